@@ -0,0 +1,93 @@
+"""Compare the JSON results of a benchmark run against a stored baseline.
+
+The results are written by the benchmarks with the arguments
+`--benchmark_out=<path>.json --benchmark_out_format=json`. The script exits
+with a non-zero status, if any benchmark is slower than the baseline by more
+than the given relative tolerance. For repeated runs, the median is compared.
+"""
+
+import argparse
+import json
+import os
+import sys
+
+TIME_UNIT_TO_SECONDS = {"ns": 1e-9, "us": 1e-6, "ms": 1e-3, "s": 1.0}
+
+
+def read_results(path, metric):
+    with open(path, "r") as fid:
+        data = json.load(fid)
+
+    results = {}
+    medians = {}
+    for benchmark in data["benchmarks"]:
+        if benchmark.get("error_occurred", False):
+            continue
+        seconds = (
+            benchmark[metric] * TIME_UNIT_TO_SECONDS[benchmark["time_unit"]]
+        )
+        if benchmark.get("run_type") == "aggregate":
+            if benchmark.get("aggregate_name") == "median":
+                medians[benchmark["run_name"]] = seconds
+            continue
+        # Without aggregates, the last repetition is used.
+        results[benchmark.get("run_name", benchmark["name"])] = seconds
+
+    results.update(medians)
+    return results
+
+
+def compare_results(baseline, contender, tolerance):
+    num_regressions = 0
+    name_width = max([len(name) for name in baseline] + [9])
+    print(f"{'Benchmark':<{name_width}}  {'Baseline':>12}  {'Contender':>12}"
+          f"  {'Change':>8}")
+    for name, baseline_seconds in sorted(baseline.items()):
+        if name not in contender:
+            print(f"{name:<{name_width}}  missing in contender")
+            continue
+        contender_seconds = contender[name]
+        change = contender_seconds / baseline_seconds - 1
+        regressed = change > tolerance
+        num_regressions += regressed
+        print(
+            f"{name:<{name_width}}  {baseline_seconds:>12.6f}"
+            f"  {contender_seconds:>12.6f}  {100 * change:>+7.1f}%"
+            + ("  REGRESSION" if regressed else "")
+        )
+    for name in sorted(set(contender) - set(baseline)):
+        print(f"{name:<{name_width}}  missing in baseline")
+    return num_regressions
+
+
+def parse_args():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--baseline_path", required=True)
+    parser.add_argument("--contender_path", required=True)
+    parser.add_argument("--tolerance", type=float, default=0.1)
+    parser.add_argument(
+        "--metric", default="real_time", choices=["real_time", "cpu_time"]
+    )
+    return parser.parse_args()
+
+
+def main():
+    args = parse_args()
+
+    if not os.path.exists(args.baseline_path):
+        print("No baseline results:", args.baseline_path)
+        return
+
+    baseline = read_results(args.baseline_path, args.metric)
+    contender = read_results(args.contender_path, args.metric)
+    num_regressions = compare_results(baseline, contender, args.tolerance)
+    if num_regressions > 0:
+        print(
+            f"{num_regressions} benchmark(s) regressed by more than "
+            f"{100 * args.tolerance:.1f}%"
+        )
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -108,4 +108,70 @@ BENCHMARK_F(BM_ReprojErrorConstantPoint3DCostFunction, Run)
   }
 }
 
+class BM_AnalyticReprojErrorCostFunction : public BM_ReprojErrorCostFunction {
+ public:
+  void SetUp(::benchmark::State& state) {
+    cost_function.reset(
+        AnalyticReprojErrorCostFunction<camera_model>::Create(data.point2D));
+  }
+};
+
+BENCHMARK_F(BM_AnalyticReprojErrorCostFunction, Run)
+(benchmark::State& state) {
+  for (auto _ : state) {
+    cost_function->Evaluate(parameters, residuals, jacobians);
+  }
+}
+
+class BM_AnalyticReprojErrorConstantPoseCostFunction
+    : public BM_ReprojErrorConstantPoseCostFunction {
+ public:
+  void SetUp(::benchmark::State& state) {
+    cost_function.reset(
+        AnalyticReprojErrorConstantPoseCostFunction<camera_model>::Create(
+            data.cam_from_world, data.point2D));
+  }
+};
+
+BENCHMARK_F(BM_AnalyticReprojErrorConstantPoseCostFunction, Run)
+(benchmark::State& state) {
+  for (auto _ : state) {
+    cost_function->Evaluate(parameters, residuals, jacobians);
+  }
+}
+
+class BM_FloatJacobianReprojErrorCostFunction
+    : public BM_ReprojErrorCostFunction {
+ public:
+  void SetUp(::benchmark::State& state) {
+    cost_function.reset(
+        FloatJacobianReprojErrorCostFunction<camera_model>::Create(
+            data.point2D));
+  }
+};
+
+BENCHMARK_F(BM_FloatJacobianReprojErrorCostFunction, Run)
+(benchmark::State& state) {
+  for (auto _ : state) {
+    cost_function->Evaluate(parameters, residuals, jacobians);
+  }
+}
+
+class BM_FloatJacobianReprojErrorConstantPoseCostFunction
+    : public BM_ReprojErrorConstantPoseCostFunction {
+ public:
+  void SetUp(::benchmark::State& state) {
+    cost_function.reset(
+        FloatJacobianReprojErrorConstantPoseCostFunction<camera_model>::Create(
+            data.cam_from_world, data.point2D));
+  }
+};
+
+BENCHMARK_F(BM_FloatJacobianReprojErrorConstantPoseCostFunction, Run)
+(benchmark::State& state) {
+  for (auto _ : state) {
+    cost_function->Evaluate(parameters, residuals, jacobians);
+  }
+}
+
 BENCHMARK_MAIN();
@@ -0,0 +1,229 @@
+#include "colmap/scene/database.h"
+#include "colmap/scene/database_cache.h"
+#include "colmap/util/misc.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <boost/filesystem.hpp>
+
+using namespace colmap;
+
+// Benchmarks of the database I/O on generated databases. The databases are
+// stored in the temporary directory or in the directory given by the
+// environment variable COLMAP_BENCHMARK_DATABASE_DIR, e.g., to compare
+// different storage devices.
+
+const int kNumFeatures = 2048;
+const int kNumMatches = 512;
+// Number of subsequent images each image is matched against, as in
+// sequential matching.
+const int kNumNeighbors = 10;
+
+std::string GetDatabasePath(const std::string& name) {
+  const char* dir = std::getenv("COLMAP_BENCHMARK_DATABASE_DIR");
+  return JoinPaths(dir == nullptr
+                       ? boost::filesystem::temp_directory_path().string()
+                       : std::string(dir),
+                   "colmap_benchmark_" + name + ".db");
+}
+
+void RemoveDatabase(const std::string& path) {
+  for (const std::string suffix : {"", "-wal", "-shm"}) {
+    boost::filesystem::remove(path + suffix);
+  }
+}
+
+// The contents of the features and matches are irrelevant for the I/O, so
+// the same data is written for all images and image pairs.
+struct SyntheticFeatures {
+  SyntheticFeatures()
+      : keypoints(kNumFeatures),
+        descriptors(FeatureDescriptors::Random(kNumFeatures, 128)) {
+    for (int i = 0; i < kNumFeatures; ++i) {
+      keypoints[i] = FeatureKeypoint(i % 1000, i / 1000);
+    }
+    for (int i = 0; i < kNumMatches; ++i) {
+      matches.emplace_back(i, kNumFeatures - i - 1);
+    }
+    two_view_geometry.config = TwoViewGeometry::CALIBRATED;
+    two_view_geometry.inlier_matches = matches;
+  }
+
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  FeatureMatches matches;
+  TwoViewGeometry two_view_geometry;
+};
+
+const SyntheticFeatures& GetSyntheticFeatures() {
+  static const SyntheticFeatures features;
+  return features;
+}
+
+std::vector<image_t> WriteImages(int num_images, Database* database) {
+  const camera_t camera_id = database->WriteCamera(Camera::CreateFromModelId(
+      kInvalidCameraId, SimpleRadialCameraModel::model_id, 1000, 1000, 1000));
+  std::vector<image_t> image_ids;
+  image_ids.reserve(num_images);
+  for (int i = 0; i < num_images; ++i) {
+    Image image;
+    image.SetName("image" + std::to_string(i));
+    image.SetCameraId(camera_id);
+    image_ids.push_back(database->WriteImage(image));
+  }
+  return image_ids;
+}
+
+void WriteFeatures(const std::vector<image_t>& image_ids, Database* database) {
+  const SyntheticFeatures& features = GetSyntheticFeatures();
+  for (const image_t image_id : image_ids) {
+    database->WriteKeypoints(image_id, features.keypoints);
+    database->WriteDescriptors(image_id, features.descriptors);
+  }
+}
+
+void WriteMatches(const std::vector<image_t>& image_ids, Database* database) {
+  const SyntheticFeatures& features = GetSyntheticFeatures();
+  for (size_t i = 0; i < image_ids.size(); ++i) {
+    const size_t end = std::min(image_ids.size(), i + kNumNeighbors + 1);
+    for (size_t j = i + 1; j < end; ++j) {
+      database->WriteMatches(image_ids[i], image_ids[j], features.matches);
+      database->WriteTwoViewGeometry(
+          image_ids[i], image_ids[j], features.two_view_geometry);
+    }
+  }
+}
+
+// Generated database with features and matches that is shared by all read
+// benchmarks with the same number of images.
+const std::string& GetGeneratedDatabase(int num_images) {
+  static std::map<int, std::string> paths;
+  std::string& path = paths[num_images];
+  if (path.empty()) {
+    path = GetDatabasePath("read_" + std::to_string(num_images));
+    RemoveDatabase(path);
+    Database database(path);
+    DatabaseTransaction transaction(&database);
+    const std::vector<image_t> image_ids = WriteImages(num_images, &database);
+    WriteFeatures(image_ids, &database);
+    WriteMatches(image_ids, &database);
+  }
+  return path;
+}
+
+void NumImagesAndTransaction(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"num_images", "transaction"})
+      ->ArgsProduct({{100, 1000}, {0, 1}})
+      ->Unit(benchmark::kMillisecond)
+      ->UseRealTime();
+}
+
+void NumImages(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgName("num_images")
+      ->Arg(100)
+      ->Arg(1000)
+      ->Arg(10000)
+      ->Unit(benchmark::kMillisecond)
+      ->UseRealTime();
+}
+
+static void BM_WriteFeatures(benchmark::State& state) {
+  const std::string path = GetDatabasePath("write_features");
+  const int num_images = state.range(0);
+  for (auto _ : state) {
+    state.PauseTiming();
+    RemoveDatabase(path);
+    Database database(path);
+    const std::vector<image_t> image_ids = WriteImages(num_images, &database);
+    state.ResumeTiming();
+    if (state.range(1)) {
+      DatabaseTransaction transaction(&database);
+      WriteFeatures(image_ids, &database);
+    } else {
+      WriteFeatures(image_ids, &database);
+    }
+    state.PauseTiming();
+    database.Close();
+    state.ResumeTiming();
+  }
+  RemoveDatabase(path);
+  state.SetItemsProcessed(state.iterations() * num_images);
+}
+
+BENCHMARK(BM_WriteFeatures)->Apply(NumImagesAndTransaction);
+
+static void BM_WriteMatches(benchmark::State& state) {
+  const std::string path = GetDatabasePath("write_matches");
+  const int num_images = state.range(0);
+  for (auto _ : state) {
+    state.PauseTiming();
+    RemoveDatabase(path);
+    Database database(path);
+    const std::vector<image_t> image_ids = WriteImages(num_images, &database);
+    state.ResumeTiming();
+    if (state.range(1)) {
+      DatabaseTransaction transaction(&database);
+      WriteMatches(image_ids, &database);
+    } else {
+      WriteMatches(image_ids, &database);
+    }
+    state.PauseTiming();
+    database.Close();
+    state.ResumeTiming();
+  }
+  RemoveDatabase(path);
+  state.SetItemsProcessed(state.iterations() * num_images * kNumNeighbors);
+}
+
+BENCHMARK(BM_WriteMatches)->Apply(NumImagesAndTransaction);
+
+static void BM_ReadAllMatches(benchmark::State& state) {
+  const Database database(GetGeneratedDatabase(state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(database.ReadAllMatches());
+  }
+}
+
+BENCHMARK(BM_ReadAllMatches)->Apply(NumImages);
+
+static void BM_ReadTwoViewGeometries(benchmark::State& state) {
+  const Database database(GetGeneratedDatabase(state.range(0)));
+  std::vector<image_pair_t> image_pair_ids;
+  std::vector<TwoViewGeometry> two_view_geometries;
+  for (auto _ : state) {
+    database.ReadTwoViewGeometries(&image_pair_ids, &two_view_geometries);
+  }
+}
+
+BENCHMARK(BM_ReadTwoViewGeometries)->Apply(NumImages);
+
+static void BM_DatabaseCacheCreate(benchmark::State& state) {
+  const Database database(GetGeneratedDatabase(state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        DatabaseCache::Create(database,
+                              /*min_num_matches=*/15,
+                              /*ignore_watermarks=*/false,
+                              /*image_names=*/{}));
+  }
+}
+
+BENCHMARK(BM_DatabaseCacheCreate)->Apply(NumImages);
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  // Remove the generated databases shared by the read benchmarks.
+  for (const int num_images : {100, 1000, 10000}) {
+    RemoveDatabase(GetDatabasePath("read_" + std::to_string(num_images)));
+  }
+  return 0;
+}
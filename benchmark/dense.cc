@@ -0,0 +1,371 @@
+#include "colmap/mvs/depth_map.h"
+#include "colmap/mvs/fusion.h"
+#include "colmap/mvs/meshing.h"
+#include "colmap/mvs/normal_map.h"
+#include "colmap/mvs/patch_match.h"
+#include "colmap/scene/reconstruction.h"
+#include "colmap/sensor/bitmap.h"
+#include "colmap/util/misc.h"
+
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+
+#include <benchmark/benchmark.h>
+#include <boost/filesystem.hpp>
+
+using namespace colmap;
+
+// Benchmarks of the dense reconstruction on synthetic workspaces, which are
+// rendered from a textured ground plane with boxes standing on it. Besides
+// the images and the sparse model, the workspaces contain the ground-truth
+// depth and normal maps with input type "synthetic", so that fusion and
+// meshing can be benchmarked independently of PatchMatch.
+
+const int kNumImages = 10;
+const char* kInputType = "synthetic";
+
+struct SyntheticBox {
+  Eigen::Vector3d min;
+  Eigen::Vector3d max;
+};
+
+const std::vector<SyntheticBox> kBoxes = {
+    {Eigen::Vector3d(-1.5, -1.0, 0), Eigen::Vector3d(-0.5, 0.0, 1.0)},
+    {Eigen::Vector3d(0.2, -0.5, 0), Eigen::Vector3d(0.8, 0.5, 0.6)},
+    {Eigen::Vector3d(-0.4, 0.8, 0), Eigen::Vector3d(0.6, 1.6, 1.4)},
+};
+
+const double kGroundExtent = 4;
+
+// Intersects the ray with the scene and returns the distance along the ray
+// direction and the normal of the closest surface.
+bool IntersectScene(const Eigen::Vector3d& origin,
+                    const Eigen::Vector3d& dir,
+                    double* t,
+                    Eigen::Vector3d* normal) {
+  *t = std::numeric_limits<double>::max();
+  if (dir.z() < 0) {
+    const double t_ground = -origin.z() / dir.z();
+    const Eigen::Vector3d point = origin + t_ground * dir;
+    if (std::abs(point.x()) <= kGroundExtent &&
+        std::abs(point.y()) <= kGroundExtent) {
+      *t = t_ground;
+      *normal = Eigen::Vector3d::UnitZ();
+    }
+  }
+
+  for (const SyntheticBox& box : kBoxes) {
+    double t_near = 0;
+    double t_far = std::numeric_limits<double>::max();
+    int near_axis = -1;
+    bool parallel_miss = false;
+    for (int axis = 0; axis < 3; ++axis) {
+      if (dir(axis) == 0) {
+        parallel_miss |=
+            origin(axis) < box.min(axis) || origin(axis) > box.max(axis);
+        continue;
+      }
+      double t1 = (box.min(axis) - origin(axis)) / dir(axis);
+      double t2 = (box.max(axis) - origin(axis)) / dir(axis);
+      if (t1 > t2) {
+        std::swap(t1, t2);
+      }
+      if (t1 > t_near) {
+        t_near = t1;
+        near_axis = axis;
+      }
+      t_far = std::min(t_far, t2);
+    }
+    if (!parallel_miss && near_axis >= 0 && t_near <= t_far && t_near < *t) {
+      *t = t_near;
+      *normal = Eigen::Vector3d::Zero();
+      (*normal)(near_axis) = dir(near_axis) > 0 ? -1 : 1;
+    }
+  }
+
+  return *t < std::numeric_limits<double>::max();
+}
+
+// Deterministic blocky texture at two frequencies, which is well suited for
+// matching and independent of the image resolution.
+uint8_t SceneTexture(const Eigen::Vector3d& point) {
+  const auto hash = [&point](double scale) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 3; ++i) {
+      h = (h ^ static_cast<uint32_t>(std::floor(point(i) * scale))) *
+          16777619u;
+    }
+    h ^= h >> 15;
+    return static_cast<double>(h % 1024) / 1024;
+  };
+  return static_cast<uint8_t>(32 + 127 * hash(25) + 95 * hash(5));
+}
+
+// Camera looking at the origin from the given position with the z-axis up.
+Rigid3d LookAtOrigin(const Eigen::Vector3d& position) {
+  const Eigen::Vector3d forward = -position.normalized();
+  const Eigen::Vector3d right = forward.cross(Eigen::Vector3d::UnitZ());
+  const Eigen::Vector3d down = forward.cross(right.normalized());
+  Eigen::Matrix3d R;
+  R.row(0) = right.normalized();
+  R.row(1) = down.normalized();
+  R.row(2) = forward;
+  return Rigid3d(Eigen::Quaterniond(R), -R * position);
+}
+
+struct SyntheticWorkspace {
+  explicit SyntheticWorkspace(int width) {
+    path = (boost::filesystem::temp_directory_path() /
+            boost::filesystem::unique_path("colmap_benchmark_mvs_%%%%%%%%"))
+               .string();
+    const std::string stereo_path = JoinPaths(path, "stereo");
+    for (const std::string dir : {"images",
+                                  "sparse",
+                                  "stereo",
+                                  "stereo/depth_maps",
+                                  "stereo/normal_maps",
+                                  "stereo/consistency_graphs"}) {
+      CreateDirIfNotExists(JoinPaths(path, dir), /*recursive=*/true);
+    }
+
+    const int height = width * 3 / 4;
+    num_pixels = static_cast<size_t>(width) * height;
+    Reconstruction reconstruction;
+    Camera camera = Camera::CreateFromModelId(
+        1, PinholeCameraModel::model_id, 0.8 * width, width, height);
+    reconstruction.AddCamera(camera);
+
+    std::vector<Rigid3d> cams_from_world;
+    std::vector<DepthMap> depth_maps;
+    std::string patch_match_config;
+    std::string fusion_config;
+    for (int image_idx = 0; image_idx < kNumImages; ++image_idx) {
+      const double angle = M_PI / 2 * image_idx / (kNumImages - 1) - M_PI / 4;
+      const Eigen::Vector3d position(
+          5 * std::cos(angle), 5 * std::sin(angle), 3);
+      cams_from_world.push_back(LookAtOrigin(position));
+      const Eigen::Matrix3d world_from_cam_rotation =
+          cams_from_world.back().rotation.toRotationMatrix().transpose();
+
+      Bitmap bitmap;
+      bitmap.Allocate(width, height, /*as_rgb=*/false);
+      DepthMap depth_map(width, height, 0.1, 20);
+      NormalMap normal_map(width, height);
+      for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+          // Rays with unit depth, such that the distance along the ray is
+          // equal to the depth.
+          const Eigen::Vector2d point_in_cam =
+              camera.CamFromImg(Eigen::Vector2d(x + 0.5, y + 0.5));
+          const Eigen::Vector3d ray =
+              world_from_cam_rotation * point_in_cam.homogeneous();
+          double depth;
+          Eigen::Vector3d normal;
+          if (!IntersectScene(position, ray, &depth, &normal)) {
+            bitmap.SetPixel(x, y, BitmapColor<uint8_t>(0));
+            depth_map.Set(y, x, 0);
+            continue;
+          }
+          bitmap.SetPixel(
+              x, y, BitmapColor<uint8_t>(SceneTexture(position + depth * ray)));
+          depth_map.Set(y, x, depth);
+          const Eigen::Vector3d normal_in_cam =
+              cams_from_world.back().rotation * normal;
+          for (int i = 0; i < 3; ++i) {
+            normal_map.Set(y, x, i, normal_in_cam(i));
+          }
+        }
+      }
+
+      const std::string image_name =
+          "image" + std::to_string(image_idx) + ".png";
+      bitmap.Write(JoinPaths(path, "images", image_name));
+      const std::string file_name =
+          image_name + "." + std::string(kInputType) + ".bin";
+      depth_map.Write(JoinPaths(stereo_path, "depth_maps", file_name));
+      normal_map.Write(JoinPaths(stereo_path, "normal_maps", file_name));
+      depth_maps.push_back(std::move(depth_map));
+
+      Image image;
+      image.SetImageId(image_idx + 1);
+      image.SetName(image_name);
+      image.SetCameraId(camera.camera_id);
+      image.CamFromWorld() = cams_from_world.back();
+      reconstruction.AddImage(std::move(image));
+      reconstruction.RegisterImage(image_idx + 1);
+
+      patch_match_config += image_name + "\n__auto__, 5\n";
+      fusion_config += image_name + "\n";
+    }
+
+    // Sparse points on a grid on the ground plane, which are used to select
+    // the source images and depth ranges of PatchMatch.
+    std::vector<std::vector<Eigen::Vector2d>> points2D(kNumImages);
+    std::vector<Eigen::Vector3d> points3D;
+    std::vector<Track> tracks;
+    for (double x = -kGroundExtent; x <= kGroundExtent; x += 0.25) {
+      for (double y = -kGroundExtent; y <= kGroundExtent; y += 0.25) {
+        const Eigen::Vector3d point3D(x, y, 0);
+        Track track;
+        for (int image_idx = 0; image_idx < kNumImages; ++image_idx) {
+          const Eigen::Vector3d point3D_in_cam =
+              cams_from_world[image_idx] * point3D;
+          const Eigen::Vector2d point2D =
+              camera.ImgFromCam(point3D_in_cam.hnormalized());
+          const int col = static_cast<int>(point2D.x());
+          const int row = static_cast<int>(point2D.y());
+          if (point3D_in_cam.z() <= 0 || col < 0 || row < 0 ||
+              col >= width || row >= height ||
+              std::abs(depth_maps[image_idx].Get(row, col) -
+                       point3D_in_cam.z()) > 0.05) {
+            continue;
+          }
+          track.AddElement(image_idx + 1, points2D[image_idx].size());
+          points2D[image_idx].push_back(point2D);
+        }
+        if (track.Length() >= 2) {
+          points3D.push_back(point3D);
+          tracks.push_back(std::move(track));
+        } else {
+          // Remove the observations of points without a track.
+          for (const TrackElement& track_el : track.Elements()) {
+            points2D[track_el.image_id - 1].pop_back();
+          }
+        }
+      }
+    }
+    for (int image_idx = 0; image_idx < kNumImages; ++image_idx) {
+      reconstruction.Image(image_idx + 1).SetPoints2D(points2D[image_idx]);
+    }
+    for (size_t i = 0; i < points3D.size(); ++i) {
+      reconstruction.AddPoint3D(points3D[i], tracks[i]);
+    }
+    reconstruction.Write(JoinPaths(path, "sparse"));
+
+    std::ofstream patch_match_file(JoinPaths(stereo_path, "patch-match.cfg"));
+    THROW_CHECK_FILE_OPEN(patch_match_file, stereo_path);
+    patch_match_file << patch_match_config;
+    patch_match_file.close();
+    std::ofstream fusion_file(JoinPaths(stereo_path, "fusion.cfg"));
+    THROW_CHECK_FILE_OPEN(fusion_file, stereo_path);
+    fusion_file << fusion_config;
+    fusion_file.close();
+
+    // Fused points of the ground-truth depth maps as input to the meshing.
+    StereoFusion fusion(
+        StereoFusionOptions(), path, "COLMAP", "", std::string(kInputType));
+    fusion.Run();
+    num_fused_points = fusion.NumFusedPoints();
+    fusion.WriteFusedPoints(JoinPaths(path, "fused.ply"));
+  }
+
+  ~SyntheticWorkspace() { boost::filesystem::remove_all(path); }
+
+  std::string path;
+  size_t num_pixels = 0;
+  size_t num_fused_points = 0;
+};
+
+// Rendering the workspaces takes longer than most of the benchmarks, so they
+// are shared by all benchmarks of a run and deleted at exit.
+const SyntheticWorkspace& GetSyntheticWorkspace(int width) {
+  static std::map<int, std::unique_ptr<SyntheticWorkspace>> workspaces;
+  std::unique_ptr<SyntheticWorkspace>& workspace = workspaces[width];
+  if (!workspace) {
+    workspace = std::make_unique<SyntheticWorkspace>(width);
+  }
+  return *workspace;
+}
+
+void ImageWidths(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgName("width")
+      ->Arg(320)
+      ->Arg(640)
+      ->Arg(1280)
+      ->Unit(benchmark::kMillisecond)
+      ->UseRealTime();
+}
+
+benchmark::Counter Rate(double value) {
+  return benchmark::Counter(value,
+                            benchmark::Counter::kIsIterationInvariantRate);
+}
+
+static void BM_PatchMatch(benchmark::State& state) {
+  const SyntheticWorkspace& workspace = GetSyntheticWorkspace(state.range(0));
+  PatchMatchOptions options;
+  options.use_gpu = state.range(1);
+  for (auto _ : state) {
+    PatchMatchController controller(options, workspace.path, "COLMAP", "");
+    controller.Run();
+  }
+  // Every image is processed once photometrically and once geometrically.
+  state.counters["megapixels_per_second"] =
+      Rate(2 * kNumImages * workspace.num_pixels / 1e6);
+}
+
+// The CUDA implementation is only benchmarked, if it is available.
+void ImageWidthsAndDevices(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"width", "use_gpu"});
+  for (const int width : {320, 640, 1280}) {
+    benchmark->Args({width, 0});
+#if defined(COLMAP_CUDA_ENABLED)
+    benchmark->Args({width, 1});
+#endif
+  }
+  benchmark->Iterations(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+}
+
+BENCHMARK(BM_PatchMatch)->Apply(ImageWidthsAndDevices);
+
+static void BM_StereoFusion(benchmark::State& state) {
+  const SyntheticWorkspace& workspace = GetSyntheticWorkspace(state.range(0));
+  size_t num_fused_points = 0;
+  for (auto _ : state) {
+    StereoFusion fusion(StereoFusionOptions(),
+                        workspace.path,
+                        "COLMAP",
+                        "",
+                        std::string(kInputType));
+    fusion.Run();
+    num_fused_points = fusion.NumFusedPoints();
+  }
+  state.counters["megapixels_per_second"] =
+      Rate(kNumImages * workspace.num_pixels / 1e6);
+  state.counters["points_per_second"] = Rate(num_fused_points);
+}
+
+BENCHMARK(BM_StereoFusion)->Apply(ImageWidths);
+
+static void BM_PoissonMeshing(benchmark::State& state) {
+  const SyntheticWorkspace& workspace = GetSyntheticWorkspace(state.range(0));
+  const std::string output_path =
+      JoinPaths(workspace.path, "meshed-poisson.ply");
+  for (auto _ : state) {
+    PoissonMeshing(PoissonMeshingOptions(),
+                   JoinPaths(workspace.path, "fused.ply"),
+                   output_path);
+  }
+  state.counters["points_per_second"] = Rate(workspace.num_fused_points);
+}
+
+BENCHMARK(BM_PoissonMeshing)->Apply(ImageWidths);
+
+#if defined(COLMAP_CGAL_ENABLED)
+static void BM_DenseDelaunayMeshing(benchmark::State& state) {
+  const SyntheticWorkspace& workspace = GetSyntheticWorkspace(state.range(0));
+  const std::string output_path =
+      JoinPaths(workspace.path, "meshed-delaunay.ply");
+  for (auto _ : state) {
+    DenseDelaunayMeshing(DelaunayMeshingOptions(), workspace.path, output_path);
+  }
+  state.counters["points_per_second"] = Rate(workspace.num_fused_points);
+}
+
+BENCHMARK(BM_DenseDelaunayMeshing)->Apply(ImageWidths);
+#endif
+
+BENCHMARK_MAIN();
@@ -0,0 +1,328 @@
+#include "colmap/estimators/absolute_pose.h"
+#include "colmap/estimators/essential_matrix.h"
+#include "colmap/estimators/fundamental_matrix.h"
+#include "colmap/estimators/generalized_absolute_pose.h"
+#include "colmap/estimators/generalized_relative_pose.h"
+#include "colmap/estimators/homography_matrix.h"
+#include "colmap/estimators/two_view_geometry.h"
+#include "colmap/geometry/rigid3.h"
+#include "colmap/math/random.h"
+#include "colmap/optim/loransac.h"
+#include "colmap/scene/camera.h"
+#include "colmap/sensor/models.h"
+#include "colmap/util/eigen_alignment.h"
+
+#include <array>
+
+#include <benchmark/benchmark.h>
+
+using namespace colmap;
+
+// Random points in front of the first camera, such that they project into the
+// normalized image plane within [-0.25, 0.25] of both cameras.
+Eigen::Vector3d RandomPoint3D() {
+  return Eigen::Vector3d(RandomUniformReal(-1.0, 1.0),
+                         RandomUniformReal(-1.0, 1.0),
+                         RandomUniformReal(4.0, 6.0));
+}
+
+Eigen::Vector2d RandomNormalizedPoint2D() {
+  return Eigen::Vector2d(RandomUniformReal(-0.25, 0.25),
+                         RandomUniformReal(-0.25, 0.25));
+}
+
+// Correspondences between two calibrated cameras, in which the last
+// correspondences are outliers according to the given inlier ratio.
+struct SyntheticTwoView {
+  SyntheticTwoView(int num_points, double inlier_ratio)
+      : cam2_from_cam1(Eigen::Quaterniond(Eigen::AngleAxisd(
+                           0.2, Eigen::Vector3d(0.1, 1, 0).normalized())),
+                       Eigen::Vector3d(1, 0.1, 0.05)) {
+    SetPRNGSeed(42);
+    const int num_inliers = inlier_ratio * num_points;
+    for (int i = 0; i < num_points; ++i) {
+      const Eigen::Vector3d point3D = RandomPoint3D();
+      points1.push_back(point3D.hnormalized());
+      if (i < num_inliers) {
+        points2.push_back((cam2_from_cam1 * point3D).hnormalized());
+      } else {
+        points2.push_back(RandomNormalizedPoint2D());
+      }
+    }
+  }
+
+  Rigid3d cam2_from_cam1;
+  std::vector<Eigen::Vector2d> points1;
+  std::vector<Eigen::Vector2d> points2;
+};
+
+// 2D-3D correspondences of a calibrated camera with the given inlier ratio.
+struct SyntheticAbsolutePose {
+  SyntheticAbsolutePose(int num_points, double inlier_ratio)
+      : cam_from_world(Eigen::Quaterniond(Eigen::AngleAxisd(
+                           0.1, Eigen::Vector3d(1, 0.2, 0).normalized())),
+                       Eigen::Vector3d(0.2, -0.1, 0.3)) {
+    SetPRNGSeed(42);
+    const int num_inliers = inlier_ratio * num_points;
+    for (int i = 0; i < num_points; ++i) {
+      points3D.push_back(RandomPoint3D());
+      if (i < num_inliers) {
+        points2D.push_back((cam_from_world * points3D.back()).hnormalized());
+      } else {
+        points2D.push_back(RandomNormalizedPoint2D());
+      }
+    }
+  }
+
+  Rigid3d cam_from_world;
+  std::vector<Eigen::Vector2d> points2D;
+  std::vector<Eigen::Vector3d> points3D;
+};
+
+// Generalized camera with four slightly rotated and offset cameras.
+std::array<Rigid3d, 4> SyntheticCamsFromRig() {
+  std::array<Rigid3d, 4> cams_from_rig;
+  for (size_t i = 0; i < cams_from_rig.size(); ++i) {
+    cams_from_rig[i] =
+        Rigid3d(Eigen::Quaterniond(1, 0.05 * i, 0, 0).normalized(),
+                Eigen::Vector3d(0.1 * i, 0.1, 0));
+  }
+  return cams_from_rig;
+}
+
+struct SyntheticGeneralizedAbsolutePose {
+  explicit SyntheticGeneralizedAbsolutePose(int num_points)
+      : rig_from_world(Eigen::Quaterniond(Eigen::AngleAxisd(
+                           0.1, Eigen::Vector3d(1, 0.2, 0).normalized())),
+                       Eigen::Vector3d(0.2, -0.1, 0.3)) {
+    SetPRNGSeed(42);
+    const std::array<Rigid3d, 4> cams_from_rig = SyntheticCamsFromRig();
+    for (int i = 0; i < num_points; ++i) {
+      points3D.push_back(RandomPoint3D());
+      GP3PEstimator::X_t point2D;
+      point2D.cam_from_rig = cams_from_rig[i % cams_from_rig.size()];
+      point2D.ray_in_cam =
+          (point2D.cam_from_rig * (rig_from_world * points3D.back()))
+              .normalized();
+      points2D.push_back(point2D);
+    }
+  }
+
+  Rigid3d rig_from_world;
+  std::vector<GP3PEstimator::X_t> points2D;
+  std::vector<GP3PEstimator::Y_t> points3D;
+};
+
+struct SyntheticGeneralizedRelativePose {
+  explicit SyntheticGeneralizedRelativePose(int num_points)
+      : rig2_from_rig1(Eigen::Quaterniond(Eigen::AngleAxisd(
+                           0.2, Eigen::Vector3d(0.1, 1, 0).normalized())),
+                       Eigen::Vector3d(1, 0.1, 0.05)) {
+    SetPRNGSeed(42);
+    const std::array<Rigid3d, 4> cams_from_rig = SyntheticCamsFromRig();
+    for (int i = 0; i < num_points; ++i) {
+      const Eigen::Vector3d point3D = RandomPoint3D();
+      // Observe the points from different cameras in both rigs, since the
+      // problem is degenerate otherwise.
+      GR6PEstimator::X_t point1;
+      point1.cam_from_rig = cams_from_rig[i % cams_from_rig.size()];
+      point1.ray_in_cam = (point1.cam_from_rig * point3D).normalized();
+      points1.push_back(point1);
+      GR6PEstimator::Y_t point2;
+      point2.cam_from_rig = cams_from_rig[(i + 1) % cams_from_rig.size()];
+      point2.ray_in_cam =
+          (point2.cam_from_rig * (rig2_from_rig1 * point3D)).normalized();
+      points2.push_back(point2);
+    }
+  }
+
+  Rigid3d rig2_from_rig1;
+  std::vector<GR6PEstimator::X_t> points1;
+  std::vector<GR6PEstimator::Y_t> points2;
+};
+
+void NumResiduals(benchmark::internal::Benchmark* benchmark) {
+  benchmark->Arg(100)->Arg(1000)->Arg(10000)->Arg(100000);
+}
+
+void NumPointsAndInlierPercentages(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"num_points", "inlier_percentage"})
+      ->ArgsProduct({{1000}, {25, 50, 75, 100}})
+      ->Unit(benchmark::kMillisecond);
+}
+
+template <typename Estimator>
+static void BM_TwoViewMinimalSolver(benchmark::State& state) {
+  const SyntheticTwoView problem(Estimator::kMinNumSamples, 1);
+  std::vector<typename Estimator::M_t> models;
+  for (auto _ : state) {
+    Estimator::Estimate(problem.points1, problem.points2, &models);
+    benchmark::DoNotOptimize(models.data());
+  }
+}
+
+BENCHMARK_TEMPLATE(BM_TwoViewMinimalSolver, EssentialMatrixFivePointEstimator);
+BENCHMARK_TEMPLATE(BM_TwoViewMinimalSolver, EssentialMatrixEightPointEstimator);
+BENCHMARK_TEMPLATE(BM_TwoViewMinimalSolver,
+                   FundamentalMatrixSevenPointEstimator);
+BENCHMARK_TEMPLATE(BM_TwoViewMinimalSolver,
+                   FundamentalMatrixEightPointEstimator);
+BENCHMARK_TEMPLATE(BM_TwoViewMinimalSolver, HomographyMatrixEstimator);
+
+template <typename Estimator>
+static void BM_TwoViewResiduals(benchmark::State& state) {
+  const SyntheticTwoView problem(state.range(0), 1);
+  std::vector<typename Estimator::M_t> models;
+  Estimator::Estimate(
+      {problem.points1.begin(),
+       problem.points1.begin() + Estimator::kMinNumSamples},
+      {problem.points2.begin(),
+       problem.points2.begin() + Estimator::kMinNumSamples},
+      &models);
+  if (models.empty()) {
+    state.SkipWithError("Failed to estimate model");
+    return;
+  }
+  std::vector<double> residuals;
+  for (auto _ : state) {
+    Estimator::Residuals(
+        problem.points1, problem.points2, models[0], &residuals);
+    benchmark::DoNotOptimize(residuals.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_TEMPLATE(BM_TwoViewResiduals, EssentialMatrixFivePointEstimator)
+    ->Apply(NumResiduals);
+BENCHMARK_TEMPLATE(BM_TwoViewResiduals, FundamentalMatrixSevenPointEstimator)
+    ->Apply(NumResiduals);
+BENCHMARK_TEMPLATE(BM_TwoViewResiduals, HomographyMatrixEstimator)
+    ->Apply(NumResiduals);
+
+template <typename Estimator>
+static void BM_AbsolutePoseMinimalSolver(benchmark::State& state) {
+  const SyntheticAbsolutePose problem(Estimator::kMinNumSamples, 1);
+  std::vector<typename Estimator::M_t> models;
+  for (auto _ : state) {
+    Estimator::Estimate(problem.points2D, problem.points3D, &models);
+    benchmark::DoNotOptimize(models.data());
+  }
+}
+
+BENCHMARK_TEMPLATE(BM_AbsolutePoseMinimalSolver, P3PEstimator);
+BENCHMARK_TEMPLATE(BM_AbsolutePoseMinimalSolver, EPNPEstimator);
+
+static void BM_AbsolutePoseResiduals(benchmark::State& state) {
+  const SyntheticAbsolutePose problem(state.range(0), 1);
+  const Eigen::Matrix3x4d cam_from_world = problem.cam_from_world.ToMatrix();
+  std::vector<double> residuals;
+  for (auto _ : state) {
+    P3PEstimator::Residuals(
+        problem.points2D, problem.points3D, cam_from_world, &residuals);
+    benchmark::DoNotOptimize(residuals.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_AbsolutePoseResiduals)->Apply(NumResiduals);
+
+static void BM_GP3PMinimalSolver(benchmark::State& state) {
+  const SyntheticGeneralizedAbsolutePose problem(GP3PEstimator::kMinNumSamples);
+  std::vector<GP3PEstimator::M_t> models;
+  for (auto _ : state) {
+    GP3PEstimator::Estimate(problem.points2D, problem.points3D, &models);
+    benchmark::DoNotOptimize(models.data());
+  }
+}
+
+BENCHMARK(BM_GP3PMinimalSolver);
+
+static void BM_GP3PResiduals(benchmark::State& state) {
+  const SyntheticGeneralizedAbsolutePose problem(state.range(0));
+  GP3PEstimator estimator;
+  std::vector<double> residuals;
+  for (auto _ : state) {
+    estimator.Residuals(
+        problem.points2D, problem.points3D, problem.rig_from_world, &residuals);
+    benchmark::DoNotOptimize(residuals.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_GP3PResiduals)->Apply(NumResiduals);
+
+static void BM_GR6PMinimalSolver(benchmark::State& state) {
+  const SyntheticGeneralizedRelativePose problem(GR6PEstimator::kMinNumSamples);
+  std::vector<GR6PEstimator::M_t> models;
+  for (auto _ : state) {
+    GR6PEstimator::Estimate(problem.points1, problem.points2, &models);
+    benchmark::DoNotOptimize(models.data());
+  }
+}
+
+BENCHMARK(BM_GR6PMinimalSolver);
+
+static void BM_GR6PResiduals(benchmark::State& state) {
+  const SyntheticGeneralizedRelativePose problem(state.range(0));
+  std::vector<double> residuals;
+  for (auto _ : state) {
+    GR6PEstimator::Residuals(
+        problem.points1, problem.points2, problem.rig2_from_rig1, &residuals);
+    benchmark::DoNotOptimize(residuals.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_GR6PResiduals)->Apply(NumResiduals);
+
+static void BM_LORANSACEssentialMatrix(benchmark::State& state) {
+  const SyntheticTwoView problem(state.range(0), state.range(1) / 100.0);
+  RANSACOptions options;
+  options.max_error = 1e-3;
+  for (auto _ : state) {
+    LORANSAC<EssentialMatrixFivePointEstimator,
+             EssentialMatrixEightPointEstimator>
+        ransac(options);
+    benchmark::DoNotOptimize(ransac.Estimate(problem.points1, problem.points2));
+  }
+}
+
+BENCHMARK(BM_LORANSACEssentialMatrix)->Apply(NumPointsAndInlierPercentages);
+
+static void BM_LORANSACAbsolutePose(benchmark::State& state) {
+  const SyntheticAbsolutePose problem(state.range(0), state.range(1) / 100.0);
+  RANSACOptions options;
+  options.max_error = 1e-3;
+  for (auto _ : state) {
+    LORANSAC<P3PEstimator, EPNPEstimator> ransac(options);
+    benchmark::DoNotOptimize(
+        ransac.Estimate(problem.points2D, problem.points3D));
+  }
+}
+
+BENCHMARK(BM_LORANSACAbsolutePose)->Apply(NumPointsAndInlierPercentages);
+
+static void BM_EstimateTwoViewGeometry(benchmark::State& state) {
+  const SyntheticTwoView problem(state.range(0), state.range(1) / 100.0);
+  Camera camera = Camera::CreateFromModelId(
+      1, SimplePinholeCameraModel::model_id, 1000, 1000, 1000);
+  // Use the calibrated estimation, as for most images with EXIF data.
+  camera.has_prior_focal_length = true;
+  std::vector<Eigen::Vector2d> points1;
+  std::vector<Eigen::Vector2d> points2;
+  FeatureMatches matches;
+  for (size_t i = 0; i < problem.points1.size(); ++i) {
+    points1.push_back(camera.ImgFromCam(problem.points1[i]));
+    points2.push_back(camera.ImgFromCam(problem.points2[i]));
+    matches.emplace_back(i, i);
+  }
+  const TwoViewGeometryOptions options;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(EstimateTwoViewGeometry(
+        camera, points1, camera, points2, matches, options));
+  }
+}
+
+BENCHMARK(BM_EstimateTwoViewGeometry)->Apply(NumPointsAndInlierPercentages);
+
+BENCHMARK_MAIN();
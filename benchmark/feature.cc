@@ -0,0 +1,216 @@
+#include "colmap/feature/sift.h"
+#include "colmap/feature/utils.h"
+#include "colmap/math/random.h"
+#include "colmap/scene/two_view_geometry.h"
+#include "colmap/sensor/bitmap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <numeric>
+
+#include <benchmark/benchmark.h>
+
+using namespace colmap;
+
+// Deterministic synthetic descriptors of two images, in which the first half of
+// the descriptors of the second image are noisy copies of the first image's
+// descriptors in shuffled order and the second half are unrelated.
+struct SyntheticDescriptors {
+  explicit SyntheticDescriptors(int num_descriptors) {
+    SetPRNGSeed(42);
+    const int kDim = 128;
+    FeatureDescriptorsFloat descriptors1_float(num_descriptors, kDim);
+    for (int i = 0; i < num_descriptors; ++i) {
+      for (int j = 0; j < kDim; ++j) {
+        descriptors1_float(i, j) = std::pow(RandomUniformReal(0.0f, 1.0f), 2);
+      }
+    }
+
+    std::vector<int> order(num_descriptors);
+    std::iota(order.begin(), order.end(), 0);
+    Shuffle(num_descriptors, &order);
+
+    FeatureDescriptorsFloat descriptors2_float(num_descriptors, kDim);
+    for (int i = 0; i < num_descriptors; ++i) {
+      for (int j = 0; j < kDim; ++j) {
+        if (i < num_descriptors / 2) {
+          descriptors2_float(i, j) =
+              descriptors1_float(order[i], j) + RandomGaussian(0.0f, 0.01f);
+        } else {
+          descriptors2_float(i, j) = std::pow(RandomUniformReal(0.0f, 1.0f), 2);
+        }
+      }
+    }
+
+    L2NormalizeFeatureDescriptors(&descriptors1_float);
+    L2NormalizeFeatureDescriptors(&descriptors2_float);
+    descriptors1 = std::make_shared<FeatureDescriptors>(
+        FeatureDescriptorsToUnsignedByte(descriptors1_float));
+    descriptors2 = std::make_shared<FeatureDescriptors>(
+        FeatureDescriptorsToUnsignedByte(descriptors2_float));
+
+    // The second image is translated horizontally, such that the epipolar
+    // lines of the corresponding keypoints are the image rows.
+    auto keypoints1_ptr = std::make_shared<FeatureKeypoints>();
+    auto keypoints2_ptr = std::make_shared<FeatureKeypoints>(num_descriptors);
+    for (int i = 0; i < num_descriptors; ++i) {
+      keypoints1_ptr->emplace_back(RandomUniformReal(0.0f, 1000.0f),
+                                   RandomUniformReal(0.0f, 1000.0f));
+    }
+    for (int i = 0; i < num_descriptors; ++i) {
+      if (i < num_descriptors / 2) {
+        const FeatureKeypoint& keypoint1 = (*keypoints1_ptr)[order[i]];
+        (*keypoints2_ptr)[i] = FeatureKeypoint(
+            keypoint1.x - RandomUniformReal(0.0f, 100.0f), keypoint1.y);
+      } else {
+        (*keypoints2_ptr)[i] =
+            FeatureKeypoint(RandomUniformReal(0.0f, 1000.0f),
+                            RandomUniformReal(0.0f, 1000.0f));
+      }
+    }
+    keypoints1 = std::move(keypoints1_ptr);
+    keypoints2 = std::move(keypoints2_ptr);
+
+    two_view_geometry.config = TwoViewGeometry::UNCALIBRATED;
+    two_view_geometry.F << 0, 0, 0, 0, 0, -1, 0, 1, 0;
+  }
+
+  std::shared_ptr<const FeatureKeypoints> keypoints1;
+  std::shared_ptr<const FeatureKeypoints> keypoints2;
+  std::shared_ptr<const FeatureDescriptors> descriptors1;
+  std::shared_ptr<const FeatureDescriptors> descriptors2;
+  TwoViewGeometry two_view_geometry;
+};
+
+// Deterministic synthetic image of overlapping gray discs, whose layout is
+// independent of the image size, so that the same structures are detected at
+// the different scales.
+Bitmap CreateSyntheticImage(int width, int height) {
+  SetPRNGSeed(42);
+  Bitmap bitmap;
+  bitmap.Allocate(width, height, /*as_rgb=*/false);
+  bitmap.Fill(BitmapColor<uint8_t>(128));
+  const int kNumDiscs = 2000;
+  for (int i = 0; i < kNumDiscs; ++i) {
+    const double center_x = RandomUniformReal(0.0, 1.0) * width;
+    const double center_y = RandomUniformReal(0.0, 1.0) * height;
+    const double radius = RandomUniformReal(0.002, 0.02) * width;
+    const BitmapColor<uint8_t> color(
+        static_cast<uint8_t>(RandomUniformInteger(0, 255)));
+    const int min_x = std::max(0, static_cast<int>(center_x - radius));
+    const int max_x = std::min(width - 1, static_cast<int>(center_x + radius));
+    const int min_y = std::max(0, static_cast<int>(center_y - radius));
+    const int max_y = std::min(height - 1, static_cast<int>(center_y + radius));
+    for (int y = min_y; y <= max_y; ++y) {
+      for (int x = min_x; x <= max_x; ++x) {
+        const double dx = x - center_x;
+        const double dy = y - center_y;
+        if (dx * dx + dy * dy <= radius * radius) {
+          bitmap.SetPixel(x, y, color);
+        }
+      }
+    }
+  }
+  return bitmap;
+}
+
+void NumDescriptors(benchmark::internal::Benchmark* benchmark) {
+  benchmark->RangeMultiplier(2)
+      ->Range(1024, 32768)
+      ->Unit(benchmark::kMillisecond);
+}
+
+static void BM_SiftCPUMatch(benchmark::State& state) {
+  const SyntheticDescriptors problem(state.range(0));
+  SiftMatchingOptions options;
+  options.use_gpu = false;
+  options.num_threads = 1;
+  options.brute_force_cpu_matcher = state.range(1);
+  auto matcher = CreateSiftFeatureMatcher(options);
+  FeatureMatches matches;
+  for (auto _ : state) {
+    matcher->Match(problem.descriptors1, problem.descriptors2, &matches);
+  }
+  state.counters["num_matches"] = matches.size();
+}
+
+BENCHMARK(BM_SiftCPUMatch)
+    ->ArgNames({"num_descriptors", "brute_force"})
+    ->ArgsProduct({benchmark::CreateRange(1024, 32768, /*multi=*/2), {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_SiftCPUMatchGuided(benchmark::State& state) {
+  const SyntheticDescriptors problem(state.range(0));
+  SiftMatchingOptions options;
+  options.use_gpu = false;
+  options.num_threads = 1;
+  auto matcher = CreateSiftFeatureMatcher(options);
+  TwoViewGeometry two_view_geometry;
+  for (auto _ : state) {
+    two_view_geometry = problem.two_view_geometry;
+    matcher->MatchGuided(/*max_error=*/4,
+                         problem.keypoints1,
+                         problem.keypoints2,
+                         problem.descriptors1,
+                         problem.descriptors2,
+                         &two_view_geometry);
+  }
+  state.counters["num_matches"] = two_view_geometry.inlier_matches.size();
+}
+
+BENCHMARK(BM_SiftCPUMatchGuided)->Apply(NumDescriptors);
+
+// The GPU matcher is only benchmarked with CUDA, since the OpenGL version
+// requires a window system.
+#if defined(COLMAP_CUDA_ENABLED)
+static void BM_SiftGPUMatch(benchmark::State& state) {
+  const SyntheticDescriptors problem(state.range(0));
+  SiftMatchingOptions options;
+  options.use_gpu = true;
+  options.gpu_index = "0";
+  options.max_num_matches = state.range(0);
+  auto matcher = CreateSiftFeatureMatcher(options);
+  if (matcher == nullptr) {
+    state.SkipWithError("Failed to create GPU matcher");
+    return;
+  }
+  FeatureMatches matches;
+  for (auto _ : state) {
+    matcher->Match(problem.descriptors1, problem.descriptors2, &matches);
+  }
+  state.counters["num_matches"] = matches.size();
+}
+
+BENCHMARK(BM_SiftGPUMatch)->Apply(NumDescriptors);
+#endif
+
+static void BM_SiftCPUExtract(benchmark::State& state) {
+  const int max_image_size = state.range(0);
+  const Bitmap bitmap =
+      CreateSyntheticImage(max_image_size, max_image_size * 3 / 4);
+  SiftExtractionOptions options;
+  options.use_gpu = false;
+  options.num_threads = 1;
+  options.max_image_size = max_image_size;
+  auto extractor = CreateSiftFeatureExtractor(options);
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  for (auto _ : state) {
+    if (!extractor->Extract(bitmap, &keypoints, &descriptors)) {
+      state.SkipWithError("Failed to extract features");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["num_features"] = keypoints.size();
+}
+
+BENCHMARK(BM_SiftCPUExtract)
+    ->ArgName("max_image_size")
+    ->Arg(640)
+    ->Arg(1600)
+    ->Arg(3200)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
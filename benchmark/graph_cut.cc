@@ -0,0 +1,150 @@
+#include "colmap/math/graph_cut.h"
+#include "colmap/scene/scene_clustering.h"
+
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+using namespace colmap;
+
+// Synthetic scene graph, in which every image overlaps with the next images
+// of a sequence and with a few random images, e.g., loop closures.
+struct SyntheticSceneGraph {
+  explicit SyntheticSceneGraph(int num_images) {
+    const int kNumSequentialNeighbors = 10;
+    const int kNumRandomNeighbors = 2;
+    std::mt19937 prng(42);
+    std::uniform_int_distribution<int> image_distribution(0, num_images - 1);
+    std::uniform_int_distribution<int> weight_distribution(15, 1000);
+    for (int i = 0; i < num_images; ++i) {
+      for (int j = 1; j <= kNumSequentialNeighbors && i + j < num_images; ++j) {
+        image_pairs.emplace_back(i, i + j);
+        num_inliers.push_back(weight_distribution(prng) / j);
+      }
+      for (int j = 0; j < kNumRandomNeighbors; ++j) {
+        const int other = image_distribution(prng);
+        if (other != i) {
+          image_pairs.emplace_back(i, other);
+          num_inliers.push_back(weight_distribution(prng) / 10);
+        }
+      }
+    }
+  }
+
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<int> num_inliers;
+};
+
+static void BM_ComputeNormalizedMinGraphCut(benchmark::State& state) {
+  const SyntheticSceneGraph scene_graph(state.range(0));
+  const std::vector<std::pair<int, int>> edges(scene_graph.image_pairs.begin(),
+                                               scene_graph.image_pairs.end());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        ComputeNormalizedMinGraphCut(edges, scene_graph.num_inliers, 2));
+  }
+}
+
+BENCHMARK(BM_ComputeNormalizedMinGraphCut)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Arg(1000000)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_SceneClusteringPartition(benchmark::State& state) {
+  const SyntheticSceneGraph scene_graph(state.range(0));
+  SceneClustering::Options options;
+  options.leaf_max_num_images = 500;
+  for (auto _ : state) {
+    SceneClustering scene_clustering(options);
+    scene_clustering.Partition(scene_graph.image_pairs,
+                               scene_graph.num_inliers);
+    benchmark::DoNotOptimize(scene_clustering.GetRootCluster());
+  }
+}
+
+BENCHMARK(BM_SceneClusteringPartition)
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMillisecond);
+
+// Synthetic S-T graph of the size of the cell graph of a large Delaunay
+// triangulation, in which neighboring cells of a regular grid are connected
+// and the cells near the two ends are strongly connected to the source and the
+// sink, respectively, as for the inside and outside of a surface.
+struct SyntheticSTGraph {
+  explicit SyntheticSTGraph(int grid_size)
+      : num_nodes(grid_size * grid_size * grid_size) {
+    std::mt19937 prng(42);
+    std::uniform_real_distribution<float> weight_distribution(0, 1);
+    for (int z = 0; z < grid_size; ++z) {
+      for (int y = 0; y < grid_size; ++y) {
+        for (int x = 0; x < grid_size; ++x) {
+          const int node_idx = (z * grid_size + y) * grid_size + x;
+          source_weights.push_back(weight_distribution(prng) *
+                                   (z < grid_size / 3 ? 5.0f : 0.1f));
+          sink_weights.push_back(weight_distribution(prng) *
+                                 (z > 2 * grid_size / 3 ? 5.0f : 0.1f));
+          const bool has_neighbors[3] = {
+              x + 1 < grid_size, y + 1 < grid_size, z + 1 < grid_size};
+          const int neighbor_offsets[3] = {
+              1, grid_size, grid_size * grid_size};
+          for (int i = 0; i < 3; ++i) {
+            if (has_neighbors[i]) {
+              edges.emplace_back(node_idx, node_idx + neighbor_offsets[i]);
+              edge_weights.emplace_back(weight_distribution(prng),
+                                        weight_distribution(prng));
+            }
+          }
+        }
+      }
+    }
+  }
+
+  int num_nodes;
+  std::vector<float> source_weights;
+  std::vector<float> sink_weights;
+  std::vector<std::pair<int, int>> edges;
+  std::vector<std::pair<float, float>> edge_weights;
+};
+
+static void BM_MinSTGraphCut(benchmark::State& state) {
+  const SyntheticSTGraph st_graph(state.range(0));
+  const MinSTGraphCutAlgorithm algorithm =
+      static_cast<MinSTGraphCutAlgorithm>(state.range(1));
+  const int num_threads = state.range(2);
+  for (auto _ : state) {
+    state.PauseTiming();
+    MinSTGraphCut<int, float> graph_cut(
+        st_graph.num_nodes, algorithm, num_threads);
+    for (int i = 0; i < st_graph.num_nodes; ++i) {
+      graph_cut.AddNode(
+          i, st_graph.source_weights[i], st_graph.sink_weights[i]);
+    }
+    for (size_t i = 0; i < st_graph.edges.size(); ++i) {
+      graph_cut.AddEdge(st_graph.edges[i].first,
+                        st_graph.edges[i].second,
+                        st_graph.edge_weights[i].first,
+                        st_graph.edge_weights[i].second);
+    }
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(graph_cut.Compute());
+  }
+  state.counters["num_nodes"] = st_graph.num_nodes;
+}
+
+const int kBoykovKolmogorov =
+    static_cast<int>(MinSTGraphCutAlgorithm::BOYKOV_KOLMOGOROV);
+const int kParallelPushRelabel =
+    static_cast<int>(MinSTGraphCutAlgorithm::PARALLEL_PUSH_RELABEL);
+
+BENCHMARK(BM_MinSTGraphCut)
+    ->ArgNames({"grid_size", "algorithm", "num_threads"})
+    ->ArgsProduct({{50, 100}, {kBoykovKolmogorov}, {1}})
+    ->ArgsProduct({{50, 100}, {kParallelPushRelabel}, {1, 4, 16}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
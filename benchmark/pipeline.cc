@@ -0,0 +1,336 @@
+#include "colmap/controllers/incremental_mapper.h"
+#include "colmap/scene/database.h"
+#include "colmap/scene/database_cache.h"
+#include "colmap/scene/reconstruction.h"
+#include "colmap/scene/synthetic.h"
+#include "colmap/sfm/incremental_mapper.h"
+#include "colmap/util/timer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+using namespace colmap;
+
+// End-to-end benchmarks of the reconstruction pipeline on synthetic scenes.
+// The synthetic generator observes every 3D point in every image, so the
+// exhaustive matches grow quadratically with the number of images. Larger
+// scenes therefore use chained matches, which grow linearly with the number of
+// observations. Scenes with 10k and more images are only benchmarked if the
+// environment variable COLMAP_BENCHMARK_LARGE_SCENES is set.
+
+const int kNumPoints3D = 200;
+const int kMaxNumImagesExhaustive = 200;
+
+struct SyntheticScene {
+  explicit SyntheticScene(int num_images)
+      : database(Database::kInMemoryDatabasePath) {
+    SyntheticDatasetOptions options;
+    options.num_cameras = std::max(1, num_images / 50);
+    options.num_images = num_images;
+    options.num_points3D = kNumPoints3D;
+    options.point2D_stddev = 0.5;
+    if (num_images > kMaxNumImagesExhaustive) {
+      options.match_config = SyntheticDatasetOptions::MatchConfig::CHAINED;
+      // Chained matches spread the observations of a point over many image
+      // pairs with only few matches each.
+      min_num_matches = 1;
+    }
+    SynthesizeDataset(options, &reconstruction, &database);
+  }
+
+  std::shared_ptr<DatabaseCache> CreateDatabaseCache() const {
+    return DatabaseCache::Create(database,
+                                 min_num_matches,
+                                 /*ignore_watermarks=*/false,
+                                 /*image_names=*/{});
+  }
+
+  // Ground-truth reconstruction with all 3D points removed, i.e., only the
+  // known camera poses remain to be triangulated.
+  std::shared_ptr<Reconstruction> CreateReconstructionWithoutPoints() const {
+    auto known_poses = std::make_shared<Reconstruction>(reconstruction);
+    for (const point3D_t point3D_id : known_poses->Point3DIds()) {
+      known_poses->DeletePoint3D(point3D_id);
+    }
+    return known_poses;
+  }
+
+  Database database;
+  Reconstruction reconstruction;
+  size_t min_num_matches = 15;
+};
+
+// Synthesizing the larger scenes takes much longer than most of the
+// benchmarked steps, so they are shared by all benchmarks of a run.
+const SyntheticScene& GetSyntheticScene(int num_images) {
+  static std::map<int, std::unique_ptr<SyntheticScene>> scenes;
+  std::unique_ptr<SyntheticScene>& scene = scenes[num_images];
+  if (!scene) {
+    scene = std::make_unique<SyntheticScene>(num_images);
+  }
+  return *scene;
+}
+
+void SceneScales(benchmark::internal::Benchmark* benchmark) {
+  benchmark->Arg(100)->Arg(1000);
+  if (std::getenv("COLMAP_BENCHMARK_LARGE_SCENES") != nullptr) {
+    benchmark->Arg(10000)->Arg(100000);
+  }
+  benchmark->Unit(benchmark::kMillisecond);
+}
+
+// Mapper on the known poses of the synthetic scene, which is advanced to the
+// given stage outside of the timed region of the benchmarks.
+struct KnownPosesMapper {
+  enum class Stage { BEGIN, TRIANGULATED, MERGED, ADJUSTED };
+
+  KnownPosesMapper(const SyntheticScene& scene, Stage stage)
+      : mapper(scene.CreateDatabaseCache()) {
+    mapper.BeginReconstruction(scene.CreateReconstructionWithoutPoints());
+    if (stage >= Stage::TRIANGULATED) {
+      TriangulateImages();
+    }
+    if (stage >= Stage::MERGED) {
+      mapper.CompleteAndMergeTracks(options.Triangulation());
+    }
+    if (stage >= Stage::ADJUSTED) {
+      mapper.AdjustGlobalBundle(options.Mapper(),
+                                options.GlobalBundleAdjustment());
+    }
+  }
+
+  ~KnownPosesMapper() { mapper.EndReconstruction(/*discard=*/false); }
+
+  void TriangulateImages() {
+    for (const image_t image_id : mapper.Reconstruction()->RegImageIds()) {
+      mapper.TriangulateImage(options.Triangulation(), image_id);
+    }
+  }
+
+  IncrementalMapperOptions options;
+  IncrementalMapper mapper;
+};
+
+static void BM_DatabaseCacheCreate(benchmark::State& state) {
+  const SyntheticScene& scene = GetSyntheticScene(state.range(0));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(scene.CreateDatabaseCache());
+  }
+}
+
+BENCHMARK(BM_DatabaseCacheCreate)->Apply(SceneScales);
+
+static void BM_TriangulateImages(benchmark::State& state) {
+  const SyntheticScene& scene = GetSyntheticScene(state.range(0));
+  std::unique_ptr<KnownPosesMapper> known_poses;
+  for (auto _ : state) {
+    state.PauseTiming();
+    // Destroy the mapper of the previous iteration outside of the timing.
+    known_poses.reset();
+    known_poses = std::make_unique<KnownPosesMapper>(
+        scene, KnownPosesMapper::Stage::BEGIN);
+    state.ResumeTiming();
+    known_poses->TriangulateImages();
+  }
+  state.counters["num_points3D"] =
+      known_poses->mapper.Reconstruction()->NumPoints3D();
+}
+
+BENCHMARK(BM_TriangulateImages)->Apply(SceneScales);
+
+static void BM_CompleteAndMergeTracks(benchmark::State& state) {
+  const SyntheticScene& scene = GetSyntheticScene(state.range(0));
+  std::unique_ptr<KnownPosesMapper> known_poses;
+  for (auto _ : state) {
+    state.PauseTiming();
+    known_poses.reset();
+    known_poses = std::make_unique<KnownPosesMapper>(
+        scene, KnownPosesMapper::Stage::TRIANGULATED);
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(known_poses->mapper.CompleteAndMergeTracks(
+        known_poses->options.Triangulation()));
+  }
+}
+
+BENCHMARK(BM_CompleteAndMergeTracks)->Apply(SceneScales);
+
+static void BM_Retriangulate(benchmark::State& state) {
+  const SyntheticScene& scene = GetSyntheticScene(state.range(0));
+  std::unique_ptr<KnownPosesMapper> known_poses;
+  for (auto _ : state) {
+    state.PauseTiming();
+    known_poses.reset();
+    known_poses = std::make_unique<KnownPosesMapper>(
+        scene, KnownPosesMapper::Stage::MERGED);
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(known_poses->mapper.Retriangulate(
+        known_poses->options.Triangulation()));
+  }
+}
+
+BENCHMARK(BM_Retriangulate)->Apply(SceneScales);
+
+static void BM_AdjustGlobalBundle(benchmark::State& state) {
+  const SyntheticScene& scene = GetSyntheticScene(state.range(0));
+  std::unique_ptr<KnownPosesMapper> known_poses;
+  for (auto _ : state) {
+    state.PauseTiming();
+    known_poses.reset();
+    known_poses = std::make_unique<KnownPosesMapper>(
+        scene, KnownPosesMapper::Stage::MERGED);
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(known_poses->mapper.AdjustGlobalBundle(
+        known_poses->options.Mapper(),
+        known_poses->options.GlobalBundleAdjustment()));
+  }
+}
+
+BENCHMARK(BM_AdjustGlobalBundle)->Apply(SceneScales);
+
+static void BM_FilterPointsAndImages(benchmark::State& state) {
+  const SyntheticScene& scene = GetSyntheticScene(state.range(0));
+  std::unique_ptr<KnownPosesMapper> known_poses;
+  for (auto _ : state) {
+    state.PauseTiming();
+    known_poses.reset();
+    known_poses = std::make_unique<KnownPosesMapper>(
+        scene, KnownPosesMapper::Stage::ADJUSTED);
+    const IncrementalMapper::Options mapper_options =
+        known_poses->options.Mapper();
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(known_poses->mapper.FilterPoints(mapper_options));
+    benchmark::DoNotOptimize(known_poses->mapper.FilterImages(mapper_options));
+  }
+}
+
+BENCHMARK(BM_FilterPointsAndImages)->Apply(SceneScales);
+
+// Full incremental reconstruction from scratch, following the steps of the
+// incremental mapper controller. The time spent in every phase is reported as
+// a separate counter in seconds. Only scenes with exhaustive matches are used,
+// since the chained matches are too sparse to initialize a reconstruction.
+static void BM_IncrementalMapping(benchmark::State& state) {
+  const SyntheticScene& scene = GetSyntheticScene(state.range(0));
+  const IncrementalMapperOptions options;
+  const IncrementalMapper::Options mapper_options = options.Mapper();
+
+  std::map<std::string, Timer> timers;
+  for (auto _ : state) {
+    timers.clear();
+    Timer& cache_timer = timers["database_cache"];
+    cache_timer.Start();
+    IncrementalMapper mapper(scene.CreateDatabaseCache());
+    cache_timer.Pause();
+
+    auto reconstruction = std::make_shared<Reconstruction>();
+    mapper.BeginReconstruction(reconstruction);
+
+    Timer& init_timer = timers["initialization"];
+    init_timer.Start();
+    TwoViewGeometry two_view_geometry;
+    image_t image_id1 = kInvalidImageId;
+    image_t image_id2 = kInvalidImageId;
+    if (!mapper.FindInitialImagePair(
+            mapper_options, two_view_geometry, image_id1, image_id2)) {
+      state.SkipWithError("Failed to find initial image pair");
+      break;
+    }
+    mapper.RegisterInitialImagePair(
+        mapper_options, two_view_geometry, image_id1, image_id2);
+    init_timer.Pause();
+
+    // The remaining phases are interleaved, so their timers are started in
+    // paused state and only resumed around the respective steps.
+    const auto paused_timer = [&timers](const std::string& name) -> Timer& {
+      Timer& timer = timers[name];
+      timer.Start();
+      timer.Pause();
+      return timer;
+    };
+    Timer& registration_timer = paused_timer("registration");
+    Timer& triangulation_timer = paused_timer("triangulation");
+    Timer& local_ba_timer = paused_timer("local_bundle_adjustment");
+    Timer& global_ba_timer = paused_timer("global_bundle_adjustment");
+    Timer& filter_timer = paused_timer("filtering");
+
+    const auto global_refinement = [&]() {
+      global_ba_timer.Resume();
+      mapper.IterativeGlobalRefinement(options.ba_global_max_refinements,
+                                       options.ba_global_max_refinement_change,
+                                       mapper_options,
+                                       options.GlobalBundleAdjustment(),
+                                       options.Triangulation());
+      global_ba_timer.Pause();
+      filter_timer.Resume();
+      mapper.FilterImages(mapper_options);
+      filter_timer.Pause();
+    };
+
+    global_refinement();
+
+    size_t ba_prev_num_reg_images = reconstruction->NumRegImages();
+    size_t ba_prev_num_points = reconstruction->NumPoints3D();
+    while (true) {
+      registration_timer.Resume();
+      image_t next_image_id = kInvalidImageId;
+      for (const image_t image_id : mapper.FindNextImages(mapper_options)) {
+        if (mapper.RegisterNextImage(mapper_options, image_id)) {
+          next_image_id = image_id;
+          break;
+        }
+      }
+      registration_timer.Pause();
+      if (next_image_id == kInvalidImageId) {
+        break;
+      }
+
+      triangulation_timer.Resume();
+      mapper.TriangulateImage(options.Triangulation(), next_image_id);
+      triangulation_timer.Pause();
+
+      local_ba_timer.Resume();
+      mapper.IterativeLocalRefinement(options.ba_local_max_refinements,
+                                      options.ba_local_max_refinement_change,
+                                      mapper_options,
+                                      options.LocalBundleAdjustment(),
+                                      options.Triangulation(),
+                                      next_image_id);
+      local_ba_timer.Pause();
+
+      if (reconstruction->NumRegImages() >=
+              options.ba_global_images_ratio * ba_prev_num_reg_images ||
+          reconstruction->NumPoints3D() >=
+              options.ba_global_points_ratio * ba_prev_num_points) {
+        global_refinement();
+        ba_prev_num_reg_images = reconstruction->NumRegImages();
+        ba_prev_num_points = reconstruction->NumPoints3D();
+      }
+    }
+
+    if (reconstruction->NumRegImages() > ba_prev_num_reg_images) {
+      global_refinement();
+    }
+
+    state.counters["num_reg_images"] = reconstruction->NumRegImages();
+    state.counters["num_points3D"] = reconstruction->NumPoints3D();
+    mapper.EndReconstruction(/*discard=*/false);
+  }
+
+  for (const auto& timer : timers) {
+    state.counters[timer.first + "_sec"] = timer.second.ElapsedSeconds();
+  }
+}
+
+BENCHMARK(BM_IncrementalMapping)
+    ->Arg(50)
+    ->Arg(100)
+    ->Arg(kMaxNumImagesExhaustive)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
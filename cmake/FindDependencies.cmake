@@ -82,6 +82,13 @@ if(CGAL_FOUND)
             CGAL INTERFACE ${CGAL_LIBRARY} ${GMP_LIBRARIES})
     endif()
     list(APPEND COLMAP_LINK_DIRS ${CGAL_LIBRARIES_DIR})
+    # Parallel Delaunay triangulation requires CGAL to be linked with TBB.
+    include(CGAL_TBB_support OPTIONAL)
+    if(TARGET CGAL::TBB_support)
+        message(STATUS "Enabling parallel CGAL triangulation")
+    else()
+        message(STATUS "Disabling parallel CGAL triangulation")
+    endif()
 endif()
 
 set(COLMAP_LINK_DIRS ${Boost_LIBRARY_DIRS})
@@ -197,6 +204,16 @@ else()
     message(STATUS "Disabling OpenGL support")
 endif()
 
+# Headless OpenGL contexts require a build of GLEW with EGL support, since
+# SiftGPU initializes GLEW in the current context.
+if(OPENGL_ENABLED AND EGL_ENABLED AND TARGET OpenGL::EGL)
+    add_definitions("-DCOLMAP_EGL_ENABLED")
+    message(STATUS "Enabling headless OpenGL contexts with EGL")
+else()
+    set(EGL_ENABLED OFF)
+    message(STATUS "Disabling EGL support")
+endif()
+
 set(GPU_ENABLED OFF)
 if(OPENGL_ENABLED OR CUDA_ENABLED)
     add_definitions("-DCOLMAP_GPU_ENABLED")
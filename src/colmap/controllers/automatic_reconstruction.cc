@@ -40,17 +40,20 @@
 #include "colmap/util/logging.h"
 #include "colmap/util/misc.h"
 
+#include <chrono>
+#include <thread>
+
 namespace colmap {
 
 AutomaticReconstructionController::AutomaticReconstructionController(
     const Options& options,
     std::shared_ptr<ReconstructionManager> reconstruction_manager)
     : options_(options),
-      reconstruction_manager_(std::move(reconstruction_manager)),
-      active_thread_(nullptr) {
+      reconstruction_manager_(std::move(reconstruction_manager)) {
   THROW_CHECK_DIR_EXISTS(options_.workspace_path);
   THROW_CHECK_DIR_EXISTS(options_.image_path);
   THROW_CHECK_NOTNULL(reconstruction_manager_);
+  THROW_CHECK_GT(options_.overlap_num_images, 0);
 
   option_manager_.AddAllOptions();
 
@@ -103,6 +106,7 @@ AutomaticReconstructionController::AutomaticReconstructionController(
 
   option_manager_.sift_extraction->gpu_index = options_.gpu_index;
   option_manager_.sift_matching->gpu_index = options_.gpu_index;
+  option_manager_.patch_match_stereo->use_gpu = options_.use_gpu;
   option_manager_.patch_match_stereo->gpu_index = options_.gpu_index;
 
   feature_extractor_ = CreateFeatureExtractorController(
@@ -120,6 +124,14 @@ AutomaticReconstructionController::AutomaticReconstructionController(
         options_.vocab_tree_path;
   }
 
+  if (options_.overlap_stages && options_.data_type == DataType::VIDEO) {
+    // Each matching round only matches the newly extracted images and adds
+    // them to the persistent index of loop detection.
+    option_manager_.sequential_matching->online = true;
+    option_manager_.sequential_matching->loop_detection_index_path =
+        JoinPaths(options_.workspace_path, "loop_detection_index.bin");
+  }
+
   sequential_matcher_ =
       CreateSequentialFeatureMatcher(*option_manager_.sequential_matching,
                                      *option_manager_.sift_matching,
@@ -138,18 +150,37 @@ AutomaticReconstructionController::AutomaticReconstructionController(
 }
 
 void AutomaticReconstructionController::Stop() {
-  if (active_thread_ != nullptr) {
-    active_thread_->Stop();
+  {
+    std::lock_guard<std::mutex> lock(active_threads_mutex_);
+    for (Thread* thread : active_threads_) {
+      thread->Stop();
+    }
   }
   Thread::Stop();
 }
 
+void AutomaticReconstructionController::StartActiveThread(Thread* thread) {
+  std::lock_guard<std::mutex> lock(active_threads_mutex_);
+  active_threads_.insert(thread);
+  thread->Start();
+}
+
+void AutomaticReconstructionController::WaitActiveThread(Thread* thread) {
+  thread->Wait();
+  std::lock_guard<std::mutex> lock(active_threads_mutex_);
+  active_threads_.erase(thread);
+}
+
 void AutomaticReconstructionController::Run() {
   if (IsStopped()) {
     return;
   }
 
-  RunFeatureExtraction();
+  if (options_.overlap_stages && options_.data_type == DataType::VIDEO) {
+    RunFeatureExtractionAndMatching();
+  } else {
+    RunFeatureExtraction();
+  }
 
   if (IsStopped()) {
     return;
@@ -161,6 +192,11 @@ void AutomaticReconstructionController::Run() {
     return;
   }
 
+  if (options_.sparse && options_.dense && options_.overlap_stages) {
+    RunSparseAndDenseMapper();
+    return;
+  }
+
   if (options_.sparse) {
     RunSparseMapper();
   }
@@ -176,11 +212,46 @@ void AutomaticReconstructionController::Run() {
 
 void AutomaticReconstructionController::RunFeatureExtraction() {
   THROW_CHECK_NOTNULL(feature_extractor_);
-  active_thread_ = feature_extractor_.get();
-  feature_extractor_->Start();
-  feature_extractor_->Wait();
+  StartActiveThread(feature_extractor_.get());
+  WaitActiveThread(feature_extractor_.get());
+  feature_extractor_.reset();
+}
+
+void AutomaticReconstructionController::RunFeatureExtractionAndMatching() {
+  THROW_CHECK_NOTNULL(feature_extractor_);
+  StartActiveThread(feature_extractor_.get());
+
+  // The extractor writes the images together with their features, so all
+  // images in the database can be matched. The online sequential matching
+  // only matches the newly extracted images of each round against their
+  // preceding images and loop candidates. The final matching after the
+  // extraction matches the remaining images.
+  const SequentialMatchingOptions& sequential_matching =
+      *option_manager_.sequential_matching;
+
+  Database database(*option_manager_.database_path);
+  size_t num_matched_images = 0;
+  while (!feature_extractor_->IsFinished() && !IsStopped()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    const size_t num_images = database.NumImages();
+    if (num_images <
+        num_matched_images + static_cast<size_t>(options_.overlap_num_images)) {
+      continue;
+    }
+
+    LOG(INFO) << "Matching " << num_images << " extracted images";
+    std::unique_ptr<Thread> matcher =
+        CreateSequentialFeatureMatcher(sequential_matching,
+                                       *option_manager_.sift_matching,
+                                       *option_manager_.two_view_geometry,
+                                       *option_manager_.database_path);
+    StartActiveThread(matcher.get());
+    WaitActiveThread(matcher.get());
+    num_matched_images = num_images;
+  }
+
+  WaitActiveThread(feature_extractor_.get());
   feature_extractor_.reset();
-  active_thread_ = nullptr;
 }
 
 void AutomaticReconstructionController::RunFeatureMatching() {
@@ -199,16 +270,15 @@ void AutomaticReconstructionController::RunFeatureMatching() {
   }
 
   THROW_CHECK_NOTNULL(matcher);
-  active_thread_ = matcher;
-  matcher->Start();
-  matcher->Wait();
+  StartActiveThread(matcher);
+  WaitActiveThread(matcher);
   exhaustive_matcher_.reset();
   sequential_matcher_.reset();
   vocab_tree_matcher_.reset();
-  active_thread_ = nullptr;
 }
 
-void AutomaticReconstructionController::RunSparseMapper() {
+void AutomaticReconstructionController::RunSparseMapper(
+    const std::function<void()>& finished_reconstruction_callback) {
   const auto sparse_path = JoinPaths(options_.workspace_path, "sparse");
   if (ExistsDir(sparse_path)) {
     auto dir_list = GetDirList(sparse_path);
@@ -228,6 +298,10 @@ void AutomaticReconstructionController::RunSparseMapper() {
                                      *option_manager_.database_path,
                                      reconstruction_manager_);
   mapper.SetCheckIfStoppedFunc([&]() { return IsStopped(); });
+  if (finished_reconstruction_callback) {
+    mapper.AddCallback(IncrementalMapperController::LAST_IMAGE_REG_CALLBACK,
+                       finished_reconstruction_callback);
+  }
   mapper.Run();
 
   CreateDirIfNotExists(sparse_path);
@@ -242,107 +316,146 @@ void AutomaticReconstructionController::RunDenseMapper() {
     if (IsStopped()) {
       return;
     }
+    RunDenseMapper(i, *reconstruction_manager_->Get(i));
+  }
+}
 
-    const std::string dense_path =
-        JoinPaths(options_.workspace_path, "dense", std::to_string(i));
-    const std::string fused_path = JoinPaths(dense_path, "fused.ply");
+void AutomaticReconstructionController::RunDenseMapper(
+    const size_t reconstruction_idx, const Reconstruction& reconstruction) {
+  const std::string dense_path = JoinPaths(
+      options_.workspace_path, "dense", std::to_string(reconstruction_idx));
+  const std::string fused_path = JoinPaths(dense_path, "fused.ply");
+
+  std::string meshing_path;
+  if (options_.mesher == Mesher::POISSON) {
+    meshing_path = JoinPaths(dense_path, "meshed-poisson.ply");
+  } else if (options_.mesher == Mesher::DELAUNAY) {
+    meshing_path = JoinPaths(dense_path, "meshed-delaunay.ply");
+  }
 
-    std::string meshing_path;
-    if (options_.mesher == Mesher::POISSON) {
-      meshing_path = JoinPaths(dense_path, "meshed-poisson.ply");
-    } else if (options_.mesher == Mesher::DELAUNAY) {
-      meshing_path = JoinPaths(dense_path, "meshed-delaunay.ply");
-    }
+  if (ExistsFile(fused_path) && ExistsFile(meshing_path)) {
+    return;
+  }
 
-    if (ExistsFile(fused_path) && ExistsFile(meshing_path)) {
-      continue;
-    }
+  // Image undistortion.
 
-    // Image undistortion.
+  if (!ExistsDir(dense_path)) {
+    CreateDirIfNotExists(dense_path);
 
-    if (!ExistsDir(dense_path)) {
-      CreateDirIfNotExists(dense_path);
+    UndistortCameraOptions undistortion_options;
+    undistortion_options.max_image_size =
+        option_manager_.patch_match_stereo->max_image_size;
+#if defined(COLMAP_CUDA_ENABLED)
+    undistortion_options.use_gpu = options_.use_gpu;
+    undistortion_options.gpu_index = CSVToVector<int>(options_.gpu_index).at(0);
+#endif
+    COLMAPUndistorter undistorter(undistortion_options,
+                                  reconstruction,
+                                  *option_manager_.image_path,
+                                  dense_path);
+    undistorter.SetCheckIfStoppedFunc([&]() { return IsStopped(); });
+    undistorter.Run();
+  }
 
-      UndistortCameraOptions undistortion_options;
-      undistortion_options.max_image_size =
-          option_manager_.patch_match_stereo->max_image_size;
-      COLMAPUndistorter undistorter(undistortion_options,
-                                    *reconstruction_manager_->Get(i),
-                                    *option_manager_.image_path,
-                                    dense_path);
-      undistorter.SetCheckIfStoppedFunc([&]() { return IsStopped(); });
-      undistorter.Run();
-    }
+  if (IsStopped()) {
+    return;
+  }
 
-    if (IsStopped()) {
-      return;
-    }
+  // Patch match stereo.
 
-    // Patch match stereo.
+  {
+    mvs::PatchMatchController patch_match_controller(
+        *option_manager_.patch_match_stereo, dense_path, "COLMAP", "");
+    patch_match_controller.SetCheckIfStoppedFunc([&]() { return IsStopped(); });
+    patch_match_controller.Run();
+  }
 
-#if defined(COLMAP_CUDA_ENABLED)
-    {
-      mvs::PatchMatchController patch_match_controller(
-          *option_manager_.patch_match_stereo, dense_path, "COLMAP", "");
-      patch_match_controller.SetCheckIfStoppedFunc(
-          [&]() { return IsStopped(); });
-      patch_match_controller.Run();
-    }
-#else   // COLMAP_CUDA_ENABLED
-    LOG(WARNING) << "Skipping patch match stereo because CUDA is not available";
+  if (IsStopped()) {
     return;
-#endif  // COLMAP_CUDA_ENABLED
-
-    if (IsStopped()) {
-      return;
-    }
+  }
 
-    // Stereo fusion.
-
-    if (!ExistsFile(fused_path)) {
-      auto fusion_options = *option_manager_.stereo_fusion;
-      const int num_reg_images =
-          reconstruction_manager_->Get(i)->NumRegImages();
-      fusion_options.min_num_pixels =
-          std::min(num_reg_images + 1, fusion_options.min_num_pixels);
-      mvs::StereoFusion fuser(
-          fusion_options,
-          dense_path,
-          "COLMAP",
-          "",
-          options_.quality == Quality::HIGH ? "geometric" : "photometric");
-      fuser.SetCheckIfStoppedFunc([&]() { return IsStopped(); });
-      fuser.Run();
-
-      LOG(INFO) << "Writing output: " << fused_path;
-      WriteBinaryPlyPoints(fused_path, fuser.GetFusedPoints());
-      mvs::WritePointsVisibility(fused_path + ".vis",
-                                 fuser.GetFusedPointsVisibility());
-    }
+  // Stereo fusion.
+
+  if (!ExistsFile(fused_path)) {
+    auto fusion_options = *option_manager_.stereo_fusion;
+    const int num_reg_images = reconstruction.NumRegImages();
+    fusion_options.min_num_pixels =
+        std::min(num_reg_images + 1, fusion_options.min_num_pixels);
+    mvs::StereoFusion fuser(
+        fusion_options,
+        dense_path,
+        "COLMAP",
+        "",
+        options_.quality == Quality::HIGH ? "geometric" : "photometric");
+    fuser.SetCheckIfStoppedFunc([&]() { return IsStopped(); });
+    fuser.Run();
+
+    LOG(INFO) << "Writing output: " << fused_path;
+    fuser.WriteFusedPoints(fused_path);
+  }
 
-    if (IsStopped()) {
-      return;
-    }
+  if (IsStopped()) {
+    return;
+  }
 
-    // Surface meshing.
+  // Surface meshing.
 
-    if (!ExistsFile(meshing_path)) {
-      if (options_.mesher == Mesher::POISSON) {
-        mvs::PoissonMeshing(
-            *option_manager_.poisson_meshing, fused_path, meshing_path);
-      } else if (options_.mesher == Mesher::DELAUNAY) {
+  if (!ExistsFile(meshing_path)) {
+    if (options_.mesher == Mesher::POISSON) {
+      mvs::PoissonMeshing(
+          *option_manager_.poisson_meshing, fused_path, meshing_path);
+    } else if (options_.mesher == Mesher::DELAUNAY) {
 #if defined(COLMAP_CGAL_ENABLED)
-        mvs::DenseDelaunayMeshing(
-            *option_manager_.delaunay_meshing, dense_path, meshing_path);
+      mvs::DenseDelaunayMeshing(
+          *option_manager_.delaunay_meshing, dense_path, meshing_path);
 #else  // COLMAP_CGAL_ENABLED
-        LOG(WARNING)
-            << "Skipping Delaunay meshing because CGAL is not available";
-        return;
-
+      LOG(WARNING) << "Skipping Delaunay meshing because CGAL is not available";
 #endif  // COLMAP_CGAL_ENABLED
-      }
     }
   }
 }
 
+void AutomaticReconstructionController::RunSparseAndDenseMapper() {
+  CreateDirIfNotExists(JoinPaths(options_.workspace_path, "dense"));
+
+  // The finished sparse models are densely reconstructed in a separate thread,
+  // while the mapper continues with the remaining models. The dense thread
+  // works on copies of the models, since the mapper concurrently modifies the
+  // reconstruction manager.
+  JobQueue<std::pair<size_t, std::shared_ptr<const Reconstruction>>>
+      dense_queue;
+  std::thread dense_thread([this, &dense_queue]() {
+    while (true) {
+      auto job = dense_queue.Pop();
+      if (!job.IsValid()) {
+        break;
+      }
+      if (!IsStopped()) {
+        RunDenseMapper(job.Data().first, *job.Data().second);
+      }
+    }
+  });
+
+  // All models in the manager are finished, when the mapper finishes a model.
+  // Their indices do not change afterwards, since the mapper only discards
+  // the model that it reconstructed last.
+  size_t num_finished_reconstructions = 0;
+  const auto push_finished_reconstructions = [&]() {
+    for (; num_finished_reconstructions < reconstruction_manager_->Size();
+         ++num_finished_reconstructions) {
+      dense_queue.Push(std::make_pair(
+          num_finished_reconstructions,
+          std::make_shared<const Reconstruction>(
+              *reconstruction_manager_->Get(num_finished_reconstructions))));
+    }
+  };
+
+  RunSparseMapper(push_finished_reconstructions);
+  // Models read from an existing sparse reconstruction are only pushed here.
+  push_finished_reconstructions();
+
+  dense_queue.Wait();
+  dense_thread.join();
+}
+
 }  // namespace colmap
@@ -33,8 +33,11 @@
 #include "colmap/scene/reconstruction_manager.h"
 #include "colmap/util/threading.h"
 
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_set>
 
 namespace colmap {
 
@@ -89,6 +92,18 @@ class AutomaticReconstructionController : public Thread {
     // The meshing algorithm to be used.
     Mesher mesher = Mesher::POISSON;
 
+    // Whether to overlap the execution of subsequent stages. For video data,
+    // the extracted images are sequentially matched in rounds while the
+    // remaining images are extracted, where each round only matches the newly
+    // extracted images, see `SequentialMatchingOptions::online`. The dense
+    // reconstruction of finished sparse models starts while the other models
+    // are still mapped.
+    bool overlap_stages = false;
+
+    // Number of newly extracted images that start the next round of
+    // sequential matching, if the stages are overlapped.
+    int overlap_num_images = 50;
+
     // The number of threads to use in all stages.
     int num_threads = -1;
 
@@ -110,14 +125,24 @@ class AutomaticReconstructionController : public Thread {
  private:
   void Run() override;
   void RunFeatureExtraction();
+  void RunFeatureExtractionAndMatching();
   void RunFeatureMatching();
-  void RunSparseMapper();
+  void RunSparseMapper(
+      const std::function<void()>& finished_reconstruction_callback = {});
   void RunDenseMapper();
+  void RunDenseMapper(size_t reconstruction_idx,
+                      const Reconstruction& reconstruction);
+  void RunSparseAndDenseMapper();
+
+  // Start and wait for a sub-thread, which is stopped with this controller.
+  void StartActiveThread(Thread* thread);
+  void WaitActiveThread(Thread* thread);
 
   const Options options_;
   OptionManager option_manager_;
   std::shared_ptr<ReconstructionManager> reconstruction_manager_;
-  Thread* active_thread_;
+  std::mutex active_threads_mutex_;
+  std::unordered_set<Thread*> active_threads_;
   std::unique_ptr<Thread> feature_extractor_;
   std::unique_ptr<Thread> exhaustive_matcher_;
   std::unique_ptr<Thread> sequential_matcher_;
@@ -29,7 +29,9 @@
 
 #include "colmap/controllers/feature_extraction.h"
 
+#include "colmap/feature/extractor.h"
 #include "colmap/feature/sift.h"
+#include "colmap/feature/utils.h"
 #include "colmap/geometry/gps.h"
 #include "colmap/scene/database.h"
 #include "colmap/util/cuda.h"
@@ -37,7 +39,10 @@
 #include "colmap/util/opengl_utils.h"
 #include "colmap/util/timer.h"
 
+#include <deque>
+#include <future>
 #include <numeric>
+#include <thread>
 
 namespace colmap {
 namespace {
@@ -83,6 +88,19 @@ void MaskKeypoints(const Bitmap& mask,
   descriptors->conservativeResize(out_index, descriptors->cols());
 }
 
+ImageReaderOptions ExtractionImageReaderOptions(
+    const ImageReaderOptions& reader_options,
+    const SiftExtractionOptions& sift_options) {
+  ImageReaderOptions extraction_reader_options = reader_options;
+  // Images larger than the maximum image size are downscaled before
+  // extraction, so it suffices to decode them at a reduced resolution.
+  if (extraction_reader_options.min_decode_size <= 0 &&
+      !sift_options.tiled_extraction) {
+    extraction_reader_options.min_decode_size = sift_options.max_image_size;
+  }
+  return extraction_reader_options;
+}
+
 struct ImageData {
   ImageReader::Status status = ImageReader::Status::FAILURE;
 
@@ -94,6 +112,10 @@ struct ImageData {
 
   FeatureKeypoints keypoints;
   FeatureDescriptors descriptors;
+
+  // Hash of the file content, if it should be stored with the features.
+  bool has_content_hash = false;
+  uint64_t content_hash = 0;
 };
 
 class ImageResizerThread : public Thread {
@@ -183,45 +205,125 @@ class SiftFeatureExtractorThread : public Thread {
 
     SignalValidSetup();
 
-    while (true) {
+    // On the GPU, the images are extracted in batches to amortize the setup
+    // and transfer cost per image. A batch is filled with the next images
+    // from the queue, or with the remaining images once the queue is stopped.
+    const size_t batch_size =
+        sift_options_.use_gpu ? sift_options_.gpu_batch_size : 1;
+
+    std::vector<ImageData> batch;
+    batch.reserve(batch_size);
+    bool input_stopped = false;
+    while (!input_stopped) {
       if (IsStopped()) {
         break;
       }
 
-      auto input_job = input_queue_->Pop();
-      if (input_job.IsValid()) {
-        auto& image_data = input_job.Data();
-
-        if (image_data.status == ImageReader::Status::SUCCESS) {
-          if (extractor->Extract(image_data.bitmap,
-                                 &image_data.keypoints,
-                                 &image_data.descriptors)) {
-            ScaleKeypoints(
-                image_data.bitmap, image_data.camera, &image_data.keypoints);
-            if (camera_mask_) {
-              MaskKeypoints(*camera_mask_,
-                            &image_data.keypoints,
-                            &image_data.descriptors);
-            }
-            if (image_data.mask.Data()) {
-              MaskKeypoints(image_data.mask,
-                            &image_data.keypoints,
-                            &image_data.descriptors);
-            }
-          } else {
-            image_data.status = ImageReader::Status::FAILURE;
-          }
+      batch.clear();
+      while (batch.size() < batch_size) {
+        auto input_job = input_queue_->Pop();
+        if (!input_job.IsValid()) {
+          input_stopped = true;
+          break;
         }
+        batch.push_back(std::move(input_job.Data()));
+      }
 
-        image_data.bitmap.Deallocate();
+      ExtractBatch(extractor.get(), &batch);
 
+      for (auto& image_data : batch) {
+        image_data.bitmap.Deallocate();
         output_queue_->Push(std::move(image_data));
-      } else {
-        break;
       }
     }
   }
 
+  // Extract the features of all successfully read images in the batch, where
+  // images with the same dimensions are passed to the extractor together.
+  void ExtractBatch(FeatureExtractor* extractor,
+                    std::vector<ImageData>* batch) {
+    std::vector<bool> is_extracted(batch->size(), false);
+    for (size_t i = 0; i < batch->size(); ++i) {
+      const Bitmap& ref_bitmap = (*batch)[i].bitmap;
+      if (is_extracted[i] ||
+          (*batch)[i].status != ImageReader::Status::SUCCESS) {
+        continue;
+      }
+
+      if (sift_options_.tiled_extraction &&
+          std::max(ref_bitmap.Width(), ref_bitmap.Height()) >
+              sift_options_.max_image_size) {
+        ImageData& image_data = (*batch)[i];
+        is_extracted[i] = true;
+        if (ExtractFeaturesInTiles(extractor,
+                                   image_data.bitmap,
+                                   sift_options_.max_image_size,
+                                   sift_options_.tile_overlap,
+                                   &image_data.keypoints,
+                                   &image_data.descriptors)) {
+          PostProcessFeatures(&image_data);
+        } else {
+          image_data.status = ImageReader::Status::FAILURE;
+        }
+        continue;
+      }
+
+      std::vector<size_t> indices;
+      std::vector<const Bitmap*> bitmaps;
+      for (size_t j = i; j < batch->size(); ++j) {
+        const ImageData& image_data = (*batch)[j];
+        if (!is_extracted[j] &&
+            image_data.status == ImageReader::Status::SUCCESS &&
+            image_data.bitmap.Width() == ref_bitmap.Width() &&
+            image_data.bitmap.Height() == ref_bitmap.Height()) {
+          is_extracted[j] = true;
+          indices.push_back(j);
+          bitmaps.push_back(&image_data.bitmap);
+        }
+      }
+
+      std::vector<FeatureKeypoints> keypoints;
+      std::vector<FeatureDescriptors> descriptors;
+      const bool success =
+          extractor->ExtractBatch(bitmaps, &keypoints, &descriptors);
+
+      for (size_t k = 0; k < indices.size(); ++k) {
+        ImageData& image_data = (*batch)[indices[k]];
+        if (!success) {
+          image_data.status = ImageReader::Status::FAILURE;
+          continue;
+        }
+
+        image_data.keypoints = std::move(keypoints[k]);
+        image_data.descriptors = std::move(descriptors[k]);
+        PostProcessFeatures(&image_data);
+      }
+    }
+  }
+
+  // Map the extracted features to the camera, remove masked features, and
+  // optionally select a spatially uniform subset.
+  void PostProcessFeatures(ImageData* image_data) {
+    ScaleKeypoints(
+        image_data->bitmap, image_data->camera, &image_data->keypoints);
+    if (camera_mask_) {
+      MaskKeypoints(
+          *camera_mask_, &image_data->keypoints, &image_data->descriptors);
+    }
+    if (image_data->mask.Data()) {
+      MaskKeypoints(
+          image_data->mask, &image_data->keypoints, &image_data->descriptors);
+    }
+    if (sift_options_.max_num_uniform_features > 0) {
+      ExtractSpatiallyUniformFeatures(
+          &image_data->keypoints,
+          &image_data->descriptors,
+          sift_options_.max_num_uniform_features,
+          static_cast<int>(image_data->camera.width),
+          static_cast<int>(image_data->camera.height));
+    }
+  }
+
   const SiftExtractionOptions sift_options_;
   std::shared_ptr<Bitmap> camera_mask_;
 
@@ -320,6 +422,11 @@ class FeatureWriterThread : public Thread {
           database_->WriteDescriptors(image_data.image.ImageId(),
                                       image_data.descriptors);
         }
+
+        if (image_data.has_content_hash) {
+          database_->WriteImageContentHash(image_data.image.ImageId(),
+                                           image_data.content_hash);
+        }
       } else {
         break;
       }
@@ -336,7 +443,8 @@ class FeatureExtractorController : public Thread {
  public:
   FeatureExtractorController(const ImageReaderOptions& reader_options,
                              const SiftExtractionOptions& sift_options)
-      : reader_options_(reader_options),
+      : reader_options_(
+            ExtractionImageReaderOptions(reader_options, sift_options)),
         sift_options_(sift_options),
         database_(reader_options_.database_path),
         image_reader_(reader_options_, &database_) {
@@ -361,12 +469,17 @@ class FeatureExtractorController : public Thread {
     // Make sure that we only have limited number of objects in the queue to
     // avoid excess in memory usage since images and features take lots of
     // memory.
+    // The queues are bounded, so they use lock-free ring buffers.
     const int kQueueSize = 1;
-    resizer_queue_ = std::make_unique<JobQueue<ImageData>>(kQueueSize);
-    extractor_queue_ = std::make_unique<JobQueue<ImageData>>(kQueueSize);
-    writer_queue_ = std::make_unique<JobQueue<ImageData>>(kQueueSize);
-
-    if (sift_options_.max_image_size > 0) {
+    decoder_pool_ = std::make_unique<ThreadPool>(num_threads);
+    resizer_queue_ = std::make_unique<JobQueue<ImageData>>(
+        kQueueSize, JobQueueType::LOCK_FREE);
+    extractor_queue_ = std::make_unique<JobQueue<ImageData>>(
+        kQueueSize, JobQueueType::LOCK_FREE);
+    writer_queue_ = std::make_unique<JobQueue<ImageData>>(
+        kQueueSize, JobQueueType::LOCK_FREE);
+
+    if (sift_options_.max_image_size > 0 && !sift_options_.tiled_extraction) {
       for (int i = 0; i < num_threads; ++i) {
         resizers_.emplace_back(
             std::make_unique<ImageResizerThread>(sift_options_.max_image_size,
@@ -450,8 +563,42 @@ class FeatureExtractorController : public Thread {
       }
     }
 
+    // Images are decoded in parallel ahead of time but handed to the image
+    // reader in their original order, so that the assignment of image and
+    // camera identifiers remains deterministic. Images whose features already
+    // exist are not decoded. Checking this is part of the parallel tasks,
+    // since it may require hashing the image file.
+    struct DecodedImage {
+      bool exists_features = false;
+      ImageReader::Status status = ImageReader::Status::FAILURE;
+      Bitmap bitmap;
+      Bitmap mask;
+    };
+    std::deque<std::future<DecodedImage>> decoded_images;
+    size_t decode_index = 0;
+    double decode_wait_seconds = 0;
+    double last_stats_seconds = 0;
+    auto DecodeImages = [&]() {
+      while (decode_index < image_reader_.NumImages() &&
+             decoded_images.size() < decoder_pool_->NumThreads()) {
+        decoded_images.push_back(
+            decoder_pool_->AddTask([this, index = decode_index]() {
+              DecodedImage decoded_image;
+              decoded_image.exists_features =
+                  image_reader_.ExistsFeatures(index);
+              if (!decoded_image.exists_features) {
+                decoded_image.status = image_reader_.ReadBitmap(
+                    index, &decoded_image.bitmap, &decoded_image.mask);
+              }
+              return decoded_image;
+            }));
+        decode_index += 1;
+      }
+    };
+
     while (image_reader_.NextIndex() < image_reader_.NumImages()) {
       if (IsStopped()) {
+        decoder_pool_->Stop();
         resizer_queue_->Stop();
         extractor_queue_->Stop();
         resizer_queue_->Clear();
@@ -459,22 +606,53 @@ class FeatureExtractorController : public Thread {
         break;
       }
 
+      DecodeImages();
+
       ImageData image_data;
-      image_data.status = image_reader_.Next(&image_data.camera,
-                                             &image_data.image,
-                                             &image_data.pose_prior,
-                                             &image_data.bitmap,
-                                             &image_data.mask);
+      Timer decode_wait_timer;
+      decode_wait_timer.Start();
+      DecodedImage decoded_image = decoded_images.front().get();
+      decoded_images.pop_front();
+      decode_wait_seconds += decode_wait_timer.ElapsedSeconds();
+      if (decoded_image.exists_features) {
+        image_data.status = image_reader_.Next(&image_data.camera,
+                                               &image_data.image,
+                                               &image_data.pose_prior,
+                                               &image_data.bitmap,
+                                               &image_data.mask);
+      } else {
+        image_data.bitmap = std::move(decoded_image.bitmap);
+        image_data.mask = std::move(decoded_image.mask);
+        image_data.status = image_reader_.Next(&image_data.camera,
+                                               &image_data.image,
+                                               &image_data.pose_prior,
+                                               &image_data.bitmap,
+                                               &image_data.mask,
+                                               decoded_image.status);
+      }
+
+      if (image_data.status == ImageReader::Status::SUCCESS &&
+          reader_options_.use_content_hash) {
+        image_data.has_content_hash = true;
+        image_data.content_hash =
+            image_reader_.ContentHash(image_reader_.NextIndex() - 1);
+      }
 
       if (image_data.status != ImageReader::Status::SUCCESS) {
         image_data.bitmap.Deallocate();
       }
 
-      if (sift_options_.max_image_size > 0) {
+      if (!resizers_.empty()) {
         THROW_CHECK(resizer_queue_->Push(std::move(image_data)));
       } else {
         THROW_CHECK(extractor_queue_->Push(std::move(image_data)));
       }
+
+      const double elapsed_seconds = run_timer.ElapsedSeconds();
+      if (elapsed_seconds - last_stats_seconds >= kStatsIntervalSeconds) {
+        LogPipelineStats(elapsed_seconds, decode_wait_seconds, false);
+        last_stats_seconds = elapsed_seconds;
+      }
     }
 
     resizer_queue_->Wait();
@@ -493,15 +671,139 @@ class FeatureExtractorController : public Thread {
     writer_queue_->Stop();
     writer_->Wait();
 
+    LogPipelineStats(run_timer.ElapsedSeconds(), decode_wait_seconds, true);
+
     run_timer.PrintMinutes();
   }
 
+  // Log the throughput of every pipeline stage together with the time its
+  // threads waited for input and for space in the output queue, accumulated
+  // over all threads of the stage. Stages mostly waiting for output are
+  // limited by a later stage, stages mostly waiting for input by an earlier
+  // stage. The final statistics are additionally logged as a single line of
+  // JSON for further processing.
+  void LogPipelineStats(const double elapsed_seconds,
+                        const double decode_wait_seconds,
+                        const bool final_stats) {
+    struct StageStats {
+      std::string name;
+      size_t num_threads = 0;
+      size_t num_images = 0;
+      double input_wait_seconds = 0;
+      double output_wait_seconds = 0;
+      // Statistics of the input queue, if any.
+      double mean_queue_size = -1;
+      size_t max_queue_size = 0;
+    };
+
+    const auto resizer_stats = resizer_queue_->GetStats();
+    const auto extractor_stats = extractor_queue_->GetStats();
+    const auto writer_stats = writer_queue_->GetStats();
+
+    auto MakeStageStats = [](const std::string& name,
+                             const size_t num_threads,
+                             const JobQueue<ImageData>::Stats& input_stats,
+                             const double output_wait_seconds) {
+      StageStats stage;
+      stage.name = name;
+      stage.num_threads = num_threads;
+      stage.num_images = input_stats.num_popped;
+      stage.input_wait_seconds = input_stats.pop_wait_seconds;
+      stage.output_wait_seconds = output_wait_seconds;
+      stage.mean_queue_size = input_stats.mean_num_jobs;
+      stage.max_queue_size = input_stats.max_num_jobs;
+      return stage;
+    };
+
+    std::vector<StageStats> stages;
+    stages.emplace_back();
+    stages.back().name = "reader";
+    stages.back().num_threads = decoder_pool_->NumThreads();
+    stages.back().num_images = image_reader_.NextIndex();
+    stages.back().input_wait_seconds = decode_wait_seconds;
+    if (!resizers_.empty()) {
+      stages.back().output_wait_seconds = resizer_stats.push_wait_seconds;
+      stages.push_back(MakeStageStats("resizer",
+                                      resizers_.size(),
+                                      resizer_stats,
+                                      extractor_stats.push_wait_seconds));
+    } else {
+      stages.back().output_wait_seconds = extractor_stats.push_wait_seconds;
+    }
+    stages.push_back(MakeStageStats("extractor",
+                                    extractors_.size(),
+                                    extractor_stats,
+                                    writer_stats.push_wait_seconds));
+    stages.push_back(MakeStageStats("writer", 1, writer_stats, 0));
+
+    const double images_per_second_scale =
+        elapsed_seconds > 0 ? 1.0 / elapsed_seconds : 0;
+
+    LOG(INFO) << StringPrintf("Pipeline statistics after %.1fs:",
+                              elapsed_seconds);
+    for (const auto& stage : stages) {
+      std::string queue_stats;
+      if (stage.mean_queue_size >= 0) {
+        queue_stats = StringPrintf(", input queue %.2f (max %d)",
+                                   stage.mean_queue_size,
+                                   static_cast<int>(stage.max_queue_size));
+      }
+      LOG(INFO) << StringPrintf(
+          "  %-9s %6d images at %6.2f/s, waited %.1fs for input and %.1fs "
+          "for output%s",
+          (stage.name + ":").c_str(),
+          static_cast<int>(stage.num_images),
+          stage.num_images * images_per_second_scale,
+          stage.input_wait_seconds,
+          stage.output_wait_seconds,
+          queue_stats.c_str());
+    }
+
+    if (!final_stats) {
+      return;
+    }
+
+    std::string json =
+        StringPrintf("{\"elapsed_seconds\": %.3f, \"stages\": [",
+                     elapsed_seconds);
+    for (size_t i = 0; i < stages.size(); ++i) {
+      const auto& stage = stages[i];
+      if (i > 0) {
+        json += ", ";
+      }
+      json += StringPrintf(
+          "{\"name\": \"%s\", \"num_threads\": %d, \"num_images\": %d, "
+          "\"images_per_second\": %.3f, \"input_wait_seconds\": %.3f, "
+          "\"output_wait_seconds\": %.3f",
+          stage.name.c_str(),
+          static_cast<int>(stage.num_threads),
+          static_cast<int>(stage.num_images),
+          stage.num_images * images_per_second_scale,
+          stage.input_wait_seconds,
+          stage.output_wait_seconds);
+      if (stage.mean_queue_size >= 0) {
+        json += StringPrintf(
+            ", \"mean_input_queue_size\": %.3f, \"max_input_queue_size\": "
+            "%d",
+            stage.mean_queue_size,
+            static_cast<int>(stage.max_queue_size));
+      }
+      json += "}";
+    }
+    json += "]}";
+    LOG(INFO) << "Pipeline statistics (JSON): " << json;
+  }
+
+  // Interval in which the pipeline statistics are logged during extraction.
+  static constexpr double kStatsIntervalSeconds = 60;
+
   const ImageReaderOptions reader_options_;
   const SiftExtractionOptions sift_options_;
 
   Database database_;
   ImageReader image_reader_;
 
+  std::unique_ptr<ThreadPool> decoder_pool_;
   std::vector<std::unique_ptr<Thread>> resizers_;
   std::vector<std::unique_ptr<Thread>> extractors_;
   std::unique_ptr<Thread> writer_;
@@ -511,15 +813,30 @@ class FeatureExtractorController : public Thread {
   std::unique_ptr<JobQueue<ImageData>> writer_queue_;
 };
 
-// Import features from text files. Each image must have a corresponding text
-// file with the same name and an additional ".txt" suffix.
+// Import features from text or binary files. Each image must have a
+// corresponding file with the same name and an additional ".txt" or ".bin"
+// suffix. The files are parsed in parallel and a single writer thread writes
+// the parsed features in batched transactions in the order of the images.
 class FeatureImporterController : public Thread {
  public:
   FeatureImporterController(const ImageReaderOptions& reader_options,
-                            const std::string& import_path)
-      : reader_options_(reader_options), import_path_(import_path) {}
+                            const std::string& import_path,
+                            int num_threads)
+      : reader_options_(reader_options),
+        import_path_(import_path),
+        num_threads_(GetEffectiveNumThreads(num_threads)) {}
 
  private:
+  // Maximum number of images written in one database transaction.
+  static constexpr int kWriteBatchSize = 100;
+
+  struct ImportData {
+    Image image;
+    PosePrior pose_prior;
+    FeatureKeypoints keypoints;
+    FeatureDescriptors descriptors;
+  };
+
   void Run() override {
     PrintHeading1("Feature import");
     Timer run_timer;
@@ -533,6 +850,12 @@ class FeatureImporterController : public Thread {
     Database database(reader_options_.database_path);
     ImageReader image_reader(reader_options_, &database);
 
+    ThreadPool parser_pool(num_threads_);
+    JobQueue<std::future<ImportData>> writer_queue(2 * num_threads_);
+    std::thread writer_thread([this, &database, &writer_queue]() {
+      Write(&database, &writer_queue);
+    });
+
     while (image_reader.NextIndex() < image_reader.NumImages()) {
       if (IsStopped()) {
         break;
@@ -544,49 +867,107 @@ class FeatureImporterController : public Thread {
 
       // Load image data and possibly save camera to database.
       Camera camera;
-      Image image;
-      PosePrior pose_prior;
+      ImportData data;
+      // The pixels are not needed, so only the image header is read.
       Bitmap bitmap;
-      if (image_reader.Next(&camera, &image, &pose_prior, &bitmap, nullptr) !=
-          ImageReader::Status::SUCCESS) {
+      const ImageReader::Status read_status =
+          image_reader.ReadHeader(image_reader.NextIndex(), &bitmap);
+      if (image_reader.Next(&camera,
+                            &data.image,
+                            &data.pose_prior,
+                            &bitmap,
+                            nullptr,
+                            read_status) != ImageReader::Status::SUCCESS) {
+        continue;
+      }
+
+      std::string path = JoinPaths(import_path_, data.image.Name() + ".txt");
+      bool is_binary = false;
+      if (!ExistsFile(path)) {
+        path = JoinPaths(import_path_, data.image.Name() + ".bin");
+        is_binary = true;
+      }
+
+      if (!ExistsFile(path)) {
+        LOG(INFO) << "SKIP: No features found at " << path;
         continue;
       }
 
-      const std::string path = JoinPaths(import_path_, image.Name() + ".txt");
+      writer_queue.Push(parser_pool.AddTask(
+          [path, is_binary, data = std::move(data)]() mutable {
+            if (is_binary) {
+              LoadSiftFeaturesFromBinaryFile(
+                  path, &data.keypoints, &data.descriptors);
+            } else {
+              LoadSiftFeaturesFromTextFile(
+                  path, &data.keypoints, &data.descriptors);
+            }
+            return std::move(data);
+          }));
+    }
 
-      if (ExistsFile(path)) {
-        FeatureKeypoints keypoints;
-        FeatureDescriptors descriptors;
-        LoadSiftFeaturesFromTextFile(path, &keypoints, &descriptors);
+    writer_queue.Wait();
+    writer_thread.join();
 
-        LOG(INFO) << "Features:       " << keypoints.size();
+    run_timer.PrintMinutes();
+  }
 
-        DatabaseTransaction database_transaction(&database);
+  void Write(Database* database,
+             JobQueue<std::future<ImportData>>* writer_queue) {
+    std::unique_ptr<DatabaseTransaction> database_transaction;
+    int num_batch_images = 0;
+    while (true) {
+      // The transaction blocks the image reader, so it is committed when the
+      // queue runs empty and not only when the batch is full.
+      if (num_batch_images >= kWriteBatchSize ||
+          (database_transaction != nullptr && writer_queue->Size() == 0)) {
+        database_transaction.reset();
+        num_batch_images = 0;
+      }
 
-        if (image.ImageId() == kInvalidImageId) {
-          image.SetImageId(database.WriteImage(image));
-          if (pose_prior.IsValid()) {
-            database.WritePosePrior(image.ImageId(), pose_prior);
-          }
-        }
+      auto job = writer_queue->Pop();
+      if (!job.IsValid()) {
+        break;
+      }
 
-        if (!database.ExistsKeypoints(image.ImageId())) {
-          database.WriteKeypoints(image.ImageId(), keypoints);
-        }
+      ImportData data;
+      try {
+        data = job.Data().get();
+      } catch (const std::exception& e) {
+        LOG(ERROR) << "Failed to import features: " << e.what();
+        continue;
+      }
 
-        if (!database.ExistsDescriptors(image.ImageId())) {
-          database.WriteDescriptors(image.ImageId(), descriptors);
+      if (database_transaction == nullptr) {
+        database_transaction = std::make_unique<DatabaseTransaction>(database);
+      }
+
+      LOG(INFO) << StringPrintf("Features of %s: %d",
+                                data.image.Name().c_str(),
+                                data.keypoints.size());
+
+      if (data.image.ImageId() == kInvalidImageId) {
+        data.image.SetImageId(database->WriteImage(data.image));
+        if (data.pose_prior.IsValid()) {
+          database->WritePosePrior(data.image.ImageId(), data.pose_prior);
         }
-      } else {
-        LOG(INFO) << "SKIP: No features found at " << path;
       }
-    }
 
-    run_timer.PrintMinutes();
+      if (!database->ExistsKeypoints(data.image.ImageId())) {
+        database->WriteKeypoints(data.image.ImageId(), data.keypoints);
+      }
+
+      if (!database->ExistsDescriptors(data.image.ImageId())) {
+        database->WriteDescriptors(data.image.ImageId(), data.descriptors);
+      }
+
+      num_batch_images += 1;
+    }
   }
 
   const ImageReaderOptions reader_options_;
   const std::string import_path_;
+  const int num_threads_;
 };
 
 }  // namespace
@@ -599,9 +980,11 @@ std::unique_ptr<Thread> CreateFeatureExtractorController(
 }
 
 std::unique_ptr<Thread> CreateFeatureImporterController(
-    const ImageReaderOptions& reader_options, const std::string& import_path) {
-  return std::make_unique<FeatureImporterController>(reader_options,
-                                                     import_path);
+    const ImageReaderOptions& reader_options,
+    const std::string& import_path,
+    const int num_threads) {
+  return std::make_unique<FeatureImporterController>(
+      reader_options, import_path, num_threads);
 }
 
 }  // namespace colmap
@@ -36,8 +36,11 @@
 #include "colmap/util/misc.h"
 #include "colmap/util/timer.h"
 
+#include <algorithm>
 #include <fstream>
+#include <future>
 #include <numeric>
+#include <thread>
 
 namespace colmap {
 namespace {
@@ -86,10 +89,23 @@ class GenericFeatureMatcher : public Thread {
       timer.Start();
       const std::vector<std::pair<image_t, image_t>> image_pairs =
           pair_generator.Next();
-      DatabaseTransaction database_transaction(database_.get());
       matcher_.Match(image_pairs);
       PrintElapsedTime(timer);
     }
+    matcher_.Flush();
+    matcher_.LogStats();
+
+    const FeatureMatcherCache::Stats cache_stats = cache_->GetStats();
+    LOG(INFO) << StringPrintf(
+        "Feature cache: %d of %d requests hit (%.1f%%), %d feature sets read "
+        "from database",
+        static_cast<int>(cache_stats.num_hits),
+        static_cast<int>(cache_stats.num_requests),
+        cache_stats.num_requests == 0
+            ? 100.0
+            : 100.0 * cache_stats.num_hits / cache_stats.num_requests,
+        static_cast<int>(cache_stats.num_reads));
+
     run_timer.PrintMinutes();
   }
 
@@ -115,6 +131,11 @@ std::unique_ptr<Thread> CreateVocabTreeFeatureMatcher(
     const SiftMatchingOptions& matching_options,
     const TwoViewGeometryOptions& geometry_options,
     const std::string& database_path) {
+  if (options.use_global_descriptors) {
+    return std::make_unique<
+        GenericFeatureMatcher<GlobalDescriptorPairGenerator>>(
+        options, matching_options, geometry_options, database_path);
+  }
   return std::make_unique<GenericFeatureMatcher<VocabTreePairGenerator>>(
       options, matching_options, geometry_options, database_path);
 }
@@ -169,10 +190,27 @@ class TransitiveFeatureMatcher : public Thread {
 
     cache_->Setup();
 
-    const std::vector<image_t> image_ids = cache_->GetImageIds();
+    // The correspondence graph of verified image pairs is only read once and
+    // then maintained in memory. The transitive candidates of two previously
+    // verified pairs have already been matched, so each iteration only
+    // expands the frontier of pairs newly verified in the previous iteration.
+    std::vector<std::pair<image_t, image_t>> frontier_image_pairs;
+    std::vector<int> existing_num_inliers;
+    database_->ReadTwoViewGeometryNumInliers(&frontier_image_pairs,
+                                             &existing_num_inliers);
+    THROW_CHECK_EQ(frontier_image_pairs.size(), existing_num_inliers.size());
+
+    std::unordered_map<image_t, std::vector<image_t>> adjacency;
+    std::unordered_set<image_pair_t> visited_image_pair_ids;
+    visited_image_pair_ids.reserve(frontier_image_pairs.size());
+    for (const auto& image_pair : frontier_image_pairs) {
+      adjacency[image_pair.first].push_back(image_pair.second);
+      adjacency[image_pair.second].push_back(image_pair.first);
+      visited_image_pair_ids.insert(
+          Database::ImagePairToPairId(image_pair.first, image_pair.second));
+    }
 
-    std::vector<std::pair<image_t, image_t>> image_pairs;
-    std::unordered_set<image_pair_t> image_pair_ids;
+    const size_t batch_size = static_cast<size_t>(options_.batch_size);
 
     for (int iteration = 0; iteration < options_.num_iterations; ++iteration) {
       if (IsStopped()) {
@@ -186,61 +224,69 @@ class TransitiveFeatureMatcher : public Thread {
       LOG(INFO) << StringPrintf(
           "Iteration [%d/%d]", iteration + 1, options_.num_iterations);
 
-      std::vector<std::pair<image_t, image_t>> existing_image_pairs;
-      std::vector<int> existing_num_inliers;
-      database_->ReadTwoViewGeometryNumInliers(&existing_image_pairs,
-                                               &existing_num_inliers);
-
-      THROW_CHECK_EQ(existing_image_pairs.size(), existing_num_inliers.size());
-
-      std::unordered_map<image_t, std::vector<image_t>> adjacency;
-      for (const auto& image_pair : existing_image_pairs) {
-        adjacency[image_pair.first].push_back(image_pair.second);
-        adjacency[image_pair.second].push_back(image_pair.first);
+      // Collect the unvisited pairs closing a path of two verified pairs, of
+      // which at least one is part of the frontier.
+      std::vector<std::pair<image_t, image_t>> candidate_image_pairs;
+      for (const auto& image_pair : frontier_image_pairs) {
+        const std::pair<image_t, image_t> reverse_image_pair(
+            image_pair.second, image_pair.first);
+        for (const auto& edge : {image_pair, reverse_image_pair}) {
+          for (const image_t image_id3 : adjacency.at(edge.second)) {
+            if (image_id3 != edge.first &&
+                visited_image_pair_ids
+                    .insert(Database::ImagePairToPairId(edge.first, image_id3))
+                    .second) {
+              candidate_image_pairs.emplace_back(edge.first, image_id3);
+            }
+          }
+        }
       }
 
-      const size_t batch_size = static_cast<size_t>(options_.batch_size);
+      frontier_image_pairs.clear();
 
       size_t num_batches = 0;
-      image_pairs.clear();
-      image_pair_ids.clear();
-      for (const auto& image : adjacency) {
-        const auto image_id1 = image.first;
-        for (const auto& image_id2 : image.second) {
-          if (adjacency.count(image_id2) > 0) {
-            for (const auto& image_id3 : adjacency.at(image_id2)) {
-              const auto image_pair_id =
-                  Database::ImagePairToPairId(image_id1, image_id3);
-              if (image_pair_ids.count(image_pair_id) == 0) {
-                image_pairs.emplace_back(image_id1, image_id3);
-                image_pair_ids.insert(image_pair_id);
-                if (image_pairs.size() >= batch_size) {
-                  num_batches += 1;
-                  LOG(INFO) << StringPrintf("  Batch %d", num_batches);
-                  DatabaseTransaction database_transaction(database_.get());
-                  matcher_.Match(image_pairs);
-                  image_pairs.clear();
-                  PrintElapsedTime(timer);
-                  timer.Restart();
-
-                  if (IsStopped()) {
-                    run_timer.PrintMinutes();
-                    return;
-                  }
-                }
-              }
-            }
+      std::vector<std::pair<image_t, image_t>> image_pairs;
+      image_pairs.reserve(std::min(batch_size, candidate_image_pairs.size()));
+      for (size_t i = 0; i < candidate_image_pairs.size(); i += batch_size) {
+        image_pairs.assign(
+            candidate_image_pairs.begin() + i,
+            candidate_image_pairs.begin() +
+                std::min(i + batch_size, candidate_image_pairs.size()));
+
+        num_batches += 1;
+        LOG(INFO) << StringPrintf("  Batch %d", num_batches);
+        matcher_.Match(image_pairs);
+
+        for (const auto& image_pair : image_pairs) {
+          if (!database_
+                   ->ReadTwoViewGeometry(image_pair.first, image_pair.second)
+                   .inlier_matches.empty()) {
+            frontier_image_pairs.push_back(image_pair);
           }
         }
+
+        PrintElapsedTime(timer);
+        timer.Restart();
+
+        if (IsStopped()) {
+          run_timer.PrintMinutes();
+          return;
+        }
       }
 
-      num_batches += 1;
-      LOG(INFO) << StringPrintf("  Batch %d", num_batches);
-      DatabaseTransaction database_transaction(database_.get());
-      matcher_.Match(image_pairs);
-      PrintElapsedTime(timer);
+      for (const auto& image_pair : frontier_image_pairs) {
+        adjacency[image_pair.first].push_back(image_pair.second);
+        adjacency[image_pair.second].push_back(image_pair.first);
+      }
+
+      if (frontier_image_pairs.empty()) {
+        LOG(INFO) << "  No new verified image pairs";
+        break;
+      }
     }
 
+    matcher_.Flush();
+    matcher_.LogStats();
     run_timer.PrintMinutes();
   }
 
@@ -291,6 +337,19 @@ class FeaturePairsFeatureMatcher : public Thread {
   }
 
  private:
+  // Maximum number of image pairs written in one database transaction.
+  static constexpr int kWriteBatchSize = 1000;
+
+  struct ImportData {
+    image_t image_id1 = kInvalidImageId;
+    image_t image_id2 = kInvalidImageId;
+    FeatureMatches matches;
+    TwoViewGeometry two_view_geometry;
+  };
+
+  // The file is read sequentially, while the matches of each image pair are
+  // parsed and verified in parallel. A single writer thread writes the pairs
+  // in batched transactions in the order of the file.
   void Run() override {
     PrintHeading1("Importing matches");
     Timer run_timer;
@@ -308,11 +367,17 @@ class FeaturePairsFeatureMatcher : public Thread {
     std::ifstream file(options_.match_list_path);
     THROW_CHECK_FILE_OPEN(file, options_.match_list_path);
 
+    ThreadPool parser_pool(
+        GetEffectiveNumThreads(matching_options_.num_threads));
+    JobQueue<std::future<ImportData>> writer_queue(
+        2 * parser_pool.NumThreads());
+    std::thread writer_thread(
+        [this, &writer_queue]() { Write(&writer_queue); });
+
     std::string line;
     while (std::getline(file, line)) {
       if (IsStopped()) {
-        run_timer.PrintMinutes();
-        return;
+        break;
       }
 
       StringTrim(&line);
@@ -333,87 +398,140 @@ class FeaturePairsFeatureMatcher : public Thread {
       LOG(INFO) << StringPrintf(
           "%s - %s", image_name1.c_str(), image_name2.c_str());
 
+      std::vector<std::string> match_lines;
+      while (std::getline(file, line)) {
+        StringTrim(&line);
+        if (line.empty()) {
+          break;
+        }
+        match_lines.push_back(std::move(line));
+      }
+
       if (image_name_to_image.count(image_name1) == 0) {
         LOG(INFO) << StringPrintf("SKIP: Image %s not found in database.",
                                   image_name1.c_str());
-        break;
+        continue;
       }
       if (image_name_to_image.count(image_name2) == 0) {
         LOG(INFO) << StringPrintf("SKIP: Image %s not found in database.",
                                   image_name2.c_str());
-        break;
+        continue;
       }
 
-      const Image& image1 = *image_name_to_image[image_name1];
-      const Image& image2 = *image_name_to_image[image_name2];
+      const image_t image_id1 = image_name_to_image[image_name1]->ImageId();
+      const image_t image_id2 = image_name_to_image[image_name2]->ImageId();
 
-      bool skip_pair = false;
-      if (database_->ExistsInlierMatches(image1.ImageId(), image2.ImageId())) {
+      if (cache_->ExistsInlierMatches(image_id1, image_id2)) {
         LOG(INFO) << "SKIP: Matches for image pair already exist in database.";
-        skip_pair = true;
+        continue;
       }
 
-      FeatureMatches matches;
-      while (std::getline(file, line)) {
-        StringTrim(&line);
+      writer_queue.Push(parser_pool.AddTask(
+          [this, image_id1, image_id2, match_lines = std::move(match_lines)]() {
+            return ParseAndVerify(image_id1, image_id2, match_lines);
+          }));
+    }
 
-        if (line.empty()) {
-          break;
-        }
+    writer_queue.Wait();
+    writer_thread.join();
 
-        std::istringstream line_stream(line);
+    run_timer.PrintMinutes();
+  }
 
-        FeatureMatch match;
-        try {
-          line_stream >> match.point2D_idx1 >> match.point2D_idx2;
-        } catch (...) {
-          LOG(ERROR) << "Cannot read feature matches.";
-          break;
-        }
+  ImportData ParseAndVerify(const image_t image_id1,
+                            const image_t image_id2,
+                            const std::vector<std::string>& match_lines) {
+    ImportData data;
+    data.image_id1 = image_id1;
+    data.image_id2 = image_id2;
 
-        matches.push_back(match);
-      }
+    data.matches.reserve(match_lines.size());
+    for (const std::string& match_line : match_lines) {
+      std::istringstream line_stream(match_line);
 
-      if (skip_pair) {
-        continue;
+      FeatureMatch match;
+      try {
+        line_stream >> match.point2D_idx1 >> match.point2D_idx2;
+      } catch (...) {
+        LOG(ERROR) << "Cannot read feature matches.";
+        break;
       }
 
-      const Camera& camera1 = cache_->GetCamera(image1.CameraId());
-      const Camera& camera2 = cache_->GetCamera(image2.CameraId());
+      data.matches.push_back(match);
+    }
 
-      if (options_.verify_matches) {
-        database_->WriteMatches(image1.ImageId(), image2.ImageId(), matches);
+    const Camera& camera1 =
+        cache_->GetCamera(cache_->GetImage(image_id1).CameraId());
+    const Camera& camera2 =
+        cache_->GetCamera(cache_->GetImage(image_id2).CameraId());
+
+    if (options_.verify_matches) {
+      const auto keypoints1 = cache_->GetKeypoints(image_id1);
+      const auto keypoints2 = cache_->GetKeypoints(image_id2);
+
+      data.two_view_geometry =
+          EstimateTwoViewGeometry(camera1,
+                                  FeatureKeypointsToPointsVector(*keypoints1),
+                                  camera2,
+                                  FeatureKeypointsToPointsVector(*keypoints2),
+                                  data.matches,
+                                  geometry_options_);
+    } else {
+      if (camera1.has_prior_focal_length && camera2.has_prior_focal_length) {
+        data.two_view_geometry.config = TwoViewGeometry::CALIBRATED;
+      } else {
+        data.two_view_geometry.config = TwoViewGeometry::UNCALIBRATED;
+      }
 
-        const auto keypoints1 = cache_->GetKeypoints(image1.ImageId());
-        const auto keypoints2 = cache_->GetKeypoints(image2.ImageId());
+      data.two_view_geometry.inlier_matches = data.matches;
+    }
 
-        TwoViewGeometry two_view_geometry =
-            EstimateTwoViewGeometry(camera1,
-                                    FeatureKeypointsToPointsVector(*keypoints1),
-                                    camera2,
-                                    FeatureKeypointsToPointsVector(*keypoints2),
-                                    matches,
-                                    geometry_options_);
+    return data;
+  }
 
-        database_->WriteTwoViewGeometry(
-            image1.ImageId(), image2.ImageId(), two_view_geometry);
-      } else {
-        TwoViewGeometry two_view_geometry;
+  void Write(JobQueue<std::future<ImportData>>* writer_queue) {
+    bool in_transaction = false;
+    int num_batch_pairs = 0;
+    while (true) {
+      // Commit the transaction, when the queue runs empty, such that the
+      // imported pairs are visible while waiting for the next pairs.
+      if (in_transaction && (num_batch_pairs >= kWriteBatchSize ||
+                             writer_queue->Size() == 0)) {
+        cache_->EndTransaction();
+        in_transaction = false;
+        num_batch_pairs = 0;
+      }
 
-        if (camera1.has_prior_focal_length && camera2.has_prior_focal_length) {
-          two_view_geometry.config = TwoViewGeometry::CALIBRATED;
-        } else {
-          two_view_geometry.config = TwoViewGeometry::UNCALIBRATED;
-        }
+      auto job = writer_queue->Pop();
+      if (!job.IsValid()) {
+        break;
+      }
 
-        two_view_geometry.inlier_matches = matches;
+      ImportData data;
+      try {
+        data = job.Data().get();
+      } catch (const std::exception& e) {
+        LOG(ERROR) << "Failed to import matches: " << e.what();
+        continue;
+      }
 
-        database_->WriteTwoViewGeometry(
-            image1.ImageId(), image2.ImageId(), two_view_geometry);
+      if (!in_transaction) {
+        cache_->BeginTransaction();
+        in_transaction = true;
       }
+
+      if (options_.verify_matches) {
+        cache_->WriteMatches(data.image_id1, data.image_id2, data.matches);
+      }
+      cache_->WriteTwoViewGeometry(
+          data.image_id1, data.image_id2, data.two_view_geometry);
+
+      num_batch_pairs += 1;
     }
 
-    run_timer.PrintMinutes();
+    if (in_transaction) {
+      cache_->EndTransaction();
+    }
   }
 
   const FeaturePairsMatchingOptions options_;
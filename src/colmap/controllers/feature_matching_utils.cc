@@ -33,24 +33,121 @@
 #include "colmap/feature/utils.h"
 #include "colmap/util/cuda.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/profiler.h"
+#include "colmap/util/timer.h"
 
+#include <algorithm>
+#include <array>
 #include <fstream>
 #include <numeric>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace colmap {
+namespace {
+
+// Deterministically assign image pairs to shards. The pair identifiers are
+// mixed, since consecutive identifiers share the first image.
+int ImagePairToShardIndex(const image_pair_t pair_id, const int num_shards) {
+  uint64_t hash = pair_id + 0x9e3779b97f4a7c15ULL;
+  hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+  hash = hash ^ (hash >> 31);
+  return static_cast<int>(hash % static_cast<uint64_t>(num_shards));
+}
+
+void AddStats(FeatureMatcherStats* stats,
+              const FeatureMatcherStats::Stage stage,
+              const Timer& timer,
+              const size_t num_pairs = 1) {
+  if (stats != nullptr) {
+    stats->Add(stage, timer.ElapsedSeconds(), num_pairs);
+  }
+}
+
+}  // namespace
+
+const std::vector<double>& FeatureMatcherStats::HistogramBinEdges() {
+  static const std::vector<double> kBinEdges = {0.1,
+                                                0.2,
+                                                0.5,
+                                                1,
+                                                2,
+                                                5,
+                                                10,
+                                                20,
+                                                50,
+                                                100,
+                                                200,
+                                                500,
+                                                1000,
+                                                2000,
+                                                5000,
+                                                10000};
+  return kBinEdges;
+}
+
+std::string FeatureMatcherStats::StageName(const Stage stage) {
+  switch (stage) {
+    case Stage::FETCH:
+      return "fetch";
+    case Stage::PRE_FILTER:
+      return "pre_filter";
+    case Stage::MATCH:
+      return "match";
+    case Stage::VERIFY:
+      return "verify";
+    case Stage::GUIDED_MATCH:
+      return "guided_match";
+    case Stage::WRITE:
+      return "write";
+  }
+  return "unknown";
+}
+
+void FeatureMatcherStats::Add(const Stage stage,
+                              const double seconds,
+                              const size_t num_pairs) {
+  const std::vector<double>& bin_edges = HistogramBinEdges();
+  std::lock_guard<std::mutex> lock(mutex_);
+  StageStats& stage_stats = stages_.at(static_cast<size_t>(stage));
+  stage_stats.seconds += seconds;
+  if (num_pairs == 0) {
+    return;
+  }
+  stage_stats.num_pairs += num_pairs;
+  if (stage_stats.histogram.empty()) {
+    stage_stats.histogram.resize(bin_edges.size() + 1, 0);
+  }
+  const double milliseconds_per_pair = 1000 * seconds / num_pairs;
+  const size_t bin_idx =
+      std::upper_bound(
+          bin_edges.begin(), bin_edges.end(), milliseconds_per_pair) -
+      bin_edges.begin();
+  stage_stats.histogram[bin_idx] += num_pairs;
+}
+
+FeatureMatcherStats::StageStats FeatureMatcherStats::Get(
+    const Stage stage) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  StageStats stage_stats = stages_.at(static_cast<size_t>(stage));
+  stage_stats.histogram.resize(HistogramBinEdges().size() + 1, 0);
+  return stage_stats;
+}
 
 FeatureMatcherWorker::FeatureMatcherWorker(
     const SiftMatchingOptions& matching_options,
     const TwoViewGeometryOptions& geometry_options,
     FeatureMatcherCache* cache,
     JobQueue<Input>* input_queue,
-    JobQueue<Output>* output_queue)
+    JobQueue<Output>* output_queue,
+    FeatureMatcherStats* stats)
     : matching_options_(matching_options),
       geometry_options_(geometry_options),
       cache_(cache),
       input_queue_(input_queue),
-      output_queue_(output_queue) {
+      output_queue_(output_queue),
+      stats_(stats) {
   THROW_CHECK(matching_options_.Check());
 
   prev_keypoints_image_ids_[0] = kInvalidImageId;
@@ -65,6 +162,23 @@ FeatureMatcherWorker::FeatureMatcherWorker(
   }
 }
 
+FeatureMatcherWorker::FeatureMatcherWorker(
+    const SiftMatchingOptions& matching_options,
+    const TwoViewGeometryOptions& geometry_options,
+    FeatureMatcherCache* cache,
+    JobQueue<BatchInput>* batch_input_queue,
+    JobQueue<Output>* output_queue,
+    FeatureMatcherStats* stats)
+    : FeatureMatcherWorker(matching_options,
+                           geometry_options,
+                           cache,
+                           static_cast<JobQueue<Input>*>(nullptr),
+                           output_queue,
+                           stats) {
+  THROW_CHECK(!matching_options_.guided_matching);
+  batch_input_queue_ = THROW_CHECK_NOTNULL(batch_input_queue);
+}
+
 void FeatureMatcherWorker::SetMaxNumMatches(int max_num_matches) {
   matching_options_.max_num_matches = max_num_matches;
 }
@@ -92,8 +206,18 @@ void FeatureMatcherWorker::Run() {
       break;
     }
 
+    if (batch_input_queue_ != nullptr) {
+      auto input_job = batch_input_queue_->Pop();
+      if (input_job.IsValid()) {
+        COLMAP_PROFILE_ZONE("FeatureMatcherWorker::MatchBatch");
+        MatchBatch(matcher.get(), &input_job.Data());
+      }
+      continue;
+    }
+
     auto input_job = input_queue_->Pop();
     if (input_job.IsValid()) {
+      COLMAP_PROFILE_ZONE("FeatureMatcherWorker::Match");
       auto& data = input_job.Data();
 
       if (!cache_->ExistsDescriptors(data.image_id1) ||
@@ -102,17 +226,33 @@ void FeatureMatcherWorker::Run() {
         continue;
       }
 
+      Timer timer;
+      timer.Start();
       if (matching_options_.guided_matching) {
+        const auto keypoints1 = GetKeypointsPtr(0, data.image_id1);
+        const auto keypoints2 = GetKeypointsPtr(1, data.image_id2);
+        const auto descriptors1 = GetDescriptorsPtr(0, data.image_id1);
+        const auto descriptors2 = GetDescriptorsPtr(1, data.image_id2);
+        AddStats(stats_, FeatureMatcherStats::Stage::FETCH, timer);
+        timer.Restart();
         matcher->MatchGuided(geometry_options_.ransac_options.max_error,
-                             GetKeypointsPtr(0, data.image_id1),
-                             GetKeypointsPtr(1, data.image_id2),
-                             GetDescriptorsPtr(0, data.image_id1),
-                             GetDescriptorsPtr(1, data.image_id2),
+                             keypoints1,
+                             keypoints2,
+                             descriptors1,
+                             descriptors2,
                              &data.two_view_geometry);
+        AddStats(stats_, FeatureMatcherStats::Stage::GUIDED_MATCH, timer);
       } else {
-        matcher->Match(GetDescriptorsPtr(0, data.image_id1),
-                       GetDescriptorsPtr(1, data.image_id2),
-                       &data.matches);
+        const auto descriptors1 = GetDescriptorsPtr(0, data.image_id1);
+        const auto descriptors2 = GetDescriptorsPtr(1, data.image_id2);
+        AddStats(stats_, FeatureMatcherStats::Stage::FETCH, timer);
+        timer.Restart();
+        matcher->Match(descriptors1, descriptors2, &data.matches);
+        if (matching_options_.sort_matches) {
+          SortFeatureMatchesBySimilarity(
+              *prev_descriptors_[0], *prev_descriptors_[1], &data.matches);
+        }
+        AddStats(stats_, FeatureMatcherStats::Stage::MATCH, timer);
       }
 
       THROW_CHECK(output_queue_->Push(std::move(data)));
@@ -120,6 +260,137 @@ void FeatureMatcherWorker::Run() {
   }
 }
 
+void FeatureMatcherWorker::MatchBatch(FeatureMatcher* matcher,
+                                      BatchInput* batch) {
+  if (batch->empty()) {
+    return;
+  }
+
+  const image_t image_id1 = batch->front().image_id1;
+  const bool exists_descriptors1 = cache_->ExistsDescriptors(image_id1);
+
+  std::vector<FeatureMatcherData*> batch_data;
+  batch_data.reserve(batch->size());
+  for (auto& data : *batch) {
+    THROW_CHECK_EQ(data.image_id1, image_id1);
+    if (!exists_descriptors1 || !cache_->ExistsDescriptors(data.image_id2)) {
+      THROW_CHECK(output_queue_->Push(std::move(data)));
+      continue;
+    }
+    batch_data.push_back(&data);
+  }
+
+  Timer timer;
+  if (matching_options_.pre_filter_num_features > 0 && !batch_data.empty()) {
+    timer.Start();
+    const size_t num_pairs = batch_data.size();
+    PreFilterBatch(matcher, &batch_data);
+    AddStats(stats_, FeatureMatcherStats::Stage::PRE_FILTER, timer, num_pairs);
+  }
+
+  if (batch_data.empty()) {
+    return;
+  }
+
+  timer.Restart();
+  const auto descriptors1 = GetDescriptorsPtr(0, image_id1);
+  std::vector<std::shared_ptr<const FeatureDescriptors>> descriptors2;
+  descriptors2.reserve(batch_data.size());
+  // The null descriptors of repeated images are resolved for sorting.
+  std::vector<std::shared_ptr<const FeatureDescriptors>> sort_descriptors2;
+  for (const FeatureMatcherData* data : batch_data) {
+    descriptors2.push_back(GetDescriptorsPtr(1, data->image_id2));
+    if (matching_options_.sort_matches) {
+      sort_descriptors2.push_back(prev_descriptors_[1]);
+    }
+  }
+  AddStats(
+      stats_, FeatureMatcherStats::Stage::FETCH, timer, batch_data.size());
+
+  timer.Restart();
+  std::vector<FeatureMatches> matches;
+  matcher->MatchBatch(descriptors1, descriptors2, &matches);
+  THROW_CHECK_EQ(matches.size(), batch_data.size());
+  if (matching_options_.sort_matches) {
+    for (size_t i = 0; i < batch_data.size(); ++i) {
+      SortFeatureMatchesBySimilarity(
+          *prev_descriptors_[0], *sort_descriptors2[i], &matches[i]);
+    }
+  }
+  AddStats(
+      stats_, FeatureMatcherStats::Stage::MATCH, timer, batch_data.size());
+
+  for (size_t i = 0; i < batch_data.size(); ++i) {
+    batch_data[i]->matches = std::move(matches[i]);
+    THROW_CHECK(output_queue_->Push(std::move(*batch_data[i])));
+  }
+}
+
+void FeatureMatcherWorker::PreFilterBatch(
+    FeatureMatcher* matcher, std::vector<FeatureMatcherData*>* batch_data) {
+  const FeatureDescriptors::Index num_features =
+      matching_options_.pre_filter_num_features;
+
+  const std::shared_ptr<const FeatureDescriptors> descriptors1 =
+      GetTopScaleDescriptors(batch_data->front()->image_id1);
+
+  std::vector<FeatureMatcherData*> filtered_batch_data;
+  filtered_batch_data.reserve(batch_data->size());
+  std::vector<FeatureMatcherData*> coarse_batch_data;
+  std::vector<std::shared_ptr<const FeatureDescriptors>> descriptors2;
+  for (FeatureMatcherData* data : *batch_data) {
+    std::shared_ptr<const FeatureDescriptors> top_descriptors2 =
+        GetTopScaleDescriptors(data->image_id2);
+    // The coarse matching would be identical to the full matching.
+    if (descriptors1->rows() <= num_features &&
+        top_descriptors2->rows() <= num_features) {
+      filtered_batch_data.push_back(data);
+      continue;
+    }
+    coarse_batch_data.push_back(data);
+    descriptors2.push_back(std::move(top_descriptors2));
+  }
+
+  if (coarse_batch_data.empty()) {
+    return;
+  }
+
+  std::vector<FeatureMatches> coarse_matches;
+  matcher->MatchBatch(descriptors1, descriptors2, &coarse_matches);
+  THROW_CHECK_EQ(coarse_matches.size(), coarse_batch_data.size());
+
+  // The matcher now holds the coarse descriptors, which must not be mistaken
+  // for the full descriptors of the same images in the next call.
+  prev_descriptors_image_ids_[0] = kInvalidImageId;
+  prev_descriptors_image_ids_[1] = kInvalidImageId;
+
+  for (size_t i = 0; i < coarse_batch_data.size(); ++i) {
+    if (coarse_matches[i].size() <
+        static_cast<size_t>(matching_options_.pre_filter_min_num_matches)) {
+      THROW_CHECK(output_queue_->Push(std::move(*coarse_batch_data[i])));
+    } else {
+      filtered_batch_data.push_back(coarse_batch_data[i]);
+    }
+  }
+
+  *batch_data = std::move(filtered_batch_data);
+}
+
+std::shared_ptr<const FeatureDescriptors>
+FeatureMatcherWorker::GetTopScaleDescriptors(const image_t image_id) {
+  std::shared_ptr<FeatureDescriptors> descriptors =
+      cache_->GetDescriptors(image_id);
+  const size_t num_features =
+      static_cast<size_t>(matching_options_.pre_filter_num_features);
+  if (static_cast<size_t>(descriptors->rows()) <= num_features) {
+    return descriptors;
+  }
+  FeatureKeypoints top_keypoints = *cache_->GetKeypoints(image_id);
+  auto top_descriptors = std::make_shared<FeatureDescriptors>(*descriptors);
+  ExtractTopScaleFeatures(&top_keypoints, top_descriptors.get(), num_features);
+  return top_descriptors;
+}
+
 std::shared_ptr<FeatureKeypoints> FeatureMatcherWorker::GetKeypointsPtr(
     const int index, const image_t image_id) {
   THROW_CHECK_GE(index, 0);
@@ -156,11 +427,13 @@ class VerifierWorker : public Thread {
   VerifierWorker(const TwoViewGeometryOptions& options,
                  FeatureMatcherCache* cache,
                  JobQueue<Input>* input_queue,
-                 JobQueue<Output>* output_queue)
+                 JobQueue<Output>* output_queue,
+                 FeatureMatcherStats* stats)
       : options_(options),
         cache_(cache),
         input_queue_(input_queue),
-        output_queue_(output_queue) {
+        output_queue_(output_queue),
+        stats_(stats) {
     THROW_CHECK(options_.Check());
   }
 
@@ -181,19 +454,22 @@ class VerifierWorker : public Thread {
           continue;
         }
 
+        Timer timer;
+        timer.Start();
         const auto& camera1 =
             cache_->GetCamera(cache_->GetImage(data.image_id1).CameraId());
         const auto& camera2 =
             cache_->GetCamera(cache_->GetImage(data.image_id2).CameraId());
-        const auto keypoints1 = cache_->GetKeypoints(data.image_id1);
-        const auto keypoints2 = cache_->GetKeypoints(data.image_id2);
-        const std::vector<Eigen::Vector2d> points1 =
-            FeatureKeypointsToPointsVector(*keypoints1);
-        const std::vector<Eigen::Vector2d> points2 =
-            FeatureKeypointsToPointsVector(*keypoints2);
+        const std::vector<Eigen::Vector2d>& points1 =
+            GetPoints(data.image_id1, data.image_id2);
+        const std::vector<Eigen::Vector2d>& points2 =
+            GetPoints(data.image_id2, data.image_id1);
+        AddStats(stats_, FeatureMatcherStats::Stage::FETCH, timer);
 
+        timer.Restart();
         data.two_view_geometry = EstimateTwoViewGeometry(
             camera1, points1, camera2, points2, data.matches, options_);
+        AddStats(stats_, FeatureMatcherStats::Stage::VERIFY, timer);
 
         THROW_CHECK(output_queue_->Push(std::move(data)));
       }
@@ -201,14 +477,128 @@ class VerifierWorker : public Thread {
   }
 
  private:
+  // Get the keypoint locations of an image. The locations of the two most
+  // recently verified images are kept, so that consecutive pairs sharing an
+  // image neither convert its keypoints again nor contend for the cache.
+  // The entry of the other image in the current pair is never replaced.
+  const std::vector<Eigen::Vector2d>& GetPoints(const image_t image_id,
+                                                const image_t other_image_id) {
+    for (int i = 0; i < 2; ++i) {
+      if (points_image_ids_[i] == image_id) {
+        return points_[i];
+      }
+    }
+    const int index = points_image_ids_[0] == other_image_id ? 1 : 0;
+    points_image_ids_[index] = image_id;
+    points_[index] =
+        FeatureKeypointsToPointsVector(*cache_->GetKeypoints(image_id));
+    return points_[index];
+  }
+
   const TwoViewGeometryOptions options_;
   FeatureMatcherCache* cache_;
   JobQueue<Input>* input_queue_;
   JobQueue<Output>* output_queue_;
+  FeatureMatcherStats* stats_;
+  std::array<image_t, 2> points_image_ids_ = {{kInvalidImageId,
+                                               kInvalidImageId}};
+  std::array<std::vector<Eigen::Vector2d>, 2> points_;
 };
 
 }  // namespace
 
+FeatureMatcherWriter::FeatureMatcherWriter(
+    const SiftMatchingOptions& matching_options,
+    const TwoViewGeometryOptions& geometry_options,
+    FeatureMatcherCache* cache,
+    JobQueue<Input>* input_queue,
+    FeatureMatcherStats* stats)
+    : matching_options_(matching_options),
+      geometry_options_(geometry_options),
+      cache_(cache),
+      input_queue_(input_queue),
+      stats_(stats) {
+  THROW_CHECK(matching_options_.Check());
+  THROW_CHECK(geometry_options_.Check());
+}
+
+void FeatureMatcherWriter::WaitForNumProcessed(const size_t num_processed) {
+  std::unique_lock<std::mutex> lock(num_processed_mutex_);
+  num_processed_condition_.wait(
+      lock, [&]() { return num_processed_ >= num_processed; });
+}
+
+void FeatureMatcherWriter::Run() {
+  const size_t max_num_pairs =
+      static_cast<size_t>(matching_options_.max_num_pairs_per_commit);
+  const size_t max_num_bytes =
+      static_cast<size_t>(matching_options_.max_num_bytes_per_commit);
+
+  size_t num_pairs = 0;
+  size_t num_bytes = 0;
+
+  while (true) {
+    if (IsStopped()) {
+      break;
+    }
+
+    auto input_job = input_queue_->Pop();
+    if (input_job.IsValid()) {
+      auto& data = input_job.Data();
+
+      Timer timer;
+      timer.Start();
+      if (data.image_id1 == kInvalidImageId) {
+        if (num_pairs > 0) {
+          cache_->EndTransaction();
+          num_pairs = 0;
+          num_bytes = 0;
+        }
+        AddStats(stats_, FeatureMatcherStats::Stage::WRITE, timer, 0);
+      } else {
+        if (data.matches.size() <
+            static_cast<size_t>(geometry_options_.min_num_inliers)) {
+          data.matches = {};
+        }
+
+        if (data.two_view_geometry.inlier_matches.size() <
+            static_cast<size_t>(geometry_options_.min_num_inliers)) {
+          data.two_view_geometry = TwoViewGeometry();
+        }
+
+        if (num_pairs == 0) {
+          cache_->BeginTransaction();
+        }
+
+        cache_->WriteMatches(data.image_id1, data.image_id2, data.matches);
+        cache_->WriteTwoViewGeometry(
+            data.image_id1, data.image_id2, data.two_view_geometry);
+
+        num_pairs += 1;
+        num_bytes += sizeof(FeatureMatch) *
+                     (data.matches.size() +
+                      data.two_view_geometry.inlier_matches.size());
+        if (num_pairs >= max_num_pairs || num_bytes >= max_num_bytes) {
+          cache_->EndTransaction();
+          num_pairs = 0;
+          num_bytes = 0;
+        }
+        AddStats(stats_, FeatureMatcherStats::Stage::WRITE, timer);
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(num_processed_mutex_);
+        num_processed_ += 1;
+      }
+      num_processed_condition_.notify_all();
+    }
+  }
+
+  if (num_pairs > 0) {
+    cache_->EndTransaction();
+  }
+}
+
 FeatureMatcherController::FeatureMatcherController(
     const SiftMatchingOptions& matching_options,
     const TwoViewGeometryOptions& geometry_options,
@@ -218,7 +608,13 @@ FeatureMatcherController::FeatureMatcherController(
       geometry_options_(geometry_options),
       database_(database),
       cache_(cache),
-      is_setup_(false) {
+      is_setup_(false),
+      // The writer queue is bounded by the commit size, so it can use the
+      // preallocated lock-free ring buffer, unless the commit size is huge.
+      output_queue_(matching_options.max_num_pairs_per_commit,
+                    matching_options.max_num_pairs_per_commit <= 10000
+                        ? JobQueueType::LOCK_FREE
+                        : JobQueueType::LOCKING) {
   THROW_CHECK(matching_options_.Check());
   THROW_CHECK(geometry_options_.Check());
 
@@ -236,6 +632,18 @@ FeatureMatcherController::FeatureMatcherController(
     gpu_indices.resize(num_cuda_devices);
     std::iota(gpu_indices.begin(), gpu_indices.end(), 0);
   }
+
+  // Create multiple matchers per GPU, whose work overlaps on the device.
+  if (matching_options_.use_gpu && matching_options_.num_matchers_per_gpu > 1) {
+    std::vector<int> matcher_gpu_indices;
+    matcher_gpu_indices.reserve(gpu_indices.size() *
+                                matching_options_.num_matchers_per_gpu);
+    for (int i = 0; i < matching_options_.num_matchers_per_gpu; ++i) {
+      matcher_gpu_indices.insert(
+          matcher_gpu_indices.end(), gpu_indices.begin(), gpu_indices.end());
+    }
+    gpu_indices = std::move(matcher_gpu_indices);
+  }
 #endif  // COLMAP_CUDA_ENABLED
 
   if (matching_options_.use_gpu) {
@@ -250,7 +658,8 @@ FeatureMatcherController::FeatureMatcherController(
                                                  geometry_options_,
                                                  cache,
                                                  &matcher_queue_,
-                                                 &verifier_queue_));
+                                                 &verifier_queue_,
+                                                 &stats_));
     }
   } else {
     auto matching_options_copy = matching_options_;
@@ -263,7 +672,8 @@ FeatureMatcherController::FeatureMatcherController(
                                                  geometry_options_,
                                                  cache,
                                                  &matcher_queue_,
-                                                 &verifier_queue_));
+                                                 &verifier_queue_,
+                                                 &stats_));
     }
   }
 
@@ -271,8 +681,12 @@ FeatureMatcherController::FeatureMatcherController(
   if (matching_options_.guided_matching) {
     // Redirect the verification output to final round of guided matching.
     for (int i = 0; i < num_threads; ++i) {
-      verifiers_.emplace_back(std::make_unique<VerifierWorker>(
-          geometry_options_, cache, &verifier_queue_, &guided_matcher_queue_));
+      verifiers_.emplace_back(
+          std::make_unique<VerifierWorker>(geometry_options_,
+                                           cache,
+                                           &verifier_queue_,
+                                           &guided_matcher_queue_,
+                                           &stats_));
     }
 
     if (matching_options_.use_gpu) {
@@ -285,7 +699,8 @@ FeatureMatcherController::FeatureMatcherController(
                                                    geometry_options_,
                                                    cache,
                                                    &guided_matcher_queue_,
-                                                   &output_queue_));
+                                                   &output_queue_,
+                                                   &stats_));
       }
     } else {
       guided_matchers_.reserve(num_threads);
@@ -295,15 +710,23 @@ FeatureMatcherController::FeatureMatcherController(
                                                    geometry_options_,
                                                    cache,
                                                    &guided_matcher_queue_,
-                                                   &output_queue_));
+                                                   &output_queue_,
+                                                   &stats_));
       }
     }
   } else {
     for (int i = 0; i < num_threads; ++i) {
-      verifiers_.emplace_back(std::make_unique<VerifierWorker>(
-          geometry_options_, cache, &verifier_queue_, &output_queue_));
+      verifiers_.emplace_back(
+          std::make_unique<VerifierWorker>(geometry_options_,
+                                           cache,
+                                           &verifier_queue_,
+                                           &output_queue_,
+                                           &stats_));
     }
   }
+
+  writer_ = std::make_unique<FeatureMatcherWriter>(
+      matching_options_, geometry_options_, cache, &output_queue_, &stats_);
 }
 
 FeatureMatcherController::~FeatureMatcherController() {
@@ -324,6 +747,8 @@ FeatureMatcherController::~FeatureMatcherController() {
     guided_matcher->Stop();
   }
 
+  writer_->Stop();
+
   matcher_queue_.Stop();
   verifier_queue_.Stop();
   guided_matcher_queue_.Stop();
@@ -340,6 +765,8 @@ FeatureMatcherController::~FeatureMatcherController() {
   for (auto& guided_matcher : guided_matchers_) {
     guided_matcher->Wait();
   }
+
+  writer_->Wait();
 }
 
 bool FeatureMatcherController::Setup() {
@@ -364,6 +791,8 @@ bool FeatureMatcherController::Setup() {
     guided_matcher->Start();
   }
 
+  writer_->Start();
+
   for (auto& matcher : matchers_) {
     if (!matcher->CheckValidSetup()) {
       return false;
@@ -398,6 +827,11 @@ void FeatureMatcherController::Match(
   std::unordered_set<image_pair_t> image_pair_ids;
   image_pair_ids.reserve(image_pairs.size());
 
+  // Jobs are only pushed after prefetching the features of all involved images
+  // in one go, since the workers would otherwise read them one by one.
+  std::vector<FeatureMatcherData> matcher_jobs;
+  std::vector<FeatureMatcherData> verifier_jobs;
+
   size_t num_outputs = 0;
   for (const auto& image_pair : image_pairs) {
     // Avoid self-matches.
@@ -414,12 +848,22 @@ void FeatureMatcherController::Match(
 
     image_pair_ids.insert(pair_id);
 
+    // Skip image pairs of other shards.
+    if (matching_options_.num_shards > 1 &&
+        ImagePairToShardIndex(pair_id, matching_options_.num_shards) !=
+            matching_options_.shard_index) {
+      continue;
+    }
+
     const bool exists_matches =
         cache_->ExistsMatches(image_pair.first, image_pair.second);
     const bool exists_inlier_matches =
         cache_->ExistsInlierMatches(image_pair.first, image_pair.second);
 
-    if (exists_matches && exists_inlier_matches) {
+    // Verified pairs are only verified again from their stored matches, if
+    // requested, e.g., after changing the two-view geometry options.
+    if (exists_matches && exists_inlier_matches &&
+        !matching_options_.reverify_matches) {
       continue;
     }
 
@@ -428,7 +872,8 @@ void FeatureMatcherController::Match(
     // If only one of the matches or inlier matches exist, we recompute them
     // from scratch and delete the existing results. This must be done before
     // pushing the jobs to the queue, otherwise database constraints might fail
-    // when writing an existing result into the database.
+    // when writing an existing result into the database. Existing matches are
+    // only verified again.
 
     if (exists_inlier_matches) {
       cache_->DeleteInlierMatches(image_pair.first, image_pair.second);
@@ -441,37 +886,163 @@ void FeatureMatcherController::Match(
     if (exists_matches) {
       data.matches = cache_->GetMatches(image_pair.first, image_pair.second);
       cache_->DeleteMatches(image_pair.first, image_pair.second);
-      THROW_CHECK(verifier_queue_.Push(std::move(data)));
+      verifier_jobs.push_back(std::move(data));
+    } else {
+      matcher_jobs.push_back(std::move(data));
+    }
+  }
+
+  // The verification of existing matches only needs the keypoints, unless the
+  // verified pairs are matched again in guided matching.
+  std::vector<image_t> image_ids;
+  std::unordered_set<image_t> image_ids_set;
+  for (const auto& data : matcher_jobs) {
+    for (const image_t image_id : {data.image_id1, data.image_id2}) {
+      if (image_ids_set.insert(image_id).second) {
+        image_ids.push_back(image_id);
+      }
+    }
+  }
+  std::vector<image_t> verifier_image_ids;
+  for (const auto& data : verifier_jobs) {
+    for (const image_t image_id : {data.image_id1, data.image_id2}) {
+      if (image_ids_set.insert(image_id).second) {
+        verifier_image_ids.push_back(image_id);
+      }
+    }
+  }
+  cache_->Prefetch(image_ids);
+  cache_->Prefetch(verifier_image_ids,
+                   /*prefetch_descriptors=*/matching_options_.guided_matching);
+
+  for (auto& data : verifier_jobs) {
+    THROW_CHECK(verifier_queue_.Push(std::move(data)));
+  }
+
+  // Group the pairs by their first image, such that the matchers only set up
+  // the search structures of that image once for all its pairs. The size of
+  // the batches is limited to keep all matchers busy.
+  const size_t max_batch_size = std::max<size_t>(
+      1, (matcher_jobs.size() + matchers_.size() - 1) / matchers_.size());
+  std::vector<FeatureMatcherWorker::BatchInput> batches;
+  std::unordered_map<image_t, size_t> image_id1_to_batch_idx;
+  for (auto& data : matcher_jobs) {
+    auto it = image_id1_to_batch_idx.find(data.image_id1);
+    if (it == image_id1_to_batch_idx.end() ||
+        batches[it->second].size() >= max_batch_size) {
+      image_id1_to_batch_idx[data.image_id1] = batches.size();
+      batches.emplace_back();
+      batches.back().push_back(std::move(data));
     } else {
-      THROW_CHECK(matcher_queue_.Push(std::move(data)));
+      batches[it->second].push_back(std::move(data));
     }
   }
 
+  for (auto& batch : batches) {
+    THROW_CHECK(matcher_queue_.Push(std::move(batch)));
+  }
+
   //////////////////////////////////////////////////////////////////////////////
-  // Write results to database
+  // Wait for the results to be written to the database
   //////////////////////////////////////////////////////////////////////////////
 
-  for (size_t i = 0; i < num_outputs; ++i) {
-    auto output_job = output_queue_.Pop();
-    THROW_CHECK(output_job.IsValid());
-    auto& output = output_job.Data();
+  // Subsequent calls check for existing matches, so all results of this batch
+  // must be written before returning.
+  num_outputs_ += num_outputs;
+  writer_->WaitForNumProcessed(num_outputs_);
 
-    if (output.matches.size() <
-        static_cast<size_t>(geometry_options_.min_num_inliers)) {
-      output.matches = {};
-    }
+  THROW_CHECK_EQ(output_queue_.Size(), 0);
+}
+
+void FeatureMatcherController::Flush() {
+  THROW_CHECK(is_setup_);
+  // An output with invalid image identifiers commits the current transaction.
+  THROW_CHECK(output_queue_.Push(FeatureMatcherData()));
+  num_outputs_ += 1;
+  writer_->WaitForNumProcessed(num_outputs_);
+}
+
+void FeatureMatcherController::LogStats() {
+  THROW_CHECK(is_setup_);
 
-    if (output.two_view_geometry.inlier_matches.size() <
-        static_cast<size_t>(geometry_options_.min_num_inliers)) {
-      output.two_view_geometry = TwoViewGeometry();
+  struct WorkerStats {
+    std::string name;
+    size_t num_threads;
+    double input_wait_seconds;
+  };
+  const std::vector<WorkerStats> workers = {
+      {"matcher", matchers_.size(), matcher_queue_.GetStats().pop_wait_seconds},
+      {"verifier",
+       verifiers_.size(),
+       verifier_queue_.GetStats().pop_wait_seconds},
+      {"guided_matcher",
+       guided_matchers_.size(),
+       guided_matcher_queue_.GetStats().pop_wait_seconds},
+      {"writer", 1, output_queue_.GetStats().pop_wait_seconds}};
+
+  const std::vector<double>& bin_edges =
+      FeatureMatcherStats::HistogramBinEdges();
+
+  std::string json = "{\"histogram_bin_edges_milliseconds\": [";
+  for (size_t i = 0; i < bin_edges.size(); ++i) {
+    json += StringPrintf(i == 0 ? "%g" : ", %g", bin_edges[i]);
+  }
+  json += "], \"stages\": [";
+
+  LOG(INFO) << "Matching statistics:";
+  for (size_t i = 0; i < FeatureMatcherStats::kNumStages; ++i) {
+    const auto stage = static_cast<FeatureMatcherStats::Stage>(i);
+    const std::string name = FeatureMatcherStats::StageName(stage);
+    const FeatureMatcherStats::StageStats stage_stats = stats_.Get(stage);
+    const double milliseconds_per_pair =
+        stage_stats.num_pairs == 0
+            ? 0
+            : 1000 * stage_stats.seconds / stage_stats.num_pairs;
+    LOG(INFO) << StringPrintf("  %-13s %8d pairs in %9.1fs, %8.2fms per pair",
+                              (name + ":").c_str(),
+                              static_cast<int>(stage_stats.num_pairs),
+                              stage_stats.seconds,
+                              milliseconds_per_pair);
+    if (i > 0) {
+      json += ", ";
+    }
+    json += StringPrintf(
+        "{\"name\": \"%s\", \"num_pairs\": %d, \"seconds\": %.3f, "
+        "\"milliseconds_per_pair\": %.3f, \"histogram\": [",
+        name.c_str(),
+        static_cast<int>(stage_stats.num_pairs),
+        stage_stats.seconds,
+        milliseconds_per_pair);
+    for (size_t j = 0; j < stage_stats.histogram.size(); ++j) {
+      json += StringPrintf(j == 0 ? "%d" : ", %d",
+                           static_cast<int>(stage_stats.histogram[j]));
     }
+    json += "]}";
+  }
+  json += "], \"workers\": [";
 
-    cache_->WriteMatches(output.image_id1, output.image_id2, output.matches);
-    cache_->WriteTwoViewGeometry(
-        output.image_id1, output.image_id2, output.two_view_geometry);
+  for (size_t i = 0; i < workers.size(); ++i) {
+    const WorkerStats& worker = workers[i];
+    if (worker.num_threads == 0) {
+      continue;
+    }
+    LOG(INFO) << StringPrintf("  %-15s %2d threads waited %.1fs for input",
+                              (worker.name + ":").c_str(),
+                              static_cast<int>(worker.num_threads),
+                              worker.input_wait_seconds);
+    if (json.back() != '[') {
+      json += ", ";
+    }
+    json += StringPrintf(
+        "{\"name\": \"%s\", \"num_threads\": %d, "
+        "\"input_wait_seconds\": %.3f}",
+        worker.name.c_str(),
+        static_cast<int>(worker.num_threads),
+        worker.input_wait_seconds);
   }
+  json += "]}";
 
-  THROW_CHECK_EQ(output_queue_.Size(), 0);
+  LOG(INFO) << "Matching statistics (JSON): " << json;
 }
 
 }  // namespace colmap
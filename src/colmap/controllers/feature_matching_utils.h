@@ -37,7 +37,9 @@
 #include "colmap/util/threading.h"
 
 #include <array>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -50,22 +52,85 @@ struct FeatureMatcherData {
   TwoViewGeometry two_view_geometry;
 };
 
+// Thread-safe timing statistics of the matching pipeline stages, accumulated
+// over all threads of a stage. The time per image pair is additionally
+// collected in a histogram, e.g., to decide whether matching or verification
+// is the bottleneck and needs more GPUs or threads.
+class FeatureMatcherStats {
+ public:
+  enum class Stage {
+    // Reading keypoints and descriptors from the feature cache.
+    FETCH = 0,
+    // Coarse matching of SiftMatchingOptions::pre_filter_num_features.
+    PRE_FILTER = 1,
+    MATCH = 2,
+    VERIFY = 3,
+    GUIDED_MATCH = 4,
+    // Writing and committing the results to the database.
+    WRITE = 5,
+  };
+  static const size_t kNumStages = 6;
+
+  struct StageStats {
+    size_t num_pairs = 0;
+    double seconds = 0;
+    // Number of image pairs per bin of HistogramBinEdges().
+    std::vector<size_t> histogram;
+  };
+
+  // Upper bounds in milliseconds of the histogram bins. The last bin of the
+  // histogram has no upper bound.
+  static const std::vector<double>& HistogramBinEdges();
+
+  static std::string StageName(Stage stage);
+
+  // Add the time spent on a number of image pairs processed in one go, which
+  // is evenly attributed to the individual pairs.
+  void Add(Stage stage, double seconds, size_t num_pairs = 1);
+
+  StageStats Get(Stage stage) const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::array<StageStats, kNumStages> stages_;
+};
+
+// Matches image pairs popped from the input queue. Instead of single pairs,
+// the worker can consume batches of pairs with the same first image, which are
+// matched in one go to only set up the search structures of that image once.
 class FeatureMatcherWorker : public Thread {
  public:
   typedef FeatureMatcherData Input;
+  typedef std::vector<FeatureMatcherData> BatchInput;
   typedef FeatureMatcherData Output;
 
   FeatureMatcherWorker(const SiftMatchingOptions& matching_options,
                        const TwoViewGeometryOptions& geometry_options,
                        FeatureMatcherCache* cache,
                        JobQueue<Input>* input_queue,
-                       JobQueue<Output>* output_queue);
+                       JobQueue<Output>* output_queue,
+                       FeatureMatcherStats* stats = nullptr);
+  FeatureMatcherWorker(const SiftMatchingOptions& matching_options,
+                       const TwoViewGeometryOptions& geometry_options,
+                       FeatureMatcherCache* cache,
+                       JobQueue<BatchInput>* batch_input_queue,
+                       JobQueue<Output>* output_queue,
+                       FeatureMatcherStats* stats = nullptr);
 
   void SetMaxNumMatches(int max_num_matches);
 
  private:
   void Run() override;
 
+  void MatchBatch(FeatureMatcher* matcher, BatchInput* batch);
+
+  // Match the largest-scale features of the pairs, output the pairs with too
+  // few coarse matches without matching them fully, and keep the other pairs.
+  void PreFilterBatch(FeatureMatcher* matcher,
+                      std::vector<FeatureMatcherData*>* batch_data);
+  std::shared_ptr<const FeatureDescriptors> GetTopScaleDescriptors(
+      image_t image_id);
+
   std::shared_ptr<FeatureKeypoints> GetKeypointsPtr(int index,
                                                     image_t image_id);
   std::shared_ptr<FeatureDescriptors> GetDescriptorsPtr(int index,
@@ -74,8 +139,10 @@ class FeatureMatcherWorker : public Thread {
   SiftMatchingOptions matching_options_;
   TwoViewGeometryOptions geometry_options_;
   FeatureMatcherCache* cache_;
-  JobQueue<Input>* input_queue_;
+  JobQueue<Input>* input_queue_ = nullptr;
+  JobQueue<BatchInput>* batch_input_queue_ = nullptr;
   JobQueue<Output>* output_queue_;
+  FeatureMatcherStats* stats_;
 
   std::unique_ptr<OpenGLContextManager> opengl_context_;
 
@@ -85,11 +152,43 @@ class FeatureMatcherWorker : public Thread {
   std::array<std::shared_ptr<FeatureDescriptors>, 2> prev_descriptors_;
 };
 
+// Writes the matching results to the database in a separate thread. The
+// results are coalesced into transactions of at most the configured number of
+// image pairs and bytes, such that committing overlaps with ongoing matching.
+// An input with invalid image identifiers commits the current transaction.
+class FeatureMatcherWriter : public Thread {
+ public:
+  typedef FeatureMatcherData Input;
+
+  FeatureMatcherWriter(const SiftMatchingOptions& matching_options,
+                       const TwoViewGeometryOptions& geometry_options,
+                       FeatureMatcherCache* cache,
+                       JobQueue<Input>* input_queue,
+                       FeatureMatcherStats* stats = nullptr);
+
+  // Wait until the given total number of inputs has been processed.
+  void WaitForNumProcessed(size_t num_processed);
+
+ private:
+  void Run() override;
+
+  SiftMatchingOptions matching_options_;
+  TwoViewGeometryOptions geometry_options_;
+  FeatureMatcherCache* cache_;
+  JobQueue<Input>* input_queue_;
+  FeatureMatcherStats* stats_;
+
+  std::mutex num_processed_mutex_;
+  std::condition_variable num_processed_condition_;
+  size_t num_processed_ = 0;
+};
+
 // Multi-threaded and multi-GPU SIFT feature matcher, which writes the computed
 // results to the database and skips already matched image pairs. To improve
 // performance of the matching by taking advantage of caching and database
-// transactions, pass multiple images to the `Match` function. Note that the
-// database should be in an active transaction while calling `Match`.
+// transactions, pass multiple images to the `Match` function. The results are
+// written in transactions managed by the matcher, so the database must not be
+// in an active transaction while calling `Match`.
 class FeatureMatcherController {
  public:
   FeatureMatcherController(
@@ -103,9 +202,17 @@ class FeatureMatcherController {
   // Setup the matchers and return if successful.
   bool Setup();
 
-  // Match one batch of multiple image pairs.
+  // Match one batch of multiple image pairs. Returns once all results are
+  // written to the database, but they may not be committed yet.
   void Match(const std::vector<std::pair<image_t, image_t>>& image_pairs);
 
+  // Commit all results written to the database so far.
+  void Flush();
+
+  // Log the timing statistics of the pipeline stages for all image pairs
+  // matched so far, followed by a single line of JSON for further processing.
+  void LogStats();
+
  private:
   SiftMatchingOptions matching_options_;
   TwoViewGeometryOptions geometry_options_;
@@ -117,12 +224,18 @@ class FeatureMatcherController {
   std::vector<std::unique_ptr<FeatureMatcherWorker>> matchers_;
   std::vector<std::unique_ptr<FeatureMatcherWorker>> guided_matchers_;
   std::vector<std::unique_ptr<Thread>> verifiers_;
+  std::unique_ptr<FeatureMatcherWriter> writer_;
   std::unique_ptr<ThreadPool> thread_pool_;
 
-  JobQueue<FeatureMatcherData> matcher_queue_;
+  JobQueue<FeatureMatcherWorker::BatchInput> matcher_queue_;
   JobQueue<FeatureMatcherData> verifier_queue_;
   JobQueue<FeatureMatcherData> guided_matcher_queue_;
   JobQueue<FeatureMatcherData> output_queue_;
+
+  FeatureMatcherStats stats_;
+
+  // The total number of inputs pushed to the output queue.
+  size_t num_outputs_ = 0;
 };
 
 }  // namespace colmap
@@ -0,0 +1,330 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/controllers/global_mapper.h"
+
+#include "colmap/estimators/two_view_geometry.h"
+#include "colmap/math/math.h"
+#include "colmap/scene/database_cache.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/threading.h"
+#include "colmap/util/timer.h"
+
+#include <algorithm>
+#include <tuple>
+
+namespace colmap {
+namespace {
+
+struct ImagePairGeometry {
+  image_t image_id1 = kInvalidImageId;
+  image_t image_id2 = kInvalidImageId;
+  TwoViewGeometry two_view_geometry;
+};
+
+bool IsValidConfig(const int config) {
+  return config == TwoViewGeometry::ConfigurationType::CALIBRATED ||
+         config == TwoViewGeometry::ConfigurationType::PLANAR ||
+         config == TwoViewGeometry::ConfigurationType::PANORAMIC ||
+         config == TwoViewGeometry::ConfigurationType::PLANAR_OR_PANORAMIC;
+}
+
+// Whether the relative pose was estimated during geometric verification,
+// i.e., it differs from its default value.
+bool HasRelativePose(const TwoViewGeometry& two_view_geometry) {
+  const Rigid3d& cam2_from_cam1 = two_view_geometry.cam2_from_cam1;
+  return cam2_from_cam1.translation != Eigen::Vector3d::Zero() ||
+         cam2_from_cam1.rotation.coeffs() !=
+             Eigen::Quaterniond::Identity().coeffs();
+}
+
+// Read the verified image pairs of the cached images from the database and
+// estimate their relative poses, if they are not stored in the database.
+std::vector<ImagePairGeometry> ReadImagePairGeometries(
+    const Database& database,
+    const DatabaseCache& database_cache,
+    const size_t min_num_matches,
+    const int num_threads) {
+  std::vector<ImagePairGeometry> image_pairs;
+  database.ReadTwoViewGeometries(
+      [&](const image_pair_t pair_id, TwoViewGeometry two_view_geometry) {
+        if (!IsValidConfig(two_view_geometry.config) ||
+            two_view_geometry.inlier_matches.size() < min_num_matches) {
+          return;
+        }
+        ImagePairGeometry image_pair;
+        std::tie(image_pair.image_id1, image_pair.image_id2) =
+            Database::PairIdToImagePair(pair_id);
+        if (!database_cache.ExistsImage(image_pair.image_id1) ||
+            !database_cache.ExistsImage(image_pair.image_id2)) {
+          return;
+        }
+        image_pair.two_view_geometry = std::move(two_view_geometry);
+        image_pairs.push_back(std::move(image_pair));
+      });
+
+  auto EstimateRelativePose = [&database_cache](ImagePairGeometry* image_pair) {
+    const Image& image1 = database_cache.Image(image_pair->image_id1);
+    const Image& image2 = database_cache.Image(image_pair->image_id2);
+    std::vector<Eigen::Vector2d> points1;
+    points1.reserve(image1.NumPoints2D());
+    for (const auto& point2D : image1.Points2D()) {
+      points1.push_back(point2D.xy);
+    }
+    std::vector<Eigen::Vector2d> points2;
+    points2.reserve(image2.NumPoints2D());
+    for (const auto& point2D : image2.Points2D()) {
+      points2.push_back(point2D.xy);
+    }
+    if (!EstimateTwoViewGeometryPose(
+            database_cache.Camera(image1.CameraId()),
+            points1,
+            database_cache.Camera(image2.CameraId()),
+            points2,
+            &image_pair->two_view_geometry)) {
+      image_pair->two_view_geometry.config =
+          TwoViewGeometry::ConfigurationType::DEGENERATE;
+    }
+  };
+
+  ThreadPool thread_pool(num_threads);
+  size_t num_estimated_poses = 0;
+  for (auto& image_pair : image_pairs) {
+    if (!HasRelativePose(image_pair.two_view_geometry)) {
+      thread_pool.AddTask(EstimateRelativePose, &image_pair);
+      num_estimated_poses += 1;
+    }
+  }
+  thread_pool.Wait();
+
+  if (num_estimated_poses > 0) {
+    LOG(INFO) << "Estimated " << num_estimated_poses
+              << " relative poses missing in the database";
+  }
+
+  image_pairs.erase(std::remove_if(image_pairs.begin(),
+                                   image_pairs.end(),
+                                   [](const ImagePairGeometry& image_pair) {
+                                     return !IsValidConfig(
+                                         image_pair.two_view_geometry.config);
+                                   }),
+                    image_pairs.end());
+
+  return image_pairs;
+}
+
+}  // namespace
+
+bool GlobalMapperController::Options::Check() const {
+  CHECK_OPTION_GE(max_rotation_error_deg, 0);
+  rotation_averaging.Check();
+  positioning.Check();
+  incremental_options.Check();
+  return true;
+}
+
+GlobalMapperController::GlobalMapperController(
+    const Options& options,
+    std::shared_ptr<ReconstructionManager> reconstruction_manager)
+    : options_(options),
+      reconstruction_manager_(std::move(reconstruction_manager)) {
+  THROW_CHECK(options_.Check());
+}
+
+void GlobalMapperController::Run() {
+  Timer run_timer;
+  run_timer.Start();
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Load database
+  //////////////////////////////////////////////////////////////////////////////
+
+  PrintHeading1("Loading database");
+
+  const Database database(options_.database_path);
+  const size_t min_num_matches =
+      static_cast<size_t>(options_.incremental_options.min_num_matches);
+  std::shared_ptr<const DatabaseCache> database_cache = DatabaseCache::Create(
+      database,
+      min_num_matches,
+      options_.incremental_options.ignore_watermarks,
+      options_.incremental_options.image_names,
+      options_.incremental_options.correspondence_graph_cache_path,
+      options_.incremental_options.lazy_points2D,
+      static_cast<size_t>(options_.incremental_options.max_num_neighbors));
+
+  if (database_cache->NumImages() == 0) {
+    LOG(WARNING) << "No images with matches found in the database";
+    return;
+  }
+
+  const std::vector<ImagePairGeometry> image_pairs =
+      ReadImagePairGeometries(database,
+                              *database_cache,
+                              min_num_matches,
+                              options_.incremental_options.NumThreads());
+
+  LOG(INFO) << "Found " << image_pairs.size() << " image pairs";
+
+  if (CheckIfStopped()) {
+    return;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Rotation averaging
+  //////////////////////////////////////////////////////////////////////////////
+
+  PrintHeading1("Rotation averaging");
+
+  std::vector<std::pair<image_t, image_t>> image_pair_ids;
+  std::vector<Eigen::Quaterniond> cams2_from_cams1;
+  std::vector<double> weights;
+  image_pair_ids.reserve(image_pairs.size());
+  cams2_from_cams1.reserve(image_pairs.size());
+  weights.reserve(image_pairs.size());
+  for (const auto& image_pair : image_pairs) {
+    image_pair_ids.emplace_back(image_pair.image_id1, image_pair.image_id2);
+    cams2_from_cams1.push_back(
+        image_pair.two_view_geometry.cam2_from_cam1.rotation);
+    weights.push_back(image_pair.two_view_geometry.inlier_matches.size());
+  }
+
+  std::unordered_map<image_t, Eigen::Quaterniond> cams_from_world;
+  if (!EstimateGlobalRotations(options_.rotation_averaging,
+                               image_pair_ids,
+                               cams2_from_cams1,
+                               weights,
+                               &cams_from_world)) {
+    LOG(WARNING) << "Failed to estimate the rotations";
+    return;
+  }
+
+  LOG(INFO) << "Estimated rotations of " << cams_from_world.size()
+            << " images";
+
+  if (CheckIfStopped()) {
+    return;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Global positioning
+  //////////////////////////////////////////////////////////////////////////////
+
+  PrintHeading1("Global positioning");
+
+  // Only use the pairs consistent with the averaged rotations. Panoramic
+  // pairs have no translation and do not constrain the positions.
+  const double max_rotation_error = DegToRad(options_.max_rotation_error_deg);
+  std::vector<std::pair<image_t, image_t>> position_image_pair_ids;
+  std::vector<Eigen::Vector3d> cams2_from_cams1_translation;
+  for (const auto& image_pair : image_pairs) {
+    if (image_pair.two_view_geometry.config ==
+        TwoViewGeometry::ConfigurationType::PANORAMIC) {
+      continue;
+    }
+    const auto cam1_from_world = cams_from_world.find(image_pair.image_id1);
+    const auto cam2_from_world = cams_from_world.find(image_pair.image_id2);
+    if (cam1_from_world == cams_from_world.end() ||
+        cam2_from_world == cams_from_world.end()) {
+      continue;
+    }
+    const Rigid3d& cam2_from_cam1 = image_pair.two_view_geometry.cam2_from_cam1;
+    const double rotation_error = cam2_from_cam1.rotation.angularDistance(
+        cam2_from_world->second * cam1_from_world->second.inverse());
+    if (rotation_error > max_rotation_error) {
+      continue;
+    }
+    position_image_pair_ids.emplace_back(image_pair.image_id1,
+                                         image_pair.image_id2);
+    cams2_from_cams1_translation.push_back(cam2_from_cam1.translation);
+  }
+
+  LOG(INFO) << "Using " << position_image_pair_ids.size() << " / "
+            << image_pairs.size() << " image pairs";
+
+  GlobalPositioningOptions positioning_options = options_.positioning;
+  if (positioning_options.solver_options.num_threads < 0) {
+    positioning_options.solver_options.num_threads =
+        options_.incremental_options.NumThreads();
+  }
+
+  std::unordered_map<image_t, Eigen::Vector3d> proj_centers;
+  if (!EstimateGlobalPositions(positioning_options,
+                               position_image_pair_ids,
+                               cams2_from_cams1_translation,
+                               cams_from_world,
+                               &proj_centers)) {
+    LOG(WARNING) << "Failed to estimate the positions";
+    return;
+  }
+
+  LOG(INFO) << "Estimated positions of " << proj_centers.size() << " images";
+
+  if (CheckIfStopped()) {
+    return;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Triangulation and bundle adjustment
+  //////////////////////////////////////////////////////////////////////////////
+
+  PrintHeading1("Triangulation and bundle adjustment");
+
+  const size_t reconstruction_idx = reconstruction_manager_->Add();
+  std::shared_ptr<Reconstruction> reconstruction =
+      reconstruction_manager_->Get(reconstruction_idx);
+  reconstruction->Load(*database_cache);
+  for (const auto& proj_center : proj_centers) {
+    const image_t image_id = proj_center.first;
+    const Eigen::Quaterniond& cam_from_world = cams_from_world.at(image_id);
+    reconstruction->Image(image_id).CamFromWorld() =
+        Rigid3d(cam_from_world, -(cam_from_world * proj_center.second));
+    reconstruction->RegisterImage(image_id);
+  }
+
+  // The incremental mapper triangulates all registered images and then
+  // alternates between retriangulation, global bundle adjustment, and
+  // filtering of the observations.
+  IncrementalMapperController mapper(
+      std::make_shared<const IncrementalMapperOptions>(
+          options_.incremental_options),
+      options_.image_path,
+      options_.database_path,
+      database_cache,
+      reconstruction_manager_);
+  mapper.TriangulateReconstruction(reconstruction);
+
+  LOG(INFO) << "Reconstructed " << reconstruction->NumRegImages()
+            << " images and " << reconstruction->NumPoints3D() << " points";
+
+  run_timer.PrintMinutes();
+}
+
+}  // namespace colmap
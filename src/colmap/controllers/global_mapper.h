@@ -0,0 +1,86 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/controllers/incremental_mapper.h"
+#include "colmap/estimators/global_positioning.h"
+#include "colmap/estimators/rotation_averaging.h"
+#include "colmap/scene/reconstruction_manager.h"
+#include "colmap/util/base_controller.h"
+
+#include <memory>
+
+namespace colmap {
+
+// Global mapping estimates the poses of all images at once from the two-view
+// geometries of the database, instead of registering them one by one. First,
+// the rotations are estimated by rotation averaging and the projection
+// centers by averaging the translation directions. Then, all images are
+// triangulated and the reconstruction is refined by iterative global bundle
+// adjustment. This is typically much faster than incremental mapping for
+// larger scenes but less robust to wrong two-view geometries.
+class GlobalMapperController : public BaseController {
+ public:
+  struct Options {
+    // The path to the image folder which are used as input.
+    std::string image_path;
+
+    // The path to the database file which is used as input.
+    std::string database_path;
+
+    // The maximum angular error between the relative rotation of an image
+    // pair and the averaged rotations, before the pair is discarded for
+    // estimating the positions.
+    double max_rotation_error_deg = 10.0;
+
+    // Options for estimating the rotations and positions.
+    RotationAveragingOptions rotation_averaging;
+    GlobalPositioningOptions positioning;
+
+    // Options for loading the database and for triangulating and refining
+    // the reconstruction after the poses were estimated.
+    IncrementalMapperOptions incremental_options;
+
+    bool Check() const;
+  };
+
+  GlobalMapperController(
+      const Options& options,
+      std::shared_ptr<ReconstructionManager> reconstruction_manager);
+
+  void Run() override;
+
+ private:
+  const Options options_;
+  std::shared_ptr<ReconstructionManager> reconstruction_manager_;
+};
+
+}  // namespace colmap
@@ -30,37 +30,62 @@
 #include "colmap/controllers/hierarchical_mapper.h"
 
 #include "colmap/estimators/alignment.h"
+#include "colmap/scene/database_cache.h"
 #include "colmap/scene/scene_clustering.h"
 #include "colmap/sfm/observation_manager.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/threading.h"
 
+#include <atomic>
+#include <mutex>
+#include <set>
+
 namespace colmap {
 namespace {
 
-void MergeClusters(const SceneClustering::Cluster& cluster,
-                   std::unordered_map<const SceneClustering::Cluster*,
-                                      std::shared_ptr<ReconstructionManager>>*
-                       reconstruction_managers) {
+typedef std::unordered_map<const SceneClustering::Cluster*,
+                           std::shared_ptr<ReconstructionManager>>
+    ClusterReconstructionManagers;
+
+// Merges the reconstructions of all child clusters of the given cluster into
+// a new reconstruction manager for the cluster. The children must have been
+// merged before. Access to the reconstruction managers is synchronized by the
+// given mutex, such that clusters of disjoint subtrees can be merged in
+// parallel.
+void MergeChildClusters(
+    const SceneClustering::Cluster& cluster,
+    std::mutex* reconstruction_managers_mutex,
+    ClusterReconstructionManagers* reconstruction_managers) {
   // Extract all reconstructions from all child clusters.
   std::vector<std::shared_ptr<Reconstruction>> reconstructions;
-  for (const auto& child_cluster : cluster.child_clusters) {
-    if (!child_cluster.child_clusters.empty()) {
-      MergeClusters(child_cluster, reconstruction_managers);
-    }
-
-    auto& reconstruction_manager = reconstruction_managers->at(&child_cluster);
-    for (size_t i = 0; i < reconstruction_manager->Size(); ++i) {
-      reconstructions.push_back(reconstruction_manager->Get(i));
+  {
+    std::lock_guard<std::mutex> lock(*reconstruction_managers_mutex);
+    for (const auto& child_cluster : cluster.child_clusters) {
+      auto& reconstruction_manager =
+          reconstruction_managers->at(&child_cluster);
+      for (size_t i = 0; i < reconstruction_manager->Size(); ++i) {
+        reconstructions.push_back(reconstruction_manager->Get(i));
+      }
     }
   }
 
+  // Pairs of reconstructions that could not be merged. They are not tried
+  // again, unless one of them changed by merging with another reconstruction.
+  std::set<std::pair<const Reconstruction*, const Reconstruction*>>
+      failed_merges;
+
   // Try to merge all child cluster reconstruction.
   while (reconstructions.size() > 1) {
     bool merge_success = false;
     for (size_t i = 0; i < reconstructions.size(); ++i) {
       const int num_reg_images_i = reconstructions[i]->NumRegImages();
       for (size_t j = 0; j < i; ++j) {
+        const auto reconstruction_pair = std::make_pair(
+            reconstructions[j].get(), reconstructions[i].get());
+        if (failed_merges.count(reconstruction_pair) > 0) {
+          continue;
+        }
+
         const double kMaxReprojError = 8.0;
         const int num_reg_images_j = reconstructions[j]->NumRegImages();
         if (MergeAndFilterReconstructions(
@@ -70,10 +95,20 @@ void MergeClusters(const SceneClustering::Cluster& cluster,
               num_reg_images_i,
               num_reg_images_j,
               reconstructions[i]->NumRegImages());
+          for (auto it = failed_merges.begin(); it != failed_merges.end();) {
+            if (it->first == reconstructions[i].get() ||
+                it->second == reconstructions[i].get()) {
+              it = failed_merges.erase(it);
+            } else {
+              ++it;
+            }
+          }
           reconstructions.erase(reconstructions.begin() + j);
           merge_success = true;
           break;
         }
+
+        failed_merges.insert(reconstruction_pair);
       }
 
       if (merge_success) {
@@ -87,23 +122,88 @@ void MergeClusters(const SceneClustering::Cluster& cluster,
   }
 
   // Insert a new reconstruction manager for merged cluster.
-  auto& reconstruction_manager = (*reconstruction_managers)[&cluster];
-  reconstruction_manager = std::make_shared<ReconstructionManager>();
+  auto merged_reconstruction_manager =
+      std::make_shared<ReconstructionManager>();
   for (const auto& reconstruction : reconstructions) {
-    reconstruction_manager->Get(reconstruction_manager->Add()) = reconstruction;
+    merged_reconstruction_manager->Get(merged_reconstruction_manager->Add()) =
+        reconstruction;
   }
 
+  std::lock_guard<std::mutex> lock(*reconstruction_managers_mutex);
+  (*reconstruction_managers)[&cluster] =
+      std::move(merged_reconstruction_manager);
+
   // Delete all merged child cluster reconstruction managers.
   for (const auto& child_cluster : cluster.child_clusters) {
     reconstruction_managers->erase(&child_cluster);
   }
 }
 
+// Merges the clusters bottom-up, where the clusters at the same depth of the
+// tree are independent and thus merged in parallel.
+void MergeClusters(const SceneClustering::Cluster& root_cluster,
+                   int num_threads,
+                   ClusterReconstructionManagers* reconstruction_managers) {
+  std::vector<std::vector<const SceneClustering::Cluster*>> clusters_by_depth;
+  std::vector<const SceneClustering::Cluster*> clusters = {&root_cluster};
+  while (!clusters.empty()) {
+    std::vector<const SceneClustering::Cluster*> child_clusters;
+    for (const auto* cluster : clusters) {
+      for (const auto& child_cluster : cluster->child_clusters) {
+        if (!child_cluster.child_clusters.empty()) {
+          child_clusters.push_back(&child_cluster);
+        }
+      }
+    }
+    clusters_by_depth.push_back(std::move(clusters));
+    clusters = std::move(child_clusters);
+  }
+
+  std::mutex reconstruction_managers_mutex;
+  ThreadPool thread_pool(num_threads);
+  for (auto it = clusters_by_depth.rbegin(); it != clusters_by_depth.rend();
+       ++it) {
+    std::vector<std::future<void>> futures;
+    futures.reserve(it->size());
+    for (const auto* cluster : *it) {
+      futures.push_back(thread_pool.AddTask(MergeChildClusters,
+                                            std::cref(*cluster),
+                                            &reconstruction_managers_mutex,
+                                            reconstruction_managers));
+    }
+    for (auto& future : futures) {
+      future.get();
+    }
+  }
+}
+
+void MergeLeafClusters(const SceneClustering& scene_clustering,
+                       size_t num_leaf_clusters,
+                       int num_threads,
+                       ClusterReconstructionManagers* reconstruction_managers,
+                       ReconstructionManager* reconstruction_manager) {
+  if (num_leaf_clusters > 1) {
+    PrintHeading1("Merging clusters");
+
+    MergeClusters(*scene_clustering.GetRootCluster(),
+                  num_threads,
+                  reconstruction_managers);
+  }
+
+  THROW_CHECK_EQ(reconstruction_managers->size(), 1);
+  THROW_CHECK_GT(
+      reconstruction_managers->begin()->second->Get(0)->NumRegImages(), 0);
+  *reconstruction_manager = *reconstruction_managers->begin()->second;
+}
+
 }  // namespace
 
 bool HierarchicalMapperController::Options::Check() const {
   CHECK_OPTION_GT(init_num_trials, -1);
   CHECK_OPTION_GE(num_workers, -1);
+  if (!cluster_input_path.empty()) {
+    CHECK_OPTION(!cluster_manifest_path.empty());
+  }
   clustering_options.Check();
   THROW_CHECK_EQ(clustering_options.branching, 2);
   incremental_options.Check();
@@ -119,10 +219,17 @@ HierarchicalMapperController::HierarchicalMapperController(
 }
 
 void HierarchicalMapperController::Run() {
-  PrintHeading1("Partitioning scene");
   Timer run_timer;
   run_timer.Start();
 
+  if (!options_.cluster_input_path.empty()) {
+    MergeClusterReconstructions();
+    run_timer.PrintMinutes();
+    return;
+  }
+
+  PrintHeading1("Partitioning scene");
+
   //////////////////////////////////////////////////////////////////////////////
   // Cluster scene graph
   //////////////////////////////////////////////////////////////////////////////
@@ -152,6 +259,45 @@ void HierarchicalMapperController::Run() {
 
   LOG(INFO) << StringPrintf("Clusters have %d images", total_num_images);
 
+  if (!options_.cluster_manifest_path.empty()) {
+    LOG(INFO) << "Writing cluster manifest to "
+              << options_.cluster_manifest_path;
+    scene_clustering.Write(options_.cluster_manifest_path);
+    run_timer.PrintMinutes();
+    return;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Load database cache
+  //////////////////////////////////////////////////////////////////////////////
+
+  PrintHeading1("Loading database");
+
+  // Load the images of all clusters and their matches only once. The cluster
+  // reconstructions then extract their images from the shared cache instead
+  // of reading the database again.
+  std::unordered_set<std::string> image_names =
+      options_.incremental_options.image_names;
+  if (!image_names.empty()) {
+    for (const auto* cluster : leaf_clusters) {
+      for (const image_t image_id : cluster->image_ids) {
+        image_names.insert(image_id_to_name.at(image_id));
+      }
+    }
+  }
+
+  Timer load_timer;
+  load_timer.Start();
+  std::shared_ptr<const DatabaseCache> database_cache = DatabaseCache::Create(
+      database,
+      static_cast<size_t>(options_.incremental_options.min_num_matches),
+      options_.incremental_options.ignore_watermarks,
+      image_names,
+      options_.incremental_options.correspondence_graph_cache_path,
+      options_.incremental_options.lazy_points2D,
+      static_cast<size_t>(options_.incremental_options.max_num_neighbors));
+  load_timer.PrintMinutes();
+
   //////////////////////////////////////////////////////////////////////////////
   // Reconstruct clusters
   //////////////////////////////////////////////////////////////////////////////
@@ -167,14 +313,25 @@ void HierarchicalMapperController::Run() {
           ? std::min(static_cast<int>(leaf_clusters.size()),
                      std::min(kDefaultNumWorkers, num_eff_threads))
           : options_.num_workers;
-  const int num_threads_per_worker =
-      std::max(1, num_eff_threads / num_eff_workers);
+
+  // Distribute the threads among the clusters that are not finished yet. The
+  // reconstructions query their number of threads before every bundle
+  // adjustment, so that the remaining clusters get more threads as the
+  // workers run out of clusters and become idle.
+  std::atomic<int> num_unfinished_clusters(
+      static_cast<int>(leaf_clusters.size()));
+  auto NumThreadsPerWorker = [&]() {
+    const int num_busy_workers =
+        std::max(1, std::min(num_eff_workers, num_unfinished_clusters.load()));
+    return std::max(1, num_eff_threads / num_busy_workers);
+  };
 
   // Function to reconstruct one cluster using incremental mapping.
   auto ReconstructCluster =
       [&, this](const SceneClustering::Cluster& cluster,
                 std::shared_ptr<ReconstructionManager> reconstruction_manager) {
         if (cluster.image_ids.empty()) {
+          --num_unfinished_clusters;
           return;
         }
 
@@ -183,7 +340,7 @@ void HierarchicalMapperController::Run() {
         incremental_options->max_model_overlap = 3;
         incremental_options->init_num_trials = options_.init_num_trials;
         if (incremental_options->num_threads < 0) {
-          incremental_options->num_threads = num_threads_per_worker;
+          incremental_options->dynamic_num_threads = NumThreadsPerWorker;
         }
 
         for (const auto image_id : cluster.image_ids) {
@@ -194,8 +351,16 @@ void HierarchicalMapperController::Run() {
         IncrementalMapperController mapper(std::move(incremental_options),
                                            options_.image_path,
                                            options_.database_path,
+                                           database_cache,
                                            std::move(reconstruction_manager));
         mapper.Run();
+
+        // Accumulate the phase timings and counters of all clusters.
+        for (const auto& counter : mapper.GetMetrics().Counters()) {
+          GetMetrics().IncrementCounter(counter.first, counter.second);
+        }
+
+        --num_unfinished_clusters;
       };
 
   // Start reconstructing the bigger clusters first for better resource usage.
@@ -208,9 +373,7 @@ void HierarchicalMapperController::Run() {
 
   // Start the reconstruction workers. Use a separate reconstruction manager per
   // thread to avoid race conditions.
-  std::unordered_map<const SceneClustering::Cluster*,
-                     std::shared_ptr<ReconstructionManager>>
-      reconstruction_managers;
+  ClusterReconstructionManagers reconstruction_managers;
   reconstruction_managers.reserve(leaf_clusters.size());
 
   ThreadPool thread_pool(num_eff_workers);
@@ -221,23 +384,61 @@ void HierarchicalMapperController::Run() {
         ReconstructCluster, *cluster, reconstruction_managers[cluster]);
   }
   thread_pool.Wait();
+  database_cache.reset();
 
   //////////////////////////////////////////////////////////////////////////////
   // Merge clusters
   //////////////////////////////////////////////////////////////////////////////
 
-  if (leaf_clusters.size() > 1) {
-    PrintHeading1("Merging clusters");
+  MergeLeafClusters(scene_clustering,
+                    leaf_clusters.size(),
+                    GetEffectiveNumThreads(options_.num_workers),
+                    &reconstruction_managers,
+                    reconstruction_manager_.get());
 
-    MergeClusters(*scene_clustering.GetRootCluster(), &reconstruction_managers);
-  }
+  run_timer.PrintMinutes();
+}
 
-  THROW_CHECK_EQ(reconstruction_managers.size(), 1);
-  THROW_CHECK_GT(
-      reconstruction_managers.begin()->second->Get(0)->NumRegImages(), 0);
-  *reconstruction_manager_ = *reconstruction_managers.begin()->second;
+void HierarchicalMapperController::MergeClusterReconstructions() {
+  PrintHeading1("Reading clusters");
 
-  run_timer.PrintMinutes();
+  const SceneClustering scene_clustering =
+      SceneClustering::Read(options_.cluster_manifest_path);
+  const auto leaf_clusters = scene_clustering.GetLeafClusters();
+
+  // Each leaf cluster was reconstructed into a separate directory named by its
+  // index in the manifest with one sub-directory per reconstruction. Leaf
+  // clusters without any reconstruction are skipped during merging.
+  ClusterReconstructionManagers reconstruction_managers;
+  reconstruction_managers.reserve(leaf_clusters.size());
+  for (size_t i = 0; i < leaf_clusters.size(); ++i) {
+    auto& reconstruction_manager = reconstruction_managers[leaf_clusters[i]];
+    reconstruction_manager = std::make_shared<ReconstructionManager>();
+
+    const std::string cluster_path =
+        JoinPaths(options_.cluster_input_path, std::to_string(i));
+    if (!ExistsDir(cluster_path)) {
+      LOG(WARNING) << "Missing reconstructions of cluster " << i << " in "
+                   << cluster_path;
+      continue;
+    }
+
+    std::vector<std::string> reconstruction_paths = GetDirList(cluster_path);
+    std::sort(reconstruction_paths.begin(), reconstruction_paths.end());
+    for (const auto& reconstruction_path : reconstruction_paths) {
+      reconstruction_manager->Read(reconstruction_path);
+    }
+
+    LOG(INFO) << StringPrintf("  Cluster %d with %d reconstructions",
+                              static_cast<int>(i),
+                              static_cast<int>(reconstruction_manager->Size()));
+  }
+
+  MergeLeafClusters(scene_clustering,
+                    leaf_clusters.size(),
+                    GetEffectiveNumThreads(options_.num_workers),
+                    &reconstruction_managers,
+                    reconstruction_manager_.get());
 }
 
 }  // namespace colmap
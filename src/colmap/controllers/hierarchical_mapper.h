@@ -64,6 +64,16 @@ class HierarchicalMapperController : public BaseController {
     // Options used to reconstruction each cluster individually.
     IncrementalMapperOptions incremental_options;
 
+    // Manifest of the scene partition for distributed reconstruction. If
+    // only the manifest path is set, the controller partitions the scene,
+    // writes the manifest, and stops. Each leaf cluster can then be
+    // reconstructed by a separate `mapper --cluster_manifest_path
+    // --cluster_index` process into `cluster_input_path/<cluster_index>`.
+    // If the input path is also set, the controller reads the manifest and
+    // merges the collected leaf reconstructions instead.
+    std::string cluster_manifest_path;
+    std::string cluster_input_path;
+
     bool Check() const;
   };
 
@@ -74,6 +84,8 @@ class HierarchicalMapperController : public BaseController {
   void Run() override;
 
  private:
+  void MergeClusterReconstructions();
+
   const Options options_;
   std::shared_ptr<ReconstructionManager> reconstruction_manager_;
 };
@@ -32,7 +32,49 @@
 #include "colmap/sensor/models.h"
 #include "colmap/util/misc.h"
 
+#include <fstream>
+
 namespace colmap {
+namespace {
+
+// FNV-1a hash of the file size and content, which is processed in 64-bit words
+// and is much cheaper to compute than decoding the image. Returns zero, if the
+// file cannot be read, in which case decoding the image fails later anyway.
+uint64_t ComputeFileContentHash(const std::string& path) {
+  constexpr uint64_t kOffsetBasis = 14695981039346656037ULL;
+  constexpr uint64_t kPrime = 1099511628211ULL;
+  constexpr std::streamsize kChunkSize = 1 << 20;
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return 0;
+  }
+
+  std::vector<uint64_t> chunk(kChunkSize / sizeof(uint64_t));
+  uint64_t hash = kOffsetBasis;
+  uint64_t num_bytes = 0;
+  while (file) {
+    file.read(reinterpret_cast<char*>(chunk.data()), kChunkSize);
+    const std::streamsize num_read = file.gcount();
+    if (num_read <= 0) {
+      break;
+    }
+    // Zero-pad the last incomplete word.
+    const size_t num_words =
+        (num_read + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    std::fill(reinterpret_cast<char*>(chunk.data()) + num_read,
+              reinterpret_cast<char*>(chunk.data() + num_words),
+              0);
+    for (size_t i = 0; i < num_words; ++i) {
+      hash = (hash ^ chunk[i]) * kPrime;
+    }
+    num_bytes += num_read;
+  }
+
+  return (hash ^ num_bytes) * kPrime;
+}
+
+}  // namespace
 
 bool ImageReaderOptions::Check() const {
   CHECK_OPTION_GT(default_focal_length_factor, 0.0);
@@ -83,6 +125,16 @@ ImageReader::ImageReader(const ImageReaderOptions& options, Database* database)
       prev_camera_.has_prior_focal_length = true;
     }
   }
+
+  // Determine all images with existing features using a few bulk queries
+  // instead of querying the keypoints and descriptors of every image.
+  for (const Image& image : database_->ReadAllImages()) {
+    image_name_to_id_.emplace(image.Name(), image.ImageId());
+  }
+  image_ids_with_features_ = database_->ReadImageIdsWithFeatures();
+  if (options_.use_content_hash) {
+    content_hashes_ = database_->ReadAllImageContentHashes();
+  }
 }
 
 ImageReader::Status ImageReader::Next(Camera* camera,
@@ -90,6 +142,140 @@ ImageReader::Status ImageReader::Next(Camera* camera,
                                       PosePrior* pose_prior,
                                       Bitmap* bitmap,
                                       Bitmap* mask) {
+  DatabaseTransaction database_transaction(database_);
+  return NextImpl(camera, image, pose_prior, bitmap, mask, nullptr);
+}
+
+ImageReader::Status ImageReader::Next(Camera* camera,
+                                      Image* image,
+                                      PosePrior* pose_prior,
+                                      Bitmap* bitmap,
+                                      Bitmap* mask,
+                                      const Status read_status) {
+  DatabaseTransaction database_transaction(database_);
+  return NextImpl(camera, image, pose_prior, bitmap, mask, &read_status);
+}
+
+ImageReader::Status ImageReader::ReadBitmap(const size_t index,
+                                            Bitmap* bitmap,
+                                            Bitmap* mask) const {
+  THROW_CHECK_NOTNULL(bitmap);
+
+  if (!bitmap->Read(options_.image_list.at(index),
+                    /*as_rgb=*/false,
+                    /*min_size=*/options_.min_decode_size)) {
+    return Status::BITMAP_ERROR;
+  }
+
+  if (mask && !options_.mask_path.empty()) {
+    const std::string mask_path =
+        JoinPaths(options_.mask_path, ImageName(index) + ".png");
+    if (ExistsFile(mask_path) && !mask->Read(mask_path, false)) {
+      // NOTE: Maybe introduce a separate error type MASK_ERROR?
+      return Status::BITMAP_ERROR;
+    }
+  }
+
+  return Status::SUCCESS;
+}
+
+ImageReader::Status ImageReader::ReadHeader(const size_t index,
+                                            Bitmap* bitmap) const {
+  THROW_CHECK_NOTNULL(bitmap);
+
+  const std::string& path = options_.image_list.at(index);
+  if (!bitmap->ReadHeader(path) && !bitmap->Read(path, /*as_rgb=*/false)) {
+    return Status::BITMAP_ERROR;
+  }
+
+  return Status::SUCCESS;
+}
+
+size_t ImageReader::ImportNext(const size_t num_images,
+                               ThreadPool* thread_pool) {
+  THROW_CHECK_NOTNULL(thread_pool);
+
+  struct ImageHeader {
+    Status status = Status::FAILURE;
+    Bitmap bitmap;
+  };
+
+  const size_t end_index = std::min(image_index_ + num_images, NumImages());
+  std::vector<std::future<ImageHeader>> headers;
+  headers.reserve(end_index - image_index_);
+  for (size_t index = image_index_; index < end_index; ++index) {
+    headers.push_back(thread_pool->AddTask([this, index]() {
+      ImageHeader header;
+      header.status = ReadHeader(index, &header.bitmap);
+      return header;
+    }));
+  }
+
+  // The headers are consumed in the order of the images, so that the
+  // assignment of image and camera identifiers remains deterministic.
+  size_t num_imported = 0;
+  DatabaseTransaction database_transaction(database_);
+  for (auto& header_future : headers) {
+    ImageHeader header = header_future.get();
+    Camera camera;
+    Image image;
+    PosePrior pose_prior;
+    if (NextImpl(&camera,
+                 &image,
+                 &pose_prior,
+                 &header.bitmap,
+                 /*mask=*/nullptr,
+                 &header.status) != Status::SUCCESS ||
+        image.ImageId() != kInvalidImageId) {
+      continue;
+    }
+    image.SetImageId(database_->WriteImage(image));
+    if (pose_prior.IsValid()) {
+      database_->WritePosePrior(image.ImageId(), pose_prior);
+    }
+    num_imported += 1;
+  }
+
+  return num_imported;
+}
+
+bool ImageReader::ExistsFeatures(const size_t index) const {
+  const auto image_id = image_name_to_id_.find(ImageName(index));
+  if (image_id == image_name_to_id_.end() ||
+      image_ids_with_features_.count(image_id->second) == 0) {
+    return false;
+  }
+  if (!options_.use_content_hash) {
+    return true;
+  }
+  const auto content_hash = content_hashes_.find(image_id->second);
+  return content_hash == content_hashes_.end() ||
+         content_hash->second == ContentHash(index);
+}
+
+uint64_t ImageReader::ContentHash(const size_t index) const {
+  {
+    std::lock_guard<std::mutex> lock(image_content_hashes_mutex_);
+    const auto content_hash = image_content_hashes_.find(index);
+    if (content_hash != image_content_hashes_.end()) {
+      return content_hash->second;
+    }
+  }
+  // Compute the hash without holding the lock, so that the hashes of
+  // different images can be computed in parallel.
+  const uint64_t content_hash =
+      ComputeFileContentHash(options_.image_list.at(index));
+  std::lock_guard<std::mutex> lock(image_content_hashes_mutex_);
+  image_content_hashes_.emplace(index, content_hash);
+  return content_hash;
+}
+
+ImageReader::Status ImageReader::NextImpl(Camera* camera,
+                                          Image* image,
+                                          PosePrior* pose_prior,
+                                          Bitmap* bitmap,
+                                          Bitmap* mask,
+                                          const Status* read_status) {
   THROW_CHECK_NOTNULL(camera);
   THROW_CHECK_NOTNULL(image);
   THROW_CHECK_NOTNULL(bitmap);
@@ -97,19 +283,11 @@ ImageReader::Status ImageReader::Next(Camera* camera,
   image_index_ += 1;
   THROW_CHECK_LE(image_index_, options_.image_list.size());
 
-  const std::string image_path = options_.image_list.at(image_index_ - 1);
-
-  DatabaseTransaction database_transaction(database_);
-
   //////////////////////////////////////////////////////////////////////////////
   // Set the image name.
   //////////////////////////////////////////////////////////////////////////////
 
-  image->SetName(image_path);
-  image->SetName(StringReplace(image->Name(), "\\", "/"));
-  image->SetName(
-      image->Name().substr(options_.image_path.size(),
-                           image->Name().size() - options_.image_path.size()));
+  image->SetName(ImageName(image_index_ - 1));
 
   const std::string image_folder = GetParentDir(image->Name());
 
@@ -121,34 +299,47 @@ ImageReader::Status ImageReader::Next(Camera* camera,
 
   if (exists_image) {
     *image = database_->ReadImageWithName(image->Name());
-    const bool exists_keypoints = database_->ExistsKeypoints(image->ImageId());
-    const bool exists_descriptors =
-        database_->ExistsDescriptors(image->ImageId());
+    if (image_ids_with_features_.count(image->ImageId()) > 0) {
+      if (!options_.use_content_hash) {
+        return Status::IMAGE_EXISTS;
+      }
+
+      const uint64_t content_hash = ContentHash(image_index_ - 1);
+      const auto stored_content_hash = content_hashes_.find(image->ImageId());
+      if (stored_content_hash == content_hashes_.end()) {
+        // The features were extracted before storing content hashes, so
+        // assume that they are up to date.
+        database_->WriteImageContentHash(image->ImageId(), content_hash);
+        return Status::IMAGE_EXISTS;
+      } else if (stored_content_hash->second == content_hash) {
+        return Status::IMAGE_EXISTS;
+      }
 
-    if (exists_keypoints && exists_descriptors) {
-      return Status::IMAGE_EXISTS;
+      LOG(INFO) << "Image " << image->Name()
+                << " changed, extracting its features again";
+      database_->DeleteImageFeatures(image->ImageId());
     }
   }
 
   //////////////////////////////////////////////////////////////////////////////
-  // Read image.
+  // Read image and mask.
   //////////////////////////////////////////////////////////////////////////////
 
-  if (!bitmap->Read(image_path, false)) {
-    return Status::BITMAP_ERROR;
+  const Status status = read_status == nullptr
+                            ? ReadBitmap(image_index_ - 1, bitmap, mask)
+                            : *read_status;
+  if (status != Status::SUCCESS) {
+    return status;
   }
 
-  //////////////////////////////////////////////////////////////////////////////
-  // Read mask.
-  //////////////////////////////////////////////////////////////////////////////
-
-  if (mask && !options_.mask_path.empty()) {
-    const std::string mask_path =
-        JoinPaths(options_.mask_path, image->Name() + ".png");
-    if (ExistsFile(mask_path) && !mask->Read(mask_path, false)) {
-      // NOTE: Maybe introduce a separate error type MASK_ERROR?
-      return Status::BITMAP_ERROR;
-    }
+  // The bitmap may have been decoded at a reduced resolution, whereas the
+  // camera must be defined with respect to the original image.
+  // Formats without support for reading dimensions are never downscaled.
+  int width = bitmap->Width();
+  int height = bitmap->Height();
+  if (options_.min_decode_size > 0) {
+    Bitmap::ReadDimensions(
+        options_.image_list.at(image_index_ - 1), &width, &height);
   }
 
   //////////////////////////////////////////////////////////////////////////////
@@ -164,8 +355,8 @@ ImageReader::Status ImageReader::Next(Camera* camera,
       return Status::CAMERA_SINGLE_DIM_ERROR;
     }
 
-    if (static_cast<size_t>(bitmap->Width()) != current_camera.width ||
-        static_cast<size_t>(bitmap->Height()) != current_camera.height) {
+    if (static_cast<size_t>(width) != current_camera.width ||
+        static_cast<size_t>(height) != current_camera.height) {
       return Status::CAMERA_EXIST_DIM_ERROR;
     }
 
@@ -180,8 +371,8 @@ ImageReader::Status ImageReader::Next(Camera* camera,
         ((options_.single_camera && !options_.single_camera_per_folder) ||
          (options_.single_camera_per_folder &&
           image_folder == prev_image_folder_)) &&
-        (prev_camera_.width != static_cast<size_t>(bitmap->Width()) ||
-         prev_camera_.height != static_cast<size_t>(bitmap->Height()))) {
+        (prev_camera_.width != static_cast<size_t>(width) ||
+         prev_camera_.height != static_cast<size_t>(height))) {
       return Status::CAMERA_SINGLE_DIM_ERROR;
     }
 
@@ -193,8 +384,8 @@ ImageReader::Status ImageReader::Next(Camera* camera,
     if (camera_model_to_id_.count(camera_model) > 0) {
       Camera camera =
           database_->ReadCamera(camera_model_to_id_.at(camera_model));
-      if (camera.width != static_cast<size_t>(bitmap->Width()) ||
-          camera.height != static_cast<size_t>(bitmap->Height())) {
+      if (camera.width != static_cast<size_t>(width) ||
+          camera.height != static_cast<size_t>(height)) {
         return Status::CAMERA_EXIST_DIM_ERROR;
       }
       prev_camera_ = std::move(camera);
@@ -217,22 +408,25 @@ ImageReader::Status ImageReader::Next(Camera* camera,
         double focal_length = 0.0;
         bool has_focal_length = false;
         if (bitmap->ExifFocalLength(&focal_length)) {
+          // The focal length in pixels is relative to the decoded bitmap.
+          focal_length *= static_cast<double>(std::max(width, height)) /
+                          std::max(bitmap->Width(), bitmap->Height());
           has_focal_length = true;
         } else {
-          focal_length = options_.default_focal_length_factor *
-                         std::max(bitmap->Width(), bitmap->Height());
+          focal_length =
+              options_.default_focal_length_factor * std::max(width, height);
         }
 
         prev_camera_ = Camera::CreateFromModelId(prev_camera_.camera_id,
                                                  prev_camera_.model_id,
                                                  focal_length,
-                                                 bitmap->Width(),
-                                                 bitmap->Height());
+                                                 width,
+                                                 height);
         prev_camera_.has_prior_focal_length = has_focal_length;
       }
 
-      prev_camera_.width = static_cast<size_t>(bitmap->Width());
-      prev_camera_.height = static_cast<size_t>(bitmap->Height());
+      prev_camera_.width = static_cast<size_t>(width);
+      prev_camera_.height = static_cast<size_t>(height);
 
       if (!prev_camera_.VerifyParams()) {
         return Status::CAMERA_PARAM_ERROR;
@@ -271,4 +465,11 @@ size_t ImageReader::NextIndex() const { return image_index_; }
 
 size_t ImageReader::NumImages() const { return options_.image_list.size(); }
 
+std::string ImageReader::ImageName(const size_t index) const {
+  const std::string image_name =
+      StringReplace(options_.image_list.at(index), "\\", "/");
+  return image_name.substr(options_.image_path.size(),
+                           image_name.size() - options_.image_path.size());
+}
+
 }  // namespace colmap
@@ -34,6 +34,8 @@
 #include "colmap/sensor/bitmap.h"
 #include "colmap/util/threading.h"
 
+#include <mutex>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace colmap {
@@ -88,6 +90,20 @@ struct ImageReaderOptions {
   // intensity value 0 in grayscale).
   std::string camera_mask_path = "";
 
+  // If positive, JPEG images are decoded at a reduced resolution of 1/2, 1/4,
+  // or 1/8 using the DCT scaling of the decoder, such that the larger image
+  // dimension is still at least this size. Cameras are nevertheless created
+  // with the original image dimensions. Feature extraction sets this to the
+  // maximum image size, since larger images are downscaled anyway.
+  int min_decode_size = -1;
+
+  // Whether to store a hash of the file content of each image in the
+  // database. When re-running on existing images, images with unchanged
+  // content are skipped, while the features of modified images are deleted,
+  // including their matches, and extracted again. Images whose features were
+  // extracted without a stored hash are assumed to be unchanged.
+  bool use_content_hash = false;
+
   bool Check() const;
 };
 
@@ -113,10 +129,61 @@ class ImageReader {
               PosePrior* pose_prior,
               Bitmap* bitmap,
               Bitmap* mask);
+
+  // Same as above, but the bitmap and mask of the next image were already read
+  // with `ReadBitmap`, which returned the given status.
+  Status Next(Camera* camera,
+              Image* image,
+              PosePrior* pose_prior,
+              Bitmap* bitmap,
+              Bitmap* mask,
+              Status read_status);
+
+  // Read the bitmap and the optional mask of the image at the given index.
+  // This does not access the database and is thread-safe, such that images
+  // can be decoded in parallel before passing them to `Next` in order. Note
+  // that the bitmap may be smaller than the image, see `min_decode_size`.
+  Status ReadBitmap(size_t index, Bitmap* bitmap, Bitmap* mask) const;
+
+  // Read the dimensions and EXIF metadata of the image at the given index
+  // without decoding its pixels, if supported by the image format, and
+  // otherwise decode the image. The bitmap can be passed to `Next` instead of
+  // a decoded bitmap, if the pixels are not needed. This does not access the
+  // database and is thread-safe.
+  Status ReadHeader(size_t index, Bitmap* bitmap) const;
+
+  // Import the next images into the database without extracting features,
+  // i.e., write their cameras, images, and pose priors. The headers of at most
+  // `num_images` images are read in parallel using the given thread pool and
+  // the images are written in a single transaction. Returns the number of
+  // newly written images.
+  size_t ImportNext(size_t num_images, ThreadPool* thread_pool);
+
+  // Whether the features of the image at the given index already exist in the
+  // database and are up to date, in which case `Next` does not need its
+  // bitmap. The database is scanned once on construction, such that this
+  // does not access the database and is thread-safe.
+  bool ExistsFeatures(size_t index) const;
+
+  // Hash of the file content of the image at the given index. The hash is
+  // computed once and cached, such that it is cheap to query it repeatedly.
+  // This is thread-safe.
+  uint64_t ContentHash(size_t index) const;
+
   size_t NextIndex() const;
   size_t NumImages() const;
 
  private:
+  // Must be called within a transaction of the database.
+  Status NextImpl(Camera* camera,
+                  Image* image,
+                  PosePrior* pose_prior,
+                  Bitmap* bitmap,
+                  Bitmap* mask,
+                  const Status* read_status);
+
+  std::string ImageName(size_t index) const;
+
   // Image reader options.
   ImageReaderOptions options_;
   Database* database_;
@@ -128,6 +195,14 @@ class ImageReader {
   // Names of image sub-folders.
   std::string prev_image_folder_;
   std::unordered_set<std::string> image_folders_;
+  // State of the database on construction, such that the existence of
+  // features does not need to be queried for every image.
+  std::unordered_map<std::string, image_t> image_name_to_id_;
+  std::unordered_set<image_t> image_ids_with_features_;
+  std::unordered_map<image_t, uint64_t> content_hashes_;
+  // Content hashes of images in the current image list by index.
+  mutable std::mutex image_content_hashes_mutex_;
+  mutable std::unordered_map<size_t, uint64_t> image_content_hashes_;
 };
 
 }  // namespace colmap
@@ -29,16 +29,24 @@
 
 #include "colmap/controllers/incremental_mapper.h"
 
+#include "colmap/scene/reconstruction_snapshot.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/timer.h"
 
+#include <atomic>
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
 namespace colmap {
 namespace {
 
 void IterativeGlobalRefinement(const IncrementalMapperOptions& options,
                                const IncrementalMapper::Options& mapper_options,
-                               IncrementalMapper& mapper) {
+                               IncrementalMapper& mapper,
+                               Metrics& metrics) {
   LOG(INFO) << "Retriangulation and Global bundle adjustment";
+  metrics.IncrementCounter("num_global_refinements");
   mapper.IterativeGlobalRefinement(options.ba_global_max_refinements,
                                    options.ba_global_max_refinement_change,
                                    mapper_options,
@@ -58,7 +66,8 @@ void ExtractColors(const std::string& image_path,
 }
 
 void WriteSnapshot(const Reconstruction& reconstruction,
-                   const std::string& snapshot_path) {
+                   const std::string& snapshot_path,
+                   IncrementalSnapshotWriter* incremental_writer) {
   LOG(INFO) << "Creating snapshot";
   // Get the current timestamp in milliseconds.
   const size_t timestamp =
@@ -70,7 +79,64 @@ void WriteSnapshot(const Reconstruction& reconstruction,
       JoinPaths(snapshot_path, StringPrintf("%010d", timestamp));
   CreateDirIfNotExists(path);
   VLOG(1) << "=> Writing to " << path;
-  reconstruction.Write(path);
+  if (incremental_writer != nullptr) {
+    incremental_writer->Write(reconstruction, path);
+  } else {
+    reconstruction.Write(path);
+  }
+}
+
+// Find the connected components of the images in the correspondence graph,
+// sorted by decreasing size.
+std::vector<std::vector<image_t>> FindConnectedComponents(
+    const DatabaseCache& database_cache) {
+  std::unordered_map<image_t, image_t> parents;
+  parents.reserve(database_cache.NumImages());
+  for (const auto& image : database_cache.Images()) {
+    parents.emplace(image.first, image.first);
+  }
+
+  const auto find_root = [&parents](image_t image_id) {
+    while (parents.at(image_id) != image_id) {
+      image_t& parent = parents.at(image_id);
+      parent = parents.at(parent);
+      image_id = parent;
+    }
+    return image_id;
+  };
+
+  const auto& correspondence_graph = *database_cache.CorrespondenceGraph();
+  for (const auto& num_corrs :
+       correspondence_graph.NumCorrespondencesBetweenImages()) {
+    const auto image_pair = Database::PairIdToImagePair(num_corrs.first);
+    const image_t root1 = find_root(image_pair.first);
+    const image_t root2 = find_root(image_pair.second);
+    if (root1 != root2) {
+      parents.at(std::max(root1, root2)) = std::min(root1, root2);
+    }
+  }
+
+  std::unordered_map<image_t, std::vector<image_t>> root_to_component;
+  for (const auto& image : database_cache.Images()) {
+    root_to_component[find_root(image.first)].push_back(image.first);
+  }
+
+  std::vector<std::vector<image_t>> components;
+  components.reserve(root_to_component.size());
+  for (auto& component : root_to_component) {
+    std::sort(component.second.begin(), component.second.end());
+    components.push_back(std::move(component.second));
+  }
+  std::sort(components.begin(),
+            components.end(),
+            [](const std::vector<image_t>& component1,
+               const std::vector<image_t>& component2) {
+              if (component1.size() == component2.size()) {
+                return component1.front() < component2.front();
+              }
+              return component1.size() > component2.size();
+            });
+  return components;
 }
 
 }  // namespace
@@ -82,9 +148,12 @@ IncrementalMapper::Options IncrementalMapperOptions::Mapper() const {
   options.min_focal_length_ratio = min_focal_length_ratio;
   options.max_focal_length_ratio = max_focal_length_ratio;
   options.max_extra_param = max_extra_param;
-  options.num_threads = num_threads;
+  options.num_threads = NumThreads();
   options.local_ba_num_images = ba_local_num_images;
   options.fix_existing_images = fix_existing_images;
+  options.ba_global_reuse_problem = ba_global_reuse_problem;
+  options.ba_global_max_num_images_per_partition =
+      ba_global_max_num_images_per_partition;
   return options;
 }
 
@@ -106,14 +175,16 @@ BundleAdjustmentOptions IncrementalMapperOptions::LocalBundleAdjustment()
   options.solver_options.max_num_iterations = ba_local_max_num_iterations;
   options.solver_options.max_linear_solver_iterations = 100;
   options.solver_options.logging_type = ceres::LoggingType::SILENT;
-  options.solver_options.num_threads = num_threads;
+  options.solver_options.num_threads = NumThreads();
 #if CERES_VERSION_MAJOR < 2
-  options.solver_options.num_linear_solver_threads = num_threads;
+  options.solver_options.num_linear_solver_threads =
+      options.solver_options.num_threads;
 #endif  // CERES_VERSION_MAJOR
   options.print_summary = false;
   options.refine_focal_length = ba_refine_focal_length;
   options.refine_principal_point = ba_refine_principal_point;
   options.refine_extra_params = ba_refine_extra_params;
+  options.use_analytic_jacobians = ba_use_analytic_jacobians;
   options.min_num_residuals_for_multi_threading =
       ba_min_num_residuals_for_multi_threading;
   options.loss_function_scale = 1.0;
@@ -133,14 +204,20 @@ BundleAdjustmentOptions IncrementalMapperOptions::GlobalBundleAdjustment()
   options.solver_options.logging_type =
       ceres::LoggingType::PER_MINIMIZER_ITERATION;
   options.solver_options.minimizer_progress_to_stdout = false;
-  options.solver_options.num_threads = num_threads;
+  options.solver_options.num_threads = NumThreads();
 #if CERES_VERSION_MAJOR < 2
-  options.solver_options.num_linear_solver_threads = num_threads;
+  options.solver_options.num_linear_solver_threads =
+      options.solver_options.num_threads;
 #endif  // CERES_VERSION_MAJOR
   options.print_summary = false;
   options.refine_focal_length = ba_refine_focal_length;
   options.refine_principal_point = ba_refine_principal_point;
   options.refine_extra_params = ba_refine_extra_params;
+  options.use_analytic_jacobians = ba_use_analytic_jacobians;
+  options.use_gpu = ba_global_use_gpu;
+  options.gpu_index = ba_global_gpu_index;
+  options.points3D_subsampling_num_levels =
+      ba_global_points3D_subsampling_num_levels;
   options.min_num_residuals_for_multi_threading =
       ba_min_num_residuals_for_multi_threading;
   options.loss_function_type =
@@ -148,8 +225,16 @@ BundleAdjustmentOptions IncrementalMapperOptions::GlobalBundleAdjustment()
   return options;
 }
 
+int IncrementalMapperOptions::NumThreads() const {
+  if (dynamic_num_threads) {
+    return dynamic_num_threads();
+  }
+  return num_threads;
+}
+
 bool IncrementalMapperOptions::Check() const {
   CHECK_OPTION_GT(min_num_matches, 0);
+  CHECK_OPTION_GE(max_num_neighbors, 0);
   CHECK_OPTION_GT(max_num_models, 0);
   CHECK_OPTION_GT(max_model_overlap, 0);
   CHECK_OPTION_GE(min_model_size, 0);
@@ -163,12 +248,21 @@ bool IncrementalMapperOptions::Check() const {
   CHECK_OPTION_GT(ba_global_points_ratio, 1.0);
   CHECK_OPTION_GT(ba_global_images_freq, 0);
   CHECK_OPTION_GT(ba_global_points_freq, 0);
+  CHECK_OPTION_GE(ba_global_max_reproj_error_drift, 0);
   CHECK_OPTION_GT(ba_global_max_num_iterations, 0);
+  CHECK_OPTION_GE(ba_global_points3D_subsampling_num_levels, 0);
   CHECK_OPTION_GT(ba_local_max_refinements, 0);
   CHECK_OPTION_GE(ba_local_max_refinement_change, 0);
   CHECK_OPTION_GT(ba_global_max_refinements, 0);
   CHECK_OPTION_GE(ba_global_max_refinement_change, 0);
+  CHECK_OPTION_GE(reg_batch_size, 1);
+  CHECK_OPTION_GE(reg_batch_min_num_visible_points3D, 0);
   CHECK_OPTION_GE(snapshot_images_freq, 0);
+  CHECK_OPTION_GE(checkpoint_images_freq, 0);
+  CHECK_OPTION_GE(num_component_workers, 1);
+  if (checkpoint_images_freq > 0 || resume) {
+    CHECK_OPTION(!checkpoint_path.empty());
+  }
   CHECK_OPTION(Mapper().Check());
   CHECK_OPTION(Triangulation().Check());
   return true;
@@ -189,6 +283,20 @@ IncrementalMapperController::IncrementalMapperController(
   RegisterCallback(LAST_IMAGE_REG_CALLBACK);
 }
 
+IncrementalMapperController::IncrementalMapperController(
+    std::shared_ptr<const IncrementalMapperOptions> options,
+    const std::string& image_path,
+    const std::string& database_path,
+    std::shared_ptr<const class DatabaseCache> shared_database_cache,
+    std::shared_ptr<class ReconstructionManager> reconstruction_manager)
+    : IncrementalMapperController(std::move(options),
+                                  image_path,
+                                  database_path,
+                                  std::move(reconstruction_manager)) {
+  THROW_CHECK_NOTNULL(shared_database_cache);
+  shared_database_cache_ = std::move(shared_database_cache);
+}
+
 void IncrementalMapperController::Run() {
   Timer run_timer;
   run_timer.Start();
@@ -196,7 +304,21 @@ void IncrementalMapperController::Run() {
     return;
   }
 
+  // Independent components are only reconstructed concurrently when starting
+  // from scratch without a given initial image or checkpoints.
+  if (options_->num_component_workers > 1 && options_->multiple_models &&
+      reconstruction_manager_->Size() == 0 && options_->init_image_id1 == -1 &&
+      options_->init_image_id2 == -1 && options_->checkpoint_images_freq == 0 &&
+      !options_->resume && ReconstructComponents()) {
+    run_timer.PrintMinutes();
+    return;
+  }
+
   IncrementalMapper::Options init_mapper_options = options_->Mapper();
+  if (options_->resume && ReadCheckpoint()) {
+    init_mapper_options.init_min_num_inliers = progress_.init_min_num_inliers;
+    init_mapper_options.init_min_tri_angle = progress_.init_min_tri_angle;
+  }
   Reconstruct(init_mapper_options);
 
   const size_t kNumInitRelaxations = 2;
@@ -218,6 +340,8 @@ void IncrementalMapperController::Run() {
     Reconstruct(init_mapper_options);
   }
 
+  WaitForCheckpoint();
+
   run_timer.PrintMinutes();
 }
 
@@ -235,12 +359,24 @@ bool IncrementalMapperController::LoadDatabase() {
     }
   }
 
-  Database database(database_path_);
   Timer timer;
   timer.Start();
-  const size_t min_num_matches = static_cast<size_t>(options_->min_num_matches);
-  database_cache_ = DatabaseCache::Create(
-      database, min_num_matches, options_->ignore_watermarks, image_names);
+  if (shared_database_cache_ != nullptr) {
+    database_cache_ =
+        DatabaseCache::CreateFromCache(*shared_database_cache_, image_names);
+  } else {
+    Database database(database_path_);
+    const size_t min_num_matches =
+        static_cast<size_t>(options_->min_num_matches);
+    database_cache_ =
+        DatabaseCache::Create(database,
+                              min_num_matches,
+                              options_->ignore_watermarks,
+                              image_names,
+                              options_->correspondence_graph_cache_path,
+                              options_->lazy_points2D,
+                              static_cast<size_t>(options_->max_num_neighbors));
+  }
   timer.PrintMinutes();
 
   if (database_cache_->NumImages() == 0) {
@@ -311,15 +447,71 @@ IncrementalMapperController::InitializeReconstruction(
 bool IncrementalMapperController::CheckRunGlobalRefinement(
     const Reconstruction& reconstruction,
     const size_t ba_prev_num_reg_images,
-    const size_t ba_prev_num_points) {
-  return reconstruction.NumRegImages() >=
-             options_->ba_global_images_ratio * ba_prev_num_reg_images ||
-         reconstruction.NumRegImages() >=
-             options_->ba_global_images_freq + ba_prev_num_reg_images ||
-         reconstruction.NumPoints3D() >=
-             options_->ba_global_points_ratio * ba_prev_num_points ||
-         reconstruction.NumPoints3D() >=
-             options_->ba_global_points_freq + ba_prev_num_points;
+    const size_t ba_prev_num_points,
+    const double ba_prev_mean_reproj_error) {
+  const size_t num_reg_images = reconstruction.NumRegImages();
+  const size_t num_points = reconstruction.NumPoints3D();
+
+  // The absolute growth limits always trigger global bundle adjustment to
+  // bound the drift accumulated in the unrefined parts of the model.
+  if (num_reg_images >=
+      options_->ba_global_images_freq + ba_prev_num_reg_images) {
+    LOG(INFO) << StringPrintf(
+        "Global bundle adjustment triggered by %d new images",
+        num_reg_images - ba_prev_num_reg_images);
+    return true;
+  }
+  if (num_points >= options_->ba_global_points_freq + ba_prev_num_points) {
+    LOG(INFO) << StringPrintf(
+        "Global bundle adjustment triggered by %d new points",
+        num_points - ba_prev_num_points);
+    return true;
+  }
+
+  const bool images_ratio_reached =
+      num_reg_images >=
+      options_->ba_global_images_ratio * ba_prev_num_reg_images;
+  const bool points_ratio_reached =
+      num_points >= options_->ba_global_points_ratio * ba_prev_num_points;
+  if (!images_ratio_reached && !points_ratio_reached) {
+    return false;
+  }
+
+  const std::string growth_reason = StringPrintf(
+      "growth of %d to %d images and %d to %d points",
+      ba_prev_num_reg_images,
+      num_reg_images,
+      ba_prev_num_points,
+      num_points);
+
+  // In adaptive mode, the relative growth only triggers global bundle
+  // adjustment, if the local refinements could not keep the mean
+  // reprojection error from drifting since the last global refinement.
+  if (options_->ba_global_adaptive && ba_prev_mean_reproj_error > 0) {
+    const double mean_reproj_error =
+        reconstruction.ComputeMeanReprojectionError();
+    const double reproj_error_drift =
+        mean_reproj_error / ba_prev_mean_reproj_error - 1;
+    if (reproj_error_drift < options_->ba_global_max_reproj_error_drift) {
+      VLOG(2) << StringPrintf(
+          "Postponing global bundle adjustment after %s, reprojection error "
+          "drift: %.2f%%",
+          growth_reason.c_str(),
+          100 * reproj_error_drift);
+      return false;
+    }
+    LOG(INFO) << StringPrintf(
+        "Global bundle adjustment triggered by %s and reprojection error "
+        "drift of %.2f%% (%.3fpx to %.3fpx)",
+        growth_reason.c_str(),
+        100 * reproj_error_drift,
+        ba_prev_mean_reproj_error,
+        mean_reproj_error);
+    return true;
+  }
+
+  LOG(INFO) << "Global bundle adjustment triggered by " << growth_reason;
+  return true;
 }
 
 IncrementalMapperController::Status
@@ -328,6 +520,10 @@ IncrementalMapperController::ReconstructSubModel(
     const IncrementalMapper::Options& mapper_options,
     const std::shared_ptr<Reconstruction>& reconstruction) {
   mapper.BeginReconstruction(reconstruction);
+  if (resume_state_) {
+    mapper.SetState(*resume_state_);
+    resume_state_.reset();
+  }
 
   ////////////////////////////////////////////////////////////////////////////
   // Register initial pair
@@ -348,8 +544,12 @@ IncrementalMapperController::ReconstructSubModel(
   ////////////////////////////////////////////////////////////////////////////
 
   size_t snapshot_prev_num_reg_images = reconstruction->NumRegImages();
+  IncrementalSnapshotWriter snapshot_writer;
+  size_t checkpoint_prev_num_reg_images = reconstruction->NumRegImages();
   size_t ba_prev_num_reg_images = reconstruction->NumRegImages();
   size_t ba_prev_num_points = reconstruction->NumPoints3D();
+  double ba_prev_mean_reproj_error =
+      reconstruction->ComputeMeanReprojectionError();
 
   bool reg_next_success = true;
   bool prev_reg_next_success = true;
@@ -369,9 +569,22 @@ IncrementalMapperController::ReconstructSubModel(
     }
 
     image_t next_image_id;
-    for (size_t reg_trial = 0; reg_trial < next_images.size(); ++reg_trial) {
+    size_t reg_trial = 0;
+    for (; reg_trial < next_images.size(); ++reg_trial) {
       next_image_id = next_images[reg_trial];
 
+      const size_t num_parallel_reg_candidates =
+          static_cast<size_t>(mapper_options.num_parallel_reg_candidates);
+      if (num_parallel_reg_candidates > 1 &&
+          reg_trial % num_parallel_reg_candidates == 0) {
+        const size_t num_candidates = std::min(
+            num_parallel_reg_candidates, next_images.size() - reg_trial);
+        mapper.EstimateNextImagePoses(
+            mapper_options,
+            {next_images.begin() + reg_trial,
+             next_images.begin() + reg_trial + num_candidates});
+      }
+
       LOG(INFO) << StringPrintf("Registering image #%d (%d)",
                                 next_image_id,
                                 reconstruction->NumRegImages() + 1);
@@ -400,32 +613,111 @@ IncrementalMapperController::ReconstructSubModel(
     }
 
     if (reg_next_success) {
-      mapper.TriangulateImage(options_->Triangulation(), next_image_id);
+      // Register further well-constrained candidates before triangulation and
+      // local refinement, so that these are done once for the whole batch.
+      std::vector<image_t> batch_image_ids = {next_image_id};
+      const size_t reg_batch_size =
+          static_cast<size_t>(options_->reg_batch_size);
+      for (++reg_trial; reg_trial < next_images.size() &&
+                        batch_image_ids.size() < reg_batch_size;
+           ++reg_trial) {
+        const image_t image_id = next_images[reg_trial];
+        const size_t num_visible_points3D =
+            mapper.ObservationManager().NumVisiblePoints3D(image_id);
+        if (num_visible_points3D <
+            static_cast<size_t>(options_->reg_batch_min_num_visible_points3D)) {
+          // Candidates are sorted by their rank, which is often correlated
+          // with the number of visible points, so stop at the first one.
+          break;
+        }
+
+        LOG(INFO) << StringPrintf("Registering image #%d (%d) in batch",
+                                  image_id,
+                                  reconstruction->NumRegImages() + 1);
+        LOG(INFO) << StringPrintf(
+            "=> Image sees %d / %d points",
+            num_visible_points3D,
+            mapper.ObservationManager().NumObservations(image_id));
+
+        if (mapper.RegisterNextImage(mapper_options, image_id)) {
+          batch_image_ids.push_back(image_id);
+        } else {
+          LOG(INFO) << "=> Could not register, skipping image in batch.";
+        }
+      }
+
+      for (const image_t image_id : batch_image_ids) {
+        mapper.TriangulateImage(options_->Triangulation(), image_id);
+      }
       mapper.IterativeLocalRefinement(options_->ba_local_max_refinements,
                                       options_->ba_local_max_refinement_change,
                                       mapper_options,
                                       options_->LocalBundleAdjustment(),
                                       options_->Triangulation(),
                                       next_image_id);
+      GetMetrics().IncrementCounter("num_local_refinements");
+
+      // In sequential mode, the drift of the sliding window is only corrected
+      // by global refinement once a frame closes a loop.
+      bool run_global_refinement = false;
+      if (mapper_options.sequential) {
+        if (reconstruction->NumRegImages() >=
+            ba_prev_num_reg_images + options_->ba_local_num_images) {
+          for (const image_t image_id : batch_image_ids) {
+            if (mapper.IsLoopClosure(mapper_options, image_id)) {
+              LOG(INFO) << StringPrintf("Image #%d closes a loop", image_id);
+              run_global_refinement = true;
+              break;
+            }
+          }
+        }
+      } else {
+        run_global_refinement =
+            CheckRunGlobalRefinement(*reconstruction,
+                                     ba_prev_num_reg_images,
+                                     ba_prev_num_points,
+                                     ba_prev_mean_reproj_error);
+      }
 
-      if (CheckRunGlobalRefinement(
-              *reconstruction, ba_prev_num_reg_images, ba_prev_num_points)) {
-        IterativeGlobalRefinement(*options_, mapper_options, mapper);
+      if (run_global_refinement) {
+        IterativeGlobalRefinement(
+            *options_, mapper_options, mapper, GetMetrics());
         ba_prev_num_points = reconstruction->NumPoints3D();
         ba_prev_num_reg_images = reconstruction->NumRegImages();
+        ba_prev_mean_reproj_error =
+            reconstruction->ComputeMeanReprojectionError();
       }
 
       if (options_->extract_colors) {
-        ExtractColors(image_path_, next_image_id, *reconstruction);
+        for (const image_t image_id : batch_image_ids) {
+          ExtractColors(image_path_, image_id, *reconstruction);
+        }
       }
 
       if (options_->snapshot_images_freq > 0 &&
           reconstruction->NumRegImages() >=
               options_->snapshot_images_freq + snapshot_prev_num_reg_images) {
         snapshot_prev_num_reg_images = reconstruction->NumRegImages();
-        WriteSnapshot(*reconstruction, options_->snapshot_path);
+        WriteSnapshot(
+            *reconstruction,
+            options_->snapshot_path,
+            options_->snapshot_incremental ? &snapshot_writer : nullptr);
+      }
+
+      if (options_->checkpoint_images_freq > 0 &&
+          reconstruction->NumRegImages() >=
+              options_->checkpoint_images_freq +
+                  checkpoint_prev_num_reg_images) {
+        checkpoint_prev_num_reg_images = reconstruction->NumRegImages();
+        WriteCheckpoint(mapper, mapper_options);
       }
 
+      GetMetrics().IncrementCounter("num_image_registrations",
+                                    batch_image_ids.size());
+      GetMetrics().SetGauge("num_reg_images", reconstruction->NumRegImages());
+      GetMetrics().SetGauge("num_points3D", reconstruction->NumPoints3D());
+      reconstruction_memory_account_.SetNumBytes(reconstruction->NumBytes());
+
       Callback(NEXT_IMAGE_REG_CALLBACK);
     }
 
@@ -439,7 +731,9 @@ IncrementalMapperController::ReconstructSubModel(
     // bundle adjustment and try again to register one image. If this fails
     // once, then exit the incremental mapping.
     if (!reg_next_success && prev_reg_next_success) {
-      IterativeGlobalRefinement(*options_, mapper_options, mapper);
+      LOG(INFO) << "Global bundle adjustment triggered by failed registration";
+      IterativeGlobalRefinement(
+          *options_, mapper_options, mapper, GetMetrics());
     }
   } while (reg_next_success || prev_reg_next_success);
 
@@ -451,7 +745,8 @@ IncrementalMapperController::ReconstructSubModel(
   if (reconstruction->NumRegImages() >= 2 &&
       reconstruction->NumRegImages() != ba_prev_num_reg_images &&
       reconstruction->NumPoints3D() != ba_prev_num_points) {
-    IterativeGlobalRefinement(*options_, mapper_options, mapper);
+    LOG(INFO) << "Global bundle adjustment triggered by end of reconstruction";
+    IterativeGlobalRefinement(*options_, mapper_options, mapper, GetMetrics());
   }
   return Status::SUCCESS;
 }
@@ -459,28 +754,43 @@ IncrementalMapperController::ReconstructSubModel(
 void IncrementalMapperController::Reconstruct(
     const IncrementalMapper::Options& mapper_options) {
   IncrementalMapper mapper(database_cache_);
+  mapper.SetMetrics(&GetMetrics());
 
   // Is there a sub-model before we start the reconstruction? I.e. the user
-  // has imported an existing reconstruction.
-  const bool initial_reconstruction_given = reconstruction_manager_->Size() > 0;
-  THROW_CHECK_LE(reconstruction_manager_->Size(), 1)
-      << "Can only resume from a "
-         "single reconstruction, but "
-         "multiple are given.";
-
-  for (int num_trials = 0; num_trials < options_->init_num_trials;
+  // has imported an existing reconstruction. When resuming from a checkpoint,
+  // the reconstructions and trials of the checkpoint are continued instead.
+  const bool resume_checkpoint = resume_state_ != nullptr;
+  const bool initial_reconstruction_given =
+      resume_checkpoint ? progress_.initial_reconstruction_given
+                        : reconstruction_manager_->Size() > 0;
+  if (!resume_checkpoint) {
+    THROW_CHECK_LE(reconstruction_manager_->Size(), 1)
+        << "Can only resume from a "
+           "single reconstruction, but "
+           "multiple are given.";
+  }
+
+  for (int num_trials = resume_checkpoint ? progress_.num_trials : 0;
+       num_trials < options_->init_num_trials;
        ++num_trials) {
     if (CheckIfStopped()) {
       break;
     }
     size_t reconstruction_idx;
-    if (!initial_reconstruction_given || num_trials > 0) {
+    if (resume_state_) {
+      reconstruction_idx = progress_.reconstruction_idx;
+    } else if (!initial_reconstruction_given || num_trials > 0) {
       reconstruction_idx = reconstruction_manager_->Add();
     } else {
       reconstruction_idx = 0;
     }
+    progress_.reconstruction_idx = reconstruction_idx;
+    progress_.num_trials = num_trials;
+    progress_.initial_reconstruction_given = initial_reconstruction_given;
     std::shared_ptr<Reconstruction> reconstruction =
         reconstruction_manager_->Get(reconstruction_idx);
+    GetMetrics().SetGauge("num_reconstructions",
+                          reconstruction_manager_->Size());
 
     const Status status =
         ReconstructSubModel(mapper, mapper_options, reconstruction);
@@ -537,12 +847,255 @@ void IncrementalMapperController::Reconstruct(
   }
 }
 
+void IncrementalMapperController::WriteCheckpoint(
+    const IncrementalMapper& mapper,
+    const IncrementalMapper::Options& mapper_options) {
+  WaitForCheckpoint();
+
+  Progress progress = progress_;
+  progress.init_min_num_inliers = mapper_options.init_min_num_inliers;
+  progress.init_min_tri_angle = mapper_options.init_min_tri_angle;
+
+  // Only the current reconstruction is modified while the checkpoint is
+  // written, so the previous reconstructions are shared with the checkpoint.
+  std::vector<std::shared_ptr<const Reconstruction>> reconstructions;
+  reconstructions.reserve(reconstruction_manager_->Size());
+  for (size_t i = 0; i < reconstruction_manager_->Size(); ++i) {
+    if (i == progress.reconstruction_idx) {
+      auto reconstruction = std::make_shared<Reconstruction>(
+          *reconstruction_manager_->Get(i));
+      reconstruction->TearDown();
+      reconstructions.push_back(std::move(reconstruction));
+    } else {
+      reconstructions.push_back(reconstruction_manager_->Get(i));
+    }
+  }
+
+  const std::string prev_path =
+      checkpoint_idx_ > 0
+          ? JoinPaths(options_->checkpoint_path,
+                      StringPrintf("checkpoint%06d", checkpoint_idx_ - 1))
+          : "";
+  const std::string checkpoint_name =
+      StringPrintf("checkpoint%06d", checkpoint_idx_);
+  checkpoint_idx_ += 1;
+
+  LOG(INFO) << "Creating checkpoint " << checkpoint_name;
+
+  if (checkpoint_thread_pool_ == nullptr) {
+    checkpoint_thread_pool_ = std::make_unique<ThreadPool>(1);
+  }
+  checkpoint_future_ = checkpoint_thread_pool_->AddTask(
+      [checkpoint_path = options_->checkpoint_path,
+       checkpoint_name,
+       prev_path,
+       progress,
+       state = mapper.GetState(),
+       reconstructions = std::move(reconstructions)]() {
+        const std::string path = JoinPaths(checkpoint_path, checkpoint_name);
+        CreateDirIfNotExists(path, /*recursive=*/true);
+        for (size_t i = 0; i < reconstructions.size(); ++i) {
+          const std::string reconstruction_path =
+              JoinPaths(path, std::to_string(i));
+          CreateDirIfNotExists(reconstruction_path);
+          reconstructions[i]->WriteBinary(reconstruction_path);
+        }
+        state.Write(JoinPaths(path, "mapper_state.txt"));
+
+        const std::string progress_path = JoinPaths(path, "progress.txt");
+        std::ofstream progress_file(progress_path, std::ios::trunc);
+        THROW_CHECK_FILE_OPEN(progress_file, progress_path);
+        progress_file << progress.reconstruction_idx << " "
+                      << progress.num_trials << " "
+                      << progress.initial_reconstruction_given << " "
+                      << progress.init_min_num_inliers << " "
+                      << progress.init_min_tri_angle << "\n";
+        progress_file.close();
+        THROW_CHECK(progress_file.good())
+            << "Failed to write " << progress_path;
+
+        // Atomically replace the reference to the latest checkpoint, so that
+        // an interrupted write never invalidates the previous checkpoint.
+        const std::string latest_path = JoinPaths(checkpoint_path, "latest");
+        const std::string tmp_path = latest_path + ".tmp";
+        {
+          std::ofstream latest_file(tmp_path, std::ios::trunc);
+          THROW_CHECK_FILE_OPEN(latest_file, tmp_path);
+          latest_file << checkpoint_name << "\n";
+          THROW_CHECK(latest_file.good()) << "Failed to write " << tmp_path;
+        }
+        THROW_CHECK_EQ(std::rename(tmp_path.c_str(), latest_path.c_str()), 0);
+
+        if (!prev_path.empty()) {
+          boost::filesystem::remove_all(prev_path);
+        }
+        VLOG(1) << "=> Wrote checkpoint to " << path;
+      });
+}
+
+bool IncrementalMapperController::ReadCheckpoint() {
+  const std::string latest_path =
+      JoinPaths(options_->checkpoint_path, "latest");
+  if (!ExistsFile(latest_path)) {
+    LOG(INFO) << "No checkpoint found, starting from scratch";
+    return false;
+  }
+
+  std::string checkpoint_name;
+  {
+    std::ifstream latest_file(latest_path);
+    THROW_CHECK_FILE_OPEN(latest_file, latest_path);
+    latest_file >> checkpoint_name;
+  }
+  const std::string path =
+      JoinPaths(options_->checkpoint_path, checkpoint_name);
+  LOG(INFO) << "Resuming from checkpoint " << path;
+
+  const std::string progress_path = JoinPaths(path, "progress.txt");
+  std::ifstream progress_file(progress_path);
+  THROW_CHECK_FILE_OPEN(progress_file, progress_path);
+  progress_file >> progress_.reconstruction_idx >> progress_.num_trials >>
+      progress_.initial_reconstruction_given >>
+      progress_.init_min_num_inliers >> progress_.init_min_tri_angle;
+  THROW_CHECK(!progress_file.fail()) << "Failed to read " << progress_path;
+
+  reconstruction_manager_->Clear();
+  for (size_t i = 0;; ++i) {
+    const std::string reconstruction_path = JoinPaths(path, std::to_string(i));
+    if (!ExistsDir(reconstruction_path)) {
+      break;
+    }
+    reconstruction_manager_->Read(reconstruction_path);
+  }
+  THROW_CHECK_LT(progress_.reconstruction_idx, reconstruction_manager_->Size())
+      << "Invalid checkpoint " << path;
+
+  resume_state_ = std::make_unique<IncrementalMapper::State>(
+      IncrementalMapper::State::Read(JoinPaths(path, "mapper_state.txt")));
+
+  // Continue the numbering, so that the resumed checkpoint is replaced by the
+  // next checkpoint of this run.
+  checkpoint_idx_ = std::stoi(checkpoint_name.substr(10)) + 1;
+
+  LOG(INFO) << StringPrintf(
+      "=> Resuming reconstruction %d with %d images",
+      progress_.reconstruction_idx + 1,
+      reconstruction_manager_->Get(progress_.reconstruction_idx)
+          ->NumRegImages());
+
+  return true;
+}
+
+void IncrementalMapperController::WaitForCheckpoint() {
+  if (checkpoint_future_.valid()) {
+    checkpoint_future_.get();
+  }
+}
+
+bool IncrementalMapperController::ReconstructComponents() {
+  std::vector<std::vector<image_t>> components =
+      FindConnectedComponents(*database_cache_);
+
+  // Isolated images cannot be reconstructed.
+  while (!components.empty() && components.back().size() < 2) {
+    components.pop_back();
+  }
+  if (components.size() < 2) {
+    return false;
+  }
+
+  LOG(INFO) << StringPrintf(
+      "Reconstructing %d connected components concurrently",
+      components.size());
+
+  // Distribute the threads among the components that are not finished yet,
+  // such that the remaining components get more threads as the workers run
+  // out of components, see `HierarchicalMapperController`.
+  const int num_workers = std::min(options_->num_component_workers,
+                                   static_cast<int>(components.size()));
+  const int num_eff_threads = GetEffectiveNumThreads(options_->NumThreads());
+  std::atomic<int> num_unfinished_components(
+      static_cast<int>(components.size()));
+  const auto num_threads_per_worker = [&]() {
+    const int num_busy_workers = std::max(
+        1, std::min(num_workers, num_unfinished_components.load()));
+    return std::max(1, num_eff_threads / num_busy_workers);
+  };
+
+  // Reconstruct each component with a separate reconstruction manager to
+  // avoid race conditions. The components are processed in order of
+  // decreasing size for better resource usage.
+  std::vector<std::shared_ptr<class ReconstructionManager>>
+      reconstruction_managers(components.size());
+  ThreadPool thread_pool(num_workers);
+  for (size_t i = 0; i < components.size(); ++i) {
+    reconstruction_managers[i] =
+        std::make_shared<class ReconstructionManager>();
+    thread_pool.AddTask([&, i]() {
+      auto component_options =
+          std::make_shared<IncrementalMapperOptions>(*options_);
+      component_options->num_component_workers = 1;
+      if (options_->num_threads < 0) {
+        component_options->dynamic_num_threads = num_threads_per_worker;
+      }
+      component_options->image_names.clear();
+      for (const image_t image_id : components[i]) {
+        // Not through Image, which would load the 2D points in lazy mode.
+        component_options->image_names.insert(
+            database_cache_->Images().at(image_id).Name());
+      }
+
+      IncrementalMapperController mapper(std::move(component_options),
+                                         image_path_,
+                                         database_path_,
+                                         database_cache_,
+                                         reconstruction_managers[i]);
+      mapper.SetCheckIfStoppedFunc([this]() { return CheckIfStopped(); });
+      mapper.Run();
+
+      --num_unfinished_components;
+    });
+  }
+  thread_pool.Wait();
+
+  // Collect the models in order of the components and discard small models
+  // as in the sequential reconstruction, except for the first model.
+  const size_t min_model_size = std::min<size_t>(
+      0.8 * database_cache_->NumImages(), options_->min_model_size);
+  for (const auto& component_reconstruction_manager : reconstruction_managers) {
+    for (size_t i = 0; i < component_reconstruction_manager->Size(); ++i) {
+      if (reconstruction_manager_->Size() >=
+          static_cast<size_t>(options_->max_num_models)) {
+        break;
+      }
+      std::shared_ptr<Reconstruction>& reconstruction =
+          component_reconstruction_manager->Get(i);
+      if (reconstruction_manager_->Size() > 0 &&
+          reconstruction->NumRegImages() < min_model_size) {
+        continue;
+      }
+      reconstruction_manager_->Get(reconstruction_manager_->Add()) =
+          std::move(reconstruction);
+    }
+  }
+
+  Callback(LAST_IMAGE_REG_CALLBACK);
+
+  return true;
+}
+
 void IncrementalMapperController::TriangulateReconstruction(
     const std::shared_ptr<Reconstruction>& reconstruction) {
   THROW_CHECK(LoadDatabase());
   IncrementalMapper mapper(database_cache_);
+  mapper.SetMetrics(&GetMetrics());
   mapper.BeginReconstruction(reconstruction);
 
+  // The poses are fixed, so that the new points of each image can be
+  // estimated in parallel.
+  IncrementalTriangulator::Options tri_options = options_->Triangulation();
+  tri_options.num_threads = options_->NumThreads();
+
   LOG(INFO) << "Iterative triangulation";
   const std::vector<image_t>& reg_image_ids = reconstruction->RegImageIds();
   for (size_t i = 0; i < reg_image_ids.size(); ++i) {
@@ -555,7 +1108,7 @@ void IncrementalMapperController::TriangulateReconstruction(
               << mapper.ObservationManager().NumObservations(image_id)
               << " points";
 
-    mapper.TriangulateImage(options_->Triangulation(), image_id);
+    mapper.TriangulateImage(tri_options, image_id);
     VLOG(1) << "=> Triangulated "
             << (image.NumPoints3D() - num_existing_points3D) << " points";
   }
@@ -570,7 +1123,8 @@ void IncrementalMapperController::TriangulateReconstruction(
   mapper.EndReconstruction(/*discard=*/false);
 
   LOG(INFO) << "Extracting colors";
-  reconstruction->ExtractColorsForAllImages(image_path_);
+  reconstruction->ExtractColorsForAllImages(image_path_,
+                                            options_->NumThreads());
 }
 
 }  // namespace colmap
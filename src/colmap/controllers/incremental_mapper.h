@@ -32,6 +32,12 @@
 #include "colmap/scene/reconstruction_manager.h"
 #include "colmap/sfm/incremental_mapper.h"
 #include "colmap/util/base_controller.h"
+#include "colmap/util/memory_budget.h"
+#include "colmap/util/threading.h"
+
+#include <functional>
+#include <future>
+#include <memory>
 
 namespace colmap {
 
@@ -70,9 +76,22 @@ struct IncrementalMapperOptions {
   // Whether to extract colors for reconstructed points.
   bool extract_colors = true;
 
+  // The number of workers that reconstruct the connected components of the
+  // correspondence graph concurrently, if multiple models are reconstructed
+  // from scratch. Each component is reconstructed independently with its
+  // share of the threads. Not used when writing or resuming checkpoints.
+  int num_component_workers = 1;
+
   // The number of threads to use during reconstruction.
   int num_threads = -1;
 
+  // Optional function returning the current number of threads, which then
+  // overrides `num_threads`. It is queried whenever the options of the next
+  // bundle adjustment or reconstruction are created, e.g., to give more
+  // threads to the remaining mappers as concurrent mappers finish. Must be
+  // safe to call from the reconstruction thread.
+  std::function<int()> dynamic_num_threads;
+
   // Thresholds for filtering images with degenerate intrinsics.
   double min_focal_length_ratio = 0.1;
   double max_focal_length_ratio = 10.0;
@@ -83,6 +102,10 @@ struct IncrementalMapperOptions {
   bool ba_refine_principal_point = false;
   bool ba_refine_extra_params = true;
 
+  // Whether to use analytic Jacobians in bundle adjustment for the camera
+  // models that support them.
+  bool ba_use_analytic_jacobians = false;
+
   // The minimum number of residuals per bundle adjustment problem to
   // enable multi-threading solving of the problems.
   int ba_min_num_residuals_for_multi_threading = 50000;
@@ -102,23 +125,88 @@ struct IncrementalMapperOptions {
   int ba_global_images_freq = 500;
   int ba_global_points_freq = 250000;
 
+  // Whether to postpone global bundle adjustments triggered by the growth
+  // ratios above until the mean reprojection error increased by more than the
+  // given relative drift since the last global bundle adjustment. The growth
+  // frequencies above still trigger global bundle adjustment unconditionally.
+  bool ba_global_adaptive = false;
+  double ba_global_max_reproj_error_drift = 0.05;
+
   // Ceres solver function tolerance for global bundle adjustment
   double ba_global_function_tolerance = 0.0;
 
   // The maximum number of global bundle adjustment iterations.
   int ba_global_max_num_iterations = 50;
 
+  // Whether to use the CUDA solvers of Ceres for global bundle adjustment,
+  // if available, and the index of the GPU to use (-1 for the best GPU).
+  bool ba_global_use_gpu = false;
+  std::string ba_global_gpu_index = "-1";
+
+  // Whether to keep the global bundle adjustment problem alive across the
+  // refinement iterations and to only update changed observations.
+  bool ba_global_reuse_problem = true;
+
+  // If positive, global bundle adjustment of more registered images is
+  // partitioned into co-visible clusters of at most this number of images.
+  int ba_global_max_num_images_per_partition = 0;
+
+  // If positive, global bundle adjustment optimizes the cameras with a subset
+  // of the 3D points selected by visibility pyramids with this number of
+  // levels and refines the other 3D points afterwards with constant cameras.
+  int ba_global_points3D_subsampling_num_levels = 0;
+
   // The thresholds for iterative bundle adjustment refinements.
   int ba_local_max_refinements = 2;
   double ba_local_max_refinement_change = 0.001;
   int ba_global_max_refinements = 5;
   double ba_global_max_refinement_change = 0.0005;
 
+  // The maximum number of images to register in a batch before jointly
+  // triangulating and locally refining them. After the best candidate is
+  // registered, the following candidates are added to the batch only if they
+  // see at least `reg_batch_min_num_visible_points3D` triangulated points.
+  // Batches should not exceed `ba_local_num_images` so that the registered
+  // images are covered by the local bundle adjustment of the batch.
+  int reg_batch_size = 1;
+  int reg_batch_min_num_visible_points3D = 200;
+
   // Path to a folder with reconstruction snapshots during incremental
   // reconstruction. Snapshots will be saved according to the specified
-  // frequency of registered images.
+  // frequency of registered images. If `snapshot_incremental` is set, only
+  // the first snapshot of a reconstruction is a full model and the following
+  // snapshots only store the changes since the previous snapshot. They can be
+  // read like a full model, e.g., with the model_converter.
   std::string snapshot_path = "";
   int snapshot_images_freq = 0;
+  bool snapshot_incremental = false;
+
+  // Path to a folder in which checkpoints of all reconstructions and of the
+  // mapper state are written every `checkpoint_images_freq` registered
+  // images. Checkpoints are written in the background and only the latest
+  // one is kept. If `resume` is set, the reconstruction continues from the
+  // latest checkpoint in the folder instead of starting from scratch.
+  std::string checkpoint_path = "";
+  int checkpoint_images_freq = 0;
+  bool resume = false;
+
+  // Path to a folder in which snapshots of the correspondence graph are
+  // cached. If the images and matches in the database did not change, the
+  // correspondence graph is read from the snapshot instead of being rebuilt.
+  std::string correspondence_graph_cache_path = "";
+
+  // Whether to load the 2D points of images from the database only when they
+  // are first needed instead of keeping them in the database cache. Reduces
+  // the memory usage on large scenes at the cost of reading the keypoints
+  // again for every reconstructed model.
+  bool lazy_points2D = false;
+
+  // The maximum number of neighbors with the most inliers, to which the
+  // correspondences of each image are kept. Image pairs on a maximum spanning
+  // tree of the matches are always kept to preserve the connectivity. Reduces
+  // the size of the correspondence graph and the cost of triangulation in
+  // densely matched scenes. All image pairs are kept if zero.
+  int max_num_neighbors = 0;
 
   // Which images to reconstruct. If no images are specified, all images will
   // be reconstructed by default.
@@ -135,6 +223,10 @@ struct IncrementalMapperOptions {
   BundleAdjustmentOptions LocalBundleAdjustment() const;
   BundleAdjustmentOptions GlobalBundleAdjustment() const;
 
+  // The number of threads given either by `dynamic_num_threads` or
+  // `num_threads`.
+  int NumThreads() const;
+
   inline bool IsInitialPairProvided() const {
     return init_image_id1 != -1 && init_image_id2 != -1;
   }
@@ -160,6 +252,17 @@ class IncrementalMapperController : public BaseController {
       const std::string& database_path,
       std::shared_ptr<class ReconstructionManager> reconstruction_manager);
 
+  // Extract the database cache from an already loaded cache instead of
+  // loading it from the database, e.g., to share the matches between multiple
+  // controllers reconstructing different images of the same database. The
+  // shared cache must contain the images of the options and is not modified.
+  IncrementalMapperController(
+      std::shared_ptr<const IncrementalMapperOptions> options,
+      const std::string& image_path,
+      const std::string& database_path,
+      std::shared_ptr<const class DatabaseCache> shared_database_cache,
+      std::shared_ptr<class ReconstructionManager> reconstruction_manager);
+
   void Run();
 
   void TriangulateReconstruction(
@@ -195,14 +298,52 @@ class IncrementalMapperController : public BaseController {
 
   bool CheckRunGlobalRefinement(const Reconstruction& reconstruction,
                                 size_t ba_prev_num_reg_images,
-                                size_t ba_prev_num_points);
+                                size_t ba_prev_num_points,
+                                double ba_prev_mean_reproj_error = -1);
 
  private:
+  // The progress of the reconstruction that is stored in checkpoints in
+  // addition to the reconstructions and the mapper state.
+  struct Progress {
+    size_t reconstruction_idx = 0;
+    int num_trials = 0;
+    bool initial_reconstruction_given = false;
+    int init_min_num_inliers = 0;
+    double init_min_tri_angle = 0;
+  };
+
+  // Asynchronously write a checkpoint of the current progress. Waits for the
+  // previous checkpoint to be written first.
+  void WriteCheckpoint(const IncrementalMapper& mapper,
+                       const IncrementalMapper::Options& mapper_options);
+
+  // Read the latest checkpoint, if one exists, and replace the current
+  // reconstructions by the ones of the checkpoint.
+  bool ReadCheckpoint();
+
+  // Wait for the pending checkpoint to be written.
+  void WaitForCheckpoint();
+
+  // Reconstruct the connected components of the correspondence graph
+  // concurrently with separate controllers. Returns false without
+  // reconstructing anything if there are less than two components.
+  bool ReconstructComponents();
+
   const std::shared_ptr<const IncrementalMapperOptions> options_;
   const std::string image_path_;
   const std::string database_path_;
   std::shared_ptr<class ReconstructionManager> reconstruction_manager_;
   std::shared_ptr<class DatabaseCache> database_cache_;
+  std::shared_ptr<const class DatabaseCache> shared_database_cache_;
+
+  Progress progress_;
+  std::unique_ptr<IncrementalMapper::State> resume_state_;
+  std::unique_ptr<ThreadPool> checkpoint_thread_pool_;
+  std::future<void> checkpoint_future_;
+  int checkpoint_idx_ = 0;
+
+  // Size of the reconstruction currently being built.
+  MemoryAccount reconstruction_memory_account_{"Reconstruction"};
 };
 
 }  // namespace colmap
@@ -31,6 +31,7 @@
 
 #include "colmap/estimators/alignment.h"
 #include "colmap/scene/synthetic.h"
+#include "colmap/util/misc.h"
 #include "colmap/util/testing.h"
 
 #include <gtest/gtest.h>
@@ -166,6 +167,62 @@ TEST(IncrementalMapperController, MultiReconstruction) {
                              /*num_obs_tolerance=*/0);
 }
 
+TEST(IncrementalMapperController, ParallelComponents) {
+  const std::string database_path = CreateTestDir() + "/database.db";
+
+  Database database(database_path);
+  Reconstruction gt_reconstruction1;
+  Reconstruction gt_reconstruction2;
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_cameras = 1;
+  synthetic_dataset_options.num_images = 5;
+  synthetic_dataset_options.num_points3D = 50;
+  synthetic_dataset_options.point2D_stddev = 0;
+  SynthesizeDataset(synthetic_dataset_options, &gt_reconstruction1, &database);
+  synthetic_dataset_options.num_images = 4;
+  SynthesizeDataset(synthetic_dataset_options, &gt_reconstruction2, &database);
+
+  for (const bool lazy_points2D : {false, true}) {
+    auto reconstruction_manager = std::make_shared<ReconstructionManager>();
+    auto mapper_options = std::make_shared<IncrementalMapperOptions>();
+    mapper_options->min_model_size = 4;
+    mapper_options->num_component_workers = 2;
+    mapper_options->lazy_points2D = lazy_points2D;
+    IncrementalMapperController mapper(mapper_options,
+                                       /*image_path=*/"",
+                                       database_path,
+                                       reconstruction_manager);
+    mapper.Run();
+
+    // The models are ordered by the size of their components.
+    ASSERT_EQ(reconstruction_manager->Size(), 2);
+    ExpectEqualReconstructions(gt_reconstruction1,
+                               *reconstruction_manager->Get(0),
+                               /*max_rotation_error_deg=*/1e-2,
+                               /*max_proj_center_error=*/1e-4,
+                               /*num_obs_tolerance=*/0);
+    ExpectEqualReconstructions(gt_reconstruction2,
+                               *reconstruction_manager->Get(1),
+                               /*max_rotation_error_deg=*/1e-2,
+                               /*max_proj_center_error=*/1e-4,
+                               /*num_obs_tolerance=*/0);
+
+    if (lazy_points2D) {
+      // The components load their 2D points into their own caches, so the
+      // shared cache still has none of them loaded.
+      const auto unloaded_database_cache = DatabaseCache::Create(
+          database,
+          static_cast<size_t>(mapper_options->min_num_matches),
+          mapper_options->ignore_watermarks,
+          /*image_names=*/{},
+          /*correspondence_graph_cache_path=*/"",
+          /*lazy_points2D=*/true);
+      EXPECT_EQ(mapper.DatabaseCache()->NumBytes(),
+                unloaded_database_cache->NumBytes());
+    }
+  }
+}
+
 TEST(IncrementalMapperController, ChainedMatches) {
   const std::string database_path = CreateTestDir() + "/database.db";
 
@@ -196,5 +253,131 @@ TEST(IncrementalMapperController, ChainedMatches) {
                              /*num_obs_tolerance=*/0);
 }
 
+TEST(IncrementalMapperController, ParallelInitialPairCandidates) {
+  const std::string database_path = CreateTestDir() + "/database.db";
+
+  Database database(database_path);
+  Reconstruction gt_reconstruction;
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_cameras = 1;
+  synthetic_dataset_options.num_images = 4;
+  synthetic_dataset_options.num_points3D = 100;
+  synthetic_dataset_options.point2D_stddev = 0;
+  SynthesizeDataset(synthetic_dataset_options, &gt_reconstruction, &database);
+
+  auto options = std::make_shared<IncrementalMapperOptions>();
+  options->mapper.num_parallel_init_pair_candidates = 4;
+  auto reconstruction_manager = std::make_shared<ReconstructionManager>();
+  IncrementalMapperController mapper(options,
+                                     /*image_path=*/"",
+                                     database_path,
+                                     reconstruction_manager);
+  mapper.Run();
+
+  ASSERT_EQ(reconstruction_manager->Size(), 1);
+  ExpectEqualReconstructions(gt_reconstruction,
+                             *reconstruction_manager->Get(0),
+                             /*max_rotation_error_deg=*/1e-2,
+                             /*max_proj_center_error=*/1e-4,
+                             /*num_obs_tolerance=*/0);
+}
+
+TEST(IncrementalMapperController, Sequential) {
+  const std::string database_path = CreateTestDir() + "/database.db";
+
+  Database database(database_path);
+  Reconstruction gt_reconstruction;
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.match_config =
+      SyntheticDatasetOptions::MatchConfig::CHAINED;
+  synthetic_dataset_options.num_cameras = 1;
+  synthetic_dataset_options.num_images = 4;
+  synthetic_dataset_options.num_points3D = 100;
+  synthetic_dataset_options.point2D_stddev = 0;
+  SynthesizeDataset(synthetic_dataset_options, &gt_reconstruction, &database);
+
+  auto options = std::make_shared<IncrementalMapperOptions>();
+  options->mapper.sequential = true;
+  options->ba_local_num_images = 3;
+  auto reconstruction_manager = std::make_shared<ReconstructionManager>();
+  IncrementalMapperController mapper(options,
+                                     /*image_path=*/"",
+                                     database_path,
+                                     reconstruction_manager);
+  mapper.Run();
+
+  ASSERT_EQ(reconstruction_manager->Size(), 1);
+  ExpectEqualReconstructions(gt_reconstruction,
+                             *reconstruction_manager->Get(0),
+                             /*max_rotation_error_deg=*/1e-2,
+                             /*max_proj_center_error=*/1e-4,
+                             /*num_obs_tolerance=*/0);
+}
+
+TEST(IncrementalMapperController, ResumeFromCheckpoint) {
+  const std::string test_dir = CreateTestDir();
+  const std::string database_path = test_dir + "/database.db";
+  const std::string checkpoint_path = test_dir + "/checkpoints";
+
+  Database database(database_path);
+  Reconstruction gt_reconstruction;
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_cameras = 2;
+  synthetic_dataset_options.num_images = 10;
+  synthetic_dataset_options.num_points3D = 50;
+  synthetic_dataset_options.point2D_stddev = 0;
+  SynthesizeDataset(synthetic_dataset_options, &gt_reconstruction, &database);
+
+  auto mapper_options = std::make_shared<IncrementalMapperOptions>();
+  mapper_options->checkpoint_path = checkpoint_path;
+  mapper_options->checkpoint_images_freq = 1;
+
+  // Interrupt the reconstruction after a few images were registered.
+  auto interrupted_reconstruction_manager =
+      std::make_shared<ReconstructionManager>();
+  IncrementalMapperController interrupted_mapper(
+      mapper_options,
+      /*image_path=*/"",
+      database_path,
+      interrupted_reconstruction_manager);
+  int num_reg_callbacks = 0;
+  interrupted_mapper.AddCallback(
+      IncrementalMapperController::NEXT_IMAGE_REG_CALLBACK,
+      [&num_reg_callbacks]() { num_reg_callbacks += 1; });
+  interrupted_mapper.SetCheckIfStoppedFunc(
+      [&num_reg_callbacks]() { return num_reg_callbacks >= 3; });
+  interrupted_mapper.Run();
+
+  ASSERT_EQ(interrupted_reconstruction_manager->Size(), 1);
+  const size_t num_interrupted_reg_images =
+      interrupted_reconstruction_manager->Get(0)->NumRegImages();
+  EXPECT_LT(num_interrupted_reg_images, gt_reconstruction.NumRegImages());
+  EXPECT_TRUE(ExistsFile(JoinPaths(checkpoint_path, "latest")));
+
+  // Continue the reconstruction from the latest checkpoint.
+  mapper_options->resume = true;
+  auto reconstruction_manager = std::make_shared<ReconstructionManager>();
+  IncrementalMapperController mapper(mapper_options,
+                                     /*image_path=*/"",
+                                     database_path,
+                                     reconstruction_manager);
+  bool resumed = false;
+  mapper.AddCallback(
+      IncrementalMapperController::INITIAL_IMAGE_PAIR_REG_CALLBACK,
+      [&resumed, &reconstruction_manager, num_interrupted_reg_images]() {
+        resumed = reconstruction_manager->Get(0)->NumRegImages() ==
+                  num_interrupted_reg_images;
+      });
+  mapper.Run();
+
+  EXPECT_TRUE(resumed);
+  ASSERT_EQ(reconstruction_manager->Size(), 1);
+  ExpectEqualReconstructions(gt_reconstruction,
+                             *reconstruction_manager->Get(0),
+                             /*max_rotation_error_deg=*/1e-2,
+                             /*max_proj_center_error=*/1e-4,
+                             /*num_obs_tolerance=*/0);
+}
+
 }  // namespace
 }  // namespace colmap
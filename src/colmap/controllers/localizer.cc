@@ -0,0 +1,406 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/controllers/localizer.h"
+
+#include "colmap/util/logging.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/timer.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace colmap {
+
+bool LocalizerOptions::Check() const {
+  CHECK_OPTION_GT(num_images, 0);
+  CHECK_OPTION_GT(max_num_track_descriptors, 0);
+  CHECK_OPTION_GT(min_num_inliers, 0);
+  CHECK_OPTION(extraction.Check());
+  CHECK_OPTION(matching.Check());
+  abs_pose.Check();
+  abs_pose_refinement.Check();
+  return true;
+}
+
+Localizer::Localizer(const LocalizerOptions& options,
+                     const Reconstruction& reconstruction,
+                     const Database& database)
+    : options_(options), thread_pool_(options.num_threads) {
+  THROW_CHECK(options_.Check());
+  BuildIndex(reconstruction, database);
+}
+
+size_t Localizer::NumPoints3D() const { return point3D_ids_.size(); }
+
+void Localizer::BuildIndex(const Reconstruction& reconstruction,
+                           const Database& database) {
+  Timer timer;
+  timer.Start();
+
+  point3D_ids_.reserve(reconstruction.NumPoints3D());
+  for (const auto& point3D : reconstruction.Points3D()) {
+    point3D_ids_.push_back(point3D.first);
+  }
+  std::sort(point3D_ids_.begin(), point3D_ids_.end());
+
+  // Select a bounded number of track elements per point, whose descriptors
+  // are candidates for the representative descriptor of the point. The rows
+  // of the candidates of a point are consecutive.
+  struct Candidate {
+    point2D_t point2D_idx;
+    int row;
+  };
+  std::unordered_map<image_t, std::vector<Candidate>> image_candidates;
+  std::vector<int> point_rows_begin(point3D_ids_.size() + 1, 0);
+  points3D_.reserve(point3D_ids_.size());
+  for (size_t point_idx = 0; point_idx < point3D_ids_.size(); ++point_idx) {
+    const Point3D& point3D = reconstruction.Point3D(point3D_ids_[point_idx]);
+    points3D_.push_back(point3D.xyz);
+    int num_candidates = 0;
+    for (const TrackElement& track_el : point3D.track.Elements()) {
+      image_point_idxs_[track_el.image_id].push_back(point_idx);
+      if (num_candidates < options_.max_num_track_descriptors) {
+        const int row = point_rows_begin[point_idx] + num_candidates;
+        image_candidates[track_el.image_id].push_back(
+            {track_el.point2D_idx, row});
+        ++num_candidates;
+      }
+    }
+    point_rows_begin[point_idx + 1] =
+        point_rows_begin[point_idx] + num_candidates;
+  }
+
+  use_visual_index_ = !options_.vocab_tree_path.empty();
+  if (use_visual_index_) {
+    visual_index_.Read(options_.vocab_tree_path);
+  }
+
+  retrieval::VisualIndex<>::IndexOptions index_options;
+  index_options.num_threads = options_.num_threads;
+  index_options.use_gpu = options_.matching.use_gpu;
+
+  std::vector<image_t> image_ids;
+  image_ids.reserve(image_candidates.size());
+  for (const auto& image : image_candidates) {
+    image_ids.push_back(image.first);
+  }
+  std::sort(image_ids.begin(), image_ids.end());
+
+  // Read the features of the registered images in batches, such that the
+  // visual words of a batch are quantized in a single search.
+  FeatureDescriptors candidate_descriptors(point_rows_begin.back(), 128);
+  const size_t kBatchSize = 32;
+  for (size_t begin = 0; begin < image_ids.size(); begin += kBatchSize) {
+    const size_t end = std::min(begin + kBatchSize, image_ids.size());
+    const std::vector<image_t> batch_image_ids(image_ids.begin() + begin,
+                                               image_ids.begin() + end);
+    std::vector<FeatureDescriptors> batch_descriptors =
+        database.ReadDescriptors(batch_image_ids);
+    for (size_t i = 0; i < batch_image_ids.size(); ++i) {
+      const FeatureDescriptors& descriptors = batch_descriptors[i];
+      THROW_CHECK_EQ(descriptors.cols(), candidate_descriptors.cols());
+      for (const Candidate& candidate :
+           image_candidates.at(batch_image_ids[i])) {
+        THROW_CHECK_LT(candidate.point2D_idx, descriptors.rows());
+        candidate_descriptors.row(candidate.row) =
+            descriptors.row(candidate.point2D_idx);
+      }
+    }
+
+    if (use_visual_index_) {
+      std::vector<int> batch_index_image_ids(batch_image_ids.begin(),
+                                             batch_image_ids.end());
+      std::vector<retrieval::VisualIndex<>::DescType> batch_index_descriptors(
+          batch_descriptors.begin(), batch_descriptors.end());
+      visual_index_.Add(index_options,
+                        batch_index_image_ids,
+                        database.ReadKeypoints(batch_image_ids),
+                        batch_index_descriptors);
+    }
+  }
+
+  if (use_visual_index_) {
+    retrieval::VisualIndex<>::PrepareOptions prepare_options;
+    prepare_options.compact = true;
+    visual_index_.Prepare(prepare_options);
+  }
+
+  // The representative descriptor of a point is the medoid of its candidates,
+  // i.e., the descriptor with the smallest sum of distances to the others.
+  auto descriptors = std::make_shared<FeatureDescriptors>(
+      point3D_ids_.size(), candidate_descriptors.cols());
+  thread_pool_.ParallelFor(
+      0, point3D_ids_.size(), 256, [&](const int64_t point_idx) {
+        const int rows_begin = point_rows_begin[point_idx];
+        const int rows_end = point_rows_begin[point_idx + 1];
+        int best_row = rows_begin;
+        int64_t best_dist = std::numeric_limits<int64_t>::max();
+        for (int row1 = rows_begin; row1 < rows_end; ++row1) {
+          int64_t dist = 0;
+          for (int row2 = rows_begin; row2 < rows_end; ++row2) {
+            dist += (candidate_descriptors.row(row1).cast<int>() -
+                     candidate_descriptors.row(row2).cast<int>())
+                        .squaredNorm();
+          }
+          if (dist < best_dist) {
+            best_row = row1;
+            best_dist = dist;
+          }
+        }
+        if (rows_begin < rows_end) {
+          descriptors->row(point_idx) = candidate_descriptors.row(best_row);
+        } else {
+          descriptors->row(point_idx).setZero();
+        }
+      });
+  descriptors_ = std::move(descriptors);
+
+  LOG(INFO) << StringPrintf(
+      "Indexed %d points of %d images in %.3fs",
+      point3D_ids_.size(),
+      image_ids.size(),
+      timer.ElapsedSeconds());
+}
+
+std::unique_ptr<Localizer::Worker> Localizer::AcquireWorker() {
+  {
+    std::lock_guard<std::mutex> lock(workers_mutex_);
+    if (!workers_.empty()) {
+      std::unique_ptr<Worker> worker = std::move(workers_.back());
+      workers_.pop_back();
+      return worker;
+    }
+  }
+  auto worker = std::make_unique<Worker>();
+  worker->matcher = CreateSiftFeatureMatcher(options_.matching);
+  THROW_CHECK_NOTNULL(worker->matcher);
+  return worker;
+}
+
+void Localizer::ReleaseWorker(std::unique_ptr<Worker> worker) {
+  std::lock_guard<std::mutex> lock(workers_mutex_);
+  workers_.push_back(std::move(worker));
+}
+
+LocalizationResult Localizer::Localize(const Bitmap& bitmap,
+                                       const Camera& camera) {
+  Bitmap grey_bitmap = bitmap.CloneAsGrey();
+  const int max_image_size = options_.extraction.max_image_size;
+  if (grey_bitmap.Width() > max_image_size ||
+      grey_bitmap.Height() > max_image_size) {
+    const double scale = static_cast<double>(max_image_size) /
+                         std::max(grey_bitmap.Width(), grey_bitmap.Height());
+    grey_bitmap.Rescale(static_cast<int>(grey_bitmap.Width() * scale),
+                        static_cast<int>(grey_bitmap.Height() * scale));
+  }
+
+  std::unique_ptr<Worker> worker = AcquireWorker();
+  if (worker->extractor == nullptr) {
+    worker->extractor = CreateSiftFeatureExtractor(options_.extraction);
+    THROW_CHECK_NOTNULL(worker->extractor);
+  }
+
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  LocalizationResult result;
+  result.camera = camera;
+  if (worker->extractor->Extract(grey_bitmap, &keypoints, &descriptors)) {
+    const float scale_x =
+        static_cast<float>(camera.width) / grey_bitmap.Width();
+    const float scale_y =
+        static_cast<float>(camera.height) / grey_bitmap.Height();
+    for (auto& keypoint : keypoints) {
+      keypoint.Rescale(scale_x, scale_y);
+    }
+    result = Localize(keypoints, descriptors, camera, worker.get());
+  }
+
+  ReleaseWorker(std::move(worker));
+  return result;
+}
+
+LocalizationResult Localizer::Localize(const FeatureKeypoints& keypoints,
+                                       const FeatureDescriptors& descriptors,
+                                       const Camera& camera) {
+  std::unique_ptr<Worker> worker = AcquireWorker();
+  LocalizationResult result =
+      Localize(keypoints, descriptors, camera, worker.get());
+  ReleaseWorker(std::move(worker));
+  return result;
+}
+
+std::vector<LocalizationResult> Localizer::LocalizeBatch(
+    const std::vector<Bitmap>& bitmaps, const std::vector<Camera>& cameras) {
+  THROW_CHECK_EQ(bitmaps.size(), cameras.size());
+  std::vector<LocalizationResult> results(bitmaps.size());
+  thread_pool_.ParallelFor(0, bitmaps.size(), 1, [&](const int64_t i) {
+    results[i] = Localize(bitmaps[i], cameras[i]);
+  });
+  return results;
+}
+
+LocalizationResult Localizer::Localize(const FeatureKeypoints& keypoints,
+                                       const FeatureDescriptors& descriptors,
+                                       const Camera& camera,
+                                       Worker* worker) {
+  THROW_CHECK_EQ(keypoints.size(), descriptors.rows());
+
+  LocalizationResult result;
+  result.camera = camera;
+
+  //////////////////////////////////////////////////////////////////////////////
+  // 2D-3D matching
+  //////////////////////////////////////////////////////////////////////////////
+
+  const auto query_descriptors =
+      std::make_shared<const FeatureDescriptors>(descriptors);
+
+  FeatureMatches matches;
+  std::vector<int> candidate_point_idxs;
+  if (use_visual_index_) {
+    retrieval::VisualIndex<>::QueryOptions query_options;
+    query_options.max_num_images = options_.num_images;
+    query_options.num_threads = 1;
+    query_options.use_gpu = options_.matching.use_gpu;
+    std::vector<retrieval::ImageScore> image_scores;
+    visual_index_.Query(query_options, keypoints, descriptors, &image_scores);
+
+    for (const retrieval::ImageScore& image_score : image_scores) {
+      const auto it = image_point_idxs_.find(image_score.image_id);
+      if (it != image_point_idxs_.end()) {
+        candidate_point_idxs.insert(
+            candidate_point_idxs.end(), it->second.begin(), it->second.end());
+      }
+    }
+    std::sort(candidate_point_idxs.begin(), candidate_point_idxs.end());
+    candidate_point_idxs.erase(
+        std::unique(candidate_point_idxs.begin(), candidate_point_idxs.end()),
+        candidate_point_idxs.end());
+
+    auto candidate_descriptors = std::make_shared<FeatureDescriptors>(
+        candidate_point_idxs.size(), descriptors_->cols());
+    for (size_t i = 0; i < candidate_point_idxs.size(); ++i) {
+      candidate_descriptors->row(i) =
+          descriptors_->row(candidate_point_idxs[i]);
+    }
+
+    worker->matcher->Match(
+        query_descriptors, std::move(candidate_descriptors), &matches);
+    worker->prev_target_descriptors = nullptr;
+  } else {
+    // The search structure of all points is only built once per worker.
+    worker->matcher->Match(
+        query_descriptors,
+        worker->prev_target_descriptors == descriptors_.get() ? nullptr
+                                                              : descriptors_,
+        &matches);
+    worker->prev_target_descriptors = descriptors_.get();
+  }
+
+  result.num_matches = matches.size();
+  if (matches.size() < static_cast<size_t>(options_.min_num_inliers)) {
+    return result;
+  }
+
+  std::vector<Eigen::Vector2d> points2D;
+  std::vector<Eigen::Vector3d> points3D;
+  std::vector<int> point_idxs;
+  points2D.reserve(matches.size());
+  points3D.reserve(matches.size());
+  point_idxs.reserve(matches.size());
+  for (const FeatureMatch& match : matches) {
+    const int point_idx = use_visual_index_
+                              ? candidate_point_idxs[match.point2D_idx2]
+                              : static_cast<int>(match.point2D_idx2);
+    const FeatureKeypoint& keypoint = keypoints[match.point2D_idx1];
+    points2D.emplace_back(keypoint.x, keypoint.y);
+    points3D.push_back(points3D_[point_idx]);
+    point_idxs.push_back(point_idx);
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // 2D-3D estimation
+  //////////////////////////////////////////////////////////////////////////////
+
+  AbsolutePoseEstimationOptions abs_pose_options = options_.abs_pose;
+  AbsolutePoseRefinementOptions abs_pose_refinement_options =
+      options_.abs_pose_refinement;
+  abs_pose_options.estimate_focal_length =
+      options_.refine_focal_length && !camera.has_prior_focal_length;
+  if (!options_.refine_focal_length) {
+    abs_pose_refinement_options.refine_focal_length = false;
+    abs_pose_refinement_options.refine_extra_params = false;
+  }
+
+  size_t num_inliers;
+  std::vector<char> inlier_mask;
+  if (!EstimateAbsolutePose(abs_pose_options,
+                            points2D,
+                            points3D,
+                            &result.cam_from_world,
+                            &result.camera,
+                            &num_inliers,
+                            &inlier_mask)) {
+    return result;
+  }
+
+  if (num_inliers < static_cast<size_t>(options_.min_num_inliers)) {
+    return result;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Pose refinement
+  //////////////////////////////////////////////////////////////////////////////
+
+  if (!RefineAbsolutePose(abs_pose_refinement_options,
+                          inlier_mask,
+                          points2D,
+                          points3D,
+                          &result.cam_from_world,
+                          &result.camera)) {
+    return result;
+  }
+
+  result.success = true;
+  result.num_inliers = num_inliers;
+  result.inlier_point2D_idxs.reserve(num_inliers);
+  result.inlier_point3D_ids.reserve(num_inliers);
+  for (size_t i = 0; i < matches.size(); ++i) {
+    if (inlier_mask[i]) {
+      result.inlier_point2D_idxs.push_back(matches[i].point2D_idx1);
+      result.inlier_point3D_ids.push_back(point3D_ids_[point_idxs[i]]);
+    }
+  }
+
+  return result;
+}
+
+}  // namespace colmap
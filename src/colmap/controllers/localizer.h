@@ -0,0 +1,193 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/estimators/pose.h"
+#include "colmap/feature/extractor.h"
+#include "colmap/feature/matcher.h"
+#include "colmap/feature/sift.h"
+#include "colmap/geometry/rigid3.h"
+#include "colmap/retrieval/visual_index.h"
+#include "colmap/scene/camera.h"
+#include "colmap/scene/database.h"
+#include "colmap/scene/reconstruction.h"
+#include "colmap/sensor/bitmap.h"
+#include "colmap/util/threading.h"
+#include "colmap/util/types.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace colmap {
+
+struct LocalizerOptions {
+  // Path to the vocabulary tree used to retrieve the most similar images of
+  // the reconstruction. The query features are then only matched against the
+  // 3D points observed in the retrieved images. If empty, the query features
+  // are matched against all 3D points.
+  std::string vocab_tree_path;
+
+  // Number of retrieved images per query.
+  int num_images = 20;
+
+  // Maximum number of track elements per 3D point, from which the
+  // representative descriptor of the point is selected.
+  int max_num_track_descriptors = 16;
+
+  // Minimum number of 2D-3D inliers for a successful localization.
+  int min_num_inliers = 15;
+
+  // Number of threads for building the index and for batch queries.
+  int num_threads = ThreadPool::kMaxNumThreads;
+
+  // Whether to estimate and refine the focal length of the query camera.
+  // Otherwise, the given camera parameters are kept fixed.
+  bool refine_focal_length = false;
+
+  SiftExtractionOptions extraction;
+
+  // Cross checking is disabled by default, since it would search all
+  // candidate points among the query features.
+  SiftMatchingOptions matching;
+
+  AbsolutePoseEstimationOptions abs_pose;
+  AbsolutePoseRefinementOptions abs_pose_refinement;
+
+  LocalizerOptions() {
+    extraction.use_gpu = false;
+    matching.use_gpu = false;
+    matching.cross_check = false;
+    abs_pose.num_threads = 1;
+    abs_pose.ransac_options.max_error = 12.0;
+    abs_pose.ransac_options.min_inlier_ratio = 0.1;
+    abs_pose.ransac_options.min_num_trials = 100;
+    abs_pose.ransac_options.max_num_trials = 10000;
+    abs_pose.ransac_options.confidence = 0.9999;
+  }
+
+  bool Check() const;
+};
+
+struct LocalizationResult {
+  // Whether the query image was successfully localized.
+  bool success = false;
+
+  Rigid3d cam_from_world;
+
+  // The query camera, with a refined focal length if enabled.
+  Camera camera;
+
+  // Number of 2D-3D matches and inliers after pose estimation.
+  size_t num_matches = 0;
+  size_t num_inliers = 0;
+
+  // Inlier correspondences of the query keypoints and the 3D points.
+  std::vector<point2D_t> inlier_point2D_idxs;
+  std::vector<point3D_t> inlier_point3D_ids;
+};
+
+// Long-lived engine to localize query images against a fixed reconstruction.
+// In contrast to image registration through the incremental mapper, the
+// reconstruction, one representative descriptor per 3D point and the
+// vocabulary tree are loaded once and stay resident, so that each query only
+// extracts its features, retrieves the most similar images, matches against
+// their 3D points and estimates its pose from the 2D-3D matches.
+//
+// All localization methods are thread-safe. Each concurrent call uses its own
+// feature extractor and matcher, which are reused by later calls.
+class Localizer {
+ public:
+  // Build the index from the features of the registered images, which are
+  // read from the database the reconstruction was created from.
+  Localizer(const LocalizerOptions& options,
+            const Reconstruction& reconstruction,
+            const Database& database);
+
+  // Number of indexed 3D points.
+  size_t NumPoints3D() const;
+
+  // Localize a query image with the given camera. The bitmap is down-sampled
+  // to the maximum image size for feature extraction, while the camera must
+  // have the dimensions of the original image.
+  LocalizationResult Localize(const Bitmap& bitmap, const Camera& camera);
+
+  // Localize a query image from its extracted features.
+  LocalizationResult Localize(const FeatureKeypoints& keypoints,
+                              const FeatureDescriptors& descriptors,
+                              const Camera& camera);
+
+  // Localize multiple query images in parallel.
+  std::vector<LocalizationResult> LocalizeBatch(
+      const std::vector<Bitmap>& bitmaps, const std::vector<Camera>& cameras);
+
+ private:
+  struct Worker {
+    std::unique_ptr<FeatureExtractor> extractor;
+    std::unique_ptr<FeatureMatcher> matcher;
+    // The target descriptors of the previous match, whose search structure
+    // is kept by the matcher.
+    const FeatureDescriptors* prev_target_descriptors = nullptr;
+  };
+
+  void BuildIndex(const Reconstruction& reconstruction,
+                  const Database& database);
+
+  std::unique_ptr<Worker> AcquireWorker();
+  void ReleaseWorker(std::unique_ptr<Worker> worker);
+
+  LocalizationResult Localize(const FeatureKeypoints& keypoints,
+                              const FeatureDescriptors& descriptors,
+                              const Camera& camera,
+                              Worker* worker);
+
+  const LocalizerOptions options_;
+
+  ThreadPool thread_pool_;
+
+  // The 3D points and their representative descriptors, one row per point.
+  std::vector<point3D_t> point3D_ids_;
+  std::vector<Eigen::Vector3d> points3D_;
+  std::shared_ptr<const FeatureDescriptors> descriptors_;
+
+  // The indices of the 3D points observed by each registered image.
+  std::unordered_map<image_t, std::vector<int>> image_point_idxs_;
+
+  bool use_visual_index_ = false;
+  retrieval::VisualIndex<> visual_index_;
+
+  std::mutex workers_mutex_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+}  // namespace colmap
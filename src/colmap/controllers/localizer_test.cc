@@ -0,0 +1,151 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/controllers/localizer.h"
+
+#include "colmap/feature/utils.h"
+#include "colmap/math/random.h"
+#include "colmap/scene/synthetic.h"
+#include "colmap/util/testing.h"
+
+#include <unordered_map>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+FeatureDescriptorsFloat RandomDescriptor() {
+  FeatureDescriptorsFloat descriptor(1, 128);
+  for (int i = 0; i < descriptor.cols(); ++i) {
+    descriptor(0, i) = RandomUniformReal(0.0f, 1.0f);
+  }
+  return descriptor;
+}
+
+// Write descriptors, such that all observations of a 3D point have noisy
+// copies of the same descriptor and all other keypoints have random ones.
+void SynthesizeDescriptors(const Reconstruction& reconstruction,
+                           Database* database) {
+  std::unordered_map<point3D_t, FeatureDescriptorsFloat> point_descriptors;
+  for (const auto& point3D : reconstruction.Points3D()) {
+    point_descriptors.emplace(point3D.first, RandomDescriptor());
+  }
+  for (const auto& image : reconstruction.Images()) {
+    FeatureDescriptorsFloat descriptors(image.second.NumPoints2D(), 128);
+    for (point2D_t point2D_idx = 0; point2D_idx < image.second.NumPoints2D();
+         ++point2D_idx) {
+      const Point2D& point2D = image.second.Point2D(point2D_idx);
+      if (point2D.HasPoint3D()) {
+        descriptors.row(point2D_idx) = point_descriptors.at(point2D.point3D_id);
+        for (int i = 0; i < descriptors.cols(); ++i) {
+          descriptors(point2D_idx, i) += RandomGaussian(0.0f, 0.01f);
+        }
+      } else {
+        descriptors.row(point2D_idx) = RandomDescriptor();
+      }
+    }
+    L2NormalizeFeatureDescriptors(&descriptors);
+    database->WriteDescriptors(image.first,
+                               FeatureDescriptorsToUnsignedByte(descriptors));
+  }
+}
+
+TEST(Localizer, Nominal) {
+  SetPRNGSeed(0);
+  Database database(Database::kInMemoryDatabasePath);
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_cameras = 1;
+  synthetic_dataset_options.num_images = 5;
+  synthetic_dataset_options.num_points3D = 200;
+  synthetic_dataset_options.num_points2D_without_point3D = 50;
+  SynthesizeDataset(synthetic_dataset_options, &reconstruction, &database);
+  SynthesizeDescriptors(reconstruction, &database);
+
+  Localizer localizer(LocalizerOptions(), reconstruction, database);
+  EXPECT_EQ(localizer.NumPoints3D(), reconstruction.NumPoints3D());
+
+  for (const image_t image_id : reconstruction.RegImageIds()) {
+    const Image& image = reconstruction.Image(image_id);
+    const LocalizationResult result =
+        localizer.Localize(database.ReadKeypoints(image_id),
+                           database.ReadDescriptors(image_id),
+                           reconstruction.Camera(image.CameraId()));
+    ASSERT_TRUE(result.success);
+    EXPECT_GE(result.num_matches, result.num_inliers);
+    EXPECT_GE(result.num_inliers, 0.9 * image.NumPoints3D());
+    EXPECT_LT(result.cam_from_world.rotation.angularDistance(
+                  image.CamFromWorld().rotation),
+              1e-5);
+    EXPECT_LT((result.cam_from_world.translation -
+               image.CamFromWorld().translation)
+                  .norm(),
+              1e-5);
+    ASSERT_EQ(result.inlier_point2D_idxs.size(), result.num_inliers);
+    ASSERT_EQ(result.inlier_point3D_ids.size(), result.num_inliers);
+    for (size_t i = 0; i < result.num_inliers; ++i) {
+      EXPECT_EQ(image.Point2D(result.inlier_point2D_idxs[i]).point3D_id,
+                result.inlier_point3D_ids[i]);
+    }
+  }
+}
+
+TEST(Localizer, UnrelatedQuery) {
+  SetPRNGSeed(0);
+  Database database(Database::kInMemoryDatabasePath);
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_cameras = 1;
+  synthetic_dataset_options.num_images = 3;
+  synthetic_dataset_options.num_points3D = 100;
+  SynthesizeDataset(synthetic_dataset_options, &reconstruction, &database);
+  SynthesizeDescriptors(reconstruction, &database);
+
+  Localizer localizer(LocalizerOptions(), reconstruction, database);
+
+  const image_t image_id = reconstruction.RegImageIds().front();
+  const FeatureKeypoints keypoints = database.ReadKeypoints(image_id);
+  FeatureDescriptorsFloat descriptors(keypoints.size(), 128);
+  for (size_t i = 0; i < keypoints.size(); ++i) {
+    descriptors.row(i) = RandomDescriptor();
+  }
+  L2NormalizeFeatureDescriptors(&descriptors);
+  const LocalizationResult result = localizer.Localize(
+      keypoints,
+      FeatureDescriptorsToUnsignedByte(descriptors),
+      reconstruction.Camera(reconstruction.Image(image_id).CameraId()));
+  EXPECT_FALSE(result.success);
+  EXPECT_EQ(result.num_inliers, 0);
+  EXPECT_TRUE(result.inlier_point2D_idxs.empty());
+}
+
+}  // namespace
+}  // namespace colmap
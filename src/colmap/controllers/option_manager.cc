@@ -41,7 +41,9 @@
 #include "colmap/mvs/meshing.h"
 #include "colmap/mvs/patch_match.h"
 #include "colmap/ui/render_options.h"
+#include "colmap/util/memory_budget.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/threading.h"
 #include "colmap/util/version.h"
 
 #include <boost/filesystem/operations.hpp>
@@ -50,11 +52,41 @@
 namespace config = boost::program_options;
 
 namespace colmap {
+namespace {
+
+void SetGlobalMemoryBudget(const double memory_budget) {
+  MemoryBudget::Global().SetMaxNumBytes(
+      static_cast<size_t>(1024.0 * 1024.0 * 1024.0 * memory_budget));
+}
+
+bool ThreadAffinityFromString(const std::string& name,
+                              ThreadAffinity* affinity) {
+  if (name == "none") {
+    *affinity = ThreadAffinity::NONE;
+  } else if (name == "numa_node") {
+    *affinity = ThreadAffinity::NUMA_NODE;
+  } else if (name == "core") {
+    *affinity = ThreadAffinity::CORE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void SetGlobalThreadAffinity(const std::string& name) {
+  ThreadAffinity affinity = ThreadAffinity::NONE;
+  THROW_CHECK(ThreadAffinityFromString(name, &affinity));
+  SetThreadAffinity(affinity);
+}
+
+}  // namespace
 
 OptionManager::OptionManager(bool add_project_options) {
   project_path = std::make_shared<std::string>();
   database_path = std::make_shared<std::string>();
   image_path = std::make_shared<std::string>();
+  memory_budget = std::make_shared<double>(0.0);
+  thread_affinity = std::make_shared<std::string>("none");
 
   image_reader = std::make_shared<ImageReaderOptions>();
   sift_extraction = std::make_shared<SiftExtractionOptions>();
@@ -80,6 +112,8 @@ OptionManager::OptionManager(bool add_project_options) {
 
   AddRandomOptions();
   AddLogOptions();
+  AddMemoryOptions();
+  AddThreadOptions();
 
   if (add_project_options) {
     desc_->add_options()("project_path", config::value<std::string>());
@@ -96,6 +130,7 @@ void OptionManager::ModifyForVideoData() {
   const bool kResetPaths = false;
   ResetOptions(kResetPaths);
   mapper->mapper.init_min_tri_angle /= 2;
+  mapper->mapper.sequential = true;
   mapper->ba_global_images_ratio = 1.4;
   mapper->ba_global_points_ratio = 1.4;
   mapper->min_focal_length_ratio = 0.1;
@@ -173,6 +208,8 @@ void OptionManager::ModifyForExtremeQuality() {
 void OptionManager::AddAllOptions() {
   AddLogOptions();
   AddRandomOptions();
+  AddMemoryOptions();
+  AddThreadOptions();
   AddDatabaseOptions();
   AddImageOptions();
   AddExtractionOptions();
@@ -211,6 +248,24 @@ void OptionManager::AddRandomOptions() {
   AddAndRegisterDefaultOption("random_seed", &kDefaultPRNGSeed);
 }
 
+void OptionManager::AddMemoryOptions() {
+  if (added_memory_options_) {
+    return;
+  }
+  added_memory_options_ = true;
+
+  AddAndRegisterDefaultOption("memory_budget", memory_budget.get());
+}
+
+void OptionManager::AddThreadOptions() {
+  if (added_thread_options_) {
+    return;
+  }
+  added_thread_options_ = true;
+
+  AddAndRegisterDefaultOption("thread_affinity", thread_affinity.get());
+}
+
 void OptionManager::AddDatabaseOptions() {
   if (added_database_options_) {
     return;
@@ -253,17 +308,29 @@ void OptionManager::AddExtractionOptions() {
                               &image_reader->default_focal_length_factor);
   AddAndRegisterDefaultOption("ImageReader.camera_mask_path",
                               &image_reader->camera_mask_path);
+  AddAndRegisterDefaultOption("ImageReader.use_content_hash",
+                              &image_reader->use_content_hash);
 
   AddAndRegisterDefaultOption("SiftExtraction.num_threads",
                               &sift_extraction->num_threads);
+  AddAndRegisterDefaultOption("SiftExtraction.num_threads_per_image",
+                              &sift_extraction->num_threads_per_image);
   AddAndRegisterDefaultOption("SiftExtraction.use_gpu",
                               &sift_extraction->use_gpu);
   AddAndRegisterDefaultOption("SiftExtraction.gpu_index",
                               &sift_extraction->gpu_index);
+  AddAndRegisterDefaultOption("SiftExtraction.gpu_batch_size",
+                              &sift_extraction->gpu_batch_size);
   AddAndRegisterDefaultOption("SiftExtraction.max_image_size",
                               &sift_extraction->max_image_size);
+  AddAndRegisterDefaultOption("SiftExtraction.tiled_extraction",
+                              &sift_extraction->tiled_extraction);
+  AddAndRegisterDefaultOption("SiftExtraction.tile_overlap",
+                              &sift_extraction->tile_overlap);
   AddAndRegisterDefaultOption("SiftExtraction.max_num_features",
                               &sift_extraction->max_num_features);
+  AddAndRegisterDefaultOption("SiftExtraction.max_num_uniform_features",
+                              &sift_extraction->max_num_uniform_features);
   AddAndRegisterDefaultOption("SiftExtraction.first_octave",
                               &sift_extraction->first_octave);
   AddAndRegisterDefaultOption("SiftExtraction.num_octaves",
@@ -288,6 +355,8 @@ void OptionManager::AddExtractionOptions() {
                               &sift_extraction->dsp_max_scale);
   AddAndRegisterDefaultOption("SiftExtraction.dsp_num_scales",
                               &sift_extraction->dsp_num_scales);
+  AddAndRegisterDefaultOption("SiftExtraction.compact_descriptors",
+                              &sift_extraction->compact_descriptors);
 }
 
 void OptionManager::AddMatchingOptions() {
@@ -311,10 +380,32 @@ void OptionManager::AddMatchingOptions() {
                               &sift_matching->guided_matching);
   AddAndRegisterDefaultOption("SiftMatching.max_num_matches",
                               &sift_matching->max_num_matches);
+  AddAndRegisterDefaultOption("SiftMatching.max_num_pairs_per_commit",
+                              &sift_matching->max_num_pairs_per_commit);
+  AddAndRegisterDefaultOption("SiftMatching.max_num_bytes_per_commit",
+                              &sift_matching->max_num_bytes_per_commit);
+  AddAndRegisterDefaultOption("SiftMatching.num_shards",
+                              &sift_matching->num_shards);
+  AddAndRegisterDefaultOption("SiftMatching.shard_index",
+                              &sift_matching->shard_index);
+  AddAndRegisterDefaultOption("SiftMatching.pre_filter_num_features",
+                              &sift_matching->pre_filter_num_features);
+  AddAndRegisterDefaultOption("SiftMatching.pre_filter_min_num_matches",
+                              &sift_matching->pre_filter_min_num_matches);
+  AddAndRegisterDefaultOption("SiftMatching.sort_matches",
+                              &sift_matching->sort_matches);
+  AddAndRegisterDefaultOption("SiftMatching.reverify_matches",
+                              &sift_matching->reverify_matches);
+  AddAndRegisterDefaultOption("SiftMatching.num_matchers_per_gpu",
+                              &sift_matching->num_matchers_per_gpu);
   AddAndRegisterDefaultOption("TwoViewGeometry.min_num_inliers",
                               &two_view_geometry->min_num_inliers);
   AddAndRegisterDefaultOption("TwoViewGeometry.multiple_models",
                               &two_view_geometry->multiple_models);
+  AddAndRegisterDefaultOption("TwoViewGeometry.min_num_matches_parallel",
+                              &two_view_geometry->min_num_matches_parallel);
+  AddAndRegisterDefaultOption("TwoViewGeometry.use_prosac",
+                              &two_view_geometry->use_prosac);
   AddAndRegisterDefaultOption("TwoViewGeometry.compute_relative_pose",
                               &two_view_geometry->compute_relative_pose);
   AddAndRegisterDefaultOption("TwoViewGeometry.max_error",
@@ -327,6 +418,8 @@ void OptionManager::AddMatchingOptions() {
   AddAndRegisterDefaultOption(
       "TwoViewGeometry.min_inlier_ratio",
       &two_view_geometry->ransac_options.min_inlier_ratio);
+  AddAndRegisterDefaultOption("TwoViewGeometry.use_sprt",
+                              &two_view_geometry->ransac_options.use_sprt);
 }
 
 void OptionManager::AddExhaustiveMatchingOptions() {
@@ -339,6 +432,8 @@ void OptionManager::AddExhaustiveMatchingOptions() {
 
   AddAndRegisterDefaultOption("ExhaustiveMatching.block_size",
                               &exhaustive_matching->block_size);
+  AddAndRegisterDefaultOption("ExhaustiveMatching.cache_size",
+                              &exhaustive_matching->cache_size);
 }
 
 void OptionManager::AddSequentialMatchingOptions() {
@@ -372,6 +467,15 @@ void OptionManager::AddSequentialMatchingOptions() {
       &sequential_matching->loop_detection_max_num_features);
   AddAndRegisterDefaultOption("SequentialMatching.vocab_tree_path",
                               &sequential_matching->vocab_tree_path);
+  AddAndRegisterDefaultOption(
+      "SequentialMatching.loop_detection_index_path",
+      &sequential_matching->loop_detection_index_path);
+  AddAndRegisterDefaultOption("SequentialMatching.rig_config_path",
+                              &sequential_matching->rig_config_path);
+  AddAndRegisterDefaultOption("SequentialMatching.rig_max_view_angle",
+                              &sequential_matching->rig_max_view_angle);
+  AddAndRegisterDefaultOption("SequentialMatching.online",
+                              &sequential_matching->online);
 }
 
 void OptionManager::AddVocabTreeMatchingOptions() {
@@ -393,10 +497,28 @@ void OptionManager::AddVocabTreeMatchingOptions() {
       &vocab_tree_matching->num_images_after_verification);
   AddAndRegisterDefaultOption("VocabTreeMatching.max_num_features",
                               &vocab_tree_matching->max_num_features);
+  AddAndRegisterDefaultOption("VocabTreeMatching.max_document_frequency",
+                              &vocab_tree_matching->max_document_frequency);
   AddAndRegisterDefaultOption("VocabTreeMatching.vocab_tree_path",
                               &vocab_tree_matching->vocab_tree_path);
   AddAndRegisterDefaultOption("VocabTreeMatching.match_list_path",
                               &vocab_tree_matching->match_list_path);
+  AddAndRegisterDefaultOption("VocabTreeMatching.index_path",
+                              &vocab_tree_matching->index_path);
+  AddAndRegisterDefaultOption("VocabTreeMatching.use_gpu",
+                              &vocab_tree_matching->use_gpu);
+  AddAndRegisterDefaultOption("VocabTreeMatching.gpu_index",
+                              &vocab_tree_matching->gpu_index);
+  AddAndRegisterDefaultOption("VocabTreeMatching.use_global_descriptors",
+                              &vocab_tree_matching->use_global_descriptors);
+  AddAndRegisterDefaultOption(
+      "VocabTreeMatching.global_descriptor_num_clusters",
+      &vocab_tree_matching->global_descriptor_num_clusters);
+  AddAndRegisterDefaultOption(
+      "VocabTreeMatching.global_descriptor_num_probes",
+      &vocab_tree_matching->global_descriptor_num_probes);
+  AddAndRegisterDefaultOption("VocabTreeMatching.cache_size",
+                              &vocab_tree_matching->cache_size);
 }
 
 void OptionManager::AddSpatialMatchingOptions() {
@@ -413,6 +535,10 @@ void OptionManager::AddSpatialMatchingOptions() {
                               &spatial_matching->max_num_neighbors);
   AddAndRegisterDefaultOption("SpatialMatching.max_distance",
                               &spatial_matching->max_distance);
+  AddAndRegisterDefaultOption("SpatialMatching.rig_config_path",
+                              &spatial_matching->rig_config_path);
+  AddAndRegisterDefaultOption("SpatialMatching.rig_max_view_angle",
+                              &spatial_matching->rig_max_view_angle);
 }
 
 void OptionManager::AddTransitiveMatchingOptions() {
@@ -470,6 +596,21 @@ void OptionManager::AddBundleAdjustmentOptions() {
                               &bundle_adjustment->refine_extra_params);
   AddAndRegisterDefaultOption("BundleAdjustment.refine_extrinsics",
                               &bundle_adjustment->refine_extrinsics);
+  AddAndRegisterDefaultOption("BundleAdjustment.use_analytic_jacobians",
+                              &bundle_adjustment->use_analytic_jacobians);
+  AddAndRegisterDefaultOption("BundleAdjustment.use_float_jacobians",
+                              &bundle_adjustment->use_float_jacobians);
+  AddAndRegisterDefaultOption("BundleAdjustment.use_batched_evaluation",
+                              &bundle_adjustment->use_batched_evaluation);
+  AddAndRegisterDefaultOption("BundleAdjustment.use_gpu",
+                              &bundle_adjustment->use_gpu);
+  AddAndRegisterDefaultOption("BundleAdjustment.gpu_index",
+                              &bundle_adjustment->gpu_index);
+  AddAndRegisterDefaultOption("BundleAdjustment.min_num_images_gpu_solver",
+                              &bundle_adjustment->min_num_images_gpu_solver);
+  AddAndRegisterDefaultOption(
+      "BundleAdjustment.points3D_subsampling_num_levels",
+      &bundle_adjustment->points3D_subsampling_num_levels);
 }
 
 void OptionManager::AddMapperOptions() {
@@ -494,6 +635,8 @@ void OptionManager::AddMapperOptions() {
                               &mapper->init_num_trials);
   AddAndRegisterDefaultOption("Mapper.extract_colors", &mapper->extract_colors);
   AddAndRegisterDefaultOption("Mapper.num_threads", &mapper->num_threads);
+  AddAndRegisterDefaultOption("Mapper.num_component_workers",
+                              &mapper->num_component_workers);
   AddAndRegisterDefaultOption("Mapper.min_focal_length_ratio",
                               &mapper->min_focal_length_ratio);
   AddAndRegisterDefaultOption("Mapper.max_focal_length_ratio",
@@ -506,6 +649,8 @@ void OptionManager::AddMapperOptions() {
                               &mapper->ba_refine_principal_point);
   AddAndRegisterDefaultOption("Mapper.ba_refine_extra_params",
                               &mapper->ba_refine_extra_params);
+  AddAndRegisterDefaultOption("Mapper.ba_use_analytic_jacobians",
+                              &mapper->ba_use_analytic_jacobians);
   AddAndRegisterDefaultOption(
       "Mapper.ba_min_num_residuals_for_multi_threading",
       &mapper->ba_min_num_residuals_for_multi_threading);
@@ -523,10 +668,26 @@ void OptionManager::AddMapperOptions() {
                               &mapper->ba_global_images_freq);
   AddAndRegisterDefaultOption("Mapper.ba_global_points_freq",
                               &mapper->ba_global_points_freq);
+  AddAndRegisterDefaultOption("Mapper.ba_global_adaptive",
+                              &mapper->ba_global_adaptive);
+  AddAndRegisterDefaultOption("Mapper.ba_global_max_reproj_error_drift",
+                              &mapper->ba_global_max_reproj_error_drift);
   AddAndRegisterDefaultOption("Mapper.ba_global_function_tolerance",
                               &mapper->ba_global_function_tolerance);
   AddAndRegisterDefaultOption("Mapper.ba_global_max_num_iterations",
                               &mapper->ba_global_max_num_iterations);
+  AddAndRegisterDefaultOption("Mapper.ba_global_use_gpu",
+                              &mapper->ba_global_use_gpu);
+  AddAndRegisterDefaultOption("Mapper.ba_global_gpu_index",
+                              &mapper->ba_global_gpu_index);
+  AddAndRegisterDefaultOption("Mapper.ba_global_reuse_problem",
+                              &mapper->ba_global_reuse_problem);
+  AddAndRegisterDefaultOption(
+      "Mapper.ba_global_max_num_images_per_partition",
+      &mapper->ba_global_max_num_images_per_partition);
+  AddAndRegisterDefaultOption(
+      "Mapper.ba_global_points3D_subsampling_num_levels",
+      &mapper->ba_global_points3D_subsampling_num_levels);
   AddAndRegisterDefaultOption("Mapper.ba_global_max_refinements",
                               &mapper->ba_global_max_refinements);
   AddAndRegisterDefaultOption("Mapper.ba_global_max_refinement_change",
@@ -535,9 +696,25 @@ void OptionManager::AddMapperOptions() {
                               &mapper->ba_local_max_refinements);
   AddAndRegisterDefaultOption("Mapper.ba_local_max_refinement_change",
                               &mapper->ba_local_max_refinement_change);
+  AddAndRegisterDefaultOption("Mapper.reg_batch_size",
+                              &mapper->reg_batch_size);
+  AddAndRegisterDefaultOption("Mapper.reg_batch_min_num_visible_points3D",
+                              &mapper->reg_batch_min_num_visible_points3D);
   AddAndRegisterDefaultOption("Mapper.snapshot_path", &mapper->snapshot_path);
   AddAndRegisterDefaultOption("Mapper.snapshot_images_freq",
                               &mapper->snapshot_images_freq);
+  AddAndRegisterDefaultOption("Mapper.snapshot_incremental",
+                              &mapper->snapshot_incremental);
+  AddAndRegisterDefaultOption("Mapper.checkpoint_path",
+                              &mapper->checkpoint_path);
+  AddAndRegisterDefaultOption("Mapper.checkpoint_images_freq",
+                              &mapper->checkpoint_images_freq);
+  AddAndRegisterDefaultOption("Mapper.resume", &mapper->resume);
+  AddAndRegisterDefaultOption("Mapper.correspondence_graph_cache_path",
+                              &mapper->correspondence_graph_cache_path);
+  AddAndRegisterDefaultOption("Mapper.lazy_points2D", &mapper->lazy_points2D);
+  AddAndRegisterDefaultOption("Mapper.max_num_neighbors",
+                              &mapper->max_num_neighbors);
   AddAndRegisterDefaultOption("Mapper.fix_existing_images",
                               &mapper->fix_existing_images);
 
@@ -558,14 +735,27 @@ void OptionManager::AddMapperOptions() {
                               &mapper->mapper.abs_pose_min_num_inliers);
   AddAndRegisterDefaultOption("Mapper.abs_pose_min_inlier_ratio",
                               &mapper->mapper.abs_pose_min_inlier_ratio);
+  AddAndRegisterDefaultOption("Mapper.abs_pose_use_sprt",
+                              &mapper->mapper.abs_pose_use_sprt);
+  AddAndRegisterDefaultOption("Mapper.abs_pose_use_prosac",
+                              &mapper->mapper.abs_pose_use_prosac);
   AddAndRegisterDefaultOption("Mapper.filter_max_reproj_error",
                               &mapper->mapper.filter_max_reproj_error);
   AddAndRegisterDefaultOption("Mapper.filter_min_tri_angle",
                               &mapper->mapper.filter_min_tri_angle);
   AddAndRegisterDefaultOption("Mapper.max_reg_trials",
                               &mapper->mapper.max_reg_trials);
+  AddAndRegisterDefaultOption("Mapper.num_parallel_reg_candidates",
+                              &mapper->mapper.num_parallel_reg_candidates);
+  AddAndRegisterDefaultOption(
+      "Mapper.num_parallel_init_pair_candidates",
+      &mapper->mapper.num_parallel_init_pair_candidates);
   AddAndRegisterDefaultOption("Mapper.local_ba_min_tri_angle",
                               &mapper->mapper.local_ba_min_tri_angle);
+  AddAndRegisterDefaultOption("Mapper.sequential",
+                              &mapper->mapper.sequential);
+  AddAndRegisterDefaultOption("Mapper.sequential_loop_min_frame_gap",
+                              &mapper->mapper.sequential_loop_min_frame_gap);
 
   // IncrementalTriangulator.
   AddAndRegisterDefaultOption("Mapper.tri_max_transitivity",
@@ -600,8 +790,12 @@ void OptionManager::AddPatchMatchStereoOptions() {
 
   AddAndRegisterDefaultOption("PatchMatchStereo.max_image_size",
                               &patch_match_stereo->max_image_size);
+  AddAndRegisterDefaultOption("PatchMatchStereo.use_gpu",
+                              &patch_match_stereo->use_gpu);
   AddAndRegisterDefaultOption("PatchMatchStereo.gpu_index",
                               &patch_match_stereo->gpu_index);
+  AddAndRegisterDefaultOption("PatchMatchStereo.num_threads",
+                              &patch_match_stereo->num_threads);
   AddAndRegisterDefaultOption("PatchMatchStereo.depth_min",
                               &patch_match_stereo->depth_min);
   AddAndRegisterDefaultOption("PatchMatchStereo.depth_max",
@@ -624,6 +818,12 @@ void OptionManager::AddPatchMatchStereoOptions() {
                               &patch_match_stereo->incident_angle_sigma);
   AddAndRegisterDefaultOption("PatchMatchStereo.num_iterations",
                               &patch_match_stereo->num_iterations);
+  AddAndRegisterDefaultOption("PatchMatchStereo.num_pyramid_levels",
+                              &patch_match_stereo->num_pyramid_levels);
+  AddAndRegisterDefaultOption("PatchMatchStereo.pyramid_num_iterations",
+                              &patch_match_stereo->pyramid_num_iterations);
+  AddAndRegisterDefaultOption("PatchMatchStereo.init_from_sparse_points",
+                              &patch_match_stereo->init_from_sparse_points);
   AddAndRegisterDefaultOption("PatchMatchStereo.geom_consistency",
                               &patch_match_stereo->geom_consistency);
   AddAndRegisterDefaultOption(
@@ -631,6 +831,10 @@ void OptionManager::AddPatchMatchStereoOptions() {
       &patch_match_stereo->geom_consistency_regularizer);
   AddAndRegisterDefaultOption("PatchMatchStereo.geom_consistency_max_cost",
                               &patch_match_stereo->geom_consistency_max_cost);
+  AddAndRegisterDefaultOption("PatchMatchStereo.half_precision_depth_maps",
+                              &patch_match_stereo->half_precision_depth_maps);
+  AddAndRegisterDefaultOption("PatchMatchStereo.gpu_depth_map_cache_size",
+                              &patch_match_stereo->gpu_depth_map_cache_size);
   AddAndRegisterDefaultOption("PatchMatchStereo.filter",
                               &patch_match_stereo->filter);
   AddAndRegisterDefaultOption("PatchMatchStereo.filter_min_ncc",
@@ -649,6 +853,20 @@ void OptionManager::AddPatchMatchStereoOptions() {
                               &patch_match_stereo->allow_missing_files);
   AddAndRegisterDefaultOption("PatchMatchStereo.write_consistency_graph",
                               &patch_match_stereo->write_consistency_graph);
+  AddAndRegisterDefaultOption("PatchMatchStereo.write_compressed_maps",
+                              &patch_match_stereo->write_compressed_maps);
+  AddAndRegisterDefaultOption("PatchMatchStereo.scored_src_image_selection",
+                              &patch_match_stereo->scored_src_image_selection);
+  AddAndRegisterDefaultOption("PatchMatchStereo.src_image_min_score_ratio",
+                              &patch_match_stereo->src_image_min_score_ratio);
+  AddAndRegisterDefaultOption("PatchMatchStereo.tile_size",
+                              &patch_match_stereo->tile_size);
+  AddAndRegisterDefaultOption("PatchMatchStereo.tile_overlap",
+                              &patch_match_stereo->tile_overlap);
+  AddAndRegisterDefaultOption("PatchMatchStereo.num_shards",
+                              &patch_match_stereo->num_shards);
+  AddAndRegisterDefaultOption("PatchMatchStereo.shard_index",
+                              &patch_match_stereo->shard_index);
 }
 
 void OptionManager::AddStereoFusionOptions() {
@@ -681,6 +899,15 @@ void OptionManager::AddStereoFusionOptions() {
                               &stereo_fusion->cache_size);
   AddAndRegisterDefaultOption("StereoFusion.use_cache",
                               &stereo_fusion->use_cache);
+  AddAndRegisterDefaultOption("StereoFusion.out_of_core_path",
+                              &stereo_fusion->out_of_core_path);
+  AddAndRegisterDefaultOption("StereoFusion.use_gpu", &stereo_fusion->use_gpu);
+  AddAndRegisterDefaultOption("StereoFusion.gpu_index",
+                              &stereo_fusion->gpu_index);
+  AddAndRegisterDefaultOption("StereoFusion.use_consistency_graph",
+                              &stereo_fusion->use_consistency_graph);
+  AddAndRegisterDefaultOption("StereoFusion.max_num_concurrent_images",
+                              &stereo_fusion->max_num_concurrent_images);
 }
 
 void OptionManager::AddPoissonMeshingOptions() {
@@ -696,6 +923,12 @@ void OptionManager::AddPoissonMeshingOptions() {
   AddAndRegisterDefaultOption("PoissonMeshing.trim", &poisson_meshing->trim);
   AddAndRegisterDefaultOption("PoissonMeshing.num_threads",
                               &poisson_meshing->num_threads);
+  AddAndRegisterDefaultOption("PoissonMeshing.downsample_voxel_size",
+                              &poisson_meshing->downsample_voxel_size);
+  AddAndRegisterDefaultOption("PoissonMeshing.tile_size",
+                              &poisson_meshing->tile_size);
+  AddAndRegisterDefaultOption("PoissonMeshing.tile_overlap",
+                              &poisson_meshing->tile_overlap);
 }
 
 void OptionManager::AddDelaunayMeshingOptions() {
@@ -720,6 +953,14 @@ void OptionManager::AddDelaunayMeshingOptions() {
                               &delaunay_meshing->max_side_length_percentile);
   AddAndRegisterDefaultOption("DelaunayMeshing.num_threads",
                               &delaunay_meshing->num_threads);
+  AddAndRegisterDefaultOption("DelaunayMeshing.parallel_graph_cut",
+                              &delaunay_meshing->parallel_graph_cut);
+  AddAndRegisterDefaultOption("DelaunayMeshing.downsample_voxel_size",
+                              &delaunay_meshing->downsample_voxel_size);
+  AddAndRegisterDefaultOption("DelaunayMeshing.tile_size",
+                              &delaunay_meshing->tile_size);
+  AddAndRegisterDefaultOption("DelaunayMeshing.tile_overlap",
+                              &delaunay_meshing->tile_overlap);
 }
 
 void OptionManager::AddRenderOptions() {
@@ -754,6 +995,8 @@ void OptionManager::Reset() {
 
   added_log_options_ = false;
   added_random_options_ = false;
+  added_memory_options_ = false;
+  added_thread_options_ = false;
   added_database_options_ = false;
   added_image_options_ = false;
   added_extraction_options_ = false;
@@ -795,6 +1038,8 @@ void OptionManager::ResetOptions(const bool reset_paths) {
   *poisson_meshing = mvs::PoissonMeshingOptions();
   *delaunay_meshing = mvs::DelaunayMeshingOptions();
   *render = RenderOptions();
+  *memory_budget = 0.0;
+  *thread_affinity = "none";
 }
 
 bool OptionManager::Check() {
@@ -810,6 +1055,15 @@ bool OptionManager::Check() {
   if (added_image_options_)
     success = success && CHECK_OPTION_IMPL(ExistsDir(*image_path));
 
+  if (added_memory_options_)
+    success = success && CHECK_OPTION_IMPL(*memory_budget >= 0);
+
+  if (added_thread_options_) {
+    ThreadAffinity affinity;
+    success = success && CHECK_OPTION_IMPL(ThreadAffinityFromString(
+                             *thread_affinity, &affinity));
+  }
+
   if (image_reader) success = success && image_reader->Check();
   if (sift_extraction) success = success && sift_extraction->Check();
 
@@ -878,6 +1132,9 @@ void OptionManager::Parse(const int argc, char** argv) {
     // NOLINTNEXTLINE(concurrency-mt-unsafe)
     exit(EXIT_FAILURE);
   }
+
+  SetGlobalMemoryBudget(*memory_budget);
+  SetGlobalThreadAffinity(*thread_affinity);
 }
 
 bool OptionManager::Read(const std::string& path) {
@@ -901,7 +1158,13 @@ bool OptionManager::Read(const std::string& path) {
     return false;
   }
 
-  return Check();
+  if (!Check()) {
+    return false;
+  }
+
+  SetGlobalMemoryBudget(*memory_budget);
+  SetGlobalThreadAffinity(*thread_affinity);
+  return true;
 }
 
 bool OptionManager::ReRead(const std::string& path) {
@@ -80,6 +80,8 @@ class OptionManager {
   void AddAllOptions();
   void AddLogOptions();
   void AddRandomOptions();
+  void AddMemoryOptions();
+  void AddThreadOptions();
   void AddDatabaseOptions();
   void AddImageOptions();
   void AddExtractionOptions();
@@ -121,6 +123,14 @@ class OptionManager {
   std::shared_ptr<std::string> database_path;
   std::shared_ptr<std::string> image_path;
 
+  // Global memory budget in gigabytes shared by all caches, see
+  // util/memory_budget.h. Zero for an unlimited budget.
+  std::shared_ptr<double> memory_budget;
+
+  // Placement of the workers of thread pools on the CPUs, i.e., "none",
+  // "numa_node", or "core", see ThreadAffinity in util/threading.h.
+  std::shared_ptr<std::string> thread_affinity;
+
   std::shared_ptr<ImageReaderOptions> image_reader;
   std::shared_ptr<SiftExtractionOptions> sift_extraction;
 
@@ -165,6 +175,8 @@ class OptionManager {
 
   bool added_log_options_;
   bool added_random_options_;
+  bool added_memory_options_;
+  bool added_thread_options_;
   bool added_database_options_;
   bool added_image_options_;
   bool added_extraction_options_;
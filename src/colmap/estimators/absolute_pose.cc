@@ -96,21 +96,13 @@ void P3PEstimator::Estimate(const std::vector<X_t>& points2D,
               (p * r + q * p2 - 2 * q) * b + (r * p + 2 * q) * a * b - 2 * q;
   coeffs(4) = a2 + b2 - 2 * a + (2 - p2) * b - 2 * a * b + 1;
 
-  Eigen::VectorXd roots_real;
-  Eigen::VectorXd roots_imag;
-  if (!FindPolynomialRootsCompanionMatrix(coeffs, &roots_real, &roots_imag)) {
-    return;
-  }
-
-  models->reserve(roots_real.size());
+  Eigen::Matrix<double, 4, 1> roots;
+  const int num_roots = FindRealPolynomialRootsSturm<4>(coeffs, &roots);
 
-  for (Eigen::VectorXd::Index i = 0; i < roots_real.size(); ++i) {
-    const double kMaxRootImag = 1e-10;
-    if (std::abs(roots_imag(i)) > kMaxRootImag) {
-      continue;
-    }
+  models->reserve(num_roots);
 
-    const double x = roots_real(i);
+  for (int i = 0; i < num_roots; ++i) {
+    const double x = roots(i);
     if (x < 0) {
       continue;
     }
@@ -34,31 +34,95 @@
 #include "colmap/optim/loransac.h"
 #include "colmap/scene/projection.h"
 #include "colmap/util/logging.h"
+#include "colmap/util/threading.h"
 
+#include <memory>
 #include <unordered_map>
 
 namespace colmap {
 namespace {
 
+// Observations of an image registered in both reconstructions, whose 2D points
+// are triangulated in both reconstructions. They are extracted once before
+// RANSAC, such that the residual evaluation does not need to scan all 2D
+// points and look up their 3D points in every iteration.
+struct CommonImage {
+  Eigen::Vector3d src_proj_center;
+  Eigen::Vector3d tgt_proj_center;
+  Eigen::Matrix3x4d src_cam_from_world;
+  Eigen::Matrix3x4d tgt_cam_from_world;
+  const Camera* src_camera = nullptr;
+  const Camera* tgt_camera = nullptr;
+  std::vector<Eigen::Vector2d> src_points2D;
+  std::vector<Eigen::Vector2d> tgt_points2D;
+  std::vector<Eigen::Vector3d> src_points3D;
+  std::vector<Eigen::Vector3d> tgt_points3D;
+};
+
+typedef std::vector<CommonImage, Eigen::aligned_allocator<CommonImage>>
+    CommonImageVector;
+
+CommonImage ExtractCommonImage(const Reconstruction& src_reconstruction,
+                               const Reconstruction& tgt_reconstruction,
+                               const Image& src_image,
+                               const Image& tgt_image) {
+  THROW_CHECK_EQ(src_image.ImageId(), tgt_image.ImageId());
+  THROW_CHECK_EQ(src_image.NumPoints2D(), tgt_image.NumPoints2D());
+
+  CommonImage common_image;
+  common_image.src_proj_center = src_image.ProjectionCenter();
+  common_image.tgt_proj_center = tgt_image.ProjectionCenter();
+  common_image.src_cam_from_world = src_image.CamFromWorld().ToMatrix();
+  common_image.tgt_cam_from_world = tgt_image.CamFromWorld().ToMatrix();
+  common_image.src_camera = &src_reconstruction.Camera(src_image.CameraId());
+  common_image.tgt_camera = &tgt_reconstruction.Camera(tgt_image.CameraId());
+
+  for (point2D_t point2D_idx = 0; point2D_idx < src_image.NumPoints2D();
+       ++point2D_idx) {
+    // Check if both images have a 3D point.
+
+    const auto& src_point2D = src_image.Point2D(point2D_idx);
+    if (!src_point2D.HasPoint3D()) {
+      continue;
+    }
+
+    const auto& tgt_point2D = tgt_image.Point2D(point2D_idx);
+    if (!tgt_point2D.HasPoint3D()) {
+      continue;
+    }
+
+    common_image.src_points2D.push_back(src_point2D.xy);
+    common_image.tgt_points2D.push_back(tgt_point2D.xy);
+    common_image.src_points3D.push_back(
+        src_reconstruction.Point3D(src_point2D.point3D_id).xyz);
+    common_image.tgt_points3D.push_back(
+        tgt_reconstruction.Point3D(tgt_point2D.point3D_id).xyz);
+  }
+
+  return common_image;
+}
+
 struct ReconstructionAlignmentEstimator {
   static const int kMinNumSamples = 3;
 
-  typedef const Image* X_t;
-  typedef const Image* Y_t;
+  // The source and target samples are the same common images.
+  typedef const CommonImage* X_t;
+  typedef const CommonImage* Y_t;
   typedef Sim3d M_t;
 
   void SetMaxReprojError(const double max_reproj_error) {
     max_squared_reproj_error_ = max_reproj_error * max_reproj_error;
   }
 
-  void SetReconstructions(const Reconstruction* src_reconstruction,
-                          const Reconstruction* tgt_reconstruction) {
-    THROW_CHECK_NOTNULL(src_reconstruction);
-    THROW_CHECK_NOTNULL(tgt_reconstruction);
-    src_reconstruction_ = src_reconstruction;
-    tgt_reconstruction_ = tgt_reconstruction;
+  // Evaluate the inlier ratio of each image on an evenly strided subset of at
+  // most the given number of common points, or on all points if not positive.
+  void SetMaxNumPointsPerImage(const int max_num_points_per_image) {
+    max_num_points_per_image_ = max_num_points_per_image;
   }
 
+  // Evaluate the residuals of the images in parallel on the given pool.
+  void SetThreadPool(ThreadPool* thread_pool) { thread_pool_ = thread_pool; }
+
   // Estimate 3D similarity transform from corresponding projection centers.
   void Estimate(const std::vector<X_t>& src_images,
                 const std::vector<Y_t>& tgt_images,
@@ -73,9 +137,9 @@ struct ReconstructionAlignmentEstimator {
     std::vector<Eigen::Vector3d> proj_centers1(src_images.size());
     std::vector<Eigen::Vector3d> proj_centers2(tgt_images.size());
     for (size_t i = 0; i < src_images.size(); ++i) {
-      THROW_CHECK_EQ(src_images[i]->ImageId(), tgt_images[i]->ImageId());
-      proj_centers1[i] = src_images[i]->ProjectionCenter();
-      proj_centers2[i] = tgt_images[i]->ProjectionCenter();
+      THROW_CHECK_EQ(src_images[i], tgt_images[i]);
+      proj_centers1[i] = src_images[i]->src_proj_center;
+      proj_centers2[i] = tgt_images[i]->tgt_proj_center;
     }
 
     Sim3d tgt_from_src;
@@ -97,68 +161,44 @@ struct ReconstructionAlignmentEstimator {
                  const M_t& tgt_from_src,
                  std::vector<double>* residuals) const {
     THROW_CHECK_EQ(src_images.size(), tgt_images.size());
-    THROW_CHECK_NOTNULL(src_reconstruction_);
-    THROW_CHECK_NOTNULL(tgt_reconstruction_);
 
     const Sim3d srcFromTgt = Inverse(tgt_from_src);
 
     residuals->resize(src_images.size());
 
-    for (size_t i = 0; i < src_images.size(); ++i) {
-      const auto& src_image = *src_images[i];
-      const auto& tgt_image = *tgt_images[i];
-
-      THROW_CHECK_EQ(src_image.ImageId(), tgt_image.ImageId());
-
-      const auto& src_camera =
-          src_reconstruction_->Camera(src_image.CameraId());
-      const auto& tgt_camera =
-          tgt_reconstruction_->Camera(tgt_image.CameraId());
-
-      const Eigen::Matrix3x4d src_cam_from_world =
-          src_image.CamFromWorld().ToMatrix();
-      const Eigen::Matrix3x4d tgt_cam_from_world =
-          tgt_image.CamFromWorld().ToMatrix();
-
-      THROW_CHECK_EQ(src_image.NumPoints2D(), tgt_image.NumPoints2D());
+    const auto ComputeResidual = [&](const size_t i) {
+      THROW_CHECK_EQ(src_images[i], tgt_images[i]);
+      const CommonImage& image = *src_images[i];
 
+      const size_t num_common_points = image.src_points2D.size();
+      size_t stride = 1;
+      if (max_num_points_per_image_ > 0 &&
+          num_common_points > static_cast<size_t>(max_num_points_per_image_)) {
+        stride = (num_common_points + max_num_points_per_image_ - 1) /
+                 max_num_points_per_image_;
+      }
+      size_t num_evaluated_points = 0;
       size_t num_inliers = 0;
-      size_t num_common_points = 0;
 
-      for (point2D_t point2D_idx = 0; point2D_idx < src_image.NumPoints2D();
-           ++point2D_idx) {
-        // Check if both images have a 3D point.
-
-        const auto& src_point2D = src_image.Point2D(point2D_idx);
-        if (!src_point2D.HasPoint3D()) {
-          continue;
-        }
-
-        const auto& tgt_point2D = tgt_image.Point2D(point2D_idx);
-        if (!tgt_point2D.HasPoint3D()) {
-          continue;
-        }
-
-        num_common_points += 1;
+      for (size_t j = 0; j < num_common_points; j += stride) {
+        num_evaluated_points += 1;
 
         const Eigen::Vector3d src_point_in_tgt =
-            tgt_from_src *
-            src_reconstruction_->Point3D(src_point2D.point3D_id).xyz;
-        if (CalculateSquaredReprojectionError(tgt_point2D.xy,
+            tgt_from_src * image.src_points3D[j];
+        if (CalculateSquaredReprojectionError(image.tgt_points2D[j],
                                               src_point_in_tgt,
-                                              tgt_cam_from_world,
-                                              tgt_camera) >
+                                              image.tgt_cam_from_world,
+                                              *image.tgt_camera) >
             max_squared_reproj_error_) {
           continue;
         }
 
         const Eigen::Vector3d tgt_point_in_src =
-            srcFromTgt *
-            tgt_reconstruction_->Point3D(tgt_point2D.point3D_id).xyz;
-        if (CalculateSquaredReprojectionError(src_point2D.xy,
+            srcFromTgt * image.tgt_points3D[j];
+        if (CalculateSquaredReprojectionError(image.src_points2D[j],
                                               tgt_point_in_src,
-                                              src_cam_from_world,
-                                              src_camera) >
+                                              image.src_cam_from_world,
+                                              *image.src_camera) >
             max_squared_reproj_error_) {
           continue;
         }
@@ -166,23 +206,42 @@ struct ReconstructionAlignmentEstimator {
         num_inliers += 1;
       }
 
-      if (num_common_points == 0) {
+      if (num_evaluated_points == 0) {
         (*residuals)[i] = 1.0;
       } else {
         const double negative_inlier_ratio =
             1.0 - static_cast<double>(num_inliers) /
-                      static_cast<double>(num_common_points);
+                      static_cast<double>(num_evaluated_points);
         (*residuals)[i] = negative_inlier_ratio * negative_inlier_ratio;
       }
+    };
+
+    if (thread_pool_ == nullptr) {
+      for (size_t i = 0; i < src_images.size(); ++i) {
+        ComputeResidual(i);
+      }
+    } else {
+      thread_pool_->ParallelFor(
+          0, src_images.size(), /*grain_size=*/1, [&](const int64_t i) {
+            ComputeResidual(i);
+          });
     }
   }
 
  private:
   double max_squared_reproj_error_ = 0.0;
-  const Reconstruction* src_reconstruction_ = nullptr;
-  const Reconstruction* tgt_reconstruction_ = nullptr;
+  int max_num_points_per_image_ = 0;
+  ThreadPool* thread_pool_ = nullptr;
 };
 
+// Number of common points per image, on which the inlier ratios are evaluated
+// inside RANSAC, before the final model is refined using all points.
+constexpr int kMaxNumPointsPerImageForRANSAC = 500;
+
+// Minimum number of common points, from which on the residuals are evaluated
+// in parallel.
+constexpr size_t kMinNumPointsForParallelAlignment = 100000;
+
 }  // namespace
 
 bool AlignReconstructionToLocations(
@@ -259,10 +318,7 @@ bool AlignReconstructionsViaReprojections(
   LORANSAC<ReconstructionAlignmentEstimator, ReconstructionAlignmentEstimator>
       ransac(ransac_options);
   ransac.estimator.SetMaxReprojError(max_reproj_error);
-  ransac.estimator.SetReconstructions(&src_reconstruction, &tgt_reconstruction);
   ransac.local_estimator.SetMaxReprojError(max_reproj_error);
-  ransac.local_estimator.SetReconstructions(&src_reconstruction,
-                                            &tgt_reconstruction);
 
   const std::vector<std::pair<image_t, image_t>> common_image_ids =
       src_reconstruction.FindCommonRegImageIds(tgt_reconstruction);
@@ -271,20 +327,73 @@ bool AlignReconstructionsViaReprojections(
     return false;
   }
 
-  std::vector<const Image*> src_images(common_image_ids.size());
-  std::vector<const Image*> tgt_images(common_image_ids.size());
-  for (size_t i = 0; i < common_image_ids.size(); ++i) {
-    src_images[i] = &src_reconstruction.Image(common_image_ids[i].first);
-    tgt_images[i] = &tgt_reconstruction.Image(common_image_ids[i].second);
+  CommonImageVector common_images;
+  common_images.reserve(common_image_ids.size());
+  for (const auto& image_ids : common_image_ids) {
+    common_images.push_back(
+        ExtractCommonImage(src_reconstruction,
+                           tgt_reconstruction,
+                           src_reconstruction.Image(image_ids.first),
+                           tgt_reconstruction.Image(image_ids.second)));
   }
 
-  const auto report = ransac.Estimate(src_images, tgt_images);
+  std::vector<const CommonImage*> common_image_ptrs(common_images.size());
+  size_t num_common_points = 0;
+  for (size_t i = 0; i < common_images.size(); ++i) {
+    common_image_ptrs[i] = &common_images[i];
+    num_common_points += common_images[i].src_points2D.size();
+  }
 
-  if (report.success) {
-    *tgt_from_src = report.model;
+  std::unique_ptr<ThreadPool> thread_pool;
+  if (num_common_points >= kMinNumPointsForParallelAlignment) {
+    thread_pool = std::make_unique<ThreadPool>();
   }
 
-  return report.success;
+  // Hypotheses are only evaluated on a subset of the points of each image.
+  ransac.estimator.SetMaxNumPointsPerImage(kMaxNumPointsPerImageForRANSAC);
+  ransac.estimator.SetThreadPool(thread_pool.get());
+  ransac.local_estimator.SetMaxNumPointsPerImage(
+      kMaxNumPointsPerImageForRANSAC);
+  ransac.local_estimator.SetThreadPool(thread_pool.get());
+
+  const auto report = ransac.Estimate(common_image_ptrs, common_image_ptrs);
+  if (!report.success) {
+    return false;
+  }
+
+  // Refine the model on the inlier images determined using all points and
+  // keep it, if it is supported by at least as many images.
+  ReconstructionAlignmentEstimator estimator;
+  estimator.SetMaxReprojError(max_reproj_error);
+  estimator.SetThreadPool(thread_pool.get());
+
+  const auto CollectInliers = [&](const Sim3d& model) {
+    std::vector<double> residuals;
+    estimator.Residuals(
+        common_image_ptrs, common_image_ptrs, model, &residuals);
+    std::vector<const CommonImage*> inlier_images;
+    for (size_t i = 0; i < residuals.size(); ++i) {
+      if (residuals[i] <= ransac_options.max_error) {
+        inlier_images.push_back(common_image_ptrs[i]);
+      }
+    }
+    return inlier_images;
+  };
+
+  *tgt_from_src = report.model;
+  const std::vector<const CommonImage*> inlier_images =
+      CollectInliers(report.model);
+  if (inlier_images.size() >=
+      static_cast<size_t>(ReconstructionAlignmentEstimator::kMinNumSamples)) {
+    std::vector<Sim3d> refined_models;
+    estimator.Estimate(inlier_images, inlier_images, &refined_models);
+    if (!refined_models.empty() &&
+        CollectInliers(refined_models[0]).size() >= inlier_images.size()) {
+      *tgt_from_src = refined_models[0];
+    }
+  }
+
+  return true;
 }
 
 bool AlignReconstructionsViaProjCenters(
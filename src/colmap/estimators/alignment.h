@@ -48,7 +48,10 @@ bool AlignReconstructionToLocations(
 // robustly inside RANSAC from corresponding projection centers. An alignment
 // is verified by reprojecting common 3D point observations.
 // The min_inlier_observations threshold determines how many observations
-// in a common image must reproject within the given threshold.
+// in a common image must reproject within the given threshold. Inside RANSAC,
+// the observations are evaluated on a subset of each image in parallel, while
+// the final alignment is refined on the inliers determined from all
+// observations.
 bool AlignReconstructionsViaReprojections(
     const Reconstruction& src_reconstruction,
     const Reconstruction& tgt_reconstruction,
@@ -84,6 +84,31 @@ TEST(Alignment, AlignReconstructionsViaReprojections) {
   ExpectEqualSim3d(gt_tgt_from_src, tgt_from_src);
 }
 
+TEST(Alignment, AlignReconstructionsViaReprojectionsManyPoints) {
+  // Enough points to subsample the points of each image inside RANSAC and to
+  // evaluate the residuals in parallel.
+  Reconstruction src_reconstruction;
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_cameras = 2;
+  synthetic_dataset_options.num_images = 60;
+  synthetic_dataset_options.num_points3D = 2000;
+  synthetic_dataset_options.point2D_stddev = 0;
+  SynthesizeDataset(synthetic_dataset_options, &src_reconstruction);
+  Reconstruction tgt_reconstruction = src_reconstruction;
+
+  Sim3d gt_tgt_from_src = TestSim3d();
+  tgt_reconstruction.Transform(gt_tgt_from_src);
+
+  Sim3d tgt_from_src;
+  THROW_CHECK(
+      AlignReconstructionsViaReprojections(src_reconstruction,
+                                           tgt_reconstruction,
+                                           /*min_inlier_observations=*/0.9,
+                                           /*max_reproj_error=*/2,
+                                           &tgt_from_src));
+  ExpectEqualSim3d(gt_tgt_from_src, tgt_from_src);
+}
+
 TEST(Alignment, AlignReconstructionsViaProjCenters) {
   Reconstruction src_reconstruction = GenerateReconstructionForAlignment();
   Reconstruction tgt_reconstruction = src_reconstruction;
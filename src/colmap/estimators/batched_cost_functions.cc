@@ -0,0 +1,195 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/estimators/batched_cost_functions.h"
+
+#include "colmap/util/logging.h"
+
+#include <future>
+
+namespace colmap {
+namespace {
+
+// Minimum number of observations per task of the multi-threaded evaluation.
+const size_t kMinChunkSize = 256;
+
+}  // namespace
+
+bool BatchedReprojErrorEvaluator::Options::Check() const {
+  CHECK_OPTION(num_threads == -1 || num_threads > 0);
+  return true;
+}
+
+BatchedReprojErrorEvaluator::BatchedReprojErrorEvaluator(
+    const Options& options)
+    : options_(options) {
+  THROW_CHECK(options_.Check());
+  const int num_threads = GetEffectiveNumThreads(options_.num_threads);
+  if (num_threads > 1) {
+    thread_pool_ = std::make_unique<ThreadPool>(num_threads);
+  }
+}
+
+template <typename CameraModel>
+ReprojErrorBatch<CameraModel>* BatchedReprojErrorEvaluator::GetBatch() {
+  std::unique_ptr<ReprojErrorBatchBase>& batch =
+      batches_[CameraModel::model_id];
+  if (!batch) {
+    batch = std::make_unique<ReprojErrorBatch<CameraModel>>(
+        options_.use_analytic_jacobians, options_.use_float_jacobians);
+  }
+  return static_cast<ReprojErrorBatch<CameraModel>*>(batch.get());
+}
+
+ceres::CostFunction* BatchedReprojErrorEvaluator::AddObservation(
+    const CameraModelId camera_model_id,
+    const double* cam_from_world_rotation,
+    const double* cam_from_world_translation,
+    const double* point3D,
+    const double* camera_params,
+    const Eigen::Vector2d& point2D) {
+  has_residuals_ = false;
+  has_jacobians_ = false;
+  switch (camera_model_id) {
+#define CAMERA_MODEL_CASE(CameraModel)                                    \
+  case CameraModel::model_id: {                                           \
+    ReprojErrorBatch<CameraModel>* batch = GetBatch<CameraModel>();       \
+    const size_t index = batch->Add(cam_from_world_rotation,              \
+                                    cam_from_world_translation,           \
+                                    nullptr,                              \
+                                    point3D,                              \
+                                    camera_params,                        \
+                                    point2D);                             \
+    return new BatchedReprojErrorCostFunction<CameraModel>(batch, index); \
+  }
+
+    CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+  }
+}
+
+ceres::CostFunction* BatchedReprojErrorEvaluator::AddConstantPoseObservation(
+    const CameraModelId camera_model_id,
+    const Rigid3d& cam_from_world,
+    const double* point3D,
+    const double* camera_params,
+    const Eigen::Vector2d& point2D) {
+  has_residuals_ = false;
+  has_jacobians_ = false;
+  switch (camera_model_id) {
+#define CAMERA_MODEL_CASE(CameraModel)                                   \
+  case CameraModel::model_id: {                                          \
+    ReprojErrorBatch<CameraModel>* batch = GetBatch<CameraModel>();      \
+    const size_t index = batch->Add(nullptr,                             \
+                                    nullptr,                             \
+                                    &cam_from_world,                     \
+                                    point3D,                             \
+                                    camera_params,                       \
+                                    point2D);                            \
+    return new BatchedReprojErrorConstantPoseCostFunction<CameraModel>(  \
+        batch, index);                                                   \
+  }
+
+    CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+  }
+}
+
+size_t BatchedReprojErrorEvaluator::NumObservations() const {
+  size_t num_observations = 0;
+  for (const auto& batch : batches_) {
+    num_observations += batch.second->NumObservations();
+  }
+  return num_observations;
+}
+
+void BatchedReprojErrorEvaluator::PrepareForEvaluation(
+    const bool evaluate_jacobians, const bool new_evaluation_point) {
+  if (new_evaluation_point) {
+    Invalidate();
+  } else if (has_residuals_ && (has_jacobians_ || !evaluate_jacobians)) {
+    return;
+  }
+
+  for (auto& batch : batches_) {
+    batch.second->Prepare(evaluate_jacobians);
+  }
+
+  bool success = true;
+  if (thread_pool_ == nullptr) {
+    for (auto& batch : batches_) {
+      success &= batch.second->Evaluate(
+          0, batch.second->NumObservations(), evaluate_jacobians);
+    }
+  } else {
+    // Split the batches into chunks, such that every thread evaluates a
+    // contiguous range of observations of the same camera model.
+    const size_t num_threads = thread_pool_->NumThreads();
+    const size_t chunk_size = std::max<size_t>(
+        kMinChunkSize, (NumObservations() + num_threads - 1) / num_threads);
+    std::vector<std::future<bool>> futures;
+    for (auto& batch : batches_) {
+      ReprojErrorBatchBase* batch_ptr = batch.second.get();
+      const size_t num_observations = batch_ptr->NumObservations();
+      for (size_t begin = 0; begin < num_observations; begin += chunk_size) {
+        const size_t end = std::min(begin + chunk_size, num_observations);
+        futures.push_back(thread_pool_->AddTask(
+            [batch_ptr, begin, end, evaluate_jacobians]() {
+              return batch_ptr->Evaluate(begin, end, evaluate_jacobians);
+            }));
+      }
+    }
+    for (auto& future : futures) {
+      success &= future.get();
+    }
+  }
+
+  // If any observation failed, fall back to the individual evaluation of the
+  // residual blocks, which then reports the failure to the solver.
+  if (success) {
+    has_residuals_ = true;
+    has_jacobians_ = evaluate_jacobians;
+    for (auto& batch : batches_) {
+      batch.second->SetValid(has_residuals_, has_jacobians_);
+    }
+  }
+}
+
+void BatchedReprojErrorEvaluator::Invalidate() {
+  has_residuals_ = false;
+  has_jacobians_ = false;
+  for (auto& batch : batches_) {
+    batch.second->SetValid(false, false);
+  }
+}
+
+}  // namespace colmap
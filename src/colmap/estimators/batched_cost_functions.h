@@ -0,0 +1,441 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/estimators/cost_functions.h"
+#include "colmap/geometry/rigid3.h"
+#include "colmap/sensor/models.h"
+#include "colmap/util/threading.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <Eigen/Core>
+#include <ceres/ceres.h>
+
+namespace colmap {
+
+// Reprojection errors of all observations of one camera model, which are
+// evaluated together in a single pass without virtual calls per observation.
+class ReprojErrorBatchBase {
+ public:
+  virtual ~ReprojErrorBatchBase() = default;
+
+  virtual size_t NumObservations() const = 0;
+
+  // Allocate the memory for the cached results before evaluating them.
+  virtual void Prepare(bool evaluate_jacobians) = 0;
+
+  // Evaluate and cache the residuals and optionally the Jacobians of the
+  // observations in the range [begin, end). Returns false if the evaluation of
+  // any observation failed.
+  virtual bool Evaluate(size_t begin, size_t end, bool evaluate_jacobians) = 0;
+
+  // Mark the cached results as valid or invalid for all observations.
+  void SetValid(bool has_residuals, bool has_jacobians) {
+    has_residuals_ = has_residuals;
+    has_jacobians_ = has_jacobians;
+  }
+
+ protected:
+  bool has_residuals_ = false;
+  bool has_jacobians_ = false;
+};
+
+template <typename CameraModel>
+class ReprojErrorBatch : public ReprojErrorBatchBase {
+ public:
+  static constexpr int kNumParams = CameraModel::num_params;
+  static constexpr int kJacobianSize = 2 * (4 + 3 + 3 + kNumParams);
+
+  ReprojErrorBatch(bool use_analytic_jacobians, bool use_float_jacobians)
+      : use_analytic_jacobians_(use_analytic_jacobians &&
+                                HasAnalyticImgFromCam<CameraModel>::value),
+        use_float_jacobians_(use_float_jacobians) {}
+
+  // Add an observation with variable camera pose, if `cam_from_world` is null,
+  // or with constant camera pose otherwise. Returns its index in the batch.
+  size_t Add(const double* cam_from_world_rotation,
+             const double* cam_from_world_translation,
+             const Rigid3d* constant_cam_from_world,
+             const double* point3D,
+             const double* camera_params,
+             const Eigen::Vector2d& point2D);
+
+  size_t NumObservations() const override { return observations_.size(); }
+
+  void Prepare(bool evaluate_jacobians) override;
+
+  bool Evaluate(size_t begin, size_t end, bool evaluate_jacobians) override;
+
+  // Copy the cached results of an observation or, if they are not available,
+  // evaluate the observation for the given parameters instead. The parameters
+  // are the ones of the residual block, i.e., without the camera pose for
+  // observations with constant camera pose.
+  bool Evaluate(size_t index,
+                double const* const* parameters,
+                double* residuals,
+                double** jacobians) const;
+
+ private:
+  struct Observation {
+    const double* cam_from_world_rotation;
+    const double* cam_from_world_translation;
+    const Rigid3d* constant_cam_from_world;
+    const double* point3D;
+    const double* camera_params;
+    double observed_x;
+    double observed_y;
+  };
+
+  // Evaluate the residuals and the Jacobians of all non-null blocks in the
+  // order of the parameter blocks of the residual block.
+  bool EvaluateObservation(const Observation& observation,
+                           double const* const* parameters,
+                           double* residuals,
+                           double** jacobians) const;
+
+  // Dispatch to `EvaluateAnalyticReprojError` for the camera models that
+  // support it, which is a no-op for all other models.
+  static void EvaluateAnalytic(std::true_type,
+                               const double* cam_from_world_rotation,
+                               const double* cam_from_world_translation,
+                               const double* point3D,
+                               const double* camera_params,
+                               const Eigen::Vector2d& observed,
+                               double* residuals,
+                               double* J_rotation,
+                               double* J_translation,
+                               double* J_point3D,
+                               double* J_params) {
+    EvaluateAnalyticReprojError<CameraModel>(cam_from_world_rotation,
+                                             cam_from_world_translation,
+                                             point3D,
+                                             camera_params,
+                                             observed,
+                                             residuals,
+                                             J_rotation,
+                                             J_translation,
+                                             J_point3D,
+                                             J_params);
+  }
+  static void EvaluateAnalytic(std::false_type,
+                               const double* cam_from_world_rotation,
+                               const double* cam_from_world_translation,
+                               const double* point3D,
+                               const double* camera_params,
+                               const Eigen::Vector2d& observed,
+                               double* residuals,
+                               double* J_rotation,
+                               double* J_translation,
+                               double* J_point3D,
+                               double* J_params) {}
+
+  const bool use_analytic_jacobians_;
+  const bool use_float_jacobians_;
+  std::vector<Observation> observations_;
+  std::vector<double> residuals_;
+  std::vector<double> jacobians_;
+};
+
+// Batched evaluation of the reprojection errors of a bundle adjustment
+// problem. The evaluator must be set as the evaluation callback of the problem
+// (requires Ceres >= 2.0), such that Ceres invokes it before evaluating the
+// residual blocks at a new point. It then evaluates the residuals and Jacobians
+// of all observations in one multi-threaded pass per camera model and the
+// residual blocks of the problem only copy their cached results. Outside of
+// the solver, e.g., after calling `Invalidate`, the residual blocks evaluate
+// themselves as usual.
+class BatchedReprojErrorEvaluator : public ceres::EvaluationCallback {
+ public:
+  struct Options {
+    // Whether to use analytic Jacobians for the supported camera models.
+    bool use_analytic_jacobians = false;
+
+    // Whether to evaluate the automatically differentiated Jacobians in single
+    // precision, see `FloatJacobianAutoDiffCostFunction`.
+    bool use_float_jacobians = false;
+
+    // The number of threads for the batched evaluation.
+    int num_threads = -1;
+
+    bool Check() const;
+  };
+
+  explicit BatchedReprojErrorEvaluator(const Options& options);
+
+  // Create the cost function of an observation with variable camera pose. The
+  // parameter blocks must be added to the problem in the same order and must
+  // have the same memory as passed here. The caller takes ownership of the
+  // cost function, which must not outlive the evaluator.
+  ceres::CostFunction* AddObservation(CameraModelId camera_model_id,
+                                      const double* cam_from_world_rotation,
+                                      const double* cam_from_world_translation,
+                                      const double* point3D,
+                                      const double* camera_params,
+                                      const Eigen::Vector2d& point2D);
+
+  // Create the cost function of an observation with constant camera pose. The
+  // pose must remain unchanged while the cost function is used.
+  ceres::CostFunction* AddConstantPoseObservation(
+      CameraModelId camera_model_id,
+      const Rigid3d& cam_from_world,
+      const double* point3D,
+      const double* camera_params,
+      const Eigen::Vector2d& point2D);
+
+  size_t NumObservations() const;
+
+  void PrepareForEvaluation(bool evaluate_jacobians,
+                            bool new_evaluation_point) override;
+
+  // Discard the cached results, e.g., after the parameters were changed
+  // outside of the solver.
+  void Invalidate();
+
+ private:
+  template <typename CameraModel>
+  ReprojErrorBatch<CameraModel>* GetBatch();
+
+  const Options options_;
+  std::unique_ptr<ThreadPool> thread_pool_;
+  std::map<CameraModelId, std::unique_ptr<ReprojErrorBatchBase>> batches_;
+  bool has_residuals_ = false;
+  bool has_jacobians_ = false;
+};
+
+// Cost functions of the observations of `BatchedReprojErrorEvaluator` with
+// the same parameter blocks as `ReprojErrorCostFunction` and
+// `ReprojErrorConstantPoseCostFunction`, respectively.
+template <typename CameraModel>
+class BatchedReprojErrorCostFunction
+    : public ceres::SizedCostFunction<2, 4, 3, 3, CameraModel::num_params> {
+ public:
+  BatchedReprojErrorCostFunction(const ReprojErrorBatch<CameraModel>* batch,
+                                 size_t index)
+      : batch_(batch), index_(index) {}
+
+  bool Evaluate(double const* const* parameters,
+                double* residuals,
+                double** jacobians) const override {
+    return batch_->Evaluate(index_, parameters, residuals, jacobians);
+  }
+
+ private:
+  const ReprojErrorBatch<CameraModel>* batch_;
+  const size_t index_;
+};
+
+template <typename CameraModel>
+class BatchedReprojErrorConstantPoseCostFunction
+    : public ceres::SizedCostFunction<2, 3, CameraModel::num_params> {
+ public:
+  BatchedReprojErrorConstantPoseCostFunction(
+      const ReprojErrorBatch<CameraModel>* batch, size_t index)
+      : batch_(batch), index_(index) {}
+
+  bool Evaluate(double const* const* parameters,
+                double* residuals,
+                double** jacobians) const override {
+    return batch_->Evaluate(index_, parameters, residuals, jacobians);
+  }
+
+ private:
+  const ReprojErrorBatch<CameraModel>* batch_;
+  const size_t index_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename CameraModel>
+size_t ReprojErrorBatch<CameraModel>::Add(
+    const double* cam_from_world_rotation,
+    const double* cam_from_world_translation,
+    const Rigid3d* constant_cam_from_world,
+    const double* point3D,
+    const double* camera_params,
+    const Eigen::Vector2d& point2D) {
+  Observation observation;
+  observation.cam_from_world_rotation = cam_from_world_rotation;
+  observation.cam_from_world_translation = cam_from_world_translation;
+  observation.constant_cam_from_world = constant_cam_from_world;
+  observation.point3D = point3D;
+  observation.camera_params = camera_params;
+  observation.observed_x = point2D.x();
+  observation.observed_y = point2D.y();
+  observations_.push_back(observation);
+  residuals_.resize(2 * observations_.size());
+  has_residuals_ = false;
+  has_jacobians_ = false;
+  return observations_.size() - 1;
+}
+
+template <typename CameraModel>
+void ReprojErrorBatch<CameraModel>::Prepare(const bool evaluate_jacobians) {
+  if (evaluate_jacobians) {
+    jacobians_.resize(kJacobianSize * observations_.size());
+  }
+}
+
+template <typename CameraModel>
+bool ReprojErrorBatch<CameraModel>::Evaluate(const size_t begin,
+                                             const size_t end,
+                                             const bool evaluate_jacobians) {
+  bool success = true;
+  for (size_t i = begin; i < end; ++i) {
+    const Observation& observation = observations_[i];
+    double* residuals = residuals_.data() + 2 * i;
+    if (observation.constant_cam_from_world == nullptr) {
+      const double* parameters[4] = {observation.cam_from_world_rotation,
+                                     observation.cam_from_world_translation,
+                                     observation.point3D,
+                                     observation.camera_params};
+      if (evaluate_jacobians) {
+        double* jacobian = jacobians_.data() + kJacobianSize * i;
+        double* jacobians[4] = {jacobian,
+                                jacobian + 2 * 4,
+                                jacobian + 2 * (4 + 3),
+                                jacobian + 2 * (4 + 3 + 3)};
+        success &=
+            EvaluateObservation(observation, parameters, residuals, jacobians);
+      } else {
+        success &=
+            EvaluateObservation(observation, parameters, residuals, nullptr);
+      }
+    } else {
+      const double* parameters[2] = {observation.point3D,
+                                     observation.camera_params};
+      if (evaluate_jacobians) {
+        double* jacobian = jacobians_.data() + kJacobianSize * i;
+        double* jacobians[2] = {jacobian, jacobian + 2 * 3};
+        success &=
+            EvaluateObservation(observation, parameters, residuals, jacobians);
+      } else {
+        success &=
+            EvaluateObservation(observation, parameters, residuals, nullptr);
+      }
+    }
+  }
+  return success;
+}
+
+template <typename CameraModel>
+bool ReprojErrorBatch<CameraModel>::Evaluate(const size_t index,
+                                             double const* const* parameters,
+                                             double* residuals,
+                                             double** jacobians) const {
+  const Observation& observation = observations_[index];
+  if (!has_residuals_ || (jacobians != nullptr && !has_jacobians_)) {
+    return EvaluateObservation(observation, parameters, residuals, jacobians);
+  }
+
+  residuals[0] = residuals_[2 * index];
+  residuals[1] = residuals_[2 * index + 1];
+
+  if (jacobians != nullptr) {
+    const double* jacobian = jacobians_.data() + kJacobianSize * index;
+    const int num_blocks = observation.constant_cam_from_world ? 2 : 4;
+    const int block_sizes[4] = {4, 3, 3, kNumParams};
+    const int* block_size = block_sizes + (4 - num_blocks);
+    for (int i = 0; i < num_blocks; ++i) {
+      if (jacobians[i] != nullptr) {
+        std::copy(jacobian, jacobian + 2 * block_size[i], jacobians[i]);
+      }
+      jacobian += 2 * block_size[i];
+    }
+  }
+
+  return true;
+}
+
+template <typename CameraModel>
+bool ReprojErrorBatch<CameraModel>::EvaluateObservation(
+    const Observation& observation,
+    double const* const* parameters,
+    double* residuals,
+    double** jacobians) const {
+  const Eigen::Vector2d observed(observation.observed_x,
+                                 observation.observed_y);
+  if (observation.constant_cam_from_world == nullptr) {
+    if (use_analytic_jacobians_) {
+      EvaluateAnalytic(HasAnalyticImgFromCam<CameraModel>(),
+                       parameters[0],
+                       parameters[1],
+                       parameters[2],
+                       parameters[3],
+                       observed,
+                       residuals,
+                       jacobians ? jacobians[0] : nullptr,
+                       jacobians ? jacobians[1] : nullptr,
+                       jacobians ? jacobians[2] : nullptr,
+                       jacobians ? jacobians[3] : nullptr);
+      return true;
+    }
+    const ReprojErrorCostFunction<CameraModel> functor(observed);
+    if (use_float_jacobians_) {
+      return EvaluateCostFunctorWithJets<float, 2, 4, 3, 3, kNumParams>(
+          functor, parameters, residuals, jacobians);
+    }
+    return EvaluateCostFunctorWithJets<double, 2, 4, 3, 3, kNumParams>(
+        functor, parameters, residuals, jacobians);
+  } else {
+    const Rigid3d& cam_from_world = *observation.constant_cam_from_world;
+    if (use_analytic_jacobians_) {
+      EvaluateAnalytic(HasAnalyticImgFromCam<CameraModel>(),
+                       cam_from_world.rotation.coeffs().data(),
+                       cam_from_world.translation.data(),
+                       parameters[0],
+                       parameters[1],
+                       observed,
+                       residuals,
+                       nullptr,
+                       nullptr,
+                       jacobians ? jacobians[0] : nullptr,
+                       jacobians ? jacobians[1] : nullptr);
+      return true;
+    }
+    const ReprojErrorConstantPoseCostFunction<CameraModel> functor(
+        cam_from_world, observed);
+    if (use_float_jacobians_) {
+      return EvaluateCostFunctorWithJets<float, 2, 3, kNumParams>(
+          functor, parameters, residuals, jacobians);
+    }
+    return EvaluateCostFunctorWithJets<double, 2, 3, kNumParams>(
+        functor, parameters, residuals, jacobians);
+  }
+}
+
+}  // namespace colmap
@@ -0,0 +1,268 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/estimators/batched_cost_functions.h"
+
+#include "colmap/estimators/cost_functions.h"
+#include "colmap/geometry/rigid3.h"
+#include "colmap/sensor/models.h"
+#include "colmap/util/eigen_alignment.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+struct Observations {
+  std::vector<Rigid3d> cams_from_world;
+  std::vector<Eigen::Vector3d> points3D;
+  std::vector<Eigen::Vector2d> points2D;
+};
+
+Observations GenerateObservations(const int num_observations) {
+  Observations observations;
+  for (int i = 0; i < num_observations; ++i) {
+    observations.cams_from_world.emplace_back(
+        Eigen::Quaterniond(Eigen::AngleAxisd(
+            0.3 + 1e-3 * i, Eigen::Vector3d(0.2, 1, -0.4).normalized())),
+        Eigen::Vector3d(0.1, -0.2, 3 + 1e-3 * i));
+    observations.points3D.emplace_back(0.3 - 1e-3 * i, 0.4, 1.5);
+    observations.points2D.emplace_back(300 + 0.1 * i, 200 - 0.1 * i);
+  }
+  return observations;
+}
+
+void ExpectNearEvaluation(const ceres::CostFunction& cost_function,
+                          const ceres::CostFunction& ref_cost_function,
+                          const double* const* parameters,
+                          const bool evaluate_jacobians) {
+  const std::vector<int32_t>& block_sizes =
+      ref_cost_function.parameter_block_sizes();
+  std::vector<std::vector<double>> jacobians(block_sizes.size());
+  std::vector<std::vector<double>> ref_jacobians(block_sizes.size());
+  std::vector<double*> jacobian_ptrs(block_sizes.size());
+  std::vector<double*> ref_jacobian_ptrs(block_sizes.size());
+  for (size_t i = 0; i < block_sizes.size(); ++i) {
+    jacobians[i].resize(2 * block_sizes[i]);
+    ref_jacobians[i].resize(2 * block_sizes[i]);
+    jacobian_ptrs[i] = jacobians[i].data();
+    ref_jacobian_ptrs[i] = ref_jacobians[i].data();
+  }
+
+  Eigen::Vector2d residuals;
+  Eigen::Vector2d ref_residuals;
+  EXPECT_TRUE(cost_function.Evaluate(
+      parameters,
+      residuals.data(),
+      evaluate_jacobians ? jacobian_ptrs.data() : nullptr));
+  EXPECT_TRUE(ref_cost_function.Evaluate(
+      parameters, ref_residuals.data(), ref_jacobian_ptrs.data()));
+  EXPECT_NEAR(residuals(0), ref_residuals(0), 1e-9);
+  EXPECT_NEAR(residuals(1), ref_residuals(1), 1e-9);
+  if (evaluate_jacobians) {
+    for (size_t i = 0; i < block_sizes.size(); ++i) {
+      for (size_t j = 0; j < jacobians[i].size(); ++j) {
+        EXPECT_NEAR(jacobians[i][j],
+                    ref_jacobians[i][j],
+                    1e-6 * std::max(1.0, std::abs(ref_jacobians[i][j])));
+      }
+    }
+  }
+}
+
+template <typename CameraModel>
+void TestBatchedEvaluation(const std::vector<double>& camera_params,
+                           const bool use_analytic_jacobians,
+                           const int num_threads) {
+  ASSERT_EQ(camera_params.size(), CameraModel::num_params);
+  // Enough observations for multiple chunks in the multi-threaded case.
+  Observations observations = GenerateObservations(600);
+
+  BatchedReprojErrorEvaluator::Options options;
+  options.use_analytic_jacobians = use_analytic_jacobians;
+  options.num_threads = num_threads;
+  BatchedReprojErrorEvaluator evaluator(options);
+
+  std::vector<std::unique_ptr<ceres::CostFunction>> cost_functions;
+  std::vector<std::unique_ptr<ceres::CostFunction>> ref_cost_functions;
+  for (size_t i = 0; i < observations.points3D.size(); ++i) {
+    const Rigid3d& cam_from_world = observations.cams_from_world[i];
+    if (i % 2 == 0) {
+      cost_functions.emplace_back(
+          evaluator.AddObservation(CameraModel::model_id,
+                                   cam_from_world.rotation.coeffs().data(),
+                                   cam_from_world.translation.data(),
+                                   observations.points3D[i].data(),
+                                   camera_params.data(),
+                                   observations.points2D[i]));
+      ref_cost_functions.emplace_back(
+          ReprojErrorCostFunction<CameraModel>::Create(
+              observations.points2D[i]));
+    } else {
+      cost_functions.emplace_back(
+          evaluator.AddConstantPoseObservation(CameraModel::model_id,
+                                               cam_from_world,
+                                               observations.points3D[i].data(),
+                                               camera_params.data(),
+                                               observations.points2D[i]));
+      ref_cost_functions.emplace_back(
+          ReprojErrorConstantPoseCostFunction<CameraModel>::Create(
+              cam_from_world, observations.points2D[i]));
+    }
+  }
+  EXPECT_EQ(evaluator.NumObservations(), observations.points3D.size());
+
+  const auto expect_near = [&](const bool evaluate_jacobians) {
+    for (size_t i = 0; i < cost_functions.size(); ++i) {
+      const Rigid3d& cam_from_world = observations.cams_from_world[i];
+      const double* parameters[4] = {cam_from_world.rotation.coeffs().data(),
+                                     cam_from_world.translation.data(),
+                                     observations.points3D[i].data(),
+                                     camera_params.data()};
+      ExpectNearEvaluation(*cost_functions[i],
+                           *ref_cost_functions[i],
+                           i % 2 == 0 ? parameters : parameters + 2,
+                           evaluate_jacobians);
+    }
+  };
+
+  // Without preparation, the cost functions evaluate themselves.
+  expect_near(/*evaluate_jacobians=*/true);
+
+  evaluator.PrepareForEvaluation(/*evaluate_jacobians=*/false,
+                                 /*new_evaluation_point=*/true);
+  expect_near(/*evaluate_jacobians=*/false);
+  // Jacobians were not prepared and are evaluated individually.
+  expect_near(/*evaluate_jacobians=*/true);
+
+  evaluator.PrepareForEvaluation(/*evaluate_jacobians=*/true,
+                                 /*new_evaluation_point=*/false);
+  expect_near(/*evaluate_jacobians=*/true);
+
+  // Move to a new evaluation point.
+  for (Eigen::Vector3d& point3D : observations.points3D) {
+    point3D += Eigen::Vector3d(0.01, -0.02, 0.03);
+  }
+  evaluator.PrepareForEvaluation(/*evaluate_jacobians=*/true,
+                                 /*new_evaluation_point=*/true);
+  expect_near(/*evaluate_jacobians=*/true);
+
+  // Stale results must not be used after invalidation.
+  for (Eigen::Vector3d& point3D : observations.points3D) {
+    point3D -= Eigen::Vector3d(0.01, -0.02, 0.03);
+  }
+  evaluator.Invalidate();
+  expect_near(/*evaluate_jacobians=*/true);
+}
+
+TEST(BatchedReprojErrorEvaluator, AutoDiff) {
+  TestBatchedEvaluation<SimpleRadialCameraModel>(
+      {500, 320, 240, 0.1}, /*use_analytic_jacobians=*/false, 1);
+  TestBatchedEvaluation<FullOpenCVCameraModel>(
+      {500, 520, 320, 240, 0.1, -0.05, 0.01, -0.02, 0.01, 0, 0, 0},
+      /*use_analytic_jacobians=*/false,
+      2);
+}
+
+TEST(BatchedReprojErrorEvaluator, Analytic) {
+  TestBatchedEvaluation<SimpleRadialCameraModel>(
+      {500, 320, 240, 0.1}, /*use_analytic_jacobians=*/true, 1);
+  TestBatchedEvaluation<OpenCVCameraModel>(
+      {500, 520, 320, 240, 0.1, -0.05, 0.01, -0.02},
+      /*use_analytic_jacobians=*/true,
+      2);
+  // Falls back to automatic differentiation for unsupported models.
+  TestBatchedEvaluation<FullOpenCVCameraModel>(
+      {500, 520, 320, 240, 0.1, -0.05, 0.01, -0.02, 0.01, 0, 0, 0},
+      /*use_analytic_jacobians=*/true,
+      2);
+}
+
+TEST(BatchedReprojErrorEvaluator, MultipleCameraModels) {
+  Observations observations = GenerateObservations(2);
+  const std::vector<double> pinhole_params = {500, 520, 320, 240};
+  const std::vector<double> radial_params = {500, 320, 240, 0.1, -0.05};
+
+  BatchedReprojErrorEvaluator evaluator(BatchedReprojErrorEvaluator::Options{});
+  std::unique_ptr<ceres::CostFunction> pinhole_cost_function(
+      evaluator.AddObservation(
+          PinholeCameraModel::model_id,
+          observations.cams_from_world[0].rotation.coeffs().data(),
+          observations.cams_from_world[0].translation.data(),
+          observations.points3D[0].data(),
+          pinhole_params.data(),
+          observations.points2D[0]));
+  std::unique_ptr<ceres::CostFunction> radial_cost_function(
+      evaluator.AddObservation(
+          RadialCameraModel::model_id,
+          observations.cams_from_world[1].rotation.coeffs().data(),
+          observations.cams_from_world[1].translation.data(),
+          observations.points3D[1].data(),
+          radial_params.data(),
+          observations.points2D[1]));
+  EXPECT_EQ(evaluator.NumObservations(), 2);
+  EXPECT_EQ(pinhole_cost_function->parameter_block_sizes().back(), 4);
+  EXPECT_EQ(radial_cost_function->parameter_block_sizes().back(), 5);
+
+  evaluator.PrepareForEvaluation(/*evaluate_jacobians=*/true,
+                                 /*new_evaluation_point=*/true);
+
+  std::unique_ptr<ceres::CostFunction> ref_pinhole_cost_function(
+      ReprojErrorCostFunction<PinholeCameraModel>::Create(
+          observations.points2D[0]));
+  const double* pinhole_parameters[4] = {
+      observations.cams_from_world[0].rotation.coeffs().data(),
+      observations.cams_from_world[0].translation.data(),
+      observations.points3D[0].data(),
+      pinhole_params.data()};
+  ExpectNearEvaluation(*pinhole_cost_function,
+                       *ref_pinhole_cost_function,
+                       pinhole_parameters,
+                       /*evaluate_jacobians=*/true);
+
+  std::unique_ptr<ceres::CostFunction> ref_radial_cost_function(
+      ReprojErrorCostFunction<RadialCameraModel>::Create(
+          observations.points2D[1]));
+  const double* radial_parameters[4] = {
+      observations.cams_from_world[1].rotation.coeffs().data(),
+      observations.cams_from_world[1].translation.data(),
+      observations.points3D[1].data(),
+      radial_params.data()};
+  ExpectNearEvaluation(*radial_cost_function,
+                       *ref_radial_cost_function,
+                       radial_parameters,
+                       /*evaluate_jacobians=*/true);
+}
+
+}  // namespace
+}  // namespace colmap
@@ -29,17 +29,72 @@
 
 #include "colmap/estimators/bundle_adjustment.h"
 
+#include "colmap/estimators/batched_cost_functions.h"
 #include "colmap/estimators/cost_functions.h"
 #include "colmap/estimators/manifold.h"
+#include "colmap/estimators/structure_refinement.h"
 #include "colmap/scene/projection.h"
+#include "colmap/scene/scene_clustering.h"
+#include "colmap/scene/visibility_pyramid.h"
 #include "colmap/sensor/models.h"
+#include "colmap/util/cuda.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/profiler.h"
 #include "colmap/util/threading.h"
 #include "colmap/util/timer.h"
 
 #include <iomanip>
 
 namespace colmap {
+namespace {
+
+ceres::CostFunction* CreateReprojErrorCostFunction(
+    const BundleAdjustmentOptions& options,
+    const CameraModelId camera_model_id,
+    const Eigen::Vector2d& point2D) {
+  if (options.use_analytic_jacobians && options.use_float_jacobians) {
+    return AnalyticCameraCostFunction<AnalyticReprojErrorCostFunction,
+                                      FloatJacobianReprojErrorCostFunction>(
+        camera_model_id, point2D);
+  }
+  if (options.use_analytic_jacobians) {
+    return AnalyticCameraCostFunction<AnalyticReprojErrorCostFunction,
+                                      ReprojErrorCostFunction>(camera_model_id,
+                                                               point2D);
+  }
+  if (options.use_float_jacobians) {
+    return CameraCostFunction<FloatJacobianReprojErrorCostFunction>(
+        camera_model_id, point2D);
+  }
+  return CameraCostFunction<ReprojErrorCostFunction>(camera_model_id, point2D);
+}
+
+ceres::CostFunction* CreateReprojErrorConstantPoseCostFunction(
+    const BundleAdjustmentOptions& options,
+    const CameraModelId camera_model_id,
+    const Rigid3d& cam_from_world,
+    const Eigen::Vector2d& point2D) {
+  if (options.use_analytic_jacobians && options.use_float_jacobians) {
+    return AnalyticCameraCostFunction<
+        AnalyticReprojErrorConstantPoseCostFunction,
+        FloatJacobianReprojErrorConstantPoseCostFunction>(
+        camera_model_id, cam_from_world, point2D);
+  }
+  if (options.use_analytic_jacobians) {
+    return AnalyticCameraCostFunction<
+        AnalyticReprojErrorConstantPoseCostFunction,
+        ReprojErrorConstantPoseCostFunction>(
+        camera_model_id, cam_from_world, point2D);
+  }
+  if (options.use_float_jacobians) {
+    return CameraCostFunction<FloatJacobianReprojErrorConstantPoseCostFunction>(
+        camera_model_id, cam_from_world, point2D);
+  }
+  return CameraCostFunction<ReprojErrorConstantPoseCostFunction>(
+      camera_model_id, cam_from_world, point2D);
+}
+
+}  // namespace
 
 ////////////////////////////////////////////////////////////////////////////////
 // BundleAdjustmentOptions
@@ -64,6 +119,14 @@ ceres::LossFunction* BundleAdjustmentOptions::CreateLossFunction() const {
 
 bool BundleAdjustmentOptions::Check() const {
   CHECK_OPTION_GE(loss_function_scale, 0);
+  CHECK_OPTION_GE(min_num_images_gpu_solver, 0);
+  CHECK_OPTION_GE(points3D_subsampling_num_levels, 0);
+  CHECK_OPTION_LE(points3D_subsampling_num_levels, 16);
+  // Updates would add the observations of all 3D points.
+  CHECK_OPTION(!enable_problem_updates || points3D_subsampling_num_levels == 0);
+  if (use_gpu) {
+    CHECK_OPTION_GT(CSVToVector<int>(gpu_index).size(), 0);
+  }
   return true;
 }
 
@@ -267,10 +330,27 @@ BundleAdjuster::BundleAdjuster(const BundleAdjustmentOptions& options,
 }
 
 bool BundleAdjuster::Solve(Reconstruction* reconstruction) {
+  COLMAP_PROFILE_ZONE("BundleAdjuster::Solve");
   loss_function_ =
       std::unique_ptr<ceres::LossFunction>(options_.CreateLossFunction());
   SetUpProblem(reconstruction, loss_function_.get());
+  if (!SolveProblem()) {
+    return false;
+  }
+  if (options_.points3D_subsampling_num_levels > 0) {
+    RefineUnselectedPoints3D(reconstruction);
+  }
+  return true;
+}
+
+bool BundleAdjuster::Resolve(Reconstruction* reconstruction) {
+  THROW_CHECK_NOTNULL(reconstruction);
+  THROW_CHECK(problem_) << "Problem must be set up by Solve() first";
+  UpdateProblem(reconstruction, loss_function_.get());
+  return SolveProblem();
+}
 
+bool BundleAdjuster::SolveProblem() {
   if (problem_->NumResiduals() == 0) {
     return false;
   }
@@ -280,6 +360,12 @@ bool BundleAdjuster::Solve(Reconstruction* reconstruction) {
 
   ceres::Solve(solver_options, problem_.get(), &summary_);
 
+  // The cached results refer to the last evaluation point of the solver,
+  // which is not necessarily the final solution.
+  if (batched_evaluator_) {
+    batched_evaluator_->Invalidate();
+  }
+
   if (options_.print_summary || VLOG_IS_ON(1)) {
     PrintSolverSummary(summary_, "Bundle adjustment report");
   }
@@ -306,7 +392,42 @@ void BundleAdjuster::SetUpProblem(Reconstruction* reconstruction,
   // Initialize an empty problem
   ceres::Problem::Options problem_options;
   problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
-  problem_ = std::make_shared<ceres::Problem>(problem_options);
+  // Updating the problem removes residual blocks, which is otherwise linear in
+  // the number of residual blocks.
+  problem_options.enable_fast_removal = options_.enable_problem_updates;
+  batched_evaluator_.reset();
+#if CERES_VERSION_MAJOR >= 2
+  if (options_.use_batched_evaluation && !options_.enable_problem_updates) {
+    BatchedReprojErrorEvaluator::Options evaluator_options;
+    evaluator_options.use_analytic_jacobians = options_.use_analytic_jacobians;
+    evaluator_options.use_float_jacobians = options_.use_float_jacobians;
+    if (config_.NumResiduals(*reconstruction) <
+        static_cast<size_t>(options_.min_num_residuals_for_multi_threading)) {
+      evaluator_options.num_threads = 1;
+    } else {
+      evaluator_options.num_threads =
+          GetEffectiveNumThreads(options_.solver_options.num_threads);
+    }
+    batched_evaluator_ =
+        std::make_shared<BatchedReprojErrorEvaluator>(evaluator_options);
+    problem_options.evaluation_callback = batched_evaluator_.get();
+  }
+#endif
+  if (batched_evaluator_) {
+    std::shared_ptr<BatchedReprojErrorEvaluator> evaluator = batched_evaluator_;
+    problem_ = std::shared_ptr<ceres::Problem>(
+        new ceres::Problem(problem_options),
+        [evaluator](ceres::Problem* problem) { delete problem; });
+  } else {
+    problem_ = std::make_shared<ceres::Problem>(problem_options);
+  }
+  observation_residuals_.clear();
+  point3D_params_.clear();
+  constant_cams_from_world_.clear();
+
+  if (options_.points3D_subsampling_num_levels > 0) {
+    SubsamplePoints3D(*reconstruction);
+  }
 
   // Set up problem
   // Warning: AddPointsToProblem assumes that AddImageToProblem is called first.
@@ -334,12 +455,52 @@ ceres::Solver::Options BundleAdjuster::SetUpSolverOptions(
 
   // Empirical choice.
   const size_t kMaxNumImagesDirectDenseSolver = 50;
+  const size_t kMaxNumImagesDirectDenseGpuSolver = 200;
   const size_t kMaxNumImagesDirectSparseSolver = 1000;
+  const size_t kMaxNumImagesDirectSparseGpuSolver = 4000;
   const size_t num_images = config_.NumImages();
-  if (num_images <= kMaxNumImagesDirectDenseSolver) {
+
+  bool use_gpu_dense = false;
+  bool use_gpu_sparse = false;
+  if (options_.use_gpu &&
+      num_images >= static_cast<size_t>(options_.min_num_images_gpu_solver)) {
+#if (CERES_VERSION_MAJOR >= 3 ||                                \
+     (CERES_VERSION_MAJOR == 2 && CERES_VERSION_MINOR >= 2)) && \
+    !defined(CERES_NO_CUDA)
+    use_gpu_dense = true;
+#else
+    LOG_FIRST_N(WARNING, 1)
+        << "Requested to use GPU for bundle adjustment, but Ceres was "
+           "compiled without CUDA support. Falling back to CPU solvers.";
+#endif
+#if (CERES_VERSION_MAJOR >= 3 ||                                \
+     (CERES_VERSION_MAJOR == 2 && CERES_VERSION_MINOR >= 3)) && \
+    !defined(CERES_NO_CUDSS)
+    use_gpu_sparse = true;
+#endif
+  }
+
+  if (num_images <= kMaxNumImagesDirectDenseSolver ||
+      (use_gpu_dense && num_images <= kMaxNumImagesDirectDenseGpuSolver)) {
     solver_options.linear_solver_type = ceres::DENSE_SCHUR;
-  } else if (num_images <= kMaxNumImagesDirectSparseSolver && has_sparse) {
+#if (CERES_VERSION_MAJOR >= 3 ||                                \
+     (CERES_VERSION_MAJOR == 2 && CERES_VERSION_MINOR >= 2)) && \
+    !defined(CERES_NO_CUDA)
+    if (use_gpu_dense) {
+      solver_options.dense_linear_algebra_library_type = ceres::CUDA;
+    }
+#endif
+  } else if ((num_images <= kMaxNumImagesDirectSparseSolver && has_sparse) ||
+             (use_gpu_sparse &&
+              num_images <= kMaxNumImagesDirectSparseGpuSolver)) {
     solver_options.linear_solver_type = ceres::SPARSE_SCHUR;
+#if (CERES_VERSION_MAJOR >= 3 ||                                \
+     (CERES_VERSION_MAJOR == 2 && CERES_VERSION_MINOR >= 3)) && \
+    !defined(CERES_NO_CUDSS)
+    if (use_gpu_sparse) {
+      solver_options.sparse_linear_algebra_library_type = ceres::CUDA_SPARSE;
+    }
+#endif
   } else {  // Indirect sparse (preconditioned CG) solver.
     solver_options.linear_solver_type = ceres::ITERATIVE_SCHUR;
     solver_options.preconditioner_type = ceres::SCHUR_JACOBI;
@@ -359,6 +520,14 @@ ceres::Solver::Options BundleAdjuster::SetUpSolverOptions(
 #endif  // CERES_VERSION_MAJOR
   }
 
+#if defined(COLMAP_CUDA_ENABLED)
+  if (use_gpu_dense || use_gpu_sparse) {
+    const std::vector<int> gpu_indices = CSVToVector<int>(options_.gpu_index);
+    THROW_CHECK_GT(gpu_indices.size(), 0);
+    SetBestCudaDevice(gpu_indices[0]);
+  }
+#endif  // COLMAP_CUDA_ENABLED
+
   std::string solver_error;
   THROW_CHECK(solver_options.IsValid(&solver_error)) << solver_error;
   return solver_options;
@@ -368,68 +537,113 @@ void BundleAdjuster::AddImageToProblem(const image_t image_id,
                                        Reconstruction* reconstruction,
                                        ceres::LossFunction* loss_function) {
   Image& image = reconstruction->Image(image_id);
-  Camera& camera = reconstruction->Camera(image.CameraId());
 
   // CostFunction assumes unit quaternions.
   image.CamFromWorld().rotation.normalize();
 
-  double* cam_from_world_rotation =
-      image.CamFromWorld().rotation.coeffs().data();
-  double* cam_from_world_translation = image.CamFromWorld().translation.data();
-  double* camera_params = camera.params.data();
-
   const bool constant_cam_pose =
       !options_.refine_extrinsics || config_.HasConstantCamPose(image_id);
 
+  if (options_.enable_problem_updates) {
+    observation_residuals_[image_id].assign(image.NumPoints2D(),
+                                            ObservationResidual());
+    if (constant_cam_pose) {
+      constant_cams_from_world_[image_id] = image.CamFromWorld();
+    }
+  }
+
   // Add residuals to bundle adjustment problem.
   size_t num_observations = 0;
-  for (const Point2D& point2D : image.Points2D()) {
-    if (!point2D.HasPoint3D()) {
+  for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+       ++point2D_idx) {
+    const Point2D& point2D = image.Point2D(point2D_idx);
+    if (!point2D.HasPoint3D() ||
+        (options_.points3D_subsampling_num_levels > 0 &&
+         selected_point3D_ids_.count(point2D.point3D_id) == 0)) {
       continue;
     }
-
     num_observations += 1;
-    point3D_num_observations_[point2D.point3D_id] += 1;
-
-    Point3D& point3D = reconstruction->Point3D(point2D.point3D_id);
-    assert(point3D.track.Length() > 1);
-
-    if (constant_cam_pose) {
-      problem_->AddResidualBlock(
-          CameraCostFunction<ReprojErrorConstantPoseCostFunction>(
-              camera.model_id, image.CamFromWorld(), point2D.xy),
-          loss_function,
-          point3D.xyz.data(),
-          camera_params);
-    } else {
-      problem_->AddResidualBlock(CameraCostFunction<ReprojErrorCostFunction>(
-                                     camera.model_id, point2D.xy),
-                                 loss_function,
-                                 cam_from_world_rotation,
-                                 cam_from_world_translation,
-                                 point3D.xyz.data(),
-                                 camera_params);
-    }
+    AddObservationToProblem(image_id,
+                            point2D_idx,
+                            constant_cam_pose,
+                            reconstruction,
+                            loss_function);
   }
 
   if (num_observations > 0) {
     camera_ids_.insert(image.CameraId());
-
-    // Set pose parameterization.
     if (!constant_cam_pose) {
-      SetQuaternionManifold(problem_.get(), cam_from_world_rotation);
-      if (config_.HasConstantCamPositions(image_id)) {
-        const std::vector<int>& constant_position_idxs =
-            config_.ConstantCamPositions(image_id);
-        SetSubsetManifold(3,
-                          constant_position_idxs,
-                          problem_.get(),
-                          cam_from_world_translation);
-      }
+      ParameterizeCamPose(image_id, image);
     }
   }
 }
 
+void BundleAdjuster::AddObservationToProblem(
+    const image_t image_id,
+    const point2D_t point2D_idx,
+    const bool constant_cam_pose,
+    Reconstruction* reconstruction,
+    ceres::LossFunction* loss_function) {
+  Image& image = reconstruction->Image(image_id);
+  Camera& camera = reconstruction->Camera(image.CameraId());
+  const Point2D& point2D = image.Point2D(point2D_idx);
+
+  point3D_num_observations_[point2D.point3D_id] += 1;
+
+  Point3D& point3D = reconstruction->Point3D(point2D.point3D_id);
+  assert(point3D.track.Length() > 1);
+
+  ceres::ResidualBlockId residual_block_id;
+  if (batched_evaluator_ && constant_cam_pose) {
+    residual_block_id = problem_->AddResidualBlock(
+        batched_evaluator_->AddConstantPoseObservation(camera.model_id,
+                                                       image.CamFromWorld(),
+                                                       point3D.xyz.data(),
+                                                       camera.params.data(),
+                                                       point2D.xy),
+        loss_function,
+        point3D.xyz.data(),
+        camera.params.data());
+  } else if (batched_evaluator_) {
+    residual_block_id = problem_->AddResidualBlock(
+        batched_evaluator_->AddObservation(
+            camera.model_id,
+            image.CamFromWorld().rotation.coeffs().data(),
+            image.CamFromWorld().translation.data(),
+            point3D.xyz.data(),
+            camera.params.data(),
+            point2D.xy),
+        loss_function,
+        image.CamFromWorld().rotation.coeffs().data(),
+        image.CamFromWorld().translation.data(),
+        point3D.xyz.data(),
+        camera.params.data());
+  } else if (constant_cam_pose) {
+    residual_block_id = problem_->AddResidualBlock(
+        CreateReprojErrorConstantPoseCostFunction(
+            options_, camera.model_id, image.CamFromWorld(), point2D.xy),
+        loss_function,
+        point3D.xyz.data(),
+        camera.params.data());
+  } else {
+    residual_block_id = problem_->AddResidualBlock(
+        CreateReprojErrorCostFunction(options_, camera.model_id, point2D.xy),
+        loss_function,
+        image.CamFromWorld().rotation.coeffs().data(),
+        image.CamFromWorld().translation.data(),
+        point3D.xyz.data(),
+        camera.params.data());
+  }
+
+  if (options_.enable_problem_updates) {
+    ObservationResidual& residual =
+        observation_residuals_.at(image_id)[point2D_idx];
+    residual.point3D_id = point2D.point3D_id;
+    residual.residual_block_id = residual_block_id;
+    point3D_params_.emplace(point2D.point3D_id, point3D.xyz.data());
+  }
+}
+
 void BundleAdjuster::AddPointToProblem(const point3D_t point3D_id,
                                        Reconstruction* reconstruction,
                                        ceres::LossFunction* loss_function) {
@@ -465,51 +679,284 @@ void BundleAdjuster::AddPointToProblem(const point3D_t point3D_id,
       config_.SetConstantCamIntrinsics(image.CameraId());
     }
     problem_->AddResidualBlock(
-        CameraCostFunction<ReprojErrorConstantPoseCostFunction>(
-            camera.model_id, image.CamFromWorld(), point2D.xy),
+        CreateReprojErrorConstantPoseCostFunction(
+            options_, camera.model_id, image.CamFromWorld(), point2D.xy),
         loss_function,
         point3D.xyz.data(),
         camera.params.data());
   }
 }
 
-void BundleAdjuster::ParameterizeCameras(Reconstruction* reconstruction) {
-  const bool constant_camera = !options_.refine_focal_length &&
-                               !options_.refine_principal_point &&
-                               !options_.refine_extra_params;
-  for (const camera_t camera_id : camera_ids_) {
-    Camera& camera = reconstruction->Camera(camera_id);
+void BundleAdjuster::SubsamplePoints3D(const Reconstruction& reconstruction) {
+  selected_point3D_ids_.clear();
+  unselected_point3D_ids_.clear();
+
+  // Explicitly configured points are always part of the problem.
+  selected_point3D_ids_.insert(config_.VariablePoints().begin(),
+                               config_.VariablePoints().end());
+  selected_point3D_ids_.insert(config_.ConstantPoints().begin(),
+                               config_.ConstantPoints().end());
+
+  std::unordered_map<image_t, VisibilityPyramid> visibility_pyramids;
+  std::unordered_set<point3D_t> observed_point3D_ids;
+  for (const image_t image_id : config_.Images()) {
+    const Image& image = reconstruction.Image(image_id);
+    const Camera& camera = reconstruction.Camera(image.CameraId());
+    visibility_pyramids.emplace(
+        image_id,
+        VisibilityPyramid(options_.points3D_subsampling_num_levels,
+                          camera.width,
+                          camera.height));
+    for (const Point2D& point2D : image.Points2D()) {
+      if (point2D.HasPoint3D()) {
+        observed_point3D_ids.insert(point2D.point3D_id);
+      }
+    }
+  }
 
-    if (constant_camera || config_.HasConstantCamIntrinsics(camera_id)) {
-      problem_->SetParameterBlockConstant(camera.params.data());
+  // Long tracks constrain more images, so they are selected first.
+  std::vector<std::pair<size_t, point3D_t>> candidates;
+  candidates.reserve(observed_point3D_ids.size());
+  for (const point3D_t point3D_id : observed_point3D_ids) {
+    if (selected_point3D_ids_.count(point3D_id) == 0) {
+      candidates.emplace_back(
+          reconstruction.Point3D(point3D_id).track.Length(), point3D_id);
+    }
+  }
+  std::sort(candidates.begin(),
+            candidates.end(),
+            std::greater<std::pair<size_t, point3D_t>>());
+
+  // Select a point if it populates a new cell in any of its images.
+  for (const auto& candidate : candidates) {
+    const point3D_t point3D_id = candidate.second;
+    const Track& track = reconstruction.Point3D(point3D_id).track;
+    bool populates_new_cell = false;
+    for (const TrackElement& track_el : track.Elements()) {
+      const auto it = visibility_pyramids.find(track_el.image_id);
+      if (it != visibility_pyramids.end()) {
+        const Eigen::Vector2d& xy = reconstruction.Image(track_el.image_id)
+                                        .Point2D(track_el.point2D_idx)
+                                        .xy;
+        const size_t prev_score = it->second.Score();
+        it->second.SetPoint(xy.x(), xy.y());
+        populates_new_cell |= it->second.Score() > prev_score;
+      }
+    }
+
+    if (populates_new_cell) {
+      selected_point3D_ids_.insert(point3D_id);
       continue;
+    }
+
+    unselected_point3D_ids_.push_back(point3D_id);
+    for (const TrackElement& track_el : track.Elements()) {
+      const auto it = visibility_pyramids.find(track_el.image_id);
+      if (it != visibility_pyramids.end()) {
+        const Eigen::Vector2d& xy = reconstruction.Image(track_el.image_id)
+                                        .Point2D(track_el.point2D_idx)
+                                        .xy;
+        it->second.ResetPoint(xy.x(), xy.y());
+      }
+    }
+  }
+
+  VLOG(1) << "Selected " << candidates.size() - unselected_point3D_ids_.size()
+          << " of " << candidates.size() << " points for bundle adjustment";
+}
+
+void BundleAdjuster::RefineUnselectedPoints3D(Reconstruction* reconstruction) {
+  // Only points with fully contained tracks would be variable in the problem.
+  std::vector<point3D_t> point3D_ids;
+  point3D_ids.reserve(unselected_point3D_ids_.size());
+  for (const point3D_t point3D_id : unselected_point3D_ids_) {
+    const Track& track = reconstruction->Point3D(point3D_id).track;
+    if (std::all_of(track.Elements().begin(),
+                    track.Elements().end(),
+                    [this](const TrackElement& track_el) {
+                      return config_.HasImage(track_el.image_id);
+                    })) {
+      point3D_ids.push_back(point3D_id);
+    }
+  }
+
+  StructureRefinementOptions structure_refinement_options;
+  structure_refinement_options.max_num_iterations =
+      options_.solver_options.max_num_iterations;
+  structure_refinement_options.parameter_tolerance =
+      options_.solver_options.parameter_tolerance;
+  structure_refinement_options.function_tolerance =
+      options_.solver_options.function_tolerance;
+  structure_refinement_options.num_threads =
+      options_.solver_options.num_threads;
+  RefinePoints3D(structure_refinement_options,
+                 point3D_ids,
+                 reconstruction,
+                 loss_function_.get());
+}
+
+void BundleAdjuster::UpdateProblem(Reconstruction* reconstruction,
+                                   ceres::LossFunction* loss_function) {
+  THROW_CHECK(options_.enable_problem_updates);
+  THROW_CHECK_EQ(config_.NumPoints(), 0)
+      << "Problems with explicitly configured points cannot be updated";
+
+  // Remove the residuals of deleted or reassigned observations and of constant
+  // images whose pose changed, e.g., by normalizing the reconstruction.
+  for (const image_t image_id : config_.Images()) {
+    Image& image = reconstruction->Image(image_id);
+    bool changed_constant_cam_pose = false;
+    const auto constant_cam_it = constant_cams_from_world_.find(image_id);
+    if (constant_cam_it != constant_cams_from_world_.end()) {
+      Rigid3d& prev_cam_from_world = constant_cam_it->second;
+      if (prev_cam_from_world.rotation.coeffs() !=
+              image.CamFromWorld().rotation.coeffs() ||
+          prev_cam_from_world.translation != image.CamFromWorld().translation) {
+        image.CamFromWorld().rotation.normalize();
+        prev_cam_from_world = image.CamFromWorld();
+        changed_constant_cam_pose = true;
+      }
     } else {
-      std::vector<int> const_camera_params;
+      // CostFunction assumes unit quaternions.
+      image.CamFromWorld().rotation.normalize();
+    }
 
-      if (!options_.refine_focal_length) {
-        const span<const size_t> params_idxs = camera.FocalLengthIdxs();
-        const_camera_params.insert(
-            const_camera_params.end(), params_idxs.begin(), params_idxs.end());
+    std::vector<ObservationResidual>& residuals =
+        observation_residuals_.at(image_id);
+    for (point2D_t point2D_idx = 0; point2D_idx < residuals.size();
+         ++point2D_idx) {
+      ObservationResidual& residual = residuals[point2D_idx];
+      if (residual.residual_block_id == nullptr ||
+          (!changed_constant_cam_pose &&
+           residual.point3D_id == image.Point2D(point2D_idx).point3D_id)) {
+        continue;
       }
-      if (!options_.refine_principal_point) {
-        const span<const size_t> params_idxs = camera.PrincipalPointIdxs();
-        const_camera_params.insert(
-            const_camera_params.end(), params_idxs.begin(), params_idxs.end());
+      problem_->RemoveResidualBlock(residual.residual_block_id);
+      const auto num_observations_it =
+          point3D_num_observations_.find(residual.point3D_id);
+      num_observations_it->second -= 1;
+      if (num_observations_it->second == 0) {
+        point3D_num_observations_.erase(num_observations_it);
       }
-      if (!options_.refine_extra_params) {
-        const span<const size_t> params_idxs = camera.ExtraParamsIdxs();
-        const_camera_params.insert(
-            const_camera_params.end(), params_idxs.begin(), params_idxs.end());
+      residual = ObservationResidual();
+    }
+  }
+
+  // Remove deleted 3D points before adding new residuals, since the memory of
+  // their parameter blocks may be reused by new 3D points.
+  for (auto it = point3D_params_.begin(); it != point3D_params_.end();) {
+    if (reconstruction->ExistsPoint3D(it->first)) {
+      ++it;
+    } else {
+      problem_->RemoveParameterBlock(it->second);
+      it = point3D_params_.erase(it);
+    }
+  }
+
+  // Add the residuals of new or reassigned observations.
+  for (const image_t image_id : config_.Images()) {
+    Image& image = reconstruction->Image(image_id);
+    const bool constant_cam_pose =
+        !options_.refine_extrinsics || config_.HasConstantCamPose(image_id);
+    const bool has_cam_pose =
+        constant_cam_pose ||
+        problem_->HasParameterBlock(
+            image.CamFromWorld().rotation.coeffs().data());
+
+    const std::vector<ObservationResidual>& residuals =
+        observation_residuals_.at(image_id);
+    size_t num_added_observations = 0;
+    for (point2D_t point2D_idx = 0; point2D_idx < residuals.size();
+         ++point2D_idx) {
+      if (residuals[point2D_idx].residual_block_id != nullptr ||
+          !image.Point2D(point2D_idx).HasPoint3D()) {
+        continue;
       }
+      num_added_observations += 1;
+      AddObservationToProblem(image_id,
+                              point2D_idx,
+                              constant_cam_pose,
+                              reconstruction,
+                              loss_function);
+    }
 
-      if (const_camera_params.size() > 0) {
-        SetSubsetManifold(static_cast<int>(camera.params.size()),
-                          const_camera_params,
-                          problem_.get(),
-                          camera.params.data());
+    if (num_added_observations > 0) {
+      if (camera_ids_.insert(image.CameraId()).second) {
+        ParameterizeCamera(image.CameraId(), reconstruction);
+      }
+      if (!has_cam_pose) {
+        ParameterizeCamPose(image_id, image);
       }
     }
   }
+
+  // Points are constant if their tracks are only partially contained.
+  for (const auto& elem : point3D_num_observations_) {
+    double* xyz = point3D_params_.at(elem.first);
+    if (reconstruction->Point3D(elem.first).track.Length() > elem.second) {
+      problem_->SetParameterBlockConstant(xyz);
+    } else {
+      problem_->SetParameterBlockVariable(xyz);
+    }
+  }
+}
+
+void BundleAdjuster::ParameterizeCamPose(const image_t image_id,
+                                         Image& image) {
+  SetQuaternionManifold(problem_.get(),
+                        image.CamFromWorld().rotation.coeffs().data());
+  if (config_.HasConstantCamPositions(image_id)) {
+    const std::vector<int>& constant_position_idxs =
+        config_.ConstantCamPositions(image_id);
+    SetSubsetManifold(3,
+                      constant_position_idxs,
+                      problem_.get(),
+                      image.CamFromWorld().translation.data());
+  }
+}
+
+void BundleAdjuster::ParameterizeCameras(Reconstruction* reconstruction) {
+  for (const camera_t camera_id : camera_ids_) {
+    ParameterizeCamera(camera_id, reconstruction);
+  }
+}
+
+void BundleAdjuster::ParameterizeCamera(const camera_t camera_id,
+                                        Reconstruction* reconstruction) {
+  const bool constant_camera = !options_.refine_focal_length &&
+                               !options_.refine_principal_point &&
+                               !options_.refine_extra_params;
+  Camera& camera = reconstruction->Camera(camera_id);
+
+  if (constant_camera || config_.HasConstantCamIntrinsics(camera_id)) {
+    problem_->SetParameterBlockConstant(camera.params.data());
+    return;
+  }
+
+  std::vector<int> const_camera_params;
+
+  if (!options_.refine_focal_length) {
+    const span<const size_t> params_idxs = camera.FocalLengthIdxs();
+    const_camera_params.insert(
+        const_camera_params.end(), params_idxs.begin(), params_idxs.end());
+  }
+  if (!options_.refine_principal_point) {
+    const span<const size_t> params_idxs = camera.PrincipalPointIdxs();
+    const_camera_params.insert(
+        const_camera_params.end(), params_idxs.begin(), params_idxs.end());
+  }
+  if (!options_.refine_extra_params) {
+    const span<const size_t> params_idxs = camera.ExtraParamsIdxs();
+    const_camera_params.insert(
+        const_camera_params.end(), params_idxs.begin(), params_idxs.end());
+  }
+
+  if (const_camera_params.size() > 0) {
+    SetSubsetManifold(static_cast<int>(camera.params.size()),
+                      const_camera_params,
+                      problem_.get(),
+                      camera.params.data());
+  }
 }
 
 void BundleAdjuster::ParameterizePoints(Reconstruction* reconstruction) {
@@ -547,6 +994,7 @@ bool RigBundleAdjuster::Solve(Reconstruction* reconstruction,
 
   ceres::Solver::Options solver_options =
       SetUpSolverOptions(*problem_, options_.solver_options);
+  SetUpSolverOrdering(*reconstruction, &solver_options);
 
   ceres::Solve(solver_options, problem_.get(), &summary_);
 
@@ -690,14 +1138,14 @@ void RigBundleAdjuster::AddImageToProblem(const image_t image_id,
     if (camera_rig == nullptr) {
       if (constant_cam_pose) {
         problem_->AddResidualBlock(
-            CameraCostFunction<ReprojErrorConstantPoseCostFunction>(
-                camera.model_id, image.CamFromWorld(), point2D.xy),
+            CreateReprojErrorConstantPoseCostFunction(
+                options_, camera.model_id, image.CamFromWorld(), point2D.xy),
             loss_function,
             point3D.xyz.data(),
             camera_params);
       } else {
-        problem_->AddResidualBlock(CameraCostFunction<ReprojErrorCostFunction>(
-                                       camera.model_id, point2D.xy),
+        problem_->AddResidualBlock(CreateReprojErrorCostFunction(
+                                       options_, camera.model_id, point2D.xy),
                                    loss_function,
                                    cam_from_rig_rotation,     // rig == world
                                    cam_from_rig_translation,  // rig == world
@@ -776,8 +1224,8 @@ void RigBundleAdjuster::AddPointToProblem(const point3D_t point3D_id,
     }
 
     problem_->AddResidualBlock(
-        CameraCostFunction<ReprojErrorConstantPoseCostFunction>(
-            camera.model_id, image.CamFromWorld(), point2D.xy),
+        CreateReprojErrorConstantPoseCostFunction(
+            options_, camera.model_id, image.CamFromWorld(), point2D.xy),
         loss_function,
         point3D.xyz.data(),
         camera.params.data());
@@ -811,6 +1259,309 @@ void RigBundleAdjuster::ParameterizeCameraRigs(Reconstruction* reconstruction) {
   }
 }
 
+void RigBundleAdjuster::SetUpSolverOrdering(
+    const Reconstruction& reconstruction,
+    ceres::Solver::Options* solver_options) const {
+  const bool is_schur_solver =
+      solver_options->linear_solver_type == ceres::DENSE_SCHUR ||
+      solver_options->linear_solver_type == ceres::SPARSE_SCHUR ||
+      solver_options->linear_solver_type == ceres::ITERATIVE_SCHUR;
+
+  if (rig_options_.use_elimination_ordering && is_schur_solver) {
+    const int kPointsGroup = 0;
+    const int kPosesGroup = 1;
+    const int kSharedGroup = 2;
+
+    std::unordered_set<const double*> pose_params;
+    for (const auto& rig_from_world : rigs_from_world_) {
+      for (const Rigid3d& snapshot_from_world : rig_from_world) {
+        pose_params.insert(snapshot_from_world.rotation.coeffs().data());
+        pose_params.insert(snapshot_from_world.translation.data());
+      }
+    }
+    for (const image_t image_id : config_.Images()) {
+      if (image_id_to_camera_rig_.count(image_id) == 0) {
+        const Rigid3d& cam_from_world =
+            reconstruction.Image(image_id).CamFromWorld();
+        pose_params.insert(cam_from_world.rotation.coeffs().data());
+        pose_params.insert(cam_from_world.translation.data());
+      }
+    }
+
+    std::unordered_set<const double*> point_params;
+    for (const auto& point3D : reconstruction.Points3D()) {
+      point_params.insert(point3D.second.xyz.data());
+    }
+
+    // The ordering must contain all parameter blocks, including the constant
+    // ones, which Ceres removes from the ordering itself.
+    std::vector<double*> parameter_blocks;
+    problem_->GetParameterBlocks(&parameter_blocks);
+    auto ordering = std::make_shared<ceres::ParameterBlockOrdering>();
+    for (double* parameter_block : parameter_blocks) {
+      if (point_params.count(parameter_block)) {
+        ordering->AddElementToGroup(parameter_block, kPointsGroup);
+      } else if (pose_params.count(parameter_block)) {
+        ordering->AddElementToGroup(parameter_block, kPosesGroup);
+      } else {
+        ordering->AddElementToGroup(parameter_block, kSharedGroup);
+      }
+    }
+    solver_options->linear_solver_ordering = ordering;
+  }
+
+  if (rig_options_.use_nested_dissection) {
+    bool has_nested_dissection = false;
+#if CERES_VERSION_MAJOR >= 3 || \
+    (CERES_VERSION_MAJOR == 2 && CERES_VERSION_MINOR >= 1)
+    switch (solver_options->sparse_linear_algebra_library_type) {
+      case ceres::SUITE_SPARSE:
+#if !defined(CERES_NO_CHOLMOD_PARTITION)
+        has_nested_dissection = true;
+#endif
+        break;
+#if CERES_VERSION_MAJOR >= 3 || \
+    (CERES_VERSION_MAJOR == 2 && CERES_VERSION_MINOR >= 2)
+      case ceres::EIGEN_SPARSE:
+#if !defined(CERES_NO_EIGEN_METIS)
+        has_nested_dissection = true;
+#endif
+        break;
+#endif
+      default:
+        break;
+    }
+#endif
+
+    const bool is_sparse_direct_solver =
+        solver_options->linear_solver_type == ceres::SPARSE_SCHUR ||
+        solver_options->linear_solver_type == ceres::SPARSE_NORMAL_CHOLESKY;
+    if (has_nested_dissection && is_sparse_direct_solver) {
+#if CERES_VERSION_MAJOR >= 3 || \
+    (CERES_VERSION_MAJOR == 2 && CERES_VERSION_MINOR >= 1)
+      solver_options->linear_solver_ordering_type = ceres::NESDIS;
+#endif
+    } else if (!has_nested_dissection) {
+      LOG_FIRST_N(WARNING, 1)
+          << "Requested nested dissection ordering for rig bundle adjustment, "
+             "but Ceres was compiled without METIS support for the sparse "
+             "linear algebra library. Falling back to the default ordering.";
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// PartitionedBundleAdjuster
+////////////////////////////////////////////////////////////////////////////////
+
+bool PartitionedBundleAdjuster::Options::Check() const {
+  CHECK_OPTION_GT(max_num_images_per_partition, 0);
+  CHECK_OPTION_GT(max_num_rounds, 0);
+  CHECK_OPTION_GE(function_tolerance, 0);
+  return true;
+}
+
+PartitionedBundleAdjuster::PartitionedBundleAdjuster(
+    const BundleAdjustmentOptions& options,
+    const Options& partition_options,
+    const BundleAdjustmentConfig& config)
+    : options_(options),
+      partition_options_(partition_options),
+      config_(config) {
+  THROW_CHECK(options_.Check());
+  THROW_CHECK(partition_options_.Check());
+}
+
+bool PartitionedBundleAdjuster::Solve(Reconstruction* reconstruction) {
+  THROW_CHECK_NOTNULL(reconstruction);
+  THROW_CHECK_EQ(config_.NumPoints(), 0)
+      << "Partitioned bundle adjustment only supports configured images";
+
+  PartitionImages(*reconstruction);
+  if (partitions_.size() <= 1) {
+    BundleAdjuster bundle_adjuster(options_, config_);
+    return bundle_adjuster.Solve(reconstruction);
+  }
+
+  LOG(INFO) << "Partitioned bundle adjustment of " << config_.NumImages()
+            << " images in " << partitions_.size() << " partitions";
+
+  bool success = false;
+  double prev_cost = -1;
+  for (int round = 0; round < partition_options_.max_num_rounds; ++round) {
+    double cost = 0;
+    if (!AdjustPartitions(reconstruction) ||
+        !AdjustStructure(reconstruction, &cost)) {
+      break;
+    }
+    success = true;
+    VLOG(1) << StringPrintf("=> Round %d with cost: %e", round + 1, cost);
+    if (prev_cost > 0 &&
+        prev_cost - cost < partition_options_.function_tolerance * prev_cost) {
+      break;
+    }
+    prev_cost = cost;
+  }
+
+  return success;
+}
+
+const std::vector<std::vector<image_t>>&
+PartitionedBundleAdjuster::Partitions() const {
+  return partitions_;
+}
+
+void PartitionedBundleAdjuster::PartitionImages(
+    const Reconstruction& reconstruction) {
+  partitions_.clear();
+
+  if (config_.NumImages() <=
+      static_cast<size_t>(partition_options_.max_num_images_per_partition)) {
+    partitions_.emplace_back(config_.Images().begin(), config_.Images().end());
+    return;
+  }
+
+  // Build the co-visibility graph of the configured images.
+  std::unordered_map<image_pair_t, int> num_shared_points3D;
+  for (const auto& point3D : reconstruction.Points3D()) {
+    const std::vector<TrackElement>& elements =
+        point3D.second.track.Elements();
+    for (size_t i = 0; i < elements.size(); ++i) {
+      if (!config_.HasImage(elements[i].image_id)) {
+        continue;
+      }
+      for (size_t j = 0; j < i; ++j) {
+        if (config_.HasImage(elements[j].image_id) &&
+            elements[i].image_id != elements[j].image_id) {
+          num_shared_points3D[Database::ImagePairToPairId(
+              elements[i].image_id, elements[j].image_id)] += 1;
+        }
+      }
+    }
+  }
+
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<int> num_shared;
+  image_pairs.reserve(num_shared_points3D.size());
+  num_shared.reserve(num_shared_points3D.size());
+  for (const auto& image_pair : num_shared_points3D) {
+    image_pairs.push_back(Database::PairIdToImagePair(image_pair.first));
+    num_shared.push_back(image_pair.second);
+  }
+
+  SceneClustering::Options clustering_options;
+  clustering_options.is_hierarchical = true;
+  clustering_options.image_overlap = 0;
+  clustering_options.leaf_max_num_images =
+      partition_options_.max_num_images_per_partition;
+  SceneClustering scene_clustering(clustering_options);
+  scene_clustering.Partition(image_pairs, num_shared);
+
+  // Every image is adjusted in exactly one partition. Images without any
+  // co-visible images are added to the first partition.
+  std::unordered_set<image_t> partitioned_image_ids;
+  for (const auto* cluster : scene_clustering.GetLeafClusters()) {
+    std::vector<image_t> partition;
+    for (const image_t image_id : cluster->image_ids) {
+      if (partitioned_image_ids.insert(image_id).second) {
+        partition.push_back(image_id);
+      }
+    }
+    if (!partition.empty()) {
+      partitions_.push_back(std::move(partition));
+    }
+  }
+  if (partitions_.empty()) {
+    partitions_.emplace_back();
+  }
+  for (const image_t image_id : config_.Images()) {
+    if (partitioned_image_ids.count(image_id) == 0) {
+      partitions_[0].push_back(image_id);
+    }
+  }
+}
+
+bool PartitionedBundleAdjuster::AdjustPartitions(
+    Reconstruction* reconstruction) {
+  // Cameras shared across partitions would be concurrently refined.
+  std::unordered_map<camera_t, size_t> camera_partition_idxs;
+  std::unordered_set<camera_t> shared_camera_ids;
+  for (size_t partition_idx = 0; partition_idx < partitions_.size();
+       ++partition_idx) {
+    for (const image_t image_id : partitions_[partition_idx]) {
+      const camera_t camera_id = reconstruction->Image(image_id).CameraId();
+      const auto it =
+          camera_partition_idxs.emplace(camera_id, partition_idx).first;
+      if (it->second != partition_idx) {
+        shared_camera_ids.insert(camera_id);
+      }
+    }
+  }
+
+  const int num_threads =
+      GetEffectiveNumThreads(options_.solver_options.num_threads);
+  const int num_parallel_partitions =
+      std::min(num_threads, static_cast<int>(partitions_.size()));
+
+  BundleAdjustmentOptions partition_ba_options = options_;
+  partition_ba_options.print_summary = false;
+  partition_ba_options.solver_options.num_threads =
+      std::max(1, num_threads / num_parallel_partitions);
+
+  // The partitions only share constant parameters, so they can be adjusted
+  // concurrently on the same reconstruction.
+  std::vector<char> partition_success(partitions_.size(), 0);
+  ThreadPool thread_pool(num_parallel_partitions);
+  for (size_t partition_idx = 0; partition_idx < partitions_.size();
+       ++partition_idx) {
+    thread_pool.AddTask([&, partition_idx]() {
+      BundleAdjustmentConfig partition_config;
+      for (const image_t image_id : partitions_[partition_idx]) {
+        partition_config.AddImage(image_id);
+        if (config_.HasConstantCamPose(image_id)) {
+          partition_config.SetConstantCamPose(image_id);
+        } else if (config_.HasConstantCamPositions(image_id)) {
+          partition_config.SetConstantCamPositions(
+              image_id, config_.ConstantCamPositions(image_id));
+        }
+        const camera_t camera_id = reconstruction->Image(image_id).CameraId();
+        if (config_.HasConstantCamIntrinsics(camera_id) ||
+            shared_camera_ids.count(camera_id) > 0) {
+          partition_config.SetConstantCamIntrinsics(camera_id);
+        }
+      }
+      BundleAdjuster bundle_adjuster(partition_ba_options, partition_config);
+      partition_success[partition_idx] = bundle_adjuster.Solve(reconstruction);
+    });
+  }
+  thread_pool.Wait();
+
+  return std::find(partition_success.begin(), partition_success.end(), 1) !=
+         partition_success.end();
+}
+
+bool PartitionedBundleAdjuster::AdjustStructure(Reconstruction* reconstruction,
+                                                double* cost) {
+  BundleAdjustmentConfig structure_config;
+  for (const image_t image_id : config_.Images()) {
+    structure_config.AddImage(image_id);
+    structure_config.SetConstantCamPose(image_id);
+    const camera_t camera_id = reconstruction->Image(image_id).CameraId();
+    if (config_.HasConstantCamIntrinsics(camera_id)) {
+      structure_config.SetConstantCamIntrinsics(camera_id);
+    }
+  }
+
+  BundleAdjustmentOptions structure_ba_options = options_;
+  structure_ba_options.print_summary = false;
+  BundleAdjuster bundle_adjuster(structure_ba_options, structure_config);
+  if (!bundle_adjuster.Solve(reconstruction)) {
+    return false;
+  }
+  *cost = bundle_adjuster.Summary().final_cost;
+  return true;
+}
+
 void PrintSolverSummary(const ceres::Solver::Summary& summary,
                         const std::string& header) {
   std::ostringstream log;
@@ -41,6 +41,8 @@
 
 namespace colmap {
 
+class BatchedReprojErrorEvaluator;
+
 struct BundleAdjustmentOptions {
   // Loss function types: Trivial (non-robust) and Cauchy (robust) loss.
   enum class LossFunctionType { TRIVIAL, SOFT_L1, CAUCHY };
@@ -61,6 +63,40 @@ struct BundleAdjustmentOptions {
   // Whether to refine the extrinsic parameter group.
   bool refine_extrinsics = true;
 
+  // Whether to use cost functions with analytic instead of automatically
+  // differentiated Jacobians for the camera models that support them, i.e.,
+  // PINHOLE, SIMPLE_RADIAL, RADIAL, and OPENCV. Other models and camera rigs
+  // always use automatic differentiation.
+  bool use_analytic_jacobians = false;
+
+  // Whether to evaluate the automatically differentiated Jacobians in single
+  // instead of double precision. The residuals are still evaluated in double
+  // precision. This is experimental and speeds up the Jacobian evaluation at
+  // the cost of less accurate Gauss-Newton steps, which are only acceptable
+  // for well-conditioned problems. Applies to the models not covered by
+  // analytic Jacobians, if those are enabled.
+  bool use_float_jacobians = false;
+
+  // Whether to evaluate the reprojection errors of all observations in
+  // batches grouped by camera model before each evaluation of the solver
+  // (requires Ceres >= 2.0), instead of evaluating every residual block on its
+  // own. This avoids the overhead of per-residual-block virtual calls for
+  // large problems. Ignored if `enable_problem_updates` is set.
+  bool use_batched_evaluation = false;
+
+  // Whether to use Ceres' CUDA linear solvers, if Ceres was built with CUDA
+  // support. Dense solvers require Ceres >= 2.2 and sparse solvers require
+  // Ceres >= 2.3 with cuDSS. Otherwise, the CPU solvers are used.
+  bool use_gpu = false;
+
+  // Index of the GPU used for bundle adjustment. With the default of -1, the
+  // best available GPU is selected.
+  std::string gpu_index = "-1";
+
+  // Minimum number of images to use the GPU solvers. Smaller problems are
+  // typically solved faster on the CPU.
+  int min_num_images_gpu_solver = 50;
+
   // Whether to print a final summary.
   bool print_summary = true;
 
@@ -69,6 +105,18 @@ struct BundleAdjustmentOptions {
   // due to the overhead of threading.
   int min_num_residuals_for_multi_threading = 50000;
 
+  // Whether to keep track of the residual blocks of all observations, such
+  // that the problem can be updated with `BundleAdjuster::Resolve` instead of
+  // being set up from scratch. Requires more memory during problem setup.
+  bool enable_problem_updates = false;
+
+  // If positive, the cameras are adjusted with a subset of the 3D points,
+  // which are greedily selected in the order of their track lengths to cover
+  // every image uniformly in a visibility pyramid with this number of levels.
+  // The other 3D points are then refined in parallel with constant cameras.
+  // This is much faster for reconstructions with many redundant 3D points.
+  int points3D_subsampling_num_levels = 0;
+
   // Ceres-Solver options.
   ceres::Solver::Options solver_options;
 
@@ -172,6 +220,14 @@ class BundleAdjuster {
 
   bool Solve(Reconstruction* reconstruction);
 
+  // Update the problem of the last call to `Solve` for the changes to the
+  // observations of the configured images since then, e.g., due to merged,
+  // completed, or filtered tracks, and solve it again. Only the residual blocks
+  // of changed observations are removed and added. Requires the
+  // `enable_problem_updates` option and a configuration without explicitly
+  // added variable or constant points.
+  bool Resolve(Reconstruction* reconstruction);
+
   // Set up the problem
   void SetUpProblem(Reconstruction* reconstruction,
                     ceres::LossFunction* loss_function);
@@ -188,14 +244,56 @@ class BundleAdjuster {
   const ceres::Solver::Summary& Summary() const;
 
  private:
+  bool SolveProblem();
+
+  void SubsamplePoints3D(const Reconstruction& reconstruction);
+  void RefineUnselectedPoints3D(Reconstruction* reconstruction);
+
   void AddImageToProblem(image_t image_id,
                          Reconstruction* reconstruction,
                          ceres::LossFunction* loss_function);
 
+  void AddObservationToProblem(image_t image_id,
+                               point2D_t point2D_idx,
+                               bool constant_cam_pose,
+                               Reconstruction* reconstruction,
+                               ceres::LossFunction* loss_function);
+
   void AddPointToProblem(point3D_t point3D_id,
                          Reconstruction* reconstruction,
                          ceres::LossFunction* loss_function);
 
+  void UpdateProblem(Reconstruction* reconstruction,
+                     ceres::LossFunction* loss_function);
+
+  void ParameterizeCamPose(image_t image_id, Image& image);
+  void ParameterizeCamera(camera_t camera_id, Reconstruction* reconstruction);
+
+  struct ObservationResidual {
+    point3D_t point3D_id = kInvalidPoint3DId;
+    ceres::ResidualBlockId residual_block_id = nullptr;
+  };
+
+  // The residual blocks of the observations of each configured image, indexed
+  // by 2D point, if the problem can be updated.
+  std::unordered_map<image_t, std::vector<ObservationResidual>>
+      observation_residuals_;
+  // The parameter blocks of the 3D points in the problem, which are needed to
+  // remove deleted 3D points from the problem.
+  std::unordered_map<point3D_t, double*> point3D_params_;
+  // The poses of the constant images, which are baked into their cost
+  // functions and thus require to recreate the residuals on changes.
+  std::unordered_map<image_t, Rigid3d> constant_cams_from_world_;
+
+  // The evaluation callback of the problem for batched evaluation, which is
+  // kept alive by the problem as long as its residual blocks reference it.
+  std::shared_ptr<BatchedReprojErrorEvaluator> batched_evaluator_;
+
+  // The 3D points selected for the problem and the other observed 3D points,
+  // if the points are subsampled.
+  std::unordered_set<point3D_t> selected_point3D_ids_;
+  std::vector<point3D_t> unselected_point3D_ids_;
+
  protected:
   void ParameterizeCameras(Reconstruction* reconstruction);
   void ParameterizePoints(Reconstruction* reconstruction);
@@ -223,6 +321,21 @@ class RigBundleAdjuster : public BundleAdjuster {
     // rig poses, which might be different from the absolute pose of the image
     // in the reconstruction.
     double max_reproj_error = 1000.0;
+
+    // Whether to explicitly order the parameter blocks for the elimination in
+    // the Schur-based solvers instead of relying on the automatic ordering of
+    // Ceres. The 3D points are eliminated first, followed by the per-snapshot
+    // rig poses and the poses of images without rig, and finally the relative
+    // poses of the rig cameras and the camera intrinsics, which are shared by
+    // many snapshots.
+    bool use_elimination_ordering = true;
+
+    // Whether to order the reduced camera system by nested dissection using
+    // METIS instead of approximate minimum degree, which typically causes less
+    // fill-in for large rigs with many snapshots. Only applies to the sparse
+    // direct solvers and requires Ceres >= 2.1 built with METIS support for
+    // the employed sparse linear algebra library.
+    bool use_nested_dissection = false;
   };
 
   RigBundleAdjuster(const BundleAdjustmentOptions& options,
@@ -254,6 +367,9 @@ class RigBundleAdjuster : public BundleAdjuster {
 
   void ParameterizeCameraRigs(Reconstruction* reconstruction);
 
+  void SetUpSolverOrdering(const Reconstruction& reconstruction,
+                           ceres::Solver::Options* solver_options) const;
+
   const Options rig_options_;
 
   // Mapping from images to camera rigs.
@@ -270,6 +386,49 @@ class RigBundleAdjuster : public BundleAdjuster {
   std::unordered_set<double*> parameterized_quats_;
 };
 
+// Partitioned bundle adjustment for large problems. The configured images are
+// partitioned into disjoint clusters of co-visible images using
+// `SceneClustering`. In each round, the partitions are adjusted in parallel
+// while the 3D points observed across partitions and the cameras shared across
+// partitions are held constant. Afterwards, all 3D points and cameras are
+// adjusted with constant poses. This is a block-coordinate descent on the
+// global problem, which is repeated until the cost converges.
+class PartitionedBundleAdjuster {
+ public:
+  struct Options {
+    // The maximum number of images per partition. Problems with fewer images
+    // are adjusted jointly by a single bundle adjuster.
+    int max_num_images_per_partition = 500;
+
+    // The maximum number of block-coordinate descent rounds.
+    int max_num_rounds = 10;
+
+    // Stop once the relative decrease of the cost in a round is smaller.
+    double function_tolerance = 1e-3;
+
+    bool Check() const;
+  };
+
+  PartitionedBundleAdjuster(const BundleAdjustmentOptions& options,
+                            const Options& partition_options,
+                            const BundleAdjustmentConfig& config);
+
+  bool Solve(Reconstruction* reconstruction);
+
+  // The image partitions of the last call to `Solve`.
+  const std::vector<std::vector<image_t>>& Partitions() const;
+
+ private:
+  void PartitionImages(const Reconstruction& reconstruction);
+  bool AdjustPartitions(Reconstruction* reconstruction);
+  bool AdjustStructure(Reconstruction* reconstruction, double* cost);
+
+  const BundleAdjustmentOptions options_;
+  const Options partition_options_;
+  const BundleAdjustmentConfig config_;
+  std::vector<std::vector<image_t>> partitions_;
+};
+
 void PrintSolverSummary(const ceres::Solver::Summary& summary,
                         const std::string& header);
 
@@ -251,6 +251,74 @@ TEST(BundleAdjustment, TwoView) {
   }
 }
 
+TEST(BundleAdjustment, TwoViewFloatJacobians) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(2, 100, &reconstruction);
+  const auto orig_reconstruction = reconstruction;
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.SetConstantCamPose(0);
+  config.SetConstantCamPositions(1, {0});
+
+  BundleAdjustmentOptions options;
+  options.use_float_jacobians = true;
+  BundleAdjuster bundle_adjuster(options, config);
+  ASSERT_TRUE(bundle_adjuster.Solve(&reconstruction));
+
+  const auto summary = bundle_adjuster.Summary();
+
+  EXPECT_EQ(summary.num_residuals_reduced, 400);
+  EXPECT_EQ(summary.num_effective_parameters_reduced, 309);
+  EXPECT_LE(summary.final_cost, summary.initial_cost);
+
+  CheckVariableCamera(reconstruction.Camera(0), orig_reconstruction.Camera(0));
+  CheckConstantImage(reconstruction.Image(0), orig_reconstruction.Image(0));
+
+  CheckVariableCamera(reconstruction.Camera(1), orig_reconstruction.Camera(1));
+  CheckConstantXImage(reconstruction.Image(1), orig_reconstruction.Image(1));
+
+  for (const auto& point3D : reconstruction.Points3D()) {
+    CheckVariablePoint(point3D.second,
+                       orig_reconstruction.Point3D(point3D.first));
+  }
+}
+
+TEST(BundleAdjustment, TwoViewBatchedEvaluation) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(2, 100, &reconstruction);
+  const auto orig_reconstruction = reconstruction;
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.SetConstantCamPose(0);
+  config.SetConstantCamPositions(1, {0});
+
+  BundleAdjustmentOptions options;
+  options.use_batched_evaluation = true;
+  BundleAdjuster bundle_adjuster(options, config);
+  ASSERT_TRUE(bundle_adjuster.Solve(&reconstruction));
+
+  const auto summary = bundle_adjuster.Summary();
+
+  EXPECT_EQ(summary.num_residuals_reduced, 400);
+  EXPECT_EQ(summary.num_effective_parameters_reduced, 309);
+  EXPECT_LE(summary.final_cost, summary.initial_cost);
+
+  CheckVariableCamera(reconstruction.Camera(0), orig_reconstruction.Camera(0));
+  CheckConstantImage(reconstruction.Image(0), orig_reconstruction.Image(0));
+
+  CheckVariableCamera(reconstruction.Camera(1), orig_reconstruction.Camera(1));
+  CheckConstantXImage(reconstruction.Image(1), orig_reconstruction.Image(1));
+
+  for (const auto& point3D : reconstruction.Points3D()) {
+    CheckVariablePoint(point3D.second,
+                       orig_reconstruction.Point3D(point3D.first));
+  }
+}
+
 TEST(BundleAdjustment, TwoViewConstantCamera) {
   Reconstruction reconstruction;
   GenerateReconstruction(2, 100, &reconstruction);
@@ -478,6 +546,80 @@ TEST(BundleAdjustment, VariableImage) {
   }
 }
 
+TEST(BundleAdjustment, Resolve) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(3, 100, &reconstruction);
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.AddImage(2);
+  config.SetConstantCamPose(0);
+  config.SetConstantCamPositions(1, {0});
+
+  BundleAdjustmentOptions options;
+  options.enable_problem_updates = true;
+  BundleAdjuster bundle_adjuster(options, config);
+  ASSERT_TRUE(bundle_adjuster.Solve(&reconstruction));
+  EXPECT_EQ(bundle_adjuster.Summary().num_residuals_reduced, 600);
+  EXPECT_EQ(bundle_adjuster.Summary().num_effective_parameters_reduced, 317);
+
+  // Delete one 3D point and one observation and change the constant pose.
+  reconstruction.DeletePoint3D(reconstruction.Image(2).Point2D(0).point3D_id);
+  const point3D_t point3D_id = reconstruction.Image(2).Point2D(1).point3D_id;
+  reconstruction.DeleteObservation(2, 1);
+  reconstruction.Normalize();
+  const auto normalized_reconstruction = reconstruction;
+
+  ASSERT_TRUE(bundle_adjuster.Resolve(&reconstruction));
+  // 99 points, 3 images, 2 residuals per point per image, minus one
+  // observation.
+  EXPECT_EQ(bundle_adjuster.Summary().num_residuals_reduced, 592);
+  EXPECT_EQ(bundle_adjuster.Summary().num_effective_parameters_reduced, 314);
+  EXPECT_EQ(bundle_adjuster.Problem()->NumResidualBlocks(), 296);
+  CheckConstantImage(reconstruction.Image(0),
+                     normalized_reconstruction.Image(0));
+
+  // Add back the deleted observation.
+  reconstruction.AddObservation(point3D_id, TrackElement(2, 1));
+  ASSERT_TRUE(bundle_adjuster.Resolve(&reconstruction));
+  EXPECT_EQ(bundle_adjuster.Summary().num_residuals_reduced, 594);
+  EXPECT_EQ(bundle_adjuster.Problem()->NumResidualBlocks(), 297);
+}
+
+TEST(BundleAdjustment, SubsampledPoints) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(3, 100, &reconstruction);
+  const auto orig_reconstruction = reconstruction;
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.AddImage(2);
+  config.SetConstantCamPose(0);
+  config.SetConstantCamPositions(1, {0});
+
+  BundleAdjustmentOptions options;
+  options.points3D_subsampling_num_levels = 1;
+  BundleAdjuster bundle_adjuster(options, config);
+  ASSERT_TRUE(bundle_adjuster.Solve(&reconstruction));
+
+  // At most 2 x 2 points per image, 3 images, 2 residuals per point per image.
+  const auto summary = bundle_adjuster.Summary();
+  EXPECT_GT(summary.num_residuals_reduced, 0);
+  EXPECT_LE(summary.num_residuals_reduced, 72);
+
+  CheckConstantImage(reconstruction.Image(0), orig_reconstruction.Image(0));
+  CheckConstantXImage(reconstruction.Image(1), orig_reconstruction.Image(1));
+  CheckVariableImage(reconstruction.Image(2), orig_reconstruction.Image(2));
+
+  // The points not in the problem are refined afterwards.
+  for (const auto& point3D : reconstruction.Points3D()) {
+    CheckVariablePoint(point3D.second,
+                       orig_reconstruction.Point3D(point3D.first));
+  }
+}
+
 TEST(BundleAdjustment, ConstantFocalLength) {
   Reconstruction reconstruction;
   GenerateReconstruction(2, 100, &reconstruction);
@@ -643,6 +785,49 @@ TEST(BundleAdjustment, ConstantExtraParam) {
   }
 }
 
+TEST(BundleAdjustment, Partitioned) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(4, 100, &reconstruction);
+  const auto orig_reconstruction = reconstruction;
+
+  BundleAdjustmentConfig config;
+  config.AddImage(0);
+  config.AddImage(1);
+  config.AddImage(2);
+  config.AddImage(3);
+  config.SetConstantCamPose(0);
+  config.SetConstantCamPositions(1, {0});
+
+  BundleAdjustmentOptions options;
+  PartitionedBundleAdjuster::Options partition_options;
+  partition_options.max_num_images_per_partition = 2;
+  PartitionedBundleAdjuster bundle_adjuster(options, partition_options, config);
+  ASSERT_TRUE(bundle_adjuster.Solve(&reconstruction));
+
+  // Every image is adjusted in exactly one partition.
+  std::unordered_set<image_t> partitioned_image_ids;
+  size_t num_partitioned_images = 0;
+  for (const auto& partition : bundle_adjuster.Partitions()) {
+    partitioned_image_ids.insert(partition.begin(), partition.end());
+    num_partitioned_images += partition.size();
+  }
+  EXPECT_EQ(partitioned_image_ids.size(), 4);
+  EXPECT_EQ(num_partitioned_images, 4);
+
+  CheckConstantImage(reconstruction.Image(0), orig_reconstruction.Image(0));
+  CheckConstantXImage(reconstruction.Image(1), orig_reconstruction.Image(1));
+  CheckVariableImage(reconstruction.Image(2), orig_reconstruction.Image(2));
+  CheckVariableImage(reconstruction.Image(3), orig_reconstruction.Image(3));
+  for (const auto& camera : reconstruction.Cameras()) {
+    CheckVariableCamera(camera.second,
+                        orig_reconstruction.Camera(camera.first));
+  }
+  for (const auto& point3D : reconstruction.Points3D()) {
+    CheckVariablePoint(point3D.second,
+                       orig_reconstruction.Point3D(point3D.first));
+  }
+}
+
 TEST(BundleAdjustment, RigTwoView) {
   Reconstruction reconstruction;
   GenerateReconstruction(2, 100, &reconstruction);
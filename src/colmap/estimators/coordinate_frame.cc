@@ -37,6 +37,9 @@
 #include "colmap/optim/ransac.h"
 #include "colmap/util/logging.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/threading.h"
+
+#include <future>
 
 namespace colmap {
 namespace {
@@ -158,98 +161,148 @@ struct VanishingPointEstimator {
   }
 };
 
-Eigen::Matrix3d EstimateManhattanWorldFrame(
+// The vanishing point axes of a single image in world coordinates.
+struct ImageManhattanAxes {
+  size_t num_line_segments = 0;
+  size_t num_horizontal_lines = 0;
+  size_t num_vertical_lines = 0;
+  size_t num_horizontal_inliers = 0;
+  size_t num_vertical_inliers = 0;
+  bool has_horizontal_axis = false;
+  Eigen::Vector3d horizontal_axis = Eigen::Vector3d::Zero();
+  bool has_vertical_axis = false;
+  Eigen::Vector3d vertical_axis = Eigen::Vector3d::Zero();
+};
+
+ImageManhattanAxes EstimateImageManhattanAxes(
     const ManhattanWorldFrameEstimationOptions& options,
     const Reconstruction& reconstruction,
-    const std::string& image_path) {
-  std::vector<Eigen::Vector3d> rightward_axes;
-  std::vector<Eigen::Vector3d> downward_axes;
-  for (size_t i = 0; i < reconstruction.NumRegImages(); ++i) {
-    const auto image_id = reconstruction.RegImageIds()[i];
-    const auto& image = reconstruction.Image(image_id);
-    const auto& camera = reconstruction.Camera(image.CameraId());
-
-    PrintHeading1(StringPrintf("Processing image %s (%d / %d)",
-                               image.Name().c_str(),
-                               i + 1,
-                               reconstruction.NumRegImages()));
-
-    LOG(INFO) << "Reading image...";
-
-    colmap::Bitmap bitmap;
-    THROW_CHECK(bitmap.Read(colmap::JoinPaths(image_path, image.Name())));
-
-    LOG(INFO) << "Undistorting image...";
-
-    UndistortCameraOptions undistortion_options;
-    undistortion_options.max_image_size = options.max_image_size;
-
-    Bitmap undistorted_bitmap;
-    Camera undistorted_camera;
-    UndistortImage(undistortion_options,
-                   bitmap,
-                   camera,
-                   &undistorted_bitmap,
-                   &undistorted_camera);
-
-    LOG(INFO) << "Detecting lines...";
-
-    const std::vector<LineSegment> line_segments =
-        DetectLineSegments(undistorted_bitmap, options.min_line_length);
-    const std::vector<LineSegmentOrientation> line_orientations =
-        ClassifyLineSegmentOrientations(line_segments,
-                                        options.line_orientation_tolerance);
-
-    LOG(INFO) << StringPrintf(" %d", line_segments.size());
-
-    std::vector<LineSegment> horizontal_line_segments;
-    std::vector<LineSegment> vertical_line_segments;
-    std::vector<Eigen::Vector3d> horizontal_lines;
-    std::vector<Eigen::Vector3d> vertical_lines;
-    for (size_t i = 0; i < line_segments.size(); ++i) {
-      const auto& line_segment = line_segments[i];
-      const Eigen::Vector3d line_segment_start =
-          line_segment.start.homogeneous();
-      const Eigen::Vector3d line_segment_end = line_segment.end.homogeneous();
-      const Eigen::Vector3d line = line_segment_start.cross(line_segment_end);
-      if (line_orientations[i] == LineSegmentOrientation::HORIZONTAL) {
-        horizontal_line_segments.push_back(line_segment);
-        horizontal_lines.push_back(line);
-      } else if (line_orientations[i] == LineSegmentOrientation::VERTICAL) {
-        vertical_line_segments.push_back(line_segment);
-        vertical_lines.push_back(line);
-      }
+    const std::string& image_path,
+    const image_t image_id) {
+  const auto& image = reconstruction.Image(image_id);
+  const auto& camera = reconstruction.Camera(image.CameraId());
+
+  colmap::Bitmap bitmap;
+  THROW_CHECK(bitmap.Read(colmap::JoinPaths(image_path, image.Name())));
+
+  UndistortCameraOptions undistortion_options;
+  undistortion_options.max_image_size = options.max_image_size;
+
+  Bitmap undistorted_bitmap;
+  Camera undistorted_camera;
+  UndistortImage(undistortion_options,
+                 bitmap,
+                 camera,
+                 &undistorted_bitmap,
+                 &undistorted_camera);
+
+  const std::vector<LineSegment> line_segments =
+      DetectLineSegments(undistorted_bitmap, options.min_line_length);
+  const std::vector<LineSegmentOrientation> line_orientations =
+      ClassifyLineSegmentOrientations(line_segments,
+                                      options.line_orientation_tolerance);
+
+  std::vector<LineSegment> horizontal_line_segments;
+  std::vector<LineSegment> vertical_line_segments;
+  std::vector<Eigen::Vector3d> horizontal_lines;
+  std::vector<Eigen::Vector3d> vertical_lines;
+  for (size_t i = 0; i < line_segments.size(); ++i) {
+    const auto& line_segment = line_segments[i];
+    const Eigen::Vector3d line_segment_start = line_segment.start.homogeneous();
+    const Eigen::Vector3d line_segment_end = line_segment.end.homogeneous();
+    const Eigen::Vector3d line = line_segment_start.cross(line_segment_end);
+    if (line_orientations[i] == LineSegmentOrientation::HORIZONTAL) {
+      horizontal_line_segments.push_back(line_segment);
+      horizontal_lines.push_back(line);
+    } else if (line_orientations[i] == LineSegmentOrientation::VERTICAL) {
+      vertical_line_segments.push_back(line_segment);
+      vertical_lines.push_back(line);
     }
+  }
 
-    LOG(INFO) << StringPrintf(" (%d horizontal, %d vertical)",
-                              horizontal_lines.size(),
-                              vertical_lines.size());
-
-    LOG(INFO) << "Estimating vanishing points...";
+  RANSACOptions ransac_options;
+  ransac_options.max_error = options.max_line_vp_distance;
+  RANSAC<VanishingPointEstimator> ransac(ransac_options);
+  const auto horizontal_report =
+      ransac.Estimate(horizontal_line_segments, horizontal_lines);
+  const auto vertical_report =
+      ransac.Estimate(vertical_line_segments, vertical_lines);
+
+  ImageManhattanAxes axes;
+  axes.num_line_segments = line_segments.size();
+  axes.num_horizontal_lines = horizontal_lines.size();
+  axes.num_vertical_lines = vertical_lines.size();
+  axes.num_horizontal_inliers = horizontal_report.support.num_inliers;
+  axes.num_vertical_inliers = vertical_report.support.num_inliers;
+
+  const Eigen::Matrix3d inv_calib_matrix =
+      undistorted_camera.CalibrationMatrix().inverse();
+  const Eigen::Quaterniond world_from_cam_rotation =
+      image.CamFromWorld().rotation.inverse();
+
+  if (horizontal_report.success) {
+    axes.has_horizontal_axis = true;
+    axes.horizontal_axis =
+        world_from_cam_rotation *
+        (inv_calib_matrix * horizontal_report.model).normalized();
+  }
 
-    RANSACOptions ransac_options;
-    ransac_options.max_error = options.max_line_vp_distance;
-    RANSAC<VanishingPointEstimator> ransac(ransac_options);
-    const auto horizontal_report =
-        ransac.Estimate(horizontal_line_segments, horizontal_lines);
-    const auto vertical_report =
-        ransac.Estimate(vertical_line_segments, vertical_lines);
+  if (vertical_report.success) {
+    const Eigen::Vector3d vertical_axis_in_cam =
+        (inv_calib_matrix * vertical_report.model).normalized();
+    axes.has_vertical_axis = true;
+    axes.vertical_axis =
+        (world_from_cam_rotation * vertical_axis_in_cam).normalized();
+    // Make sure axis points downwards in the image, assuming that the image
+    // was taken in upright orientation.
+    if (axes.vertical_axis.dot(Eigen::Vector3d(0, 1, 0)) < 0) {
+      axes.vertical_axis = -axes.vertical_axis;
+    }
+  }
 
-    LOG(INFO) << StringPrintf(" (%d horizontal inliers, %d vertical inliers)",
-                              horizontal_report.support.num_inliers,
-                              vertical_report.support.num_inliers);
+  return axes;
+}
 
-    LOG(INFO) << "Composing coordinate axes...";
+Eigen::Matrix3d EstimateManhattanWorldFrame(
+    const ManhattanWorldFrameEstimationOptions& options,
+    const Reconstruction& reconstruction,
+    const std::string& image_path) {
+  const std::vector<image_t>& reg_image_ids = reconstruction.RegImageIds();
+
+  // The images are processed independently in parallel, while the results
+  // are collected in the order of the images, such that the resulting frame
+  // does not depend on the number of threads.
+  ThreadPool thread_pool(GetEffectiveNumThreads(options.num_threads));
+  std::vector<std::future<ImageManhattanAxes>> futures;
+  futures.reserve(reg_image_ids.size());
+  for (const image_t image_id : reg_image_ids) {
+    futures.push_back(thread_pool.AddTask([&, image_id]() {
+      return EstimateImageManhattanAxes(
+          options, reconstruction, image_path, image_id);
+    }));
+  }
 
-    const Eigen::Matrix3d inv_calib_matrix =
-        undistorted_camera.CalibrationMatrix().inverse();
-    const Eigen::Quaterniond world_from_cam_rotation =
-        image.CamFromWorld().rotation.inverse();
+  std::vector<Eigen::Vector3d> rightward_axes;
+  std::vector<Eigen::Vector3d> downward_axes;
+  for (size_t i = 0; i < reg_image_ids.size(); ++i) {
+    const ImageManhattanAxes axes = futures[i].get();
+
+    PrintHeading1(
+        StringPrintf("Processed image %s (%d / %d)",
+                     reconstruction.Image(reg_image_ids[i]).Name().c_str(),
+                     i + 1,
+                     reg_image_ids.size()));
+
+    LOG(INFO) << StringPrintf("Detected %d lines (%d horizontal, %d vertical)",
+                              axes.num_line_segments,
+                              axes.num_horizontal_lines,
+                              axes.num_vertical_lines);
+    LOG(INFO) << StringPrintf(" (%d horizontal inliers, %d vertical inliers)",
+                              axes.num_horizontal_inliers,
+                              axes.num_vertical_inliers);
 
-    if (horizontal_report.success) {
-      Eigen::Vector3d horizontal_axis_in_world =
-          world_from_cam_rotation *
-          (inv_calib_matrix * horizontal_report.model).normalized();
+    if (axes.has_horizontal_axis) {
+      Eigen::Vector3d horizontal_axis_in_world = axes.horizontal_axis;
       // Make sure all axes point into the same direction.
       if (rightward_axes.size() > 0 &&
           rightward_axes[0].dot(horizontal_axis_in_world) < 0) {
@@ -259,18 +312,9 @@ Eigen::Matrix3d EstimateManhattanWorldFrame(
       LOG(INFO) << "Horizontal: " << horizontal_axis_in_world.transpose();
     }
 
-    if (vertical_report.success) {
-      const Eigen::Vector3d vertical_axis_in_cam =
-          (inv_calib_matrix * vertical_report.model).normalized();
-      Eigen::Vector3d vertical_axis_in_world =
-          (world_from_cam_rotation * vertical_axis_in_cam).normalized();
-      // Make sure axis points downwards in the image, assuming that the image
-      // was taken in upright orientation.
-      if (vertical_axis_in_world.dot(Eigen::Vector3d(0, 1, 0)) < 0) {
-        vertical_axis_in_world = -vertical_axis_in_world;
-      }
-      downward_axes.push_back(vertical_axis_in_world);
-      LOG(INFO) << "Vertical: " << vertical_axis_in_world.transpose();
+    if (axes.has_vertical_axis) {
+      downward_axes.push_back(axes.vertical_axis);
+      LOG(INFO) << "Vertical: " << axes.vertical_axis.transpose();
     }
   }
 
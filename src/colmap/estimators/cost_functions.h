@@ -29,11 +29,16 @@
 
 #pragma once
 
+#include "colmap/geometry/pose.h"
 #include "colmap/geometry/rigid3.h"
 #include "colmap/sensor/models.h"
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/logging.h"
 
+#include <memory>
+#include <type_traits>
+#include <utility>
+
 #include <Eigen/Core>
 #include <ceres/ceres.h>
 #include <ceres/conditioned_cost_function.h>
@@ -182,6 +187,440 @@ class ReprojErrorConstantPoint3DCostFunction
   const double point3D_z_;
 };
 
+namespace internal {
+
+template <typename T,
+          int kNumResiduals,
+          int... Ns,
+          typename CostFunctor,
+          int... Is>
+bool EvaluateCostFunctorWithJets(const CostFunctor& functor,
+                                 double const* const* parameters,
+                                 double* residuals,
+                                 double** jacobians,
+                                 std::integer_sequence<int, Is...>) {
+  if (!functor(parameters[Is]..., residuals)) {
+    return false;
+  }
+
+  if (jacobians == nullptr) {
+    return true;
+  }
+
+  constexpr int kNumParameters =
+      ceres::SizedCostFunction<kNumResiduals,
+                               Ns...>::ParameterDims::kNumParameters;
+  typedef ceres::Jet<T, kNumParameters> JetT;
+
+  const int block_sizes[] = {Ns...};
+  int block_offsets[sizeof...(Ns)];
+  JetT jet_parameters[kNumParameters];
+  int offset = 0;
+  for (size_t i = 0; i < sizeof...(Ns); ++i) {
+    block_offsets[i] = offset;
+    for (int j = 0; j < block_sizes[i]; ++j) {
+      jet_parameters[offset] = JetT(static_cast<T>(parameters[i][j]), offset);
+      ++offset;
+    }
+  }
+
+  JetT jet_residuals[kNumResiduals];
+  if (!functor(jet_parameters + block_offsets[Is]..., jet_residuals)) {
+    return false;
+  }
+
+  for (size_t i = 0; i < sizeof...(Ns); ++i) {
+    if (jacobians[i] == nullptr) {
+      continue;
+    }
+    for (int r = 0; r < kNumResiduals; ++r) {
+      for (int j = 0; j < block_sizes[i]; ++j) {
+        jacobians[i][r * block_sizes[i] + j] =
+            jet_residuals[r].v[block_offsets[i] + j];
+      }
+    }
+  }
+
+  return true;
+}
+
+}  // namespace internal
+
+// Evaluate the residuals of the cost functor in double precision and, if
+// requested, its Jacobians in row-major order by forward-mode automatic
+// differentiation with Jets of scalar type T. Null Jacobian blocks are skipped.
+template <typename T, int kNumResiduals, int... Ns, typename CostFunctor>
+bool EvaluateCostFunctorWithJets(const CostFunctor& functor,
+                                 double const* const* parameters,
+                                 double* residuals,
+                                 double** jacobians) {
+  return internal::EvaluateCostFunctorWithJets<T, kNumResiduals, Ns...>(
+      functor,
+      parameters,
+      residuals,
+      jacobians,
+      std::make_integer_sequence<int, sizeof...(Ns)>());
+}
+
+// Automatically differentiated cost function, which evaluates the Jacobians
+// with single-precision instead of double-precision Jets, which halves the
+// memory and arithmetic cost of the derivative parts. The residuals are always
+// evaluated in double precision, such that the cost and the converged solution
+// are not affected by the reduced precision, which only perturbs the
+// Gauss-Newton steps. This is only suitable for well-scaled problems with
+// moderate coordinates, e.g., normalized reconstructions.
+template <typename CostFunctor, int kNumResiduals, int... Ns>
+class FloatJacobianAutoDiffCostFunction
+    : public ceres::SizedCostFunction<kNumResiduals, Ns...> {
+ public:
+  explicit FloatJacobianAutoDiffCostFunction(CostFunctor* functor)
+      : functor_(functor) {}
+
+  bool Evaluate(double const* const* parameters,
+                double* residuals,
+                double** jacobians) const override {
+    return EvaluateCostFunctorWithJets<float, kNumResiduals, Ns...>(
+        *functor_, parameters, residuals, jacobians);
+  }
+
+ private:
+  std::unique_ptr<CostFunctor> functor_;
+};
+
+// Variants of the standard bundle adjustment cost functions with
+// single-precision Jacobians, see `FloatJacobianAutoDiffCostFunction`.
+template <typename CameraModel>
+struct FloatJacobianReprojErrorCostFunction {
+  static ceres::CostFunction* Create(const Eigen::Vector2d& point2D) {
+    return new FloatJacobianAutoDiffCostFunction<
+        ReprojErrorCostFunction<CameraModel>,
+        2,
+        4,
+        3,
+        3,
+        CameraModel::num_params>(
+        new ReprojErrorCostFunction<CameraModel>(point2D));
+  }
+};
+
+template <typename CameraModel>
+struct FloatJacobianReprojErrorConstantPoseCostFunction {
+  static ceres::CostFunction* Create(const Rigid3d& cam_from_world,
+                                     const Eigen::Vector2d& point2D) {
+    return new FloatJacobianAutoDiffCostFunction<
+        ReprojErrorConstantPoseCostFunction<CameraModel>,
+        2,
+        3,
+        CameraModel::num_params>(
+        new ReprojErrorConstantPoseCostFunction<CameraModel>(cam_from_world,
+                                                             point2D));
+  }
+};
+
+// Projection of a point from camera to image coordinates together with the
+// analytic Jacobians w.r.t. the point in camera coordinates and the camera
+// parameters. Only specialized for camera models with hand-derived Jacobians,
+// see `AnalyticCameraCostFunction` for the fallback to automatic
+// differentiation. The Jacobians are stored in row-major order and
+// `J_params` may be null.
+template <typename CameraModel>
+struct AnalyticImgFromCam;
+
+template <>
+struct AnalyticImgFromCam<PinholeCameraModel> {
+  static void Evaluate(const double* params,
+                       const Eigen::Vector3d& uvw,
+                       Eigen::Vector2d* xy,
+                       Eigen::Matrix<double, 2, 3, Eigen::RowMajor>* J_uvw,
+                       double* J_params) {
+    const double f1 = params[0];
+    const double f2 = params[1];
+    const double inv_w = 1 / uvw.z();
+    const double u = uvw.x() * inv_w;
+    const double v = uvw.y() * inv_w;
+
+    xy->x() = f1 * u + params[2];
+    xy->y() = f2 * v + params[3];
+
+    *J_uvw << f1 * inv_w, 0, -f1 * u * inv_w, 0, f2 * inv_w, -f2 * v * inv_w;
+
+    if (J_params) {
+      Eigen::Map<Eigen::Matrix<double, 2, 4, Eigen::RowMajor>>(J_params)
+          << u, 0, 1, 0, 0, v, 0, 1;
+    }
+  }
+};
+
+// Shared implementation of the radial models with a single focal length, where
+// `radial` is the distortion factor and `d_radial_d_r2` its derivative w.r.t.
+// the squared radius.
+inline void AnalyticRadialImgFromCam(
+    const double* params,
+    const Eigen::Vector3d& uvw,
+    const double radial,
+    const double d_radial_d_r2,
+    Eigen::Vector2d* xy,
+    Eigen::Matrix<double, 2, 3, Eigen::RowMajor>* J_uvw) {
+  const double f = params[0];
+  const double inv_w = 1 / uvw.z();
+  const double u = uvw.x() * inv_w;
+  const double v = uvw.y() * inv_w;
+
+  xy->x() = f * u * radial + params[1];
+  xy->y() = f * v * radial + params[2];
+
+  // Jacobian of the distorted w.r.t. the normalized coordinates.
+  Eigen::Matrix2d J_uv;
+  J_uv << radial + 2 * u * u * d_radial_d_r2, 2 * u * v * d_radial_d_r2,
+      2 * u * v * d_radial_d_r2, radial + 2 * v * v * d_radial_d_r2;
+
+  Eigen::Matrix<double, 2, 3> J_normalize;
+  J_normalize << inv_w, 0, -u * inv_w, 0, inv_w, -v * inv_w;
+
+  *J_uvw = f * J_uv * J_normalize;
+}
+
+template <>
+struct AnalyticImgFromCam<SimpleRadialCameraModel> {
+  static void Evaluate(const double* params,
+                       const Eigen::Vector3d& uvw,
+                       Eigen::Vector2d* xy,
+                       Eigen::Matrix<double, 2, 3, Eigen::RowMajor>* J_uvw,
+                       double* J_params) {
+    const double k = params[3];
+    const double u = uvw.x() / uvw.z();
+    const double v = uvw.y() / uvw.z();
+    const double r2 = u * u + v * v;
+    AnalyticRadialImgFromCam(params, uvw, 1 + k * r2, k, xy, J_uvw);
+
+    if (J_params) {
+      const double f = params[0];
+      const double radial = 1 + k * r2;
+      Eigen::Map<Eigen::Matrix<double, 2, 4, Eigen::RowMajor>>(J_params)
+          << u * radial, 1, 0, f * u * r2, v * radial, 0, 1, f * v * r2;
+    }
+  }
+};
+
+template <>
+struct AnalyticImgFromCam<RadialCameraModel> {
+  static void Evaluate(const double* params,
+                       const Eigen::Vector3d& uvw,
+                       Eigen::Vector2d* xy,
+                       Eigen::Matrix<double, 2, 3, Eigen::RowMajor>* J_uvw,
+                       double* J_params) {
+    const double k1 = params[3];
+    const double k2 = params[4];
+    const double u = uvw.x() / uvw.z();
+    const double v = uvw.y() / uvw.z();
+    const double r2 = u * u + v * v;
+    const double radial = 1 + k1 * r2 + k2 * r2 * r2;
+    AnalyticRadialImgFromCam(params, uvw, radial, k1 + 2 * k2 * r2, xy, J_uvw);
+
+    if (J_params) {
+      const double f = params[0];
+      const double r4 = r2 * r2;
+      Eigen::Map<Eigen::Matrix<double, 2, 5, Eigen::RowMajor>>(J_params)
+          << u * radial, 1, 0, f * u * r2, f * u * r4, v * radial, 0, 1,
+          f * v * r2, f * v * r4;
+    }
+  }
+};
+
+template <>
+struct AnalyticImgFromCam<OpenCVCameraModel> {
+  static void Evaluate(const double* params,
+                       const Eigen::Vector3d& uvw,
+                       Eigen::Vector2d* xy,
+                       Eigen::Matrix<double, 2, 3, Eigen::RowMajor>* J_uvw,
+                       double* J_params) {
+    const double f1 = params[0];
+    const double f2 = params[1];
+    const double k1 = params[4];
+    const double k2 = params[5];
+    const double p1 = params[6];
+    const double p2 = params[7];
+
+    const double inv_w = 1 / uvw.z();
+    const double u = uvw.x() * inv_w;
+    const double v = uvw.y() * inv_w;
+    const double u2 = u * u;
+    const double uv = u * v;
+    const double v2 = v * v;
+    const double r2 = u2 + v2;
+    const double radial = 1 + k1 * r2 + k2 * r2 * r2;
+    const double d_radial_d_r2 = k1 + 2 * k2 * r2;
+
+    const double ud = u * radial + 2 * p1 * uv + p2 * (r2 + 2 * u2);
+    const double vd = v * radial + 2 * p2 * uv + p1 * (r2 + 2 * v2);
+    xy->x() = f1 * ud + params[2];
+    xy->y() = f2 * vd + params[3];
+
+    // Jacobian of the distorted w.r.t. the normalized coordinates.
+    const double d_ud_d_v = 2 * uv * d_radial_d_r2 + 2 * p1 * u + 2 * p2 * v;
+    Eigen::Matrix2d J_uv;
+    J_uv << radial + 2 * u2 * d_radial_d_r2 + 2 * p1 * v + 6 * p2 * u,
+        d_ud_d_v, d_ud_d_v,
+        radial + 2 * v2 * d_radial_d_r2 + 2 * p2 * u + 6 * p1 * v;
+
+    Eigen::Matrix<double, 2, 3> J_normalize;
+    J_normalize << inv_w, 0, -u * inv_w, 0, inv_w, -v * inv_w;
+
+    *J_uvw = Eigen::Vector2d(f1, f2).asDiagonal() * J_uv * J_normalize;
+
+    if (J_params) {
+      const double r4 = r2 * r2;
+      Eigen::Map<Eigen::Matrix<double, 2, 8, Eigen::RowMajor>>(J_params)
+          << ud, 0, 1, 0, f1 * u * r2, f1 * u * r4, f1 * 2 * uv,
+          f1 * (r2 + 2 * u2), 0, vd, 0, 1, f2 * v * r2, f2 * v * r4,
+          f2 * (r2 + 2 * v2), f2 * 2 * uv;
+    }
+  }
+};
+
+// Whether the camera model implements `AnalyticImgFromCam`.
+template <typename CameraModel>
+struct HasAnalyticImgFromCam : std::false_type {};
+template <>
+struct HasAnalyticImgFromCam<PinholeCameraModel> : std::true_type {};
+template <>
+struct HasAnalyticImgFromCam<SimpleRadialCameraModel> : std::true_type {};
+template <>
+struct HasAnalyticImgFromCam<RadialCameraModel> : std::true_type {};
+template <>
+struct HasAnalyticImgFromCam<OpenCVCameraModel> : std::true_type {};
+
+// Evaluate the reprojection error and its analytic Jacobians for the given
+// camera pose, point, and camera parameters. The Jacobian w.r.t. the rotation
+// is w.r.t. the four ambient coefficients of the quaternion in Eigen's
+// (x, y, z, w) order, as expected by `EigenQuaternionManifold`. Any of the
+// Jacobians may be null.
+template <typename CameraModel>
+inline void EvaluateAnalyticReprojError(
+    const double* cam_from_world_rotation,
+    const double* cam_from_world_translation,
+    const double* point3D,
+    const double* camera_params,
+    const Eigen::Vector2d& observed,
+    double* residuals,
+    double* J_rotation,
+    double* J_translation,
+    double* J_point3D,
+    double* J_params) {
+  // Rotate as in Eigen's quaternion-vector product, which is what the
+  // automatically differentiated cost functions as well as the derivatives
+  // below are based on: R * x = x + w * t + q_xyz x t with t = 2 * q_xyz x x.
+  const Eigen::Map<const Eigen::Vector3d> q_xyz(cam_from_world_rotation);
+  const double q_w = cam_from_world_rotation[3];
+  const Eigen::Map<const Eigen::Vector3d> point(point3D);
+  const Eigen::Vector3d t = 2 * q_xyz.cross(point);
+  const Eigen::Vector3d point3D_in_cam =
+      point + q_w * t + q_xyz.cross(t) +
+      Eigen::Map<const Eigen::Vector3d>(cam_from_world_translation);
+
+  Eigen::Vector2d xy;
+  Eigen::Matrix<double, 2, 3, Eigen::RowMajor> J_uvw;
+  AnalyticImgFromCam<CameraModel>::Evaluate(
+      camera_params, point3D_in_cam, &xy, &J_uvw, J_params);
+  residuals[0] = xy.x() - observed.x();
+  residuals[1] = xy.y() - observed.y();
+
+  if (J_translation) {
+    Eigen::Map<Eigen::Matrix<double, 2, 3, Eigen::RowMajor>> J(J_translation);
+    J = J_uvw;
+  }
+
+  if (J_rotation || J_point3D) {
+    const Eigen::Matrix3d q_xyz_cross = CrossProductMatrix(q_xyz);
+    if (J_rotation) {
+      const Eigen::Matrix3d point_cross = CrossProductMatrix(point);
+      Eigen::Map<Eigen::Matrix<double, 2, 4, Eigen::RowMajor>> J(J_rotation);
+      J.leftCols<3>() =
+          J_uvw * (-2 * q_w * point_cross - CrossProductMatrix(t) -
+                   2 * q_xyz_cross * point_cross);
+      J.col(3) = J_uvw * t;
+    }
+    if (J_point3D) {
+      Eigen::Map<Eigen::Matrix<double, 2, 3, Eigen::RowMajor>> J(J_point3D);
+      J = J_uvw * (Eigen::Matrix3d::Identity() + 2 * q_w * q_xyz_cross +
+                   2 * q_xyz_cross * q_xyz_cross);
+    }
+  }
+}
+
+// Standard bundle adjustment cost function for variable camera pose,
+// calibration, and point parameters with analytic instead of automatically
+// differentiated Jacobians.
+template <typename CameraModel>
+class AnalyticReprojErrorCostFunction
+    : public ceres::SizedCostFunction<2, 4, 3, 3, CameraModel::num_params> {
+ public:
+  explicit AnalyticReprojErrorCostFunction(const Eigen::Vector2d& point2D)
+      : observed_(point2D) {}
+
+  static ceres::CostFunction* Create(const Eigen::Vector2d& point2D) {
+    return new AnalyticReprojErrorCostFunction(point2D);
+  }
+
+  bool Evaluate(double const* const* parameters,
+                double* residuals,
+                double** jacobians) const override {
+    EvaluateAnalyticReprojError<CameraModel>(
+        parameters[0],
+        parameters[1],
+        parameters[2],
+        parameters[3],
+        observed_,
+        residuals,
+        jacobians ? jacobians[0] : nullptr,
+        jacobians ? jacobians[1] : nullptr,
+        jacobians ? jacobians[2] : nullptr,
+        jacobians ? jacobians[3] : nullptr);
+    return true;
+  }
+
+ private:
+  const Eigen::Vector2d observed_;
+};
+
+// Bundle adjustment cost function for variable camera calibration and point
+// parameters, and fixed camera pose with analytic Jacobians.
+template <typename CameraModel>
+class AnalyticReprojErrorConstantPoseCostFunction
+    : public ceres::SizedCostFunction<2, 3, CameraModel::num_params> {
+ public:
+  AnalyticReprojErrorConstantPoseCostFunction(const Rigid3d& cam_from_world,
+                                              const Eigen::Vector2d& point2D)
+      : cam_from_world_(cam_from_world), observed_(point2D) {}
+
+  static ceres::CostFunction* Create(const Rigid3d& cam_from_world,
+                                     const Eigen::Vector2d& point2D) {
+    return new AnalyticReprojErrorConstantPoseCostFunction(cam_from_world,
+                                                           point2D);
+  }
+
+  bool Evaluate(double const* const* parameters,
+                double* residuals,
+                double** jacobians) const override {
+    EvaluateAnalyticReprojError<CameraModel>(
+        cam_from_world_.rotation.coeffs().data(),
+        cam_from_world_.translation.data(),
+        parameters[0],
+        parameters[1],
+        observed_,
+        residuals,
+        nullptr,
+        nullptr,
+        jacobians ? jacobians[0] : nullptr,
+        jacobians ? jacobians[1] : nullptr);
+    return true;
+  }
+
+ private:
+  const Rigid3d& cam_from_world_;
+  const Eigen::Vector2d observed_;
+};
+
 // Rig bundle adjustment cost function for variable camera pose and calibration
 // and point parameters. Different from the standard bundle adjustment function,
 // this cost function is suitable for camera rigs with consistent relative poses
@@ -493,6 +932,45 @@ struct Point3dAlignmentCostFunction {
   const Eigen::Matrix3d sqrt_information_point_;
 };
 
+// Cost function for the pairwise direction constraint of two projection
+// centers in global positioning, where the direction is the unit vector
+// from the second to the first projection center. The residual is the
+// difference between the direction and the scaled baseline, as proposed in:
+//
+//    "Baseline Desensitizing In Translation Averaging".
+//    Bingbing Zhuang, Loong-Fah Cheong, Gim Hee Lee. CVPR 2018.
+//
+// The per-pair scale should be constrained to be non-negative.
+struct PairwiseDirectionErrorCostFunction {
+ public:
+  explicit PairwiseDirectionErrorCostFunction(const Eigen::Vector3d& direction)
+      : direction_(direction) {}
+
+  static ceres::CostFunction* Create(const Eigen::Vector3d& direction) {
+    return (new ceres::AutoDiffCostFunction<PairwiseDirectionErrorCostFunction,
+                                            3,
+                                            3,
+                                            3,
+                                            1>(
+        new PairwiseDirectionErrorCostFunction(direction)));
+  }
+
+  template <typename T>
+  bool operator()(const T* const proj_center1,
+                  const T* const proj_center2,
+                  const T* const scale,
+                  T* residuals_ptr) const {
+    Eigen::Map<Eigen::Matrix<T, 3, 1>> residuals(residuals_ptr);
+    residuals = direction_.cast<T>() -
+                scale[0] * (EigenVector3Map<T>(proj_center1) -
+                            EigenVector3Map<T>(proj_center2));
+    return true;
+  }
+
+ private:
+  const Eigen::Vector3d direction_;
+};
+
 // A cost function that wraps another one and whiten its residuals with an
 // isotropic covariance, i.e. assuming that the variance is identical in and
 // independent between each dimension of the residual.
@@ -556,4 +1034,32 @@ ceres::CostFunction* CameraCostFunction(const CameraModelId camera_model_id,
   }
 }
 
+// Create the cost function with analytic Jacobians for the camera models that
+// implement `AnalyticImgFromCam` and fall back to the automatically
+// differentiated cost function for all other models.
+template <template <typename> class AnalyticCostFunction,
+          template <typename>
+          class CostFunction,
+          typename... Args>
+ceres::CostFunction* AnalyticCameraCostFunction(
+    const CameraModelId camera_model_id, Args&&... args) {
+  switch (camera_model_id) {
+#define ANALYTIC_CAMERA_MODEL_CASE(CameraModel)                     \
+  case CameraModel::model_id:                                       \
+    return AnalyticCostFunction<CameraModel>::Create(               \
+        std::forward<Args>(args)...);
+
+    ANALYTIC_CAMERA_MODEL_CASE(PinholeCameraModel)
+    ANALYTIC_CAMERA_MODEL_CASE(SimpleRadialCameraModel)
+    ANALYTIC_CAMERA_MODEL_CASE(RadialCameraModel)
+    ANALYTIC_CAMERA_MODEL_CASE(OpenCVCameraModel)
+
+#undef ANALYTIC_CAMERA_MODEL_CASE
+
+    default:
+      return CameraCostFunction<CostFunction>(camera_model_id,
+                                              std::forward<Args>(args)...);
+  }
+}
+
 }  // namespace colmap
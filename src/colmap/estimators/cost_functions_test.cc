@@ -163,6 +163,221 @@ TEST(BundleAdjustment, ConstantPoint3DAbsolutePose) {
   }
 }
 
+template <typename CameraModel>
+void ExpectEqualAnalyticAndAutoDiffJacobians(
+    const std::vector<double>& camera_params) {
+  ASSERT_EQ(camera_params.size(), CameraModel::num_params);
+  const Eigen::Vector2d point2D(300, 200);
+  const Rigid3d cam_from_world(
+      Eigen::Quaterniond(
+          Eigen::AngleAxisd(0.3, Eigen::Vector3d(0.2, 1, -0.4).normalized())),
+      Eigen::Vector3d(0.1, -0.2, 3));
+  const Eigen::Vector3d point3D(0.3, 0.4, 1.5);
+
+  const double* parameters[4] = {cam_from_world.rotation.coeffs().data(),
+                                 cam_from_world.translation.data(),
+                                 point3D.data(),
+                                 camera_params.data()};
+  const int block_sizes[4] = {4, 3, 3, CameraModel::num_params};
+
+  const auto evaluate = [&](const ceres::CostFunction& cost_function,
+                            const double* const* parameters,
+                            const int* block_sizes,
+                            const int num_blocks,
+                            Eigen::Vector2d* residuals,
+                            std::vector<std::vector<double>>* jacobians) {
+    std::vector<double*> jacobian_ptrs(num_blocks);
+    jacobians->resize(num_blocks);
+    for (int i = 0; i < num_blocks; ++i) {
+      (*jacobians)[i].resize(2 * block_sizes[i]);
+      jacobian_ptrs[i] = (*jacobians)[i].data();
+    }
+    EXPECT_TRUE(cost_function.Evaluate(
+        parameters, residuals->data(), jacobian_ptrs.data()));
+  };
+
+  const auto expect_near = [](const Eigen::Vector2d& residuals1,
+                              const std::vector<std::vector<double>>& J1,
+                              const Eigen::Vector2d& residuals2,
+                              const std::vector<std::vector<double>>& J2) {
+    EXPECT_NEAR(residuals1(0), residuals2(0), 1e-9);
+    EXPECT_NEAR(residuals1(1), residuals2(1), 1e-9);
+    ASSERT_EQ(J1.size(), J2.size());
+    for (size_t i = 0; i < J1.size(); ++i) {
+      ASSERT_EQ(J1[i].size(), J2[i].size());
+      for (size_t j = 0; j < J1[i].size(); ++j) {
+        EXPECT_NEAR(
+            J1[i][j], J2[i][j], 1e-6 * std::max(1.0, std::abs(J2[i][j])));
+      }
+    }
+  };
+
+  Eigen::Vector2d residuals;
+  Eigen::Vector2d analytic_residuals;
+  std::vector<std::vector<double>> jacobians;
+  std::vector<std::vector<double>> analytic_jacobians;
+
+  std::unique_ptr<ceres::CostFunction> cost_function(
+      ReprojErrorCostFunction<CameraModel>::Create(point2D));
+  std::unique_ptr<ceres::CostFunction> analytic_cost_function(
+      AnalyticReprojErrorCostFunction<CameraModel>::Create(point2D));
+  evaluate(*cost_function, parameters, block_sizes, 4, &residuals, &jacobians);
+  evaluate(*analytic_cost_function,
+           parameters,
+           block_sizes,
+           4,
+           &analytic_residuals,
+           &analytic_jacobians);
+  expect_near(analytic_residuals, analytic_jacobians, residuals, jacobians);
+
+  std::unique_ptr<ceres::CostFunction> constant_pose_cost_function(
+      ReprojErrorConstantPoseCostFunction<CameraModel>::Create(cam_from_world,
+                                                               point2D));
+  std::unique_ptr<ceres::CostFunction> analytic_constant_pose_cost_function(
+      AnalyticReprojErrorConstantPoseCostFunction<CameraModel>::Create(
+          cam_from_world, point2D));
+  evaluate(*constant_pose_cost_function,
+           parameters + 2,
+           block_sizes + 2,
+           2,
+           &residuals,
+           &jacobians);
+  evaluate(*analytic_constant_pose_cost_function,
+           parameters + 2,
+           block_sizes + 2,
+           2,
+           &analytic_residuals,
+           &analytic_jacobians);
+  expect_near(analytic_residuals, analytic_jacobians, residuals, jacobians);
+
+  EXPECT_TRUE(
+      analytic_cost_function->Evaluate(parameters, residuals.data(), nullptr));
+  EXPECT_NEAR(residuals(0), analytic_residuals(0), 1e-9);
+  EXPECT_NEAR(residuals(1), analytic_residuals(1), 1e-9);
+}
+
+TEST(BundleAdjustment, AnalyticJacobians) {
+  ExpectEqualAnalyticAndAutoDiffJacobians<PinholeCameraModel>(
+      {500, 520, 320, 240});
+  ExpectEqualAnalyticAndAutoDiffJacobians<SimpleRadialCameraModel>(
+      {500, 320, 240, 0.1});
+  ExpectEqualAnalyticAndAutoDiffJacobians<RadialCameraModel>(
+      {500, 320, 240, 0.1, -0.05});
+  ExpectEqualAnalyticAndAutoDiffJacobians<OpenCVCameraModel>(
+      {500, 520, 320, 240, 0.1, -0.05, 0.01, -0.02});
+}
+
+TEST(BundleAdjustment, AnalyticCameraCostFunction) {
+  std::unique_ptr<ceres::CostFunction> cost_function(
+      AnalyticCameraCostFunction<AnalyticReprojErrorCostFunction,
+                                 ReprojErrorCostFunction>(
+          SimpleRadialCameraModel::model_id, Eigen::Vector2d::Zero()));
+  EXPECT_NE(dynamic_cast<
+                AnalyticReprojErrorCostFunction<SimpleRadialCameraModel>*>(
+                cost_function.get()),
+            nullptr);
+  cost_function.reset(
+      AnalyticCameraCostFunction<AnalyticReprojErrorCostFunction,
+                                 ReprojErrorCostFunction>(
+          FOVCameraModel::model_id, Eigen::Vector2d::Zero()));
+  EXPECT_NE(cost_function, nullptr);
+  EXPECT_EQ(cost_function->num_residuals(), 2);
+}
+
+template <typename CameraModel>
+void ExpectNearFloatAndDoubleJacobians(
+    const std::vector<double>& camera_params) {
+  ASSERT_EQ(camera_params.size(), CameraModel::num_params);
+  const Eigen::Vector2d point2D(300, 200);
+  const Rigid3d cam_from_world(
+      Eigen::Quaterniond(
+          Eigen::AngleAxisd(0.3, Eigen::Vector3d(0.2, 1, -0.4).normalized())),
+      Eigen::Vector3d(0.1, -0.2, 3));
+  const Eigen::Vector3d point3D(0.3, 0.4, 1.5);
+
+  const double* parameters[4] = {cam_from_world.rotation.coeffs().data(),
+                                 cam_from_world.translation.data(),
+                                 point3D.data(),
+                                 camera_params.data()};
+  const int block_sizes[4] = {4, 3, 3, CameraModel::num_params};
+
+  const auto expect_near = [&](const ceres::CostFunction& cost_function,
+                               const ceres::CostFunction& float_cost_function,
+                               const int first_block,
+                               const int num_blocks) {
+    std::vector<std::vector<double>> jacobians(num_blocks);
+    std::vector<std::vector<double>> float_jacobians(num_blocks);
+    std::vector<double*> jacobian_ptrs(num_blocks);
+    std::vector<double*> float_jacobian_ptrs(num_blocks);
+    for (int i = 0; i < num_blocks; ++i) {
+      jacobians[i].resize(2 * block_sizes[first_block + i]);
+      float_jacobians[i].resize(2 * block_sizes[first_block + i]);
+      jacobian_ptrs[i] = jacobians[i].data();
+      float_jacobian_ptrs[i] = float_jacobians[i].data();
+    }
+    // Only request the last Jacobian block to test skipping of null blocks.
+    float_jacobian_ptrs[0] = nullptr;
+
+    Eigen::Vector2d residuals;
+    Eigen::Vector2d float_residuals;
+    EXPECT_TRUE(cost_function.Evaluate(parameters + first_block,
+                                       residuals.data(),
+                                       jacobian_ptrs.data()));
+    EXPECT_TRUE(float_cost_function.Evaluate(parameters + first_block,
+                                             float_residuals.data(),
+                                             float_jacobian_ptrs.data()));
+    EXPECT_NEAR(residuals(0), float_residuals(0), 1e-9);
+    EXPECT_NEAR(residuals(1), float_residuals(1), 1e-9);
+    for (int i = 1; i < num_blocks; ++i) {
+      for (size_t j = 0; j < jacobians[i].size(); ++j) {
+        EXPECT_NEAR(jacobians[i][j],
+                    float_jacobians[i][j],
+                    1e-4 * std::max(1.0, std::abs(jacobians[i][j])));
+      }
+    }
+
+    float_jacobian_ptrs[0] = float_jacobians[0].data();
+    EXPECT_TRUE(float_cost_function.Evaluate(parameters + first_block,
+                                             float_residuals.data(),
+                                             float_jacobian_ptrs.data()));
+    for (size_t j = 0; j < jacobians[0].size(); ++j) {
+      EXPECT_NEAR(jacobians[0][j],
+                  float_jacobians[0][j],
+                  1e-4 * std::max(1.0, std::abs(jacobians[0][j])));
+    }
+
+    EXPECT_TRUE(float_cost_function.Evaluate(
+        parameters + first_block, float_residuals.data(), nullptr));
+    EXPECT_NEAR(residuals(0), float_residuals(0), 1e-9);
+    EXPECT_NEAR(residuals(1), float_residuals(1), 1e-9);
+  };
+
+  std::unique_ptr<ceres::CostFunction> cost_function(
+      ReprojErrorCostFunction<CameraModel>::Create(point2D));
+  std::unique_ptr<ceres::CostFunction> float_cost_function(
+      FloatJacobianReprojErrorCostFunction<CameraModel>::Create(point2D));
+  expect_near(*cost_function, *float_cost_function, 0, 4);
+
+  std::unique_ptr<ceres::CostFunction> constant_pose_cost_function(
+      ReprojErrorConstantPoseCostFunction<CameraModel>::Create(cam_from_world,
+                                                               point2D));
+  std::unique_ptr<ceres::CostFunction> float_constant_pose_cost_function(
+      FloatJacobianReprojErrorConstantPoseCostFunction<CameraModel>::Create(
+          cam_from_world, point2D));
+  expect_near(
+      *constant_pose_cost_function, *float_constant_pose_cost_function, 2, 2);
+}
+
+TEST(BundleAdjustment, FloatJacobians) {
+  ExpectNearFloatAndDoubleJacobians<SimplePinholeCameraModel>({500, 320, 240});
+  ExpectNearFloatAndDoubleJacobians<SimpleRadialCameraModel>(
+      {500, 320, 240, 0.1});
+  ExpectNearFloatAndDoubleJacobians<OpenCVCameraModel>(
+      {500, 520, 320, 240, 0.1, -0.05, 0.01, -0.02});
+  ExpectNearFloatAndDoubleJacobians<FullOpenCVCameraModel>(
+      {500, 520, 320, 240, 0.1, -0.05, 0.01, -0.02, 0.01, 0, 0, 0});
+}
+
 TEST(BundleAdjustment, Rig) {
   std::unique_ptr<ceres::CostFunction> cost_function(
       RigReprojErrorCostFunction<SimplePinholeCameraModel>::Create(
@@ -388,5 +603,26 @@ TEST(PoseGraphOptimization, Point3dAlignment) {
   EXPECT_NEAR(residuals[2], error[2] / 2.0, 1e-6);
 }
 
+TEST(PairwiseDirectionErrorCostFunction, Nominal) {
+  std::unique_ptr<ceres::CostFunction> cost_function(
+      PairwiseDirectionErrorCostFunction::Create(Eigen::Vector3d(0, 0, 1)));
+  Eigen::Vector3d proj_center1(1, 2, 5);
+  Eigen::Vector3d proj_center2(1, 2, 3);
+  double scale = 0.5;
+  const double* parameters[3] = {
+      proj_center1.data(), proj_center2.data(), &scale};
+  double residuals[3];
+  EXPECT_TRUE(cost_function->Evaluate(parameters, residuals, nullptr));
+  EXPECT_EQ(residuals[0], 0);
+  EXPECT_EQ(residuals[1], 0);
+  EXPECT_EQ(residuals[2], 0);
+
+  proj_center1 = Eigen::Vector3d(2, 2, 3);
+  EXPECT_TRUE(cost_function->Evaluate(parameters, residuals, nullptr));
+  EXPECT_EQ(residuals[0], -0.5);
+  EXPECT_EQ(residuals[1], 0);
+  EXPECT_EQ(residuals[2], 1);
+}
+
 }  // namespace
 }  // namespace colmap
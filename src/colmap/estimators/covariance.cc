@@ -30,6 +30,7 @@
 #include "colmap/estimators/covariance.h"
 
 #include "colmap/estimators/manifold.h"
+#include "colmap/util/threading.h"
 
 #include <ceres/crs_matrix.h>
 
@@ -483,13 +484,38 @@ bool BundleAdjustmentCovarianceEstimator::HasValidPoseFactorization() const {
   return L_matrix_poses_inv_.size() != 0;
 }
 
+bool BundleAdjustmentCovarianceEstimator::HasValidPoseMarginals() const {
+  return !pose_marginals_.empty();
+}
+
 double BundleAdjustmentCovarianceEstimator::GetPoseCovarianceByIndex(
     int row, int col) const {
-  THROW_CHECK(HasValidPoseCovariance() || HasValidPoseFactorization());
+  THROW_CHECK(HasValidPoseCovariance() || HasValidPoseFactorization() ||
+              HasValidPoseMarginals());
   if (HasValidPoseCovariance())
     return cov_poses_(row, col);
-  else
+  else if (HasValidPoseFactorization())
     return L_matrix_poses_inv_.col(row).dot(L_matrix_poses_inv_.col(col));
+  else
+    return GetPoseMarginalBlock(row, col, 1, 1)(0, 0);
+}
+
+Eigen::MatrixXd BundleAdjustmentCovarianceEstimator::GetPoseMarginalBlock(
+    int row_start,
+    int col_start,
+    int row_block_size,
+    int col_block_size) const {
+  THROW_CHECK(HasValidPoseMarginals());
+  auto it = pose_marginals_.upper_bound(std::min(row_start, col_start));
+  THROW_CHECK(it != pose_marginals_.begin());
+  --it;
+  const int row_offset = row_start - it->first;
+  const int col_offset = col_start - it->first;
+  THROW_CHECK(row_offset + row_block_size <= it->second.rows() &&
+              col_offset + col_block_size <= it->second.cols())
+      << "Only the diagonal blocks of the pose covariance were computed";
+  return it->second.block(
+      row_offset, col_offset, row_block_size, col_block_size);
 }
 
 Eigen::MatrixXd
@@ -498,11 +524,16 @@ BundleAdjustmentCovarianceEstimator::GetPoseCovarianceBlockOperation(
     int col_start,
     int row_block_size,
     int col_block_size) const {
-  THROW_CHECK(HasValidPoseCovariance() || HasValidPoseFactorization());
+  THROW_CHECK(HasValidPoseCovariance() || HasValidPoseFactorization() ||
+              HasValidPoseMarginals());
   if (HasValidPoseCovariance()) {
     return cov_poses_.block(
         row_start, col_start, row_block_size, col_block_size);
   }
+  if (!HasValidPoseFactorization()) {
+    return GetPoseMarginalBlock(
+        row_start, col_start, row_block_size, col_block_size);
+  }
   // HasValidPoseRefactorization() == true
   Eigen::MatrixXd output(row_block_size, col_block_size);
   for (int row = 0; row < row_block_size; ++row) {
@@ -623,7 +654,8 @@ bool BundleAdjustmentCovarianceEstimator::ComputeFull() {
   return true;
 }
 
-bool BundleAdjustmentCovarianceEstimator::Factorize() {
+bool BundleAdjustmentCovarianceEstimator::FactorizePoseSchurComplement(
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>>* ldltOfS_poses) {
   if (!HasValidSchurComplement()) {
     ComputeSchurComplement();
   }
@@ -652,10 +684,10 @@ bool BundleAdjustmentCovarianceEstimator::Factorize() {
   // Compute pose covariance
   LOG(INFO) << StringPrintf("Start sparse Cholesky decomposition (n = %d)",
                             num_params_poses_);
-  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> ldltOfS_poses(S_poses);
+  ldltOfS_poses->compute(S_poses);
   int rank = 0;
   for (int i = 0; i < S_poses.rows(); ++i) {
-    if (ldltOfS_poses.vectorD().coeff(i) != 0.0) rank++;
+    if (ldltOfS_poses->vectorD().coeff(i) != 0.0) rank++;
   }
   if (rank < S_poses.rows()) {
     LOG(INFO) << StringPrintf(
@@ -667,6 +699,14 @@ bool BundleAdjustmentCovarianceEstimator::Factorize() {
     return false;
   }
   LOG(INFO) << "Finish sparse Cholesky decomposition.";
+  return true;
+}
+
+bool BundleAdjustmentCovarianceEstimator::Factorize() {
+  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> ldltOfS_poses;
+  if (!FactorizePoseSchurComplement(&ldltOfS_poses)) {
+    return false;
+  }
   // construct the inverse of the L_matrix
   Eigen::SparseMatrix<double> L_poses = ldltOfS_poses.matrixL();
   for (int i = 0; i < L_poses.rows(); ++i) {
@@ -685,54 +725,109 @@ bool BundleAdjustmentCovarianceEstimator::Factorize() {
 }
 
 bool BundleAdjustmentCovarianceEstimator::Compute() {
-  if (!HasValidSchurComplement()) {
-    ComputeSchurComplement();
+  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> ldltOfS_poses;
+  if (!FactorizePoseSchurComplement(&ldltOfS_poses)) {
+    return false;
   }
+  Eigen::SparseMatrix<double> I(ldltOfS_poses.rows(), ldltOfS_poses.cols());
+  I.setIdentity();
+  Eigen::SparseMatrix<double> S_poses_inv = ldltOfS_poses.solve(I);
+  cov_poses_ = S_poses_inv;  // convert to dense matrix
+  return true;
+}
 
-  // Schur elimination on other variables
-  LOG(INFO) << StringPrintf("Schur elimination on other variables (n = %d)",
-                            num_params_other_variables_);
-  Eigen::SparseMatrix<double> S_aa =
-      S_matrix_.block(0, 0, num_params_poses_, num_params_poses_);
-  Eigen::SparseMatrix<double> S_ab = S_matrix_.block(
-      0, num_params_poses_, num_params_poses_, num_params_other_variables_);
-  Eigen::SparseMatrix<double> S_ba = S_ab.transpose();
-  Eigen::SparseMatrix<double> S_bb =
-      S_matrix_.block(num_params_poses_,
-                      num_params_poses_,
-                      num_params_other_variables_,
-                      num_params_other_variables_);
-  for (int i = 0; i < S_bb.rows(); ++i) {
-    if (S_bb.coeff(i, i) == 0.0)
-      S_bb.coeffRef(i, i) = lambda_;
-    else
-      S_bb.coeffRef(i, i) += lambda_;
+bool BundleAdjustmentCovarianceEstimator::ComputeMarginals(
+    const int num_threads, const double max_memory_mb) {
+  THROW_CHECK_GT(max_memory_mb, 0);
+
+  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> ldltOfS_poses;
+  if (!FactorizePoseSchurComplement(&ldltOfS_poses)) {
+    return false;
   }
-  Eigen::SimplicialLLT<Eigen::SparseMatrix<double>> lltOfS_bb(S_bb);
-  Eigen::SparseMatrix<double> S_poses = S_aa - S_ab * lltOfS_bb.solve(S_ba);
 
-  // Compute pose covariance
-  LOG(INFO) << StringPrintf("Start sparse Cholesky decomposition (n = %d)",
-                            num_params_poses_);
-  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> ldltOfS_poses(S_poses);
-  int rank = 0;
-  for (int i = 0; i < S_poses.rows(); ++i) {
-    if (ldltOfS_poses.vectorD().coeff(i) != 0.0) rank++;
+  // Group the pose blocks into the diagonal blocks to compute, i.e., the
+  // rotation and translation of each image jointly and all other pose blocks
+  // individually. Maps the first row of each block to its size.
+  std::map<int, int> marginal_blocks;
+  std::set<const double*> grouped_blocks;
+  if (HasReconstruction()) {
+    for (const auto& image : reconstruction_->Images()) {
+      if (!HasPose(image.first)) continue;
+      const double* qvec = image.second.CamFromWorld().rotation.coeffs().data();
+      const double* tvec = image.second.CamFromWorld().translation.data();
+      if (GetBlockIndex(qvec) + GetBlockTangentSize(qvec) !=
+          GetBlockIndex(tvec)) {
+        continue;
+      }
+      marginal_blocks.emplace(GetPoseIndex(image.first),
+                              GetPoseTangentSize(image.first));
+      grouped_blocks.insert(qvec);
+      grouped_blocks.insert(tvec);
+    }
   }
-  if (rank < S_poses.rows()) {
-    LOG(INFO) << StringPrintf(
-        "Unable to compute covariance. The Schur complement on pose parameters "
-        "is rank deficient. Number of columns: %d, rank: %d. This is likely "
-        "due to the poses being underconstrained with Gauge ambiguity.",
-        S_poses.rows(),
-        rank);
-    return false;
+  for (const double* block : pose_blocks_) {
+    if (grouped_blocks.count(block) == 0) {
+      marginal_blocks.emplace(GetBlockIndex(block), GetBlockTangentSize(block));
+    }
   }
-  LOG(INFO) << "Finish sparse Cholesky decomposition.";
-  Eigen::SparseMatrix<double> I(S_poses.rows(), S_poses.cols());
-  I.setIdentity();
-  Eigen::SparseMatrix<double> S_poses_inv = ldltOfS_poses.solve(I);
-  cov_poses_ = S_poses_inv;  // convert to dense matrix
+
+  // Solve for the columns of the diagonal blocks in batches, such that the
+  // dense right-hand sides and solutions of all threads fit into the budget.
+  const int num_eff_threads = GetEffectiveNumThreads(num_threads);
+  const int num_rows = ldltOfS_poses.rows();
+  const size_t max_num_cols = std::max<size_t>(
+      1,
+      static_cast<size_t>(max_memory_mb * 1024 * 1024) /
+          (2 * sizeof(double) * std::max(num_rows, 1) * num_eff_threads));
+
+  pose_marginals_.clear();
+  std::vector<std::vector<std::map<int, int>::const_iterator>> batches;
+  size_t num_batch_cols = 0;
+  for (auto it = marginal_blocks.cbegin(); it != marginal_blocks.cend(); ++it) {
+    if (batches.empty() || num_batch_cols + it->second > max_num_cols) {
+      batches.emplace_back();
+      num_batch_cols = 0;
+    }
+    batches.back().push_back(it);
+    num_batch_cols += it->second;
+    // Allocate the blocks upfront, so that the threads only write to them.
+    pose_marginals_.emplace(it->first,
+                            Eigen::MatrixXd(it->second, it->second));
+  }
+
+  LOG(INFO) << StringPrintf(
+      "Computing %d diagonal blocks of the pose covariance in %d batches",
+      static_cast<int>(marginal_blocks.size()),
+      static_cast<int>(batches.size()));
+
+  auto SolveBatch =
+      [&](const std::vector<std::map<int, int>::const_iterator>& batch) {
+        int num_cols = 0;
+        for (const auto& block : batch) {
+          num_cols += block->second;
+        }
+        Eigen::MatrixXd rhs = Eigen::MatrixXd::Zero(num_rows, num_cols);
+        int col = 0;
+        for (const auto& block : batch) {
+          rhs.block(block->first, col, block->second, block->second)
+              .setIdentity();
+          col += block->second;
+        }
+        const Eigen::MatrixXd cols = ldltOfS_poses.solve(rhs);
+        col = 0;
+        for (const auto& block : batch) {
+          pose_marginals_.at(block->first) =
+              cols.block(block->first, col, block->second, block->second);
+          col += block->second;
+        }
+      };
+
+  ThreadPool thread_pool(std::min<int>(num_eff_threads, batches.size()));
+  for (const auto& batch : batches) {
+    thread_pool.AddTask(SolveBatch, batch);
+  }
+  thread_pool.Wait();
+
   return true;
 }
 
@@ -769,4 +864,23 @@ bool EstimatePoseCovariance(
   return true;
 }
 
+bool EstimatePoseMarginalCovariance(
+    ceres::Problem* problem,
+    Reconstruction* reconstruction,
+    std::map<image_t, Eigen::MatrixXd>& image_id_to_covar,
+    double lambda,
+    int num_threads,
+    double max_memory_mb) {
+  BundleAdjustmentCovarianceEstimator estimator(
+      problem, reconstruction, lambda);
+  if (!estimator.ComputeMarginals(num_threads, max_memory_mb)) return false;
+  image_id_to_covar.clear();
+  for (const auto& image : reconstruction->Images()) {
+    image_t image_id = image.first;
+    if (!estimator.HasPose(image_id)) continue;
+    image_id_to_covar.emplace(image_id, estimator.GetPoseCovariance(image_id));
+  }
+  return true;
+}
+
 }  // namespace colmap
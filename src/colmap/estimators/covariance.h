@@ -189,6 +189,19 @@ class BundleAdjustmentCovarianceEstimator
   bool ComputeFull() override;
   bool Compute() override;
 
+  // Compute only the diagonal blocks of the pose covariance, i.e., the
+  // marginal covariances of the image poses (or of the individual pose
+  // blocks). Instead of inverting the Schur complement of the poses, the
+  // columns of the blocks are solved with its sparse factorization in parallel
+  // batches. Afterwards, only the diagonal blocks can be queried, which makes
+  // this suitable for large reconstructions.
+  //
+  // @param num_threads     Number of threads for the column solves.
+  // @param max_memory_mb   Maximum memory in megabytes used by the dense
+  //                        columns that are solved concurrently.
+  bool ComputeMarginals(int num_threads = -1, double max_memory_mb = 1024);
+  bool HasValidPoseMarginals() const;
+
   // factorization
   bool FactorizeFull();
   bool Factorize();
@@ -222,9 +235,23 @@ class BundleAdjustmentCovarianceEstimator
   void ComputeSchurComplement();
   bool HasValidSchurComplement() const;
 
+  // Factorize the Schur complement for poses after Schur elimination on other
+  // variables. Returns false if it is rank deficient.
+  bool FactorizePoseSchurComplement(
+      Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>>* ldltOfS_poses);
+
+  // Lookup of the diagonal blocks computed by `ComputeMarginals`.
+  Eigen::MatrixXd GetPoseMarginalBlock(int row_start,
+                                       int col_start,
+                                       int row_block_size,
+                                       int col_block_size) const;
+
   // The inverse of L matrix after Cholesky factorization
   Eigen::MatrixXd L_matrix_variables_inv_;
   Eigen::MatrixXd L_matrix_poses_inv_;
+
+  // The diagonal blocks of the pose covariance indexed by their first row
+  std::map<int, Eigen::MatrixXd> pose_marginals_;
 };
 
 // The covariance for each image is in the order [R, t] with both of them
@@ -245,4 +272,15 @@ bool EstimatePoseCovariance(
     std::map<image_t, Eigen::MatrixXd>& image_id_to_covar,
     double lambda = 1e-8);
 
+// Similar to ``EstimatePoseCovariance`` but only computes the covariance for
+// each image and not between images, which is much faster and requires much
+// less memory for large reconstructions.
+bool EstimatePoseMarginalCovariance(
+    ceres::Problem* problem,
+    Reconstruction* reconstruction,
+    std::map<image_t, Eigen::MatrixXd>& image_id_to_covar,
+    double lambda = 1e-8,
+    int num_threads = -1,
+    double max_memory_mb = 1024);
+
 }  // namespace colmap
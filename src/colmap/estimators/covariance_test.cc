@@ -186,6 +186,47 @@ TEST(Covariance, ComputeFull) {
   ExpectNearEigenMatrixXd(covar, covar_ceres, 1e-6);
 }
 
+TEST(Covariance, ComputeMarginals) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(&reconstruction);
+  std::shared_ptr<BundleAdjuster> bundle_adjuster =
+      BuildBundleAdjuster(&reconstruction);
+  bundle_adjuster->Solve(&reconstruction);
+  std::shared_ptr<ceres::Problem> problem = bundle_adjuster->Problem();
+
+  BundleAdjustmentCovarianceEstimator estimator(problem.get(), &reconstruction);
+  ASSERT_TRUE(estimator.Compute());
+
+  // A tiny memory budget solves every diagonal block in a separate batch.
+  for (const double max_memory_mb : {1e-6, 1024.0}) {
+    BundleAdjustmentCovarianceEstimator marginals_estimator(problem.get(),
+                                                            &reconstruction);
+    ASSERT_TRUE(marginals_estimator.ComputeMarginals(
+        /*num_threads=*/2, max_memory_mb));
+    EXPECT_TRUE(marginals_estimator.HasValidPoseMarginals());
+    EXPECT_FALSE(marginals_estimator.HasValidPoseCovariance());
+    for (const auto& image : reconstruction.Images()) {
+      if (!estimator.HasPose(image.first)) continue;
+      ExpectNearEigenMatrixXd(
+          marginals_estimator.GetPoseCovariance(image.first),
+          estimator.GetPoseCovariance(image.first),
+          1e-6);
+    }
+  }
+
+  std::map<image_t, Eigen::MatrixXd> image_id_to_covar;
+  ASSERT_TRUE(EstimatePoseCovariance(
+      problem.get(), &reconstruction, image_id_to_covar));
+  std::map<image_t, Eigen::MatrixXd> image_id_to_marginal_covar;
+  ASSERT_TRUE(EstimatePoseMarginalCovariance(
+      problem.get(), &reconstruction, image_id_to_marginal_covar));
+  ASSERT_EQ(image_id_to_marginal_covar.size(), image_id_to_covar.size());
+  for (const auto& covar : image_id_to_covar) {
+    ExpectNearEigenMatrixXd(
+        image_id_to_marginal_covar.at(covar.first), covar.second, 1e-6);
+  }
+}
+
 TEST(Covariance, RankDeficientPoints) {
   Reconstruction reconstruction;
   GenerateReconstruction(&reconstruction);
@@ -53,21 +53,26 @@ void EssentialMatrixFivePointEstimator::Estimate(
 
   models->clear();
 
-  // Setup system of equations: [points2(i,:), 1]' * E * [points1(i,:), 1]'.
-
-  Eigen::Matrix<double, Eigen::Dynamic, 9> Q(points1.size(), 9);
-  for (size_t i = 0; i < points1.size(); ++i) {
-    Q.row(i) << points2[i].x() * points1[i].transpose().homogeneous(),
-        points2[i].y() * points1[i].transpose().homogeneous(),
-        points1[i].transpose().homogeneous();
-  }
-
-  // Step 1: Extraction of the nullspace.
+  // Setup system of equations: [points2(i,:), 1]' * E * [points1(i,:), 1]'
+  // and extract its nullspace (step 1). The minimal case, which is solved
+  // for every RANSAC sample, uses fixed-size matrices to avoid allocations.
 
   Eigen::Matrix<double, 9, 4> E;
   if (points1.size() == 5) {
-    E = Q.transpose().fullPivHouseholderQr().matrixQ().rightCols<4>();
+    Eigen::Matrix<double, 9, 5> Qt;
+    for (size_t i = 0; i < 5; ++i) {
+      Qt.col(i) << points2[i].x() * points1[i].homogeneous(),
+          points2[i].y() * points1[i].homogeneous(), points1[i].homogeneous();
+    }
+    const Eigen::Matrix<double, 9, 9> Q = Qt.fullPivHouseholderQr().matrixQ();
+    E = Q.rightCols<4>();
   } else {
+    Eigen::Matrix<double, Eigen::Dynamic, 9> Q(points1.size(), 9);
+    for (size_t i = 0; i < points1.size(); ++i) {
+      Q.row(i) << points2[i].x() * points1[i].transpose().homogeneous(),
+          points2[i].y() * points1[i].transpose().homogeneous(),
+          points1[i].transpose().homogeneous();
+    }
     const Eigen::JacobiSVD<Eigen::Matrix<double, Eigen::Dynamic, 9>> svd(
         Q, Eigen::ComputeFullV);
     E = svd.matrixV().rightCols<4>();
@@ -100,22 +105,13 @@ void EssentialMatrixFivePointEstimator::Estimate(
   Eigen::Matrix<double, 11, 1> coeffs;
 #include "colmap/estimators/essential_matrix_coeffs.h"
 
-  Eigen::VectorXd roots_real;
-  Eigen::VectorXd roots_imag;
-  if (!FindPolynomialRootsCompanionMatrix(coeffs, &roots_real, &roots_imag)) {
-    return;
-  }
+  Eigen::Matrix<double, 10, 1> roots;
+  const int num_roots = FindRealPolynomialRootsSturm<10>(coeffs, &roots);
 
-  const int num_roots = roots_real.size();
   models->reserve(num_roots);
 
   for (int i = 0; i < num_roots; ++i) {
-    const double kMaxRootImag = 1e-10;
-    if (std::abs(roots_imag(i)) > kMaxRootImag) {
-      continue;
-    }
-
-    const double z1 = roots_real(i);
+    const double z1 = roots(i);
     const double z2 = z1 * z1;
     const double z3 = z2 * z1;
     const double z4 = z3 * z1;
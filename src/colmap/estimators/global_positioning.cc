@@ -0,0 +1,194 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/estimators/global_positioning.h"
+
+#include "colmap/estimators/cost_functions.h"
+#include "colmap/math/random.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/threading.h"
+
+#include <algorithm>
+#include <memory>
+#include <queue>
+
+namespace colmap {
+
+bool GlobalPositioningOptions::Check() const {
+  CHECK_OPTION_GT(loss_function_scale, 0);
+  return true;
+}
+
+bool EstimateGlobalPositions(
+    const GlobalPositioningOptions& options,
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const std::vector<Eigen::Vector3d>& cams2_from_cams1_translation,
+    const std::unordered_map<image_t, Eigen::Quaterniond>& cams_from_world,
+    std::unordered_map<image_t, Eigen::Vector3d>* proj_centers) {
+  THROW_CHECK(options.Check());
+  THROW_CHECK_EQ(image_pairs.size(), cams2_from_cams1_translation.size());
+  THROW_CHECK_NOTNULL(proj_centers);
+
+  proj_centers->clear();
+
+  // Compute the directions between the projection centers. For the
+  // translation t of cam2_from_cam1, it holds that
+  // R2^T * t = proj_center1 - proj_center2.
+  std::vector<size_t> pair_idxs;
+  std::vector<Eigen::Vector3d> directions;
+  std::unordered_map<image_t, std::vector<image_t>> adjacency;
+  for (size_t i = 0; i < image_pairs.size(); ++i) {
+    const image_t image_id1 = image_pairs[i].first;
+    const image_t image_id2 = image_pairs[i].second;
+    if (cams_from_world.count(image_id1) == 0) {
+      continue;
+    }
+    const auto cam2_from_world = cams_from_world.find(image_id2);
+    if (cam2_from_world == cams_from_world.end()) {
+      continue;
+    }
+    const double norm = cams2_from_cams1_translation[i].norm();
+    if (norm == 0) {
+      continue;
+    }
+    pair_idxs.push_back(i);
+    directions.push_back(cam2_from_world->second.inverse() *
+                         cams2_from_cams1_translation[i] / norm);
+    adjacency[image_id1].push_back(image_id2);
+    adjacency[image_id2].push_back(image_id1);
+  }
+
+  if (pair_idxs.empty()) {
+    return false;
+  }
+
+  // Find the largest connected component of the remaining view graph.
+  std::unordered_map<image_t, int> image_id_to_component;
+  image_id_to_component.reserve(adjacency.size());
+  std::vector<int> component_sizes;
+  for (const auto& image : adjacency) {
+    if (image_id_to_component.count(image.first) > 0) {
+      continue;
+    }
+    const int component = component_sizes.size();
+    component_sizes.push_back(1);
+    image_id_to_component.emplace(image.first, component);
+    std::queue<image_t> queue;
+    queue.push(image.first);
+    while (!queue.empty()) {
+      const image_t image_id = queue.front();
+      queue.pop();
+      for (const image_t other_image_id : adjacency.at(image_id)) {
+        if (image_id_to_component.emplace(other_image_id, component).second) {
+          component_sizes[component] += 1;
+          queue.push(other_image_id);
+        }
+      }
+    }
+  }
+  const int largest_component =
+      std::max_element(component_sizes.begin(), component_sizes.end()) -
+      component_sizes.begin();
+
+  if (options.random_seed >= 0) {
+    SetPRNGSeed(options.random_seed);
+  }
+
+  // Initialize the projection centers randomly, since the problem has a wide
+  // basin of convergence.
+  proj_centers->reserve(component_sizes[largest_component]);
+  for (const auto& image : image_id_to_component) {
+    if (image.second == largest_component) {
+      proj_centers->emplace(image.first,
+                            Eigen::Vector3d(RandomUniformReal(-100.0, 100.0),
+                                            RandomUniformReal(-100.0, 100.0),
+                                            RandomUniformReal(-100.0, 100.0)));
+    }
+  }
+
+  ceres::Problem::Options problem_options;
+  problem_options.loss_function_ownership = ceres::DO_NOT_TAKE_OWNERSHIP;
+  ceres::Problem problem(problem_options);
+  std::unique_ptr<ceres::LossFunction> loss_function =
+      std::make_unique<ceres::HuberLoss>(options.loss_function_scale);
+
+  std::vector<double> scales(pair_idxs.size(), 1.0);
+  for (size_t i = 0; i < pair_idxs.size(); ++i) {
+    const auto& image_pair = image_pairs[pair_idxs[i]];
+    if (image_id_to_component.at(image_pair.first) != largest_component) {
+      continue;
+    }
+    problem.AddResidualBlock(
+        PairwiseDirectionErrorCostFunction::Create(directions[i]),
+        loss_function.get(),
+        proj_centers->at(image_pair.first).data(),
+        proj_centers->at(image_pair.second).data(),
+        &scales[i]);
+    problem.SetParameterLowerBound(&scales[i], 0, 0);
+  }
+
+  // Fix the translational gauge. The scale of the solution is implicitly
+  // fixed by the unit norm of the directions, which retains the random scale
+  // of the initialization.
+  problem.SetParameterBlockConstant(proj_centers->begin()->second.data());
+
+  ceres::Solver::Options solver_options = options.solver_options;
+  if (solver_options.sparse_linear_algebra_library_type != ceres::NO_SPARSE) {
+    solver_options.linear_solver_type = ceres::SPARSE_SCHUR;
+  } else {
+    solver_options.linear_solver_type = ceres::ITERATIVE_SCHUR;
+    solver_options.preconditioner_type = ceres::SCHUR_JACOBI;
+  }
+  solver_options.num_threads =
+      GetEffectiveNumThreads(solver_options.num_threads);
+#if CERES_VERSION_MAJOR < 2
+  solver_options.num_linear_solver_threads = solver_options.num_threads;
+#endif  // CERES_VERSION_MAJOR
+
+  std::string solver_error;
+  THROW_CHECK(solver_options.IsValid(&solver_error)) << solver_error;
+
+  ceres::Solver::Summary summary;
+  ceres::Solve(solver_options, &problem, &summary);
+
+  if (solver_options.minimizer_progress_to_stdout) {
+    LOG(INFO) << summary.FullReport();
+  }
+
+  if (!summary.IsSolutionUsable()) {
+    LOG(WARNING) << "Failed to estimate global positions";
+    proj_centers->clear();
+    return false;
+  }
+
+  return true;
+}
+
+}  // namespace colmap
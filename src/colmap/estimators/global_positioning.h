@@ -0,0 +1,84 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/util/eigen_alignment.h"
+#include "colmap/util/types.h"
+
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Geometry>
+#include <ceres/ceres.h>
+
+namespace colmap {
+
+struct GlobalPositioningOptions {
+  // Scale of the Huber loss on the pairwise direction residuals.
+  double loss_function_scale = 0.1;
+
+  // Seed of the random initialization of the projection centers. If negative,
+  // the initialization is non-deterministic.
+  int random_seed = -1;
+
+  // Ceres-Solver options.
+  ceres::Solver::Options solver_options;
+
+  GlobalPositioningOptions() {
+    solver_options.function_tolerance = 1e-5;
+    solver_options.logging_type = ceres::LoggingType::SILENT;
+    solver_options.max_num_iterations = 200;
+    solver_options.num_threads = -1;
+  }
+
+  bool Check() const;
+};
+
+// Estimate the projection centers of images from the pairwise translation
+// directions given known absolute rotations. The translation of the i-th
+// image pair is the translation of cam2_from_cam1 and only its direction is
+// used. The problem is solved from a random initialization by minimizing the
+// difference between the measured directions and the scaled baselines:
+//
+//    "Baseline Desensitizing In Translation Averaging".
+//    Bingbing Zhuang, Loong-Fah Cheong, Gim Hee Lee. CVPR 2018.
+//
+// Pairs with images without rotation or with zero translation are ignored and
+// positions are only estimated for the largest connected component of the
+// remaining pairs. The positions are recovered up to a similarity transform.
+bool EstimateGlobalPositions(
+    const GlobalPositioningOptions& options,
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const std::vector<Eigen::Vector3d>& cams2_from_cams1_translation,
+    const std::unordered_map<image_t, Eigen::Quaterniond>& cams_from_world,
+    std::unordered_map<image_t, Eigen::Vector3d>* proj_centers);
+
+}  // namespace colmap
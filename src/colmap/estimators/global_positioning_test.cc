@@ -0,0 +1,131 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/estimators/global_positioning.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+void GenerateImagePairs(
+    const int num_images,
+    std::unordered_map<image_t, Eigen::Quaterniond>* cams_from_world,
+    std::vector<Eigen::Vector3d>* gt_proj_centers,
+    std::vector<std::pair<image_t, image_t>>* image_pairs,
+    std::vector<Eigen::Vector3d>* cams2_from_cams1_translation) {
+  for (int i = 0; i < num_images; ++i) {
+    cams_from_world->emplace(i + 1, Eigen::Quaterniond::UnitRandom());
+    gt_proj_centers->push_back(Eigen::Vector3d::Random());
+  }
+  for (int i = 0; i < num_images; ++i) {
+    for (int j = i + 1; j < num_images; ++j) {
+      image_pairs->emplace_back(i + 1, j + 1);
+      // The translation of cam2_from_cam1 is R2 * (proj_center1 -
+      // proj_center2) with an arbitrary scale.
+      cams2_from_cams1_translation->push_back(
+          (i + 1.0) * (cams_from_world->at(j + 1) *
+                       ((*gt_proj_centers)[i] - (*gt_proj_centers)[j])));
+    }
+  }
+}
+
+void ExpectEqualDirections(
+    const std::vector<Eigen::Vector3d>& gt_proj_centers,
+    const std::unordered_map<image_t, Eigen::Vector3d>& proj_centers) {
+  ASSERT_EQ(proj_centers.size(), gt_proj_centers.size());
+  for (size_t i = 0; i < gt_proj_centers.size(); ++i) {
+    for (size_t j = i + 1; j < gt_proj_centers.size(); ++j) {
+      const Eigen::Vector3d gt_direction =
+          (gt_proj_centers[i] - gt_proj_centers[j]).normalized();
+      const Eigen::Vector3d direction =
+          (proj_centers.at(i + 1) - proj_centers.at(j + 1)).normalized();
+      EXPECT_LT((gt_direction - direction).norm(), 1e-3);
+    }
+  }
+}
+
+TEST(EstimateGlobalPositions, Nominal) {
+  std::unordered_map<image_t, Eigen::Quaterniond> cams_from_world;
+  std::vector<Eigen::Vector3d> gt_proj_centers;
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<Eigen::Vector3d> cams2_from_cams1_translation;
+  GenerateImagePairs(10,
+                     &cams_from_world,
+                     &gt_proj_centers,
+                     &image_pairs,
+                     &cams2_from_cams1_translation);
+
+  GlobalPositioningOptions options;
+  options.random_seed = 0;
+  std::unordered_map<image_t, Eigen::Vector3d> proj_centers;
+  EXPECT_TRUE(EstimateGlobalPositions(options,
+                                      image_pairs,
+                                      cams2_from_cams1_translation,
+                                      cams_from_world,
+                                      &proj_centers));
+  ExpectEqualDirections(gt_proj_centers, proj_centers);
+}
+
+TEST(EstimateGlobalPositions, MissingRotation) {
+  std::unordered_map<image_t, Eigen::Quaterniond> cams_from_world;
+  std::vector<Eigen::Vector3d> gt_proj_centers;
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<Eigen::Vector3d> cams2_from_cams1_translation;
+  GenerateImagePairs(10,
+                     &cams_from_world,
+                     &gt_proj_centers,
+                     &image_pairs,
+                     &cams2_from_cams1_translation);
+
+  cams_from_world.erase(10);
+  gt_proj_centers.pop_back();
+
+  GlobalPositioningOptions options;
+  options.random_seed = 0;
+  std::unordered_map<image_t, Eigen::Vector3d> proj_centers;
+  EXPECT_TRUE(EstimateGlobalPositions(options,
+                                      image_pairs,
+                                      cams2_from_cams1_translation,
+                                      cams_from_world,
+                                      &proj_centers));
+  EXPECT_EQ(proj_centers.count(10), 0);
+  ExpectEqualDirections(gt_proj_centers, proj_centers);
+}
+
+TEST(EstimateGlobalPositions, Empty) {
+  std::unordered_map<image_t, Eigen::Vector3d> proj_centers;
+  EXPECT_FALSE(EstimateGlobalPositions(
+      GlobalPositioningOptions(), {}, {}, {}, &proj_centers));
+  EXPECT_TRUE(proj_centers.empty());
+}
+
+}  // namespace
+}  // namespace colmap
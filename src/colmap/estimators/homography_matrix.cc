@@ -50,20 +50,26 @@ void HomographyMatrixEstimator::Estimate(const std::vector<X_t>& points1,
   const size_t num_points = points1.size();
 
   // Setup constraint matrix.
-  Eigen::Matrix<double, Eigen::Dynamic, 9> A(2 * num_points, 9);
-  for (size_t i = 0; i < num_points; ++i) {
-    A.block<1, 3>(2 * i, 0) = points1[i].transpose().homogeneous();
-    A.block<1, 3>(2 * i, 3).setZero();
-    A.block<1, 3>(2 * i, 6) =
-        -points2[i].x() * points1[i].transpose().homogeneous();
-    A.block<1, 3>(2 * i + 1, 0).setZero();
-    A.block<1, 3>(2 * i + 1, 3) = points1[i].transpose().homogeneous();
-    A.block<1, 3>(2 * i + 1, 6) =
-        -points2[i].y() * points1[i].transpose().homogeneous();
-  }
+  const auto fill_constraints = [&](auto* A) {
+    for (size_t i = 0; i < num_points; ++i) {
+      A->template block<1, 3>(2 * i, 0) = points1[i].transpose().homogeneous();
+      A->template block<1, 3>(2 * i, 3).setZero();
+      A->template block<1, 3>(2 * i, 6) =
+          -points2[i].x() * points1[i].transpose().homogeneous();
+      A->template block<1, 3>(2 * i + 1, 0).setZero();
+      A->template block<1, 3>(2 * i + 1, 3) =
+          points1[i].transpose().homogeneous();
+      A->template block<1, 3>(2 * i + 1, 6) =
+          -points2[i].y() * points1[i].transpose().homogeneous();
+    }
+  };
 
   Eigen::Matrix3d H;
   if (num_points == 4) {
+    // The minimal case, which is solved for every RANSAC sample, uses a
+    // fixed-size matrix to avoid allocations.
+    Eigen::Matrix<double, 8, 9> A;
+    fill_constraints(&A);
     const Eigen::Matrix<double, 9, 1> h = A.block<8, 8>(0, 0)
                                               .partialPivLu()
                                               .solve(-A.block<8, 1>(0, 8))
@@ -73,6 +79,8 @@ void HomographyMatrixEstimator::Estimate(const std::vector<X_t>& points1,
     }
     H = Eigen::Map<const Eigen::Matrix3d>(h.data()).transpose();
   } else {
+    Eigen::Matrix<double, Eigen::Dynamic, 9> A(2 * num_points, 9);
+    fill_constraints(&A);
     // Solve for the nullspace of the constraint matrix.
     Eigen::JacobiSVD<Eigen::Matrix<double, Eigen::Dynamic, 9>> svd(
         A, Eigen::ComputeFullV);
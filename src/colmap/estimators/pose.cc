@@ -37,6 +37,7 @@
 #include "colmap/geometry/essential_matrix.h"
 #include "colmap/geometry/pose.h"
 #include "colmap/math/matrix.h"
+#include "colmap/optim/progressive_sampler.h"
 #include "colmap/sensor/models.h"
 #include "colmap/util/logging.h"
 #include "colmap/util/threading.h"
@@ -51,6 +52,7 @@ void EstimateAbsolutePoseKernel(const Camera& camera,
                                 const std::vector<Eigen::Vector2d>& points2D,
                                 const std::vector<Eigen::Vector3d>& points3D,
                                 const RANSACOptions& options,
+                                const bool use_prosac,
                                 AbsolutePoseRANSAC::Report* report) {
   // Scale the focal length by the given factor.
   Camera scaled_camera = camera;
@@ -68,8 +70,23 @@ void EstimateAbsolutePoseKernel(const Camera& camera,
   auto custom_options = options;
   custom_options.max_error =
       scaled_camera.CamFromImgThreshold(options.max_error);
-  AbsolutePoseRANSAC ransac(custom_options);
-  *report = ransac.Estimate(points2D_in_cam, points3D);
+  if (!use_prosac) {
+    AbsolutePoseRANSAC ransac(custom_options);
+    *report = ransac.Estimate(points2D_in_cam, points3D);
+    return;
+  }
+
+  LORANSAC<P3PEstimator,
+           EPNPEstimator,
+           InlierSupportMeasurer,
+           ProgressiveSampler>
+      prosac(custom_options);
+  auto prosac_report = prosac.Estimate(points2D_in_cam, points3D);
+  report->success = prosac_report.success;
+  report->num_trials = prosac_report.num_trials;
+  report->support = prosac_report.support;
+  report->inlier_mask = std::move(prosac_report.inlier_mask);
+  report->model = prosac_report.model;
 }
 
 }  // namespace
@@ -120,6 +137,7 @@ bool EstimateAbsolutePose(const AbsolutePoseEstimationOptions& options,
                                      points2D,
                                      points3D,
                                      options.ransac_options,
+                                     options.use_prosac,
                                      &reports[i]);
   }
 
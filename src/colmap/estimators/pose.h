@@ -63,6 +63,10 @@ struct AbsolutePoseEstimationOptions {
   // Number of threads for parallel estimation of focal length.
   int num_threads = ThreadPool::kMaxNumThreads;
 
+  // Whether to sample the correspondences progressively (PROSAC) instead of
+  // uniformly in RANSAC, assuming they are sorted by decreasing quality.
+  bool use_prosac = false;
+
   // Options used for P3P RANSAC.
   RANSACOptions ransac_options;
 
@@ -0,0 +1,282 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/estimators/rotation_averaging.h"
+
+#include "colmap/math/math.h"
+#include "colmap/util/logging.h"
+
+#include <algorithm>
+#include <numeric>
+#include <queue>
+
+#include <Eigen/Sparse>
+
+namespace colmap {
+namespace {
+
+int FindRoot(std::vector<int>* parents, int idx) {
+  while ((*parents)[idx] != idx) {
+    (*parents)[idx] = (*parents)[(*parents)[idx]];
+    idx = (*parents)[idx];
+  }
+  return idx;
+}
+
+// Tangent space error of the relative rotation given the absolute rotations,
+// such that cam1_from_world * exp(error) = cam2_from_cam1^-1 * cam2_from_world.
+Eigen::Vector3d RelativeRotationError(
+    const Eigen::Quaterniond& cam1_from_world,
+    const Eigen::Quaterniond& cam2_from_world,
+    const Eigen::Quaterniond& cam2_from_cam1) {
+  const Eigen::AngleAxisd error(cam1_from_world.inverse() *
+                                cam2_from_cam1.inverse() * cam2_from_world);
+  return error.angle() * error.axis();
+}
+
+}  // namespace
+
+bool RotationAveragingOptions::Check() const {
+  CHECK_OPTION_GT(max_num_iterations, 0);
+  CHECK_OPTION_GE(max_update_deg, 0);
+  CHECK_OPTION_GT(loss_scale_deg, 0);
+  return true;
+}
+
+bool EstimateGlobalRotations(
+    const RotationAveragingOptions& options,
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const std::vector<Eigen::Quaterniond>& cams2_from_cams1,
+    const std::vector<double>& weights,
+    std::unordered_map<image_t, Eigen::Quaterniond>* cams_from_world) {
+  THROW_CHECK(options.Check());
+  THROW_CHECK_EQ(image_pairs.size(), cams2_from_cams1.size());
+  THROW_CHECK_EQ(image_pairs.size(), weights.size());
+  THROW_CHECK_NOTNULL(cams_from_world);
+
+  cams_from_world->clear();
+
+  if (image_pairs.empty()) {
+    return false;
+  }
+
+  // Map the image identifiers to consecutive indices.
+  std::unordered_map<image_t, int> image_id_to_idx;
+  std::vector<image_t> image_ids;
+  std::vector<std::pair<int, int>> edges;
+  edges.reserve(image_pairs.size());
+  for (size_t i = 0; i < image_pairs.size(); ++i) {
+    THROW_CHECK_GT(weights[i], 0);
+    THROW_CHECK_NE(image_pairs[i].first, image_pairs[i].second);
+    int idxs[2];
+    for (int k = 0; k < 2; ++k) {
+      const image_t image_id =
+          k == 0 ? image_pairs[i].first : image_pairs[i].second;
+      const auto it = image_id_to_idx.emplace(image_id, image_ids.size());
+      if (it.second) {
+        image_ids.push_back(image_id);
+      }
+      idxs[k] = it.first->second;
+    }
+    edges.emplace_back(idxs[0], idxs[1]);
+  }
+
+  const int num_images = image_ids.size();
+
+  // Compute the maximum spanning tree using Kruskal's algorithm.
+  std::vector<size_t> sorted_edge_idxs(edges.size());
+  std::iota(sorted_edge_idxs.begin(), sorted_edge_idxs.end(), 0);
+  std::sort(sorted_edge_idxs.begin(),
+            sorted_edge_idxs.end(),
+            [&weights](const size_t edge_idx1, const size_t edge_idx2) {
+              return weights[edge_idx1] > weights[edge_idx2];
+            });
+
+  std::vector<int> parents(num_images);
+  std::iota(parents.begin(), parents.end(), 0);
+  std::vector<std::vector<size_t>> tree_edge_idxs(num_images);
+  for (const size_t edge_idx : sorted_edge_idxs) {
+    const int root1 = FindRoot(&parents, edges[edge_idx].first);
+    const int root2 = FindRoot(&parents, edges[edge_idx].second);
+    if (root1 != root2) {
+      parents[root2] = root1;
+      tree_edge_idxs[edges[edge_idx].first].push_back(edge_idx);
+      tree_edge_idxs[edges[edge_idx].second].push_back(edge_idx);
+    }
+  }
+
+  // Select the largest connected component and its most connected image.
+  std::vector<int> component_sizes(num_images, 0);
+  for (int idx = 0; idx < num_images; ++idx) {
+    component_sizes[FindRoot(&parents, idx)] += 1;
+  }
+  const int component_root =
+      std::max_element(component_sizes.begin(), component_sizes.end()) -
+      component_sizes.begin();
+  int gauge_idx = -1;
+  for (int idx = 0; idx < num_images; ++idx) {
+    if (FindRoot(&parents, idx) == component_root &&
+        (gauge_idx == -1 ||
+         tree_edge_idxs[idx].size() > tree_edge_idxs[gauge_idx].size())) {
+      gauge_idx = idx;
+    }
+  }
+
+  // Initialize the rotations by chaining the relative rotations along the
+  // spanning tree. The images of the component are enumerated in traversal
+  // order, such that the gauge image has the first index.
+  std::vector<Eigen::Quaterniond> rotations(num_images);
+  std::vector<int> component_idxs(num_images, -1);
+  std::vector<int> component_image_idxs;
+  component_image_idxs.reserve(component_sizes[component_root]);
+  std::queue<int> queue;
+  rotations[gauge_idx] = Eigen::Quaterniond::Identity();
+  component_idxs[gauge_idx] = 0;
+  component_image_idxs.push_back(gauge_idx);
+  queue.push(gauge_idx);
+  while (!queue.empty()) {
+    const int idx = queue.front();
+    queue.pop();
+    for (const size_t edge_idx : tree_edge_idxs[idx]) {
+      const auto& edge = edges[edge_idx];
+      const int other_idx = edge.first == idx ? edge.second : edge.first;
+      if (component_idxs[other_idx] != -1) {
+        continue;
+      }
+      if (edge.first == idx) {
+        rotations[other_idx] = cams2_from_cams1[edge_idx] * rotations[idx];
+      } else {
+        rotations[other_idx] =
+            cams2_from_cams1[edge_idx].inverse() * rotations[idx];
+      }
+      rotations[other_idx].normalize();
+      component_idxs[other_idx] = component_image_idxs.size();
+      component_image_idxs.push_back(other_idx);
+      queue.push(other_idx);
+    }
+  }
+
+  const int num_component_images = component_image_idxs.size();
+
+  std::vector<size_t> component_edge_idxs;
+  for (size_t edge_idx = 0; edge_idx < edges.size(); ++edge_idx) {
+    if (component_idxs[edges[edge_idx].first] != -1) {
+      component_edge_idxs.push_back(edge_idx);
+    }
+  }
+
+  // Refine the rotations using iteratively reweighted least-squares. In each
+  // iteration, the rotations are updated as R_i * exp(w_i) and the updates
+  // minimize sum_ij weight_ij * |w_i - w_j - error_ij|^2, where error_ij is
+  // the current error of the relative rotation and weight_ij is given by the
+  // pair weight and the robust loss. The gauge image is kept fixed, so the
+  // linear system only contains the other images.
+  const double loss_scale = DegToRad(options.loss_scale_deg);
+  const double max_update = DegToRad(options.max_update_deg);
+  const int num_variables = num_component_images - 1;
+  if (num_variables > 0) {
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> solver;
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(4 * component_edge_idxs.size());
+    Eigen::SparseMatrix<double> lhs(num_variables, num_variables);
+    Eigen::MatrixX3d rhs(num_variables, 3);
+
+    for (int iteration = 0; iteration < options.max_num_iterations;
+         ++iteration) {
+      triplets.clear();
+      rhs.setZero();
+      for (const size_t edge_idx : component_edge_idxs) {
+        const int idx1 = component_idxs[edges[edge_idx].first] - 1;
+        const int idx2 = component_idxs[edges[edge_idx].second] - 1;
+        const Eigen::Vector3d error =
+            RelativeRotationError(rotations[edges[edge_idx].first],
+                                  rotations[edges[edge_idx].second],
+                                  cams2_from_cams1[edge_idx]);
+        const double loss_weight =
+            loss_scale * loss_scale /
+            (loss_scale * loss_scale + error.squaredNorm());
+        const double weight = weights[edge_idx] * loss_weight * loss_weight;
+        if (idx1 >= 0) {
+          triplets.emplace_back(idx1, idx1, weight);
+          rhs.row(idx1) += weight * error.transpose();
+        }
+        if (idx2 >= 0) {
+          triplets.emplace_back(idx2, idx2, weight);
+          rhs.row(idx2) -= weight * error.transpose();
+        }
+        if (idx1 >= 0 && idx2 >= 0) {
+          triplets.emplace_back(idx1, idx2, -weight);
+          triplets.emplace_back(idx2, idx1, -weight);
+        }
+      }
+
+      lhs.setFromTriplets(triplets.begin(), triplets.end());
+      if (iteration == 0) {
+        solver.analyzePattern(lhs);
+      }
+      solver.factorize(lhs);
+      if (solver.info() != Eigen::Success) {
+        LOG(WARNING) << "Failed to solve rotation averaging system";
+        return false;
+      }
+
+      const Eigen::MatrixX3d updates = solver.solve(rhs);
+
+      double max_update_norm = 0;
+      for (int i = 0; i < num_variables; ++i) {
+        const Eigen::Vector3d update = updates.row(i).transpose();
+        const double update_norm = update.norm();
+        max_update_norm = std::max(max_update_norm, update_norm);
+        if (update_norm > 0) {
+          Eigen::Quaterniond& rotation = rotations[component_image_idxs[i + 1]];
+          rotation = rotation * Eigen::Quaterniond(Eigen::AngleAxisd(
+                                    update_norm, update / update_norm));
+          rotation.normalize();
+        }
+      }
+
+      VLOG(2) << "Rotation averaging iteration " << iteration
+              << ", max. update: " << RadToDeg(max_update_norm) << " deg";
+
+      if (max_update_norm < max_update) {
+        break;
+      }
+    }
+  }
+
+  cams_from_world->reserve(num_component_images);
+  for (const int idx : component_image_idxs) {
+    cams_from_world->emplace(image_ids[idx], rotations[idx]);
+  }
+
+  return true;
+}
+
+}  // namespace colmap
@@ -0,0 +1,79 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/util/eigen_alignment.h"
+#include "colmap/util/types.h"
+
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+namespace colmap {
+
+struct RotationAveragingOptions {
+  // Maximum number of iteratively reweighted least-squares iterations.
+  int max_num_iterations = 100;
+
+  // Stop once the largest rotation update of any image is below this
+  // threshold in degrees.
+  double max_update_deg = 1e-3;
+
+  // Scale of the robust Geman-McClure loss on the rotation residuals in
+  // degrees. Relative rotations with residuals far above the scale have
+  // effectively no influence on the solution.
+  double loss_scale_deg = 5.0;
+
+  bool Check() const;
+};
+
+// Robustly estimate the absolute rotations of images from pairwise relative
+// rotations, where the relative rotation of the i-th image pair is
+// cam2_from_cam1 = cam2_from_world * cam1_from_world^-1. The rotations are
+// initialized from the maximum spanning tree of the view graph using the given
+// pair weights, e.g., the number of inlier matches. They are then refined by
+// iteratively reweighted least-squares in the tangent space, similar to:
+//
+//    "Efficient and Robust Large-Scale Rotation Averaging".
+//    Avishek Chatterjee and Venu Madhav Govindu. ICCV 2013.
+//
+// Rotations are only estimated for the images in the largest connected
+// component of the view graph. The gauge is fixed by the image with the most
+// pairs in the spanning tree, which keeps its identity rotation.
+bool EstimateGlobalRotations(
+    const RotationAveragingOptions& options,
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const std::vector<Eigen::Quaterniond>& cams2_from_cams1,
+    const std::vector<double>& weights,
+    std::unordered_map<image_t, Eigen::Quaterniond>* cams_from_world);
+
+}  // namespace colmap
@@ -0,0 +1,170 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/estimators/rotation_averaging.h"
+
+#include "colmap/math/math.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+void GenerateRotations(
+    const int num_images,
+    std::vector<Eigen::Quaterniond>* cams_from_world,
+    std::vector<std::pair<image_t, image_t>>* image_pairs,
+    std::vector<Eigen::Quaterniond>* cams2_from_cams1,
+    std::vector<double>* weights) {
+  cams_from_world->clear();
+  for (int i = 0; i < num_images; ++i) {
+    cams_from_world->push_back(Eigen::Quaterniond::UnitRandom());
+  }
+  image_pairs->clear();
+  cams2_from_cams1->clear();
+  weights->clear();
+  for (int i = 0; i < num_images; ++i) {
+    for (int j = i + 1; j < num_images; ++j) {
+      image_pairs->emplace_back(i + 1, j + 1);
+      cams2_from_cams1->push_back((*cams_from_world)[j] *
+                                  (*cams_from_world)[i].inverse());
+      weights->push_back(1.0 + i + j);
+    }
+  }
+}
+
+void ExpectEqualRelativeRotations(
+    const std::vector<Eigen::Quaterniond>& gt_cams_from_world,
+    const std::unordered_map<image_t, Eigen::Quaterniond>& cams_from_world,
+    const double max_error_deg) {
+  ASSERT_EQ(cams_from_world.size(), gt_cams_from_world.size());
+  for (size_t i = 0; i < gt_cams_from_world.size(); ++i) {
+    for (size_t j = i + 1; j < gt_cams_from_world.size(); ++j) {
+      const Eigen::Quaterniond gt_cam2_from_cam1 =
+          gt_cams_from_world[j] * gt_cams_from_world[i].inverse();
+      const Eigen::Quaterniond cam2_from_cam1 =
+          cams_from_world.at(j + 1) * cams_from_world.at(i + 1).inverse();
+      EXPECT_LT(RadToDeg(gt_cam2_from_cam1.angularDistance(cam2_from_cam1)),
+                max_error_deg);
+    }
+  }
+}
+
+TEST(EstimateGlobalRotations, Nominal) {
+  std::vector<Eigen::Quaterniond> gt_cams_from_world;
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<Eigen::Quaterniond> cams2_from_cams1;
+  std::vector<double> weights;
+  GenerateRotations(
+      10, &gt_cams_from_world, &image_pairs, &cams2_from_cams1, &weights);
+
+  std::unordered_map<image_t, Eigen::Quaterniond> cams_from_world;
+  EXPECT_TRUE(EstimateGlobalRotations(RotationAveragingOptions(),
+                                      image_pairs,
+                                      cams2_from_cams1,
+                                      weights,
+                                      &cams_from_world));
+  ExpectEqualRelativeRotations(gt_cams_from_world, cams_from_world, 1e-6);
+}
+
+TEST(EstimateGlobalRotations, Noise) {
+  std::vector<Eigen::Quaterniond> gt_cams_from_world;
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<Eigen::Quaterniond> cams2_from_cams1;
+  std::vector<double> weights;
+  GenerateRotations(
+      20, &gt_cams_from_world, &image_pairs, &cams2_from_cams1, &weights);
+
+  for (auto& cam2_from_cam1 : cams2_from_cams1) {
+    cam2_from_cam1 =
+        cam2_from_cam1 *
+        Eigen::Quaterniond(Eigen::AngleAxisd(
+            DegToRad(0.5), Eigen::Vector3d::Random().normalized()));
+  }
+
+  std::unordered_map<image_t, Eigen::Quaterniond> cams_from_world;
+  EXPECT_TRUE(EstimateGlobalRotations(RotationAveragingOptions(),
+                                      image_pairs,
+                                      cams2_from_cams1,
+                                      weights,
+                                      &cams_from_world));
+  ExpectEqualRelativeRotations(gt_cams_from_world, cams_from_world, 0.5);
+}
+
+TEST(EstimateGlobalRotations, Outliers) {
+  std::vector<Eigen::Quaterniond> gt_cams_from_world;
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<Eigen::Quaterniond> cams2_from_cams1;
+  std::vector<double> weights;
+  GenerateRotations(
+      20, &gt_cams_from_world, &image_pairs, &cams2_from_cams1, &weights);
+
+  // Corrupt every tenth relative rotation, which also corrupts the
+  // initialization from the spanning tree.
+  for (size_t i = 0; i < cams2_from_cams1.size(); i += 10) {
+    cams2_from_cams1[i] = Eigen::Quaterniond::UnitRandom();
+  }
+
+  std::unordered_map<image_t, Eigen::Quaterniond> cams_from_world;
+  EXPECT_TRUE(EstimateGlobalRotations(RotationAveragingOptions(),
+                                      image_pairs,
+                                      cams2_from_cams1,
+                                      weights,
+                                      &cams_from_world));
+  ExpectEqualRelativeRotations(gt_cams_from_world, cams_from_world, 1e-3);
+}
+
+TEST(EstimateGlobalRotations, LargestComponent) {
+  const std::vector<std::pair<image_t, image_t>> image_pairs = {
+      {1, 2}, {2, 3}, {1, 3}, {4, 5}};
+  const std::vector<Eigen::Quaterniond> cams2_from_cams1(
+      image_pairs.size(), Eigen::Quaterniond::Identity());
+  const std::vector<double> weights(image_pairs.size(), 1.0);
+
+  std::unordered_map<image_t, Eigen::Quaterniond> cams_from_world;
+  EXPECT_TRUE(EstimateGlobalRotations(RotationAveragingOptions(),
+                                      image_pairs,
+                                      cams2_from_cams1,
+                                      weights,
+                                      &cams_from_world));
+  EXPECT_EQ(cams_from_world.size(), 3);
+  EXPECT_EQ(cams_from_world.count(4), 0);
+  EXPECT_EQ(cams_from_world.count(5), 0);
+}
+
+TEST(EstimateGlobalRotations, Empty) {
+  std::unordered_map<image_t, Eigen::Quaterniond> cams_from_world;
+  EXPECT_FALSE(EstimateGlobalRotations(
+      RotationAveragingOptions(), {}, {}, {}, &cams_from_world));
+  EXPECT_TRUE(cams_from_world.empty());
+}
+
+}  // namespace
+}  // namespace colmap
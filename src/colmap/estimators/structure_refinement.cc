@@ -0,0 +1,316 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/estimators/structure_refinement.h"
+
+#include "colmap/estimators/cost_functions.h"
+#include "colmap/sensor/models.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/threading.h"
+
+#include <future>
+
+#include <Eigen/Dense>
+#include <ceres/jet.h>
+
+namespace colmap {
+namespace {
+
+typedef Eigen::Matrix<double, 2, 3, Eigen::RowMajor> Matrix23d;
+
+// Project a point in camera coordinates to the image together with the
+// Jacobian w.r.t. the point. Uses the analytic Jacobians where available and
+// otherwise forward-mode automatic differentiation of the camera model.
+void ImgFromCamWithJacobian(const Camera& camera,
+                            const Eigen::Vector3d& uvw,
+                            Eigen::Vector2d* xy,
+                            Matrix23d* J_uvw) {
+  switch (camera.model_id) {
+#define ANALYTIC_CAMERA_MODEL_CASE(CameraModel)         \
+  case CameraModel::model_id:                           \
+    AnalyticImgFromCam<CameraModel>::Evaluate(          \
+        camera.params.data(), uvw, xy, J_uvw, nullptr); \
+    return;
+
+    ANALYTIC_CAMERA_MODEL_CASE(PinholeCameraModel)
+    ANALYTIC_CAMERA_MODEL_CASE(SimpleRadialCameraModel)
+    ANALYTIC_CAMERA_MODEL_CASE(RadialCameraModel)
+    ANALYTIC_CAMERA_MODEL_CASE(OpenCVCameraModel)
+
+#undef ANALYTIC_CAMERA_MODEL_CASE
+
+    default:
+      break;
+  }
+
+  typedef ceres::Jet<double, 3> JetT;
+  const std::vector<JetT> params(camera.params.begin(), camera.params.end());
+  const JetT u(uvw.x(), 0);
+  const JetT v(uvw.y(), 1);
+  const JetT w(uvw.z(), 2);
+  JetT x;
+  JetT y;
+  switch (camera.model_id) {
+#define CAMERA_MODEL_CASE(CameraModel)                       \
+  case CameraModel::model_id:                                \
+    CameraModel::ImgFromCam(params.data(), u, v, w, &x, &y); \
+    break;
+
+    CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+  }
+
+  xy->x() = x.a;
+  xy->y() = y.a;
+  J_uvw->row(0) = x.v.transpose();
+  J_uvw->row(1) = y.v.transpose();
+}
+
+struct Observation {
+  Eigen::Matrix3d cam_from_world_rotation;
+  Eigen::Vector3d cam_from_world_translation;
+  const Camera* camera;
+  Eigen::Vector2d point2D;
+};
+
+typedef std::vector<Observation, Eigen::aligned_allocator<Observation>>
+    ObservationVector;
+
+double Loss(const ceres::LossFunction* loss_function,
+            const double squared_residual,
+            double* weight) {
+  if (loss_function == nullptr) {
+    *weight = 1;
+    return squared_residual;
+  }
+  double rho[3];
+  loss_function->Evaluate(squared_residual, rho);
+  *weight = rho[1];
+  return rho[0];
+}
+
+// Evaluate the cost at the given point and optionally the Gauss-Newton
+// approximation of the Hessian and the gradient using iteratively reweighted
+// least squares. Returns false if the point is behind any of the cameras.
+bool EvaluateCost(const ObservationVector& observations,
+                  const ceres::LossFunction* loss_function,
+                  const Eigen::Vector3d& xyz,
+                  double* cost,
+                  Eigen::Matrix3d* H,
+                  Eigen::Vector3d* g) {
+  *cost = 0;
+  if (H != nullptr) {
+    H->setZero();
+    g->setZero();
+  }
+
+  Eigen::Vector2d xy;
+  Matrix23d J_uvw;
+  for (const Observation& observation : observations) {
+    const Eigen::Vector3d uvw = observation.cam_from_world_rotation * xyz +
+                                observation.cam_from_world_translation;
+    if (uvw.z() <= std::numeric_limits<double>::epsilon()) {
+      return false;
+    }
+
+    double weight;
+    if (H == nullptr) {
+      const Eigen::Vector2d residual =
+          CameraModelImgFromCam(
+              observation.camera->model_id, observation.camera->params, uvw) -
+          observation.point2D;
+      *cost += 0.5 * Loss(loss_function, residual.squaredNorm(), &weight);
+    } else {
+      ImgFromCamWithJacobian(*observation.camera, uvw, &xy, &J_uvw);
+      const Eigen::Vector2d residual = xy - observation.point2D;
+      *cost += 0.5 * Loss(loss_function, residual.squaredNorm(), &weight);
+      const Eigen::Matrix<double, 2, 3> J =
+          J_uvw * observation.cam_from_world_rotation;
+      *H += weight * J.transpose() * J;
+      *g += weight * J.transpose() * residual;
+    }
+  }
+
+  return std::isfinite(*cost);
+}
+
+}  // namespace
+
+bool StructureRefinementOptions::Check() const {
+  CHECK_OPTION_GE(max_num_iterations, 0);
+  CHECK_OPTION_GE(parameter_tolerance, 0);
+  CHECK_OPTION_GE(function_tolerance, 0);
+  return true;
+}
+
+bool RefinePoint3D(const StructureRefinementOptions& options,
+                   const Reconstruction& reconstruction,
+                   Point3D* point3D,
+                   const ceres::LossFunction* loss_function) {
+  THROW_CHECK_NOTNULL(point3D);
+
+  ObservationVector observations;
+  observations.reserve(point3D->track.Length());
+  for (const TrackElement& track_el : point3D->track.Elements()) {
+    const Image& image = reconstruction.Image(track_el.image_id);
+    observations.emplace_back();
+    Observation& observation = observations.back();
+    observation.cam_from_world_rotation =
+        image.CamFromWorld().rotation.toRotationMatrix();
+    observation.cam_from_world_translation = image.CamFromWorld().translation;
+    observation.camera = &reconstruction.Camera(image.CameraId());
+    observation.point2D = image.Point2D(track_el.point2D_idx).xy;
+  }
+
+  // Initial damping of the Levenberg-Marquardt iterations and its bounds,
+  // chosen similar to the default trust region of Ceres.
+  const double kInitialLambda = 1e-4;
+  const double kMinLambda = 1e-16;
+  const double kMaxLambda = 1e16;
+
+  Eigen::Vector3d xyz = point3D->xyz;
+  double cost;
+  Eigen::Matrix3d H;
+  Eigen::Vector3d g;
+  if (!EvaluateCost(observations, loss_function, xyz, &cost, &H, &g)) {
+    return false;
+  }
+
+  bool refined = false;
+  bool update_normal_equations = false;
+  double lambda = kInitialLambda;
+  for (int iteration = 0; iteration < options.max_num_iterations;
+       ++iteration) {
+    if (update_normal_equations) {
+      EvaluateCost(observations, loss_function, xyz, &cost, &H, &g);
+      update_normal_equations = false;
+    }
+
+    Eigen::Matrix3d H_damped = H;
+    H_damped.diagonal() += lambda * H.diagonal();
+    const Eigen::Vector3d step = H_damped.ldlt().solve(-g);
+    if (!step.allFinite()) {
+      lambda *= 10;
+      if (lambda > kMaxLambda) {
+        break;
+      }
+      continue;
+    }
+
+    if (step.norm() <=
+        options.parameter_tolerance *
+            (xyz.norm() + options.parameter_tolerance)) {
+      break;
+    }
+
+    const Eigen::Vector3d new_xyz = xyz + step;
+    double new_cost;
+    if (EvaluateCost(observations,
+                     loss_function,
+                     new_xyz,
+                     &new_cost,
+                     /*H=*/nullptr,
+                     /*g=*/nullptr) &&
+        new_cost < cost) {
+      const double relative_decrease = (cost - new_cost) / cost;
+      xyz = new_xyz;
+      cost = new_cost;
+      refined = true;
+      update_normal_equations = true;
+      lambda = std::max(kMinLambda, lambda / 10);
+      if (relative_decrease <= options.function_tolerance) {
+        break;
+      }
+    } else {
+      lambda *= 10;
+      if (lambda > kMaxLambda) {
+        break;
+      }
+    }
+  }
+
+  if (refined) {
+    point3D->xyz = xyz;
+  }
+
+  return refined;
+}
+
+size_t RefinePoints3D(const StructureRefinementOptions& options,
+                      const std::vector<point3D_t>& point3D_ids,
+                      Reconstruction* reconstruction,
+                      const ceres::LossFunction* loss_function) {
+  THROW_CHECK(options.Check());
+  THROW_CHECK_NOTNULL(reconstruction);
+
+  if (point3D_ids.empty()) {
+    return 0;
+  }
+
+  // The points only read the shared images and cameras, so that contiguous
+  // chunks of points can be refined without synchronization.
+  auto RefineChunk = [&](const size_t begin, const size_t end) {
+    size_t num_refined = 0;
+    for (size_t i = begin; i < end; ++i) {
+      if (RefinePoint3D(options,
+                        *reconstruction,
+                        &reconstruction->Point3D(point3D_ids[i]),
+                        loss_function)) {
+        ++num_refined;
+      }
+    }
+    return num_refined;
+  };
+
+  const int num_threads = std::min<int>(
+      GetEffectiveNumThreads(options.num_threads), point3D_ids.size());
+  if (num_threads == 1) {
+    return RefineChunk(0, point3D_ids.size());
+  }
+
+  const size_t chunk_size =
+      (point3D_ids.size() + num_threads - 1) / num_threads;
+  ThreadPool thread_pool(num_threads);
+  std::vector<std::future<size_t>> futures;
+  for (size_t begin = 0; begin < point3D_ids.size(); begin += chunk_size) {
+    futures.push_back(thread_pool.AddTask(
+        RefineChunk, begin, std::min(begin + chunk_size, point3D_ids.size())));
+  }
+
+  size_t num_refined = 0;
+  for (auto& future : futures) {
+    num_refined += future.get();
+  }
+
+  return num_refined;
+}
+
+}  // namespace colmap
@@ -0,0 +1,90 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/scene/reconstruction.h"
+#include "colmap/util/types.h"
+
+#include <vector>
+
+#include <ceres/ceres.h>
+
+namespace colmap {
+
+// Options for the structure-only refinement of 3D points with constant camera
+// poses and intrinsics. In this case, the points are independent of each other
+// and every point is refined by a small Levenberg-Marquardt solver on its 3x3
+// normal equations instead of a joint ceres::Problem.
+struct StructureRefinementOptions {
+  // Maximum number of iterations per point.
+  int max_num_iterations = 10;
+
+  // Convergence threshold on the relative change of the point position.
+  double parameter_tolerance = 1e-8;
+
+  // Convergence threshold on the relative change of the cost.
+  double function_tolerance = 1e-6;
+
+  // Number of threads used to refine multiple points in parallel.
+  int num_threads = -1;
+
+  bool Check() const;
+};
+
+// Refine the position of a single 3D point by minimizing the (robustified)
+// reprojection error of its track w.r.t. the constant images and cameras in
+// the reconstruction. Points observed behind any of the cameras are not
+// refined. The point remains unchanged if the refinement does not reduce its
+// cost.
+//
+// @param options         Structure refinement options.
+// @param reconstruction  Reconstruction with the images and cameras of the
+//                        point's track.
+// @param point3D         3D point to refine.
+// @param loss_function   Optional robust loss function on the squared
+//                        reprojection error. The trivial loss if null.
+//
+// @return                Whether the point was refined.
+bool RefinePoint3D(const StructureRefinementOptions& options,
+                   const Reconstruction& reconstruction,
+                   Point3D* point3D,
+                   const ceres::LossFunction* loss_function = nullptr);
+
+// Refine the given 3D points of the reconstruction independently in parallel.
+// The loss function must be thread-safe, which holds for the ceres losses.
+//
+// @return                The number of refined points.
+size_t RefinePoints3D(const StructureRefinementOptions& options,
+                      const std::vector<point3D_t>& point3D_ids,
+                      Reconstruction* reconstruction,
+                      const ceres::LossFunction* loss_function = nullptr);
+
+}  // namespace colmap
@@ -0,0 +1,142 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/estimators/structure_refinement.h"
+
+#include "colmap/math/random.h"
+#include "colmap/scene/synthetic.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+std::vector<point3D_t> Point3DIds(const Reconstruction& reconstruction) {
+  std::vector<point3D_t> point3D_ids;
+  for (const auto& point3D : reconstruction.Points3D()) {
+    point3D_ids.push_back(point3D.first);
+  }
+  return point3D_ids;
+}
+
+void PerturbPoints3D(const double stddev, Reconstruction* reconstruction) {
+  for (auto& point3D : reconstruction->Points3D()) {
+    reconstruction->Point3D(point3D.first).xyz +=
+        Eigen::Vector3d(RandomGaussian(0.0, stddev),
+                        RandomGaussian(0.0, stddev),
+                        RandomGaussian(0.0, stddev));
+  }
+}
+
+void TestRefinePoints3D(const CameraModelId camera_model_id,
+                        const std::vector<double>& camera_params) {
+  SetPRNGSeed(0);
+
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_images = 5;
+  synthetic_dataset_options.num_points3D = 50;
+  synthetic_dataset_options.camera_model_id = camera_model_id;
+  synthetic_dataset_options.camera_params = camera_params;
+  SynthesizeDataset(synthetic_dataset_options, &reconstruction);
+  const auto orig_reconstruction = reconstruction;
+
+  PerturbPoints3D(0.01, &reconstruction);
+
+  StructureRefinementOptions options;
+  options.max_num_iterations = 100;
+  EXPECT_EQ(
+      RefinePoints3D(options, Point3DIds(reconstruction), &reconstruction),
+      reconstruction.NumPoints3D());
+
+  for (const auto& point3D : reconstruction.Points3D()) {
+    EXPECT_LT((point3D.second.xyz -
+               orig_reconstruction.Point3D(point3D.first).xyz)
+                  .norm(),
+              1e-6);
+  }
+}
+
+TEST(RefinePoints3D, Nominal) {
+  TestRefinePoints3D(SimpleRadialCameraModel::model_id, {1280, 512, 384, 0.05});
+}
+
+TEST(RefinePoints3D, AutoDiffCameraModel) {
+  TestRefinePoints3D(OpenCVFisheyeCameraModel::model_id,
+                     {1280, 1280, 512, 384, 0.05, 0.01, 0, 0});
+}
+
+TEST(RefinePoints3D, WithNoise) {
+  SetPRNGSeed(0);
+
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_images = 5;
+  synthetic_dataset_options.num_points3D = 50;
+  synthetic_dataset_options.point2D_stddev = 1.0;
+  SynthesizeDataset(synthetic_dataset_options, &reconstruction);
+  reconstruction.UpdatePoint3DErrors();
+  const double orig_error = reconstruction.ComputeMeanReprojectionError();
+
+  PerturbPoints3D(0.01, &reconstruction);
+
+  StructureRefinementOptions options;
+  std::unique_ptr<ceres::LossFunction> loss_function =
+      std::make_unique<ceres::CauchyLoss>(1.0);
+  RefinePoints3D(options,
+                 Point3DIds(reconstruction),
+                 &reconstruction,
+                 loss_function.get());
+
+  // The refined points fit the noisy observations at least as well as the
+  // ground-truth points.
+  reconstruction.UpdatePoint3DErrors();
+  EXPECT_LE(reconstruction.ComputeMeanReprojectionError(), orig_error + 1e-6);
+}
+
+TEST(RefinePoint3D, NegativeDepth) {
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions synthetic_dataset_options;
+  synthetic_dataset_options.num_images = 2;
+  synthetic_dataset_options.num_points3D = 1;
+  SynthesizeDataset(synthetic_dataset_options, &reconstruction);
+
+  Point3D& point3D = reconstruction.Point3D(Point3DIds(reconstruction)[0]);
+  const Image& image = reconstruction.Image(point3D.track.Element(0).image_id);
+  point3D.xyz = image.ProjectionCenter() - image.ViewingDirection();
+  const Eigen::Vector3d orig_xyz = point3D.xyz;
+
+  EXPECT_FALSE(
+      RefinePoint3D(StructureRefinementOptions(), reconstruction, &point3D));
+  EXPECT_EQ(point3D.xyz, orig_xyz);
+}
+
+}  // namespace
+}  // namespace colmap
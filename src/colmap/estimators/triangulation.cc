@@ -41,6 +41,48 @@
 #include <Eigen/Geometry>
 
 namespace colmap {
+namespace {
+
+// Check whether any pair of viewing rays of the point encloses at least the
+// given triangulation angle, as computed by `CalculateTriangulationAngle`.
+// Each ray is normalized once and the pairs are compared by the cosines of
+// their angles, which avoids the square roots and inverse cosines per pair.
+bool HasMinTriangulationAngle(
+    const std::vector<TriangulationEstimator::PoseData>& pose_data,
+    const Eigen::Vector3d& xyz,
+    const double min_tri_angle) {
+  if (min_tri_angle <= 0) {
+    return true;
+  }
+
+  // The minimum of the angle and its supplement is at least the minimum
+  // angle, if the absolute cosine is at most the cosine of the minimum angle.
+  const double max_abs_cos = std::cos(min_tri_angle);
+
+  thread_local std::vector<Eigen::Vector3d> rays;
+  rays.clear();
+  rays.reserve(pose_data.size());
+  for (const auto& pose : pose_data) {
+    const Eigen::Vector3d ray = pose.proj_center - xyz;
+    const double ray_length = ray.norm();
+    // Degenerate rays have a triangulation angle of zero with any other ray.
+    if (ray_length > 0) {
+      rays.push_back(ray / ray_length);
+    }
+  }
+
+  for (size_t i = 0; i < rays.size(); ++i) {
+    for (size_t j = 0; j < i; ++j) {
+      if (std::abs(rays[i].dot(rays[j])) <= max_abs_cos) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+}  // namespace
 
 void TriangulationEstimator::SetMinTriAngle(const double min_tri_angle) {
   THROW_CHECK_GE(min_tri_angle, 0);
@@ -80,10 +122,12 @@ void TriangulationEstimator::Estimate(const std::vector<X_t>& point_data,
   } else {
     // Multi-view triangulation.
 
-    std::vector<Eigen::Matrix3x4d> proj_matrices;
-    proj_matrices.reserve(point_data.size());
-    std::vector<Eigen::Vector2d> points;
-    points.reserve(point_data.size());
+    // The buffers are reused, since this is called for every local
+    // optimization of every track.
+    thread_local std::vector<Eigen::Matrix3x4d> proj_matrices;
+    thread_local std::vector<Eigen::Vector2d> points;
+    proj_matrices.clear();
+    points.clear();
     for (size_t i = 0; i < point_data.size(); ++i) {
       proj_matrices.push_back(pose_data[i].proj_matrix);
       points.push_back(point_data[i].point_normalized);
@@ -99,16 +143,9 @@ void TriangulationEstimator::Estimate(const std::vector<X_t>& point_data,
     }
 
     // Check for sufficient triangulation angle.
-    for (size_t i = 0; i < pose_data.size(); ++i) {
-      for (size_t j = 0; j < i; ++j) {
-        const double tri_angle = CalculateTriangulationAngle(
-            pose_data[i].proj_center, pose_data[j].proj_center, xyz);
-        if (tri_angle >= min_tri_angle_) {
-          models->resize(1);
-          (*models)[0] = xyz;
-          return;
-        }
-      }
+    if (HasMinTriangulationAngle(pose_data, xyz, min_tri_angle_)) {
+      models->resize(1);
+      (*models)[0] = xyz;
     }
   }
 }
@@ -39,14 +39,74 @@
 #include "colmap/geometry/triangulation.h"
 #include "colmap/math/random.h"
 #include "colmap/optim/loransac.h"
+#include "colmap/optim/progressive_sampler.h"
 #include "colmap/optim/ransac.h"
 #include "colmap/scene/camera.h"
+#include "colmap/util/threading.h"
 
+#include <functional>
+#include <future>
 #include <unordered_set>
 
 namespace colmap {
 namespace {
 
+// Robustly estimate a model with LO-RANSAC. The matches are either sampled
+// uniformly or progressively, if they are sorted by decreasing quality.
+template <typename Estimator, typename LocalEstimator>
+typename LORANSAC<Estimator, LocalEstimator>::Report EstimateModel(
+    const RANSACOptions& options,
+    const bool use_prosac,
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y) {
+  if (!use_prosac) {
+    LORANSAC<Estimator, LocalEstimator> ransac(options);
+    return ransac.Estimate(X, Y);
+  }
+
+  LORANSAC<Estimator,
+           LocalEstimator,
+           InlierSupportMeasurer,
+           ProgressiveSampler>
+      prosac(options);
+  auto prosac_report = prosac.Estimate(X, Y);
+
+  typename LORANSAC<Estimator, LocalEstimator>::Report report;
+  report.success = prosac_report.success;
+  report.num_trials = prosac_report.num_trials;
+  report.support = prosac_report.support;
+  report.inlier_mask = std::move(prosac_report.inlier_mask);
+  report.model = prosac_report.model;
+  return report;
+}
+
+// Run the independent estimations of the different models. They run
+// concurrently, if there are enough matches to amortize the overhead.
+void RunModelEstimations(
+    const TwoViewGeometryOptions& options,
+    const size_t num_matches,
+    const std::vector<std::function<void()>>& estimations) {
+  if (options.min_num_matches_parallel < 0 ||
+      num_matches < static_cast<size_t>(options.min_num_matches_parallel) ||
+      estimations.size() < 2) {
+    for (const auto& estimation : estimations) {
+      estimation();
+    }
+    return;
+  }
+
+  ThreadPool thread_pool(static_cast<int>(estimations.size()) - 1);
+  std::vector<std::future<void>> futures;
+  futures.reserve(estimations.size() - 1);
+  for (size_t i = 1; i < estimations.size(); ++i) {
+    futures.push_back(thread_pool.AddTask(estimations[i]));
+  }
+  estimations[0]();
+  for (auto& future : futures) {
+    future.get();
+  }
+}
+
 FeatureMatches ExtractInlierMatches(const FeatureMatches& matches,
                                     const size_t num_inliers,
                                     const std::vector<char>& inlier_mask) {
@@ -118,9 +178,12 @@ TwoViewGeometry EstimateCalibratedHomography(
 
   // Estimate planar or panoramic model.
 
-  LORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator> H_ransac(
-      options.ransac_options);
-  const auto H_report = H_ransac.Estimate(matched_points1, matched_points2);
+  const auto H_report =
+      EstimateModel<HomographyMatrixEstimator, HomographyMatrixEstimator>(
+          options.ransac_options,
+          options.use_prosac,
+          matched_points1,
+          matched_points2);
   geometry.H = H_report.model;
 
   if (!H_report.success || H_report.support.num_inliers < min_num_inliers) {
@@ -172,19 +235,36 @@ TwoViewGeometry EstimateUncalibratedTwoViewGeometry(
     matched_points2[i] = points2[matches[i].point2D_idx2];
   }
 
-  // Estimate epipolar model.
+  // Estimate epipolar model and planar or panoramic model.
 
   LORANSAC<FundamentalMatrixSevenPointEstimator,
-           FundamentalMatrixEightPointEstimator>
-      F_ransac(options.ransac_options);
-  const auto F_report = F_ransac.Estimate(matched_points1, matched_points2);
-  geometry.F = F_report.model;
+           FundamentalMatrixEightPointEstimator>::Report
+      F_report;
+
+  LORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator>::Report
+      H_report;
+
+  RunModelEstimations(
+      options,
+      matches.size(),
+      {[&]() {
+         F_report = EstimateModel<FundamentalMatrixSevenPointEstimator,
+                                  FundamentalMatrixEightPointEstimator>(
+             options.ransac_options,
+             options.use_prosac,
+             matched_points1,
+             matched_points2);
+       },
+       [&]() {
+         H_report = EstimateModel<HomographyMatrixEstimator,
+                                  HomographyMatrixEstimator>(
+             options.ransac_options,
+             options.use_prosac,
+             matched_points1,
+             matched_points2);
+       }});
 
-  // Estimate planar or panoramic model.
-
-  LORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator> H_ransac(
-      options.ransac_options);
-  const auto H_report = H_ransac.Estimate(matched_points1, matched_points2);
+  geometry.F = F_report.model;
   geometry.H = H_report.model;
 
   if ((!F_report.success && !H_report.success) ||
@@ -292,6 +372,7 @@ bool TwoViewGeometryOptions::Check() const {
   CHECK_OPTION_LE(watermark_min_inlier_ratio, 1);
   CHECK_OPTION_GE(watermark_border_size, 0);
   CHECK_OPTION_LE(watermark_border_size, 1);
+  CHECK_OPTION_GE(min_num_matches_parallel, -1);
   CHECK_OPTION_GT(ransac_options.max_error, 0);
   CHECK_OPTION_GE(ransac_options.min_inlier_ratio, 0);
   CHECK_OPTION_LE(ransac_options.min_inlier_ratio, 1);
@@ -449,23 +530,48 @@ TwoViewGeometry EstimateCalibratedTwoViewGeometry(
        camera2.CamFromImgThreshold(options.ransac_options.max_error)) /
       2;
 
-  LORANSAC<EssentialMatrixFivePointEstimator, EssentialMatrixFivePointEstimator>
-      E_ransac(E_ransac_options);
-  const auto E_report =
-      E_ransac.Estimate(matched_points1_normalized, matched_points2_normalized);
-  geometry.E = E_report.model;
+  LORANSAC<EssentialMatrixFivePointEstimator,
+           EssentialMatrixFivePointEstimator>::Report E_report;
 
   LORANSAC<FundamentalMatrixSevenPointEstimator,
-           FundamentalMatrixEightPointEstimator>
-      F_ransac(options.ransac_options);
-  const auto F_report = F_ransac.Estimate(matched_points1, matched_points2);
-  geometry.F = F_report.model;
+           FundamentalMatrixEightPointEstimator>::Report
+      F_report;
 
   // Estimate planar or panoramic model.
 
-  LORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator> H_ransac(
-      options.ransac_options);
-  const auto H_report = H_ransac.Estimate(matched_points1, matched_points2);
+  LORANSAC<HomographyMatrixEstimator, HomographyMatrixEstimator>::Report
+      H_report;
+
+  RunModelEstimations(
+      options,
+      matches.size(),
+      {[&]() {
+         E_report = EstimateModel<EssentialMatrixFivePointEstimator,
+                                  EssentialMatrixFivePointEstimator>(
+             E_ransac_options,
+             options.use_prosac,
+             matched_points1_normalized,
+             matched_points2_normalized);
+       },
+       [&]() {
+         F_report = EstimateModel<FundamentalMatrixSevenPointEstimator,
+                                  FundamentalMatrixEightPointEstimator>(
+             options.ransac_options,
+             options.use_prosac,
+             matched_points1,
+             matched_points2);
+       },
+       [&]() {
+         H_report = EstimateModel<HomographyMatrixEstimator,
+                                  HomographyMatrixEstimator>(
+             options.ransac_options,
+             options.use_prosac,
+             matched_points1,
+             matched_points2);
+       }});
+
+  geometry.E = E_report.model;
+  geometry.F = F_report.model;
   geometry.H = H_report.model;
 
   if ((!E_report.success && !F_report.success && !H_report.success) ||
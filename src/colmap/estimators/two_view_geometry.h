@@ -94,6 +94,18 @@ struct TwoViewGeometryOptions {
   // field will be initialized.
   bool multiple_models = false;
 
+  // Minimum number of matches, for which the E, F, and H models are estimated
+  // concurrently in separate threads. This reduces the latency of verifying
+  // pairs with many matches, but oversubscribes the CPU if many pairs are
+  // verified in parallel already. Set to -1 to always estimate sequentially.
+  int min_num_matches_parallel = -1;
+
+  // Whether to sample the matches progressively (PROSAC) instead of uniformly
+  // in RANSAC. This assumes the matches to be sorted by decreasing quality,
+  // e.g., using `SiftMatchingOptions::sort_matches`, in which case a good
+  // model is typically found in far fewer iterations.
+  bool use_prosac = false;
+
   // TwoViewGeometryOptions used to robustly estimate the geometry.
   RANSACOptions ransac_options;
 
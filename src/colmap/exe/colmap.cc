@@ -35,8 +35,12 @@
 #include "colmap/exe/mvs.h"
 #include "colmap/exe/sfm.h"
 #include "colmap/exe/vocab_tree.h"
+#include "colmap/util/memory_budget.h"
+#include "colmap/util/profiler.h"
 #include "colmap/util/version.h"
 
+#include <cstdlib>
+
 namespace {
 
 typedef std::function<int(int, char**)> command_func_t;
@@ -105,9 +109,11 @@ int main(int argc, char** argv) {
   commands.emplace_back("exhaustive_matcher", &colmap::RunExhaustiveMatcher);
   commands.emplace_back("feature_extractor", &colmap::RunFeatureExtractor);
   commands.emplace_back("feature_importer", &colmap::RunFeatureImporter);
+  commands.emplace_back("global_mapper", &colmap::RunGlobalMapper);
   commands.emplace_back("hierarchical_mapper", &colmap::RunHierarchicalMapper);
   commands.emplace_back("image_deleter", &colmap::RunImageDeleter);
   commands.emplace_back("image_filterer", &colmap::RunImageFilterer);
+  commands.emplace_back("image_localizer", &colmap::RunImageLocalizer);
   commands.emplace_back("image_rectifier", &colmap::RunImageRectifier);
   commands.emplace_back("image_registrator", &colmap::RunImageRegistrator);
   commands.emplace_back("image_undistorter", &colmap::RunImageUndistorter);
@@ -115,6 +121,7 @@ int main(int argc, char** argv) {
                         &colmap::RunImageUndistorterStandalone);
   commands.emplace_back("mapper", &colmap::RunMapper);
   commands.emplace_back("matches_importer", &colmap::RunMatchesImporter);
+  commands.emplace_back("matches_merger", &colmap::RunMatchesMerger);
   commands.emplace_back("model_aligner", &colmap::RunModelAligner);
   commands.emplace_back("model_analyzer", &colmap::RunModelAnalyzer);
   commands.emplace_back("model_comparer", &colmap::RunModelComparer);
@@ -161,10 +168,23 @@ int main(int argc, char** argv) {
           command.c_str());
       return EXIT_FAILURE;
     } else {
+      // Record the profiled zones of the command into a Chrome trace file,
+      // if its path is given in the environment.
+      const char* trace_path = std::getenv("COLMAP_PROFILE_TRACE");
+      if (trace_path != nullptr) {
+        colmap::Profiler::Enable();
+      }
       int command_argc = argc - 1;
       char** command_argv = &argv[1];
       command_argv[0] = argv[0];
-      return matched_command_func(command_argc, command_argv);
+      const int status = matched_command_func(command_argc, command_argv);
+      if (trace_path != nullptr) {
+        colmap::Profiler::Disable();
+        colmap::Profiler::WriteChromeTrace(trace_path);
+        LOG(INFO) << "Wrote profiler trace to " << trace_path;
+      }
+      colmap::MemoryBudget::Global().PrintReport();
+      return status;
     }
   }
 
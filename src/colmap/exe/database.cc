@@ -37,9 +37,25 @@ namespace colmap {
 
 int RunDatabaseCleaner(int argc, char** argv) {
   std::string type;
+  std::string image_ids_path;
+  std::string image_names_path;
+  std::string vacuum_into_path;
 
   OptionManager options;
   options.AddRequiredOption("type", &type, "{all, images, features, matches}");
+  options.AddDefaultOption(
+      "image_ids_path",
+      &image_ids_path,
+      "For type images, only delete the images with the image_id per line");
+  options.AddDefaultOption(
+      "image_names_path",
+      &image_names_path,
+      "For type images, only delete the images with the image name per line");
+  options.AddDefaultOption(
+      "vacuum_into_path",
+      &vacuum_into_path,
+      "Write the compacted database to this path instead of vacuuming the "
+      "database in-place");
   options.AddDatabaseOptions();
   options.Parse(argc, argv);
 
@@ -51,6 +67,37 @@ int RunDatabaseCleaner(int argc, char** argv) {
     if (type == "all") {
       PrintHeading2("Clearing all tables");
       database.ClearAllTables();
+    } else if (type == "images" &&
+               (!image_ids_path.empty() || !image_names_path.empty())) {
+      std::vector<image_t> image_ids;
+      if (!image_ids_path.empty()) {
+        for (const auto& image_id_str : ReadTextFileLines(image_ids_path)) {
+          if (!image_id_str.empty()) {
+            image_ids.push_back(std::stoi(image_id_str));
+          }
+        }
+      }
+      if (!image_names_path.empty()) {
+        std::unordered_map<std::string, image_t> image_name_to_id;
+        for (const auto& image : database.ReadAllImages()) {
+          image_name_to_id.emplace(image.Name(), image.ImageId());
+        }
+        for (const auto& image_name : ReadTextFileLines(image_names_path)) {
+          if (image_name.empty()) {
+            continue;
+          }
+          const auto it = image_name_to_id.find(image_name);
+          if (it == image_name_to_id.end()) {
+            LOG(WARNING) << "Skipping image_name=" << image_name
+                         << ", because it does not exist in the database";
+          } else {
+            image_ids.push_back(it->second);
+          }
+        }
+      }
+      PrintHeading2(StringPrintf("Deleting %d images and their dependent rows",
+                                 image_ids.size()));
+      database.DeleteImages(image_ids);
     } else if (type == "images") {
       PrintHeading2("Clearing Images and all dependent tables");
       database.ClearImages();
@@ -72,6 +119,11 @@ int RunDatabaseCleaner(int argc, char** argv) {
     }
   }
 
+  if (!vacuum_into_path.empty()) {
+    PrintHeading2("Writing compacted database");
+    database.VacuumInto(vacuum_into_path);
+  }
+
   return EXIT_SUCCESS;
 }
 
@@ -109,4 +161,40 @@ int RunDatabaseMerger(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
+int RunMatchesMerger(int argc, char** argv) {
+  std::string input_database_paths;
+
+  OptionManager options;
+  options.AddDatabaseOptions();
+  options.AddRequiredOption(
+      "input_database_paths",
+      &input_database_paths,
+      "Comma-separated list of databases, whose matches are merged");
+  options.Parse(argc, argv);
+
+  const std::vector<std::string> paths =
+      CSVToVector<std::string>(input_database_paths);
+  if (paths.empty()) {
+    LOG(ERROR) << "No input databases given.";
+    return EXIT_FAILURE;
+  }
+
+  for (const auto& path : paths) {
+    if (!ExistsFile(path)) {
+      LOG(ERROR) << "Input database " << path << " does not exist.";
+      return EXIT_FAILURE;
+    }
+  }
+
+  Database database(*options.database_path);
+  for (const auto& path : paths) {
+    LOG(INFO) << "Merging matches of " << path;
+    Database input_database(path);
+    DatabaseTransaction transaction(&database);
+    Database::MergeImagePairs(input_database, &database);
+  }
+
+  return EXIT_SUCCESS;
+}
+
 }  // namespace colmap
@@ -206,8 +206,8 @@ int RunFeatureImporter(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
-  auto feature_importer =
-      CreateFeatureImporterController(reader_options, import_path);
+  auto feature_importer = CreateFeatureImporterController(
+      reader_options, import_path, options.sift_extraction->num_threads);
   feature_importer->Start();
   feature_importer->Wait();
 
@@ -43,7 +43,10 @@ class QApplication {
 
 namespace colmap {
 
-#if defined(COLMAP_CUDA_ENABLED) || !defined(COLMAP_GUI_ENABLED)
+// Whether GPU threads must be run with an OpenGL context of a Qt application.
+// This is not necessary with CUDA or headless EGL contexts.
+#if defined(COLMAP_CUDA_ENABLED) || !defined(COLMAP_GUI_ENABLED) || \
+    defined(COLMAP_EGL_ENABLED)
 const bool kUseOpenGL = false;
 #else
 const bool kUseOpenGL = true;
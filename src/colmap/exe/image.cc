@@ -29,7 +29,9 @@
 
 #include "colmap/exe/image.h"
 
+#include "colmap/controllers/image_reader.h"
 #include "colmap/controllers/incremental_mapper.h"
+#include "colmap/controllers/localizer.h"
 #include "colmap/controllers/option_manager.h"
 #include "colmap/image/undistortion.h"
 #include "colmap/scene/reconstruction.h"
@@ -39,6 +41,8 @@
 #include "colmap/util/misc.h"
 #include "colmap/util/timer.h"
 
+#include <fstream>
+
 namespace colmap {
 namespace {
 
@@ -73,6 +77,28 @@ std::vector<std::pair<image_t, image_t>> ReadStereoImagePairs(
   return stereo_pairs;
 }
 
+// Create the camera of a query image analogous to the image reader, i.e.,
+// from the given parameters, the EXIF focal length or a default focal length.
+Camera CreateQueryCamera(const ImageReaderOptions& options,
+                         const Bitmap& bitmap) {
+  Camera camera =
+      Camera::CreateFromModelName(kInvalidCameraId,
+                                  options.camera_model,
+                                  options.default_focal_length_factor *
+                                      std::max(bitmap.Width(), bitmap.Height()),
+                                  bitmap.Width(),
+                                  bitmap.Height());
+  double focal_length = 0.0;
+  if (!options.camera_params.empty()) {
+    THROW_CHECK(camera.SetParamsFromString(options.camera_params));
+    camera.has_prior_focal_length = true;
+  } else if (bitmap.ExifFocalLength(&focal_length)) {
+    camera.SetFocalLength(focal_length);
+    camera.has_prior_focal_length = true;
+  }
+  return camera;
+}
+
 }  // namespace
 
 int RunImageDeleter(int argc, char** argv) {
@@ -237,6 +263,122 @@ int RunImageRectifier(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
+int RunImageLocalizer(int argc, char** argv) {
+  std::string input_path;
+  std::string image_list_path;
+  std::string output_path;
+  int batch_size = 32;
+  LocalizerOptions localizer_options;
+
+  OptionManager options;
+  options.AddDatabaseOptions();
+  options.AddImageOptions();
+  options.AddExtractionOptions();
+  options.AddRequiredOption("input_path", &input_path);
+  options.AddRequiredOption(
+      "image_list_path",
+      &image_list_path,
+      "Path to text file containing one query image name per line");
+  options.AddRequiredOption(
+      "output_path",
+      &output_path,
+      "Path to text file with the name, cam_from_world rotation (QW, QX, QY, "
+      "QZ), translation (TX, TY, TZ) and number of inliers per localized "
+      "image");
+  options.AddDefaultOption("batch_size", &batch_size);
+  options.AddDefaultOption("vocab_tree_path",
+                           &localizer_options.vocab_tree_path);
+  options.AddDefaultOption("num_images", &localizer_options.num_images);
+  options.AddDefaultOption("min_num_inliers",
+                           &localizer_options.min_num_inliers);
+  options.AddDefaultOption("refine_focal_length",
+                           &localizer_options.refine_focal_length);
+  options.Parse(argc, argv);
+
+  if (!ExistsDir(input_path)) {
+    LOG(ERROR) << "`input_path` is not a directory";
+    return EXIT_FAILURE;
+  }
+
+  // The features are extracted and matched on the CPU, such that the queries
+  // of a batch can run in parallel without a shared GPU context.
+  localizer_options.extraction = *options.sift_extraction;
+  localizer_options.extraction.use_gpu = false;
+  localizer_options.extraction.num_threads = 1;
+  localizer_options.num_threads = options.sift_extraction->num_threads;
+
+  PrintHeading1("Building index");
+
+  Reconstruction reconstruction;
+  reconstruction.Read(input_path);
+  Localizer localizer(
+      localizer_options, reconstruction, Database(*options.database_path));
+
+  PrintHeading1("Localizing images");
+
+  const std::vector<std::string> image_names =
+      ReadTextFileLines(image_list_path);
+
+  std::ofstream file(output_path, std::ios::trunc);
+  THROW_CHECK_FILE_OPEN(file, output_path);
+  file.precision(17);
+
+  size_t num_localized = 0;
+  for (size_t begin = 0; begin < image_names.size(); begin += batch_size) {
+    const size_t end = std::min(begin + batch_size, image_names.size());
+
+    Timer timer;
+    timer.Start();
+
+    std::vector<std::string> batch_image_names;
+    std::vector<Bitmap> bitmaps;
+    std::vector<Camera> cameras;
+    for (size_t i = begin; i < end; ++i) {
+      Bitmap bitmap;
+      if (!bitmap.Read(JoinPaths(*options.image_path, image_names[i]),
+                       /*as_rgb=*/false)) {
+        LOG(ERROR) << "Failed to read image " << image_names[i];
+        continue;
+      }
+      cameras.push_back(CreateQueryCamera(*options.image_reader, bitmap));
+      bitmaps.push_back(std::move(bitmap));
+      batch_image_names.push_back(image_names[i]);
+    }
+
+    const std::vector<LocalizationResult> results =
+        localizer.LocalizeBatch(bitmaps, cameras);
+
+    for (size_t i = 0; i < results.size(); ++i) {
+      const LocalizationResult& result = results[i];
+      if (!result.success) {
+        LOG(INFO) << "Failed to localize " << batch_image_names[i] << " with "
+                  << result.num_matches << " matches";
+        continue;
+      }
+      ++num_localized;
+      const Rigid3d& cam_from_world = result.cam_from_world;
+      file << batch_image_names[i] << " " << cam_from_world.rotation.w() << " "
+           << cam_from_world.rotation.x() << " " << cam_from_world.rotation.y()
+           << " " << cam_from_world.rotation.z() << " "
+           << cam_from_world.translation.x() << " "
+           << cam_from_world.translation.y() << " "
+           << cam_from_world.translation.z() << " " << result.num_inliers
+           << "\n";
+    }
+
+    LOG(INFO) << StringPrintf("Localized images [%d-%d/%d] in %.3fs",
+                              begin + 1,
+                              end,
+                              image_names.size(),
+                              timer.ElapsedSeconds());
+  }
+
+  LOG(INFO) << StringPrintf(
+      "Localized %d / %d images", num_localized, image_names.size());
+
+  return EXIT_SUCCESS;
+}
+
 int RunImageRegistrator(int argc, char** argv) {
   std::string input_path;
   std::string output_path;
@@ -338,6 +480,8 @@ int RunImageUndistorter(int argc, char** argv) {
   options.AddDefaultOption("roi_min_y", &undistort_camera_options.roi_min_y);
   options.AddDefaultOption("roi_max_x", &undistort_camera_options.roi_max_x);
   options.AddDefaultOption("roi_max_y", &undistort_camera_options.roi_max_y);
+  options.AddDefaultOption("use_gpu", &undistort_camera_options.use_gpu);
+  options.AddDefaultOption("gpu_index", &undistort_camera_options.gpu_index);
   options.Parse(argc, argv);
 
   CreateDirIfNotExists(output_path);
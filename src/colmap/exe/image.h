@@ -31,6 +31,7 @@ namespace colmap {
 
 int RunImageDeleter(int argc, char** argv);
 int RunImageFilterer(int argc, char** argv);
+int RunImageLocalizer(int argc, char** argv);
 int RunImageRectifier(int argc, char** argv);
 int RunImageRegistrator(int argc, char** argv);
 int RunImageUndistorter(int argc, char** argv);
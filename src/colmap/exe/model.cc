@@ -584,14 +584,18 @@ int RunModelConverter(int argc, char** argv) {
   std::string output_path;
   std::string output_type;
   bool skip_distortion = false;
+  double tile_size = -1;
 
   OptionManager options;
   options.AddRequiredOption("input_path", &input_path);
   options.AddRequiredOption("output_path", &output_path);
-  options.AddRequiredOption("output_type",
-                            &output_type,
-                            "{BIN, TXT, NVM, Bundler, VRML, PLY, R3D, CAM}");
+  options.AddRequiredOption(
+      "output_type",
+      &output_type,
+      "{BIN, TXT, TILED_BIN, NVM, Bundler, VRML, PLY, R3D, CAM}");
   options.AddDefaultOption("skip_distortion", &skip_distortion);
+  options.AddDefaultOption(
+      "tile_size", &tile_size, "Tile size of TILED_BIN, automatic if <= 0");
   options.Parse(argc, argv);
 
   Reconstruction reconstruction;
@@ -602,6 +606,13 @@ int RunModelConverter(int argc, char** argv) {
     reconstruction.WriteBinary(output_path);
   } else if (output_type == "txt") {
     reconstruction.WriteText(output_path);
+  } else if (output_type == "tiled_bin") {
+    THROW_CHECK_DIR_EXISTS(output_path);
+    WriteCamerasBinary(reconstruction, JoinPaths(output_path, "cameras.bin"));
+    WriteImagesBinary(reconstruction, JoinPaths(output_path, "images.bin"));
+    WritePoints3DTiledBinary(reconstruction,
+                             JoinPaths(output_path, "points3D_tiled.bin"),
+                             tile_size);
   } else if (output_type == "nvm") {
     ExportNVM(reconstruction, output_path, skip_distortion);
   } else if (output_type == "bundler") {
@@ -639,12 +650,14 @@ int RunModelCropper(int argc, char** argv) {
   std::string boundary;
   std::string gps_transform_path;
   bool is_gps = false;
+  int num_threads = -1;
 
   OptionManager options;
   options.AddRequiredOption("input_path", &input_path);
   options.AddRequiredOption("output_path", &output_path);
   options.AddRequiredOption("boundary", &boundary);
   options.AddDefaultOption("gps_transform_path", &gps_transform_path);
+  options.AddDefaultOption("num_threads", &num_threads);
   options.Parse(argc, argv);
 
   if (!ExistsDir(input_path)) {
@@ -664,8 +677,17 @@ int RunModelCropper(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
+  // With tiled 3D points and an explicit boundary, only the 3D points of the
+  // overlapping tiles are read.
+  const bool read_tiled =
+      boundary_elements.size() == 6 &&
+      !ExistsFile(JoinPaths(input_path, "points3D.bin")) &&
+      ExistsFile(JoinPaths(input_path, "points3D_tiled.bin"));
+
   Reconstruction reconstruction;
-  reconstruction.Read(input_path);
+  if (!read_tiled) {
+    reconstruction.Read(input_path);
+  }
 
   PrintHeading2("Calculating boundary coordinates");
   std::pair<Eigen::Vector3d, Eigen::Vector3d> bounding_box;
@@ -697,8 +719,16 @@ int RunModelCropper(int argc, char** argv) {
                                                      boundary_elements[1]);
   }
 
+  if (read_tiled) {
+    ReadCamerasBinary(reconstruction, JoinPaths(input_path, "cameras.bin"));
+    ReadImagesBinary(reconstruction, JoinPaths(input_path, "images.bin"));
+    ReadPoints3DTiledBinary(reconstruction,
+                            JoinPaths(input_path, "points3D_tiled.bin"),
+                            bounding_box);
+  }
+
   PrintHeading2("Cropping reconstruction");
-  reconstruction.Crop(bounding_box).Write(output_path);
+  reconstruction.Crop(bounding_box, num_threads).Write(output_path);
   WriteBoundingBox(output_path, bounding_box);
 
   LOG(INFO) << "=> Cropping succeeded";
@@ -770,6 +800,8 @@ int RunModelOrientationAligner(int argc, char** argv) {
 #endif
   options.AddDefaultOption("max_image_size",
                            &frame_estimation_options.max_image_size);
+  options.AddDefaultOption("num_threads",
+                           &frame_estimation_options.num_threads);
   options.Parse(argc, argv);
 
   StringToLower(&method);
@@ -968,7 +1000,9 @@ int RunModelSplitter(int argc, char** argv) {
   const bool use_tile_keys = split_type == "tiles";
 
   auto SplitReconstruction = [&](const int idx) {
-    Reconstruction tile_recon = reconstruction.Crop(bounds[idx]);
+    // The parts are already cropped in parallel.
+    Reconstruction tile_recon =
+        reconstruction.Crop(bounds[idx], /*num_threads=*/1);
     // calculate area covered by model as proportion of box area
     auto bbox_extent = bounds[idx].second - bounds[idx].first;
     auto model_bbox = tile_recon.ComputeBoundingBox();
@@ -34,6 +34,7 @@
 #include "colmap/mvs/meshing.h"
 #include "colmap/mvs/patch_match.h"
 #include "colmap/scene/reconstruction.h"
+#include "colmap/util/metrics.h"
 #include "colmap/util/misc.h"
 
 namespace colmap {
@@ -76,15 +77,12 @@ int RunDelaunayMesher(int argc, char** argv) {
 }
 
 int RunPatchMatchStereo(int argc, char** argv) {
-#if !defined(COLMAP_CUDA_ENABLED)
-  LOG(ERROR) << "Dense stereo reconstruction requires CUDA, which is not "
-                "available on your system.";
-  return EXIT_FAILURE;
-#else   // COLMAP_CUDA_ENABLED
   std::string workspace_path;
   std::string workspace_format = "COLMAP";
   std::string pmvs_option_name = "option-all";
   std::string config_path;
+  std::string metrics_path;
+  double metrics_interval = 10.0;
 
   OptionManager options;
   options.AddRequiredOption(
@@ -95,6 +93,8 @@ int RunPatchMatchStereo(int argc, char** argv) {
       "workspace_format", &workspace_format, "{COLMAP, PMVS}");
   options.AddDefaultOption("pmvs_option_name", &pmvs_option_name);
   options.AddDefaultOption("config_path", &config_path);
+  options.AddDefaultOption("metrics_path", &metrics_path);
+  options.AddDefaultOption("metrics_interval", &metrics_interval);
   options.AddPatchMatchStereoOptions();
   options.Parse(argc, argv);
 
@@ -111,10 +111,16 @@ int RunPatchMatchStereo(int argc, char** argv) {
                                        pmvs_option_name,
                                        config_path);
 
+  // Periodically dump the progress metrics for external monitoring.
+  std::unique_ptr<MetricsFileWriter> metrics_writer;
+  if (!metrics_path.empty()) {
+    metrics_writer = std::make_unique<MetricsFileWriter>(
+        &controller.GetMetrics(), metrics_path, metrics_interval);
+  }
+
   controller.Run();
 
   return EXIT_SUCCESS;
-#endif  // COLMAP_CUDA_ENABLED
 }
 
 int RunPoissonMesher(int argc, char** argv) {
@@ -141,6 +147,8 @@ int RunStereoFuser(int argc, char** argv) {
   std::string output_type = "PLY";
   std::string output_path;
   std::string bbox_path;
+  std::string metrics_path;
+  double metrics_interval = 10.0;
 
   OptionManager options;
   options.AddRequiredOption("workspace_path", &workspace_path);
@@ -152,6 +160,8 @@ int RunStereoFuser(int argc, char** argv) {
   options.AddDefaultOption("output_type", &output_type, "{BIN, TXT, PLY}");
   options.AddRequiredOption("output_path", &output_path);
   options.AddDefaultOption("bbox_path", &bbox_path);
+  options.AddDefaultOption("metrics_path", &metrics_path);
+  options.AddDefaultOption("metrics_interval", &metrics_interval);
   options.AddStereoFusionOptions();
   options.Parse(argc, argv);
 
@@ -169,6 +179,13 @@ int RunStereoFuser(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
+  StringToLower(&output_type);
+  if (!options.stereo_fusion->out_of_core_path.empty() &&
+      output_type != "ply") {
+    LOG(ERROR) << "Out-of-core fusion only supports `output_type` PLY.";
+    return EXIT_FAILURE;
+  }
+
   if (!bbox_path.empty()) {
     std::ifstream file(bbox_path);
     if (file.is_open()) {
@@ -188,8 +205,21 @@ int RunStereoFuser(int argc, char** argv) {
                           pmvs_option_name,
                           input_type);
 
+  // Periodically dump the progress metrics for external monitoring.
+  std::unique_ptr<MetricsFileWriter> metrics_writer;
+  if (!metrics_path.empty()) {
+    metrics_writer = std::make_unique<MetricsFileWriter>(
+        &fuser.GetMetrics(), metrics_path, metrics_interval);
+  }
+
   fuser.Run();
 
+  if (output_type == "ply") {
+    LOG(INFO) << "Writing output: " << output_path;
+    fuser.WriteFusedPoints(output_path);
+    return EXIT_SUCCESS;
+  }
+
   Reconstruction reconstruction;
 
   // read data from sparse reconstruction
@@ -203,15 +233,10 @@ int RunStereoFuser(int argc, char** argv) {
   LOG(INFO) << "Writing output: " << output_path;
 
   // write output
-  StringToLower(&output_type);
   if (output_type == "bin") {
     reconstruction.WriteBinary(output_path);
   } else if (output_type == "txt") {
     reconstruction.WriteText(output_path);
-  } else if (output_type == "ply") {
-    WriteBinaryPlyPoints(output_path, fuser.GetFusedPoints());
-    mvs::WritePointsVisibility(output_path + ".vis",
-                               fuser.GetFusedPointsVisibility());
   } else {
     LOG(ERROR) << "Invalid `output_type`";
     return EXIT_FAILURE;
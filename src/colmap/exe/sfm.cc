@@ -31,12 +31,16 @@
 
 #include "colmap/controllers/automatic_reconstruction.h"
 #include "colmap/controllers/bundle_adjustment.h"
+#include "colmap/controllers/global_mapper.h"
 #include "colmap/controllers/hierarchical_mapper.h"
 #include "colmap/controllers/option_manager.h"
+#include "colmap/estimators/bundle_adjustment.h"
 #include "colmap/estimators/similarity_transform.h"
 #include "colmap/exe/gui.h"
 #include "colmap/scene/reconstruction.h"
+#include "colmap/scene/scene_clustering.h"
 #include "colmap/sfm/observation_manager.h"
+#include "colmap/util/metrics.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/opengl_utils.h"
 
@@ -69,6 +73,10 @@ int RunAutomaticReconstructor(int argc, char** argv) {
                            &reconstruction_options.camera_params);
   options.AddDefaultOption("sparse", &reconstruction_options.sparse);
   options.AddDefaultOption("dense", &reconstruction_options.dense);
+  options.AddDefaultOption("overlap_stages",
+                           &reconstruction_options.overlap_stages);
+  options.AddDefaultOption("overlap_num_images",
+                           &reconstruction_options.overlap_num_images);
   options.AddDefaultOption("mesher", &mesher, "{poisson, delaunay}");
   options.AddDefaultOption("num_threads", &reconstruction_options.num_threads);
   options.AddDefaultOption("use_gpu", &reconstruction_options.use_gpu);
@@ -137,10 +145,21 @@ int RunAutomaticReconstructor(int argc, char** argv) {
 int RunBundleAdjuster(int argc, char** argv) {
   std::string input_path;
   std::string output_path;
+  bool partitioned = false;
+
+  PartitionedBundleAdjuster::Options partition_options;
 
   OptionManager options;
   options.AddRequiredOption("input_path", &input_path);
   options.AddRequiredOption("output_path", &output_path);
+  options.AddDefaultOption("partitioned", &partitioned);
+  options.AddDefaultOption(
+      "PartitionedBundleAdjustment.max_num_images_per_partition",
+      &partition_options.max_num_images_per_partition);
+  options.AddDefaultOption("PartitionedBundleAdjustment.max_num_rounds",
+                           &partition_options.max_num_rounds);
+  options.AddDefaultOption("PartitionedBundleAdjustment.function_tolerance",
+                           &partition_options.function_tolerance);
   options.AddBundleAdjustmentOptions();
   options.Parse(argc, argv);
 
@@ -157,8 +176,31 @@ int RunBundleAdjuster(int argc, char** argv) {
   auto reconstruction = std::make_shared<Reconstruction>();
   reconstruction->Read(input_path);
 
-  BundleAdjustmentController ba_controller(options, reconstruction);
-  ba_controller.Run();
+  if (partitioned) {
+    PrintHeading1("Partitioned global bundle adjustment");
+    const std::vector<image_t>& reg_image_ids = reconstruction->RegImageIds();
+    if (reg_image_ids.size() < 2) {
+      LOG(ERROR) << "Need at least two views.";
+      return EXIT_FAILURE;
+    }
+
+    // Avoid degeneracies in bundle adjustment.
+    ObservationManager(*reconstruction).FilterObservationsWithNegativeDepth();
+
+    BundleAdjustmentConfig ba_config;
+    for (const image_t image_id : reg_image_ids) {
+      ba_config.AddImage(image_id);
+    }
+    ba_config.SetConstantCamPose(reg_image_ids[0]);
+    ba_config.SetConstantCamPositions(reg_image_ids[1], {0});
+
+    PartitionedBundleAdjuster bundle_adjuster(
+        *options.bundle_adjustment, partition_options, ba_config);
+    bundle_adjuster.Solve(reconstruction.get());
+  } else {
+    BundleAdjustmentController ba_controller(options, reconstruction);
+    ba_controller.Run();
+  }
 
   reconstruction->Write(output_path);
 
@@ -168,16 +210,21 @@ int RunBundleAdjuster(int argc, char** argv) {
 int RunColorExtractor(int argc, char** argv) {
   std::string input_path;
   std::string output_path;
+  int num_threads = -1;
+  int min_image_size = 0;
 
   OptionManager options;
   options.AddImageOptions();
   options.AddDefaultOption("input_path", &input_path);
   options.AddRequiredOption("output_path", &output_path);
+  options.AddDefaultOption("num_threads", &num_threads);
+  options.AddDefaultOption("min_image_size", &min_image_size);
   options.Parse(argc, argv);
 
   Reconstruction reconstruction;
   reconstruction.Read(input_path);
-  reconstruction.ExtractColorsForAllImages(*options.image_path);
+  reconstruction.ExtractColorsForAllImages(
+      *options.image_path, num_threads, min_image_size);
   reconstruction.Write(output_path);
 
   return EXIT_SUCCESS;
@@ -187,6 +234,10 @@ int RunMapper(int argc, char** argv) {
   std::string input_path;
   std::string output_path;
   std::string image_list_path;
+  std::string cluster_manifest_path;
+  int cluster_index = -1;
+  std::string metrics_path;
+  double metrics_interval = 10.0;
 
   OptionManager options;
   options.AddDatabaseOptions();
@@ -194,6 +245,10 @@ int RunMapper(int argc, char** argv) {
   options.AddDefaultOption("input_path", &input_path);
   options.AddRequiredOption("output_path", &output_path);
   options.AddDefaultOption("image_list_path", &image_list_path);
+  options.AddDefaultOption("cluster_manifest_path", &cluster_manifest_path);
+  options.AddDefaultOption("cluster_index", &cluster_index);
+  options.AddDefaultOption("metrics_path", &metrics_path);
+  options.AddDefaultOption("metrics_interval", &metrics_interval);
   options.AddMapperOptions();
   options.Parse(argc, argv);
 
@@ -208,6 +263,34 @@ int RunMapper(int argc, char** argv) {
         std::unordered_set<std::string>(image_names.begin(), image_names.end());
   }
 
+  // Reconstruct one leaf cluster of a manifest written by the
+  // hierarchical_mapper, e.g., as one job of a distributed reconstruction.
+  if (!cluster_manifest_path.empty()) {
+    if (!image_list_path.empty()) {
+      LOG(ERROR) << "`image_list_path` and `cluster_manifest_path` are "
+                    "mutually exclusive.";
+      return EXIT_FAILURE;
+    }
+
+    const SceneClustering scene_clustering =
+        SceneClustering::Read(cluster_manifest_path);
+    const auto leaf_clusters = scene_clustering.GetLeafClusters();
+    if (cluster_index < 0 ||
+        cluster_index >= static_cast<int>(leaf_clusters.size())) {
+      LOG(ERROR) << "`cluster_index` must be in [0, " << leaf_clusters.size()
+                 << ")";
+      return EXIT_FAILURE;
+    }
+
+    const Database database(*options.database_path);
+    for (const image_t image_id : leaf_clusters[cluster_index]->image_ids) {
+      options.mapper->image_names.insert(database.ReadImage(image_id).Name());
+    }
+
+    // Same as for the clusters reconstructed by the hierarchical_mapper.
+    options.mapper->max_model_overlap = 3;
+  }
+
   auto reconstruction_manager = std::make_shared<ReconstructionManager>();
   if (input_path != "") {
     if (!ExistsDir(input_path)) {
@@ -247,19 +330,27 @@ int RunMapper(int argc, char** argv) {
     mapper.AddCallback(
         IncrementalMapperController::LAST_IMAGE_REG_CALLBACK, [&]() {
           // If the number of reconstructions has not changed, the last model
-          // was discarded for some reason.
-          if (reconstruction_manager->Size() > prev_num_reconstructions) {
+          // was discarded for some reason. When resuming from a checkpoint,
+          // the models finished before the checkpoint are written again.
+          while (reconstruction_manager->Size() > prev_num_reconstructions) {
             const std::string reconstruction_path = JoinPaths(
                 output_path, std::to_string(prev_num_reconstructions));
             CreateDirIfNotExists(reconstruction_path);
             reconstruction_manager->Get(prev_num_reconstructions)
                 ->Write(reconstruction_path);
             options.Write(JoinPaths(reconstruction_path, "project.ini"));
-            prev_num_reconstructions = reconstruction_manager->Size();
+            prev_num_reconstructions += 1;
           }
         });
   }
 
+  // Periodically dump the progress metrics for external monitoring.
+  std::unique_ptr<MetricsFileWriter> metrics_writer;
+  if (!metrics_path.empty()) {
+    metrics_writer = std::make_unique<MetricsFileWriter>(
+        &mapper.GetMetrics(), metrics_path, metrics_interval);
+  }
+
   mapper.Run();
 
   if (reconstruction_manager->Size() == 0) {
@@ -301,9 +392,55 @@ int RunMapper(int argc, char** argv) {
   return EXIT_SUCCESS;
 }
 
+int RunGlobalMapper(int argc, char** argv) {
+  GlobalMapperController::Options mapper_options;
+  std::string output_path;
+
+  OptionManager options;
+  options.AddRequiredOption("database_path", &mapper_options.database_path);
+  options.AddRequiredOption("image_path", &mapper_options.image_path);
+  options.AddRequiredOption("output_path", &output_path);
+  options.AddDefaultOption("max_rotation_error_deg",
+                           &mapper_options.max_rotation_error_deg);
+  options.AddDefaultOption(
+      "rotation_averaging_max_num_iterations",
+      &mapper_options.rotation_averaging.max_num_iterations);
+  options.AddDefaultOption("rotation_averaging_loss_scale_deg",
+                           &mapper_options.rotation_averaging.loss_scale_deg);
+  options.AddDefaultOption("positioning_loss_function_scale",
+                           &mapper_options.positioning.loss_function_scale);
+  options.AddDefaultOption(
+      "positioning_max_num_iterations",
+      &mapper_options.positioning.solver_options.max_num_iterations);
+  options.AddMapperOptions();
+  options.Parse(argc, argv);
+
+  if (!ExistsDir(output_path)) {
+    LOG(ERROR) << "`output_path` is not a directory.";
+    return EXIT_FAILURE;
+  }
+
+  mapper_options.incremental_options = *options.mapper;
+  auto reconstruction_manager = std::make_shared<ReconstructionManager>();
+  GlobalMapperController global_mapper(mapper_options, reconstruction_manager);
+  global_mapper.Run();
+
+  if (reconstruction_manager->Size() == 0) {
+    LOG(ERROR) << "failed to create sparse model";
+    return EXIT_FAILURE;
+  }
+
+  reconstruction_manager->Write(output_path);
+  options.Write(JoinPaths(output_path, "project.ini"));
+
+  return EXIT_SUCCESS;
+}
+
 int RunHierarchicalMapper(int argc, char** argv) {
   HierarchicalMapperController::Options mapper_options;
   std::string output_path;
+  std::string metrics_path;
+  double metrics_interval = 10.0;
 
   OptionManager options;
   options.AddRequiredOption("database_path", &mapper_options.database_path);
@@ -315,6 +452,12 @@ int RunHierarchicalMapper(int argc, char** argv) {
   options.AddDefaultOption(
       "leaf_max_num_images",
       &mapper_options.clustering_options.leaf_max_num_images);
+  options.AddDefaultOption("cluster_manifest_path",
+                           &mapper_options.cluster_manifest_path);
+  options.AddDefaultOption("cluster_input_path",
+                           &mapper_options.cluster_input_path);
+  options.AddDefaultOption("metrics_path", &metrics_path);
+  options.AddDefaultOption("metrics_interval", &metrics_interval);
   options.AddMapperOptions();
   options.Parse(argc, argv);
 
@@ -327,8 +470,23 @@ int RunHierarchicalMapper(int argc, char** argv) {
   auto reconstruction_manager = std::make_shared<ReconstructionManager>();
   HierarchicalMapperController hierarchical_mapper(mapper_options,
                                                    reconstruction_manager);
+
+  std::unique_ptr<MetricsFileWriter> metrics_writer;
+  if (!metrics_path.empty()) {
+    metrics_writer = std::make_unique<MetricsFileWriter>(
+        &hierarchical_mapper.GetMetrics(), metrics_path, metrics_interval);
+  }
+
   hierarchical_mapper.Run();
 
+  // Only the manifest was written and the clusters are reconstructed by
+  // separate mapper processes.
+  if (!mapper_options.cluster_manifest_path.empty() &&
+      mapper_options.cluster_input_path.empty()) {
+    options.Write(JoinPaths(output_path, "project.ini"));
+    return EXIT_SUCCESS;
+  }
+
   if (reconstruction_manager->Size() == 0) {
     LOG(ERROR) << "failed to create sparse model";
     return EXIT_FAILURE;
@@ -362,13 +520,18 @@ int RunPointFiltering(int argc, char** argv) {
   size_t num_filtered = ObservationManager(reconstruction)
                             .FilterAllPoints3D(max_reproj_error, min_tri_angle);
 
-  for (const auto point3D_id : reconstruction.Point3DIds()) {
-    const auto& point3D = reconstruction.Point3D(point3D_id);
-    if (point3D.track.Length() < min_track_len) {
-      num_filtered += point3D.track.Length();
-      reconstruction.DeletePoint3D(point3D_id);
+  // Collect the short tracks by a linear scan over the points, which avoids
+  // building a hash set of all points in large reconstructions.
+  std::vector<point3D_t> short_track_point3D_ids;
+  for (const auto& point3D : reconstruction.Points3D()) {
+    if (point3D.second.track.Length() < min_track_len) {
+      num_filtered += point3D.second.track.Length();
+      short_track_point3D_ids.push_back(point3D.first);
     }
   }
+  for (const auto point3D_id : short_track_point3D_ids) {
+    reconstruction.DeletePoint3D(point3D_id);
+  }
 
   LOG(INFO) << "Filtered observations: " << num_filtered;
 
@@ -645,6 +808,10 @@ int RunRigBundleAdjuster(int argc, char** argv) {
                            &estimate_rig_relative_poses);
   options.AddDefaultOption("RigBundleAdjustment.refine_relative_poses",
                            &rig_ba_options.refine_relative_poses);
+  options.AddDefaultOption("RigBundleAdjustment.use_elimination_ordering",
+                           &rig_ba_options.use_elimination_ordering);
+  options.AddDefaultOption("RigBundleAdjustment.use_nested_dissection",
+                           &rig_ba_options.use_nested_dissection);
   options.AddBundleAdjustmentOptions();
   options.Parse(argc, argv);
 
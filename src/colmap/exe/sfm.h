@@ -46,6 +46,7 @@ void RunPointTriangulatorImpl(
 int RunAutomaticReconstructor(int argc, char** argv);
 int RunBundleAdjuster(int argc, char** argv);
 int RunColorExtractor(int argc, char** argv);
+int RunGlobalMapper(int argc, char** argv);
 int RunMapper(int argc, char** argv);
 int RunHierarchicalMapper(int argc, char** argv);
 int RunPointFiltering(int argc, char** argv);
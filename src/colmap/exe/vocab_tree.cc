@@ -33,6 +33,7 @@
 #include "colmap/controllers/option_manager.h"
 #include "colmap/feature/sift.h"
 #include "colmap/feature/utils.h"
+#include "colmap/math/random.h"
 #include "colmap/optim/random_sampler.h"
 #include "colmap/retrieval/visual_index.h"
 #include "colmap/scene/database.h"
@@ -46,9 +47,13 @@ namespace {
 
 // Loads descriptors for training from the database. Loads all descriptors from
 // the database if max_num_images < 0, otherwise the descriptors of a random
-// subset of images are selected.
+// subset of images are selected. If max_num_descriptors > 0, a uniform random
+// sample of at most this many descriptors is drawn while streaming through the
+// images, such that the training data need not fit into memory.
 FeatureDescriptors LoadRandomDatabaseDescriptors(
-    const std::string& database_path, const int max_num_images) {
+    const std::string& database_path,
+    const int max_num_images,
+    const int64_t max_num_descriptors) {
   Database database(database_path);
   DatabaseTransaction database_transaction(&database);
 
@@ -75,6 +80,32 @@ FeatureDescriptors LoadRandomDatabaseDescriptors(
     }
   }
 
+  if (max_num_descriptors > 0 &&
+      num_descriptors > static_cast<size_t>(max_num_descriptors)) {
+    // Reservoir sampling of the descriptors.
+    descriptors.resize(max_num_descriptors, 128);
+    size_t descriptor_idx = 0;
+    for (const size_t image_idx : image_idxs) {
+      const auto& image = images.at(image_idx);
+      const FeatureDescriptors image_descriptors =
+          database.ReadDescriptors(image.ImageId());
+      for (Eigen::Index i = 0; i < image_descriptors.rows();
+           ++i, ++descriptor_idx) {
+        if (descriptor_idx < static_cast<size_t>(max_num_descriptors)) {
+          descriptors.row(descriptor_idx) = image_descriptors.row(i);
+        } else {
+          const size_t sample_idx =
+              RandomUniformInteger<size_t>(0, descriptor_idx);
+          if (sample_idx < static_cast<size_t>(max_num_descriptors)) {
+            descriptors.row(sample_idx) = image_descriptors.row(i);
+          }
+        }
+      }
+    }
+    THROW_CHECK_EQ(descriptor_idx, num_descriptors);
+    return descriptors;
+  }
+
   descriptors.resize(num_descriptors, 128);
 
   size_t descriptor_row = 0;
@@ -120,6 +151,7 @@ int RunVocabTreeBuilder(int argc, char** argv) {
   std::string vocab_tree_path;
   retrieval::VisualIndex<>::BuildOptions build_options;
   int max_num_images = -1;
+  int max_num_descriptors = -1;
 
   OptionManager options;
   options.AddDatabaseOptions();
@@ -128,12 +160,19 @@ int RunVocabTreeBuilder(int argc, char** argv) {
   options.AddDefaultOption("num_checks", &build_options.num_checks);
   options.AddDefaultOption("branching", &build_options.branching);
   options.AddDefaultOption("num_iterations", &build_options.num_iterations);
+  options.AddDefaultOption("mini_batch_size", &build_options.mini_batch_size);
+  options.AddDefaultOption("num_mini_batch_iterations",
+                           &build_options.num_mini_batch_iterations);
+  options.AddDefaultOption("num_threads", &build_options.num_threads);
+  options.AddDefaultOption("use_gpu", &build_options.use_gpu);
+  options.AddDefaultOption("gpu_index", &build_options.gpu_index);
   options.AddDefaultOption("max_num_images", &max_num_images);
+  options.AddDefaultOption("max_num_descriptors", &max_num_descriptors);
   options.Parse(argc, argv);
 
   LOG(INFO) << "Loading descriptors...";
-  const auto descriptors =
-      LoadRandomDatabaseDescriptors(*options.database_path, max_num_images);
+  const auto descriptors = LoadRandomDatabaseDescriptors(
+      *options.database_path, max_num_images, max_num_descriptors);
   LOG(INFO) << "=> Loaded a total of " << descriptors.rows() << " descriptors";
   THROW_CHECK_GT(descriptors.size(), 0);
 
@@ -171,6 +210,8 @@ int RunVocabTreeRetriever(int argc, char** argv) {
   options.AddDefaultOption("num_checks", &query_options.num_checks);
   options.AddDefaultOption("num_images_after_verification",
                            &query_options.num_images_after_verification);
+  options.AddDefaultOption("max_num_verified_images",
+                           &query_options.max_num_verified_images);
   options.AddDefaultOption("max_num_features", &max_num_features);
   options.Parse(argc, argv);
 
@@ -0,0 +1,154 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/feature/extractor.h"
+
+#include <algorithm>
+
+namespace colmap {
+namespace {
+
+// Offsets of the tiles along one dimension, where the last tile is aligned to
+// the end of the dimension.
+std::vector<int> ComputeTileOffsets(const int size,
+                                    const int tile_size,
+                                    const int tile_overlap) {
+  std::vector<int> offsets = {0};
+  while (offsets.back() + tile_size < size) {
+    offsets.push_back(std::min(offsets.back() + tile_size - tile_overlap,
+                               size - tile_size));
+  }
+  return offsets;
+}
+
+// Interior region of the i-th tile, which ends in the middle of the overlap
+// with its neighboring tiles.
+std::pair<float, float> ComputeTileInterior(const std::vector<int>& offsets,
+                                            const size_t i,
+                                            const int size,
+                                            const int tile_size) {
+  const float begin =
+      i == 0 ? 0.0f : 0.5f * (offsets[i] + offsets[i - 1] + tile_size);
+  const float end = i + 1 == offsets.size()
+                        ? static_cast<float>(size)
+                        : 0.5f * (offsets[i + 1] + offsets[i] + tile_size);
+  return {begin, end};
+}
+
+}  // namespace
+
+bool ExtractFeaturesInTiles(FeatureExtractor* extractor,
+                            const Bitmap& bitmap,
+                            const int tile_size,
+                            const int tile_overlap,
+                            FeatureKeypoints* keypoints,
+                            FeatureDescriptors* descriptors) {
+  THROW_CHECK_NOTNULL(extractor);
+  THROW_CHECK_NOTNULL(keypoints);
+  THROW_CHECK_NOTNULL(descriptors);
+  THROW_CHECK_GT(tile_size, 0);
+  THROW_CHECK_GE(tile_overlap, 0);
+  THROW_CHECK_LT(tile_overlap, tile_size);
+
+  if (bitmap.Width() <= tile_size && bitmap.Height() <= tile_size) {
+    return extractor->Extract(bitmap, keypoints, descriptors);
+  }
+
+  const std::vector<int> tile_xs =
+      ComputeTileOffsets(bitmap.Width(), tile_size, tile_overlap);
+  const std::vector<int> tile_ys =
+      ComputeTileOffsets(bitmap.Height(), tile_size, tile_overlap);
+
+  keypoints->clear();
+  std::vector<FeatureDescriptors> interior_descriptors;
+  size_t num_features = 0;
+
+  for (size_t ty = 0; ty < tile_ys.size(); ++ty) {
+    const int tile_y = tile_ys[ty];
+    const int tile_height = std::min(tile_size, bitmap.Height() - tile_y);
+    const std::pair<float, float> interior_y =
+        ComputeTileInterior(tile_ys, ty, bitmap.Height(), tile_size);
+    for (size_t tx = 0; tx < tile_xs.size(); ++tx) {
+      const int tile_x = tile_xs[tx];
+      const int tile_width = std::min(tile_size, bitmap.Width() - tile_x);
+      const std::pair<float, float> interior_x =
+          ComputeTileInterior(tile_xs, tx, bitmap.Width(), tile_size);
+
+      FeatureKeypoints tile_keypoints;
+      FeatureDescriptors tile_descriptors;
+      if (!extractor->Extract(
+              bitmap.Crop(tile_x, tile_y, tile_width, tile_height),
+              &tile_keypoints,
+              &tile_descriptors)) {
+        return false;
+      }
+
+      std::vector<size_t> interior_indices;
+      for (size_t i = 0; i < tile_keypoints.size(); ++i) {
+        FeatureKeypoint keypoint = tile_keypoints[i];
+        keypoint.x += tile_x;
+        keypoint.y += tile_y;
+        if (keypoint.x >= interior_x.first && keypoint.x < interior_x.second &&
+            keypoint.y >= interior_y.first && keypoint.y < interior_y.second) {
+          keypoints->push_back(keypoint);
+          interior_indices.push_back(i);
+        }
+      }
+
+      FeatureDescriptors tile_interior_descriptors(interior_indices.size(),
+                                                   tile_descriptors.cols());
+      for (size_t i = 0; i < interior_indices.size(); ++i) {
+        tile_interior_descriptors.row(i) =
+            tile_descriptors.row(interior_indices[i]);
+      }
+      num_features += interior_indices.size();
+      interior_descriptors.push_back(std::move(tile_interior_descriptors));
+    }
+  }
+
+  FeatureDescriptors::Index num_cols = 0;
+  for (const FeatureDescriptors& tile_descriptors : interior_descriptors) {
+    num_cols = std::max(num_cols, tile_descriptors.cols());
+  }
+
+  descriptors->resize(num_features, num_cols);
+  FeatureDescriptors::Index row = 0;
+  for (const FeatureDescriptors& tile_descriptors : interior_descriptors) {
+    if (tile_descriptors.rows() == 0) {
+      continue;
+    }
+    descriptors->middleRows(row, tile_descriptors.rows()) = tile_descriptors;
+    row += tile_descriptors.rows();
+  }
+
+  return true;
+}
+
+}  // namespace colmap
@@ -31,6 +31,9 @@
 
 #include "colmap/feature/types.h"
 #include "colmap/sensor/bitmap.h"
+#include "colmap/util/logging.h"
+
+#include <vector>
 
 namespace colmap {
 
@@ -41,6 +44,47 @@ class FeatureExtractor {
   virtual bool Extract(const Bitmap& bitmap,
                        FeatureKeypoints* keypoints,
                        FeatureDescriptors* descriptors) = 0;
+
+  // Extract features for a batch of bitmaps with the same dimensions. Returns
+  // false if the extraction failed for any of the bitmaps. By default, the
+  // bitmaps are processed one by one, while implementations may amortize
+  // their setup cost across the batch.
+  virtual bool ExtractBatch(const std::vector<const Bitmap*>& bitmaps,
+                            std::vector<FeatureKeypoints>* keypoints,
+                            std::vector<FeatureDescriptors>* descriptors);
 };
 
+// Extract features of a large bitmap in overlapping square tiles of the given
+// size, such that the memory of the extractor is bounded by the tile size.
+// Every tile only keeps the features in its interior region, which ends in the
+// middle of the overlap with its neighboring tiles, so features at the tile
+// borders are not duplicated. Bitmaps that fit into a single tile are passed
+// to the extractor as a whole.
+bool ExtractFeaturesInTiles(FeatureExtractor* extractor,
+                            const Bitmap& bitmap,
+                            int tile_size,
+                            int tile_overlap,
+                            FeatureKeypoints* keypoints,
+                            FeatureDescriptors* descriptors);
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+inline bool FeatureExtractor::ExtractBatch(
+    const std::vector<const Bitmap*>& bitmaps,
+    std::vector<FeatureKeypoints>* keypoints,
+    std::vector<FeatureDescriptors>* descriptors) {
+  THROW_CHECK_NOTNULL(keypoints);
+  THROW_CHECK_NOTNULL(descriptors);
+  keypoints->resize(bitmaps.size());
+  descriptors->resize(bitmaps.size());
+  for (size_t i = 0; i < bitmaps.size(); ++i) {
+    if (!Extract(*bitmaps[i], &(*keypoints)[i], &(*descriptors)[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
 }  // namespace colmap
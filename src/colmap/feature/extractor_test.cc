@@ -0,0 +1,128 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/feature/extractor.h"
+
+#include <set>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+// Detects a feature at the center of every bright pixel, whose descriptor
+// stores the value of the pixel to the right.
+class BrightPixelFeatureExtractor : public FeatureExtractor {
+ public:
+  bool Extract(const Bitmap& bitmap,
+               FeatureKeypoints* keypoints,
+               FeatureDescriptors* descriptors) override {
+    EXPECT_LE(bitmap.Width(), max_size);
+    EXPECT_LE(bitmap.Height(), max_size);
+    keypoints->clear();
+    std::vector<uint8_t> values;
+    BitmapColor<uint8_t> color;
+    for (int y = 0; y < bitmap.Height(); ++y) {
+      for (int x = 0; x < bitmap.Width(); ++x) {
+        if (bitmap.GetPixel(x, y, &color) && color.r == 255) {
+          keypoints->emplace_back(x + 0.5f, y + 0.5f);
+          values.push_back(bitmap.GetPixel(x + 1, y, &color) ? color.r : 0);
+        }
+      }
+    }
+    descriptors->resize(keypoints->size(), 1);
+    for (size_t i = 0; i < values.size(); ++i) {
+      (*descriptors)(i, 0) = values[i];
+    }
+    return true;
+  }
+
+  int max_size = std::numeric_limits<int>::max();
+};
+
+TEST(ExtractFeaturesInTiles, Nominal) {
+  Bitmap bitmap;
+  bitmap.Allocate(100, 60, false);
+  bitmap.Fill(BitmapColor<uint8_t>(0));
+  std::set<std::pair<int, int>> bright_pixels;
+  for (int y = 0; y < bitmap.Height(); y += 3) {
+    for (int x = 0; x < bitmap.Width(); x += 7) {
+      bitmap.SetPixel(x, y, BitmapColor<uint8_t>(255));
+      bitmap.SetPixel(x + 1, y, BitmapColor<uint8_t>(x % 200));
+      bright_pixels.emplace(x, y);
+    }
+  }
+
+  BrightPixelFeatureExtractor extractor;
+  extractor.max_size = 32;
+
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  EXPECT_TRUE(ExtractFeaturesInTiles(&extractor,
+                                     bitmap,
+                                     /*tile_size=*/32,
+                                     /*tile_overlap=*/8,
+                                     &keypoints,
+                                     &descriptors));
+  ASSERT_EQ(keypoints.size(), bright_pixels.size());
+  ASSERT_EQ(descriptors.rows(), keypoints.size());
+
+  std::set<std::pair<int, int>> detected_pixels;
+  for (size_t i = 0; i < keypoints.size(); ++i) {
+    const int x = static_cast<int>(keypoints[i].x);
+    const int y = static_cast<int>(keypoints[i].y);
+    EXPECT_TRUE(detected_pixels.emplace(x, y).second);
+    EXPECT_EQ(descriptors(i, 0), x % 200);
+  }
+  EXPECT_EQ(detected_pixels, bright_pixels);
+}
+
+TEST(ExtractFeaturesInTiles, SingleTile) {
+  Bitmap bitmap;
+  bitmap.Allocate(20, 10, false);
+  bitmap.Fill(BitmapColor<uint8_t>(0));
+  bitmap.SetPixel(3, 4, BitmapColor<uint8_t>(255));
+
+  BrightPixelFeatureExtractor extractor;
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  EXPECT_TRUE(ExtractFeaturesInTiles(&extractor,
+                                     bitmap,
+                                     /*tile_size=*/32,
+                                     /*tile_overlap=*/8,
+                                     &keypoints,
+                                     &descriptors));
+  ASSERT_EQ(keypoints.size(), 1);
+  EXPECT_EQ(keypoints[0].x, 3.5f);
+  EXPECT_EQ(keypoints[0].y, 4.5f);
+}
+
+}  // namespace
+}  // namespace colmap
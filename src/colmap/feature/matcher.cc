@@ -29,13 +29,33 @@
 
 #include "colmap/feature/matcher.h"
 
+#include <algorithm>
+
 namespace colmap {
 
+void FeatureMatcher::MatchBatch(
+    const std::shared_ptr<const FeatureDescriptors>& query_descriptors,
+    const std::vector<std::shared_ptr<const FeatureDescriptors>>&
+        target_descriptors,
+    std::vector<FeatureMatches>* matches) {
+  THROW_CHECK_NOTNULL(matches);
+  matches->resize(target_descriptors.size());
+  for (size_t i = 0; i < target_descriptors.size(); ++i) {
+    // After the first target, the query is identical to the previous call.
+    Match(i == 0 ? query_descriptors : nullptr,
+          target_descriptors[i],
+          &(*matches)[i]);
+  }
+}
+
 FeatureMatcherCache::FeatureMatcherCache(const size_t cache_size,
                                          std::shared_ptr<Database> database,
                                          const bool do_setup)
     : cache_size_(cache_size),
-      database_(std::move(THROW_CHECK_NOTNULL(database))) {
+      database_(std::move(THROW_CHECK_NOTNULL(database))),
+      num_reads_(0),
+      num_loaded_bytes_(0),
+      memory_account_("FeatureMatcherCache") {
   if (do_setup) {
     Setup();
   }
@@ -54,27 +74,41 @@ void FeatureMatcherCache::Setup() {
     images_cache_.emplace(image.ImageId(), std::move(image));
   }
 
-  locations_priors_cache_.reserve(database_->NumPosePriors());
-  for (const auto& id_and_image : images_cache_) {
-    if (database_->ExistsPosePrior(id_and_image.first)) {
-      locations_priors_cache_.emplace(
-          id_and_image.first, database_->ReadPosePrior(id_and_image.first));
-    }
-  }
+  locations_priors_cache_ = database_->ReadAllPosePriors();
 
-  keypoints_cache_ =
-      std::make_unique<LRUCache<image_t, std::shared_ptr<FeatureKeypoints>>>(
-          cache_size_, [this](const image_t image_id) {
-            return std::make_shared<FeatureKeypoints>(
-                database_->ReadKeypoints(image_id));
-          });
+  keypoints_cache_ = std::make_unique<
+      ThreadSafeLRUCache<image_t, std::shared_ptr<FeatureKeypoints>>>(
+      cache_size_, [this](const image_t image_id) {
+        std::shared_ptr<FeatureKeypoints> keypoints;
+        const Database* read_database = GetReadDatabase();
+        if (read_database == nullptr) {
+          std::lock_guard<std::mutex> lock(database_mutex_);
+          keypoints = std::make_shared<FeatureKeypoints>(
+              database_->ReadKeypoints(image_id));
+        } else {
+          keypoints = std::make_shared<FeatureKeypoints>(
+              read_database->ReadKeypoints(image_id));
+        }
+        UpdateMemoryAccount(keypoints->size() * sizeof(FeatureKeypoint), 1);
+        return keypoints;
+      });
 
-  descriptors_cache_ =
-      std::make_unique<LRUCache<image_t, std::shared_ptr<FeatureDescriptors>>>(
-          cache_size_, [this](const image_t image_id) {
-            return std::make_shared<FeatureDescriptors>(
-                database_->ReadDescriptors(image_id));
-          });
+  descriptors_cache_ = std::make_unique<
+      ThreadSafeLRUCache<image_t, std::shared_ptr<FeatureDescriptors>>>(
+      cache_size_, [this](const image_t image_id) {
+        std::shared_ptr<FeatureDescriptors> descriptors;
+        const Database* read_database = GetReadDatabase();
+        if (read_database == nullptr) {
+          std::lock_guard<std::mutex> lock(database_mutex_);
+          descriptors = std::make_shared<FeatureDescriptors>(
+              database_->ReadDescriptors(image_id));
+        } else {
+          descriptors = std::make_shared<FeatureDescriptors>(
+              read_database->ReadDescriptors(image_id));
+        }
+        UpdateMemoryAccount(descriptors->size(), 1);
+        return descriptors;
+      });
 
   keypoints_exists_cache_ = std::make_unique<LRUCache<image_t, bool>>(
       images_cache_.size(), [this](const image_t image_id) {
@@ -87,6 +121,23 @@ void FeatureMatcherCache::Setup() {
       });
 }
 
+FeatureMatcherCache::Stats FeatureMatcherCache::GetStats() {
+  const auto keypoints_stats = keypoints_cache_->GetStats();
+  const auto descriptors_stats = descriptors_cache_->GetStats();
+  Stats stats;
+  stats.num_hits = keypoints_stats.num_hits + descriptors_stats.num_hits;
+  stats.num_requests = stats.num_hits + keypoints_stats.num_misses +
+                       descriptors_stats.num_misses;
+  stats.num_reads = num_reads_;
+  return stats;
+}
+
+size_t FeatureMatcherCache::CacheSize() const { return cache_size_; }
+
+bool FeatureMatcherCache::HasCachedDescriptors(const image_t image_id) {
+  return descriptors_cache_->Exists(image_id);
+}
+
 const Camera& FeatureMatcherCache::GetCamera(const camera_t camera_id) const {
   return cameras_cache_.at(camera_id);
 }
@@ -102,13 +153,11 @@ const PosePrior& FeatureMatcherCache::GetPosePrior(
 
 std::shared_ptr<FeatureKeypoints> FeatureMatcherCache::GetKeypoints(
     const image_t image_id) {
-  std::lock_guard<std::mutex> lock(database_mutex_);
   return keypoints_cache_->Get(image_id);
 }
 
 std::shared_ptr<FeatureDescriptors> FeatureMatcherCache::GetDescriptors(
     const image_t image_id) {
-  std::lock_guard<std::mutex> lock(database_mutex_);
   return descriptors_cache_->Get(image_id);
 }
 
@@ -127,6 +176,62 @@ std::vector<image_t> FeatureMatcherCache::GetImageIds() const {
   return image_ids;
 }
 
+void FeatureMatcherCache::Prefetch(const std::vector<image_t>& image_ids,
+                                   const bool prefetch_descriptors) {
+  std::lock_guard<std::mutex> lock(database_mutex_);
+
+  std::vector<image_t> keypoints_image_ids;
+  std::vector<image_t> descriptors_image_ids;
+  const size_t num_image_ids = std::min(image_ids.size(), cache_size_);
+  for (size_t i = 0; i < num_image_ids; ++i) {
+    // Cached images are marked as recently used, so that they are not evicted
+    // by the images loaded below.
+    if (!keypoints_cache_->Touch(image_ids[i])) {
+      keypoints_image_ids.push_back(image_ids[i]);
+    }
+    if (prefetch_descriptors && !descriptors_cache_->Touch(image_ids[i])) {
+      descriptors_image_ids.push_back(image_ids[i]);
+    }
+  }
+
+  size_t num_loaded_bytes = 0;
+
+  std::vector<FeatureKeypoints> keypoints =
+      database_->ReadKeypoints(keypoints_image_ids);
+  for (size_t i = 0; i < keypoints_image_ids.size(); ++i) {
+    num_loaded_bytes += keypoints[i].size() * sizeof(FeatureKeypoint);
+    keypoints_cache_->Set(
+        keypoints_image_ids[i],
+        std::make_shared<FeatureKeypoints>(std::move(keypoints[i])));
+  }
+
+  std::vector<FeatureDescriptors> descriptors =
+      database_->ReadDescriptors(descriptors_image_ids);
+  for (size_t i = 0; i < descriptors_image_ids.size(); ++i) {
+    num_loaded_bytes += descriptors[i].size();
+    descriptors_cache_->Set(
+        descriptors_image_ids[i],
+        std::make_shared<FeatureDescriptors>(std::move(descriptors[i])));
+  }
+
+  UpdateMemoryAccount(num_loaded_bytes,
+                      keypoints_image_ids.size() + descriptors_image_ids.size());
+}
+
+void FeatureMatcherCache::UpdateMemoryAccount(const size_t num_loaded_bytes,
+                                              const size_t num_loads) {
+  num_loaded_bytes_ += num_loaded_bytes;
+  num_reads_ += num_loads;
+  const size_t num_reads = num_reads_;
+  if (num_reads == 0) {
+    return;
+  }
+  const size_t mean_num_bytes = num_loaded_bytes_ / num_reads;
+  memory_account_.SetNumBytes(
+      mean_num_bytes *
+      (keypoints_cache_->NumElems() + descriptors_cache_->NumElems()));
+}
+
 bool FeatureMatcherCache::ExistsPosePrior(const image_t image_id) const {
   return locations_priors_cache_.find(image_id) !=
          locations_priors_cache_.end();
@@ -181,4 +286,32 @@ void FeatureMatcherCache::DeleteInlierMatches(const image_t image_id1,
   database_->DeleteInlierMatches(image_id1, image_id2);
 }
 
+void FeatureMatcherCache::BeginTransaction() {
+  std::lock_guard<std::mutex> lock(database_mutex_);
+  THROW_CHECK(database_transaction_ == nullptr);
+  database_transaction_ = std::make_unique<DatabaseTransaction>(database_.get());
+}
+
+void FeatureMatcherCache::EndTransaction() {
+  std::lock_guard<std::mutex> lock(database_mutex_);
+  THROW_CHECK_NOTNULL(database_transaction_);
+  database_transaction_.reset();
+}
+
+const Database* FeatureMatcherCache::GetReadDatabase() {
+  std::lock_guard<std::mutex> lock(read_databases_mutex_);
+  auto it = read_databases_.find(std::this_thread::get_id());
+  if (it == read_databases_.end()) {
+    std::unique_ptr<Database> read_database;
+    {
+      std::lock_guard<std::mutex> database_lock(database_mutex_);
+      read_database = database_->OpenReadOnlyConnection();
+    }
+    it = read_databases_
+             .emplace(std::this_thread::get_id(), std::move(read_database))
+             .first;
+  }
+  return it->second.get();
+}
+
 }  // namespace colmap
@@ -36,11 +36,15 @@
 #include "colmap/scene/image.h"
 #include "colmap/scene/two_view_geometry.h"
 #include "colmap/util/cache.h"
+#include "colmap/util/memory_budget.h"
 #include "colmap/util/types.h"
 
+#include <atomic>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 namespace colmap {
 
@@ -67,9 +71,23 @@ class FeatureMatcher {
       const std::shared_ptr<const FeatureDescriptors>& descriptors1,
       const std::shared_ptr<const FeatureDescriptors>& descriptors2,
       TwoViewGeometry* two_view_geometry) = 0;
+
+  // Match one query against many target feature sets, such that the search
+  // structures of the query are only set up once. The matches are returned in
+  // the order of the targets. A nullptr query is identical to the previous
+  // call. The default implementation forwards to the pairwise `Match`.
+  virtual void MatchBatch(
+      const std::shared_ptr<const FeatureDescriptors>& query_descriptors,
+      const std::vector<std::shared_ptr<const FeatureDescriptors>>&
+          target_descriptors,
+      std::vector<FeatureMatches>* matches);
 };
 
 // Cache for feature matching to minimize database access during matching.
+// Keypoints and descriptors missing in the cache are read through a separate
+// read-only database connection per calling thread, if the database supports
+// it, so that concurrent workers do not serialize on the shared connection.
+// All other database access goes through the shared connection.
 class FeatureMatcherCache {
  public:
   FeatureMatcherCache(size_t cache_size,
@@ -78,6 +96,23 @@ class FeatureMatcherCache {
 
   void Setup();
 
+  // Statistics about the keypoint and descriptor requests. A request is a hit,
+  // if the features are already in the cache. Reads count the feature sets
+  // read from the database, including prefetched ones.
+  struct Stats {
+    size_t num_requests = 0;
+    size_t num_hits = 0;
+    size_t num_reads = 0;
+  };
+
+  Stats GetStats();
+
+  // The maximum number of images with cached keypoints and descriptors.
+  size_t CacheSize() const;
+
+  // Whether the descriptors of the image are in the cache.
+  bool HasCachedDescriptors(image_t image_id);
+
   const Camera& GetCamera(camera_t camera_id) const;
   const Image& GetImage(image_t image_id) const;
   const PosePrior& GetPosePrior(image_t image_id) const;
@@ -86,6 +121,12 @@ class FeatureMatcherCache {
   FeatureMatches GetMatches(image_t image_id1, image_t image_id2);
   std::vector<image_t> GetImageIds() const;
 
+  // Load the keypoints and optionally the descriptors of the given images into
+  // the cache using batched database reads. Images already in the cache are
+  // skipped and at most as many images as fit into the cache are loaded.
+  void Prefetch(const std::vector<image_t>& image_ids,
+                bool prefetch_descriptors = true);
+
   bool ExistsPosePrior(image_t image_id) const;
   bool ExistsKeypoints(image_t image_id);
   bool ExistsDescriptors(image_t image_id);
@@ -103,19 +144,41 @@ class FeatureMatcherCache {
   void DeleteMatches(image_t image_id1, image_t image_id2);
   void DeleteInlierMatches(image_t image_id1, image_t image_id2);
 
+  // Begin and end a transaction on the shared database connection to combine
+  // multiple writes. Both must be called from the same thread.
+  void BeginTransaction();
+  void EndTransaction();
+
  private:
+  // Get the read-only connection of the calling thread or null, if the
+  // database does not support additional connections.
+  const Database* GetReadDatabase();
+
+  // Report the approximate size of the cached features to the global memory
+  // budget, estimated from the mean size of all loaded feature sets.
+  void UpdateMemoryAccount(size_t num_loaded_bytes, size_t num_loads);
+
   const size_t cache_size_;
   const std::shared_ptr<Database> database_;
   std::mutex database_mutex_;
+  std::mutex read_databases_mutex_;
+  std::unordered_map<std::thread::id, std::unique_ptr<Database>>
+      read_databases_;
+  std::unique_ptr<DatabaseTransaction> database_transaction_;
   std::unordered_map<camera_t, Camera> cameras_cache_;
   std::unordered_map<image_t, Image> images_cache_;
   std::unordered_map<image_t, PosePrior> locations_priors_cache_;
-  std::unique_ptr<LRUCache<image_t, std::shared_ptr<FeatureKeypoints>>>
+  std::unique_ptr<
+      ThreadSafeLRUCache<image_t, std::shared_ptr<FeatureKeypoints>>>
       keypoints_cache_;
-  std::unique_ptr<LRUCache<image_t, std::shared_ptr<FeatureDescriptors>>>
+  std::unique_ptr<
+      ThreadSafeLRUCache<image_t, std::shared_ptr<FeatureDescriptors>>>
       descriptors_cache_;
   std::unique_ptr<LRUCache<image_t, bool>> keypoints_exists_cache_;
   std::unique_ptr<LRUCache<image_t, bool>> descriptors_exists_cache_;
+  std::atomic<size_t> num_reads_;
+  std::atomic<size_t> num_loaded_bytes_;
+  MemoryAccount memory_account_;
 };
 
 }  // namespace colmap
@@ -31,19 +31,66 @@
 
 #include "colmap/feature/utils.h"
 #include "colmap/geometry/gps.h"
+#include "colmap/math/math.h"
 #include "colmap/util/logging.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/timer.h"
 
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
+#include <future>
 #include <numeric>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+
 namespace colmap {
 namespace {
 
+std::vector<image_t> GetQueryImageIds(
+    const std::string& match_list_path,
+    FeatureMatcherCache& cache,
+    const std::vector<image_t>& query_image_ids) {
+  if (query_image_ids.size() > 0) {
+    return query_image_ids;
+  } else if (match_list_path == "") {
+    return cache.GetImageIds();
+  }
+
+  // Map image names to image identifiers.
+  const std::vector<image_t> all_image_ids = cache.GetImageIds();
+  std::unordered_map<std::string, image_t> image_name_to_image_id;
+  image_name_to_image_id.reserve(all_image_ids.size());
+  for (const auto image_id : all_image_ids) {
+    const auto& image = cache.GetImage(image_id);
+    image_name_to_image_id.emplace(image.Name(), image_id);
+  }
+
+  // Read the match list path.
+  std::vector<image_t> match_list_image_ids;
+  std::ifstream file(match_list_path);
+  THROW_CHECK_FILE_OPEN(file, match_list_path);
+  std::string line;
+  while (std::getline(file, line)) {
+    StringTrim(&line);
+
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    if (image_name_to_image_id.count(line) == 0) {
+      LOG(ERROR) << "Image " << line << " does not exist.";
+    } else {
+      match_list_image_ids.push_back(image_name_to_image_id.at(line));
+    }
+  }
+  return match_list_image_ids;
+}
+
 std::vector<std::pair<image_t, image_t>> ReadImagePairsText(
     const std::string& path,
     const std::unordered_map<std::string, image_t>& image_name_to_image_id) {
@@ -102,6 +149,10 @@ bool VocabTreeMatchingOptions::Check() const {
   CHECK_OPTION_GT(num_images, 0);
   CHECK_OPTION_GT(num_nearest_neighbors, 0);
   CHECK_OPTION_GT(num_checks, 0);
+  CHECK_OPTION_GT(max_document_frequency, 0);
+  CHECK_OPTION_LE(max_document_frequency, 1);
+  CHECK_OPTION_GT(global_descriptor_num_clusters, 0);
+  CHECK_OPTION_GT(global_descriptor_num_probes, 0);
   return true;
 }
 
@@ -111,6 +162,12 @@ bool SequentialMatchingOptions::Check() const {
   CHECK_OPTION_GT(loop_detection_num_images, 0);
   CHECK_OPTION_GT(loop_detection_num_nearest_neighbors, 0);
   CHECK_OPTION_GT(loop_detection_num_checks, 0);
+  if (online) {
+    // New images are detected by the missing pair with their predecessor.
+    CHECK_OPTION(overlap > 1 || quadratic_overlap);
+  }
+  CHECK_OPTION_GE(rig_max_view_angle, 0.0);
+  CHECK_OPTION_LE(rig_max_view_angle, 180.0);
   return true;
 }
 
@@ -123,12 +180,15 @@ VocabTreeMatchingOptions SequentialMatchingOptions::VocabTreeOptions() const {
       loop_detection_num_images_after_verification;
   options.max_num_features = loop_detection_max_num_features;
   options.vocab_tree_path = vocab_tree_path;
+  options.index_path = loop_detection_index_path;
   return options;
 }
 
 bool SpatialMatchingOptions::Check() const {
   CHECK_OPTION_GT(max_num_neighbors, 0);
   CHECK_OPTION_GT(max_distance, 0.0);
+  CHECK_OPTION_GE(rig_max_view_angle, 0.0);
+  CHECK_OPTION_LE(rig_max_view_angle, 180.0);
   return true;
 }
 
@@ -163,9 +223,15 @@ ExhaustivePairGenerator::ExhaustivePairGenerator(
       image_ids_(THROW_CHECK_NOTNULL(cache)->GetImageIds()),
       block_size_(static_cast<size_t>(options_.block_size)),
       num_blocks_(static_cast<size_t>(
-          std::ceil(static_cast<double>(image_ids_.size()) / block_size_))) {
+          std::ceil(static_cast<double>(image_ids_.size()) / block_size_))),
+      tile_size_(std::max<size_t>(1, cache->CacheSize() / 3)) {
   THROW_CHECK(options.Check());
   LOG(INFO) << "Generating exhaustive image pairs...";
+  if (tile_size_ < block_size_) {
+    LOG(INFO) << StringPrintf(
+        "Matching blocks in tiles of %d images to fit into the cache",
+        tile_size_);
+  }
   const size_t num_pairs_per_block = block_size_ * (block_size_ - 1) / 2;
   image_pairs_.reserve(num_pairs_per_block);
 }
@@ -194,24 +260,48 @@ std::vector<std::pair<image_t, image_t>> ExhaustivePairGenerator::Next() {
     return image_pairs_;
   }
 
+  // Traverse the second blocks in alternating directions, such that the
+  // features of the last block remain in the cache for the next row of blocks.
+  const size_t block_idx1 = start_idx1_ / block_size_;
+  const size_t block_idx2 = block_idx1 % 2 == 0
+                                ? start_idx2_ / block_size_
+                                : num_blocks_ - 1 - start_idx2_ / block_size_;
+  const size_t start_idx2 = block_idx2 * block_size_;
+
   const size_t end_idx1 =
       std::min(image_ids_.size(), start_idx1_ + block_size_) - 1;
   const size_t end_idx2 =
-      std::min(image_ids_.size(), start_idx2_ + block_size_) - 1;
+      std::min(image_ids_.size(), start_idx2 + block_size_) - 1;
 
   LOG(INFO) << StringPrintf("Matching block [%d/%d, %d/%d]",
-                            start_idx1_ / block_size_ + 1,
+                            block_idx1 + 1,
                             num_blocks_,
-                            start_idx2_ / block_size_ + 1,
+                            block_idx2 + 1,
                             num_blocks_);
 
-  for (size_t idx1 = start_idx1_; idx1 <= end_idx1; ++idx1) {
-    for (size_t idx2 = start_idx2_; idx2 <= end_idx2; ++idx2) {
-      const size_t block_id1 = idx1 % block_size_;
-      const size_t block_id2 = idx2 % block_size_;
-      if ((idx1 > idx2 && block_id1 <= block_id2) ||
-          (idx1 < idx2 && block_id1 < block_id2)) {  // Avoid duplicate pairs
-        image_pairs_.emplace_back(image_ids_[idx1], image_ids_[idx2]);
+  // Enumerate the pairs in tiles whose images fit into the cache, again in
+  // alternating directions. Without a small cache, a single tile spans the
+  // block.
+  const size_t num_tiles2 = (end_idx2 - start_idx2) / tile_size_ + 1;
+  for (size_t tile_idx1 = 0; start_idx1_ + tile_idx1 * tile_size_ <= end_idx1;
+       ++tile_idx1) {
+    const size_t tile_start_idx1 = start_idx1_ + tile_idx1 * tile_size_;
+    const size_t tile_end_idx1 =
+        std::min(end_idx1, tile_start_idx1 + tile_size_ - 1);
+    for (size_t i = 0; i < num_tiles2; ++i) {
+      const size_t tile_idx2 = tile_idx1 % 2 == 0 ? i : num_tiles2 - 1 - i;
+      const size_t tile_start_idx2 = start_idx2 + tile_idx2 * tile_size_;
+      const size_t tile_end_idx2 =
+          std::min(end_idx2, tile_start_idx2 + tile_size_ - 1);
+      for (size_t idx1 = tile_start_idx1; idx1 <= tile_end_idx1; ++idx1) {
+        for (size_t idx2 = tile_start_idx2; idx2 <= tile_end_idx2; ++idx2) {
+          const size_t block_id1 = idx1 % block_size_;
+          const size_t block_id2 = idx2 % block_size_;
+          if ((idx1 > idx2 && block_id1 <= block_id2) ||
+              (idx1 < idx2 && block_id1 < block_id2)) {  // Avoid duplicates
+            image_pairs_.emplace_back(image_ids_[idx1], image_ids_[idx2]);
+          }
+        }
       }
     }
   }
@@ -223,6 +313,79 @@ std::vector<std::pair<image_t, image_t>> ExhaustivePairGenerator::Next() {
   return image_pairs_;
 }
 
+CameraRigPairFilter::CameraRigPairFilter(
+    const std::vector<CameraRig>& camera_rigs, const double max_view_angle)
+    // The tolerance keeps cameras at exactly the maximum angle overlapping.
+    : min_cos_view_angle_(std::cos(DegToRad(max_view_angle)) - 1e-6) {
+  THROW_CHECK_GE(max_view_angle, 0);
+  THROW_CHECK_LE(max_view_angle, 180);
+  for (size_t rig_idx = 0; rig_idx < camera_rigs.size(); ++rig_idx) {
+    const CameraRig& camera_rig = camera_rigs[rig_idx];
+    for (const camera_t camera_id : camera_rig.GetCameraIds()) {
+      // The viewing direction is the z-axis of the camera in the rig frame.
+      const Eigen::Vector3d view_dir =
+          camera_rig.CamFromRig(camera_id).rotation.inverse() *
+          Eigen::Vector3d::UnitZ();
+      THROW_CHECK(
+          rig_cameras_.emplace(camera_id, RigCamera{rig_idx, view_dir}).second)
+          << "Camera " << camera_id << " is part of multiple rigs";
+    }
+  }
+}
+
+CameraRigPairFilter CameraRigPairFilter::Read(
+    const std::string& rig_config_path, const double max_view_angle) {
+  boost::property_tree::ptree pt;
+  boost::property_tree::read_json(rig_config_path.c_str(), pt);
+
+  std::vector<CameraRig> camera_rigs;
+  for (const auto& rig_config : pt) {
+    CameraRig camera_rig;
+    for (const auto& camera : rig_config.second.get_child("cameras")) {
+      const auto cam_from_rig_rotation_node =
+          camera.second.get_child_optional("cam_from_rig_rotation");
+      if (!cam_from_rig_rotation_node) {
+        continue;
+      }
+
+      int index = 0;
+      Eigen::Vector4d cam_from_rig_wxyz;
+      for (const auto& node : cam_from_rig_rotation_node.get()) {
+        THROW_CHECK_LT(index, 4);
+        cam_from_rig_wxyz[index++] = node.second.get_value<double>();
+      }
+      THROW_CHECK_EQ(index, 4);
+
+      Rigid3d cam_from_rig;
+      cam_from_rig.rotation = Eigen::Quaterniond(cam_from_rig_wxyz(0),
+                                                 cam_from_rig_wxyz(1),
+                                                 cam_from_rig_wxyz(2),
+                                                 cam_from_rig_wxyz(3))
+                                  .normalized();
+      camera_rig.AddCamera(camera.second.get<camera_t>("camera_id"),
+                           cam_from_rig);
+    }
+    camera_rigs.push_back(std::move(camera_rig));
+  }
+
+  return CameraRigPairFilter(camera_rigs, max_view_angle);
+}
+
+bool CameraRigPairFilter::IsOverlapping(const camera_t camera_id1,
+                                        const camera_t camera_id2) const {
+  if (camera_id1 == camera_id2) {
+    return true;
+  }
+  const auto rig_camera1 = rig_cameras_.find(camera_id1);
+  const auto rig_camera2 = rig_cameras_.find(camera_id2);
+  if (rig_camera1 == rig_cameras_.end() || rig_camera2 == rig_cameras_.end() ||
+      rig_camera1->second.rig_idx != rig_camera2->second.rig_idx) {
+    return true;
+  }
+  return rig_camera1->second.view_dir.dot(rig_camera2->second.view_dir) >=
+         min_cos_view_angle_;
+}
+
 VocabTreePairGenerator::VocabTreePairGenerator(
     const VocabTreeMatchingOptions& options,
     std::shared_ptr<FeatureMatcherCache> cache,
@@ -230,45 +393,15 @@ VocabTreePairGenerator::VocabTreePairGenerator(
     : options_(options),
       cache_(std::move(THROW_CHECK_NOTNULL(cache))),
       thread_pool(options_.num_threads),
-      queue(options_.num_threads) {
+      queue(options_.num_threads),
+      prefetch_thread_pool_(1) {
   THROW_CHECK(options.Check());
   LOG(INFO) << "Generating image pairs with vocabulary tree...";
 
-  // Read the pre-trained vocabulary tree from disk.
-  visual_index_.Read(options_.vocab_tree_path);
-
   const std::vector<image_t> all_image_ids = cache_->GetImageIds();
-  if (query_image_ids.size() > 0) {
-    query_image_ids_ = query_image_ids;
-  } else if (options_.match_list_path == "") {
-    query_image_ids_ = cache_->GetImageIds();
-  } else {
-    // Map image names to image identifiers.
-    std::unordered_map<std::string, image_t> image_name_to_image_id;
-    image_name_to_image_id.reserve(all_image_ids.size());
-    for (const auto image_id : all_image_ids) {
-      const auto& image = cache_->GetImage(image_id);
-      image_name_to_image_id.emplace(image.Name(), image_id);
-    }
-
-    // Read the match list path.
-    std::ifstream file(options_.match_list_path);
-    THROW_CHECK_FILE_OPEN(file, options_.match_list_path);
-    std::string line;
-    while (std::getline(file, line)) {
-      StringTrim(&line);
-
-      if (line.empty() || line[0] == '#') {
-        continue;
-      }
-
-      if (image_name_to_image_id.count(line) == 0) {
-        LOG(ERROR) << "Image " << line << " does not exist.";
-      } else {
-        query_image_ids_.push_back(image_name_to_image_id.at(line));
-      }
-    }
-  }
+  ReadVisualIndex(all_image_ids);
+  query_image_ids_ =
+      GetQueryImageIds(options_.match_list_path, *cache_, query_image_ids);
 
   IndexImages(all_image_ids);
 
@@ -277,6 +410,11 @@ VocabTreePairGenerator::VocabTreePairGenerator(
   query_options_.num_checks = options_.num_checks;
   query_options_.num_images_after_verification =
       options_.num_images_after_verification;
+  // The queries are already parallelized over images in the thread pool, so
+  // each nearest neighbor search runs single-threaded to not oversubscribe.
+  query_options_.num_threads = 1;
+  query_options_.use_gpu = options_.use_gpu;
+  query_options_.gpu_index = options_.gpu_index;
 }
 
 VocabTreePairGenerator::VocabTreePairGenerator(
@@ -304,24 +442,21 @@ std::vector<std::pair<image_t, image_t>> VocabTreePairGenerator::Next() {
   if (HasFinished()) {
     return image_pairs_;
   }
-  if (query_idx_ == 0) {
-    // Initially, make all retrieval threads busy and continue with the
-    // matching.
-    const size_t init_num_tasks =
-        std::min(query_image_ids_.size(), 2 * thread_pool.NumThreads());
-    for (; query_idx_ < init_num_tasks; ++query_idx_) {
-      thread_pool.AddTask(
-          &VocabTreePairGenerator::Query, this, query_image_ids_[query_idx_]);
-    }
-  }
-
   LOG(INFO) << StringPrintf(
       "Matching image [%d/%d]", result_idx_ + 1, query_image_ids_.size());
 
-  // Push the next image to the retrieval queue.
-  if (query_idx_ < query_image_ids_.size()) {
-    thread_pool.AddTask(
-        &VocabTreePairGenerator::Query, this, query_image_ids_[query_idx_++]);
+  // Keep the retrieval threads busy by prefetching the features of the next
+  // images in batches, while the matching continues. The number of images
+  // ahead of the matching is bounded to limit the memory usage.
+  const size_t num_threads = thread_pool.NumThreads();
+  const size_t max_query_idx =
+      std::min(query_image_ids_.size(), result_idx_ + 2 * num_threads + 1);
+  while (query_idx_ < max_query_idx) {
+    const size_t end =
+        std::min(query_idx_ + num_threads, query_image_ids_.size());
+    prefetch_thread_pool_.AddTask(
+        &VocabTreePairGenerator::Prefetch, this, query_idx_, end);
+    query_idx_ = end;
   }
 
   // Pop the next results from the retrieval queue.
@@ -331,72 +466,351 @@ std::vector<std::pair<image_t, image_t>> VocabTreePairGenerator::Next() {
   const auto& image_id = retrieval.Data().image_id;
   const auto& image_scores = retrieval.Data().image_scores;
 
-  // Compose the image pairs from the scores.
+  // Compose the image pairs from the scores. Retrieved images, whose features
+  // are still cached from previous queries, are matched first before they are
+  // evicted by the other images.
   image_pairs_.reserve(image_scores.size());
   for (const auto image_score : image_scores) {
     image_pairs_.emplace_back(image_id, image_score.image_id);
   }
+  std::stable_partition(
+      image_pairs_.begin(),
+      image_pairs_.end(),
+      [this](const std::pair<image_t, image_t>& image_pair) {
+        return cache_->HasCachedDescriptors(image_pair.second);
+      });
   ++result_idx_;
   return image_pairs_;
 }
 
+void VocabTreePairGenerator::ReadVisualIndex(
+    const std::vector<image_t>& image_ids) {
+  if (!options_.index_path.empty() && ExistsFile(options_.index_path)) {
+    LOG(INFO) << "Reading visual index " << options_.index_path;
+    visual_index_.Read(options_.index_path);
+
+    // The inverted files cannot be pruned, so images that were deleted from
+    // the database since writing the index require indexing from scratch.
+    const std::unordered_set<image_t> image_ids_set(image_ids.begin(),
+                                                    image_ids.end());
+    bool index_up_to_date = true;
+    for (const int image_id : visual_index_.ImageIds()) {
+      if (image_ids_set.count(image_id) == 0) {
+        index_up_to_date = false;
+        break;
+      }
+    }
+    if (!index_up_to_date) {
+      LOG(WARNING) << "Visual index contains images that are not in the "
+                      "database, indexing all images again";
+    } else if (visual_index_.IsCompact() &&
+               options_.num_images_after_verification > 0) {
+      LOG(WARNING) << "Visual index is compact and cannot be used for "
+                      "spatial verification, indexing all images again";
+    } else {
+      return;
+    }
+  }
+
+  // Read the pre-trained vocabulary tree from disk.
+  visual_index_.Read(options_.vocab_tree_path);
+}
+
 void VocabTreePairGenerator::IndexImages(
     const std::vector<image_t>& image_ids) {
   retrieval::VisualIndex<>::IndexOptions index_options;
   index_options.num_threads = options_.num_threads;
   index_options.num_checks = options_.num_checks;
+  index_options.use_gpu = options_.use_gpu;
+  index_options.gpu_index = options_.gpu_index;
+
+  std::vector<image_t> new_image_ids;
+  new_image_ids.reserve(image_ids.size());
+  for (const image_t image_id : image_ids) {
+    if (!visual_index_.ImageIndexed(image_id)) {
+      new_image_ids.push_back(image_id);
+    }
+  }
+
+  if (new_image_ids.size() < image_ids.size()) {
+    LOG(INFO) << StringPrintf("Skipping %d already indexed images",
+                              image_ids.size() - new_image_ids.size());
+  }
+
+  // Quantize the descriptors of multiple images in one batched search, which
+  // amortizes the search overhead and parallelizes over more descriptors.
+  const size_t kBatchSize = 32;
+  std::vector<int> batch_image_ids;
+  std::vector<FeatureKeypoints> batch_keypoints;
+  std::vector<retrieval::VisualIndex<>::DescType> batch_descriptors;
+  for (size_t begin = 0; begin < new_image_ids.size(); begin += kBatchSize) {
+    const size_t end = std::min(begin + kBatchSize, new_image_ids.size());
 
-  for (size_t i = 0; i < image_ids.size(); ++i) {
     Timer timer;
     timer.Start();
     LOG(INFO) << StringPrintf(
-        "Indexing image [%d/%d]", i + 1, image_ids.size());
-    auto keypoints = *cache_->GetKeypoints(image_ids[i]);
-    auto descriptors = *cache_->GetDescriptors(image_ids[i]);
-    if (options_.max_num_features > 0 &&
-        descriptors.rows() > options_.max_num_features) {
-      ExtractTopScaleFeatures(
-          &keypoints, &descriptors, options_.max_num_features);
+        "Indexing images [%d-%d/%d]", begin + 1, end, new_image_ids.size());
+
+    batch_image_ids.clear();
+    batch_keypoints.clear();
+    batch_descriptors.clear();
+    for (size_t i = begin; i < end; ++i) {
+      auto keypoints = *cache_->GetKeypoints(new_image_ids[i]);
+      auto descriptors = *cache_->GetDescriptors(new_image_ids[i]);
+      if (options_.max_num_features > 0 &&
+          descriptors.rows() > options_.max_num_features) {
+        ExtractTopScaleFeatures(
+            &keypoints, &descriptors, options_.max_num_features);
+      }
+      batch_image_ids.push_back(new_image_ids[i]);
+      batch_keypoints.push_back(std::move(keypoints));
+      batch_descriptors.emplace_back(descriptors);
     }
-    visual_index_.Add(index_options, image_ids[i], keypoints, descriptors);
+
+    visual_index_.Add(
+        index_options, batch_image_ids, batch_keypoints, batch_descriptors);
     LOG(INFO) << StringPrintf(" in %.3fs", timer.ElapsedSeconds());
   }
 
   // Compute the TF-IDF weights, etc.
-  visual_index_.Prepare();
+  retrieval::VisualIndex<>::PrepareOptions prepare_options;
+  prepare_options.max_document_frequency = options_.max_document_frequency;
+  prepare_options.compact = options_.num_images_after_verification <= 0;
+  visual_index_.Prepare(prepare_options);
+  LOG(INFO) << StringPrintf("Visual index uses %.3f MB",
+                            visual_index_.NumBytes() / (1024.0 * 1024.0));
+
+  // Write the index to a temporary file first, such that concurrent readers
+  // never see a partially written index.
+  if (!options_.index_path.empty() && !new_image_ids.empty()) {
+    LOG(INFO) << "Writing visual index " << options_.index_path;
+    const std::string tmp_index_path = options_.index_path + ".tmp";
+    visual_index_.Write(tmp_index_path);
+    THROW_CHECK_EQ(
+        std::rename(tmp_index_path.c_str(), options_.index_path.c_str()), 0);
+  }
 }
 
-void VocabTreePairGenerator::Query(const image_t image_id) {
-  auto keypoints = *cache_->GetKeypoints(image_id);
-  auto descriptors = *cache_->GetDescriptors(image_id);
-  if (options_.max_num_features > 0 &&
-      descriptors.rows() > options_.max_num_features) {
-    ExtractTopScaleFeatures(
-        &keypoints, &descriptors, options_.max_num_features);
+void VocabTreePairGenerator::Prefetch(const size_t begin, const size_t end) {
+  const std::vector<image_t> image_ids(query_image_ids_.begin() + begin,
+                                       query_image_ids_.begin() + end);
+  cache_->Prefetch(image_ids);
+  for (const image_t image_id : image_ids) {
+    std::shared_ptr<FeatureKeypoints> keypoints =
+        cache_->GetKeypoints(image_id);
+    std::shared_ptr<FeatureDescriptors> descriptors =
+        cache_->GetDescriptors(image_id);
+    if (options_.max_num_features > 0 &&
+        descriptors->rows() > options_.max_num_features) {
+      // Copy the cached features before extracting the largest ones.
+      keypoints = std::make_shared<FeatureKeypoints>(*keypoints);
+      descriptors = std::make_shared<FeatureDescriptors>(*descriptors);
+      ExtractTopScaleFeatures(
+          keypoints.get(), descriptors.get(), options_.max_num_features);
+    }
+    thread_pool.AddTask(&VocabTreePairGenerator::Query,
+                        this,
+                        image_id,
+                        std::move(keypoints),
+                        std::move(descriptors));
   }
+}
 
+void VocabTreePairGenerator::Query(
+    const image_t image_id,
+    const std::shared_ptr<FeatureKeypoints>& keypoints,
+    const std::shared_ptr<FeatureDescriptors>& descriptors) {
   Retrieval retrieval;
   retrieval.image_id = image_id;
   visual_index_.Query(
-      query_options_, keypoints, descriptors, &retrieval.image_scores);
+      query_options_, *keypoints, *descriptors, &retrieval.image_scores);
 
   THROW_CHECK(queue.Push(std::move(retrieval)));
 }
 
+GlobalDescriptorPairGenerator::GlobalDescriptorPairGenerator(
+    const VocabTreeMatchingOptions& options,
+    std::shared_ptr<FeatureMatcherCache> cache,
+    const std::vector<image_t>& query_image_ids)
+    : options_(options), cache_(std::move(THROW_CHECK_NOTNULL(cache))) {
+  THROW_CHECK(options.Check());
+  LOG(INFO) << "Generating image pairs with global descriptors...";
+
+  const std::vector<image_t> all_image_ids = cache_->GetImageIds();
+  ReadGlobalIndex(all_image_ids);
+  query_image_ids_ =
+      GetQueryImageIds(options_.match_list_path, *cache_, query_image_ids);
+
+  IndexImages(all_image_ids);
+
+  query_options_.max_num_images = options_.num_images;
+  query_options_.num_probes = options_.global_descriptor_num_probes;
+}
+
+GlobalDescriptorPairGenerator::GlobalDescriptorPairGenerator(
+    const VocabTreeMatchingOptions& options,
+    const std::shared_ptr<Database>& database,
+    const std::vector<image_t>& query_image_ids)
+    : GlobalDescriptorPairGenerator(
+          options,
+          std::make_shared<FeatureMatcherCache>(CacheSize(options),
+                                                THROW_CHECK_NOTNULL(database),
+                                                /*do_setup=*/true),
+          query_image_ids) {}
+
+void GlobalDescriptorPairGenerator::Reset() { query_idx_ = 0; }
+
+bool GlobalDescriptorPairGenerator::HasFinished() const {
+  return query_idx_ >= query_image_ids_.size();
+}
+
+std::vector<std::pair<image_t, image_t>>
+GlobalDescriptorPairGenerator::Next() {
+  image_pairs_.clear();
+  if (HasFinished()) {
+    return image_pairs_;
+  }
+
+  LOG(INFO) << StringPrintf(
+      "Matching image [%d/%d]", query_idx_ + 1, query_image_ids_.size());
+
+  // All images are indexed, so the queries reuse their global descriptors.
+  const image_t image_id = query_image_ids_[query_idx_++];
+  std::vector<retrieval::ImageScore> image_scores;
+  global_index_.Query(
+      query_options_, global_index_.Descriptor(image_id), &image_scores);
+
+  image_pairs_.reserve(image_scores.size());
+  for (const auto image_score : image_scores) {
+    image_pairs_.emplace_back(image_id, image_score.image_id);
+  }
+  std::stable_partition(
+      image_pairs_.begin(),
+      image_pairs_.end(),
+      [this](const std::pair<image_t, image_t>& image_pair) {
+        return cache_->HasCachedDescriptors(image_pair.second);
+      });
+  return image_pairs_;
+}
+
+void GlobalDescriptorPairGenerator::ReadGlobalIndex(
+    const std::vector<image_t>& image_ids) {
+  if (!options_.index_path.empty() && ExistsFile(options_.index_path)) {
+    LOG(INFO) << "Reading global index " << options_.index_path;
+    global_index_.Read(options_.index_path);
+
+    const std::unordered_set<image_t> image_ids_set(image_ids.begin(),
+                                                    image_ids.end());
+    bool index_up_to_date = true;
+    for (const int image_id : global_index_.ImageIds()) {
+      if (image_ids_set.count(image_id) == 0) {
+        index_up_to_date = false;
+        break;
+      }
+    }
+    if (index_up_to_date) {
+      return;
+    }
+
+    LOG(WARNING) << "Global index contains images that are not in the "
+                    "database, indexing all images again";
+    global_index_ = retrieval::GlobalIndex();
+  }
+
+  // Derive the codebook from the visual words of the vocabulary tree.
+  LOG(INFO) << StringPrintf("Building codebook with %d clusters",
+                            options_.global_descriptor_num_clusters);
+  retrieval::VisualIndex<> visual_index;
+  visual_index.Read(options_.vocab_tree_path);
+  global_index_.BuildCodebook(visual_index.VisualWords().cast<float>(),
+                              options_.global_descriptor_num_clusters,
+                              options_.num_threads);
+}
+
+void GlobalDescriptorPairGenerator::IndexImages(
+    const std::vector<image_t>& image_ids) {
+  std::vector<image_t> new_image_ids;
+  new_image_ids.reserve(image_ids.size());
+  for (const image_t image_id : image_ids) {
+    if (!global_index_.ImageIndexed(image_id)) {
+      new_image_ids.push_back(image_id);
+    }
+  }
+
+  if (new_image_ids.size() < image_ids.size()) {
+    LOG(INFO) << StringPrintf("Skipping %d already indexed images",
+                              image_ids.size() - new_image_ids.size());
+  }
+
+  if (!new_image_ids.empty()) {
+    Timer timer;
+    timer.Start();
+    LOG(INFO) << StringPrintf("Indexing %d images", new_image_ids.size());
+
+    ThreadPool thread_pool(options_.num_threads);
+    std::vector<std::future<Eigen::VectorXf>> futures;
+    futures.reserve(new_image_ids.size());
+    for (const image_t image_id : new_image_ids) {
+      futures.push_back(thread_pool.AddTask([this, image_id]() {
+        auto keypoints = *cache_->GetKeypoints(image_id);
+        auto descriptors = *cache_->GetDescriptors(image_id);
+        if (options_.max_num_features > 0 &&
+            descriptors.rows() > options_.max_num_features) {
+          ExtractTopScaleFeatures(
+              &keypoints, &descriptors, options_.max_num_features);
+        }
+        return global_index_.ComputeDescriptor(descriptors);
+      }));
+    }
+
+    for (size_t i = 0; i < new_image_ids.size(); ++i) {
+      global_index_.Add(new_image_ids[i], futures[i].get());
+    }
+    LOG(INFO) << StringPrintf(" in %.3fs", timer.ElapsedSeconds());
+  }
+
+  // Build the inverted lists of the global descriptors.
+  retrieval::GlobalIndex::PrepareOptions prepare_options;
+  prepare_options.num_threads = options_.num_threads;
+  global_index_.Prepare(prepare_options);
+
+  if (!options_.index_path.empty() && !new_image_ids.empty()) {
+    LOG(INFO) << "Writing global index " << options_.index_path;
+    const std::string tmp_index_path = options_.index_path + ".tmp";
+    global_index_.Write(tmp_index_path);
+    THROW_CHECK_EQ(
+        std::rename(tmp_index_path.c_str(), options_.index_path.c_str()), 0);
+  }
+}
+
 SequentialPairGenerator::SequentialPairGenerator(
     const SequentialMatchingOptions& options,
     std::shared_ptr<FeatureMatcherCache> cache)
     : options_(options), cache_(std::move(THROW_CHECK_NOTNULL(cache))) {
   THROW_CHECK(options.Check());
   LOG(INFO) << "Generating sequential image pairs...";
+  if (!options_.rig_config_path.empty()) {
+    rig_pair_filter_ =
+        std::make_unique<CameraRigPairFilter>(CameraRigPairFilter::Read(
+            options_.rig_config_path, options_.rig_max_view_angle));
+  }
   image_ids_ = GetOrderedImageIds();
-  image_pairs_.reserve(options_.overlap);
+  image_pairs_.reserve(2 * options_.overlap);
+
+  if (options_.online) {
+    image_idx_ = FindFirstNewImageIdx();
+    LOG(INFO) << StringPrintf("Matching %d new images",
+                              image_ids_.size() - image_idx_);
+  }
 
   if (options_.loop_detection) {
+    // The query images are chosen by their position in the sequence, so that
+    // online matching queries the same images as matching all at once.
     std::vector<image_t> query_image_ids;
-    for (size_t i = 0; i < image_ids_.size();
-         i += options_.loop_detection_period) {
-      query_image_ids.push_back(image_ids_[i]);
+    for (size_t i = image_idx_; i < image_ids_.size(); ++i) {
+      if (i % options_.loop_detection_period == 0) {
+        query_image_ids.push_back(image_ids_[i]);
+      }
     }
     vocab_tree_pair_generator_ = std::make_unique<VocabTreePairGenerator>(
         options_.VocabTreeOptions(), cache_, query_image_ids);
@@ -413,7 +827,7 @@ SequentialPairGenerator::SequentialPairGenerator(
                                                 /*do_setup=*/true)) {}
 
 void SequentialPairGenerator::Reset() {
-  image_idx_ = 0;
+  image_idx_ = options_.online ? FindFirstNewImageIdx() : 0;
   if (vocab_tree_pair_generator_) {
     vocab_tree_pair_generator_->Reset();
   }
@@ -429,7 +843,14 @@ std::vector<std::pair<image_t, image_t>> SequentialPairGenerator::Next() {
   image_pairs_.clear();
   if (image_idx_ >= image_ids_.size()) {
     if (vocab_tree_pair_generator_) {
-      return vocab_tree_pair_generator_->Next();
+      image_pairs_ = vocab_tree_pair_generator_->Next();
+      image_pairs_.erase(
+          std::remove_if(image_pairs_.begin(),
+                         image_pairs_.end(),
+                         [this](const std::pair<image_t, image_t>& pair) {
+                           return !IsRigOverlapping(pair.first, pair.second);
+                         }),
+          image_pairs_.end());
     }
     return image_pairs_;
   }
@@ -437,15 +858,51 @@ std::vector<std::pair<image_t, image_t>> SequentialPairGenerator::Next() {
       "Matching image [%d/%d]", image_idx_ + 1, image_ids_.size());
 
   const auto image_id1 = image_ids_.at(image_idx_);
+  if (options_.online) {
+    // Match the new image against its preceding images, which yields the same
+    // pairs as matching the preceding images against their successors. The
+    // pair with the predecessor is kept regardless of the rig pair filter,
+    // since it marks the image as matched.
+    for (int i = 1; i < options_.overlap; ++i) {
+      if (static_cast<size_t>(i) > image_idx_) {
+        break;
+      }
+      const image_t image_id2 = image_ids_.at(image_idx_ - i);
+      if (i == 1 || IsRigOverlapping(image_id2, image_id1)) {
+        image_pairs_.emplace_back(image_id2, image_id1);
+      }
+    }
+    if (options_.quadratic_overlap) {
+      for (int i = 0; i < options_.overlap; ++i) {
+        const size_t offset_quadratic = 1ull << i;
+        if (offset_quadratic > image_idx_) {
+          break;
+        }
+        const image_t image_id2 = image_ids_.at(image_idx_ - offset_quadratic);
+        if (i == 0 || IsRigOverlapping(image_id2, image_id1)) {
+          image_pairs_.emplace_back(image_id2, image_id1);
+        }
+      }
+    }
+    ++image_idx_;
+    return image_pairs_;
+  }
+
   for (int i = 0; i < options_.overlap; ++i) {
     const size_t image_idx_2 = image_idx_ + i;
     if (image_idx_2 < image_ids_.size()) {
-      image_pairs_.emplace_back(image_id1, image_ids_.at(image_idx_2));
+      const image_t image_id2 = image_ids_.at(image_idx_2);
+      if (IsRigOverlapping(image_id1, image_id2)) {
+        image_pairs_.emplace_back(image_id1, image_id2);
+      }
       if (options_.quadratic_overlap) {
         const size_t image_idx_2_quadratic = image_idx_ + (1ull << i);
         if (image_idx_2_quadratic < image_ids_.size()) {
-          image_pairs_.emplace_back(image_id1,
-                                    image_ids_.at(image_idx_2_quadratic));
+          const image_t image_id2_quadratic =
+              image_ids_.at(image_idx_2_quadratic);
+          if (IsRigOverlapping(image_id1, image_id2_quadratic)) {
+            image_pairs_.emplace_back(image_id1, image_id2_quadratic);
+          }
         }
       }
     } else {
@@ -480,6 +937,28 @@ std::vector<image_t> SequentialPairGenerator::GetOrderedImageIds() const {
   return ordered_image_ids;
 }
 
+bool SequentialPairGenerator::IsRigOverlapping(const image_t image_id1,
+                                               const image_t image_id2) const {
+  if (!rig_pair_filter_) {
+    return true;
+  }
+  return rig_pair_filter_->IsOverlapping(
+      cache_->GetImage(image_id1).CameraId(),
+      cache_->GetImage(image_id2).CameraId());
+}
+
+size_t SequentialPairGenerator::FindFirstNewImageIdx() const {
+  // The matcher writes the matches of all processed pairs, also if they are
+  // empty, so the pair with the predecessor exists for all matched images.
+  size_t image_idx = image_ids_.size();
+  while (image_idx > 1 && !cache_->ExistsMatches(image_ids_[image_idx - 2],
+                                                 image_ids_[image_idx - 1])) {
+    --image_idx;
+  }
+  // The first image has no predecessor and is new, if its successor is new.
+  return image_idx == 1 ? 0 : image_idx;
+}
+
 SpatialPairGenerator::SpatialPairGenerator(
     const SpatialMatchingOptions& options,
     const std::shared_ptr<FeatureMatcherCache>& cache)
@@ -487,13 +966,22 @@ SpatialPairGenerator::SpatialPairGenerator(
   LOG(INFO) << "Generating spatial image pairs...";
   THROW_CHECK(options.Check());
 
+  if (!options_.rig_config_path.empty()) {
+    rig_pair_filter_ =
+        std::make_unique<CameraRigPairFilter>(CameraRigPairFilter::Read(
+            options_.rig_config_path, options_.rig_max_view_angle));
+    camera_ids_.reserve(image_ids_.size());
+    for (const image_t image_id : image_ids_) {
+      camera_ids_.push_back(cache->GetImage(image_id).CameraId());
+    }
+  }
+
   Timer timer;
   timer.Start();
   LOG(INFO) << "Indexing images...";
 
-  Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor> location_matrix =
-      ReadLocationData(*cache);
-  size_t num_locations = location_idxs_.size();
+  location_matrix_ = ReadLocationData(*cache);
+  const size_t num_locations = location_idxs_.size();
 
   LOG(INFO) << StringPrintf(" in %.3fs", timer.ElapsedSeconds());
   if (num_locations == 0) {
@@ -504,38 +992,13 @@ SpatialPairGenerator::SpatialPairGenerator(
   timer.Restart();
   LOG(INFO) << "Building search index...";
 
-  flann::Matrix<float> locations(
-      location_matrix.data(), num_locations, location_matrix.cols());
-
-  flann::LinearIndexParams index_params;
-  flann::LinearIndex<flann::L2<float>> search_index(index_params);
-  search_index.buildIndex(locations);
-
-  LOG(INFO) << StringPrintf(" in %.3fs", timer.ElapsedSeconds());
-
-  timer.Restart();
-  LOG(INFO) << "Searching for nearest neighbors...";
-
-  const int knn = std::min<int>(options_.max_num_neighbors, num_locations);
-  image_pairs_.reserve(knn);
-
-  index_matrix_.resize(num_locations, knn);
-  flann::Matrix<size_t> indices(index_matrix_.data(), num_locations, knn);
-
-  distance_matrix_.resize(num_locations, knn);
-  flann::Matrix<float> distances(distance_matrix_.data(), num_locations, knn);
-
-  flann::SearchParams search_params(flann::FLANN_CHECKS_AUTOTUNED);
-  if (options_.num_threads == ThreadPool::kMaxNumThreads) {
-    search_params.cores = std::thread::hardware_concurrency();
-  } else {
-    search_params.cores = options_.num_threads;
-  }
-  if (search_params.cores <= 0) {
-    search_params.cores = 1;
+  // The neighbors are retrieved lazily for each image in Next(), so that no
+  // full nearest neighbor result matrix is computed and kept in memory.
+  grid_.reserve(num_locations);
+  for (size_t i = 0; i < num_locations; ++i) {
+    grid_.emplace_back(LocationToGridCell(location_matrix_.row(i)), i);
   }
-
-  search_index.knnSearch(locations, indices, distances, knn, search_params);
+  std::sort(grid_.begin(), grid_.end());
 
   LOG(INFO) << StringPrintf(" in %.3fs", timer.ElapsedSeconds());
 }
@@ -563,23 +1026,59 @@ std::vector<std::pair<image_t, image_t>> SpatialPairGenerator::Next() {
 
   LOG(INFO) << StringPrintf(
       "Matching image [%d/%d]", current_idx_ + 1, location_idxs_.size());
-  const int knn =
-      std::min<int>(options_.max_num_neighbors, location_idxs_.size());
   const float max_distance =
       static_cast<float>(options_.max_distance * options_.max_distance);
-  for (int j = 0; j < knn; ++j) {
-    // Check if query equals result.
-    if (index_matrix_(current_idx_, j) == current_idx_) {
-      continue;
+
+  // Collect all locations within max_distance in the adjacent grid cells,
+  // including the query itself, and sorted by distance as in a kNN search.
+  const Eigen::Vector3f location = location_matrix_.row(current_idx_);
+  const GridCell cell = LocationToGridCell(location);
+  const camera_t camera_id =
+      rig_pair_filter_ ? camera_ids_[location_idxs_[current_idx_]]
+                       : kInvalidCameraId;
+  std::vector<std::pair<float, size_t>> neighbors;
+  for (int64_t dx = -1; dx <= 1; ++dx) {
+    for (int64_t dy = -1; dy <= 1; ++dy) {
+      for (int64_t dz = -1; dz <= 1; ++dz) {
+        const GridCell neighbor_cell = {
+            {cell[0] + dx, cell[1] + dy, cell[2] + dz}};
+        auto it = std::lower_bound(
+            grid_.begin(),
+            grid_.end(),
+            neighbor_cell,
+            [](const std::pair<GridCell, size_t>& entry,
+               const GridCell& cell) { return entry.first < cell; });
+        for (; it != grid_.end() && it->first == neighbor_cell; ++it) {
+          // Non-overlapping cameras of a rig do not take up neighbor slots.
+          if (rig_pair_filter_ &&
+              !rig_pair_filter_->IsOverlapping(
+                  camera_id, camera_ids_[location_idxs_[it->second]])) {
+            continue;
+          }
+          const float distance =
+              (location_matrix_.row(it->second).transpose() - location)
+                  .squaredNorm();
+          if (distance <= max_distance) {
+            neighbors.emplace_back(distance, it->second);
+          }
+        }
+      }
     }
+  }
 
-    // Since the nearest neighbors are sorted by distance, we can break.
-    if (distance_matrix_(current_idx_, j) > max_distance) {
-      break;
+  const size_t knn = std::min<size_t>(options_.max_num_neighbors,
+                                      neighbors.size());
+  std::partial_sort(
+      neighbors.begin(), neighbors.begin() + knn, neighbors.end());
+
+  const image_t image_id = image_ids_.at(location_idxs_[current_idx_]);
+  for (size_t j = 0; j < knn; ++j) {
+    // Check if query equals result.
+    if (neighbors[j].second == current_idx_) {
+      continue;
     }
 
-    const image_t image_id = image_ids_.at(location_idxs_[current_idx_]);
-    const size_t nn_idx = location_idxs_.at(index_matrix_(current_idx_, j));
+    const size_t nn_idx = location_idxs_.at(neighbors[j].second);
     const image_t nn_image_id = image_ids_.at(nn_idx);
     image_pairs_.emplace_back(image_id, nn_image_id);
   }
@@ -587,17 +1086,26 @@ std::vector<std::pair<image_t, image_t>> SpatialPairGenerator::Next() {
   return image_pairs_;
 }
 
+SpatialPairGenerator::GridCell SpatialPairGenerator::LocationToGridCell(
+    const Eigen::Vector3f& location) const {
+  const double cell_size = options_.max_distance;
+  return {{static_cast<int64_t>(std::floor(location(0) / cell_size)),
+           static_cast<int64_t>(std::floor(location(1) / cell_size)),
+           static_cast<int64_t>(std::floor(location(2) / cell_size))}};
+}
+
 Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor>
 SpatialPairGenerator::ReadLocationData(const FeatureMatcherCache& cache) {
-  GPSTransform gps_transform;
-  std::vector<Eigen::Vector3d> ells(1);
-
   size_t num_locations = 0;
   location_idxs_.clear();
   location_idxs_.reserve(image_ids_.size());
   Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor> location_matrix(
       image_ids_.size(), 3);
 
+  // The GPS locations are collected and converted in one batch.
+  std::vector<Eigen::Vector3d> ells;
+  std::vector<size_t> ell_location_idxs;
+
   for (size_t i = 0; i < image_ids_.size(); ++i) {
     if (!cache.ExistsPosePrior(image_ids_[i])) {
       continue;
@@ -614,16 +1122,12 @@ SpatialPairGenerator::ReadLocationData(const FeatureMatcherCache& cache) {
     location_idxs_.push_back(i);
 
     switch (pose_prior.coordinate_system) {
-      case PosePrior::CoordinateSystem::WGS84: {
-        ells[0](0) = translation_prior(0);
-        ells[0](1) = translation_prior(1);
-        ells[0](2) = options_.ignore_z ? 0 : translation_prior(2);
-
-        const auto xyzs = gps_transform.EllToXYZ(ells);
-        location_matrix(num_locations, 0) = static_cast<float>(xyzs[0](0));
-        location_matrix(num_locations, 1) = static_cast<float>(xyzs[0](1));
-        location_matrix(num_locations, 2) = static_cast<float>(xyzs[0](2));
-      } break;
+      case PosePrior::CoordinateSystem::WGS84:
+        ells.emplace_back(translation_prior(0),
+                          translation_prior(1),
+                          options_.ignore_z ? 0 : translation_prior(2));
+        ell_location_idxs.push_back(num_locations);
+        break;
       case PosePrior::CoordinateSystem::UNDEFINED:
         LOG(INFO) << "Unknown coordinate system for image " << image_ids_[i]
                   << ", assuming cartesian.";
@@ -639,6 +1143,15 @@ SpatialPairGenerator::ReadLocationData(const FeatureMatcherCache& cache) {
 
     num_locations += 1;
   }
+
+  if (!ells.empty()) {
+    const std::vector<Eigen::Vector3d> xyzs = GPSTransform().EllToXYZ(ells);
+    for (size_t i = 0; i < xyzs.size(); ++i) {
+      location_matrix.row(ell_location_idxs[i]) =
+          xyzs[i].cast<float>().transpose();
+    }
+  }
+
   return location_matrix;
 }
 
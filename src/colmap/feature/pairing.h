@@ -30,17 +30,27 @@
 #pragma once
 
 #include "colmap/feature/matcher.h"
+#include "colmap/retrieval/global_index.h"
 #include "colmap/retrieval/visual_index.h"
+#include "colmap/scene/camera_rig.h"
 #include "colmap/scene/database.h"
 #include "colmap/util/threading.h"
 #include "colmap/util/types.h"
 
+#include <array>
+#include <unordered_map>
+
 namespace colmap {
 
 struct ExhaustiveMatchingOptions {
   // Block size, i.e. number of images to simultaneously load into memory.
   int block_size = 50;
 
+  // Maximum number of images with features cached in memory. If not positive,
+  // features of five blocks are cached. If the cache is smaller than three
+  // blocks, the pairs of a block are matched in tiles of a third of its size.
+  int cache_size = -1;
+
   bool Check() const;
 };
 
@@ -55,22 +65,61 @@ struct VocabTreeMatchingOptions {
   int num_checks = 256;
 
   // How many images to return after spatial verification. Set to 0 to turn off
-  // spatial verification.
+  // spatial verification. Without spatial verification, the visual index only
+  // keeps the information needed for scoring, which reduces its memory usage.
   int num_images_after_verification = 0;
 
   // The maximum number of features to use for indexing an image. If an
   // image has more features, only the largest-scale features will be indexed.
   int max_num_features = -1;
 
+  // Visual words that occur in more than this fraction of the database images
+  // are pruned from the visual index as stop words.
+  double max_document_frequency = 1.0;
+
   // Path to the vocabulary tree.
   std::string vocab_tree_path = "";
 
   // Optional path to file with specific image names to match.
   std::string match_list_path = "";
 
+  // Optional path to a file with the visual index of the database images,
+  // e.g., next to the database. If the file exists, it is read instead of the
+  // vocabulary tree and only the images that are not yet indexed are added.
+  // The index is then written back, if new images were added. The index must
+  // be created with the same vocabulary tree and maximum number of features.
+  std::string index_path = "";
+
   // Number of threads for indexing and retrieval.
   int num_threads = -1;
 
+  // Whether to assign features to visual words by exhaustive search on the
+  // GPU instead of approximate search on the CPU. Requires CUDA.
+  bool use_gpu = false;
+
+  // Index of the GPU used for the visual word assignment, where -1 selects
+  // the best available GPU.
+  int gpu_index = -1;
+
+  // Whether to retrieve images by a compact global descriptor per image
+  // instead of scoring the visual words of all features in inverted files.
+  // The global descriptors aggregate the features with a codebook obtained by
+  // clustering the visual words of the vocabulary tree. This scales to much
+  // larger databases at the cost of lower retrieval quality. If enabled, the
+  // global index is persisted to `index_path` instead of the visual index.
+  bool use_global_descriptors = false;
+
+  // Number of codebook clusters of the global descriptors, which have 128
+  // times as many dimensions.
+  int global_descriptor_num_clusters = 16;
+
+  // Number of nearest inverted lists of global descriptors scanned per query.
+  int global_descriptor_num_probes = 16;
+
+  // Maximum number of images with features cached in memory. If not positive,
+  // features of five times the number of retrieved images are cached.
+  int cache_size = -1;
+
   bool Check() const;
 };
 
@@ -108,6 +157,31 @@ struct SequentialMatchingOptions {
   // Path to the vocabulary tree.
   std::string vocab_tree_path = "";
 
+  // Optional path to a file with the visual index of loop detection, which is
+  // updated with the new images instead of indexing all images again, see
+  // `VocabTreeMatchingOptions::index_path`.
+  std::string loop_detection_index_path = "";
+
+  // Whether to only match the images appended to the sequence since the
+  // previous matching, e.g., for continuously growing video captures. The new
+  // images are the trailing images in the sequence, which are not yet matched
+  // against their predecessor. Each new image is matched against its
+  // preceding images and, with loop detection, against its retrieved images,
+  // such that the matching cost per new image does not grow with the length
+  // of the sequence. A persistent `loop_detection_index_path` avoids indexing
+  // the previous images again. Assumes that images are appended in the order
+  // of their names.
+  bool online = false;
+
+  // Optional path to a camera rig configuration in the format of the rig
+  // bundle adjuster. Images of different cameras in the same rig are only
+  // matched, if the viewing directions of the cameras overlap.
+  std::string rig_config_path = "";
+
+  // The maximum angle in degrees between the viewing directions of two
+  // cameras in the same rig, such that their images are matched.
+  double rig_max_view_angle = 90.0;
+
   bool Check() const;
 
   VocabTreeMatchingOptions VocabTreeOptions() const;
@@ -124,9 +198,19 @@ struct SpatialMatchingOptions {
   // coordinates the unit is Euclidean distance in meters.
   double max_distance = 100;
 
-  // Number of threads for indexing and retrieval.
+  // Number of threads for indexing and retrieval. Not used anymore, since
+  // the neighbors are retrieved lazily per image from a spatial grid.
   int num_threads = -1;
 
+  // Optional path to a camera rig configuration in the format of the rig
+  // bundle adjuster. Images of different cameras in the same rig are only
+  // matched, if the viewing directions of the cameras overlap.
+  std::string rig_config_path = "";
+
+  // The maximum angle in degrees between the viewing directions of two
+  // cameras in the same rig, such that their images are matched.
+  double rig_max_view_angle = 90.0;
+
   bool Check() const;
 };
 
@@ -177,7 +261,8 @@ class ExhaustivePairGenerator : public PairGenerator {
  public:
   using PairOptions = ExhaustiveMatchingOptions;
   static size_t CacheSize(const ExhaustiveMatchingOptions& options) {
-    return 5 * options.block_size;
+    return options.cache_size > 0 ? options.cache_size
+                                  : 5 * options.block_size;
   }
 
   ExhaustivePairGenerator(const ExhaustiveMatchingOptions& options,
@@ -197,16 +282,46 @@ class ExhaustivePairGenerator : public PairGenerator {
   const std::vector<image_t> image_ids_;
   const size_t block_size_;
   const size_t num_blocks_;
+  const size_t tile_size_;
   size_t start_idx1_ = 0;
   size_t start_idx2_ = 0;
   std::vector<std::pair<image_t, image_t>> image_pairs_;
 };
 
+// Filters the image pairs between the cameras of multi-camera rigs, so that
+// only cameras with plausibly overlapping fields of view are matched. Two
+// cameras of the same rig overlap, if the angle between their viewing
+// directions in the rig frame is at most `max_view_angle` degrees. Images of
+// the same camera or of cameras in different or no rigs always overlap.
+class CameraRigPairFilter {
+ public:
+  CameraRigPairFilter(const std::vector<CameraRig>& camera_rigs,
+                      double max_view_angle);
+
+  // Read the camera rigs from a configuration in the format of the rig bundle
+  // adjuster. Only the camera identifiers and the optional rotations are
+  // used. Cameras without rotation are assumed to overlap with all cameras.
+  static CameraRigPairFilter Read(const std::string& rig_config_path,
+                                  double max_view_angle);
+
+  bool IsOverlapping(camera_t camera_id1, camera_t camera_id2) const;
+
+ private:
+  struct RigCamera {
+    size_t rig_idx;
+    Eigen::Vector3d view_dir;
+  };
+
+  double min_cos_view_angle_;
+  std::unordered_map<camera_t, RigCamera> rig_cameras_;
+};
+
 class VocabTreePairGenerator : public PairGenerator {
  public:
   using PairOptions = VocabTreeMatchingOptions;
   static size_t CacheSize(const VocabTreeMatchingOptions& options) {
-    return 5 * options.num_images;
+    return options.cache_size > 0 ? options.cache_size
+                                  : 5 * options.num_images;
   }
 
   VocabTreePairGenerator(const VocabTreeMatchingOptions& options,
@@ -224,6 +339,12 @@ class VocabTreePairGenerator : public PairGenerator {
   std::vector<std::pair<image_t, image_t>> Next() override;
 
  private:
+  // Read the persisted index of the database images from `index_path` or,
+  // if it does not exist or is out of date, the plain vocabulary tree.
+  void ReadVisualIndex(const std::vector<image_t>& image_ids);
+
+  // Index the given images, which are skipped if already indexed. The index
+  // is written to `index_path` if any images were added.
   void IndexImages(const std::vector<image_t>& image_ids);
 
   struct Retrieval {
@@ -231,12 +352,21 @@ class VocabTreePairGenerator : public PairGenerator {
     std::vector<retrieval::ImageScore> image_scores;
   };
 
-  void Query(image_t image_id);
+  // Read the features of the given range of query images with batched
+  // database reads and then schedule their queries in the thread pool, such
+  // that the retrieval threads never wait for the database.
+  void Prefetch(size_t begin, size_t end);
+
+  void Query(image_t image_id,
+             const std::shared_ptr<FeatureKeypoints>& keypoints,
+             const std::shared_ptr<FeatureDescriptors>& descriptors);
 
   const VocabTreeMatchingOptions options_;
   const std::shared_ptr<FeatureMatcherCache> cache_;
   ThreadPool thread_pool;
   JobQueue<Retrieval> queue;
+  // Reads the features of upcoming query images ahead of the retrieval.
+  ThreadPool prefetch_thread_pool_;
   retrieval::VisualIndex<> visual_index_;
   retrieval::VisualIndex<>::QueryOptions query_options_;
   std::vector<image_t> query_image_ids_;
@@ -245,6 +375,51 @@ class VocabTreePairGenerator : public PairGenerator {
   size_t result_idx_ = 0;
 };
 
+// Retrieves the most similar images by approximate nearest neighbor search
+// over the global descriptors of all images, as an alternative to the
+// vocabulary tree retrieval for very large databases.
+class GlobalDescriptorPairGenerator : public PairGenerator {
+ public:
+  using PairOptions = VocabTreeMatchingOptions;
+  static size_t CacheSize(const VocabTreeMatchingOptions& options) {
+    return VocabTreePairGenerator::CacheSize(options);
+  }
+
+  GlobalDescriptorPairGenerator(
+      const VocabTreeMatchingOptions& options,
+      std::shared_ptr<FeatureMatcherCache> cache,
+      const std::vector<image_t>& query_image_ids = {});
+
+  GlobalDescriptorPairGenerator(
+      const VocabTreeMatchingOptions& options,
+      const std::shared_ptr<Database>& database,
+      const std::vector<image_t>& query_image_ids = {});
+
+  void Reset() override;
+
+  bool HasFinished() const override;
+
+  std::vector<std::pair<image_t, image_t>> Next() override;
+
+ private:
+  // Read the persisted global index from `index_path` or, if it does not
+  // exist or is out of date, build the codebook from the vocabulary tree.
+  void ReadGlobalIndex(const std::vector<image_t>& image_ids);
+
+  // Compute the global descriptors of the given images, which are skipped if
+  // already indexed. The index is written to `index_path` if any images were
+  // added.
+  void IndexImages(const std::vector<image_t>& image_ids);
+
+  const VocabTreeMatchingOptions options_;
+  const std::shared_ptr<FeatureMatcherCache> cache_;
+  retrieval::GlobalIndex global_index_;
+  retrieval::GlobalIndex::QueryOptions query_options_;
+  std::vector<image_t> query_image_ids_;
+  std::vector<std::pair<image_t, image_t>> image_pairs_;
+  size_t query_idx_ = 0;
+};
+
 class SequentialPairGenerator : public PairGenerator {
  public:
   using PairOptions = SequentialMatchingOptions;
@@ -267,10 +442,17 @@ class SequentialPairGenerator : public PairGenerator {
  private:
   std::vector<image_t> GetOrderedImageIds() const;
 
+  bool IsRigOverlapping(image_t image_id1, image_t image_id2) const;
+
+  // Index of the first image in the sequence, which is not yet matched
+  // against its predecessor.
+  size_t FindFirstNewImageIdx() const;
+
   const SequentialMatchingOptions options_;
   const std::shared_ptr<FeatureMatcherCache> cache_;
   std::vector<image_t> image_ids_;
   std::unique_ptr<VocabTreePairGenerator> vocab_tree_pair_generator_;
+  std::unique_ptr<CameraRigPairFilter> rig_pair_filter_;
   std::vector<std::pair<image_t, image_t>> image_pairs_;
   size_t image_idx_ = 0;
 };
@@ -295,17 +477,25 @@ class SpatialPairGenerator : public PairGenerator {
   std::vector<std::pair<image_t, image_t>> Next() override;
 
  private:
+  typedef std::array<int64_t, 3> GridCell;
+
   Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor> ReadLocationData(
       const FeatureMatcherCache& cache);
 
+  GridCell LocationToGridCell(const Eigen::Vector3f& location) const;
+
   const SpatialMatchingOptions options_;
   std::vector<std::pair<image_t, image_t>> image_pairs_;
-  Eigen::Matrix<size_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      index_matrix_;
-  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
-      distance_matrix_;
+  Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor> location_matrix_;
+  // The location indices sorted by their cell in a uniform grid with a cell
+  // size of max_distance, such that all neighbors of a location within
+  // max_distance are in its own or the directly adjacent cells.
+  std::vector<std::pair<GridCell, size_t>> grid_;
   std::vector<image_t> image_ids_;
   std::vector<size_t> location_idxs_;
+  std::unique_ptr<CameraRigPairFilter> rig_pair_filter_;
+  // The camera of each image, only read with a rig pair filter.
+  std::vector<camera_t> camera_ids_;
   size_t current_idx_ = 0;
 };
 
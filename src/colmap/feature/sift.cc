@@ -32,9 +32,11 @@
 #include "colmap/feature/utils.h"
 #include "colmap/math/math.h"
 #include "colmap/util/cuda.h"
+#include "colmap/util/endian.h"
 #include "colmap/util/logging.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/opengl_utils.h"
+#include "colmap/util/threading.h"
 
 #if defined(COLMAP_GPU_ENABLED)
 #include "thirdparty/SiftGPU/SiftGPU.h"
@@ -50,7 +52,10 @@
 
 #include <array>
 #include <fstream>
+#include <future>
+#include <limits>
 #include <memory>
+#include <unordered_map>
 
 #include <Eigen/Geometry>
 #include <flann/flann.hpp>
@@ -60,8 +65,13 @@ namespace colmap {
 bool SiftExtractionOptions::Check() const {
   if (use_gpu) {
     CHECK_OPTION_GT(CSVToVector<int>(gpu_index).size(), 0);
+    CHECK_OPTION_GT(gpu_batch_size, 0);
   }
   CHECK_OPTION_GT(max_image_size, 0);
+  if (tiled_extraction) {
+    CHECK_OPTION_GE(tile_overlap, 0);
+    CHECK_OPTION_LT(tile_overlap, max_image_size);
+  }
   CHECK_OPTION_GT(max_num_features, 0);
   CHECK_OPTION_GT(octave_resolution, 0);
   CHECK_OPTION_GT(peak_threshold, 0.0);
@@ -79,9 +89,16 @@ bool SiftMatchingOptions::Check() const {
   if (use_gpu) {
     CHECK_OPTION_GT(CSVToVector<int>(gpu_index).size(), 0);
   }
+  CHECK_OPTION_GT(num_matchers_per_gpu, 0);
   CHECK_OPTION_GT(max_ratio, 0.0);
   CHECK_OPTION_GT(max_distance, 0.0);
   CHECK_OPTION_GT(max_num_matches, 0);
+  CHECK_OPTION_GT(max_num_pairs_per_commit, 0);
+  CHECK_OPTION_GT(max_num_bytes_per_commit, 0);
+  CHECK_OPTION_GT(num_shards, 0);
+  CHECK_OPTION_GE(shard_index, 0);
+  CHECK_OPTION_LT(shard_index, num_shards);
+  CHECK_OPTION_GE(pre_filter_min_num_matches, 0);
   return true;
 }
 
@@ -91,22 +108,75 @@ void WarnDarknessAdaptivityNotAvailable() {
   LOG(WARNING) << "Darkness adaptivity only available for GLSL SiftGPU.";
 }
 
+// Convert the grey image to row-major intensities in the range [0, 1] as
+// expected by VLFeat. The scanlines are read directly through the view to
+// avoid an intermediate copy of the image.
+std::vector<float> ConvertToNormalizedFloatArray(const BitmapView& view) {
+  THROW_CHECK_EQ(view.channels, 1);
+  std::vector<float> data_float(static_cast<size_t>(view.width) *
+                                view.height);
+  float* data = data_float.data();
+  for (int y = 0; y < view.height; ++y) {
+    const uint8_t* row = view.Row(y);
+    for (int x = 0; x < view.width; ++x) {
+      *data++ = static_cast<float>(row[x]) / 255.0f;
+    }
+  }
+  return data_float;
+}
+
+// The orientation bins of each of the 4x4 spatial bins in the original SIFT
+// format, which is also used by SiftGPU, and their positions in the VLFeat
+// format, which reverses all but the first orientation bin.
+constexpr std::array<int, 8> kUBCOrientationBins = {{0, 1, 2, 3, 4, 5, 6, 7}};
+constexpr std::array<int, 8> kVLFeatOrientationBins = {
+    {0, 7, 6, 5, 4, 3, 2, 1}};
+
+// Sum neighboring pairs of the orientation bins of each spatial bin of raw or
+// L2-normalized descriptors. The positions of the orientation bins in the
+// input are given in the order of the original SIFT format, so that the
+// output is in the same format independent of the input format.
+void CompactSiftFeatureDescriptors(
+    const FeatureDescriptorsFloat& descriptors,
+    const std::array<int, 8>& orientation_bins,
+    FeatureDescriptorsFloat* compact_descriptors) {
+  THROW_CHECK_EQ(descriptors.cols(), 128);
+  compact_descriptors->resize(descriptors.rows(), kCompactSiftDescriptorDim);
+  for (FeatureDescriptors::Index n = 0; n < descriptors.rows(); ++n) {
+    for (int i = 0; i < 16; ++i) {
+      for (int k = 0; k < 4; ++k) {
+        (*compact_descriptors)(n, 4 * i + k) =
+            descriptors(n, 8 * i + orientation_bins[2 * k]) +
+            descriptors(n, 8 * i + orientation_bins[2 * k + 1]);
+      }
+    }
+  }
+}
+
 // VLFeat uses a different convention to store its descriptors. This transforms
 // the VLFeat format into the original SIFT format that is also used by SiftGPU.
 FeatureDescriptors TransformVLFeatToUBCFeatureDescriptors(
     const FeatureDescriptors& vlfeat_descriptors) {
+  THROW_CHECK_EQ(vlfeat_descriptors.cols(), 128);
   FeatureDescriptors ubc_descriptors(vlfeat_descriptors.rows(),
                                      vlfeat_descriptors.cols());
-  const std::array<int, 8> q{{0, 7, 6, 5, 4, 3, 2, 1}};
-  for (FeatureDescriptors::Index n = 0; n < vlfeat_descriptors.rows(); ++n) {
-    for (int i = 0; i < 4; ++i) {
-      for (int j = 0; j < 4; ++j) {
-        for (int k = 0; k < 8; ++k) {
-          ubc_descriptors(n, 8 * (j + 4 * i) + q[k]) =
-              vlfeat_descriptors(n, 8 * (j + 4 * i) + k);
-        }
+  // The orientation bins of each of the 4x4 spatial bins are reversed, except
+  // for the first bin. The permutation is applied to the contiguous rows.
+  static const std::array<int, 128> kPermutation = []() {
+    std::array<int, 128> permutation;
+    for (int i = 0; i < 16; ++i) {
+      for (int k = 0; k < 8; ++k) {
+        permutation[8 * i + k] = 8 * i + kVLFeatOrientationBins[k];
       }
     }
+    return permutation;
+  }();
+  for (FeatureDescriptors::Index n = 0; n < vlfeat_descriptors.rows(); ++n) {
+    const uint8_t* vlfeat_descriptor = vlfeat_descriptors.row(n).data();
+    uint8_t* ubc_descriptor = ubc_descriptors.row(n).data();
+    for (int k = 0; k < 128; ++k) {
+      ubc_descriptor[kPermutation[k]] = vlfeat_descriptor[k];
+    }
   }
   return ubc_descriptors;
 }
@@ -123,6 +193,11 @@ class SiftCPUFeatureExtractor : public FeatureExtractor {
     if (options_.darkness_adaptivity) {
       WarnDarknessAdaptivityNotAvailable();
     }
+    const int num_threads_per_image =
+        GetEffectiveNumThreads(options_.num_threads_per_image);
+    if (num_threads_per_image > 1) {
+      thread_pool_ = std::make_unique<ThreadPool>(num_threads_per_image);
+    }
   }
 
   static std::unique_ptr<FeatureExtractor> Create(
@@ -152,6 +227,9 @@ class SiftCPUFeatureExtractor : public FeatureExtractor {
     vl_sift_set_peak_thresh(sift_.get(), options_.peak_threshold);
     vl_sift_set_edge_thresh(sift_.get(), options_.edge_threshold);
 
+    const int descriptor_dim =
+        options_.compact_descriptors ? kCompactSiftDescriptorDim : 128;
+
     // Iterate through octaves.
     std::vector<size_t> level_num_features;
     std::vector<FeatureKeypoints> level_keypoints;
@@ -159,11 +237,8 @@ class SiftCPUFeatureExtractor : public FeatureExtractor {
     bool first_octave = true;
     while (true) {
       if (first_octave) {
-        const std::vector<uint8_t> data_uint8 = bitmap.ConvertToRowMajorArray();
-        std::vector<float> data_float(data_uint8.size());
-        for (size_t i = 0; i < data_uint8.size(); ++i) {
-          data_float[i] = static_cast<float>(data_uint8[i]) / 255.0f;
-        }
+        const std::vector<float> data_float =
+            ConvertToNormalizedFloatArray(bitmap.View());
         if (vl_sift_process_first_octave(sift_.get(), data_float.data())) {
           break;
         }
@@ -184,17 +259,102 @@ class SiftCPUFeatureExtractor : public FeatureExtractor {
         continue;
       }
 
-      // Extract features with different orientations per DOG level.
+      // Compute the orientations and descriptors of all keypoints in the
+      // octave, optionally in parallel, since they only read the gradients
+      // of the current octave.
+      const int max_num_used_orientations =
+          std::min(4, options_.max_num_orientations);
+      std::vector<std::array<double, 4>> keypoint_angles(num_keypoints);
+      std::vector<int> keypoint_num_orientations(num_keypoints);
+      FeatureDescriptors keypoint_descriptors;
+      if (descriptors != nullptr) {
+        keypoint_descriptors.resize(num_keypoints * max_num_used_orientations,
+                                    descriptor_dim);
+      }
+
+      auto ComputeKeypoints = [&](const int begin, const int end) {
+        FeatureDescriptorsFloat raw_desc(1, 128);
+        FeatureDescriptorsFloat compact_desc;
+        FeatureDescriptorsFloat& desc =
+            options_.compact_descriptors ? compact_desc : raw_desc;
+        for (int i = begin; i < end; ++i) {
+          // Extract feature orientations.
+          double* angles = keypoint_angles[i].data();
+          int num_orientations;
+          if (options_.upright) {
+            num_orientations = 1;
+            angles[0] = 0.0;
+          } else {
+            num_orientations = vl_sift_calc_keypoint_orientations(
+                sift_.get(), angles, &vl_keypoints[i]);
+          }
+
+          // Note that this is different from SiftGPU, which selects the top
+          // global maxima as orientations while this selects the first two
+          // local maxima. It is not clear which procedure is better.
+          const int num_used_orientations =
+              std::min(num_orientations, max_num_used_orientations);
+          keypoint_num_orientations[i] = num_used_orientations;
+
+          if (descriptors == nullptr) {
+            continue;
+          }
+
+          for (int o = 0; o < num_used_orientations; ++o) {
+            vl_sift_calc_keypoint_descriptor(
+                sift_.get(), raw_desc.data(), &vl_keypoints[i], angles[o]);
+            if (options_.compact_descriptors) {
+              CompactSiftFeatureDescriptors(
+                  raw_desc, kVLFeatOrientationBins, &compact_desc);
+            }
+            if (options_.normalization ==
+                SiftExtractionOptions::Normalization::L2) {
+              L2NormalizeFeatureDescriptors(&desc);
+            } else if (options_.normalization ==
+                       SiftExtractionOptions::Normalization::L1_ROOT) {
+              L1RootNormalizeFeatureDescriptors(&desc);
+            } else {
+              LOG(FATAL_THROW) << "Normalization type not supported";
+            }
+
+            keypoint_descriptors.row(i * max_num_used_orientations + o) =
+                FeatureDescriptorsToUnsignedByte(desc);
+          }
+        }
+      };
+
+      if (thread_pool_ == nullptr) {
+        ComputeKeypoints(0, num_keypoints);
+      } else {
+        // The gradients of the octave are lazily computed by VLFeat on first
+        // use, which must not happen concurrently.
+        ComputeOctaveGradients();
+        const int num_tasks = std::min(
+            num_keypoints, static_cast<int>(thread_pool_->NumThreads()));
+        std::vector<std::future<void>> futures;
+        futures.reserve(num_tasks);
+        for (int t = 0; t < num_tasks; ++t) {
+          futures.push_back(
+              thread_pool_->AddTask(ComputeKeypoints,
+                                    t * num_keypoints / num_tasks,
+                                    (t + 1) * num_keypoints / num_tasks));
+        }
+        for (auto& future : futures) {
+          future.get();
+        }
+      }
+
+      // Collect features with different orientations per DOG level.
       size_t level_idx = 0;
       int prev_level = -1;
-      FeatureDescriptorsFloat desc(1, 128);
       for (int i = 0; i < num_keypoints; ++i) {
         if (vl_keypoints[i].is != prev_level) {
           if (i > 0) {
             // Resize containers of previous DOG level.
             level_keypoints.back().resize(level_idx);
             if (descriptors != nullptr) {
-              level_descriptors.back().conservativeResize(level_idx, 128);
+              level_descriptors.back().conservativeResize(level_idx,
+                                                          descriptor_dim);
             }
           }
 
@@ -205,51 +365,22 @@ class SiftCPUFeatureExtractor : public FeatureExtractor {
                                        num_keypoints);
           if (descriptors != nullptr) {
             level_descriptors.emplace_back(
-                options_.max_num_orientations * num_keypoints, 128);
+                options_.max_num_orientations * num_keypoints, descriptor_dim);
           }
         }
 
         level_num_features.back() += 1;
         prev_level = vl_keypoints[i].is;
 
-        // Extract feature orientations.
-        double angles[4];
-        int num_orientations;
-        if (options_.upright) {
-          num_orientations = 1;
-          angles[0] = 0.0;
-        } else {
-          num_orientations = vl_sift_calc_keypoint_orientations(
-              sift_.get(), angles, &vl_keypoints[i]);
-        }
-
-        // Note that this is different from SiftGPU, which selects the top
-        // global maxima as orientations while this selects the first two
-        // local maxima. It is not clear which procedure is better.
-        const int num_used_orientations =
-            std::min(num_orientations, options_.max_num_orientations);
-
-        for (int o = 0; o < num_used_orientations; ++o) {
+        for (int o = 0; o < keypoint_num_orientations[i]; ++o) {
           level_keypoints.back()[level_idx] =
               FeatureKeypoint(vl_keypoints[i].x + 0.5f,
                               vl_keypoints[i].y + 0.5f,
                               vl_keypoints[i].sigma,
-                              angles[o]);
+                              keypoint_angles[i][o]);
           if (descriptors != nullptr) {
-            vl_sift_calc_keypoint_descriptor(
-                sift_.get(), desc.data(), &vl_keypoints[i], angles[o]);
-            if (options_.normalization ==
-                SiftExtractionOptions::Normalization::L2) {
-              L2NormalizeFeatureDescriptors(&desc);
-            } else if (options_.normalization ==
-                       SiftExtractionOptions::Normalization::L1_ROOT) {
-              L1RootNormalizeFeatureDescriptors(&desc);
-            } else {
-              LOG(FATAL_THROW) << "Normalization type not supported";
-            }
-
             level_descriptors.back().row(level_idx) =
-                FeatureDescriptorsToUnsignedByte(desc);
+                keypoint_descriptors.row(i * max_num_used_orientations + o);
           }
 
           level_idx += 1;
@@ -259,7 +390,7 @@ class SiftCPUFeatureExtractor : public FeatureExtractor {
       // Resize containers for last DOG level in octave.
       level_keypoints.back().resize(level_idx);
       if (descriptors != nullptr) {
-        level_descriptors.back().conservativeResize(level_idx, 128);
+        level_descriptors.back().conservativeResize(level_idx, descriptor_dim);
       }
     }
 
@@ -291,22 +422,43 @@ class SiftCPUFeatureExtractor : public FeatureExtractor {
     // Compute the descriptors for the detected keypoints.
     if (descriptors != nullptr) {
       size_t k = 0;
-      descriptors->resize(num_features_with_orientations, 128);
+      descriptors->resize(num_features_with_orientations, descriptor_dim);
       for (size_t i = first_level_to_keep; i < level_keypoints.size(); ++i) {
         for (size_t j = 0; j < level_keypoints[i].size(); ++j) {
           descriptors->row(k) = level_descriptors[i].row(j);
           k += 1;
         }
       }
-      *descriptors = TransformVLFeatToUBCFeatureDescriptors(*descriptors);
+      // Compact descriptors are already in the original SIFT format.
+      if (!options_.compact_descriptors) {
+        *descriptors = TransformVLFeatToUBCFeatureDescriptors(*descriptors);
+      }
     }
 
     return true;
   }
 
  private:
+  // Compute the gradients of the current octave by extracting the
+  // orientations of a keypoint at its center, which is always within bounds.
+  void ComputeOctaveGradients() {
+    const double scale = std::pow(2.0, vl_sift_get_octave_index(sift_.get()));
+    VlSiftKeypoint keypoint;
+    keypoint.o = vl_sift_get_octave_index(sift_.get());
+    keypoint.ix = vl_sift_get_octave_width(sift_.get()) / 2;
+    keypoint.iy = vl_sift_get_octave_height(sift_.get()) / 2;
+    keypoint.is = sift_->s_min + 1;
+    keypoint.x = static_cast<float>(keypoint.ix * scale);
+    keypoint.y = static_cast<float>(keypoint.iy * scale);
+    keypoint.s = static_cast<float>(keypoint.is);
+    keypoint.sigma = static_cast<float>(sift_->sigma0 * scale);
+    double angles[4];
+    vl_sift_calc_keypoint_orientations(sift_.get(), angles, &keypoint);
+  }
+
   const SiftExtractionOptions options_;
   VlSiftType sift_;
+  std::unique_ptr<ThreadPool> thread_pool_;
 };
 
 class CovariantSiftCPUFeatureExtractor : public FeatureExtractor {
@@ -347,11 +499,8 @@ class CovariantSiftCPUFeatureExtractor : public FeatureExtractor {
     vl_covdet_set_edge_threshold(covdet.get(), options_.edge_threshold);
 
     {
-      const std::vector<uint8_t> data_uint8 = bitmap.ConvertToRowMajorArray();
-      std::vector<float> data_float(data_uint8.size());
-      for (size_t i = 0; i < data_uint8.size(); ++i) {
-        data_float[i] = static_cast<float>(data_uint8[i]) / 255.0f;
-      }
+      const std::vector<float> data_float =
+          ConvertToNormalizedFloatArray(bitmap.View());
       vl_covdet_put_image(
           covdet.get(), data_float.data(), bitmap.Width(), bitmap.Height());
     }
@@ -411,7 +560,9 @@ class CovariantSiftCPUFeatureExtractor : public FeatureExtractor {
 
     // Compute the descriptors for the detected keypoints.
     if (descriptors != nullptr) {
-      descriptors->resize(keypoints->size(), 128);
+      descriptors->resize(
+          keypoints->size(),
+          options_.compact_descriptors ? kCompactSiftDescriptorDim : 128);
 
       const size_t kPatchResolution = 15;
       const size_t kPatchSide = 2 * kPatchResolution + 1;
@@ -490,6 +641,13 @@ class CovariantSiftCPUFeatureExtractor : public FeatureExtractor {
 
         THROW_CHECK_EQ(descriptor.cols(), 128);
 
+        if (options_.compact_descriptors) {
+          FeatureDescriptorsFloat compact_descriptor;
+          CompactSiftFeatureDescriptors(
+              descriptor, kVLFeatOrientationBins, &compact_descriptor);
+          descriptor = std::move(compact_descriptor);
+        }
+
         if (options_.normalization ==
             SiftExtractionOptions::Normalization::L2) {
           L2NormalizeFeatureDescriptors(&descriptor);
@@ -503,7 +661,10 @@ class CovariantSiftCPUFeatureExtractor : public FeatureExtractor {
         descriptors->row(i) = FeatureDescriptorsToUnsignedByte(descriptor);
       }
 
-      *descriptors = TransformVLFeatToUBCFeatureDescriptors(*descriptors);
+      // Compact descriptors are already in the original SIFT format.
+      if (!options_.compact_descriptors) {
+        *descriptors = TransformVLFeatToUBCFeatureDescriptors(*descriptors);
+      }
     }
 
     return true;
@@ -550,6 +711,7 @@ class SiftGPUFeatureExtractor : public FeatureExtractor {
     if (gpu_indices[0] >= 0) {
       sift_gpu_args.push_back("-cuda");
       sift_gpu_args.push_back(std::to_string(gpu_indices[0]));
+      SetCudaDeviceThreadAffinity(gpu_indices[0]);
     }
 #endif  // COLMAP_CUDA_ENABLED
 
@@ -649,12 +811,68 @@ class SiftGPUFeatureExtractor : public FeatureExtractor {
 
     std::lock_guard<std::mutex> lock(*sift_gpu_mutexes_[sift_gpu_.gpu_index]);
 
+    return ExtractLocked(bitmap, keypoints, descriptors);
+  }
+
+  bool ExtractBatch(const std::vector<const Bitmap*>& bitmaps,
+                    std::vector<FeatureKeypoints>* keypoints,
+                    std::vector<FeatureDescriptors>* descriptors) override {
+    THROW_CHECK_NOTNULL(keypoints);
+    THROW_CHECK_NOTNULL(descriptors);
+
+    if (bitmaps.empty()) {
+      keypoints->clear();
+      descriptors->clear();
+      return true;
+    }
+
+    for (const Bitmap* bitmap : bitmaps) {
+      THROW_CHECK(bitmap->IsGrey());
+      THROW_CHECK_EQ(bitmap->Width(), bitmaps[0]->Width());
+      THROW_CHECK_EQ(bitmap->Height(), bitmaps[0]->Height());
+    }
+
+    const int compensation_factor = 1 << -std::min(0, options_.first_octave);
+    THROW_CHECK_EQ(options_.max_image_size * compensation_factor,
+                   sift_gpu_.GetMaxDimension());
+
+    keypoints->resize(bitmaps.size());
+    descriptors->resize(bitmaps.size());
+
+    // Hold the device for the entire batch. Since all bitmaps have the same
+    // dimensions, SiftGPU reuses its pyramid allocations between the images
+    // and the host-side buffers are only allocated once.
+    std::lock_guard<std::mutex> lock(*sift_gpu_mutexes_[sift_gpu_.gpu_index]);
+
+    for (size_t i = 0; i < bitmaps.size(); ++i) {
+      if (!ExtractLocked(*bitmaps[i], &(*keypoints)[i], &(*descriptors)[i])) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+ private:
+  // Requires the mutex of the GPU to be locked by the caller.
+  bool ExtractLocked(const Bitmap& bitmap,
+                     FeatureKeypoints* keypoints,
+                     FeatureDescriptors* descriptors) {
     // Note, that this produces slightly different results than using SiftGPU
     // directly for RGB->GRAY conversion, since it uses different weights.
-    const std::vector<uint8_t> bitmap_raw_bits = bitmap.ConvertToRawBits();
-    const int code = sift_gpu_.RunSIFT(bitmap.Pitch(),
+    // The raw bits are written into a buffer that is reused across calls.
+    const unsigned int pitch = bitmap.Pitch();
+    bitmap_buffer_.resize(static_cast<size_t>(pitch) * bitmap.Height());
+    for (int y = 0; y < bitmap.Height(); ++y) {
+      const uint8_t* scanline = bitmap.GetScanline(y);
+      std::copy(scanline,
+                scanline + pitch,
+                bitmap_buffer_.data() + static_cast<size_t>(y) * pitch);
+    }
+
+    const int code = sift_gpu_.RunSIFT(pitch,
                                        bitmap.Height(),
-                                       bitmap_raw_bits.data(),
+                                       bitmap_buffer_.data(),
                                        GL_LUMINANCE,
                                        GL_UNSIGNED_BYTE);
 
@@ -666,12 +884,11 @@ class SiftGPUFeatureExtractor : public FeatureExtractor {
     const size_t num_features = static_cast<size_t>(sift_gpu_.GetFeatureNum());
 
     keypoints_buffer_.resize(num_features);
-
-    FeatureDescriptorsFloat descriptors_float(num_features, 128);
+    descriptors_buffer_.resize(num_features, 128);
 
     // Download the extracted keypoints and descriptors.
     sift_gpu_.GetFeatureVector(keypoints_buffer_.data(),
-                               descriptors_float.data());
+                               descriptors_buffer_.data());
 
     keypoints->resize(num_features);
     for (size_t i = 0; i < num_features; ++i) {
@@ -681,25 +898,36 @@ class SiftGPUFeatureExtractor : public FeatureExtractor {
                                         keypoints_buffer_[i].o);
     }
 
-    // Save and normalize the descriptors.
+    // Save and normalize the descriptors. SiftGPU returns L2-normalized
+    // descriptors, which can be compacted before normalizing them again.
+    FeatureDescriptorsFloat* output_descriptors = &descriptors_buffer_;
+    if (options_.compact_descriptors) {
+      CompactSiftFeatureDescriptors(descriptors_buffer_,
+                                    kUBCOrientationBins,
+                                    &compact_descriptors_buffer_);
+      output_descriptors = &compact_descriptors_buffer_;
+    }
+
     if (options_.normalization == SiftExtractionOptions::Normalization::L2) {
-      L2NormalizeFeatureDescriptors(&descriptors_float);
+      L2NormalizeFeatureDescriptors(output_descriptors);
     } else if (options_.normalization ==
                SiftExtractionOptions::Normalization::L1_ROOT) {
-      L1RootNormalizeFeatureDescriptors(&descriptors_float);
+      L1RootNormalizeFeatureDescriptors(output_descriptors);
     } else {
       LOG(FATAL_THROW) << "Normalization type not supported";
     }
 
-    *descriptors = FeatureDescriptorsToUnsignedByte(descriptors_float);
+    *descriptors = FeatureDescriptorsToUnsignedByte(*output_descriptors);
 
     return true;
   }
 
- private:
   const SiftExtractionOptions options_;
   SiftGPU sift_gpu_;
+  std::vector<uint8_t> bitmap_buffer_;
   std::vector<SiftKeypoint> keypoints_buffer_;
+  FeatureDescriptorsFloat descriptors_buffer_;
+  FeatureDescriptorsFloat compact_descriptors_buffer_;
 };
 #endif  // COLMAP_GPU_ENABLED
 
@@ -726,38 +954,54 @@ std::unique_ptr<FeatureExtractor> CreateSiftFeatureExtractor(
 
 namespace {
 
-size_t FindBestMatchesOneWayBruteForce(const Eigen::MatrixXi& dists,
-                                       const float max_ratio,
-                                       const float max_distance,
-                                       std::vector<int>* matches) {
+// Full and compact SIFT descriptors can both be matched, but not against each
+// other, since their dot products are not comparable.
+void CheckSiftDescriptorDim(const FeatureDescriptors& descriptors) {
+  THROW_CHECK(descriptors.cols() == 128 ||
+              descriptors.cols() == kCompactSiftDescriptorDim)
+      << "SIFT descriptors must have 128 or " << kCompactSiftDescriptorDim
+      << " dimensions";
+}
+
+// Best and second best dot product of a descriptor with all descriptors of the
+// other image. Ties are resolved in favor of the smaller index.
+struct BestSiftMatch {
+  int idx = -1;
+  int dist = 0;
+  int second_dist = 0;
+
+  inline void Update(const int other_idx, const int other_dist) {
+    if (other_dist > dist) {
+      idx = other_idx;
+      second_dist = dist;
+      dist = other_dist;
+    } else if (other_dist > second_dist) {
+      second_dist = other_dist;
+    }
+  }
+};
+
+size_t FindBestMatchesOneWayBruteForce(
+    const std::vector<BestSiftMatch>& best_matches,
+    const float max_ratio,
+    const float max_distance,
+    std::vector<int>* matches) {
   // SIFT descriptor vectors are normalized to length 512.
   const float kDistNorm = 1.0f / (512.0f * 512.0f);
 
   size_t num_matches = 0;
-  matches->resize(dists.rows(), -1);
+  matches->resize(best_matches.size(), -1);
 
-  for (Eigen::Index i1 = 0; i1 < dists.rows(); ++i1) {
-    int best_i2 = -1;
-    int best_dist = 0;
-    int second_best_dist = 0;
-    for (Eigen::Index i2 = 0; i2 < dists.cols(); ++i2) {
-      const int dist = dists(i1, i2);
-      if (dist > best_dist) {
-        best_i2 = i2;
-        second_best_dist = best_dist;
-        best_dist = dist;
-      } else if (dist > second_best_dist) {
-        second_best_dist = dist;
-      }
-    }
+  for (size_t i1 = 0; i1 < best_matches.size(); ++i1) {
+    const BestSiftMatch& best_match = best_matches[i1];
 
     // Check if any match found.
-    if (best_i2 == -1) {
+    if (best_match.idx == -1) {
       continue;
     }
 
     const float best_dist_normed =
-        std::acos(std::min(kDistNorm * best_dist, 1.0f));
+        std::acos(std::min(kDistNorm * best_match.dist, 1.0f));
 
     // Check if match distance passes threshold.
     if (best_dist_normed > max_distance) {
@@ -765,7 +1009,7 @@ size_t FindBestMatchesOneWayBruteForce(const Eigen::MatrixXi& dists,
     }
 
     const float second_best_dist_normed =
-        std::acos(std::min(kDistNorm * second_best_dist, 1.0f));
+        std::acos(std::min(kDistNorm * best_match.second_dist, 1.0f));
 
     // Check if match passes ratio test. Keep this comparison >= in order to
     // ensure that the case of best == second_best is detected.
@@ -774,27 +1018,80 @@ size_t FindBestMatchesOneWayBruteForce(const Eigen::MatrixXi& dists,
     }
 
     num_matches += 1;
-    (*matches)[i1] = best_i2;
+    (*matches)[i1] = best_match.idx;
   }
 
   return num_matches;
 }
 
-void FindBestMatchesBruteForce(const Eigen::MatrixXi& dists,
+// Find the best and second best matches in both directions without
+// materializing the full distance matrix. The dot products are computed for
+// blocks of descriptors using a single-precision matrix product, which is
+// exact, since all partial sums of products of 8-bit integers in up to 128
+// dimensions are integers below 2^24. The blocks are visited in order of
+// increasing indices in both images, such that ties are resolved exactly as
+// in a sequential scan of the full distance matrix.
+void FindBestSiftMatchesBlocked(const FeatureDescriptorsFloat& descriptors1,
+                                const FeatureDescriptorsFloat& descriptors2,
+                                std::vector<BestSiftMatch>* best_matches12,
+                                std::vector<BestSiftMatch>* best_matches21) {
+  THROW_CHECK_EQ(descriptors1.cols(), descriptors2.cols());
+  THROW_CHECK_LE(descriptors1.cols(), 128);
+
+  // The distances of a block have a size of 1MB.
+  constexpr Eigen::Index kBlockSize1 = 256;
+  constexpr Eigen::Index kBlockSize2 = 1024;
+
+  best_matches12->assign(descriptors1.rows(), BestSiftMatch());
+  best_matches21->assign(descriptors2.rows(), BestSiftMatch());
+
+  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> dists;
+  for (Eigen::Index begin1 = 0; begin1 < descriptors1.rows();
+       begin1 += kBlockSize1) {
+    const Eigen::Index num1 =
+        std::min(kBlockSize1, descriptors1.rows() - begin1);
+    for (Eigen::Index begin2 = 0; begin2 < descriptors2.rows();
+         begin2 += kBlockSize2) {
+      const Eigen::Index num2 =
+          std::min(kBlockSize2, descriptors2.rows() - begin2);
+      dists.resize(num1, num2);
+      dists.noalias() = descriptors1.middleRows(begin1, num1) *
+                        descriptors2.middleRows(begin2, num2).transpose();
+      for (Eigen::Index i1 = 0; i1 < num1; ++i1) {
+        const float* dists_row = dists.row(i1).data();
+        BestSiftMatch& best_match12 = (*best_matches12)[begin1 + i1];
+        BestSiftMatch* best_matches21_block = &(*best_matches21)[begin2];
+        for (Eigen::Index i2 = 0; i2 < num2; ++i2) {
+          const int dist = static_cast<int>(dists_row[i2]);
+          best_match12.Update(begin2 + i2, dist);
+          best_matches21_block[i2].Update(begin1 + i1, dist);
+        }
+      }
+    }
+  }
+}
+
+void FindBestMatchesBruteForce(const FeatureDescriptorsFloat& descriptors1,
+                               const FeatureDescriptorsFloat& descriptors2,
                                const float max_ratio,
                                const float max_distance,
                                const bool cross_check,
                                FeatureMatches* matches) {
   matches->clear();
 
+  std::vector<BestSiftMatch> best_matches12;
+  std::vector<BestSiftMatch> best_matches21;
+  FindBestSiftMatchesBlocked(
+      descriptors1, descriptors2, &best_matches12, &best_matches21);
+
   std::vector<int> matches12;
   const size_t num_matches12 = FindBestMatchesOneWayBruteForce(
-      dists, max_ratio, max_distance, &matches12);
+      best_matches12, max_ratio, max_distance, &matches12);
 
   if (cross_check) {
     std::vector<int> matches21;
     const size_t num_matches21 = FindBestMatchesOneWayBruteForce(
-        dists.transpose(), max_ratio, max_distance, &matches21);
+        best_matches21, max_ratio, max_distance, &matches21);
     matches->reserve(std::min(num_matches12, num_matches21));
     for (size_t i1 = 0; i1 < matches12.size(); ++i1) {
       if (matches12[i1] != -1 && matches21[matches12[i1]] != -1 &&
@@ -831,10 +1128,12 @@ Eigen::MatrixXi ComputeSiftDistanceMatrix(
     THROW_CHECK_EQ(keypoints2->size(), descriptors2.rows());
   }
 
-  const Eigen::Matrix<int, Eigen::Dynamic, 128> descriptors1_int =
-      descriptors1.cast<int>();
-  const Eigen::Matrix<int, Eigen::Dynamic, 128> descriptors2_int =
-      descriptors2.cast<int>();
+  THROW_CHECK_EQ(descriptors1.cols(), descriptors2.cols());
+
+  const Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      descriptors1_int = descriptors1.cast<int>();
+  const Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      descriptors2_int = descriptors2.cast<int>();
 
   Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> dists(
       descriptors1.rows(), descriptors2.rows());
@@ -876,7 +1175,7 @@ void FindNearestNeighborsFlann(
   indices->resize(query.rows(), num_nearest_neighbors);
   distances->resize(query.rows(), num_nearest_neighbors);
   const flann::Matrix<uint8_t> query_matrix(
-      const_cast<uint8_t*>(query.data()), query.rows(), 128);
+      const_cast<uint8_t*>(query.data()), query.rows(), query.cols());
 
   flann::Matrix<int> indices_matrix(
       indices->data(), query.rows(), num_nearest_neighbors);
@@ -1022,28 +1321,34 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
     matches->clear();
 
     if (descriptors1 != nullptr) {
-      THROW_CHECK_EQ(descriptors1->cols(), 128);
-      descriptors1_ = descriptors1;
-      flann_index1_ = BuildFlannIndex(*descriptors1_);
+      CheckSiftDescriptorDim(*descriptors1);
+      SetDescriptors1(descriptors1);
     }
 
     if (descriptors2 != nullptr) {
-      THROW_CHECK_EQ(descriptors2->cols(), 128);
-      descriptors2_ = descriptors2;
-      flann_index2_ = BuildFlannIndex(*descriptors2_);
+      CheckSiftDescriptorDim(*descriptors2);
+      SetDescriptors2(descriptors2);
     }
 
     THROW_CHECK_NOTNULL(descriptors1_);
     THROW_CHECK_NOTNULL(descriptors2_);
+    THROW_CHECK_EQ(descriptors1_->cols(), descriptors2_->cols());
 
     if (descriptors1_->rows() == 0 || descriptors2_->rows() == 0) {
       return;
     }
 
     if (options_.brute_force_cpu_matcher) {
-      const Eigen::MatrixXi distances = ComputeSiftDistanceMatrix(
-          nullptr, nullptr, *descriptors1_, *descriptors2_, nullptr);
-      FindBestMatchesBruteForce(distances,
+      // The converted descriptors are cached, since one of the images is
+      // typically matched against many others.
+      if (descriptors1_float_.rows() == 0) {
+        descriptors1_float_ = descriptors1_->cast<float>();
+      }
+      if (descriptors2_float_.rows() == 0) {
+        descriptors2_float_ = descriptors2_->cast<float>();
+      }
+      FindBestMatchesBruteForce(descriptors1_float_,
+                                descriptors2_float_,
                                 options_.max_ratio,
                                 options_.max_distance,
                                 options_.cross_check,
@@ -1051,6 +1356,15 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
       return;
     }
 
+    // The indices are only built on demand, since they are not needed for
+    // brute-force and guided matching.
+    if (flann_index1_ == nullptr && options_.cross_check) {
+      flann_index1_ = BuildFlannIndex(*descriptors1_);
+    }
+    if (flann_index2_ == nullptr) {
+      flann_index2_ = BuildFlannIndex(*descriptors2_);
+    }
+
     Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
         indices_1to2;
     Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
@@ -1096,19 +1410,17 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
     if (descriptors1 != nullptr) {
       THROW_CHECK_NOTNULL(keypoints1);
       THROW_CHECK_EQ(descriptors1->rows(), keypoints1->size());
-      THROW_CHECK_EQ(descriptors1->cols(), 128);
+      CheckSiftDescriptorDim(*descriptors1);
       keypoints1_ = keypoints1;
-      descriptors1_ = descriptors1;
-      flann_index1_ = BuildFlannIndex(*descriptors1_);
+      SetDescriptors1(descriptors1);
     }
 
     if (descriptors2 != nullptr) {
       THROW_CHECK_NOTNULL(keypoints2);
       THROW_CHECK_EQ(descriptors2->rows(), keypoints2->size());
-      THROW_CHECK_EQ(descriptors2->cols(), 128);
+      CheckSiftDescriptorDim(*descriptors2);
       keypoints2_ = keypoints2;
-      descriptors2_ = descriptors2;
-      flann_index2_ = BuildFlannIndex(*descriptors2_);
+      SetDescriptors2(descriptors2);
     }
 
     const float max_residual = max_error * max_error;
@@ -1184,15 +1496,30 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
  private:
   using FlannIndexType = flann::Index<flann::L2<uint8_t>>;
 
+  void SetDescriptors1(
+      const std::shared_ptr<const FeatureDescriptors>& descriptors) {
+    descriptors1_ = descriptors;
+    descriptors1_float_.resize(0, descriptors->cols());
+    flann_index1_.reset();
+  }
+
+  void SetDescriptors2(
+      const std::shared_ptr<const FeatureDescriptors>& descriptors) {
+    descriptors2_ = descriptors;
+    descriptors2_float_.resize(0, descriptors->cols());
+    flann_index2_.reset();
+  }
+
   static std::unique_ptr<FlannIndexType> BuildFlannIndex(
       const FeatureDescriptors& descriptors) {
-    THROW_CHECK_EQ(descriptors.cols(), 128);
     if (descriptors.rows() == 0) {
       // Flann is not happy when the input has no descriptors.
       return nullptr;
     }
     const flann::Matrix<uint8_t> descriptors_matrix(
-        const_cast<uint8_t*>(descriptors.data()), descriptors.rows(), 128);
+        const_cast<uint8_t*>(descriptors.data()),
+        descriptors.rows(),
+        descriptors.cols());
     constexpr size_t kNumTreesInForest = 4;
     auto index = std::make_unique<FlannIndexType>(
         descriptors_matrix, flann::KDTreeIndexParams(kNumTreesInForest));
@@ -1205,6 +1532,8 @@ class SiftCPUFeatureMatcher : public FeatureMatcher {
   std::shared_ptr<const FeatureKeypoints> keypoints2_;
   std::shared_ptr<const FeatureDescriptors> descriptors1_;
   std::shared_ptr<const FeatureDescriptors> descriptors2_;
+  FeatureDescriptorsFloat descriptors1_float_;
+  FeatureDescriptorsFloat descriptors2_float_;
   std::unique_ptr<FlannIndexType> flann_index1_;
   std::unique_ptr<FlannIndexType> flann_index2_;
 };
@@ -1246,6 +1575,7 @@ class SiftGPUFeatureMatcher : public FeatureMatcher {
     if (gpu_indices[0] >= 0) {
       matcher->sift_match_gpu_.SetLanguage(
           SiftMatchGPU::SIFTMATCH_CUDA_DEVICE0 + gpu_indices[0]);
+      SetCudaDeviceThreadAffinity(gpu_indices[0]);
     } else {
       matcher->sift_match_gpu_.SetLanguage(SiftMatchGPU::SIFTMATCH_CUDA);
     }
@@ -1276,11 +1606,34 @@ class SiftGPUFeatureMatcher : public FeatureMatcher {
     }
 #endif  // COLMAP_CUDA_ENABLED
 
+    // Keep recently matched descriptors resident in GPU memory, so that images
+    // matched against many others are only uploaded once. Only supported by
+    // the CUDA version of SiftGPU.
+    matcher->descriptor_cache_size_ =
+        matcher->sift_match_gpu_.SetDescriptorCacheSize(-1);
+    // The concurrent matchers on the same GPU share its memory.
+    if (matcher->descriptor_cache_size_ > 0 &&
+        options.num_matchers_per_gpu > 1) {
+      matcher->descriptor_cache_size_ =
+          matcher->sift_match_gpu_.SetDescriptorCacheSize(
+              matcher->descriptor_cache_size_ / options.num_matchers_per_gpu);
+    }
+    if (matcher->descriptor_cache_size_ > 0) {
+      VLOG(2) << "Caching up to " << matcher->descriptor_cache_size_
+              << " descriptor sets in GPU memory";
+    }
+
     matcher->sift_match_gpu_.gpu_index = gpu_indices[0];
+#if !defined(COLMAP_CUDA_ENABLED)
+    // Only the OpenGL version shares state between the matchers on the same
+    // GPU. The CUDA version keeps all state in the matcher, so that multiple
+    // matchers can run on the same GPU at the same time.
     if (sift_match_gpu_mutexes_.count(gpu_indices[0]) == 0) {
       sift_match_gpu_mutexes_.emplace(gpu_indices[0],
                                       std::make_unique<std::mutex>());
     }
+    matcher->gpu_mutex_ = sift_match_gpu_mutexes_[gpu_indices[0]].get();
+#endif
 
     return matcher;
   }
@@ -1291,23 +1644,26 @@ class SiftGPUFeatureMatcher : public FeatureMatcher {
     THROW_CHECK_NOTNULL(matches);
     matches->clear();
 
-    std::lock_guard<std::mutex> lock(
-        *sift_match_gpu_mutexes_[sift_match_gpu_.gpu_index]);
+    std::unique_lock<std::mutex> lock = LockGPU();
 
     if (descriptors1 != nullptr) {
-      THROW_CHECK_EQ(descriptors1->cols(), 128);
       WarnIfMaxNumMatchesReachedGPU(*descriptors1);
-      sift_match_gpu_.SetDescriptors(
-          0, descriptors1->rows(), descriptors1->data());
+      sift_match_gpu_.SetDescriptors(0,
+                                     descriptors1->rows(),
+                                     GetDescriptorsData(0, *descriptors1),
+                                     GetDescriptorsId(descriptors1));
     }
 
     if (descriptors2 != nullptr) {
-      THROW_CHECK_EQ(descriptors2->cols(), 128);
       WarnIfMaxNumMatchesReachedGPU(*descriptors2);
-      sift_match_gpu_.SetDescriptors(
-          1, descriptors2->rows(), descriptors2->data());
+      sift_match_gpu_.SetDescriptors(1,
+                                     descriptors2->rows(),
+                                     GetDescriptorsData(1, *descriptors2),
+                                     GetDescriptorsId(descriptors2));
     }
 
+    THROW_CHECK_EQ(descriptor_dims_[0], descriptor_dims_[1]);
+
     matches->resize(static_cast<size_t>(options_.max_num_matches));
 
     const int num_matches = sift_match_gpu_.GetSiftMatch(
@@ -1345,19 +1701,19 @@ class SiftGPUFeatureMatcher : public FeatureMatcher {
     THROW_CHECK_NOTNULL(two_view_geometry);
     two_view_geometry->inlier_matches.clear();
 
-    std::lock_guard<std::mutex> lock(
-        *sift_match_gpu_mutexes_[sift_match_gpu_.gpu_index]);
+    std::unique_lock<std::mutex> lock = LockGPU();
 
     constexpr size_t kFeatureShapeNumElems = 4;
 
     if (descriptors1 != nullptr) {
       THROW_CHECK_NOTNULL(keypoints1);
       THROW_CHECK_EQ(descriptors1->rows(), keypoints1->size());
-      THROW_CHECK_EQ(descriptors1->cols(), 128);
       WarnIfMaxNumMatchesReachedGPU(*descriptors1);
       const size_t kIndex = 0;
-      sift_match_gpu_.SetDescriptors(
-          kIndex, descriptors1->rows(), descriptors1->data());
+      sift_match_gpu_.SetDescriptors(kIndex,
+                                     descriptors1->rows(),
+                                     GetDescriptorsData(kIndex, *descriptors1),
+                                     GetDescriptorsId(descriptors1));
       sift_match_gpu_.SetFeautreLocation(
           kIndex,
           reinterpret_cast<const float*>(keypoints1->data()),
@@ -1367,11 +1723,12 @@ class SiftGPUFeatureMatcher : public FeatureMatcher {
     if (descriptors2 != nullptr) {
       THROW_CHECK_NOTNULL(keypoints2);
       THROW_CHECK_EQ(descriptors2->rows(), keypoints2->size());
-      THROW_CHECK_EQ(descriptors2->cols(), 128);
       WarnIfMaxNumMatchesReachedGPU(*descriptors2);
       const size_t kIndex = 1;
-      sift_match_gpu_.SetDescriptors(
-          kIndex, descriptors2->rows(), descriptors2->data());
+      sift_match_gpu_.SetDescriptors(kIndex,
+                                     descriptors2->rows(),
+                                     GetDescriptorsData(kIndex, *descriptors2),
+                                     GetDescriptorsId(descriptors2));
       sift_match_gpu_.SetFeautreLocation(
           kIndex,
           reinterpret_cast<const float*>(keypoints2->data()),
@@ -1397,6 +1754,7 @@ class SiftGPUFeatureMatcher : public FeatureMatcher {
     }
 
     THROW_CHECK(F_ptr != nullptr || H_ptr != nullptr);
+    THROW_CHECK_EQ(descriptor_dims_[0], descriptor_dims_[1]);
 
     two_view_geometry->inlier_matches.resize(
         static_cast<size_t>(options_.max_num_matches));
@@ -1427,6 +1785,13 @@ class SiftGPUFeatureMatcher : public FeatureMatcher {
   }
 
  private:
+  std::unique_lock<std::mutex> LockGPU() {
+    if (gpu_mutex_ == nullptr) {
+      return std::unique_lock<std::mutex>();
+    }
+    return std::unique_lock<std::mutex>(*gpu_mutex_);
+  }
+
   void WarnIfMaxNumMatchesReachedGPU(const FeatureDescriptors& descriptors) {
     if (sift_match_gpu_.GetMaxSift() < descriptors.rows()) {
       LOG(WARNING) << StringPrintf(
@@ -1437,8 +1802,70 @@ class SiftGPUFeatureMatcher : public FeatureMatcher {
     }
   }
 
+  // SiftMatchGPU only supports 128-dimensional descriptors, so compact
+  // descriptors are zero-padded, which does not change their dot products.
+  const uint8_t* GetDescriptorsData(const size_t index,
+                                    const FeatureDescriptors& descriptors) {
+    CheckSiftDescriptorDim(descriptors);
+    descriptor_dims_[index] = descriptors.cols();
+    if (descriptors.cols() == 128) {
+      return descriptors.data();
+    }
+    FeatureDescriptors& padded_descriptors = padded_descriptors_[index];
+    padded_descriptors.setZero(descriptors.rows(), 128);
+    padded_descriptors.leftCols(descriptors.cols()) = descriptors;
+    return padded_descriptors.data();
+  }
+
+  // SiftMatchGPU identifies resident descriptors by an integer id. The
+  // descriptors of an image are shared by all its pairs through the feature
+  // matcher cache, so their address identifies the image, as long as they are
+  // alive. Returns -1, if descriptors are not cached on the GPU.
+  int GetDescriptorsId(
+      const std::shared_ptr<const FeatureDescriptors>& descriptors) {
+    if (descriptor_cache_size_ <= 0) {
+      return -1;
+    }
+
+    auto it = descriptor_ids_.find(descriptors.get());
+    if (it != descriptor_ids_.end() && !it->second.first.expired()) {
+      return it->second.second;
+    }
+
+    // Forget about expired descriptors, whose address may be reused.
+    if (descriptor_ids_.size() >=
+        2 * static_cast<size_t>(descriptor_cache_size_)) {
+      for (auto id_it = descriptor_ids_.begin();
+           id_it != descriptor_ids_.end();) {
+        if (id_it->second.first.expired()) {
+          id_it = descriptor_ids_.erase(id_it);
+        } else {
+          ++id_it;
+        }
+      }
+    }
+
+    const int id = next_descriptors_id_;
+    next_descriptors_id_ =
+        next_descriptors_id_ == std::numeric_limits<int>::max()
+            ? 0
+            : next_descriptors_id_ + 1;
+    descriptor_ids_[descriptors.get()] = std::make_pair(descriptors, id);
+    return id;
+  }
+
   const SiftMatchingOptions options_;
   SiftMatchGPU sift_match_gpu_;
+  // Serializes the matchers on the same GPU, if not null.
+  std::mutex* gpu_mutex_ = nullptr;
+  int descriptor_cache_size_ = 0;
+  int next_descriptors_id_ = 0;
+  std::unordered_map<
+      const FeatureDescriptors*,
+      std::pair<std::weak_ptr<const FeatureDescriptors>, int>>
+      descriptor_ids_;
+  std::array<FeatureDescriptors::Index, 2> descriptor_dims_ = {{128, 128}};
+  std::array<FeatureDescriptors, 2> padded_descriptors_;
 };
 #endif  // COLMAP_GPU_ENABLED
 
@@ -1514,4 +1941,36 @@ void LoadSiftFeaturesFromTextFile(const std::string& path,
   }
 }
 
+void LoadSiftFeaturesFromBinaryFile(const std::string& path,
+                                    FeatureKeypoints* keypoints,
+                                    FeatureDescriptors* descriptors) {
+  THROW_CHECK_NOTNULL(keypoints);
+  THROW_CHECK_NOTNULL(descriptors);
+
+  std::ifstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  const uint32_t num_features = ReadBinaryLittleEndian<uint32_t>(&file);
+  const uint32_t dim = ReadBinaryLittleEndian<uint32_t>(&file);
+
+  THROW_CHECK_EQ(dim, 128) << "SIFT features must have 128 dimensions";
+
+  // Read the arrays at once rather than value by value.
+  std::vector<float> keypoint_values(4 * static_cast<size_t>(num_features));
+  file.read(reinterpret_cast<char*>(keypoint_values.data()),
+            keypoint_values.size() * sizeof(float));
+  descriptors->resize(num_features, dim);
+  file.read(reinterpret_cast<char*>(descriptors->data()), descriptors->size());
+  THROW_CHECK(!file.fail()) << "Failed to read " << path;
+
+  keypoints->resize(num_features);
+  for (size_t i = 0; i < num_features; ++i) {
+    const float* values = &keypoint_values[4 * i];
+    (*keypoints)[i] = FeatureKeypoint(LittleEndianToNative(values[0]),
+                                      LittleEndianToNative(values[1]),
+                                      LittleEndianToNative(values[2]),
+                                      LittleEndianToNative(values[3]));
+  }
+}
+
 }  //  namespace colmap
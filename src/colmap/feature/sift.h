@@ -38,6 +38,13 @@ struct SiftExtractionOptions {
   // Number of threads for feature extraction.
   int num_threads = -1;
 
+  // Number of threads used by the CPU extractor to compute the orientations
+  // and descriptors within a single image. This reduces the number of images
+  // that need to be processed concurrently, and thus the memory usage, for
+  // the same throughput. Note that each of the num_threads extraction threads
+  // uses this many threads.
+  int num_threads_per_image = 1;
+
   // Whether to use the GPU for feature extraction.
   bool use_gpu = true;
 
@@ -45,12 +52,29 @@ struct SiftExtractionOptions {
   // you should separate multiple GPU indices by comma, e.g., "0,1,2,3".
   std::string gpu_index = "-1";
 
+  // Number of images with the same dimensions that are extracted together on
+  // the GPU to amortize the per-image setup and transfer cost.
+  int gpu_batch_size = 4;
+
   // Maximum image size, otherwise image will be down-scaled.
   int max_image_size = 3200;
 
+  // Whether to extract the features of images larger than max_image_size at
+  // their original resolution in overlapping tiles of max_image_size instead
+  // of down-scaling them. Note that max_num_features then applies per tile.
+  bool tiled_extraction = false;
+
+  // Overlap in pixels between neighboring tiles in tiled extraction.
+  int tile_overlap = 128;
+
   // Maximum number of features to detect, keeping larger-scale features.
   int max_num_features = 8192;
 
+  // If positive, the detected features are reduced to this number by
+  // selecting them uniformly over the image, which preserves the coverage of
+  // the image with fewer features than max_num_features.
+  int max_num_uniform_features = -1;
+
   // First octave in the pyramid, i.e. -1 upsamples the image by one level.
   int first_octave = -1;
 
@@ -109,9 +133,20 @@ struct SiftExtractionOptions {
   };
   Normalization normalization = Normalization::L1_ROOT;
 
+  // Whether to extract compact descriptors with kCompactSiftDescriptorDim
+  // instead of 128 dimensions, which halves the storage, memory, and transfer
+  // cost of descriptors in matching. The compact descriptors sum neighboring
+  // pairs of the 8 orientation bins in each spatial bin before normalization.
+  // Images with compact and full descriptors cannot be matched against each
+  // other and vocabulary tree matching requires full descriptors.
+  bool compact_descriptors = false;
+
   bool Check() const;
 };
 
+// Dimensionality of descriptors extracted with compact_descriptors.
+constexpr int kCompactSiftDescriptorDim = 64;
+
 // Create a Sift feature extractor based on the provided options. The same
 // feature extractor instance can be used to extract features for multiple
 // images in the same thread. Note that, for GPU based extraction, a OpenGL
@@ -132,6 +167,13 @@ struct SiftMatchingOptions {
   // you should separate multiple GPU indices by comma, e.g., "0,1,2,3".
   std::string gpu_index = "-1";
 
+  // Number of concurrent matchers on each GPU. The matchers use separate
+  // CUDA streams, such that the upload of descriptors and the processing of
+  // the matches on the host for one image pair overlap with the matching of
+  // other image pairs. Each matcher allocates its own GPU memory for up to
+  // max_num_matches features. Only supported by the CUDA version of SiftGPU.
+  int num_matchers_per_gpu = 1;
+
   // Maximum distance ratio between first and second best match.
   double max_ratio = 0.8;
 
@@ -150,6 +192,38 @@ struct SiftMatchingOptions {
   // Whether to use brute-force instead of FLANN based CPU matching.
   bool brute_force_cpu_matcher = false;
 
+  // Maximum number of image pairs and bytes of matches per database commit.
+  // The results are written in a separate thread, which commits them once one
+  // of the limits is reached, so that committing overlaps with matching.
+  int max_num_pairs_per_commit = 1000;
+  int max_num_bytes_per_commit = 64 * 1024 * 1024;
+
+  // Only match the image pairs of one out of multiple shards, e.g., to
+  // distribute matching across machines. The image pairs are deterministically
+  // partitioned by their pair identifier, so each shard can be matched into a
+  // separate copy of the database and the results merged afterwards.
+  int num_shards = 1;
+  int shard_index = 0;
+
+  // If positive, the image pairs are first matched using only this number of
+  // largest-scale features per image, and pairs with fewer than
+  // pre_filter_min_num_matches coarse matches are rejected without full
+  // matching. This avoids the full matching cost of most non-overlapping
+  // pairs, e.g., in unordered internet photo collections.
+  int pre_filter_num_features = -1;
+  int pre_filter_min_num_matches = 5;
+
+  // Whether to sort the matches of an image pair by decreasing descriptor
+  // similarity, so that they can be sampled progressively in geometric
+  // verification, see `TwoViewGeometryOptions::use_prosac`. Guided matches
+  // are not sorted.
+  bool sort_matches = false;
+
+  // Whether to reuse the stored matches of already verified image pairs and
+  // only run their geometric verification again, e.g., to tune the two-view
+  // geometry options without matching the features again.
+  bool reverify_matches = false;
+
   bool Check() const;
 };
 
@@ -177,4 +251,18 @@ void LoadSiftFeaturesFromTextFile(const std::string& path,
                                   FeatureKeypoints* keypoints,
                                   FeatureDescriptors* descriptors);
 
+// Load keypoints and descriptors from a binary file, which is much faster to
+// parse than the text format for large feature sets. All values are stored in
+// little endian byte order:
+//
+//    NUM_FEATURES:  uint32
+//    DIM:           uint32
+//    KEYPOINTS:     NUM_FEATURES x 4 float32 (X Y SCALE ORIENTATION)
+//    DESCRIPTORS:   NUM_FEATURES x DIM uint8
+//
+// where the keypoints and descriptors are stored in row-major order.
+void LoadSiftFeaturesFromBinaryFile(const std::string& path,
+                                    FeatureKeypoints* keypoints,
+                                    FeatureDescriptors* descriptors);
+
 }  // namespace colmap
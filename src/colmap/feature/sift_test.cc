@@ -39,10 +39,15 @@
 #include "colmap/feature/utils.h"
 #include "colmap/math/math.h"
 #include "colmap/math/random.h"
+#include "colmap/util/endian.h"
+#include "colmap/util/misc.h"
 #include "colmap/util/opengl_utils.h"
+#include "colmap/util/testing.h"
 
 #include "thirdparty/SiftGPU/SiftGPU.h"
 
+#include <fstream>
+
 namespace colmap {
 namespace {
 
@@ -88,6 +93,122 @@ TEST(ExtractSiftFeaturesCPU, Nominal) {
   }
 }
 
+TEST(ExtractSiftFeaturesCPU, MultiThreaded) {
+  Bitmap bitmap;
+  CreateImageWithSquare(256, &bitmap);
+
+  SiftExtractionOptions options;
+  options.use_gpu = false;
+  options.estimate_affine_shape = false;
+  options.domain_size_pooling = false;
+  options.force_covariant_extractor = false;
+  auto extractor = CreateSiftFeatureExtractor(options);
+
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  EXPECT_TRUE(extractor->Extract(bitmap, &keypoints, &descriptors));
+
+  options.num_threads_per_image = 4;
+  auto parallel_extractor = CreateSiftFeatureExtractor(options);
+
+  FeatureKeypoints parallel_keypoints;
+  FeatureDescriptors parallel_descriptors;
+  EXPECT_TRUE(parallel_extractor->Extract(
+      bitmap, &parallel_keypoints, &parallel_descriptors));
+
+  ASSERT_EQ(parallel_keypoints.size(), keypoints.size());
+  for (size_t i = 0; i < keypoints.size(); ++i) {
+    EXPECT_EQ(parallel_keypoints[i].x, keypoints[i].x);
+    EXPECT_EQ(parallel_keypoints[i].y, keypoints[i].y);
+    EXPECT_EQ(parallel_keypoints[i].ComputeOrientation(),
+              keypoints[i].ComputeOrientation());
+  }
+  EXPECT_EQ(parallel_descriptors, descriptors);
+}
+
+TEST(ExtractSiftFeaturesCPU, Batch) {
+  Bitmap bitmap1;
+  CreateImageWithSquare(256, &bitmap1);
+  Bitmap bitmap2;
+  CreateImageWithSquare(256, &bitmap2);
+
+  SiftExtractionOptions options;
+  options.use_gpu = false;
+  options.estimate_affine_shape = false;
+  options.domain_size_pooling = false;
+  options.force_covariant_extractor = false;
+  auto extractor = CreateSiftFeatureExtractor(options);
+
+  std::vector<FeatureKeypoints> batch_keypoints;
+  std::vector<FeatureDescriptors> batch_descriptors;
+  EXPECT_TRUE(extractor->ExtractBatch(
+      {&bitmap1, &bitmap2}, &batch_keypoints, &batch_descriptors));
+  ASSERT_EQ(batch_keypoints.size(), 2);
+  ASSERT_EQ(batch_descriptors.size(), 2);
+
+  const std::vector<const Bitmap*> bitmaps = {&bitmap1, &bitmap2};
+  for (size_t i = 0; i < bitmaps.size(); ++i) {
+    FeatureKeypoints keypoints;
+    FeatureDescriptors descriptors;
+    EXPECT_TRUE(extractor->Extract(*bitmaps[i], &keypoints, &descriptors));
+    ASSERT_EQ(batch_keypoints[i].size(), keypoints.size());
+    for (size_t j = 0; j < keypoints.size(); ++j) {
+      EXPECT_EQ(batch_keypoints[i][j].x, keypoints[j].x);
+      EXPECT_EQ(batch_keypoints[i][j].y, keypoints[j].y);
+    }
+    EXPECT_EQ(batch_descriptors[i], descriptors);
+  }
+}
+
+TEST(ExtractSiftFeaturesCPU, CompactDescriptors) {
+  Bitmap bitmap;
+  CreateImageWithSquare(256, &bitmap);
+
+  SiftExtractionOptions options;
+  options.use_gpu = false;
+  options.estimate_affine_shape = false;
+  options.domain_size_pooling = false;
+  options.force_covariant_extractor = false;
+  auto extractor = CreateSiftFeatureExtractor(options);
+
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  EXPECT_TRUE(extractor->Extract(bitmap, &keypoints, &descriptors));
+
+  options.compact_descriptors = true;
+  auto compact_extractor = CreateSiftFeatureExtractor(options);
+
+  FeatureKeypoints compact_keypoints;
+  FeatureDescriptors compact_descriptors;
+  EXPECT_TRUE(compact_extractor->Extract(
+      bitmap, &compact_keypoints, &compact_descriptors));
+
+  ASSERT_EQ(compact_keypoints.size(), keypoints.size());
+  ASSERT_EQ(compact_descriptors.rows(), descriptors.rows());
+  ASSERT_EQ(compact_descriptors.cols(), kCompactSiftDescriptorDim);
+
+  // With L1-root normalization, summing neighboring orientation bins of the
+  // raw descriptors corresponds to the root of the sum of squares of the
+  // normalized descriptors.
+  for (FeatureDescriptors::Index i = 0; i < descriptors.rows(); ++i) {
+    EXPECT_LT(std::abs(compact_descriptors.row(i).cast<float>().norm() - 512),
+              1);
+    Eigen::RowVectorXf expected_descriptor(kCompactSiftDescriptorDim);
+    for (int j = 0; j < kCompactSiftDescriptorDim; ++j) {
+      expected_descriptor(j) =
+          std::sqrt(static_cast<float>(descriptors(i, 2 * j)) *
+                        descriptors(i, 2 * j) +
+                    static_cast<float>(descriptors(i, 2 * j + 1)) *
+                        descriptors(i, 2 * j + 1));
+    }
+    expected_descriptor *= 512 / expected_descriptor.norm();
+    EXPECT_LT((compact_descriptors.row(i).cast<float>() - expected_descriptor)
+                  .cwiseAbs()
+                  .mean(),
+              1);
+  }
+}
+
 TEST(ExtractCovariantSiftFeaturesCPU, Nominal) {
   Bitmap bitmap;
   CreateImageWithSquare(256, &bitmap);
@@ -264,11 +385,56 @@ TEST(ExtractSiftFeaturesGPU, Nominal) {
   RunThreadWithOpenGLContext(&thread);
 }
 
-FeatureDescriptors CreateRandomFeatureDescriptors(const size_t num_features) {
+TEST(ExtractSiftFeaturesGPU, Batch) {
+  char app_name[] = "Test";
+  int argc = 1;
+  char* argv[] = {app_name};
+  QApplication app(argc, argv);
+
+  class TestThread : public Thread {
+   private:
+    void Run() {
+      opengl_context_.MakeCurrent();
+
+      Bitmap bitmap1;
+      CreateImageWithSquare(256, &bitmap1);
+      Bitmap bitmap2 = bitmap1.Clone();
+
+      SiftExtractionOptions options;
+      options.use_gpu = true;
+      options.estimate_affine_shape = false;
+      options.domain_size_pooling = false;
+      options.force_covariant_extractor = false;
+      auto extractor = CreateSiftFeatureExtractor(options);
+
+      FeatureKeypoints keypoints;
+      FeatureDescriptors descriptors;
+      EXPECT_TRUE(extractor->Extract(bitmap1, &keypoints, &descriptors));
+
+      std::vector<FeatureKeypoints> batch_keypoints;
+      std::vector<FeatureDescriptors> batch_descriptors;
+      EXPECT_TRUE(extractor->ExtractBatch(
+          {&bitmap1, &bitmap2}, &batch_keypoints, &batch_descriptors));
+      ASSERT_EQ(batch_keypoints.size(), 2);
+      ASSERT_EQ(batch_descriptors.size(), 2);
+      for (size_t i = 0; i < batch_keypoints.size(); ++i) {
+        EXPECT_EQ(batch_keypoints[i].size(), keypoints.size());
+        EXPECT_EQ(batch_descriptors[i].rows(), descriptors.rows());
+      }
+    }
+    OpenGLContextManager opengl_context_;
+  };
+
+  TestThread thread;
+  RunThreadWithOpenGLContext(&thread);
+}
+
+FeatureDescriptors CreateRandomFeatureDescriptors(const size_t num_features,
+                                                  const int dim = 128) {
   SetPRNGSeed(0);
-  FeatureDescriptorsFloat descriptors(num_features, 128);
+  FeatureDescriptorsFloat descriptors(num_features, dim);
   for (size_t i = 0; i < num_features; ++i) {
-    for (size_t j = 0; j < 128; ++j) {
+    for (int j = 0; j < dim; ++j) {
       descriptors(i, j) = std::pow(RandomUniformReal(0.0f, 1.0f), 2);
     }
   }
@@ -366,6 +532,108 @@ TEST(SiftCPUFeatureMatcher, Nominal) {
   EXPECT_EQ(matches.size(), 0);
 }
 
+TEST(SiftCPUFeatureMatcher, MatchBatch) {
+  const auto empty_descriptors = std::make_shared<FeatureDescriptors>(0, 128);
+  const auto query_descriptors =
+      std::make_shared<FeatureDescriptors>(CreateRandomFeatureDescriptors(50));
+  const auto reversed_descriptors = std::make_shared<FeatureDescriptors>(
+      query_descriptors->colwise().reverse());
+  const auto random_descriptors =
+      std::make_shared<FeatureDescriptors>(CreateRandomFeatureDescriptors(40));
+  const std::vector<std::shared_ptr<const FeatureDescriptors>>
+      target_descriptors = {reversed_descriptors,
+                            empty_descriptors,
+                            random_descriptors,
+                            query_descriptors};
+
+  for (const bool brute_force_cpu_matcher : {false, true}) {
+    SiftMatchingOptions options;
+    options.use_gpu = false;
+    options.brute_force_cpu_matcher = brute_force_cpu_matcher;
+    auto matcher = CreateSiftFeatureMatcher(options);
+
+    std::vector<FeatureMatches> batch_matches;
+    matcher->MatchBatch(query_descriptors, target_descriptors, &batch_matches);
+    ASSERT_EQ(batch_matches.size(), target_descriptors.size());
+    EXPECT_EQ(batch_matches[0].size(), 50);
+    EXPECT_EQ(batch_matches[1].size(), 0);
+    EXPECT_EQ(batch_matches[3].size(), 50);
+
+    for (size_t i = 0; i < target_descriptors.size(); ++i) {
+      FeatureMatches matches;
+      matcher->Match(query_descriptors, target_descriptors[i], &matches);
+      ASSERT_EQ(matches.size(), batch_matches[i].size());
+      for (size_t j = 0; j < matches.size(); ++j) {
+        EXPECT_EQ(matches[j].point2D_idx1, batch_matches[i][j].point2D_idx1);
+        EXPECT_EQ(matches[j].point2D_idx2, batch_matches[i][j].point2D_idx2);
+      }
+    }
+
+    // A null query reuses the query of the previous call.
+    matcher->MatchBatch(nullptr, {reversed_descriptors}, &batch_matches);
+    ASSERT_EQ(batch_matches.size(), 1);
+    EXPECT_EQ(batch_matches[0].size(), 50);
+
+    matcher->MatchBatch(query_descriptors, {}, &batch_matches);
+    EXPECT_TRUE(batch_matches.empty());
+  }
+}
+
+TEST(SiftCPUFeatureMatcher, CompactDescriptors) {
+  const auto descriptors1 = std::make_shared<FeatureDescriptors>(
+      CreateRandomFeatureDescriptors(2, kCompactSiftDescriptorDim));
+  const auto descriptors2 =
+      std::make_shared<FeatureDescriptors>(descriptors1->colwise().reverse());
+  const auto full_descriptors =
+      std::make_shared<FeatureDescriptors>(CreateRandomFeatureDescriptors(2));
+
+  for (const bool brute_force_cpu_matcher : {false, true}) {
+    SiftMatchingOptions options;
+    options.use_gpu = false;
+    options.brute_force_cpu_matcher = brute_force_cpu_matcher;
+    auto matcher = CreateSiftFeatureMatcher(options);
+
+    FeatureMatches matches;
+    matcher->Match(descriptors1, descriptors2, &matches);
+    EXPECT_EQ(matches.size(), 2);
+    EXPECT_EQ(matches[0].point2D_idx1, 0);
+    EXPECT_EQ(matches[0].point2D_idx2, 1);
+    EXPECT_EQ(matches[1].point2D_idx1, 1);
+    EXPECT_EQ(matches[1].point2D_idx2, 0);
+
+    EXPECT_ANY_THROW(matcher->Match(descriptors1, full_descriptors, &matches));
+  }
+}
+
+TEST(SiftCPUFeatureMatcher, BruteForceMultipleBlocks) {
+  // More descriptors than fit into a single block of the distance matrix.
+  constexpr int kNumFeatures = 1500;
+  const auto descriptors1 = std::make_shared<FeatureDescriptors>(
+      CreateRandomFeatureDescriptors(kNumFeatures));
+  const auto descriptors2 =
+      std::make_shared<FeatureDescriptors>(descriptors1->colwise().reverse());
+
+  SiftMatchingOptions options;
+  options.use_gpu = false;
+  options.brute_force_cpu_matcher = true;
+  auto matcher = CreateSiftFeatureMatcher(options);
+
+  FeatureMatches matches;
+  matcher->Match(descriptors1, descriptors2, &matches);
+  ASSERT_EQ(matches.size(), kNumFeatures);
+  for (int i = 0; i < kNumFeatures; ++i) {
+    EXPECT_EQ(matches[i].point2D_idx1, i);
+    EXPECT_EQ(matches[i].point2D_idx2, kNumFeatures - 1 - i);
+  }
+
+  matcher->Match(nullptr, descriptors1, &matches);
+  ASSERT_EQ(matches.size(), kNumFeatures);
+  for (int i = 0; i < kNumFeatures; ++i) {
+    EXPECT_EQ(matches[i].point2D_idx1, i);
+    EXPECT_EQ(matches[i].point2D_idx2, i);
+  }
+}
+
 TEST(SiftCPUFeatureMatcherFlannVsBruteForce, Nominal) {
   SiftMatchingOptions match_options;
   match_options.max_num_matches = 1000;
@@ -598,6 +866,17 @@ TEST(MatchSiftFeaturesGPU, Nominal) {
       EXPECT_EQ(matches[1].point2D_idx1, 1);
       EXPECT_EQ(matches[1].point2D_idx2, 0);
 
+      // Previously uploaded descriptors may be resident in GPU memory.
+      const auto descriptors3 = std::make_shared<FeatureDescriptors>(
+          CreateRandomFeatureDescriptors(2));
+      matcher->Match(descriptors3, descriptors1, &matches);
+      matcher->Match(descriptors2, descriptors1, &matches);
+      EXPECT_EQ(matches.size(), 2);
+      EXPECT_EQ(matches[0].point2D_idx1, 0);
+      EXPECT_EQ(matches[0].point2D_idx2, 1);
+      EXPECT_EQ(matches[1].point2D_idx1, 1);
+      EXPECT_EQ(matches[1].point2D_idx2, 0);
+
       matcher->Match(empty_descriptors, descriptors2, &matches);
       EXPECT_EQ(matches.size(), 0);
       matcher->Match(descriptors1, empty_descriptors, &matches);
@@ -860,5 +1139,58 @@ TEST(MatchGuidedSiftFeaturesGPU, Nominal) {
   RunThreadWithOpenGLContext(&thread);
 }
 
+TEST(LoadSiftFeaturesFromBinaryFile, Nominal) {
+  const std::string path = JoinPaths(CreateTestDir(), "features.bin");
+  const int kNumFeatures = 3;
+  {
+    std::ofstream file(path, std::ios::binary);
+    WriteBinaryLittleEndian<uint32_t>(&file, kNumFeatures);
+    WriteBinaryLittleEndian<uint32_t>(&file, 128);
+    for (int i = 0; i < kNumFeatures; ++i) {
+      WriteBinaryLittleEndian<float>(&file, i + 0.5f);
+      WriteBinaryLittleEndian<float>(&file, i + 1.5f);
+      WriteBinaryLittleEndian<float>(&file, i + 2.0f);
+      WriteBinaryLittleEndian<float>(&file, i * 0.1f);
+    }
+    for (int i = 0; i < kNumFeatures * 128; ++i) {
+      WriteBinaryLittleEndian<uint8_t>(&file, i % 256);
+    }
+  }
+
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  LoadSiftFeaturesFromBinaryFile(path, &keypoints, &descriptors);
+  ASSERT_EQ(keypoints.size(), kNumFeatures);
+  ASSERT_EQ(descriptors.rows(), kNumFeatures);
+  ASSERT_EQ(descriptors.cols(), 128);
+  for (int i = 0; i < kNumFeatures; ++i) {
+    const FeatureKeypoint expected(i + 0.5f, i + 1.5f, i + 2.0f, i * 0.1f);
+    EXPECT_EQ(keypoints[i].x, expected.x);
+    EXPECT_EQ(keypoints[i].y, expected.y);
+    EXPECT_EQ(keypoints[i].a11, expected.a11);
+    EXPECT_EQ(keypoints[i].a12, expected.a12);
+    EXPECT_EQ(keypoints[i].a21, expected.a21);
+    EXPECT_EQ(keypoints[i].a22, expected.a22);
+    for (int j = 0; j < 128; ++j) {
+      EXPECT_EQ(descriptors(i, j), (i * 128 + j) % 256);
+    }
+  }
+}
+
+TEST(LoadSiftFeaturesFromBinaryFile, Truncated) {
+  const std::string path = JoinPaths(CreateTestDir(), "features.bin");
+  {
+    std::ofstream file(path, std::ios::binary);
+    WriteBinaryLittleEndian<uint32_t>(&file, 2);
+    WriteBinaryLittleEndian<uint32_t>(&file, 128);
+    WriteBinaryLittleEndian<float>(&file, 1.0f);
+  }
+
+  FeatureKeypoints keypoints;
+  FeatureDescriptors descriptors;
+  EXPECT_ANY_THROW(
+      LoadSiftFeaturesFromBinaryFile(path, &keypoints, &descriptors));
+}
+
 }  // namespace
 }  // namespace colmap
@@ -31,6 +31,8 @@
 
 #include "colmap/math/math.h"
 
+#include <numeric>
+
 namespace colmap {
 
 std::vector<Eigen::Vector2d> FeatureKeypointsToPointsVector(
@@ -47,24 +49,25 @@ void L2NormalizeFeatureDescriptors(FeatureDescriptorsFloat* descriptors) {
 }
 
 void L1RootNormalizeFeatureDescriptors(FeatureDescriptorsFloat* descriptors) {
+  // Scale and square root are fused into a single pass over each contiguous
+  // row, which Eigen vectorizes.
   for (Eigen::MatrixXf::Index r = 0; r < descriptors->rows(); ++r) {
-    descriptors->row(r) *= 1 / descriptors->row(r).lpNorm<1>();
-    descriptors->row(r) = descriptors->row(r).array().sqrt();
+    const float scale = 1 / descriptors->row(r).lpNorm<1>();
+    descriptors->row(r) = (descriptors->row(r).array() * scale).sqrt();
   }
 }
 
 FeatureDescriptors FeatureDescriptorsToUnsignedByte(
     const Eigen::Ref<const FeatureDescriptorsFloat>& descriptors) {
-  FeatureDescriptors descriptors_unsigned_byte(descriptors.rows(),
-                                               descriptors.cols());
-  for (Eigen::MatrixXf::Index r = 0; r < descriptors.rows(); ++r) {
-    for (Eigen::MatrixXf::Index c = 0; c < descriptors.cols(); ++c) {
-      const float scaled_value = std::round(512.0f * descriptors(r, c));
-      descriptors_unsigned_byte(r, c) =
-          TruncateCast<float, uint8_t>(scaled_value);
-    }
-  }
-  return descriptors_unsigned_byte;
+  // Equivalent to std::round followed by TruncateCast<float, uint8_t> for
+  // each element, but evaluated as one array expression that Eigen can
+  // vectorize.
+  return (512.0f * descriptors.array())
+      .round()
+      .max(0.0f)
+      .min(255.0f)
+      .cast<uint8_t>()
+      .matrix();
 }
 
 void ExtractTopScaleFeatures(FeatureKeypoints* keypoints,
@@ -102,4 +105,114 @@ void ExtractTopScaleFeatures(FeatureKeypoints* keypoints,
   *descriptors = std::move(top_scale_descriptors);
 }
 
+void ExtractSpatiallyUniformFeatures(FeatureKeypoints* keypoints,
+                                     FeatureDescriptors* descriptors,
+                                     const size_t num_features,
+                                     const int width,
+                                     const int height) {
+  THROW_CHECK_EQ(keypoints->size(), descriptors->rows());
+  THROW_CHECK_GT(num_features, 0);
+  THROW_CHECK_GT(width, 0);
+  THROW_CHECK_GT(height, 0);
+
+  if (keypoints->size() <= num_features) {
+    return;
+  }
+
+  // Choose the cell size such that a cell holds a few of the selected
+  // features on average.
+  const double kNumFeaturesPerCell = 4;
+  const double cell_size = std::max(
+      1.0,
+      std::sqrt(static_cast<double>(width) * height * kNumFeaturesPerCell /
+                num_features));
+  const int num_cols = static_cast<int>(std::ceil(width / cell_size));
+  const int num_rows = static_cast<int>(std::ceil(height / cell_size));
+
+  std::vector<std::vector<std::pair<size_t, float>>> cells(num_cols *
+                                                           num_rows);
+  for (size_t i = 0; i < keypoints->size(); ++i) {
+    const FeatureKeypoint& keypoint = (*keypoints)[i];
+    const int col = std::min(
+        num_cols - 1, std::max(0, static_cast<int>(keypoint.x / cell_size)));
+    const int row = std::min(
+        num_rows - 1, std::max(0, static_cast<int>(keypoint.y / cell_size)));
+    cells[row * num_cols + col].emplace_back(i, keypoint.ComputeScale());
+  }
+
+  const auto CompareScale = [](const std::pair<size_t, float>& scale1,
+                               const std::pair<size_t, float>& scale2) {
+    return scale1.second > scale2.second;
+  };
+
+  for (auto& cell : cells) {
+    std::stable_sort(cell.begin(), cell.end(), CompareScale);
+  }
+
+  // Select the largest-scale remaining feature of every cell in turn. If the
+  // last round exceeds the number of features, the largest-scale candidates
+  // of the round are selected.
+  std::vector<size_t> selected_indices;
+  selected_indices.reserve(num_features);
+  std::vector<std::pair<size_t, float>> candidates;
+  for (size_t rank = 0; selected_indices.size() < num_features; ++rank) {
+    candidates.clear();
+    for (const auto& cell : cells) {
+      if (rank < cell.size()) {
+        candidates.push_back(cell[rank]);
+      }
+    }
+    const size_t num_remaining = num_features - selected_indices.size();
+    if (candidates.size() > num_remaining) {
+      std::partial_sort(candidates.begin(),
+                        candidates.begin() + num_remaining,
+                        candidates.end(),
+                        CompareScale);
+      candidates.resize(num_remaining);
+    }
+    for (const auto& candidate : candidates) {
+      selected_indices.push_back(candidate.first);
+    }
+  }
+
+  // Retain the original order of the features.
+  std::sort(selected_indices.begin(), selected_indices.end());
+
+  FeatureKeypoints uniform_keypoints(num_features);
+  FeatureDescriptors uniform_descriptors(num_features, descriptors->cols());
+  for (size_t i = 0; i < num_features; ++i) {
+    uniform_keypoints[i] = (*keypoints)[selected_indices[i]];
+    uniform_descriptors.row(i) = descriptors->row(selected_indices[i]);
+  }
+
+  *keypoints = std::move(uniform_keypoints);
+  *descriptors = std::move(uniform_descriptors);
+}
+
+void SortFeatureMatchesBySimilarity(const FeatureDescriptors& descriptors1,
+                                    const FeatureDescriptors& descriptors2,
+                                    FeatureMatches* matches) {
+  THROW_CHECK_EQ(descriptors1.cols(), descriptors2.cols());
+
+  std::vector<int> similarities(matches->size());
+  for (size_t i = 0; i < matches->size(); ++i) {
+    const FeatureMatch& match = (*matches)[i];
+    similarities[i] =
+        descriptors1.row(match.point2D_idx1).cast<int>().dot(
+            descriptors2.row(match.point2D_idx2).cast<int>());
+  }
+
+  std::vector<size_t> order(matches->size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t i, size_t j) {
+    return similarities[i] > similarities[j];
+  });
+
+  FeatureMatches sorted_matches(matches->size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    sorted_matches[i] = (*matches)[order[i]];
+  }
+  *matches = std::move(sorted_matches);
+}
+
 }  // namespace colmap
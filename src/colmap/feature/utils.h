@@ -57,4 +57,22 @@ void ExtractTopScaleFeatures(FeatureKeypoints* keypoints,
                              FeatureDescriptors* descriptors,
                              size_t num_features);
 
+// Extract the given number of features uniformly distributed over an image of
+// the given dimensions. The image is divided into a grid of cells, from which
+// the largest-scale features are selected in a round-robin fashion, such that
+// densely textured regions do not dominate the selection.
+void ExtractSpatiallyUniformFeatures(FeatureKeypoints* keypoints,
+                                     FeatureDescriptors* descriptors,
+                                     size_t num_features,
+                                     int width,
+                                     int height);
+
+// Sort the matches by decreasing dot product of their descriptors, i.e., by
+// decreasing similarity of the normalized descriptors. Matches with equal
+// similarity retain their order. The sorted matches can be sampled
+// progressively in geometric verification.
+void SortFeatureMatchesBySimilarity(const FeatureDescriptors& descriptors1,
+                                    const FeatureDescriptors& descriptors2,
+                                    FeatureMatches* matches);
+
 }  // namespace colmap
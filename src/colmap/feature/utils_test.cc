@@ -29,6 +29,8 @@
 
 #include "colmap/feature/utils.h"
 
+#include "colmap/math/math.h"
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -76,6 +78,40 @@ TEST(FeatureDescriptorsToUnsignedByte, Nominal) {
   }
 }
 
+TEST(L1RootNormalizeFeatureDescriptors, MatchesTwoPassReference) {
+  FeatureDescriptorsFloat descriptors = Eigen::MatrixXf::Random(100, 128);
+  descriptors.array() += 1.0f;
+  FeatureDescriptorsFloat ref_descriptors = descriptors;
+  for (Eigen::MatrixXf::Index r = 0; r < ref_descriptors.rows(); ++r) {
+    ref_descriptors.row(r) *= 1 / ref_descriptors.row(r).lpNorm<1>();
+    ref_descriptors.row(r) = ref_descriptors.row(r).array().sqrt();
+  }
+  L1RootNormalizeFeatureDescriptors(&descriptors);
+  EXPECT_EQ(descriptors, ref_descriptors);
+}
+
+TEST(FeatureDescriptorsToUnsignedByte, MatchesScalarReference) {
+  FeatureDescriptorsFloat descriptors = Eigen::MatrixXf::Random(100, 128);
+  // Include out of range values and ties, which must round away from zero.
+  descriptors(0, 0) = -1.0f;
+  descriptors(0, 1) = 1.0f;
+  descriptors(0, 2) = 0.5f / 512.0f;
+  descriptors(0, 3) = 1.5f / 512.0f;
+  descriptors(0, 4) = 254.5f / 512.0f;
+  descriptors(0, 5) = 255.5f / 512.0f;
+  descriptors(0, 6) = -0.5f / 512.0f;
+  descriptors(0, 7) = 0.0f;
+  const FeatureDescriptors descriptors_uint8 =
+      FeatureDescriptorsToUnsignedByte(descriptors);
+  for (Eigen::MatrixXf::Index r = 0; r < descriptors.rows(); ++r) {
+    for (Eigen::MatrixXf::Index c = 0; c < descriptors.cols(); ++c) {
+      const uint8_t ref_value = TruncateCast<float, uint8_t>(
+          std::round(512.0f * descriptors(r, c)));
+      EXPECT_EQ(ref_value, descriptors_uint8(r, c));
+    }
+  }
+}
+
 TEST(ExtractTopScaleFeatures, Nominal) {
   FeatureKeypoints keypoints(5);
   keypoints[0].Rescale(3);
@@ -110,5 +146,87 @@ TEST(ExtractTopScaleFeatures, Nominal) {
   EXPECT_EQ(top_descriptors6, descriptors);
 }
 
+TEST(ExtractSpatiallyUniformFeatures, Nominal) {
+  // A dense cluster of large-scale features in the top-left corner and a few
+  // small-scale features spread over the rest of the image.
+  FeatureKeypoints keypoints;
+  for (int i = 0; i < 90; ++i) {
+    keypoints.emplace_back(i % 10, i / 10, 10, 0);
+  }
+  for (int row = 0; row < 3; ++row) {
+    for (int col = 0; col < 3; ++col) {
+      if (row > 0 || col > 0) {
+        keypoints.emplace_back(20 + 35 * col, 20 + 35 * row, 1, 0);
+      }
+    }
+  }
+
+  FeatureDescriptors descriptors(keypoints.size(), 1);
+  for (size_t i = 0; i < keypoints.size(); ++i) {
+    descriptors(i, 0) = i;
+  }
+
+  ExtractSpatiallyUniformFeatures(&keypoints,
+                                  &descriptors,
+                                  /*num_features=*/20,
+                                  /*width=*/100,
+                                  /*height=*/100);
+
+  EXPECT_EQ(keypoints.size(), 20);
+  EXPECT_EQ(descriptors.rows(), 20);
+  int num_spread_features = 0;
+  for (size_t i = 0; i < keypoints.size(); ++i) {
+    if (keypoints[i].ComputeScale() == 1) {
+      EXPECT_GE(descriptors(i, 0), 90);
+      num_spread_features += 1;
+    } else {
+      EXPECT_LT(descriptors(i, 0), 90);
+    }
+    if (i > 0) {
+      EXPECT_GT(descriptors(i, 0), descriptors(i - 1, 0));
+    }
+  }
+  EXPECT_EQ(num_spread_features, 8);
+}
+
+TEST(ExtractSpatiallyUniformFeatures, FewerFeatures) {
+  FeatureKeypoints keypoints(5);
+  FeatureDescriptors descriptors = FeatureDescriptors::Random(5, 128);
+  const FeatureDescriptors orig_descriptors = descriptors;
+  ExtractSpatiallyUniformFeatures(&keypoints,
+                                  &descriptors,
+                                  /*num_features=*/10,
+                                  /*width=*/100,
+                                  /*height=*/100);
+  EXPECT_EQ(keypoints.size(), 5);
+  EXPECT_EQ(descriptors, orig_descriptors);
+}
+
+TEST(SortFeatureMatchesBySimilarity, Nominal) {
+  FeatureDescriptors descriptors1(3, 2);
+  descriptors1 << 1, 0, 2, 0, 3, 0;
+  FeatureDescriptors descriptors2(2, 2);
+  descriptors2 << 1, 1, 2, 0;
+
+  FeatureMatches matches = {{0, 0}, {1, 1}, {2, 0}, {0, 1}, {1, 0}};
+  SortFeatureMatchesBySimilarity(descriptors1, descriptors2, &matches);
+  // The similarities are 1, 4, 3, 2, 2 in the original order.
+  ASSERT_EQ(matches.size(), 5);
+  EXPECT_EQ(matches[0].point2D_idx1, 1);
+  EXPECT_EQ(matches[0].point2D_idx2, 1);
+  EXPECT_EQ(matches[1].point2D_idx1, 2);
+  EXPECT_EQ(matches[1].point2D_idx2, 0);
+  EXPECT_EQ(matches[2].point2D_idx1, 0);
+  EXPECT_EQ(matches[2].point2D_idx2, 1);
+  EXPECT_EQ(matches[3].point2D_idx1, 1);
+  EXPECT_EQ(matches[3].point2D_idx2, 0);
+  EXPECT_EQ(matches[4].point2D_idx1, 0);
+  EXPECT_EQ(matches[4].point2D_idx2, 0);
+
+  FeatureMatches no_matches;
+  SortFeatureMatchesBySimilarity(descriptors1, descriptors2, &no_matches);
+  EXPECT_TRUE(no_matches.empty());
+}
+
 }  // namespace
 }  // namespace colmap
@@ -32,6 +32,24 @@
 #include "colmap/math/math.h"
 
 namespace colmap {
+namespace {
+
+static_assert(sizeof(Eigen::Vector3d) == 3 * sizeof(double),
+              "Points must be stored contiguously");
+
+// View the points as the columns of a 3xN matrix.
+Eigen::Map<const Eigen::Matrix3Xd> AsMatrix(
+    const std::vector<Eigen::Vector3d>& points) {
+  return Eigen::Map<const Eigen::Matrix3Xd>(
+      points.empty() ? nullptr : points[0].data(), 3, points.size());
+}
+
+Eigen::Map<Eigen::Matrix3Xd> AsMatrix(std::vector<Eigen::Vector3d>* points) {
+  return Eigen::Map<Eigen::Matrix3Xd>(
+      points->empty() ? nullptr : (*points)[0].data(), 3, points->size());
+}
+
+}  // namespace
 
 GPSTransform::GPSTransform(const int ellipsoid) {
   switch (ellipsoid) {
@@ -58,23 +76,23 @@ std::vector<Eigen::Vector3d> GPSTransform::EllToXYZ(
     const std::vector<Eigen::Vector3d>& ell) const {
   std::vector<Eigen::Vector3d> xyz(ell.size());
 
-  for (size_t i = 0; i < ell.size(); ++i) {
-    const double lat = DegToRad(ell[i](0));
-    const double lon = DegToRad(ell[i](1));
-    const double alt = ell[i](2);
+  // Convert all points at once using array operations, which Eigen can
+  // vectorize, instead of converting one point at a time.
+  const auto ell_mat = AsMatrix(ell);
+  const Eigen::ArrayXd lat = ell_mat.row(0).transpose().array() * DegToRad(1.0);
+  const Eigen::ArrayXd lon = ell_mat.row(1).transpose().array() * DegToRad(1.0);
+  const Eigen::ArrayXd alt = ell_mat.row(2).transpose().array();
 
-    const double sin_lat = std::sin(lat);
-    const double sin_lon = std::sin(lon);
-    const double cos_lat = std::cos(lat);
-    const double cos_lon = std::cos(lon);
+  const Eigen::ArrayXd sin_lat = lat.sin();
+  const Eigen::ArrayXd cos_lat = lat.cos();
 
-    // Normalized radius
-    const double N = a_ / std::sqrt(1 - e2_ * sin_lat * sin_lat);
+  // Normalized radius
+  const Eigen::ArrayXd N = a_ / (1 - e2_ * sin_lat.square()).sqrt();
 
-    xyz[i](0) = (N + alt) * cos_lat * cos_lon;
-    xyz[i](1) = (N + alt) * cos_lat * sin_lon;
-    xyz[i](2) = (N * (1 - e2_) + alt) * sin_lat;
-  }
+  auto xyz_mat = AsMatrix(&xyz);
+  xyz_mat.row(0) = ((N + alt) * cos_lat * lon.cos()).matrix().transpose();
+  xyz_mat.row(1) = ((N + alt) * cos_lat * lon.sin()).matrix().transpose();
+  xyz_mat.row(2) = ((N * (1 - e2_) + alt) * sin_lat).matrix().transpose();
 
   return xyz;
 }
@@ -149,8 +167,8 @@ std::vector<Eigen::Vector3d> GPSTransform::XYZToENU(
       cos_lat0, cos_lat0 * cos_lon0, cos_lat0 * sin_lon0, sin_lat0;
 
   // Convert ECEF to ENU coords. (w.r.t. ECEF ref == xyz[0])
-  for (size_t i = 0; i < xyz.size(); ++i) {
-    enu[i] = R * (xyz[i] - xyz[0]);
+  if (!xyz.empty()) {
+    AsMatrix(&enu) = R * (AsMatrix(xyz).colwise() - xyz[0]);
   }
 
   return enu;
@@ -190,9 +208,7 @@ std::vector<Eigen::Vector3d> GPSTransform::ENUToXYZ(
   R.transposeInPlace();
 
   // Convert ENU to ECEF coords.
-  for (size_t i = 0; i < enu.size(); ++i) {
-    xyz[i] = (R * enu[i]) + xyz_ref;
-  }
+  AsMatrix(&xyz) = (R * AsMatrix(enu)).colwise() + xyz_ref;
 
   return xyz;
 }
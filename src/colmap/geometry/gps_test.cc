@@ -290,5 +290,13 @@ TEST(GPS, ENUToXYZ) {
   }
 }
 
+TEST(GPS, Empty) {
+  GPSTransform gps_tform(GPSTransform::WGS84);
+  EXPECT_TRUE(gps_tform.EllToXYZ({}).empty());
+  EXPECT_TRUE(gps_tform.XYZToEll({}).empty());
+  EXPECT_TRUE(gps_tform.EllToENU({}, 48, 11).empty());
+  EXPECT_TRUE(gps_tform.ENUToEll({}, 48, 11, 500).empty());
+}
+
 }  // namespace
 }  // namespace colmap
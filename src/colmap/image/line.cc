@@ -37,6 +37,7 @@ extern "C" {
 }
 #endif
 
+#include <algorithm>
 #include <memory>
 
 namespace colmap {
@@ -53,16 +54,22 @@ std::vector<LineSegment> DetectLineSegments(const Bitmap& bitmap,
                                             const double min_length) {
   const double min_length_squared = min_length * min_length;
 
-  std::vector<uint8_t> bitmap_data;
-  if (bitmap.IsGrey()) {
-    bitmap_data = bitmap.ConvertToRowMajorArray();
-  } else {
-    const Bitmap bitmap_gray = bitmap.CloneAsGrey();
-    bitmap_data = bitmap_gray.ConvertToRowMajorArray();
+  // Only convert color images to grey, while the scanlines of grey images are
+  // directly converted to the input of LSD.
+  Bitmap bitmap_gray;
+  if (!bitmap.IsGrey()) {
+    bitmap_gray = bitmap.CloneAsGrey();
+  }
+  const BitmapView view =
+      bitmap.IsGrey() ? bitmap.View() : bitmap_gray.View();
+
+  std::vector<double> bitmap_data_double(static_cast<size_t>(view.width) *
+                                         view.height);
+  double* bitmap_data = bitmap_data_double.data();
+  for (int y = 0; y < view.height; ++y) {
+    const uint8_t* row = view.Row(y);
+    bitmap_data = std::copy(row, row + view.width, bitmap_data);
   }
-
-  std::vector<double> bitmap_data_double(bitmap_data.begin(),
-                                         bitmap_data.end());
 
   int num_segments;
   std::unique_ptr<double, RawDeleter> segments_data(
@@ -152,8 +152,66 @@ void WriteCOLMAPCommands(const bool geometric,
         << std::endl;
 }
 
+// Count the number of images of each camera, which are undistorted with the
+// same warp map.
+std::unordered_map<camera_t, size_t> CountImagesPerCamera(
+    const Reconstruction& reconstruction,
+    const std::vector<image_t>& image_ids) {
+  std::unordered_map<camera_t, size_t> num_images_per_camera;
+  for (const image_t image_id : image_ids) {
+    num_images_per_camera[reconstruction.Image(image_id).CameraId()] += 1;
+  }
+  return num_images_per_camera;
+}
+
 }  // namespace
 
+UndistortionMapCache::UndistortionMapCache(
+    const UndistortCameraOptions& options,
+    const std::unordered_map<camera_t, size_t>& num_uses_per_camera)
+    : options_(options) {
+#if !defined(COLMAP_CUDA_ENABLED)
+  if (options_.use_gpu) {
+    LOG(FATAL_THROW) << "Image undistortion on the GPU requires CUDA support";
+  }
+#endif
+  entries_.reserve(num_uses_per_camera.size());
+  for (const auto& num_uses : num_uses_per_camera) {
+    auto& cached_entry = entries_[num_uses.first];
+    cached_entry = std::make_unique<CachedEntry>();
+    cached_entry->num_remaining_uses = num_uses.second;
+  }
+}
+
+std::shared_ptr<const UndistortionMapCache::Entry> UndistortionMapCache::Get(
+    const camera_t camera_id, const Camera& camera) {
+  CachedEntry& cached_entry = *entries_.at(camera_id);
+  std::lock_guard<std::mutex> lock(cached_entry.mutex);
+  if (!cached_entry.entry) {
+    auto entry = std::make_shared<Entry>();
+    entry->undistorted_camera = UndistortCamera(options_, camera);
+    entry->warp_map =
+        ComputeCameraWarpMap(camera, entry->undistorted_camera);
+#if defined(COLMAP_CUDA_ENABLED)
+    if (options_.use_gpu) {
+      entry->cuda_warper = std::make_unique<CudaCameraWarper>(
+          options_.gpu_index, entry->warp_map);
+      entry->warp_map.source_points.clear();
+      entry->warp_map.source_points.shrink_to_fit();
+    }
+#endif
+    cached_entry.entry = std::move(entry);
+  }
+  std::shared_ptr<const Entry> entry = cached_entry.entry;
+  if (cached_entry.num_remaining_uses > 0) {
+    cached_entry.num_remaining_uses -= 1;
+  }
+  if (cached_entry.num_remaining_uses == 0) {
+    cached_entry.entry.reset();
+  }
+  return entry;
+}
+
 COLMAPUndistorter::COLMAPUndistorter(const UndistortCameraOptions& options,
                                      const Reconstruction& reconstruction,
                                      const std::string& image_path,
@@ -187,6 +245,12 @@ void COLMAPUndistorter::Run() {
   reconstruction_.CreateImageDirs(
       JoinPaths(output_path_, "stereo/consistency_graphs"));
 
+  map_cache_ = std::make_unique<UndistortionMapCache>(
+      options_,
+      CountImagesPerCamera(reconstruction_,
+                           image_ids_.empty() ? reconstruction_.RegImageIds()
+                                              : image_ids_));
+
   ThreadPool thread_pool;
   std::vector<std::future<bool>> futures;
   futures.reserve(reconstruction_.NumRegImages());
@@ -246,7 +310,6 @@ bool COLMAPUndistorter::Undistort(const image_t image_id) const {
   Bitmap distorted_bitmap;
   Bitmap undistorted_bitmap;
   const Camera& camera = reconstruction_.Camera(image.CameraId());
-  Camera undistorted_camera;
 
   const std::string input_image_path = JoinPaths(image_path_, image.Name());
   const std::string output_image_path =
@@ -267,11 +330,8 @@ bool COLMAPUndistorter::Undistort(const image_t image_id) const {
     return false;
   }
 
-  UndistortImage(options_,
-                 distorted_bitmap,
-                 camera,
-                 &undistorted_bitmap,
-                 &undistorted_camera);
+  const auto map_entry = map_cache_->Get(image.CameraId(), camera);
+  UndistortImage(*map_entry, distorted_bitmap, &undistorted_bitmap);
   return undistorted_bitmap.Write(output_image_path);
 }
 
@@ -325,6 +385,10 @@ void PMVSUndistorter::Run() {
   CreateDirIfNotExists(JoinPaths(output_path_, "pmvs/visualize"));
   CreateDirIfNotExists(JoinPaths(output_path_, "pmvs/models"));
 
+  map_cache_ = std::make_unique<UndistortionMapCache>(
+      options_,
+      CountImagesPerCamera(reconstruction_, reconstruction_.RegImageIds()));
+
   ThreadPool thread_pool;
   std::vector<std::future<bool>> futures;
   futures.reserve(reconstruction_.NumRegImages());
@@ -390,14 +454,11 @@ bool PMVSUndistorter::Undistort(const size_t reg_image_idx) const {
   }
 
   Bitmap undistorted_bitmap;
-  Camera undistorted_camera;
-  UndistortImage(options_,
-                 distorted_bitmap,
-                 camera,
-                 &undistorted_bitmap,
-                 &undistorted_camera);
+  const auto map_entry = map_cache_->Get(image.CameraId(), camera);
+  UndistortImage(*map_entry, distorted_bitmap, &undistorted_bitmap);
 
-  WriteProjectionMatrix(proj_matrix_path, undistorted_camera, image, "CONTOUR");
+  WriteProjectionMatrix(
+      proj_matrix_path, map_entry->undistorted_camera, image, "CONTOUR");
   return undistorted_bitmap.Write(output_image_path);
 }
 
@@ -559,6 +620,10 @@ void CMPMVSUndistorter::Run() {
   run_timer.Start();
   PrintHeading1("Image undistortion (CMP-MVS)");
 
+  map_cache_ = std::make_unique<UndistortionMapCache>(
+      options_,
+      CountImagesPerCamera(reconstruction_, reconstruction_.RegImageIds()));
+
   ThreadPool thread_pool;
   std::vector<std::future<bool>> futures;
   futures.reserve(reconstruction_.NumRegImages());
@@ -599,14 +664,11 @@ bool CMPMVSUndistorter::Undistort(const size_t reg_image_idx) const {
   }
 
   Bitmap undistorted_bitmap;
-  Camera undistorted_camera;
-  UndistortImage(options_,
-                 distorted_bitmap,
-                 camera,
-                 &undistorted_bitmap,
-                 &undistorted_camera);
+  const auto map_entry = map_cache_->Get(image.CameraId(), camera);
+  UndistortImage(*map_entry, distorted_bitmap, &undistorted_bitmap);
 
-  WriteProjectionMatrix(proj_matrix_path, undistorted_camera, image, "CONTOUR");
+  WriteProjectionMatrix(
+      proj_matrix_path, map_entry->undistorted_camera, image, "CONTOUR");
   return undistorted_bitmap.Write(output_image_path);
 }
 
@@ -973,6 +1035,21 @@ void UndistortImage(const UndistortCameraOptions& options,
   distorted_bitmap.CloneMetadata(undistorted_bitmap);
 }
 
+void UndistortImage(const UndistortionMapCache::Entry& map_entry,
+                    const Bitmap& distorted_bitmap,
+                    Bitmap* undistorted_bitmap) {
+#if defined(COLMAP_CUDA_ENABLED)
+  if (map_entry.cuda_warper) {
+    map_entry.cuda_warper->Warp(distorted_bitmap, undistorted_bitmap);
+    distorted_bitmap.CloneMetadata(undistorted_bitmap);
+    return;
+  }
+#endif
+  WarpImageWithCameraWarpMap(
+      map_entry.warp_map, distorted_bitmap, undistorted_bitmap);
+  distorted_bitmap.CloneMetadata(undistorted_bitmap);
+}
+
 void UndistortReconstruction(const UndistortCameraOptions& options,
                              Reconstruction* reconstruction) {
   const auto distorted_cameras = reconstruction->Cameras();
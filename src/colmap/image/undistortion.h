@@ -30,11 +30,19 @@
 #pragma once
 
 #include "colmap/geometry/rigid3.h"
+#include "colmap/image/warp.h"
+#if defined(COLMAP_CUDA_ENABLED)
+#include "colmap/image/warp_cuda.h"
+#endif
 #include "colmap/scene/reconstruction.h"
 #include "colmap/sensor/bitmap.h"
 #include "colmap/util/base_controller.h"
 #include "colmap/util/misc.h"
 
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 namespace colmap {
 
 struct UndistortCameraOptions {
@@ -57,6 +65,48 @@ struct UndistortCameraOptions {
   double roi_min_y = 0.0;
   double roi_max_x = 1.0;
   double roi_max_y = 1.0;
+
+  // Whether to warp the images on the GPU, while reading and writing the
+  // images remains on the CPU threads. Requires CUDA.
+  bool use_gpu = false;
+
+  // The index of the GPU used for warping, where -1 selects the best GPU.
+  int gpu_index = -1;
+};
+
+// Thread-safe cache of the undistorted cameras and warp maps of cameras
+// shared by multiple images. The warp map of a camera is computed on first
+// use and released after its expected number of uses, so that the memory
+// stays bounded for reconstructions with many cameras.
+class UndistortionMapCache {
+ public:
+  struct Entry {
+    Camera undistorted_camera;
+    // The warp map on the CPU, which is empty if the images are warped on the
+    // GPU to avoid keeping the map in host and device memory.
+    CameraWarpMap warp_map;
+#if defined(COLMAP_CUDA_ENABLED)
+    std::unique_ptr<CudaCameraWarper> cuda_warper;
+#endif
+  };
+
+  UndistortionMapCache(
+      const UndistortCameraOptions& options,
+      const std::unordered_map<camera_t, size_t>& num_uses_per_camera);
+
+  std::shared_ptr<const Entry> Get(camera_t camera_id, const Camera& camera);
+
+ private:
+  struct CachedEntry {
+    std::mutex mutex;
+    std::shared_ptr<const Entry> entry;
+    size_t num_remaining_uses = 0;
+  };
+
+  const UndistortCameraOptions options_;
+  // The cached entries are created upfront, such that the map itself is never
+  // modified concurrently.
+  std::unordered_map<camera_t, std::unique_ptr<CachedEntry>> entries_;
 };
 
 // Undistort images and export undistorted cameras, as required by the
@@ -88,6 +138,7 @@ class COLMAPUndistorter : public BaseController {
   const Reconstruction& reconstruction_;
   const std::vector<image_t> image_ids_;
   std::vector<std::string> image_names_;
+  std::unique_ptr<UndistortionMapCache> map_cache_;
 };
 
 // Undistort images and prepare data for CMVS/PMVS.
@@ -113,6 +164,7 @@ class PMVSUndistorter : public BaseController {
   std::string image_path_;
   std::string output_path_;
   const Reconstruction& reconstruction_;
+  std::unique_ptr<UndistortionMapCache> map_cache_;
 };
 
 // Undistort images and prepare data for CMP-MVS.
@@ -132,6 +184,7 @@ class CMPMVSUndistorter : public BaseController {
   std::string image_path_;
   std::string output_path_;
   const Reconstruction& reconstruction_;
+  std::unique_ptr<UndistortionMapCache> map_cache_;
 };
 
 // Undistort images and export undistorted cameras without the need for a
@@ -207,6 +260,12 @@ void UndistortImage(const UndistortCameraOptions& options,
                     Bitmap* undistorted_image,
                     Camera* undistorted_camera);
 
+// Undistort image with the precomputed warp map of its camera, as obtained
+// from an UndistortionMapCache, either on the CPU or the GPU.
+void UndistortImage(const UndistortionMapCache::Entry& map_entry,
+                    const Bitmap& distorted_image,
+                    Bitmap* undistorted_image);
+
 // Undistort all cameras in the reconstruction and accordingly all
 // observations in their corresponding images.
 void UndistortReconstruction(const UndistortCameraOptions& options,
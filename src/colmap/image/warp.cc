@@ -34,21 +34,85 @@
 
 #include "thirdparty/VLFeat/imopv.h"
 
+#include <cmath>
+
 #include <Eigen/Geometry>
 
 namespace colmap {
 namespace {
 
-float GetPixelConstantBorder(const float* data,
-                             const int rows,
-                             const int cols,
-                             const int row,
-                             const int col) {
-  if (row >= 0 && col >= 0 && row < rows && col < cols) {
-    return data[row * cols + col];
-  } else {
-    return 0;
+// Bilinearly interpolate all channels of the source image at the given
+// position, where the upper left pixel center has coordinates (0, 0). The
+// pixel is set to zero, if any of the four neighbors lies outside the image,
+// which is the same border handling and rounding as with
+// Bitmap::InterpolateBilinear but without the per-pixel scanline lookups.
+inline void InterpolatePixelBilinear(const BitmapView& source,
+                                     const double x,
+                                     const double y,
+                                     uint8_t* pixel) {
+  // The rows are addressed in the bottom-up order of FreeImage, such that the
+  // weights are identical to Bitmap::InterpolateBilinear.
+  const double inv_y = source.height - 1 - y;
+
+  const int x0 = static_cast<int>(std::floor(x));
+  const int x1 = x0 + 1;
+  const int y0 = static_cast<int>(std::floor(inv_y));
+  const int y1 = y0 + 1;
+
+  if (x0 < 0 || x1 >= source.width || y0 < 0 || y1 >= source.height) {
+    for (int c = 0; c < source.channels; ++c) {
+      pixel[c] = 0;
+    }
+    return;
+  }
+
+  const double dx = x - x0;
+  const double dy = inv_y - y0;
+  const double dx_1 = 1 - dx;
+  const double dy_1 = 1 - dy;
+
+  const uint8_t* line0 = source.Row(source.height - 1 - y0);
+  const uint8_t* line1 = source.Row(source.height - 1 - y1);
+  const uint8_t* p00 = line0 + source.channels * x0;
+  const uint8_t* p01 = line0 + source.channels * x1;
+  const uint8_t* p10 = line1 + source.channels * x0;
+  const uint8_t* p11 = line1 + source.channels * x1;
+
+  for (int c = 0; c < source.channels; ++c) {
+    const double v0 = dx_1 * p00[c] + dx * p01[c];
+    const double v1 = dx_1 * p10[c] + dx * p11[c];
+    const float value = dy_1 * v0 + dy * v1;
+    pixel[c] = static_cast<uint8_t>(std::round(value));
+  }
+}
+
+// Index and weight of the two neighbors in one dimension for bilinear
+// resampling with constant zero border. Neighbors outside the image get a zero
+// weight and a clamped index, such that the interpolation needs no branches.
+struct ResampleCoeffs {
+  int idx_min = 0;
+  int idx_max = 0;
+  float weight_min = 0;
+  float weight_max = 0;
+};
+
+ResampleCoeffs ComputeResampleCoeffs(const int i,
+                                     const float scale,
+                                     const int size) {
+  const float i_src = (i + 0.5f) * scale - 0.5f;
+  const int i_min = std::floor(i_src);
+  const int i_max = i_min + 1;
+
+  ResampleCoeffs coeffs;
+  if (i_min >= 0 && i_min < size) {
+    coeffs.idx_min = i_min;
+    coeffs.weight_min = i_max - i_src;
+  }
+  if (i_max >= 0 && i_max < size) {
+    coeffs.idx_max = i_max;
+    coeffs.weight_max = i_src - i_min;
   }
+  return coeffs;
 }
 
 }  // namespace
@@ -61,9 +125,18 @@ void WarpImageBetweenCameras(const Camera& source_camera,
   THROW_CHECK_EQ(source_camera.height, source_image.Height());
   THROW_CHECK_NOTNULL(target_image);
 
-  target_image->Allocate(static_cast<int>(source_camera.width),
-                         static_cast<int>(source_camera.height),
-                         source_image.IsRGB());
+  WarpImageWithCameraWarpMap(ComputeCameraWarpMap(source_camera, target_camera),
+                             source_image,
+                             target_image);
+}
+
+CameraWarpMap ComputeCameraWarpMap(const Camera& source_camera,
+                                   const Camera& target_camera) {
+  CameraWarpMap warp_map;
+  warp_map.width = static_cast<int>(source_camera.width);
+  warp_map.height = static_cast<int>(source_camera.height);
+  warp_map.target_width = static_cast<int>(target_camera.width);
+  warp_map.target_height = static_cast<int>(target_camera.height);
 
   // To avoid aliasing, perform the warping in the source resolution and
   // then rescale the image at the end.
@@ -73,10 +146,13 @@ void WarpImageBetweenCameras(const Camera& source_camera,
     scaled_target_camera.Rescale(source_camera.width, source_camera.height);
   }
 
+  warp_map.source_points.resize(static_cast<size_t>(warp_map.width) *
+                                warp_map.height);
+
   Eigen::Vector2d image_point;
-  for (int y = 0; y < target_image->Height(); ++y) {
+  for (int y = 0; y < warp_map.height; ++y) {
     image_point.y() = y + 0.5;
-    for (int x = 0; x < target_image->Width(); ++x) {
+    for (int x = 0; x < warp_map.width; ++x) {
       image_point.x() = x + 0.5;
 
       // Camera models assume that the upper left pixel center is (0.5, 0.5).
@@ -84,19 +160,40 @@ void WarpImageBetweenCameras(const Camera& source_camera,
           scaled_target_camera.CamFromImg(image_point);
       const Eigen::Vector2d source_point = source_camera.ImgFromCam(cam_point);
 
-      BitmapColor<float> color;
-      if (source_image.InterpolateBilinear(
-              source_point.x() - 0.5, source_point.y() - 0.5, &color)) {
-        target_image->SetPixel(x, y, color.Cast<uint8_t>());
-      } else {
-        target_image->SetPixel(x, y, BitmapColor<uint8_t>(0));
-      }
+      warp_map.source_points[static_cast<size_t>(y) * warp_map.width + x] =
+          (source_point.array() - 0.5).matrix().cast<float>();
     }
   }
 
-  if (target_camera.width != source_camera.width ||
-      target_camera.height != source_camera.height) {
-    target_image->Rescale(target_camera.width, target_camera.height);
+  return warp_map;
+}
+
+void WarpImageWithCameraWarpMap(const CameraWarpMap& warp_map,
+                                const Bitmap& source_image,
+                                Bitmap* target_image) {
+  THROW_CHECK_EQ(warp_map.width, source_image.Width());
+  THROW_CHECK_EQ(warp_map.height, source_image.Height());
+  THROW_CHECK_NOTNULL(target_image);
+
+  target_image->Allocate(
+      warp_map.width, warp_map.height, source_image.IsRGB());
+
+  const BitmapView source_view = source_image.View();
+  const int channels = source_view.channels;
+  const Eigen::Vector2f* source_point = warp_map.source_points.data();
+  for (int y = 0; y < warp_map.height; ++y) {
+    uint8_t* target_line = target_image->GetScanline(y);
+    for (int x = 0; x < warp_map.width; ++x, ++source_point) {
+      InterpolatePixelBilinear(source_view,
+                               source_point->x(),
+                               source_point->y(),
+                               target_line + channels * x);
+    }
+  }
+
+  if (warp_map.target_width != warp_map.width ||
+      warp_map.target_height != warp_map.height) {
+    target_image->Rescale(warp_map.target_width, warp_map.target_height);
   }
 }
 
@@ -108,21 +205,21 @@ void WarpImageWithHomography(const Eigen::Matrix3d& H,
   THROW_CHECK_GT(target_image->Height(), 0);
   THROW_CHECK_EQ(source_image.IsRGB(), target_image->IsRGB());
 
+  const BitmapView source_view = source_image.View();
+  const int channels = source_view.channels;
   Eigen::Vector3d target_pixel(0, 0, 1);
   for (int y = 0; y < target_image->Height(); ++y) {
     target_pixel.y() = y + 0.5;
+    uint8_t* target_line = target_image->GetScanline(y);
     for (int x = 0; x < target_image->Width(); ++x) {
       target_pixel.x() = x + 0.5;
 
       const Eigen::Vector2d source_pixel = (H * target_pixel).hnormalized();
 
-      BitmapColor<float> color;
-      if (source_image.InterpolateBilinear(
-              source_pixel.x() - 0.5, source_pixel.y() - 0.5, &color)) {
-        target_image->SetPixel(x, y, color.Cast<uint8_t>());
-      } else {
-        target_image->SetPixel(x, y, BitmapColor<uint8_t>(0));
-      }
+      InterpolatePixelBilinear(source_view,
+                               source_pixel.x() - 0.5,
+                               source_pixel.y() - 0.5,
+                               target_line + channels * x);
     }
   }
 }
@@ -148,9 +245,12 @@ void WarpImageWithHomographyBetweenCameras(const Eigen::Matrix3d& H,
     scaled_target_camera.Rescale(source_camera.width, source_camera.height);
   }
 
+  const BitmapView source_view = source_image.View();
+  const int channels = source_view.channels;
   Eigen::Vector3d image_point(0, 0, 1);
   for (int y = 0; y < target_image->Height(); ++y) {
     image_point.y() = y + 0.5;
+    uint8_t* target_line = target_image->GetScanline(y);
     for (int x = 0; x < target_image->Width(); ++x) {
       image_point.x() = x + 0.5;
 
@@ -160,13 +260,10 @@ void WarpImageWithHomographyBetweenCameras(const Eigen::Matrix3d& H,
           target_camera.CamFromImg(warped_point.hnormalized());
       const Eigen::Vector2d source_point = source_camera.ImgFromCam(cam_point);
 
-      BitmapColor<float> color;
-      if (source_image.InterpolateBilinear(
-              source_point.x() - 0.5, source_point.y() - 0.5, &color)) {
-        target_image->SetPixel(x, y, color.Cast<uint8_t>());
-      } else {
-        target_image->SetPixel(x, y, BitmapColor<uint8_t>(0));
-      }
+      InterpolatePixelBilinear(source_view,
+                               source_point.x() - 0.5,
+                               source_point.y() - 0.5,
+                               target_line + channels * x);
     }
   }
 
@@ -192,30 +289,30 @@ void ResampleImageBilinear(const float* data,
   const float scale_r = static_cast<float>(rows) / static_cast<float>(new_rows);
   const float scale_c = static_cast<float>(cols) / static_cast<float>(new_cols);
 
-  for (int r = 0; r < new_rows; ++r) {
-    const float r_i = (r + 0.5f) * scale_r - 0.5f;
-    const int r_i_min = std::floor(r_i);
-    const int r_i_max = r_i_min + 1;
-    const float d_r_min = r_i - r_i_min;
-    const float d_r_max = r_i_max - r_i;
+  // The column coefficients are the same for all rows, so that the inner
+  // loop only gathers and blends the precomputed neighbors.
+  std::vector<ResampleCoeffs> col_coeffs(new_cols);
+  for (int c = 0; c < new_cols; ++c) {
+    col_coeffs[c] = ComputeResampleCoeffs(c, scale_c, cols);
+  }
 
+  for (int r = 0; r < new_rows; ++r) {
+    const ResampleCoeffs row_coeffs = ComputeResampleCoeffs(r, scale_r, rows);
+    const float* row_min = data + row_coeffs.idx_min * cols;
+    const float* row_max = data + row_coeffs.idx_max * cols;
+    float* resampled_row = resampled + r * new_cols;
     for (int c = 0; c < new_cols; ++c) {
-      const float c_i = (c + 0.5f) * scale_c - 0.5f;
-      const int c_i_min = std::floor(c_i);
-      const int c_i_max = c_i_min + 1;
-      const float d_c_min = c_i - c_i_min;
-      const float d_c_max = c_i_max - c_i;
+      const ResampleCoeffs& coeffs = col_coeffs[c];
 
       // Interpolation in column direction.
-      const float value1 =
-          d_c_max * GetPixelConstantBorder(data, rows, cols, r_i_min, c_i_min) +
-          d_c_min * GetPixelConstantBorder(data, rows, cols, r_i_min, c_i_max);
-      const float value2 =
-          d_c_max * GetPixelConstantBorder(data, rows, cols, r_i_max, c_i_min) +
-          d_c_min * GetPixelConstantBorder(data, rows, cols, r_i_max, c_i_max);
+      const float value1 = coeffs.weight_min * row_min[coeffs.idx_min] +
+                           coeffs.weight_max * row_min[coeffs.idx_max];
+      const float value2 = coeffs.weight_min * row_max[coeffs.idx_min] +
+                           coeffs.weight_max * row_max[coeffs.idx_max];
 
       // Interpolation in row direction.
-      resampled[r * new_cols + c] = d_r_max * value1 + d_r_min * value2;
+      resampled_row[c] =
+          row_coeffs.weight_min * value1 + row_coeffs.weight_max * value2;
     }
   }
 }
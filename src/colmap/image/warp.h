@@ -32,6 +32,10 @@
 #include "colmap/scene/camera.h"
 #include "colmap/sensor/bitmap.h"
 
+#include <vector>
+
+#include <Eigen/Core>
+
 namespace colmap {
 
 // Warp source image to target image by projecting the pixels of the target
@@ -42,6 +46,37 @@ void WarpImageBetweenCameras(const Camera& source_camera,
                              const Bitmap& source_image,
                              Bitmap* target_image);
 
+// Precomputed inverse mapping from the pixels of the target image to the
+// pixels of the source image for warping images between two cameras. The
+// mapping only depends on the cameras and is more expensive to compute than
+// the interpolation of the pixels, so it should be reused for all images that
+// share the same cameras.
+struct CameraWarpMap {
+  // The dimensions of the warped image, which are the dimensions of the source
+  // camera to avoid aliasing.
+  int width = 0;
+  int height = 0;
+
+  // The dimensions of the target camera, to which the warped image is rescaled.
+  int target_width = 0;
+  int target_height = 0;
+
+  // The source pixel coordinates of each warped pixel in row-major order,
+  // where the upper left pixel center has coordinates (0, 0).
+  std::vector<Eigen::Vector2f> source_points;
+};
+
+// Compute the warp map from the source to the target camera, as used by
+// WarpImageBetweenCameras.
+CameraWarpMap ComputeCameraWarpMap(const Camera& source_camera,
+                                   const Camera& target_camera);
+
+// Warp the source image with a precomputed warp map. The function allocates
+// the target image.
+void WarpImageWithCameraWarpMap(const CameraWarpMap& warp_map,
+                                const Bitmap& source_image,
+                                Bitmap* target_image);
+
 // Warp an image with the given homography, where H defines the pixel mapping
 // from the target to source image. Note that the pixel centers are assumed to
 // have coordinates (0.5, 0.5).
@@ -0,0 +1,216 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/image/warp_cuda.h"
+
+#include "colmap/util/cuda.h"
+#include "colmap/util/cudacc.h"
+#include "colmap/util/logging.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include <cuda_runtime.h>
+
+namespace colmap {
+namespace {
+
+const int kBlockDimX = 32;
+const int kBlockDimY = 8;
+
+// Each thread interpolates one pixel of the target image. The interpolation
+// follows Bitmap::InterpolateBilinear, whose origin is in the lower left of
+// the image, such that the results are identical to the CPU implementation.
+// The rows of the source image start at its top row and are the given
+// (possibly negative) stride apart, and the target image is stored top-down
+// without padding.
+__global__ void WarpImageKernel(const float2* source_points,
+                                const int width,
+                                const int height,
+                                const int channels,
+                                const uint8_t* source_image,
+                                const ptrdiff_t source_stride,
+                                uint8_t* target_image) {
+  const int x = blockIdx.x * blockDim.x + threadIdx.x;
+  const int y = blockIdx.y * blockDim.y + threadIdx.y;
+  if (x >= width || y >= height) {
+    return;
+  }
+
+  const size_t pixel_idx = static_cast<size_t>(y) * width + x;
+  const float2 source_point = source_points[pixel_idx];
+  uint8_t* target_pixel = target_image + pixel_idx * channels;
+
+  const double inv_y = height - 1 - static_cast<double>(source_point.y);
+
+  const int x0 = static_cast<int>(floor(static_cast<double>(source_point.x)));
+  const int x1 = x0 + 1;
+  const int y0 = static_cast<int>(floor(inv_y));
+  const int y1 = y0 + 1;
+
+  if (x0 < 0 || x1 >= width || y0 < 0 || y1 >= height) {
+    for (int c = 0; c < channels; ++c) {
+      target_pixel[c] = 0;
+    }
+    return;
+  }
+
+  const double dx = source_point.x - x0;
+  const double dy = inv_y - y0;
+  const double dx_1 = 1 - dx;
+  const double dy_1 = 1 - dy;
+
+  const uint8_t* line0 =
+      source_image + static_cast<ptrdiff_t>(height - 1 - y0) * source_stride;
+  const uint8_t* line1 =
+      source_image + static_cast<ptrdiff_t>(height - 1 - y1) * source_stride;
+
+  for (int c = 0; c < channels; ++c) {
+    const double v0 =
+        dx_1 * line0[x0 * channels + c] + dx * line0[x1 * channels + c];
+    const double v1 =
+        dx_1 * line1[x0 * channels + c] + dx * line1[x1 * channels + c];
+    const double value = round(dy_1 * v0 + dy * v1);
+    target_pixel[c] = static_cast<uint8_t>(fmin(255.0, fmax(0.0, value)));
+  }
+}
+
+}  // namespace
+
+CudaCameraWarper::CudaCameraWarper(const int gpu_index,
+                                   const CameraWarpMap& warp_map)
+    : width_(warp_map.width),
+      height_(warp_map.height),
+      target_width_(warp_map.target_width),
+      target_height_(warp_map.target_height),
+      device_id_(-1),
+      source_points_d_(nullptr) {
+  THROW_CHECK_GT(width_, 0);
+  THROW_CHECK_GT(height_, 0);
+  THROW_CHECK_EQ(warp_map.source_points.size(),
+                 static_cast<size_t>(width_) * height_);
+
+  SetBestCudaDevice(gpu_index);
+  CUDA_SAFE_CALL(cudaGetDevice(&device_id_));
+
+  std::vector<float> source_points(2 * warp_map.source_points.size());
+  for (size_t i = 0; i < warp_map.source_points.size(); ++i) {
+    source_points[2 * i] = warp_map.source_points[i].x();
+    source_points[2 * i + 1] = warp_map.source_points[i].y();
+  }
+
+  const size_t num_bytes = source_points.size() * sizeof(float);
+  CUDA_SAFE_CALL(cudaMalloc(&source_points_d_, num_bytes));
+  CUDA_SAFE_CALL(cudaMemcpy(source_points_d_,
+                            source_points.data(),
+                            num_bytes,
+                            cudaMemcpyHostToDevice));
+}
+
+CudaCameraWarper::~CudaCameraWarper() {
+  cudaSetDevice(device_id_);
+  cudaFree(source_points_d_);
+}
+
+void CudaCameraWarper::Warp(const Bitmap& source_image,
+                            Bitmap* target_image) const {
+  THROW_CHECK_EQ(width_, source_image.Width());
+  THROW_CHECK_EQ(height_, source_image.Height());
+  THROW_CHECK_NOTNULL(target_image);
+
+  // The scanlines are uploaded directly from the bitmap in their memory order
+  // without an intermediate copy on the host.
+  const BitmapView source_view = source_image.View();
+  const int channels = source_view.channels;
+  const ptrdiff_t source_pitch = std::abs(source_view.stride);
+  const uint8_t* source_begin = source_view.stride < 0
+                                    ? source_view.Row(height_ - 1)
+                                    : source_view.Row(0);
+  const int target_pitch = width_ * channels;
+  const size_t source_num_bytes = static_cast<size_t>(source_pitch) * height_;
+  const size_t target_num_bytes = static_cast<size_t>(target_pitch) * height_;
+
+  std::vector<uint8_t> target_bits(target_num_bytes);
+
+  CUDA_SAFE_CALL(cudaSetDevice(device_id_));
+
+  // Use a separate stream per call, such that concurrent calls from different
+  // threads only synchronize with their own transfers and kernels.
+  cudaStream_t stream;
+  CUDA_SAFE_CALL(cudaStreamCreateWithFlags(&stream, cudaStreamNonBlocking));
+
+  uint8_t* source_image_d = nullptr;
+  uint8_t* target_image_d = nullptr;
+  CUDA_SAFE_CALL(cudaMalloc(&source_image_d, source_num_bytes));
+  CUDA_SAFE_CALL(cudaMalloc(&target_image_d, target_num_bytes));
+  CUDA_SAFE_CALL(cudaMemcpyAsync(source_image_d,
+                                 source_begin,
+                                 source_num_bytes,
+                                 cudaMemcpyHostToDevice,
+                                 stream));
+
+  const uint8_t* source_top_row_d =
+      source_view.stride < 0
+          ? source_image_d + static_cast<size_t>(height_ - 1) * source_pitch
+          : source_image_d;
+
+  const dim3 block_size(kBlockDimX, kBlockDimY);
+  const dim3 grid_size((width_ + kBlockDimX - 1) / kBlockDimX,
+                       (height_ + kBlockDimY - 1) / kBlockDimY);
+  WarpImageKernel<<<grid_size, block_size, 0, stream>>>(
+      reinterpret_cast<const float2*>(source_points_d_),
+      width_,
+      height_,
+      channels,
+      source_top_row_d,
+      source_view.stride,
+      target_image_d);
+  CUDA_SAFE_CALL(cudaGetLastError());
+
+  CUDA_SAFE_CALL(cudaMemcpyAsync(target_bits.data(),
+                                 target_image_d,
+                                 target_num_bytes,
+                                 cudaMemcpyDeviceToHost,
+                                 stream));
+  CUDA_SAFE_CALL(cudaStreamSynchronize(stream));
+
+  CUDA_SAFE_CALL(cudaFree(source_image_d));
+  CUDA_SAFE_CALL(cudaFree(target_image_d));
+  CUDA_SAFE_CALL(cudaStreamDestroy(stream));
+
+  *target_image = Bitmap::ConvertFromRawBits(
+      target_bits.data(), target_pitch, width_, height_, channels == 3);
+
+  if (target_width_ != width_ || target_height_ != height_) {
+    target_image->Rescale(target_width_, target_height_);
+  }
+}
+
+}  // namespace colmap
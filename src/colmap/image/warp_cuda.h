@@ -0,0 +1,68 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/image/warp.h"
+#include "colmap/sensor/bitmap.h"
+
+#include <cstdint>
+
+namespace colmap {
+
+// Warping of images between two cameras on the GPU. The source pixel
+// coordinates of the warp map are uploaded once and stay resident in device
+// memory, such that warping the images of the same camera only transfers the
+// source and target images.
+class CudaCameraWarper {
+ public:
+  // The GPU is selected as in SetBestCudaDevice.
+  CudaCameraWarper(int gpu_index, const CameraWarpMap& warp_map);
+  ~CudaCameraWarper();
+
+  CudaCameraWarper(const CudaCameraWarper&) = delete;
+  CudaCameraWarper& operator=(const CudaCameraWarper&) = delete;
+
+  // Warp the source image as WarpImageWithCameraWarpMap. The bilinear
+  // interpolation is computed on the GPU, while the rescaling to the target
+  // camera is done on the CPU. This function is thread-safe.
+  void Warp(const Bitmap& source_image, Bitmap* target_image) const;
+
+ private:
+  const int width_;
+  const int height_;
+  const int target_width_;
+  const int target_height_;
+  int device_id_;
+  // The interleaved source pixel coordinates of the warp map.
+  float* source_points_d_;
+};
+
+}  // namespace colmap
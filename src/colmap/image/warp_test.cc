@@ -131,6 +131,43 @@ TEST(Warp, ShiftedCameras) {
   }
 }
 
+TEST(Warp, ComputeCameraWarpMap) {
+  const Camera source_camera =
+      Camera::CreateFromModelName(1, "PINHOLE", 1, 100, 80);
+  Camera target_camera = source_camera;
+  target_camera.SetPrincipalPointX(40.0);
+  target_camera.Rescale(50, 40);
+  const CameraWarpMap warp_map =
+      ComputeCameraWarpMap(source_camera, target_camera);
+  EXPECT_EQ(warp_map.width, 100);
+  EXPECT_EQ(warp_map.height, 80);
+  EXPECT_EQ(warp_map.target_width, 50);
+  EXPECT_EQ(warp_map.target_height, 40);
+  ASSERT_EQ(warp_map.source_points.size(), 100 * 80);
+  EXPECT_NEAR(warp_map.source_points[0].x(), 10, 1e-5);
+  EXPECT_NEAR(warp_map.source_points[0].y(), 0, 1e-5);
+  EXPECT_NEAR(warp_map.source_points[2 * 100 + 3].x(), 13, 1e-5);
+  EXPECT_NEAR(warp_map.source_points[2 * 100 + 3].y(), 2, 1e-5);
+}
+
+TEST(Warp, WarpImageWithCameraWarpMap) {
+  const Camera source_camera =
+      Camera::CreateFromModelName(1, "SIMPLE_RADIAL", 100, 100, 100);
+  Camera target_camera = Camera::CreateFromModelName(2, "PINHOLE", 90, 80, 80);
+  Bitmap source_image;
+  GenerateRandomBitmap(100, 100, true, &source_image);
+  Bitmap target_image;
+  WarpImageBetweenCameras(
+      source_camera, target_camera, source_image, &target_image);
+  const CameraWarpMap warp_map =
+      ComputeCameraWarpMap(source_camera, target_camera);
+  for (int i = 0; i < 2; ++i) {
+    Bitmap mapped_target_image;
+    WarpImageWithCameraWarpMap(warp_map, source_image, &mapped_target_image);
+    CheckBitmapsEqual(target_image, mapped_target_image);
+  }
+}
+
 TEST(Warp, WarpImageWithHomographyIdentity) {
   Bitmap source_image_gray;
   GenerateRandomBitmap(100, 100, false, &source_image_gray);
@@ -168,6 +205,33 @@ TEST(Warp, WarpImageWithHomographyTransposed) {
   CheckBitmapsTransposed(source_image_rgb, target_image_rgb);
 }
 
+TEST(Warp, WarpImageWithHomographyMatchesInterpolateBilinear) {
+  Eigen::Matrix3d H;
+  H << 0.9, 0.1, 3.3, -0.2, 1.1, -4.7, 0.0001, -0.0002, 1;
+  for (const bool as_rgb : {false, true}) {
+    Bitmap source_image;
+    GenerateRandomBitmap(100, 80, as_rgb, &source_image);
+    Bitmap target_image;
+    target_image.Allocate(90, 70, as_rgb);
+    WarpImageWithHomography(H, source_image, &target_image);
+    for (int y = 0; y < target_image.Height(); ++y) {
+      for (int x = 0; x < target_image.Width(); ++x) {
+        const Eigen::Vector2d source_pixel =
+            (H * Eigen::Vector3d(x + 0.5, y + 0.5, 1)).hnormalized();
+        BitmapColor<float> color;
+        BitmapColor<uint8_t> expected_color(0);
+        if (source_image.InterpolateBilinear(
+                source_pixel.x() - 0.5, source_pixel.y() - 0.5, &color)) {
+          expected_color = color.Cast<uint8_t>();
+        }
+        BitmapColor<uint8_t> target_color;
+        EXPECT_TRUE(target_image.GetPixel(x, y, &target_color));
+        EXPECT_EQ(target_color, expected_color);
+      }
+    }
+  }
+}
+
 TEST(Warp, WarpImageWithHomographyBetweenCamerasIdentity) {
   const Camera camera = Camera::CreateFromModelName(1, "PINHOLE", 1, 100, 100);
   Bitmap source_image_gray;
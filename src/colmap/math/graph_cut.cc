@@ -29,6 +29,8 @@
 
 #include "colmap/math/graph_cut.h"
 
+#include <algorithm>
+#include <limits>
 #include <unordered_map>
 
 #include <boost/graph/stoer_wagner_min_cut.hpp>
@@ -47,52 +49,63 @@ extern "C" {
 #endif
 
 #include "colmap/util/logging.h"
+#include "colmap/util/threading.h"
 
 namespace colmap {
 namespace {
 
-// Wrapper class for weighted, undirected Metis graph.
+// Wrapper class for weighted, undirected Metis graph. The adjacency structure
+// is directly built in the compressed sparse row format expected by Metis,
+// which requires linear time and memory in the number of edges.
 class MetisGraph {
  public:
   MetisGraph(const std::vector<std::pair<int, int>>& edges,
              const std::vector<int>& weights) {
-    std::unordered_map<int, std::vector<std::pair<int, int>>> adjacency_list;
-    for (size_t i = 0; i < edges.size(); ++i) {
-      const auto& edge = edges[i];
-      const auto weight = weights[i];
-      const int vertex_idx1 = GetVertexIdx(edge.first);
-      const int vertex_idx2 = GetVertexIdx(edge.second);
-      adjacency_list[vertex_idx1].emplace_back(vertex_idx2, weight);
-      adjacency_list[vertex_idx2].emplace_back(vertex_idx1, weight);
+    // Map the vertex identifiers to consecutive indices.
+    vertex_idx_to_id_.reserve(2 * edges.size());
+    for (const auto& edge : edges) {
+      vertex_idx_to_id_.push_back(edge.first);
+      vertex_idx_to_id_.push_back(edge.second);
     }
+    std::sort(vertex_idx_to_id_.begin(), vertex_idx_to_id_.end());
+    vertex_idx_to_id_.erase(
+        std::unique(vertex_idx_to_id_.begin(), vertex_idx_to_id_.end()),
+        vertex_idx_to_id_.end());
+    vertex_idx_to_id_.shrink_to_fit();
 
-    xadj_.reserve(vertex_id_to_idx_.size() + 1);
-    adjncy_.reserve(2 * edges.size());
-    adjwgt_.reserve(2 * edges.size());
-
-    idx_t edge_idx = 0;
-    for (size_t i = 0; i < vertex_id_to_idx_.size(); ++i) {
-      xadj_.push_back(edge_idx);
-
-      if (adjacency_list.count(i) == 0) {
-        continue;
-      }
+    std::vector<idx_t> edge_vertex_idxs(2 * edges.size());
+    for (size_t i = 0; i < edges.size(); ++i) {
+      edge_vertex_idxs[2 * i] = GetVertexIdx(edges[i].first);
+      edge_vertex_idxs[2 * i + 1] = GetVertexIdx(edges[i].second);
+    }
 
-      for (const auto& edge : adjacency_list[i]) {
-        edge_idx += 1;
-        adjncy_.push_back(edge.first);
-        adjwgt_.push_back(edge.second);
-      }
+    // Count the vertex degrees and accumulate them to the row offsets.
+    xadj_.resize(vertex_idx_to_id_.size() + 1, 0);
+    for (const idx_t vertex_idx : edge_vertex_idxs) {
+      xadj_[vertex_idx + 1] += 1;
+    }
+    for (size_t i = 1; i < xadj_.size(); ++i) {
+      xadj_[i] += xadj_[i - 1];
     }
 
-    xadj_.push_back(edge_idx);
+    // Insert both directions of every edge at the next free position.
+    adjncy_.resize(2 * edges.size());
+    adjwgt_.resize(2 * edges.size());
+    std::vector<idx_t> next_edge_idxs(xadj_.begin(), xadj_.end() - 1);
+    for (size_t i = 0; i < edges.size(); ++i) {
+      const idx_t vertex_idx1 = edge_vertex_idxs[2 * i];
+      const idx_t vertex_idx2 = edge_vertex_idxs[2 * i + 1];
+      const idx_t edge_idx1 = next_edge_idxs[vertex_idx1]++;
+      adjncy_[edge_idx1] = vertex_idx2;
+      adjwgt_[edge_idx1] = weights[i];
+      const idx_t edge_idx2 = next_edge_idxs[vertex_idx2]++;
+      adjncy_[edge_idx2] = vertex_idx1;
+      adjwgt_[edge_idx2] = weights[i];
+    }
 
-    THROW_CHECK_EQ(edge_idx, 2 * edges.size());
-    THROW_CHECK_EQ(xadj_.size(), vertex_id_to_idx_.size() + 1);
-    THROW_CHECK_EQ(adjncy_.size(), 2 * edges.size());
-    THROW_CHECK_EQ(adjwgt_.size(), 2 * edges.size());
+    THROW_CHECK_EQ(xadj_.back(), 2 * edges.size());
 
-    nvtxs = vertex_id_to_idx_.size();
+    nvtxs = vertex_idx_to_id_.size();
 
     xadj = xadj_.data();
     adjncy = adjncy_.data();
@@ -101,19 +114,13 @@ class MetisGraph {
     adjwgt = adjwgt_.data();
   }
 
-  int GetVertexIdx(const int id) {
-    const auto it = vertex_id_to_idx_.find(id);
-    if (it == vertex_id_to_idx_.end()) {
-      const int idx = vertex_id_to_idx_.size();
-      vertex_id_to_idx_.emplace(id, idx);
-      vertex_idx_to_id_.emplace(idx, id);
-      return idx;
-    } else {
-      return it->second;
-    }
+  int GetVertexIdx(const int id) const {
+    return std::lower_bound(
+               vertex_idx_to_id_.begin(), vertex_idx_to_id_.end(), id) -
+           vertex_idx_to_id_.begin();
   }
 
-  int GetVertexId(const int idx) { return vertex_idx_to_id_.at(idx); }
+  int GetVertexId(const int idx) const { return vertex_idx_to_id_.at(idx); }
 
   idx_t nvtxs = 0;
   idx_t* xadj = nullptr;
@@ -122,13 +129,19 @@ class MetisGraph {
   idx_t* adjwgt = nullptr;
 
  private:
-  std::unordered_map<int, int> vertex_id_to_idx_;
-  std::unordered_map<int, int> vertex_idx_to_id_;
+  std::vector<int> vertex_idx_to_id_;
   std::vector<idx_t> xadj_;
   std::vector<idx_t> adjncy_;
   std::vector<idx_t> adjwgt_;
 };
 
+void AtomicAdd(std::atomic<double>* value, const double delta) {
+  double expected = value->load(std::memory_order_relaxed);
+  while (!value->compare_exchange_weak(
+      expected, expected + delta, std::memory_order_relaxed)) {
+  }
+}
+
 }  // namespace
 
 void ComputeMinGraphCutStoerWagner(
@@ -216,6 +229,7 @@ std::unordered_map<int, int> ComputeNormalizedMinGraphCut(
   }
 
   std::unordered_map<int, int> labels;
+  labels.reserve(cut_labels.size());
   for (size_t idx = 0; idx < cut_labels.size(); ++idx) {
     labels.emplace(graph.GetVertexId(idx), cut_labels[idx]);
   }
@@ -223,4 +237,310 @@ std::unordered_map<int, int> ComputeNormalizedMinGraphCut(
   return labels;
 }
 
+struct ParallelPushRelabelMaxFlow::DischargeResult {
+  int label = 0;
+  double excess = 0;
+  int64_t work = 0;
+};
+
+ParallelPushRelabelMaxFlow::ParallelPushRelabelMaxFlow(
+    const size_t num_vertices, const int num_threads)
+    : num_vertices_(static_cast<int>(num_vertices)),
+      num_threads_(num_threads) {
+  THROW_CHECK_LE(num_vertices, std::numeric_limits<int>::max());
+}
+
+size_t ParallelPushRelabelMaxFlow::NumVertices() const {
+  return num_vertices_;
+}
+
+size_t ParallelPushRelabelMaxFlow::NumArcs() const {
+  return computed_ ? arc_heads_.size() : 2 * edges_.size();
+}
+
+void ParallelPushRelabelMaxFlow::AddEdge(const size_t vertex_idx1,
+                                         const size_t vertex_idx2,
+                                         const double capacity,
+                                         const double reverse_capacity) {
+  THROW_CHECK(!computed_);
+  THROW_CHECK_LT(vertex_idx1, num_vertices_);
+  THROW_CHECK_LT(vertex_idx2, num_vertices_);
+  THROW_CHECK_GE(capacity, 0);
+  THROW_CHECK_GE(reverse_capacity, 0);
+  edges_.emplace_back(vertex_idx1, vertex_idx2);
+  edge_capacities_.emplace_back(capacity, reverse_capacity);
+}
+
+double ParallelPushRelabelMaxFlow::Compute(const size_t source_idx,
+                                           const size_t sink_idx) {
+  THROW_CHECK(!computed_);
+  THROW_CHECK_LT(source_idx, num_vertices_);
+  THROW_CHECK_LT(sink_idx, num_vertices_);
+  THROW_CHECK_NE(source_idx, sink_idx);
+
+  computed_ = true;
+  source_idx_ = static_cast<int>(source_idx);
+  sink_idx_ = static_cast<int>(sink_idx);
+
+  BuildGraph();
+
+  labels_.resize(num_vertices_);
+  excesses_.assign(num_vertices_, 0);
+  added_excesses_ = std::make_unique<std::atomic<double>[]>(num_vertices_);
+  is_discovered_ = std::make_unique<std::atomic<bool>[]>(num_vertices_);
+
+  // Initialize the preflow by saturating all arcs out of the source.
+  for (int arc_idx = arc_offsets_[source_idx_];
+       arc_idx < arc_offsets_[source_idx_ + 1];
+       ++arc_idx) {
+    const double residual = arc_residuals_[arc_idx].load();
+    if (residual > 0) {
+      arc_residuals_[arc_idx] = 0;
+      arc_residuals_[arc_reverse_idxs_[arc_idx]] =
+          arc_residuals_[arc_reverse_idxs_[arc_idx]].load() + residual;
+      excesses_[arc_heads_[arc_idx]] += residual;
+    }
+  }
+
+  std::unique_ptr<ThreadPool> thread_pool;
+  if (GetEffectiveNumThreads(num_threads_) > 1) {
+    thread_pool =
+        std::make_unique<ThreadPool>(GetEffectiveNumThreads(num_threads_));
+  }
+
+  // The labels are recomputed after the work, i.e., the number of scanned
+  // arcs, exceeds this threshold as suggested in the paper.
+  const int64_t kGlobalRelabelFactor = 6;
+  const int64_t global_relabel_work =
+      kGlobalRelabelFactor * num_vertices_ + arc_heads_.size();
+  // Small sets of active vertices are discharged sequentially, since the
+  // parallelization overhead would dominate.
+  const size_t kMinNumParallelVertices = 256;
+
+  std::vector<int> active_vertex_idxs;
+  std::vector<int> next_active_vertex_idxs;
+  std::vector<DischargeResult> results;
+  std::vector<std::vector<int>> discovered_vertex_idxs;
+  int64_t work_since_global_relabel = global_relabel_work + 1;
+
+  while (true) {
+    if (active_vertex_idxs.empty() ||
+        work_since_global_relabel > global_relabel_work) {
+      GlobalRelabel();
+      work_since_global_relabel = 0;
+      active_vertex_idxs.clear();
+      for (int vertex_idx = 0; vertex_idx < num_vertices_; ++vertex_idx) {
+        if (IsActive(vertex_idx)) {
+          active_vertex_idxs.push_back(vertex_idx);
+        }
+      }
+      if (active_vertex_idxs.empty()) {
+        break;
+      }
+    }
+
+    // Active vertices are not discovered again by pushes in this round.
+    for (const int vertex_idx : active_vertex_idxs) {
+      is_discovered_[vertex_idx] = true;
+    }
+
+    const size_t num_active_vertices = active_vertex_idxs.size();
+    results.resize(num_active_vertices);
+    if (discovered_vertex_idxs.size() < num_active_vertices) {
+      discovered_vertex_idxs.resize(num_active_vertices);
+    }
+
+    auto DischargeActiveVertex = [&](const int64_t i) {
+      discovered_vertex_idxs[i].clear();
+      results[i] =
+          Discharge(active_vertex_idxs[i], &discovered_vertex_idxs[i]);
+    };
+
+    if (thread_pool && num_active_vertices >= kMinNumParallelVertices) {
+      thread_pool->ParallelFor(
+          0, num_active_vertices, /*grain_size=*/32, DischargeActiveVertex);
+    } else {
+      for (size_t i = 0; i < num_active_vertices; ++i) {
+        DischargeActiveVertex(i);
+      }
+    }
+
+    // Apply the new labels and excesses of the discharged vertices and add
+    // the excesses pushed to their neighbors.
+    for (size_t i = 0; i < num_active_vertices; ++i) {
+      labels_[active_vertex_idxs[i]] = results[i].label;
+      excesses_[active_vertex_idxs[i]] = results[i].excess;
+      work_since_global_relabel += results[i].work;
+    }
+
+    next_active_vertex_idxs.clear();
+    auto UpdateVertex = [&](const int vertex_idx) {
+      excesses_[vertex_idx] += added_excesses_[vertex_idx].exchange(0);
+      is_discovered_[vertex_idx] = false;
+      if (IsActive(vertex_idx)) {
+        next_active_vertex_idxs.push_back(vertex_idx);
+      }
+    };
+    for (size_t i = 0; i < num_active_vertices; ++i) {
+      UpdateVertex(active_vertex_idxs[i]);
+    }
+    for (size_t i = 0; i < num_active_vertices; ++i) {
+      for (const int vertex_idx : discovered_vertex_idxs[i]) {
+        UpdateVertex(vertex_idx);
+      }
+    }
+
+    active_vertex_idxs.swap(next_active_vertex_idxs);
+  }
+
+  // The last global relabeling determines the vertices that can still reach
+  // the sink in the residual graph and thereby the minimum cut.
+  return excesses_[sink_idx_] + added_excesses_[sink_idx_].load();
+}
+
+bool ParallelPushRelabelMaxFlow::IsConnectedToSink(
+    const size_t vertex_idx) const {
+  THROW_CHECK(computed_);
+  return labels_.at(vertex_idx) < num_vertices_;
+}
+
+void ParallelPushRelabelMaxFlow::BuildGraph() {
+  // Count the vertex degrees and accumulate them to the arc offsets.
+  arc_offsets_.assign(num_vertices_ + 1, 0);
+  for (const auto& edge : edges_) {
+    arc_offsets_[edge.first + 1] += 1;
+    arc_offsets_[edge.second + 1] += 1;
+  }
+  for (size_t i = 1; i < arc_offsets_.size(); ++i) {
+    arc_offsets_[i] += arc_offsets_[i - 1];
+  }
+
+  // Insert both directions of every edge at the next free position.
+  const size_t num_arcs = 2 * edges_.size();
+  THROW_CHECK_LE(num_arcs, std::numeric_limits<int>::max());
+  arc_heads_.resize(num_arcs);
+  arc_reverse_idxs_.resize(num_arcs);
+  arc_residuals_ = std::make_unique<std::atomic<double>[]>(num_arcs);
+  std::vector<int> next_arc_idxs(arc_offsets_.begin(), arc_offsets_.end() - 1);
+  for (size_t i = 0; i < edges_.size(); ++i) {
+    const int vertex_idx1 = edges_[i].first;
+    const int vertex_idx2 = edges_[i].second;
+    const int arc_idx1 = next_arc_idxs[vertex_idx1]++;
+    const int arc_idx2 = next_arc_idxs[vertex_idx2]++;
+    arc_heads_[arc_idx1] = vertex_idx2;
+    arc_heads_[arc_idx2] = vertex_idx1;
+    arc_reverse_idxs_[arc_idx1] = arc_idx2;
+    arc_reverse_idxs_[arc_idx2] = arc_idx1;
+    arc_residuals_[arc_idx1] = edge_capacities_[i].first;
+    arc_residuals_[arc_idx2] = edge_capacities_[i].second;
+  }
+
+  edges_ = {};
+  edge_capacities_ = {};
+}
+
+bool ParallelPushRelabelMaxFlow::IsActive(const int vertex_idx) const {
+  return excesses_[vertex_idx] > 0 && labels_[vertex_idx] < num_vertices_ &&
+         vertex_idx != source_idx_ && vertex_idx != sink_idx_;
+}
+
+void ParallelPushRelabelMaxFlow::GlobalRelabel() {
+  // Breadth-first search from the sink over the reverse residual arcs.
+  std::fill(labels_.begin(), labels_.end(), num_vertices_);
+  labels_[sink_idx_] = 0;
+  std::vector<int> queue;
+  queue.reserve(num_vertices_);
+  queue.push_back(sink_idx_);
+  for (size_t i = 0; i < queue.size(); ++i) {
+    const int vertex_idx = queue[i];
+    for (int arc_idx = arc_offsets_[vertex_idx];
+         arc_idx < arc_offsets_[vertex_idx + 1];
+         ++arc_idx) {
+      const int other_vertex_idx = arc_heads_[arc_idx];
+      if (labels_[other_vertex_idx] == num_vertices_ &&
+          other_vertex_idx != source_idx_ &&
+          arc_residuals_[arc_reverse_idxs_[arc_idx]].load(
+              std::memory_order_relaxed) > 0) {
+        labels_[other_vertex_idx] = labels_[vertex_idx] + 1;
+        queue.push_back(other_vertex_idx);
+      }
+    }
+  }
+}
+
+ParallelPushRelabelMaxFlow::DischargeResult
+ParallelPushRelabelMaxFlow::Discharge(
+    const int vertex_idx, std::vector<int>* discovered_vertex_idxs) {
+  // The labels and excesses of all vertices are those of the previous round,
+  // while the residuals of the arcs of the vertex are only modified by the
+  // vertex itself or by an inactive neighbor, which does not push.
+  const int old_label = labels_[vertex_idx];
+
+  DischargeResult result;
+  result.label = old_label;
+  result.excess = excesses_[vertex_idx];
+
+  while (result.excess > 0) {
+    int new_label = num_vertices_;
+    bool skipped = false;
+    for (int arc_idx = arc_offsets_[vertex_idx];
+         arc_idx < arc_offsets_[vertex_idx + 1] && result.excess > 0;
+         ++arc_idx) {
+      ++result.work;
+
+      const double residual =
+          arc_residuals_[arc_idx].load(std::memory_order_relaxed);
+      if (residual <= 0) {
+        continue;
+      }
+
+      const int other_vertex_idx = arc_heads_[arc_idx];
+      const int other_label = labels_[other_vertex_idx];
+      const bool admissible = result.label == other_label + 1;
+
+      // Two active neighbors must not push to each other in the same round,
+      // so only the winner of the pair may push over an admissible arc.
+      if (admissible && IsActive(other_vertex_idx)) {
+        const bool wins =
+            old_label == other_label + 1 || old_label < other_label - 1 ||
+            (old_label == other_label && vertex_idx < other_vertex_idx);
+        if (!wins) {
+          skipped = true;
+          continue;
+        }
+      }
+
+      if (admissible) {
+        const double delta = std::min(residual, result.excess);
+        result.excess -= delta;
+        arc_residuals_[arc_idx].store(residual - delta,
+                                      std::memory_order_relaxed);
+        std::atomic<double>& reverse_residual =
+            arc_residuals_[arc_reverse_idxs_[arc_idx]];
+        reverse_residual.store(
+            reverse_residual.load(std::memory_order_relaxed) + delta,
+            std::memory_order_relaxed);
+        AtomicAdd(&added_excesses_[other_vertex_idx], delta);
+        if (other_vertex_idx != source_idx_ && other_vertex_idx != sink_idx_ &&
+            !is_discovered_[other_vertex_idx].exchange(true)) {
+          discovered_vertex_idxs->push_back(other_vertex_idx);
+        }
+      } else if (other_label >= result.label) {
+        new_label = std::min(new_label, other_label + 1);
+      }
+    }
+
+    if (result.excess <= 0 || skipped) {
+      break;
+    }
+
+    result.label = new_label;
+    if (result.label >= num_vertices_) {
+      break;
+    }
+  }
+
+  return result;
+}
+
 }  // namespace colmap
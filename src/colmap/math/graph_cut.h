@@ -31,6 +31,8 @@
 
 #include "colmap/util/logging.h"
 
+#include <atomic>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -55,10 +57,82 @@ std::unordered_map<int, int> ComputeNormalizedMinGraphCut(
     const std::vector<int>& weights,
     int num_parts);
 
-// Compute the minimum graph cut of a directed S-T graph using the
+// Max-flow min-cut solver for directed S-T graphs based on the synchronous
+// parallel push-relabel algorithm, as described in:
+//   "Efficient Implementation of a Synchronous Parallel Push-Relabel
+//    Algorithm". Niklas Baumstark, Guy Blelloch, and Julian Shun. ESA, 2015.
+// All active vertices are discharged in parallel in rounds with a consistent
+// view of the labels of the previous round, and the labels are periodically
+// recomputed exactly by a global relabeling. The graph is stored in the
+// compressed sparse row format, which is built when computing the flow.
+class ParallelPushRelabelMaxFlow {
+ public:
+  ParallelPushRelabelMaxFlow(size_t num_vertices, int num_threads = -1);
+
+  size_t NumVertices() const;
+  size_t NumArcs() const;
+
+  // Add an edge with the capacities in both directions to the graph.
+  void AddEdge(size_t vertex_idx1,
+               size_t vertex_idx2,
+               double capacity,
+               double reverse_capacity);
+
+  // Compute the maximum flow from the source to the sink vertex, after which
+  // no more edges may be added.
+  double Compute(size_t source_idx, size_t sink_idx);
+
+  // Check whether the vertex is on the sink side of the minimum cut, i.e.,
+  // whether it can reach the sink in the residual graph.
+  bool IsConnectedToSink(size_t vertex_idx) const;
+
+ private:
+  struct DischargeResult;
+
+  void BuildGraph();
+  bool IsActive(int vertex_idx) const;
+  // Recompute the exact distances to the sink in the residual graph, where
+  // vertices that cannot reach the sink are assigned the number of vertices.
+  void GlobalRelabel();
+  // Push the excess of the vertex to its neighbors and relabel it until it
+  // has no excess left or loses a conflict with an active neighbor.
+  DischargeResult Discharge(int vertex_idx,
+                            std::vector<int>* discovered_vertex_idxs);
+
+  const int num_vertices_;
+  const int num_threads_;
+  bool computed_ = false;
+  int source_idx_ = -1;
+  int sink_idx_ = -1;
+
+  // The edges as added to the graph.
+  std::vector<std::pair<int, int>> edges_;
+  std::vector<std::pair<double, double>> edge_capacities_;
+
+  // The residual graph in compressed sparse row format, where each arc stores
+  // its head vertex, residual capacity, and the index of its reverse arc.
+  std::vector<int> arc_offsets_;
+  std::vector<int> arc_heads_;
+  std::vector<int> arc_reverse_idxs_;
+  std::unique_ptr<std::atomic<double>[]> arc_residuals_;
+
+  std::vector<int> labels_;
+  std::vector<double> excesses_;
+  std::unique_ptr<std::atomic<double>[]> added_excesses_;
+  std::unique_ptr<std::atomic<bool>[]> is_discovered_;
+};
+
+enum class MinSTGraphCutAlgorithm {
+  BOYKOV_KOLMOGOROV,
+  PARALLEL_PUSH_RELABEL,
+};
+
+// Compute the minimum graph cut of a directed S-T graph using, by default, the
 // Boykov-Kolmogorov max-flow min-cut algorithm, as descibed in:
 //   "An Experimental Comparison of Min-Cut/Max-Flow Algorithms for Energy
 //    Minimization in Vision". Yuri Boykov and Vladimir Kolmogorov. PAMI, 2004.
+// Alternatively, the parallel push-relabel algorithm can be used, which scales
+// better to large graphs with many cores.
 template <typename node_t, typename value_t>
 class MinSTGraphCut {
  public:
@@ -78,7 +152,11 @@ class MinSTGraphCut {
       adjacency_list<boost::vecS, boost::vecS, boost::directedS, size_t, Edge>
           graph_t;
 
-  explicit MinSTGraphCut(size_t num_nodes);
+  explicit MinSTGraphCut(
+      size_t num_nodes,
+      MinSTGraphCutAlgorithm algorithm =
+          MinSTGraphCutAlgorithm::BOYKOV_KOLMOGOROV,
+      int num_threads = -1);
 
   // Count the number of nodes and edges in the graph.
   size_t NumNodes() const;
@@ -105,6 +183,7 @@ class MinSTGraphCut {
   const node_t T_node_;
   graph_t graph_;
   std::vector<boost::default_color_type> colors_;
+  std::unique_ptr<ParallelPushRelabelMaxFlow> push_relabel_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -112,16 +191,32 @@ class MinSTGraphCut {
 ////////////////////////////////////////////////////////////////////////////////
 
 template <typename node_t, typename value_t>
-MinSTGraphCut<node_t, value_t>::MinSTGraphCut(const size_t num_nodes)
-    : S_node_(num_nodes), T_node_(num_nodes + 1), graph_(num_nodes + 2) {}
+MinSTGraphCut<node_t, value_t>::MinSTGraphCut(
+    const size_t num_nodes,
+    const MinSTGraphCutAlgorithm algorithm,
+    const int num_threads)
+    : S_node_(num_nodes), T_node_(num_nodes + 1) {
+  if (algorithm == MinSTGraphCutAlgorithm::PARALLEL_PUSH_RELABEL) {
+    push_relabel_ = std::make_unique<ParallelPushRelabelMaxFlow>(
+        num_nodes + 2, num_threads);
+  } else {
+    graph_ = graph_t(num_nodes + 2);
+  }
+}
 
 template <typename node_t, typename value_t>
 size_t MinSTGraphCut<node_t, value_t>::NumNodes() const {
+  if (push_relabel_) {
+    return push_relabel_->NumVertices() - 2;
+  }
   return boost::num_vertices(graph_) - 2;
 }
 
 template <typename node_t, typename value_t>
 size_t MinSTGraphCut<node_t, value_t>::NumEdges() const {
+  if (push_relabel_) {
+    return push_relabel_->NumArcs();
+  }
   return boost::num_edges(graph_);
 }
 
@@ -130,10 +225,20 @@ void MinSTGraphCut<node_t, value_t>::AddNode(const node_t node_idx,
                                              const value_t source_capacity,
                                              const value_t sink_capacity) {
   THROW_CHECK_GE(node_idx, 0);
-  THROW_CHECK_LE(node_idx, boost::num_vertices(graph_));
+  THROW_CHECK_LE(node_idx, NumNodes() + 2);
   THROW_CHECK_GE(source_capacity, 0);
   THROW_CHECK_GE(sink_capacity, 0);
 
+  if (push_relabel_) {
+    if (source_capacity > 0) {
+      push_relabel_->AddEdge(S_node_, node_idx, source_capacity, 0);
+    }
+    if (sink_capacity > 0) {
+      push_relabel_->AddEdge(node_idx, T_node_, sink_capacity, 0);
+    }
+    return;
+  }
+
   if (source_capacity > 0) {
     const edge_descriptor_t edge =
         boost::add_edge(S_node_, node_idx, graph_).first;
@@ -161,12 +266,17 @@ void MinSTGraphCut<node_t, value_t>::AddEdge(const node_t node_idx1,
                                              const value_t capacity,
                                              const value_t reverse_capacity) {
   THROW_CHECK_GE(node_idx1, 0);
-  THROW_CHECK_LE(node_idx1, boost::num_vertices(graph_));
+  THROW_CHECK_LE(node_idx1, NumNodes() + 2);
   THROW_CHECK_GE(node_idx2, 0);
-  THROW_CHECK_LE(node_idx2, boost::num_vertices(graph_));
+  THROW_CHECK_LE(node_idx2, NumNodes() + 2);
   THROW_CHECK_GE(capacity, 0);
   THROW_CHECK_GE(reverse_capacity, 0);
 
+  if (push_relabel_) {
+    push_relabel_->AddEdge(node_idx1, node_idx2, capacity, reverse_capacity);
+    return;
+  }
+
   const edge_descriptor_t edge =
       boost::add_edge(node_idx1, node_idx2, graph_).first;
   const edge_descriptor_t edge_reverse =
@@ -179,6 +289,10 @@ void MinSTGraphCut<node_t, value_t>::AddEdge(const node_t node_idx1,
 
 template <typename node_t, typename value_t>
 value_t MinSTGraphCut<node_t, value_t>::Compute() {
+  if (push_relabel_) {
+    return static_cast<value_t>(push_relabel_->Compute(S_node_, T_node_));
+  }
+
   const vertices_size_t num_vertices = boost::num_vertices(graph_);
 
   colors_.resize(num_vertices);
@@ -201,12 +315,18 @@ value_t MinSTGraphCut<node_t, value_t>::Compute() {
 template <typename node_t, typename value_t>
 bool MinSTGraphCut<node_t, value_t>::IsConnectedToSource(
     const node_t node_idx) const {
+  if (push_relabel_) {
+    return !push_relabel_->IsConnectedToSink(node_idx);
+  }
   return colors_.at(node_idx) != boost::white_color;
 }
 
 template <typename node_t, typename value_t>
 bool MinSTGraphCut<node_t, value_t>::IsConnectedToSink(
     const node_t node_idx) const {
+  if (push_relabel_) {
+    return push_relabel_->IsConnectedToSink(node_idx);
+  }
   return colors_.at(node_idx) == boost::white_color;
 }
 
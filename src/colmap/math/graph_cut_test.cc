@@ -29,6 +29,8 @@
 
 #include "colmap/math/graph_cut.h"
 
+#include "colmap/math/random.h"
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -275,5 +277,106 @@ TEST(GraphCut, MinSTGraphCut3) {
   EXPECT_TRUE(graph.IsConnectedToSink(2));
 }
 
+TEST(GraphCut, MinSTGraphCutParallelPushRelabel) {
+  const auto kAlgorithm = MinSTGraphCutAlgorithm::PARALLEL_PUSH_RELABEL;
+  {
+    MinSTGraphCut<int, int> graph(2, kAlgorithm);
+    EXPECT_EQ(graph.NumNodes(), 2);
+    EXPECT_EQ(graph.NumEdges(), 0);
+    graph.AddNode(0, 5, 1);
+    graph.AddNode(1, 2, 6);
+    graph.AddEdge(0, 1, 3, 4);
+    EXPECT_EQ(graph.NumEdges(), 10);
+    EXPECT_EQ(graph.Compute(), 6);
+    EXPECT_TRUE(graph.IsConnectedToSource(0));
+    EXPECT_TRUE(graph.IsConnectedToSink(1));
+  }
+  {
+    MinSTGraphCut<int, int> graph(2, kAlgorithm);
+    graph.AddNode(0, 1, 5);
+    graph.AddNode(1, 2, 6);
+    graph.AddEdge(0, 1, 3, 4);
+    EXPECT_EQ(graph.Compute(), 3);
+    EXPECT_TRUE(graph.IsConnectedToSink(0));
+    EXPECT_TRUE(graph.IsConnectedToSink(1));
+  }
+  {
+    MinSTGraphCut<int, int> graph(3, kAlgorithm);
+    graph.AddNode(0, 6, 4);
+    graph.AddNode(2, 3, 6);
+    graph.AddEdge(0, 1, 2, 4);
+    graph.AddEdge(1, 2, 3, 5);
+    EXPECT_EQ(graph.NumEdges(), 12);
+    EXPECT_EQ(graph.Compute(), 9);
+    EXPECT_TRUE(graph.IsConnectedToSource(0));
+    EXPECT_TRUE(graph.IsConnectedToSink(1));
+    EXPECT_TRUE(graph.IsConnectedToSink(2));
+  }
+}
+
+TEST(GraphCut, MinSTGraphCutParallelPushRelabelRandomGrid) {
+  SetPRNGSeed(0);
+  const int kWidth = 40;
+  const int kHeight = 30;
+  const int kNumNodes = kWidth * kHeight;
+  for (const int num_threads : {1, 4}) {
+    MinSTGraphCut<int, int> graph_bk(kNumNodes);
+    MinSTGraphCut<int, int> graph_pr(
+        kNumNodes, MinSTGraphCutAlgorithm::PARALLEL_PUSH_RELABEL, num_threads);
+    std::vector<std::pair<int, int>> edges;
+    std::vector<int> capacities;
+    std::vector<int> source_capacities;
+    std::vector<int> sink_capacities;
+    for (int y = 0; y < kHeight; ++y) {
+      for (int x = 0; x < kWidth; ++x) {
+        const int node_idx = y * kWidth + x;
+        source_capacities.push_back(RandomUniformInteger(0, 10));
+        sink_capacities.push_back(RandomUniformInteger(0, 10));
+        graph_bk.AddNode(
+            node_idx, source_capacities.back(), sink_capacities.back());
+        graph_pr.AddNode(
+            node_idx, source_capacities.back(), sink_capacities.back());
+        for (const int other_node_idx :
+             {x + 1 < kWidth ? node_idx + 1 : -1,
+              y + 1 < kHeight ? node_idx + kWidth : -1}) {
+          if (other_node_idx < 0) {
+            continue;
+          }
+          const int capacity = RandomUniformInteger(0, 8);
+          const int reverse_capacity = RandomUniformInteger(0, 8);
+          graph_bk.AddEdge(
+              node_idx, other_node_idx, capacity, reverse_capacity);
+          graph_pr.AddEdge(
+              node_idx, other_node_idx, capacity, reverse_capacity);
+          edges.emplace_back(node_idx, other_node_idx);
+          capacities.push_back(capacity);
+          edges.emplace_back(other_node_idx, node_idx);
+          capacities.push_back(reverse_capacity);
+        }
+      }
+    }
+
+    const int flow = graph_bk.Compute();
+    EXPECT_EQ(graph_pr.Compute(), flow);
+
+    // The capacity of the cut must equal the maximum flow.
+    int cut_capacity = 0;
+    for (int node_idx = 0; node_idx < kNumNodes; ++node_idx) {
+      if (graph_pr.IsConnectedToSource(node_idx)) {
+        cut_capacity += sink_capacities[node_idx];
+      } else {
+        cut_capacity += source_capacities[node_idx];
+      }
+    }
+    for (size_t i = 0; i < edges.size(); ++i) {
+      if (graph_pr.IsConnectedToSource(edges[i].first) &&
+          graph_pr.IsConnectedToSink(edges[i].second)) {
+        cut_capacity += capacities[i];
+      }
+    }
+    EXPECT_EQ(cut_capacity, flow);
+  }
+}
+
 }  // namespace
 }  // namespace colmap
@@ -31,6 +31,10 @@
 
 #include "colmap/util/eigen_alignment.h"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include <Eigen/Core>
 
 namespace colmap {
@@ -91,6 +95,17 @@ bool FindPolynomialRootsCompanionMatrix(const Eigen::VectorXd& coeffs,
                                         Eigen::VectorXd* real,
                                         Eigen::VectorXd* imag);
 
+// Find the real roots of a polynomial of maximum degree N, based on Sturm
+// sequences to isolate the roots, which are then refined by safeguarded
+// Newton iterations. In contrast to the functions above, all intermediate
+// storage is on the stack, such that the function is suitable for minimal
+// solvers evaluated in every RANSAC iteration. Leading zero coefficients reduce
+// the degree and roots with multiplicity are only returned once. The roots are
+// returned in ascending order and the number of roots is returned.
+template <int N>
+int FindRealPolynomialRootsSturm(const Eigen::Matrix<double, N + 1, 1>& coeffs,
+                                 Eigen::Matrix<double, N, 1>* roots);
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -104,4 +119,275 @@ T EvaluatePolynomial(const Eigen::VectorXd& coeffs, const T& x) {
   return value;
 }
 
+namespace internal {
+
+inline double EvaluatePolynomial(const double* coeffs,
+                                 const int degree,
+                                 const double x) {
+  double value = coeffs[0];
+  for (int i = 1; i <= degree; ++i) {
+    value = value * x + coeffs[i];
+  }
+  return value;
+}
+
+// Sturm sequence p_0 = p, p_1 = p', p_{i+1} = -rem(p_{i-1}, p_i) of a
+// polynomial with maximum degree N. The polynomials are scaled by positive
+// factors, which leaves the signs of their values unchanged.
+template <int N>
+struct SturmSequence {
+  double polys[N + 1][N + 1];
+  int degrees[N + 1];
+  int size = 0;
+
+  // Build the sequence for the polynomial with non-zero leading coefficient.
+  void Build(const double* coeffs, const int degree) {
+    for (int i = 0; i <= degree; ++i) {
+      polys[0][i] = coeffs[i];
+    }
+    degrees[0] = degree;
+    for (int i = 0; i < degree; ++i) {
+      polys[1][i] = coeffs[i] * (degree - i);
+    }
+    degrees[1] = degree - 1;
+    size = 2;
+    Normalize(0);
+    Normalize(1);
+
+    while (degrees[size - 1] > 0) {
+      const double* poly1 = polys[size - 2];
+      const double* poly2 = polys[size - 1];
+      const int degree1 = degrees[size - 2];
+      const int degree2 = degrees[size - 1];
+
+      // Polynomial long division, where the remainder is given by the
+      // trailing degree2 coefficients.
+      double rem[N + 1];
+      for (int i = 0; i <= degree1; ++i) {
+        rem[i] = poly1[i];
+      }
+      double max_factor = 0;
+      for (int i = 0; i <= degree1 - degree2; ++i) {
+        const double factor = rem[i] / poly2[0];
+        max_factor = std::max(max_factor, std::abs(factor));
+        for (int j = 0; j <= degree2; ++j) {
+          rem[i + j] -= factor * poly2[j];
+        }
+      }
+
+      // If the remainder vanishes up to numerical precision, the last
+      // polynomial is the greatest common divisor of p and p', i.e., p has
+      // multiple roots, and the sequence is complete.
+      const double* rem_begin = rem + degree1 - degree2 + 1;
+      double max_rem = 0;
+      for (int i = 0; i < degree2; ++i) {
+        max_rem = std::max(max_rem, std::abs(rem_begin[i]));
+      }
+      const double kEps = 16 * std::numeric_limits<double>::epsilon();
+      if (max_rem <= kEps * (1 + max_factor)) {
+        break;
+      }
+
+      int offset = 0;
+      while (offset < degree2 - 1 &&
+             std::abs(rem_begin[offset]) <= kEps * max_rem) {
+        ++offset;
+      }
+      degrees[size] = degree2 - 1 - offset;
+      for (int i = 0; i <= degrees[size]; ++i) {
+        polys[size][i] = -rem_begin[offset + i];
+      }
+      Normalize(size);
+      ++size;
+    }
+  }
+
+  void Normalize(const int idx) {
+    double max_coeff = 0;
+    for (int i = 0; i <= degrees[idx]; ++i) {
+      max_coeff = std::max(max_coeff, std::abs(polys[idx][i]));
+    }
+    if (max_coeff > 0) {
+      for (int i = 0; i <= degrees[idx]; ++i) {
+        polys[idx][i] /= max_coeff;
+      }
+    }
+  }
+
+  // Number of sign changes in the sequence evaluated at x. The difference of
+  // the sign changes at a < b is the number of distinct roots in (a, b].
+  int CountSignChanges(const double x) const {
+    int num_changes = 0;
+    double prev_value = 0;
+    for (int i = 0; i < size; ++i) {
+      const double value = EvaluatePolynomial(polys[i], degrees[i], x);
+      if (value != 0) {
+        if (prev_value != 0 && (value < 0) != (prev_value < 0)) {
+          ++num_changes;
+        }
+        prev_value = value;
+      }
+    }
+    return num_changes;
+  }
+};
+
+// Refine the single distinct root in (lower, upper].
+template <int N>
+double RefineSturmRoot(const SturmSequence<N>& sturm,
+                       double lower,
+                       double upper,
+                       int lower_num_changes) {
+  const double* poly = sturm.polys[0];
+  const int degree = sturm.degrees[0];
+  const int kMaxNumIterations = 100;
+
+  const double upper_value = EvaluatePolynomial(poly, degree, upper);
+  if (upper_value == 0) {
+    return upper;
+  }
+
+  const double lower_value = EvaluatePolynomial(poly, degree, lower);
+  if ((lower_value < 0) == (upper_value < 0)) {
+    // Roots of even multiplicity do not change the sign of the polynomial, so
+    // the root is bracketed by bisection of the Sturm sequence.
+    for (int i = 0; i < kMaxNumIterations; ++i) {
+      const double mid = 0.5 * (lower + upper);
+      if (mid <= lower || mid >= upper) {
+        break;
+      }
+      const int mid_num_changes = sturm.CountSignChanges(mid);
+      if (lower_num_changes > mid_num_changes) {
+        upper = mid;
+      } else {
+        lower = mid;
+        lower_num_changes = mid_num_changes;
+      }
+    }
+    return 0.5 * (lower + upper);
+  }
+
+  // Newton iterations, which fall back to bisection if the step leaves the
+  // bracket of the root or does not shrink fast enough, e.g., far from the
+  // root of a high degree polynomial.
+  const double kTolerance = 4 * std::numeric_limits<double>::epsilon();
+  double x = 0.5 * (lower + upper);
+  double prev_step = upper - lower;
+  for (int i = 0; i < 2 * kMaxNumIterations; ++i) {
+    double value = poly[0];
+    double derivative = 0;
+    for (int j = 1; j <= degree; ++j) {
+      derivative = derivative * x + value;
+      value = value * x + poly[j];
+    }
+    if (value == 0) {
+      return x;
+    }
+
+    if ((value < 0) == (lower_value < 0)) {
+      lower = x;
+    } else {
+      upper = x;
+    }
+
+    double next_x = x - value / derivative;
+    if (!(next_x > lower && next_x < upper) ||
+        std::abs(next_x - x) > 0.5 * prev_step) {
+      next_x = 0.5 * (lower + upper);
+    }
+    prev_step = std::abs(next_x - x);
+    if (prev_step <= kTolerance * std::max(1.0, std::abs(x))) {
+      return next_x;
+    }
+    x = next_x;
+  }
+
+  return x;
+}
+
+// Recursively bisect (lower, upper] until each interval contains a single
+// distinct root.
+template <int N>
+void IsolateSturmRoots(const SturmSequence<N>& sturm,
+                       const double lower,
+                       const double upper,
+                       const int lower_num_changes,
+                       const int upper_num_changes,
+                       const int depth,
+                       double* roots,
+                       int* num_roots) {
+  const int num_interval_roots = lower_num_changes - upper_num_changes;
+  if (num_interval_roots <= 0) {
+    return;
+  } else if (num_interval_roots == 1) {
+    roots[(*num_roots)++] =
+        RefineSturmRoot(sturm, lower, upper, lower_num_changes);
+    return;
+  }
+
+  // Roots that cannot be separated numerically are returned once.
+  const int kMaxDepth = 1100;
+  const double mid = 0.5 * (lower + upper);
+  if (depth >= kMaxDepth || mid <= lower || mid >= upper) {
+    roots[(*num_roots)++] = mid;
+    return;
+  }
+
+  const int mid_num_changes = sturm.CountSignChanges(mid);
+  IsolateSturmRoots(sturm,
+                    lower,
+                    mid,
+                    lower_num_changes,
+                    mid_num_changes,
+                    depth + 1,
+                    roots,
+                    num_roots);
+  IsolateSturmRoots(sturm,
+                    mid,
+                    upper,
+                    mid_num_changes,
+                    upper_num_changes,
+                    depth + 1,
+                    roots,
+                    num_roots);
+}
+
+}  // namespace internal
+
+template <int N>
+int FindRealPolynomialRootsSturm(const Eigen::Matrix<double, N + 1, 1>& coeffs,
+                                 Eigen::Matrix<double, N, 1>* roots) {
+  static_assert(N >= 1, "Polynomial must have at least degree 1");
+
+  int offset = 0;
+  while (offset < N && coeffs(offset) == 0) {
+    ++offset;
+  }
+  const int degree = N - offset;
+  if (degree == 0) {
+    return 0;
+  }
+
+  internal::SturmSequence<N> sturm;
+  sturm.Build(coeffs.data() + offset, degree);
+
+  // All roots lie strictly within the Cauchy bound.
+  double bound = 0;
+  for (int i = 1; i <= degree; ++i) {
+    bound = std::max(bound, std::abs(coeffs(offset + i) / coeffs(offset)));
+  }
+  bound += 1;
+
+  int num_roots = 0;
+  internal::IsolateSturmRoots(sturm,
+                              -bound,
+                              bound,
+                              sturm.CountSignChanges(-bound),
+                              sturm.CountSignChanges(bound),
+                              /*depth=*/0,
+                              roots->data(),
+                              &num_roots);
+  return num_roots;
+}
+
 }  // namespace colmap
@@ -29,6 +29,9 @@
 
 #include "colmap/math/polynomial.h"
 
+#include <algorithm>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -234,5 +237,62 @@ TEST(FindPolynomialRootsCompanionMatrixZeroSolution, Nominal) {
   EXPECT_TRUE(imag.isApprox(ref_imag, 1e-6));
 }
 
+TEST(FindRealPolynomialRootsSturm, Nominal) {
+  // (x + 3) * (x + 1) * (x - 2) * (x - 4)
+  Eigen::Matrix<double, 5, 1> coeffs;
+  coeffs << 1, -2, -13, 14, 24;
+  Eigen::Matrix<double, 4, 1> roots;
+  EXPECT_EQ(FindRealPolynomialRootsSturm<4>(coeffs, &roots), 4);
+  EXPECT_TRUE(roots.isApprox(Eigen::Vector4d(-3, -1, 2, 4), 1e-12));
+
+  // x^2 + 1 has no real roots.
+  Eigen::Vector2d quadratic_roots;
+  EXPECT_EQ(FindRealPolynomialRootsSturm<2>(Eigen::Vector3d(1, 0, 1),
+                                            &quadratic_roots),
+            0);
+}
+
+TEST(FindRealPolynomialRootsSturm, MultipleRoots) {
+  // x * (x - 1)^2
+  Eigen::Matrix<double, 3, 1> roots;
+  EXPECT_EQ(
+      FindRealPolynomialRootsSturm<3>(Eigen::Vector4d(1, -2, 1, 0), &roots), 2);
+  EXPECT_NEAR(roots(0), 0, 1e-12);
+  EXPECT_NEAR(roots(1), 1, 1e-6);
+}
+
+TEST(FindRealPolynomialRootsSturm, LeadingZeros) {
+  Eigen::Matrix<double, 3, 1> roots;
+  EXPECT_EQ(
+      FindRealPolynomialRootsSturm<3>(Eigen::Vector4d(0, 0, 2, -3), &roots), 1);
+  EXPECT_EQ(roots(0), 1.5);
+  EXPECT_EQ(
+      FindRealPolynomialRootsSturm<3>(Eigen::Vector4d(0, 0, 0, 1), &roots), 0);
+}
+
+TEST(FindRealPolynomialRootsSturm, CompareToCompanionMatrix) {
+  for (int i = 0; i < 100; ++i) {
+    const Eigen::Matrix<double, 11, 1> coeffs =
+        Eigen::Matrix<double, 11, 1>::Random();
+    Eigen::Matrix<double, 10, 1> roots;
+    const int num_roots = FindRealPolynomialRootsSturm<10>(coeffs, &roots);
+    Eigen::VectorXd real;
+    Eigen::VectorXd imag;
+    ASSERT_TRUE(FindPolynomialRootsCompanionMatrix(coeffs, &real, &imag));
+    std::vector<double> ref_roots;
+    for (int j = 0; j < real.size(); ++j) {
+      if (imag(j) == 0) {
+        ref_roots.push_back(real(j));
+      }
+    }
+    std::sort(ref_roots.begin(), ref_roots.end());
+    ASSERT_EQ(num_roots, static_cast<int>(ref_roots.size()));
+    for (int j = 0; j < num_roots; ++j) {
+      EXPECT_NEAR(
+          roots(j), ref_roots[j], 1e-8 * std::max(1.0, std::abs(ref_roots[j])));
+    }
+  }
+}
+
 }  // namespace
 }  // namespace colmap
@@ -32,6 +32,7 @@
 #include "colmap/util/logging.h"
 
 #include <chrono>
+#include <cstdint>
 #include <memory>
 #include <random>
 #include <thread>
@@ -78,6 +79,30 @@ T RandomGaussian(T mean, T stddev);
 template <typename T>
 void Shuffle(uint32_t num_to_shuffle, std::vector<T>* elems);
 
+// Small and fast PRNG (PCG-XSH-RR with 64-bit state) for drawing many random
+// numbers in hot loops, e.g., the samples in RANSAC. In contrast to the
+// global PRNG, each instance has its own state and must not be shared between
+// threads. Seed it from the global PRNG for repeatable results.
+class PCG32 {
+ public:
+  using result_type = uint32_t;
+
+  explicit PCG32(uint64_t seed = 0);
+
+  void Seed(uint64_t seed);
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return UINT32_MAX; }
+  result_type operator()();
+
+  // Generate uniformly distributed random integer number in [0, bound) using
+  // unbiased multiply-and-shift instead of a division per number.
+  uint32_t UniformInteger(uint32_t bound);
+
+ private:
+  uint64_t state_ = 0;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -124,4 +149,38 @@ void Shuffle(const uint32_t num_to_shuffle, std::vector<T>* elems) {
   }
 }
 
+inline PCG32::PCG32(const uint64_t seed) { Seed(seed); }
+
+inline void PCG32::Seed(const uint64_t seed) {
+  state_ = 0;
+  (*this)();
+  state_ += seed;
+  (*this)();
+}
+
+inline PCG32::result_type PCG32::operator()() {
+  const uint64_t state = state_;
+  state_ = state * 6364136223846793005ULL + 1442695040888963407ULL;
+  const uint32_t xorshifted =
+      static_cast<uint32_t>(((state >> 18) ^ state) >> 27);
+  const uint32_t rot = static_cast<uint32_t>(state >> 59);
+  return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+}
+
+inline uint32_t PCG32::UniformInteger(const uint32_t bound) {
+  THROW_CHECK_GT(bound, 0);
+  uint64_t product = static_cast<uint64_t>((*this)()) * bound;
+  uint32_t low = static_cast<uint32_t>(product);
+  if (low < bound) {
+    // Reject the few values, for which the range of the product is not evenly
+    // divided by the bound.
+    const uint32_t threshold = (0u - bound) % bound;
+    while (low < threshold) {
+      product = static_cast<uint64_t>((*this)()) * bound;
+      low = static_cast<uint32_t>(product);
+    }
+  }
+  return static_cast<uint32_t>(product >> 32);
+}
+
 }  // namespace colmap
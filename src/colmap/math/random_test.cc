@@ -136,5 +136,42 @@ TEST(ShuffleAll, Nominal) {
   EXPECT_GT(num_shuffled, 0);
 }
 
+TEST(PCG32, Repeatability) {
+  PCG32 prng1(0);
+  PCG32 prng2(1);
+  PCG32 prng3(0);
+  bool all_equal = true;
+  for (size_t i = 0; i < 100; ++i) {
+    const uint32_t number1 = prng1();
+    EXPECT_EQ(number1, prng3());
+    if (number1 != prng2()) {
+      all_equal = false;
+    }
+  }
+  EXPECT_FALSE(all_equal);
+  prng3.Seed(0);
+  prng1.Seed(0);
+  EXPECT_EQ(prng1(), prng3());
+}
+
+TEST(PCG32, UniformInteger) {
+  PCG32 prng(0);
+  EXPECT_EQ(prng.UniformInteger(1), 0);
+  std::vector<int> counts(10, 0);
+  const int kNumValues = 100000;
+  for (int i = 0; i < kNumValues; ++i) {
+    const uint32_t value = prng.UniformInteger(10);
+    ASSERT_LT(value, 10);
+    counts[value] += 1;
+  }
+  for (const int count : counts) {
+    EXPECT_NEAR(count, kNumValues / 10, kNumValues / 100);
+  }
+  const uint32_t kMaxBound = std::numeric_limits<uint32_t>::max();
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_LT(prng.UniformInteger(kMaxBound), kMaxBound);
+  }
+}
+
 }  // namespace
 }  // namespace colmap
@@ -29,99 +29,214 @@
 
 #include "colmap/mvs/consistency_graph.h"
 
+#include "colmap/mvs/map_compression.h"
+#include "colmap/util/endian.h"
 #include "colmap/util/logging.h"
-#include "colmap/util/misc.h"
 
+#include <algorithm>
+#include <bitset>
 #include <fstream>
-#include <numeric>
 
 namespace colmap {
 namespace mvs {
+namespace {
 
-const int ConsistencyGraph::kNoConsistentImageIds = -1;
+// Number of 16-bit values, into which the 64-bit bitmasks are split for
+// compression.
+const size_t kNumValuesPerMask = sizeof(uint64_t) / sizeof(uint16_t);
+
+}  // namespace
 
 ConsistencyGraph::ConsistencyGraph() {}
 
 ConsistencyGraph::ConsistencyGraph(const size_t width,
                                    const size_t height,
-                                   const std::vector<int>& data)
-    : data_(data) {
-  InitializeMap(width, height);
+                                   const std::vector<int>& data) {
+  InitializeMasks(width, height, data);
 }
 
+size_t ConsistencyGraph::GetWidth() const { return width_; }
+
+size_t ConsistencyGraph::GetHeight() const { return height_; }
+
 size_t ConsistencyGraph::GetNumBytes() const {
-  return (data_.size() + map_.size()) * sizeof(int);
+  return image_idxs_.size() * sizeof(int) + image_masks_.GetNumBytes();
+}
+
+const std::vector<int>& ConsistencyGraph::GetAllImageIdxs() const {
+  return image_idxs_;
+}
+
+const Mat<uint64_t>& ConsistencyGraph::GetImageMasks() const {
+  return image_masks_;
 }
 
 void ConsistencyGraph::GetImageIdxs(const int row,
                                     const int col,
-                                    int* num_images,
-                                    const int** image_idxs) const {
-  const int index = map_(row, col);
-  if (index == kNoConsistentImageIds) {
-    *num_images = 0;
-    *image_idxs = nullptr;
-  } else {
-    *num_images = data_.at(index);
-    *image_idxs = &data_.at(index + 1);
+                                    std::vector<int>* image_idxs) const {
+  image_idxs->clear();
+  for (size_t slice = 0; slice < image_masks_.GetDepth(); ++slice) {
+    uint64_t mask = image_masks_.Get(row, col, slice);
+    for (size_t i = slice * 64; mask != 0; ++i, mask >>= 1) {
+      if (mask & 1) {
+        image_idxs->push_back(image_idxs_[i]);
+      }
+    }
+  }
+}
+
+int ConsistencyGraph::GetNumImages(const int row, const int col) const {
+  int num_images = 0;
+  for (size_t slice = 0; slice < image_masks_.GetDepth(); ++slice) {
+    num_images += std::bitset<64>(image_masks_.Get(row, col, slice)).count();
+  }
+  return num_images;
+}
+
+bool ConsistencyGraph::IsConsistent(const int row,
+                                    const int col,
+                                    const int image_idx) const {
+  const auto it =
+      std::lower_bound(image_idxs_.begin(), image_idxs_.end(), image_idx);
+  if (it == image_idxs_.end() || *it != image_idx) {
+    return false;
   }
+  const size_t i = it - image_idxs_.begin();
+  return image_masks_.Get(row, col, i / 64) & (uint64_t(1) << (i % 64));
 }
 
 void ConsistencyGraph::Read(const std::string& path) {
-  std::fstream text_file(path, std::ios::in | std::ios::binary);
-  THROW_CHECK_FILE_OPEN(text_file, path);
+  std::ifstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
 
   size_t width = 0;
   size_t height = 0;
   size_t depth = 0;
-  char unused_char;
+  if (ReadCompressedMapHeader(&file, &width, &height, &depth)) {
+    THROW_CHECK_GT(width, 0) << path;
+    THROW_CHECK_GT(height, 0) << path;
+
+    std::vector<int> image_idxs(ReadBinaryLittleEndian<int>(&file));
+    ReadBinaryLittleEndian<int>(&file, &image_idxs);
+    THROW_CHECK(file) << "Truncated consistency graph: " << path;
+    THROW_CHECK_EQ(depth, (image_idxs.size() + 63) / 64) << path;
+
+    Mat<uint64_t> image_masks(width, height, depth);
+    const size_t num_masks = width * height * depth;
+    std::vector<uint16_t> values(kNumValuesPerMask * num_masks);
+    ReadCompressedMapValues(&file, &values);
+    uint64_t* masks = image_masks.GetPtr();
+    for (size_t j = 0; j < kNumValuesPerMask; ++j) {
+      for (size_t i = 0; i < num_masks; ++i) {
+        masks[i] |= static_cast<uint64_t>(values[j * num_masks + i])
+                    << (16 * j);
+      }
+    }
 
-  text_file >> width >> unused_char >> height >> unused_char >> depth >>
-      unused_char;
-  const std::streampos pos = text_file.tellg();
-  text_file.close();
+    width_ = width;
+    height_ = height;
+    image_idxs_ = std::move(image_idxs);
+    image_masks_ = std::move(image_masks);
+    return;
+  }
 
-  THROW_CHECK_GT(width, 0);
-  THROW_CHECK_GT(height, 0);
-  THROW_CHECK_GT(depth, 0);
+  char unused_char;
+  file >> width >> unused_char >> height >> unused_char >> depth >>
+      unused_char;
+  THROW_CHECK(file) << "Invalid consistency graph header: " << path;
+  THROW_CHECK_GT(width, 0) << path;
+  THROW_CHECK_GT(height, 0) << path;
+  THROW_CHECK_GT(depth, 0) << path;
 
-  std::fstream binary_file(path, std::ios::in | std::ios::binary);
-  THROW_CHECK_FILE_OPEN(binary_file, path);
+  const std::streampos pos = file.tellg();
+  file.seekg(0, std::ios::end);
+  const size_t num_bytes = file.tellg() - pos;
+  file.seekg(pos);
 
-  binary_file.seekg(0, std::ios::end);
-  const size_t num_bytes = binary_file.tellg() - pos;
+  std::vector<int> data(num_bytes / sizeof(int));
+  ReadBinaryLittleEndian<int>(&file, &data);
+  file.close();
 
-  data_.resize(num_bytes / sizeof(int));
+  InitializeMasks(width, height, data);
+}
 
-  binary_file.seekg(pos);
-  ReadBinaryLittleEndian<int>(&binary_file, &data_);
-  binary_file.close();
+void ConsistencyGraph::Write(const std::string& path,
+                             const bool compress) const {
+  std::ofstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  if (compress) {
+    WriteCompressedMapHeader(width_, height_, image_masks_.GetDepth(), &file);
+    WriteBinaryLittleEndian<int>(&file, static_cast<int>(image_idxs_.size()));
+    WriteBinaryLittleEndian<int>(&file, image_idxs_);
+
+    // Split the bitmasks into planes of 16-bit values, such that the delta
+    // encoding of equal bitmasks of neighboring pixels yields zeros.
+    const std::vector<uint64_t>& masks = image_masks_.GetData();
+    std::vector<uint16_t> values(kNumValuesPerMask * masks.size());
+    for (size_t j = 0; j < kNumValuesPerMask; ++j) {
+      for (size_t i = 0; i < masks.size(); ++i) {
+        values[j * masks.size() + i] =
+            static_cast<uint16_t>(masks[i] >> (16 * j));
+      }
+    }
+    WriteCompressedMapValues(values, &file);
+    file.close();
+    return;
+  }
 
-  InitializeMap(width, height);
-}
+  // Convert the bitmasks back to the flat list format.
+  std::vector<int> data;
+  std::vector<int> image_idxs;
+  for (size_t row = 0; row < height_; ++row) {
+    for (size_t col = 0; col < width_; ++col) {
+      GetImageIdxs(row, col, &image_idxs);
+      if (image_idxs.empty()) {
+        continue;
+      }
+      data.push_back(col);
+      data.push_back(row);
+      data.push_back(image_idxs.size());
+      data.insert(data.end(), image_idxs.begin(), image_idxs.end());
+    }
+  }
 
-void ConsistencyGraph::Write(const std::string& path) const {
-  std::fstream text_file(path, std::ios::out);
-  THROW_CHECK_FILE_OPEN(text_file, path);
-  text_file << map_.cols() << "&" << map_.rows() << "&" << 1 << "&";
-  text_file.close();
-
-  std::fstream binary_file(path,
-                           std::ios::out | std::ios::binary | std::ios::app);
-  THROW_CHECK_FILE_OPEN(binary_file, path);
-  WriteBinaryLittleEndian<int>(&binary_file, data_);
-  binary_file.close();
+  file << width_ << "&" << height_ << "&" << 1 << "&";
+  WriteBinaryLittleEndian<int>(&file, data);
+  file.close();
 }
 
-void ConsistencyGraph::InitializeMap(const size_t width, const size_t height) {
-  map_.resize(height, width);
-  map_.setConstant(kNoConsistentImageIds);
-  for (size_t i = 0; i < data_.size();) {
-    const int num_images = data_.at(i + 2);
-    if (num_images > 0) {
-      const int col = data_.at(i);
-      const int row = data_.at(i + 1);
-      map_(row, col) = i + 2;
+void ConsistencyGraph::InitializeMasks(const size_t width,
+                                       const size_t height,
+                                       const std::vector<int>& data) {
+  image_idxs_.clear();
+  for (size_t i = 0; i < data.size();) {
+    const int num_images = data.at(i + 2);
+    image_idxs_.insert(image_idxs_.end(),
+                       data.begin() + i + 3,
+                       data.begin() + i + 3 + num_images);
+    i += 3 + num_images;
+  }
+  std::sort(image_idxs_.begin(), image_idxs_.end());
+  image_idxs_.erase(std::unique(image_idxs_.begin(), image_idxs_.end()),
+                    image_idxs_.end());
+
+  width_ = width;
+  height_ = height;
+  image_masks_ = Mat<uint64_t>(width, height, (image_idxs_.size() + 63) / 64);
+  for (size_t i = 0; i < data.size();) {
+    const int col = data.at(i);
+    const int row = data.at(i + 1);
+    const int num_images = data.at(i + 2);
+    for (int j = 0; j < num_images; ++j) {
+      const size_t image_pos =
+          std::lower_bound(
+              image_idxs_.begin(), image_idxs_.end(), data.at(i + 3 + j)) -
+          image_idxs_.begin();
+      const size_t slice = image_pos / 64;
+      const uint64_t mask = image_masks_.Get(row, col, slice);
+      image_masks_.Set(
+          row, col, slice, mask | (uint64_t(1) << (image_pos % 64)));
     }
     i += 3 + num_images;
   }
@@ -29,18 +29,18 @@
 
 #pragma once
 
-#include "colmap/util/eigen_alignment.h"
+#include "colmap/mvs/mat.h"
 #include "colmap/util/types.h"
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
-#include <Eigen/Core>
-
 namespace colmap {
 namespace mvs {
 
-// List of geometrically consistent images, in the following format:
+// Geometrically consistent images of the pixels of a reference image. The
+// graph is constructed from a flat list in the following format:
 //
 //    r_1, c_1, N_1, i_11, i_12, ..., i_1N_1,
 //    r_2, c_2, N_2, i_21, i_22, ..., i_2N_2, ...
@@ -49,27 +49,49 @@ namespace mvs {
 // N is the number of consistent images, followed by the N image indices.
 // Note that only pixels are listed which are not filtered and that the
 // consistency graph is only filled if filtering is enabled.
+//
+// The consistent images of each pixel are stored as a bitmask over the sorted
+// list of all images consistent with any pixel, which are few source images in
+// practice, such that the graph takes a few bytes per pixel and the images of
+// a pixel can be queried in constant time. In the compressed file format,
+// the bitmasks are further delta encoded and LZ4 compressed, which collapses
+// the long runs of equal bitmasks of neighboring pixels.
 class ConsistencyGraph {
  public:
   ConsistencyGraph();
   ConsistencyGraph(size_t width, size_t height, const std::vector<int>& data);
 
+  size_t GetWidth() const;
+  size_t GetHeight() const;
   size_t GetNumBytes() const;
 
-  void GetImageIdxs(int row,
-                    int col,
-                    int* num_images,
-                    const int** image_idxs) const;
+  // The sorted indices of all images that are consistent with any pixel.
+  const std::vector<int>& GetAllImageIdxs() const;
+
+  // The bitmasks of consistent images per pixel, where bit i % 64 of slice
+  // i / 64 corresponds to the i-th image in GetAllImageIdxs.
+  const Mat<uint64_t>& GetImageMasks() const;
+
+  // Get the consistent image indices of a pixel in ascending order.
+  void GetImageIdxs(int row, int col, std::vector<int>* image_idxs) const;
+  int GetNumImages(int row, int col) const;
+  bool IsConsistent(int row, int col, int image_idx) const;
 
+  // Read the graph in the raw flat list or compressed format. Write the graph
+  // in the raw format, which is readable by previous versions, or in the
+  // compressed format.
   void Read(const std::string& path);
-  void Write(const std::string& path) const;
+  void Write(const std::string& path, bool compress = false) const;
 
  private:
-  void InitializeMap(size_t width, size_t height);
+  void InitializeMasks(size_t width,
+                       size_t height,
+                       const std::vector<int>& data);
 
-  const static int kNoConsistentImageIds;
-  std::vector<int> data_;
-  Eigen::MatrixXi map_;
+  size_t width_ = 0;
+  size_t height_ = 0;
+  std::vector<int> image_idxs_;
+  Mat<uint64_t> image_masks_;
 };
 
 }  // namespace mvs
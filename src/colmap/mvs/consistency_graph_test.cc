@@ -29,6 +29,8 @@
 
 #include "colmap/mvs/consistency_graph.h"
 
+#include "colmap/util/testing.h"
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -38,62 +40,124 @@ namespace {
 TEST(ConsistencyGraph, Empty) {
   const std::vector<int> data;
   ConsistencyGraph consistency_graph(2, 2, data);
-  for (size_t i = 0; i < 2; ++i) {
-    for (size_t j = 0; j < 2; ++j) {
-      int num_images;
-      const int* image_idxs;
-      consistency_graph.GetImageIdxs(0, 0, &num_images, &image_idxs);
-      EXPECT_EQ(num_images, 0);
-      EXPECT_TRUE(image_idxs == nullptr);
+  EXPECT_EQ(consistency_graph.GetWidth(), 2);
+  EXPECT_EQ(consistency_graph.GetHeight(), 2);
+  EXPECT_TRUE(consistency_graph.GetAllImageIdxs().empty());
+  std::vector<int> image_idxs;
+  for (int row = 0; row < 2; ++row) {
+    for (int col = 0; col < 2; ++col) {
+      consistency_graph.GetImageIdxs(row, col, &image_idxs);
+      EXPECT_TRUE(image_idxs.empty());
+      EXPECT_EQ(consistency_graph.GetNumImages(row, col), 0);
+      EXPECT_FALSE(consistency_graph.IsConsistent(row, col, 0));
     }
   }
-  EXPECT_EQ(consistency_graph.GetNumBytes(), 16);
+  EXPECT_EQ(consistency_graph.GetNumBytes(), 0);
 }
 
 TEST(ConsistencyGraph, Partial) {
   const std::vector<int> data = {0, 0, 3, 5, 7, 33};
   ConsistencyGraph consistency_graph(2, 1, data);
-  int num_images;
-  const int* image_idxs;
-  consistency_graph.GetImageIdxs(0, 0, &num_images, &image_idxs);
-  EXPECT_EQ(num_images, 3);
-  EXPECT_EQ(image_idxs[0], 5);
-  EXPECT_EQ(image_idxs[1], 7);
-  EXPECT_EQ(image_idxs[2], 33);
-  consistency_graph.GetImageIdxs(0, 1, &num_images, &image_idxs);
-  EXPECT_EQ(num_images, 0);
-  EXPECT_TRUE(image_idxs == nullptr);
-  EXPECT_EQ(consistency_graph.GetNumBytes(), 32);
+  EXPECT_EQ(consistency_graph.GetAllImageIdxs(), std::vector<int>({5, 7, 33}));
+  std::vector<int> image_idxs;
+  consistency_graph.GetImageIdxs(0, 0, &image_idxs);
+  EXPECT_EQ(image_idxs, std::vector<int>({5, 7, 33}));
+  EXPECT_EQ(consistency_graph.GetNumImages(0, 0), 3);
+  EXPECT_TRUE(consistency_graph.IsConsistent(0, 0, 7));
+  EXPECT_FALSE(consistency_graph.IsConsistent(0, 0, 6));
+  consistency_graph.GetImageIdxs(0, 1, &image_idxs);
+  EXPECT_TRUE(image_idxs.empty());
+  EXPECT_EQ(consistency_graph.GetNumImages(0, 1), 0);
+  EXPECT_FALSE(consistency_graph.IsConsistent(0, 1, 7));
+  EXPECT_EQ(consistency_graph.GetNumBytes(), 28);
 }
 
 TEST(ConsistencyGraph, Zero) {
   const std::vector<int> data = {0, 0, 0};
   ConsistencyGraph consistency_graph(2, 1, data);
-  int num_images;
-  const int* image_idxs;
-  consistency_graph.GetImageIdxs(0, 0, &num_images, &image_idxs);
-  EXPECT_EQ(num_images, 0);
-  EXPECT_TRUE(image_idxs == nullptr);
-  consistency_graph.GetImageIdxs(0, 1, &num_images, &image_idxs);
-  EXPECT_EQ(num_images, 0);
-  EXPECT_TRUE(image_idxs == nullptr);
-  EXPECT_EQ(consistency_graph.GetNumBytes(), 20);
+  std::vector<int> image_idxs;
+  consistency_graph.GetImageIdxs(0, 0, &image_idxs);
+  EXPECT_TRUE(image_idxs.empty());
+  consistency_graph.GetImageIdxs(0, 1, &image_idxs);
+  EXPECT_TRUE(image_idxs.empty());
+  EXPECT_EQ(consistency_graph.GetNumBytes(), 0);
 }
 
 TEST(ConsistencyGraph, Full) {
   const std::vector<int> data = {0, 0, 3, 5, 7, 33, 0, 1, 1, 100};
   ConsistencyGraph consistency_graph(1, 2, data);
-  int num_images;
-  const int* image_idxs;
-  consistency_graph.GetImageIdxs(0, 0, &num_images, &image_idxs);
-  EXPECT_EQ(num_images, 3);
-  EXPECT_EQ(image_idxs[0], 5);
-  EXPECT_EQ(image_idxs[1], 7);
-  EXPECT_EQ(image_idxs[2], 33);
-  consistency_graph.GetImageIdxs(1, 0, &num_images, &image_idxs);
-  EXPECT_EQ(num_images, 1);
-  EXPECT_EQ(image_idxs[0], 100);
-  EXPECT_EQ(consistency_graph.GetNumBytes(), 48);
+  std::vector<int> image_idxs;
+  consistency_graph.GetImageIdxs(0, 0, &image_idxs);
+  EXPECT_EQ(image_idxs, std::vector<int>({5, 7, 33}));
+  consistency_graph.GetImageIdxs(1, 0, &image_idxs);
+  EXPECT_EQ(image_idxs, std::vector<int>({100}));
+  EXPECT_FALSE(consistency_graph.IsConsistent(1, 0, 5));
+  EXPECT_TRUE(consistency_graph.IsConsistent(1, 0, 100));
+  EXPECT_EQ(consistency_graph.GetNumBytes(), 32);
+}
+
+TEST(ConsistencyGraph, ManyImages) {
+  std::vector<int> data = {1, 0, 70};
+  for (int i = 0; i < 70; ++i) {
+    data.push_back(2 * i);
+  }
+  data.insert(data.end(), {0, 1, 2, 3, 138});
+  ConsistencyGraph consistency_graph(2, 2, data);
+  EXPECT_EQ(consistency_graph.GetAllImageIdxs().size(), 71);
+  EXPECT_EQ(consistency_graph.GetImageMasks().GetDepth(), 2);
+  std::vector<int> image_idxs;
+  consistency_graph.GetImageIdxs(0, 1, &image_idxs);
+  EXPECT_EQ(image_idxs, std::vector<int>(data.begin() + 3, data.end() - 5));
+  EXPECT_EQ(consistency_graph.GetNumImages(0, 1), 70);
+  consistency_graph.GetImageIdxs(1, 0, &image_idxs);
+  EXPECT_EQ(image_idxs, std::vector<int>({3, 138}));
+  EXPECT_TRUE(consistency_graph.IsConsistent(1, 0, 138));
+  EXPECT_FALSE(consistency_graph.IsConsistent(1, 0, 136));
+}
+
+void ExpectEqualConsistencyGraphs(const ConsistencyGraph& graph1,
+                                  const ConsistencyGraph& graph2) {
+  EXPECT_EQ(graph1.GetWidth(), graph2.GetWidth());
+  EXPECT_EQ(graph1.GetHeight(), graph2.GetHeight());
+  EXPECT_EQ(graph1.GetAllImageIdxs(), graph2.GetAllImageIdxs());
+  EXPECT_EQ(graph1.GetImageMasks().GetDepth(),
+            graph2.GetImageMasks().GetDepth());
+  EXPECT_EQ(graph1.GetImageMasks().GetData(),
+            graph2.GetImageMasks().GetData());
+}
+
+TEST(ConsistencyGraph, WriteRead) {
+  std::vector<int> data;
+  for (int row = 0; row < 8; ++row) {
+    for (int col = 0; col < 10; ++col) {
+      if ((row + col) % 3 != 0) {
+        data.insert(data.end(), {col, row, 2, col, 80 + row});
+      }
+    }
+  }
+  const ConsistencyGraph consistency_graph(10, 8, data);
+  const std::string path = CreateTestDir() + "/consistency_graph.bin";
+  ConsistencyGraph read_consistency_graph;
+
+  consistency_graph.Write(path, /*compress=*/true);
+  read_consistency_graph.Read(path);
+  ExpectEqualConsistencyGraphs(read_consistency_graph, consistency_graph);
+
+  // The raw format of previous versions can still be read.
+  consistency_graph.Write(path);
+  read_consistency_graph.Read(path);
+  ExpectEqualConsistencyGraphs(read_consistency_graph, consistency_graph);
+}
+
+TEST(ConsistencyGraph, WriteReadEmpty) {
+  const ConsistencyGraph consistency_graph(3, 2, {});
+  const std::string path = CreateTestDir() + "/consistency_graph.bin";
+  ConsistencyGraph read_consistency_graph;
+  for (const bool compress : {false, true}) {
+    consistency_graph.Write(path, compress);
+    read_consistency_graph.Read(path);
+    ExpectEqualConsistencyGraphs(read_consistency_graph, consistency_graph);
+  }
 }
 
 }  // namespace
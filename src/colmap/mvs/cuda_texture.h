@@ -52,7 +52,17 @@ class CudaArrayLayeredTexture {
       const size_t depth,
       const T* data);
 
+  // Overwrite the contents of the texture without reallocating the array.
+  // The dimensions of the given data must match the texture dimensions.
+  void CopyFromGpuMat(const GpuMat<T>& mat);
+  void CopyFromHostArray(const T* data);
+
+  // Overwrite the top-left region of a single layer with the first slice of
+  // the given matrix, which must not be larger than the texture.
+  void CopyLayerFromGpuMat(size_t layer, const GpuMat<T>& mat);
+
   cudaTextureObject_t GetObj() const;
+  const cudaTextureDesc& GetTextureDesc() const;
 
   size_t GetWidth() const;
   size_t GetHeight() const;
@@ -90,17 +100,7 @@ CudaArrayLayeredTexture<T>::FromGpuMat(const cudaTextureDesc& texture_desc,
                                        const GpuMat<T>& mat) {
   auto array = std::make_unique<CudaArrayLayeredTexture<T>>(
       texture_desc, mat.GetWidth(), mat.GetHeight(), mat.GetDepth());
-
-  cudaMemcpy3DParms params;
-  memset(&params, 0, sizeof(params));
-  params.extent =
-      make_cudaExtent(mat.GetWidth(), mat.GetHeight(), mat.GetDepth());
-  params.kind = cudaMemcpyDeviceToDevice;
-  params.srcPtr = make_cudaPitchedPtr(
-      (void*)mat.GetPtr(), mat.GetPitch(), mat.GetWidth(), mat.GetHeight());
-  params.dstArray = array->array_;
-  CUDA_SAFE_CALL(cudaMemcpy3D(&params));
-
+  array->CopyFromGpuMat(mat);
   return array;
 }
 
@@ -113,16 +113,7 @@ CudaArrayLayeredTexture<T>::FromHostArray(const cudaTextureDesc& texture_desc,
                                           const T* data) {
   auto array = std::make_unique<CudaArrayLayeredTexture<T>>(
       texture_desc, width, height, depth);
-
-  cudaMemcpy3DParms params;
-  memset(&params, 0, sizeof(params));
-  params.extent = make_cudaExtent(width, height, depth);
-  params.kind = cudaMemcpyHostToDevice;
-  params.srcPtr =
-      make_cudaPitchedPtr((void*)data, width * sizeof(T), width, height);
-  params.dstArray = array->array_;
-  CUDA_SAFE_CALL(cudaMemcpy3D(&params));
-
+  array->CopyFromHostArray(data);
   return array;
 }
 
@@ -158,11 +149,62 @@ CudaArrayLayeredTexture<T>::~CudaArrayLayeredTexture() {
   CUDA_SAFE_CALL(cudaDestroyTextureObject(texture_));
 }
 
+template <typename T>
+void CudaArrayLayeredTexture<T>::CopyFromGpuMat(const GpuMat<T>& mat) {
+  THROW_CHECK_EQ(mat.GetWidth(), width_);
+  THROW_CHECK_EQ(mat.GetHeight(), height_);
+  THROW_CHECK_EQ(mat.GetDepth(), depth_);
+
+  cudaMemcpy3DParms params;
+  memset(&params, 0, sizeof(params));
+  params.extent = make_cudaExtent(width_, height_, depth_);
+  params.kind = cudaMemcpyDeviceToDevice;
+  params.srcPtr = make_cudaPitchedPtr(
+      (void*)mat.GetPtr(), mat.GetPitch(), mat.GetWidth(), mat.GetHeight());
+  params.dstArray = array_;
+  CUDA_SAFE_CALL(cudaMemcpy3D(&params));
+}
+
+template <typename T>
+void CudaArrayLayeredTexture<T>::CopyLayerFromGpuMat(const size_t layer,
+                                                     const GpuMat<T>& mat) {
+  THROW_CHECK_LT(layer, depth_);
+  THROW_CHECK_LE(mat.GetWidth(), width_);
+  THROW_CHECK_LE(mat.GetHeight(), height_);
+
+  cudaMemcpy3DParms params;
+  memset(&params, 0, sizeof(params));
+  params.extent = make_cudaExtent(mat.GetWidth(), mat.GetHeight(), 1);
+  params.kind = cudaMemcpyDeviceToDevice;
+  params.srcPtr = make_cudaPitchedPtr(
+      (void*)mat.GetPtr(), mat.GetPitch(), mat.GetWidth(), mat.GetHeight());
+  params.dstArray = array_;
+  params.dstPos = make_cudaPos(0, 0, layer);
+  CUDA_SAFE_CALL(cudaMemcpy3D(&params));
+}
+
+template <typename T>
+void CudaArrayLayeredTexture<T>::CopyFromHostArray(const T* data) {
+  cudaMemcpy3DParms params;
+  memset(&params, 0, sizeof(params));
+  params.extent = make_cudaExtent(width_, height_, depth_);
+  params.kind = cudaMemcpyHostToDevice;
+  params.srcPtr =
+      make_cudaPitchedPtr((void*)data, width_ * sizeof(T), width_, height_);
+  params.dstArray = array_;
+  CUDA_SAFE_CALL(cudaMemcpy3D(&params));
+}
+
 template <typename T>
 cudaTextureObject_t CudaArrayLayeredTexture<T>::GetObj() const {
   return texture_;
 }
 
+template <typename T>
+const cudaTextureDesc& CudaArrayLayeredTexture<T>::GetTextureDesc() const {
+  return texture_desc_;
+}
+
 template <typename T>
 size_t CudaArrayLayeredTexture<T>::GetWidth() const {
   return width_;
@@ -31,6 +31,10 @@
 
 #include "colmap/image/warp.h"
 #include "colmap/math/math.h"
+#include "colmap/mvs/map_compression.h"
+
+#include <fstream>
+#include <limits>
 
 namespace colmap {
 namespace mvs {
@@ -82,6 +86,78 @@ void DepthMap::Downsize(const size_t max_width, const size_t max_height) {
   Rescale(std::min(factor_x, factor_y));
 }
 
+void DepthMap::Read(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+  if (!ReadCompressedMapHeader(&file, &width_, &height_, &depth_)) {
+    file.close();
+    Mat<float>::Read(path);
+    return;
+  }
+
+  THROW_CHECK_GT(width_, 0) << path;
+  THROW_CHECK_GT(height_, 0) << path;
+  THROW_CHECK_EQ(depth_, 1) << path;
+
+  const float inv_depth_min = ReadBinaryLittleEndian<float>(&file);
+  const float inv_depth_max = ReadBinaryLittleEndian<float>(&file);
+  std::vector<uint16_t> values(width_ * height_);
+  ReadCompressedMapValues(&file, &values);
+  file.close();
+
+  const float inv_depth_scale = (inv_depth_max - inv_depth_min) / 65534;
+  data_.resize(values.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (values[i] == 0) {
+      data_[i] = 0;
+    } else {
+      data_[i] = 1 / (inv_depth_min + (values[i] - 1) * inv_depth_scale);
+    }
+  }
+}
+
+void DepthMap::Write(const std::string& path, const bool compress) const {
+  if (!compress) {
+    Mat<float>::Write(path);
+    return;
+  }
+
+  // Quantize the inverse depths, such that the quantization error is
+  // proportional to the depth, and reserve zero for invalid pixels.
+  float inv_depth_min = std::numeric_limits<float>::max();
+  float inv_depth_max = 0;
+  for (const float depth : data_) {
+    if (depth > 0) {
+      inv_depth_min = std::min(inv_depth_min, 1 / depth);
+      inv_depth_max = std::max(inv_depth_max, 1 / depth);
+    }
+  }
+  if (inv_depth_max == 0) {
+    inv_depth_min = 0;
+  }
+
+  const float inv_depth_range = inv_depth_max - inv_depth_min;
+  std::vector<uint16_t> values(data_.size(), 0);
+  for (size_t i = 0; i < data_.size(); ++i) {
+    if (data_[i] > 0) {
+      const float normalized_inv_depth =
+          inv_depth_range > 0
+              ? (1 / data_[i] - inv_depth_min) / inv_depth_range
+              : 0.0f;
+      values[i] =
+          1 + static_cast<uint16_t>(std::round(normalized_inv_depth * 65534));
+    }
+  }
+
+  std::ofstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+  WriteCompressedMapHeader(width_, height_, depth_, &file);
+  WriteBinaryLittleEndian<float>(&file, inv_depth_min);
+  WriteBinaryLittleEndian<float>(&file, inv_depth_max);
+  WriteCompressedMapValues(values, &file);
+  file.close();
+}
+
 Bitmap DepthMap::ToBitmap(const float min_percentile,
                           const float max_percentile) const {
   THROW_CHECK_GT(width_, 0);
@@ -108,8 +184,9 @@ Bitmap DepthMap::ToBitmap(const float min_percentile,
 
   const float robust_depth_range = robust_depth_max - robust_depth_min;
   for (size_t y = 0; y < height_; ++y) {
+    const float* depth_row = GetRowPtr(y);
     for (size_t x = 0; x < width_; ++x) {
-      const float depth = Get(y, x);
+      const float depth = depth_row[x];
       if (depth > 0) {
         const float robust_depth =
             std::max(robust_depth_min, std::min(robust_depth_max, depth));
@@ -52,6 +52,12 @@ class DepthMap : public Mat<float> {
   void Rescale(float factor);
   void Downsize(size_t max_width, size_t max_height);
 
+  // Read the depth map in the raw or compressed format. Write the depth map in
+  // the raw format or, if enabled, in the compressed format, which quantizes
+  // the inverse depths of valid pixels to 16 bits within their range.
+  void Read(const std::string& path);
+  void Write(const std::string& path, bool compress = false) const;
+
   Bitmap ToBitmap(float min_percentile, float max_percentile) const;
 
  private:
@@ -29,6 +29,8 @@
 
 #include "colmap/mvs/depth_map.h"
 
+#include "colmap/util/testing.h"
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -93,6 +95,36 @@ TEST(DepthMap, ToBitmap) {
   EXPECT_EQ(color, BitmapColor<uint8_t>(128, 0, 0));
 }
 
+TEST(DepthMap, WriteReadCompressed) {
+  DepthMap depth_map(4, 3, 1, 10);
+  for (size_t row = 0; row < depth_map.GetHeight(); ++row) {
+    for (size_t col = 0; col < depth_map.GetWidth(); ++col) {
+      depth_map.Set(row, col, 1 + row * depth_map.GetWidth() + col * 0.5f);
+    }
+  }
+  depth_map.Set(1, 2, 0);
+
+  const std::string path = CreateTestDir() + "/depth_map.bin";
+  depth_map.Write(path, /*compress=*/true);
+  DepthMap read_depth_map;
+  read_depth_map.Read(path);
+  EXPECT_EQ(read_depth_map.GetWidth(), depth_map.GetWidth());
+  EXPECT_EQ(read_depth_map.GetHeight(), depth_map.GetHeight());
+  EXPECT_EQ(read_depth_map.GetDepth(), 1);
+  for (size_t row = 0; row < depth_map.GetHeight(); ++row) {
+    for (size_t col = 0; col < depth_map.GetWidth(); ++col) {
+      const float depth = depth_map.Get(row, col);
+      EXPECT_NEAR(read_depth_map.Get(row, col), depth, 1e-4 * depth);
+    }
+  }
+  EXPECT_EQ(read_depth_map.Get(1, 2), 0);
+
+  // The raw format can still be read.
+  depth_map.Write(path);
+  read_depth_map.Read(path);
+  EXPECT_EQ(read_depth_map.GetData(), depth_map.GetData());
+}
+
 }  // namespace
 }  // namespace mvs
 }  // namespace colmap
@@ -29,13 +29,24 @@
 
 #include "colmap/mvs/fusion.h"
 
+#include "colmap/mvs/consistency_graph.h"
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/profiler.h"
 #include "colmap/util/threading.h"
 #include "colmap/util/timer.h"
 
+#include <cstdio>
+#include <fstream>
+#include <utility>
+
 #include <Eigen/Geometry>
 
+#if defined(COLMAP_CUDA_ENABLED)
+#include "colmap/mvs/fusion_cuda.h"
+#include "colmap/util/cuda.h"
+#endif  // COLMAP_CUDA_ENABLED
+
 namespace colmap {
 namespace mvs {
 namespace internal {
@@ -81,6 +92,60 @@ int FindNextImage(const std::vector<std::vector<int>>& overlapping_images,
   return -1;
 }
 
+// Starting from the given image, greedily collect not yet fused images whose
+// neighborhoods, i.e., the image and its overlapping not yet fused images, are
+// pairwise disjoint, such that they can be fused concurrently.
+std::vector<int> FindConcurrentImages(
+    const std::vector<std::vector<int>>& overlapping_images,
+    const std::vector<char>& used_images,
+    const std::vector<char>& fused_images,
+    const int image_idx,
+    const int max_num_images) {
+  THROW_CHECK_EQ(used_images.size(), fused_images.size());
+
+  std::vector<int> image_idxs = {image_idx};
+  if (max_num_images <= 1) {
+    return image_idxs;
+  }
+
+  std::vector<char> claimed_images(used_images.size(), false);
+  auto ForEachNeighbor = [&](const int center_image_idx, const auto& func) {
+    func(center_image_idx);
+    for (const auto overlapping_image_idx :
+         overlapping_images.at(center_image_idx)) {
+      if (used_images.at(overlapping_image_idx) &&
+          !fused_images.at(overlapping_image_idx)) {
+        func(overlapping_image_idx);
+      }
+    }
+  };
+
+  ForEachNeighbor(image_idx,
+                  [&](const int idx) { claimed_images[idx] = true; });
+
+  for (size_t candidate_image_idx = 0;
+       candidate_image_idx < used_images.size() &&
+       image_idxs.size() < static_cast<size_t>(max_num_images);
+       ++candidate_image_idx) {
+    if (!used_images[candidate_image_idx] ||
+        fused_images[candidate_image_idx] ||
+        claimed_images[candidate_image_idx]) {
+      continue;
+    }
+    bool is_disjoint = true;
+    ForEachNeighbor(candidate_image_idx, [&](const int idx) {
+      is_disjoint = is_disjoint && !claimed_images[idx];
+    });
+    if (is_disjoint) {
+      ForEachNeighbor(candidate_image_idx,
+                      [&](const int idx) { claimed_images[idx] = true; });
+      image_idxs.push_back(candidate_image_idx);
+    }
+  }
+
+  return image_idxs;
+}
+
 }  // namespace internal
 
 void StereoFusionOptions::Print() const {
@@ -97,6 +162,11 @@ void StereoFusionOptions::Print() const {
   PrintOption(check_num_images);
   PrintOption(use_cache);
   PrintOption(cache_size);
+  PrintOption(out_of_core_path);
+  PrintOption(use_gpu);
+  PrintOption(gpu_index);
+  PrintOption(use_consistency_graph);
+  PrintOption(max_num_concurrent_images);
   const auto& bbox_min = bounding_box.first.transpose().eval();
   const auto& bbox_max = bounding_box.second.transpose().eval();
   PrintOption(bbox_min);
@@ -113,6 +183,8 @@ bool StereoFusionOptions::Check() const {
   CHECK_OPTION_GE(max_normal_error, 0);
   CHECK_OPTION_GT(check_num_images, 0);
   CHECK_OPTION_GT(cache_size, 0);
+  CHECK_OPTION_GE(gpu_index, -1);
+  CHECK_OPTION_GT(max_num_concurrent_images, 0);
   return true;
 }
 
@@ -132,6 +204,8 @@ StereoFusion::StereoFusion(const StereoFusionOptions& options,
   THROW_CHECK(options_.Check());
 }
 
+StereoFusion::~StereoFusion() = default;
+
 const std::vector<PlyPoint>& StereoFusion::GetFusedPoints() const {
   return fused_points_;
 }
@@ -141,15 +215,40 @@ const std::vector<std::vector<int>>& StereoFusion::GetFusedPointsVisibility()
   return fused_points_visibility_;
 }
 
+size_t StereoFusion::NumFusedPoints() const {
+  return IsOutOfCore() ? num_spilled_points_ : fused_points_.size();
+}
+
+void StereoFusion::WriteFusedPoints(const std::string& path) const {
+  if (!IsOutOfCore() || !ExistsFile(GetSpilledPointsPath())) {
+    WriteBinaryPlyPoints(path, fused_points_);
+    WritePointsVisibility(path + ".vis", fused_points_visibility_);
+    return;
+  }
+
+  THROW_CHECK(!spilled_points_writer_) << "Fusion is still running";
+  FileCopy(GetSpilledPointsPath(), path);
+  FileCopy(GetSpilledPointsVisibilityPath(), path + ".vis");
+}
+
 void StereoFusion::Run() {
   Timer run_timer;
   run_timer.Start();
 
   fused_points_.clear();
   fused_points_visibility_.clear();
+  num_spilled_points_ = 0;
 
   options_.Print();
 
+  if (IsOutOfCore()) {
+    CreateDirIfNotExists(options_.out_of_core_path, /*recursive=*/true);
+    // Remove the spill files of any previous run.
+    CloseSpillWriters();
+    std::remove(GetSpilledPointsPath().c_str());
+    std::remove(GetSpilledPointsVisibilityPath().c_str());
+  }
+
   LOG(INFO) << "Reading workspace...";
 
   Workspace::Options workspace_options;
@@ -199,10 +298,17 @@ void StereoFusion::Run() {
 
   task_fused_points_.resize(num_threads);
   task_fused_points_visibility_.resize(num_threads);
+  task_num_visited_pixels_.assign(num_threads, 0);
 
   used_images_.resize(model.images.size(), false);
   fused_images_.resize(model.images.size(), false);
+  active_images_.resize(model.images.size(), false);
+  spilled_fused_pixel_masks_.resize(model.images.size(), false);
   fused_pixel_masks_.resize(model.images.size());
+  num_masked_pixels_.resize(model.images.size(), 0);
+  if (options_.max_num_concurrent_images > 1) {
+    neighborhood_owners_.resize(model.images.size(), -1);
+  }
   depth_map_sizes_.resize(model.images.size());
   bitmap_scales_.resize(model.images.size());
   P_.resize(model.images.size());
@@ -226,7 +332,13 @@ void StereoFusion::Run() {
 
     used_images_.at(image_idx) = true;
 
-    InitFusedPixelMask(image_idx, depth_map.GetWidth(), depth_map.GetHeight());
+    // In out-of-core mode, the masks are initialized once the image enters
+    // the active neighborhood.
+    if (!IsOutOfCore()) {
+      active_images_.at(image_idx) = true;
+      InitFusedPixelMask(
+          image_idx, depth_map.GetWidth(), depth_map.GetHeight());
+    }
 
     depth_map_sizes_.at(image_idx) =
         std::make_pair(depth_map.GetWidth(), depth_map.GetHeight());
@@ -253,32 +365,83 @@ void StereoFusion::Run() {
             .transpose();
   }
 
+#if defined(COLMAP_CUDA_ENABLED)
+  fusion_cuda_.reset();
+  if (options_.use_gpu) {
+    SetBestCudaDevice(options_.gpu_index);
+    fusion_cuda_ = std::make_unique<StereoFusionCuda>(
+        options_.max_reproj_error,
+        options_.max_depth_error,
+        options_.max_normal_error);
+  }
+#endif  // COLMAP_CUDA_ENABLED
+
   LOG(INFO) << StringPrintf("Starting fusion with %d threads", num_threads);
   ThreadPool thread_pool(num_threads);
 
   // Using a row stride of 10 to avoid starting parallel processing in rows that
   // are too close to each other which may lead to duplicated work, since nearby
-  // pixels are likely to get fused into the same point.
+  // pixels are likely to get fused into the same point. If the consistent
+  // images were computed on the GPU or read from the consistency graph, the
+  // traversal of each pixel is restricted to its consistent images.
   const int kRowStride = 10;
-  auto ProcessImageRows = [&, this](const int row_start,
-                                    const int height,
-                                    const int width,
-                                    const int image_idx,
-                                    const Mat<char>& fused_pixel_mask) {
-    const int row_end = std::min(height, row_start + kRowStride);
-    for (int row = row_start; row < row_end; ++row) {
-      for (int col = 0; col < width; ++col) {
-        if (fused_pixel_mask.Get(row, col) > 0) {
-          continue;
+  auto ProcessImageRows =
+      [&, this](const int row_start,
+                const int height,
+                const int width,
+                const int image_idx,
+                const Mat<char>& fused_pixel_mask,
+                const Mat<uint64_t>* consistent_images,
+                const std::vector<int>* consistent_image_idxs) {
+        COLMAP_PROFILE_ZONE("StereoFusion::Fuse");
+        const int row_end = std::min(height, row_start + kRowStride);
+        std::vector<int> next_image_idxs;
+        for (int row = row_start; row < row_end; ++row) {
+          const char* fused_pixel_mask_row = fused_pixel_mask.GetRowPtr(row);
+          for (int col = 0; col < width; ++col) {
+            if (fused_pixel_mask_row[col] > 0) {
+              continue;
+            }
+            const int thread_id = thread_pool.GetThreadIndex();
+            if (consistent_images == nullptr) {
+              Fuse(thread_id, image_idx, row, col);
+              continue;
+            }
+            next_image_idxs.clear();
+            for (size_t slice = 0; slice < consistent_images->GetDepth();
+                 ++slice) {
+              uint64_t consistent_mask =
+                  consistent_images->GetRef(row, col, slice);
+              for (size_t i = slice * 64; consistent_mask != 0;
+                   ++i, consistent_mask >>= 1) {
+                if (consistent_mask & 1) {
+                  next_image_idxs.push_back(consistent_image_idxs->at(i));
+                }
+              }
+            }
+            // Skip pixels that cannot yield a point. They remain unfused and
+            // can still be fused from another reference image.
+            if (next_image_idxs.size() + 1 <
+                static_cast<size_t>(options_.min_num_pixels)) {
+              continue;
+            }
+            Fuse(thread_id, image_idx, row, col, &next_image_idxs);
+          }
         }
-        const int thread_id = thread_pool.GetThreadIndex();
-        Fuse(thread_id, image_idx, row, col);
-      }
-    }
-  };
+      };
+
+  if (IsOutOfCore()) {
+    spilled_points_writer_ =
+        std::make_unique<BinaryPlyPointsWriter>(GetSpilledPointsPath());
+    spilled_points_visibility_writer_ =
+        std::make_unique<PointsVisibilityWriter>(
+            GetSpilledPointsVisibilityPath());
+  }
 
   size_t num_fused_images = 0;
   size_t total_fused_points = 0;
+  GetMetrics().SetGauge("num_images", model.images.size());
+  size_t num_unique_visited_pixels = 0;
   for (int image_idx = 0; image_idx >= 0;
        image_idx = internal::FindNextImage(
            overlapping_images_, used_images_, fused_images_, image_idx)) {
@@ -289,35 +452,127 @@ void StereoFusion::Run() {
     Timer timer;
     timer.Start();
 
-    LOG(INFO) << StringPrintf("Fusing image [%d/%d] with index %d",
+    const std::vector<int> batch_image_idxs =
+        internal::FindConcurrentImages(overlapping_images_,
+                                       used_images_,
+                                       fused_images_,
+                                       image_idx,
+                                       options_.max_num_concurrent_images);
+
+    LOG(INFO) << StringPrintf("Fusing image [%d/%d] with index %s",
                               num_fused_images + 1,
                               model.images.size(),
-                              image_idx)
+                              VectorToCSV(batch_image_idxs).c_str())
               << std::flush;
 
-    const int width = depth_map_sizes_.at(image_idx).first;
-    const int height = depth_map_sizes_.at(image_idx).second;
-    const auto& fused_pixel_mask = fused_pixel_masks_.at(image_idx);
+    if (IsOutOfCore()) {
+      ActivateNeighborhoods(batch_image_idxs);
+    }
+
+    if (!neighborhood_owners_.empty()) {
+      std::fill(neighborhood_owners_.begin(), neighborhood_owners_.end(), -1);
+      for (const int batch_image_idx : batch_image_idxs) {
+        neighborhood_owners_.at(batch_image_idx) = batch_image_idx;
+        for (const auto overlapping_image_idx :
+             overlapping_images_.at(batch_image_idx)) {
+          if (used_images_.at(overlapping_image_idx) &&
+              !fused_images_.at(overlapping_image_idx)) {
+            neighborhood_owners_.at(overlapping_image_idx) = batch_image_idx;
+          }
+        }
+      }
+    }
 
-    for (int row_start = 0; row_start < height; row_start += kRowStride) {
-      thread_pool.AddTask(ProcessImageRows,
-                          row_start,
-                          height,
-                          width,
-                          image_idx,
-                          fused_pixel_mask);
+    std::vector<Mat<uint64_t>> consistent_images(batch_image_idxs.size());
+    std::vector<std::vector<int>> consistent_image_idxs(
+        batch_image_idxs.size());
+    std::vector<char> has_consistent_images(batch_image_idxs.size(), false);
+#if defined(COLMAP_CUDA_ENABLED)
+    if (fusion_cuda_) {
+      for (size_t i = 0; i < batch_image_idxs.size(); ++i) {
+        consistent_image_idxs[i] =
+            ComputeConsistentImages(batch_image_idxs[i], &consistent_images[i]);
+        has_consistent_images[i] = true;
+      }
+    }
+#endif  // COLMAP_CUDA_ENABLED
+    if (options_.use_consistency_graph) {
+      for (size_t i = 0; i < batch_image_idxs.size(); ++i) {
+        if (!has_consistent_images[i]) {
+          has_consistent_images[i] =
+              ReadConsistentImages(batch_image_idxs[i],
+                                   &consistent_images[i],
+                                   &consistent_image_idxs[i]);
+        }
+      }
     }
-    thread_pool.Wait();
 
-    num_fused_images += 1;
-    fused_images_.at(image_idx) = true;
+    // The neighborhoods of the images are disjoint, so the rows of all images
+    // can be fused concurrently.
+    std::vector<std::pair<size_t, int>> row_starts;
+    for (size_t i = 0; i < batch_image_idxs.size(); ++i) {
+      const int height = depth_map_sizes_.at(batch_image_idxs[i]).second;
+      for (int row_start = 0; row_start < height; row_start += kRowStride) {
+        row_starts.emplace_back(i, row_start);
+      }
+    }
+    thread_pool.ParallelFor(
+        0, row_starts.size(), /*grain_size=*/1, [&](const int64_t idx) {
+          const size_t i = row_starts[idx].first;
+          const int batch_image_idx = batch_image_idxs[i];
+          ProcessImageRows(
+              row_starts[idx].second,
+              depth_map_sizes_.at(batch_image_idx).second,
+              depth_map_sizes_.at(batch_image_idx).first,
+              batch_image_idx,
+              fused_pixel_masks_.at(batch_image_idx),
+              has_consistent_images[i] ? &consistent_images[i] : nullptr,
+              has_consistent_images[i] ? &consistent_image_idxs[i] : nullptr);
+        });
+
+    for (const int batch_image_idx : batch_image_idxs) {
+      num_fused_images += 1;
+      fused_images_.at(batch_image_idx) = true;
+
+      // The traversal never enters fused images, so their masks are obsolete.
+      auto& fused_pixel_mask = fused_pixel_masks_.at(batch_image_idx);
+      num_unique_visited_pixels +=
+          std::count_if(fused_pixel_mask.GetData().begin(),
+                        fused_pixel_mask.GetData().end(),
+                        [](const char value) { return value > 0; }) -
+          num_masked_pixels_.at(batch_image_idx);
+      fused_pixel_mask = Mat<char>();
+    }
 
-    total_fused_points = 0;
-    for (const auto& task_fused_points : task_fused_points_) {
-      total_fused_points += task_fused_points.size();
+    if (IsOutOfCore()) {
+      SpillFusedPoints();
+      total_fused_points = num_spilled_points_;
+    } else {
+      total_fused_points = 0;
+      for (const auto& task_fused_points : task_fused_points_) {
+        total_fused_points += task_fused_points.size();
+      }
     }
     LOG(INFO) << StringPrintf(
         " in %.3fs (%d points)", timer.ElapsedSeconds(), total_fused_points);
+
+    GetMetrics().SetGauge("num_fused_images", num_fused_images);
+    GetMetrics().SetGauge("num_fused_points", total_fused_points);
+  }
+
+  // Pixels are visited multiple times, if the traversals of multiple threads
+  // reach the same pixel before it is marked as fused.
+  size_t num_visited_pixels = 0;
+  for (const size_t task_num_visited_pixels : task_num_visited_pixels_) {
+    num_visited_pixels += task_num_visited_pixels;
+  }
+  if (num_visited_pixels > 0 &&
+      num_visited_pixels >= num_unique_visited_pixels) {
+    LOG(INFO) << StringPrintf(
+        "Duplicated work: %.2f%% of %d visited pixels",
+        100.0 * (num_visited_pixels - num_unique_visited_pixels) /
+            num_visited_pixels,
+        num_visited_pixels);
   }
 
   fused_points_.reserve(total_fused_points);
@@ -336,17 +591,118 @@ void StereoFusion::Run() {
     task_fused_points_visibility_[thread_id].clear();
   }
 
-  if (fused_points_.empty()) {
+  if (IsOutOfCore()) {
+    CloseSpillWriters();
+    for (size_t image_idx = 0; image_idx < spilled_fused_pixel_masks_.size();
+         ++image_idx) {
+      if (spilled_fused_pixel_masks_[image_idx]) {
+        std::remove(GetSpilledFusedPixelMaskPath(image_idx).c_str());
+        spilled_fused_pixel_masks_[image_idx] = false;
+      }
+    }
+  }
+
+#if defined(COLMAP_CUDA_ENABLED)
+  fusion_cuda_.reset();
+#endif  // COLMAP_CUDA_ENABLED
+
+  if (NumFusedPoints() == 0) {
     LOG(WARNING)
         << "Could not fuse any points. This is likely caused by "
            "incorrect settings - filtering must be enabled for the last "
            "call to patch match stereo.";
   }
 
-  LOG(INFO) << "Number of fused points: " << fused_points_.size();
+  LOG(INFO) << "Number of fused points: " << NumFusedPoints();
   run_timer.PrintMinutes();
 }
 
+bool StereoFusion::IsOutOfCore() const {
+  return !options_.out_of_core_path.empty();
+}
+
+std::string StereoFusion::GetSpilledPointsPath() const {
+  return JoinPaths(options_.out_of_core_path, "fused.ply");
+}
+
+std::string StereoFusion::GetSpilledPointsVisibilityPath() const {
+  return GetSpilledPointsPath() + ".vis";
+}
+
+std::string StereoFusion::GetSpilledFusedPixelMaskPath(
+    const int image_idx) const {
+  return JoinPaths(options_.out_of_core_path,
+                   StringPrintf("fused_pixel_mask_%d.bin", image_idx));
+}
+
+void StereoFusion::ActivateNeighborhoods(const std::vector<int>& image_idxs) {
+  std::vector<char> next_active_images(active_images_.size(), false);
+  for (const int image_idx : image_idxs) {
+    next_active_images.at(image_idx) = true;
+    for (const auto overlapping_image_idx :
+         overlapping_images_.at(image_idx)) {
+      if (used_images_.at(overlapping_image_idx) &&
+          !fused_images_.at(overlapping_image_idx)) {
+        next_active_images.at(overlapping_image_idx) = true;
+      }
+    }
+  }
+
+  for (size_t idx = 0; idx < active_images_.size(); ++idx) {
+    if (active_images_[idx] && !next_active_images[idx]) {
+      if (!fused_images_[idx]) {
+        fused_pixel_masks_[idx].Write(GetSpilledFusedPixelMaskPath(idx));
+        spilled_fused_pixel_masks_[idx] = true;
+      }
+      fused_pixel_masks_[idx] = Mat<char>();
+    } else if (!active_images_[idx] && next_active_images[idx]) {
+      if (spilled_fused_pixel_masks_[idx]) {
+        fused_pixel_masks_[idx].Read(GetSpilledFusedPixelMaskPath(idx));
+        std::remove(GetSpilledFusedPixelMaskPath(idx).c_str());
+        spilled_fused_pixel_masks_[idx] = false;
+      } else {
+        InitFusedPixelMask(idx,
+                           depth_map_sizes_.at(idx).first,
+                           depth_map_sizes_.at(idx).second);
+      }
+    }
+  }
+
+  active_images_ = std::move(next_active_images);
+}
+
+void StereoFusion::SpillFusedPoints() {
+  THROW_CHECK_NOTNULL(spilled_points_writer_);
+  THROW_CHECK_NOTNULL(spilled_points_visibility_writer_);
+
+  for (size_t thread_id = 0; thread_id < task_fused_points_.size();
+       ++thread_id) {
+    auto& task_fused_points = task_fused_points_[thread_id];
+    auto& task_fused_points_visibility =
+        task_fused_points_visibility_[thread_id];
+    spilled_points_writer_->Write(task_fused_points);
+    for (const auto& visibility : task_fused_points_visibility) {
+      spilled_points_visibility_writer_->Write(visibility);
+    }
+    num_spilled_points_ += task_fused_points.size();
+    task_fused_points.clear();
+    task_fused_points.shrink_to_fit();
+    task_fused_points_visibility.clear();
+    task_fused_points_visibility.shrink_to_fit();
+  }
+}
+
+void StereoFusion::CloseSpillWriters() {
+  if (spilled_points_writer_) {
+    spilled_points_writer_->Close();
+    spilled_points_writer_.reset();
+  }
+  if (spilled_points_visibility_writer_) {
+    spilled_points_visibility_writer_->Close();
+    spilled_points_visibility_writer_.reset();
+  }
+}
+
 void StereoFusion::InitFusedPixelMask(int image_idx,
                                       size_t width,
                                       size_t height) {
@@ -356,6 +712,7 @@ void StereoFusion::InitFusedPixelMask(int image_idx,
       JoinPaths(options_.mask_path,
                 workspace_->GetModel().GetImageName(image_idx) + ".png");
   fused_pixel_mask = Mat<char>(width, height, 1);
+  num_masked_pixels_.at(image_idx) = 0;
   if (!options_.mask_path.empty() && ExistsFile(mask_path) &&
       mask.Read(mask_path, false)) {
     BitmapColor<uint8_t> color;
@@ -365,7 +722,10 @@ void StereoFusion::InitFusedPixelMask(int image_idx,
     for (size_t row = 0; row < height; ++row) {
       for (size_t col = 0; col < width; ++col) {
         mask.GetPixel(col, row, &color);
-        fused_pixel_mask.Set(row, col, color.r == 0 ? 1 : 0);
+        fused_pixel_mask.GetRef(row, col) = color.r == 0 ? 1 : 0;
+        if (color.r == 0) {
+          num_masked_pixels_.at(image_idx) += 1;
+        }
       }
     }
   } else {
@@ -373,10 +733,91 @@ void StereoFusion::InitFusedPixelMask(int image_idx,
   }
 }
 
+bool StereoFusion::ReadConsistentImages(
+    const int image_idx,
+    Mat<uint64_t>* consistent_images,
+    std::vector<int>* consistent_image_idxs) {
+  if (!workspace_->HasConsistencyGraph(image_idx)) {
+    return false;
+  }
+
+  ConsistencyGraph consistency_graph;
+  consistency_graph.Read(workspace_->GetConsistencyGraphPath(image_idx));
+  const auto& depth_map_size = depth_map_sizes_.at(image_idx);
+  if (consistency_graph.GetWidth() !=
+          static_cast<size_t>(depth_map_size.first) ||
+      consistency_graph.GetHeight() !=
+          static_cast<size_t>(depth_map_size.second)) {
+    LOG(WARNING) << StringPrintf(
+        "Ignoring consistency graph of image %d, because its size differs "
+        "from the depth map.",
+        image_idx);
+    return false;
+  }
+
+  *consistent_images = consistency_graph.GetImageMasks();
+  *consistent_image_idxs = consistency_graph.GetAllImageIdxs();
+  return true;
+}
+
+#if defined(COLMAP_CUDA_ENABLED)
+std::vector<int> StereoFusion::ComputeConsistentImages(
+    const int image_idx, Mat<uint64_t>* consistent_images) {
+  std::vector<int> src_image_idxs;
+  size_t max_src_width = 0;
+  size_t max_src_height = 0;
+  for (const auto overlapping_image_idx : overlapping_images_.at(image_idx)) {
+    if (src_image_idxs.size() >=
+        static_cast<size_t>(StereoFusionCuda::kMaxNumSrcImages)) {
+      break;
+    }
+    if (!active_images_.at(overlapping_image_idx) ||
+        fused_images_.at(overlapping_image_idx) ||
+        (!neighborhood_owners_.empty() &&
+         neighborhood_owners_.at(overlapping_image_idx) != image_idx)) {
+      continue;
+    }
+    src_image_idxs.push_back(overlapping_image_idx);
+    const auto& depth_map_size = depth_map_sizes_.at(overlapping_image_idx);
+    max_src_width =
+        std::max(max_src_width, static_cast<size_t>(depth_map_size.first));
+    max_src_height =
+        std::max(max_src_height, static_cast<size_t>(depth_map_size.second));
+  }
+
+  // The images are uploaded one by one, since the workspace cache may evict
+  // previously returned depth and normal maps.
+  auto GetImage = [this](const int image_idx) {
+    StereoFusionCuda::Image image;
+    image.depth_map = &workspace_->GetDepthMap(image_idx);
+    image.normal_map = &workspace_->GetNormalMap(image_idx);
+    image.fused_pixel_mask = &fused_pixel_masks_.at(image_idx);
+    image.P = P_.at(image_idx).data();
+    image.inv_P = inv_P_.at(image_idx).data();
+    image.inv_R = inv_R_.at(image_idx).data();
+    return image;
+  };
+
+  fusion_cuda_->SetRefImage(GetImage(image_idx),
+                            src_image_idxs.size(),
+                            max_src_width,
+                            max_src_height);
+  for (size_t i = 0; i < src_image_idxs.size(); ++i) {
+    fusion_cuda_->SetSrcImage(i, GetImage(src_image_idxs[i]));
+  }
+  *consistent_images = fusion_cuda_->ComputeConsistentSrcImages();
+
+  return src_image_idxs;
+}
+#endif  // COLMAP_CUDA_ENABLED
+
 void StereoFusion::Fuse(const int thread_id,
                         const int image_idx,
                         const int row,
-                        const int col) {
+                        const int col,
+                        const std::vector<int>* next_image_idxs) {
+  const int ref_image_idx = image_idx;
+
   // Next points to fuse.
   std::vector<FusionData> fusion_queue;
   fusion_queue.emplace_back(image_idx, row, col, 0);
@@ -405,14 +846,15 @@ void StereoFusion::Fuse(const int thread_id,
 
     fusion_queue.pop_back();
 
-    // Check if pixel already fused.
-    auto& fused_pixel_mask = fused_pixel_masks_.at(image_idx);
-    if (fused_pixel_mask.Get(row, col) > 0) {
+    // Check if pixel already fused. The queued pixels are within the bounds
+    // of the depth map, so the maps are accessed without checks.
+    char& fused_pixel = fused_pixel_masks_.at(image_idx).GetRef(row, col);
+    if (fused_pixel > 0) {
       continue;
     }
 
     const auto& depth_map = workspace_->GetDepthMap(image_idx);
-    const float depth = depth_map.Get(row, col);
+    const float depth = depth_map.GetRef(row, col);
 
     // Pixels with negative depth are filtered.
     if (depth <= 0.0f) {
@@ -444,9 +886,9 @@ void StereoFusion::Fuse(const int thread_id,
     // Determine normal direction in global reference frame.
     const auto& normal_map = workspace_->GetNormalMap(image_idx);
     const Eigen::Vector3f normal =
-        inv_R_.at(image_idx) * Eigen::Vector3f(normal_map.Get(row, col, 0),
-                                               normal_map.Get(row, col, 1),
-                                               normal_map.Get(row, col, 2));
+        inv_R_.at(image_idx) * Eigen::Vector3f(normal_map.GetRef(row, col, 0),
+                                               normal_map.GetRef(row, col, 1),
+                                               normal_map.GetRef(row, col, 2));
 
     // Check for consistent normal direction with reference normal.
     if (traversal_depth > 0) {
@@ -468,7 +910,8 @@ void StereoFusion::Fuse(const int thread_id,
         col / bitmap_scale.first, row / bitmap_scale.second, &color);
 
     // Set the current pixel as visited.
-    fused_pixel_mask.Set(row, col, 1);
+    fused_pixel = 1;
+    task_num_visited_pixels_[thread_id] += 1;
 
     // Pixels out of bounds are filtered
     if (xyz(0) < options_.bounding_box.first(0) ||
@@ -506,9 +949,18 @@ void StereoFusion::Fuse(const int thread_id,
       continue;
     }
 
-    for (const auto next_image_idx : overlapping_images_.at(image_idx)) {
-      if (!used_images_.at(next_image_idx) ||
-          fused_images_.at(next_image_idx)) {
+    // Restricted traversals only continue from the reference pixel.
+    if (next_image_idxs != nullptr && traversal_depth > 0) {
+      continue;
+    }
+
+    for (const auto next_image_idx :
+         next_image_idxs != nullptr ? *next_image_idxs
+                                    : overlapping_images_.at(image_idx)) {
+      if (!active_images_.at(next_image_idx) ||
+          fused_images_.at(next_image_idx) ||
+          (!neighborhood_owners_.empty() &&
+           neighborhood_owners_.at(next_image_idx) != ref_image_idx)) {
         continue;
       }
 
@@ -566,18 +1018,48 @@ void StereoFusion::Fuse(const int thread_id,
 void WritePointsVisibility(
     const std::string& path,
     const std::vector<std::vector<int>>& points_visibility) {
-  std::fstream file(path, std::ios::out | std::ios::binary);
-  THROW_CHECK_FILE_OPEN(file, path);
+  PointsVisibilityWriter writer(path);
+  for (const auto& visibility : points_visibility) {
+    writer.Write(visibility);
+  }
+  writer.Close();
+}
 
-  WriteBinaryLittleEndian<uint64_t>(&file, points_visibility.size());
+PointsVisibilityWriter::PointsVisibilityWriter(const std::string& path)
+    : path_(path), file_(path, std::ios::out | std::ios::binary) {
+  THROW_CHECK_FILE_OPEN(file_, path_);
+  WriteBinaryLittleEndian<uint64_t>(&file_, 0);
+}
 
-  for (const auto& visibility : points_visibility) {
-    WriteBinaryLittleEndian<uint32_t>(&file, visibility.size());
-    for (const auto& image_idx : visibility) {
-      WriteBinaryLittleEndian<uint32_t>(&file, image_idx);
-    }
+PointsVisibilityWriter::~PointsVisibilityWriter() {
+  if (file_.is_open()) {
+    WriteNumPoints();
+    file_.close();
   }
 }
 
+void PointsVisibilityWriter::Write(const std::vector<int>& visibility) {
+  THROW_CHECK(file_.is_open()) << path_;
+  WriteBinaryLittleEndian<uint32_t>(&file_, visibility.size());
+  for (const auto& image_idx : visibility) {
+    WriteBinaryLittleEndian<uint32_t>(&file_, image_idx);
+  }
+  num_points_ += 1;
+}
+
+size_t PointsVisibilityWriter::NumPoints() const { return num_points_; }
+
+void PointsVisibilityWriter::Close() {
+  THROW_CHECK(file_.is_open()) << path_;
+  WriteNumPoints();
+  file_.close();
+  THROW_CHECK(!file_.fail()) << "Failed to write " << path_;
+}
+
+void PointsVisibilityWriter::WriteNumPoints() {
+  file_.seekp(0);
+  WriteBinaryLittleEndian<uint64_t>(&file_, num_points_);
+}
+
 }  // namespace mvs
 }  // namespace colmap
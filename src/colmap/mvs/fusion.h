@@ -42,6 +42,8 @@
 #include "colmap/util/ply.h"
 
 #include <cfloat>
+#include <fstream>
+#include <memory>
 #include <unordered_set>
 #include <vector>
 
@@ -50,6 +52,9 @@
 namespace colmap {
 namespace mvs {
 
+class PointsVisibilityWriter;
+class StereoFusionCuda;
+
 struct StereoFusionOptions {
   // Path for PNG masks. Same format expected as ImageReaderOptions.
   std::string mask_path = "";
@@ -91,6 +96,43 @@ struct StereoFusionOptions {
   // consume a lot of memory, if the consistency graph is dense.
   double cache_size = 32.0;
 
+  // Directory for out-of-core fusion, which bounds the memory usage for large
+  // scenes. The fused points and their visibility are spilled to this
+  // directory after every fused image instead of being kept in memory, and
+  // only the fused pixel masks of the active neighborhood, i.e., the image
+  // being fused and its overlapping images, are kept in memory. The traversal
+  // is restricted to the active neighborhood. The fused points can then only
+  // be accessed through StereoFusion::WriteFusedPoints. If empty, all data is
+  // kept in memory.
+  std::string out_of_core_path = "";
+
+  // Whether to check the consistency of the reference pixels with their
+  // overlapping images in parallel on the GPU. The traversal of each pixel is
+  // then restricted to the directly consistent overlapping images, i.e., the
+  // traversal depth is at most one, and only the first 64 not yet fused
+  // overlapping images of each reference image are considered. Ignored, if
+  // COLMAP is built without CUDA.
+  bool use_gpu = false;
+
+  // Index of the GPU used for fusion. If -1, the best available GPU is used.
+  int gpu_index = -1;
+
+  // Whether to restrict the traversal of each reference pixel to the images,
+  // which were consistent with it during stereo, as stored in the consistency
+  // graphs written with PatchMatchOptions::write_consistency_graph. As for
+  // the GPU consistency check, which takes precedence, the traversal depth is
+  // then at most one. Images without a matching consistency graph are fused
+  // with an unrestricted traversal.
+  bool use_consistency_graph = false;
+
+  // Maximum number of images that are fused concurrently. Images are only
+  // fused concurrently, if their neighborhoods, i.e., the image and its not yet
+  // fused overlapping images, are disjoint, such that each pixel is only
+  // traversed from one reference image. The traversal is then restricted to
+  // the neighborhood of the reference image. If 1, the images are fused one
+  // after the other with an unrestricted traversal.
+  int max_num_concurrent_images = 1;
+
   std::pair<Eigen::Vector3f, Eigen::Vector3f> bounding_box =
       std::make_pair(Eigen::Vector3f(-FLT_MAX, -FLT_MAX, -FLT_MAX),
                      Eigen::Vector3f(FLT_MAX, FLT_MAX, FLT_MAX));
@@ -109,15 +151,58 @@ class StereoFusion : public BaseController {
                const std::string& workspace_format,
                const std::string& pmvs_option_name,
                const std::string& input_type);
+  ~StereoFusion();
 
+  // The fused points are empty in out-of-core mode.
   const std::vector<PlyPoint>& GetFusedPoints() const;
   const std::vector<std::vector<int>>& GetFusedPointsVisibility() const;
 
+  size_t NumFusedPoints() const;
+
+  // Write the fused points as binary PLY to the given path and their
+  // visibility to the path with ".vis" suffix. In out-of-core mode, the
+  // spilled points are already written in the same format and only copied.
+  void WriteFusedPoints(const std::string& path) const;
+
   void Run();
 
  private:
   void InitFusedPixelMask(int image_idx, size_t width, size_t height);
-  void Fuse(int thread_id, int image_idx, int row, int col);
+  // If next image indices are given, the traversal only continues from the
+  // reference pixel into the given images instead of all overlapping images.
+  void Fuse(int thread_id,
+            int image_idx,
+            int row,
+            int col,
+            const std::vector<int>* next_image_idxs = nullptr);
+
+  // Read the bit masks of consistent images for all pixels of the reference
+  // image from its consistency graph and return false, if the image has no
+  // consistency graph of the size of its depth map.
+  bool ReadConsistentImages(int image_idx,
+                            Mat<uint64_t>* consistent_images,
+                            std::vector<int>* consistent_image_idxs);
+
+#if defined(COLMAP_CUDA_ENABLED)
+  // Compute the bit masks of consistent overlapping images for all pixels of
+  // the reference image on the GPU and return the overlapping images, which
+  // correspond to the bits.
+  std::vector<int> ComputeConsistentImages(int image_idx,
+                                           Mat<uint64_t>* consistent_images);
+#endif
+
+  bool IsOutOfCore() const;
+  std::string GetSpilledPointsPath() const;
+  std::string GetSpilledPointsVisibilityPath() const;
+  std::string GetSpilledFusedPixelMaskPath(int image_idx) const;
+
+  // Load the fused pixel masks of the images and their overlapping images and
+  // spill the masks of all other not yet fused images to disk.
+  void ActivateNeighborhoods(const std::vector<int>& image_idxs);
+
+  // Append the fused points of all threads to the spill files.
+  void SpillFusedPoints();
+  void CloseSpillWriters();
 
   const StereoFusionOptions options_;
   const std::string workspace_path_;
@@ -130,10 +215,21 @@ class StereoFusion : public BaseController {
   std::unique_ptr<Workspace> workspace_;
   std::vector<char> used_images_;
   std::vector<char> fused_images_;
+  // Images into which the traversal may continue. In out-of-core mode, these
+  // are the images of the active neighborhood and otherwise all used images.
+  std::vector<char> active_images_;
+  // Reference image, whose neighborhood contains the image, if multiple images
+  // are fused concurrently, or -1, if the image may not be traversed.
+  // Empty, if the images are fused one after the other.
+  std::vector<int> neighborhood_owners_;
+  // Images whose fused pixel mask is spilled to disk in out-of-core mode.
+  std::vector<char> spilled_fused_pixel_masks_;
   std::vector<std::vector<int>> overlapping_images_;
   // Contains image masks of pre-masked and already fused pixels.
   // Initialized from image masks if provided in StereoFusionOptions.
   std::vector<Mat<char>> fused_pixel_masks_;
+  // Number of pixels masked by the image masks.
+  std::vector<size_t> num_masked_pixels_;
   std::vector<std::pair<int, int>> depth_map_sizes_;
   std::vector<std::pair<float, float>> bitmap_scales_;
   std::vector<Eigen::Matrix<float, 3, 4, Eigen::RowMajor>> P_;
@@ -161,6 +257,17 @@ class StereoFusion : public BaseController {
 
   std::vector<std::vector<PlyPoint>> task_fused_points_;
   std::vector<std::vector<std::vector<int>>> task_fused_points_visibility_;
+  // Number of pixels visited by each thread, including pixels that were
+  // visited by multiple threads due to concurrent traversals.
+  std::vector<size_t> task_num_visited_pixels_;
+
+  size_t num_spilled_points_ = 0;
+  std::unique_ptr<BinaryPlyPointsWriter> spilled_points_writer_;
+  std::unique_ptr<PointsVisibilityWriter> spilled_points_visibility_writer_;
+
+#if defined(COLMAP_CUDA_ENABLED)
+  std::unique_ptr<StereoFusionCuda> fusion_cuda_;
+#endif
 };
 
 // Write the visiblity information into a binary file of the following format:
@@ -179,5 +286,28 @@ void WritePointsVisibility(
     const std::string& path,
     const std::vector<std::vector<int>>& points_visibility);
 
+// Incrementally write the visibility information in the format of
+// WritePointsVisibility without knowing the number of points upfront. The
+// number of points is patched, when the writer is closed.
+class PointsVisibilityWriter {
+ public:
+  explicit PointsVisibilityWriter(const std::string& path);
+  ~PointsVisibilityWriter();
+
+  void Write(const std::vector<int>& visibility);
+
+  size_t NumPoints() const;
+
+  // Patch the number of points and close the file.
+  void Close();
+
+ private:
+  void WriteNumPoints();
+
+  const std::string path_;
+  std::fstream file_;
+  size_t num_points_ = 0;
+};
+
 }  // namespace mvs
 }  // namespace colmap
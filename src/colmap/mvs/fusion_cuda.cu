@@ -0,0 +1,339 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/mvs/fusion_cuda.h"
+
+#include "colmap/util/cuda.h"
+#include "colmap/util/cudacc.h"
+#include "colmap/util/logging.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// We must not include "util/math.h" to avoid any Eigen includes here,
+// since Visual Studio cannot compile some of the Eigen/Boost expressions.
+#ifndef DEG2RAD
+#define DEG2RAD(deg) deg * 0.0174532925199432
+#endif
+
+namespace colmap {
+namespace mvs {
+namespace {
+
+const size_t kBlockDimX = 32;
+const size_t kBlockDimY = 16;
+
+// Projection matrix, inverse rotation, width, and height.
+const size_t kNumSrcParams = 12 + 9 + 2;
+
+struct RefParams {
+  float inv_P[12];
+  float inv_R[9];
+};
+
+__device__ inline void Mat33DotVec3(const float* mat,
+                                    const float* vec,
+                                    float* result) {
+  result[0] = mat[0] * vec[0] + mat[1] * vec[1] + mat[2] * vec[2];
+  result[1] = mat[3] * vec[0] + mat[4] * vec[1] + mat[5] * vec[2];
+  result[2] = mat[6] * vec[0] + mat[7] * vec[1] + mat[8] * vec[2];
+}
+
+__device__ inline void Mat34DotVec3(const float* mat,
+                                    const float* vec,
+                                    float* result) {
+  result[0] = mat[0] * vec[0] + mat[1] * vec[1] + mat[2] * vec[2] + mat[3];
+  result[1] = mat[4] * vec[0] + mat[5] * vec[1] + mat[6] * vec[2] + mat[7];
+  result[2] = mat[8] * vec[0] + mat[9] * vec[1] + mat[10] * vec[2] + mat[11];
+}
+
+__global__ void ComputeConsistentSrcImagesKernel(
+    const RefParams ref_params,
+    const GpuMat<float> ref_depth_map,
+    const GpuMat<float> ref_normal_map,
+    const GpuMat<char> ref_fused_pixel_mask,
+    const int num_src_images,
+    const GpuMat<float> src_params,
+    const GpuMat<float> src_depth_maps,
+    const GpuMat<float> src_normal_maps,
+    const GpuMat<char> src_fused_pixel_masks,
+    const float max_squared_reproj_error,
+    const float max_depth_error,
+    const float min_cos_normal_error,
+    GpuMat<uint64_t> consistent_src_images) {
+  const int row = blockIdx.y * blockDim.y + threadIdx.y;
+  const int col = blockIdx.x * blockDim.x + threadIdx.x;
+  if (row >= ref_depth_map.GetHeight() || col >= ref_depth_map.GetWidth()) {
+    return;
+  }
+
+  uint64_t consistent_mask = 0;
+
+  const float ref_depth = ref_depth_map.Get(row, col);
+  if (ref_depth <= 0.0f || ref_fused_pixel_mask.Get(row, col) > 0) {
+    consistent_src_images.Set(row, col, consistent_mask);
+    return;
+  }
+
+  // Determine 3D location and normal in the global reference frame.
+  const float ref_point[3] = {col * ref_depth, row * ref_depth, ref_depth};
+  float xyz[3];
+  Mat34DotVec3(ref_params.inv_P, ref_point, xyz);
+
+  float ref_local_normal[3];
+  ref_normal_map.GetSlice(row, col, ref_local_normal);
+  float ref_normal[3];
+  Mat33DotVec3(ref_params.inv_R, ref_local_normal, ref_normal);
+
+  for (int src_image_idx = 0; src_image_idx < num_src_images;
+       ++src_image_idx) {
+    float params[kNumSrcParams];
+    for (size_t i = 0; i < kNumSrcParams; ++i) {
+      params[i] = src_params.Get(src_image_idx, i);
+    }
+    const float* P = params;
+    const float* inv_R = params + 12;
+    const int width = static_cast<int>(params[21]);
+    const int height = static_cast<int>(params[22]);
+
+    float proj[3];
+    Mat34DotVec3(P, xyz, proj);
+    if (proj[2] <= 0.0f) {
+      continue;
+    }
+
+    const float src_col_float = proj[0] / proj[2];
+    const float src_row_float = proj[1] / proj[2];
+    const int src_col = static_cast<int>(roundf(src_col_float));
+    const int src_row = static_cast<int>(roundf(src_row_float));
+    if (src_col < 0 || src_row < 0 || src_col >= width || src_row >= height) {
+      continue;
+    }
+
+    if (src_fused_pixel_masks.Get(src_row, src_col, src_image_idx) > 0) {
+      continue;
+    }
+
+    // Depth error of reference depth with source depth.
+    const float src_depth =
+        src_depth_maps.Get(src_row, src_col, src_image_idx);
+    if (src_depth <= 0.0f ||
+        fabsf((proj[2] - src_depth) / src_depth) > max_depth_error) {
+      continue;
+    }
+
+    // Reprojection error of reference point in the source image.
+    const float col_diff = src_col_float - src_col;
+    const float row_diff = src_row_float - src_row;
+    if (col_diff * col_diff + row_diff * row_diff > max_squared_reproj_error) {
+      continue;
+    }
+
+    // Consistent normal direction with reference normal.
+    const float src_local_normal[3] = {
+        src_normal_maps.Get(src_row, src_col, 3 * src_image_idx),
+        src_normal_maps.Get(src_row, src_col, 3 * src_image_idx + 1),
+        src_normal_maps.Get(src_row, src_col, 3 * src_image_idx + 2)};
+    float src_normal[3];
+    Mat33DotVec3(inv_R, src_local_normal, src_normal);
+    const float cos_normal_error = ref_normal[0] * src_normal[0] +
+                                   ref_normal[1] * src_normal[1] +
+                                   ref_normal[2] * src_normal[2];
+    if (cos_normal_error < min_cos_normal_error) {
+      continue;
+    }
+
+    consistent_mask |= uint64_t(1) << src_image_idx;
+  }
+
+  consistent_src_images.Set(row, col, consistent_mask);
+}
+
+// Allocate a new matrix only if the existing matrix has not enough memory.
+template <typename T>
+void ReshapeOrAllocate(const size_t width,
+                       const size_t height,
+                       const size_t depth,
+                       std::unique_ptr<GpuMat<T>>* mat) {
+  if (*mat && (*mat)->CanReshape(width, height, depth)) {
+    (*mat)->Reshape(width, height, depth);
+  } else {
+    mat->reset();
+    *mat = std::make_unique<GpuMat<T>>(width, height, depth);
+  }
+}
+
+// Copy all slices of the host matrix to the device matrix starting at the
+// given slice. The device matrix may be larger than the host matrix.
+template <typename T>
+void CopyToDeviceSlices(const Mat<T>& mat,
+                        const size_t slice,
+                        GpuMat<T>* gpu_mat) {
+  THROW_CHECK_LE(mat.GetWidth(), gpu_mat->GetWidth());
+  THROW_CHECK_LE(mat.GetHeight(), gpu_mat->GetHeight());
+  THROW_CHECK_LE(slice + mat.GetDepth(), gpu_mat->GetDepth());
+  for (size_t d = 0; d < mat.GetDepth(); ++d) {
+    char* slice_ptr = reinterpret_cast<char*>(gpu_mat->GetPtr()) +
+                      gpu_mat->GetPitch() * gpu_mat->GetHeight() * (slice + d);
+    CUDA_SAFE_CALL(
+        cudaMemcpy2D(slice_ptr,
+                     gpu_mat->GetPitch(),
+                     mat.GetPtr() + d * mat.GetWidth() * mat.GetHeight(),
+                     mat.GetWidth() * sizeof(T),
+                     mat.GetWidth() * sizeof(T),
+                     mat.GetHeight(),
+                     cudaMemcpyHostToDevice));
+  }
+}
+
+}  // namespace
+
+StereoFusionCuda::StereoFusionCuda(const float max_reproj_error,
+                                   const float max_depth_error,
+                                   const float max_normal_error)
+    : max_squared_reproj_error_(max_reproj_error * max_reproj_error),
+      max_depth_error_(max_depth_error),
+      min_cos_normal_error_(std::cos(DEG2RAD(max_normal_error))) {}
+
+void StereoFusionCuda::SetRefImage(const Image& image,
+                                   const size_t num_src_images,
+                                   const size_t max_src_width,
+                                   const size_t max_src_height) {
+  THROW_CHECK_NOTNULL(image.depth_map);
+  THROW_CHECK_NOTNULL(image.normal_map);
+  THROW_CHECK_NOTNULL(image.fused_pixel_mask);
+  THROW_CHECK_NOTNULL(image.inv_P);
+  THROW_CHECK_NOTNULL(image.inv_R);
+  THROW_CHECK_LE(num_src_images, static_cast<size_t>(kMaxNumSrcImages));
+
+  const size_t width = image.depth_map->GetWidth();
+  const size_t height = image.depth_map->GetHeight();
+  THROW_CHECK_EQ(image.normal_map->GetWidth(), width);
+  THROW_CHECK_EQ(image.normal_map->GetHeight(), height);
+  THROW_CHECK_EQ(image.normal_map->GetDepth(), 3);
+  THROW_CHECK_EQ(image.fused_pixel_mask->GetWidth(), width);
+  THROW_CHECK_EQ(image.fused_pixel_mask->GetHeight(), height);
+
+  ReshapeOrAllocate(width, height, 1, &ref_depth_map_);
+  ReshapeOrAllocate(width, height, 3, &ref_normal_map_);
+  ReshapeOrAllocate(width, height, 1, &ref_fused_pixel_mask_);
+  ReshapeOrAllocate(width, height, 1, &consistent_src_images_);
+  CopyToDeviceSlices(*image.depth_map, 0, ref_depth_map_.get());
+  CopyToDeviceSlices(*image.normal_map, 0, ref_normal_map_.get());
+  CopyToDeviceSlices(*image.fused_pixel_mask, 0, ref_fused_pixel_mask_.get());
+  memcpy(ref_inv_P_, image.inv_P, 12 * sizeof(float));
+  memcpy(ref_inv_R_, image.inv_R, 9 * sizeof(float));
+
+  num_src_images_ = num_src_images;
+  src_params_.assign(std::max<size_t>(num_src_images, 1) * kNumSrcParams, 0);
+  if (num_src_images == 0) {
+    return;
+  }
+
+  // Zero-initialize the padding of the source depth maps, such that it is
+  // never consistent with the reference pixels.
+  ReshapeOrAllocate(
+      max_src_width, max_src_height, num_src_images, &src_depth_maps_);
+  ReshapeOrAllocate(
+      max_src_width, max_src_height, 3 * num_src_images, &src_normal_maps_);
+  ReshapeOrAllocate(
+      max_src_width, max_src_height, num_src_images, &src_fused_pixel_masks_);
+  src_depth_maps_->FillWithScalar(0);
+}
+
+void StereoFusionCuda::SetSrcImage(const size_t src_image_idx,
+                                   const Image& image) {
+  THROW_CHECK_LT(src_image_idx, num_src_images_);
+  THROW_CHECK_NOTNULL(image.depth_map);
+  THROW_CHECK_NOTNULL(image.normal_map);
+  THROW_CHECK_NOTNULL(image.fused_pixel_mask);
+  THROW_CHECK_NOTNULL(image.P);
+  THROW_CHECK_NOTNULL(image.inv_R);
+  THROW_CHECK_EQ(image.normal_map->GetDepth(), 3);
+
+  CopyToDeviceSlices(*image.depth_map, src_image_idx, src_depth_maps_.get());
+  CopyToDeviceSlices(
+      *image.normal_map, 3 * src_image_idx, src_normal_maps_.get());
+  CopyToDeviceSlices(
+      *image.fused_pixel_mask, src_image_idx, src_fused_pixel_masks_.get());
+
+  float* params = src_params_.data() + src_image_idx * kNumSrcParams;
+  memcpy(params, image.P, 12 * sizeof(float));
+  memcpy(params + 12, image.inv_R, 9 * sizeof(float));
+  params[21] = image.depth_map->GetWidth();
+  params[22] = image.depth_map->GetHeight();
+}
+
+Mat<uint64_t> StereoFusionCuda::ComputeConsistentSrcImages() {
+  THROW_CHECK(consistent_src_images_) << "Reference image not set";
+
+  const size_t num_src_rows = std::max<size_t>(num_src_images_, 1);
+  ReshapeOrAllocate(kNumSrcParams, num_src_rows, 1, &src_params_device_);
+  src_params_device_->CopyToDevice(src_params_.data(),
+                                   kNumSrcParams * sizeof(float));
+
+  // Without source images, the source matrices are never accessed.
+  if (!src_depth_maps_) {
+    ReshapeOrAllocate(1, 1, 1, &src_depth_maps_);
+    ReshapeOrAllocate(1, 1, 3, &src_normal_maps_);
+    ReshapeOrAllocate(1, 1, 1, &src_fused_pixel_masks_);
+  }
+
+  RefParams ref_params;
+  memcpy(ref_params.inv_P, ref_inv_P_, sizeof(ref_inv_P_));
+  memcpy(ref_params.inv_R, ref_inv_R_, sizeof(ref_inv_R_));
+
+  const size_t width = consistent_src_images_->GetWidth();
+  const size_t height = consistent_src_images_->GetHeight();
+  const dim3 block_size(kBlockDimX, kBlockDimY);
+  const dim3 grid_size((width - 1) / kBlockDimX + 1,
+                       (height - 1) / kBlockDimY + 1);
+  ComputeConsistentSrcImagesKernel<<<grid_size, block_size>>>(
+      ref_params,
+      *ref_depth_map_,
+      *ref_normal_map_,
+      *ref_fused_pixel_mask_,
+      static_cast<int>(num_src_images_),
+      *src_params_device_,
+      *src_depth_maps_,
+      *src_normal_maps_,
+      *src_fused_pixel_masks_,
+      max_squared_reproj_error_,
+      max_depth_error_,
+      min_cos_normal_error_,
+      *consistent_src_images_);
+  CUDA_SYNC_AND_CHECK();
+
+  return consistent_src_images_->CopyToMat();
+}
+
+}  // namespace mvs
+}  // namespace colmap
@@ -0,0 +1,116 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/mvs/gpu_mat.h"
+#include "colmap/mvs/mat.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <cuda_runtime.h>
+
+namespace colmap {
+namespace mvs {
+
+// Checks the consistency of all pixels of a reference image with a set of
+// source images in parallel on the GPU. Every reference pixel is projected into
+// the source images and compared against the source pixel it falls onto with
+// the same depth, reprojection, and normal criteria as in StereoFusion. The
+// result for each reference pixel is a bit mask of the consistent source
+// images, which is then used to restrict the CPU fusion of the pixel.
+class StereoFusionCuda {
+ public:
+  // Maximum number of source images, such that the consistent source images
+  // of a pixel fit into a bit mask.
+  static const int kMaxNumSrcImages = 64;
+
+  // View of an image, where the projection matrices are in row-major order.
+  // The pointed to data must only remain valid during the call it is passed to.
+  struct Image {
+    const Mat<float>* depth_map = nullptr;
+    const Mat<float>* normal_map = nullptr;
+    const Mat<char>* fused_pixel_mask = nullptr;
+    // 3x4 projection matrix from world to image coordinates.
+    const float* P = nullptr;
+    // 3x4 inverse projection matrix from image to world coordinates.
+    const float* inv_P = nullptr;
+    // 3x3 rotation matrix from camera to world coordinates.
+    const float* inv_R = nullptr;
+  };
+
+  StereoFusionCuda(float max_reproj_error,
+                   float max_depth_error,
+                   float max_normal_error);
+
+  // Upload the reference image and allocate the device memory for the given
+  // number of source images with the given maximum dimensions.
+  void SetRefImage(const Image& image,
+                   size_t num_src_images,
+                   size_t max_src_width,
+                   size_t max_src_height);
+
+  // Upload the source image at the given index in [0, num_src_images).
+  void SetSrcImage(size_t src_image_idx, const Image& image);
+
+  // Compute the bit masks of consistent source images for all reference
+  // pixels. Already fused reference pixels and pixels without depth have an
+  // empty bit mask. Source pixels are only consistent, if not yet fused.
+  Mat<uint64_t> ComputeConsistentSrcImages();
+
+ private:
+  const float max_squared_reproj_error_;
+  const float max_depth_error_;
+  const float min_cos_normal_error_;
+
+  size_t num_src_images_ = 0;
+  float ref_inv_P_[12];
+  float ref_inv_R_[9];
+
+  // The source image data is stored in zero-padded slices of the maximum
+  // dimensions, where each normal map occupies 3 consecutive slices. The
+  // source parameters contain the projection matrix, the inverse rotation,
+  // and the dimensions of each source image in one row.
+  std::vector<float> src_params_;
+
+  std::unique_ptr<GpuMat<float>> ref_depth_map_;
+  std::unique_ptr<GpuMat<float>> ref_normal_map_;
+  std::unique_ptr<GpuMat<char>> ref_fused_pixel_mask_;
+  std::unique_ptr<GpuMat<float>> src_depth_maps_;
+  std::unique_ptr<GpuMat<float>> src_normal_maps_;
+  std::unique_ptr<GpuMat<char>> src_fused_pixel_masks_;
+  std::unique_ptr<GpuMat<float>> src_params_device_;
+  std::unique_ptr<GpuMat<uint64_t>> consistent_src_images_;
+};
+
+}  // namespace mvs
+}  // namespace colmap
@@ -62,6 +62,16 @@ class GpuMat {
   __host__ __device__ size_t GetHeight() const;
   __host__ __device__ size_t GetDepth() const;
 
+  // Number of allocated bytes, which can exceed the number of bytes required
+  // for the current dimensions after reshaping.
+  size_t GetCapacity() const;
+
+  // Change the dimensions while reusing the allocated memory, which must be
+  // large enough for the new dimensions. The contents are undefined after
+  // reshaping.
+  bool CanReshape(size_t width, size_t height, size_t depth) const;
+  void Reshape(size_t width, size_t height, size_t depth);
+
   __device__ T Get(const size_t row,
                    const size_t col,
                    const size_t slice = 0) const;
@@ -106,9 +116,15 @@ class GpuMat {
   const static size_t kBlockDimX = 32;
   const static size_t kBlockDimY = 16;
 
+  // Alignment of rows of reshaped matrices in bytes.
+  const static size_t kReshapePitchAlignment = 512;
+
+  static size_t ComputeReshapePitch(size_t width);
+
   std::shared_ptr<T> array_;
   T* array_ptr_;
 
+  size_t capacity_;
   size_t pitch_;
   size_t width_;
   size_t height_;
@@ -179,6 +195,7 @@ GpuMat<T>::GpuMat(const size_t width, const size_t height, const size_t depth)
       (void**)&array_ptr_, &pitch_, width_ * sizeof(T), height_ * depth_));
 
   array_ = std::shared_ptr<T>(array_ptr_, cudaFree);
+  capacity_ = pitch_ * height_ * depth_;
 
   ComputeCudaConfig();
 }
@@ -187,6 +204,7 @@ template <typename T>
 GpuMat<T>::~GpuMat() {
   array_.reset();
   array_ptr_ = nullptr;
+  capacity_ = 0;
   pitch_ = 0;
   width_ = 0;
   height_ = 0;
@@ -223,6 +241,33 @@ __host__ __device__ size_t GpuMat<T>::GetDepth() const {
   return depth_;
 }
 
+template <typename T>
+size_t GpuMat<T>::GetCapacity() const {
+  return capacity_;
+}
+
+template <typename T>
+bool GpuMat<T>::CanReshape(const size_t width,
+                           const size_t height,
+                           const size_t depth) const {
+  return ComputeReshapePitch(width) * height * depth <= capacity_;
+}
+
+template <typename T>
+void GpuMat<T>::Reshape(const size_t width,
+                        const size_t height,
+                        const size_t depth) {
+  if (width == width_ && height == height_ && depth == depth_) {
+    return;
+  }
+  THROW_CHECK(CanReshape(width, height, depth));
+  pitch_ = ComputeReshapePitch(width);
+  width_ = width;
+  height_ = height;
+  depth_ = depth;
+  ComputeCudaConfig();
+}
+
 template <typename T>
 __device__ T GpuMat<T>::Get(const size_t row,
                             const size_t col,
@@ -438,6 +483,12 @@ void GpuMat<T>::Write(const std::string& path, const size_t slice) {
   binary_file.close();
 }
 
+template <typename T>
+size_t GpuMat<T>::ComputeReshapePitch(const size_t width) {
+  return (width * sizeof(T) + kReshapePitchAlignment - 1) /
+         kReshapePitchAlignment * kReshapePitchAlignment;
+}
+
 template <typename T>
 void GpuMat<T>::ComputeCudaConfig() {
   blockSize_.x = kBlockDimX;
@@ -89,6 +89,21 @@ GpuMatRefImage::GpuMatRefImage(const size_t width, const size_t height)
   squared_sum_image.reset(new GpuMat<float>(width, height));
 }
 
+GpuMatRefImage::GpuMatRefImage(
+    std::unique_ptr<GpuMat<uint8_t>> image_mat,
+    std::unique_ptr<GpuMat<float>> sum_image_mat,
+    std::unique_ptr<GpuMat<float>> squared_sum_image_mat)
+    : image(std::move(image_mat)),
+      sum_image(std::move(sum_image_mat)),
+      squared_sum_image(std::move(squared_sum_image_mat)),
+      width_(image->GetWidth()),
+      height_(image->GetHeight()) {
+  THROW_CHECK_EQ(sum_image->GetWidth(), width_);
+  THROW_CHECK_EQ(sum_image->GetHeight(), height_);
+  THROW_CHECK_EQ(squared_sum_image->GetWidth(), width_);
+  THROW_CHECK_EQ(squared_sum_image->GetHeight(), height_);
+}
+
 void GpuMatRefImage::Filter(const uint8_t* image_data,
                             const size_t window_radius,
                             const size_t window_step,
@@ -41,6 +41,12 @@ class GpuMatRefImage {
  public:
   GpuMatRefImage(const size_t width, const size_t height);
 
+  // Use the given, possibly previously allocated, matrices of the same
+  // dimensions as storage instead of allocating new memory.
+  GpuMatRefImage(std::unique_ptr<GpuMat<uint8_t>> image_mat,
+                 std::unique_ptr<GpuMat<float>> sum_image_mat,
+                 std::unique_ptr<GpuMat<float>> squared_sum_image_mat);
+
   // Filter image using sum convolution kernel to compute local sum of
   // intensities. The filtered images can then be used for repeated, efficient
   // NCC computation.
@@ -56,6 +56,30 @@ TEST(GpuMat, FillWithVector) {
   }
 }
 
+TEST(GpuMat, Reshape) {
+  GpuMat<float> array(100, 50, 2);
+  const float* ptr = array.GetPtr();
+  EXPECT_GE(array.GetCapacity(), 100 * 50 * 2 * sizeof(float));
+  EXPECT_TRUE(array.CanReshape(50, 100, 2));
+  EXPECT_FALSE(array.CanReshape(1000, 1000, 2));
+
+  array.Reshape(50, 100, 2);
+  EXPECT_EQ(array.GetWidth(), 50);
+  EXPECT_EQ(array.GetHeight(), 100);
+  EXPECT_EQ(array.GetDepth(), 2);
+  EXPECT_EQ(array.GetPtr(), ptr);
+  EXPECT_GE(array.GetPitch(), 50 * sizeof(float));
+
+  const std::vector<float> vector = {1.0f, 2.0f};
+  array.FillWithVector(vector.data());
+  std::vector<float> array_host(50 * 100 * 2, 0.0f);
+  array.CopyToHost(array_host.data(), 50 * sizeof(float));
+  for (size_t i = 0; i < 50 * 100; ++i) {
+    EXPECT_EQ(array_host[i], 1.0f);
+    EXPECT_EQ(array_host[50 * 100 + i], 2.0f);
+  }
+}
+
 template <typename T>
 void TestTransposeImage(const size_t width,
                         const size_t height,
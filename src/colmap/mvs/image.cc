@@ -33,6 +33,8 @@
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/logging.h"
 
+#include <utility>
+
 #include <Eigen/Core>
 
 namespace colmap {
@@ -60,6 +62,12 @@ void Image::SetBitmap(const Bitmap& bitmap) {
   THROW_CHECK_EQ(height_, bitmap_.Height());
 }
 
+void Image::SetBitmap(Bitmap&& bitmap) {
+  bitmap_ = std::move(bitmap);
+  THROW_CHECK_EQ(width_, bitmap_.Width());
+  THROW_CHECK_EQ(height_, bitmap_.Height());
+}
+
 void Image::Rescale(const float factor) { Rescale(factor, factor); }
 
 void Image::Rescale(const float factor_x, const float factor_y) {
@@ -54,7 +54,10 @@ class Image {
   inline size_t GetWidth() const;
   inline size_t GetHeight() const;
 
+  // Set the bitmap by copying it, or by taking ownership of a temporary,
+  // e.g., a cropped bitmap, without copying the pixel data.
   void SetBitmap(const Bitmap& bitmap);
+  void SetBitmap(Bitmap&& bitmap);
   inline const Bitmap& GetBitmap() const;
 
   inline const std::string& GetPath() const;
@@ -0,0 +1,132 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/mvs/map_compression.h"
+
+#include "colmap/util/endian.h"
+#include "colmap/util/logging.h"
+
+#include <string>
+
+#include <lz4.h>
+
+namespace colmap {
+namespace mvs {
+namespace {
+
+const std::string kCompressedMapMagic = "lz4";
+
+}  // namespace
+
+void WriteCompressedMapHeader(const size_t width,
+                              const size_t height,
+                              const size_t depth,
+                              std::ostream* stream) {
+  *stream << kCompressedMapMagic << "&" << width << "&" << height << "&"
+          << depth << "&";
+}
+
+bool ReadCompressedMapHeader(std::istream* stream,
+                             size_t* width,
+                             size_t* height,
+                             size_t* depth) {
+  const std::streampos pos = stream->tellg();
+  std::string magic(kCompressedMapMagic.size(), '\0');
+  stream->read(&magic[0], magic.size());
+  if (!*stream || magic != kCompressedMapMagic) {
+    stream->clear();
+    stream->seekg(pos);
+    return false;
+  }
+
+  char unused_char;
+  *stream >> unused_char >> *width >> unused_char >> *height >> unused_char >>
+      *depth >> unused_char;
+  THROW_CHECK(*stream) << "Invalid compressed map header";
+  return true;
+}
+
+void WriteCompressedMapValues(const std::vector<uint16_t>& values,
+                              std::ostream* stream) {
+  // Delta encode the values and split them into planes of low and high bytes.
+  // For smooth maps, most of the high bytes are then zero or 0xFF.
+  std::vector<char> planes(2 * values.size());
+  uint16_t prev_value = 0;
+  for (size_t i = 0; i < values.size(); ++i) {
+    const uint16_t delta = values[i] - prev_value;
+    planes[i] = static_cast<char>(delta & 0xFF);
+    planes[values.size() + i] = static_cast<char>(delta >> 8);
+    prev_value = values[i];
+  }
+
+  std::vector<char> compressed_planes(
+      LZ4_compressBound(static_cast<int>(planes.size())));
+  const int num_compressed_bytes =
+      LZ4_compress_default(planes.data(),
+                           compressed_planes.data(),
+                           static_cast<int>(planes.size()),
+                           static_cast<int>(compressed_planes.size()));
+  THROW_CHECK(planes.empty() || num_compressed_bytes > 0);
+
+  WriteBinaryLittleEndian<uint64_t>(stream, num_compressed_bytes);
+  stream->write(compressed_planes.data(), num_compressed_bytes);
+}
+
+void ReadCompressedMapValues(std::istream* stream,
+                             std::vector<uint16_t>* values) {
+  const uint64_t num_compressed_bytes =
+      ReadBinaryLittleEndian<uint64_t>(stream);
+  std::vector<char> compressed_planes(num_compressed_bytes);
+  stream->read(compressed_planes.data(), num_compressed_bytes);
+  THROW_CHECK(*stream) << "Truncated compressed map";
+
+  std::vector<char> planes(2 * values->size());
+  if (!planes.empty()) {
+    THROW_CHECK_EQ(
+        LZ4_decompress_safe(compressed_planes.data(),
+                            planes.data(),
+                            static_cast<int>(num_compressed_bytes),
+                            static_cast<int>(planes.size())),
+        static_cast<int>(planes.size()))
+        << "Corrupt compressed map";
+  }
+
+  uint16_t value = 0;
+  for (size_t i = 0; i < values->size(); ++i) {
+    const uint16_t delta =
+        static_cast<uint8_t>(planes[i]) |
+        (static_cast<uint8_t>(planes[values->size() + i]) << 8);
+    value += delta;
+    (*values)[i] = value;
+  }
+}
+
+}  // namespace mvs
+}  // namespace colmap
@@ -0,0 +1,73 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+namespace colmap {
+namespace mvs {
+
+// Compressed file format of depth and normal maps, in the following format:
+//
+//    lz4&width&height&depth&<binary payload>
+//
+// The header differs from the raw format of `Mat<T>::Write` by the leading
+// magic, such that both formats can be read transparently. The payload
+// consists of the map-specific quantization parameters followed by blocks
+// of quantized 16-bit values. Each block is delta encoded, split into
+// separate planes of low and high bytes, and LZ4 compressed, which exploits
+// the spatial smoothness of the maps.
+
+// Write the header of a compressed map.
+void WriteCompressedMapHeader(size_t width,
+                              size_t height,
+                              size_t depth,
+                              std::ostream* stream);
+
+// Read the header of a compressed map and return true or rewind the stream
+// and return false, if the stream does not contain a compressed map.
+bool ReadCompressedMapHeader(std::istream* stream,
+                             size_t* width,
+                             size_t* height,
+                             size_t* depth);
+
+// Write/read a block of quantized values. The values must be presized to the
+// number of encoded values when reading.
+void WriteCompressedMapValues(const std::vector<uint16_t>& values,
+                              std::ostream* stream);
+void ReadCompressedMapValues(std::istream* stream,
+                             std::vector<uint16_t>* values);
+
+}  // namespace mvs
+}  // namespace colmap
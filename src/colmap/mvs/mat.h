@@ -57,6 +57,19 @@ class Mat {
   T* GetPtr();
   const T* GetPtr() const;
 
+  // Unchecked access for hot loops. The caller ensures that the indices are
+  // within bounds, whereas Get and Set check them.
+  T& GetRef(size_t row, size_t col, size_t slice = 0);
+  const T& GetRef(size_t row, size_t col, size_t slice = 0) const;
+
+  // Views of the contiguous values of a row or of a whole slice. The values of
+  // a row are followed by the next row in the same slice, so that loops over
+  // rows or slices can be vectorized by the compiler.
+  T* GetRowPtr(size_t row, size_t slice = 0);
+  const T* GetRowPtr(size_t row, size_t slice = 0) const;
+  T* GetSlicePtr(size_t slice);
+  const T* GetSlicePtr(size_t slice) const;
+
   const std::vector<T>& GetData() const;
 
   void Set(size_t row, size_t col, T value);
@@ -72,6 +85,9 @@ class Mat {
   size_t height_ = 0;
   size_t depth_ = 0;
   std::vector<T> data_;
+
+ private:
+  size_t GetIndex(size_t row, size_t col, size_t slice) const;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -109,7 +125,7 @@ size_t Mat<T>::GetNumBytes() const {
 
 template <typename T>
 T Mat<T>::Get(const size_t row, const size_t col, const size_t slice) const {
-  return data_.at(slice * width_ * height_ + row * width_ + col);
+  return data_.at(GetIndex(row, col, slice));
 }
 
 template <typename T>
@@ -129,6 +145,38 @@ const T* Mat<T>::GetPtr() const {
   return data_.data();
 }
 
+template <typename T>
+T& Mat<T>::GetRef(const size_t row, const size_t col, const size_t slice) {
+  return data_[GetIndex(row, col, slice)];
+}
+
+template <typename T>
+const T& Mat<T>::GetRef(const size_t row,
+                        const size_t col,
+                        const size_t slice) const {
+  return data_[GetIndex(row, col, slice)];
+}
+
+template <typename T>
+T* Mat<T>::GetRowPtr(const size_t row, const size_t slice) {
+  return data_.data() + GetIndex(row, 0, slice);
+}
+
+template <typename T>
+const T* Mat<T>::GetRowPtr(const size_t row, const size_t slice) const {
+  return data_.data() + GetIndex(row, 0, slice);
+}
+
+template <typename T>
+T* Mat<T>::GetSlicePtr(const size_t slice) {
+  return data_.data() + slice * width_ * height_;
+}
+
+template <typename T>
+const T* Mat<T>::GetSlicePtr(const size_t slice) const {
+  return data_.data() + slice * width_ * height_;
+}
+
 template <typename T>
 const std::vector<T>& Mat<T>::GetData() const {
   return data_;
@@ -144,7 +192,7 @@ void Mat<T>::Set(const size_t row,
                  const size_t col,
                  const size_t slice,
                  const T value) {
-  data_.at(slice * width_ * height_ + row * width_ + col) = value;
+  data_.at(GetIndex(row, col, slice)) = value;
 }
 
 template <typename T>
@@ -178,5 +226,12 @@ void Mat<T>::Write(const std::string& path) const {
   file.close();
 }
 
+template <typename T>
+size_t Mat<T>::GetIndex(const size_t row,
+                        const size_t col,
+                        const size_t slice) const {
+  return (slice * height_ + row) * width_ + col;
+}
+
 }  // namespace mvs
 }  // namespace colmap
@@ -81,6 +81,43 @@ TEST(Mat, GetSet) {
   EXPECT_EQ(slice[2], 6);
 }
 
+TEST(Mat, GetRef) {
+  Mat<int> mat(2, 3, 2);
+  mat.GetRef(1, 0) = 1;
+  mat.GetRef(2, 1, 1) = 2;
+  EXPECT_EQ(mat.Get(1, 0), 1);
+  EXPECT_EQ(mat.Get(2, 1, 1), 2);
+  const Mat<int>& const_mat = mat;
+  EXPECT_EQ(const_mat.GetRef(1, 0, 0), 1);
+  EXPECT_EQ(const_mat.GetRef(2, 1, 1), 2);
+  EXPECT_EQ(const_mat.GetRef(0, 0), 0);
+}
+
+TEST(Mat, GetRowAndSlicePtr) {
+  Mat<int> mat(2, 3, 2);
+  for (size_t slice = 0; slice < 2; ++slice) {
+    for (size_t row = 0; row < 3; ++row) {
+      for (size_t col = 0; col < 2; ++col) {
+        mat.Set(row, col, slice, 100 * slice + 10 * row + col);
+      }
+    }
+  }
+
+  EXPECT_EQ(mat.GetSlicePtr(0), mat.GetPtr());
+  EXPECT_EQ(mat.GetSlicePtr(1), mat.GetPtr() + 6);
+  EXPECT_EQ(mat.GetSlicePtr(1)[5], 121);
+  for (size_t slice = 0; slice < 2; ++slice) {
+    for (size_t row = 0; row < 3; ++row) {
+      const int* values = mat.GetRowPtr(row, slice);
+      EXPECT_EQ(values[0], 100 * slice + 10 * row);
+      EXPECT_EQ(values[1], 100 * slice + 10 * row + 1);
+    }
+  }
+
+  mat.GetRowPtr(2)[1] = -1;
+  EXPECT_EQ(mat.Get(2, 1), -1);
+}
+
 TEST(Mat, Fill) {
   Mat<int> mat(1, 2, 3);
 
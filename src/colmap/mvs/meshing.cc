@@ -29,13 +29,20 @@
 
 #include "colmap/mvs/meshing.h"
 
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
+#include <functional>
+#include <limits>
 #include <unordered_map>
 #include <vector>
 
 #if defined(COLMAP_CGAL_ENABLED)
 #include <CGAL/Delaunay_triangulation_3.h>
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
+#if defined(CGAL_LINKED_WITH_TBB)
+#include <tbb/task_arena.h>
+#endif  // CGAL_LINKED_WITH_TBB
 #endif  // COLMAP_CGAL_ENABLED
 
 #include "colmap/math/graph_cut.h"
@@ -54,7 +61,18 @@
 #if defined(COLMAP_CGAL_ENABLED)
 
 typedef CGAL::Exact_predicates_inexact_constructions_kernel K;
+#if defined(CGAL_LINKED_WITH_TBB)
+// The concurrent triangulation data structure allows for parallel insertion
+// of points. Note that the Fast_location policy is not supported in this mode.
+typedef CGAL::Triangulation_data_structure_3<
+    CGAL::Triangulation_vertex_base_3<K>,
+    CGAL::Delaunay_triangulation_cell_base_3<K>,
+    CGAL::Parallel_tag>
+    DelaunayTds;
+typedef CGAL::Delaunay_triangulation_3<K, DelaunayTds> Delaunay;
+#else
 typedef CGAL::Delaunay_triangulation_3<K, CGAL::Fast_location> Delaunay;
+#endif  // CGAL_LINKED_WITH_TBB
 
 namespace std {
 
@@ -100,6 +118,10 @@ bool PoissonMeshingOptions::Check() const {
   CHECK_OPTION_GE(trim, 0);
   CHECK_OPTION_GE(num_threads, -1);
   CHECK_OPTION_NE(num_threads, 0);
+  CHECK_OPTION_GE(downsample_voxel_size, 0);
+  CHECK_OPTION_GE(tile_size, 0);
+  CHECK_OPTION_GE(tile_overlap, 0);
+  CHECK_OPTION_LE(tile_overlap, 1);
   return true;
 }
 
@@ -115,6 +137,183 @@ bool DelaunayMeshingOptions::Check() const {
   CHECK_OPTION_LE(max_side_length_percentile, 100);
   CHECK_OPTION_GE(num_threads, -1);
   CHECK_OPTION_NE(num_threads, 0);
+  CHECK_OPTION_GE(downsample_voxel_size, 0);
+  CHECK_OPTION_GE(tile_size, 0);
+  CHECK_OPTION_GE(tile_overlap, 0);
+  CHECK_OPTION_LE(tile_overlap, 1);
+  return true;
+}
+
+// A cubic tile of the scene, which is meshed with all points within the tile
+// extended by the overlap. The resulting mesh is then clipped to the tile.
+struct MeshingTile {
+  Eigen::Vector3f min_bound = Eigen::Vector3f::Zero();
+  Eigen::Vector3f max_bound = Eigen::Vector3f::Zero();
+  std::vector<size_t> point_idxs;
+};
+
+// Partition the points into a regular grid of tiles aligned with the origin.
+// Tiles without any point inside their non-overlapping bounds are discarded.
+std::vector<MeshingTile> PartitionMeshingTiles(
+    const size_t num_points,
+    const std::function<Eigen::Vector3f(size_t)>& point_position,
+    const double tile_size,
+    const double tile_overlap) {
+  THROW_CHECK_GT(tile_size, 0);
+
+  struct TileHash {
+    size_t operator()(const Eigen::Vector3i& tile) const {
+      return static_cast<size_t>(tile.x()) * 73856093 ^
+             static_cast<size_t>(tile.y()) * 19349663 ^
+             static_cast<size_t>(tile.z()) * 83492791;
+    }
+  };
+
+  std::unordered_map<Eigen::Vector3i, size_t, TileHash> tile_idxs;
+  std::vector<MeshingTile> tiles;
+  std::vector<size_t> num_inner_points;
+
+  const double overlap = tile_overlap * tile_size;
+  for (size_t point_idx = 0; point_idx < num_points; ++point_idx) {
+    const Eigen::Array3d position = point_position(point_idx).cast<double>();
+    const Eigen::Vector3i inner_tile =
+        (position / tile_size).floor().cast<int>();
+    const Eigen::Vector3i min_tile =
+        ((position - overlap) / tile_size).floor().cast<int>();
+    const Eigen::Vector3i max_tile =
+        ((position + overlap) / tile_size).floor().cast<int>();
+    for (int x = min_tile.x(); x <= max_tile.x(); ++x) {
+      for (int y = min_tile.y(); y <= max_tile.y(); ++y) {
+        for (int z = min_tile.z(); z <= max_tile.z(); ++z) {
+          const Eigen::Vector3i tile(x, y, z);
+          const auto tile_idx = tile_idxs.emplace(tile, tiles.size());
+          if (tile_idx.second) {
+            tiles.emplace_back();
+            tiles.back().min_bound =
+                (tile.cast<double>() * tile_size).cast<float>();
+            tiles.back().max_bound =
+                ((tile.cast<double>().array() + 1) * tile_size)
+                    .matrix()
+                    .cast<float>();
+            num_inner_points.push_back(0);
+          }
+          tiles[tile_idx.first->second].point_idxs.push_back(point_idx);
+          if (tile == inner_tile) {
+            num_inner_points[tile_idx.first->second] += 1;
+          }
+        }
+      }
+    }
+  }
+
+  std::vector<MeshingTile> non_empty_tiles;
+  non_empty_tiles.reserve(tiles.size());
+  for (size_t i = 0; i < tiles.size(); ++i) {
+    if (num_inner_points[i] > 0) {
+      non_empty_tiles.push_back(std::move(tiles[i]));
+    }
+  }
+
+  return non_empty_tiles;
+}
+
+// Append the faces of the tile mesh, whose centroid lies within the
+// non-overlapping bounds of the tile, to the given mesh. The bounds are
+// half-open, such that every face is clipped into exactly one tile.
+void AppendClippedTileMesh(const MeshingTile& tile,
+                           const PlyMesh& tile_mesh,
+                           PlyMesh* mesh) {
+  const size_t kInvalidVertexIdx = std::numeric_limits<size_t>::max();
+  std::vector<size_t> vertex_idxs(tile_mesh.vertices.size(),
+                                  kInvalidVertexIdx);
+
+  auto AppendVertex = [&](const size_t tile_vertex_idx) {
+    size_t& vertex_idx = vertex_idxs.at(tile_vertex_idx);
+    if (vertex_idx == kInvalidVertexIdx) {
+      vertex_idx = mesh->vertices.size();
+      mesh->vertices.push_back(tile_mesh.vertices[tile_vertex_idx]);
+    }
+    return vertex_idx;
+  };
+
+  auto VertexPosition = [&](const size_t tile_vertex_idx) {
+    const PlyMeshVertex& vertex = tile_mesh.vertices.at(tile_vertex_idx);
+    return Eigen::Vector3f(vertex.x, vertex.y, vertex.z);
+  };
+
+  for (const auto& face : tile_mesh.faces) {
+    const Eigen::Array3f centroid = (VertexPosition(face.vertex_idx1) +
+                                     VertexPosition(face.vertex_idx2) +
+                                     VertexPosition(face.vertex_idx3)) /
+                                    3.0f;
+    if ((centroid < tile.min_bound.array()).any() ||
+        (centroid >= tile.max_bound.array()).any()) {
+      continue;
+    }
+    const size_t vertex_idx1 = AppendVertex(face.vertex_idx1);
+    const size_t vertex_idx2 = AppendVertex(face.vertex_idx2);
+    const size_t vertex_idx3 = AppendVertex(face.vertex_idx3);
+    mesh->faces.emplace_back(vertex_idx1, vertex_idx2, vertex_idx3);
+  }
+}
+
+bool TiledPoissonMeshing(const PoissonMeshingOptions& options,
+                         const std::string& input_path,
+                         const std::string& output_path) {
+  std::vector<PlyPoint> points = ReadPly(input_path, options.num_threads);
+  if (options.downsample_voxel_size > 0) {
+    const size_t num_points = points.size();
+    points = DownsamplePlyPoints(points, options.downsample_voxel_size);
+    LOG(INFO) << StringPrintf(
+        "Downsampled %d to %d points", num_points, points.size());
+  }
+
+  const std::vector<MeshingTile> tiles = PartitionMeshingTiles(
+      points.size(),
+      [&points](const size_t point_idx) {
+        const PlyPoint& point = points[point_idx];
+        return Eigen::Vector3f(point.x, point.y, point.z);
+      },
+      options.tile_size,
+      options.tile_overlap);
+
+  PoissonMeshingOptions tile_options = options;
+  tile_options.downsample_voxel_size = 0;
+  tile_options.tile_size = 0;
+
+  const std::string tile_input_path = output_path + ".tile.ply";
+  const std::string tile_output_path = output_path + ".tile.mesh.ply";
+
+  PlyMesh mesh;
+  for (size_t tile_idx = 0; tile_idx < tiles.size(); ++tile_idx) {
+    const MeshingTile& tile = tiles[tile_idx];
+    LOG(INFO) << StringPrintf("Meshing tile [%d/%d] with %d points",
+                              tile_idx + 1,
+                              tiles.size(),
+                              tile.point_idxs.size());
+
+    {
+      BinaryPlyPointsWriter writer(tile_input_path);
+      for (const size_t point_idx : tile.point_idxs) {
+        writer.Write(points[point_idx]);
+      }
+      writer.Close();
+    }
+
+    const bool success =
+        PoissonMeshing(tile_options, tile_input_path, tile_output_path);
+    std::remove(tile_input_path.c_str());
+    if (!success) {
+      std::remove(tile_output_path.c_str());
+      return false;
+    }
+
+    AppendClippedTileMesh(tile, ReadPlyMesh(tile_output_path), &mesh);
+    std::remove(tile_output_path.c_str());
+  }
+
+  WriteBinaryPlyMesh(output_path, mesh);
+
   return true;
 }
 
@@ -123,12 +322,29 @@ bool PoissonMeshing(const PoissonMeshingOptions& options,
                     const std::string& output_path) {
   THROW_CHECK(options.Check());
 
+  if (options.tile_size > 0) {
+    return TiledPoissonMeshing(options, input_path, output_path);
+  }
+
+  std::string poisson_input_path = input_path;
+  if (options.downsample_voxel_size > 0) {
+    const std::vector<PlyPoint> points =
+        ReadPly(input_path, options.num_threads);
+    const std::vector<PlyPoint> downsampled_points =
+        DownsamplePlyPoints(points, options.downsample_voxel_size);
+    LOG(INFO) << StringPrintf("Downsampled %d to %d points",
+                              points.size(),
+                              downsampled_points.size());
+    poisson_input_path = output_path + ".downsampled.ply";
+    WriteBinaryPlyPoints(poisson_input_path, downsampled_points);
+  }
+
   std::vector<std::string> args;
 
   args.push_back("./binary");
 
   args.push_back("--in");
-  args.push_back(input_path);
+  args.push_back(poisson_input_path);
 
   args.push_back("--out");
   args.push_back(output_path);
@@ -161,8 +377,12 @@ bool PoissonMeshing(const PoissonMeshingOptions& options,
     args_cstr.push_back(arg.c_str());
   }
 
-  if (PoissonRecon(args_cstr.size(), const_cast<char**>(args_cstr.data())) !=
-      EXIT_SUCCESS) {
+  const int poisson_status =
+      PoissonRecon(args_cstr.size(), const_cast<char**>(args_cstr.data()));
+  if (poisson_input_path != input_path) {
+    std::remove(poisson_input_path.c_str());
+  }
+  if (poisson_status != EXIT_SUCCESS) {
     return false;
   }
 
@@ -221,6 +441,31 @@ class DelaunayMeshingInput {
   std::vector<Image> images;
   std::vector<Point> points;
 
+  // Extract the subset of points with the given indices and their image
+  // observations, where the visible images of each point are given.
+  DelaunayMeshingInput ExtractPoints(
+      const std::vector<size_t>& point_idxs,
+      const std::vector<std::vector<uint32_t>>& points_image_idxs) const {
+    DelaunayMeshingInput subset;
+    subset.cameras = cameras;
+    subset.images.reserve(images.size());
+    for (const auto& image : images) {
+      DelaunayMeshingInput::Image subset_image;
+      subset_image.camera_id = image.camera_id;
+      subset_image.proj_matrix = image.proj_matrix;
+      subset_image.proj_center = image.proj_center;
+      subset.images.push_back(subset_image);
+    }
+    subset.points.reserve(point_idxs.size());
+    for (const size_t point_idx : point_idxs) {
+      for (const uint32_t image_idx : points_image_idxs.at(point_idx)) {
+        subset.images[image_idx].point_idxs.push_back(subset.points.size());
+      }
+      subset.points.push_back(points[point_idx]);
+    }
+    return subset;
+  }
+
   void ReadSparseReconstruction(const std::string& path) {
     Reconstruction reconstruction;
     reconstruction.Read(path);
@@ -260,7 +505,9 @@ class DelaunayMeshingInput {
     }
   }
 
-  void ReadDenseReconstruction(const std::string& path) {
+  void ReadDenseReconstruction(const std::string& path,
+                               const double downsample_voxel_size,
+                               const int num_threads) {
     {
       Reconstruction reconstruction;
       reconstruction.Read(JoinPaths(path, "sparse"));
@@ -278,7 +525,8 @@ class DelaunayMeshingInput {
       }
     }
 
-    const auto& ply_points = ReadPly(JoinPaths(path, "fused.ply"));
+    std::vector<PlyPoint> ply_points =
+        ReadPly(JoinPaths(path, "fused.ply"), num_threads);
 
     const std::string vis_path = JoinPaths(path, "fused.ply.vis");
     std::fstream vis_file(vis_path, std::ios::in | std::ios::binary);
@@ -287,38 +535,80 @@ class DelaunayMeshingInput {
     const size_t vis_num_points = ReadBinaryLittleEndian<uint64_t>(&vis_file);
     THROW_CHECK_EQ(vis_num_points, ply_points.size());
 
+    // Index of the downsampled point for each fused point.
+    std::vector<size_t> point_idxs;
+    if (downsample_voxel_size > 0) {
+      ply_points =
+          DownsamplePlyPoints(ply_points, downsample_voxel_size, &point_idxs);
+      LOG(INFO) << StringPrintf("Downsampled %d to %d points",
+                                vis_num_points,
+                                ply_points.size());
+    }
+
+    std::vector<std::vector<uint32_t>> points_image_idxs(ply_points.size());
+    for (size_t i = 0; i < vis_num_points; ++i) {
+      auto& point_image_idxs =
+          points_image_idxs[point_idxs.empty() ? i : point_idxs[i]];
+      const uint32_t num_visible_images =
+          ReadBinaryLittleEndian<uint32_t>(&vis_file);
+      for (uint32_t j = 0; j < num_visible_images; ++j) {
+        point_image_idxs.push_back(ReadBinaryLittleEndian<uint32_t>(&vis_file));
+      }
+    }
+
     points.reserve(ply_points.size());
-    for (const auto& ply_point : ply_points) {
-      const int point_idx = points.size();
+    for (size_t point_idx = 0; point_idx < ply_points.size(); ++point_idx) {
+      const auto& ply_point = ply_points[point_idx];
+      // Merged points may share visible images.
+      auto& point_image_idxs = points_image_idxs[point_idx];
+      std::sort(point_image_idxs.begin(), point_image_idxs.end());
+      point_image_idxs.erase(
+          std::unique(point_image_idxs.begin(), point_image_idxs.end()),
+          point_image_idxs.end());
       DelaunayMeshingInput::Point input_point;
       input_point.position =
           Eigen::Vector3f(ply_point.x, ply_point.y, ply_point.z);
-      input_point.num_visible_images =
-          ReadBinaryLittleEndian<uint32_t>(&vis_file);
-      for (uint32_t i = 0; i < input_point.num_visible_images; ++i) {
-        const int image_idx = ReadBinaryLittleEndian<uint32_t>(&vis_file);
+      input_point.num_visible_images = point_image_idxs.size();
+      for (const uint32_t image_idx : point_image_idxs) {
         images.at(image_idx).point_idxs.push_back(point_idx);
       }
       points.push_back(input_point);
     }
   }
 
-  Delaunay CreateDelaunayTriangulation() const {
+  Delaunay CreateDelaunayTriangulation(const int num_threads) const {
     std::vector<Delaunay::Point> delaunay_points(points.size());
     for (size_t i = 0; i < points.size(); ++i) {
       delaunay_points[i] = Delaunay::Point(points[i].position.x(),
                                            points[i].position.y(),
                                            points[i].position.z());
     }
+#if defined(CGAL_LINKED_WITH_TBB)
+    if (num_threads > 1 && !delaunay_points.empty()) {
+      // Concurrent insertion locks the cells in a regular grid over the
+      // bounding box of the points.
+      Delaunay::Lock_data_structure locking_ds(
+          CGAL::bbox_3(delaunay_points.begin(), delaunay_points.end()),
+          /*num_grid_cells_per_axis=*/50);
+      Delaunay triangulation(&locking_ds);
+      tbb::task_arena arena(num_threads);
+      arena.execute([&]() {
+        triangulation.insert(delaunay_points.begin(), delaunay_points.end());
+      });
+      triangulation.set_lock_data_structure(nullptr);
+      return triangulation;
+    }
+#endif  // CGAL_LINKED_WITH_TBB
     return Delaunay(delaunay_points.begin(), delaunay_points.end());
   }
 
-  Delaunay CreateSubSampledDelaunayTriangulation(
-      const float max_proj_dist, const float max_depth_dist) const {
+  Delaunay CreateSubSampledDelaunayTriangulation(const float max_proj_dist,
+                                                 const float max_depth_dist,
+                                                 const int num_threads) const {
     THROW_CHECK_GE(max_proj_dist, 0);
 
     if (max_proj_dist == 0) {
-      return CreateDelaunayTriangulation();
+      return CreateDelaunayTriangulation(num_threads);
     }
 
     std::vector<std::vector<uint32_t>> points_visible_image_idxs(points.size());
@@ -701,10 +991,12 @@ PlyMesh DelaunayMeshing(const DelaunayMeshingOptions& options,
                         const DelaunayMeshingInput& input_data) {
   THROW_CHECK(options.Check());
 
+  const int num_threads = GetEffectiveNumThreads(options.num_threads);
+
   // Create a delaunay triangulation of all input points.
   LOG(INFO) << "Triangulating points...";
   const auto triangulation = input_data.CreateSubSampledDelaunayTriangulation(
-      options.max_proj_dist, options.max_depth_dist);
+      options.max_proj_dist, options.max_depth_dist, num_threads);
 
   // Helper class to efficiently trace rays through the triangulation.
   LOG(INFO) << "Initializing ray tracer...";
@@ -729,26 +1021,46 @@ PlyMesh DelaunayMeshing(const DelaunayMeshingOptions& options,
     cell_graph_data.emplace(it, DelaunayCellData(cell_graph_data.size()));
   }
 
+  // Split the observations of each image into blocks, such that the viewing
+  // rays are cast in parallel across points and not only across images. This
+  // keeps all threads busy for few images with many observations each.
+  struct IntegrationTask {
+    size_t image_idx;
+    size_t begin_point_idx;
+    size_t end_point_idx;
+  };
+
+  std::vector<IntegrationTask> integration_tasks;
+  const size_t kNumPointsPerTask = 100000;
+  for (size_t image_idx = 0; image_idx < input_data.images.size();
+       ++image_idx) {
+    const size_t num_points = input_data.images[image_idx].point_idxs.size();
+    for (size_t begin = 0; begin < num_points; begin += kNumPointsPerTask) {
+      integration_tasks.push_back(
+          {image_idx, begin, std::min(begin + kNumPointsPerTask, num_points)});
+    }
+  }
+
   // Spawn threads for parallelized integration of images.
-  const int num_threads = GetEffectiveNumThreads(options.num_threads);
   ThreadPool thread_pool(num_threads);
   JobQueue<CellGraphData> result_queue(num_threads);
 
-  // Function that accumulates edge weights in the s-t graph for a single image.
-  auto IntegreateImage = [&](const size_t image_idx) {
-    // Accumulated weights for the current image only.
+  // Function that accumulates edge weights in the s-t graph for a block of
+  // observations of a single image.
+  auto IntegreateImage = [&](const IntegrationTask& task) {
+    // Accumulated weights for the current block of observations only.
     CellGraphData image_cell_graph_data;
 
     // Image that is integrated into s-t graph.
-    const auto& image = input_data.images[image_idx];
+    const auto& image = input_data.images[task.image_idx];
     const K::Point_3 image_position = EigenToCGAL(image.proj_center);
 
     // Intersections between viewing rays and Delaunay triangulation.
     std::vector<DelaunayTriangulationRayCaster::Intersection> intersections;
 
-    // Iterate through all image observations and integrate them into the graph.
-    for (const auto& point_idx : image.point_idxs) {
-      const auto& point = input_data.points[point_idx];
+    // Iterate through the image observations and integrate them into the graph.
+    for (size_t i = task.begin_point_idx; i < task.end_point_idx; ++i) {
+      const auto& point = input_data.points[image.point_idxs[i]];
 
       // Likelihood of the point observation.
       const double alpha = edge_weight_computer.ComputeVisibilityProb(
@@ -828,29 +1140,29 @@ PlyMesh DelaunayMeshing(const DelaunayMeshingOptions& options,
     THROW_CHECK(result_queue.Push(std::move(image_cell_graph_data)));
   };
 
-  // Add first batch of images to the thread job queue.
-  size_t image_idx = 0;
+  // Add first batch of tasks to the thread job queue.
+  size_t task_idx = 0;
   const size_t init_num_tasks =
-      std::min(input_data.images.size(), 2 * thread_pool.NumThreads());
-  for (; image_idx < init_num_tasks; ++image_idx) {
-    thread_pool.AddTask(IntegreateImage, image_idx);
+      std::min(integration_tasks.size(), 2 * thread_pool.NumThreads());
+  for (; task_idx < init_num_tasks; ++task_idx) {
+    thread_pool.AddTask(IntegreateImage, integration_tasks[task_idx]);
   }
 
-  // Pop the integrated images from the thread job queue and integrate their
+  // Pop the integrated blocks from the thread job queue and integrate their
   // accumulated weights into the global graph.
-  for (size_t i = 0; i < input_data.images.size(); ++i) {
+  for (size_t i = 0; i < integration_tasks.size(); ++i) {
     Timer timer;
     timer.Start();
 
-    LOG(INFO) << StringPrintf("Integrating image [%d/%d]",
+    LOG(INFO) << StringPrintf("Integrating observations [%d/%d]",
                               i + 1,
-                              input_data.images.size())
+                              integration_tasks.size())
               << std::flush;
 
-    // Push the next image to the queue.
-    if (image_idx < input_data.images.size()) {
-      thread_pool.AddTask(IntegreateImage, image_idx);
-      image_idx += 1;
+    // Push the next task to the queue.
+    if (task_idx < integration_tasks.size()) {
+      thread_pool.AddTask(IntegreateImage, integration_tasks[task_idx]);
+      task_idx += 1;
     }
 
     // Pop the next results from the queue.
@@ -877,7 +1189,12 @@ PlyMesh DelaunayMeshing(const DelaunayMeshingOptions& options,
 
   // Each oriented facet in the Delaunay triangulation corresponds to a directed
   // edge and each cell corresponds to a node in the graph.
-  MinSTGraphCut<size_t, float> graph_cut(cell_graph_data.size());
+  MinSTGraphCut<size_t, float> graph_cut(
+      cell_graph_data.size(),
+      options.parallel_graph_cut
+          ? MinSTGraphCutAlgorithm::PARALLEL_PUSH_RELABEL
+          : MinSTGraphCutAlgorithm::BOYKOV_KOLMOGOROV,
+      num_threads);
 
   // Iterate all cells in the triangulation.
   for (auto& cell_data : cell_graph_data) {
@@ -977,6 +1294,11 @@ PlyMesh DelaunayMeshing(const DelaunayMeshingOptions& options,
 
   PlyMesh mesh;
 
+  // The cut may be empty, e.g., for the sparse points of a single tile.
+  if (surface_facets.empty()) {
+    return mesh;
+  }
+
   std::unordered_map<const Delaunay::Vertex_handle, size_t>
       surface_vertex_indices;
   surface_vertex_indices.reserve(surface_vertices.size());
@@ -1014,6 +1336,49 @@ PlyMesh DelaunayMeshing(const DelaunayMeshingOptions& options,
   return mesh;
 }
 
+PlyMesh TiledDelaunayMeshing(const DelaunayMeshingOptions& options,
+                             const DelaunayMeshingInput& input_data) {
+  if (options.tile_size == 0) {
+    return DelaunayMeshing(options, input_data);
+  }
+
+  const std::vector<MeshingTile> tiles = PartitionMeshingTiles(
+      input_data.points.size(),
+      [&input_data](const size_t point_idx) {
+        return input_data.points[point_idx].position;
+      },
+      options.tile_size,
+      options.tile_overlap);
+
+  std::vector<std::vector<uint32_t>> points_image_idxs(
+      input_data.points.size());
+  for (size_t image_idx = 0; image_idx < input_data.images.size();
+       ++image_idx) {
+    for (const size_t point_idx : input_data.images[image_idx].point_idxs) {
+      points_image_idxs[point_idx].push_back(image_idx);
+    }
+  }
+
+  PlyMesh mesh;
+  for (size_t tile_idx = 0; tile_idx < tiles.size(); ++tile_idx) {
+    const MeshingTile& tile = tiles[tile_idx];
+    LOG(INFO) << StringPrintf("Meshing tile [%d/%d] with %d points",
+                              tile_idx + 1,
+                              tiles.size(),
+                              tile.point_idxs.size());
+    // Skip tiles too small to be tetrahedralized.
+    if (tile.point_idxs.size() < 4) {
+      continue;
+    }
+    const DelaunayMeshingInput tile_input_data =
+        input_data.ExtractPoints(tile.point_idxs, points_image_idxs);
+    AppendClippedTileMesh(
+        tile, DelaunayMeshing(options, tile_input_data), &mesh);
+  }
+
+  return mesh;
+}
+
 void SparseDelaunayMeshing(const DelaunayMeshingOptions& options,
                            const std::string& input_path,
                            const std::string& output_path) {
@@ -1023,7 +1388,7 @@ void SparseDelaunayMeshing(const DelaunayMeshingOptions& options,
   DelaunayMeshingInput input_data;
   input_data.ReadSparseReconstruction(input_path);
 
-  const auto mesh = DelaunayMeshing(options, input_data);
+  const auto mesh = TiledDelaunayMeshing(options, input_data);
 
   LOG(INFO) << "Writing surface mesh...";
   WriteBinaryPlyMesh(output_path, mesh);
@@ -1038,9 +1403,10 @@ void DenseDelaunayMeshing(const DelaunayMeshingOptions& options,
   timer.Start();
 
   DelaunayMeshingInput input_data;
-  input_data.ReadDenseReconstruction(input_path);
+  input_data.ReadDenseReconstruction(
+      input_path, options.downsample_voxel_size, options.num_threads);
 
-  const auto mesh = DelaunayMeshing(options, input_data);
+  const auto mesh = TiledDelaunayMeshing(options, input_data);
 
   LOG(INFO) << "Writing surface mesh...";
   WriteBinaryPlyMesh(output_path, mesh);
@@ -61,6 +61,22 @@ struct PoissonMeshingOptions {
   // The number of threads used for the Poisson reconstruction.
   int num_threads = -1;
 
+  // If positive, the input points are downsampled on a voxel grid of this size
+  // before the reconstruction, since its runtime and memory grow with the
+  // number of points. The size is in the units of the input points.
+  double downsample_voxel_size = 0.0;
+
+  // If positive, the scene is partitioned into a regular grid of cubic tiles
+  // of this size, which are meshed independently and clipped at their
+  // boundaries, such that the memory of the reconstruction is bounded by the
+  // number of points per tile. The size is in the units of the input points.
+  double tile_size = 0.0;
+
+  // The overlap of neighboring tiles relative to the tile size. Each tile is
+  // meshed with all points within its overlap to avoid artifacts at the
+  // clipped boundaries.
+  double tile_overlap = 0.1;
+
   bool Check() const;
 };
 
@@ -96,6 +112,24 @@ struct DelaunayMeshingOptions {
   // The number of threads to use for reconstruction. Default is all threads.
   int num_threads = -1;
 
+  // Whether to compute the graph-cut with the parallel push-relabel instead of
+  // the Boykov-Kolmogorov max-flow algorithm, which is faster for large
+  // triangulations.
+  bool parallel_graph_cut = false;
+
+  // If positive, the fused points of dense input are downsampled on a voxel
+  // grid of this size before the triangulation and the visibility of the
+  // points within a voxel is merged. The size is in the units of the points.
+  double downsample_voxel_size = 0.0;
+
+  // If positive, the scene is partitioned into a regular grid of cubic tiles
+  // of this size, which are triangulated and meshed independently and clipped
+  // at their boundaries. The size is in the units of the points.
+  double tile_size = 0.0;
+
+  // The overlap of neighboring tiles relative to the tile size.
+  double tile_overlap = 0.1;
+
   bool Check() const;
 };
 
@@ -165,6 +165,129 @@ std::vector<std::vector<int>> Model::GetMaxOverlappingImages(
   return overlapping_images;
 }
 
+std::vector<std::vector<int>> Model::SelectSourceImages(
+    const size_t num_images,
+    const double min_triangulation_angle,
+    const double min_score_ratio) const {
+  const float min_triangulation_angle_rad = DegToRad(min_triangulation_angle);
+
+  std::vector<Eigen::Vector3f> proj_centers(images.size());
+  for (size_t image_idx = 0; image_idx < images.size(); ++image_idx) {
+    const auto& image = images[image_idx];
+    ComputeProjectionCenter(
+        image.GetR(), image.GetT(), proj_centers[image_idx].data());
+  }
+
+  std::vector<std::vector<int>> image_point_idxs(images.size());
+  for (size_t point_idx = 0; point_idx < points.size(); ++point_idx) {
+    for (const int image_idx : points[point_idx].track) {
+      image_point_idxs.at(image_idx).push_back(point_idx);
+    }
+  }
+
+  // Angle weight of Yao et al., "MVSNet: Depth Inference for Unstructured
+  // Multi-view Stereo", 2018, and resolution weight of Goesele et al.,
+  // "Multi-View Stereo for Community Photo Collections", 2007.
+  const float kOptimalTriangulationAngle = DegToRad(5.0f);
+  const float kSigmaBelow = DegToRad(1.0f);
+  const float kSigmaAbove = DegToRad(10.0f);
+  const auto AngleWeight = [&](const float angle) {
+    const float sigma = angle <= kOptimalTriangulationAngle ? kSigmaBelow
+                                                             : kSigmaAbove;
+    const float diff = angle - kOptimalTriangulationAngle;
+    return std::exp(-diff * diff / (2 * sigma * sigma));
+  };
+  const auto ResolutionWeight = [](const float ratio) {
+    if (ratio >= 2) {
+      return 2 / ratio;
+    } else if (ratio >= 1) {
+      return 1.0f;
+    } else {
+      return ratio;
+    }
+  };
+  const auto Resolution = [this](const int image_idx,
+                                 const Eigen::Vector3f& X) {
+    const auto& image = images[image_idx];
+    const float depth =
+        Eigen::Map<const Eigen::Vector3f>(&image.GetR()[6]).dot(X) +
+        image.GetT()[2];
+    return depth > 0 ? image.GetK()[0] / depth : 0.0f;
+  };
+
+  std::vector<std::vector<int>> src_images(images.size());
+  for (size_t ref_image_idx = 0; ref_image_idx < images.size();
+       ++ref_image_idx) {
+    const auto& ref_point_idxs = image_point_idxs[ref_image_idx];
+
+    // Compute the weight of all shared points for each candidate image.
+    std::map<int, std::vector<std::pair<int, float>>> candidate_point_weights;
+    for (size_t i = 0; i < ref_point_idxs.size(); ++i) {
+      const auto& point = points[ref_point_idxs[i]];
+      const Eigen::Vector3f X(point.x, point.y, point.z);
+      const float ref_resolution = Resolution(ref_image_idx, X);
+      if (ref_resolution <= 0) {
+        continue;
+      }
+      const Eigen::Vector3f ref_ray =
+          (X - proj_centers[ref_image_idx]).normalized();
+      for (const int src_image_idx : point.track) {
+        if (src_image_idx == static_cast<int>(ref_image_idx)) {
+          continue;
+        }
+        const float angle = std::acos(std::min(
+            1.0f, ref_ray.dot((X - proj_centers[src_image_idx]).normalized())));
+        if (angle < min_triangulation_angle_rad) {
+          continue;
+        }
+        const float weight =
+            AngleWeight(angle) *
+            ResolutionWeight(Resolution(src_image_idx, X) / ref_resolution);
+        if (weight > 0) {
+          candidate_point_weights[src_image_idx].emplace_back(i, weight);
+        }
+      }
+    }
+
+    std::vector<int> point_num_covered(ref_point_idxs.size(), 0);
+    float first_score = 0;
+    while (src_images[ref_image_idx].size() < num_images &&
+           !candidate_point_weights.empty()) {
+      auto best_candidate = candidate_point_weights.end();
+      float best_score = 0;
+      for (auto it = candidate_point_weights.begin();
+           it != candidate_point_weights.end();
+           ++it) {
+        float score = 0;
+        for (const auto& point_weight : it->second) {
+          score += std::ldexp(point_weight.second,
+                              -point_num_covered[point_weight.first]);
+        }
+        if (score > best_score) {
+          best_score = score;
+          best_candidate = it;
+        }
+      }
+
+      if (best_candidate == candidate_point_weights.end() ||
+          best_score < min_score_ratio * first_score) {
+        break;
+      }
+      if (first_score == 0) {
+        first_score = best_score;
+      }
+
+      src_images[ref_image_idx].push_back(best_candidate->first);
+      for (const auto& point_weight : best_candidate->second) {
+        point_num_covered[point_weight.first] += 1;
+      }
+      candidate_point_weights.erase(best_candidate);
+    }
+  }
+
+  return src_images;
+}
+
 const std::vector<std::vector<int>>& Model::GetMaxOverlappingImagesFromPMVS()
     const {
   return pmvs_vis_dat_;
@@ -212,6 +335,119 @@ std::vector<std::pair<float, float>> Model::ComputeDepthRanges() const {
   return depth_ranges;
 }
 
+DepthMap Model::ComputeInterpolatedDepthMap(const int image_idx,
+                                            const float depth_min,
+                                            const float depth_max,
+                                            const int cell_size) const {
+  THROW_CHECK_GE(image_idx, 0);
+  THROW_CHECK_LT(image_idx, images.size());
+  THROW_CHECK_GT(cell_size, 0);
+
+  const auto& image = images[image_idx];
+  const int width = image.GetWidth();
+  const int height = image.GetHeight();
+  const int grid_width = (width + cell_size - 1) / cell_size;
+  const int grid_height = (height + cell_size - 1) / cell_size;
+
+  const Eigen::Map<const Eigen::Matrix<float, 3, 4, Eigen::RowMajor>> P(
+      image.GetP());
+
+  // Average the depths of the observed points per grid cell.
+  std::vector<float> cell_depths(grid_width * grid_height, 0.0f);
+  std::vector<int> cell_num_points(grid_width * grid_height, 0);
+  for (const auto& point : points) {
+    if (std::find(point.track.begin(), point.track.end(), image_idx) ==
+        point.track.end()) {
+      continue;
+    }
+    const Eigen::Vector3f proj =
+        P * Eigen::Vector4f(point.x, point.y, point.z, 1);
+    const float depth = proj.z();
+    if (depth < depth_min || depth > depth_max || depth <= 0) {
+      continue;
+    }
+    const int col = static_cast<int>(std::floor(proj.x() / depth));
+    const int row = static_cast<int>(std::floor(proj.y() / depth));
+    if (col < 0 || col >= width || row < 0 || row >= height) {
+      continue;
+    }
+    const int cell_idx = (row / cell_size) * grid_width + col / cell_size;
+    cell_depths[cell_idx] += depth;
+    cell_num_points[cell_idx] += 1;
+  }
+
+  std::vector<int> queue;
+  queue.reserve(cell_depths.size());
+  for (size_t cell_idx = 0; cell_idx < cell_depths.size(); ++cell_idx) {
+    if (cell_num_points[cell_idx] > 0) {
+      cell_depths[cell_idx] /= cell_num_points[cell_idx];
+      queue.push_back(cell_idx);
+    }
+  }
+
+  if (queue.empty()) {
+    return DepthMap();
+  }
+
+  // Fill the empty cells in breadth-first order from their nearest non-empty
+  // cells, which is linear in the number of cells.
+  for (size_t i = 0; i < queue.size(); ++i) {
+    const int cell_idx = queue[i];
+    const int cell_row = cell_idx / grid_width;
+    const int cell_col = cell_idx % grid_width;
+    const int neighbor_rows[4] = {
+        cell_row - 1, cell_row + 1, cell_row, cell_row};
+    const int neighbor_cols[4] = {
+        cell_col, cell_col, cell_col - 1, cell_col + 1};
+    for (int j = 0; j < 4; ++j) {
+      if (neighbor_rows[j] < 0 || neighbor_rows[j] >= grid_height ||
+          neighbor_cols[j] < 0 || neighbor_cols[j] >= grid_width) {
+        continue;
+      }
+      const int neighbor_idx = neighbor_rows[j] * grid_width + neighbor_cols[j];
+      if (cell_num_points[neighbor_idx] == 0) {
+        cell_depths[neighbor_idx] = cell_depths[cell_idx];
+        cell_num_points[neighbor_idx] = -1;
+        queue.push_back(neighbor_idx);
+      }
+    }
+  }
+
+  // Bilinearly interpolate the depths between the cell centers.
+  const auto GridCoord = [cell_size](const int coord,
+                                     const int grid_size,
+                                     int* coord0,
+                                     int* coord1) {
+    const float grid_coord = std::max(0.0f, (coord + 0.5f) / cell_size - 0.5f);
+    *coord0 = std::min(static_cast<int>(grid_coord), grid_size - 1);
+    *coord1 = std::min(*coord0 + 1, grid_size - 1);
+    return std::min(grid_coord - *coord0, 1.0f);
+  };
+
+  DepthMap depth_map(width, height, depth_min, depth_max);
+  for (int row = 0; row < height; ++row) {
+    int cell_row0;
+    int cell_row1;
+    const float weight_row =
+        GridCoord(row, grid_height, &cell_row0, &cell_row1);
+    for (int col = 0; col < width; ++col) {
+      int cell_col0;
+      int cell_col1;
+      const float weight_col =
+          GridCoord(col, grid_width, &cell_col0, &cell_col1);
+      const float depth0 =
+          (1 - weight_col) * cell_depths[cell_row0 * grid_width + cell_col0] +
+          weight_col * cell_depths[cell_row0 * grid_width + cell_col1];
+      const float depth1 =
+          (1 - weight_col) * cell_depths[cell_row1 * grid_width + cell_col0] +
+          weight_col * cell_depths[cell_row1 * grid_width + cell_col1];
+      depth_map.Set(row, col, (1 - weight_row) * depth0 + weight_row * depth1);
+    }
+  }
+
+  return depth_map;
+}
+
 std::vector<std::map<int, int>> Model::ComputeSharedPoints() const {
   std::vector<std::map<int, int>> shared_points(images.size());
   for (const auto& point : points) {
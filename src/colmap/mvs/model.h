@@ -70,12 +70,37 @@ struct Model {
   std::vector<std::vector<int>> GetMaxOverlappingImages(
       size_t num_images, double min_triangulation_angle) const;
 
+  // For each image, greedily select up to the given number of source images
+  // for multi-view stereo with a view selection model. Each shared point
+  // contributes to the score of a source image based on its triangulation
+  // angle, which ideally is around 5 degrees, and the ratio of the image
+  // resolutions at the point. The contribution of a point is halved for every
+  // already selected image that observes it, which favors source images
+  // covering different parts of the reference image. Selection stops early
+  // once the score of the next image drops below the given ratio of the score
+  // of the first image. The images are sorted by their selection order.
+  std::vector<std::vector<int>> SelectSourceImages(
+      size_t num_images,
+      double min_triangulation_angle,
+      double min_score_ratio) const;
+
   // Get the overlapping images defined in the vis.dat file.
   const std::vector<std::vector<int>>& GetMaxOverlappingImagesFromPMVS() const;
 
   // Compute the robust minimum and maximum depths from the sparse point cloud.
   std::vector<std::pair<float, float>> ComputeDepthRanges() const;
 
+  // Compute a dense depth map of the image by interpolating the depths of its
+  // observed sparse points. The depths are averaged on a regular grid with the
+  // given cell size in pixels, empty cells are filled from their nearest
+  // non-empty cell, and the grid is bilinearly interpolated at every pixel.
+  // Only points with a depth in the given range are considered. Returns an
+  // empty depth map, if there are no such points.
+  DepthMap ComputeInterpolatedDepthMap(int image_idx,
+                                       float depth_min,
+                                       float depth_max,
+                                       int cell_size = 16) const;
+
   // Compute the number of shared points between all overlapping images.
   std::vector<std::map<int, int>> ComputeSharedPoints() const;
 
@@ -0,0 +1,139 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/mvs/model.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace mvs {
+namespace {
+
+Model CreateModelWithPlane(const float depth) {
+  const float K[9] = {10, 0, 16, 0, 10, 12, 0, 0, 1};
+  const float R[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+  const float T[3] = {0, 0, 0};
+  Model model;
+  model.images.emplace_back("", 32, 24, K, R, T);
+  model.images.emplace_back("", 32, 24, K, R, T);
+  for (const float x : {-1.0f, 1.0f}) {
+    Model::Point point;
+    point.x = x * depth;
+    point.y = 0;
+    point.z = depth;
+    point.track = {0};
+    model.points.push_back(point);
+  }
+  return model;
+}
+
+TEST(Model, SelectSourceImages) {
+  const float K[9] = {10, 0, 16, 0, 10, 12, 0, 0, 1};
+  const float R[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+  Model model;
+  // The reference image, two images with an ideal baseline on both sides,
+  // and one image with a too small baseline.
+  for (const float x : {0.0f, 0.87f, 0.05f, -0.87f}) {
+    const float T[3] = {-x, 0, 0};
+    model.images.emplace_back("", 32, 24, K, R, T);
+  }
+  for (int i = -5; i <= 5; ++i) {
+    Model::Point point;
+    point.x = i;
+    point.z = 10;
+    point.track = {0, 1, 2, 3};
+    model.points.push_back(point);
+  }
+
+  const auto src_images =
+      model.SelectSourceImages(/*num_images=*/5,
+                               /*min_triangulation_angle=*/1,
+                               /*min_score_ratio=*/0.05);
+  ASSERT_EQ(src_images.size(), 4);
+  EXPECT_EQ(src_images[0], std::vector<int>({1, 3}));
+
+  // The second image only contributes half of the score of the first image,
+  // since it observes the same points.
+  EXPECT_EQ(model
+                .SelectSourceImages(/*num_images=*/5,
+                                    /*min_triangulation_angle=*/1,
+                                    /*min_score_ratio=*/0.6)[0]
+                .size(),
+            1);
+  EXPECT_EQ(model.SelectSourceImages(/*num_images=*/1,
+                                     /*min_triangulation_angle=*/1,
+                                     /*min_score_ratio=*/0)[0]
+                .size(),
+            1);
+}
+
+TEST(Model, ComputeInterpolatedDepthMap) {
+  const Model model = CreateModelWithPlane(2);
+  const DepthMap depth_map =
+      model.ComputeInterpolatedDepthMap(/*image_idx=*/0,
+                                        /*depth_min=*/1,
+                                        /*depth_max=*/3,
+                                        /*cell_size=*/4);
+  EXPECT_EQ(depth_map.GetWidth(), 32);
+  EXPECT_EQ(depth_map.GetHeight(), 24);
+  EXPECT_EQ(depth_map.GetDepthMin(), 1);
+  EXPECT_EQ(depth_map.GetDepthMax(), 3);
+  for (size_t row = 0; row < depth_map.GetHeight(); ++row) {
+    for (size_t col = 0; col < depth_map.GetWidth(); ++col) {
+      EXPECT_FLOAT_EQ(depth_map.Get(row, col), 2);
+    }
+  }
+}
+
+TEST(Model, ComputeInterpolatedDepthMapSlanted) {
+  Model model = CreateModelWithPlane(2);
+  model.points[1].x = 4;
+  model.points[1].z = 4;
+  const DepthMap depth_map = model.ComputeInterpolatedDepthMap(0, 1, 5, 4);
+  EXPECT_FLOAT_EQ(depth_map.Get(12, 0), 2);
+  EXPECT_FLOAT_EQ(depth_map.Get(12, 31), 4);
+  for (size_t col = 1; col < depth_map.GetWidth(); ++col) {
+    EXPECT_GE(depth_map.Get(12, col), depth_map.Get(12, col - 1));
+  }
+}
+
+TEST(Model, ComputeInterpolatedDepthMapOutsideRange) {
+  const Model model = CreateModelWithPlane(2);
+  EXPECT_EQ(model.ComputeInterpolatedDepthMap(0, 3, 4).GetWidth(), 0);
+}
+
+TEST(Model, ComputeInterpolatedDepthMapNotObserved) {
+  const Model model = CreateModelWithPlane(2);
+  EXPECT_EQ(model.ComputeInterpolatedDepthMap(1, 1, 3).GetWidth(), 0);
+}
+
+}  // namespace
+}  // namespace mvs
+}  // namespace colmap
@@ -30,9 +30,56 @@
 #include "colmap/mvs/normal_map.h"
 
 #include "colmap/image/warp.h"
+#include "colmap/mvs/map_compression.h"
+
+#include <fstream>
 
 namespace colmap {
 namespace mvs {
+namespace {
+
+// Octahedral encoding of unit vectors, see Cigolle et al., "A Survey of
+// Efficient Representations for Independent Unit Vectors", 2014. The
+// coordinates are quantized to [1, 65535] and zero is reserved for invalid
+// pixels without a normal.
+void EncodeOctahedral(const Eigen::Vector3f& normal,
+                      uint16_t* u,
+                      uint16_t* v) {
+  const float l1_norm = normal.cwiseAbs().sum();
+  if (l1_norm == 0) {
+    *u = 0;
+    *v = 0;
+    return;
+  }
+  float x = normal.x() / l1_norm;
+  float y = normal.y() / l1_norm;
+  if (normal.z() < 0) {
+    const float wrapped_x = (1 - std::abs(y)) * (x >= 0 ? 1 : -1);
+    const float wrapped_y = (1 - std::abs(x)) * (y >= 0 ? 1 : -1);
+    x = wrapped_x;
+    y = wrapped_y;
+  }
+  *u = 1 + static_cast<uint16_t>(std::round((x + 1) * 0.5f * 65534));
+  *v = 1 + static_cast<uint16_t>(std::round((y + 1) * 0.5f * 65534));
+}
+
+Eigen::Vector3f DecodeOctahedral(const uint16_t u, const uint16_t v) {
+  if (u == 0) {
+    return Eigen::Vector3f::Zero();
+  }
+  Eigen::Vector3f normal;
+  normal.x() = (u - 1) / 65534.0f * 2 - 1;
+  normal.y() = (v - 1) / 65534.0f * 2 - 1;
+  normal.z() = 1 - std::abs(normal.x()) - std::abs(normal.y());
+  if (normal.z() < 0) {
+    const float x = normal.x();
+    normal.x() = (1 - std::abs(normal.y())) * (x >= 0 ? 1 : -1);
+    normal.y() = (1 - std::abs(x)) * (normal.y() >= 0 ? 1 : -1);
+  }
+  return normal.normalized();
+}
+
+}  // namespace
 
 NormalMap::NormalMap() : Mat<float>(0, 0, 3) {}
 
@@ -72,18 +119,20 @@ void NormalMap::Rescale(const float factor) {
 
   data_.shrink_to_fit();
 
-  // Re-normalize the normal vectors.
-  for (size_t r = 0; r < height_; ++r) {
-    for (size_t c = 0; c < width_; ++c) {
-      Eigen::Vector3f normal(Get(r, c, 0), Get(r, c, 1), Get(r, c, 2));
-      const float squared_norm = normal.squaredNorm();
-      if (squared_norm > 0) {
-        normal /= std::sqrt(squared_norm);
-      }
-      Set(r, c, 0, normal(0));
-      Set(r, c, 1, normal(1));
-      Set(r, c, 2, normal(2));
-    }
+  // Re-normalize the normal vectors. The components are stored in separate
+  // slices, such that the loop over the pixels is vectorized.
+  float* normal_x = GetSlicePtr(0);
+  float* normal_y = GetSlicePtr(1);
+  float* normal_z = GetSlicePtr(2);
+  const size_t num_pixels = width_ * height_;
+  for (size_t i = 0; i < num_pixels; ++i) {
+    const float squared_norm = normal_x[i] * normal_x[i] +
+                               normal_y[i] * normal_y[i] +
+                               normal_z[i] * normal_z[i];
+    const float inv_norm = squared_norm > 0 ? 1 / std::sqrt(squared_norm) : 1;
+    normal_x[i] *= inv_norm;
+    normal_y[i] *= inv_norm;
+    normal_z[i] *= inv_norm;
   }
 }
 
@@ -96,6 +145,55 @@ void NormalMap::Downsize(const size_t max_width, const size_t max_height) {
   Rescale(std::min(factor_x, factor_y));
 }
 
+void NormalMap::Read(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+  if (!ReadCompressedMapHeader(&file, &width_, &height_, &depth_)) {
+    file.close();
+    Mat<float>::Read(path);
+    return;
+  }
+
+  THROW_CHECK_GT(width_, 0) << path;
+  THROW_CHECK_GT(height_, 0) << path;
+  THROW_CHECK_EQ(depth_, 3) << path;
+
+  const size_t num_pixels = width_ * height_;
+  std::vector<uint16_t> values(2 * num_pixels);
+  ReadCompressedMapValues(&file, &values);
+  file.close();
+
+  data_.resize(3 * num_pixels);
+  for (size_t i = 0; i < num_pixels; ++i) {
+    const Eigen::Vector3f normal =
+        DecodeOctahedral(values[i], values[num_pixels + i]);
+    for (size_t d = 0; d < 3; ++d) {
+      data_[d * num_pixels + i] = normal(d);
+    }
+  }
+}
+
+void NormalMap::Write(const std::string& path, const bool compress) const {
+  if (!compress) {
+    Mat<float>::Write(path);
+    return;
+  }
+
+  const size_t num_pixels = width_ * height_;
+  std::vector<uint16_t> values(2 * num_pixels);
+  for (size_t i = 0; i < num_pixels; ++i) {
+    const Eigen::Vector3f normal(
+        data_[i], data_[num_pixels + i], data_[2 * num_pixels + i]);
+    EncodeOctahedral(normal, &values[i], &values[num_pixels + i]);
+  }
+
+  std::ofstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+  WriteCompressedMapHeader(width_, height_, depth_, &file);
+  WriteCompressedMapValues(values, &file);
+  file.close();
+}
+
 Bitmap NormalMap::ToBitmap() const {
   THROW_CHECK_GT(width_, 0);
   THROW_CHECK_GT(height_, 0);
@@ -48,6 +48,12 @@ class NormalMap : public Mat<float> {
   void Rescale(float factor);
   void Downsize(size_t max_width, size_t max_height);
 
+  // Read the normal map in the raw or compressed format. Write the normal map
+  // in the raw format or, if enabled, in the compressed format, which stores
+  // the normals in 16-bit octahedral encoding.
+  void Read(const std::string& path);
+  void Write(const std::string& path, bool compress = false) const;
+
   Bitmap ToBitmap() const;
 };
 
@@ -29,6 +29,9 @@
 
 #include "colmap/mvs/normal_map.h"
 
+#include "colmap/util/testing.h"
+
+#include <Eigen/Core>
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -94,6 +97,45 @@ TEST(NormalMap, ToBitmap) {
   EXPECT_EQ(color, BitmapColor<uint8_t>(37, 37, 0));
 }
 
+TEST(NormalMap, WriteReadCompressed) {
+  NormalMap normal_map(4, 3);
+  for (size_t row = 0; row < normal_map.GetHeight(); ++row) {
+    for (size_t col = 0; col < normal_map.GetWidth(); ++col) {
+      const Eigen::Vector3f normal =
+          Eigen::Vector3f(col - 1.5f, row - 1.0f, row % 2 ? 1 : -1)
+              .normalized();
+      for (size_t d = 0; d < 3; ++d) {
+        normal_map.Set(row, col, d, normal(d));
+      }
+    }
+  }
+  for (size_t d = 0; d < 3; ++d) {
+    normal_map.Set(1, 2, d, 0);
+  }
+
+  const std::string path = CreateTestDir() + "/normal_map.bin";
+  normal_map.Write(path, /*compress=*/true);
+  NormalMap read_normal_map;
+  read_normal_map.Read(path);
+  EXPECT_EQ(read_normal_map.GetWidth(), normal_map.GetWidth());
+  EXPECT_EQ(read_normal_map.GetHeight(), normal_map.GetHeight());
+  EXPECT_EQ(read_normal_map.GetDepth(), 3);
+  for (size_t row = 0; row < normal_map.GetHeight(); ++row) {
+    for (size_t col = 0; col < normal_map.GetWidth(); ++col) {
+      for (size_t d = 0; d < 3; ++d) {
+        EXPECT_NEAR(read_normal_map.Get(row, col, d),
+                    normal_map.Get(row, col, d),
+                    1e-4);
+      }
+    }
+  }
+
+  // The raw format can still be read.
+  normal_map.Write(path);
+  read_normal_map.Read(path);
+  EXPECT_EQ(read_normal_map.GetData(), normal_map.GetData());
+}
+
 }  // namespace
 }  // namespace mvs
 }  // namespace colmap
@@ -31,11 +31,23 @@
 
 #include "colmap/math/math.h"
 #include "colmap/mvs/consistency_graph.h"
-#include "colmap/mvs/patch_match_cuda.h"
+#include "colmap/mvs/patch_match_cpu.h"
 #include "colmap/mvs/workspace.h"
 #include "colmap/util/misc.h"
 
+#if defined(COLMAP_CUDA_ENABLED)
+#include "colmap/mvs/patch_match_cuda.h"
+#include "colmap/util/cuda.h"
+#endif  // COLMAP_CUDA_ENABLED
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <limits>
 #include <numeric>
+#include <set>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
 
 #define PrintOption(option) LOG(INFO) << #option ": " << option << std::endl
@@ -43,6 +55,262 @@
 namespace colmap {
 namespace mvs {
 
+namespace {
+
+// Resample the depth map with nearest neighbor interpolation, which, unlike
+// bilinear interpolation, does not create hypotheses across depth edges.
+DepthMap ResampleDepthMap(const DepthMap& depth_map,
+                          const size_t width,
+                          const size_t height) {
+  DepthMap resampled_depth_map(
+      width, height, depth_map.GetDepthMin(), depth_map.GetDepthMax());
+  const float scale_x = static_cast<float>(depth_map.GetWidth()) / width;
+  const float scale_y = static_cast<float>(depth_map.GetHeight()) / height;
+  for (size_t row = 0; row < height; ++row) {
+    const size_t src_row = std::min(static_cast<size_t>(row * scale_y),
+                                    depth_map.GetHeight() - 1);
+    for (size_t col = 0; col < width; ++col) {
+      const size_t src_col = std::min(static_cast<size_t>(col * scale_x),
+                                      depth_map.GetWidth() - 1);
+      resampled_depth_map.Set(row, col, depth_map.Get(src_row, src_col));
+    }
+  }
+  return resampled_depth_map;
+}
+
+NormalMap ResampleNormalMap(const NormalMap& normal_map,
+                           const size_t width,
+                           const size_t height) {
+  NormalMap resampled_normal_map(width, height);
+  const float scale_x = static_cast<float>(normal_map.GetWidth()) / width;
+  const float scale_y = static_cast<float>(normal_map.GetHeight()) / height;
+  for (size_t row = 0; row < height; ++row) {
+    const size_t src_row = std::min(static_cast<size_t>(row * scale_y),
+                                    normal_map.GetHeight() - 1);
+    for (size_t col = 0; col < width; ++col) {
+      const size_t src_col = std::min(static_cast<size_t>(col * scale_x),
+                                      normal_map.GetWidth() - 1);
+      for (size_t d = 0; d < 3; ++d) {
+        resampled_normal_map.Set(
+            row, col, d, normal_map.Get(src_row, src_col, d));
+      }
+    }
+  }
+  return resampled_normal_map;
+}
+
+DepthMap CropDepthMap(const DepthMap& depth_map,
+                      const size_t x,
+                      const size_t y,
+                      const size_t width,
+                      const size_t height) {
+  DepthMap cropped_depth_map(
+      width, height, depth_map.GetDepthMin(), depth_map.GetDepthMax());
+  for (size_t row = 0; row < height; ++row) {
+    for (size_t col = 0; col < width; ++col) {
+      cropped_depth_map.Set(row, col, depth_map.Get(y + row, x + col));
+    }
+  }
+  return cropped_depth_map;
+}
+
+NormalMap CropNormalMap(const NormalMap& normal_map,
+                        const size_t x,
+                        const size_t y,
+                        const size_t width,
+                        const size_t height) {
+  NormalMap cropped_normal_map(width, height);
+  for (size_t row = 0; row < height; ++row) {
+    for (size_t col = 0; col < width; ++col) {
+      for (size_t d = 0; d < 3; ++d) {
+        cropped_normal_map.Set(
+            row, col, d, normal_map.Get(y + row, x + col, d));
+      }
+    }
+  }
+  return cropped_normal_map;
+}
+
+// Crop the image and its bitmap, where the principal point is shifted such
+// that the cropped image remains consistent with its pose.
+Image CropImage(const Image& image,
+                const size_t x,
+                const size_t y,
+                const size_t width,
+                const size_t height) {
+  float K[9];
+  std::copy(image.GetK(), image.GetK() + 9, K);
+  K[2] -= x;
+  K[5] -= y;
+  Image cropped_image(
+      image.GetPath(), width, height, K, image.GetR(), image.GetT());
+  cropped_image.SetBitmap(image.GetBitmap().Crop(x, y, width, height));
+  return cropped_image;
+}
+
+// Determine the bounding box of the source image, in which the given region
+// of the reference image is visible within the depth range. Since the
+// projection of the viewing frustum is the convex hull of the projections of
+// its corners, it suffices to project the corners at the minimum and maximum
+// depth. If any corner lies behind the source image, the full source image is
+// returned.
+void ComputeSourceRegion(const Image& ref_image,
+                         const Image& src_image,
+                         const size_t ref_x,
+                         const size_t ref_y,
+                         const size_t ref_width,
+                         const size_t ref_height,
+                         const float depth_min,
+                         const float depth_max,
+                         const int margin,
+                         size_t* src_x,
+                         size_t* src_y,
+                         size_t* src_width,
+                         size_t* src_height) {
+  const Eigen::Map<const Eigen::Matrix<float, 3, 3, Eigen::RowMajor>> ref_K(
+      ref_image.GetK());
+  const Eigen::Map<const Eigen::Matrix<float, 3, 3, Eigen::RowMajor>> ref_R(
+      ref_image.GetR());
+  const Eigen::Map<const Eigen::Vector3f> ref_T(ref_image.GetT());
+  const Eigen::Map<const Eigen::Matrix<float, 3, 4, Eigen::RowMajor>> src_P(
+      src_image.GetP());
+  const Eigen::Matrix3f ref_inv_K = ref_K.inverse();
+
+  float min_x = std::numeric_limits<float>::max();
+  float min_y = std::numeric_limits<float>::max();
+  float max_x = std::numeric_limits<float>::lowest();
+  float max_y = std::numeric_limits<float>::lowest();
+  bool is_visible = true;
+  for (const float x : {static_cast<float>(ref_x),
+                        static_cast<float>(ref_x + ref_width)}) {
+    for (const float y : {static_cast<float>(ref_y),
+                          static_cast<float>(ref_y + ref_height)}) {
+      for (const float depth : {depth_min, depth_max}) {
+        const Eigen::Vector3f point_in_ref =
+            depth * ref_inv_K * Eigen::Vector3f(x, y, 1);
+        const Eigen::Vector3f point_in_world =
+            ref_R.transpose() * (point_in_ref - ref_T);
+        const Eigen::Vector3f proj = src_P * point_in_world.homogeneous();
+        if (proj.z() <= 0) {
+          is_visible = false;
+          continue;
+        }
+        min_x = std::min(min_x, proj.x() / proj.z());
+        min_y = std::min(min_y, proj.y() / proj.z());
+        max_x = std::max(max_x, proj.x() / proj.z());
+        max_y = std::max(max_y, proj.y() / proj.z());
+      }
+    }
+  }
+
+  const float width = src_image.GetWidth();
+  const float height = src_image.GetHeight();
+  if (!is_visible) {
+    min_x = 0;
+    min_y = 0;
+    max_x = width;
+    max_y = height;
+  }
+
+  // Make sure that the region contains at least one pixel, even if the tile
+  // is not visible in the source image.
+  min_x = std::min(std::max(0.0f, min_x - margin), width - 1);
+  min_y = std::min(std::max(0.0f, min_y - margin), height - 1);
+  max_x = std::max(std::min(width, max_x + margin), min_x + 1);
+  max_y = std::max(std::min(height, max_y + margin), min_y + 1);
+
+  *src_x = static_cast<size_t>(min_x);
+  *src_y = static_cast<size_t>(min_y);
+  *src_width = static_cast<size_t>(std::ceil(max_x)) - *src_x;
+  *src_height = static_cast<size_t>(std::ceil(max_y)) - *src_y;
+}
+
+// Write the output to a temporary file and rename it afterwards, such that
+// interrupted runs or other shards never observe partial outputs.
+template <typename T, typename... Args>
+void WriteOutputAtomically(const T& output,
+                           const std::string& path,
+                           Args... args) {
+  const std::string tmp_path = path + ".tmp";
+  output.Write(tmp_path, args...);
+  THROW_CHECK_EQ(std::rename(tmp_path.c_str(), path.c_str()), 0) << path;
+}
+
+// Greedily order the problems, such that each problem shares as many images
+// with its predecessor as possible, which increases the reuse of the source
+// depth maps that are kept resident on the GPU.
+void OrderProblemsBySharedImages(std::vector<PatchMatch::Problem>* problems) {
+  std::unordered_map<int, std::vector<size_t>> image_problem_idxs;
+  for (size_t problem_idx = 0; problem_idx < problems->size(); ++problem_idx) {
+    const auto& problem = problems->at(problem_idx);
+    image_problem_idxs[problem.ref_image_idx].push_back(problem_idx);
+    for (const int image_idx : problem.src_image_idxs) {
+      image_problem_idxs[image_idx].push_back(problem_idx);
+    }
+  }
+
+  // The ordering is quadratic in the number of problems per image and
+  // pointless, if most images are shared by all problems, e.g., with the
+  // `__all__` configuration.
+  size_t num_operations = 0;
+  for (const auto& image : image_problem_idxs) {
+    num_operations += image.second.size() * image.second.size();
+  }
+  const size_t kMaxNumOperations = 100000000;
+  if (num_operations > kMaxNumOperations) {
+    return;
+  }
+
+  std::vector<PatchMatch::Problem> ordered_problems;
+  ordered_problems.reserve(problems->size());
+  std::vector<char> is_ordered(problems->size(), false);
+  std::unordered_map<size_t, int> num_shared_images;
+  size_t next_unordered_problem_idx = 0;
+  size_t problem_idx = 0;
+  while (ordered_problems.size() < problems->size()) {
+    is_ordered[problem_idx] = true;
+    const auto& problem = problems->at(problem_idx);
+    ordered_problems.push_back(problem);
+
+    num_shared_images.clear();
+    auto CountSharedImages = [&](const int image_idx) {
+      for (const size_t other_problem_idx : image_problem_idxs.at(image_idx)) {
+        if (!is_ordered[other_problem_idx]) {
+          num_shared_images[other_problem_idx] += 1;
+        }
+      }
+    };
+    CountSharedImages(problem.ref_image_idx);
+    for (const int image_idx : problem.src_image_idxs) {
+      CountSharedImages(image_idx);
+    }
+
+    // Continue with the unordered problem with the most shared images or the
+    // first unordered problem, if no problem shares any images.
+    problem_idx = problems->size();
+    int max_num_shared_images = 0;
+    for (const auto& other_problem : num_shared_images) {
+      if (other_problem.second > max_num_shared_images ||
+          (other_problem.second == max_num_shared_images &&
+           other_problem.first < problem_idx)) {
+        problem_idx = other_problem.first;
+        max_num_shared_images = other_problem.second;
+      }
+    }
+    if (problem_idx == problems->size()) {
+      while (next_unordered_problem_idx < problems->size() &&
+             is_ordered[next_unordered_problem_idx]) {
+        ++next_unordered_problem_idx;
+      }
+      problem_idx = next_unordered_problem_idx;
+    }
+  }
+
+  *problems = std::move(ordered_problems);
+}
+
+}  // namespace
+
 PatchMatch::PatchMatch(const PatchMatchOptions& options, const Problem& problem)
     : options_(options), problem_(problem) {}
 
@@ -51,7 +319,9 @@ PatchMatch::~PatchMatch() {}
 void PatchMatchOptions::Print() const {
   PrintHeading2("PatchMatchOptions");
   PrintOption(max_image_size);
+  PrintOption(use_gpu);
   PrintOption(gpu_index);
+  PrintOption(num_threads);
   PrintOption(depth_min);
   PrintOption(depth_max);
   PrintOption(window_radius);
@@ -63,15 +333,25 @@ void PatchMatchOptions::Print() const {
   PrintOption(min_triangulation_angle);
   PrintOption(incident_angle_sigma);
   PrintOption(num_iterations);
+  PrintOption(num_pyramid_levels);
+  PrintOption(pyramid_num_iterations);
+  PrintOption(init_from_sparse_points);
   PrintOption(geom_consistency);
   PrintOption(geom_consistency_regularizer);
   PrintOption(geom_consistency_max_cost);
+  PrintOption(half_precision_depth_maps);
+  PrintOption(gpu_depth_map_cache_size);
   PrintOption(filter);
   PrintOption(filter_min_ncc);
   PrintOption(filter_min_triangulation_angle);
   PrintOption(filter_min_num_consistent);
   PrintOption(filter_geom_consistency_max_cost);
   PrintOption(write_consistency_graph);
+  PrintOption(write_compressed_maps);
+  PrintOption(tile_size);
+  PrintOption(tile_overlap);
+  PrintOption(scored_src_image_selection);
+  PrintOption(src_image_min_score_ratio);
   PrintOption(allow_missing_files);
 }
 
@@ -149,6 +429,18 @@ void PatchMatch::Check() const {
     THROW_CHECK_EQ(ref_image.GetWidth(), ref_normal_map.GetWidth());
     THROW_CHECK_EQ(ref_image.GetHeight(), ref_normal_map.GetHeight());
   }
+
+  THROW_CHECK_EQ(problem_.init_depth_map == nullptr,
+                 problem_.init_normal_map == nullptr);
+  if (problem_.init_depth_map != nullptr) {
+    const Image& ref_image = problem_.images->at(problem_.ref_image_idx);
+    THROW_CHECK_EQ(ref_image.GetWidth(), problem_.init_depth_map->GetWidth());
+    THROW_CHECK_EQ(ref_image.GetHeight(),
+                   problem_.init_depth_map->GetHeight());
+    THROW_CHECK_EQ(ref_image.GetWidth(), problem_.init_normal_map->GetWidth());
+    THROW_CHECK_EQ(ref_image.GetHeight(),
+                   problem_.init_normal_map->GetHeight());
+  }
 }
 
 void PatchMatch::Run() {
@@ -156,27 +448,318 @@ void PatchMatch::Run() {
 
   Check();
 
-  patch_match_cuda_ = std::make_unique<PatchMatchCuda>(options_, problem_);
-  patch_match_cuda_->Run();
+  const Image& ref_image = problem_.images->at(problem_.ref_image_idx);
+  if (options_.tile_size > 0 &&
+      (ref_image.GetWidth() > static_cast<size_t>(options_.tile_size) ||
+       ref_image.GetHeight() > static_cast<size_t>(options_.tile_size))) {
+    RunTiled();
+    return;
+  }
+
+  // Limit the pyramid, such that the coarsest level is still reasonably
+  // larger than the matching window.
+  const size_t min_image_size =
+      std::min(ref_image.GetWidth(), ref_image.GetHeight());
+  const size_t kMinCoarseImageSize = 16 * options_.window_radius;
+  int num_levels = options_.geom_consistency ? 1 : options_.num_pyramid_levels;
+  while (num_levels > 1 &&
+         (min_image_size >> (num_levels - 1)) < kMinCoarseImageSize) {
+    --num_levels;
+  }
+
+  if (num_levels == 1) {
+    RunImpl(options_, problem_);
+    return;
+  }
+
+  DepthMap init_depth_map;
+  NormalMap init_normal_map;
+  for (int level = num_levels - 1; level >= 0; --level) {
+    PatchMatchOptions level_options = options_;
+    level_options.num_iterations = level == num_levels - 1
+                                       ? options_.num_iterations
+                                       : options_.pyramid_num_iterations;
+    Problem level_problem = problem_;
+
+    // Downsample all images of the problem to the resolution of the level.
+    std::vector<Image> level_images;
+    if (level > 0) {
+      level_options.filter = false;
+      level_images = *problem_.images;
+      const float scale = 1.0f / (1 << level);
+      level_images.at(problem_.ref_image_idx).Rescale(scale);
+      for (const int image_idx : problem_.src_image_idxs) {
+        level_images.at(image_idx).Rescale(scale);
+      }
+      level_problem.images = &level_images;
+    }
+
+    // Initialize from the upsampled solution of the coarser level or from the
+    // downsampled initialization of the problem at the coarsest level.
+    if (level == num_levels - 1 && problem_.init_depth_map != nullptr) {
+      init_depth_map = *problem_.init_depth_map;
+      init_normal_map = *problem_.init_normal_map;
+    }
+    if (level < num_levels - 1 || problem_.init_depth_map != nullptr) {
+      const Image& level_ref_image =
+          level_problem.images->at(problem_.ref_image_idx);
+      init_depth_map = ResampleDepthMap(init_depth_map,
+                                        level_ref_image.GetWidth(),
+                                        level_ref_image.GetHeight());
+      init_normal_map = ResampleNormalMap(init_normal_map,
+                                          level_ref_image.GetWidth(),
+                                          level_ref_image.GetHeight());
+      level_problem.init_depth_map = &init_depth_map;
+      level_problem.init_normal_map = &init_normal_map;
+    }
+
+    LOG(INFO) << StringPrintf("Pyramid level %d with %d iterations",
+                              level,
+                              level_options.num_iterations);
+    RunImpl(level_options, level_problem);
+    if (level > 0) {
+      init_depth_map = GetDepthMap();
+      init_normal_map = GetNormalMap();
+    }
+  }
+}
+
+void PatchMatch::SetCudaWorkspace(
+    std::shared_ptr<PatchMatchCudaWorkspace> workspace) {
+  cuda_workspace_ = std::move(workspace);
+}
+
+void PatchMatch::RunImpl(const PatchMatchOptions& options,
+                         const Problem& problem) {
+#if defined(COLMAP_CUDA_ENABLED)
+  patch_match_cuda_.reset();
+#endif
+  patch_match_cpu_.reset();
+
+#if defined(COLMAP_CUDA_ENABLED)
+  if (options.use_gpu) {
+    patch_match_cuda_ =
+        std::make_unique<PatchMatchCuda>(options, problem, cuda_workspace_);
+    patch_match_cuda_->Run();
+    return;
+  }
+#endif
+
+  patch_match_cpu_ = std::make_unique<PatchMatchCpu>(options, problem);
+  patch_match_cpu_->Run();
+}
+
+void PatchMatch::RunTiled() {
+  const Image& ref_image = problem_.images->at(problem_.ref_image_idx);
+  const size_t width = ref_image.GetWidth();
+  const size_t height = ref_image.GetHeight();
+  const size_t tile_size = options_.tile_size;
+  const size_t overlap = options_.tile_overlap;
+
+  // Split the image into tiles of equal size, which are enlarged by the
+  // overlap on each side.
+  const size_t num_tiles_x = (width + tile_size - 1) / tile_size;
+  const size_t num_tiles_y = (height + tile_size - 1) / tile_size;
+  const size_t core_width = (width + num_tiles_x - 1) / num_tiles_x;
+  const size_t core_height = (height + num_tiles_y - 1) / num_tiles_y;
+
+  PatchMatchOptions tile_options = options_;
+  tile_options.tile_size = -1;
+
+  tiled_depth_map_ =
+      DepthMap(width, height, options_.depth_min, options_.depth_max);
+  tiled_normal_map_ = NormalMap(width, height);
+  tiled_sel_prob_map_ =
+      Mat<float>(width, height, problem_.src_image_idxs.size());
+  tiled_consistent_image_idxs_.clear();
+
+  for (size_t tile_y = 0; tile_y < num_tiles_y; ++tile_y) {
+    for (size_t tile_x = 0; tile_x < num_tiles_x; ++tile_x) {
+      const size_t core_x = tile_x * core_width;
+      const size_t core_y = tile_y * core_height;
+      const size_t core_x_end = std::min(core_x + core_width, width);
+      const size_t core_y_end = std::min(core_y + core_height, height);
+      const size_t x = core_x - std::min(core_x, overlap);
+      const size_t y = core_y - std::min(core_y, overlap);
+      const size_t tile_width = std::min(core_x_end + overlap, width) - x;
+      const size_t tile_height = std::min(core_y_end + overlap, height) - y;
+
+      LOG(INFO) << StringPrintf("Processing tile %d / %d at (%d, %d)",
+                                tile_y * num_tiles_x + tile_x + 1,
+                                num_tiles_x * num_tiles_y,
+                                x,
+                                y);
+
+      // Only the cropped images and maps of the problem are populated, all
+      // other entries remain empty.
+      std::vector<Image> tile_images(problem_.images->size());
+      std::vector<DepthMap> tile_depth_maps;
+      std::vector<NormalMap> tile_normal_maps;
+      if (options_.geom_consistency) {
+        tile_depth_maps.resize(problem_.images->size());
+        tile_normal_maps.resize(problem_.images->size());
+      }
+
+      Problem tile_problem = problem_;
+      tile_problem.images = &tile_images;
+      tile_problem.depth_maps = &tile_depth_maps;
+      tile_problem.normal_maps = &tile_normal_maps;
+      tile_problem.cache_src_depth_maps = false;
+
+      tile_images[problem_.ref_image_idx] =
+          CropImage(ref_image, x, y, tile_width, tile_height);
+      if (options_.geom_consistency) {
+        tile_depth_maps[problem_.ref_image_idx] =
+            CropDepthMap(problem_.depth_maps->at(problem_.ref_image_idx),
+                         x,
+                         y,
+                         tile_width,
+                         tile_height);
+        tile_normal_maps[problem_.ref_image_idx] =
+            CropNormalMap(problem_.normal_maps->at(problem_.ref_image_idx),
+                          x,
+                          y,
+                          tile_width,
+                          tile_height);
+      }
+
+      DepthMap tile_init_depth_map;
+      NormalMap tile_init_normal_map;
+      if (problem_.init_depth_map != nullptr) {
+        tile_init_depth_map = CropDepthMap(
+            *problem_.init_depth_map, x, y, tile_width, tile_height);
+        tile_init_normal_map = CropNormalMap(
+            *problem_.init_normal_map, x, y, tile_width, tile_height);
+        tile_problem.init_depth_map = &tile_init_depth_map;
+        tile_problem.init_normal_map = &tile_init_normal_map;
+      }
+
+      for (const int src_image_idx : problem_.src_image_idxs) {
+        const Image& src_image = problem_.images->at(src_image_idx);
+        size_t src_x;
+        size_t src_y;
+        size_t src_width;
+        size_t src_height;
+        ComputeSourceRegion(ref_image,
+                            src_image,
+                            x,
+                            y,
+                            tile_width,
+                            tile_height,
+                            options_.depth_min,
+                            options_.depth_max,
+                            options_.tile_overlap,
+                            &src_x,
+                            &src_y,
+                            &src_width,
+                            &src_height);
+        tile_images[src_image_idx] =
+            CropImage(src_image, src_x, src_y, src_width, src_height);
+        if (options_.geom_consistency) {
+          tile_depth_maps[src_image_idx] =
+              CropDepthMap(problem_.depth_maps->at(src_image_idx),
+                           src_x,
+                           src_y,
+                           src_width,
+                           src_height);
+        }
+      }
+
+      PatchMatch tile_patch_match(tile_options, tile_problem);
+      tile_patch_match.Run();
+
+      // Only keep the non-overlapping part of the tile.
+      const DepthMap tile_depth_map = tile_patch_match.GetDepthMap();
+      const NormalMap tile_normal_map = tile_patch_match.GetNormalMap();
+      const Mat<float> tile_sel_prob_map = tile_patch_match.GetSelProbMap();
+      for (size_t row = core_y; row < core_y_end; ++row) {
+        for (size_t col = core_x; col < core_x_end; ++col) {
+          tiled_depth_map_.Set(
+              row, col, tile_depth_map.Get(row - y, col - x));
+          for (size_t d = 0; d < 3; ++d) {
+            tiled_normal_map_.Set(
+                row, col, d, tile_normal_map.Get(row - y, col - x, d));
+          }
+          for (size_t d = 0; d < tiled_sel_prob_map_.GetDepth(); ++d) {
+            tiled_sel_prob_map_.Set(
+                row, col, d, tile_sel_prob_map.Get(row - y, col - x, d));
+          }
+        }
+      }
+
+      const std::vector<int> tile_consistent_image_idxs =
+          tile_patch_match.GetConsistentImageIdxs();
+      for (size_t i = 0; i < tile_consistent_image_idxs.size();) {
+        const size_t col = tile_consistent_image_idxs[i] + x;
+        const size_t row = tile_consistent_image_idxs[i + 1] + y;
+        const int num_images = tile_consistent_image_idxs[i + 2];
+        if (col >= core_x && col < core_x_end && row >= core_y &&
+            row < core_y_end) {
+          tiled_consistent_image_idxs_.push_back(col);
+          tiled_consistent_image_idxs_.push_back(row);
+          tiled_consistent_image_idxs_.insert(
+              tiled_consistent_image_idxs_.end(),
+              tile_consistent_image_idxs.begin() + i + 2,
+              tile_consistent_image_idxs.begin() + i + 3 + num_images);
+        }
+        i += 3 + num_images;
+      }
+    }
+  }
 }
 
 DepthMap PatchMatch::GetDepthMap() const {
-  return patch_match_cuda_->GetDepthMap();
+#if defined(COLMAP_CUDA_ENABLED)
+  if (patch_match_cuda_ != nullptr) {
+    return patch_match_cuda_->GetDepthMap();
+  }
+#endif
+  if (patch_match_cpu_ != nullptr) {
+    return patch_match_cpu_->GetDepthMap();
+  }
+  return tiled_depth_map_;
 }
 
 NormalMap PatchMatch::GetNormalMap() const {
-  return patch_match_cuda_->GetNormalMap();
+#if defined(COLMAP_CUDA_ENABLED)
+  if (patch_match_cuda_ != nullptr) {
+    return patch_match_cuda_->GetNormalMap();
+  }
+#endif
+  if (patch_match_cpu_ != nullptr) {
+    return patch_match_cpu_->GetNormalMap();
+  }
+  return tiled_normal_map_;
 }
 
 Mat<float> PatchMatch::GetSelProbMap() const {
-  return patch_match_cuda_->GetSelProbMap();
+#if defined(COLMAP_CUDA_ENABLED)
+  if (patch_match_cuda_ != nullptr) {
+    return patch_match_cuda_->GetSelProbMap();
+  }
+#endif
+  if (patch_match_cpu_ != nullptr) {
+    return patch_match_cpu_->GetSelProbMap();
+  }
+  return tiled_sel_prob_map_;
 }
 
 ConsistencyGraph PatchMatch::GetConsistencyGraph() const {
   const auto& ref_image = problem_.images->at(problem_.ref_image_idx);
-  return ConsistencyGraph(ref_image.GetWidth(),
-                          ref_image.GetHeight(),
-                          patch_match_cuda_->GetConsistentImageIdxs());
+  return ConsistencyGraph(
+      ref_image.GetWidth(), ref_image.GetHeight(), GetConsistentImageIdxs());
+}
+
+std::vector<int> PatchMatch::GetConsistentImageIdxs() const {
+#if defined(COLMAP_CUDA_ENABLED)
+  if (patch_match_cuda_ != nullptr) {
+    return patch_match_cuda_->GetConsistentImageIdxs();
+  }
+#endif
+  if (patch_match_cpu_ != nullptr) {
+    return patch_match_cpu_->GetConsistentImageIdxs();
+  }
+  return tiled_consistent_image_idxs_;
 }
 
 PatchMatchController::PatchMatchController(const PatchMatchOptions& options,
@@ -197,9 +780,19 @@ void PatchMatchController::Run() {
   run_timer.Start();
   ReadWorkspace();
   ReadProblems();
+  if (options_.num_shards > 1) {
+    SelectShardProblems();
+  }
   ReadGpuIndices();
 
+  GetMetrics().SetGauge("num_problems", problems_.size());
+  GetMetrics().SetGauge("num_passes", options_.geom_consistency ? 2 : 1);
+
   thread_pool_ = std::make_unique<ThreadPool>(gpu_indices_.size());
+  prefetch_thread_pool_ = std::make_unique<ThreadPool>(1);
+  write_thread_pool_ = std::make_unique<ThreadPool>(gpu_indices_.size());
+  pending_writes_.resize(gpu_indices_.size());
+  cuda_workspaces_.resize(gpu_indices_.size());
 
   // If geometric consistency is enabled, then photometric output must be
   // computed first for all images without filtering.
@@ -217,6 +810,17 @@ void PatchMatchController::Run() {
     }
 
     thread_pool_->Wait();
+    prefetch_thread_pool_->Wait();
+    WaitForPendingWrites();
+
+    if (options_.num_shards > 1) {
+      WaitForShardDependencies();
+    }
+  }
+
+  if (options_.geom_consistency && options_.use_gpu &&
+      options_.gpu_depth_map_cache_size > 0) {
+    OrderProblemsBySharedImages(&problems_);
   }
 
   for (size_t problem_idx = 0; problem_idx < problems_.size(); ++problem_idx) {
@@ -225,6 +829,10 @@ void PatchMatchController::Run() {
   }
 
   thread_pool_->Wait();
+  prefetch_thread_pool_->Wait();
+  WaitForPendingWrites();
+
+  cuda_workspaces_.clear();
 
   run_timer.PrintMinutes();
 }
@@ -275,6 +883,7 @@ void PatchMatchController::ReadProblems() {
 
   std::vector<std::map<int, int>> shared_num_points;
   std::vector<std::map<int, float>> triangulation_angles;
+  std::vector<std::vector<int>> selected_src_images;
 
   const float min_triangulation_angle_rad =
       DegToRad(options_.min_triangulation_angle);
@@ -311,6 +920,18 @@ void PatchMatchController::ReadProblems() {
     ref_image_name.clear();
   }
 
+  // The scored selection is computed once for the maximum number of source
+  // images of all problems, since its ranking is a greedy prefix.
+  size_t max_num_auto_src_images = 0;
+  for (const auto& problem_config : problem_configs) {
+    if (problem_config.src_image_names.size() == 2 &&
+        problem_config.src_image_names[0] == "__auto__") {
+      max_num_auto_src_images =
+          std::max<size_t>(max_num_auto_src_images,
+                           std::stoll(problem_config.src_image_names[1]));
+    }
+  }
+
   for (const auto& problem_config : problem_configs) {
     PatchMatch::Problem problem;
 
@@ -326,6 +947,22 @@ void PatchMatchController::ReadProblems() {
           problem.src_image_idxs.push_back(image_idx);
         }
       }
+    } else if (options_.scored_src_image_selection &&
+               problem_config.src_image_names.size() == 2 &&
+               problem_config.src_image_names[0] == "__auto__") {
+      // Use the top ranked source images of the view selection model.
+      if (selected_src_images.empty()) {
+        selected_src_images =
+            model.SelectSourceImages(max_num_auto_src_images,
+                                     options_.min_triangulation_angle,
+                                     options_.src_image_min_score_ratio);
+      }
+      const size_t max_num_src_images =
+          std::stoll(problem_config.src_image_names[1]);
+      const auto& src_images = selected_src_images.at(problem.ref_image_idx);
+      problem.src_image_idxs.assign(
+          src_images.begin(),
+          src_images.begin() + std::min(src_images.size(), max_num_src_images));
     } else if (problem_config.src_image_names.size() == 2 &&
                problem_config.src_image_names[0] == "__auto__") {
       // Use maximum number of overlapping images as source images. Overlapping
@@ -393,16 +1030,112 @@ void PatchMatchController::ReadProblems() {
 
   LOG(INFO) << StringPrintf("Configuration has %d problems...",
                             problems_.size());
+
+  if (!selected_src_images.empty() && options_.shard_index == 0) {
+    WriteSelectedConfig();
+  }
+}
+
+void PatchMatchController::WriteSelectedConfig() const {
+  const auto& model = workspace_->GetModel();
+  const std::string path = JoinPaths(workspace_path_,
+                                     workspace_->GetOptions().stereo_folder,
+                                     "patch-match-selected.cfg");
+  LOG(INFO) << "Writing selected configuration to " << path;
+
+  std::ofstream file(path, std::ios::trunc);
+  THROW_CHECK_FILE_OPEN(file, path);
+  for (const auto& problem : problems_) {
+    file << model.GetImageName(problem.ref_image_idx) << "\n";
+    for (size_t i = 0; i < problem.src_image_idxs.size(); ++i) {
+      if (i > 0) {
+        file << ", ";
+      }
+      file << model.GetImageName(problem.src_image_idxs[i]);
+    }
+    file << "\n";
+  }
+}
+
+void PatchMatchController::SelectShardProblems() {
+  std::unordered_set<int> ref_image_idxs;
+  for (const auto& problem : problems_) {
+    ref_image_idxs.insert(problem.ref_image_idx);
+  }
+
+  std::vector<PatchMatch::Problem> shard_problems;
+  std::set<int> dependency_image_idxs;
+  for (size_t problem_idx = options_.shard_index;
+       problem_idx < problems_.size();
+       problem_idx += options_.num_shards) {
+    const auto& problem = problems_[problem_idx];
+    shard_problems.push_back(problem);
+    dependency_image_idxs.insert(problem.ref_image_idx);
+    for (const int src_image_idx : problem.src_image_idxs) {
+      if (ref_image_idxs.count(src_image_idx) > 0) {
+        dependency_image_idxs.insert(src_image_idx);
+      }
+    }
+  }
+
+  LOG(INFO) << StringPrintf("Shard %d / %d has %d problems...",
+                            options_.shard_index + 1,
+                            options_.num_shards,
+                            shard_problems.size());
+
+  problems_ = std::move(shard_problems);
+  shard_dependency_image_idxs_.assign(dependency_image_idxs.begin(),
+                                      dependency_image_idxs.end());
+}
+
+void PatchMatchController::WaitForShardDependencies() {
+  const auto& model = workspace_->GetModel();
+  const std::string& stereo_folder = workspace_->GetOptions().stereo_folder;
+
+  const auto ExistsPhotometricOutput = [&](const int image_idx) {
+    const std::string file_name = StringPrintf(
+        "%s.photometric.bin", model.GetImageName(image_idx).c_str());
+    return ExistsFile(JoinPaths(
+               workspace_path_, stereo_folder, "depth_maps", file_name)) &&
+           ExistsFile(JoinPaths(
+               workspace_path_, stereo_folder, "normal_maps", file_name));
+  };
+
+  const std::chrono::seconds kPollInterval(10);
+  size_t num_missing = 0;
+  for (const int image_idx : shard_dependency_image_idxs_) {
+    while (!ExistsPhotometricOutput(image_idx)) {
+      if (CheckIfStopped()) {
+        return;
+      }
+      if (num_missing == 0) {
+        LOG(INFO) << StringPrintf(
+            "Waiting for photometric output of %s from other shards...",
+            model.GetImageName(image_idx).c_str());
+      }
+      num_missing += 1;
+      std::this_thread::sleep_for(kPollInterval);
+    }
+    num_missing = 0;
+  }
 }
 
 void PatchMatchController::ReadGpuIndices() {
-  gpu_indices_ = CSVToVector<int>(options_.gpu_index);
-  if (gpu_indices_.size() == 1 && gpu_indices_[0] == -1) {
-    const int num_cuda_devices = GetNumCudaDevices();
-    THROW_CHECK_GT(num_cuda_devices, 0);
-    gpu_indices_.resize(num_cuda_devices);
-    std::iota(gpu_indices_.begin(), gpu_indices_.end(), 0);
+#if defined(COLMAP_CUDA_ENABLED)
+  if (options_.use_gpu) {
+    gpu_indices_ = CSVToVector<int>(options_.gpu_index);
+    if (gpu_indices_.size() == 1 && gpu_indices_[0] == -1) {
+      const int num_cuda_devices = GetNumCudaDevices();
+      THROW_CHECK_GT(num_cuda_devices, 0);
+      gpu_indices_.resize(num_cuda_devices);
+      std::iota(gpu_indices_.begin(), gpu_indices_.end(), 0);
+    }
+    return;
   }
+#endif  // COLMAP_CUDA_ENABLED
+
+  // The CPU implementation processes one problem at a time with all threads.
+  gpu_indices_ = {-1};
 }
 
 void PatchMatchController::ProcessProblem(const PatchMatchOptions& options,
@@ -471,6 +1204,8 @@ void PatchMatchController::ProcessProblem(const PatchMatchOptions& options,
   problem.images = &images;
   problem.depth_maps = &depth_maps;
   problem.normal_maps = &normal_maps;
+  // The photometric depth maps do not change during the geometric pass.
+  problem.cache_src_depth_maps = options.geom_consistency;
 
   {
     // Collect all used images in current problem.
@@ -523,21 +1258,139 @@ void PatchMatchController::ProcessProblem(const PatchMatchOptions& options,
     problem.src_image_idxs = src_image_idxs;
   }
 
+  // This worker most likely processes the problem after the ones that are
+  // currently processed by all workers next.
+  const size_t next_problem_idx = problem_idx + thread_pool_->NumThreads();
+  if (next_problem_idx < problems_.size()) {
+    prefetch_thread_pool_->AddTask(&PatchMatchController::PrefetchProblem,
+                                   this,
+                                   options,
+                                   next_problem_idx);
+  }
+
+  // Seed the photometric hypotheses with the interpolated sparse depths and
+  // fronto-parallel normals.
+  DepthMap init_depth_map;
+  NormalMap init_normal_map;
+  problem.init_depth_map = nullptr;
+  problem.init_normal_map = nullptr;
+  if (options.init_from_sparse_points && !options.geom_consistency) {
+    init_depth_map =
+        model.ComputeInterpolatedDepthMap(problem.ref_image_idx,
+                                          patch_match_options.depth_min,
+                                          patch_match_options.depth_max);
+    if (init_depth_map.GetWidth() > 0) {
+      init_normal_map =
+          NormalMap(init_depth_map.GetWidth(), init_depth_map.GetHeight());
+      init_normal_map.Fill(0);
+      for (size_t row = 0; row < init_normal_map.GetHeight(); ++row) {
+        for (size_t col = 0; col < init_normal_map.GetWidth(); ++col) {
+          init_normal_map.Set(row, col, 2, -1);
+        }
+      }
+      problem.init_depth_map = &init_depth_map;
+      problem.init_normal_map = &init_normal_map;
+    } else {
+      LOG(WARNING) << "No sparse points for initialization, falling back to "
+                      "random initialization.";
+    }
+  }
+
   problem.Print();
   patch_match_options.Print();
 
   PatchMatch patch_match(patch_match_options, problem);
+#if defined(COLMAP_CUDA_ENABLED)
+  if (patch_match_options.use_gpu) {
+    auto& cuda_workspace =
+        cuda_workspaces_.at(thread_pool_->GetThreadIndex());
+    if (cuda_workspace == nullptr) {
+      SetBestCudaDevice(gpu_index);
+      cuda_workspace = std::make_shared<PatchMatchCudaWorkspace>();
+    }
+    patch_match.SetCudaWorkspace(cuda_workspace);
+  }
+#endif  // COLMAP_CUDA_ENABLED
   patch_match.Run();
+  GetMetrics().IncrementCounter("num_processed_problems");
 
-  LOG(INFO) << std::endl
-            << StringPrintf("Writing %s output for %s",
-                            output_type.c_str(),
-                            image_name.c_str());
-
-  patch_match.GetDepthMap().Write(depth_map_path);
-  patch_match.GetNormalMap().Write(normal_map_path);
+  DepthMap depth_map = patch_match.GetDepthMap();
+  NormalMap normal_map = patch_match.GetNormalMap();
+  ConsistencyGraph consistency_graph;
   if (options.write_consistency_graph) {
-    patch_match.GetConsistencyGraph().Write(consistency_graph_path);
+    consistency_graph = patch_match.GetConsistencyGraph();
+  }
+
+  // Write the outputs asynchronously, so that the GPU can continue with the
+  // next problem. Waiting for the previous write of this worker bounds the
+  // number of outputs in memory.
+  auto& pending_write = pending_writes_.at(thread_pool_->GetThreadIndex());
+  if (pending_write.valid()) {
+    pending_write.get();
+  }
+  pending_write = write_thread_pool_->AddTask(
+      [this,
+       output_type,
+       image_name,
+       depth_map_path,
+       normal_map_path,
+       consistency_graph_path,
+       write_consistency_graph = options.write_consistency_graph,
+       write_compressed_maps = options.write_compressed_maps,
+       depth_map = std::move(depth_map),
+       normal_map = std::move(normal_map),
+       consistency_graph = std::move(consistency_graph)]() {
+        LOG(INFO) << StringPrintf("Writing %s output for %s",
+                                  output_type.c_str(),
+                                  image_name.c_str());
+        WriteOutputAtomically(
+            depth_map, depth_map_path, write_compressed_maps);
+        WriteOutputAtomically(
+            normal_map, normal_map_path, write_compressed_maps);
+        if (write_consistency_graph) {
+          WriteOutputAtomically(
+              consistency_graph, consistency_graph_path, write_compressed_maps);
+        }
+        GetMetrics().IncrementCounter("num_written_outputs");
+      });
+}
+
+void PatchMatchController::PrefetchProblem(const PatchMatchOptions& options,
+                                           const size_t problem_idx) {
+  if (CheckIfStopped()) {
+    return;
+  }
+
+  std::vector<int> image_idxs;
+  {
+    std::unique_lock<std::mutex> lock(workspace_mutex_);
+    const auto& problem = problems_.at(problem_idx);
+    image_idxs = problem.src_image_idxs;
+    image_idxs.push_back(problem.ref_image_idx);
+  }
+
+  // Lock the workspace only per image, such that the workers are not blocked
+  // for long while reading their own inputs.
+  for (const int image_idx : image_idxs) {
+    std::unique_lock<std::mutex> lock(workspace_mutex_);
+    if (!ExistsFile(workspace_->GetBitmapPath(image_idx))) {
+      continue;
+    }
+    workspace_->GetBitmap(image_idx);
+    if (options.geom_consistency &&
+        ExistsFile(workspace_->GetDepthMapPath(image_idx)) &&
+        ExistsFile(workspace_->GetNormalMapPath(image_idx))) {
+      workspace_->GetDepthMap(image_idx);
+      workspace_->GetNormalMap(image_idx);
+    }
+  }
+}
+
+void PatchMatchController::WaitForPendingWrites() {
+  for (auto& pending_write : pending_writes_) {
+    if (pending_write.valid()) {
+      pending_write.get();
+    }
   }
 }
 
@@ -38,6 +38,7 @@
 #include "colmap/util/threading.h"
 #endif
 
+#include <future>
 #include <iostream>
 #include <memory>
 #include <vector>
@@ -51,17 +52,27 @@ namespace mvs {
 const static size_t kMaxPatchMatchWindowRadius = 32;
 
 class ConsistencyGraph;
+class PatchMatchCpu;
 class PatchMatchCuda;
+class PatchMatchCudaWorkspace;
 class Workspace;
 
 struct PatchMatchOptions {
   // Maximum image size in either dimension.
   int max_image_size = -1;
 
+  // Whether to use the CUDA implementation. Otherwise, or if COLMAP is built
+  // without CUDA, the multi-threaded CPU implementation is used, which
+  // produces compatible outputs but is considerably slower.
+  bool use_gpu = true;
+
   // Index of the GPU used for patch match. For multi-GPU usage,
   // you should separate multiple GPU indices by comma, e.g., "0,1,2,3".
   std::string gpu_index = "-1";
 
+  // Number of threads of the CPU implementation for each problem.
+  int num_threads = -1;
+
   // Depth range in which to randomly sample depth hypotheses.
   double depth_min = -1.0f;
   double depth_max = -1.0f;
@@ -96,6 +107,26 @@ struct PatchMatchOptions {
   // of four sweeps from left to right, top to bottom, and vice versa.
   int num_iterations = 5;
 
+  // Number of levels of a coarse-to-fine image pyramid, where each coarser
+  // level halves the image resolution. The coarsest level is solved with
+  // `num_iterations` from random initialization and each finer level is
+  // initialized with the upsampled depths and normals of the coarser level,
+  // which converges with only `pyramid_num_iterations`. This is much
+  // faster for high-resolution images and better propagates hypotheses into
+  // weakly textured regions. Only applies to the photometric pass, since the
+  // geometric pass is initialized from the photometric output.
+  int num_pyramid_levels = 1;
+
+  // Number of coordinate descent iterations at all but the coarsest level.
+  int pyramid_num_iterations = 2;
+
+  // Whether to initialize the depth hypotheses of the photometric pass by
+  // interpolating the depths of the sparse points observed by the reference
+  // image instead of sampling them randomly. Since most hypotheses already
+  // start close to the surface, fewer `num_iterations` are needed. Images
+  // without any sparse points fall back to random initialization.
+  bool init_from_sparse_points = false;
+
   // Whether to add a regularized geometric consistency term to the cost
   // function. If true, the `depth_maps` and `normal_maps` must not be null.
   bool geom_consistency = true;
@@ -108,6 +139,21 @@ struct PatchMatchOptions {
   // reprojection error in pixels.
   double geom_consistency_max_cost = 3.0f;
 
+  // Whether to store the source depth maps of the geometric consistency term
+  // in half precision on the GPU. This halves their texture memory, which
+  // dominates the memory usage of the geometric pass, and allows for more
+  // source images per problem. The relative depth error of about 5e-4 is far
+  // below the typical reprojection error threshold.
+  bool half_precision_depth_maps = false;
+
+  // Size in gigabytes of the GPU cache of source depth maps in the geometric
+  // pass. The photometric depth maps do not change during the pass, such that
+  // the source depth maps of consecutive problems on the same GPU are only
+  // uploaded once and are otherwise copied on the device. The problems are
+  // ordered such that consecutive problems share many source images. If 0,
+  // the source depth maps are uploaded for every problem.
+  double gpu_depth_map_cache_size = 1.0;
+
   // Whether to enable filtering.
   bool filter = true;
 
@@ -132,12 +178,51 @@ struct PatchMatchOptions {
   // of memory, if the consistency graph is dense.
   double cache_size = 32.0;
 
+  // Whether to select the source images of `__auto__` problems with a view
+  // selection model based on the triangulation angle, the resolution, and
+  // the coverage of the reference image by the shared sparse points. The
+  // selection stops early, once the score of the next source image drops below
+  // `src_image_min_score_ratio` times the score of the first source image,
+  // such that often fewer than the configured number of source images are
+  // processed. The selected sources are written to the config file
+  // `patch-match-selected.cfg` in the stereo folder for reuse.
+  bool scored_src_image_selection = false;
+  double src_image_min_score_ratio = 0.05;
+
   // Whether to tolerate missing images/maps in the problem setup
   bool allow_missing_files = false;
 
   // Whether to write the consistency graph.
   bool write_consistency_graph = false;
 
+  // Whether to write the depth and normal maps in the compressed format, which
+  // quantizes them to 16 bits per value and typically reduces their size by
+  // a factor of 3-5. The consistency graphs are then also compressed. Both
+  // formats are read transparently by the fusion.
+  bool write_compressed_maps = false;
+
+  // Maximum width and height of the tiles, in which the reference image is
+  // processed, or -1 to process the image in one piece. For each tile, only
+  // the regions of the source images are uploaded to the GPU, which can see
+  // the tile within the depth range. GPU memory is thereby bounded by the
+  // tile size rather than the image size.
+  int tile_size = -1;
+
+  // Number of pixels, by which neighboring tiles overlap, such that the
+  // propagation and the matching windows near the tile borders are not
+  // affected by the missing image content. Only the non-overlapping part of
+  // each tile is kept in the output.
+  int tile_overlap = 64;
+
+  // Number of shards and index of this shard, in which the problems are
+  // partitioned for distributed processing on multiple machines with a
+  // shared workspace. Each shard processes every `num_shards`-th problem
+  // starting at `shard_index`. With geometric consistency, a shard waits
+  // before its geometric pass until the other shards have written the
+  // photometric outputs of all images it depends on.
+  int num_shards = 1;
+  int shard_index = 0;
+
   void Print() const;
   bool Check() const {
     if (depth_min != -1.0f || depth_max != -1.0f) {
@@ -156,8 +241,11 @@ struct PatchMatchOptions {
     CHECK_OPTION_LT(min_triangulation_angle, 180.0f);
     CHECK_OPTION_GT(incident_angle_sigma, 0.0f);
     CHECK_OPTION_GT(num_iterations, 0);
+    CHECK_OPTION_GT(num_pyramid_levels, 0);
+    CHECK_OPTION_GT(pyramid_num_iterations, 0);
     CHECK_OPTION_GE(geom_consistency_regularizer, 0.0f);
     CHECK_OPTION_GE(geom_consistency_max_cost, 0.0f);
+    CHECK_OPTION_GE(gpu_depth_map_cache_size, 0);
     CHECK_OPTION_GE(filter_min_ncc, -1.0f);
     CHECK_OPTION_LE(filter_min_ncc, 1.0f);
     CHECK_OPTION_GE(filter_min_triangulation_angle, 0.0f);
@@ -165,13 +253,22 @@ struct PatchMatchOptions {
     CHECK_OPTION_GE(filter_min_num_consistent, 0);
     CHECK_OPTION_GE(filter_geom_consistency_max_cost, 0.0f);
     CHECK_OPTION_GT(cache_size, 0);
+    CHECK_OPTION_GE(src_image_min_score_ratio, 0);
+    CHECK_OPTION_LE(src_image_min_score_ratio, 1);
+    if (tile_size != -1) {
+      CHECK_OPTION_GT(tile_size, 2 * window_radius);
+    }
+    CHECK_OPTION_GE(tile_overlap, 0);
+    CHECK_OPTION_GT(num_shards, 0);
+    CHECK_OPTION_GE(shard_index, 0);
+    CHECK_OPTION_LT(shard_index, num_shards);
     return true;
   }
 };
 
-// This is a wrapper class around the actual PatchMatchCuda implementation. This
-// class is necessary to hide Cuda code from any boost or Eigen code, since
-// NVCC/MSVC cannot compile complex C++ code.
+// This is a wrapper class around the actual PatchMatchCuda or PatchMatchCpu
+// implementation. This class is necessary to hide Cuda code from any boost or
+// Eigen code, since NVCC/MSVC cannot compile complex C++ code.
 class PatchMatch {
  public:
   struct Problem {
@@ -190,6 +287,19 @@ class PatchMatch {
     // Input normal maps for the geometric consistency term.
     std::vector<NormalMap>* normal_maps = nullptr;
 
+    // Optional initial depth and normal map of the reference image, e.g.,
+    // interpolated from the sparse points or upsampled from a coarser
+    // resolution. Otherwise, the reference maps in `depth_maps` and
+    // `normal_maps` are used for geometric consistency and random hypotheses
+    // for photometric consistency.
+    const DepthMap* init_depth_map = nullptr;
+    const NormalMap* init_normal_map = nullptr;
+
+    // Whether the source depth maps are the same for all problems, which are
+    // processed with the same CUDA workspace, such that they can be kept
+    // resident on the device across problems.
+    bool cache_src_depth_maps = false;
+
     // Print the configuration to stdout.
     void Print() const;
   };
@@ -203,6 +313,10 @@ class PatchMatch {
   // Run the patch match algorithm.
   void Run();
 
+  // Reuse the device memory of the given workspace in the CUDA implementation,
+  // e.g., across consecutive problems processed on the same GPU.
+  void SetCudaWorkspace(std::shared_ptr<PatchMatchCudaWorkspace> workspace);
+
   // Get the computed values after running the algorithm.
   DepthMap GetDepthMap() const;
   NormalMap GetNormalMap() const;
@@ -210,9 +324,29 @@ class PatchMatch {
   Mat<float> GetSelProbMap() const;
 
  private:
+  // Run the algorithm independently for overlapping tiles of the reference
+  // image and stitch the results.
+  void RunTiled();
+
+  // Run the CUDA or CPU implementation for the given options and problem,
+  // whose results are then returned by the getters.
+  void RunImpl(const PatchMatchOptions& options, const Problem& problem);
+
+  std::vector<int> GetConsistentImageIdxs() const;
+
   const PatchMatchOptions options_;
   const Problem problem_;
+  std::shared_ptr<PatchMatchCudaWorkspace> cuda_workspace_;
+#if defined(COLMAP_CUDA_ENABLED)
   std::unique_ptr<PatchMatchCuda> patch_match_cuda_;
+#endif
+  std::unique_ptr<PatchMatchCpu> patch_match_cpu_;
+
+  // Stitched results of all tiles in tiled mode.
+  DepthMap tiled_depth_map_;
+  NormalMap tiled_normal_map_;
+  Mat<float> tiled_sel_prob_map_;
+  std::vector<int> tiled_consistent_image_idxs_;
 };
 
 // This thread processes all problems in a workspace. A workspace has the
@@ -259,8 +393,27 @@ class PatchMatchController : public BaseController {
   void ReadWorkspace();
   void ReadProblems();
   void ReadGpuIndices();
+
+  // Write the problems with explicit source images as configuration file,
+  // which can be reused to skip the source image selection.
+  void WriteSelectedConfig() const;
   void ProcessProblem(const PatchMatchOptions& options, size_t problem_idx);
 
+  // Only keep the problems of this shard and determine the images, whose
+  // photometric outputs are produced by any shard and required by the
+  // geometric pass of this shard.
+  void SelectShardProblems();
+
+  // Wait until the photometric outputs of all dependent images exist.
+  void WaitForShardDependencies();
+
+  // Read the inputs of a problem into the cached workspace ahead of its
+  // processing, while the GPUs are busy with the current problems.
+  void PrefetchProblem(const PatchMatchOptions& options, size_t problem_idx);
+
+  // Wait until the outputs of all processed problems are written.
+  void WaitForPendingWrites();
+
   const PatchMatchOptions options_;
   const std::string workspace_path_;
   const std::string workspace_format_;
@@ -268,11 +421,19 @@ class PatchMatchController : public BaseController {
   const std::string config_path_;
 
   std::unique_ptr<ThreadPool> thread_pool_;
+  std::unique_ptr<ThreadPool> prefetch_thread_pool_;
+  std::unique_ptr<ThreadPool> write_thread_pool_;
+  // The last scheduled write of each GPU worker, such that each worker has at
+  // most one output in memory that is not yet written.
+  std::vector<std::future<void>> pending_writes_;
+  // The device memory of each GPU worker that is reused across its problems.
+  std::vector<std::shared_ptr<PatchMatchCudaWorkspace>> cuda_workspaces_;
   std::mutex workspace_mutex_;
   std::unique_ptr<Workspace> workspace_;
   std::vector<PatchMatch::Problem> problems_;
   std::vector<int> gpu_indices_;
   std::vector<std::pair<float, float>> depth_ranges_;
+  std::vector<int> shard_dependency_image_idxs_;
 };
 
 #endif
@@ -0,0 +1,1518 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/mvs/patch_match_cpu.h"
+
+#include "colmap/math/math.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/timer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include <Eigen/Core>
+
+namespace colmap {
+namespace mvs {
+namespace {
+
+// Number of parameters per source image in the poses, see PatchMatchCuda.
+constexpr size_t kNumTformParams = 4 + 9 + 3 + 3 + 12 + 12;
+
+inline void Mat33DotVec3(const float mat[9],
+                         const float vec[3],
+                         float result[3]) {
+  result[0] = mat[0] * vec[0] + mat[1] * vec[1] + mat[2] * vec[2];
+  result[1] = mat[3] * vec[0] + mat[4] * vec[1] + mat[5] * vec[2];
+  result[2] = mat[6] * vec[0] + mat[7] * vec[1] + mat[8] * vec[2];
+}
+
+inline void Mat33DotVec3Homogeneous(const float mat[9],
+                                    const float vec[2],
+                                    float result[2]) {
+  const float inv_z = 1.0f / (mat[6] * vec[0] + mat[7] * vec[1] + mat[8]);
+  result[0] = inv_z * (mat[0] * vec[0] + mat[1] * vec[1] + mat[2]);
+  result[1] = inv_z * (mat[3] * vec[0] + mat[4] * vec[1] + mat[5]);
+}
+
+inline float DotProduct3(const float vec1[3], const float vec2[3]) {
+  return vec1[0] * vec2[0] + vec1[1] * vec2[1] + vec1[2] * vec2[2];
+}
+
+inline float GenerateRandomUniform(std::mt19937* rand_state) {
+  return std::uniform_real_distribution<float>(0.0f, 1.0f)(*rand_state);
+}
+
+inline float GenerateRandomDepth(const float depth_min,
+                                 const float depth_max,
+                                 std::mt19937* rand_state) {
+  return GenerateRandomUniform(rand_state) * (depth_max - depth_min) +
+         depth_min;
+}
+
+void GenerateRandomNormal(const int row,
+                          const int col,
+                          const float ref_inv_K[4],
+                          std::mt19937* rand_state,
+                          float normal[3]) {
+  // Unbiased sampling of normal, according to George Marsaglia, "Choosing a
+  // Point from the Surface of a Sphere", 1972.
+  float v1 = 0.0f;
+  float v2 = 0.0f;
+  float s = 2.0f;
+  while (s >= 1.0f) {
+    v1 = 2.0f * GenerateRandomUniform(rand_state) - 1.0f;
+    v2 = 2.0f * GenerateRandomUniform(rand_state) - 1.0f;
+    s = v1 * v1 + v2 * v2;
+  }
+
+  const float s_norm = std::sqrt(1.0f - s);
+  normal[0] = 2.0f * v1 * s_norm;
+  normal[1] = 2.0f * v2 * s_norm;
+  normal[2] = 1.0f - 2.0f * s;
+
+  // Make sure normal is looking away from camera.
+  const float view_ray[3] = {ref_inv_K[0] * col + ref_inv_K[1],
+                             ref_inv_K[2] * row + ref_inv_K[3],
+                             1.0f};
+  if (DotProduct3(normal, view_ray) > 0) {
+    normal[0] = -normal[0];
+    normal[1] = -normal[1];
+    normal[2] = -normal[2];
+  }
+}
+
+inline float PerturbDepth(const float perturbation,
+                          const float depth,
+                          std::mt19937* rand_state) {
+  const float depth_min = (1.0f - perturbation) * depth;
+  const float depth_max = (1.0f + perturbation) * depth;
+  return GenerateRandomDepth(depth_min, depth_max, rand_state);
+}
+
+void PerturbNormal(const int row,
+                   const int col,
+                   const float perturbation,
+                   const float normal[3],
+                   const float ref_inv_K[4],
+                   std::mt19937* rand_state,
+                   float perturbed_normal[3],
+                   const int num_trials = 0) {
+  // Perturbation rotation angles.
+  const float a1 = (GenerateRandomUniform(rand_state) - 0.5f) * perturbation;
+  const float a2 = (GenerateRandomUniform(rand_state) - 0.5f) * perturbation;
+  const float a3 = (GenerateRandomUniform(rand_state) - 0.5f) * perturbation;
+
+  const float sin_a1 = std::sin(a1);
+  const float sin_a2 = std::sin(a2);
+  const float sin_a3 = std::sin(a3);
+  const float cos_a1 = std::cos(a1);
+  const float cos_a2 = std::cos(a2);
+  const float cos_a3 = std::cos(a3);
+
+  // R = Rx * Ry * Rz
+  float R[9];
+  R[0] = cos_a2 * cos_a3;
+  R[1] = -cos_a2 * sin_a3;
+  R[2] = sin_a2;
+  R[3] = cos_a1 * sin_a3 + cos_a3 * sin_a1 * sin_a2;
+  R[4] = cos_a1 * cos_a3 - sin_a1 * sin_a2 * sin_a3;
+  R[5] = -cos_a2 * sin_a1;
+  R[6] = sin_a1 * sin_a3 - cos_a1 * cos_a3 * sin_a2;
+  R[7] = cos_a3 * sin_a1 + cos_a1 * sin_a2 * sin_a3;
+  R[8] = cos_a1 * cos_a2;
+
+  // Perturb the normal vector.
+  Mat33DotVec3(R, normal, perturbed_normal);
+
+  // Make sure the perturbed normal is still looking in the same direction as
+  // the viewing direction, otherwise try again but with smaller perturbation.
+  const float view_ray[3] = {ref_inv_K[0] * col + ref_inv_K[1],
+                             ref_inv_K[2] * row + ref_inv_K[3],
+                             1.0f};
+  if (DotProduct3(perturbed_normal, view_ray) >= 0.0f) {
+    const int kMaxNumTrials = 3;
+    if (num_trials < kMaxNumTrials) {
+      PerturbNormal(row,
+                    col,
+                    0.5f * perturbation,
+                    normal,
+                    ref_inv_K,
+                    rand_state,
+                    perturbed_normal,
+                    num_trials + 1);
+      return;
+    } else {
+      perturbed_normal[0] = normal[0];
+      perturbed_normal[1] = normal[1];
+      perturbed_normal[2] = normal[2];
+      return;
+    }
+  }
+
+  // Make sure normal has unit norm.
+  const float inv_norm =
+      1.0f / std::sqrt(DotProduct3(perturbed_normal, perturbed_normal));
+  perturbed_normal[0] *= inv_norm;
+  perturbed_normal[1] *= inv_norm;
+  perturbed_normal[2] *= inv_norm;
+}
+
+inline void ComputePointAtDepth(const float row,
+                                const float col,
+                                const float depth,
+                                const float ref_inv_K[4],
+                                float point[3]) {
+  point[0] = depth * (ref_inv_K[0] * col + ref_inv_K[1]);
+  point[1] = depth * (ref_inv_K[2] * row + ref_inv_K[3]);
+  point[2] = depth;
+}
+
+// Transfer depth on plane from viewing ray at row1 to row2. The returned
+// depth is the intersection of the viewing ray through row2 with the plane
+// at row1 defined by the given depth and normal.
+inline float PropagateDepth(const float depth1,
+                            const float normal1[3],
+                            const float row1,
+                            const float row2,
+                            const float ref_inv_K[4]) {
+  // Point along first viewing ray.
+  const float x1 = depth1 * (ref_inv_K[2] * row1 + ref_inv_K[3]);
+  const float y1 = depth1;
+  // Point on plane defined by point along first viewing ray and plane normal1.
+  const float x2 = x1 + normal1[2];
+  const float y2 = y1 - normal1[1];
+
+  // Point on second viewing ray through the origin.
+  const float x4 = ref_inv_K[2] * row2 + ref_inv_K[3];
+
+  // Intersection of the lines ((x1, y1), (x2, y2)) and ((0, 0), (x4, 1)).
+  const float denom = x2 - x1 + x4 * (y1 - y2);
+  constexpr float kEps = 1e-5f;
+  if (std::abs(denom) < kEps) {
+    return depth1;
+  }
+  const float nom = y1 * x2 - x1 * y2;
+  return nom / denom;
+}
+
+// First, compute triangulation angle between reference and source image for 3D
+// point. Second, compute incident angle between viewing direction of source
+// image and normal direction of 3D point. Both angles are cosine distances.
+inline void ComputeViewingAngles(const float* pose,
+                                 const float point[3],
+                                 const float normal[3],
+                                 float* cos_triangulation_angle,
+                                 float* cos_incident_angle) {
+  // Projection center of source image.
+  const float* C = pose + 16;
+
+  // Ray from point to camera.
+  const float SX[3] = {C[0] - point[0], C[1] - point[1], C[2] - point[2]};
+
+  // Length of ray from reference image to point.
+  const float RX_inv_norm = 1.0f / std::sqrt(DotProduct3(point, point));
+
+  // Length of ray from source image to point.
+  const float SX_inv_norm = 1.0f / std::sqrt(DotProduct3(SX, SX));
+
+  *cos_incident_angle = DotProduct3(SX, normal) * SX_inv_norm;
+  *cos_triangulation_angle = DotProduct3(SX, point) * RX_inv_norm * SX_inv_norm;
+}
+
+void ComposeHomography(const float* pose,
+                       const float ref_inv_K[4],
+                       const int row,
+                       const int col,
+                       const float depth,
+                       const float normal[3],
+                       float H[9]) {
+  // Calibration, relative rotation, and relative translation of source image.
+  const float* K = pose;
+  const float* R = pose + 4;
+  const float* T = pose + 13;
+
+  // Distance to the plane.
+  const float dist =
+      depth * (normal[0] * (ref_inv_K[0] * col + ref_inv_K[1]) +
+               normal[1] * (ref_inv_K[2] * row + ref_inv_K[3]) + normal[2]);
+  const float inv_dist = 1.0f / dist;
+
+  const float inv_dist_N0 = inv_dist * normal[0];
+  const float inv_dist_N1 = inv_dist * normal[1];
+  const float inv_dist_N2 = inv_dist * normal[2];
+
+  // Homography as H = K * (R - T * n' / d) * Kref^-1.
+  H[0] = ref_inv_K[0] * (K[0] * (R[0] + inv_dist_N0 * T[0]) +
+                         K[1] * (R[6] + inv_dist_N0 * T[2]));
+  H[1] = ref_inv_K[2] * (K[0] * (R[1] + inv_dist_N1 * T[0]) +
+                         K[1] * (R[7] + inv_dist_N1 * T[2]));
+  H[2] = K[0] * (R[2] + inv_dist_N2 * T[0]) +
+         K[1] * (R[8] + inv_dist_N2 * T[2]) +
+         ref_inv_K[1] * (K[0] * (R[0] + inv_dist_N0 * T[0]) +
+                         K[1] * (R[6] + inv_dist_N0 * T[2])) +
+         ref_inv_K[3] * (K[0] * (R[1] + inv_dist_N1 * T[0]) +
+                         K[1] * (R[7] + inv_dist_N1 * T[2]));
+  H[3] = ref_inv_K[0] * (K[2] * (R[3] + inv_dist_N0 * T[1]) +
+                         K[3] * (R[6] + inv_dist_N0 * T[2]));
+  H[4] = ref_inv_K[2] * (K[2] * (R[4] + inv_dist_N1 * T[1]) +
+                         K[3] * (R[7] + inv_dist_N1 * T[2]));
+  H[5] = K[2] * (R[5] + inv_dist_N2 * T[1]) +
+         K[3] * (R[8] + inv_dist_N2 * T[2]) +
+         ref_inv_K[1] * (K[2] * (R[3] + inv_dist_N0 * T[1]) +
+                         K[3] * (R[6] + inv_dist_N0 * T[2])) +
+         ref_inv_K[3] * (K[2] * (R[4] + inv_dist_N1 * T[1]) +
+                         K[3] * (R[7] + inv_dist_N1 * T[2]));
+  H[6] = ref_inv_K[0] * (R[6] + inv_dist_N0 * T[2]);
+  H[7] = ref_inv_K[2] * (R[7] + inv_dist_N1 * T[2]);
+  H[8] = R[8] + ref_inv_K[1] * (R[6] + inv_dist_N0 * T[2]) +
+         ref_inv_K[3] * (R[7] + inv_dist_N1 * T[2]) + inv_dist_N2 * T[2];
+}
+
+// Read the pixel at the given position or zero outside of the image, which is
+// equivalent to a point sampled CUDA texture with border addressing.
+inline float SampleNearest(const float* data,
+                           const int width,
+                           const int height,
+                           const float x,
+                           const float y) {
+  if (!(x >= 0.0f && y >= 0.0f && x < width && y < height)) {
+    return 0.0f;
+  }
+  return data[static_cast<int>(y) * width + static_cast<int>(x)];
+}
+
+// Bilinearly interpolate the image at the given position with pixel centers at
+// integer coordinates and zero outside of the image, which is equivalent to a
+// linearly filtered CUDA texture with border addressing.
+inline float SampleBilinear(const float* data,
+                            const int width,
+                            const int height,
+                            const float x,
+                            const float y) {
+  if (!(x > -1.0f && y > -1.0f && x < width && y < height)) {
+    return 0.0f;
+  }
+  const float x0 = std::floor(x);
+  const float y0 = std::floor(y);
+  const int col0 = static_cast<int>(x0);
+  const int row0 = static_cast<int>(y0);
+  const float dx = x - x0;
+  const float dy = y - y0;
+  const auto Texel = [&](const int row, const int col) {
+    if (row < 0 || col < 0 || row >= height || col >= width) {
+      return 0.0f;
+    }
+    return data[row * width + col];
+  };
+  return (1.0f - dy) * ((1.0f - dx) * Texel(row0, col0) +
+                        dx * Texel(row0, col0 + 1)) +
+         dy * ((1.0f - dx) * Texel(row0 + 1, col0) +
+               dx * Texel(row0 + 1, col0 + 1));
+}
+
+// Rotate the map with interleaved channels by 90 degrees in counter-clockwise
+// direction, such that its width and height are swapped.
+template <typename T>
+void RotateMap(const size_t width,
+               const size_t height,
+               const size_t depth,
+               std::vector<T>* map) {
+  std::vector<T> rotated_map(map->size());
+  for (size_t row = 0; row < height; ++row) {
+    for (size_t col = 0; col < width; ++col) {
+      const size_t rotated_row = width - 1 - col;
+      const size_t rotated_col = row;
+      std::copy_n(map->begin() + (row * width + col) * depth,
+                  depth,
+                  rotated_map.begin() + (rotated_row * height + rotated_col) *
+                                            depth);
+    }
+  }
+  map->swap(rotated_map);
+}
+
+// The return values is 1 - NCC, so the range is [0, 2], the smaller the
+// value, the better the color consistency. The bilateral weights and colors of
+// the reference patch only depend on the pixel and are computed once in `Read`
+// for all hypotheses and source images. The weighted sums of the warped source
+// patch are then evaluated as fixed-size vector expressions.
+template <int kWindowSize, int kWindowStep>
+class PhotoConsistencyCostComputer {
+ public:
+  static const int kWindowRadius = kWindowSize / 2;
+  static const int kNumSamplesPerDim = (kWindowSize - 1) / kWindowStep + 1;
+  static const int kNumSamples = kNumSamplesPerDim * kNumSamplesPerDim;
+  typedef Eigen::Array<float, kNumSamples, 1> SamplesType;
+
+  PhotoConsistencyCostComputer(const float* ref_image,
+                               const int ref_width,
+                               const int ref_height,
+                               const float* src_images,
+                               const int src_width,
+                               const int src_height,
+                               const float* poses,
+                               const float ref_inv_K[4],
+                               const float sigma_spatial,
+                               const float sigma_color)
+      : ref_image_(ref_image),
+        ref_width_(ref_width),
+        ref_height_(ref_height),
+        src_images_(src_images),
+        src_width_(src_width),
+        src_height_(src_height),
+        poses_(poses),
+        ref_inv_K_(ref_inv_K),
+        spatial_normalization_(1.0f / (2.0f * sigma_spatial * sigma_spatial)),
+        color_normalization_(1.0f / (2.0f * sigma_color * sigma_color)) {}
+
+  // Maximum photo consistency cost as 1 - min(NCC).
+  const float kMaxCost = 2.0f;
+
+  // Read the reference patch centered at the given pixel.
+  void Read(const int row, const int col) {
+    row_ = row;
+    col_ = col;
+
+    const float center_color = SampleNearest(
+        ref_image_, ref_width_, ref_height_, col_, row_);
+
+    int sample_idx = 0;
+    for (int window_row = -kWindowRadius; window_row <= kWindowRadius;
+         window_row += kWindowStep) {
+      for (int window_col = -kWindowRadius; window_col <= kWindowRadius;
+           window_col += kWindowStep) {
+        const float color = SampleNearest(ref_image_,
+                                          ref_width_,
+                                          ref_height_,
+                                          col_ + window_col,
+                                          row_ + window_row);
+        const float color_dist = center_color - color;
+        ref_colors_[sample_idx] = color;
+        ref_weights_[sample_idx] = std::exp(
+            -(window_row * window_row + window_col * window_col) *
+                spatial_normalization_ -
+            color_dist * color_dist * color_normalization_);
+        sample_idx += 1;
+      }
+    }
+
+    ref_weights_ /= ref_weights_.sum();
+    weighted_ref_colors_ = ref_weights_ * ref_colors_;
+    ref_color_sum_ = weighted_ref_colors_.sum();
+    ref_color_var_ = (weighted_ref_colors_ * ref_colors_).sum() -
+                     ref_color_sum_ * ref_color_sum_;
+  }
+
+  float Compute(const int src_image_idx,
+                const float depth,
+                const float normal[3]) const {
+    float tform[9];
+    ComposeHomography(poses_ + src_image_idx * kNumTformParams,
+                      ref_inv_K_,
+                      row_,
+                      col_,
+                      depth,
+                      normal,
+                      tform);
+
+    float tform_step[8];
+    for (int i = 0; i < 8; ++i) {
+      tform_step[i] = kWindowStep * tform[i];
+    }
+
+    const int row_start = row_ - kWindowRadius;
+    const int col_start = col_ - kWindowRadius;
+
+    float base_col_src = tform[0] * col_start + tform[1] * row_start + tform[2];
+    float base_row_src = tform[3] * col_start + tform[4] * row_start + tform[5];
+    float base_z = tform[6] * col_start + tform[7] * row_start + tform[8];
+
+    const float* src_image =
+        src_images_ + src_image_idx * src_width_ * src_height_;
+
+    SamplesType src_colors;
+    int sample_idx = 0;
+    for (int row = 0; row < kNumSamplesPerDim; ++row) {
+      // Accumulate warped source coordinates per row to reduce numerical
+      // errors, since coordinates usually are in the order of 1000s.
+      float col_src = base_col_src;
+      float row_src = base_row_src;
+      float z = base_z;
+      for (int col = 0; col < kNumSamplesPerDim; ++col) {
+        const float inv_z = 1.0f / z;
+        src_colors[sample_idx] = SampleBilinear(src_image,
+                                                src_width_,
+                                                src_height_,
+                                                inv_z * col_src,
+                                                inv_z * row_src);
+        sample_idx += 1;
+        col_src += tform_step[0];
+        row_src += tform_step[3];
+        z += tform_step[6];
+      }
+      base_col_src += tform_step[1];
+      base_row_src += tform_step[4];
+      base_z += tform_step[7];
+    }
+
+    const SamplesType weighted_src_colors = ref_weights_ * src_colors;
+    const float src_color_sum = weighted_src_colors.sum();
+    const float src_color_squared_sum =
+        (weighted_src_colors * src_colors).sum();
+    const float src_ref_color_sum = (weighted_ref_colors_ * src_colors).sum();
+
+    const float src_color_var =
+        src_color_squared_sum - src_color_sum * src_color_sum;
+
+    // Based on Jensen's Inequality for convex functions, the variance
+    // should always be larger than 0. Do not make this threshold smaller.
+    constexpr float kMinVar = 1e-5f;
+    if (ref_color_var_ < kMinVar || src_color_var < kMinVar) {
+      return kMaxCost;
+    } else {
+      const float src_ref_color_covar =
+          src_ref_color_sum - ref_color_sum_ * src_color_sum;
+      const float src_ref_color_var = std::sqrt(ref_color_var_ * src_color_var);
+      return std::max(
+          0.0f,
+          std::min(kMaxCost, 1.0f - src_ref_color_covar / src_ref_color_var));
+    }
+  }
+
+ private:
+  const float* ref_image_;
+  const int ref_width_;
+  const int ref_height_;
+  const float* src_images_;
+  const int src_width_;
+  const int src_height_;
+  const float* poses_;
+  const float* ref_inv_K_;
+  const float spatial_normalization_;
+  const float color_normalization_;
+
+  // Center position of patch in reference image.
+  int row_ = -1;
+  int col_ = -1;
+
+  // Normalized bilateral weights and colors of the reference patch.
+  SamplesType ref_colors_;
+  SamplesType ref_weights_;
+  SamplesType weighted_ref_colors_;
+  float ref_color_sum_ = 0.0f;
+  float ref_color_var_ = 0.0f;
+};
+
+float ComputeGeomConsistencyCost(const float* pose,
+                                 const float ref_K[4],
+                                 const float ref_inv_K[4],
+                                 const float* src_depth_map,
+                                 const int src_width,
+                                 const int src_height,
+                                 const float row,
+                                 const float col,
+                                 const float depth,
+                                 const float max_cost) {
+  // Projection matrices for source image.
+  const float* P = pose + 19;
+  const float* inv_P = pose + 31;
+
+  // Project point in reference image to world.
+  float forward_point[3];
+  ComputePointAtDepth(row, col, depth, ref_inv_K, forward_point);
+
+  // Project world point to source image.
+  const float inv_forward_z =
+      1.0f / (P[8] * forward_point[0] + P[9] * forward_point[1] +
+              P[10] * forward_point[2] + P[11]);
+  float src_col =
+      inv_forward_z * (P[0] * forward_point[0] + P[1] * forward_point[1] +
+                       P[2] * forward_point[2] + P[3]);
+  float src_row =
+      inv_forward_z * (P[4] * forward_point[0] + P[5] * forward_point[1] +
+                       P[6] * forward_point[2] + P[7]);
+
+  // Extract depth in source image.
+  const float src_depth = SampleNearest(
+      src_depth_map, src_width, src_height, src_col + 0.5f, src_row + 0.5f);
+
+  // Projection outside of source image.
+  if (src_depth == 0.0f) {
+    return max_cost;
+  }
+
+  // Project point in source image to world.
+  src_col *= src_depth;
+  src_row *= src_depth;
+  const float backward_point_x =
+      inv_P[0] * src_col + inv_P[1] * src_row + inv_P[2] * src_depth + inv_P[3];
+  const float backward_point_y =
+      inv_P[4] * src_col + inv_P[5] * src_row + inv_P[6] * src_depth + inv_P[7];
+  const float backward_point_z = inv_P[8] * src_col + inv_P[9] * src_row +
+                                 inv_P[10] * src_depth + inv_P[11];
+  const float inv_backward_point_z = 1.0f / backward_point_z;
+
+  // Project world point back to reference image.
+  const float backward_col =
+      inv_backward_point_z *
+      (ref_K[0] * backward_point_x + ref_K[1] * backward_point_z);
+  const float backward_row =
+      inv_backward_point_z *
+      (ref_K[2] * backward_point_y + ref_K[3] * backward_point_z);
+
+  // Return truncated reprojection error between original observation and
+  // the forward-backward projected observation.
+  const float diff_col = col - backward_col;
+  const float diff_row = row - backward_row;
+  return std::min(max_cost,
+                  std::sqrt(diff_col * diff_col + diff_row * diff_row));
+}
+
+// Find index of minimum in given values.
+template <int kNumCosts>
+inline int FindMinCost(const float costs[kNumCosts]) {
+  float min_cost = costs[0];
+  int min_cost_idx = 0;
+  for (int idx = 1; idx < kNumCosts; ++idx) {
+    if (costs[idx] <= min_cost) {
+      min_cost = costs[idx];
+      min_cost_idx = idx;
+    }
+  }
+  return min_cost_idx;
+}
+
+void TransformPDFToCDF(float* probs, const int num_probs) {
+  float prob_sum = 0.0f;
+  for (int i = 0; i < num_probs; ++i) {
+    prob_sum += probs[i];
+  }
+  const float inv_prob_sum = 1.0f / prob_sum;
+
+  float cum_prob = 0.0f;
+  for (int i = 0; i < num_probs; ++i) {
+    const float prob = probs[i] * inv_prob_sum;
+    cum_prob += prob;
+    probs[i] = cum_prob;
+  }
+}
+
+class LikelihoodComputer {
+ public:
+  LikelihoodComputer(const float ncc_sigma,
+                     const float min_triangulation_angle,
+                     const float incident_angle_sigma)
+      : cos_min_triangulation_angle_(std::cos(min_triangulation_angle)),
+        inv_incident_angle_sigma_square_(
+            -0.5f / (incident_angle_sigma * incident_angle_sigma)),
+        inv_ncc_sigma_square_(-0.5f / (ncc_sigma * ncc_sigma)),
+        ncc_norm_factor_(ComputeNCCCostNormFactor(ncc_sigma)) {}
+
+  // Compute forward message from current cost and forward message of
+  // previous / neighboring pixel.
+  float ComputeForwardMessage(const float cost, const float prev) const {
+    return ComputeMessage<true>(cost, prev);
+  }
+
+  // Compute backward message from current cost and backward message of
+  // previous / neighboring pixel.
+  float ComputeBackwardMessage(const float cost, const float prev) const {
+    return ComputeMessage<false>(cost, prev);
+  }
+
+  // Compute the selection probability from the forward and backward message.
+  inline float ComputeSelProb(const float alpha,
+                              const float beta,
+                              const float prev,
+                              const float prev_weight) const {
+    const float zn0 = (1.0f - alpha) * (1.0f - beta);
+    const float zn1 = alpha * beta;
+    const float curr = zn1 / (zn0 + zn1);
+    return prev_weight * prev + (1.0f - prev_weight) * curr;
+  }
+
+  // Compute NCC probability. Note that cost = 1 - NCC.
+  inline float ComputeNCCProb(const float cost) const {
+    return std::exp(cost * cost * inv_ncc_sigma_square_) * ncc_norm_factor_;
+  }
+
+  // Compute the triangulation angle probability.
+  inline float ComputeTriProb(const float cos_triangulation_angle) const {
+    const float abs_cos_triangulation_angle =
+        std::abs(cos_triangulation_angle);
+    if (abs_cos_triangulation_angle > cos_min_triangulation_angle_) {
+      const float scaled = 1.0f - (1.0f - abs_cos_triangulation_angle) /
+                                      (1.0f - cos_min_triangulation_angle_);
+      const float likelihood = 1.0f - scaled * scaled;
+      return std::min(1.0f, std::max(0.0f, likelihood));
+    } else {
+      return 1.0f;
+    }
+  }
+
+  // Compute the incident angle probability.
+  inline float ComputeIncProb(const float cos_incident_angle) const {
+    const float x = 1.0f - std::max(0.0f, cos_incident_angle);
+    return std::exp(x * x * inv_incident_angle_sigma_square_);
+  }
+
+  // Compute the warping/resolution prior probability.
+  template <int kWindowSize>
+  inline float ComputeResolutionProb(const float H[9],
+                                     const float row,
+                                     const float col) const {
+    const int kWindowRadius = kWindowSize / 2;
+
+    // Warp corners of patch in reference image to source image.
+    float src1[2];
+    const float ref1[2] = {col - kWindowRadius, row - kWindowRadius};
+    Mat33DotVec3Homogeneous(H, ref1, src1);
+    float src2[2];
+    const float ref2[2] = {col - kWindowRadius, row + kWindowRadius};
+    Mat33DotVec3Homogeneous(H, ref2, src2);
+    float src3[2];
+    const float ref3[2] = {col + kWindowRadius, row + kWindowRadius};
+    Mat33DotVec3Homogeneous(H, ref3, src3);
+    float src4[2];
+    const float ref4[2] = {col + kWindowRadius, row - kWindowRadius};
+    Mat33DotVec3Homogeneous(H, ref4, src4);
+
+    // Compute area of patches in reference and source image.
+    const float ref_area = kWindowSize * kWindowSize;
+    const float src_area = std::abs(
+        0.5f * (src1[0] * src2[1] - src2[0] * src1[1] - src1[0] * src4[1] +
+                src2[0] * src3[1] - src3[0] * src2[1] + src4[0] * src1[1] +
+                src3[0] * src4[1] - src4[0] * src3[1]));
+
+    if (ref_area > src_area) {
+      return src_area / ref_area;
+    } else {
+      return ref_area / src_area;
+    }
+  }
+
+ private:
+  // The normalization for the likelihood function, i.e. the normalization for
+  // the prior on the matching cost.
+  static inline float ComputeNCCCostNormFactor(const float ncc_sigma) {
+    // A = sqrt(2pi)*sigma/2*erf(sqrt(2)/sigma)
+    // erf(x) = 2/sqrt(pi) * integral from 0 to x of exp(-t^2) dt
+    return 2.0f / (std::sqrt(2.0f * static_cast<float>(M_PI)) * ncc_sigma *
+                   std::erf(2.0f / (ncc_sigma * 1.414213562f)));
+  }
+
+  // Compute the forward or backward message.
+  template <bool kForward>
+  inline float ComputeMessage(const float cost, const float prev) const {
+    constexpr float kUniformProb = 0.5f;
+    constexpr float kNoChangeProb = 0.99999f;
+    const float kChangeProb = 1.0f - kNoChangeProb;
+    const float emission = ComputeNCCProb(cost);
+
+    float zn0;  // Message for selection probability = 0.
+    float zn1;  // Message for selection probability = 1.
+    if (kForward) {
+      zn0 = (prev * kChangeProb + (1.0f - prev) * kNoChangeProb) * kUniformProb;
+      zn1 = (prev * kNoChangeProb + (1.0f - prev) * kChangeProb) * emission;
+    } else {
+      zn0 = prev * emission * kChangeProb +
+            (1.0f - prev) * kUniformProb * kNoChangeProb;
+      zn1 = prev * emission * kNoChangeProb +
+            (1.0f - prev) * kUniformProb * kChangeProb;
+    }
+
+    return zn1 / (zn0 + zn1);
+  }
+
+  const float cos_min_triangulation_angle_;
+  const float inv_incident_angle_sigma_square_;
+  const float inv_ncc_sigma_square_;
+  const float ncc_norm_factor_;
+};
+
+}  // namespace
+
+PatchMatchCpu::PatchMatchCpu(const PatchMatchOptions& options,
+                             const PatchMatch::Problem& problem)
+    : options_(options),
+      problem_(problem),
+      ref_width_(0),
+      ref_height_(0),
+      width_(0),
+      height_(0),
+      rotation_in_half_pi_(0),
+      src_max_width_(0),
+      src_max_height_(0) {
+  thread_pool_ = std::make_unique<ThreadPool>(
+      GetEffectiveNumThreads(options_.num_threads));
+  InitRefImage();
+  InitSourceImages();
+  InitTransforms();
+  InitWorkspaceMemory();
+}
+
+void PatchMatchCpu::Run() {
+#define CASE_WINDOW_RADIUS(window_radius, window_step)              \
+  case window_radius:                                               \
+    RunWithWindowSizeAndStep<2 * window_radius + 1, window_step>(); \
+    break;
+
+#define CASE_WINDOW_STEP(window_step)                          \
+  case window_step:                                            \
+    switch (options_.window_radius) {                          \
+      CASE_WINDOW_RADIUS(1, window_step)                       \
+      CASE_WINDOW_RADIUS(2, window_step)                       \
+      CASE_WINDOW_RADIUS(3, window_step)                       \
+      CASE_WINDOW_RADIUS(4, window_step)                       \
+      CASE_WINDOW_RADIUS(5, window_step)                       \
+      CASE_WINDOW_RADIUS(6, window_step)                       \
+      CASE_WINDOW_RADIUS(7, window_step)                       \
+      CASE_WINDOW_RADIUS(8, window_step)                       \
+      CASE_WINDOW_RADIUS(9, window_step)                       \
+      CASE_WINDOW_RADIUS(10, window_step)                      \
+      CASE_WINDOW_RADIUS(11, window_step)                      \
+      CASE_WINDOW_RADIUS(12, window_step)                      \
+      CASE_WINDOW_RADIUS(13, window_step)                      \
+      CASE_WINDOW_RADIUS(14, window_step)                      \
+      CASE_WINDOW_RADIUS(15, window_step)                      \
+      CASE_WINDOW_RADIUS(16, window_step)                      \
+      CASE_WINDOW_RADIUS(17, window_step)                      \
+      CASE_WINDOW_RADIUS(18, window_step)                      \
+      CASE_WINDOW_RADIUS(19, window_step)                      \
+      CASE_WINDOW_RADIUS(20, window_step)                      \
+      default: {                                               \
+        LOG(ERROR) << "Window size " << options_.window_radius \
+                   << " not supported";                        \
+        break;                                                 \
+      }                                                        \
+    }                                                          \
+    break;
+
+  switch (options_.window_step) {
+    CASE_WINDOW_STEP(1)
+    CASE_WINDOW_STEP(2)
+    default: {
+      LOG(ERROR) << "Window step " << options_.window_step << " not supported";
+      break;
+    }
+  }
+
+#undef CASE_WINDOW_STEP
+#undef CASE_WINDOW_RADIUS
+}
+
+DepthMap PatchMatchCpu::GetDepthMap() const {
+  Mat<float> mat(width_, height_, 1);
+  std::copy(depth_map_.begin(), depth_map_.end(), mat.GetPtr());
+  return DepthMap(mat, options_.depth_min, options_.depth_max);
+}
+
+NormalMap PatchMatchCpu::GetNormalMap() const {
+  // De-interleave the normals into the slices of the map.
+  Mat<float> mat(width_, height_, 3);
+  const size_t num_pixels = width_ * height_;
+  for (size_t d = 0; d < 3; ++d) {
+    float* slice = mat.GetSlicePtr(d);
+    for (size_t i = 0; i < num_pixels; ++i) {
+      slice[i] = normal_map_[i * 3 + d];
+    }
+  }
+  return NormalMap(mat);
+}
+
+Mat<float> PatchMatchCpu::GetSelProbMap() const {
+  const size_t num_src_images = problem_.src_image_idxs.size();
+  Mat<float> mat(width_, height_, num_src_images);
+  const size_t num_pixels = width_ * height_;
+  for (size_t d = 0; d < num_src_images; ++d) {
+    float* slice = mat.GetSlicePtr(d);
+    for (size_t i = 0; i < num_pixels; ++i) {
+      slice[i] = prev_sel_prob_map_[i * num_src_images + d];
+    }
+  }
+  return mat;
+}
+
+std::vector<int> PatchMatchCpu::GetConsistentImageIdxs() const {
+  std::vector<int> consistent_image_idxs;
+  if (consistency_mask_.empty()) {
+    return consistent_image_idxs;
+  }
+  const size_t num_src_images = problem_.src_image_idxs.size();
+  std::vector<int> pixel_consistent_image_idxs;
+  pixel_consistent_image_idxs.reserve(num_src_images);
+  for (size_t r = 0; r < height_; ++r) {
+    for (size_t c = 0; c < width_; ++c) {
+      pixel_consistent_image_idxs.clear();
+      for (size_t d = 0; d < num_src_images; ++d) {
+        if (consistency_mask_[(r * width_ + c) * num_src_images + d]) {
+          pixel_consistent_image_idxs.push_back(problem_.src_image_idxs[d]);
+        }
+      }
+      if (pixel_consistent_image_idxs.size() > 0) {
+        consistent_image_idxs.push_back(c);
+        consistent_image_idxs.push_back(r);
+        consistent_image_idxs.push_back(pixel_consistent_image_idxs.size());
+        consistent_image_idxs.insert(consistent_image_idxs.end(),
+                                     pixel_consistent_image_idxs.begin(),
+                                     pixel_consistent_image_idxs.end());
+      }
+    }
+  }
+  return consistent_image_idxs;
+}
+
+template <int kWindowSize, int kWindowStep>
+void PatchMatchCpu::RunWithWindowSizeAndStep() {
+  Timer total_timer;
+  total_timer.Start();
+
+  Timer init_timer;
+  init_timer.Start();
+  ParallelForEachColumn([this](const size_t col) {
+    ComputeInitialCost<kWindowSize, kWindowStep>(col);
+  });
+  LOG(INFO) << StringPrintf("Initialization: %.4fs",
+                            init_timer.ElapsedSeconds());
+
+  const float total_num_steps = options_.num_iterations * 4;
+
+  SweepOptions sweep_options;
+  sweep_options.geom_consistency_term = options_.geom_consistency;
+
+  for (int iter = 0; iter < options_.num_iterations; ++iter) {
+    Timer iter_timer;
+    iter_timer.Start();
+
+    for (int sweep = 0; sweep < 4; ++sweep) {
+      Timer sweep_timer;
+      sweep_timer.Start();
+
+      // Exponentially reduce amount of perturbation during the optimization.
+      sweep_options.perturbation = 1.0f / std::pow(2.0f, iter + sweep / 4.0f);
+
+      // Linearly increase the influence of previous selection probabilities.
+      sweep_options.prev_sel_prob_weight =
+          static_cast<float>(iter * 4 + sweep) / total_num_steps;
+
+      const bool last_sweep = iter == options_.num_iterations - 1 && sweep == 3;
+      if (last_sweep && options_.filter) {
+        consistency_mask_.assign(cost_map_.size(), 0);
+        sweep_options.filter_photo_consistency = true;
+        sweep_options.filter_geom_consistency = options_.geom_consistency;
+      }
+
+      ParallelForEachColumn([this, &sweep_options](const size_t col) {
+        SweepFromTopToBottom<kWindowSize, kWindowStep>(sweep_options, col);
+      });
+
+      Rotate();
+
+      LOG(INFO) << StringPrintf(
+          " Sweep %d: %.4fs", sweep + 1, sweep_timer.ElapsedSeconds());
+    }
+
+    LOG(INFO) << StringPrintf(
+        "Iteration %d: %.4fs", iter + 1, iter_timer.ElapsedSeconds());
+  }
+
+  LOG(INFO) << StringPrintf("Total: %.4fs", total_timer.ElapsedSeconds());
+}
+
+template <int kWindowSize, int kWindowStep>
+void PatchMatchCpu::ComputeInitialCost(const size_t col) {
+  const size_t num_src_images = problem_.src_image_idxs.size();
+
+  PhotoConsistencyCostComputer<kWindowSize, kWindowStep> pcc_computer(
+      ref_image_.data(),
+      width_,
+      height_,
+      src_images_.data(),
+      src_max_width_,
+      src_max_height_,
+      poses_[rotation_in_half_pi_].data(),
+      ref_inv_K_[rotation_in_half_pi_],
+      options_.sigma_spatial,
+      options_.sigma_color);
+
+  for (size_t row = 0; row < height_; ++row) {
+    const size_t pixel_idx = row * width_ + col;
+    pcc_computer.Read(row, col);
+    for (size_t image_idx = 0; image_idx < num_src_images; ++image_idx) {
+      cost_map_[pixel_idx * num_src_images + image_idx] =
+          pcc_computer.Compute(image_idx,
+                               depth_map_[pixel_idx],
+                               &normal_map_[pixel_idx * 3]);
+    }
+  }
+}
+
+template <int kWindowSize, int kWindowStep>
+void PatchMatchCpu::SweepFromTopToBottom(const SweepOptions& sweep_options,
+                                         const size_t col) {
+  const int num_src_images = problem_.src_image_idxs.size();
+  const float* poses = poses_[rotation_in_half_pi_].data();
+  const float* ref_K = ref_K_[rotation_in_half_pi_];
+  const float* ref_inv_K = ref_inv_K_[rotation_in_half_pi_];
+  const size_t src_size = src_max_width_ * src_max_height_;
+
+  // Probability for boundary pixels.
+  constexpr float kUniformProb = 0.5f;
+
+  LikelihoodComputer likelihood_computer(
+      options_.ncc_sigma,
+      DegToRad(options_.min_triangulation_angle),
+      options_.incident_angle_sigma);
+
+  const auto GeomConsistencyCost = [&](const int row,
+                                       const float depth,
+                                       const int image_idx) {
+    return ComputeGeomConsistencyCost(
+        poses + image_idx * kNumTformParams,
+        ref_K,
+        ref_inv_K,
+        src_depth_maps_.data() + image_idx * src_size,
+        src_max_width_,
+        src_max_height_,
+        row,
+        col,
+        depth,
+        options_.geom_consistency_max_cost);
+  };
+
+  std::vector<float> forward_message(num_src_images);
+  std::vector<float> sampling_probs(num_src_images);
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Compute backward message for all rows. Note that the backward messages are
+  // temporarily stored in the sel_prob_map and replaced row by row as the
+  // updated forward messages are computed further below.
+  //////////////////////////////////////////////////////////////////////////////
+
+  for (int image_idx = 0; image_idx < num_src_images; ++image_idx) {
+    // Compute backward message.
+    float beta = kUniformProb;
+    for (int row = height_ - 1; row >= 0; --row) {
+      const size_t idx = (row * width_ + col) * num_src_images + image_idx;
+      beta = likelihood_computer.ComputeBackwardMessage(cost_map_[idx], beta);
+      sel_prob_map_[idx] = beta;
+    }
+
+    // Initialize forward message.
+    forward_message[image_idx] = kUniformProb;
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Estimate parameters for remaining rows and compute selection probabilities.
+  //////////////////////////////////////////////////////////////////////////////
+
+  PhotoConsistencyCostComputer<kWindowSize, kWindowStep> pcc_computer(
+      ref_image_.data(),
+      width_,
+      height_,
+      src_images_.data(),
+      src_max_width_,
+      src_max_height_,
+      poses,
+      ref_inv_K,
+      options_.sigma_spatial,
+      options_.sigma_color);
+
+  struct ParamState {
+    float depth = 0.0f;
+    float normal[3] = {0};
+  };
+
+  // Parameters of previous pixel in column.
+  ParamState prev_param_state;
+  // Parameters of current pixel in column.
+  ParamState curr_param_state;
+  // Randomly sampled parameters.
+  ParamState rand_param_state;
+  // PRNG state for random sampling.
+  std::mt19937& rand_state = rand_states_[col];
+
+  // Parameters for first row in column.
+  prev_param_state.depth = depth_map_[col];
+  std::copy_n(&normal_map_[col * 3], 3, prev_param_state.normal);
+
+  for (size_t row = 0; row < height_; ++row) {
+    const size_t pixel_idx = row * width_ + col;
+    float* costs_ptr = &cost_map_[pixel_idx * num_src_images];
+    float* sel_probs_ptr = &sel_prob_map_[pixel_idx * num_src_images];
+    const float* prev_sel_probs_ptr =
+        &prev_sel_prob_map_[pixel_idx * num_src_images];
+
+    pcc_computer.Read(row, col);
+
+    // Propagate the depth at which the current ray intersects with the plane
+    // of the normal of the previous ray. This helps to better estimate
+    // the depth of very oblique structures, i.e. pixels whose normal direction
+    // is significantly different from their viewing direction.
+    prev_param_state.depth = PropagateDepth(prev_param_state.depth,
+                                            prev_param_state.normal,
+                                            static_cast<float>(row) - 1,
+                                            row,
+                                            ref_inv_K);
+
+    // Read parameters for current pixel from previous sweep.
+    curr_param_state.depth = depth_map_[pixel_idx];
+    std::copy_n(&normal_map_[pixel_idx * 3], 3, curr_param_state.normal);
+
+    // Generate random parameters.
+    rand_param_state.depth = PerturbDepth(
+        sweep_options.perturbation, curr_param_state.depth, &rand_state);
+    PerturbNormal(row,
+                  col,
+                  sweep_options.perturbation * M_PI,
+                  curr_param_state.normal,
+                  ref_inv_K,
+                  &rand_state,
+                  rand_param_state.normal);
+
+    // Read in the backward message, compute selection probabilities and
+    // modulate selection probabilities with priors.
+
+    float point[3];
+    ComputePointAtDepth(row, col, curr_param_state.depth, ref_inv_K, point);
+
+    for (int image_idx = 0; image_idx < num_src_images; ++image_idx) {
+      const float* pose = poses + image_idx * kNumTformParams;
+
+      const float alpha = likelihood_computer.ComputeForwardMessage(
+          costs_ptr[image_idx], forward_message[image_idx]);
+      const float sel_prob = likelihood_computer.ComputeSelProb(
+          alpha,
+          sel_probs_ptr[image_idx],
+          prev_sel_probs_ptr[image_idx],
+          sweep_options.prev_sel_prob_weight);
+
+      float cos_triangulation_angle;
+      float cos_incident_angle;
+      ComputeViewingAngles(pose,
+                           point,
+                           curr_param_state.normal,
+                           &cos_triangulation_angle,
+                           &cos_incident_angle);
+      const float tri_prob =
+          likelihood_computer.ComputeTriProb(cos_triangulation_angle);
+      const float inc_prob =
+          likelihood_computer.ComputeIncProb(cos_incident_angle);
+
+      float H[9];
+      ComposeHomography(pose,
+                        ref_inv_K,
+                        row,
+                        col,
+                        curr_param_state.depth,
+                        curr_param_state.normal,
+                        H);
+      const float res_prob =
+          likelihood_computer.ComputeResolutionProb<kWindowSize>(H, row, col);
+
+      sampling_probs[image_idx] = sel_prob * tri_prob * inc_prob * res_prob;
+    }
+
+    TransformPDFToCDF(sampling_probs.data(), num_src_images);
+
+    // Compute matching cost using Monte Carlo sampling of source images. Images
+    // with higher selection probability are more likely to be sampled. Hence,
+    // if only very few source images see the reference image pixel, the same
+    // source image is likely to be sampled many times. Instead of taking
+    // the best K probabilities, this sampling scheme has the advantage of
+    // being adaptive to any distribution of selection probabilities.
+
+    constexpr int kNumCosts = 5;
+    float costs[kNumCosts] = {0};
+    const float depths[kNumCosts] = {curr_param_state.depth,
+                                     prev_param_state.depth,
+                                     rand_param_state.depth,
+                                     curr_param_state.depth,
+                                     rand_param_state.depth};
+    const float* normals[kNumCosts] = {curr_param_state.normal,
+                                       prev_param_state.normal,
+                                       rand_param_state.normal,
+                                       rand_param_state.normal,
+                                       curr_param_state.normal};
+
+    for (int sample = 0; sample < options_.num_samples; ++sample) {
+      const float rand_prob = GenerateRandomUniform(&rand_state) - FLT_EPSILON;
+
+      int src_image_idx = -1;
+      for (int image_idx = 0; image_idx < num_src_images; ++image_idx) {
+        if (sampling_probs[image_idx] > rand_prob) {
+          src_image_idx = image_idx;
+          break;
+        }
+      }
+
+      if (src_image_idx == -1) {
+        continue;
+      }
+
+      costs[0] += costs_ptr[src_image_idx];
+      if (sweep_options.geom_consistency_term) {
+        costs[0] += options_.geom_consistency_regularizer *
+                    GeomConsistencyCost(row, depths[0], src_image_idx);
+      }
+
+      for (int i = 1; i < kNumCosts; ++i) {
+        costs[i] += pcc_computer.Compute(src_image_idx, depths[i], normals[i]);
+        if (sweep_options.geom_consistency_term) {
+          costs[i] += options_.geom_consistency_regularizer *
+                      GeomConsistencyCost(row, depths[i], src_image_idx);
+        }
+      }
+    }
+
+    // Find the parameters of the minimum cost.
+    const int min_cost_idx = FindMinCost<kNumCosts>(costs);
+    const float best_depth = depths[min_cost_idx];
+    const float* best_normal = normals[min_cost_idx];
+
+    // Save best new parameters.
+    depth_map_[pixel_idx] = best_depth;
+    std::copy_n(best_normal, 3, &normal_map_[pixel_idx * 3]);
+
+    // Use the new cost to recompute the updated forward message and
+    // the selection probability.
+    for (int image_idx = 0; image_idx < num_src_images; ++image_idx) {
+      // Determine the cost for best depth.
+      if (min_cost_idx != 0) {
+        costs_ptr[image_idx] =
+            pcc_computer.Compute(image_idx, best_depth, best_normal);
+      }
+
+      const float alpha = likelihood_computer.ComputeForwardMessage(
+          costs_ptr[image_idx], forward_message[image_idx]);
+      const float prob = likelihood_computer.ComputeSelProb(
+          alpha,
+          sel_probs_ptr[image_idx],
+          prev_sel_probs_ptr[image_idx],
+          sweep_options.prev_sel_prob_weight);
+      forward_message[image_idx] = alpha;
+      sel_probs_ptr[image_idx] = prob;
+    }
+
+    if (sweep_options.filter_photo_consistency ||
+        sweep_options.filter_geom_consistency) {
+      uint8_t* consistency_mask_ptr =
+          &consistency_mask_[pixel_idx * num_src_images];
+
+      int num_consistent = 0;
+
+      float best_point[3];
+      ComputePointAtDepth(row, col, best_depth, ref_inv_K, best_point);
+
+      const float min_ncc_prob =
+          likelihood_computer.ComputeNCCProb(1.0f - options_.filter_min_ncc);
+      const float cos_min_triangulation_angle =
+          std::cos(DegToRad(options_.filter_min_triangulation_angle));
+
+      for (int image_idx = 0; image_idx < num_src_images; ++image_idx) {
+        float cos_triangulation_angle;
+        float cos_incident_angle;
+        ComputeViewingAngles(poses + image_idx * kNumTformParams,
+                             best_point,
+                             best_normal,
+                             &cos_triangulation_angle,
+                             &cos_incident_angle);
+        if (cos_triangulation_angle > cos_min_triangulation_angle ||
+            cos_incident_angle <= 0.0f) {
+          continue;
+        }
+
+        const bool photo_consistent =
+            !sweep_options.filter_photo_consistency ||
+            sel_probs_ptr[image_idx] >= min_ncc_prob;
+        const bool geom_consistent =
+            !sweep_options.filter_geom_consistency ||
+            GeomConsistencyCost(row, best_depth, image_idx) <=
+                options_.filter_geom_consistency_max_cost;
+        if (photo_consistent && geom_consistent) {
+          consistency_mask_ptr[image_idx] = 1;
+          num_consistent += 1;
+        }
+      }
+
+      if (num_consistent < options_.filter_min_num_consistent) {
+        depth_map_[pixel_idx] = 0.0f;
+        std::fill_n(&normal_map_[pixel_idx * 3], 3, 0.0f);
+        std::fill_n(consistency_mask_ptr, num_src_images, 0);
+      }
+    }
+
+    // Update previous depth for next row.
+    prev_param_state.depth = best_depth;
+    std::copy_n(best_normal, 3, prev_param_state.normal);
+  }
+}
+
+void PatchMatchCpu::InitRefImage() {
+  const Image& ref_image = problem_.images->at(problem_.ref_image_idx);
+
+  ref_width_ = ref_image.GetWidth();
+  ref_height_ = ref_image.GetHeight();
+  width_ = ref_width_;
+  height_ = ref_height_;
+
+  // Read the scanlines through a view to avoid an intermediate copy.
+  const BitmapView ref_view = ref_image.GetBitmap().View();
+  const size_t row_size =
+      static_cast<size_t>(ref_view.width) * ref_view.channels;
+  ref_image_.resize(row_size * ref_view.height);
+  float* dest = ref_image_.data();
+  for (int r = 0; r < ref_view.height; ++r) {
+    const uint8_t* row = ref_view.Row(r);
+    for (size_t i = 0; i < row_size; ++i) {
+      *dest++ = row[i] / 255.0f;
+    }
+  }
+}
+
+void PatchMatchCpu::InitSourceImages() {
+  // Determine maximum image size.
+  for (const auto image_idx : problem_.src_image_idxs) {
+    const Image& image = problem_.images->at(image_idx);
+    src_max_width_ = std::max(src_max_width_, image.GetWidth());
+    src_max_height_ = std::max(src_max_height_, image.GetHeight());
+  }
+
+  const size_t src_size = src_max_width_ * src_max_height_;
+
+  // Copy source images to contiguous memory block.
+  src_images_.resize(src_size * problem_.src_image_idxs.size(), 0.0f);
+  for (size_t i = 0; i < problem_.src_image_idxs.size(); ++i) {
+    const Image& image = problem_.images->at(problem_.src_image_idxs[i]);
+    const Bitmap& bitmap = image.GetBitmap();
+    float* dest = src_images_.data() + src_size * i;
+    for (size_t r = 0; r < image.GetHeight(); ++r) {
+      const uint8_t* scanline = bitmap.GetScanline(r);
+      for (size_t c = 0; c < image.GetWidth(); ++c) {
+        dest[c] = scanline[c] / 255.0f;
+      }
+      dest += src_max_width_;
+    }
+  }
+
+  // Copy source depth maps to contiguous memory block.
+  if (options_.geom_consistency) {
+    src_depth_maps_.resize(src_size * problem_.src_image_idxs.size(), 0.0f);
+    for (size_t i = 0; i < problem_.src_image_idxs.size(); ++i) {
+      const DepthMap& depth_map =
+          problem_.depth_maps->at(problem_.src_image_idxs[i]);
+      float* dest = src_depth_maps_.data() + src_size * i;
+      for (size_t r = 0; r < depth_map.GetHeight(); ++r) {
+        std::copy_n(depth_map.GetPtr() + r * depth_map.GetWidth(),
+                    depth_map.GetWidth(),
+                    dest);
+        dest += src_max_width_;
+      }
+    }
+  }
+}
+
+void PatchMatchCpu::InitTransforms() {
+  const Image& ref_image = problem_.images->at(problem_.ref_image_idx);
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Generate rotated versions (counter-clockwise) of calibration matrix.
+  //////////////////////////////////////////////////////////////////////////////
+
+  for (size_t i = 0; i < 4; ++i) {
+    ref_K_[i][0] = ref_image.GetK()[0];
+    ref_K_[i][1] = ref_image.GetK()[2];
+    ref_K_[i][2] = ref_image.GetK()[4];
+    ref_K_[i][3] = ref_image.GetK()[5];
+  }
+
+  // Rotated by 90 degrees.
+  std::swap(ref_K_[1][0], ref_K_[1][2]);
+  std::swap(ref_K_[1][1], ref_K_[1][3]);
+  ref_K_[1][3] = ref_width_ - 1 - ref_K_[1][3];
+
+  // Rotated by 180 degrees.
+  ref_K_[2][1] = ref_width_ - 1 - ref_K_[2][1];
+  ref_K_[2][3] = ref_height_ - 1 - ref_K_[2][3];
+
+  // Rotated by 270 degrees.
+  std::swap(ref_K_[3][0], ref_K_[3][2]);
+  std::swap(ref_K_[3][1], ref_K_[3][3]);
+  ref_K_[3][1] = ref_height_ - 1 - ref_K_[3][1];
+
+  // Extract 1/fx, -cx/fx, fy, -cy/fy.
+  for (size_t i = 0; i < 4; ++i) {
+    ref_inv_K_[i][0] = 1.0f / ref_K_[i][0];
+    ref_inv_K_[i][1] = -ref_K_[i][1] / ref_K_[i][0];
+    ref_inv_K_[i][2] = 1.0f / ref_K_[i][2];
+    ref_inv_K_[i][3] = -ref_K_[i][3] / ref_K_[i][2];
+  }
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Generate rotated versions of camera poses.
+  //////////////////////////////////////////////////////////////////////////////
+
+  float rotated_R[9];
+  memcpy(rotated_R, ref_image.GetR(), 9 * sizeof(float));
+
+  float rotated_T[3];
+  memcpy(rotated_T, ref_image.GetT(), 3 * sizeof(float));
+
+  // Matrix for 90deg rotation around Z-axis in counter-clockwise direction.
+  const float R_z90[9] = {0, 1, 0, -1, 0, 0, 0, 0, 1};
+
+  for (size_t i = 0; i < 4; ++i) {
+    poses_[i].resize(kNumTformParams * problem_.src_image_idxs.size());
+    float* pose = poses_[i].data();
+    for (const auto image_idx : problem_.src_image_idxs) {
+      const Image& image = problem_.images->at(image_idx);
+
+      pose[0] = image.GetK()[0];
+      pose[1] = image.GetK()[2];
+      pose[2] = image.GetK()[4];
+      pose[3] = image.GetK()[5];
+
+      float* rel_R = pose + 4;
+      float* rel_T = pose + 13;
+      ComputeRelativePose(
+          rotated_R, rotated_T, image.GetR(), image.GetT(), rel_R, rel_T);
+      ComputeProjectionCenter(rel_R, rel_T, pose + 16);
+      ComposeProjectionMatrix(image.GetK(), rel_R, rel_T, pose + 19);
+      ComposeInverseProjectionMatrix(image.GetK(), rel_R, rel_T, pose + 31);
+
+      pose += kNumTformParams;
+    }
+
+    RotatePose(R_z90, rotated_R, rotated_T);
+  }
+}
+
+void PatchMatchCpu::InitWorkspaceMemory() {
+  const size_t num_pixels = ref_width_ * ref_height_;
+  const size_t num_src_images = problem_.src_image_idxs.size();
+
+  // Seed the generators deterministically, such that the results do not
+  // depend on the number of threads.
+  rand_states_.resize(std::max(ref_width_, ref_height_));
+  for (size_t col = 0; col < rand_states_.size(); ++col) {
+    rand_states_[col].seed(col);
+  }
+
+  if (problem_.init_depth_map != nullptr) {
+    depth_map_ = problem_.init_depth_map->GetData();
+  } else if (options_.geom_consistency) {
+    depth_map_ = problem_.depth_maps->at(problem_.ref_image_idx).GetData();
+  } else {
+    depth_map_.resize(num_pixels);
+    for (size_t row = 0; row < ref_height_; ++row) {
+      for (size_t col = 0; col < ref_width_; ++col) {
+        depth_map_[row * ref_width_ + col] = GenerateRandomDepth(
+            options_.depth_min, options_.depth_max, &rand_states_[col]);
+      }
+    }
+  }
+
+  const NormalMap* init_normal_map = nullptr;
+  if (problem_.init_normal_map != nullptr) {
+    init_normal_map = problem_.init_normal_map;
+  } else if (options_.geom_consistency) {
+    init_normal_map = &problem_.normal_maps->at(problem_.ref_image_idx);
+  }
+
+  normal_map_.resize(num_pixels * 3);
+  for (size_t row = 0; row < ref_height_; ++row) {
+    for (size_t col = 0; col < ref_width_; ++col) {
+      float* normal = &normal_map_[(row * ref_width_ + col) * 3];
+      if (init_normal_map != nullptr) {
+        init_normal_map->GetSlice(row, col, normal);
+      } else {
+        GenerateRandomNormal(
+            row, col, ref_inv_K_[0], &rand_states_[col], normal);
+      }
+    }
+  }
+
+  sel_prob_map_.resize(num_pixels * num_src_images);
+  prev_sel_prob_map_.resize(num_pixels * num_src_images, 0.5f);
+  cost_map_.resize(num_pixels * num_src_images);
+  consistency_mask_.clear();
+}
+
+void PatchMatchCpu::ParallelForEachColumn(
+    const std::function<void(size_t)>& func) {
+  // Process blocks of consecutive columns to amortize the task overhead, while
+  // still balancing the load over the threads.
+  const size_t kNumBlocksPerThread = 4;
+  const size_t num_blocks =
+      std::min(width_, kNumBlocksPerThread * thread_pool_->NumThreads());
+  const size_t block_size = (width_ + num_blocks - 1) / num_blocks;
+  for (size_t begin = 0; begin < width_; begin += block_size) {
+    const size_t end = std::min(begin + block_size, width_);
+    thread_pool_->AddTask([&func, begin, end]() {
+      for (size_t col = begin; col < end; ++col) {
+        func(col);
+      }
+    });
+  }
+  thread_pool_->Wait();
+}
+
+void PatchMatchCpu::Rotate() {
+  rotation_in_half_pi_ = (rotation_in_half_pi_ + 1) % 4;
+
+  const size_t num_src_images = problem_.src_image_idxs.size();
+
+  // Rotate normals by 90deg around z-axis in counter-clockwise direction.
+  for (size_t i = 0; i < normal_map_.size(); i += 3) {
+    const float normal0 = normal_map_[i];
+    normal_map_[i] = normal_map_[i + 1];
+    normal_map_[i + 1] = -normal0;
+  }
+
+  RotateMap(width_, height_, 1, &ref_image_);
+  RotateMap(width_, height_, 1, &depth_map_);
+  RotateMap(width_, height_, 3, &normal_map_);
+  RotateMap(width_, height_, num_src_images, &cost_map_);
+  if (!consistency_mask_.empty()) {
+    RotateMap(width_, height_, num_src_images, &consistency_mask_);
+  }
+
+  // The rotated selection probabilities are the priors of the next sweep.
+  RotateMap(width_, height_, num_src_images, &sel_prob_map_);
+  prev_sel_prob_map_.swap(sel_prob_map_);
+
+  std::swap(width_, height_);
+}
+
+}  // namespace mvs
+}  // namespace colmap
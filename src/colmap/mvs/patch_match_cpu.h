@@ -0,0 +1,148 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/mvs/depth_map.h"
+#include "colmap/mvs/image.h"
+#include "colmap/mvs/mat.h"
+#include "colmap/mvs/normal_map.h"
+#include "colmap/mvs/patch_match.h"
+#include "colmap/util/threading.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace colmap {
+namespace mvs {
+
+// Multi-threaded CPU implementation of the PatchMatchCuda algorithm, which
+// produces compatible outputs for machines without a CUDA device. As on the
+// GPU, the reference image is rotated by 90 degrees after each sweep from top
+// to bottom, such that all columns of a sweep are independent and processed in
+// parallel. Within a column, the bilateral weights and colors of the reference
+// patch are computed once per pixel and shared by all hypotheses and source
+// images, so that the NCC reduces to vectorized dot products.
+class PatchMatchCpu {
+ public:
+  PatchMatchCpu(const PatchMatchOptions& options,
+                const PatchMatch::Problem& problem);
+
+  void Run();
+
+  DepthMap GetDepthMap() const;
+  NormalMap GetNormalMap() const;
+  Mat<float> GetSelProbMap() const;
+  std::vector<int> GetConsistentImageIdxs() const;
+
+ private:
+  struct SweepOptions {
+    float perturbation = 1.0f;
+    float prev_sel_prob_weight = 0.0f;
+    bool geom_consistency_term = false;
+    bool filter_photo_consistency = false;
+    bool filter_geom_consistency = false;
+  };
+
+  template <int kWindowSize, int kWindowStep>
+  void RunWithWindowSizeAndStep();
+
+  template <int kWindowSize, int kWindowStep>
+  void ComputeInitialCost(size_t col);
+
+  template <int kWindowSize, int kWindowStep>
+  void SweepFromTopToBottom(const SweepOptions& sweep_options, size_t col);
+
+  void InitRefImage();
+  void InitSourceImages();
+  void InitTransforms();
+  void InitWorkspaceMemory();
+
+  // Call the function for all columns of the current rotation in parallel.
+  void ParallelForEachColumn(const std::function<void(size_t)>& func);
+
+  // Rotate reference image by 90 degrees in counter-clockwise direction.
+  void Rotate();
+
+  const PatchMatchOptions options_;
+  const PatchMatch::Problem problem_;
+
+  std::unique_ptr<ThreadPool> thread_pool_;
+
+  // Original (not rotated) dimension of reference image.
+  size_t ref_width_;
+  size_t ref_height_;
+
+  // Dimension of reference image in the current rotation.
+  size_t width_;
+  size_t height_;
+
+  // Rotation of reference image in pi/2. This is equivalent to the number of
+  // calls to `rotate` mod 4.
+  int rotation_in_half_pi_;
+
+  // Reference image with intensities normalized to [0, 1].
+  std::vector<float> ref_image_;
+
+  // Source images and depth maps with normalized intensities, stored
+  // contiguously with the maximum width and height of all source images.
+  size_t src_max_width_;
+  size_t src_max_height_;
+  std::vector<float> src_images_;
+  std::vector<float> src_depth_maps_;
+
+  // Relative poses from rotated versions of reference image to source images
+  // in the same layout as in PatchMatchCuda, i.e., per source image:
+  //
+  //    [K(0, 0), K(0, 2), K(1, 1), K(1, 2), R(:), T(:), C(:), P(:), P^-1(:)]
+  std::vector<float> poses_[4];
+
+  // Calibration matrix for rotated versions of reference image
+  // as {K[0, 0], K[0, 2], K[1, 1], K[1, 2]} corresponding to _rotationInHalfPi.
+  float ref_K_[4][4];
+  float ref_inv_K_[4][4];
+
+  // Data for reference image in the current rotation. Unlike on the GPU, the
+  // per source image values are stored contiguously for each pixel.
+  std::vector<float> depth_map_;
+  std::vector<float> normal_map_;
+  std::vector<float> sel_prob_map_;
+  std::vector<float> prev_sel_prob_map_;
+  std::vector<float> cost_map_;
+  std::vector<uint8_t> consistency_mask_;
+
+  // Random number generator for each column.
+  std::vector<std::mt19937> rand_states_;
+};
+
+}  // namespace mvs
+}  // namespace colmap
@@ -0,0 +1,203 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/mvs/patch_match_cpu.h"
+
+#include "colmap/util/testing.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace mvs {
+namespace {
+
+constexpr int kWidth = 64;
+constexpr int kHeight = 48;
+constexpr float kFocalLength = 100;
+constexpr float kPlaneDepth = 10;
+
+// Random piecewise bilinear texture on the plane z = kPlaneDepth.
+float PlaneTexture(const float x, const float y) {
+  const auto Hash = [](const int i, const int j) {
+    const unsigned h = static_cast<unsigned>(i * 73856093 ^ j * 19349663);
+    return static_cast<float>((h * 2654435761u) >> 24) / 255.0f;
+  };
+  const float kCellSize = 0.2f;
+  const float u = x / kCellSize;
+  const float v = y / kCellSize;
+  const int i = static_cast<int>(std::floor(u));
+  const int j = static_cast<int>(std::floor(v));
+  const float du = u - i;
+  const float dv = v - j;
+  return (1 - dv) * ((1 - du) * Hash(i, j) + du * Hash(i + 1, j)) +
+         dv * ((1 - du) * Hash(i, j + 1) + du * Hash(i + 1, j + 1));
+}
+
+// Camera with identity rotation at the given horizontal position, which
+// observes the textured plane.
+Image CreatePlaneImage(const float center_x) {
+  const float K[9] = {kFocalLength,
+                      0,
+                      0.5f * (kWidth - 1),
+                      0,
+                      kFocalLength,
+                      0.5f * (kHeight - 1),
+                      0,
+                      0,
+                      1};
+  const float R[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+  const float T[3] = {-center_x, 0, 0};
+  Image image("", kWidth, kHeight, K, R, T);
+
+  Bitmap bitmap;
+  bitmap.Allocate(kWidth, kHeight, /*as_rgb=*/false);
+  for (int row = 0; row < kHeight; ++row) {
+    for (int col = 0; col < kWidth; ++col) {
+      const float x = (col - K[2]) / K[0] * kPlaneDepth + center_x;
+      const float y = (row - K[5]) / K[4] * kPlaneDepth;
+      bitmap.SetPixel(col,
+                      row,
+                      BitmapColor<uint8_t>(static_cast<uint8_t>(
+                          std::round(255 * PlaneTexture(x, y)))));
+    }
+  }
+  image.SetBitmap(bitmap);
+  return image;
+}
+
+PatchMatchOptions CreatePlaneOptions() {
+  PatchMatchOptions options;
+  options.depth_min = 5;
+  options.depth_max = 20;
+  options.window_radius = 3;
+  options.sigma_spatial = options.window_radius;
+  options.num_iterations = 3;
+  options.geom_consistency = false;
+  options.filter = false;
+  return options;
+}
+
+TEST(PatchMatchCpu, FrontoParallelPlane) {
+  std::vector<Image> images = {
+      CreatePlaneImage(0), CreatePlaneImage(-1), CreatePlaneImage(1)};
+  PatchMatch::Problem problem;
+  problem.ref_image_idx = 0;
+  problem.src_image_idxs = {1, 2};
+  problem.images = &images;
+
+  PatchMatchCpu patch_match(CreatePlaneOptions(), problem);
+  patch_match.Run();
+
+  const DepthMap depth_map = patch_match.GetDepthMap();
+  EXPECT_EQ(depth_map.GetWidth(), kWidth);
+  EXPECT_EQ(depth_map.GetHeight(), kHeight);
+  const NormalMap normal_map = patch_match.GetNormalMap();
+  EXPECT_EQ(normal_map.GetWidth(), kWidth);
+  EXPECT_EQ(normal_map.GetHeight(), kHeight);
+  const Mat<float> sel_prob_map = patch_match.GetSelProbMap();
+  EXPECT_EQ(sel_prob_map.GetWidth(), kWidth);
+  EXPECT_EQ(sel_prob_map.GetHeight(), kHeight);
+  EXPECT_EQ(sel_prob_map.GetDepth(), 2);
+  EXPECT_TRUE(patch_match.GetConsistentImageIdxs().empty());
+
+  // The inner pixels are observed by both source images.
+  std::vector<float> depth_errors;
+  for (int row = 8; row < kHeight - 8; ++row) {
+    for (int col = 16; col < kWidth - 16; ++col) {
+      depth_errors.push_back(std::abs(depth_map.Get(row, col) - kPlaneDepth));
+    }
+  }
+  std::nth_element(depth_errors.begin(),
+                   depth_errors.begin() + depth_errors.size() / 2,
+                   depth_errors.end());
+  EXPECT_LT(depth_errors[depth_errors.size() / 2], 0.05 * kPlaneDepth);
+}
+
+TEST(PatchMatchCpu, FilterAndConsistencyGraph) {
+  std::vector<Image> images = {
+      CreatePlaneImage(0), CreatePlaneImage(-1), CreatePlaneImage(1)};
+  PatchMatch::Problem problem;
+  problem.ref_image_idx = 0;
+  problem.src_image_idxs = {1, 2};
+  problem.images = &images;
+
+  PatchMatchOptions options = CreatePlaneOptions();
+  options.filter = true;
+  options.filter_min_num_consistent = 1;
+  PatchMatchCpu patch_match(options, problem);
+  patch_match.Run();
+
+  const DepthMap depth_map = patch_match.GetDepthMap();
+  const std::vector<int> consistent_image_idxs =
+      patch_match.GetConsistentImageIdxs();
+  EXPECT_FALSE(consistent_image_idxs.empty());
+  for (size_t i = 0; i < consistent_image_idxs.size();) {
+    const int col = consistent_image_idxs[i];
+    const int row = consistent_image_idxs[i + 1];
+    const int num_images = consistent_image_idxs[i + 2];
+    EXPECT_GE(num_images, 1);
+    EXPECT_LE(num_images, 2);
+    EXPECT_GT(depth_map.Get(row, col), 0);
+    for (int j = 0; j < num_images; ++j) {
+      const int image_idx = consistent_image_idxs[i + 3 + j];
+      EXPECT_TRUE(image_idx == 1 || image_idx == 2);
+    }
+    i += 3 + num_images;
+  }
+}
+
+TEST(PatchMatchCpu, IndependentOfNumThreads) {
+  std::vector<Image> images = {
+      CreatePlaneImage(0), CreatePlaneImage(-1), CreatePlaneImage(1)};
+  PatchMatch::Problem problem;
+  problem.ref_image_idx = 0;
+  problem.src_image_idxs = {1, 2};
+  problem.images = &images;
+
+  PatchMatchOptions options = CreatePlaneOptions();
+  options.num_iterations = 1;
+  options.num_threads = 1;
+  PatchMatchCpu patch_match1(options, problem);
+  patch_match1.Run();
+  options.num_threads = 3;
+  PatchMatchCpu patch_match2(options, problem);
+  patch_match2.Run();
+
+  EXPECT_EQ(patch_match1.GetDepthMap().GetData(),
+            patch_match2.GetDepthMap().GetData());
+  EXPECT_EQ(patch_match1.GetNormalMap().GetData(),
+            patch_match2.GetNormalMap().GetData());
+}
+
+}  // namespace
+}  // namespace mvs
+}  // namespace colmap
@@ -33,6 +33,7 @@
 #include "colmap/util/cuda.h"
 #include "colmap/util/cudacc.h"
 #include "colmap/util/logging.h"
+#include "colmap/util/profiler.h"
 
 #include <algorithm>
 #include <cfloat>
@@ -1245,21 +1246,116 @@ __global__ void SweepFromTopToBottom(
   }
 }
 
-PatchMatchCuda::PatchMatchCuda(const PatchMatchOptions& options,
-                               const PatchMatch::Problem& problem)
+// Convert a depth to the precision of the source depth maps texture.
+template <typename T>
+T ConvertDepth(float depth);
+
+template <>
+inline float ConvertDepth<float>(const float depth) {
+  return depth;
+}
+
+template <>
+inline __half ConvertDepth<__half>(const float depth) {
+  return __float2half(depth);
+}
+
+PatchMatchCudaWorkspace::PatchMatchCudaWorkspace() {
+  CUDA_SAFE_CALL(cudaGetDevice(&device_));
+}
+
+PatchMatchCudaWorkspace::~PatchMatchCudaWorkspace() {
+  // The memory must be freed on the device it was allocated on, which is not
+  // necessarily the active device of the destroying thread.
+  int active_device;
+  CUDA_SAFE_CALL(cudaGetDevice(&active_device));
+  CUDA_SAFE_CALL(cudaSetDevice(device_));
+  Clear();
+  CUDA_SAFE_CALL(cudaSetDevice(active_device));
+}
+
+std::unique_ptr<GpuMat<curandState>>
+PatchMatchCudaWorkspace::AcquireRandStateMap(const size_t width,
+                                             const size_t height) {
+  std::unique_ptr<GpuMat<curandState>> map =
+      rand_state_maps_.Pop([&](const GpuMat<curandState>& map) {
+        return map.GetWidth() == width && map.GetHeight() == height;
+      });
+  if (map == nullptr) {
+    // Only the initialization of random states is expensive. The rotated
+    // copies during the sweeps are acquired as regular matrices.
+    map = std::make_unique<GpuMat<curandState>>(GpuMatPRNG(width, height));
+  }
+  return map;
+}
+
+void PatchMatchCudaWorkspace::ReleaseRandStateMap(
+    std::unique_ptr<GpuMat<curandState>> map) {
+  rand_state_maps_.Push(std::move(map));
+}
+
+void PatchMatchCudaWorkspace::Clear() {
+  std::get<0>(mats_).Clear();
+  std::get<1>(mats_).Clear();
+  std::get<2>(mats_).Clear();
+  std::get<0>(textures_).Clear();
+  std::get<1>(textures_).Clear();
+  std::get<2>(textures_).Clear();
+  rand_state_maps_.Clear();
+  std::get<0>(depth_maps_).clear();
+  std::get<1>(depth_maps_).clear();
+}
+
+PatchMatchCuda::PatchMatchCuda(
+    const PatchMatchOptions& options,
+    const PatchMatch::Problem& problem,
+    std::shared_ptr<PatchMatchCudaWorkspace> workspace)
     : options_(options),
       problem_(problem),
+      workspace_(std::move(workspace)),
       ref_width_(0),
       ref_height_(0),
       rotation_in_half_pi_(0) {
   SetBestCudaDevice(std::stoi(options_.gpu_index));
+  if (workspace_ == nullptr) {
+    workspace_ = std::make_shared<PatchMatchCudaWorkspace>();
+  }
   InitRefImage();
   InitSourceImages();
   InitTransforms();
   InitWorkspaceMemory();
 }
 
+PatchMatchCuda::~PatchMatchCuda() {
+  // Wait for pending kernels before the memory is handed to the next problem.
+  CUDA_SYNC_AND_CHECK();
+
+  workspace_->ReleaseTexture(std::move(ref_image_texture_));
+  workspace_->ReleaseTexture(std::move(src_images_texture_));
+  workspace_->ReleaseTexture(std::move(src_depth_maps_texture_));
+  workspace_->ReleaseTexture(std::move(src_depth_maps_half_texture_));
+  for (auto& poses_texture : poses_texture_) {
+    workspace_->ReleaseTexture(std::move(poses_texture));
+  }
+
+  if (ref_image_ != nullptr) {
+    workspace_->ReleaseMat(std::move(ref_image_->image));
+    workspace_->ReleaseMat(std::move(ref_image_->sum_image));
+    workspace_->ReleaseMat(std::move(ref_image_->squared_sum_image));
+  }
+  workspace_->ReleaseMat(std::move(depth_map_));
+  workspace_->ReleaseMat(std::move(normal_map_));
+  workspace_->ReleaseMat(std::move(sel_prob_map_));
+  workspace_->ReleaseMat(std::move(prev_sel_prob_map_));
+  workspace_->ReleaseMat(std::move(cost_map_));
+  workspace_->ReleaseMat(std::move(consistency_mask_));
+  workspace_->ReleaseMat(std::move(global_workspace_));
+  workspace_->ReleaseRandStateMap(std::move(rand_state_map_));
+}
+
 void PatchMatchCuda::Run() {
+  COLMAP_PROFILE_ZONE("PatchMatchCuda::Run");
+
 #define CASE_WINDOW_RADIUS(window_radius, window_step)              \
   case window_radius:                                               \
     RunWithWindowSizeAndStep<2 * window_radius + 1, window_step>(); \
@@ -1428,17 +1524,17 @@ void PatchMatchCuda::RunWithWindowSizeAndStep() {
           *ref_image_->sum_image,                         \
           *ref_image_->squared_sum_image,                 \
           src_images_texture_->GetObj(),                  \
-          src_depth_maps_texture_ == nullptr              \
-              ? 0                                         \
-              : src_depth_maps_texture_->GetObj(),        \
+          GetSrcDepthMapsTexture(),                       \
           poses_texture_[rotation_in_half_pi_]->GetObj(), \
           sweep_options);
 
       if (last_sweep) {
         if (options_.filter) {
-          consistency_mask_.reset(new GpuMat<uint8_t>(cost_map_->GetWidth(),
-                                                      cost_map_->GetHeight(),
-                                                      cost_map_->GetDepth()));
+          workspace_->ReleaseMat(std::move(consistency_mask_));
+          consistency_mask_ =
+              workspace_->AcquireMat<uint8_t>(cost_map_->GetWidth(),
+                                              cost_map_->GetHeight(),
+                                              cost_map_->GetDepth());
           consistency_mask_->FillWithScalar(0);
         }
         if (options_.geom_consistency) {
@@ -1484,12 +1580,13 @@ void PatchMatchCuda::RunWithWindowSizeAndStep() {
 
       // Rotate selected image map.
       if (last_sweep && options_.filter) {
-        std::unique_ptr<GpuMat<uint8_t>> rot_consistency_mask_(
-            new GpuMat<uint8_t>(cost_map_->GetWidth(),
-                                cost_map_->GetHeight(),
-                                cost_map_->GetDepth()));
+        std::unique_ptr<GpuMat<uint8_t>> rot_consistency_mask_ =
+            workspace_->AcquireMat<uint8_t>(cost_map_->GetWidth(),
+                                            cost_map_->GetHeight(),
+                                            cost_map_->GetDepth());
         consistency_mask_->Rotate(rot_consistency_mask_.get());
         consistency_mask_.swap(rot_consistency_mask_);
+        workspace_->ReleaseMat(std::move(rot_consistency_mask_));
       }
 
       sweep_timer.Print(" Sweep " + std::to_string(sweep + 1));
@@ -1527,8 +1624,16 @@ void PatchMatchCuda::BindRefImageTexture() {
   texture_desc.filterMode = cudaFilterModePoint;
   texture_desc.readMode = cudaReadModeNormalizedFloat;
   texture_desc.normalizedCoords = false;
-  ref_image_texture_ = CudaArrayLayeredTexture<uint8_t>::FromGpuMat(
-      texture_desc, *ref_image_->image);
+  // The previous texture has the dimensions of the reference image before
+  // rotation. The texture of the current orientation is taken from the
+  // workspace, so that no new array is allocated for every rotation.
+  workspace_->ReleaseTexture(std::move(ref_image_texture_));
+  ref_image_texture_ =
+      workspace_->AcquireTexture<uint8_t>(texture_desc,
+                                          ref_image_->image->GetWidth(),
+                                          ref_image_->image->GetHeight(),
+                                          ref_image_->image->GetDepth());
+  ref_image_texture_->CopyFromGpuMat(*ref_image_->image);
 }
 
 void PatchMatchCuda::InitRefImage() {
@@ -1538,7 +1643,10 @@ void PatchMatchCuda::InitRefImage() {
   ref_height_ = ref_image.GetHeight();
 
   // Upload to device and filter.
-  ref_image_.reset(new GpuMatRefImage(ref_width_, ref_height_));
+  ref_image_ = std::make_unique<GpuMatRefImage>(
+      workspace_->AcquireMat<uint8_t>(ref_width_, ref_height_),
+      workspace_->AcquireMat<float>(ref_width_, ref_height_),
+      workspace_->AcquireMat<float>(ref_width_, ref_height_));
   const std::vector<uint8_t> ref_image_array =
       ref_image.GetBitmap().ConvertToRowMajorArray();
   ref_image_->Filter(ref_image_array.data(),
@@ -1591,49 +1699,112 @@ void PatchMatchCuda::InitSourceImages() {
     texture_desc.filterMode = cudaFilterModeLinear;
     texture_desc.readMode = cudaReadModeNormalizedFloat;
     texture_desc.normalizedCoords = false;
-    src_images_texture_ = CudaArrayLayeredTexture<uint8_t>::FromHostArray(
-        texture_desc,
-        max_width,
-        max_height,
-        problem_.src_image_idxs.size(),
-        src_images_host_data.data());
+    src_images_texture_ = workspace_->AcquireTexture<uint8_t>(
+        texture_desc, max_width, max_height, problem_.src_image_idxs.size());
+    src_images_texture_->CopyFromHostArray(src_images_host_data.data());
   }
 
   // Upload source depth maps to device.
   if (options_.geom_consistency) {
-    const float kDefaultValue = 0.0f;
-    std::vector<float> src_depth_maps_host_data(
-        static_cast<size_t>(max_width * max_height *
-                            problem_.src_image_idxs.size()),
-        kDefaultValue);
-    for (size_t i = 0; i < problem_.src_image_idxs.size(); ++i) {
+    if (options_.half_precision_depth_maps) {
+      src_depth_maps_half_texture_ =
+          InitSrcDepthMapsTexture<__half>(max_width, max_height);
+    } else {
+      src_depth_maps_texture_ =
+          InitSrcDepthMapsTexture<float>(max_width, max_height);
+    }
+  }
+}
+
+template <typename T>
+std::unique_ptr<CudaArrayLayeredTexture<T>>
+PatchMatchCuda::InitSrcDepthMapsTexture(const size_t max_width,
+                                        const size_t max_height) {
+  const size_t num_src_images = problem_.src_image_idxs.size();
+
+  // Half precision textures are promoted to float on fetch, such that the
+  // kernels are agnostic to the precision.
+  cudaTextureDesc texture_desc;
+  memset(&texture_desc, 0, sizeof(texture_desc));
+  texture_desc.addressMode[0] = cudaAddressModeBorder;
+  texture_desc.addressMode[1] = cudaAddressModeBorder;
+  texture_desc.addressMode[2] = cudaAddressModeBorder;
+  texture_desc.filterMode = cudaFilterModePoint;
+  texture_desc.readMode = cudaReadModeElementType;
+  texture_desc.normalizedCoords = false;
+  std::unique_ptr<CudaArrayLayeredTexture<T>> texture =
+      workspace_->AcquireTexture<T>(
+          texture_desc, max_width, max_height, num_src_images);
+
+  if (!problem_.cache_src_depth_maps ||
+      options_.gpu_depth_map_cache_size <= 0) {
+    // Copy source depth maps to contiguous memory block.
+    std::vector<T> host_data(max_width * max_height * num_src_images,
+                             ConvertDepth<T>(0.0f));
+    for (size_t i = 0; i < num_src_images; ++i) {
       const DepthMap& depth_map =
           problem_.depth_maps->at(problem_.src_image_idxs[i]);
-      float* dest =
-          src_depth_maps_host_data.data() + max_width * max_height * i;
+      T* dest = host_data.data() + max_width * max_height * i;
       for (size_t r = 0; r < depth_map.GetHeight(); ++r) {
-        memcpy(dest,
-               depth_map.GetPtr() + r * depth_map.GetWidth(),
-               depth_map.GetWidth() * sizeof(float));
+        for (size_t c = 0; c < depth_map.GetWidth(); ++c) {
+          dest[c] = ConvertDepth<T>(depth_map.Get(r, c));
+        }
         dest += max_width;
       }
     }
+    texture->CopyFromHostArray(host_data.data());
+    return texture;
+  }
 
-    // Create source depth maps texture.
-    cudaTextureDesc texture_desc;
-    memset(&texture_desc, 0, sizeof(texture_desc));
-    texture_desc.addressMode[0] = cudaAddressModeBorder;
-    texture_desc.addressMode[1] = cudaAddressModeBorder;
-    texture_desc.addressMode[2] = cudaAddressModeBorder;
-    texture_desc.filterMode = cudaFilterModePoint;
-    texture_desc.readMode = cudaReadModeElementType;
-    texture_desc.normalizedCoords = false;
-    src_depth_maps_texture_ = CudaArrayLayeredTexture<float>::FromHostArray(
-        texture_desc,
-        max_width,
-        max_height,
-        problem_.src_image_idxs.size(),
-        src_depth_maps_host_data.data());
+  // Only upload the depth maps, which are not yet resident on the device,
+  // and assemble the texture with device to device copies.
+  const size_t max_num_bytes = static_cast<size_t>(
+      options_.gpu_depth_map_cache_size * 1024 * 1024 * 1024);
+  std::unique_ptr<GpuMat<T>> zeros;
+  std::vector<T> host_data;
+  for (size_t i = 0; i < num_src_images; ++i) {
+    const int image_idx = problem_.src_image_idxs[i];
+    const DepthMap& depth_map = problem_.depth_maps->at(image_idx);
+    std::unique_ptr<GpuMat<T>> src_depth_map =
+        workspace_->AcquireDepthMap<T>(image_idx);
+    if (src_depth_map == nullptr ||
+        src_depth_map->GetWidth() != depth_map.GetWidth() ||
+        src_depth_map->GetHeight() != depth_map.GetHeight()) {
+      host_data.resize(depth_map.GetWidth() * depth_map.GetHeight());
+      for (size_t j = 0; j < host_data.size(); ++j) {
+        host_data[j] = ConvertDepth<T>(depth_map.GetPtr()[j]);
+      }
+      src_depth_map = std::make_unique<GpuMat<T>>(
+          depth_map.GetWidth(), depth_map.GetHeight(), 1);
+      src_depth_map->CopyToDevice(host_data.data(),
+                                  depth_map.GetWidth() * sizeof(T));
+    }
+
+    // Smaller depth maps are padded with zeros as in the host upload.
+    if (depth_map.GetWidth() < max_width ||
+        depth_map.GetHeight() < max_height) {
+      if (zeros == nullptr) {
+        zeros = std::make_unique<GpuMat<T>>(max_width, max_height, 1);
+        zeros->FillWithScalar(ConvertDepth<T>(0.0f));
+      }
+      texture->CopyLayerFromGpuMat(i, *zeros);
+    }
+    texture->CopyLayerFromGpuMat(i, *src_depth_map);
+
+    workspace_->ReleaseDepthMap(
+        image_idx, std::move(src_depth_map), max_num_bytes);
+  }
+
+  return texture;
+}
+
+cudaTextureObject_t PatchMatchCuda::GetSrcDepthMapsTexture() const {
+  if (src_depth_maps_half_texture_ != nullptr) {
+    return src_depth_maps_half_texture_->GetObj();
+  } else if (src_depth_maps_texture_ != nullptr) {
+    return src_depth_maps_texture_->GetObj();
+  } else {
+    return 0;
   }
 }
 
@@ -1742,22 +1913,23 @@ void PatchMatchCuda::InitTransforms() {
       offset += 12;
     }
 
-    poses_texture_[i] = CudaArrayLayeredTexture<float>::FromHostArray(
-        texture_desc,
-        kNumTformParams,
-        problem_.src_image_idxs.size(),
-        1,
-        poses_host_data.data());
+    poses_texture_[i] = workspace_->AcquireTexture<float>(
+        texture_desc, kNumTformParams, problem_.src_image_idxs.size(), 1);
+    poses_texture_[i]->CopyFromHostArray(poses_host_data.data());
 
     RotatePose(R_z90, rotated_R, rotated_T);
   }
 }
 
 void PatchMatchCuda::InitWorkspaceMemory() {
-  rand_state_map_.reset(new GpuMatPRNG(ref_width_, ref_height_));
-
-  depth_map_.reset(new GpuMat<float>(ref_width_, ref_height_));
-  if (options_.geom_consistency) {
+  rand_state_map_ = workspace_->AcquireRandStateMap(ref_width_, ref_height_);
+
+  depth_map_ = workspace_->AcquireMat<float>(ref_width_, ref_height_);
+  if (problem_.init_depth_map != nullptr) {
+    depth_map_->CopyToDevice(problem_.init_depth_map->GetPtr(),
+                             problem_.init_depth_map->GetWidth() *
+                                 sizeof(float));
+  } else if (options_.geom_consistency) {
     const DepthMap& init_depth_map =
         problem_.depth_maps->at(problem_.ref_image_idx);
     depth_map_->CopyToDevice(init_depth_map.GetPtr(),
@@ -1767,31 +1939,35 @@ void PatchMatchCuda::InitWorkspaceMemory() {
         options_.depth_min, options_.depth_max, *rand_state_map_);
   }
 
-  normal_map_.reset(new GpuMat<float>(ref_width_, ref_height_, 3));
+  normal_map_ = workspace_->AcquireMat<float>(ref_width_, ref_height_, 3);
 
   // Note that it is not necessary to keep the selection probability map in
   // memory for all pixels. Theoretically, it is possible to incorporate
   // the temporary selection probabilities in the global_workspace_.
   // However, it is useful to keep the probabilities for the entire image
   // in memory, so that it can be exported.
-  sel_prob_map_.reset(new GpuMat<float>(
-      ref_width_, ref_height_, problem_.src_image_idxs.size()));
-  prev_sel_prob_map_.reset(new GpuMat<float>(
-      ref_width_, ref_height_, problem_.src_image_idxs.size()));
+  sel_prob_map_ = workspace_->AcquireMat<float>(
+      ref_width_, ref_height_, problem_.src_image_idxs.size());
+  prev_sel_prob_map_ = workspace_->AcquireMat<float>(
+      ref_width_, ref_height_, problem_.src_image_idxs.size());
   prev_sel_prob_map_->FillWithScalar(0.5f);
 
-  cost_map_.reset(new GpuMat<float>(
-      ref_width_, ref_height_, problem_.src_image_idxs.size()));
+  cost_map_ = workspace_->AcquireMat<float>(
+      ref_width_, ref_height_, problem_.src_image_idxs.size());
 
   const int ref_max_dim = std::max(ref_width_, ref_height_);
-  global_workspace_.reset(
-      new GpuMat<float>(ref_max_dim, problem_.src_image_idxs.size(), 2));
+  global_workspace_ = workspace_->AcquireMat<float>(
+      ref_max_dim, problem_.src_image_idxs.size(), 2);
 
-  consistency_mask_.reset(new GpuMat<uint8_t>(0, 0, 0));
+  consistency_mask_ = workspace_->AcquireMat<uint8_t>(0, 0, 0);
 
   ComputeCudaConfig();
 
-  if (options_.geom_consistency) {
+  if (problem_.init_normal_map != nullptr) {
+    normal_map_->CopyToDevice(problem_.init_normal_map->GetPtr(),
+                              problem_.init_normal_map->GetWidth() *
+                                  sizeof(float));
+  } else if (options_.geom_consistency) {
     const NormalMap& init_normal_map =
         problem_.normal_maps->at(problem_.ref_image_idx);
     normal_map_->CopyToDevice(init_normal_map.GetPtr(),
@@ -1817,55 +1993,68 @@ void PatchMatchCuda::Rotate() {
 
   // Rotate random map.
   {
-    std::unique_ptr<GpuMatPRNG> rotated_rand_state_map(
-        new GpuMatPRNG(width, height));
+    std::unique_ptr<GpuMat<curandState>> rotated_rand_state_map =
+        workspace_->AcquireMat<curandState>(width, height);
     rand_state_map_->Rotate(rotated_rand_state_map.get());
     rand_state_map_.swap(rotated_rand_state_map);
+    workspace_->ReleaseMat(std::move(rotated_rand_state_map));
   }
 
   // Rotate depth map.
   {
-    std::unique_ptr<GpuMat<float>> rotated_depth_map(
-        new GpuMat<float>(width, height));
+    std::unique_ptr<GpuMat<float>> rotated_depth_map =
+        workspace_->AcquireMat<float>(width, height);
     depth_map_->Rotate(rotated_depth_map.get());
     depth_map_.swap(rotated_depth_map);
+    workspace_->ReleaseMat(std::move(rotated_depth_map));
   }
 
   // Rotate normal map.
   {
     RotateNormalMap<<<elem_wise_grid_size_, elem_wise_block_size_>>>(
         *normal_map_);
-    std::unique_ptr<GpuMat<float>> rotated_normal_map(
-        new GpuMat<float>(width, height, 3));
+    std::unique_ptr<GpuMat<float>> rotated_normal_map =
+        workspace_->AcquireMat<float>(width, height, 3);
     normal_map_->Rotate(rotated_normal_map.get());
     normal_map_.swap(rotated_normal_map);
+    workspace_->ReleaseMat(std::move(rotated_normal_map));
   }
 
   // Rotate reference image.
   {
-    std::unique_ptr<GpuMatRefImage> rotated_ref_image(
-        new GpuMatRefImage(width, height));
+    std::unique_ptr<GpuMatRefImage> rotated_ref_image =
+        std::make_unique<GpuMatRefImage>(
+            workspace_->AcquireMat<uint8_t>(width, height),
+            workspace_->AcquireMat<float>(width, height),
+            workspace_->AcquireMat<float>(width, height));
     ref_image_->image->Rotate(rotated_ref_image->image.get());
     ref_image_->sum_image->Rotate(rotated_ref_image->sum_image.get());
     ref_image_->squared_sum_image->Rotate(
         rotated_ref_image->squared_sum_image.get());
     ref_image_.swap(rotated_ref_image);
+    workspace_->ReleaseMat(std::move(rotated_ref_image->image));
+    workspace_->ReleaseMat(std::move(rotated_ref_image->sum_image));
+    workspace_->ReleaseMat(std::move(rotated_ref_image->squared_sum_image));
     BindRefImageTexture();
   }
 
   // Rotate selection probability map.
-  prev_sel_prob_map_.reset(
-      new GpuMat<float>(width, height, problem_.src_image_idxs.size()));
+  workspace_->ReleaseMat(std::move(prev_sel_prob_map_));
+  prev_sel_prob_map_ = workspace_->AcquireMat<float>(
+      width, height, problem_.src_image_idxs.size());
   sel_prob_map_->Rotate(prev_sel_prob_map_.get());
-  sel_prob_map_.reset(
-      new GpuMat<float>(width, height, problem_.src_image_idxs.size()));
+  workspace_->ReleaseMat(std::move(sel_prob_map_));
+  sel_prob_map_ = workspace_->AcquireMat<float>(
+      width, height, problem_.src_image_idxs.size());
 
   // Rotate cost map.
   {
-    std::unique_ptr<GpuMat<float>> rotated_cost_map(
-        new GpuMat<float>(width, height, problem_.src_image_idxs.size()));
+    std::unique_ptr<GpuMat<float>> rotated_cost_map =
+        workspace_->AcquireMat<float>(
+            width, height, problem_.src_image_idxs.size());
     cost_map_->Rotate(rotated_cost_map.get());
     cost_map_.swap(rotated_cost_map);
+    workspace_->ReleaseMat(std::move(rotated_cost_map));
   }
 
   // Rotate calibration.
@@ -38,19 +38,133 @@
 #include "colmap/mvs/normal_map.h"
 #include "colmap/mvs/patch_match.h"
 
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <list>
 #include <memory>
+#include <tuple>
 #include <vector>
 
+#include <cuda_fp16.h>
 #include <cuda_runtime.h>
 
 namespace colmap {
 namespace mvs {
 
+// Device memory that is reused across consecutive problems processed on the
+// same GPU. PatchMatchCuda acquires its matrices and textures from the
+// workspace and returns them on destruction, such that subsequent problems
+// with the same dimensions do not allocate device memory. The random states
+// are only initialized once per reference image resolution. A workspace must
+// only be used by one PatchMatchCuda instance at a time.
+class PatchMatchCudaWorkspace {
+ public:
+  // Captures the currently active device.
+  PatchMatchCudaWorkspace();
+  ~PatchMatchCudaWorkspace();
+
+  // Return a cached matrix with enough memory for the given dimensions or
+  // allocate a new one. The contents of the returned matrix are undefined.
+  template <typename T>
+  std::unique_ptr<GpuMat<T>> AcquireMat(size_t width,
+                                        size_t height,
+                                        size_t depth = 1);
+  template <typename T>
+  void ReleaseMat(std::unique_ptr<GpuMat<T>> mat);
+
+  // Return a cached texture of the given dimensions and description or
+  // allocate a new one. The contents of the returned texture are undefined.
+  template <typename T>
+  std::unique_ptr<CudaArrayLayeredTexture<T>> AcquireTexture(
+      const cudaTextureDesc& texture_desc,
+      size_t width,
+      size_t height,
+      size_t depth);
+  template <typename T>
+  void ReleaseTexture(std::unique_ptr<CudaArrayLayeredTexture<T>> texture);
+
+  // Return initialized random states of the given dimensions. The states are
+  // continued from the previous problem, if the dimensions did not change.
+  std::unique_ptr<GpuMat<curandState>> AcquireRandStateMap(size_t width,
+                                                           size_t height);
+  void ReleaseRandStateMap(std::unique_ptr<GpuMat<curandState>> map);
+
+  // Return the resident depth map of the given image or null, if it is not
+  // cached. The depth maps are cached separately per precision.
+  template <typename T>
+  std::unique_ptr<GpuMat<T>> AcquireDepthMap(int image_idx);
+  // Cache the depth map of the given image and free the least recently
+  // released depth maps, if the cache exceeds the given number of bytes.
+  template <typename T>
+  void ReleaseDepthMap(int image_idx,
+                       std::unique_ptr<GpuMat<T>> depth_map,
+                       size_t max_num_bytes);
+
+  // Free all cached device memory.
+  void Clear();
+
+ private:
+  // Bounded cache of objects, where the least recently released objects are
+  // freed first if the capacity is exceeded.
+  template <typename T>
+  class Cache {
+   public:
+    template <typename Predicate>
+    std::unique_ptr<T> Pop(Predicate predicate) {
+      for (auto it = objects_.begin(); it != objects_.end(); ++it) {
+        if (predicate(**it)) {
+          std::unique_ptr<T> object = std::move(*it);
+          objects_.erase(it);
+          return object;
+        }
+      }
+      return nullptr;
+    }
+
+    void Push(std::unique_ptr<T> object) {
+      if (object == nullptr) {
+        return;
+      }
+      objects_.push_back(std::move(object));
+      if (objects_.size() > kMaxNumCachedObjects) {
+        objects_.pop_front();
+      }
+    }
+
+    void Clear() { objects_.clear(); }
+
+   private:
+    // Enough to hold all buffers of one problem.
+    static const size_t kMaxNumCachedObjects = 16;
+    std::deque<std::unique_ptr<T>> objects_;
+  };
+
+  int device_;
+
+  std::tuple<Cache<GpuMat<uint8_t>>,
+             Cache<GpuMat<float>>,
+             Cache<GpuMat<curandState>>>
+      mats_;
+  std::tuple<Cache<CudaArrayLayeredTexture<uint8_t>>,
+             Cache<CudaArrayLayeredTexture<float>>,
+             Cache<CudaArrayLayeredTexture<__half>>>
+      textures_;
+  Cache<GpuMat<curandState>> rand_state_maps_;
+
+  template <typename T>
+  using DepthMapCache = std::list<std::pair<int, std::unique_ptr<GpuMat<T>>>>;
+  std::tuple<DepthMapCache<float>, DepthMapCache<__half>> depth_maps_;
+};
+
 class PatchMatchCuda {
  public:
+  // If no workspace is given, the device memory is allocated for this
+  // instance only.
   PatchMatchCuda(const PatchMatchOptions& options,
-                 const PatchMatch::Problem& problem);
+                 const PatchMatch::Problem& problem,
+                 std::shared_ptr<PatchMatchCudaWorkspace> workspace = nullptr);
+  ~PatchMatchCuda();
 
   void Run();
 
@@ -72,11 +186,22 @@ class PatchMatchCuda {
   void InitTransforms();
   void InitWorkspaceMemory();
 
+  // Upload the source depth maps to a texture, either from the host or from
+  // the depth maps that are resident in the workspace.
+  template <typename T>
+  std::unique_ptr<CudaArrayLayeredTexture<T>> InitSrcDepthMapsTexture(
+      size_t max_width, size_t max_height);
+
+  // Texture of the source depth maps in the configured precision or zero, if
+  // geometric consistency is disabled.
+  cudaTextureObject_t GetSrcDepthMapsTexture() const;
+
   // Rotate reference image by 90 degrees in counter-clockwise direction.
   void Rotate();
 
   const PatchMatchOptions options_;
   const PatchMatch::Problem problem_;
+  std::shared_ptr<PatchMatchCudaWorkspace> workspace_;
 
   // Dimensions for sweeping from top to bottom, i.e. one thread per column.
   dim3 sweep_block_size_;
@@ -97,6 +222,8 @@ class PatchMatchCuda {
   std::unique_ptr<CudaArrayLayeredTexture<uint8_t>> ref_image_texture_;
   std::unique_ptr<CudaArrayLayeredTexture<uint8_t>> src_images_texture_;
   std::unique_ptr<CudaArrayLayeredTexture<float>> src_depth_maps_texture_;
+  std::unique_ptr<CudaArrayLayeredTexture<__half>>
+      src_depth_maps_half_texture_;
 
   // Relative poses from rotated versions of reference image to source images
   // corresponding to _rotationInHalfPi:
@@ -126,7 +253,7 @@ class PatchMatchCuda {
   std::unique_ptr<GpuMat<float>> sel_prob_map_;
   std::unique_ptr<GpuMat<float>> prev_sel_prob_map_;
   std::unique_ptr<GpuMat<float>> cost_map_;
-  std::unique_ptr<GpuMatPRNG> rand_state_map_;
+  std::unique_ptr<GpuMat<curandState>> rand_state_map_;
   std::unique_ptr<GpuMat<uint8_t>> consistency_mask_;
 
   // Shared memory is too small to hold local state for each thread,
@@ -134,5 +261,102 @@ class PatchMatchCuda {
   std::unique_ptr<GpuMat<float>> global_workspace_;
 };
 
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef __CUDACC__
+
+template <typename T>
+std::unique_ptr<GpuMat<T>> PatchMatchCudaWorkspace::AcquireMat(
+    const size_t width, const size_t height, const size_t depth) {
+  Cache<GpuMat<T>>& cache = std::get<Cache<GpuMat<T>>>(mats_);
+  // Prefer matrices of the same dimensions and otherwise reshape any matrix
+  // with enough memory, e.g., the previous orientation of a rotated matrix.
+  std::unique_ptr<GpuMat<T>> mat = cache.Pop([&](const GpuMat<T>& mat) {
+    return mat.GetWidth() == width && mat.GetHeight() == height &&
+           mat.GetDepth() == depth;
+  });
+  if (mat == nullptr) {
+    mat = cache.Pop([&](const GpuMat<T>& mat) {
+      return mat.CanReshape(width, height, depth);
+    });
+  }
+  if (mat == nullptr) {
+    mat = std::make_unique<GpuMat<T>>(width, height, depth);
+  } else {
+    mat->Reshape(width, height, depth);
+  }
+  return mat;
+}
+
+template <typename T>
+void PatchMatchCudaWorkspace::ReleaseMat(std::unique_ptr<GpuMat<T>> mat) {
+  std::get<Cache<GpuMat<T>>>(mats_).Push(std::move(mat));
+}
+
+template <typename T>
+std::unique_ptr<CudaArrayLayeredTexture<T>>
+PatchMatchCudaWorkspace::AcquireTexture(const cudaTextureDesc& texture_desc,
+                                        const size_t width,
+                                        const size_t height,
+                                        const size_t depth) {
+  std::unique_ptr<CudaArrayLayeredTexture<T>> texture =
+      std::get<Cache<CudaArrayLayeredTexture<T>>>(textures_)
+          .Pop([&](const CudaArrayLayeredTexture<T>& texture) {
+            return texture.GetWidth() == width &&
+                   texture.GetHeight() == height &&
+                   texture.GetDepth() == depth &&
+                   memcmp(&texture.GetTextureDesc(),
+                          &texture_desc,
+                          sizeof(cudaTextureDesc)) == 0;
+          });
+  if (texture == nullptr) {
+    texture = std::make_unique<CudaArrayLayeredTexture<T>>(
+        texture_desc, width, height, depth);
+  }
+  return texture;
+}
+
+template <typename T>
+void PatchMatchCudaWorkspace::ReleaseTexture(
+    std::unique_ptr<CudaArrayLayeredTexture<T>> texture) {
+  std::get<Cache<CudaArrayLayeredTexture<T>>>(textures_).Push(
+      std::move(texture));
+}
+
+template <typename T>
+std::unique_ptr<GpuMat<T>> PatchMatchCudaWorkspace::AcquireDepthMap(
+    const int image_idx) {
+  DepthMapCache<T>& depth_maps = std::get<DepthMapCache<T>>(depth_maps_);
+  for (auto it = depth_maps.begin(); it != depth_maps.end(); ++it) {
+    if (it->first == image_idx) {
+      std::unique_ptr<GpuMat<T>> depth_map = std::move(it->second);
+      depth_maps.erase(it);
+      return depth_map;
+    }
+  }
+  return nullptr;
+}
+
+template <typename T>
+void PatchMatchCudaWorkspace::ReleaseDepthMap(
+    const int image_idx,
+    std::unique_ptr<GpuMat<T>> depth_map,
+    const size_t max_num_bytes) {
+  DepthMapCache<T>& depth_maps = std::get<DepthMapCache<T>>(depth_maps_);
+  depth_maps.emplace_back(image_idx, std::move(depth_map));
+  size_t num_bytes = 0;
+  for (const auto& cached_depth_map : depth_maps) {
+    num_bytes += cached_depth_map.second->GetCapacity();
+  }
+  while (num_bytes > max_num_bytes) {
+    num_bytes -= depth_maps.front().second->GetCapacity();
+    depth_maps.pop_front();
+  }
+}
+
+#endif  // __CUDACC__
+
 }  // namespace mvs
 }  // namespace colmap
@@ -31,6 +31,7 @@
 
 #include "colmap/util/threading.h"
 
+#include <algorithm>
 #include <numeric>
 
 namespace colmap {
@@ -49,6 +50,8 @@ Workspace::Workspace(const Options& options) : options_(options) {
       JoinPaths(options_.workspace_path, options_.stereo_folder, "depth_maps"));
   normal_map_path_ = EnsureTrailingSlash(JoinPaths(
       options_.workspace_path, options_.stereo_folder, "normal_maps"));
+  consistency_graph_path_ = EnsureTrailingSlash(JoinPaths(
+      options_.workspace_path, options_.stereo_folder, "consistency_graphs"));
 }
 
 std::string Workspace::GetFileName(const int image_idx) const {
@@ -134,6 +137,10 @@ std::string Workspace::GetNormalMapPath(const int image_idx) const {
   return normal_map_path_ + GetFileName(image_idx);
 }
 
+std::string Workspace::GetConsistencyGraphPath(const int image_idx) const {
+  return consistency_graph_path_ + GetFileName(image_idx);
+}
+
 bool Workspace::HasBitmap(const int image_idx) const {
   return ExistsFile(GetBitmapPath(image_idx));
 }
@@ -146,6 +153,10 @@ bool Workspace::HasNormalMap(const int image_idx) const {
   return ExistsFile(GetNormalMapPath(image_idx));
 }
 
+bool Workspace::HasConsistencyGraph(const int image_idx) const {
+  return ExistsFile(GetConsistencyGraphPath(image_idx));
+}
+
 CachedWorkspace::CachedImage::CachedImage(CachedImage&& other) noexcept {
   num_bytes = other.num_bytes;
   bitmap = std::move(other.bitmap);
@@ -166,8 +177,19 @@ CachedWorkspace::CachedImage& CachedWorkspace::CachedImage::operator=(
 
 CachedWorkspace::CachedWorkspace(const Options& options)
     : Workspace(options),
-      cache_((size_t)(1024.0 * 1024.0 * 1024.0 * options.cache_size),
-             [](const int) { return CachedImage(); }) {}
+      max_cache_num_bytes_(
+          (size_t)(1024.0 * 1024.0 * 1024.0 * options.cache_size)),
+      cache_(max_cache_num_bytes_, [](const int) { return CachedImage(); }),
+      memory_account_("CachedWorkspace") {}
+
+void CachedWorkspace::UpdateMemoryBudget() {
+  const size_t max_num_bytes =
+      memory_account_.AvailableNumBytes(max_cache_num_bytes_);
+  if (max_num_bytes != cache_.MaxNumBytes()) {
+    cache_.SetMaxNumBytes(std::max<size_t>(max_num_bytes, 1));
+  }
+  memory_account_.SetNumBytes(cache_.NumBytes());
+}
 
 const Bitmap& CachedWorkspace::GetBitmap(const int image_idx) {
   auto& cached_image = cache_.GetMutable(image_idx);
@@ -180,6 +202,7 @@ const Bitmap& CachedWorkspace::GetBitmap(const int image_idx) {
     }
     cached_image.num_bytes += cached_image.bitmap->NumBytes();
     cache_.UpdateNumBytes(image_idx);
+    UpdateMemoryBudget();
   }
   return *cached_image.bitmap;
 }
@@ -195,6 +218,7 @@ const DepthMap& CachedWorkspace::GetDepthMap(const int image_idx) {
     }
     cached_image.num_bytes += cached_image.depth_map->GetNumBytes();
     cache_.UpdateNumBytes(image_idx);
+    UpdateMemoryBudget();
   }
   return *cached_image.depth_map;
 }
@@ -211,6 +235,7 @@ const NormalMap& CachedWorkspace::GetNormalMap(const int image_idx) {
     }
     cached_image.num_bytes += cached_image.normal_map->GetNumBytes();
     cache_.UpdateNumBytes(image_idx);
+    UpdateMemoryBudget();
   }
   return *cached_image.normal_map;
 }
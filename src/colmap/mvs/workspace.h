@@ -35,6 +35,7 @@
 #include "colmap/mvs/normal_map.h"
 #include "colmap/sensor/bitmap.h"
 #include "colmap/util/cache.h"
+#include "colmap/util/memory_budget.h"
 #include "colmap/util/misc.h"
 
 #include <memory>
@@ -82,11 +83,13 @@ class Workspace {
   std::string GetBitmapPath(int image_idx) const;
   std::string GetDepthMapPath(int image_idx) const;
   std::string GetNormalMapPath(int image_idx) const;
+  std::string GetConsistencyGraphPath(int image_idx) const;
 
   // Return whether bitmap, depth map, normal map, and consistency graph exist.
   bool HasBitmap(int image_idx) const;
   bool HasDepthMap(int image_idx) const;
   bool HasNormalMap(int image_idx) const;
+  bool HasConsistencyGraph(int image_idx) const;
 
  protected:
   std::string GetFileName(int image_idx) const;
@@ -97,6 +100,7 @@ class Workspace {
  private:
   std::string depth_map_path_;
   std::string normal_map_path_;
+  std::string consistency_graph_path_;
   std::vector<std::unique_ptr<Bitmap>> bitmaps_;
   std::vector<std::unique_ptr<DepthMap>> depth_maps_;
   std::vector<std::unique_ptr<NormalMap>> normal_maps_;
@@ -108,13 +112,20 @@ class CachedWorkspace : public Workspace {
 
   void Load(const std::vector<std::string>& image_names) override {}
 
-  inline void ClearCache() { cache_.Clear(); }
+  inline void ClearCache() {
+    cache_.Clear();
+    memory_account_.SetNumBytes(0);
+  }
 
   const Bitmap& GetBitmap(int image_idx) override;
   const DepthMap& GetDepthMap(int image_idx) override;
   const NormalMap& GetNormalMap(int image_idx) override;
 
  private:
+  // Report the size of the cache to the global memory budget and shrink the
+  // cache, if other subsystems leave less memory than the configured size.
+  void UpdateMemoryBudget();
+
   class CachedImage {
    public:
     CachedImage() {}
@@ -130,7 +141,9 @@ class CachedWorkspace : public Workspace {
     NON_COPYABLE(CachedImage)
   };
 
+  const size_t max_cache_num_bytes_;
   MemoryConstrainedLRUCache<int, CachedImage> cache_;
+  MemoryAccount memory_account_;
 };
 
 // Import a PMVS workspace into the COLMAP workspace format. Only images in the
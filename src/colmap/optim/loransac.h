@@ -33,6 +33,7 @@
 #include "colmap/optim/ransac.h"
 #include "colmap/optim/support_measurement.h"
 #include "colmap/util/logging.h"
+#include "colmap/util/profiler.h"
 
 #include <cfloat>
 #include <random>
@@ -70,6 +71,10 @@ class LORANSAC : public RANSAC<Estimator, SupportMeasurer, Sampler> {
   using RANSAC<Estimator, SupportMeasurer, Sampler>::support_measurer;
 
  private:
+  using typename RANSAC<Estimator, SupportMeasurer, Sampler>::SampleBlocks;
+  using RANSAC<Estimator, SupportMeasurer, Sampler>::SplitSamplesIntoBlocks;
+  using RANSAC<Estimator, SupportMeasurer, Sampler>::InitializeSPRT;
+  using RANSAC<Estimator, SupportMeasurer, Sampler>::EvaluateModel;
   using RANSAC<Estimator, SupportMeasurer, Sampler>::options_;
 };
 
@@ -93,6 +98,7 @@ typename LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Report
 LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
     const std::vector<typename Estimator::X_t>& X,
     const std::vector<typename Estimator::Y_t>& Y) {
+  COLMAP_PROFILE_ZONE("LORANSAC::Estimate");
   THROW_CHECK_EQ(X.size(), Y.size());
 
   const size_t num_samples = X.size();
@@ -113,16 +119,25 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
 
   const double max_residual = options_.max_error * options_.max_error;
 
-  std::vector<double> residuals;
-  std::vector<double> best_local_residuals;
+  // The buffers are reused by all estimations in the same thread, such that
+  // the many small estimations, e.g., in geometric verification, do not
+  // allocate memory in the sampling loop.
+  thread_local std::vector<double> residuals;
+  thread_local std::vector<double> best_local_residuals;
 
-  std::vector<typename LocalEstimator::X_t> X_inlier;
-  std::vector<typename LocalEstimator::Y_t> Y_inlier;
+  thread_local SampleBlocks blocks;
+  SplitSamplesIntoBlocks(X, Y, &blocks);
+  InitializeSPRT();
 
-  std::vector<typename Estimator::X_t> X_rand(Estimator::kMinNumSamples);
-  std::vector<typename Estimator::Y_t> Y_rand(Estimator::kMinNumSamples);
-  std::vector<typename Estimator::M_t> sample_models;
-  std::vector<typename LocalEstimator::M_t> local_models;
+  thread_local std::vector<typename LocalEstimator::X_t> X_inlier;
+  thread_local std::vector<typename LocalEstimator::Y_t> Y_inlier;
+
+  thread_local std::vector<typename Estimator::X_t> X_rand;
+  thread_local std::vector<typename Estimator::Y_t> Y_rand;
+  thread_local std::vector<typename Estimator::M_t> sample_models;
+  thread_local std::vector<typename LocalEstimator::M_t> local_models;
+  X_rand.resize(Estimator::kMinNumSamples);
+  Y_rand.resize(Estimator::kMinNumSamples);
 
   sampler.Initialize(num_samples);
 
@@ -145,13 +160,19 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
 
     // Iterate through all estimated models
     for (const auto& sample_model : sample_models) {
-      estimator.Residuals(X, Y, sample_model, &residuals);
-      THROW_CHECK_EQ(residuals.size(), num_samples);
-
-      const auto support = support_measurer.Evaluate(residuals, max_residual);
+      typename SupportMeasurer::Support support;
+      const bool evaluated = EvaluateModel(estimator,
+                                           X,
+                                           Y,
+                                           blocks,
+                                           sample_model,
+                                           max_residual,
+                                           best_support,
+                                           &residuals,
+                                           &support);
 
       // Do local optimization if better than all previous subsets.
-      if (support_measurer.Compare(support, best_support)) {
+      if (evaluated && support_measurer.Compare(support, best_support)) {
         best_support = support;
         best_model = sample_model;
         best_model_is_local = false;
@@ -180,14 +201,20 @@ LORANSAC<Estimator, LocalEstimator, SupportMeasurer, Sampler>::Estimate(
             const size_t prev_best_num_inliers = best_support.num_inliers;
 
             for (const auto& local_model : local_models) {
-              local_estimator.Residuals(X, Y, local_model, &residuals);
-              THROW_CHECK_EQ(residuals.size(), num_samples);
-
-              const auto local_support =
-                  support_measurer.Evaluate(residuals, max_residual);
+              typename SupportMeasurer::Support local_support;
+              const bool local_evaluated = EvaluateModel(local_estimator,
+                                                         X,
+                                                         Y,
+                                                         blocks,
+                                                         local_model,
+                                                         max_residual,
+                                                         best_support,
+                                                         &residuals,
+                                                         &local_support);
 
               // Check if locally optimized model is better.
-              if (support_measurer.Compare(local_support, best_support)) {
+              if (local_evaluated &&
+                  support_measurer.Compare(local_support, best_support)) {
                 best_support = local_support;
                 best_model = local_model;
                 best_model_is_local = true;
@@ -61,6 +61,9 @@ void ProgressiveSampler::Initialize(const size_t total_num_samples) {
   for (size_t i = 0; i < num_samples_; ++i) {
     T_n_ *= static_cast<double>(num_samples_ - i) / (total_num_samples_ - i);
   }
+
+  prng_.Seed(RandomUniformInteger<uint64_t>(
+      0, std::numeric_limits<uint64_t>::max()));
 }
 
 size_t ProgressiveSampler::MaxNumSamples() {
@@ -93,8 +96,8 @@ void ProgressiveSampler::Sample(std::vector<size_t>* sampled_idxs) {
   // Draw semi-random samples as described in algorithm 1.
   for (size_t i = 0; i < num_random_samples; ++i) {
     while (true) {
-      const size_t random_idx =
-          RandomUniformInteger<uint32_t>(0, max_random_sample_idx);
+      const size_t random_idx = prng_.UniformInteger(
+          static_cast<uint32_t>(max_random_sample_idx + 1));
       if (!VectorContainsValue(*sampled_idxs, random_idx)) {
         sampled_idxs->push_back(random_idx);
         break;
@@ -31,6 +31,7 @@
 
 #include "colmap/math/random.h"
 
+#include <limits>
 #include <numeric>
 
 namespace colmap {
@@ -40,8 +41,13 @@ RandomSampler::RandomSampler(const size_t num_samples)
 
 void RandomSampler::Initialize(const size_t total_num_samples) {
   THROW_CHECK_LE(num_samples_, total_num_samples);
+  THROW_CHECK_LE(total_num_samples, std::numeric_limits<uint32_t>::max());
   sample_idxs_.resize(total_num_samples);
   std::iota(sample_idxs_.begin(), sample_idxs_.end(), 0);
+  batch_sample_idxs_.resize(kNumBatchSamples * num_samples_);
+  batch_idx_ = kNumBatchSamples;
+  prng_.Seed(RandomUniformInteger<uint64_t>(
+      0, std::numeric_limits<uint64_t>::max()));
 }
 
 size_t RandomSampler::MaxNumSamples() {
@@ -49,12 +55,33 @@ size_t RandomSampler::MaxNumSamples() {
 }
 
 void RandomSampler::Sample(std::vector<size_t>* sampled_idxs) {
-  Shuffle(static_cast<uint32_t>(num_samples_), &sample_idxs_);
+  if (batch_idx_ == kNumBatchSamples) {
+    SampleBatch();
+  }
 
+  const uint32_t* batch_sample_idxs =
+      batch_sample_idxs_.data() + batch_idx_ * num_samples_;
   sampled_idxs->resize(num_samples_);
   for (size_t i = 0; i < num_samples_; ++i) {
-    (*sampled_idxs)[i] = sample_idxs_[i];
+    (*sampled_idxs)[i] = batch_sample_idxs[i];
+  }
+  ++batch_idx_;
+}
+
+void RandomSampler::SampleBatch() {
+  // Each sample is drawn by a partial Fisher-Yates shuffle of the first
+  // elements, which continues from the permutation of the previous sample.
+  const uint32_t num_total_samples =
+      static_cast<uint32_t>(sample_idxs_.size());
+  uint32_t* batch_sample_idxs = batch_sample_idxs_.data();
+  for (size_t k = 0; k < kNumBatchSamples; ++k) {
+    for (uint32_t i = 0; i < num_samples_; ++i) {
+      const uint32_t j = i + prng_.UniformInteger(num_total_samples - i);
+      std::swap(sample_idxs_[i], sample_idxs_[j]);
+      *batch_sample_idxs++ = sample_idxs_[i];
+    }
   }
+  batch_idx_ = 0;
 }
 
 }  // namespace colmap
@@ -29,11 +29,15 @@
 
 #pragma once
 
+#include "colmap/math/random.h"
 #include "colmap/optim/sampler.h"
 
 namespace colmap {
 
-// Random sampler for RANSAC-based methods.
+// Random sampler for RANSAC-based methods, which draws samples without
+// replacement. The samples are generated in batches with a PCG32 generator,
+// which is seeded from the global PRNG in `Initialize`, such that results
+// are repeatable.
 //
 // Note that a separate sampler should be instantiated per thread.
 class RandomSampler : public Sampler {
@@ -47,8 +51,17 @@ class RandomSampler : public Sampler {
   void Sample(std::vector<size_t>* sampled_idxs) override;
 
  private:
+  // Number of samples generated at once.
+  static const size_t kNumBatchSamples = 64;
+
+  void SampleBatch();
+
   const size_t num_samples_;
-  std::vector<size_t> sample_idxs_;
+  PCG32 prng_;
+  std::vector<uint32_t> sample_idxs_;
+  // The concatenated indices of the samples in the current batch.
+  std::vector<uint32_t> batch_sample_idxs_;
+  size_t batch_idx_ = kNumBatchSamples;
 };
 
 }  // namespace colmap
@@ -29,6 +29,8 @@
 
 #include "colmap/optim/random_sampler.h"
 
+#include "colmap/math/random.h"
+
 #include <unordered_set>
 
 #include <gtest/gtest.h>
@@ -62,5 +64,43 @@ TEST(RandomSampler, EqualSamples) {
   }
 }
 
+TEST(RandomSampler, ManyBatches) {
+  RandomSampler sampler(3);
+  sampler.Initialize(10);
+  std::vector<int> counts(10, 0);
+  const size_t kNumSamples = 10000;
+  for (size_t i = 0; i < kNumSamples; ++i) {
+    std::vector<size_t> samples;
+    sampler.Sample(&samples);
+    EXPECT_EQ(samples.size(), 3);
+    EXPECT_EQ(std::unordered_set<size_t>(samples.begin(), samples.end()).size(),
+              3);
+    for (const size_t sample : samples) {
+      ASSERT_LT(sample, 10);
+      counts[sample] += 1;
+    }
+  }
+  for (const int count : counts) {
+    EXPECT_NEAR(count, 3 * kNumSamples / 10, 3 * kNumSamples / 100);
+  }
+}
+
+TEST(RandomSampler, Repeatability) {
+  RandomSampler sampler(4);
+  std::vector<std::vector<size_t>> samples1(100);
+  SetPRNGSeed(0);
+  sampler.Initialize(20);
+  for (auto& samples : samples1) {
+    sampler.Sample(&samples);
+  }
+  std::vector<std::vector<size_t>> samples2(100);
+  SetPRNGSeed(0);
+  sampler.Initialize(20);
+  for (auto& samples : samples2) {
+    sampler.Sample(&samples);
+  }
+  EXPECT_EQ(samples1, samples2);
+}
+
 }  // namespace
 }  // namespace colmap
@@ -29,11 +29,16 @@
 
 #pragma once
 
+#include "colmap/math/random.h"
 #include "colmap/optim/random_sampler.h"
+#include "colmap/optim/sprt.h"
 #include "colmap/optim/support_measurement.h"
 #include "colmap/util/logging.h"
+#include "colmap/util/profiler.h"
 
+#include <algorithm>
 #include <cfloat>
+#include <numeric>
 #include <random>
 #include <stdexcept>
 #include <vector>
@@ -61,6 +66,12 @@ struct RANSACOptions {
   int min_num_trials = 0;
   int max_num_trials = std::numeric_limits<int>::max();
 
+  // Whether to reject bad models early with the sequential probability ratio
+  // test of Matas et al., 2005, instead of evaluating them on all samples.
+  // Only applies to large numbers of samples, which are then evaluated in
+  // random order. Good models are rejected with a small probability.
+  bool use_sprt = false;
+
   void Check() const {
     THROW_CHECK_GT(max_error, 0);
     THROW_CHECK_GE(min_inlier_ratio, 0);
@@ -128,7 +139,53 @@ class RANSAC {
   SupportMeasurer support_measurer;
 
  protected:
+  // Samples split into consecutive blocks, for which the residuals of a model
+  // are computed one after another. This allows to stop evaluating a model
+  // early, once it cannot be better than the best model anymore.
+  struct SampleBlocks {
+    std::vector<std::vector<typename Estimator::X_t>> X;
+    std::vector<std::vector<typename Estimator::Y_t>> Y;
+    // The indices of the samples in the blocks, if they were shuffled.
+    std::vector<size_t> sample_idxs;
+  };
+
+  // The blocks are only used for enough samples to amortize their overhead.
+  static const size_t kNumSamplesPerBlock = 128;
+
+  void SplitSamplesIntoBlocks(const std::vector<typename Estimator::X_t>& X,
+                              const std::vector<typename Estimator::Y_t>& Y,
+                              SampleBlocks* blocks);
+
+  // Reset the sequential probability ratio test before a new estimation.
+  void InitializeSPRT();
+
+  // Compute the residuals and support of a model. Returns false if the
+  // evaluation stopped early, because the model cannot be better than the
+  // given best support or was rejected by the sequential probability ratio
+  // test, in which case the residuals are incomplete.
+  template <typename ModelEstimator>
+  bool EvaluateModel(ModelEstimator& model_estimator,
+                     const std::vector<typename Estimator::X_t>& X,
+                     const std::vector<typename Estimator::Y_t>& Y,
+                     const SampleBlocks& blocks,
+                     const typename ModelEstimator::M_t& model,
+                     double max_residual,
+                     const typename SupportMeasurer::Support& best_support,
+                     std::vector<double>* residuals,
+                     typename SupportMeasurer::Support* support);
+
   RANSACOptions options_;
+
+ private:
+  // Adapt the test to the inlier ratio of a rejected model or of a model,
+  // which passed the test.
+  void UpdateSPRT(bool rejected, size_t num_inliers, size_t num_samples);
+
+  std::vector<double> block_residuals_;
+
+  SPRT sprt_;
+  size_t sprt_num_rejected_inliers_ = 0;
+  size_t sprt_num_rejected_samples_ = 0;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -138,7 +195,9 @@ class RANSAC {
 template <typename Estimator, typename SupportMeasurer, typename Sampler>
 RANSAC<Estimator, SupportMeasurer, Sampler>::RANSAC(
     const RANSACOptions& options)
-    : sampler(Sampler(Estimator::kMinNumSamples)), options_(options) {
+    : sampler(Sampler(Estimator::kMinNumSamples)),
+      options_(options),
+      sprt_(SPRT::Options()) {
   options.Check();
 
   // Determine max_num_trials based on assumed `min_inlier_ratio`.
@@ -178,11 +237,169 @@ size_t RANSAC<Estimator, SupportMeasurer, Sampler>::ComputeNumTrials(
       std::ceil(std::log(nom) / std::log(denom) * num_trials_multiplier));
 }
 
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+void RANSAC<Estimator, SupportMeasurer, Sampler>::SplitSamplesIntoBlocks(
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y,
+    SampleBlocks* blocks) {
+  const size_t num_samples_per_block = kNumSamplesPerBlock;
+  blocks->X.clear();
+  blocks->Y.clear();
+  if (X.size() < 2 * num_samples_per_block) {
+    return;
+  }
+
+  // The test assumes the samples of a model to be evaluated in random order.
+  blocks->sample_idxs.clear();
+  if (options_.use_sprt) {
+    blocks->sample_idxs.resize(X.size());
+    std::iota(blocks->sample_idxs.begin(), blocks->sample_idxs.end(), 0);
+    Shuffle(static_cast<uint32_t>(X.size()), &blocks->sample_idxs);
+  }
+
+  const size_t num_blocks =
+      (X.size() + num_samples_per_block - 1) / num_samples_per_block;
+  blocks->X.resize(num_blocks);
+  blocks->Y.resize(num_blocks);
+  for (size_t i = 0; i < num_blocks; ++i) {
+    const size_t begin = i * num_samples_per_block;
+    const size_t end = std::min(begin + num_samples_per_block, X.size());
+    if (blocks->sample_idxs.empty()) {
+      blocks->X[i].assign(X.begin() + begin, X.begin() + end);
+      blocks->Y[i].assign(Y.begin() + begin, Y.begin() + end);
+    } else {
+      blocks->X[i].clear();
+      blocks->Y[i].clear();
+      blocks->X[i].reserve(end - begin);
+      blocks->Y[i].reserve(end - begin);
+      for (size_t j = begin; j < end; ++j) {
+        blocks->X[i].push_back(X[blocks->sample_idxs[j]]);
+        blocks->Y[i].push_back(Y[blocks->sample_idxs[j]]);
+      }
+    }
+  }
+}
+
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+void RANSAC<Estimator, SupportMeasurer, Sampler>::InitializeSPRT() {
+  SPRT::Options sprt_options;
+  sprt_options.epsilon =
+      std::max(options_.min_inlier_ratio, 2 * sprt_options.delta);
+  sprt_.Update(sprt_options);
+  sprt_num_rejected_inliers_ = 0;
+  sprt_num_rejected_samples_ = 0;
+}
+
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+void RANSAC<Estimator, SupportMeasurer, Sampler>::UpdateSPRT(
+    const bool rejected, const size_t num_inliers, const size_t num_samples) {
+  // Keep the probabilities away from 0 and 1 for a finite decision threshold.
+  const double kMinProb = 1e-3;
+  const double kMaxProb = 0.99;
+
+  SPRT::Options sprt_options = sprt_.GetOptions();
+  if (rejected) {
+    // The probability of a sample being consistent with a bad model is
+    // estimated as the average inlier ratio of all rejected models.
+    sprt_num_rejected_inliers_ += num_inliers;
+    sprt_num_rejected_samples_ += num_samples;
+    const double delta = std::min(
+        std::max(sprt_num_rejected_inliers_ /
+                     static_cast<double>(sprt_num_rejected_samples_),
+                 kMinProb),
+        kMaxProb);
+    // Only recompute the decision threshold for significant changes.
+    if (std::abs(delta - sprt_options.delta) <= 0.1 * sprt_options.delta) {
+      return;
+    }
+    sprt_options.delta = delta;
+  } else {
+    // The inlier ratio of good models is that of the best model so far.
+    const double epsilon =
+        std::min(num_inliers / static_cast<double>(num_samples), kMaxProb);
+    if (epsilon <= sprt_options.epsilon) {
+      return;
+    }
+    sprt_options.epsilon = epsilon;
+  }
+  sprt_.Update(sprt_options);
+}
+
+template <typename Estimator, typename SupportMeasurer, typename Sampler>
+template <typename ModelEstimator>
+bool RANSAC<Estimator, SupportMeasurer, Sampler>::EvaluateModel(
+    ModelEstimator& model_estimator,
+    const std::vector<typename Estimator::X_t>& X,
+    const std::vector<typename Estimator::Y_t>& Y,
+    const SampleBlocks& blocks,
+    const typename ModelEstimator::M_t& model,
+    const double max_residual,
+    const typename SupportMeasurer::Support& best_support,
+    std::vector<double>* residuals,
+    typename SupportMeasurer::Support* support) {
+  const size_t num_samples = X.size();
+
+  if (blocks.X.empty()) {
+    model_estimator.Residuals(X, Y, model, residuals);
+    THROW_CHECK_EQ(residuals->size(), num_samples);
+  } else {
+    residuals->resize(num_samples);
+    const bool shuffled = !blocks.sample_idxs.empty();
+    // The test is only informative, if good models have more inliers.
+    const bool use_sprt =
+        shuffled && sprt_.GetOptions().delta < sprt_.GetOptions().epsilon;
+    double likelihood_ratio = 1;
+    size_t num_sprt_inliers = 0;
+    size_t num_sprt_samples = 0;
+    size_t num_evaluated = 0;
+    size_t num_inliers = 0;
+    double truncated_residual_sum = 0;
+    for (size_t i = 0; i < blocks.X.size(); ++i) {
+      model_estimator.Residuals(
+          blocks.X[i], blocks.Y[i], model, &block_residuals_);
+      THROW_CHECK_EQ(block_residuals_.size(), blocks.X[i].size());
+      for (const double residual : block_residuals_) {
+        if (residual <= max_residual) {
+          num_inliers += 1;
+          truncated_residual_sum += residual;
+        } else {
+          truncated_residual_sum += max_residual;
+        }
+        const size_t sample_idx =
+            shuffled ? blocks.sample_idxs[num_evaluated] : num_evaluated;
+        (*residuals)[sample_idx] = residual;
+        num_evaluated += 1;
+      }
+      if (use_sprt && !sprt_.Evaluate(block_residuals_,
+                                      max_residual,
+                                      &likelihood_ratio,
+                                      &num_sprt_inliers,
+                                      &num_sprt_samples)) {
+        UpdateSPRT(/*rejected=*/true, num_sprt_inliers, num_sprt_samples);
+        return false;
+      }
+      if (!support_measurer.CanBeBetter(num_inliers,
+                                        truncated_residual_sum,
+                                        num_samples - num_evaluated,
+                                        best_support)) {
+        return false;
+      }
+    }
+    if (shuffled) {
+      UpdateSPRT(/*rejected=*/false, num_inliers, num_samples);
+    }
+  }
+
+  *support = support_measurer.Evaluate(*residuals, max_residual);
+  return true;
+}
+
 template <typename Estimator, typename SupportMeasurer, typename Sampler>
 typename RANSAC<Estimator, SupportMeasurer, Sampler>::Report
 RANSAC<Estimator, SupportMeasurer, Sampler>::Estimate(
     const std::vector<typename Estimator::X_t>& X,
     const std::vector<typename Estimator::Y_t>& Y) {
+  COLMAP_PROFILE_ZONE("RANSAC::Estimate");
   THROW_CHECK_EQ(X.size(), Y.size());
 
   const size_t num_samples = X.size();
@@ -202,11 +419,21 @@ RANSAC<Estimator, SupportMeasurer, Sampler>::Estimate(
 
   const double max_residual = options_.max_error * options_.max_error;
 
-  std::vector<double> residuals(num_samples);
+  // The buffers are reused by all estimations in the same thread, such that
+  // the many small estimations, e.g., in geometric verification, do not
+  // allocate memory in the sampling loop.
+  thread_local std::vector<double> residuals;
+  residuals.resize(num_samples);
 
-  std::vector<typename Estimator::X_t> X_rand(Estimator::kMinNumSamples);
-  std::vector<typename Estimator::Y_t> Y_rand(Estimator::kMinNumSamples);
-  std::vector<typename Estimator::M_t> sample_models;
+  thread_local SampleBlocks blocks;
+  SplitSamplesIntoBlocks(X, Y, &blocks);
+  InitializeSPRT();
+
+  thread_local std::vector<typename Estimator::X_t> X_rand;
+  thread_local std::vector<typename Estimator::Y_t> Y_rand;
+  thread_local std::vector<typename Estimator::M_t> sample_models;
+  X_rand.resize(Estimator::kMinNumSamples);
+  Y_rand.resize(Estimator::kMinNumSamples);
 
   sampler.Initialize(num_samples);
 
@@ -229,13 +456,19 @@ RANSAC<Estimator, SupportMeasurer, Sampler>::Estimate(
 
     // Iterate through all estimated models.
     for (const auto& sample_model : sample_models) {
-      estimator.Residuals(X, Y, sample_model, &residuals);
-      THROW_CHECK_EQ(residuals.size(), num_samples);
-
-      const auto support = support_measurer.Evaluate(residuals, max_residual);
+      typename SupportMeasurer::Support support;
+      const bool evaluated = EvaluateModel(estimator,
+                                           X,
+                                           Y,
+                                           blocks,
+                                           sample_model,
+                                           max_residual,
+                                           best_support,
+                                           &residuals,
+                                           &support);
 
       // Save as best subset if better than all previous subsets.
-      if (support_measurer.Compare(support, best_support)) {
+      if (evaluated && support_measurer.Compare(support, best_support)) {
         best_support = support;
         best_model = sample_model;
 
@@ -49,6 +49,7 @@ TEST(RANSAC, Options) {
   EXPECT_EQ(options.confidence, 0.99);
   EXPECT_EQ(options.min_num_trials, 0);
   EXPECT_EQ(options.max_num_trials, std::numeric_limits<int>::max());
+  EXPECT_FALSE(options.use_sprt);
 }
 
 TEST(RANSAC, Report) {
@@ -134,5 +135,52 @@ TEST(RANSAC, SimilarityTransform) {
   EXPECT_LT(matrix_diff, 1e-6);
 }
 
+TEST(RANSAC, SimilarityTransformSPRT) {
+  SetPRNGSeed(0);
+
+  const size_t num_samples = 1000;
+  const size_t num_outliers = 400;
+
+  const Sim3d expectedTgtFromSrc(
+      2, Eigen::Quaterniond::UnitRandom(), Eigen::Vector3d(100, 10, 10));
+
+  std::vector<Eigen::Vector3d> src;
+  std::vector<Eigen::Vector3d> tgt;
+  for (size_t i = 0; i < num_samples; ++i) {
+    src.emplace_back(i, std::sqrt(i) + 2, std::sqrt(2 * i + 2));
+    tgt.push_back(expectedTgtFromSrc * src.back());
+  }
+
+  for (size_t i = 0; i < num_outliers; ++i) {
+    tgt[i] = Eigen::Vector3d(RandomUniformReal(-3000.0, -2000.0),
+                             RandomUniformReal(-4000.0, -3000.0),
+                             RandomUniformReal(-5000.0, -4000.0));
+  }
+
+  RANSACOptions options;
+  options.max_error = 10;
+  options.use_sprt = true;
+  RANSAC<SimilarityTransformEstimator<3>> ransac(options);
+  const auto report = ransac.Estimate(src, tgt);
+
+  EXPECT_TRUE(report.success);
+  EXPECT_GT(report.num_trials, 0);
+
+  // The samples are evaluated in random order, but the inlier mask must
+  // still refer to the original order.
+  EXPECT_EQ(report.support.num_inliers, num_samples - num_outliers);
+  for (size_t i = 0; i < num_samples; ++i) {
+    if (i < num_outliers) {
+      EXPECT_FALSE(report.inlier_mask[i]);
+    } else {
+      EXPECT_TRUE(report.inlier_mask[i]);
+    }
+  }
+
+  const double matrix_diff =
+      (expectedTgtFromSrc.ToMatrix() - report.model).norm();
+  EXPECT_LT(matrix_diff, 1e-6);
+}
+
 }  // namespace
 }  // namespace colmap
@@ -68,6 +68,17 @@ class SPRT {
                 size_t* num_inliers,
                 size_t* num_eval_samples);
 
+  // Continue the test of a model with the residuals of its next samples,
+  // given the likelihood ratio of the previous samples, which is initially 1.
+  // The number of inliers and evaluated samples are added to the given ones.
+  bool Evaluate(const std::vector<double>& residuals,
+                double max_residual,
+                double* likelihood_ratio,
+                size_t* num_inliers,
+                size_t* num_eval_samples);
+
+  const Options& GetOptions() const { return options_; }
+
  private:
   void UpdateDecisionThreshold();
 
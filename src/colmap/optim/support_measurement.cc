@@ -61,6 +61,13 @@ bool InlierSupportMeasurer::Compare(const Support& support1,
   }
 }
 
+bool InlierSupportMeasurer::CanBeBetter(const size_t num_inliers,
+                                        const double truncated_residual_sum,
+                                        const size_t num_remaining,
+                                        const Support& support) {
+  return num_inliers + num_remaining >= support.num_inliers;
+}
+
 UniqueInlierSupportMeasurer::Support UniqueInlierSupportMeasurer::Evaluate(
     const std::vector<double>& residuals, const double max_residual) {
   THROW_CHECK_EQ(residuals.size(), unique_sample_ids_.size());
@@ -97,6 +104,15 @@ bool UniqueInlierSupportMeasurer::Compare(const Support& support1,
   }
 }
 
+bool UniqueInlierSupportMeasurer::CanBeBetter(
+    const size_t num_inliers,
+    const double truncated_residual_sum,
+    const size_t num_remaining,
+    const Support& support) {
+  // The number of unique inliers is bounded by the number of inliers.
+  return num_inliers + num_remaining >= support.num_unique_inliers;
+}
+
 MEstimatorSupportMeasurer::Support MEstimatorSupportMeasurer::Evaluate(
     const std::vector<double>& residuals, const double max_residual) {
   Support support;
@@ -120,4 +136,13 @@ bool MEstimatorSupportMeasurer::Compare(const Support& support1,
   return support1.score < support2.score;
 }
 
+bool MEstimatorSupportMeasurer::CanBeBetter(
+    const size_t num_inliers,
+    const double truncated_residual_sum,
+    const size_t num_remaining,
+    const Support& support) {
+  // The score only increases with the remaining residuals.
+  return truncated_residual_sum < support.score;
+}
+
 }  // namespace colmap
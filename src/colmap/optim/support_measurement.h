@@ -52,6 +52,15 @@ struct InlierSupportMeasurer {
 
   // Compare the two supports and return the better support.
   bool Compare(const Support& support1, const Support& support2);
+
+  // Whether a model can still be better than the given support, if the
+  // residuals of all but num_remaining samples are known and contain the given
+  // number of inliers and the given sum of residuals truncated to
+  // max_residual. Used to stop evaluating models early.
+  bool CanBeBetter(size_t num_inliers,
+                   double truncated_residual_sum,
+                   size_t num_remaining,
+                   const Support& support);
 };
 
 // Measure the support of a model by counting the number of unique inliers
@@ -82,6 +91,15 @@ struct UniqueInlierSupportMeasurer {
   // Compare the two supports and return the better support.
   bool Compare(const Support& support1, const Support& support2);
 
+  // Whether a model can still be better than the given support, if the
+  // residuals of all but num_remaining samples are known and contain the given
+  // number of inliers and the given sum of residuals truncated to
+  // max_residual. Used to stop evaluating models early.
+  bool CanBeBetter(size_t num_inliers,
+                   double truncated_residual_sum,
+                   size_t num_remaining,
+                   const Support& support);
+
  private:
   std::vector<size_t> unique_sample_ids_;
 };
@@ -102,6 +120,15 @@ struct MEstimatorSupportMeasurer {
 
   // Compare the two supports and return the better support.
   bool Compare(const Support& support1, const Support& support2);
+
+  // Whether a model can still be better than the given support, if the
+  // residuals of all but num_remaining samples are known and contain the given
+  // number of inliers and the given sum of residuals truncated to
+  // max_residual. Used to stop evaluating models early.
+  bool CanBeBetter(size_t num_inliers,
+                   double truncated_residual_sum,
+                   size_t num_remaining,
+                   const Support& support);
 };
 
 }  // namespace colmap
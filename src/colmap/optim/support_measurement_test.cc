@@ -66,6 +66,18 @@ TEST(InlierSupportMeasurer, Nominal) {
   EXPECT_TRUE(measurer.Compare(support2, support1));
 }
 
+TEST(InlierSupportMeasurer, CanBeBetter) {
+  InlierSupportMeasurer measurer;
+  InlierSupportMeasurer::Support support;
+  EXPECT_TRUE(measurer.CanBeBetter(0, 0, 0, support));
+  support.num_inliers = 5;
+  support.residual_sum = 1;
+  EXPECT_TRUE(measurer.CanBeBetter(5, 10, 0, support));
+  EXPECT_TRUE(measurer.CanBeBetter(2, 10, 3, support));
+  EXPECT_FALSE(measurer.CanBeBetter(2, 10, 2, support));
+  EXPECT_FALSE(measurer.CanBeBetter(4, 0, 0, support));
+}
+
 TEST(UniqueInlierSupportMeasurer, Nominal) {
   UniqueInlierSupportMeasurer::Support support1;
   EXPECT_EQ(support1.num_inliers, 0);
@@ -114,6 +126,17 @@ TEST(UniqueInlierSupportMeasurer, Nominal) {
   EXPECT_TRUE(measurer.Compare(support2, support1));
 }
 
+TEST(UniqueInlierSupportMeasurer, CanBeBetter) {
+  UniqueInlierSupportMeasurer measurer;
+  UniqueInlierSupportMeasurer::Support support;
+  EXPECT_TRUE(measurer.CanBeBetter(0, 0, 0, support));
+  support.num_unique_inliers = 3;
+  support.num_inliers = 5;
+  EXPECT_TRUE(measurer.CanBeBetter(3, 10, 0, support));
+  EXPECT_TRUE(measurer.CanBeBetter(1, 10, 2, support));
+  EXPECT_FALSE(measurer.CanBeBetter(1, 10, 1, support));
+}
+
 TEST(MEstimatorSupportMeasurer, Nominal) {
   MEstimatorSupportMeasurer::Support support1;
   EXPECT_EQ(support1.num_inliers, 0);
@@ -138,5 +161,14 @@ TEST(MEstimatorSupportMeasurer, Nominal) {
   EXPECT_TRUE(measurer.Compare(support2, support1));
 }
 
+TEST(MEstimatorSupportMeasurer, CanBeBetter) {
+  MEstimatorSupportMeasurer measurer;
+  MEstimatorSupportMeasurer::Support support;
+  EXPECT_TRUE(measurer.CanBeBetter(0, 1e10, 0, support));
+  support.score = 2;
+  EXPECT_TRUE(measurer.CanBeBetter(0, 1.99, 10, support));
+  EXPECT_FALSE(measurer.CanBeBetter(10, 2, 10, support));
+}
+
 }  // namespace
 }  // namespace colmap
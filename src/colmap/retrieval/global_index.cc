@@ -0,0 +1,279 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/retrieval/global_index.h"
+
+#include "colmap/retrieval/kmeans.h"
+#include "colmap/util/endian.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/threading.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+
+namespace colmap {
+namespace retrieval {
+
+void GlobalIndex::BuildCodebook(const FloatMatrix& descriptors,
+                                const int num_clusters,
+                                const int num_threads) {
+  THROW_CHECK(image_ids_.empty())
+      << "The codebook cannot change after indexing images";
+  THROW_CHECK_GE(descriptors.rows(), num_clusters);
+
+  HierarchicalKMeansOptions kmeans_options;
+  kmeans_options.num_clusters = num_clusters;
+  kmeans_options.branching = num_clusters;
+  kmeans_options.num_threads = num_threads;
+  codebook_ = HierarchicalKMeans(kmeans_options, descriptors);
+  prepared_ = false;
+}
+
+int GlobalIndex::Dimensionality() const {
+  return static_cast<int>(codebook_.size());
+}
+
+Eigen::VectorXf GlobalIndex::ComputeDescriptor(
+    const FeatureDescriptors& descriptors) const {
+  THROW_CHECK_GT(codebook_.rows(), 0);
+  THROW_CHECK_EQ(descriptors.cols(), codebook_.cols());
+
+  // Accumulate the residuals of the local descriptors to their nearest
+  // cluster centers.
+  FloatMatrix residuals = FloatMatrix::Zero(codebook_.rows(), codebook_.cols());
+  for (Eigen::Index i = 0; i < descriptors.rows(); ++i) {
+    const Eigen::RowVectorXf descriptor =
+        descriptors.row(i).cast<float>();
+    Eigen::Index cluster_idx;
+    (codebook_.rowwise() - descriptor).rowwise().squaredNorm().minCoeff(
+        &cluster_idx);
+    residuals.row(cluster_idx) += descriptor - codebook_.row(cluster_idx);
+  }
+
+  // Intra-normalization suppresses the burstiness of repeated structures.
+  for (Eigen::Index k = 0; k < residuals.rows(); ++k) {
+    const float norm = residuals.row(k).norm();
+    if (norm > 0) {
+      residuals.row(k) /= norm;
+    }
+  }
+
+  Eigen::VectorXf global_descriptor =
+      Eigen::Map<const Eigen::VectorXf>(residuals.data(), residuals.size());
+  const float norm = global_descriptor.norm();
+  if (norm > 0) {
+    global_descriptor /= norm;
+  }
+  return global_descriptor;
+}
+
+void GlobalIndex::Add(const int image_id, const Eigen::VectorXf& descriptor) {
+  THROW_CHECK_EQ(descriptor.size(), Dimensionality());
+  if (ImageIndexed(image_id)) {
+    return;
+  }
+  image_id_to_idx_.emplace(image_id, image_ids_.size());
+  image_ids_.push_back(image_id);
+  descriptors_data_.insert(descriptors_data_.end(),
+                           descriptor.data(),
+                           descriptor.data() + descriptor.size());
+  prepared_ = false;
+}
+
+bool GlobalIndex::ImageIndexed(const int image_id) const {
+  return image_id_to_idx_.count(image_id) != 0;
+}
+
+const std::vector<int>& GlobalIndex::ImageIds() const { return image_ids_; }
+
+Eigen::Map<const Eigen::VectorXf> GlobalIndex::Descriptor(
+    const int image_id) const {
+  const size_t idx = image_id_to_idx_.at(image_id);
+  return Eigen::Map<const Eigen::VectorXf>(
+      descriptors_data_.data() + idx * Dimensionality(), Dimensionality());
+}
+
+size_t GlobalIndex::NumImages() const { return image_ids_.size(); }
+
+void GlobalIndex::Prepare(const PrepareOptions& options) {
+  lists_.clear();
+  list_centroids_.resize(0, Dimensionality());
+  prepared_ = true;
+
+  const size_t num_images = image_ids_.size();
+  if (num_images == 0) {
+    return;
+  }
+
+  const Eigen::Map<const FloatMatrix> descriptors(
+      descriptors_data_.data(), num_images, Dimensionality());
+
+  int num_lists = options.num_lists > 0
+                      ? options.num_lists
+                      : static_cast<int>(std::sqrt(num_images));
+  num_lists = std::max(1, std::min<int>(num_lists, num_images));
+  if (num_lists == 1) {
+    list_centroids_ = descriptors.colwise().mean();
+    lists_.resize(1);
+    lists_[0].resize(num_images);
+    std::iota(lists_[0].begin(), lists_[0].end(), 0);
+    return;
+  }
+
+  // Cluster the lists by a two-level tree, which is much faster than a flat
+  // k-means for many lists.
+  HierarchicalKMeansOptions kmeans_options;
+  kmeans_options.num_clusters = num_lists;
+  kmeans_options.branching = std::max(
+      2,
+      static_cast<int>(std::ceil(std::sqrt(static_cast<double>(num_lists)))));
+  kmeans_options.num_threads = options.num_threads;
+  list_centroids_ = HierarchicalKMeans(kmeans_options, descriptors);
+
+  std::vector<uint32_t> idxs(num_images);
+  std::iota(idxs.begin(), idxs.end(), 0);
+  std::vector<int> assignments;
+  ThreadPool thread_pool(options.num_threads);
+  internal::AssignToNearestCenters(kmeans_options,
+                                   descriptors,
+                                   idxs,
+                                   list_centroids_,
+                                   &thread_pool,
+                                   &assignments);
+
+  lists_.resize(list_centroids_.rows());
+  for (size_t i = 0; i < num_images; ++i) {
+    lists_[assignments[i]].push_back(i);
+  }
+}
+
+void GlobalIndex::Query(const QueryOptions& options,
+                        const Eigen::VectorXf& descriptor,
+                        std::vector<ImageScore>* image_scores) const {
+  THROW_CHECK(prepared_);
+  THROW_CHECK_EQ(descriptor.size(), Dimensionality());
+  THROW_CHECK_GT(options.num_probes, 0);
+
+  image_scores->clear();
+  if (lists_.empty()) {
+    return;
+  }
+
+  // Find the nearest inverted lists.
+  const Eigen::VectorXf list_dists =
+      (list_centroids_.rowwise() - descriptor.transpose())
+          .rowwise()
+          .squaredNorm();
+  std::vector<size_t> list_idxs(lists_.size());
+  std::iota(list_idxs.begin(), list_idxs.end(), 0);
+  const size_t num_probes =
+      std::min<size_t>(options.num_probes, list_idxs.size());
+  std::partial_sort(list_idxs.begin(),
+                    list_idxs.begin() + num_probes,
+                    list_idxs.end(),
+                    [&list_dists](const size_t idx1, const size_t idx2) {
+                      return list_dists(idx1) < list_dists(idx2);
+                    });
+
+  const Eigen::Map<const FloatMatrix> descriptors(
+      descriptors_data_.data(), image_ids_.size(), Dimensionality());
+  for (size_t i = 0; i < num_probes; ++i) {
+    for (const size_t idx : lists_[list_idxs[i]]) {
+      ImageScore image_score;
+      image_score.image_id = image_ids_[idx];
+      image_score.score = descriptors.row(idx).dot(descriptor.transpose());
+      image_scores->push_back(image_score);
+    }
+  }
+
+  auto SortFunc = [](const ImageScore& score1, const ImageScore& score2) {
+    return score1.score > score2.score;
+  };
+
+  size_t num_images = image_scores->size();
+  if (options.max_num_images >= 0) {
+    num_images = std::min<size_t>(image_scores->size(), options.max_num_images);
+  }
+
+  if (num_images == image_scores->size()) {
+    std::sort(image_scores->begin(), image_scores->end(), SortFunc);
+  } else {
+    std::partial_sort(image_scores->begin(),
+                      image_scores->begin() + num_images,
+                      image_scores->end(),
+                      SortFunc);
+    image_scores->resize(num_images);
+  }
+}
+
+void GlobalIndex::Read(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  const uint64_t num_clusters = ReadBinaryLittleEndian<uint64_t>(&file);
+  const uint64_t dim = ReadBinaryLittleEndian<uint64_t>(&file);
+  codebook_.resize(num_clusters, dim);
+  for (Eigen::Index i = 0; i < codebook_.size(); ++i) {
+    codebook_.data()[i] = ReadBinaryLittleEndian<float>(&file);
+  }
+
+  const uint64_t num_images = ReadBinaryLittleEndian<uint64_t>(&file);
+  image_ids_.resize(num_images);
+  ReadBinaryLittleEndian<int>(&file, &image_ids_);
+  descriptors_data_.resize(num_images * Dimensionality());
+  ReadBinaryLittleEndian<float>(&file, &descriptors_data_);
+  THROW_CHECK(file.good()) << "Invalid global index " << path;
+
+  image_id_to_idx_.clear();
+  for (size_t i = 0; i < image_ids_.size(); ++i) {
+    image_id_to_idx_.emplace(image_ids_[i], i);
+  }
+  prepared_ = false;
+}
+
+void GlobalIndex::Write(const std::string& path) const {
+  std::ofstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  WriteBinaryLittleEndian<uint64_t>(&file, codebook_.rows());
+  WriteBinaryLittleEndian<uint64_t>(&file, codebook_.cols());
+  for (Eigen::Index i = 0; i < codebook_.size(); ++i) {
+    WriteBinaryLittleEndian<float>(&file, codebook_.data()[i]);
+  }
+
+  WriteBinaryLittleEndian<uint64_t>(&file, image_ids_.size());
+  WriteBinaryLittleEndian<int>(&file, image_ids_);
+  WriteBinaryLittleEndian<float>(&file, descriptors_data_);
+}
+
+}  // namespace retrieval
+}  // namespace colmap
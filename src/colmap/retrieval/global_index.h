@@ -0,0 +1,137 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/feature/types.h"
+#include "colmap/retrieval/utils.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace colmap {
+namespace retrieval {
+
+// Image retrieval using one compact global descriptor per image, based on
+// VLAD aggregation of local features with intra-normalization:
+//
+//    Jegou, Douze, Schmid, Perez. "Aggregating local descriptors into a
+//    compact image representation". CVPR 2010.
+//
+//    Arandjelovic, Zisserman. "All about VLAD". CVPR 2013.
+//
+// The global descriptors are searched approximately with an inverted file
+// index over a coarse k-means quantization of the descriptor space, where a
+// query only scans the images in the nearest lists.
+class GlobalIndex {
+ public:
+  typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      FloatMatrix;
+
+  struct QueryOptions {
+    // The maximum number of most similar images to retrieve.
+    int max_num_images = -1;
+
+    // The number of nearest inverted lists scanned per query.
+    int num_probes = 16;
+  };
+
+  struct PrepareOptions {
+    // The number of inverted lists. If not positive, the square root of the
+    // number of indexed images is used.
+    int num_lists = -1;
+
+    // The number of threads used for the coarse quantization.
+    int num_threads = -1;
+  };
+
+  // Compute the VLAD codebook by clustering the given local descriptors, e.g.,
+  // the visual words of a vocabulary tree, into the given number of clusters.
+  void BuildCodebook(const FloatMatrix& descriptors,
+                     int num_clusters,
+                     int num_threads = -1);
+
+  // The dimensionality of the global descriptors.
+  int Dimensionality() const;
+
+  // Aggregate the local descriptors of an image into its L2-normalized global
+  // descriptor. This function is thread-safe.
+  Eigen::VectorXf ComputeDescriptor(
+      const FeatureDescriptors& descriptors) const;
+
+  // Add the global descriptor of an image to the index.
+  void Add(int image_id, const Eigen::VectorXf& descriptor);
+
+  // Check if an image has been indexed.
+  bool ImageIndexed(int image_id) const;
+
+  // Identifiers of all indexed images.
+  const std::vector<int>& ImageIds() const;
+
+  // The global descriptor of an indexed image.
+  Eigen::Map<const Eigen::VectorXf> Descriptor(int image_id) const;
+
+  // Number of indexed images.
+  size_t NumImages() const;
+
+  // Build the inverted lists after adding images and before querying.
+  void Prepare(const PrepareOptions& options);
+
+  // Query for the most similar images ordered by decreasing cosine similarity
+  // of their global descriptors.
+  void Query(const QueryOptions& options,
+             const Eigen::VectorXf& descriptor,
+             std::vector<ImageScore>* image_scores) const;
+
+  // Read and write the codebook and global descriptors of all indexed images.
+  // The inverted lists are not stored and must be rebuilt by Prepare.
+  void Read(const std::string& path);
+  void Write(const std::string& path) const;
+
+ private:
+  // The VLAD codebook with one cluster center per row.
+  FloatMatrix codebook_;
+
+  // The global descriptors of the indexed images, one per row.
+  std::vector<int> image_ids_;
+  std::vector<float> descriptors_data_;
+  std::unordered_map<int, size_t> image_id_to_idx_;
+
+  // The centroids of the inverted lists and the indices of their images.
+  FloatMatrix list_centroids_;
+  std::vector<std::vector<size_t>> lists_;
+
+  bool prepared_ = false;
+};
+
+}  // namespace retrieval
+}  // namespace colmap
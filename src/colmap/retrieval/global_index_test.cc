@@ -0,0 +1,126 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/retrieval/global_index.h"
+
+#include "colmap/math/random.h"
+#include "colmap/util/testing.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace retrieval {
+namespace {
+
+FeatureDescriptors RandomDescriptors(const int num_descriptors) {
+  FeatureDescriptors descriptors(num_descriptors, 128);
+  for (Eigen::Index i = 0; i < descriptors.size(); ++i) {
+    descriptors.data()[i] = RandomUniformInteger<int>(0, 255);
+  }
+  return descriptors;
+}
+
+GlobalIndex CreateGlobalIndex(const int num_images) {
+  GlobalIndex index;
+  index.BuildCodebook(
+      RandomDescriptors(1000).cast<float>(), /*num_clusters=*/8);
+  EXPECT_EQ(index.Dimensionality(), 8 * 128);
+  for (int image_id = 1; image_id <= num_images; ++image_id) {
+    index.Add(image_id, index.ComputeDescriptor(RandomDescriptors(100)));
+  }
+  return index;
+}
+
+TEST(GlobalIndex, ComputeDescriptor) {
+  SetPRNGSeed(0);
+  GlobalIndex index;
+  index.BuildCodebook(
+      RandomDescriptors(100).cast<float>(), /*num_clusters=*/4);
+  const Eigen::VectorXf descriptor =
+      index.ComputeDescriptor(RandomDescriptors(10));
+  EXPECT_EQ(descriptor.size(), index.Dimensionality());
+  EXPECT_NEAR(descriptor.norm(), 1, 1e-6);
+  EXPECT_EQ(index.ComputeDescriptor(FeatureDescriptors(0, 128)).norm(), 0);
+}
+
+TEST(GlobalIndex, Query) {
+  SetPRNGSeed(0);
+  GlobalIndex index = CreateGlobalIndex(20);
+  EXPECT_EQ(index.NumImages(), 20);
+  EXPECT_TRUE(index.ImageIndexed(20));
+  EXPECT_FALSE(index.ImageIndexed(21));
+
+  // Exhaustive search with a single list returns all images.
+  GlobalIndex::PrepareOptions prepare_options;
+  prepare_options.num_lists = 1;
+  index.Prepare(prepare_options);
+  GlobalIndex::QueryOptions query_options;
+  std::vector<ImageScore> image_scores;
+  index.Query(query_options, index.Descriptor(5), &image_scores);
+  ASSERT_EQ(image_scores.size(), 20);
+  EXPECT_EQ(image_scores[0].image_id, 5);
+  EXPECT_NEAR(image_scores[0].score, 1, 1e-5);
+  for (size_t i = 1; i < image_scores.size(); ++i) {
+    EXPECT_LE(image_scores[i].score, image_scores[i - 1].score);
+  }
+
+  // Approximate search still finds the query image in its nearest list.
+  prepare_options.num_lists = 4;
+  index.Prepare(prepare_options);
+  query_options.num_probes = 1;
+  query_options.max_num_images = 3;
+  for (int image_id = 1; image_id <= 20; ++image_id) {
+    index.Query(query_options, index.Descriptor(image_id), &image_scores);
+    ASSERT_FALSE(image_scores.empty());
+    EXPECT_LE(image_scores.size(), 3);
+    EXPECT_EQ(image_scores[0].image_id, image_id);
+  }
+}
+
+TEST(GlobalIndex, ReadWrite) {
+  SetPRNGSeed(0);
+  const GlobalIndex index = CreateGlobalIndex(5);
+  const std::string path = CreateTestDir() + "/global_index.bin";
+  index.Write(path);
+
+  GlobalIndex read_index;
+  read_index.Read(path);
+  EXPECT_EQ(read_index.Dimensionality(), index.Dimensionality());
+  EXPECT_EQ(read_index.NumImages(), index.NumImages());
+  for (int image_id = 1; image_id <= 5; ++image_id) {
+    EXPECT_EQ(read_index.Descriptor(image_id), index.Descriptor(image_id));
+  }
+  const FeatureDescriptors descriptors = RandomDescriptors(10);
+  EXPECT_EQ(read_index.ComputeDescriptor(descriptors),
+            index.ComputeDescriptor(descriptors));
+}
+
+}  // namespace
+}  // namespace retrieval
+}  // namespace colmap
@@ -48,6 +48,32 @@
 
 namespace colmap {
 namespace retrieval {
+namespace internal {
+
+// Append an unsigned integer in variable-length encoding with 7 bits per byte.
+inline void EncodeVarint(uint32_t value, std::vector<uint8_t>* data) {
+  while (value >= 0x80) {
+    data->push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  data->push_back(static_cast<uint8_t>(value));
+}
+
+// Decode a variable-length encoded unsigned integer and advance the pointer.
+inline uint32_t DecodeVarint(const uint8_t** data) {
+  uint32_t value = 0;
+  int shift = 0;
+  while (**data & 0x80) {
+    value |= static_cast<uint32_t>(**data & 0x7f) << shift;
+    shift += 7;
+    ++(*data);
+  }
+  value |= static_cast<uint32_t>(**data) << shift;
+  ++(*data);
+  return value;
+}
+
+}  // namespace internal
 
 // Implements an inverted file, including the ability to compute image scores
 // and matches. The template parameter is the length of the binary vectors
@@ -65,6 +91,8 @@ class InvertedFile {
     HAS_EMBEDDING = 0x01,
     ENTRIES_SORTED = 0x02,
     USABLE = 0x03,
+    STOP_WORD = 0x04,
+    COMPACT = 0x08,
   };
 
   InvertedFile();
@@ -72,7 +100,8 @@ class InvertedFile {
   // The number of added entries.
   size_t NumEntries() const;
 
-  // Return all entries in the file.
+  // Return all entries in the file. For a compact file, these are only the
+  // entries added since the last sorting.
   const std::vector<EntryType>& GetEntries() const;
 
   // Whether the Hamming embedding was computed for this file.
@@ -85,6 +114,15 @@ class InvertedFile {
   // the Hamming embedding has been computed.
   bool IsUsable() const;
 
+  // Whether this file is a stop word, whose entries are discarded.
+  bool IsStopWord() const;
+
+  // Whether the entries of this file are only stored in compact form.
+  bool IsCompact() const;
+
+  // The approximate memory usage of this file in bytes.
+  size_t NumBytes() const;
+
   // Adds an inverted file entry given a projected descriptor and its image
   // information stored in an inverted file entry. In particular, this function
   // generates the binary descriptor for the inverted file entry and then stores
@@ -104,6 +142,15 @@ class InvertedFile {
   // Reset all computed weights/thresholds and clear all entries.
   void Reset();
 
+  // Mark this file as a stop word, which clears all entries, discards all
+  // entries added later, and sets the idf-weight to zero.
+  void MarkStopWord();
+
+  // Sorts the entries and only keeps their image identifiers and binary
+  // descriptors, such that the file can still be scored but no longer be used
+  // for spatial verification. Entries added later are merged by SortEntries.
+  void Compact();
+
   // Given a projected descriptor, returns the corresponding binary string.
   void ConvertToBinaryDescriptor(
       const DescType& descriptor,
@@ -140,6 +187,14 @@ class InvertedFile {
   void Write(std::ofstream* ofs) const;
 
  private:
+  // Encode the image identifiers and binary descriptors of the sorted
+  // entries into the posting list.
+  void UpdateCompactEntries();
+
+  // Decode the posting list into entries without feature indices and
+  // geometries.
+  void DecodeCompactEntries(std::vector<EntryType>* entries) const;
+
   // Whether the inverted file is initialized.
   uint8_t status_;
 
@@ -149,6 +204,14 @@ class InvertedFile {
   // The entries of the inverted file system.
   std::vector<EntryType> entries_;
 
+  // The posting list of the sorted entries, such that scoring streams
+  // through contiguous memory instead of the full entries with their
+  // geometries. For each image in the file, the difference to the previous
+  // image identifier and the number of entries are stored as variable-length
+  // integers, followed by the binary descriptors of all entries.
+  std::vector<uint8_t> postings_;
+  std::vector<uint64_t> entry_descriptors_;
+
   // The thresholds used for Hamming embedding.
   DescType thresholds_;
 
@@ -173,6 +236,8 @@ InvertedFile<kEmbeddingDim>::InvertedFile()
                 " be a multiple of 8.");
   static_assert(kEmbeddingDim > 0,
                 "Dimensionality of projected space needs to be > 0.");
+  static_assert(kEmbeddingDim <= 64,
+                "Dimensionality of projected space needs to be <= 64.");
 
   thresholds_.resize(kEmbeddingDim);
   thresholds_.setZero();
@@ -180,6 +245,9 @@ InvertedFile<kEmbeddingDim>::InvertedFile()
 
 template <int kEmbeddingDim>
 size_t InvertedFile<kEmbeddingDim>::NumEntries() const {
+  if (IsCompact()) {
+    return entry_descriptors_.size() + entries_.size();
+  }
   return entries_.size();
 }
 
@@ -204,6 +272,24 @@ bool InvertedFile<kEmbeddingDim>::IsUsable() const {
   return status_ & USABLE;
 }
 
+template <int kEmbeddingDim>
+bool InvertedFile<kEmbeddingDim>::IsStopWord() const {
+  return status_ & STOP_WORD;
+}
+
+template <int kEmbeddingDim>
+bool InvertedFile<kEmbeddingDim>::IsCompact() const {
+  return status_ & COMPACT;
+}
+
+template <int kEmbeddingDim>
+size_t InvertedFile<kEmbeddingDim>::NumBytes() const {
+  return sizeof(*this) + entries_.capacity() * sizeof(EntryType) +
+         postings_.capacity() * sizeof(uint8_t) +
+         entry_descriptors_.capacity() * sizeof(uint64_t) +
+         thresholds_.size() * sizeof(float);
+}
+
 template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::AddEntry(const int image_id,
                                            typename DescType::Index feature_idx,
@@ -211,6 +297,9 @@ void InvertedFile<kEmbeddingDim>::AddEntry(const int image_id,
                                            const GeomType& geometry) {
   THROW_CHECK_GE(image_id, 0);
   THROW_CHECK_EQ(descriptor.size(), kEmbeddingDim);
+  if (IsStopWord()) {
+    return;
+  }
   EntryType entry;
   entry.image_id = image_id;
   entry.feature_idx = feature_idx;
@@ -222,17 +311,32 @@ void InvertedFile<kEmbeddingDim>::AddEntry(const int image_id,
 
 template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::SortEntries() {
-  std::sort(entries_.begin(),
-            entries_.end(),
-            [](const EntryType& entry1, const EntryType& entry2) {
-              return entry1.image_id < entry2.image_id;
-            });
+  if (IsCompact()) {
+    // Merge the newly added entries into the posting list.
+    if (entries_.empty()) {
+      status_ |= ENTRIES_SORTED;
+      return;
+    }
+    DecodeCompactEntries(&entries_);
+  }
+  std::stable_sort(entries_.begin(),
+                   entries_.end(),
+                   [](const EntryType& entry1, const EntryType& entry2) {
+                     return entry1.image_id < entry2.image_id;
+                   });
+  UpdateCompactEntries();
+  if (IsCompact()) {
+    entries_.clear();
+    entries_.shrink_to_fit();
+  }
   status_ |= ENTRIES_SORTED;
 }
 
 template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::ClearEntries() {
   entries_.clear();
+  postings_.clear();
+  entry_descriptors_.clear();
   status_ &= ~ENTRIES_SORTED;
 }
 
@@ -241,9 +345,37 @@ void InvertedFile<kEmbeddingDim>::Reset() {
   status_ = UNUSABLE;
   idf_weight_ = 0.0f;
   entries_.clear();
+  postings_.clear();
+  entry_descriptors_.clear();
   thresholds_.setZero();
 }
 
+template <int kEmbeddingDim>
+void InvertedFile<kEmbeddingDim>::MarkStopWord() {
+  ClearEntries();
+  entries_.shrink_to_fit();
+  postings_.shrink_to_fit();
+  entry_descriptors_.shrink_to_fit();
+  idf_weight_ = 0.0f;
+  status_ |= STOP_WORD | ENTRIES_SORTED;
+}
+
+template <int kEmbeddingDim>
+void InvertedFile<kEmbeddingDim>::Compact() {
+  if (!IsCompact()) {
+    status_ |= COMPACT;
+    // The posting list already holds all entries, if they are sorted.
+    if (EntriesSorted()) {
+      entries_.clear();
+      entries_.shrink_to_fit();
+      return;
+    }
+    postings_.clear();
+    entry_descriptors_.clear();
+  }
+  SortEntries();
+}
+
 template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::ConvertToBinaryDescriptor(
     const DescType& descriptor,
@@ -256,7 +388,7 @@ void InvertedFile<kEmbeddingDim>::ConvertToBinaryDescriptor(
 
 template <int kEmbeddingDim>
 void InvertedFile<kEmbeddingDim>::ComputeIDFWeight(const int num_total_images) {
-  if (entries_.empty()) {
+  if (NumEntries() == 0) {
     return;
   }
 
@@ -302,7 +434,7 @@ void InvertedFile<kEmbeddingDim>::ScoreFeature(
     return;
   }
 
-  if (entries_.size() == 0) {
+  if (postings_.empty()) {
     return;
   }
 
@@ -310,49 +442,46 @@ void InvertedFile<kEmbeddingDim>::ScoreFeature(
 
   std::bitset<kEmbeddingDim> bin_descriptor;
   ConvertToBinaryDescriptor(descriptor, &bin_descriptor);
-
-  ImageScore image_score;
-  image_score.image_id = entries_.front().image_id;
-  image_score.score = 0.0f;
-  int num_image_votes = 0;
+  const uint64_t query_descriptor = bin_descriptor.to_ullong();
 
   // Note that this assumes that the entries are sorted using SortEntries
   // according to their image identifiers.
-  for (const auto& entry : entries_) {
-    if (image_score.image_id < entry.image_id) {
-      if (num_image_votes > 0) {
-        // Finalizes the voting since we now know how many features from
-        // the database image match the current image feature. This is
-        // required to perform burstiness normalization (cf. Eqn. 2 in
-        // Arandjelovic, Zisserman: Scalable descriptor
-        // distinctiveness for location recognition. ACCV 2014).
-        // Notice that the weight from the descriptor matching is already
-        // accumulated in image_score.score, i.e., we only need
-        // to apply the burstiness weighting.
-        image_score.score /= std::sqrt(static_cast<float>(num_image_votes));
-        image_score.score *= squared_idf_weight;
-        image_scores->push_back(image_score);
+  const uint8_t* posting = postings_.data();
+  const uint8_t* const postings_end = postings_.data() + postings_.size();
+  const uint64_t* entry_descriptor = entry_descriptors_.data();
+  int image_id = 0;
+  while (posting < postings_end) {
+    image_id += static_cast<int>(internal::DecodeVarint(&posting));
+    const uint32_t num_image_entries = internal::DecodeVarint(&posting);
+
+    float score = 0.0f;
+    int num_image_votes = 0;
+    for (uint32_t i = 0; i < num_image_entries; ++i, ++entry_descriptor) {
+      // Compiles to a single population count instruction, if available.
+      const size_t hamming_dist =
+          std::bitset<64>(query_descriptor ^ *entry_descriptor).count();
+      if (hamming_dist <= hamming_dist_weight_functor_.kMaxHammingDistance) {
+        score += hamming_dist_weight_functor_(hamming_dist);
+        num_image_votes += 1;
       }
-
-      image_score.image_id = entry.image_id;
-      image_score.score = 0.0f;
-      num_image_votes = 0;
     }
 
-    const size_t hamming_dist = (bin_descriptor ^ entry.descriptor).count();
-
-    if (hamming_dist <= hamming_dist_weight_functor_.kMaxHammingDistance) {
-      image_score.score += hamming_dist_weight_functor_(hamming_dist);
-      num_image_votes += 1;
+    if (num_image_votes > 0) {
+      // Finalizes the voting since we now know how many features from
+      // the database image match the current image feature. This is
+      // required to perform burstiness normalization (cf. Eqn. 2 in
+      // Arandjelovic, Zisserman: Scalable descriptor
+      // distinctiveness for location recognition. ACCV 2014).
+      // Notice that the weight from the descriptor matching is already
+      // accumulated in score, i.e., we only need to apply the burstiness
+      // weighting.
+      ImageScore image_score;
+      image_score.image_id = image_id;
+      image_score.score = squared_idf_weight * score /
+                          std::sqrt(static_cast<float>(num_image_votes));
+      image_scores->push_back(image_score);
     }
   }
-
-  // Add the voting for the largest image_id in the entries.
-  if (num_image_votes > 0) {
-    image_score.score /= std::sqrt(static_cast<float>(num_image_votes));
-    image_score.score *= squared_idf_weight;
-    image_scores->push_back(image_score);
-  }
 }
 
 template <int kEmbeddingDim>
@@ -361,6 +490,16 @@ void InvertedFile<kEmbeddingDim>::GetImageIds(
   for (const EntryType& entry : entries_) {
     ids->insert(entry.image_id);
   }
+  if (IsCompact()) {
+    const uint8_t* posting = postings_.data();
+    const uint8_t* const postings_end = postings_.data() + postings_.size();
+    int image_id = 0;
+    while (posting < postings_end) {
+      image_id += static_cast<int>(internal::DecodeVarint(&posting));
+      internal::DecodeVarint(&posting);
+      ids->insert(image_id);
+    }
+  }
 }
 
 template <int kEmbeddingDim>
@@ -370,6 +509,16 @@ void InvertedFile<kEmbeddingDim>::ComputeImageSelfSimilarities(
   for (const auto& entry : entries_) {
     (*self_similarities)[entry.image_id] += squared_idf_weight;
   }
+  if (IsCompact()) {
+    const uint8_t* posting = postings_.data();
+    const uint8_t* const postings_end = postings_.data() + postings_.size();
+    int image_id = 0;
+    while (posting < postings_end) {
+      image_id += static_cast<int>(internal::DecodeVarint(&posting));
+      const uint32_t num_image_entries = internal::DecodeVarint(&posting);
+      (*self_similarities)[image_id] += num_image_entries * squared_idf_weight;
+    }
+  }
 }
 
 template <int kEmbeddingDim>
@@ -378,9 +527,24 @@ void InvertedFile<kEmbeddingDim>::Read(std::ifstream* ifs) {
 
   ifs->read(reinterpret_cast<char*>(&status_), sizeof(uint8_t));
   ifs->read(reinterpret_cast<char*>(&idf_weight_), sizeof(float));
+  ifs->read(reinterpret_cast<char*>(thresholds_.data()),
+            kEmbeddingDim * sizeof(float));
 
-  for (int i = 0; i < kEmbeddingDim; ++i) {
-    ifs->read(reinterpret_cast<char*>(&thresholds_[i]), sizeof(float));
+  entries_.clear();
+  postings_.clear();
+  entry_descriptors_.clear();
+
+  if (IsCompact()) {
+    uint64_t num_posting_bytes = 0;
+    ifs->read(reinterpret_cast<char*>(&num_posting_bytes), sizeof(uint64_t));
+    postings_.resize(num_posting_bytes);
+    ifs->read(reinterpret_cast<char*>(postings_.data()), num_posting_bytes);
+    uint64_t num_entries = 0;
+    ifs->read(reinterpret_cast<char*>(&num_entries), sizeof(uint64_t));
+    entry_descriptors_.resize(num_entries);
+    ifs->read(reinterpret_cast<char*>(entry_descriptors_.data()),
+              num_entries * sizeof(uint64_t));
+    return;
   }
 
   uint32_t num_entries = 0;
@@ -390,6 +554,10 @@ void InvertedFile<kEmbeddingDim>::Read(std::ifstream* ifs) {
   for (uint32_t i = 0; i < num_entries; ++i) {
     entries_[i].Read(ifs);
   }
+
+  if (EntriesSorted()) {
+    UpdateCompactEntries();
+  }
 }
 
 template <int kEmbeddingDim>
@@ -403,6 +571,21 @@ void InvertedFile<kEmbeddingDim>::Write(std::ofstream* ofs) const {
     ofs->write(reinterpret_cast<const char*>(&thresholds_[i]), sizeof(float));
   }
 
+  if (IsCompact()) {
+    THROW_CHECK(entries_.empty())
+        << "Compact inverted file must be sorted before writing";
+    const uint64_t num_posting_bytes = postings_.size();
+    ofs->write(reinterpret_cast<const char*>(&num_posting_bytes),
+               sizeof(uint64_t));
+    ofs->write(reinterpret_cast<const char*>(postings_.data()),
+               num_posting_bytes);
+    const uint64_t num_entries = entry_descriptors_.size();
+    ofs->write(reinterpret_cast<const char*>(&num_entries), sizeof(uint64_t));
+    ofs->write(reinterpret_cast<const char*>(entry_descriptors_.data()),
+               num_entries * sizeof(uint64_t));
+    return;
+  }
+
   const uint32_t num_entries = static_cast<uint32_t>(entries_.size());
   ofs->write(reinterpret_cast<const char*>(&num_entries), sizeof(uint32_t));
 
@@ -411,5 +594,47 @@ void InvertedFile<kEmbeddingDim>::Write(std::ofstream* ofs) const {
   }
 }
 
+template <int kEmbeddingDim>
+void InvertedFile<kEmbeddingDim>::UpdateCompactEntries() {
+  postings_.clear();
+  entry_descriptors_.resize(entries_.size());
+  int prev_image_id = 0;
+  for (size_t begin = 0; begin < entries_.size();) {
+    const int image_id = entries_[begin].image_id;
+    size_t end = begin + 1;
+    while (end < entries_.size() && entries_[end].image_id == image_id) {
+      ++end;
+    }
+    internal::EncodeVarint(static_cast<uint32_t>(image_id - prev_image_id),
+                           &postings_);
+    internal::EncodeVarint(static_cast<uint32_t>(end - begin), &postings_);
+    for (size_t i = begin; i < end; ++i) {
+      entry_descriptors_[i] = entries_[i].descriptor.to_ullong();
+    }
+    prev_image_id = image_id;
+    begin = end;
+  }
+  postings_.shrink_to_fit();
+}
+
+template <int kEmbeddingDim>
+void InvertedFile<kEmbeddingDim>::DecodeCompactEntries(
+    std::vector<EntryType>* entries) const {
+  entries->reserve(entries->size() + entry_descriptors_.size());
+  const uint8_t* posting = postings_.data();
+  const uint8_t* const postings_end = postings_.data() + postings_.size();
+  const uint64_t* entry_descriptor = entry_descriptors_.data();
+  EntryType entry;
+  entry.image_id = 0;
+  while (posting < postings_end) {
+    entry.image_id += static_cast<int>(internal::DecodeVarint(&posting));
+    const uint32_t num_image_entries = internal::DecodeVarint(&posting);
+    for (uint32_t i = 0; i < num_image_entries; ++i, ++entry_descriptor) {
+      entry.descriptor = std::bitset<kEmbeddingDim>(*entry_descriptor);
+      entries->push_back(entry);
+    }
+  }
+}
+
 }  // namespace retrieval
 }  // namespace colmap
@@ -73,6 +73,22 @@ class InvertedIndex {
   // entries are in ascending order of image ids.
   void Finalize();
 
+  // Clear the inverted files of visual words that occur in more than the
+  // given fraction of all indexed images and exclude them from scoring. This
+  // is equivalent to pruning words below an idf-weight of
+  // -log(max_document_frequency). Returns the number of pruned words.
+  int PruneStopWords(double max_document_frequency);
+
+  // Only keep the image identifiers and binary descriptors of all entries,
+  // which makes the index unusable for spatial verification.
+  void Compact();
+
+  // Whether the index was compacted.
+  bool IsCompact() const;
+
+  // The approximate memory usage of the index in bytes.
+  size_t NumBytes() const;
+
   // Generate projection matrix for Hamming embedding.
   void GenerateHammingEmbeddingProjection();
 
@@ -173,6 +189,57 @@ void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Finalize() {
   ComputeWeightsAndNormalizationConstants();
 }
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+int InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::PruneStopWords(
+    const double max_document_frequency) {
+  std::unordered_set<int> image_ids;
+  GetImageIds(&image_ids);
+  const double max_num_images = max_document_frequency * image_ids.size();
+
+  int num_stop_words = 0;
+  std::unordered_set<int> word_image_ids;
+  for (auto& inverted_file : inverted_files_) {
+    if (inverted_file.IsStopWord()) {
+      continue;
+    }
+    word_image_ids.clear();
+    inverted_file.GetImageIds(&word_image_ids);
+    if (word_image_ids.size() > max_num_images) {
+      inverted_file.MarkStopWord();
+      num_stop_words += 1;
+    }
+  }
+
+  if (num_stop_words > 0) {
+    ComputeWeightsAndNormalizationConstants();
+  }
+
+  return num_stop_words;
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::Compact() {
+  for (auto& inverted_file : inverted_files_) {
+    inverted_file.Compact();
+  }
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+bool InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::IsCompact() const {
+  return !inverted_files_.empty() && inverted_files_.front().IsCompact();
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+size_t InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::NumBytes() const {
+  size_t num_bytes =
+      sizeof(*this) + proj_matrix_.size() * sizeof(float) +
+      normalization_constants_.size() * (sizeof(int) + sizeof(float));
+  for (const auto& inverted_file : inverted_files_) {
+    num_bytes += inverted_file.NumBytes();
+  }
+  return num_bytes;
+}
+
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void InvertedIndex<kDescType, kDescDim, kEmbeddingDim>::
     GenerateHammingEmbeddingProjection() {
@@ -0,0 +1,413 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/util/logging.h"
+#include "colmap/util/string.h"
+#include "colmap/util/threading.h"
+
+#if defined(COLMAP_CUDA_ENABLED)
+#include "colmap/retrieval/visual_word_index_cuda.h"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace colmap {
+namespace retrieval {
+
+struct HierarchicalKMeansOptions {
+  // The desired number of leaf clusters. Note that the actual number of
+  // leaf clusters might be less, e.g., if nodes have too few descriptors.
+  int num_clusters = 256 * 256;
+
+  // The branching factor of the tree.
+  int branching = 256;
+
+  // The number of descriptors per mini-batch. Nodes with at most this number
+  // of descriptors are clustered by standard k-means on all descriptors.
+  int mini_batch_size = 10000;
+
+  // The number of mini-batch iterations per node.
+  int num_mini_batch_iterations = 100;
+
+  // The number of standard k-means iterations per node.
+  int num_iterations = 11;
+
+  // The number of threads used for clustering.
+  int num_threads = -1;
+
+  // Whether to assign descriptors to cluster centers on the GPU.
+  bool use_gpu = false;
+
+  // The index of the GPU, where -1 selects the best available GPU.
+  int gpu_index = -1;
+
+  bool Check() const;
+};
+
+// Cluster the rows of the descriptor matrix into the leaves of a tree by
+// recursive mini-batch k-means, based on the paper:
+//
+//    Sculley. "Web-Scale K-Means Clustering". WWW 2010.
+//
+// The tree is built level by level. Levels with fewer nodes than threads
+// parallelize the assignment of descriptors to centers, while the other
+// levels cluster multiple nodes in parallel. Each node is seeded by its
+// position in the tree, so the result does not depend on the scheduling.
+// Returns the leaf cluster centers as a row-major matrix.
+template <typename DescType>
+Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+HierarchicalKMeans(const HierarchicalKMeansOptions& options,
+                   const DescType& descriptors);
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+inline bool HierarchicalKMeansOptions::Check() const {
+  CHECK_OPTION_GT(num_clusters, 0);
+  CHECK_OPTION_GT(branching, 1);
+  CHECK_OPTION_GT(mini_batch_size, 0);
+  CHECK_OPTION_GE(num_mini_batch_iterations, 0);
+  CHECK_OPTION_GE(num_iterations, 0);
+  return true;
+}
+
+namespace internal {
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    KMeansCenters;
+
+// Assign the descriptors with the given indices to their nearest centers.
+// If a thread pool is given, the descriptors are assigned in parallel.
+template <typename DescType>
+void AssignToNearestCenters(const HierarchicalKMeansOptions& options,
+                            const DescType& descriptors,
+                            const std::vector<uint32_t>& idxs,
+                            const KMeansCenters& centers,
+                            ThreadPool* thread_pool,
+                            std::vector<int>* assignments) {
+  assignments->resize(idxs.size());
+  if (idxs.empty()) {
+    return;
+  }
+
+#if defined(COLMAP_CUDA_ENABLED)
+  if (options.use_gpu) {
+    const CudaVisualWordIndex cuda_index(options.gpu_index,
+                                         centers.data(),
+                                         static_cast<int>(centers.rows()),
+                                         static_cast<int>(centers.cols()));
+    // Upload the descriptors in chunks to bound the memory of the copies.
+    const size_t kChunkSize = 1 << 20;
+    KMeansCenters chunk;
+    for (size_t begin = 0; begin < idxs.size(); begin += kChunkSize) {
+      const size_t end = std::min(begin + kChunkSize, idxs.size());
+      chunk.resize(end - begin, descriptors.cols());
+      for (size_t i = begin; i < end; ++i) {
+        chunk.row(i - begin) = descriptors.row(idxs[i]).template cast<float>();
+      }
+      cuda_index.Search(chunk.data(),
+                        static_cast<int>(chunk.rows()),
+                        /*num_neighbors=*/1,
+                        assignments->data() + begin);
+    }
+    return;
+  }
+#else
+  THROW_CHECK(!options.use_gpu)
+      << "Clustering on the GPU requires CUDA support";
+#endif
+
+  auto AssignRange = [&](const size_t begin, const size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const Eigen::RowVectorXf descriptor =
+          descriptors.row(idxs[i]).template cast<float>();
+      Eigen::Index nearest_center_idx;
+      (centers.rowwise() - descriptor)
+          .rowwise()
+          .squaredNorm()
+          .minCoeff(&nearest_center_idx);
+      (*assignments)[i] = static_cast<int>(nearest_center_idx);
+    }
+  };
+
+  if (thread_pool == nullptr || thread_pool->NumThreads() == 1) {
+    AssignRange(0, idxs.size());
+    return;
+  }
+
+  const size_t num_tasks = 4 * thread_pool->NumThreads();
+  const size_t chunk_size = (idxs.size() + num_tasks - 1) / num_tasks;
+  std::vector<std::future<void>> futures;
+  futures.reserve(num_tasks);
+  for (size_t begin = 0; begin < idxs.size(); begin += chunk_size) {
+    futures.push_back(thread_pool->AddTask(
+        AssignRange, begin, std::min(begin + chunk_size, idxs.size())));
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+}
+
+// Cluster the descriptors of one node into at most num_centers centers and
+// partition the node's descriptors into the children of the centers.
+template <typename DescType>
+void ClusterNode(const HierarchicalKMeansOptions& options,
+                 const DescType& descriptors,
+                 const std::vector<uint32_t>& idxs,
+                 const int num_centers,
+                 const unsigned seed,
+                 ThreadPool* thread_pool,
+                 KMeansCenters* centers,
+                 std::vector<std::vector<uint32_t>>* children) {
+  std::mt19937 prng(seed);
+  std::uniform_int_distribution<size_t> idx_distribution(0, idxs.size() - 1);
+
+  // Initialize the centers by k-means++ on a random sample of the node.
+  std::vector<uint32_t> sample_idxs;
+  if (idxs.size() <= static_cast<size_t>(options.mini_batch_size)) {
+    sample_idxs = idxs;
+  } else {
+    sample_idxs.resize(options.mini_batch_size);
+    for (auto& sample_idx : sample_idxs) {
+      sample_idx = idxs[idx_distribution(prng)];
+    }
+  }
+  KMeansCenters samples(sample_idxs.size(), descriptors.cols());
+  for (size_t i = 0; i < sample_idxs.size(); ++i) {
+    samples.row(i) = descriptors.row(sample_idxs[i]).template cast<float>();
+  }
+
+  centers->resize(num_centers, descriptors.cols());
+  std::uniform_int_distribution<Eigen::Index> sample_distribution(
+      0, samples.rows() - 1);
+  centers->row(0) = samples.row(sample_distribution(prng));
+  Eigen::VectorXf squared_dists =
+      (samples.rowwise() - centers->row(0)).rowwise().squaredNorm();
+  for (int j = 1; j < num_centers; ++j) {
+    Eigen::Index sample_idx;
+    if (squared_dists.sum() > 0) {
+      std::discrete_distribution<Eigen::Index> center_distribution(
+          squared_dists.data(), squared_dists.data() + squared_dists.size());
+      sample_idx = center_distribution(prng);
+    } else {
+      // All samples coincide with the centers.
+      sample_idx = sample_distribution(prng);
+    }
+    centers->row(j) = samples.row(sample_idx);
+    squared_dists = squared_dists.cwiseMin(
+        (samples.rowwise() - centers->row(j)).rowwise().squaredNorm());
+  }
+
+  std::vector<int> assignments;
+  if (idxs.size() <= static_cast<size_t>(options.mini_batch_size)) {
+    // Standard k-means on all descriptors of the node.
+    for (int iter = 0; iter < options.num_iterations; ++iter) {
+      AssignToNearestCenters(
+          options, descriptors, idxs, *centers, thread_pool, &assignments);
+      KMeansCenters sums = KMeansCenters::Zero(num_centers, centers->cols());
+      std::vector<int> counts(num_centers, 0);
+      for (size_t i = 0; i < idxs.size(); ++i) {
+        sums.row(assignments[i]) +=
+            descriptors.row(idxs[i]).template cast<float>();
+        counts[assignments[i]] += 1;
+      }
+      // Empty clusters keep their previous center.
+      for (int j = 0; j < num_centers; ++j) {
+        if (counts[j] > 0) {
+          centers->row(j) = sums.row(j) / static_cast<float>(counts[j]);
+        }
+      }
+    }
+  } else {
+    // Mini-batch k-means with per-center learning rates.
+    std::vector<int> counts(num_centers, 0);
+    std::vector<uint32_t> batch_idxs(options.mini_batch_size);
+    for (int iter = 0; iter < options.num_mini_batch_iterations; ++iter) {
+      for (auto& batch_idx : batch_idxs) {
+        batch_idx = idxs[idx_distribution(prng)];
+      }
+      AssignToNearestCenters(options,
+                             descriptors,
+                             batch_idxs,
+                             *centers,
+                             thread_pool,
+                             &assignments);
+      for (size_t i = 0; i < batch_idxs.size(); ++i) {
+        const int center_idx = assignments[i];
+        counts[center_idx] += 1;
+        const float learning_rate = 1.0f / counts[center_idx];
+        centers->row(center_idx) +=
+            learning_rate *
+            (descriptors.row(batch_idxs[i]).template cast<float>() -
+             centers->row(center_idx));
+      }
+    }
+  }
+
+  AssignToNearestCenters(
+      options, descriptors, idxs, *centers, thread_pool, &assignments);
+  children->clear();
+  children->resize(num_centers);
+  for (size_t i = 0; i < idxs.size(); ++i) {
+    (*children)[assignments[i]].push_back(idxs[i]);
+  }
+}
+
+}  // namespace internal
+
+template <typename DescType>
+Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+HierarchicalKMeans(const HierarchicalKMeansOptions& options,
+                   const DescType& descriptors) {
+  THROW_CHECK(options.Check());
+  THROW_CHECK_GT(descriptors.rows(), 0);
+  THROW_CHECK_LE(descriptors.rows(), std::numeric_limits<uint32_t>::max());
+
+  // The number of levels, of which all but the last one have the full
+  // branching factor. The last one is chosen such that the number of leaf
+  // clusters does not exceed the desired number of clusters.
+  int num_levels = 1;
+  int num_inner_nodes = 1;
+  while (static_cast<int64_t>(num_inner_nodes) * options.branching <
+         options.num_clusters) {
+    num_inner_nodes *= options.branching;
+    num_levels += 1;
+  }
+  const int last_branching = std::max(
+      1, std::min(options.branching, options.num_clusters / num_inner_nodes));
+
+  ThreadPool thread_pool(options.num_threads);
+
+  std::vector<std::vector<uint32_t>> nodes(1);
+  nodes[0].resize(descriptors.rows());
+  std::iota(nodes[0].begin(), nodes[0].end(), 0);
+
+  std::vector<internal::KMeansCenters> leaf_centers;
+  for (int level = 0; level < num_levels; ++level) {
+    const bool is_last_level = level + 1 == num_levels;
+    const int branching = is_last_level ? last_branching : options.branching;
+
+    LOG(INFO) << StringPrintf("Clustering level [%d/%d] with %d nodes",
+                              level + 1,
+                              num_levels,
+                              nodes.size());
+
+    std::vector<internal::KMeansCenters> node_centers(nodes.size());
+    std::vector<std::vector<std::vector<uint32_t>>> node_children(
+        nodes.size());
+    auto ProcessNode = [&](const size_t node_idx, ThreadPool* inner_pool) {
+      const auto& idxs = nodes[node_idx];
+      if (idxs.empty()) {
+        return;
+      }
+      // Nodes with too few descriptors become a leaf with their mean.
+      if (static_cast<int>(idxs.size()) < branching) {
+        internal::KMeansCenters mean =
+            internal::KMeansCenters::Zero(1, descriptors.cols());
+        for (const uint32_t idx : idxs) {
+          mean += descriptors.row(idx).template cast<float>();
+        }
+        node_centers[node_idx] = mean / static_cast<float>(idxs.size());
+        return;
+      }
+      internal::ClusterNode(options,
+                            descriptors,
+                            idxs,
+                            branching,
+                            static_cast<unsigned>(level * 1000003 + node_idx),
+                            inner_pool,
+                            &node_centers[node_idx],
+                            &node_children[node_idx]);
+    };
+
+    if (nodes.size() >= thread_pool.NumThreads()) {
+      std::vector<std::future<void>> futures;
+      futures.reserve(nodes.size());
+      for (size_t node_idx = 0; node_idx < nodes.size(); ++node_idx) {
+        futures.push_back(thread_pool.AddTask(
+            ProcessNode, node_idx, static_cast<ThreadPool*>(nullptr)));
+      }
+      for (auto& future : futures) {
+        future.get();
+      }
+    } else {
+      for (size_t node_idx = 0; node_idx < nodes.size(); ++node_idx) {
+        ProcessNode(node_idx, &thread_pool);
+      }
+    }
+
+    std::vector<std::vector<uint32_t>> next_nodes;
+    for (size_t node_idx = 0; node_idx < nodes.size(); ++node_idx) {
+      auto& children = node_children[node_idx];
+      if (is_last_level || children.empty()) {
+        // Leaf nodes, i.e., nodes at the last level or with a single mean.
+        if (node_centers[node_idx].rows() == 0) {
+          continue;
+        }
+        if (is_last_level && !children.empty()) {
+          // Drop the centers of empty children.
+          for (size_t child_idx = 0; child_idx < children.size();
+               ++child_idx) {
+            if (!children[child_idx].empty()) {
+              leaf_centers.push_back(node_centers[node_idx].row(child_idx));
+            }
+          }
+        } else {
+          leaf_centers.push_back(std::move(node_centers[node_idx]));
+        }
+      } else {
+        for (auto& child : children) {
+          next_nodes.push_back(std::move(child));
+        }
+      }
+    }
+    nodes = std::move(next_nodes);
+  }
+
+  internal::KMeansCenters centers(leaf_centers.size(), descriptors.cols());
+  for (size_t i = 0; i < leaf_centers.size(); ++i) {
+    centers.row(i) = leaf_centers[i];
+  }
+  return centers;
+}
+
+}  // namespace retrieval
+}  // namespace colmap
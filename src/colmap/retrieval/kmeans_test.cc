@@ -0,0 +1,121 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/retrieval/kmeans.h"
+
+#include "colmap/math/random.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace retrieval {
+namespace {
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, 2, Eigen::RowMajor> Points2D;
+
+// Generate points in well separated groups around the corners of a square.
+Points2D GenerateClusteredPoints(const int num_points_per_cluster) {
+  const std::vector<Eigen::RowVector2f> cluster_centers = {
+      {0, 0}, {100, 0}, {0, 100}, {100, 100}};
+  Points2D points(cluster_centers.size() * num_points_per_cluster, 2);
+  for (size_t i = 0; i < cluster_centers.size(); ++i) {
+    for (int j = 0; j < num_points_per_cluster; ++j) {
+      points.row(i * num_points_per_cluster + j) =
+          cluster_centers[i] +
+          Eigen::RowVector2f(RandomUniformReal<float>(-1, 1),
+                             RandomUniformReal<float>(-1, 1));
+    }
+  }
+  return points;
+}
+
+void ExpectClusterCenters(
+    const Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>&
+        centers) {
+  ASSERT_EQ(centers.rows(), 4);
+  ASSERT_EQ(centers.cols(), 2);
+  for (const auto& expected_center : {Eigen::RowVector2f(0, 0),
+                                      Eigen::RowVector2f(100, 0),
+                                      Eigen::RowVector2f(0, 100),
+                                      Eigen::RowVector2f(100, 100)}) {
+    const float min_dist =
+        (centers.rowwise() - expected_center).rowwise().norm().minCoeff();
+    EXPECT_LT(min_dist, 1);
+  }
+}
+
+TEST(HierarchicalKMeans, Nominal) {
+  SetPRNGSeed(0);
+  const Points2D points = GenerateClusteredPoints(100);
+  HierarchicalKMeansOptions options;
+  options.num_clusters = 4;
+  options.branching = 4;
+  options.mini_batch_size = 1000;
+  ExpectClusterCenters(HierarchicalKMeans(options, points));
+}
+
+TEST(HierarchicalKMeans, MiniBatch) {
+  SetPRNGSeed(0);
+  const Points2D points = GenerateClusteredPoints(1000);
+  HierarchicalKMeansOptions options;
+  options.num_clusters = 4;
+  options.branching = 4;
+  options.mini_batch_size = 100;
+  ExpectClusterCenters(HierarchicalKMeans(options, points));
+}
+
+TEST(HierarchicalKMeans, Deterministic) {
+  SetPRNGSeed(0);
+  const Points2D points = GenerateClusteredPoints(500);
+  HierarchicalKMeansOptions options;
+  options.num_clusters = 64;
+  options.branching = 4;
+  options.mini_batch_size = 200;
+  options.num_threads = 1;
+  const auto centers1 = HierarchicalKMeans(options, points);
+  options.num_threads = 4;
+  const auto centers2 = HierarchicalKMeans(options, points);
+  EXPECT_GT(centers1.rows(), 4);
+  EXPECT_LE(centers1.rows(), 64);
+  EXPECT_EQ(centers1, centers2);
+}
+
+TEST(HierarchicalKMeans, FewDescriptors) {
+  HierarchicalKMeansOptions options;
+  options.num_clusters = 16;
+  options.branching = 4;
+  const Points2D points = Points2D::Random(3, 2);
+  const auto centers = HierarchicalKMeans(options, points);
+  ASSERT_EQ(centers.rows(), 1);
+  EXPECT_TRUE(centers.row(0).isApprox(points.colwise().mean()));
+}
+
+}  // namespace
+}  // namespace retrieval
+}  // namespace colmap
@@ -68,7 +68,7 @@ class HammingDistWeightFunctor {
   // Returns the weight for Hamming distance h and standard deviation sigma.
   // Does not perform a range check when performing the look-up.
   inline float operator()(const size_t hamming_dist) const {
-    return look_up_table_.at(hamming_dist);
+    return look_up_table_[hamming_dist];
   }
 
  private:
@@ -33,11 +33,23 @@
 #include "colmap/math/math.h"
 #include "colmap/retrieval/inverted_file.h"
 #include "colmap/retrieval/inverted_index.h"
+#include "colmap/retrieval/kmeans.h"
 #include "colmap/retrieval/vote_and_verify.h"
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/endian.h"
 #include "colmap/util/logging.h"
+#include "colmap/util/mapped_file.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/threading.h"
+
+#if defined(COLMAP_CUDA_ENABLED)
+#include "colmap/retrieval/visual_word_index_cuda.h"
+#endif
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
 
 #include <Eigen/Core>
 #include <boost/heap/fibonacci_heap.hpp>
@@ -75,6 +87,14 @@ class VisualIndex {
 
     // The number of threads used in the index.
     int num_threads = kMaxNumThreads;
+
+    // Whether to find the nearest visual words by exhaustive search on the
+    // GPU instead of approximate search on the CPU. Requires CUDA.
+    bool use_gpu = false;
+
+    // The index of the GPU used for the visual word search, where -1 selects
+    // the best available GPU.
+    int gpu_index = -1;
   };
 
   struct QueryOptions {
@@ -91,8 +111,36 @@ class VisualIndex {
     // Whether to perform spatial verification after image retrieval.
     int num_images_after_verification = 0;
 
+    // If positive, spatial verification stops after at least this many images
+    // were verified, in the order of their retrieval score. The remaining
+    // images keep their retrieval score.
+    int max_num_verified_images = -1;
+
     // The number of threads used in the index.
     int num_threads = kMaxNumThreads;
+
+    // Whether to find the nearest visual words by exhaustive search on the
+    // GPU instead of approximate search on the CPU. Requires CUDA.
+    bool use_gpu = false;
+
+    // The index of the GPU used for the visual word search, where -1 selects
+    // the best available GPU.
+    int gpu_index = -1;
+  };
+
+  struct PrepareOptions {
+    // Visual words that occur in more than this fraction of the indexed
+    // images are pruned as stop words, which reduces the memory usage and
+    // query time with little effect on the retrieval quality.
+    double max_document_frequency = 1.0;
+
+    // Whether to only keep the image identifiers and binary descriptors of
+    // the indexed features and drop their feature indices and geometries.
+    // This reduces the memory usage of the inverted index by a factor of
+    // about four, but the index can no longer be used for spatial
+    // verification. Images added later to a compact index are compacted in
+    // the next preparation.
+    bool compact = false;
   };
 
   struct BuildOptions {
@@ -106,6 +154,14 @@ class VisualIndex {
     // The number of iterations for the clustering.
     int num_iterations = 11;
 
+    // If positive, the descriptor space is quantized by the parallel
+    // hierarchical mini-batch k-means in kmeans.h with the given number of
+    // descriptors per mini-batch instead of FLANN's hierarchical k-means.
+    int mini_batch_size = -1;
+
+    // The number of mini-batch iterations per node of the tree.
+    int num_mini_batch_iterations = 100;
+
     // The target precision of the visual word search index.
     double target_precision = 0.95;
 
@@ -114,6 +170,13 @@ class VisualIndex {
 
     // The number of threads used in the index.
     int num_threads = kMaxNumThreads;
+
+    // Whether to use the GPU for the mini-batch k-means and for learning the
+    // Hamming embedding. Requires CUDA.
+    bool use_gpu = false;
+
+    // The index of the GPU, where -1 selects the best available GPU.
+    int gpu_index = -1;
   };
 
   VisualIndex();
@@ -121,15 +184,29 @@ class VisualIndex {
 
   size_t NumVisualWords() const;
 
+  // The visual words of the vocabulary tree, one per row.
+  Eigen::Map<const DescType> VisualWords() const;
+
   // Add image to the visual index.
   void Add(const IndexOptions& options,
            int image_id,
            const GeomType& geometries,
            const DescType& descriptors);
 
+  // Add multiple images to the visual index. The descriptors of all images
+  // are quantized in a single nearest neighbor search, which is parallelized
+  // across all descriptors instead of the descriptors of a single image.
+  void Add(const IndexOptions& options,
+           const std::vector<int>& image_ids,
+           const std::vector<GeomType>& geometries,
+           const std::vector<DescType>& descriptors);
+
   // Check if an image has been indexed.
   bool ImageIndexed(int image_id) const;
 
+  // Identifiers of all indexed images.
+  const std::unordered_set<int>& ImageIds() const;
+
   // Query for most similar images in the visual index.
   void Query(const QueryOptions& options,
              const DescType& descriptors,
@@ -143,13 +220,23 @@ class VisualIndex {
 
   // Prepare the index after adding images and before querying.
   void Prepare();
+  void Prepare(const PrepareOptions& options);
+
+  // Whether the index was compacted and cannot be spatially verified.
+  bool IsCompact() const;
+
+  // The approximate memory usage of the index in bytes, including the visual
+  // words.
+  size_t NumBytes() const;
 
   // Build a visual index from a set of training descriptors by quantizing the
   // descriptor space into visual words and compute their Hamming embedding.
   void Build(const BuildOptions& options, const DescType& descriptors);
 
   // Read and write the visual index. This can be done for an index with and
-  // without indexed images.
+  // without indexed images. On little-endian machines, the visual words are
+  // used in place from a read-only memory mapping of the file, such that
+  // processes reading the same index share its pages.
   void Read(const std::string& path);
   void Write(const std::string& path);
 
@@ -164,17 +251,69 @@ class VisualIndex {
                            std::vector<ImageScore>* image_scores,
                            Eigen::MatrixXi* word_ids) const;
 
+  // Add the entries of an image with the given rows of visual word ids.
+  void AddEntries(int num_neighbors,
+                  int image_id,
+                  const GeomType& geometries,
+                  const DescType& descriptors,
+                  const Eigen::MatrixXi& word_ids,
+                  Eigen::Index word_ids_offset);
+
+  // The candidate feature matches of an image ordered by their weight.
+  typedef std::vector<
+      std::pair<float, std::pair<const EntryType*, const EntryType*>>>
+      OrderedMatchListType;
+  typedef std::unordered_map<int, OrderedMatchListType> FeatureMatchesType;
+
+  // Buffers for the spatial verification, which are reused across images.
+  struct VerificationScratch {
+    typedef boost::heap::fibonacci_heap<std::pair<int, int>> FibonacciHeapType;
+    FibonacciHeapType query_heap;
+    FibonacciHeapType db_heap;
+    std::unordered_map<int, typename FibonacciHeapType::handle_type>
+        query_heap_handles;
+    std::unordered_map<int, typename FibonacciHeapType::handle_type>
+        db_heap_handles;
+    std::vector<FeatureGeometryMatch> matches;
+  };
+
+  // Enforce 1-to-1 matches between the query and database features of an
+  // image and return the number of spatially verified inliers.
+  int VerifyImage(FeatureMatchesType* query_matches,
+                  FeatureMatchesType* db_matches,
+                  VerificationScratch* scratch) const;
+
+  // Free the visual words or unmap them, if they were mapped from a file.
+  void ReleaseVisualWords();
+
   // Find the nearest neighbor visual words for the given descriptors.
   Eigen::MatrixXi FindWordIds(const DescType& descriptors,
                               int num_neighbors,
                               int num_checks,
-                              int num_threads) const;
+                              int num_threads,
+                              bool use_gpu = false,
+                              int gpu_index = -1) const;
+
+#if defined(COLMAP_CUDA_ENABLED)
+  // Find the exact nearest neighbor visual words on the GPU.
+  Eigen::MatrixXi FindWordIdsCuda(const DescType& descriptors,
+                                  int num_neighbors,
+                                  int gpu_index) const;
+#endif
 
   // The search structure on the quantized descriptor space.
   flann::AutotunedIndex<flann::L2<kDescType>> visual_word_index_;
 
-  // The centroids of the visual words.
+  // The centroids of the visual words, which are either allocated on the heap
+  // or point into the mapped file of the index.
   flann::Matrix<kDescType> visual_words_;
+  MappedFile mapped_file_;
+
+#if defined(COLMAP_CUDA_ENABLED)
+  // The visual words in device memory, which are uploaded on first use.
+  mutable std::mutex cuda_visual_word_index_mutex_;
+  mutable std::unique_ptr<CudaVisualWordIndex> cuda_visual_word_index_;
+#endif
 
   // The inverted index of the database.
   InvertedIndexType inverted_index_;
@@ -196,9 +335,7 @@ VisualIndex<kDescType, kDescDim, kEmbeddingDim>::VisualIndex()
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 VisualIndex<kDescType, kDescDim, kEmbeddingDim>::~VisualIndex() {
-  if (visual_words_.ptr() != nullptr) {
-    delete[] visual_words_.ptr();
-  }
+  ReleaseVisualWords();
 }
 
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
@@ -206,6 +343,14 @@ size_t VisualIndex<kDescType, kDescDim, kEmbeddingDim>::NumVisualWords() const {
   return visual_words_.rows;
 }
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+Eigen::Map<const typename VisualIndex<kDescType, kDescDim, kEmbeddingDim>::
+               DescType>
+VisualIndex<kDescType, kDescDim, kEmbeddingDim>::VisualWords() const {
+  return Eigen::Map<const DescType>(
+      visual_words_.ptr(), visual_words_.rows, kDescDim);
+}
+
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Add(
     const IndexOptions& options,
@@ -230,8 +375,81 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Add(
   const Eigen::MatrixXi word_ids = FindWordIds(descriptors,
                                                options.num_neighbors,
                                                options.num_checks,
-                                               options.num_threads);
+                                               options.num_threads,
+                                               options.use_gpu,
+                                               options.gpu_index);
+
+  AddEntries(options.num_neighbors,
+             image_id,
+             geometries,
+             descriptors,
+             word_ids,
+             /*word_ids_offset=*/0);
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Add(
+    const IndexOptions& options,
+    const std::vector<int>& image_ids,
+    const std::vector<GeomType>& geometries,
+    const std::vector<DescType>& descriptors) {
+  THROW_CHECK_EQ(image_ids.size(), geometries.size());
+  THROW_CHECK_EQ(image_ids.size(), descriptors.size());
+
+  // Select the images that are not yet indexed and stack their descriptors.
+  std::vector<size_t> new_idxs;
+  new_idxs.reserve(image_ids.size());
+  Eigen::Index num_descriptors = 0;
+  for (size_t i = 0; i < image_ids.size(); ++i) {
+    THROW_CHECK_EQ(geometries[i].size(), descriptors[i].rows());
+    if (ImageIndexed(image_ids[i])) {
+      continue;
+    }
+    image_ids_.insert(image_ids[i]);
+    prepared_ = false;
+    new_idxs.push_back(i);
+    num_descriptors += descriptors[i].rows();
+  }
+
+  if (num_descriptors == 0) {
+    return;
+  }
 
+  DescType stacked_descriptors(num_descriptors, kDescDim);
+  Eigen::Index offset = 0;
+  for (const size_t i : new_idxs) {
+    stacked_descriptors.middleRows(offset, descriptors[i].rows()) =
+        descriptors[i];
+    offset += descriptors[i].rows();
+  }
+
+  const Eigen::MatrixXi word_ids = FindWordIds(stacked_descriptors,
+                                               options.num_neighbors,
+                                               options.num_checks,
+                                               options.num_threads,
+                                               options.use_gpu,
+                                               options.gpu_index);
+
+  offset = 0;
+  for (const size_t i : new_idxs) {
+    AddEntries(options.num_neighbors,
+               image_ids[i],
+               geometries[i],
+               descriptors[i],
+               word_ids,
+               offset);
+    offset += descriptors[i].rows();
+  }
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::AddEntries(
+    const int num_neighbors,
+    const int image_id,
+    const GeomType& geometries,
+    const DescType& descriptors,
+    const Eigen::MatrixXi& word_ids,
+    const Eigen::Index word_ids_offset) {
   for (typename DescType::Index i = 0; i < descriptors.rows(); ++i) {
     const auto& descriptor = descriptors.row(i);
 
@@ -241,8 +459,8 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Add(
     geometry.scale = geometries[i].ComputeScale();
     geometry.orientation = geometries[i].ComputeOrientation();
 
-    for (int n = 0; n < options.num_neighbors; ++n) {
-      const int word_id = word_ids(i, n);
+    for (int n = 0; n < num_neighbors; ++n) {
+      const int word_id = word_ids(word_ids_offset + i, n);
       if (word_id != InvertedIndexType::kInvalidWordId) {
         inverted_index_.AddEntry(image_id, word_id, i, descriptor, geometry);
       }
@@ -256,6 +474,12 @@ bool VisualIndex<kDescType, kDescDim, kEmbeddingDim>::ImageIndexed(
   return image_ids_.count(image_id) != 0;
 }
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+const std::unordered_set<int>&
+VisualIndex<kDescType, kDescDim, kEmbeddingDim>::ImageIds() const {
+  return image_ids_;
+}
+
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
     const QueryOptions& options,
@@ -279,6 +503,8 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
   }
 
   THROW_CHECK_EQ(descriptors.rows(), geometries.size());
+  THROW_CHECK(!IsCompact())
+      << "Spatial verification requires an index that is not compact";
 
   // Extract top-ranked images to verify.
   std::unordered_set<int> image_ids;
@@ -286,17 +512,10 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
     image_ids.insert(image_score.image_id);
   }
 
-  // Find matches for top-ranked images
-  typedef std::vector<
-      std::pair<float, std::pair<const EntryType*, const EntryType*>>>
-      OrderedMatchListType;
-
-  // Reference our matches (with their lowest distance) for both
-  // {query feature => db feature} and vice versa.
-  std::unordered_map<int, std::unordered_map<int, OrderedMatchListType>>
-      query_to_db_matches;
-  std::unordered_map<int, std::unordered_map<int, OrderedMatchListType>>
-      db_to_query_matches;
+  // Find matches for top-ranked images. Reference our matches (with their
+  // lowest distance) for both {query feature => db feature} and vice versa.
+  std::unordered_map<int, FeatureMatchesType> query_to_db_matches;
+  std::unordered_map<int, FeatureMatchesType> db_to_query_matches;
 
   std::vector<const EntryType*> word_matches;
 
@@ -374,130 +593,47 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
     }
   }
 
-  // Verify top-ranked images using the found matches.
-  for (auto& image_score : *image_scores) {
-    auto& query_matches = query_to_db_matches[image_score.image_id];
-    auto& db_matches = db_to_query_matches[image_score.image_id];
-
-    // No matches found.
-    if (query_matches.empty()) {
-      continue;
-    }
-
-    // Enforce 1-to-1 matching: Build Fibonacci heaps for the query and database
-    // features, ordered by the minimum number of matches per feature. We'll
-    // select these matches one at a time. For convenience, we'll also pre-sort
-    // the matched feature lists by matching score.
-
-    typedef boost::heap::fibonacci_heap<std::pair<int, int>> FibonacciHeapType;
-    FibonacciHeapType query_heap;
-    FibonacciHeapType db_heap;
-    std::unordered_map<int, typename FibonacciHeapType::handle_type>
-        query_heap_handles;
-    std::unordered_map<int, typename FibonacciHeapType::handle_type>
-        db_heap_handles;
-
-    for (auto& match_data : query_matches) {
-      std::sort(
-          match_data.second.begin(),
-          match_data.second.end(),
-          std::greater<
-              std::pair<float,
-                        std::pair<const EntryType*, const EntryType*>>>());
-
-      query_heap_handles[match_data.first] = query_heap.push(std::make_pair(
-          -static_cast<int>(match_data.second.size()), match_data.first));
-    }
-
-    for (auto& match_data : db_matches) {
-      std::sort(
-          match_data.second.begin(),
-          match_data.second.end(),
-          std::greater<
-              std::pair<float,
-                        std::pair<const EntryType*, const EntryType*>>>());
-
-      db_heap_handles[match_data.first] = db_heap.push(std::make_pair(
-          -static_cast<int>(match_data.second.size()), match_data.first));
-    }
-
-    // Keep tabs on what features have been already matched.
-    std::vector<FeatureGeometryMatch> matches;
-
-    auto db_top = db_heap.top();  // (-num_available_matches, feature_idx)
-    auto query_top = query_heap.top();
-
-    while (!db_heap.empty() && !query_heap.empty()) {
-      // Take the query or database feature with the smallest number of
-      // available matches.
-      const bool use_query =
-          (query_top.first >= db_top.first) && !query_heap.empty();
-
-      // Find the best matching feature that hasn't already been matched.
-      auto& heap1 = (use_query) ? query_heap : db_heap;
-      auto& heap2 = (use_query) ? db_heap : query_heap;
-      auto& handles1 = (use_query) ? query_heap_handles : db_heap_handles;
-      auto& handles2 = (use_query) ? db_heap_handles : query_heap_handles;
-      auto& matches1 = (use_query) ? query_matches : db_matches;
-      auto& matches2 = (use_query) ? db_matches : query_matches;
-
-      const auto idx1 = heap1.top().second;
-      heap1.pop();
-
-      // Entries that have been matched (or processed and subsequently ignored)
-      // get their handles removed.
-      if (handles1.count(idx1) > 0) {
-        handles1.erase(idx1);
-
-        bool match_found = false;
-
-        // The matches have been ordered by Hamming distance, already --
-        // select the lowest available match.
-        for (auto& entry2 : matches1[idx1]) {
-          const auto idx2 = (use_query) ? entry2.second.second->feature_idx
-                                        : entry2.second.first->feature_idx;
-
-          if (handles2.count(idx2) > 0) {
-            if (!match_found) {
-              match_found = true;
-              FeatureGeometryMatch match;
-              match.geometry1 = entry2.second.first->geometry;
-              match.geometry2 = entry2.second.second->geometry;
-              matches.push_back(match);
-
-              handles2.erase(idx2);
-
-              // Remove this feature from consideration for all other features
-              // that matched to it.
-              for (auto& entry1 : matches2[idx2]) {
-                const auto other_idx1 = (use_query)
-                                            ? entry1.second.first->feature_idx
-                                            : entry1.second.second->feature_idx;
-                if (handles1.count(other_idx1) > 0) {
-                  (*handles1[other_idx1]).first += 1;
-                  heap1.increase(handles1[other_idx1]);
-                }
-              }
-            } else {
-              (*handles2[idx2]).first += 1;
-              heap2.increase(handles2[idx2]);
-            }
-          }
-        }
-      }
+  // Verify the top-ranked images in the order of their retrieval scores. The
+  // images are distributed dynamically over the threads, each with its own
+  // scratch buffers, until all or enough images are verified.
+  std::vector<std::pair<FeatureMatchesType*, FeatureMatchesType*>>
+      image_matches;
+  image_matches.reserve(image_scores->size());
+  for (const auto& image_score : *image_scores) {
+    image_matches.emplace_back(&query_to_db_matches[image_score.image_id],
+                               &db_to_query_matches[image_score.image_id]);
+  }
 
-      if (!query_heap.empty()) {
-        query_top = query_heap.top();
+  std::atomic<size_t> next_image_idx(0);
+  std::atomic<int> num_verified_images(0);
+  auto VerifyImages = [&]() {
+    VerificationScratch scratch;
+    while (options.max_num_verified_images <= 0 ||
+           num_verified_images < options.max_num_verified_images) {
+      const size_t image_idx = next_image_idx++;
+      if (image_idx >= image_scores->size()) {
+        break;
       }
-
-      if (!db_heap.empty()) {
-        db_top = db_heap.top();
+      const int num_inliers = VerifyImage(image_matches[image_idx].first,
+                                          image_matches[image_idx].second,
+                                          &scratch);
+      if (num_inliers > 0) {
+        (*image_scores)[image_idx].score += num_inliers;
+        num_verified_images += 1;
       }
     }
+  };
 
-    // Finally, run verification for the current image.
-    VoteAndVerifyOptions vote_and_verify_options;
-    image_score.score += VoteAndVerify(vote_and_verify_options, matches);
+  const int num_threads = std::min<int>(
+      GetEffectiveNumThreads(options.num_threads), image_scores->size());
+  if (num_threads <= 1) {
+    VerifyImages();
+  } else {
+    ThreadPool thread_pool(num_threads);
+    for (int i = 0; i < num_threads; ++i) {
+      thread_pool.AddTask(VerifyImages);
+    }
+    thread_pool.Wait();
   }
 
   // Re-rank the images using the spatial verification scores.
@@ -520,12 +656,170 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Query(
   }
 }
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+int VisualIndex<kDescType, kDescDim, kEmbeddingDim>::VerifyImage(
+    FeatureMatchesType* query_matches_ptr,
+    FeatureMatchesType* db_matches_ptr,
+    VerificationScratch* scratch) const {
+  auto& query_matches = *query_matches_ptr;
+  auto& db_matches = *db_matches_ptr;
+
+  // No matches found.
+  if (query_matches.empty()) {
+    return 0;
+  }
+
+  // Enforce 1-to-1 matching: Build Fibonacci heaps for the query and database
+  // features, ordered by the minimum number of matches per feature. We'll
+  // select these matches one at a time. For convenience, we'll also pre-sort
+  // the matched feature lists by matching score.
+
+  auto& query_heap = scratch->query_heap;
+  auto& db_heap = scratch->db_heap;
+  auto& query_heap_handles = scratch->query_heap_handles;
+  auto& db_heap_handles = scratch->db_heap_handles;
+  query_heap.clear();
+  db_heap.clear();
+  query_heap_handles.clear();
+  db_heap_handles.clear();
+
+  for (auto& match_data : query_matches) {
+    std::sort(
+        match_data.second.begin(),
+        match_data.second.end(),
+        std::greater<
+            std::pair<float,
+                      std::pair<const EntryType*, const EntryType*>>>());
+
+    query_heap_handles[match_data.first] = query_heap.push(std::make_pair(
+        -static_cast<int>(match_data.second.size()), match_data.first));
+  }
+
+  for (auto& match_data : db_matches) {
+    std::sort(
+        match_data.second.begin(),
+        match_data.second.end(),
+        std::greater<
+            std::pair<float,
+                      std::pair<const EntryType*, const EntryType*>>>());
+
+    db_heap_handles[match_data.first] = db_heap.push(std::make_pair(
+        -static_cast<int>(match_data.second.size()), match_data.first));
+  }
+
+  // Keep tabs on what features have been already matched.
+  auto& matches = scratch->matches;
+  matches.clear();
+
+  auto db_top = db_heap.top();  // (-num_available_matches, feature_idx)
+  auto query_top = query_heap.top();
+
+  while (!db_heap.empty() && !query_heap.empty()) {
+    // Take the query or database feature with the smallest number of
+    // available matches.
+    const bool use_query =
+        (query_top.first >= db_top.first) && !query_heap.empty();
+
+    // Find the best matching feature that hasn't already been matched.
+    auto& heap1 = (use_query) ? query_heap : db_heap;
+    auto& heap2 = (use_query) ? db_heap : query_heap;
+    auto& handles1 = (use_query) ? query_heap_handles : db_heap_handles;
+    auto& handles2 = (use_query) ? db_heap_handles : query_heap_handles;
+    auto& matches1 = (use_query) ? query_matches : db_matches;
+    auto& matches2 = (use_query) ? db_matches : query_matches;
+
+    const auto idx1 = heap1.top().second;
+    heap1.pop();
+
+    // Entries that have been matched (or processed and subsequently ignored)
+    // get their handles removed.
+    if (handles1.count(idx1) > 0) {
+      handles1.erase(idx1);
+
+      bool match_found = false;
+
+      // The matches have been ordered by Hamming distance, already --
+      // select the lowest available match.
+      for (auto& entry2 : matches1[idx1]) {
+        const auto idx2 = (use_query) ? entry2.second.second->feature_idx
+                                      : entry2.second.first->feature_idx;
+
+        if (handles2.count(idx2) > 0) {
+          if (!match_found) {
+            match_found = true;
+            FeatureGeometryMatch match;
+            match.geometry1 = entry2.second.first->geometry;
+            match.geometry2 = entry2.second.second->geometry;
+            matches.push_back(match);
+
+            handles2.erase(idx2);
+
+            // Remove this feature from consideration for all other features
+            // that matched to it.
+            for (auto& entry1 : matches2[idx2]) {
+              const auto other_idx1 = (use_query)
+                                          ? entry1.second.first->feature_idx
+                                          : entry1.second.second->feature_idx;
+              if (handles1.count(other_idx1) > 0) {
+                (*handles1[other_idx1]).first += 1;
+                heap1.increase(handles1[other_idx1]);
+              }
+            }
+          } else {
+            (*handles2[idx2]).first += 1;
+            heap2.increase(handles2[idx2]);
+          }
+        }
+      }
+    }
+
+    if (!query_heap.empty()) {
+      query_top = query_heap.top();
+    }
+
+    if (!db_heap.empty()) {
+      db_top = db_heap.top();
+    }
+  }
+
+  // Finally, run verification for the current image.
+  VoteAndVerifyOptions vote_and_verify_options;
+  return VoteAndVerify(vote_and_verify_options, matches);
+}
+
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Prepare() {
+  Prepare(PrepareOptions());
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Prepare(
+    const PrepareOptions& options) {
+  THROW_CHECK_GT(options.max_document_frequency, 0);
   inverted_index_.Finalize();
+  if (options.max_document_frequency < 1.0) {
+    const int num_stop_words =
+        inverted_index_.PruneStopWords(options.max_document_frequency);
+    VLOG(2) << "Pruned " << num_stop_words << " stop words";
+  }
+  if (options.compact) {
+    inverted_index_.Compact();
+  }
   prepared_ = true;
 }
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+bool VisualIndex<kDescType, kDescDim, kEmbeddingDim>::IsCompact() const {
+  return inverted_index_.IsCompact();
+}
+
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+size_t VisualIndex<kDescType, kDescDim, kEmbeddingDim>::NumBytes() const {
+  return inverted_index_.NumBytes() +
+         visual_words_.rows * visual_words_.cols * sizeof(kDescType) +
+         image_ids_.size() * sizeof(int);
+}
+
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Build(
     const BuildOptions& options, const DescType& descriptors) {
@@ -549,8 +843,12 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Build(
 
   // Learn the Hamming embedding.
   const int kNumNeighbors = 1;
-  const Eigen::MatrixXi word_ids = FindWordIds(
-      descriptors, kNumNeighbors, options.num_checks, options.num_threads);
+  const Eigen::MatrixXi word_ids = FindWordIds(descriptors,
+                                               kNumNeighbors,
+                                               options.num_checks,
+                                               options.num_threads,
+                                               options.use_gpu,
+                                               options.gpu_index);
   inverted_index_.ComputeHammingEmbedding(descriptors, word_ids);
 }
 
@@ -562,20 +860,40 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Read(
   // Read the visual words.
 
   {
-    if (visual_words_.ptr() != nullptr) {
-      delete[] visual_words_.ptr();
-    }
-
-    std::ifstream file(path, std::ios::binary);
-    THROW_CHECK_FILE_OPEN(file, path);
-    const uint64_t rows = ReadBinaryLittleEndian<uint64_t>(&file);
-    const uint64_t cols = ReadBinaryLittleEndian<uint64_t>(&file);
-    kDescType* visual_words_data = new kDescType[rows * cols];
-    for (size_t i = 0; i < rows * cols; ++i) {
-      visual_words_data[i] = ReadBinaryLittleEndian<kDescType>(&file);
+    ReleaseVisualWords();
+
+    MappedFile mapped_file(path);
+    uint64_t header[2];
+    THROW_CHECK_GE(mapped_file.Size(), sizeof(header))
+        << "Invalid visual index " << path;
+    std::memcpy(header, mapped_file.Data(), sizeof(header));
+    const uint64_t rows = LittleEndianToNative(header[0]);
+    const uint64_t cols = LittleEndianToNative(header[1]);
+    const size_t visual_words_end =
+        sizeof(header) + rows * cols * sizeof(kDescType);
+    THROW_CHECK_LE(visual_words_end, mapped_file.Size())
+        << "Invalid visual index " << path;
+    file_offset = visual_words_end;
+
+    const uint8_t* visual_words_data = mapped_file.Data() + sizeof(header);
+    if (IsLittleEndian()) {
+      // Only the pages of the visual words that are accessed by the search
+      // index are read from disk.
+      mapped_file_ = std::move(mapped_file);
+      visual_words_ = flann::Matrix<kDescType>(
+          reinterpret_cast<kDescType*>(const_cast<uint8_t*>(visual_words_data)),
+          rows,
+          cols);
+    } else {
+      kDescType* visual_words_copy = new kDescType[rows * cols];
+      std::memcpy(visual_words_copy,
+                  visual_words_data,
+                  rows * cols * sizeof(kDescType));
+      for (size_t i = 0; i < rows * cols; ++i) {
+        visual_words_copy[i] = LittleEndianToNative(visual_words_copy[i]);
+      }
+      visual_words_ = flann::Matrix<kDescType>(visual_words_copy, rows, cols);
     }
-    visual_words_ = flann::Matrix<kDescType>(visual_words_data, rows, cols);
-    file_offset = file.tellg();
   }
 
   // Read the visual words search index.
@@ -657,6 +975,35 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Quantize(
   THROW_CHECK_GE(options.num_visual_words, options.branching);
   THROW_CHECK_GE(descriptors.rows(), options.num_visual_words);
 
+  if (options.mini_batch_size > 0) {
+    HierarchicalKMeansOptions kmeans_options;
+    kmeans_options.num_clusters = options.num_visual_words;
+    kmeans_options.branching = options.branching;
+    kmeans_options.mini_batch_size = options.mini_batch_size;
+    kmeans_options.num_mini_batch_iterations =
+        options.num_mini_batch_iterations;
+    kmeans_options.num_iterations = options.num_iterations;
+    kmeans_options.num_threads = options.num_threads;
+    kmeans_options.use_gpu = options.use_gpu;
+    kmeans_options.gpu_index = options.gpu_index;
+    const auto centers = HierarchicalKMeans(kmeans_options, descriptors);
+
+    kDescType* visual_words_data = new kDescType[centers.size()];
+    for (Eigen::Index i = 0; i < centers.size(); ++i) {
+      if (std::is_integral<kDescType>::value) {
+        visual_words_data[i] = std::round(centers.data()[i]);
+      } else {
+        visual_words_data[i] = centers.data()[i];
+      }
+    }
+
+    ReleaseVisualWords();
+
+    visual_words_ = flann::Matrix<kDescType>(
+        visual_words_data, centers.rows(), descriptors.cols());
+    return;
+  }
+
   const flann::Matrix<kDescType> descriptor_matrix(
       const_cast<kDescType*>(descriptors.data()),
       descriptors.rows(),
@@ -687,14 +1034,24 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::Quantize(
     }
   }
 
-  if (visual_words_.ptr() != nullptr) {
-    delete[] visual_words_.ptr();
-  }
+  ReleaseVisualWords();
 
   visual_words_ = flann::Matrix<kDescType>(
       visual_words_data, num_centers, descriptors.cols());
 }
 
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::ReleaseVisualWords() {
+  if (visual_words_.ptr() != nullptr && !mapped_file_.IsOpen()) {
+    delete[] visual_words_.ptr();
+  }
+  visual_words_ = flann::Matrix<kDescType>();
+#if defined(COLMAP_CUDA_ENABLED)
+  cuda_visual_word_index_.reset();
+#endif
+  mapped_file_.Close();
+}
+
 template <typename kDescType, int kDescDim, int kEmbeddingDim>
 void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::QueryAndFindWordIds(
     const QueryOptions& options,
@@ -711,7 +1068,9 @@ void VisualIndex<kDescType, kDescDim, kEmbeddingDim>::QueryAndFindWordIds(
   *word_ids = FindWordIds(descriptors,
                           options.num_neighbors,
                           options.num_checks,
-                          options.num_threads);
+                          options.num_threads,
+                          options.use_gpu,
+                          options.gpu_index);
   inverted_index_.Query(descriptors, *word_ids, image_scores);
 
   auto SortFunc = [](const ImageScore& score1, const ImageScore& score2) {
@@ -739,12 +1098,22 @@ Eigen::MatrixXi VisualIndex<kDescType, kDescDim, kEmbeddingDim>::FindWordIds(
     const DescType& descriptors,
     const int num_neighbors,
     const int num_checks,
-    const int num_threads) const {
+    const int num_threads,
+    const bool use_gpu,
+    const int gpu_index) const {
   static_assert(DescType::IsRowMajor, "Descriptors must be row-major");
 
   THROW_CHECK_GT(descriptors.rows(), 0);
   THROW_CHECK_GT(num_neighbors, 0);
 
+  if (use_gpu) {
+#if defined(COLMAP_CUDA_ENABLED)
+    return FindWordIdsCuda(descriptors, num_neighbors, gpu_index);
+#else
+    LOG(FATAL_THROW) << "Visual word search on the GPU requires CUDA support";
+#endif
+  }
+
   Eigen::Matrix<size_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
       word_ids(descriptors.rows(), num_neighbors);
   word_ids.setConstant(InvertedIndexType::kInvalidWordId);
@@ -780,5 +1149,48 @@ Eigen::MatrixXi VisualIndex<kDescType, kDescDim, kEmbeddingDim>::FindWordIds(
   return word_ids.cast<int>();
 }
 
+#if defined(COLMAP_CUDA_ENABLED)
+template <typename kDescType, int kDescDim, int kEmbeddingDim>
+Eigen::MatrixXi
+VisualIndex<kDescType, kDescDim, kEmbeddingDim>::FindWordIdsCuda(
+    const DescType& descriptors,
+    const int num_neighbors,
+    const int gpu_index) const {
+  typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      FloatDescType;
+
+  const CudaVisualWordIndex* cuda_visual_word_index = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(cuda_visual_word_index_mutex_);
+    if (cuda_visual_word_index_ == nullptr ||
+        cuda_visual_word_index_->GpuIndex() != gpu_index) {
+      const FloatDescType visual_words =
+          Eigen::Map<const DescType>(
+              visual_words_.ptr(), visual_words_.rows, kDescDim)
+              .template cast<float>();
+      cuda_visual_word_index_ =
+          std::make_unique<CudaVisualWordIndex>(gpu_index,
+                                                visual_words.data(),
+                                                visual_words.rows(),
+                                                visual_words.cols());
+    }
+    cuda_visual_word_index = cuda_visual_word_index_.get();
+  }
+
+  const FloatDescType query = descriptors.template cast<float>();
+  Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> word_ids(
+      descriptors.rows(), num_neighbors);
+  cuda_visual_word_index->Search(
+      query.data(), query.rows(), num_neighbors, word_ids.data());
+  for (Eigen::Index i = 0; i < word_ids.size(); ++i) {
+    if (word_ids.data()[i] < 0) {
+      word_ids.data()[i] = InvertedIndexType::kInvalidWordId;
+    }
+  }
+
+  return word_ids;
+}
+#endif
+
 }  // namespace retrieval
 }  // namespace colmap
@@ -29,6 +29,8 @@
 
 #include "colmap/retrieval/visual_index.h"
 
+#include "colmap/util/testing.h"
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -58,6 +60,19 @@ void TestVocabTreeType() {
     EXPECT_EQ(visual_index.NumVisualWords(), 5);
   }
 
+  {
+    typename VisualIndexType::DescType descriptors =
+        VisualIndexType::DescType::Random(1000, kDescDim);
+    VisualIndexType visual_index;
+    typename VisualIndexType::BuildOptions build_options;
+    build_options.num_visual_words = 100;
+    build_options.branching = 10;
+    build_options.mini_batch_size = 200;
+    visual_index.Build(build_options, descriptors);
+    EXPECT_GT(visual_index.NumVisualWords(), 10);
+    EXPECT_LE(visual_index.NumVisualWords(), 100);
+  }
+
   {
     typename VisualIndexType::DescType descriptors =
         VisualIndexType::DescType::Random(1000, kDescDim);
@@ -99,6 +114,138 @@ void TestVocabTreeType() {
     EXPECT_EQ(image_scores[0].image_id, 1);
     EXPECT_EQ(image_scores[1].image_id, 2);
     EXPECT_GT(image_scores[0].score, image_scores[1].score);
+
+    // Spatial verification gives the same result with multiple threads.
+    {
+      typename VisualIndexType::QueryOptions verification_options;
+      verification_options.num_images_after_verification = 2;
+      verification_options.num_threads = 1;
+      std::vector<ImageScore> verified_image_scores1;
+      visual_index.Query(verification_options,
+                         keypoints1,
+                         descriptors1,
+                         &verified_image_scores1);
+      verification_options.num_threads = 4;
+      std::vector<ImageScore> verified_image_scores2;
+      visual_index.Query(verification_options,
+                         keypoints1,
+                         descriptors1,
+                         &verified_image_scores2);
+      ASSERT_EQ(verified_image_scores1.size(), 2);
+      ASSERT_EQ(verified_image_scores2.size(), 2);
+      EXPECT_EQ(verified_image_scores1[0].image_id, 1);
+      for (size_t i = 0; i < verified_image_scores1.size(); ++i) {
+        EXPECT_EQ(verified_image_scores1[i].image_id,
+                  verified_image_scores2[i].image_id);
+        EXPECT_EQ(verified_image_scores1[i].score,
+                  verified_image_scores2[i].score);
+      }
+
+      // Stopping after the first verified image keeps the retrieval score of
+      // the second image.
+      verification_options.num_threads = 1;
+      verification_options.max_num_verified_images = 1;
+      std::vector<ImageScore> verified_image_scores3;
+      visual_index.Query(verification_options,
+                         keypoints1,
+                         descriptors1,
+                         &verified_image_scores3);
+      ASSERT_EQ(verified_image_scores3.size(), 2);
+      EXPECT_EQ(verified_image_scores3[0].image_id, 1);
+      EXPECT_EQ(verified_image_scores3[0].score,
+                verified_image_scores1[0].score);
+      EXPECT_EQ(verified_image_scores3[1].score, image_scores[1].score);
+    }
+
+    const std::string index_path = CreateTestDir() + "/visual_index.bin";
+    visual_index.Write(index_path);
+    VisualIndexType read_visual_index;
+    read_visual_index.Read(index_path);
+    EXPECT_EQ(read_visual_index.NumVisualWords(), 100);
+    read_visual_index.Prepare();
+    std::vector<ImageScore> read_image_scores;
+    read_visual_index.Query(query_options, descriptors1, &read_image_scores);
+    ASSERT_EQ(read_image_scores.size(), image_scores.size());
+    for (size_t i = 0; i < image_scores.size(); ++i) {
+      EXPECT_EQ(read_image_scores[i].image_id, image_scores[i].image_id);
+      EXPECT_EQ(read_image_scores[i].score, image_scores[i].score);
+    }
+
+    // Reading another index replaces the mapped visual words.
+    read_visual_index.Read(index_path);
+    EXPECT_EQ(read_visual_index.NumVisualWords(), 100);
+
+    // Adding images in a batch is equivalent to adding them one by one.
+    VisualIndexType batch_visual_index;
+    batch_visual_index.Read(index_path);
+    batch_visual_index.Add(index_options,
+                           {1, 2, 3},
+                           {keypoints1, keypoints2, {}},
+                           {descriptors1, descriptors2, {}});
+    EXPECT_TRUE(batch_visual_index.ImageIndexed(3));
+    batch_visual_index.Prepare();
+    std::vector<ImageScore> batch_image_scores;
+    batch_visual_index.Query(query_options, descriptors1, &batch_image_scores);
+    ASSERT_EQ(batch_image_scores.size(), image_scores.size());
+    for (size_t i = 0; i < image_scores.size(); ++i) {
+      EXPECT_EQ(batch_image_scores[i].image_id, image_scores[i].image_id);
+      EXPECT_EQ(batch_image_scores[i].score, image_scores[i].score);
+    }
+
+    // A compact index gives the same scores with less memory and can be
+    // extended with new images, but not spatially verified.
+    VisualIndexType compact_visual_index;
+    compact_visual_index.Read(index_path);
+    EXPECT_FALSE(compact_visual_index.IsCompact());
+    const size_t num_bytes = compact_visual_index.NumBytes();
+    typename VisualIndexType::PrepareOptions prepare_options;
+    prepare_options.compact = true;
+    compact_visual_index.Prepare(prepare_options);
+    EXPECT_TRUE(compact_visual_index.IsCompact());
+    EXPECT_LT(compact_visual_index.NumBytes(), num_bytes);
+    std::vector<ImageScore> compact_image_scores;
+    compact_visual_index.Query(
+        query_options, descriptors1, &compact_image_scores);
+    ASSERT_EQ(compact_image_scores.size(), image_scores.size());
+    for (size_t i = 0; i < image_scores.size(); ++i) {
+      EXPECT_EQ(compact_image_scores[i].image_id, image_scores[i].image_id);
+      EXPECT_EQ(compact_image_scores[i].score, image_scores[i].score);
+    }
+    typename VisualIndexType::QueryOptions verification_options;
+    verification_options.num_images_after_verification = 2;
+    EXPECT_ANY_THROW(compact_visual_index.Query(verification_options,
+                                                keypoints1,
+                                                descriptors1,
+                                                &compact_image_scores));
+
+    const std::string compact_index_path =
+        CreateTestDir() + "/compact_visual_index.bin";
+    compact_visual_index.Write(compact_index_path);
+    VisualIndexType read_compact_visual_index;
+    read_compact_visual_index.Read(compact_index_path);
+    EXPECT_TRUE(read_compact_visual_index.IsCompact());
+    EXPECT_TRUE(read_compact_visual_index.ImageIndexed(1));
+    EXPECT_TRUE(read_compact_visual_index.ImageIndexed(2));
+    typename VisualIndexType::GeomType keypoints3(50);
+    typename VisualIndexType::DescType descriptors3 =
+        VisualIndexType::DescType::Random(50, kDescDim);
+    read_compact_visual_index.Add(index_options, 3, keypoints3, descriptors3);
+    read_compact_visual_index.Prepare(prepare_options);
+    read_compact_visual_index.Query(
+        query_options, descriptors3, &compact_image_scores);
+    ASSERT_EQ(compact_image_scores.size(), 3);
+    EXPECT_EQ(compact_image_scores[0].image_id, 3);
+
+    // Pruning all visual words as stop words leaves no scores.
+    VisualIndexType pruned_visual_index;
+    pruned_visual_index.Read(index_path);
+    typename VisualIndexType::PrepareOptions pruned_prepare_options;
+    pruned_prepare_options.max_document_frequency = 0.1;
+    pruned_visual_index.Prepare(pruned_prepare_options);
+    std::vector<ImageScore> pruned_image_scores;
+    pruned_visual_index.Query(
+        query_options, descriptors1, &pruned_image_scores);
+    EXPECT_TRUE(pruned_image_scores.empty());
   }
 }
 
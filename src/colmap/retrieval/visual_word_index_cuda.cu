@@ -0,0 +1,218 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/retrieval/visual_word_index_cuda.h"
+
+#include "colmap/util/cuda.h"
+#include "colmap/util/cudacc.h"
+#include "colmap/util/logging.h"
+
+#include <cfloat>
+#include <vector>
+
+#include <cuda_runtime.h>
+
+namespace colmap {
+namespace retrieval {
+namespace {
+
+const int kThreadsPerBlock = 128;
+
+// Insert the neighbor into the list of nearest neighbors sorted by increasing
+// distance, if it is closer than the farthest neighbor.
+__device__ void InsertNeighbor(const float dist,
+                               const int word_id,
+                               const int num_neighbors,
+                               float* dists,
+                               int* word_ids) {
+  if (dist >= dists[num_neighbors - 1]) {
+    return;
+  }
+  int i = num_neighbors - 1;
+  for (; i > 0 && dists[i - 1] > dist; --i) {
+    dists[i] = dists[i - 1];
+    word_ids[i] = word_ids[i - 1];
+  }
+  dists[i] = dist;
+  word_ids[i] = word_id;
+}
+
+// Each block searches the nearest visual words of one descriptor. The threads
+// of a block scan interleaved visual words and keep their own nearest
+// neighbors, which are merged by the first thread at the end.
+__global__ void FindNearestVisualWordsKernel(const float* visual_words,
+                                             const int num_visual_words,
+                                             const int dim,
+                                             const float* descriptors,
+                                             const int num_neighbors,
+                                             int* word_ids) {
+  extern __shared__ float shared_memory[];
+  float* descriptor = shared_memory;
+  float* block_dists = descriptor + dim;
+  int* block_word_ids =
+      reinterpret_cast<int*>(block_dists + kThreadsPerBlock * num_neighbors);
+
+  const size_t descriptor_idx = blockIdx.x;
+  for (int d = threadIdx.x; d < dim; d += blockDim.x) {
+    descriptor[d] = descriptors[descriptor_idx * dim + d];
+  }
+  __syncthreads();
+
+  float dists[CudaVisualWordIndex::kMaxNumNeighbors];
+  int nearest_word_ids[CudaVisualWordIndex::kMaxNumNeighbors];
+  for (int n = 0; n < num_neighbors; ++n) {
+    dists[n] = FLT_MAX;
+    nearest_word_ids[n] = -1;
+  }
+
+  for (int word_id = threadIdx.x; word_id < num_visual_words;
+       word_id += blockDim.x) {
+    float dist = 0;
+    for (int d = 0; d < dim; ++d) {
+      const float diff =
+          visual_words[static_cast<size_t>(d) * num_visual_words + word_id] -
+          descriptor[d];
+      dist += diff * diff;
+    }
+    InsertNeighbor(dist, word_id, num_neighbors, dists, nearest_word_ids);
+  }
+
+  for (int n = 0; n < num_neighbors; ++n) {
+    block_dists[threadIdx.x * num_neighbors + n] = dists[n];
+    block_word_ids[threadIdx.x * num_neighbors + n] = nearest_word_ids[n];
+  }
+  __syncthreads();
+
+  if (threadIdx.x != 0) {
+    return;
+  }
+
+  for (int i = num_neighbors; i < blockDim.x * num_neighbors; ++i) {
+    if (block_word_ids[i] >= 0) {
+      InsertNeighbor(block_dists[i],
+                     block_word_ids[i],
+                     num_neighbors,
+                     dists,
+                     nearest_word_ids);
+    }
+  }
+
+  for (int n = 0; n < num_neighbors; ++n) {
+    word_ids[descriptor_idx * num_neighbors + n] = nearest_word_ids[n];
+  }
+}
+
+}  // namespace
+
+CudaVisualWordIndex::CudaVisualWordIndex(const int gpu_index,
+                                         const float* visual_words,
+                                         const int num_visual_words,
+                                         const int dim)
+    : gpu_index_(gpu_index),
+      num_visual_words_(num_visual_words),
+      dim_(dim),
+      device_id_(-1),
+      visual_words_d_(nullptr) {
+  THROW_CHECK_GT(num_visual_words_, 0);
+  THROW_CHECK_GT(dim_, 0);
+
+  SetBestCudaDevice(gpu_index_);
+  CUDA_SAFE_CALL(cudaGetDevice(&device_id_));
+
+  std::vector<float> transposed_visual_words(
+      static_cast<size_t>(num_visual_words_) * dim_);
+  for (int i = 0; i < num_visual_words_; ++i) {
+    for (int d = 0; d < dim_; ++d) {
+      transposed_visual_words[static_cast<size_t>(d) * num_visual_words_ + i] =
+          visual_words[static_cast<size_t>(i) * dim_ + d];
+    }
+  }
+
+  const size_t num_bytes = transposed_visual_words.size() * sizeof(float);
+  CUDA_SAFE_CALL(cudaMalloc(&visual_words_d_, num_bytes));
+  CUDA_SAFE_CALL(cudaMemcpy(visual_words_d_,
+                            transposed_visual_words.data(),
+                            num_bytes,
+                            cudaMemcpyHostToDevice));
+}
+
+CudaVisualWordIndex::~CudaVisualWordIndex() {
+  cudaSetDevice(device_id_);
+  cudaFree(visual_words_d_);
+}
+
+int CudaVisualWordIndex::GpuIndex() const { return gpu_index_; }
+
+void CudaVisualWordIndex::Search(const float* descriptors,
+                                 const int num_descriptors,
+                                 const int num_neighbors,
+                                 int* word_ids) const {
+  THROW_CHECK_GT(num_neighbors, 0);
+  THROW_CHECK_LE(num_neighbors, kMaxNumNeighbors);
+  if (num_descriptors == 0) {
+    return;
+  }
+
+  CUDA_SAFE_CALL(cudaSetDevice(device_id_));
+
+  const size_t descriptors_num_bytes =
+      static_cast<size_t>(num_descriptors) * dim_ * sizeof(float);
+  const size_t word_ids_num_bytes =
+      static_cast<size_t>(num_descriptors) * num_neighbors * sizeof(int);
+
+  float* descriptors_d = nullptr;
+  int* word_ids_d = nullptr;
+  CUDA_SAFE_CALL(cudaMalloc(&descriptors_d, descriptors_num_bytes));
+  CUDA_SAFE_CALL(cudaMalloc(&word_ids_d, word_ids_num_bytes));
+  CUDA_SAFE_CALL(cudaMemcpy(descriptors_d,
+                            descriptors,
+                            descriptors_num_bytes,
+                            cudaMemcpyHostToDevice));
+
+  const size_t shared_memory_num_bytes =
+      dim_ * sizeof(float) +
+      kThreadsPerBlock * num_neighbors * (sizeof(float) + sizeof(int));
+  FindNearestVisualWordsKernel<<<num_descriptors,
+                                 kThreadsPerBlock,
+                                 shared_memory_num_bytes>>>(visual_words_d_,
+                                                            num_visual_words_,
+                                                            dim_,
+                                                            descriptors_d,
+                                                            num_neighbors,
+                                                            word_ids_d);
+  CUDA_SYNC_AND_CHECK();
+
+  CUDA_SAFE_CALL(cudaMemcpy(
+      word_ids, word_ids_d, word_ids_num_bytes, cudaMemcpyDeviceToHost));
+  CUDA_SAFE_CALL(cudaFree(descriptors_d));
+  CUDA_SAFE_CALL(cudaFree(word_ids_d));
+}
+
+}  // namespace retrieval
+}  // namespace colmap
@@ -0,0 +1,75 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+namespace colmap {
+namespace retrieval {
+
+// Exact nearest neighbor search of visual words on the GPU. The visual words
+// are uploaded once and stay resident in device memory for all searches.
+class CudaVisualWordIndex {
+ public:
+  // The maximum number of nearest neighbors supported by the search.
+  static const int kMaxNumNeighbors = 32;
+
+  // The visual words are given as a row-major matrix of single precision
+  // descriptors. The GPU is selected as in SetBestCudaDevice.
+  CudaVisualWordIndex(int gpu_index,
+                      const float* visual_words,
+                      int num_visual_words,
+                      int dim);
+  ~CudaVisualWordIndex();
+
+  CudaVisualWordIndex(const CudaVisualWordIndex&) = delete;
+  CudaVisualWordIndex& operator=(const CudaVisualWordIndex&) = delete;
+
+  int GpuIndex() const;
+
+  // Find the nearest visual words of the row-major descriptors and write
+  // their identifiers in row-major order of increasing distance to word_ids.
+  // If there are fewer visual words than neighbors, the remaining
+  // identifiers are set to -1. This function is thread-safe.
+  void Search(const float* descriptors,
+              int num_descriptors,
+              int num_neighbors,
+              int* word_ids) const;
+
+ private:
+  const int gpu_index_;
+  const int num_visual_words_;
+  const int dim_;
+  int device_id_;
+  // The visual words in column-major order, such that neighboring threads
+  // read neighboring visual words in coalesced memory transactions.
+  float* visual_words_d_;
+};
+
+}  // namespace retrieval
+}  // namespace colmap
@@ -0,0 +1,93 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/retrieval/visual_word_index_cuda.h"
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include <Eigen/Core>
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace retrieval {
+namespace {
+
+typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+    FloatMatrix;
+
+TEST(CudaVisualWordIndex, Search) {
+  const int kNumVisualWords = 1000;
+  const int kDim = 32;
+  const int kNumDescriptors = 100;
+  const int kNumNeighbors = 5;
+
+  const FloatMatrix visual_words = FloatMatrix::Random(kNumVisualWords, kDim);
+  const FloatMatrix descriptors = FloatMatrix::Random(kNumDescriptors, kDim);
+
+  CudaVisualWordIndex index(
+      /*gpu_index=*/-1, visual_words.data(), kNumVisualWords, kDim);
+  EXPECT_EQ(index.GpuIndex(), -1);
+
+  std::vector<int> word_ids(kNumDescriptors * kNumNeighbors);
+  index.Search(
+      descriptors.data(), kNumDescriptors, kNumNeighbors, word_ids.data());
+
+  for (int i = 0; i < kNumDescriptors; ++i) {
+    const Eigen::VectorXf dists =
+        (visual_words.rowwise() - descriptors.row(i)).rowwise().squaredNorm();
+    std::vector<int> expected_word_ids(kNumVisualWords);
+    std::iota(expected_word_ids.begin(), expected_word_ids.end(), 0);
+    std::partial_sort(expected_word_ids.begin(),
+                      expected_word_ids.begin() + kNumNeighbors,
+                      expected_word_ids.end(),
+                      [&dists](const int word_id1, const int word_id2) {
+                        return dists(word_id1) < dists(word_id2);
+                      });
+    for (int n = 0; n < kNumNeighbors; ++n) {
+      EXPECT_EQ(word_ids[i * kNumNeighbors + n], expected_word_ids[n]);
+    }
+  }
+}
+
+TEST(CudaVisualWordIndex, FewerVisualWordsThanNeighbors) {
+  const FloatMatrix visual_words = FloatMatrix::Random(2, 8);
+  CudaVisualWordIndex index(
+      /*gpu_index=*/-1, visual_words.data(), visual_words.rows(), 8);
+  std::vector<int> word_ids(3);
+  index.Search(visual_words.data(), 1, 3, word_ids.data());
+  EXPECT_EQ(word_ids[0], 0);
+  EXPECT_EQ(word_ids[1], 1);
+  EXPECT_EQ(word_ids[2], -1);
+}
+
+}  // namespace
+}  // namespace retrieval
+}  // namespace colmap
@@ -33,6 +33,8 @@
 #include "colmap/util/logging.h"
 #include "colmap/util/misc.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iomanip>
 
 namespace colmap {
@@ -152,4 +154,68 @@ void Camera::Rescale(const size_t new_width, const size_t new_height) {
   }
 }
 
+void Camera::ComputeUndistortionGrid(const double spacing) {
+  THROW_CHECK_GT(spacing, 0);
+  THROW_CHECK_GT(width, 0);
+  THROW_CHECK_GT(height, 0);
+
+  auto grid = std::make_shared<UndistortionGrid>();
+  grid->model_id = model_id;
+  grid->params = params;
+  grid->num_cols = std::max<size_t>(2, std::ceil(width / spacing) + 1);
+  grid->num_rows = std::max<size_t>(2, std::ceil(height / spacing) + 1);
+  grid->step_x = static_cast<double>(width) / (grid->num_cols - 1);
+  grid->step_y = static_cast<double>(height) / (grid->num_rows - 1);
+  grid->cam_points.reserve(grid->num_cols * grid->num_rows);
+  for (size_t row = 0; row < grid->num_rows; ++row) {
+    for (size_t col = 0; col < grid->num_cols; ++col) {
+      grid->cam_points.push_back(
+          CameraModelCamFromImg(
+              model_id,
+              params,
+              Eigen::Vector2d(col * grid->step_x, row * grid->step_y))
+              .hnormalized());
+    }
+  }
+
+  undistortion_grid = std::move(grid);
+}
+
+bool Camera::CamFromImgWithUndistortionGrid(const Eigen::Vector2d& image_point,
+                                            Eigen::Vector2d* cam_point) const {
+  const UndistortionGrid& grid = *undistortion_grid;
+  if (grid.model_id != model_id || grid.params != params) {
+    return false;
+  }
+
+  const double grid_x = image_point.x() / grid.step_x;
+  const double grid_y = image_point.y() / grid.step_y;
+  // Negated comparisons to also reject NaN coordinates.
+  if (!(grid_x >= 0 && grid_x <= grid.num_cols - 1 && grid_y >= 0 &&
+        grid_y <= grid.num_rows - 1)) {
+    return false;
+  }
+
+  const size_t col = std::min(static_cast<size_t>(grid_x), grid.num_cols - 2);
+  const size_t row = std::min(static_cast<size_t>(grid_y), grid.num_rows - 2);
+  const double weight_x = grid_x - col;
+  const double weight_y = grid_y - row;
+  const Eigen::Vector2d* cam_points =
+      &grid.cam_points[row * grid.num_cols + col];
+  const Eigen::Vector2d uv =
+      (1 - weight_y) * ((1 - weight_x) * cam_points[0] +
+                        weight_x * cam_points[1]) +
+      weight_y * ((1 - weight_x) * cam_points[grid.num_cols] +
+                  weight_x * cam_points[grid.num_cols + 1]);
+  // The undistortion may not converge for grid points in strongly distorted
+  // image regions, in which case we fall back to the regular undistortion.
+  if (!uv.allFinite()) {
+    return false;
+  }
+
+  *cam_point =
+      CameraModelCamFromImg(model_id, params, image_point, uv).hnormalized();
+  return true;
+}
+
 }  // namespace colmap
@@ -34,6 +34,7 @@
 #include "colmap/util/logging.h"
 #include "colmap/util/types.h"
 
+#include <memory>
 #include <vector>
 
 #include <Eigen/Geometry>
@@ -63,6 +64,23 @@ struct Camera {
   // e.g. manually provided or extracted from EXIF
   bool has_prior_focal_length = false;
 
+  // Undistorted camera coordinates precomputed on a regular grid over the
+  // image, see `ComputeUndistortionGrid`. The grid is immutable and shared
+  // between copies of the camera, so it can be used concurrently.
+  struct UndistortionGrid {
+    // The camera model and parameters, for which the grid was computed.
+    CameraModelId model_id = CameraModelId::kInvalid;
+    std::vector<double> params;
+    // Number of grid points and spacing between them in pixels.
+    size_t num_cols = 0;
+    size_t num_rows = 0;
+    double step_x = 0;
+    double step_y = 0;
+    // Camera coordinates of the grid points in row-major order.
+    std::vector<Eigen::Vector2d> cam_points;
+  };
+  std::shared_ptr<const UndistortionGrid> undistortion_grid;
+
   // Initialize parameters for given camera model and focal length, and set
   // the principal point to be the image center.
   static Camera CreateFromModelId(camera_t camera_id,
@@ -124,6 +142,13 @@ struct Camera {
                              double max_focal_length_ratio,
                              double max_extra_param) const;
 
+  // Precompute the undistortion grid with the given spacing in pixels for the
+  // current camera parameters. For points inside the image, `CamFromImg` then
+  // initializes the iterative undistortion by bilinear interpolation in the
+  // grid, which is much faster for models with strong distortion. The grid is
+  // ignored once the camera model or parameters change.
+  void ComputeUndistortionGrid(double spacing);
+
   // Project point in image plane to world / infinity.
   inline Eigen::Vector2d CamFromImg(const Eigen::Vector2d& image_point) const;
 
@@ -137,6 +162,10 @@ struct Camera {
   // and the principal point.
   void Rescale(double scale);
   void Rescale(size_t new_width, size_t new_height);
+
+ private:
+  bool CamFromImgWithUndistortionGrid(const Eigen::Vector2d& image_point,
+                                      Eigen::Vector2d* cam_point) const;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -239,6 +268,11 @@ bool Camera::HasBogusParams(const double min_focal_length_ratio,
 }
 
 Eigen::Vector2d Camera::CamFromImg(const Eigen::Vector2d& image_point) const {
+  Eigen::Vector2d cam_point;
+  if (undistortion_grid &&
+      CamFromImgWithUndistortionGrid(image_point, &cam_point)) {
+    return cam_point;
+  }
   return CameraModelCamFromImg(model_id, params, image_point).hnormalized();
 }
 
@@ -253,6 +253,38 @@ TEST(Camera, CamFromImg) {
   EXPECT_EQ(camera.CamFromImg(Eigen::Vector2d(0.5, 0.5))(1), 0.0);
 }
 
+TEST(Camera, CamFromImgWithUndistortionGrid) {
+  for (const std::string& model_name : {"FULL_OPENCV", "OPENCV_FISHEYE"}) {
+    Camera camera =
+        Camera::CreateFromModelName(1, model_name, 500.0, 640, 480);
+    for (const size_t idx : camera.ExtraParamsIdxs()) {
+      camera.params[idx] = 0.01;
+    }
+    camera.params[camera.ExtraParamsIdxs()[0]] = -0.1;
+    Camera camera_with_grid = camera;
+    camera_with_grid.ComputeUndistortionGrid(16);
+    ASSERT_TRUE(camera_with_grid.undistortion_grid);
+    for (double x = -10; x <= 650; x += 7.7) {
+      for (double y = -10; y <= 490; y += 7.7) {
+        const Eigen::Vector2d image_point(x, y);
+        const Eigen::Vector2d cam_point = camera.CamFromImg(image_point);
+        EXPECT_LT((camera_with_grid.CamFromImg(image_point) - cam_point)
+                      .lpNorm<Eigen::Infinity>(),
+                  1e-8);
+        EXPECT_LT((camera_with_grid.ImgFromCam(cam_point) - image_point)
+                      .lpNorm<Eigen::Infinity>(),
+                  1e-6);
+      }
+    }
+
+    // The grid is ignored for changed parameters.
+    camera.SetFocalLengthX(600);
+    camera_with_grid.SetFocalLengthX(600);
+    EXPECT_EQ(camera_with_grid.CamFromImg(Eigen::Vector2d(10, 20)),
+              camera.CamFromImg(Eigen::Vector2d(10, 20)));
+  }
+}
+
 TEST(Camera, CamFromImgThreshold) {
   Camera camera;
   EXPECT_THROW(camera.CamFromImgThreshold(0), std::domain_error);
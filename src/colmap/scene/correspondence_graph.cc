@@ -30,12 +30,62 @@
 #include "colmap/scene/correspondence_graph.h"
 
 #include "colmap/geometry/pose.h"
+#include "colmap/util/endian.h"
+#include "colmap/util/mapped_file.h"
+#include "colmap/util/misc.h"
 #include "colmap/util/string.h"
+#include "colmap/util/threading.h"
 
-#include <map>
-#include <set>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
 
 namespace colmap {
+namespace {
+
+// Maximum ratio of the largest image identifier to the number of images, for
+// which the dense image index is built.
+constexpr size_t kMaxImageIndexSparsity = 16;
+
+constexpr char kSnapshotMagic[8] = {'C', 'O', 'L', 'M', 'A', 'P', 'C', 'G'};
+constexpr uint64_t kSnapshotVersion = 1;
+
+struct SnapshotHeader {
+  char magic[8];
+  uint64_t version;
+  uint64_t key;
+  uint64_t num_images;
+  uint64_t num_image_pairs;
+  uint64_t num_corr_begs;
+  uint64_t num_corrs;
+};
+
+struct SnapshotImage {
+  uint32_t image_id;
+  uint32_t num_observations;
+  uint32_t num_correspondences;
+  uint32_t padding;
+  uint64_t corr_begs_offset;
+  uint64_t num_corr_begs;
+  uint64_t corrs_offset;
+  uint64_t num_corrs;
+};
+
+struct SnapshotImagePair {
+  uint64_t pair_id;
+  uint32_t num_correspondences;
+  uint32_t padding;
+};
+
+// Pad the corr_begs array to keep the following corrs array aligned.
+size_t SnapshotCorrBegsSize(const size_t num_corr_begs) {
+  return (num_corr_begs + num_corr_begs % 2) * sizeof(point2D_t);
+}
+
+}  // namespace
 
 std::unordered_map<image_pair_t, point2D_t>
 CorrespondenceGraph::NumCorrespondencesBetweenImages() const {
@@ -48,49 +98,423 @@ CorrespondenceGraph::NumCorrespondencesBetweenImages() const {
   return num_corrs_between_images;
 }
 
+CorrespondenceGraph::CorrespondenceGraph(const CorrespondenceGraph& other)
+    : finalized_(other.finalized_),
+      images_(other.images_),
+      image_pairs_(other.image_pairs_) {
+  if (finalized_) {
+    UpdateImageIndex();
+  }
+}
+
+CorrespondenceGraph& CorrespondenceGraph::operator=(
+    const CorrespondenceGraph& other) {
+  if (this != &other) {
+    finalized_ = other.finalized_;
+    images_ = other.images_;
+    image_pairs_ = other.image_pairs_;
+    image_index_.clear();
+    if (finalized_) {
+      UpdateImageIndex();
+    }
+  }
+  return *this;
+}
+
+size_t CorrespondenceGraph::NumBytes() const {
+  size_t num_bytes = image_index_.capacity() * sizeof(const Image*) +
+                     image_pairs_.size() * sizeof(ImagePair);
+  for (const auto& image : images_) {
+    num_bytes += sizeof(Image) +
+                 image.second.flat_corrs.capacity() * sizeof(Correspondence) +
+                 image.second.flat_corr_begs.capacity() * sizeof(point2D_t) +
+                 image.second.corrs.capacity() *
+                     sizeof(std::vector<Correspondence>);
+    for (const auto& corrs : image.second.corrs) {
+      num_bytes += corrs.capacity() * sizeof(Correspondence);
+    }
+  }
+  return num_bytes;
+}
+
 void CorrespondenceGraph::Finalize() {
   THROW_CHECK(!finalized_);
   finalized_ = true;
 
-  // Flatten all correspondences, remove images without observations.
+  // Flatten all correspondences. The images are independent of each other,
+  // so they are flattened in parallel.
+  std::vector<Image*> images;
+  images.reserve(images_.size());
+  for (auto& image : images_) {
+    images.push_back(&image.second);
+  }
+
+  const auto FlattenImages = [&images](const size_t beg, const size_t end) {
+    for (size_t i = beg; i < end; ++i) {
+      Image& image = *images[i];
+
+      // Count number of correspondences and observations.
+      image.num_observations = 0;
+      size_t num_total_corrs = 0;
+      for (const auto& corrs : image.corrs) {
+        num_total_corrs += corrs.size();
+        if (!corrs.empty()) {
+          image.num_observations += 1;
+        }
+      }
+
+      // Images without observations are erased below.
+      if (num_total_corrs == 0) {
+        continue;
+      }
+
+      // Reshuffle correspondences into flattened vector.
+      const point2D_t num_points2D = image.corrs.size();
+      image.flat_corrs.reserve(num_total_corrs);
+      image.flat_corr_begs.resize(num_points2D + 1);
+      for (point2D_t point2D_idx = 0; point2D_idx < num_points2D;
+           ++point2D_idx) {
+        image.flat_corr_begs[point2D_idx] = image.flat_corrs.size();
+        const std::vector<Correspondence>& corrs = image.corrs[point2D_idx];
+        image.flat_corrs.insert(
+            image.flat_corrs.end(), corrs.begin(), corrs.end());
+      }
+      image.flat_corr_begs[num_points2D] = image.flat_corrs.size();
+
+      // Ensure we reserved enough space before insertion.
+      THROW_CHECK_EQ(image.flat_corrs.size(), num_total_corrs);
+
+      // Deallocate original data.
+      image.corrs.clear();
+      image.corrs.shrink_to_fit();
+    }
+  };
+
+  const int num_threads = std::min<int>(GetEffectiveNumThreads(-1),
+                                        std::max<size_t>(1, images.size()));
+  if (num_threads == 1) {
+    FlattenImages(0, images.size());
+  } else {
+    ThreadPool thread_pool(num_threads);
+    const size_t num_images_per_task =
+        (images.size() + num_threads - 1) / num_threads;
+    std::vector<std::future<void>> futures;
+    futures.reserve(num_threads);
+    for (size_t beg = 0; beg < images.size(); beg += num_images_per_task) {
+      const size_t end = std::min(beg + num_images_per_task, images.size());
+      futures.push_back(thread_pool.AddTask(FlattenImages, beg, end));
+    }
+    for (auto& future : futures) {
+      future.get();
+    }
+  }
+
+  // Remove images without observations.
   for (auto it = images_.begin(); it != images_.end();) {
-    // Count number of correspondences and observations.
-    it->second.num_observations = 0;
-    size_t num_total_corrs = 0;
-    for (auto& corr : it->second.corrs) {
-      num_total_corrs += corr.size();
-      if (!corr.empty()) {
-        it->second.num_observations += 1;
+    if (it->second.flat_corr_begs.empty()) {
+      it = images_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  UpdateImageIndex();
+}
+
+void CorrespondenceGraph::Unfinalize() {
+  THROW_CHECK(finalized_);
+  finalized_ = false;
+  image_index_.clear();
+
+  for (auto& image : images_) {
+    const point2D_t num_points2D = image.second.flat_corr_begs.size() - 1;
+    image.second.corrs.resize(num_points2D);
+    for (point2D_t point2D_idx = 0; point2D_idx < num_points2D; ++point2D_idx) {
+      image.second.corrs[point2D_idx].assign(
+          image.second.flat_corrs.begin() +
+              image.second.flat_corr_begs[point2D_idx],
+          image.second.flat_corrs.begin() +
+              image.second.flat_corr_begs[point2D_idx + 1]);
+    }
+    image.second.flat_corrs.clear();
+    image.second.flat_corrs.shrink_to_fit();
+    image.second.flat_corr_begs.clear();
+    image.second.flat_corr_begs.shrink_to_fit();
+  }
+}
+
+CorrespondenceGraph CorrespondenceGraph::ExtractSubgraph(
+    const std::unordered_set<image_t>& image_ids) const {
+  THROW_CHECK(finalized_);
+
+  CorrespondenceGraph subgraph;
+  subgraph.finalized_ = true;
+
+  for (const image_t image_id : image_ids) {
+    const auto image_it = images_.find(image_id);
+    if (image_it == images_.end()) {
+      continue;
+    }
+
+    const Image& image = image_it->second;
+    const point2D_t num_points2D = image.flat_corr_begs.size() - 1;
+    Image subgraph_image;
+    subgraph_image.flat_corr_begs.resize(num_points2D + 1);
+    for (point2D_t point2D_idx = 0; point2D_idx < num_points2D;
+         ++point2D_idx) {
+      subgraph_image.flat_corr_begs[point2D_idx] =
+          subgraph_image.flat_corrs.size();
+      const point2D_t num_corrs = subgraph_image.flat_corrs.size();
+      for (point2D_t i = image.flat_corr_begs[point2D_idx];
+           i < image.flat_corr_begs[point2D_idx + 1];
+           ++i) {
+        if (image_ids.count(image.flat_corrs[i].image_id) > 0) {
+          subgraph_image.flat_corrs.push_back(image.flat_corrs[i]);
+        }
+      }
+      if (subgraph_image.flat_corrs.size() > num_corrs) {
+        subgraph_image.num_observations += 1;
       }
     }
+    subgraph_image.flat_corr_begs[num_points2D] =
+        subgraph_image.flat_corrs.size();
 
-    // Erase image without observations.
-    if (num_total_corrs == 0) {
-      images_.erase(it++);
+    if (subgraph_image.flat_corrs.empty()) {
       continue;
     }
 
-    // Reshuffle correspondences into flattened vector.
-    const point2D_t num_points2D = it->second.corrs.size();
-    it->second.flat_corrs.reserve(num_total_corrs);
-    it->second.flat_corr_begs.resize(num_points2D + 1);
-    for (point2D_t point2D_idx = 0; point2D_idx < num_points2D; ++point2D_idx) {
-      it->second.flat_corr_begs[point2D_idx] = it->second.flat_corrs.size();
-      std::vector<Correspondence>& corrs = it->second.corrs[point2D_idx];
-      it->second.flat_corrs.insert(
-          it->second.flat_corrs.end(), corrs.begin(), corrs.end());
+    subgraph_image.num_correspondences = subgraph_image.flat_corrs.size();
+    subgraph_image.flat_corrs.shrink_to_fit();
+    subgraph.images_.emplace(image_id, std::move(subgraph_image));
+  }
+
+  for (const auto& image_pair : image_pairs_) {
+    image_t image_id1;
+    image_t image_id2;
+    std::tie(image_id1, image_id2) =
+        Database::PairIdToImagePair(image_pair.first);
+    if (subgraph.images_.count(image_id1) > 0 &&
+        subgraph.images_.count(image_id2) > 0) {
+      subgraph.image_pairs_.emplace(image_pair);
+    }
+  }
+
+  subgraph.UpdateImageIndex();
+
+  return subgraph;
+}
+
+void CorrespondenceGraph::WriteBinary(std::ostream* stream) const {
+  THROW_CHECK(finalized_);
+
+  WriteBinaryLittleEndian<uint64_t>(stream, images_.size());
+  for (const auto& image : images_) {
+    WriteBinaryLittleEndian<image_t>(stream, image.first);
+    WriteBinaryLittleEndian<point2D_t>(stream, image.second.num_observations);
+    WriteBinaryLittleEndian<point2D_t>(stream,
+                                       image.second.num_correspondences);
+    WriteBinaryLittleEndian<uint64_t>(stream,
+                                      image.second.flat_corr_begs.size());
+    WriteBinaryLittleEndian<point2D_t>(stream, image.second.flat_corr_begs);
+    WriteBinaryLittleEndian<uint64_t>(stream, image.second.flat_corrs.size());
+    for (const auto& corr : image.second.flat_corrs) {
+      WriteBinaryLittleEndian<image_t>(stream, corr.image_id);
+      WriteBinaryLittleEndian<point2D_t>(stream, corr.point2D_idx);
+    }
+  }
+
+  WriteBinaryLittleEndian<uint64_t>(stream, image_pairs_.size());
+  for (const auto& image_pair : image_pairs_) {
+    WriteBinaryLittleEndian<image_pair_t>(stream, image_pair.first);
+    WriteBinaryLittleEndian<point2D_t>(stream,
+                                       image_pair.second.num_correspondences);
+  }
+}
+
+void CorrespondenceGraph::ReadBinary(std::istream* stream) {
+  images_.clear();
+  image_pairs_.clear();
+
+  const size_t num_images = ReadBinaryLittleEndian<uint64_t>(stream);
+  images_.reserve(num_images);
+  for (size_t i = 0; i < num_images; ++i) {
+    const image_t image_id = ReadBinaryLittleEndian<image_t>(stream);
+    struct Image& image = images_[image_id];
+    image.num_observations = ReadBinaryLittleEndian<point2D_t>(stream);
+    image.num_correspondences = ReadBinaryLittleEndian<point2D_t>(stream);
+    image.flat_corr_begs.resize(ReadBinaryLittleEndian<uint64_t>(stream));
+    ReadBinaryLittleEndian<point2D_t>(stream, &image.flat_corr_begs);
+    image.flat_corrs.resize(ReadBinaryLittleEndian<uint64_t>(stream));
+    for (auto& corr : image.flat_corrs) {
+      corr.image_id = ReadBinaryLittleEndian<image_t>(stream);
+      corr.point2D_idx = ReadBinaryLittleEndian<point2D_t>(stream);
+    }
+    THROW_CHECK(!image.flat_corr_begs.empty());
+    THROW_CHECK_EQ(image.flat_corr_begs.back(), image.flat_corrs.size());
+  }
+
+  const size_t num_image_pairs = ReadBinaryLittleEndian<uint64_t>(stream);
+  image_pairs_.reserve(num_image_pairs);
+  for (size_t i = 0; i < num_image_pairs; ++i) {
+    const image_pair_t pair_id = ReadBinaryLittleEndian<image_pair_t>(stream);
+    image_pairs_[pair_id].num_correspondences =
+        ReadBinaryLittleEndian<point2D_t>(stream);
+  }
+
+  THROW_CHECK(stream->good());
+
+  finalized_ = true;
+  UpdateImageIndex();
+}
+
+void CorrespondenceGraph::WriteSnapshot(const std::string& path,
+                                        const uint64_t key) const {
+  THROW_CHECK(finalized_);
+  THROW_CHECK(IsLittleEndian());
+  static_assert(sizeof(image_t) == sizeof(uint32_t), "Invalid image_t");
+  static_assert(sizeof(point2D_t) == sizeof(uint32_t), "Invalid point2D_t");
+  static_assert(sizeof(Correspondence) == 8, "Invalid Correspondence");
+
+  SnapshotHeader header;
+  std::memcpy(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic));
+  header.version = kSnapshotVersion;
+  header.key = key;
+  header.num_images = images_.size();
+  header.num_image_pairs = image_pairs_.size();
+  header.num_corr_begs = 0;
+  header.num_corrs = 0;
+
+  std::vector<SnapshotImage> snapshot_images;
+  snapshot_images.reserve(images_.size());
+  for (const auto& image : images_) {
+    SnapshotImage snapshot_image;
+    snapshot_image.image_id = image.first;
+    snapshot_image.num_observations = image.second.num_observations;
+    snapshot_image.num_correspondences = image.second.num_correspondences;
+    snapshot_image.padding = 0;
+    snapshot_image.corr_begs_offset = header.num_corr_begs;
+    snapshot_image.num_corr_begs = image.second.flat_corr_begs.size();
+    snapshot_image.corrs_offset = header.num_corrs;
+    snapshot_image.num_corrs = image.second.flat_corrs.size();
+    header.num_corr_begs += snapshot_image.num_corr_begs;
+    header.num_corrs += snapshot_image.num_corrs;
+    snapshot_images.push_back(snapshot_image);
+  }
+
+  std::vector<SnapshotImagePair> snapshot_image_pairs;
+  snapshot_image_pairs.reserve(image_pairs_.size());
+  for (const auto& image_pair : image_pairs_) {
+    SnapshotImagePair snapshot_image_pair;
+    snapshot_image_pair.pair_id = image_pair.first;
+    snapshot_image_pair.num_correspondences =
+        image_pair.second.num_correspondences;
+    snapshot_image_pair.padding = 0;
+    snapshot_image_pairs.push_back(snapshot_image_pair);
+  }
+
+  // Write to a temporary file first, so that concurrent readers never see a
+  // partially written snapshot.
+  const std::string tmp_path =
+      path + "." +
+      std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) +
+      ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::trunc | std::ios::binary);
+    THROW_CHECK_FILE_OPEN(file, tmp_path);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(snapshot_images.data()),
+               snapshot_images.size() * sizeof(SnapshotImage));
+    file.write(reinterpret_cast<const char*>(snapshot_image_pairs.data()),
+               snapshot_image_pairs.size() * sizeof(SnapshotImagePair));
+    for (const auto& image : images_) {
+      file.write(
+          reinterpret_cast<const char*>(image.second.flat_corr_begs.data()),
+          image.second.flat_corr_begs.size() * sizeof(point2D_t));
+    }
+    const point2D_t padding = 0;
+    file.write(reinterpret_cast<const char*>(&padding),
+               SnapshotCorrBegsSize(header.num_corr_begs) -
+                   header.num_corr_begs * sizeof(point2D_t));
+    for (const auto& image : images_) {
+      file.write(reinterpret_cast<const char*>(image.second.flat_corrs.data()),
+                 image.second.flat_corrs.size() * sizeof(Correspondence));
     }
-    it->second.flat_corr_begs[num_points2D] = it->second.flat_corrs.size();
+    THROW_CHECK(file.good()) << "Failed to write " << tmp_path;
+  }
+  THROW_CHECK_EQ(std::rename(tmp_path.c_str(), path.c_str()), 0);
+}
+
+bool CorrespondenceGraph::ReadSnapshot(const std::string& path,
+                                       const uint64_t key) {
+  if (!IsLittleEndian() || !ExistsFile(path)) {
+    return false;
+  }
+
+  MappedFile file(path);
+  const uint8_t* data = file.Data();
 
-    // Ensure we reserved enough space before insertion.
-    THROW_CHECK_EQ(it->second.flat_corrs.size(), num_total_corrs);
+  SnapshotHeader header;
+  if (file.Size() < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, kSnapshotMagic, sizeof(kSnapshotMagic)) != 0 ||
+      header.version != kSnapshotVersion || header.key != key) {
+    return false;
+  }
 
-    // Deallocate original data.
-    it->second.corrs.clear();
-    it->second.corrs.shrink_to_fit();
+  const size_t images_offset = sizeof(header);
+  const size_t image_pairs_offset =
+      images_offset + header.num_images * sizeof(SnapshotImage);
+  const size_t corr_begs_offset =
+      image_pairs_offset + header.num_image_pairs * sizeof(SnapshotImagePair);
+  const size_t corrs_offset =
+      corr_begs_offset + SnapshotCorrBegsSize(header.num_corr_begs);
+  THROW_CHECK_EQ(file.Size(),
+                 corrs_offset + header.num_corrs * sizeof(Correspondence))
+      << "Corrupt correspondence graph snapshot " << path;
+
+  const auto* snapshot_images =
+      reinterpret_cast<const SnapshotImage*>(data + images_offset);
+  const auto* snapshot_image_pairs =
+      reinterpret_cast<const SnapshotImagePair*>(data + image_pairs_offset);
+  const auto* corr_begs =
+      reinterpret_cast<const point2D_t*>(data + corr_begs_offset);
+  const auto* corrs =
+      reinterpret_cast<const Correspondence*>(data + corrs_offset);
+
+  images_.clear();
+  images_.reserve(header.num_images);
+  for (size_t i = 0; i < header.num_images; ++i) {
+    const SnapshotImage& snapshot_image = snapshot_images[i];
+    THROW_CHECK_LE(
+        snapshot_image.corr_begs_offset + snapshot_image.num_corr_begs,
+        header.num_corr_begs);
+    THROW_CHECK_LE(snapshot_image.corrs_offset + snapshot_image.num_corrs,
+                   header.num_corrs);
+    struct Image& image = images_[snapshot_image.image_id];
+    image.num_observations = snapshot_image.num_observations;
+    image.num_correspondences = snapshot_image.num_correspondences;
+    image.flat_corr_begs.assign(
+        corr_begs + snapshot_image.corr_begs_offset,
+        corr_begs + snapshot_image.corr_begs_offset +
+            snapshot_image.num_corr_begs);
+    image.flat_corrs.assign(
+        corrs + snapshot_image.corrs_offset,
+        corrs + snapshot_image.corrs_offset + snapshot_image.num_corrs);
+  }
 
-    ++it;
+  image_pairs_.clear();
+  image_pairs_.reserve(header.num_image_pairs);
+  for (size_t i = 0; i < header.num_image_pairs; ++i) {
+    image_pairs_[snapshot_image_pairs[i].pair_id].num_correspondences =
+        snapshot_image_pairs[i].num_correspondences;
   }
+
+  finalized_ = true;
+  UpdateImageIndex();
+
+  return true;
 }
 
 void CorrespondenceGraph::AddImage(const image_t image_id,
@@ -190,7 +614,10 @@ CorrespondenceGraph::FindCorrespondences(const image_t image_id,
                                          const point2D_t point2D_idx) const {
   THROW_CHECK(finalized_);
   const point2D_t next_point2D_idx = point2D_idx + 1;
-  const Image& image = images_.at(image_id);
+  const Image& image =
+      (image_id < image_index_.size() && image_index_[image_id] != nullptr)
+          ? *image_index_[image_id]
+          : images_.at(image_id);
   const Correspondence* beg =
       image.flat_corrs.data() + image.flat_corr_begs.at(point2D_idx);
   const Correspondence* end =
@@ -228,8 +655,15 @@ void CorrespondenceGraph::ExtractTransitiveCorrespondences(
   // Push requested image point on queue to visit. Will be removed later.
   corrs->emplace_back(image_id, point2D_idx);
 
-  std::map<image_t, std::set<point2D_t>> image_corrs;
-  image_corrs[image_id].insert(point2D_idx);
+  // Collected observations, packed into the image identifier in the upper and
+  // the point index in the lower 32 bits.
+  const auto observation_key = [](const image_t image_id,
+                                  const point2D_t point2D_idx) {
+    return (static_cast<uint64_t>(image_id) << 32) |
+           static_cast<uint64_t>(point2D_idx);
+  };
+  std::unordered_set<uint64_t> observations;
+  observations.insert(observation_key(image_id, point2D_idx));
 
   size_t corr_queue_beg = 0;
   size_t corr_queue_end = 1;
@@ -245,8 +679,9 @@ void CorrespondenceGraph::ExtractTransitiveCorrespondences(
            corr < ref_corr_range.end;
            ++corr) {
         // Check if correspondence already collected, otherwise collect.
-        auto& corr_image_corrs = image_corrs[corr->image_id];
-        if (corr_image_corrs.insert(corr->point2D_idx).second) {
+        if (observations.insert(observation_key(corr->image_id,
+                                                 corr->point2D_idx))
+                .second) {
           corrs->emplace_back(corr->image_id, corr->point2D_idx);
         }
       }
@@ -270,6 +705,23 @@ void CorrespondenceGraph::ExtractTransitiveCorrespondences(
   corrs->pop_back();
 }
 
+void CorrespondenceGraph::UpdateImageIndex() {
+  image_index_.clear();
+  image_t max_image_id = 0;
+  for (const auto& image : images_) {
+    max_image_id = std::max(max_image_id, image.first);
+  }
+  // Image identifiers are usually consecutive, but fall back to the hash map
+  // for very sparse identifiers to bound the memory of the index.
+  if (max_image_id >= kMaxImageIndexSparsity * images_.size()) {
+    return;
+  }
+  image_index_.resize(max_image_id + 1, nullptr);
+  for (const auto& image : images_) {
+    image_index_[image.first] = &image.second;
+  }
+}
+
 FeatureMatches CorrespondenceGraph::FindCorrespondencesBetweenImages(
     const image_t image_id1, const image_t image_id2) const {
   const point2D_t num_correspondences =
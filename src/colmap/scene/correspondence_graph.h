@@ -32,7 +32,10 @@
 #include "colmap/scene/database.h"
 #include "colmap/util/types.h"
 
+#include <iostream>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace colmap {
@@ -61,6 +64,12 @@ class CorrespondenceGraph {
   };
 
   CorrespondenceGraph() = default;
+  CorrespondenceGraph(const CorrespondenceGraph& other);
+  CorrespondenceGraph& operator=(const CorrespondenceGraph& other);
+  // Moving the hash map of images keeps its elements, so that the image index
+  // stays valid.
+  CorrespondenceGraph(CorrespondenceGraph&& other) = default;
+  CorrespondenceGraph& operator=(CorrespondenceGraph&& other) = default;
 
   // Number of added images.
   inline size_t NumImages() const;
@@ -71,6 +80,9 @@ class CorrespondenceGraph {
   // Check whether image exists.
   inline bool ExistsImage(image_t image_id) const;
 
+  // Check whether correspondences between the image pair were added.
+  inline bool ExistsImagePair(image_t image_id1, image_t image_id2) const;
+
   // Get the number of observations in an image. An observation is an image
   // point that has at least one correspondence.
   inline point2D_t NumObservationsForImage(image_t image_id) const;
@@ -86,6 +98,9 @@ class CorrespondenceGraph {
   std::unordered_map<image_pair_t, point2D_t> NumCorrespondencesBetweenImages()
       const;
 
+  // Approximate number of bytes used by the correspondences and images.
+  size_t NumBytes() const;
+
   // Finalize the database manager.
   //
   // - Calculates the number of observations per image by counting the number
@@ -94,6 +109,32 @@ class CorrespondenceGraph {
   // - Shrinks the correspondence vectors to their size to save memory.
   void Finalize();
 
+  // Revert the flattening of Finalize() such that further images and
+  // correspondences can be added before finalizing the graph again. Images
+  // without observations erased by Finalize() must be added again.
+  void Unfinalize();
+
+  // Extract the finalized subgraph of the given images, which only contains
+  // the correspondences between these images. As in Finalize(), images
+  // without observations in the subgraph are omitted. The graph must be
+  // finalized.
+  CorrespondenceGraph ExtractSubgraph(
+      const std::unordered_set<image_t>& image_ids) const;
+
+  // Write/read the finalized graph in a binary format to/from a stream.
+  void WriteBinary(std::ostream* stream) const;
+  void ReadBinary(std::istream* stream);
+
+  // Write/read a snapshot of the finalized graph to/from a file. In contrast
+  // to the binary stream format, the snapshot stores all correspondences in
+  // flat arrays in their in-memory layout, which are memory-mapped and copied
+  // in bulk when reading. The snapshot only supports little-endian hosts.
+  // Reading returns false without modifying the graph, if the file does not
+  // exist or if its key differs from the given key, e.g., a hash of the
+  // matches from which the graph was built.
+  void WriteSnapshot(const std::string& path, uint64_t key) const;
+  bool ReadSnapshot(const std::string& path, uint64_t key);
+
   // Add new image to the correspondence graph.
   void AddImage(image_t image_id, size_t num_points2D);
 
@@ -166,9 +207,18 @@ class CorrespondenceGraph {
     point2D_t num_correspondences = 0;
   };
 
+  // Build the dense index from image identifiers to images after the graph
+  // was finalized.
+  void UpdateImageIndex();
+
   bool finalized_ = false;
   std::unordered_map<image_t, Image> images_;
   std::unordered_map<image_pair_t, ImagePair> image_pairs_;
+
+  // Images indexed by their identifier to avoid the hash map lookup in
+  // `FindCorrespondences`. Entries of non-existing images are null. Empty if
+  // the graph is not finalized or if the image identifiers are too sparse.
+  std::vector<const Image*> image_index_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -185,6 +235,12 @@ bool CorrespondenceGraph::ExistsImage(const image_t image_id) const {
   return images_.find(image_id) != images_.end();
 }
 
+bool CorrespondenceGraph::ExistsImagePair(const image_t image_id1,
+                                          const image_t image_id2) const {
+  return image_pairs_.find(Database::ImagePairToPairId(
+             image_id1, image_id2)) != image_pairs_.end();
+}
+
 point2D_t CorrespondenceGraph::NumObservationsForImage(
     const image_t image_id) const {
   return images_.at(image_id).num_observations;
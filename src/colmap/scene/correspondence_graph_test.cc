@@ -29,6 +29,11 @@
 
 #include "colmap/scene/correspondence_graph.h"
 
+#include "colmap/util/testing.h"
+
+#include <memory>
+#include <sstream>
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -51,6 +56,20 @@ TEST(CorrespondenceGraph, Empty) {
   EXPECT_EQ(correspondence_graph.NumCorrespondencesBetweenImages().size(), 0);
 }
 
+TEST(CorrespondenceGraph, NumBytes) {
+  CorrespondenceGraph correspondence_graph;
+  EXPECT_EQ(correspondence_graph.NumBytes(), 0);
+  correspondence_graph.AddImage(0, 10);
+  correspondence_graph.AddImage(1, 10);
+  EXPECT_GE(correspondence_graph.NumBytes(),
+            20 * sizeof(std::vector<CorrespondenceGraph::Correspondence>));
+  correspondence_graph.AddCorrespondences(0, 1, {{0, 0}, {1, 2}});
+  correspondence_graph.Finalize();
+  EXPECT_GE(correspondence_graph.NumBytes(),
+            4 * sizeof(CorrespondenceGraph::Correspondence) +
+                22 * sizeof(point2D_t));
+}
+
 TEST(CorrespondenceGraph, TwoView) {
   CorrespondenceGraph correspondence_graph;
   correspondence_graph.AddImage(0, 10);
@@ -236,6 +255,53 @@ TEST(CorrespondenceGraph, ThreeView) {
             2);
 }
 
+TEST(CorrespondenceGraph, ExtractSubgraph) {
+  CorrespondenceGraph correspondence_graph;
+  correspondence_graph.AddImage(0, 10);
+  correspondence_graph.AddImage(1, 10);
+  correspondence_graph.AddImage(2, 10);
+  correspondence_graph.AddImage(3, 10);
+  correspondence_graph.AddCorrespondences(0, 1, {{0, 0}});
+  correspondence_graph.AddCorrespondences(0, 2, {{0, 0}});
+  correspondence_graph.AddCorrespondences(1, 2, {{0, 0}, {5, 5}});
+  correspondence_graph.AddCorrespondences(2, 3, {{1, 1}});
+  correspondence_graph.Finalize();
+
+  const CorrespondenceGraph subgraph =
+      correspondence_graph.ExtractSubgraph({1, 2, 3, 4});
+  EXPECT_EQ(subgraph.NumImages(), 3);
+  EXPECT_FALSE(subgraph.ExistsImage(0));
+  EXPECT_EQ(subgraph.NumImagePairs(), 2);
+  EXPECT_TRUE(subgraph.ExistsImagePair(1, 2));
+  EXPECT_TRUE(subgraph.ExistsImagePair(2, 3));
+  EXPECT_FALSE(subgraph.ExistsImagePair(0, 1));
+  EXPECT_EQ(subgraph.NumObservationsForImage(1), 2);
+  EXPECT_EQ(subgraph.NumObservationsForImage(2), 3);
+  EXPECT_EQ(subgraph.NumObservationsForImage(3), 1);
+  EXPECT_EQ(subgraph.NumCorrespondencesForImage(1), 2);
+  EXPECT_EQ(subgraph.NumCorrespondencesForImage(2), 3);
+  EXPECT_EQ(subgraph.NumCorrespondencesForImage(3), 1);
+  EXPECT_EQ(subgraph.NumCorrespondencesBetweenImages(1, 2), 2);
+
+  std::vector<CorrespondenceGraph::Correspondence> corrs;
+  subgraph.ExtractCorrespondences(1, 0, &corrs);
+  EXPECT_EQ(corrs.size(), 1);
+  EXPECT_EQ(corrs.at(0).image_id, 2);
+  EXPECT_EQ(corrs.at(0).point2D_idx, 0);
+  subgraph.ExtractCorrespondences(2, 0, &corrs);
+  EXPECT_EQ(corrs.size(), 1);
+  EXPECT_EQ(corrs.at(0).image_id, 1);
+  EXPECT_FALSE(subgraph.HasCorrespondences(2, 2));
+  EXPECT_TRUE(subgraph.HasCorrespondences(3, 1));
+  EXPECT_FALSE(subgraph.HasCorrespondences(3, 0));
+
+  // Images without correspondences to other selected images are omitted.
+  const CorrespondenceGraph isolated_subgraph =
+      correspondence_graph.ExtractSubgraph({0, 3});
+  EXPECT_EQ(isolated_subgraph.NumImages(), 0);
+  EXPECT_EQ(isolated_subgraph.NumImagePairs(), 0);
+}
+
 TEST(CorrespondenceGraph, OutOfBounds) {
   CorrespondenceGraph correspondence_graph;
   correspondence_graph.AddImage(0, 10);
@@ -278,5 +344,113 @@ TEST(CorrespondenceGraph, Duplicate) {
             3);
 }
 
+TEST(CorrespondenceGraph, Unfinalize) {
+  CorrespondenceGraph correspondence_graph;
+  correspondence_graph.AddImage(0, 10);
+  correspondence_graph.AddImage(1, 10);
+  correspondence_graph.AddImage(2, 10);
+  correspondence_graph.AddCorrespondences(0, 1, {{0, 0}, {1, 1}});
+  correspondence_graph.Finalize();
+  EXPECT_TRUE(correspondence_graph.ExistsImagePair(1, 0));
+  EXPECT_FALSE(correspondence_graph.ExistsImagePair(1, 2));
+  EXPECT_FALSE(correspondence_graph.ExistsImage(2));
+  correspondence_graph.Unfinalize();
+  correspondence_graph.AddImage(2, 10);
+  correspondence_graph.AddCorrespondences(1, 2, {{1, 5}});
+  correspondence_graph.Finalize();
+  EXPECT_TRUE(correspondence_graph.ExistsImagePair(1, 2));
+  EXPECT_EQ(correspondence_graph.NumObservationsForImage(0), 2);
+  EXPECT_EQ(correspondence_graph.NumObservationsForImage(1), 2);
+  EXPECT_EQ(correspondence_graph.NumObservationsForImage(2), 1);
+  EXPECT_EQ(correspondence_graph.NumCorrespondencesForImage(1), 3);
+  EXPECT_EQ(CountNumTransitiveCorrespondences(correspondence_graph, 0, 1, 2),
+            2);
+}
+
+TEST(CorrespondenceGraph, Copy) {
+  std::unique_ptr<CorrespondenceGraph> correspondence_graph =
+      std::make_unique<CorrespondenceGraph>();
+  correspondence_graph->AddImage(0, 10);
+  correspondence_graph->AddImage(1, 10);
+  correspondence_graph->AddImage(2, 10);
+  correspondence_graph->AddCorrespondences(0, 1, {{0, 0}, {1, 1}});
+  correspondence_graph->AddCorrespondences(1, 2, {{1, 5}});
+  correspondence_graph->Finalize();
+  const CorrespondenceGraph copied_correspondence_graph = *correspondence_graph;
+  correspondence_graph.reset();
+  EXPECT_EQ(copied_correspondence_graph.FindCorrespondences(0, 1).end -
+                copied_correspondence_graph.FindCorrespondences(0, 1).beg,
+            1);
+  EXPECT_EQ(
+      CountNumTransitiveCorrespondences(copied_correspondence_graph, 0, 1, 2),
+      2);
+  EXPECT_THROW(copied_correspondence_graph.FindCorrespondences(3, 0),
+               std::out_of_range);
+}
+
+TEST(CorrespondenceGraph, ReadWriteBinary) {
+  CorrespondenceGraph correspondence_graph;
+  correspondence_graph.AddImage(0, 10);
+  correspondence_graph.AddImage(1, 10);
+  correspondence_graph.AddImage(2, 10);
+  correspondence_graph.AddCorrespondences(0, 1, {{0, 0}, {1, 1}});
+  correspondence_graph.AddCorrespondences(1, 2, {{1, 5}});
+  correspondence_graph.Finalize();
+  std::stringstream stream;
+  correspondence_graph.WriteBinary(&stream);
+  CorrespondenceGraph read_correspondence_graph;
+  read_correspondence_graph.ReadBinary(&stream);
+  EXPECT_EQ(read_correspondence_graph.NumImages(), 3);
+  EXPECT_EQ(read_correspondence_graph.NumImagePairs(), 2);
+  EXPECT_EQ(read_correspondence_graph.NumCorrespondencesBetweenImages(),
+            correspondence_graph.NumCorrespondencesBetweenImages());
+  for (image_t image_id = 0; image_id < 3; ++image_id) {
+    EXPECT_EQ(read_correspondence_graph.NumObservationsForImage(image_id),
+              correspondence_graph.NumObservationsForImage(image_id));
+    EXPECT_EQ(read_correspondence_graph.NumCorrespondencesForImage(image_id),
+              correspondence_graph.NumCorrespondencesForImage(image_id));
+  }
+  EXPECT_EQ(read_correspondence_graph.FindCorrespondencesBetweenImages(0, 1)
+                .size(),
+            2);
+  EXPECT_TRUE(read_correspondence_graph.IsTwoViewObservation(0, 0));
+  EXPECT_FALSE(read_correspondence_graph.IsTwoViewObservation(2, 5));
+}
+
+TEST(CorrespondenceGraph, ReadWriteSnapshot) {
+  CorrespondenceGraph correspondence_graph;
+  correspondence_graph.AddImage(0, 10);
+  correspondence_graph.AddImage(1, 10);
+  correspondence_graph.AddImage(2, 7);
+  correspondence_graph.AddCorrespondences(0, 1, {{0, 0}, {1, 1}});
+  correspondence_graph.AddCorrespondences(1, 2, {{1, 5}});
+  correspondence_graph.Finalize();
+  const std::string path = CreateTestDir() + "/correspondence_graph.bin";
+  correspondence_graph.WriteSnapshot(path, /*key=*/42);
+
+  CorrespondenceGraph read_correspondence_graph;
+  EXPECT_FALSE(read_correspondence_graph.ReadSnapshot(path + ".missing", 42));
+  EXPECT_FALSE(read_correspondence_graph.ReadSnapshot(path, 43));
+  EXPECT_EQ(read_correspondence_graph.NumImages(), 0);
+  EXPECT_TRUE(read_correspondence_graph.ReadSnapshot(path, 42));
+  EXPECT_EQ(read_correspondence_graph.NumImages(), 3);
+  EXPECT_EQ(read_correspondence_graph.NumCorrespondencesBetweenImages(),
+            correspondence_graph.NumCorrespondencesBetweenImages());
+  for (image_t image_id = 0; image_id < 3; ++image_id) {
+    EXPECT_EQ(read_correspondence_graph.NumObservationsForImage(image_id),
+              correspondence_graph.NumObservationsForImage(image_id));
+    EXPECT_EQ(read_correspondence_graph.NumCorrespondencesForImage(image_id),
+              correspondence_graph.NumCorrespondencesForImage(image_id));
+  }
+  std::vector<CorrespondenceGraph::Correspondence> corrs;
+  read_correspondence_graph.ExtractCorrespondences(1, 1, &corrs);
+  ASSERT_EQ(corrs.size(), 2);
+  EXPECT_EQ(corrs[0].image_id, 0);
+  EXPECT_EQ(corrs[0].point2D_idx, 1);
+  EXPECT_EQ(corrs[1].image_id, 2);
+  EXPECT_EQ(corrs[1].point2D_idx, 5);
+  EXPECT_FALSE(read_correspondence_graph.HasCorrespondences(2, 6));
+}
+
 }  // namespace
 }  // namespace colmap
@@ -29,13 +29,18 @@
 
 #include "colmap/scene/database.h"
 
+#include "colmap/scene/feature_store.h"
+#include "colmap/util/misc.h"
 #include "colmap/util/sqlite3_utils.h"
 #include "colmap/util/string.h"
 #include "colmap/util/version.h"
 
+#include <algorithm>
 #include <fstream>
 #include <memory>
 
+#include <lz4.h>
+
 namespace colmap {
 namespace {
 
@@ -103,6 +108,130 @@ FeatureMatches FeatureMatchesFromBlob(const FeatureMatchesBlob& blob) {
   return matches;
 }
 
+// Encoding of the `data` column of a blob, as stored in the `compression`
+// column of the descriptors, matches, and two-view geometries tables.
+enum class BlobEncoding {
+  NONE = 0,
+  // LZ4 block compression of the raw data.
+  LZ4 = 1,
+  // Zigzag/varint encoded delta of the first index to its predecessor followed
+  // by the varint encoded second index. Only valid for blobs with two columns.
+  DELTA_VARINT = 2,
+};
+
+void AppendVarint(uint64_t value, std::vector<uint8_t>* bytes) {
+  while (value >= 0x80) {
+    bytes->push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  bytes->push_back(static_cast<uint8_t>(value));
+}
+
+uint64_t ReadVarint(const uint8_t** data, const uint8_t* end) {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    THROW_CHECK(*data < end) << "Truncated varint in blob";
+    const uint8_t byte = *((*data)++);
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  LOG(FATAL_THROW) << "Invalid varint in blob";
+  return value;
+}
+
+uint64_t ZigzagEncode(const int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+int64_t ZigzagDecode(const uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Encode the data of the matrix into the given buffer. Returns the given
+// encoding or `BlobEncoding::NONE`, if the encoded data is not smaller than the
+// raw data, in which case the buffer should not be used.
+template <typename MatrixType>
+BlobEncoding EncodeMatrixBlob(const MatrixType& matrix,
+                              const BlobEncoding encoding,
+                              std::vector<uint8_t>* bytes) {
+  const size_t num_bytes = matrix.size() * sizeof(typename MatrixType::Scalar);
+  bytes->clear();
+
+  switch (encoding) {
+    case BlobEncoding::NONE:
+      return BlobEncoding::NONE;
+    case BlobEncoding::LZ4: {
+      if (num_bytes == 0) {
+        return BlobEncoding::NONE;
+      }
+      bytes->resize(LZ4_compressBound(static_cast<int>(num_bytes)));
+      const int num_compressed_bytes =
+          LZ4_compress_default(reinterpret_cast<const char*>(matrix.data()),
+                               reinterpret_cast<char*>(bytes->data()),
+                               static_cast<int>(num_bytes),
+                               static_cast<int>(bytes->size()));
+      THROW_CHECK_GT(num_compressed_bytes, 0);
+      bytes->resize(num_compressed_bytes);
+      break;
+    }
+    case BlobEncoding::DELTA_VARINT: {
+      THROW_CHECK_EQ(matrix.cols(), 2);
+      bytes->reserve(num_bytes);
+      int64_t prev_idx1 = 0;
+      for (typename MatrixType::Index i = 0; i < matrix.rows(); ++i) {
+        const int64_t idx1 = static_cast<int64_t>(matrix(i, 0));
+        AppendVarint(ZigzagEncode(idx1 - prev_idx1), bytes);
+        AppendVarint(static_cast<uint64_t>(matrix(i, 1)), bytes);
+        prev_idx1 = idx1;
+      }
+      break;
+    }
+    default:
+      LOG(FATAL_THROW) << "Unknown blob encoding";
+  }
+
+  return bytes->size() < num_bytes ? encoding : BlobEncoding::NONE;
+}
+
+// Decode the data into the matrix, which must already have the final size.
+template <typename MatrixType>
+void DecodeMatrixBlob(const BlobEncoding encoding,
+                      const uint8_t* data,
+                      const size_t num_bytes,
+                      MatrixType* matrix) {
+  switch (encoding) {
+    case BlobEncoding::LZ4: {
+      const int num_decompressed_bytes = static_cast<int>(
+          matrix->size() * sizeof(typename MatrixType::Scalar));
+      THROW_CHECK_EQ(
+          LZ4_decompress_safe(reinterpret_cast<const char*>(data),
+                              reinterpret_cast<char*>(matrix->data()),
+                              static_cast<int>(num_bytes),
+                              num_decompressed_bytes),
+          num_decompressed_bytes);
+      break;
+    }
+    case BlobEncoding::DELTA_VARINT: {
+      THROW_CHECK_EQ(matrix->cols(), 2);
+      const uint8_t* end = data + num_bytes;
+      int64_t idx1 = 0;
+      for (typename MatrixType::Index i = 0; i < matrix->rows(); ++i) {
+        idx1 += ZigzagDecode(ReadVarint(&data, end));
+        (*matrix)(i, 0) = static_cast<typename MatrixType::Scalar>(idx1);
+        (*matrix)(i, 1) =
+            static_cast<typename MatrixType::Scalar>(ReadVarint(&data, end));
+      }
+      THROW_CHECK(data == end) << "Trailing data in blob";
+      break;
+    }
+    default:
+      LOG(FATAL_THROW) << "Unknown blob encoding";
+  }
+}
+
 template <typename MatrixType>
 MatrixType ReadStaticMatrixBlob(sqlite3_stmt* sql_stmt,
                                 const int rc,
@@ -171,6 +300,93 @@ MatrixType ReadDynamicMatrixBlob(sqlite3_stmt* sql_stmt,
   return matrix;
 }
 
+// Read a blob with `rows`, `cols`, and `data` columns starting at `col` and
+// its encoding stored in `compression_col`.
+template <typename MatrixType>
+MatrixType ReadEncodedDynamicMatrixBlob(sqlite3_stmt* sql_stmt,
+                                        const int rc,
+                                        const int col,
+                                        const int compression_col) {
+  if (rc != SQLITE_ROW) {
+    return ReadDynamicMatrixBlob<MatrixType>(sql_stmt, rc, col);
+  }
+
+  const BlobEncoding encoding = static_cast<BlobEncoding>(
+      sqlite3_column_int64(sql_stmt, compression_col));
+  if (encoding == BlobEncoding::NONE) {
+    return ReadDynamicMatrixBlob<MatrixType>(sql_stmt, rc, col);
+  }
+
+  const int64_t rows = sqlite3_column_int64(sql_stmt, col + 0);
+  const int64_t cols = sqlite3_column_int64(sql_stmt, col + 1);
+  THROW_CHECK_GE(rows, 0);
+  THROW_CHECK_GE(cols, 0);
+  MatrixType matrix(rows, cols);
+  DecodeMatrixBlob(
+      encoding,
+      static_cast<const uint8_t*>(sqlite3_column_blob(sql_stmt, col + 2)),
+      static_cast<size_t>(sqlite3_column_bytes(sql_stmt, col + 2)),
+      &matrix);
+  return matrix;
+}
+
+// Read the blobs for multiple images with a prepared statement of the form
+// `SELECT image_id, rows, cols, data FROM ... WHERE image_id IN (?, ..., ?)`
+// with `Database::kReadBatchSize` parameters. Unused parameters in the last
+// batch are bound to an already queried identifier. If `compression_col` is
+// non-negative, the encoding of the blobs is read from that column.
+template <typename MatrixType>
+std::vector<MatrixType> ReadDynamicMatrixBlobsBatched(
+    sqlite3_stmt* sql_stmt,
+    const std::vector<image_t>& image_ids,
+    const int compression_col = -1) {
+  const MatrixType empty_blob =
+      ReadDynamicMatrixBlob<MatrixType>(sql_stmt, SQLITE_DONE, 0);
+  std::vector<MatrixType> blobs(image_ids.size(), empty_blob);
+
+  std::unordered_map<image_t, std::vector<size_t>> image_id_to_idxs;
+  image_id_to_idxs.reserve(image_ids.size());
+  std::vector<image_t> unique_image_ids;
+  unique_image_ids.reserve(image_ids.size());
+  for (size_t i = 0; i < image_ids.size(); ++i) {
+    auto& idxs = image_id_to_idxs[image_ids[i]];
+    if (idxs.empty()) {
+      unique_image_ids.push_back(image_ids[i]);
+    }
+    idxs.push_back(i);
+  }
+
+  for (size_t start = 0; start < unique_image_ids.size();
+       start += Database::kReadBatchSize) {
+    const size_t end = std::min(unique_image_ids.size(),
+                                start + Database::kReadBatchSize);
+    for (int i = 0; i < Database::kReadBatchSize; ++i) {
+      const size_t idx = start + i < end ? start + i : start;
+      SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, i + 1, unique_image_ids[idx]));
+    }
+
+    int rc;
+    while ((rc = SQLITE3_CALL(sqlite3_step(sql_stmt))) == SQLITE_ROW) {
+      const image_t image_id =
+          static_cast<image_t>(sqlite3_column_int64(sql_stmt, 0));
+      const std::vector<size_t>& idxs = image_id_to_idxs.at(image_id);
+      if (compression_col < 0) {
+        blobs[idxs[0]] = ReadDynamicMatrixBlob<MatrixType>(sql_stmt, rc, 1);
+      } else {
+        blobs[idxs[0]] = ReadEncodedDynamicMatrixBlob<MatrixType>(
+            sql_stmt, rc, 1, compression_col);
+      }
+      for (size_t i = 1; i < idxs.size(); ++i) {
+        blobs[idxs[i]] = blobs[idxs[0]];
+      }
+    }
+
+    SQLITE3_CALL(sqlite3_reset(sql_stmt));
+  }
+
+  return blobs;
+}
+
 template <typename MatrixType>
 void WriteStaticMatrixBlob(sqlite3_stmt* sql_stmt,
                            const MatrixType& matrix,
@@ -201,6 +417,33 @@ void WriteDynamicMatrixBlob(sqlite3_stmt* sql_stmt,
                                  SQLITE_STATIC));
 }
 
+// Bind the matrix like `WriteDynamicMatrixBlob` and its encoding to the
+// `compression_col`. The encoded data is stored in the buffer, which must live
+// until the statement is executed.
+template <typename MatrixType>
+void WriteEncodedDynamicMatrixBlob(sqlite3_stmt* sql_stmt,
+                                   const MatrixType& matrix,
+                                   const int col,
+                                   const int compression_col,
+                                   BlobEncoding encoding,
+                                   std::vector<uint8_t>* buffer) {
+  encoding = EncodeMatrixBlob(matrix, encoding, buffer);
+  if (encoding == BlobEncoding::NONE) {
+    WriteDynamicMatrixBlob(sql_stmt, matrix, col);
+  } else {
+    THROW_CHECK_GE(col, 0);
+    SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, col + 0, matrix.rows()));
+    SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, col + 1, matrix.cols()));
+    SQLITE3_CALL(sqlite3_bind_blob(sql_stmt,
+                                   col + 2,
+                                   buffer->data(),
+                                   static_cast<int>(buffer->size()),
+                                   SQLITE_STATIC));
+  }
+  SQLITE3_CALL(sqlite3_bind_int64(
+      sql_stmt, compression_col, static_cast<sqlite3_int64>(encoding)));
+}
+
 Camera ReadCameraRow(sqlite3_stmt* sql_stmt) {
   Camera camera;
 
@@ -277,12 +520,15 @@ void Database::Open(const std::string& path) {
   // Enable auto vacuum to reduce DB file size
   SQLITE3_EXEC(database_, "PRAGMA auto_vacuum=1", nullptr);
 
+  path_ = path;
+
   CreateTables();
   UpdateSchema();
   PrepareSQLStatements();
 }
 
 void Database::Close() {
+  DetachFeatureStore();
   if (database_ != nullptr) {
     FinalizeSQLStatements();
     if (database_cleared_) {
@@ -292,8 +538,163 @@ void Database::Close() {
     sqlite3_close_v2(database_);
     database_ = nullptr;
   }
+  path_.clear();
+}
+
+std::unique_ptr<Database> Database::OpenReadOnlyConnection() const {
+  THROW_CHECK_NOTNULL(database_);
+  if (path_.empty() || path_ == kInMemoryDatabasePath || feature_store_) {
+    return nullptr;
+  }
+
+  auto database = std::make_unique<Database>();
+  SQLITE3_CALL(sqlite3_open_v2(path_.c_str(),
+                               &database->database_,
+                               SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX,
+                               nullptr));
+  database->path_ = path_;
+
+  // Wait instead of failing, if the writer briefly holds an exclusive lock,
+  // e.g., during a checkpoint of the write-ahead log.
+  SQLITE3_CALL(sqlite3_busy_timeout(database->database_, 5000));
+
+  // Store temporary tables and indices in memory
+  SQLITE3_EXEC(database->database_, "PRAGMA temp_store=MEMORY", nullptr);
+
+  // The schema was already created and updated by this connection.
+  database->PrepareSQLStatements();
+
+  return database;
+}
+
+void Database::OpenShards(const std::vector<std::string>& paths) {
+  THROW_CHECK(!paths.empty());
+
+  Close();
+
+  // Create or update the schema of all shards, so that the views below can
+  // select the same columns from all of them.
+  for (const auto& path : paths) {
+    Database shard(path);
+  }
+
+  SQLITE3_CALL(sqlite3_open_v2(
+      kInMemoryDatabasePath.c_str(),
+      &database_,
+      SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX,
+      nullptr));
+
+  THROW_CHECK_LE(static_cast<int>(paths.size()),
+                 sqlite3_limit(database_, SQLITE_LIMIT_ATTACHED, -1))
+      << "Too many database shards";
+
+  SQLITE3_EXEC(database_, "PRAGMA temp_store=MEMORY", nullptr);
+
+  // The empty tables in the main schema are only used to prepare the
+  // statements and are shadowed by the temporary views created below. The
+  // statements are transparently recompiled against the views on their first
+  // use, after which all modifications fail, since views are read-only.
+  CreateTables();
+  PrepareSQLStatements();
+
+  std::vector<size_t> camera_id_offsets(paths.size(), 0);
+  std::vector<size_t> image_id_offsets(paths.size(), 0);
+  for (size_t i = 0; i < paths.size(); ++i) {
+    const std::string shard = "shard" + std::to_string(i);
+    sqlite3_stmt* sql_stmt;
+    SQLITE3_CALL(sqlite3_prepare_v2(
+        database_, "ATTACH DATABASE ? AS ?;", -1, &sql_stmt, 0));
+    SQLITE3_CALL(sqlite3_bind_text(
+        sql_stmt, 1, paths[i].c_str(), -1, SQLITE_TRANSIENT));
+    SQLITE3_CALL(
+        sqlite3_bind_text(sql_stmt, 2, shard.c_str(), -1, SQLITE_TRANSIENT));
+    SQLITE3_CALL(sqlite3_step(sql_stmt));
+    SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+    if (i + 1 < paths.size()) {
+      camera_id_offsets[i + 1] =
+          camera_id_offsets[i] + MaxColumn("camera_id", shard + ".cameras");
+      image_id_offsets[i + 1] =
+          image_id_offsets[i] + MaxColumn("image_id", shard + ".images");
+    }
+  }
+
+  THROW_CHECK_LT(image_id_offsets.back() +
+                     MaxColumn("image_id",
+                               "shard" + std::to_string(paths.size() - 1) +
+                                   ".images"),
+                 kMaxNumImages);
+
+  const std::vector<std::string> tables = {"cameras",
+                                           "images",
+                                           "pose_priors",
+                                           "keypoints",
+                                           "descriptors",
+                                           "matches",
+                                           "two_view_geometries"};
+  for (const auto& table : tables) {
+    std::vector<std::string> columns;
+    {
+      const std::string sql =
+          StringPrintf("PRAGMA main.table_info(%s);", table.c_str());
+      sqlite3_stmt* sql_stmt;
+      SQLITE3_CALL(
+          sqlite3_prepare_v2(database_, sql.c_str(), -1, &sql_stmt, 0));
+      while (SQLITE3_CALL(sqlite3_step(sql_stmt)) == SQLITE_ROW) {
+        columns.emplace_back(
+            reinterpret_cast<const char*>(sqlite3_column_text(sql_stmt, 1)));
+      }
+      SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+    }
+
+    std::string sql = StringPrintf("CREATE TEMP VIEW %s AS ", table.c_str());
+    for (size_t i = 0; i < paths.size(); ++i) {
+      if (i > 0) {
+        sql += " UNION ALL ";
+      }
+      // Remapping both image identifiers of a pair by the same offset
+      // preserves their order, so that the remapped pair identifier is
+      // kMaxNumImages * (id1 + offset) + (id2 + offset).
+      const size_t pair_id_offset = (kMaxNumImages + 1) * image_id_offsets[i];
+      sql += "SELECT ";
+      for (size_t j = 0; j < columns.size(); ++j) {
+        const std::string& column = columns[j];
+        if (j > 0) {
+          sql += ", ";
+        }
+        if (column == "camera_id") {
+          sql += "camera_id + " + std::to_string(camera_id_offsets[i]) +
+                 " AS camera_id";
+        } else if (column == "image_id") {
+          sql += "image_id + " + std::to_string(image_id_offsets[i]) +
+                 " AS image_id";
+        } else if (column == "pair_id") {
+          sql += "pair_id + " + std::to_string(pair_id_offset) + " AS pair_id";
+        } else {
+          sql += column;
+        }
+      }
+      sql += " FROM shard" + std::to_string(i) + "." + table;
+    }
+    sql += ";";
+    SQLITE3_EXEC(database_, sql.c_str(), nullptr);
+  }
+}
+
+void Database::AttachFeatureStore(const std::string& path) {
+  THROW_CHECK_NOTNULL(database_);
+  feature_store_ = std::make_unique<FeatureStore>(path);
+}
+
+void Database::DetachFeatureStore() { feature_store_.reset(); }
+
+bool Database::HasFeatureStore() const { return feature_store_ != nullptr; }
+
+void Database::SetCompressBlobs(const bool compress) {
+  compress_blobs_ = compress;
 }
 
+bool Database::CompressBlobs() const { return compress_blobs_; }
+
 bool Database::ExistsCamera(const camera_t camera_id) const {
   return ExistsRowId(sql_stmt_exists_camera_, camera_id);
 }
@@ -311,15 +712,25 @@ bool Database::ExistsPosePrior(const image_t image_id) const {
 }
 
 bool Database::ExistsKeypoints(const image_t image_id) const {
+  if (feature_store_) {
+    return feature_store_->ExistsKeypoints(image_id);
+  }
   return ExistsRowId(sql_stmt_exists_keypoints_, image_id);
 }
 
 bool Database::ExistsDescriptors(const image_t image_id) const {
+  if (feature_store_) {
+    return feature_store_->ExistsDescriptors(image_id);
+  }
   return ExistsRowId(sql_stmt_exists_descriptors_, image_id);
 }
 
 bool Database::ExistsMatches(const image_t image_id1,
                              const image_t image_id2) const {
+  if (feature_store_) {
+    return feature_store_->ExistsMatches(
+        ImagePairToPairId(image_id1, image_id2));
+  }
   return ExistsRowId(sql_stmt_exists_matches_,
                      ImagePairToPairId(image_id1, image_id2));
 }
@@ -336,35 +747,65 @@ size_t Database::NumImages() const { return CountRows("images"); }
 
 size_t Database::NumPosePriors() const { return CountRows("pose_priors"); }
 
-size_t Database::NumKeypoints() const { return SumColumn("rows", "keypoints"); }
+size_t Database::NumKeypoints() const {
+  if (feature_store_) {
+    return feature_store_->NumKeypoints();
+  }
+  return SumColumn("rows", "keypoints");
+}
 
 size_t Database::MaxNumKeypoints() const {
+  if (feature_store_) {
+    return feature_store_->MaxNumKeypoints();
+  }
   return MaxColumn("rows", "keypoints");
 }
 
 size_t Database::NumKeypointsForImage(const image_t image_id) const {
+  if (feature_store_) {
+    return feature_store_->NumKeypointsForImage(image_id);
+  }
   return CountRowsForEntry(sql_stmt_num_keypoints_, image_id);
 }
 
 size_t Database::NumDescriptors() const {
+  if (feature_store_) {
+    return feature_store_->NumDescriptors();
+  }
   return SumColumn("rows", "descriptors");
 }
 
 size_t Database::MaxNumDescriptors() const {
+  if (feature_store_) {
+    return feature_store_->MaxNumDescriptors();
+  }
   return MaxColumn("rows", "descriptors");
 }
 
 size_t Database::NumDescriptorsForImage(const image_t image_id) const {
+  if (feature_store_) {
+    return feature_store_->NumDescriptorsForImage(image_id);
+  }
   return CountRowsForEntry(sql_stmt_num_descriptors_, image_id);
 }
 
-size_t Database::NumMatches() const { return SumColumn("rows", "matches"); }
+size_t Database::NumMatches() const {
+  if (feature_store_) {
+    return feature_store_->NumMatches();
+  }
+  return SumColumn("rows", "matches");
+}
 
 size_t Database::NumInlierMatches() const {
   return SumColumn("rows", "two_view_geometries");
 }
 
-size_t Database::NumMatchedImagePairs() const { return CountRows("matches"); }
+size_t Database::NumMatchedImagePairs() const {
+  if (feature_store_) {
+    return feature_store_->NumMatchedImagePairs();
+  }
+  return CountRows("matches");
+}
 
 size_t Database::NumVerifiedImagePairs() const {
   return CountRows("two_view_geometries");
@@ -444,6 +885,45 @@ std::vector<Image> Database::ReadAllImages() const {
   return images;
 }
 
+std::unordered_map<image_t, uint64_t> Database::ReadAllImageContentHashes()
+    const {
+  std::unordered_map<image_t, uint64_t> content_hashes;
+  while (SQLITE3_CALL(sqlite3_step(sql_stmt_read_image_content_hashes_)) ==
+         SQLITE_ROW) {
+    const image_t image_id = static_cast<image_t>(
+        sqlite3_column_int64(sql_stmt_read_image_content_hashes_, 0));
+    content_hashes.emplace(
+        image_id,
+        static_cast<uint64_t>(
+            sqlite3_column_int64(sql_stmt_read_image_content_hashes_, 1)));
+  }
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_image_content_hashes_));
+  return content_hashes;
+}
+
+std::unordered_set<image_t> Database::ReadImageIdsWithFeatures() const {
+  std::unordered_set<image_t> image_ids;
+
+  if (feature_store_) {
+    for (const Image& image : ReadAllImages()) {
+      if (feature_store_->ExistsKeypoints(image.ImageId()) &&
+          feature_store_->ExistsDescriptors(image.ImageId())) {
+        image_ids.insert(image.ImageId());
+      }
+    }
+    return image_ids;
+  }
+
+  while (SQLITE3_CALL(sqlite3_step(sql_stmt_read_image_ids_with_features_)) ==
+         SQLITE_ROW) {
+    image_ids.insert(static_cast<image_t>(
+        sqlite3_column_int64(sql_stmt_read_image_ids_with_features_, 0)));
+  }
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_image_ids_with_features_));
+
+  return image_ids;
+}
+
 PosePrior Database::ReadPosePrior(const image_t image_id) const {
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_pose_prior_, 1, image_id));
   PosePrior prior;
@@ -458,7 +938,29 @@ PosePrior Database::ReadPosePrior(const image_t image_id) const {
   return prior;
 }
 
+std::unordered_map<image_t, PosePrior> Database::ReadAllPosePriors() const {
+  std::unordered_map<image_t, PosePrior> priors;
+  priors.reserve(NumPosePriors());
+  int rc;
+  while ((rc = SQLITE3_CALL(sqlite3_step(sql_stmt_read_pose_priors_))) ==
+         SQLITE_ROW) {
+    const image_t image_id = static_cast<image_t>(
+        sqlite3_column_int64(sql_stmt_read_pose_priors_, 0));
+    PosePrior& prior = priors[image_id];
+    prior.position = ReadStaticMatrixBlob<Eigen::Vector3d>(
+        sql_stmt_read_pose_priors_, rc, 1);
+    prior.coordinate_system = static_cast<PosePrior::CoordinateSystem>(
+        sqlite3_column_int64(sql_stmt_read_pose_priors_, 2));
+  }
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_pose_priors_));
+  return priors;
+}
+
 FeatureKeypointsBlob Database::ReadKeypointsBlob(const image_t image_id) const {
+  if (feature_store_) {
+    return feature_store_->ReadKeypointsBlob(image_id);
+  }
+
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_keypoints_, 1, image_id));
 
   const int rc = SQLITE3_CALL(sqlite3_step(sql_stmt_read_keypoints_));
@@ -474,27 +976,82 @@ FeatureKeypoints Database::ReadKeypoints(const image_t image_id) const {
 }
 
 FeatureDescriptors Database::ReadDescriptors(const image_t image_id) const {
+  if (feature_store_) {
+    return feature_store_->ReadDescriptors(image_id);
+  }
+
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_descriptors_, 1, image_id));
 
   const int rc = SQLITE3_CALL(sqlite3_step(sql_stmt_read_descriptors_));
-  FeatureDescriptors descriptors = ReadDynamicMatrixBlob<FeatureDescriptors>(
-      sql_stmt_read_descriptors_, rc, 0);
+  FeatureDescriptors descriptors =
+      ReadEncodedDynamicMatrixBlob<FeatureDescriptors>(
+          sql_stmt_read_descriptors_, rc, 0, 3);
 
   SQLITE3_CALL(sqlite3_reset(sql_stmt_read_descriptors_));
 
   return descriptors;
 }
 
+std::vector<FeatureKeypointsBlob> Database::ReadKeypointsBlobs(
+    const std::vector<image_t>& image_ids) const {
+  if (feature_store_) {
+    std::vector<FeatureKeypointsBlob> blobs;
+    blobs.reserve(image_ids.size());
+    for (const image_t image_id : image_ids) {
+      blobs.emplace_back(feature_store_->ReadKeypointsBlob(image_id));
+    }
+    return blobs;
+  }
+
+  return ReadDynamicMatrixBlobsBatched<FeatureKeypointsBlob>(
+      sql_stmt_read_keypoints_batch_, image_ids);
+}
+
+std::vector<FeatureKeypoints> Database::ReadKeypoints(
+    const std::vector<image_t>& image_ids) const {
+  const std::vector<FeatureKeypointsBlob> blobs = ReadKeypointsBlobs(image_ids);
+  std::vector<FeatureKeypoints> keypoints;
+  keypoints.reserve(blobs.size());
+  for (const auto& blob : blobs) {
+    // Images without keypoints have an empty blob without columns.
+    if (blob.rows() == 0) {
+      keypoints.emplace_back();
+    } else {
+      keypoints.push_back(FeatureKeypointsFromBlob(blob));
+    }
+  }
+  return keypoints;
+}
+
+std::vector<FeatureDescriptors> Database::ReadDescriptors(
+    const std::vector<image_t>& image_ids) const {
+  if (feature_store_) {
+    std::vector<FeatureDescriptors> descriptors;
+    descriptors.reserve(image_ids.size());
+    for (const image_t image_id : image_ids) {
+      descriptors.emplace_back(feature_store_->ReadDescriptors(image_id));
+    }
+    return descriptors;
+  }
+
+  return ReadDynamicMatrixBlobsBatched<FeatureDescriptors>(
+      sql_stmt_read_descriptors_batch_, image_ids, /*compression_col=*/4);
+}
+
 FeatureMatchesBlob Database::ReadMatchesBlob(image_t image_id1,
                                              image_t image_id2) const {
   const image_pair_t pair_id = ImagePairToPairId(image_id1, image_id2);
-  SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_matches_, 1, pair_id));
-
-  const int rc = SQLITE3_CALL(sqlite3_step(sql_stmt_read_matches_));
-  FeatureMatchesBlob blob =
-      ReadDynamicMatrixBlob<FeatureMatchesBlob>(sql_stmt_read_matches_, rc, 0);
 
-  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_matches_));
+  FeatureMatchesBlob blob;
+  if (feature_store_) {
+    blob = feature_store_->ReadMatchesBlob(pair_id);
+  } else {
+    SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_read_matches_, 1, pair_id));
+    const int rc = SQLITE3_CALL(sqlite3_step(sql_stmt_read_matches_));
+    blob = ReadEncodedDynamicMatrixBlob<FeatureMatchesBlob>(
+        sql_stmt_read_matches_, rc, 0, 3);
+    SQLITE3_CALL(sqlite3_reset(sql_stmt_read_matches_));
+  }
 
   if (SwapImagePair(image_id1, image_id2)) {
     SwapFeatureMatchesBlob(&blob);
@@ -510,20 +1067,38 @@ FeatureMatches Database::ReadMatches(image_t image_id1,
 std::vector<std::pair<image_pair_t, FeatureMatches>> Database::ReadAllMatches()
     const {
   std::vector<std::pair<image_pair_t, FeatureMatches>> all_matches;
+  ReadAllMatches([&all_matches](const image_pair_t pair_id,
+                                FeatureMatches matches) {
+    all_matches.emplace_back(pair_id, std::move(matches));
+  });
+  return all_matches;
+}
+
+void Database::ReadAllMatches(
+    const std::function<void(image_pair_t, FeatureMatches)>& callback) const {
+  if (feature_store_) {
+    for (const image_pair_t pair_id :
+         feature_store_->ReadMatchedImagePairIds()) {
+      const auto blob = feature_store_->ReadMatchesBlob(pair_id);
+      if (blob.rows() > 0) {
+        callback(pair_id, FeatureMatchesFromBlob(blob));
+      }
+    }
+    return;
+  }
 
   int rc;
   while ((rc = SQLITE3_CALL(sqlite3_step(sql_stmt_read_matches_all_))) ==
          SQLITE_ROW) {
     const image_pair_t pair_id = static_cast<image_pair_t>(
         sqlite3_column_int64(sql_stmt_read_matches_all_, 0));
-    const FeatureMatchesBlob blob = ReadDynamicMatrixBlob<FeatureMatchesBlob>(
-        sql_stmt_read_matches_all_, rc, 1);
-    all_matches.emplace_back(pair_id, FeatureMatchesFromBlob(blob));
+    const FeatureMatchesBlob blob =
+        ReadEncodedDynamicMatrixBlob<FeatureMatchesBlob>(
+            sql_stmt_read_matches_all_, rc, 1, 4);
+    callback(pair_id, FeatureMatchesFromBlob(blob));
   }
 
   SQLITE3_CALL(sqlite3_reset(sql_stmt_read_matches_all_));
-
-  return all_matches;
 }
 
 TwoViewGeometry Database::ReadTwoViewGeometry(const image_t image_id1,
@@ -536,8 +1111,8 @@ TwoViewGeometry Database::ReadTwoViewGeometry(const image_t image_id1,
 
   TwoViewGeometry two_view_geometry;
 
-  FeatureMatchesBlob blob = ReadDynamicMatrixBlob<FeatureMatchesBlob>(
-      sql_stmt_read_two_view_geometry_, rc, 0);
+  FeatureMatchesBlob blob = ReadEncodedDynamicMatrixBlob<FeatureMatchesBlob>(
+      sql_stmt_read_two_view_geometry_, rc, 0, 9);
 
   two_view_geometry.config = static_cast<int>(
       sqlite3_column_int64(sql_stmt_read_two_view_geometry_, 3));
@@ -573,17 +1148,27 @@ TwoViewGeometry Database::ReadTwoViewGeometry(const image_t image_id1,
 void Database::ReadTwoViewGeometries(
     std::vector<image_pair_t>* image_pair_ids,
     std::vector<TwoViewGeometry>* two_view_geometries) const {
+  ReadTwoViewGeometries([image_pair_ids, two_view_geometries](
+                            const image_pair_t pair_id,
+                            TwoViewGeometry two_view_geometry) {
+    image_pair_ids->push_back(pair_id);
+    two_view_geometries->push_back(std::move(two_view_geometry));
+  });
+}
+
+void Database::ReadTwoViewGeometries(
+    const std::function<void(image_pair_t, TwoViewGeometry)>& callback) const {
   int rc;
   while ((rc = SQLITE3_CALL(sqlite3_step(
               sql_stmt_read_two_view_geometries_))) == SQLITE_ROW) {
     const image_pair_t pair_id = static_cast<image_pair_t>(
         sqlite3_column_int64(sql_stmt_read_two_view_geometries_, 0));
-    image_pair_ids->push_back(pair_id);
 
     TwoViewGeometry two_view_geometry;
 
-    const FeatureMatchesBlob blob = ReadDynamicMatrixBlob<FeatureMatchesBlob>(
-        sql_stmt_read_two_view_geometries_, rc, 1);
+    const FeatureMatchesBlob blob =
+        ReadEncodedDynamicMatrixBlob<FeatureMatchesBlob>(
+            sql_stmt_read_two_view_geometries_, rc, 1, 10);
     two_view_geometry.inlier_matches = FeatureMatchesFromBlob(blob);
 
     two_view_geometry.config = static_cast<int>(
@@ -607,7 +1192,7 @@ void Database::ReadTwoViewGeometries(
     two_view_geometry.E.transposeInPlace();
     two_view_geometry.H.transposeInPlace();
 
-    two_view_geometries->push_back(two_view_geometry);
+    callback(pair_id, std::move(two_view_geometry));
   }
 
   SQLITE3_CALL(sqlite3_reset(sql_stmt_read_two_view_geometries_));
@@ -615,26 +1200,61 @@ void Database::ReadTwoViewGeometries(
 
 void Database::ReadTwoViewGeometryNumInliers(
     std::vector<std::pair<image_t, image_t>>* image_pairs,
-    std::vector<int>* num_inliers) const {
-  const auto num_inlier_matches = NumInlierMatches();
-  image_pairs->reserve(num_inlier_matches);
-  num_inliers->reserve(num_inlier_matches);
+    std::vector<int>* num_inliers,
+    std::vector<int>* configs) const {
+  const size_t num_verified_image_pairs = NumVerifiedImagePairs();
+  image_pairs->reserve(num_verified_image_pairs);
+  num_inliers->reserve(num_verified_image_pairs);
+  if (configs != nullptr) {
+    configs->reserve(num_verified_image_pairs);
+  }
+
+  ReadTwoViewGeometryNumInliers([&](const image_pair_t pair_id,
+                                    const int pair_num_inliers,
+                                    const int config) {
+    image_pairs->push_back(PairIdToImagePair(pair_id));
+    num_inliers->push_back(pair_num_inliers);
+    if (configs != nullptr) {
+      configs->push_back(config);
+    }
+  });
+}
 
+void Database::ReadTwoViewGeometryNumInliers(
+    const std::function<void(image_pair_t, int, int)>& callback) const {
   while (SQLITE3_CALL(sqlite3_step(
              sql_stmt_read_two_view_geometry_num_inliers_)) == SQLITE_ROW) {
     const image_pair_t pair_id = static_cast<image_pair_t>(
         sqlite3_column_int64(sql_stmt_read_two_view_geometry_num_inliers_, 0));
-    const auto image_pair = PairIdToImagePair(pair_id);
-    image_pairs->emplace_back(image_pair.first, image_pair.second);
-
     const int rows = static_cast<int>(
         sqlite3_column_int64(sql_stmt_read_two_view_geometry_num_inliers_, 1));
-    num_inliers->push_back(rows);
+    const int config = static_cast<int>(
+        sqlite3_column_int64(sql_stmt_read_two_view_geometry_num_inliers_, 2));
+    callback(pair_id, rows, config);
   }
 
   SQLITE3_CALL(sqlite3_reset(sql_stmt_read_two_view_geometry_num_inliers_));
 }
 
+void Database::ReadNumMatches(
+    std::vector<std::pair<image_t, image_t>>* image_pairs,
+    std::vector<int>* num_matches) const {
+  const size_t num_matched_image_pairs = NumMatchedImagePairs();
+  image_pairs->reserve(num_matched_image_pairs);
+  num_matches->reserve(num_matched_image_pairs);
+
+  while (SQLITE3_CALL(sqlite3_step(sql_stmt_read_num_matches_)) ==
+         SQLITE_ROW) {
+    const image_pair_t pair_id = static_cast<image_pair_t>(
+        sqlite3_column_int64(sql_stmt_read_num_matches_, 0));
+    image_pairs->push_back(PairIdToImagePair(pair_id));
+    num_matches->push_back(
+        static_cast<int>(sqlite3_column_int64(sql_stmt_read_num_matches_, 1)));
+  }
+
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_read_num_matches_));
+}
+
 camera_t Database::WriteCamera(const Camera& camera,
                                const bool use_camera_id) const {
   if (use_camera_id) {
@@ -708,6 +1328,13 @@ void Database::WriteKeypoints(const image_t image_id,
 
 void Database::WriteKeypoints(const image_t image_id,
                               const FeatureKeypointsBlob& blob) const {
+  if (feature_store_) {
+    THROW_CHECK(!feature_store_->ExistsKeypoints(image_id))
+        << "Keypoints for image_id " << image_id << " already exist";
+    feature_store_->WriteKeypoints(image_id, blob);
+    return;
+  }
+
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_write_keypoints_, 1, image_id));
   WriteDynamicMatrixBlob(sql_stmt_write_keypoints_, blob, 2);
 
@@ -717,8 +1344,22 @@ void Database::WriteKeypoints(const image_t image_id,
 
 void Database::WriteDescriptors(const image_t image_id,
                                 const FeatureDescriptors& descriptors) const {
+  if (feature_store_) {
+    THROW_CHECK(!feature_store_->ExistsDescriptors(image_id))
+        << "Descriptors for image_id " << image_id << " already exist";
+    feature_store_->WriteDescriptors(image_id, descriptors);
+    return;
+  }
+
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_write_descriptors_, 1, image_id));
-  WriteDynamicMatrixBlob(sql_stmt_write_descriptors_, descriptors, 2);
+  std::vector<uint8_t> buffer;
+  WriteEncodedDynamicMatrixBlob(
+      sql_stmt_write_descriptors_,
+      descriptors,
+      2,
+      5,
+      compress_blobs_ ? BlobEncoding::LZ4 : BlobEncoding::NONE,
+      &buffer);
 
   SQLITE3_CALL(sqlite3_step(sql_stmt_write_descriptors_));
   SQLITE3_CALL(sqlite3_reset(sql_stmt_write_descriptors_));
@@ -734,17 +1375,40 @@ void Database::WriteMatches(const image_t image_id1,
                             const image_t image_id2,
                             const FeatureMatchesBlob& blob) const {
   const image_pair_t pair_id = ImagePairToPairId(image_id1, image_id2);
+
+  if (feature_store_) {
+    THROW_CHECK(!feature_store_->ExistsMatches(pair_id))
+        << "Matches for image pair " << image_id1 << ", " << image_id2
+        << " already exist";
+    if (SwapImagePair(image_id1, image_id2)) {
+      FeatureMatchesBlob swapped_blob = blob;
+      SwapFeatureMatchesBlob(&swapped_blob);
+      feature_store_->WriteMatches(pair_id, swapped_blob);
+    } else {
+      feature_store_->WriteMatches(pair_id, blob);
+    }
+    return;
+  }
+
   SQLITE3_CALL(sqlite3_bind_int64(sql_stmt_write_matches_, 1, pair_id));
 
-  // Important: the swapped data must live until the query is executed.
+  // Important: the swapped and encoded data must live until the query is
+  // executed.
   FeatureMatchesBlob swapped_blob;
+  const FeatureMatchesBlob* blob_ptr = &blob;
   if (SwapImagePair(image_id1, image_id2)) {
     swapped_blob = blob;
     SwapFeatureMatchesBlob(&swapped_blob);
-    WriteDynamicMatrixBlob(sql_stmt_write_matches_, swapped_blob, 2);
-  } else {
-    WriteDynamicMatrixBlob(sql_stmt_write_matches_, blob, 2);
+    blob_ptr = &swapped_blob;
   }
+  std::vector<uint8_t> buffer;
+  WriteEncodedDynamicMatrixBlob(
+      sql_stmt_write_matches_,
+      *blob_ptr,
+      2,
+      5,
+      compress_blobs_ ? BlobEncoding::DELTA_VARINT : BlobEncoding::NONE,
+      &buffer);
 
   SQLITE3_CALL(sqlite3_step(sql_stmt_write_matches_));
   SQLITE3_CALL(sqlite3_reset(sql_stmt_write_matches_));
@@ -771,7 +1435,14 @@ void Database::WriteTwoViewGeometry(
 
   const FeatureMatchesBlob inlier_matches =
       FeatureMatchesToBlob(two_view_geometry_ptr->inlier_matches);
-  WriteDynamicMatrixBlob(sql_stmt_write_two_view_geometry_, inlier_matches, 2);
+  std::vector<uint8_t> buffer;
+  WriteEncodedDynamicMatrixBlob(
+      sql_stmt_write_two_view_geometry_,
+      inlier_matches,
+      2,
+      11,
+      compress_blobs_ ? BlobEncoding::DELTA_VARINT : BlobEncoding::NONE,
+      &buffer);
 
   SQLITE3_CALL(sqlite3_bind_int64(
       sql_stmt_write_two_view_geometry_, 5, two_view_geometry_ptr->config));
@@ -851,9 +1522,28 @@ void Database::UpdateImage(const Image& image) const {
   SQLITE3_CALL(sqlite3_reset(sql_stmt_update_image_));
 }
 
+void Database::WriteImageContentHash(const image_t image_id,
+                                     const uint64_t content_hash) const {
+  // SQLite only supports signed 64-bit integers, so the hash is stored with
+  // the same bit pattern reinterpreted as a signed value.
+  SQLITE3_CALL(
+      sqlite3_bind_int64(sql_stmt_update_image_content_hash_,
+                         1,
+                         static_cast<sqlite3_int64>(content_hash)));
+  SQLITE3_CALL(
+      sqlite3_bind_int64(sql_stmt_update_image_content_hash_, 2, image_id));
+
+  SQLITE3_CALL(sqlite3_step(sql_stmt_update_image_content_hash_));
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_update_image_content_hash_));
+}
+
 void Database::DeleteMatches(const image_t image_id1,
                              const image_t image_id2) const {
   const image_pair_t pair_id = ImagePairToPairId(image_id1, image_id2);
+  if (feature_store_) {
+    feature_store_->DeleteMatches(pair_id);
+    return;
+  }
   SQLITE3_CALL(sqlite3_bind_int64(
       sql_stmt_delete_matches_, 1, static_cast<sqlite3_int64>(pair_id)));
   SQLITE3_CALL(sqlite3_step(sql_stmt_delete_matches_));
@@ -872,6 +1562,167 @@ void Database::DeleteInlierMatches(const image_t image_id1,
   database_cleared_ = true;
 }
 
+void Database::DeleteImageFeatures(const image_t image_id) const {
+  if (feature_store_) {
+    feature_store_->DeleteKeypoints(image_id);
+    feature_store_->DeleteDescriptors(image_id);
+    for (const image_pair_t pair_id :
+         feature_store_->ReadMatchedImagePairIds()) {
+      const auto image_pair = PairIdToImagePair(pair_id);
+      if (image_pair.first == image_id || image_pair.second == image_id) {
+        feature_store_->DeleteMatches(pair_id);
+      }
+    }
+  } else {
+    for (sqlite3_stmt* sql_stmt : {sql_stmt_delete_keypoints_,
+                                   sql_stmt_delete_descriptors_,
+                                   sql_stmt_delete_image_matches_}) {
+      SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, 1, image_id));
+      SQLITE3_CALL(sqlite3_step(sql_stmt));
+      SQLITE3_CALL(sqlite3_reset(sql_stmt));
+    }
+  }
+
+  SQLITE3_CALL(sqlite3_bind_int64(
+      sql_stmt_delete_image_two_view_geometries_, 1, image_id));
+  SQLITE3_CALL(sqlite3_step(sql_stmt_delete_image_two_view_geometries_));
+  SQLITE3_CALL(sqlite3_reset(sql_stmt_delete_image_two_view_geometries_));
+
+  database_cleared_ = true;
+}
+
+void Database::DeleteImages(const std::vector<image_t>& image_ids) const {
+  if (image_ids.empty()) {
+    return;
+  }
+
+  SQLITE3_EXEC(database_,
+               "CREATE TEMP TABLE IF NOT EXISTS delete_image_ids"
+               "(image_id INTEGER PRIMARY KEY NOT NULL);"
+               "DELETE FROM temp.delete_image_ids;",
+               nullptr);
+  sqlite3_stmt* sql_stmt;
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_,
+      "INSERT OR IGNORE INTO temp.delete_image_ids(image_id) VALUES(?);",
+      -1,
+      &sql_stmt,
+      0));
+  for (const image_t image_id : image_ids) {
+    SQLITE3_CALL(sqlite3_bind_int64(sql_stmt, 1, image_id));
+    SQLITE3_CALL(sqlite3_step(sql_stmt));
+    SQLITE3_CALL(sqlite3_reset(sql_stmt));
+  }
+  SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+
+  // The image identifiers of a pair are encoded as
+  // pair_id = kMaxNumImages * image_id1 + image_id2.
+  const std::string pair_ids_sql = StringPrintf(
+      "pair_id / %d IN (SELECT image_id FROM temp.delete_image_ids) OR "
+      "pair_id %% %d IN (SELECT image_id FROM temp.delete_image_ids);",
+      kMaxNumImages,
+      kMaxNumImages);
+
+  if (feature_store_) {
+    const std::unordered_set<image_t> image_ids_set(image_ids.begin(),
+                                                    image_ids.end());
+    for (const image_t image_id : image_ids_set) {
+      feature_store_->DeleteKeypoints(image_id);
+      feature_store_->DeleteDescriptors(image_id);
+    }
+    for (const image_pair_t pair_id :
+         feature_store_->ReadMatchedImagePairIds()) {
+      const auto image_pair = PairIdToImagePair(pair_id);
+      if (image_ids_set.count(image_pair.first) > 0 ||
+          image_ids_set.count(image_pair.second) > 0) {
+        feature_store_->DeleteMatches(pair_id);
+      }
+    }
+  } else {
+    SQLITE3_EXEC(database_,
+                 "DELETE FROM keypoints WHERE image_id IN "
+                 "(SELECT image_id FROM temp.delete_image_ids);"
+                 "DELETE FROM descriptors WHERE image_id IN "
+                 "(SELECT image_id FROM temp.delete_image_ids);",
+                 nullptr);
+    SQLITE3_EXEC(database_,
+                 ("DELETE FROM matches WHERE " + pair_ids_sql).c_str(),
+                 nullptr);
+  }
+
+  SQLITE3_EXEC(
+      database_,
+      ("DELETE FROM two_view_geometries WHERE " + pair_ids_sql).c_str(),
+      nullptr);
+  SQLITE3_EXEC(database_,
+               "DELETE FROM pose_priors WHERE image_id IN "
+               "(SELECT image_id FROM temp.delete_image_ids);"
+               "DELETE FROM images WHERE image_id IN "
+               "(SELECT image_id FROM temp.delete_image_ids);"
+               "DROP TABLE temp.delete_image_ids;",
+               nullptr);
+
+  database_cleared_ = true;
+}
+
+void Database::DeleteImagePairs(
+    const std::vector<image_pair_t>& pair_ids) const {
+  if (pair_ids.empty()) {
+    return;
+  }
+
+  SQLITE3_EXEC(database_,
+               "CREATE TEMP TABLE IF NOT EXISTS delete_pair_ids"
+               "(pair_id INTEGER PRIMARY KEY NOT NULL);"
+               "DELETE FROM temp.delete_pair_ids;",
+               nullptr);
+  sqlite3_stmt* sql_stmt;
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_,
+      "INSERT OR IGNORE INTO temp.delete_pair_ids(pair_id) VALUES(?);",
+      -1,
+      &sql_stmt,
+      0));
+  for (const image_pair_t pair_id : pair_ids) {
+    SQLITE3_CALL(sqlite3_bind_int64(
+        sql_stmt, 1, static_cast<sqlite3_int64>(pair_id)));
+    SQLITE3_CALL(sqlite3_step(sql_stmt));
+    SQLITE3_CALL(sqlite3_reset(sql_stmt));
+  }
+  SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+
+  if (feature_store_) {
+    for (const image_pair_t pair_id : pair_ids) {
+      feature_store_->DeleteMatches(pair_id);
+    }
+  } else {
+    SQLITE3_EXEC(database_,
+                 "DELETE FROM matches WHERE pair_id IN "
+                 "(SELECT pair_id FROM temp.delete_pair_ids);",
+                 nullptr);
+  }
+
+  SQLITE3_EXEC(database_,
+               "DELETE FROM two_view_geometries WHERE pair_id IN "
+               "(SELECT pair_id FROM temp.delete_pair_ids);"
+               "DROP TABLE temp.delete_pair_ids;",
+               nullptr);
+
+  database_cleared_ = true;
+}
+
+void Database::VacuumInto(const std::string& path) const {
+  THROW_CHECK(!ExistsFile(path)) << "Database file already exists: " << path;
+  sqlite3_stmt* sql_stmt;
+  SQLITE3_CALL(
+      sqlite3_prepare_v2(database_, "VACUUM INTO ?;", -1, &sql_stmt, 0));
+  SQLITE3_CALL(sqlite3_bind_text(
+      sql_stmt, 1, path.c_str(), static_cast<int>(path.size()), SQLITE_STATIC));
+  SQLITE3_CALL(sqlite3_step(sql_stmt));
+  SQLITE3_CALL(sqlite3_finalize(sql_stmt));
+  database_cleared_ = false;
+}
+
 void Database::ClearAllTables() const {
   ClearMatches();
   ClearTwoViewGeometries();
@@ -889,6 +1740,10 @@ void Database::ClearCameras() const {
 }
 
 void Database::ClearImages() const {
+  if (feature_store_) {
+    feature_store_->ClearKeypoints();
+    feature_store_->ClearDescriptors();
+  }
   SQLITE3_CALL(sqlite3_step(sql_stmt_clear_images_));
   SQLITE3_CALL(sqlite3_reset(sql_stmt_clear_images_));
   database_cleared_ = true;
@@ -901,18 +1756,30 @@ void Database::ClearPosePriors() const {
 }
 
 void Database::ClearDescriptors() const {
+  if (feature_store_) {
+    feature_store_->ClearDescriptors();
+    return;
+  }
   SQLITE3_CALL(sqlite3_step(sql_stmt_clear_descriptors_));
   SQLITE3_CALL(sqlite3_reset(sql_stmt_clear_descriptors_));
   database_cleared_ = true;
 }
 
 void Database::ClearKeypoints() const {
+  if (feature_store_) {
+    feature_store_->ClearKeypoints();
+    return;
+  }
   SQLITE3_CALL(sqlite3_step(sql_stmt_clear_keypoints_));
   SQLITE3_CALL(sqlite3_reset(sql_stmt_clear_keypoints_));
   database_cleared_ = true;
 }
 
 void Database::ClearMatches() const {
+  if (feature_store_) {
+    feature_store_->ClearMatches();
+    return;
+  }
   SQLITE3_CALL(sqlite3_step(sql_stmt_clear_matches_));
   SQLITE3_CALL(sqlite3_reset(sql_stmt_clear_matches_));
   database_cleared_ = true;
@@ -981,59 +1848,100 @@ void Database::Merge(const Database& database1,
     }
   }
 
-  // Merge the matches.
-
-  for (const auto& matches : database1.ReadAllMatches()) {
-    const auto image_pair = Database::PairIdToImagePair(matches.first);
-
-    const image_t new_image_id1 = new_image_ids1.at(image_pair.first);
-    const image_t new_image_id2 = new_image_ids1.at(image_pair.second);
-
-    merged_database->WriteMatches(new_image_id1, new_image_id2, matches.second);
-  }
-
-  for (const auto& matches : database2.ReadAllMatches()) {
-    const auto image_pair = Database::PairIdToImagePair(matches.first);
-
-    const image_t new_image_id1 = new_image_ids2.at(image_pair.first);
-    const image_t new_image_id2 = new_image_ids2.at(image_pair.second);
-
-    merged_database->WriteMatches(new_image_id1, new_image_id2, matches.second);
+  // Merge the matches and two-view geometries.
+
+  auto MergeImagePairs =
+      [merged_database](
+          const Database& database,
+          const std::unordered_map<image_t, image_t>& new_image_ids) {
+        database.ReadAllMatches([&](const image_pair_t pair_id,
+                                    const FeatureMatches& matches) {
+          const auto image_pair = Database::PairIdToImagePair(pair_id);
+          merged_database->WriteMatches(new_image_ids.at(image_pair.first),
+                                        new_image_ids.at(image_pair.second),
+                                        matches);
+        });
+        database.ReadTwoViewGeometries(
+            [&](const image_pair_t pair_id,
+                const TwoViewGeometry& two_view_geometry) {
+              const auto image_pair = Database::PairIdToImagePair(pair_id);
+              merged_database->WriteTwoViewGeometry(
+                  new_image_ids.at(image_pair.first),
+                  new_image_ids.at(image_pair.second),
+                  two_view_geometry);
+            });
+      };
+
+  MergeImagePairs(database1, new_image_ids1);
+  MergeImagePairs(database2, new_image_ids2);
+}
+
+void Database::MergeImagePairs(const Database& source_database,
+                               Database* target_database) {
+  THROW_CHECK_NOTNULL(target_database);
+  THROW_CHECK_NE(&source_database, target_database);
+
+  std::unordered_map<std::string, image_t> target_image_name_to_id;
+  for (const auto& image : target_database->ReadAllImages()) {
+    target_image_name_to_id.emplace(image.Name(), image.ImageId());
   }
 
-  // Merge the two-view geometries.
-
-  {
-    std::vector<image_pair_t> image_pair_ids;
-    std::vector<TwoViewGeometry> two_view_geometries;
-    database1.ReadTwoViewGeometries(&image_pair_ids, &two_view_geometries);
-
-    for (size_t i = 0; i < two_view_geometries.size(); ++i) {
-      const auto image_pair = Database::PairIdToImagePair(image_pair_ids[i]);
-
-      const image_t new_image_id1 = new_image_ids1.at(image_pair.first);
-      const image_t new_image_id2 = new_image_ids1.at(image_pair.second);
-
-      merged_database->WriteTwoViewGeometry(
-          new_image_id1, new_image_id2, two_view_geometries[i]);
+  std::unordered_map<image_t, image_t> new_image_ids;
+  for (const auto& image : source_database.ReadAllImages()) {
+    const auto it = target_image_name_to_id.find(image.Name());
+    if (it == target_image_name_to_id.end()) {
+      LOG(WARNING) << "Skipping image pairs of image " << image.Name()
+                   << ", which does not exist in the target database";
+    } else {
+      new_image_ids.emplace(image.ImageId(), it->second);
     }
   }
 
-  {
-    std::vector<image_pair_t> image_pair_ids;
-    std::vector<TwoViewGeometry> two_view_geometries;
-    database2.ReadTwoViewGeometries(&image_pair_ids, &two_view_geometries);
-
-    for (size_t i = 0; i < two_view_geometries.size(); ++i) {
-      const auto image_pair = Database::PairIdToImagePair(image_pair_ids[i]);
-
-      const image_t new_image_id1 = new_image_ids2.at(image_pair.first);
-      const image_t new_image_id2 = new_image_ids2.at(image_pair.second);
-
-      merged_database->WriteTwoViewGeometry(
-          new_image_id1, new_image_id2, two_view_geometries[i]);
+  // Map the image pair to the target database or return false, if one of the
+  // images does not exist in the target database.
+  auto MapImagePair = [&new_image_ids](
+                          const image_pair_t pair_id,
+                          std::pair<image_t, image_t>* image_pair) {
+    const auto source_image_pair = PairIdToImagePair(pair_id);
+    const auto it1 = new_image_ids.find(source_image_pair.first);
+    const auto it2 = new_image_ids.find(source_image_pair.second);
+    if (it1 == new_image_ids.end() || it2 == new_image_ids.end()) {
+      return false;
     }
-  }
+    image_pair->first = it1->second;
+    image_pair->second = it2->second;
+    return true;
+  };
+
+  source_database.ReadAllMatches(
+      [&](const image_pair_t pair_id, const FeatureMatches& matches) {
+        std::pair<image_t, image_t> image_pair;
+        if (!MapImagePair(pair_id, &image_pair)) {
+          return;
+        }
+        if (target_database->ExistsMatches(image_pair.first,
+                                           image_pair.second)) {
+          target_database->DeleteMatches(image_pair.first, image_pair.second);
+        }
+        target_database->WriteMatches(
+            image_pair.first, image_pair.second, matches);
+      });
+
+  source_database.ReadTwoViewGeometries(
+      [&](const image_pair_t pair_id,
+          const TwoViewGeometry& two_view_geometry) {
+        std::pair<image_t, image_t> image_pair;
+        if (!MapImagePair(pair_id, &image_pair)) {
+          return;
+        }
+        if (target_database->ExistsInlierMatches(image_pair.first,
+                                                 image_pair.second)) {
+          target_database->DeleteInlierMatches(image_pair.first,
+                                               image_pair.second);
+        }
+        target_database->WriteTwoViewGeometry(
+            image_pair.first, image_pair.second, two_view_geometry);
+      });
 }
 
 void Database::BeginTransaction() const {
@@ -1135,6 +2043,11 @@ void Database::PrepareSQLStatements() {
       database_, sql.c_str(), -1, &sql_stmt_update_image_, 0));
   sql_stmts_.push_back(sql_stmt_update_image_);
 
+  sql = "UPDATE images SET content_hash=? WHERE image_id=?;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_update_image_content_hash_, 0));
+  sql_stmts_.push_back(sql_stmt_update_image_content_hash_);
+
   //////////////////////////////////////////////////////////////////////////////
   // read_*
   //////////////////////////////////////////////////////////////////////////////
@@ -1163,44 +2076,95 @@ void Database::PrepareSQLStatements() {
       database_, sql.c_str(), -1, &sql_stmt_read_images_, 0));
   sql_stmts_.push_back(sql_stmt_read_images_);
 
+  sql =
+      "SELECT image_id, content_hash FROM images WHERE content_hash IS NOT "
+      "NULL;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_read_image_content_hashes_, 0));
+  sql_stmts_.push_back(sql_stmt_read_image_content_hashes_);
+
+  sql =
+      "SELECT keypoints.image_id FROM keypoints INNER JOIN descriptors ON "
+      "keypoints.image_id = descriptors.image_id;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_read_image_ids_with_features_, 0));
+  sql_stmts_.push_back(sql_stmt_read_image_ids_with_features_);
+
   sql = "SELECT * FROM pose_priors WHERE image_id = ?;";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_read_pose_prior_, 0));
   sql_stmts_.push_back(sql_stmt_read_pose_prior_);
 
+  sql = "SELECT * FROM pose_priors;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_read_pose_priors_, 0));
+  sql_stmts_.push_back(sql_stmt_read_pose_priors_);
+
   sql = "SELECT rows, cols, data FROM keypoints WHERE image_id = ?;";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_read_keypoints_, 0));
   sql_stmts_.push_back(sql_stmt_read_keypoints_);
 
-  sql = "SELECT rows, cols, data FROM descriptors WHERE image_id = ?;";
+  sql =
+      "SELECT rows, cols, data, compression FROM descriptors WHERE "
+      "image_id = ?;";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_read_descriptors_, 0));
   sql_stmts_.push_back(sql_stmt_read_descriptors_);
 
-  sql = "SELECT rows, cols, data FROM matches WHERE pair_id = ?;";
+  std::string batch_params = "?";
+  for (int i = 1; i < kReadBatchSize; ++i) {
+    batch_params += ", ?";
+  }
+
+  sql = "SELECT image_id, rows, cols, data FROM keypoints WHERE image_id IN (" +
+        batch_params + ");";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_read_keypoints_batch_, 0));
+  sql_stmts_.push_back(sql_stmt_read_keypoints_batch_);
+
+  sql =
+      "SELECT image_id, rows, cols, data, compression FROM descriptors WHERE "
+      "image_id IN (" +
+      batch_params + ");";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_read_descriptors_batch_, 0));
+  sql_stmts_.push_back(sql_stmt_read_descriptors_batch_);
+
+  sql =
+      "SELECT rows, cols, data, compression FROM matches WHERE pair_id = ?;";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_read_matches_, 0));
   sql_stmts_.push_back(sql_stmt_read_matches_);
 
-  sql = "SELECT * FROM matches WHERE rows > 0;";
+  sql =
+      "SELECT pair_id, rows, cols, data, compression FROM matches "
+      "WHERE rows > 0;";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_read_matches_all_, 0));
   sql_stmts_.push_back(sql_stmt_read_matches_all_);
 
+  sql = "SELECT pair_id, rows FROM matches WHERE rows > 0;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_read_num_matches_, 0));
+  sql_stmts_.push_back(sql_stmt_read_num_matches_);
+
   sql =
-      "SELECT rows, cols, data, config, F, E, H, qvec, tvec FROM "
-      "two_view_geometries WHERE pair_id = ?;";
+      "SELECT rows, cols, data, config, F, E, H, qvec, tvec, compression "
+      "FROM two_view_geometries WHERE pair_id = ?;";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_read_two_view_geometry_, 0));
   sql_stmts_.push_back(sql_stmt_read_two_view_geometry_);
 
-  sql = "SELECT * FROM two_view_geometries WHERE rows > 0;";
+  sql =
+      "SELECT pair_id, rows, cols, data, config, F, E, H, qvec, tvec, "
+      "compression FROM two_view_geometries WHERE rows > 0;";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_read_two_view_geometries_, 0));
   sql_stmts_.push_back(sql_stmt_read_two_view_geometries_);
 
-  sql = "SELECT pair_id, rows FROM two_view_geometries WHERE rows > 0;";
+  sql =
+      "SELECT pair_id, rows, config FROM two_view_geometries WHERE rows > 0;";
   SQLITE3_CALL(sqlite3_prepare_v2(database_,
                                   sql.c_str(),
                                   -1,
@@ -1224,19 +2188,23 @@ void Database::PrepareSQLStatements() {
   sql_stmts_.push_back(sql_stmt_write_keypoints_);
 
   sql =
-      "INSERT INTO descriptors(image_id, rows, cols, data) VALUES(?, ?, ?, ?);";
+      "INSERT INTO descriptors(image_id, rows, cols, data, compression) "
+      "VALUES(?, ?, ?, ?, ?);";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_write_descriptors_, 0));
   sql_stmts_.push_back(sql_stmt_write_descriptors_);
 
-  sql = "INSERT INTO matches(pair_id, rows, cols, data) VALUES(?, ?, ?, ?);";
+  sql =
+      "INSERT INTO matches(pair_id, rows, cols, data, compression) "
+      "VALUES(?, ?, ?, ?, ?);";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_write_matches_, 0));
   sql_stmts_.push_back(sql_stmt_write_matches_);
 
   sql =
       "INSERT INTO two_view_geometries(pair_id, rows, cols, data, config, F, "
-      "E, H, qvec, tvec) VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
+      "E, H, qvec, tvec, compression) "
+      "VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);";
   SQLITE3_CALL(sqlite3_prepare_v2(
       database_, sql.c_str(), -1, &sql_stmt_write_two_view_geometry_, 0));
   sql_stmts_.push_back(sql_stmt_write_two_view_geometry_);
@@ -1254,6 +2222,38 @@ void Database::PrepareSQLStatements() {
       database_, sql.c_str(), -1, &sql_stmt_delete_two_view_geometry_, 0));
   sql_stmts_.push_back(sql_stmt_delete_two_view_geometry_);
 
+  sql = "DELETE FROM keypoints WHERE image_id = ?;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_delete_keypoints_, 0));
+  sql_stmts_.push_back(sql_stmt_delete_keypoints_);
+
+  sql = "DELETE FROM descriptors WHERE image_id = ?;";
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_delete_descriptors_, 0));
+  sql_stmts_.push_back(sql_stmt_delete_descriptors_);
+
+  // The image identifiers of a pair are encoded as
+  // pair_id = kMaxNumImages * image_id1 + image_id2.
+  sql = StringPrintf(
+      "DELETE FROM matches WHERE pair_id / %d = ?1 OR pair_id %% %d = ?1;",
+      kMaxNumImages,
+      kMaxNumImages);
+  SQLITE3_CALL(sqlite3_prepare_v2(
+      database_, sql.c_str(), -1, &sql_stmt_delete_image_matches_, 0));
+  sql_stmts_.push_back(sql_stmt_delete_image_matches_);
+
+  sql = StringPrintf(
+      "DELETE FROM two_view_geometries WHERE pair_id / %d = ?1 OR "
+      "pair_id %% %d = ?1;",
+      kMaxNumImages,
+      kMaxNumImages);
+  SQLITE3_CALL(sqlite3_prepare_v2(database_,
+                                  sql.c_str(),
+                                  -1,
+                                  &sql_stmt_delete_image_two_view_geometries_,
+                                  0));
+  sql_stmts_.push_back(sql_stmt_delete_image_two_view_geometries_);
+
   //////////////////////////////////////////////////////////////////////////////
   // clear_*
   //////////////////////////////////////////////////////////////////////////////
@@ -1328,6 +2328,7 @@ void Database::CreateImageTable() const {
       "   (image_id   INTEGER  PRIMARY KEY AUTOINCREMENT  NOT NULL,"
       "    name       TEXT                                NOT NULL UNIQUE,"
       "    camera_id  INTEGER                             NOT NULL,"
+      "    content_hash  INTEGER,"
       "CONSTRAINT image_id_check CHECK(image_id >= 0 and image_id < %d),"
       "FOREIGN KEY(camera_id) REFERENCES cameras(camera_id));"
       "CREATE UNIQUE INDEX IF NOT EXISTS index_name ON images(name);",
@@ -1366,6 +2367,7 @@ void Database::CreateDescriptorsTable() const {
       "    rows      INTEGER               NOT NULL,"
       "    cols      INTEGER               NOT NULL,"
       "    data      BLOB,"
+      "    compression  INTEGER  NOT NULL  DEFAULT 0,"
       "FOREIGN KEY(image_id) REFERENCES images(image_id) ON DELETE CASCADE);";
 
   SQLITE3_EXEC(database_, sql.c_str(), nullptr);
@@ -1377,7 +2379,8 @@ void Database::CreateMatchesTable() const {
       "   (pair_id  INTEGER  PRIMARY KEY  NOT NULL,"
       "    rows     INTEGER               NOT NULL,"
       "    cols     INTEGER               NOT NULL,"
-      "    data     BLOB);";
+      "    data     BLOB,"
+      "    compression  INTEGER  NOT NULL  DEFAULT 0);";
 
   SQLITE3_EXEC(database_, sql.c_str(), nullptr);
 }
@@ -1399,7 +2402,8 @@ void Database::CreateTwoViewGeometriesTable() const {
         "    E        BLOB,"
         "    H        BLOB,"
         "    qvec     BLOB,"
-        "    tvec     BLOB);";
+        "    tvec     BLOB,"
+        "    compression  INTEGER  NOT NULL  DEFAULT 0);";
     SQLITE3_EXEC(database_, sql.c_str(), nullptr);
   }
 }
@@ -1435,6 +2439,28 @@ void Database::UpdateSchema() const {
                  nullptr);
   }
 
+  // Older databases only contain uncompressed blobs.
+  for (const char* table_name :
+       {"descriptors", "matches", "two_view_geometries"}) {
+    if (!ExistsColumn(table_name, "compression")) {
+      SQLITE3_EXEC(
+          database_,
+          StringPrintf("ALTER TABLE %s ADD COLUMN compression INTEGER NOT "
+                       "NULL DEFAULT 0;",
+                       table_name)
+              .c_str(),
+          nullptr);
+    }
+  }
+
+  // Images of older databases have no content hash, so their features are
+  // always considered up to date.
+  if (!ExistsColumn("images", "content_hash")) {
+    SQLITE3_EXEC(database_,
+                 "ALTER TABLE images ADD COLUMN content_hash INTEGER;",
+                 nullptr);
+  }
+
   // Update user version number.
   std::unique_lock<std::mutex> lock(update_schema_mutex_);
   const std::string update_user_version_sql =
@@ -37,8 +37,11 @@
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/types.h"
 
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <Eigen/Core>
@@ -53,6 +56,8 @@ typedef Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
 typedef Eigen::Matrix<point2D_t, Eigen::Dynamic, 2, Eigen::RowMajor>
     FeatureMatchesBlob;
 
+class FeatureStore;
+
 // Database class to read and write images, features, cameras, matches, etc.
 // from a SQLite database. The class is not thread-safe and must not be accessed
 // concurrently. The class is optimized for single-thread speed and for optimal
@@ -71,15 +76,55 @@ class Database {
   // Can be used to construct temporary in-memory database.
   const static std::string kInMemoryDatabasePath;
 
+  // The maximum number of images read in a single query by batched reads.
+  const static int kReadBatchSize = 128;
+
   Database();
   explicit Database(const std::string& path);
   ~Database();
 
   // Open and close database. The same database should not be opened
-  // concurrently in multiple threads or processes.
+  // concurrently in multiple threads or processes, except for additional
+  // read-only connections opened with `OpenReadOnlyConnection`.
   void Open(const std::string& path);
   void Close();
 
+  // Open an additional read-only connection to the same database file. Since
+  // the database uses write-ahead logging, the returned connection can be used
+  // concurrently with this connection from another thread, while this
+  // connection remains the only writer. Readers only see committed changes.
+  // Returns null for in-memory databases, which cannot be shared, and if a
+  // feature store is attached.
+  std::unique_ptr<Database> OpenReadOnlyConnection() const;
+
+  // Open multiple database shards, e.g., one per capture session, as a single
+  // logical database without physically merging them. The shards are attached
+  // to an in-memory database and exposed through views over the union of their
+  // tables, so the logical database is read-only. The camera and image
+  // identifiers of each shard are offset by the sum of the maximum identifiers
+  // of all previous shards, and the image pair identifiers are remapped
+  // accordingly. Cross-shard matches are not supported. Image names must be
+  // unique across shards. The number of shards is limited by SQLite's maximum
+  // number of attached databases (10 by default).
+  void OpenShards(const std::vector<std::string>& paths);
+
+  // Store keypoints, descriptors, and matches in a memory-mapped feature store
+  // in the given directory instead of the SQLite tables. Cameras, images, pose
+  // priors, and two-view geometries remain in SQLite. The store must be
+  // attached after opening the database and is detached when closing it.
+  // Existing features in the SQLite tables are not visible while attached.
+  void AttachFeatureStore(const std::string& path);
+  void DetachFeatureStore();
+  bool HasFeatureStore() const;
+
+  // Compress descriptors (LZ4) and matches (delta and varint encoded indices)
+  // when writing them to the SQLite tables. Compressed and uncompressed entries
+  // can be mixed in the same database and are transparently decoded on read.
+  // Disabled by default, since older versions cannot decode compressed entries.
+  // An attached feature store is never compressed.
+  void SetCompressBlobs(bool compress);
+  bool CompressBlobs() const;
+
   // Check if entry already exists in database. For image pairs, the order of
   // `image_id1` and `image_id2` does not matter.
   bool ExistsCamera(camera_t camera_id) const;
@@ -157,12 +202,37 @@ class Database {
   Image ReadImageWithName(const std::string& name) const;
   std::vector<Image> ReadAllImages() const;
 
+  // Read the content hashes of all images for which a hash was written with
+  // `WriteImageContentHash`. Images without hash are not contained.
+  std::unordered_map<image_t, uint64_t> ReadAllImageContentHashes() const;
+
+  // Read the identifiers of all images that have both keypoints and
+  // descriptors using a single query, which is significantly faster than
+  // calling `ExistsKeypoints` and `ExistsDescriptors` for every image.
+  std::unordered_set<image_t> ReadImageIdsWithFeatures() const;
+
   PosePrior ReadPosePrior(image_t image_id) const;
 
+  // Read the pose priors of all images using a single query, which is
+  // significantly faster than calling `ReadPosePrior` for every image.
+  std::unordered_map<image_t, PosePrior> ReadAllPosePriors() const;
+
   FeatureKeypointsBlob ReadKeypointsBlob(image_t image_id) const;
   FeatureKeypoints ReadKeypoints(image_t image_id) const;
   FeatureDescriptors ReadDescriptors(image_t image_id) const;
 
+  // Read the keypoints/descriptors of multiple images using one query per
+  // batch of `kReadBatchSize` images, which significantly reduces the number of
+  // round-trips compared to reading the images one by one. The results are in
+  // the same order as the given image identifiers and they are empty for
+  // images without entry.
+  std::vector<FeatureKeypointsBlob> ReadKeypointsBlobs(
+      const std::vector<image_t>& image_ids) const;
+  std::vector<FeatureKeypoints> ReadKeypoints(
+      const std::vector<image_t>& image_ids) const;
+  std::vector<FeatureDescriptors> ReadDescriptors(
+      const std::vector<image_t>& image_ids) const;
+
   FeatureMatchesBlob ReadMatchesBlob(image_t image_id1,
                                      image_t image_id2) const;
   FeatureMatches ReadMatches(image_t image_id1, image_t image_id2) const;
@@ -174,11 +244,34 @@ class Database {
       std::vector<image_pair_t>* image_pair_ids,
       std::vector<TwoViewGeometry>* two_view_geometries) const;
 
+  // Stream all matches or two-view geometries with at least one (inlier)
+  // match to the callback one image pair at a time, so that only a single
+  // pair has to be held in memory. The data is in the orientation of the pair
+  // identifier. The callback must not read all matches or two-view geometries
+  // of the same database again.
+  void ReadAllMatches(
+      const std::function<void(image_pair_t, FeatureMatches)>& callback) const;
+  void ReadTwoViewGeometries(
+      const std::function<void(image_pair_t, TwoViewGeometry)>& callback)
+      const;
+
   // Read all image pairs that have an entry in the `NumVerifiedImagePairs`
-  // table with at least one inlier match and their number of inlier matches.
+  // table with at least one inlier match and their number of inlier matches
+  // and, optionally, their two-view geometry configuration.
   void ReadTwoViewGeometryNumInliers(
       std::vector<std::pair<image_t, image_t>>* image_pairs,
-      std::vector<int>* num_inliers) const;
+      std::vector<int>* num_inliers,
+      std::vector<int>* configs = nullptr) const;
+
+  // Stream the same image pairs, number of inlier matches, and two-view
+  // geometry configurations to the callback without holding them in memory.
+  void ReadTwoViewGeometryNumInliers(
+      const std::function<void(image_pair_t, int, int)>& callback) const;
+
+  // Read all image pairs that have an entry in the `matches` table with at
+  // least one match and their number of matches without reading the matches.
+  void ReadNumMatches(std::vector<std::pair<image_t, image_t>>* image_pairs,
+                      std::vector<int>* num_matches) const;
 
   // Add new camera and return its database identifier. If `use_camera_id`
   // is false a new identifier is automatically generated.
@@ -215,12 +308,36 @@ class Database {
   // making sure that the entry already exists.
   void UpdateImage(const Image& image) const;
 
+  // Store the hash of the file content from which the features of an image
+  // were extracted. The user is responsible for making sure that the image
+  // entry already exists.
+  void WriteImageContentHash(image_t image_id, uint64_t content_hash) const;
+
   // Delete matches of an image pair.
   void DeleteMatches(image_t image_id1, image_t image_id2) const;
 
   // Delete inlier matches of an image pair.
   void DeleteInlierMatches(image_t image_id1, image_t image_id2) const;
 
+  // Delete the keypoints and descriptors of an image together with all its
+  // matches and two-view geometries, e.g., before re-extracting its features.
+  void DeleteImageFeatures(image_t image_id) const;
+
+  // Delete the given images together with their features, pose priors, and
+  // all their matches and two-view geometries. In contrast to deleting the
+  // entries image by image, the identifiers are stored in a temporary table,
+  // so that each table is only scanned once.
+  void DeleteImages(const std::vector<image_t>& image_ids) const;
+
+  // Delete the matches and two-view geometries of the given image pairs with
+  // a single statement per table.
+  void DeleteImagePairs(const std::vector<image_pair_t>& pair_ids) const;
+
+  // Write a compacted copy of the database to the given path, which must not
+  // exist yet. As this replaces the vacuuming of deleted entries, the database
+  // is not vacuumed anymore when it is closed.
+  void VacuumInto(const std::string& path) const;
+
   // Clear all database tables
   void ClearAllTables() const;
 
@@ -250,6 +367,14 @@ class Database {
                     const Database& database2,
                     Database* merged_database);
 
+  // Merge the matches and two-view geometries of the source into the target
+  // database, e.g., after distributing the matching of the image pairs across
+  // multiple copies of the same database. Images are associated by their names
+  // and must have identical features in both databases. Existing image pairs
+  // in the target database are overwritten.
+  static void MergeImagePairs(const Database& source_database,
+                              Database* target_database);
+
  private:
   friend class DatabaseTransaction;
 
@@ -293,6 +418,15 @@ class Database {
 
   sqlite3* database_ = nullptr;
 
+  // The path of the opened database.
+  std::string path_;
+
+  // Optional alternative storage backend for keypoints, descriptors, matches.
+  std::unique_ptr<FeatureStore> feature_store_;
+
+  // Whether to compress newly written descriptors and matches.
+  bool compress_blobs_ = false;
+
   // Check if elements got removed from the database to only apply
   // the VACUUM command in such case
   mutable bool database_cleared_ = false;
@@ -331,6 +465,7 @@ class Database {
   // update_*
   sqlite3_stmt* sql_stmt_update_camera_ = nullptr;
   sqlite3_stmt* sql_stmt_update_image_ = nullptr;
+  sqlite3_stmt* sql_stmt_update_image_content_hash_ = nullptr;
 
   // read_*
   sqlite3_stmt* sql_stmt_read_camera_ = nullptr;
@@ -338,11 +473,17 @@ class Database {
   sqlite3_stmt* sql_stmt_read_image_id_ = nullptr;
   sqlite3_stmt* sql_stmt_read_image_name_ = nullptr;
   sqlite3_stmt* sql_stmt_read_images_ = nullptr;
+  sqlite3_stmt* sql_stmt_read_image_content_hashes_ = nullptr;
+  sqlite3_stmt* sql_stmt_read_image_ids_with_features_ = nullptr;
   sqlite3_stmt* sql_stmt_read_pose_prior_ = nullptr;
+  sqlite3_stmt* sql_stmt_read_pose_priors_ = nullptr;
   sqlite3_stmt* sql_stmt_read_keypoints_ = nullptr;
+  sqlite3_stmt* sql_stmt_read_keypoints_batch_ = nullptr;
   sqlite3_stmt* sql_stmt_read_descriptors_ = nullptr;
+  sqlite3_stmt* sql_stmt_read_descriptors_batch_ = nullptr;
   sqlite3_stmt* sql_stmt_read_matches_ = nullptr;
   sqlite3_stmt* sql_stmt_read_matches_all_ = nullptr;
+  sqlite3_stmt* sql_stmt_read_num_matches_ = nullptr;
   sqlite3_stmt* sql_stmt_read_two_view_geometry_ = nullptr;
   sqlite3_stmt* sql_stmt_read_two_view_geometries_ = nullptr;
   sqlite3_stmt* sql_stmt_read_two_view_geometry_num_inliers_ = nullptr;
@@ -357,6 +498,10 @@ class Database {
   // delete_*
   sqlite3_stmt* sql_stmt_delete_matches_ = nullptr;
   sqlite3_stmt* sql_stmt_delete_two_view_geometry_ = nullptr;
+  sqlite3_stmt* sql_stmt_delete_keypoints_ = nullptr;
+  sqlite3_stmt* sql_stmt_delete_descriptors_ = nullptr;
+  sqlite3_stmt* sql_stmt_delete_image_matches_ = nullptr;
+  sqlite3_stmt* sql_stmt_delete_image_two_view_geometries_ = nullptr;
 
   // clear_*
   sqlite3_stmt* sql_stmt_clear_cameras_ = nullptr;
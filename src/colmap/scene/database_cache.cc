@@ -29,9 +29,13 @@
 
 #include "colmap/scene/database_cache.h"
 
+#include "colmap/util/endian.h"
+#include "colmap/util/misc.h"
 #include "colmap/util/string.h"
 #include "colmap/util/timer.h"
 
+#include <algorithm>
+#include <fstream>
 #include <unordered_set>
 
 namespace colmap {
@@ -46,14 +50,108 @@ std::vector<Eigen::Vector2d> FeatureKeypointsToPointsVector(
   return points;
 }
 
+bool UseInlierMatches(const size_t num_inliers,
+                      const int config,
+                      const size_t min_num_matches,
+                      const bool ignore_watermarks) {
+  return num_inliers >= min_num_matches &&
+         (!ignore_watermarks || config != TwoViewGeometry::WATERMARK);
+}
+
+image_t FindRootImage(const image_t image_id,
+                      std::unordered_map<image_t, image_t>* parents) {
+  image_t root = image_id;
+  while (true) {
+    const auto it = parents->find(root);
+    if (it == parents->end() || it->second == root) {
+      break;
+    }
+    root = it->second;
+  }
+  // Path compression.
+  image_t node = image_id;
+  while (node != root) {
+    image_t& parent = (*parents)[node];
+    node = parent;
+    parent = root;
+  }
+  return root;
+}
+
+// Select the image pairs to keep among the candidate pairs, such that each
+// image keeps the pairs to its neighbors with the most inliers. In addition,
+// the pairs of a maximum spanning tree by the number of inliers are kept, such
+// that the connected components of the candidate pairs are preserved.
+std::vector<char> SparsifyImagePairs(
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const std::vector<int>& num_inliers,
+    const std::vector<char>& candidates,
+    const size_t max_num_neighbors) {
+  std::vector<size_t> order;
+  order.reserve(image_pairs.size());
+  for (size_t i = 0; i < image_pairs.size(); ++i) {
+    if (candidates[i]) {
+      order.push_back(i);
+    }
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t i, size_t j) {
+    return num_inliers[i] > num_inliers[j];
+  });
+
+  // In the order of decreasing number of inliers, a pair is among the best
+  // pairs of an image, if fewer than max_num_neighbors pairs of the image
+  // were visited before, and it belongs to the spanning tree, if it connects
+  // two components (Kruskal's algorithm).
+  std::vector<char> selected(image_pairs.size(), false);
+  std::unordered_map<image_t, size_t> num_visited_pairs;
+  std::unordered_map<image_t, image_t> parents;
+  for (const size_t i : order) {
+    const image_t image_id1 = image_pairs[i].first;
+    const image_t image_id2 = image_pairs[i].second;
+    const size_t rank1 = num_visited_pairs[image_id1]++;
+    const size_t rank2 = num_visited_pairs[image_id2]++;
+    const image_t root1 = FindRootImage(image_id1, &parents);
+    const image_t root2 = FindRootImage(image_id2, &parents);
+    if (root1 != root2) {
+      parents[root1] = root2;
+      selected[i] = true;
+    } else if (rank1 < max_num_neighbors || rank2 < max_num_neighbors) {
+      selected[i] = true;
+    }
+  }
+
+  return selected;
+}
+
+// FNV-1a hash of a sequence of integers.
+void HashInteger(const uint64_t value, uint64_t* hash) {
+  for (int i = 0; i < 8; ++i) {
+    *hash ^= (value >> (8 * i)) & 0xFF;
+    *hash *= 1099511628211ull;
+  }
+}
+
 }  // namespace
 
 std::shared_ptr<DatabaseCache> DatabaseCache::Create(
     const Database& database,
     const size_t min_num_matches,
     const bool ignore_watermarks,
-    const std::unordered_set<std::string>& image_names) {
+    const std::unordered_set<std::string>& image_names,
+    const std::string& correspondence_graph_cache_path,
+    const bool lazy_points2D,
+    const size_t max_num_neighbors) {
   auto cache = std::make_shared<DatabaseCache>();
+  cache->min_num_matches_ = min_num_matches;
+  cache->ignore_watermarks_ = ignore_watermarks;
+  cache->max_num_neighbors_ = max_num_neighbors;
+  cache->image_names_ = image_names;
+  if (lazy_points2D) {
+    cache->points2D_database_ = database.OpenReadOnlyConnection();
+    if (cache->points2D_database_ == nullptr) {
+      LOG(WARNING) << "Cannot lazily load 2D points from the database";
+    }
+  }
 
   //////////////////////////////////////////////////////////////////////////////
   // Load cameras
@@ -82,19 +180,20 @@ std::shared_ptr<DatabaseCache> DatabaseCache::Create(
   timer.Restart();
   LOG(INFO) << "Loading matches...";
 
-  std::vector<image_pair_t> image_pair_ids;
-  std::vector<TwoViewGeometry> two_view_geometries;
-  database.ReadTwoViewGeometries(&image_pair_ids, &two_view_geometries);
+  // Only read the number of inliers here, the inlier matches are streamed
+  // into the correspondence graph below to bound the memory usage.
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<int> num_inliers;
+  std::vector<int> configs;
+  database.ReadTwoViewGeometryNumInliers(&image_pairs, &num_inliers, &configs);
 
   LOG(INFO) << StringPrintf(
-      " %d in %.3fs", image_pair_ids.size(), timer.ElapsedSeconds());
+      " %d in %.3fs", image_pairs.size(), timer.ElapsedSeconds());
 
   auto UseInlierMatchesCheck = [min_num_matches, ignore_watermarks](
-                                   const TwoViewGeometry& two_view_geometry) {
-    return static_cast<size_t>(two_view_geometry.inlier_matches.size()) >=
-               min_num_matches &&
-           (!ignore_watermarks ||
-            two_view_geometry.config != TwoViewGeometry::WATERMARK);
+                                   const size_t num_inliers, const int config) {
+    return UseInlierMatches(
+        num_inliers, config, min_num_matches, ignore_watermarks);
   };
 
   //////////////////////////////////////////////////////////////////////////////
@@ -105,6 +204,7 @@ std::shared_ptr<DatabaseCache> DatabaseCache::Create(
   LOG(INFO) << "Loading images...";
 
   std::unordered_set<image_t> image_ids;
+  std::vector<char> use_image_pairs(image_pairs.size(), false);
 
   {
     std::vector<class Image> images = database.ReadAllImages();
@@ -123,32 +223,59 @@ std::shared_ptr<DatabaseCache> DatabaseCache::Create(
       }
     }
 
+    // Determines which image pairs are used in the correspondence graph.
+    for (size_t i = 0; i < image_pairs.size(); ++i) {
+      use_image_pairs[i] = UseInlierMatchesCheck(num_inliers[i], configs[i]) &&
+                           image_ids.count(image_pairs[i].first) > 0 &&
+                           image_ids.count(image_pairs[i].second) > 0;
+    }
+    if (max_num_neighbors > 0) {
+      use_image_pairs = SparsifyImagePairs(
+          image_pairs, num_inliers, use_image_pairs, max_num_neighbors);
+    }
+
     // Collect all images that are connected in the correspondence graph.
     std::unordered_set<image_t> connected_image_ids;
     connected_image_ids.reserve(image_ids.size());
-    for (size_t i = 0; i < image_pair_ids.size(); ++i) {
-      if (UseInlierMatchesCheck(two_view_geometries[i])) {
-        image_t image_id1;
-        image_t image_id2;
-        std::tie(image_id1, image_id2) =
-            Database::PairIdToImagePair(image_pair_ids[i]);
-        if (image_ids.count(image_id1) > 0 && image_ids.count(image_id2) > 0) {
-          connected_image_ids.insert(image_id1);
-          connected_image_ids.insert(image_id2);
-        }
+    for (size_t i = 0; i < image_pairs.size(); ++i) {
+      if (use_image_pairs[i]) {
+        connected_image_ids.insert(image_pairs[i].first);
+        connected_image_ids.insert(image_pairs[i].second);
       }
     }
 
     // Load images with correspondences and discard images without
     // correspondences, as those images are useless for SfM.
+    // The keypoints are read in batches, which avoids one query per image.
     cache->images_.reserve(connected_image_ids.size());
-    for (auto& image : images) {
-      const image_t image_id = image.ImageId();
+    std::vector<class Image*> batch_images;
+    std::vector<image_t> batch_image_ids;
+    for (size_t i = 0; i < images.size(); ++i) {
+      const image_t image_id = images[i].ImageId();
       if (image_ids.count(image_id) > 0 &&
           connected_image_ids.count(image_id) > 0) {
-        image.SetPoints2D(
-            FeatureKeypointsToPointsVector(database.ReadKeypoints(image_id)));
-        cache->images_.emplace(image_id, std::move(image));
+        if (cache->LazyPoints2D()) {
+          cache->num_points2D_.emplace(image_id,
+                                       database.NumKeypointsForImage(image_id));
+          cache->images_.emplace(image_id, std::move(images[i]));
+        } else {
+          batch_images.push_back(&images[i]);
+          batch_image_ids.push_back(image_id);
+        }
+      }
+      if (batch_image_ids.size() ==
+              static_cast<size_t>(Database::kReadBatchSize) ||
+          (i + 1 == images.size() && !batch_image_ids.empty())) {
+        const std::vector<FeatureKeypoints> keypoints =
+            database.ReadKeypoints(batch_image_ids);
+        for (size_t j = 0; j < batch_images.size(); ++j) {
+          batch_images[j]->SetPoints2D(
+              FeatureKeypointsToPointsVector(keypoints[j]));
+          cache->images_.emplace(batch_image_ids[j],
+                                 std::move(*batch_images[j]));
+        }
+        batch_images.clear();
+        batch_image_ids.clear();
       }
     }
 
@@ -167,38 +294,438 @@ std::shared_ptr<DatabaseCache> DatabaseCache::Create(
 
   cache->correspondence_graph_ = std::make_shared<class CorrespondenceGraph>();
 
+  // The snapshot key identifies the images and image pairs from which the
+  // graph is built. Note that changes to the inlier matches of an image pair
+  // without changing their number are not detected.
+  uint64_t snapshot_key = 14695981039346656037ull;
+  std::string snapshot_path;
+  if (!correspondence_graph_cache_path.empty() && IsLittleEndian()) {
+    std::vector<image_t> sorted_image_ids;
+    sorted_image_ids.reserve(cache->images_.size());
+    for (const auto& image : cache->images_) {
+      sorted_image_ids.push_back(image.first);
+    }
+    std::sort(sorted_image_ids.begin(), sorted_image_ids.end());
+    for (const image_t image_id : sorted_image_ids) {
+      HashInteger(image_id, &snapshot_key);
+      HashInteger(cache->NumPoints2DForImage(image_id), &snapshot_key);
+    }
+    for (size_t i = 0; i < image_pairs.size(); ++i) {
+      if (use_image_pairs[i]) {
+        HashInteger(image_pairs[i].first, &snapshot_key);
+        HashInteger(image_pairs[i].second, &snapshot_key);
+        HashInteger(num_inliers[i], &snapshot_key);
+        HashInteger(configs[i], &snapshot_key);
+      }
+    }
+
+    CreateDirIfNotExists(correspondence_graph_cache_path, /*recursive=*/true);
+    snapshot_path = JoinPaths(
+        correspondence_graph_cache_path,
+        StringPrintf("correspondence_graph_%016llx.bin",
+                     static_cast<unsigned long long>(snapshot_key)));
+    if (cache->correspondence_graph_->ReadSnapshot(snapshot_path,
+                                                   snapshot_key)) {
+      LOG(INFO) << StringPrintf(" in %.3fs (from snapshot %s)",
+                                timer.ElapsedSeconds(),
+                                snapshot_path.c_str());
+      return cache;
+    }
+  }
+
   for (const auto& image : cache->images_) {
-    cache->correspondence_graph_->AddImage(image.first,
-                                           image.second.NumPoints2D());
+    cache->correspondence_graph_->AddImage(
+        image.first, cache->NumPoints2DForImage(image.first));
+  }
+
+  // The streamed image pairs are looked up by their identifier, if only a
+  // sparse subset of the image pairs is used.
+  std::unordered_set<image_pair_t> sparse_pair_ids;
+  if (max_num_neighbors > 0) {
+    for (size_t i = 0; i < image_pairs.size(); ++i) {
+      if (use_image_pairs[i]) {
+        sparse_pair_ids.insert(Database::ImagePairToPairId(
+            image_pairs[i].first, image_pairs[i].second));
+      }
+    }
   }
 
   size_t num_ignored_image_pairs = 0;
-  for (size_t i = 0; i < image_pair_ids.size(); ++i) {
-    if (UseInlierMatchesCheck(two_view_geometries[i])) {
+  database.ReadTwoViewGeometries([&](const image_pair_t pair_id,
+                                     const TwoViewGeometry& two_view_geometry) {
+    if (max_num_neighbors > 0 ? sparse_pair_ids.count(pair_id) > 0
+                              : UseInlierMatchesCheck(
+                                    two_view_geometry.inlier_matches.size(),
+                                    two_view_geometry.config)) {
       image_t image_id1;
       image_t image_id2;
-      std::tie(image_id1, image_id2) =
-          Database::PairIdToImagePair(image_pair_ids[i]);
+      std::tie(image_id1, image_id2) = Database::PairIdToImagePair(pair_id);
       if (image_ids.count(image_id1) > 0 && image_ids.count(image_id2) > 0) {
         cache->correspondence_graph_->AddCorrespondences(
-            image_id1, image_id2, two_view_geometries[i].inlier_matches);
+            image_id1, image_id2, two_view_geometry.inlier_matches);
       } else {
         num_ignored_image_pairs += 1;
       }
     } else {
       num_ignored_image_pairs += 1;
     }
-  }
+  });
 
   cache->correspondence_graph_->Finalize();
 
+  if (!snapshot_path.empty()) {
+    cache->correspondence_graph_->WriteSnapshot(snapshot_path, snapshot_key);
+  }
+
   LOG(INFO) << StringPrintf(" in %.3fs (ignored %d)",
                             timer.ElapsedSeconds(),
                             num_ignored_image_pairs);
 
+  cache->memory_account_.SetNumBytes(cache->NumBytes());
+
   return cache;
 }
 
+std::shared_ptr<DatabaseCache> DatabaseCache::CreateFromCache(
+    const DatabaseCache& database_cache,
+    const std::unordered_set<std::string>& image_names) {
+  THROW_CHECK_NOTNULL(database_cache.correspondence_graph_);
+
+  Timer timer;
+  timer.Start();
+  LOG(INFO) << "Extracting images from database cache...";
+
+  auto cache = std::make_shared<DatabaseCache>();
+  cache->min_num_matches_ = database_cache.min_num_matches_;
+  cache->ignore_watermarks_ = database_cache.ignore_watermarks_;
+  cache->max_num_neighbors_ = database_cache.max_num_neighbors_;
+  cache->image_names_ = image_names;
+  if (database_cache.points2D_database_ != nullptr) {
+    cache->points2D_database_ =
+        database_cache.points2D_database_->OpenReadOnlyConnection();
+    THROW_CHECK_NOTNULL(cache->points2D_database_);
+  }
+
+  std::unordered_set<image_t> image_ids;
+  for (const auto& image : database_cache.images_) {
+    if (image_names.empty() || image_names.count(image.second.Name()) > 0) {
+      image_ids.insert(image.first);
+    }
+  }
+
+  cache->correspondence_graph_ = std::make_shared<class CorrespondenceGraph>(
+      database_cache.correspondence_graph_->ExtractSubgraph(image_ids));
+
+  // Keep the images with correspondences to other selected images, as in
+  // Create(), and their cameras.
+  for (const image_t image_id : image_ids) {
+    if (!cache->correspondence_graph_->ExistsImage(image_id)) {
+      continue;
+    }
+    if (cache->LazyPoints2D()) {
+      // Copy the image without the 2D points, which may be loaded in the other
+      // cache, since they are read from the database on demand.
+      class Image image;
+      {
+        std::lock_guard<std::mutex> lock(database_cache.points2D_mutex_);
+        image = database_cache.images_.at(image_id);
+      }
+      image.Points2D().clear();
+      image.Points2D().shrink_to_fit();
+      cache->images_.emplace(image_id, std::move(image));
+      cache->num_points2D_.emplace(image_id,
+                                   database_cache.num_points2D_.at(image_id));
+    } else {
+      cache->images_.emplace(image_id, database_cache.images_.at(image_id));
+    }
+    const camera_t camera_id = cache->images_.at(image_id).CameraId();
+    if (!cache->ExistsCamera(camera_id)) {
+      cache->cameras_.emplace(camera_id, database_cache.cameras_.at(camera_id));
+    }
+  }
+
+  LOG(INFO) << StringPrintf(" %d images in %.3fs",
+                            cache->images_.size(),
+                            timer.ElapsedSeconds());
+
+  cache->memory_account_.SetNumBytes(cache->NumBytes());
+
+  return cache;
+}
+
+void DatabaseCache::Update(const Database& database) {
+  THROW_CHECK_NOTNULL(correspondence_graph_);
+
+  Timer timer;
+  timer.Start();
+  LOG(INFO) << "Updating database cache...";
+
+  for (auto& camera : database.ReadAllCameras()) {
+    if (!ExistsCamera(camera.camera_id)) {
+      cameras_.emplace(camera.camera_id, std::move(camera));
+    }
+  }
+
+  // Collect the image pairs that are not yet in the correspondence graph.
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  {
+    std::vector<std::pair<image_t, image_t>> all_image_pairs;
+    std::vector<int> num_inliers;
+    std::vector<int> configs;
+    database.ReadTwoViewGeometryNumInliers(
+        &all_image_pairs, &num_inliers, &configs);
+    std::vector<char> use_image_pairs(all_image_pairs.size());
+    for (size_t i = 0; i < all_image_pairs.size(); ++i) {
+      use_image_pairs[i] = UseInlierMatches(
+          num_inliers[i], configs[i], min_num_matches_, ignore_watermarks_);
+    }
+    // The sparse subset is selected among all image pairs, such that the
+    // pairs of the new images compete with the existing pairs.
+    if (max_num_neighbors_ > 0) {
+      use_image_pairs = SparsifyImagePairs(
+          all_image_pairs, num_inliers, use_image_pairs, max_num_neighbors_);
+    }
+    for (size_t i = 0; i < all_image_pairs.size(); ++i) {
+      if (use_image_pairs[i] &&
+          !correspondence_graph_->ExistsImagePair(
+              all_image_pairs[i].first, all_image_pairs[i].second)) {
+        image_pairs.push_back(all_image_pairs[i]);
+      }
+    }
+  }
+
+  // Load the new images of the new image pairs.
+  std::unordered_set<image_t> image_ids;
+  std::unordered_set<image_t> ignored_image_ids;
+  std::vector<class Image> new_images;
+  for (const auto& image_pair : image_pairs) {
+    for (const image_t image_id : {image_pair.first, image_pair.second}) {
+      if (ExistsImage(image_id) || image_ids.count(image_id) > 0 ||
+          ignored_image_ids.count(image_id) > 0) {
+        continue;
+      }
+      class Image image = database.ReadImage(image_id);
+      if (image_names_.empty() || image_names_.count(image.Name()) > 0) {
+        image_ids.insert(image_id);
+        new_images.push_back(std::move(image));
+      } else {
+        ignored_image_ids.insert(image_id);
+      }
+    }
+  }
+
+  if (LazyPoints2D()) {
+    for (auto& image : new_images) {
+      const image_t image_id = image.ImageId();
+      num_points2D_.emplace(image_id, database.NumKeypointsForImage(image_id));
+      images_.emplace(image_id, std::move(image));
+    }
+    new_images.clear();
+  }
+
+  for (size_t begin = 0; begin < new_images.size();
+       begin += Database::kReadBatchSize) {
+    const size_t end =
+        std::min(new_images.size(), begin + Database::kReadBatchSize);
+    std::vector<image_t> batch_image_ids;
+    for (size_t i = begin; i < end; ++i) {
+      batch_image_ids.push_back(new_images[i].ImageId());
+    }
+    const std::vector<FeatureKeypoints> keypoints =
+        database.ReadKeypoints(batch_image_ids);
+    for (size_t i = begin; i < end; ++i) {
+      new_images[i].SetPoints2D(
+          FeatureKeypointsToPointsVector(keypoints[i - begin]));
+      images_.emplace(new_images[i].ImageId(), std::move(new_images[i]));
+    }
+  }
+
+  // Add the new image pairs to the correspondence graph.
+  correspondence_graph_->Unfinalize();
+
+  size_t num_image_pairs = 0;
+  for (const auto& image_pair : image_pairs) {
+    const image_t image_id1 = image_pair.first;
+    const image_t image_id2 = image_pair.second;
+    if (!ExistsImage(image_id1) || !ExistsImage(image_id2)) {
+      continue;
+    }
+    // Images without observations were erased from the graph.
+    for (const image_t image_id : {image_id1, image_id2}) {
+      if (!correspondence_graph_->ExistsImage(image_id)) {
+        correspondence_graph_->AddImage(image_id,
+                                        NumPoints2DForImage(image_id));
+      }
+    }
+    correspondence_graph_->AddCorrespondences(
+        image_id1,
+        image_id2,
+        database.ReadTwoViewGeometry(image_id1, image_id2).inlier_matches);
+    num_image_pairs += 1;
+  }
+
+  correspondence_graph_->Finalize();
+
+  LOG(INFO) << StringPrintf(" %d images and %d image pairs in %.3fs",
+                            image_ids.size(),
+                            num_image_pairs,
+                            timer.ElapsedSeconds());
+
+  memory_account_.SetNumBytes(NumBytes());
+}
+
+void DatabaseCache::Write(const std::string& path) const {
+  THROW_CHECK_NOTNULL(correspondence_graph_);
+
+  std::ofstream file(path, std::ios::trunc | std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  WriteBinaryLittleEndian<uint64_t>(&file, min_num_matches_);
+  WriteBinaryLittleEndian<uint8_t>(&file, ignore_watermarks_);
+  WriteBinaryLittleEndian<uint64_t>(&file, max_num_neighbors_);
+  WriteBinaryLittleEndian<uint64_t>(&file, image_names_.size());
+  for (const auto& image_name : image_names_) {
+    file << image_name << '\0';
+  }
+
+  WriteBinaryLittleEndian<uint64_t>(&file, cameras_.size());
+  for (const auto& camera : cameras_) {
+    WriteBinaryLittleEndian<camera_t>(&file, camera.first);
+    WriteBinaryLittleEndian<int>(&file,
+                                 static_cast<int>(camera.second.model_id));
+    WriteBinaryLittleEndian<uint64_t>(&file, camera.second.width);
+    WriteBinaryLittleEndian<uint64_t>(&file, camera.second.height);
+    WriteBinaryLittleEndian<uint8_t>(&file,
+                                     camera.second.has_prior_focal_length);
+    WriteBinaryLittleEndian<double>(&file, camera.second.params);
+  }
+
+  WriteBinaryLittleEndian<uint64_t>(&file, images_.size());
+  for (const auto& image : images_) {
+    WriteBinaryLittleEndian<image_t>(&file, image.first);
+    WriteBinaryLittleEndian<camera_t>(&file, image.second.CameraId());
+    file << image.second.Name() << '\0';
+    if (LazyPoints2D() && image.second.NumPoints2D() == 0) {
+      std::vector<Eigen::Vector2d> points2D;
+      {
+        std::lock_guard<std::mutex> lock(points2D_mutex_);
+        points2D = ReadPoints2D(image.first);
+      }
+      WriteBinaryLittleEndian<uint64_t>(&file, points2D.size());
+      for (const auto& point2D : points2D) {
+        WriteBinaryLittleEndian<double>(&file, point2D(0));
+        WriteBinaryLittleEndian<double>(&file, point2D(1));
+      }
+    } else {
+      WriteBinaryLittleEndian<uint64_t>(&file, image.second.NumPoints2D());
+      for (const auto& point2D : image.second.Points2D()) {
+        WriteBinaryLittleEndian<double>(&file, point2D.xy(0));
+        WriteBinaryLittleEndian<double>(&file, point2D.xy(1));
+      }
+    }
+  }
+
+  correspondence_graph_->WriteBinary(&file);
+}
+
+std::shared_ptr<DatabaseCache> DatabaseCache::Read(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  auto cache = std::make_shared<DatabaseCache>();
+
+  cache->min_num_matches_ = ReadBinaryLittleEndian<uint64_t>(&file);
+  cache->ignore_watermarks_ = ReadBinaryLittleEndian<uint8_t>(&file);
+  cache->max_num_neighbors_ = ReadBinaryLittleEndian<uint64_t>(&file);
+  const size_t num_image_names = ReadBinaryLittleEndian<uint64_t>(&file);
+  for (size_t i = 0; i < num_image_names; ++i) {
+    std::string image_name;
+    std::getline(file, image_name, '\0');
+    cache->image_names_.insert(std::move(image_name));
+  }
+
+  const size_t num_cameras = ReadBinaryLittleEndian<uint64_t>(&file);
+  cache->cameras_.reserve(num_cameras);
+  for (size_t i = 0; i < num_cameras; ++i) {
+    struct Camera camera;
+    camera.camera_id = ReadBinaryLittleEndian<camera_t>(&file);
+    camera.model_id =
+        static_cast<CameraModelId>(ReadBinaryLittleEndian<int>(&file));
+    camera.width = ReadBinaryLittleEndian<uint64_t>(&file);
+    camera.height = ReadBinaryLittleEndian<uint64_t>(&file);
+    camera.has_prior_focal_length = ReadBinaryLittleEndian<uint8_t>(&file);
+    camera.params.resize(CameraModelNumParams(camera.model_id), 0.);
+    ReadBinaryLittleEndian<double>(&file, &camera.params);
+    cache->cameras_.emplace(camera.camera_id, std::move(camera));
+  }
+
+  const size_t num_images = ReadBinaryLittleEndian<uint64_t>(&file);
+  cache->images_.reserve(num_images);
+  for (size_t i = 0; i < num_images; ++i) {
+    class Image image;
+    image.SetImageId(ReadBinaryLittleEndian<image_t>(&file));
+    image.SetCameraId(ReadBinaryLittleEndian<camera_t>(&file));
+    std::getline(file, image.Name(), '\0');
+    std::vector<Eigen::Vector2d> points2D(
+        ReadBinaryLittleEndian<uint64_t>(&file));
+    for (auto& point2D : points2D) {
+      point2D(0) = ReadBinaryLittleEndian<double>(&file);
+      point2D(1) = ReadBinaryLittleEndian<double>(&file);
+    }
+    image.SetPoints2D(points2D);
+    const image_t image_id = image.ImageId();
+    cache->images_.emplace(image_id, std::move(image));
+  }
+
+  cache->correspondence_graph_ = std::make_shared<class CorrespondenceGraph>();
+  cache->correspondence_graph_->ReadBinary(&file);
+
+  cache->memory_account_.SetNumBytes(cache->NumBytes());
+
+  return cache;
+}
+
+void DatabaseCache::EvictPoints2D(const image_t image_id) const {
+  if (!LazyPoints2D()) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(points2D_mutex_);
+  std::vector<struct Point2D>& points2D = images_.at(image_id).Points2D();
+  points2D.clear();
+  points2D.shrink_to_fit();
+}
+
+size_t DatabaseCache::NumBytes() const {
+  size_t num_bytes = correspondence_graph_->NumBytes();
+  std::lock_guard<std::mutex> lock(points2D_mutex_);
+  for (const auto& image : images_) {
+    num_bytes += sizeof(class Image) +
+                 image.second.NumPoints2D() * sizeof(struct Point2D);
+  }
+  return num_bytes;
+}
+
+void DatabaseCache::LoadPoints2D(class Image& image) const {
+  std::lock_guard<std::mutex> lock(points2D_mutex_);
+  if (image.NumPoints2D() == 0 && num_points2D_.at(image.ImageId()) > 0) {
+    image.SetPoints2D(ReadPoints2D(image.ImageId()));
+  }
+}
+
+point2D_t DatabaseCache::NumPoints2DForImage(const image_t image_id) const {
+  if (LazyPoints2D()) {
+    return num_points2D_.at(image_id);
+  } else {
+    return images_.at(image_id).NumPoints2D();
+  }
+}
+
+std::vector<Eigen::Vector2d> DatabaseCache::ReadPoints2D(
+    const image_t image_id) const {
+  return FeatureKeypointsToPointsVector(
+      points2D_database_->ReadKeypoints(image_id));
+}
+
 const class Image* DatabaseCache::FindImageWithName(
     const std::string& name) const {
   for (const auto& image : images_) {
@@ -35,9 +35,11 @@
 #include "colmap/scene/image.h"
 #include "colmap/sensor/models.h"
 #include "colmap/util/eigen_alignment.h"
+#include "colmap/util/memory_budget.h"
 #include "colmap/util/types.h"
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -59,23 +61,66 @@ class DatabaseCache {
   // @param ignore_watermarks     Whether to ignore watermark image pairs.
   // @param image_names           Whether to use only load the data for a subset
   //                              of the images. All images are used if empty.
+  // @param correspondence_graph_cache_path  Optional folder in which snapshots
+  //                              of the correspondence graph are cached,
+  //                              keyed by the loaded images and image pairs.
+  //                              If a snapshot matches, the graph is read from
+  //                              it instead of being built from the matches.
+  // @param lazy_points2D         Whether to load the 2D points of an image only
+  //                              on first access through `Image`, using a
+  //                              read-only connection to the database file.
+  //                              Falls back to loading all points up front, if
+  //                              the database is not file-backed.
+  // @param max_num_neighbors     Whether to sparsify the image pairs, if
+  //                              larger than zero. Each image then only keeps
+  //                              the pairs to this number of neighbors with
+  //                              the most inliers and the pairs of a maximum
+  //                              spanning tree, which keeps the images
+  //                              connected as in the full graph.
   static std::shared_ptr<DatabaseCache> Create(
       const Database& database,
       size_t min_num_matches,
       bool ignore_watermarks,
+      const std::unordered_set<std::string>& image_names,
+      const std::string& correspondence_graph_cache_path = "",
+      bool lazy_points2D = false,
+      size_t max_num_neighbors = 0);
+
+  // Create a cache for a subset of the images of another cache without reading
+  // from the database, e.g., to share the loaded matches between multiple
+  // reconstructions of different parts of the scene. Only the correspondences
+  // between the selected images are kept and all images are used if the set
+  // of names is empty. The other cache is only read and may thus be shared by
+  // multiple threads. In lazy mode, the new cache opens its own read-only
+  // connection to the database.
+  static std::shared_ptr<DatabaseCache> CreateFromCache(
+      const DatabaseCache& database_cache,
       const std::unordered_set<std::string>& image_names);
 
+  // Update the cache with the cameras, images, and image pairs that were added
+  // to the database since the cache was created, using the same options as
+  // when the cache was created. Image pairs that are already in the cache are
+  // not reloaded, i.e., changes to their two-view geometries are ignored. The
+  // cache must not be in use by any reconstruction while being updated.
+  void Update(const Database& database);
+
+  // Write/read the cache in a binary format to/from a file, e.g., to later
+  // update it with the changes in the database without a full reload.
+  void Write(const std::string& path) const;
+  static std::shared_ptr<DatabaseCache> Read(const std::string& path);
+
   // Get number of objects.
   inline size_t NumCameras() const;
   inline size_t NumImages() const;
 
-  // Get specific objects.
+  // Get specific objects. In lazy mode, this loads the 2D points of the image.
   inline struct Camera& Camera(camera_t camera_id);
   inline const struct Camera& Camera(camera_t camera_id) const;
   inline class Image& Image(image_t image_id);
   inline const class Image& Image(image_t image_id) const;
 
-  // Get all objects.
+  // Get all objects. In lazy mode, the images only have their 2D points, if
+  // they were previously accessed and not evicted.
   inline const std::unordered_map<camera_t, struct Camera>& Cameras() const;
   inline const std::unordered_map<image_t, class Image>& Images() const;
 
@@ -90,11 +135,45 @@ class DatabaseCache {
   // Find specific image by name. Note that this uses linear search.
   const class Image* FindImageWithName(const std::string& name) const;
 
+  // Whether the 2D points of the images are lazily loaded.
+  inline bool LazyPoints2D() const;
+
+  // Release the 2D points of an image in lazy mode, e.g., once a
+  // reconstruction holds its own copy of the image. The points are loaded
+  // again on the next access. References to the points of the image are
+  // invalidated. Does nothing if not in lazy mode.
+  void EvictPoints2D(image_t image_id) const;
+
+  // Approximate number of bytes used by the images and the correspondence
+  // graph. In lazy mode, only the currently loaded 2D points are counted.
+  size_t NumBytes() const;
+
  private:
+  void LoadPoints2D(class Image& image) const;
+  point2D_t NumPoints2DForImage(image_t image_id) const;
+  std::vector<Eigen::Vector2d> ReadPoints2D(image_t image_id) const;
+
   std::shared_ptr<class CorrespondenceGraph> correspondence_graph_;
 
   std::unordered_map<camera_t, struct Camera> cameras_;
-  std::unordered_map<image_t, class Image> images_;
+  // Mutable to lazily load the 2D points in const accessors.
+  mutable std::unordered_map<image_t, class Image> images_;
+
+  // The connection to lazily load the 2D points and the number of 2D points
+  // of each image, only set in lazy mode.
+  std::unique_ptr<Database> points2D_database_;
+  std::unordered_map<image_t, point2D_t> num_points2D_;
+  mutable std::mutex points2D_mutex_;
+
+  // The options with which the cache was created.
+  size_t min_num_matches_ = 0;
+  bool ignore_watermarks_ = false;
+  size_t max_num_neighbors_ = 0;
+  std::unordered_set<std::string> image_names_;
+
+  // Reports the size of the cache after loading or updating to the global
+  // memory budget.
+  MemoryAccount memory_account_{"DatabaseCache"};
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -113,11 +192,19 @@ const struct Camera& DatabaseCache::Camera(const camera_t camera_id) const {
 }
 
 class Image& DatabaseCache::Image(const image_t image_id) {
-  return images_.at(image_id);
+  class Image& image = images_.at(image_id);
+  if (points2D_database_ != nullptr) {
+    LoadPoints2D(image);
+  }
+  return image;
 }
 
 const class Image& DatabaseCache::Image(const image_t image_id) const {
-  return images_.at(image_id);
+  class Image& image = images_.at(image_id);
+  if (points2D_database_ != nullptr) {
+    LoadPoints2D(image);
+  }
+  return image;
 }
 
 const std::unordered_map<camera_t, struct Camera>& DatabaseCache::Cameras()
@@ -142,4 +229,8 @@ DatabaseCache::CorrespondenceGraph() const {
   return correspondence_graph_;
 }
 
+bool DatabaseCache::LazyPoints2D() const {
+  return points2D_database_ != nullptr;
+}
+
 }  // namespace colmap
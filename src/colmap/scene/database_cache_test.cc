@@ -29,6 +29,11 @@
 
 #include "colmap/scene/database_cache.h"
 
+#include "colmap/util/misc.h"
+#include "colmap/util/testing.h"
+
+#include <tuple>
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -90,5 +95,281 @@ TEST(DatabaseCache, Nominal) {
             1);
 }
 
+TEST(DatabaseCache, UpdateReadWrite) {
+  Database database(Database::kInMemoryDatabasePath);
+  const Camera camera = Camera::CreateFromModelId(
+      kInvalidCameraId, SimplePinholeCameraModel::model_id, 1, 1, 1);
+  const camera_t camera_id = database.WriteCamera(camera);
+  std::vector<image_t> image_ids;
+  for (int i = 0; i < 4; ++i) {
+    Image image;
+    image.SetName("image" + std::to_string(i));
+    image.SetCameraId(camera_id);
+    image_ids.push_back(database.WriteImage(image));
+    database.WriteKeypoints(image_ids.back(), FeatureKeypoints(10));
+  }
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.config = TwoViewGeometry::ConfigurationType::CALIBRATED;
+  two_view_geometry.inlier_matches = {{0, 1}, {2, 3}};
+  database.WriteTwoViewGeometry(image_ids[0], image_ids[1], two_view_geometry);
+  auto cache = DatabaseCache::Create(database,
+                                     /*min_num_matches=*/2,
+                                     /*ignore_watermarks=*/false,
+                                     /*image_names=*/{});
+  EXPECT_EQ(cache->NumImages(), 2);
+  EXPECT_EQ(cache->CorrespondenceGraph()->NumImagePairs(), 1);
+
+  const std::string path = CreateTestDir() + "/database_cache.bin";
+  cache->Write(path);
+  cache = DatabaseCache::Read(path);
+  EXPECT_EQ(cache->NumCameras(), 1);
+  EXPECT_EQ(cache->Camera(camera_id).params, camera.params);
+  EXPECT_EQ(cache->NumImages(), 2);
+  EXPECT_EQ(cache->Image(image_ids[1]).Name(), "image1");
+  EXPECT_EQ(cache->Image(image_ids[1]).NumPoints2D(), 10);
+  EXPECT_EQ(cache->CorrespondenceGraph()->NumCorrespondencesBetweenImages(
+                image_ids[0], image_ids[1]),
+            2);
+
+  // Pairs below the minimum number of matches are ignored in updates, too.
+  database.WriteTwoViewGeometry(image_ids[1], image_ids[2], two_view_geometry);
+  two_view_geometry.inlier_matches = {{0, 1}};
+  database.WriteTwoViewGeometry(image_ids[2], image_ids[3], two_view_geometry);
+  cache->Update(database);
+  EXPECT_EQ(cache->NumImages(), 3);
+  EXPECT_TRUE(cache->ExistsImage(image_ids[2]));
+  EXPECT_EQ(cache->Image(image_ids[2]).NumPoints2D(), 10);
+  EXPECT_EQ(cache->CorrespondenceGraph()->NumImagePairs(), 2);
+  EXPECT_EQ(cache->CorrespondenceGraph()->NumCorrespondencesForImage(
+                image_ids[1]),
+            4);
+  EXPECT_FALSE(cache->CorrespondenceGraph()->ExistsImagePair(image_ids[2],
+                                                              image_ids[3]));
+}
+
+TEST(DatabaseCache, CreateFromCache) {
+  Database database(CreateTestDir() + "/database.db");
+  const Camera camera = Camera::CreateFromModelId(
+      kInvalidCameraId, SimplePinholeCameraModel::model_id, 1, 1, 1);
+  const camera_t camera_id1 = database.WriteCamera(camera);
+  const camera_t camera_id2 = database.WriteCamera(camera);
+  std::vector<image_t> image_ids;
+  for (int i = 0; i < 4; ++i) {
+    Image image;
+    image.SetName("image" + std::to_string(i));
+    image.SetCameraId(i < 3 ? camera_id1 : camera_id2);
+    image_ids.push_back(database.WriteImage(image));
+    database.WriteKeypoints(image_ids.back(), FeatureKeypoints(10));
+  }
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.config = TwoViewGeometry::ConfigurationType::CALIBRATED;
+  two_view_geometry.inlier_matches = {{0, 1}, {2, 3}};
+  database.WriteTwoViewGeometry(image_ids[0], image_ids[1], two_view_geometry);
+  database.WriteTwoViewGeometry(image_ids[1], image_ids[2], two_view_geometry);
+  database.WriteTwoViewGeometry(image_ids[2], image_ids[3], two_view_geometry);
+
+  for (const bool lazy_points2D : {false, true}) {
+    std::shared_ptr<const DatabaseCache> cache =
+        DatabaseCache::Create(database,
+                              /*min_num_matches=*/0,
+                              /*ignore_watermarks=*/false,
+                              /*image_names=*/{},
+                              /*correspondence_graph_cache_path=*/"",
+                              lazy_points2D);
+    EXPECT_EQ(cache->NumImages(), 4);
+
+    const std::unordered_set<std::string> image_names = {"image1", "image2"};
+    auto subset_cache = DatabaseCache::CreateFromCache(*cache, image_names);
+    auto ref_cache = DatabaseCache::Create(database,
+                                           /*min_num_matches=*/0,
+                                           /*ignore_watermarks=*/false,
+                                           image_names);
+    EXPECT_EQ(cache->LazyPoints2D(), lazy_points2D);
+    EXPECT_EQ(subset_cache->LazyPoints2D(), lazy_points2D);
+    EXPECT_EQ(subset_cache->NumCameras(), 1);
+    EXPECT_TRUE(subset_cache->ExistsCamera(camera_id1));
+    EXPECT_EQ(subset_cache->NumImages(), ref_cache->NumImages());
+    for (const auto& image : ref_cache->Images()) {
+      ASSERT_TRUE(subset_cache->ExistsImage(image.first));
+      EXPECT_EQ(subset_cache->Image(image.first).Name(), image.second.Name());
+      EXPECT_EQ(subset_cache->Image(image.first).NumPoints2D(), 10);
+    }
+    EXPECT_EQ(subset_cache->CorrespondenceGraph()->NumImagePairs(),
+              ref_cache->CorrespondenceGraph()->NumImagePairs());
+    EXPECT_EQ(subset_cache->CorrespondenceGraph()->NumCorrespondencesForImage(
+                  image_ids[1]),
+              ref_cache->CorrespondenceGraph()->NumCorrespondencesForImage(
+                  image_ids[1]));
+    EXPECT_EQ(subset_cache->CorrespondenceGraph()->NumCorrespondencesForImage(
+                  image_ids[2]),
+              2);
+
+    // Without image names, all images are used.
+    EXPECT_EQ(DatabaseCache::CreateFromCache(*cache, {})->NumImages(), 4);
+  }
+}
+
+TEST(DatabaseCache, CorrespondenceGraphSnapshot) {
+  Database database(Database::kInMemoryDatabasePath);
+  const Camera camera = Camera::CreateFromModelId(
+      kInvalidCameraId, SimplePinholeCameraModel::model_id, 1, 1, 1);
+  const camera_t camera_id = database.WriteCamera(camera);
+  std::vector<image_t> image_ids;
+  for (int i = 0; i < 3; ++i) {
+    Image image;
+    image.SetName("image" + std::to_string(i));
+    image.SetCameraId(camera_id);
+    image_ids.push_back(database.WriteImage(image));
+    database.WriteKeypoints(image_ids.back(), FeatureKeypoints(10));
+  }
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.config = TwoViewGeometry::ConfigurationType::CALIBRATED;
+  two_view_geometry.inlier_matches = {{0, 1}, {2, 3}};
+  database.WriteTwoViewGeometry(image_ids[0], image_ids[1], two_view_geometry);
+
+  const std::string cache_path = CreateTestDir();
+  auto CreateCache = [&database, &cache_path]() {
+    return DatabaseCache::Create(database,
+                                 /*min_num_matches=*/0,
+                                 /*ignore_watermarks=*/false,
+                                 /*image_names=*/{},
+                                 cache_path);
+  };
+  auto NumSnapshots = [&cache_path]() {
+    return GetFileList(cache_path).size();
+  };
+
+  EXPECT_EQ(CreateCache()->CorrespondenceGraph()->NumImagePairs(), 1);
+  EXPECT_EQ(NumSnapshots(), 1);
+  auto cache = CreateCache();
+  EXPECT_EQ(NumSnapshots(), 1);
+  EXPECT_EQ(cache->CorrespondenceGraph()->NumCorrespondencesBetweenImages(
+                image_ids[0], image_ids[1]),
+            2);
+
+  // Changes to the matches invalidate the snapshot.
+  database.WriteTwoViewGeometry(image_ids[1], image_ids[2], two_view_geometry);
+  cache = CreateCache();
+  EXPECT_EQ(NumSnapshots(), 2);
+  EXPECT_EQ(cache->CorrespondenceGraph()->NumImagePairs(), 2);
+}
+
+TEST(DatabaseCache, LazyPoints2D) {
+  Database database(CreateTestDir() + "/database.db");
+  const Camera camera = Camera::CreateFromModelId(
+      kInvalidCameraId, SimplePinholeCameraModel::model_id, 1, 1, 1);
+  const camera_t camera_id = database.WriteCamera(camera);
+  std::vector<image_t> image_ids;
+  for (int i = 0; i < 2; ++i) {
+    Image image;
+    image.SetName("image" + std::to_string(i));
+    image.SetCameraId(camera_id);
+    image_ids.push_back(database.WriteImage(image));
+    database.WriteKeypoints(image_ids.back(), FeatureKeypoints(10 + i));
+  }
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.config = TwoViewGeometry::ConfigurationType::CALIBRATED;
+  two_view_geometry.inlier_matches = {{0, 1}, {2, 3}};
+  database.WriteTwoViewGeometry(image_ids[0], image_ids[1], two_view_geometry);
+
+  auto cache = DatabaseCache::Create(database,
+                                     /*min_num_matches=*/0,
+                                     /*ignore_watermarks=*/false,
+                                     /*image_names=*/{},
+                                     /*correspondence_graph_cache_path=*/"",
+                                     /*lazy_points2D=*/true);
+  EXPECT_TRUE(cache->LazyPoints2D());
+  EXPECT_EQ(cache->NumImages(), 2);
+  EXPECT_EQ(cache->Images().at(image_ids[1]).NumPoints2D(), 0);
+  EXPECT_EQ(cache->CorrespondenceGraph()->NumCorrespondencesForImage(
+                image_ids[1]),
+            2);
+  EXPECT_EQ(cache->Image(image_ids[1]).NumPoints2D(), 11);
+  EXPECT_EQ(cache->Images().at(image_ids[1]).NumPoints2D(), 11);
+  cache->EvictPoints2D(image_ids[1]);
+  EXPECT_EQ(cache->Images().at(image_ids[1]).NumPoints2D(), 0);
+  EXPECT_EQ(cache->Image(image_ids[1]).NumPoints2D(), 11);
+
+  // Falls back to loading all points for in-memory databases.
+  Database in_memory_database(Database::kInMemoryDatabasePath);
+  EXPECT_FALSE(DatabaseCache::Create(in_memory_database,
+                                     /*min_num_matches=*/0,
+                                     /*ignore_watermarks=*/false,
+                                     /*image_names=*/{},
+                                     /*correspondence_graph_cache_path=*/"",
+                                     /*lazy_points2D=*/true)
+                   ->LazyPoints2D());
+}
+
+TEST(DatabaseCache, MaxNumNeighbors) {
+  Database database(Database::kInMemoryDatabasePath);
+  const Camera camera = Camera::CreateFromModelId(
+      kInvalidCameraId, SimplePinholeCameraModel::model_id, 1, 1, 1);
+  const camera_t camera_id = database.WriteCamera(camera);
+  std::vector<image_t> image_ids;
+  for (int i = 0; i < 6; ++i) {
+    Image image;
+    image.SetName("image" + std::to_string(i));
+    image.SetCameraId(camera_id);
+    image_ids.push_back(database.WriteImage(image));
+    database.WriteKeypoints(image_ids.back(), FeatureKeypoints(10));
+  }
+  // The first four images are fully connected and the last two images form a
+  // separate component.
+  const std::vector<std::tuple<int, int, int>> image_pairs = {
+      {0, 1, 6},
+      {2, 3, 5},
+      {0, 2, 4},
+      {1, 3, 3},
+      {0, 3, 2},
+      {1, 2, 1},
+      {4, 5, 1}};
+  for (const auto& image_pair : image_pairs) {
+    TwoViewGeometry two_view_geometry;
+    two_view_geometry.config = TwoViewGeometry::ConfigurationType::CALIBRATED;
+    for (int i = 0; i < std::get<2>(image_pair); ++i) {
+      two_view_geometry.inlier_matches.emplace_back(i, i);
+    }
+    database.WriteTwoViewGeometry(image_ids[std::get<0>(image_pair)],
+                                  image_ids[std::get<1>(image_pair)],
+                                  two_view_geometry);
+  }
+
+  auto CreateCache = [&database](size_t max_num_neighbors) {
+    return DatabaseCache::Create(database,
+                                 /*min_num_matches=*/1,
+                                 /*ignore_watermarks=*/false,
+                                 /*image_names=*/{},
+                                 /*correspondence_graph_cache_path=*/"",
+                                 /*lazy_points2D=*/false,
+                                 max_num_neighbors);
+  };
+
+  EXPECT_EQ(CreateCache(0)->CorrespondenceGraph()->NumImagePairs(), 7);
+
+  // Only the spanning tree remains for a single neighbor per image.
+  auto cache = CreateCache(1);
+  EXPECT_EQ(cache->NumImages(), 6);
+  EXPECT_EQ(cache->CorrespondenceGraph()->NumImagePairs(), 4);
+  EXPECT_TRUE(cache->CorrespondenceGraph()->ExistsImagePair(image_ids[0],
+                                                             image_ids[1]));
+  EXPECT_TRUE(cache->CorrespondenceGraph()->ExistsImagePair(image_ids[2],
+                                                             image_ids[3]));
+  EXPECT_TRUE(cache->CorrespondenceGraph()->ExistsImagePair(image_ids[0],
+                                                             image_ids[2]));
+  EXPECT_TRUE(cache->CorrespondenceGraph()->ExistsImagePair(image_ids[4],
+                                                             image_ids[5]));
+
+  // The second best pair of the images 1 and 3 is kept in addition.
+  cache = CreateCache(2);
+  EXPECT_EQ(cache->CorrespondenceGraph()->NumImagePairs(), 5);
+  EXPECT_TRUE(cache->CorrespondenceGraph()->ExistsImagePair(image_ids[1],
+                                                             image_ids[3]));
+  EXPECT_FALSE(cache->CorrespondenceGraph()->ExistsImagePair(image_ids[0],
+                                                              image_ids[3]));
+  EXPECT_FALSE(cache->CorrespondenceGraph()->ExistsImagePair(image_ids[1],
+                                                              image_ids[2]));
+}
+
 }  // namespace
 }  // namespace colmap
@@ -31,7 +31,9 @@
 
 #include "colmap/geometry/pose.h"
 #include "colmap/util/eigen_alignment.h"
+#include "colmap/util/testing.h"
 
+#include <limits>
 #include <thread>
 
 #include <Eigen/Geometry>
@@ -178,6 +180,120 @@ TEST(Database, Image) {
   EXPECT_EQ(database.NumImages(), 0);
 }
 
+TEST(Database, ImageContentHash) {
+  Database database(Database::kInMemoryDatabasePath);
+  Camera camera = Camera::CreateFromModelName(
+      kInvalidCameraId, "SIMPLE_PINHOLE", 1.0, 1, 1);
+  camera.camera_id = database.WriteCamera(camera);
+  Image image1;
+  image1.SetName("test1");
+  image1.SetCameraId(camera.camera_id);
+  image1.SetImageId(database.WriteImage(image1));
+  Image image2;
+  image2.SetName("test2");
+  image2.SetCameraId(camera.camera_id);
+  image2.SetImageId(database.WriteImage(image2));
+  EXPECT_TRUE(database.ReadAllImageContentHashes().empty());
+  const uint64_t kContentHash = std::numeric_limits<uint64_t>::max() - 1;
+  database.WriteImageContentHash(image1.ImageId(), kContentHash);
+  const auto content_hashes = database.ReadAllImageContentHashes();
+  EXPECT_EQ(content_hashes.size(), 1);
+  EXPECT_EQ(content_hashes.at(image1.ImageId()), kContentHash);
+  database.WriteImageContentHash(image1.ImageId(), 1);
+  EXPECT_EQ(database.ReadAllImageContentHashes().at(image1.ImageId()), 1);
+  EXPECT_EQ(database.ReadImage(image1.ImageId()).Name(), image1.Name());
+}
+
+TEST(Database, DeleteImageFeatures) {
+  Database database(Database::kInMemoryDatabasePath);
+  Camera camera;
+  camera.camera_id = database.WriteCamera(camera);
+  for (int i = 1; i <= 4; ++i) {
+    Image image;
+    image.SetName("test" + std::to_string(i));
+    image.SetCameraId(camera.camera_id);
+    database.WriteImage(image);
+  }
+  for (const image_t image_id : {1, 2, 3}) {
+    database.WriteKeypoints(image_id, FeatureKeypoints(10));
+    database.WriteDescriptors(image_id, FeatureDescriptors(10, 128));
+  }
+  database.WriteKeypoints(4, FeatureKeypoints(10));
+  EXPECT_EQ(database.ReadImageIdsWithFeatures(),
+            std::unordered_set<image_t>({1, 2, 3}));
+  database.WriteMatches(1, 2, FeatureMatches(5));
+  database.WriteMatches(3, 2, FeatureMatches(5));
+  database.WriteMatches(1, 3, FeatureMatches(5));
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.inlier_matches = FeatureMatches(5);
+  database.WriteTwoViewGeometry(1, 2, two_view_geometry);
+  database.WriteTwoViewGeometry(1, 3, two_view_geometry);
+  database.DeleteImageFeatures(2);
+  EXPECT_FALSE(database.ExistsKeypoints(2));
+  EXPECT_FALSE(database.ExistsDescriptors(2));
+  EXPECT_TRUE(database.ExistsKeypoints(1));
+  EXPECT_TRUE(database.ExistsDescriptors(3));
+  EXPECT_EQ(database.ReadImageIdsWithFeatures(),
+            std::unordered_set<image_t>({1, 3}));
+  EXPECT_FALSE(database.ExistsMatches(1, 2));
+  EXPECT_FALSE(database.ExistsMatches(2, 3));
+  EXPECT_TRUE(database.ExistsMatches(1, 3));
+  EXPECT_FALSE(database.ExistsInlierMatches(1, 2));
+  EXPECT_TRUE(database.ExistsInlierMatches(1, 3));
+}
+
+TEST(Database, DeleteImages) {
+  const std::string test_dir = CreateTestDir();
+  Database database(test_dir + "/database.db");
+  Camera camera;
+  camera.camera_id = database.WriteCamera(camera);
+  for (int i = 1; i <= 4; ++i) {
+    Image image;
+    image.SetName("test" + std::to_string(i));
+    image.SetCameraId(camera.camera_id);
+    const image_t image_id = database.WriteImage(image);
+    database.WriteKeypoints(image_id, FeatureKeypoints(10));
+    database.WriteDescriptors(image_id, FeatureDescriptors(10, 128));
+    database.WritePosePrior(
+        image_id,
+        PosePrior(Eigen::Vector3d::Zero(),
+                  PosePrior::CoordinateSystem::CARTESIAN));
+  }
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.inlier_matches = FeatureMatches(5);
+  const std::vector<std::pair<image_t, image_t>> image_pairs = {
+      {1, 2}, {3, 2}, {1, 3}, {3, 4}};
+  for (const auto& image_pair : image_pairs) {
+    database.WriteMatches(
+        image_pair.first, image_pair.second, FeatureMatches(5));
+    database.WriteTwoViewGeometry(
+        image_pair.first, image_pair.second, two_view_geometry);
+  }
+
+  database.DeleteImages({2, 4, 2});
+  EXPECT_EQ(database.NumImages(), 2);
+  EXPECT_TRUE(database.ExistsImage(1));
+  EXPECT_FALSE(database.ExistsImage(2));
+  EXPECT_FALSE(database.ExistsKeypoints(2));
+  EXPECT_FALSE(database.ExistsDescriptors(4));
+  EXPECT_TRUE(database.ExistsKeypoints(3));
+  EXPECT_EQ(database.NumPosePriors(), 2);
+  EXPECT_EQ(database.NumMatchedImagePairs(), 1);
+  EXPECT_TRUE(database.ExistsMatches(1, 3));
+  EXPECT_TRUE(database.ExistsInlierMatches(1, 3));
+  EXPECT_FALSE(database.ExistsInlierMatches(3, 4));
+
+  database.DeleteImagePairs({Database::ImagePairToPairId(3, 1)});
+  EXPECT_EQ(database.NumMatchedImagePairs(), 0);
+  EXPECT_FALSE(database.ExistsInlierMatches(1, 3));
+
+  const std::string vacuum_path = test_dir + "/vacuum.db";
+  database.VacuumInto(vacuum_path);
+  Database vacuum_database(vacuum_path);
+  EXPECT_EQ(vacuum_database.NumImages(), 2);
+  EXPECT_EQ(vacuum_database.NumKeypoints(), 20);
+}
+
 TEST(Database, PosePrior) {
   Database database(Database::kInMemoryDatabasePath);
   Camera camera;
@@ -196,7 +312,13 @@ TEST(Database, PosePrior) {
   EXPECT_EQ(read_pose_prior.position, pose_prior.position);
   EXPECT_EQ(read_pose_prior.coordinate_system, pose_prior.coordinate_system);
   EXPECT_TRUE(read_pose_prior.IsValid());
+  const auto pose_priors = database.ReadAllPosePriors();
+  EXPECT_EQ(pose_priors.size(), 1);
+  EXPECT_EQ(pose_priors.at(image.ImageId()).position, pose_prior.position);
+  EXPECT_EQ(pose_priors.at(image.ImageId()).coordinate_system,
+            pose_prior.coordinate_system);
   database.ClearPosePriors();
+  EXPECT_TRUE(database.ReadAllPosePriors().empty());
   EXPECT_EQ(database.NumPosePriors(), 0);
 }
 
@@ -276,6 +398,128 @@ TEST(Database, Descriptors) {
   EXPECT_EQ(database.NumDescriptorsForImage(image.ImageId()), 0);
 }
 
+TEST(Database, ReadBatched) {
+  Database database(Database::kInMemoryDatabasePath);
+  Camera camera;
+  camera.camera_id = database.WriteCamera(camera);
+  std::vector<image_t> image_ids;
+  std::vector<FeatureDescriptors> descriptors;
+  // Exceed the batch size to test multiple queries.
+  const int num_images = Database::kReadBatchSize + 10;
+  for (int i = 0; i < num_images; ++i) {
+    Image image;
+    image.SetName("test" + std::to_string(i));
+    image.SetCameraId(camera.camera_id);
+    image_ids.push_back(database.WriteImage(image));
+    // Leave some images without features.
+    if (i % 10 != 0) {
+      database.WriteKeypoints(image_ids.back(), FeatureKeypoints(i));
+      descriptors.push_back(FeatureDescriptors::Random(i, 128));
+      database.WriteDescriptors(image_ids.back(), descriptors.back());
+    } else {
+      descriptors.emplace_back();
+    }
+  }
+
+  // Query in reverse order with a duplicate entry.
+  std::vector<image_t> query_image_ids(image_ids.rbegin(), image_ids.rend());
+  query_image_ids.push_back(image_ids[1]);
+
+  const std::vector<FeatureKeypoints> keypoints_read =
+      database.ReadKeypoints(query_image_ids);
+  const std::vector<FeatureDescriptors> descriptors_read =
+      database.ReadDescriptors(query_image_ids);
+  ASSERT_EQ(keypoints_read.size(), query_image_ids.size());
+  ASSERT_EQ(descriptors_read.size(), query_image_ids.size());
+  for (size_t i = 0; i < query_image_ids.size(); ++i) {
+    const int idx = i < image_ids.size() ? num_images - 1 - i : 1;
+    EXPECT_EQ(keypoints_read[i].size(), idx % 10 != 0 ? idx : 0);
+    EXPECT_EQ(descriptors_read[i], descriptors[idx]);
+  }
+
+  EXPECT_TRUE(database.ReadKeypoints(std::vector<image_t>()).empty());
+}
+
+TEST(Database, CompressBlobs) {
+  Database database(Database::kInMemoryDatabasePath);
+  EXPECT_FALSE(database.CompressBlobs());
+  Camera camera;
+  camera.camera_id = database.WriteCamera(camera);
+  std::vector<image_t> image_ids;
+  for (int i = 0; i < 3; ++i) {
+    Image image;
+    image.SetName("test" + std::to_string(i));
+    image.SetCameraId(camera.camera_id);
+    image_ids.push_back(database.WriteImage(image));
+  }
+
+  FeatureMatches matches(100);
+  for (size_t i = 0; i < matches.size(); ++i) {
+    matches[i].point2D_idx1 = 3 * i;
+    matches[i].point2D_idx2 = 1000000 - i;
+  }
+  // Unsorted and large indices must also be preserved.
+  std::swap(matches[10], matches[20]);
+  matches.back().point2D_idx1 = std::numeric_limits<point2D_t>::max() - 1;
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.config = TwoViewGeometry::CALIBRATED;
+  two_view_geometry.inlier_matches = matches;
+
+  // Mix uncompressed and compressed entries in the same database.
+  const FeatureDescriptors descriptors1 = FeatureDescriptors::Random(10, 128);
+  database.WriteDescriptors(image_ids[0], descriptors1);
+  database.WriteMatches(image_ids[1], image_ids[0], matches);
+  database.SetCompressBlobs(true);
+  EXPECT_TRUE(database.CompressBlobs());
+  const FeatureDescriptors descriptors2 = FeatureDescriptors::Zero(20, 128);
+  const FeatureDescriptors descriptors3 = FeatureDescriptors::Random(30, 128);
+  database.WriteDescriptors(image_ids[1], descriptors2);
+  database.WriteDescriptors(image_ids[2], descriptors3);
+  database.WriteMatches(image_ids[2], image_ids[0], matches);
+  database.WriteMatches(image_ids[1], image_ids[2], FeatureMatches());
+  database.WriteTwoViewGeometry(image_ids[2], image_ids[0], two_view_geometry);
+
+  EXPECT_EQ(database.ReadDescriptors(image_ids[0]), descriptors1);
+  EXPECT_EQ(database.ReadDescriptors(image_ids[1]), descriptors2);
+  EXPECT_EQ(database.ReadDescriptors(image_ids[2]), descriptors3);
+  const std::vector<FeatureDescriptors> descriptors_read =
+      database.ReadDescriptors(image_ids);
+  ASSERT_EQ(descriptors_read.size(), 3);
+  EXPECT_EQ(descriptors_read[0], descriptors1);
+  EXPECT_EQ(descriptors_read[1], descriptors2);
+  EXPECT_EQ(descriptors_read[2], descriptors3);
+  EXPECT_EQ(database.NumDescriptors(), 60);
+
+  auto ExpectEqualMatches = [](const FeatureMatches& matches1,
+                               const FeatureMatches& matches2) {
+    ASSERT_EQ(matches1.size(), matches2.size());
+    for (size_t i = 0; i < matches1.size(); ++i) {
+      EXPECT_EQ(matches1[i].point2D_idx1, matches2[i].point2D_idx1);
+      EXPECT_EQ(matches1[i].point2D_idx2, matches2[i].point2D_idx2);
+    }
+  };
+
+  ExpectEqualMatches(database.ReadMatches(image_ids[1], image_ids[0]), matches);
+  ExpectEqualMatches(database.ReadMatches(image_ids[2], image_ids[0]), matches);
+  EXPECT_TRUE(database.ReadMatches(image_ids[1], image_ids[2]).empty());
+  const auto all_matches = database.ReadAllMatches();
+  ASSERT_EQ(all_matches.size(), 2);
+  for (const auto& pair_matches : all_matches) {
+    EXPECT_EQ(pair_matches.second.size(), matches.size());
+  }
+  EXPECT_EQ(database.NumMatches(), 2 * matches.size());
+
+  ExpectEqualMatches(
+      database.ReadTwoViewGeometry(image_ids[2], image_ids[0]).inlier_matches,
+      matches);
+  std::vector<image_pair_t> image_pair_ids;
+  std::vector<TwoViewGeometry> two_view_geometries;
+  database.ReadTwoViewGeometries(&image_pair_ids, &two_view_geometries);
+  ASSERT_EQ(two_view_geometries.size(), 1);
+  EXPECT_EQ(two_view_geometries[0].config, TwoViewGeometry::CALIBRATED);
+  EXPECT_EQ(two_view_geometries[0].inlier_matches.size(), matches.size());
+}
+
 TEST(Database, Matches) {
   Database database(Database::kInMemoryDatabasePath);
   const image_t image_id1 = 1;
@@ -319,6 +563,22 @@ TEST(Database, Matches) {
   EXPECT_EQ(database.ReadAllMatches().size(), 1);
   EXPECT_EQ(database.ReadAllMatches()[0].first,
             Database::ImagePairToPairId(image_id1, image_id2));
+  size_t num_streamed = 0;
+  database.ReadAllMatches(
+      [&](const image_pair_t pair_id, const FeatureMatches& matches) {
+        EXPECT_EQ(pair_id, Database::ImagePairToPairId(image_id1, image_id2));
+        EXPECT_EQ(matches.size(), kNumMatches);
+        num_streamed += 1;
+      });
+  EXPECT_EQ(num_streamed, 1);
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<int> num_matches;
+  database.ReadNumMatches(&image_pairs, &num_matches);
+  ASSERT_EQ(image_pairs.size(), 1);
+  ASSERT_EQ(num_matches.size(), 1);
+  EXPECT_EQ(image_pairs[0].first, image_id1);
+  EXPECT_EQ(image_pairs[0].second, image_id2);
+  EXPECT_EQ(num_matches[0], kNumMatches);
   EXPECT_EQ(database.NumMatches(), kNumMatches);
   database.DeleteMatches(image_id1, image_id2);
   EXPECT_EQ(database.NumMatches(), 0);
@@ -328,6 +588,162 @@ TEST(Database, Matches) {
   EXPECT_EQ(database.NumMatches(), 0);
 }
 
+TEST(Database, ReadOnlyConnection) {
+  Database in_memory_database(Database::kInMemoryDatabasePath);
+  EXPECT_EQ(in_memory_database.OpenReadOnlyConnection(), nullptr);
+
+  Database database(CreateTestDir() + "/database.db");
+  Camera camera;
+  camera.camera_id = database.WriteCamera(camera);
+  std::vector<image_t> image_ids;
+  std::vector<FeatureDescriptors> descriptors;
+  for (int i = 0; i < 10; ++i) {
+    Image image;
+    image.SetName("test" + std::to_string(i));
+    image.SetCameraId(camera.camera_id);
+    image_ids.push_back(database.WriteImage(image));
+    descriptors.push_back(FeatureDescriptors::Random(i + 1, 128));
+    database.WriteDescriptors(image_ids.back(), descriptors.back());
+  }
+
+  {
+    // Read concurrently while the writer has an open transaction.
+    DatabaseTransaction transaction(&database);
+    database.WriteMatches(image_ids[0], image_ids[1], FeatureMatches(10));
+    constexpr int kNumThreads = 4;
+    std::vector<std::unique_ptr<Database>> read_databases;
+    for (int i = 0; i < kNumThreads; ++i) {
+      read_databases.push_back(database.OpenReadOnlyConnection());
+      ASSERT_NE(read_databases.back(), nullptr);
+    }
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kNumThreads; ++t) {
+      threads.emplace_back([&, t]() {
+        for (size_t i = 0; i < image_ids.size(); ++i) {
+          EXPECT_EQ(read_databases[t]->ReadDescriptors(image_ids[i]),
+                    descriptors[i]);
+        }
+        // Uncommitted changes are not visible.
+        EXPECT_FALSE(
+            read_databases[t]->ExistsMatches(image_ids[0], image_ids[1]));
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  std::unique_ptr<Database> read_database = database.OpenReadOnlyConnection();
+  EXPECT_TRUE(read_database->ExistsMatches(image_ids[0], image_ids[1]));
+}
+
+TEST(Database, OpenShards) {
+  const std::string test_dir = CreateTestDir();
+  const std::vector<std::string> paths = {test_dir + "/shard1.db",
+                                          test_dir + "/shard2.db"};
+  std::vector<FeatureKeypoints> keypoints;
+  std::vector<FeatureMatches> matches;
+  for (size_t i = 0; i < paths.size(); ++i) {
+    Database database(paths[i]);
+    Camera camera = Camera::CreateFromModelName(
+        kInvalidCameraId, "SIMPLE_PINHOLE", 1, 1, 1);
+    camera.camera_id = database.WriteCamera(camera);
+    std::vector<image_t> image_ids;
+    for (size_t j = 0; j < 2 + i; ++j) {
+      Image image;
+      image.SetName("shard" + std::to_string(i) + "_" + std::to_string(j));
+      image.SetCameraId(camera.camera_id);
+      image_ids.push_back(database.WriteImage(image));
+      keypoints.push_back(FeatureKeypoints(10 * (i + 1) + j));
+      database.WriteKeypoints(image_ids.back(), keypoints.back());
+    }
+    matches.push_back(FeatureMatches(5 * (i + 1)));
+    database.WriteMatches(image_ids[1], image_ids[0], matches.back());
+    TwoViewGeometry two_view_geometry;
+    two_view_geometry.config = TwoViewGeometry::CALIBRATED;
+    two_view_geometry.inlier_matches = matches.back();
+    database.WriteTwoViewGeometry(
+        image_ids[1], image_ids[0], two_view_geometry);
+  }
+
+  Database database;
+  database.OpenShards(paths);
+  EXPECT_EQ(database.NumCameras(), 2);
+  EXPECT_EQ(database.NumImages(), 5);
+  EXPECT_EQ(database.NumMatchedImagePairs(), 2);
+  EXPECT_EQ(database.NumVerifiedImagePairs(), 2);
+  EXPECT_TRUE(database.ExistsCamera(2));
+  for (image_t image_id = 1; image_id <= 5; ++image_id) {
+    const Image image = database.ReadImage(image_id);
+    EXPECT_EQ(image.CameraId(), image_id <= 2 ? 1 : 2);
+    EXPECT_EQ(database.ReadKeypoints(image_id).size(),
+              keypoints[image_id - 1].size());
+  }
+  EXPECT_EQ(database.ReadImageWithName("shard1_2").ImageId(), 5);
+  EXPECT_EQ(database.ReadMatches(1, 2).size(), matches[0].size());
+  EXPECT_EQ(database.ReadMatches(4, 3).size(), matches[1].size());
+  EXPECT_FALSE(database.ExistsMatches(2, 3));
+  EXPECT_EQ(database.ReadTwoViewGeometry(3, 4).inlier_matches.size(),
+            matches[1].size());
+  const auto all_matches = database.ReadAllMatches();
+  ASSERT_EQ(all_matches.size(), 2);
+  EXPECT_EQ(all_matches[1].first, Database::ImagePairToPairId(3, 4));
+}
+
+TEST(Database, FeatureStore) {
+  Database database(Database::kInMemoryDatabasePath);
+  EXPECT_FALSE(database.HasFeatureStore());
+  database.AttachFeatureStore(CreateTestDir());
+  EXPECT_TRUE(database.HasFeatureStore());
+  Camera camera;
+  camera.camera_id = database.WriteCamera(camera);
+  Image image;
+  image.SetName("test");
+  image.SetCameraId(camera.camera_id);
+  const image_t image_id1 = database.WriteImage(image);
+  image.SetName("test2");
+  const image_t image_id2 = database.WriteImage(image);
+
+  const FeatureKeypoints keypoints = FeatureKeypoints(10);
+  database.WriteKeypoints(image_id1, keypoints);
+  EXPECT_TRUE(database.ExistsKeypoints(image_id1));
+  EXPECT_EQ(database.ReadKeypoints(image_id1).size(), keypoints.size());
+  EXPECT_EQ(database.NumKeypoints(), 10);
+  EXPECT_EQ(database.MaxNumKeypoints(), 10);
+  EXPECT_EQ(database.NumKeypointsForImage(image_id1), 10);
+  EXPECT_ANY_THROW(database.WriteKeypoints(image_id1, keypoints));
+
+  const FeatureDescriptors descriptors = FeatureDescriptors::Random(10, 128);
+  database.WriteDescriptors(image_id1, descriptors);
+  EXPECT_TRUE(database.ExistsDescriptors(image_id1));
+  EXPECT_EQ(database.ReadDescriptors(image_id1), descriptors);
+  EXPECT_EQ(database.NumDescriptors(), 10);
+  EXPECT_EQ(database.NumDescriptorsForImage(image_id2), 0);
+
+  FeatureMatches matches12(2);
+  matches12[0] = FeatureMatch(0, 1);
+  matches12[1] = FeatureMatch(2, 3);
+  database.WriteMatches(image_id2, image_id1, matches12);
+  EXPECT_TRUE(database.ExistsMatches(image_id1, image_id2));
+  EXPECT_EQ(database.NumMatches(), 2);
+  EXPECT_EQ(database.NumMatchedImagePairs(), 1);
+  const FeatureMatches matches21 = database.ReadMatches(image_id1, image_id2);
+  EXPECT_EQ(matches21[1].point2D_idx1, 3);
+  EXPECT_EQ(matches21[1].point2D_idx2, 2);
+  const auto all_matches = database.ReadAllMatches();
+  EXPECT_EQ(all_matches.size(), 1);
+  EXPECT_EQ(all_matches[0].first,
+            Database::ImagePairToPairId(image_id1, image_id2));
+  database.DeleteMatches(image_id1, image_id2);
+  EXPECT_FALSE(database.ExistsMatches(image_id1, image_id2));
+
+  // The SQLite tables remain untouched while the store is attached.
+  database.DetachFeatureStore();
+  EXPECT_FALSE(database.ExistsKeypoints(image_id1));
+  EXPECT_FALSE(database.ExistsDescriptors(image_id1));
+  EXPECT_EQ(database.NumKeypoints(), 0);
+}
+
 TEST(Database, TwoViewGeometry) {
   Database database(Database::kInMemoryDatabasePath);
   const image_t image_id1 = 1;
@@ -400,14 +816,38 @@ TEST(Database, TwoViewGeometry) {
             two_view_geometries[0].cam2_from_cam1.translation);
   EXPECT_EQ(two_view_geometry.inlier_matches.size(),
             two_view_geometries[0].inlier_matches.size());
+  size_t num_streamed = 0;
+  database.ReadTwoViewGeometries([&](const image_pair_t pair_id,
+                                     const TwoViewGeometry& streamed) {
+    EXPECT_EQ(pair_id, Database::ImagePairToPairId(image_id1, image_id2));
+    EXPECT_EQ(streamed.config, two_view_geometry.config);
+    EXPECT_EQ(streamed.F, two_view_geometry.F);
+    EXPECT_EQ(streamed.inlier_matches.size(),
+              two_view_geometry.inlier_matches.size());
+    num_streamed += 1;
+  });
+  EXPECT_EQ(num_streamed, 1);
   std::vector<std::pair<image_t, image_t>> image_pairs;
   std::vector<int> num_inliers;
-  database.ReadTwoViewGeometryNumInliers(&image_pairs, &num_inliers);
+  std::vector<int> configs;
+  database.ReadTwoViewGeometryNumInliers(&image_pairs, &num_inliers, &configs);
   EXPECT_EQ(image_pairs.size(), 1);
   EXPECT_EQ(num_inliers.size(), 1);
   EXPECT_EQ(image_pairs[0].first, image_id1);
   EXPECT_EQ(image_pairs[0].second, image_id2);
   EXPECT_EQ(num_inliers[0], two_view_geometry.inlier_matches.size());
+  ASSERT_EQ(configs.size(), 1);
+  EXPECT_EQ(configs[0], two_view_geometry.config);
+  size_t num_streamed_inliers = 0;
+  database.ReadTwoViewGeometryNumInliers([&](const image_pair_t pair_id,
+                                             const int pair_num_inliers,
+                                             const int config) {
+    EXPECT_EQ(pair_id, Database::ImagePairToPairId(image_id1, image_id2));
+    EXPECT_EQ(pair_num_inliers, two_view_geometry.inlier_matches.size());
+    EXPECT_EQ(config, two_view_geometry.config);
+    num_streamed_inliers += 1;
+  });
+  EXPECT_EQ(num_streamed_inliers, 1);
   EXPECT_EQ(database.NumInlierMatches(), 1000);
   database.DeleteInlierMatches(image_id1, image_id2);
   EXPECT_EQ(database.NumInlierMatches(), 0);
@@ -512,5 +952,68 @@ TEST(Database, Merge) {
   EXPECT_EQ(merged_database.NumMatches(), 0);
 }
 
+TEST(Database, MergeImagePairs) {
+  Database source_database(Database::kInMemoryDatabasePath);
+  Database target_database(Database::kInMemoryDatabasePath);
+
+  Camera camera = Camera::CreateFromModelName(
+      kInvalidCameraId, "SIMPLE_PINHOLE", 1.0, 1, 1);
+  camera.camera_id = source_database.WriteCamera(camera);
+  camera.camera_id = target_database.WriteCamera(camera);
+
+  Image image;
+  image.SetCameraId(camera.camera_id);
+
+  // The images are written in different order, so their identifiers differ.
+  image.SetName("test1");
+  const image_t source_image_id1 = source_database.WriteImage(image);
+  image.SetName("test2");
+  const image_t source_image_id2 = source_database.WriteImage(image);
+  image.SetName("test3");
+  const image_t source_image_id3 = source_database.WriteImage(image);
+  image.SetName("test2");
+  const image_t target_image_id2 = target_database.WriteImage(image);
+  image.SetName("test1");
+  const image_t target_image_id1 = target_database.WriteImage(image);
+
+  FeatureMatches matches12(2);
+  matches12[0].point2D_idx1 = 0;
+  matches12[0].point2D_idx2 = 1;
+  matches12[1].point2D_idx1 = 2;
+  matches12[1].point2D_idx2 = 3;
+  source_database.WriteMatches(source_image_id1, source_image_id2, matches12);
+  source_database.WriteMatches(
+      source_image_id1, source_image_id3, FeatureMatches(5));
+  TwoViewGeometry two_view_geometry;
+  two_view_geometry.config = TwoViewGeometry::UNCALIBRATED;
+  two_view_geometry.inlier_matches = matches12;
+  source_database.WriteTwoViewGeometry(
+      source_image_id1, source_image_id2, two_view_geometry);
+
+  // Existing image pairs are overwritten.
+  target_database.WriteMatches(
+      target_image_id1, target_image_id2, FeatureMatches(7));
+  target_database.WriteTwoViewGeometry(
+      target_image_id1, target_image_id2, TwoViewGeometry());
+
+  Database::MergeImagePairs(source_database, &target_database);
+  EXPECT_EQ(target_database.NumMatchedImagePairs(), 1);
+  EXPECT_EQ(target_database.NumMatches(), 2);
+  EXPECT_EQ(target_database.NumInlierMatches(), 2);
+  const FeatureMatches merged_matches =
+      target_database.ReadMatches(target_image_id1, target_image_id2);
+  ASSERT_EQ(merged_matches.size(), 2);
+  EXPECT_EQ(merged_matches[0].point2D_idx1, 0);
+  EXPECT_EQ(merged_matches[0].point2D_idx2, 1);
+  EXPECT_EQ(merged_matches[1].point2D_idx1, 2);
+  EXPECT_EQ(merged_matches[1].point2D_idx2, 3);
+  const TwoViewGeometry merged_two_view_geometry =
+      target_database.ReadTwoViewGeometry(target_image_id1, target_image_id2);
+  EXPECT_EQ(merged_two_view_geometry.config, TwoViewGeometry::UNCALIBRATED);
+  ASSERT_EQ(merged_two_view_geometry.inlier_matches.size(), 2);
+  EXPECT_EQ(merged_two_view_geometry.inlier_matches[1].point2D_idx1, 2);
+  EXPECT_EQ(merged_two_view_geometry.inlier_matches[1].point2D_idx2, 3);
+}
+
 }  // namespace
 }  // namespace colmap
@@ -0,0 +1,371 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/scene/feature_store.h"
+
+#include "colmap/util/endian.h"
+#include "colmap/util/misc.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace colmap {
+namespace {
+
+// Deleted entries are marked by an index record with this offset.
+constexpr uint64_t kDeletedOffset = std::numeric_limits<uint64_t>::max();
+
+// Size of a serialized index record: key, offset, rows, cols.
+constexpr size_t kIndexRecordNumBytes =
+    2 * sizeof(uint64_t) + 2 * sizeof(uint32_t);
+
+// Blobs are padded to this alignment such that the views are well aligned.
+constexpr uint64_t kBlobAlignment = 16;
+
+}  // namespace
+
+FeatureStore::FeatureStore(const std::string& path) { Open(path); }
+
+void FeatureStore::Open(const std::string& path) {
+  Close();
+  CreateDirIfNotExists(path, /*recursive=*/true);
+  keypoints_.Open(JoinPaths(path, "keypoints.bin"),
+                  JoinPaths(path, "keypoints.idx"),
+                  sizeof(FeatureKeypointsBlob::Scalar));
+  descriptors_.Open(JoinPaths(path, "descriptors.bin"),
+                    JoinPaths(path, "descriptors.idx"),
+                    sizeof(FeatureDescriptors::Scalar));
+  matches_.Open(JoinPaths(path, "matches.bin"),
+                JoinPaths(path, "matches.idx"),
+                sizeof(FeatureMatchesBlob::Scalar));
+  path_ = path;
+  is_open_ = true;
+}
+
+void FeatureStore::Close() {
+  if (!is_open_) {
+    return;
+  }
+  keypoints_.Close();
+  descriptors_.Close();
+  matches_.Close();
+  path_.clear();
+  is_open_ = false;
+}
+
+bool FeatureStore::ExistsKeypoints(const image_t image_id) const {
+  return keypoints_.Find(image_id) != nullptr;
+}
+
+bool FeatureStore::ExistsDescriptors(const image_t image_id) const {
+  return descriptors_.Find(image_id) != nullptr;
+}
+
+bool FeatureStore::ExistsMatches(const image_pair_t pair_id) const {
+  return matches_.Find(pair_id) != nullptr;
+}
+
+size_t FeatureStore::NumKeypoints() const { return keypoints_.SumRows(); }
+
+size_t FeatureStore::NumDescriptors() const { return descriptors_.SumRows(); }
+
+size_t FeatureStore::NumMatches() const { return matches_.SumRows(); }
+
+size_t FeatureStore::MaxNumKeypoints() const { return keypoints_.MaxRows(); }
+
+size_t FeatureStore::MaxNumDescriptors() const {
+  return descriptors_.MaxRows();
+}
+
+size_t FeatureStore::NumKeypointsForImage(const image_t image_id) const {
+  const Table::Entry* entry = keypoints_.Find(image_id);
+  return entry == nullptr ? 0 : entry->rows;
+}
+
+size_t FeatureStore::NumDescriptorsForImage(const image_t image_id) const {
+  const Table::Entry* entry = descriptors_.Find(image_id);
+  return entry == nullptr ? 0 : entry->rows;
+}
+
+size_t FeatureStore::NumMatchedImagePairs() const {
+  return matches_.NumEntries();
+}
+
+std::vector<image_pair_t> FeatureStore::ReadMatchedImagePairIds() const {
+  const std::vector<uint64_t> keys = matches_.Keys();
+  return std::vector<image_pair_t>(keys.begin(), keys.end());
+}
+
+FeatureStore::ConstView<FeatureKeypointsBlob> FeatureStore::ReadKeypointsBlob(
+    const image_t image_id) const {
+  return ReadBlob<FeatureKeypointsBlob>(keypoints_, image_id);
+}
+
+FeatureStore::ConstView<FeatureDescriptors> FeatureStore::ReadDescriptors(
+    const image_t image_id) const {
+  return ReadBlob<FeatureDescriptors>(descriptors_, image_id);
+}
+
+FeatureStore::ConstView<FeatureMatchesBlob> FeatureStore::ReadMatchesBlob(
+    const image_pair_t pair_id) const {
+  return ReadBlob<FeatureMatchesBlob>(matches_, pair_id);
+}
+
+void FeatureStore::WriteKeypoints(const image_t image_id,
+                                  const FeatureKeypointsBlob& blob) {
+  WriteBlob(&keypoints_, image_id, blob);
+}
+
+void FeatureStore::WriteDescriptors(const image_t image_id,
+                                    const FeatureDescriptors& descriptors) {
+  WriteBlob(&descriptors_, image_id, descriptors);
+}
+
+void FeatureStore::WriteMatches(const image_pair_t pair_id,
+                                const FeatureMatchesBlob& blob) {
+  WriteBlob(&matches_, pair_id, blob);
+}
+
+void FeatureStore::DeleteKeypoints(const image_t image_id) {
+  keypoints_.Delete(image_id);
+}
+
+void FeatureStore::DeleteDescriptors(const image_t image_id) {
+  descriptors_.Delete(image_id);
+}
+
+void FeatureStore::DeleteMatches(const image_pair_t pair_id) {
+  matches_.Delete(pair_id);
+}
+
+void FeatureStore::ClearKeypoints() { keypoints_.Clear(); }
+
+void FeatureStore::ClearDescriptors() { descriptors_.Clear(); }
+
+void FeatureStore::ClearMatches() { matches_.Clear(); }
+
+template <typename MatrixType>
+FeatureStore::ConstView<MatrixType> FeatureStore::ReadBlob(
+    const Table& table, const uint64_t key) const {
+  THROW_CHECK(is_open_);
+  const Table::Entry* entry = table.Find(key);
+  if (entry == nullptr) {
+    const Eigen::Index rows = (MatrixType::RowsAtCompileTime == Eigen::Dynamic)
+                                  ? 0
+                                  : MatrixType::RowsAtCompileTime;
+    const Eigen::Index cols = (MatrixType::ColsAtCompileTime == Eigen::Dynamic)
+                                  ? 0
+                                  : MatrixType::ColsAtCompileTime;
+    return ConstView<MatrixType>(nullptr, rows, cols);
+  }
+  return ConstView<MatrixType>(
+      reinterpret_cast<const typename MatrixType::Scalar*>(table.Data(*entry)),
+      entry->rows,
+      entry->cols);
+}
+
+template <typename MatrixType>
+void FeatureStore::WriteBlob(Table* table,
+                             const uint64_t key,
+                             const MatrixType& blob) {
+  THROW_CHECK(is_open_);
+  THROW_CHECK_LE(blob.rows(), std::numeric_limits<uint32_t>::max());
+  THROW_CHECK_LE(blob.cols(), std::numeric_limits<uint32_t>::max());
+  table->Write(key,
+               static_cast<uint32_t>(blob.rows()),
+               static_cast<uint32_t>(blob.cols()),
+               blob.data());
+}
+
+void FeatureStore::Table::Open(const std::string& data_path,
+                               const std::string& index_path,
+                               const size_t scalar_num_bytes) {
+  data_path_ = data_path;
+  index_path_ = index_path;
+  scalar_num_bytes_ = scalar_num_bytes;
+  entries_.clear();
+
+  data_size_ = ExistsFile(data_path_) ? GetFileSize(data_path_) : 0;
+
+  // Replay the index records. Records referring to data beyond the end of the
+  // data file are the result of an interrupted write and are ignored, same as
+  // a truncated trailing record.
+  if (ExistsFile(index_path_)) {
+    std::ifstream index_file(index_path_, std::ios::binary);
+    THROW_CHECK_FILE_OPEN(index_file, index_path_);
+    const size_t num_records = GetFileSize(index_path_) / kIndexRecordNumBytes;
+    for (size_t i = 0; i < num_records; ++i) {
+      const uint64_t key = ReadBinaryLittleEndian<uint64_t>(&index_file);
+      Entry entry;
+      entry.offset = ReadBinaryLittleEndian<uint64_t>(&index_file);
+      entry.rows = ReadBinaryLittleEndian<uint32_t>(&index_file);
+      entry.cols = ReadBinaryLittleEndian<uint32_t>(&index_file);
+      if (entry.offset == kDeletedOffset) {
+        entries_.erase(key);
+      } else if (entry.offset + static_cast<uint64_t>(entry.rows) *
+                                    entry.cols * scalar_num_bytes_ <=
+                 data_size_) {
+        entries_[key] = entry;
+      }
+    }
+  }
+
+  data_file_.open(data_path_, std::ios::binary | std::ios::app);
+  THROW_CHECK_FILE_OPEN(data_file_, data_path_);
+  index_file_.open(index_path_, std::ios::binary | std::ios::app);
+  THROW_CHECK_FILE_OPEN(index_file_, index_path_);
+
+  mapped_data_stale_ = true;
+}
+
+void FeatureStore::Table::Close() {
+  mapped_data_.Close();
+  data_file_.close();
+  index_file_.close();
+  entries_.clear();
+  data_size_ = 0;
+  mapped_data_stale_ = true;
+}
+
+const FeatureStore::Table::Entry* FeatureStore::Table::Find(
+    const uint64_t key) const {
+  const auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return nullptr;
+  }
+  return &it->second;
+}
+
+const uint8_t* FeatureStore::Table::Data(const Entry& entry) const {
+  if (entry.rows == 0 || entry.cols == 0) {
+    return nullptr;
+  }
+  if (mapped_data_stale_) {
+    data_file_.flush();
+    mapped_data_.Open(data_path_);
+    mapped_data_stale_ = false;
+  }
+  THROW_CHECK_LE(entry.offset +
+                     static_cast<uint64_t>(entry.rows) * entry.cols *
+                         scalar_num_bytes_,
+                 mapped_data_.Size());
+  return mapped_data_.Data() + entry.offset;
+}
+
+void FeatureStore::Table::Write(const uint64_t key,
+                                const uint32_t rows,
+                                const uint32_t cols,
+                                const void* data) {
+  // Existing views must be invalidated before appending to the mapped file.
+  mapped_data_.Close();
+  mapped_data_stale_ = true;
+
+  const uint64_t padding =
+      (kBlobAlignment - data_size_ % kBlobAlignment) % kBlobAlignment;
+  const uint64_t num_bytes =
+      static_cast<uint64_t>(rows) * cols * scalar_num_bytes_;
+  const char kZeros[kBlobAlignment] = {0};
+  data_file_.write(kZeros, padding);
+  data_file_.write(reinterpret_cast<const char*>(data), num_bytes);
+  THROW_CHECK(data_file_.good()) << "Failed to write to " << data_path_;
+
+  Entry entry;
+  entry.offset = data_size_ + padding;
+  entry.rows = rows;
+  entry.cols = cols;
+  data_size_ = entry.offset + num_bytes;
+
+  // The data must be persisted before the index record references it.
+  data_file_.flush();
+  AppendIndexRecord(key, entry);
+  entries_[key] = entry;
+}
+
+void FeatureStore::Table::Delete(const uint64_t key) {
+  if (entries_.erase(key) == 0) {
+    return;
+  }
+  Entry entry;
+  entry.offset = kDeletedOffset;
+  AppendIndexRecord(key, entry);
+}
+
+void FeatureStore::Table::Clear() {
+  mapped_data_.Close();
+  data_file_.close();
+  index_file_.close();
+  data_file_.open(data_path_, std::ios::binary | std::ios::trunc);
+  THROW_CHECK_FILE_OPEN(data_file_, data_path_);
+  index_file_.open(index_path_, std::ios::binary | std::ios::trunc);
+  THROW_CHECK_FILE_OPEN(index_file_, index_path_);
+  entries_.clear();
+  data_size_ = 0;
+  mapped_data_stale_ = true;
+}
+
+size_t FeatureStore::Table::NumEntries() const { return entries_.size(); }
+
+size_t FeatureStore::Table::SumRows() const {
+  size_t sum = 0;
+  for (const auto& entry : entries_) {
+    sum += entry.second.rows;
+  }
+  return sum;
+}
+
+size_t FeatureStore::Table::MaxRows() const {
+  size_t max = 0;
+  for (const auto& entry : entries_) {
+    max = std::max(max, static_cast<size_t>(entry.second.rows));
+  }
+  return max;
+}
+
+std::vector<uint64_t> FeatureStore::Table::Keys() const {
+  std::vector<uint64_t> keys;
+  keys.reserve(entries_.size());
+  for (const auto& entry : entries_) {
+    keys.push_back(entry.first);
+  }
+  std::sort(keys.begin(), keys.end());
+  return keys;
+}
+
+void FeatureStore::Table::AppendIndexRecord(const uint64_t key,
+                                            const Entry& entry) {
+  WriteBinaryLittleEndian<uint64_t>(&index_file_, key);
+  WriteBinaryLittleEndian<uint64_t>(&index_file_, entry.offset);
+  WriteBinaryLittleEndian<uint32_t>(&index_file_, entry.rows);
+  WriteBinaryLittleEndian<uint32_t>(&index_file_, entry.cols);
+  index_file_.flush();
+  THROW_CHECK(index_file_.good()) << "Failed to write to " << index_path_;
+}
+
+}  // namespace colmap
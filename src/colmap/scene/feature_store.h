@@ -0,0 +1,179 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/feature/types.h"
+#include "colmap/scene/database.h"
+#include "colmap/util/mapped_file.h"
+#include "colmap/util/types.h"
+
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <Eigen/Core>
+
+namespace colmap {
+
+// Append-only storage of keypoints, descriptors, and matches in flat files,
+// which are memory-mapped for reading. Each table consists of a data file with
+// the concatenated row-major blobs and an index file with fixed size records
+// mapping the image (pair) identifier to the blob location. Entries are never
+// modified in place: writes and deletions append a new index record and the
+// last record for an identifier takes precedence when opening the store.
+//
+// Reads return zero-copy views into the mapped data files. The views remain
+// valid until the next modification of the store or until it is closed.
+// The class is not thread-safe and must not be accessed concurrently.
+class FeatureStore {
+ public:
+  template <typename MatrixType>
+  using ConstView = Eigen::Map<const MatrixType>;
+
+  FeatureStore() = default;
+  explicit FeatureStore(const std::string& path);
+
+  // Open the store in the given directory, which is created if it does not
+  // exist yet. Existing files in the directory are loaded.
+  void Open(const std::string& path);
+  void Close();
+
+  inline bool IsOpen() const;
+  inline const std::string& Path() const;
+
+  bool ExistsKeypoints(image_t image_id) const;
+  bool ExistsDescriptors(image_t image_id) const;
+  bool ExistsMatches(image_pair_t pair_id) const;
+
+  // Sum of rows over all entries in the respective table.
+  size_t NumKeypoints() const;
+  size_t NumDescriptors() const;
+  size_t NumMatches() const;
+
+  // Maximum number of rows for any entry in the respective table.
+  size_t MaxNumKeypoints() const;
+  size_t MaxNumDescriptors() const;
+
+  // Number of rows for a specific entry or zero if it does not exist.
+  size_t NumKeypointsForImage(image_t image_id) const;
+  size_t NumDescriptorsForImage(image_t image_id) const;
+
+  // Number of image pairs with a matches entry.
+  size_t NumMatchedImagePairs() const;
+
+  // Identifiers of all image pairs with a matches entry in ascending order.
+  std::vector<image_pair_t> ReadMatchedImagePairIds() const;
+
+  // Zero-copy views of the stored blobs. Non-existent entries result in empty
+  // views with the default number of columns of the respective type.
+  ConstView<FeatureKeypointsBlob> ReadKeypointsBlob(image_t image_id) const;
+  ConstView<FeatureDescriptors> ReadDescriptors(image_t image_id) const;
+  ConstView<FeatureMatchesBlob> ReadMatchesBlob(image_pair_t pair_id) const;
+
+  // Add a new entry or replace an existing entry.
+  void WriteKeypoints(image_t image_id, const FeatureKeypointsBlob& blob);
+  void WriteDescriptors(image_t image_id,
+                        const FeatureDescriptors& descriptors);
+  void WriteMatches(image_pair_t pair_id, const FeatureMatchesBlob& blob);
+
+  void DeleteKeypoints(image_t image_id);
+  void DeleteDescriptors(image_t image_id);
+  void DeleteMatches(image_pair_t pair_id);
+
+  void ClearKeypoints();
+  void ClearDescriptors();
+  void ClearMatches();
+
+ private:
+  NON_COPYABLE(FeatureStore)
+
+  class Table {
+   public:
+    struct Entry {
+      uint64_t offset = 0;
+      uint32_t rows = 0;
+      uint32_t cols = 0;
+    };
+
+    void Open(const std::string& data_path,
+              const std::string& index_path,
+              size_t scalar_num_bytes);
+    void Close();
+
+    const Entry* Find(uint64_t key) const;
+    const uint8_t* Data(const Entry& entry) const;
+
+    void Write(uint64_t key, uint32_t rows, uint32_t cols, const void* data);
+    void Delete(uint64_t key);
+    void Clear();
+
+    size_t NumEntries() const;
+    size_t SumRows() const;
+    size_t MaxRows() const;
+    std::vector<uint64_t> Keys() const;
+
+   private:
+    void AppendIndexRecord(uint64_t key, const Entry& entry);
+
+    std::string data_path_;
+    std::string index_path_;
+    size_t scalar_num_bytes_ = 0;
+    mutable std::ofstream data_file_;
+    std::ofstream index_file_;
+    uint64_t data_size_ = 0;
+    std::unordered_map<uint64_t, Entry> entries_;
+    mutable bool mapped_data_stale_ = true;
+    mutable MappedFile mapped_data_;
+  };
+
+  template <typename MatrixType>
+  ConstView<MatrixType> ReadBlob(const Table& table, uint64_t key) const;
+
+  template <typename MatrixType>
+  void WriteBlob(Table* table, uint64_t key, const MatrixType& blob);
+
+  std::string path_;
+  bool is_open_ = false;
+  Table keypoints_;
+  Table descriptors_;
+  Table matches_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+bool FeatureStore::IsOpen() const { return is_open_; }
+
+const std::string& FeatureStore::Path() const { return path_; }
+
+}  // namespace colmap
@@ -0,0 +1,138 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/scene/feature_store.h"
+
+#include "colmap/util/testing.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+TEST(FeatureStore, Empty) {
+  FeatureStore store(CreateTestDir());
+  EXPECT_TRUE(store.IsOpen());
+  EXPECT_EQ(store.NumKeypoints(), 0);
+  EXPECT_EQ(store.MaxNumKeypoints(), 0);
+  EXPECT_EQ(store.NumDescriptors(), 0);
+  EXPECT_EQ(store.MaxNumDescriptors(), 0);
+  EXPECT_EQ(store.NumMatches(), 0);
+  EXPECT_EQ(store.NumMatchedImagePairs(), 0);
+  EXPECT_FALSE(store.ExistsKeypoints(1));
+  EXPECT_FALSE(store.ExistsDescriptors(1));
+  EXPECT_FALSE(store.ExistsMatches(1));
+  EXPECT_EQ(store.ReadKeypointsBlob(1).rows(), 0);
+  EXPECT_EQ(store.ReadDescriptors(1).rows(), 0);
+  EXPECT_EQ(store.ReadMatchesBlob(1).rows(), 0);
+  EXPECT_EQ(store.ReadMatchesBlob(1).cols(), 2);
+}
+
+TEST(FeatureStore, WriteReadDelete) {
+  FeatureStore store(CreateTestDir());
+  const FeatureKeypointsBlob keypoints = FeatureKeypointsBlob::Random(10, 6);
+  const FeatureDescriptors descriptors = FeatureDescriptors::Random(10, 128);
+  FeatureMatchesBlob matches(5, 2);
+  for (int i = 0; i < matches.rows(); ++i) {
+    matches(i, 0) = i;
+    matches(i, 1) = 2 * i;
+  }
+
+  store.WriteKeypoints(1, keypoints);
+  store.WriteDescriptors(1, descriptors);
+  store.WriteMatches(12, matches);
+  store.WriteKeypoints(2, FeatureKeypointsBlob(20, 6));
+  store.WriteDescriptors(2, FeatureDescriptors(20, 128));
+  store.WriteMatches(13, FeatureMatchesBlob(0, 2));
+
+  EXPECT_EQ(store.ReadKeypointsBlob(1), keypoints);
+  EXPECT_EQ(store.ReadDescriptors(1), descriptors);
+  EXPECT_EQ(store.ReadMatchesBlob(12), matches);
+  EXPECT_EQ(store.ReadMatchesBlob(13).rows(), 0);
+  EXPECT_TRUE(store.ExistsMatches(13));
+  EXPECT_EQ(store.NumKeypoints(), 30);
+  EXPECT_EQ(store.MaxNumKeypoints(), 20);
+  EXPECT_EQ(store.NumKeypointsForImage(1), 10);
+  EXPECT_EQ(store.NumKeypointsForImage(3), 0);
+  EXPECT_EQ(store.NumDescriptors(), 30);
+  EXPECT_EQ(store.MaxNumDescriptors(), 20);
+  EXPECT_EQ(store.NumDescriptorsForImage(2), 20);
+  EXPECT_EQ(store.NumMatches(), 5);
+  EXPECT_EQ(store.NumMatchedImagePairs(), 2);
+  EXPECT_EQ(store.ReadMatchedImagePairIds(),
+            std::vector<image_pair_t>({12, 13}));
+
+  // Data is aligned for efficient access.
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(store.ReadDescriptors(2).data()) % 16,
+            0);
+
+  store.DeleteMatches(12);
+  EXPECT_FALSE(store.ExistsMatches(12));
+  EXPECT_EQ(store.NumMatches(), 0);
+  store.WriteMatches(12, matches);
+  EXPECT_EQ(store.ReadMatchesBlob(12), matches);
+
+  // Replace an existing entry.
+  const FeatureKeypointsBlob keypoints2 = FeatureKeypointsBlob::Random(3, 4);
+  store.WriteKeypoints(1, keypoints2);
+  EXPECT_EQ(store.ReadKeypointsBlob(1), keypoints2);
+  EXPECT_EQ(store.NumKeypoints(), 23);
+
+  store.ClearKeypoints();
+  store.ClearDescriptors();
+  store.ClearMatches();
+  EXPECT_EQ(store.NumKeypoints(), 0);
+  EXPECT_EQ(store.NumDescriptors(), 0);
+  EXPECT_EQ(store.NumMatchedImagePairs(), 0);
+}
+
+TEST(FeatureStore, Reopen) {
+  const std::string test_dir = CreateTestDir();
+  const FeatureDescriptors descriptors = FeatureDescriptors::Random(10, 128);
+  FeatureMatchesBlob matches(1, 2);
+  matches << 1, 2;
+  {
+    FeatureStore store(test_dir);
+    store.WriteDescriptors(1, FeatureDescriptors::Random(5, 128));
+    store.WriteDescriptors(1, descriptors);
+    store.WriteDescriptors(2, descriptors);
+    store.DeleteDescriptors(2);
+    store.WriteMatches(12, matches);
+  }
+  FeatureStore store(test_dir);
+  EXPECT_TRUE(store.ExistsDescriptors(1));
+  EXPECT_FALSE(store.ExistsDescriptors(2));
+  EXPECT_EQ(store.ReadDescriptors(1), descriptors);
+  EXPECT_EQ(store.ReadMatchesBlob(12), matches);
+  EXPECT_EQ(store.NumDescriptors(), 10);
+}
+
+}  // namespace
+}  // namespace colmap
@@ -91,6 +91,19 @@ class Image {
   void SetPoints2D(const std::vector<Eigen::Vector2d>& points);
   void SetPoints2D(const std::vector<struct Point2D>& points);
 
+  // Strided views of the image coordinates and of the 3D point identifiers of
+  // all image points without copying them, e.g., to process all coordinates
+  // with Eigen expressions. The views are invalidated when points are added or
+  // removed.
+  using Points2DXYView =
+      Eigen::Map<const Eigen::Matrix2Xd, 0, Eigen::OuterStride<>>;
+  using Points2DPoint3DIdsView =
+      Eigen::Map<const Eigen::Matrix<point3D_t, Eigen::Dynamic, 1>,
+                 0,
+                 Eigen::InnerStride<>>;
+  inline Points2DXYView Points2DXY() const;
+  inline Points2DPoint3DIdsView Points2DPoint3DIds() const;
+
   // Set the point as triangulated, i.e. it is part of a 3D point track.
   void SetPoint3DForPoint2D(point2D_t point2D_idx, point3D_t point3D_id);
 
@@ -180,4 +193,23 @@ const std::vector<struct Point2D>& Image::Points2D() const { return points2D_; }
 
 std::vector<struct Point2D>& Image::Points2D() { return points2D_; }
 
+Image::Points2DXYView Image::Points2DXY() const {
+  static_assert(sizeof(struct Point2D) % sizeof(double) == 0,
+                "Point2D must be a multiple of doubles");
+  return Points2DXYView(
+      points2D_.empty() ? nullptr : points2D_[0].xy.data(),
+      2,
+      points2D_.size(),
+      Eigen::OuterStride<>(sizeof(struct Point2D) / sizeof(double)));
+}
+
+Image::Points2DPoint3DIdsView Image::Points2DPoint3DIds() const {
+  static_assert(sizeof(struct Point2D) % sizeof(point3D_t) == 0,
+                "Point2D must be a multiple of point3D_t");
+  return Points2DPoint3DIdsView(
+      points2D_.empty() ? nullptr : &points2D_[0].point3D_id,
+      points2D_.size(),
+      Eigen::InnerStride<>(sizeof(struct Point2D) / sizeof(point3D_t)));
+}
+
 }  // namespace colmap
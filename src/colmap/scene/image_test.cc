@@ -124,6 +124,27 @@ TEST(Image, Points2DWith3D) {
   EXPECT_EQ(image.NumPoints3D(), 1);
 }
 
+TEST(Image, Points2DViews) {
+  Image image;
+  EXPECT_EQ(image.Points2DXY().cols(), 0);
+  EXPECT_EQ(image.Points2DPoint3DIds().size(), 0);
+  std::vector<Point2D> points2D(3);
+  for (int i = 0; i < 3; ++i) {
+    points2D[i].xy = Eigen::Vector2d(i, 2 * i);
+  }
+  points2D[1].point3D_id = 1;
+  image.SetPoints2D(points2D);
+  const Image::Points2DXYView xy = image.Points2DXY();
+  const Image::Points2DPoint3DIdsView point3D_ids = image.Points2DPoint3DIds();
+  ASSERT_EQ(xy.cols(), 3);
+  ASSERT_EQ(point3D_ids.size(), 3);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(xy.col(i), points2D[i].xy);
+    EXPECT_EQ(point3D_ids(i), points2D[i].point3D_id);
+  }
+  EXPECT_EQ((point3D_ids.array() != kInvalidPoint3DId).count(), 1);
+}
+
 TEST(Image, Points3D) {
   Image image;
   image.SetPoints2D(std::vector<Eigen::Vector2d>(2));
@@ -35,9 +35,14 @@
 #include "colmap/scene/database_cache.h"
 #include "colmap/scene/projection.h"
 #include "colmap/scene/reconstruction_io.h"
+#include "colmap/scene/reconstruction_snapshot.h"
 #include "colmap/sensor/bitmap.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/ply.h"
+#include "colmap/util/threading.h"
+
+#include <algorithm>
+#include <atomic>
 
 namespace colmap {
 
@@ -67,19 +72,22 @@ void Reconstruction::Load(const DatabaseCache& database_cache) {
   // Add images.
   images_.reserve(database_cache.NumImages());
 
-  for (const auto& image : database_cache.Images()) {
-    if (ExistsImage(image.second.ImageId())) {
-      class Image& existing_image = Image(image.second.ImageId());
-      THROW_CHECK_EQ(existing_image.Name(), image.second.Name());
+  for (const auto& id_and_image : database_cache.Images()) {
+    // Loads the 2D points, if the database cache loads them lazily.
+    const class Image& image = database_cache.Image(id_and_image.first);
+    if (ExistsImage(image.ImageId())) {
+      class Image& existing_image = Image(image.ImageId());
+      THROW_CHECK_EQ(existing_image.Name(), image.Name());
       if (existing_image.NumPoints2D() == 0) {
-        existing_image.SetPoints2D(image.second.Points2D());
+        existing_image.SetPoints2D(image.Points2D());
       } else {
-        THROW_CHECK_EQ(image.second.NumPoints2D(),
-                       existing_image.NumPoints2D());
+        THROW_CHECK_EQ(image.NumPoints2D(), existing_image.NumPoints2D());
       }
     } else {
-      AddImage(image.second);
+      AddImage(image);
     }
+    // The reconstruction now holds its own copy of the 2D points.
+    database_cache.EvictPoints2D(image.ImageId());
   }
 }
 
@@ -104,7 +112,10 @@ void Reconstruction::TearDown() {
     }
   }
 
-  // Compress tracks.
+  CompressTracks();
+}
+
+void Reconstruction::CompressTracks() {
   for (auto& point3D : points3D_) {
     point3D.second.track.Compress();
   }
@@ -116,6 +127,15 @@ void Reconstruction::AddCamera(struct Camera camera) {
   THROW_CHECK(cameras_.emplace(camera_id, std::move(camera)).second);
 }
 
+void Reconstruction::ReserveImages(const size_t num_images) {
+  images_.reserve(num_images);
+  reg_image_ids_.reserve(num_images);
+}
+
+void Reconstruction::ReservePoints3D(const size_t num_points3D) {
+  points3D_.reserve(num_points3D);
+}
+
 void Reconstruction::AddImage(class Image image) {
   const image_t image_id = image.ImageId();
   const bool is_registered = image.IsRegistered();
@@ -187,8 +207,8 @@ point3D_t Reconstruction::MergePoints3D(const point3D_t point3D_id1,
   DeletePoint3D(point3D_id1);
   DeletePoint3D(point3D_id2);
 
-  const point3D_t merged_point3D_id =
-      AddPoint3D(merged_xyz, merged_track, merged_rgb.cast<uint8_t>());
+  const point3D_t merged_point3D_id = AddPoint3D(
+      merged_xyz, std::move(merged_track), merged_rgb.cast<uint8_t>());
 
   return merged_point3D_id;
 }
@@ -379,7 +399,8 @@ void Reconstruction::Transform(const Sim3d& new_from_old_world) {
 }
 
 Reconstruction Reconstruction::Crop(
-    const std::pair<Eigen::Vector3d, Eigen::Vector3d>& bbox) const {
+    const std::pair<Eigen::Vector3d, Eigen::Vector3d>& bbox,
+    const int num_threads) const {
   Reconstruction cropped_reconstruction;
   for (const auto& camera : cameras_) {
     cropped_reconstruction.AddCamera(camera.second);
@@ -393,19 +414,51 @@ Reconstruction Reconstruction::Crop(
     }
     cropped_reconstruction.AddImage(std::move(new_image));
   }
-  std::unordered_set<image_t> registered_image_ids;
+
+  // Test the points against the bounding box in parallel and then add the
+  // included points serially in the original order.
+  std::vector<const struct Point3D*> points3D;
+  points3D.reserve(points3D_.size());
   for (const auto& point3D : points3D_) {
-    if ((point3D.second.xyz.array() >= bbox.first.array()).all() &&
-        (point3D.second.xyz.array() <= bbox.second.array()).all()) {
-      for (const auto& track_el : point3D.second.track.Elements()) {
-        if (registered_image_ids.count(track_el.image_id) == 0) {
-          cropped_reconstruction.RegisterImage(track_el.image_id);
-          registered_image_ids.insert(track_el.image_id);
-        }
+    points3D.push_back(&point3D.second);
+  }
+
+  std::vector<char> is_included(points3D.size());
+  const auto IsIncluded = [&bbox](const struct Point3D& point3D) {
+    return (point3D.xyz.array() >= bbox.first.array()).all() &&
+           (point3D.xyz.array() <= bbox.second.array()).all();
+  };
+  constexpr size_t kMinNumPoints3DForParallelCrop = 100000;
+  const int effective_num_threads = GetEffectiveNumThreads(num_threads);
+  if (effective_num_threads > 1 &&
+      points3D.size() >= kMinNumPoints3DForParallelCrop) {
+    ThreadPool thread_pool(effective_num_threads);
+    thread_pool.ParallelFor(
+        0, points3D.size(), /*grain_size=*/10000, [&](const int64_t i) {
+          is_included[i] = IsIncluded(*points3D[i]);
+        });
+  } else {
+    for (size_t i = 0; i < points3D.size(); ++i) {
+      is_included[i] = IsIncluded(*points3D[i]);
+    }
+  }
+
+  cropped_reconstruction.points3D_.reserve(
+      std::count(is_included.begin(), is_included.end(), 1));
+
+  std::unordered_set<image_t> registered_image_ids;
+  for (size_t i = 0; i < points3D.size(); ++i) {
+    if (!is_included[i]) {
+      continue;
+    }
+    const struct Point3D& point3D = *points3D[i];
+    for (const auto& track_el : point3D.track.Elements()) {
+      if (registered_image_ids.insert(track_el.image_id).second) {
+        cropped_reconstruction.RegisterImage(track_el.image_id);
       }
-      cropped_reconstruction.AddPoint3D(
-          point3D.second.xyz, point3D.second.track, point3D.second.color);
     }
+    cropped_reconstruction.AddPoint3D(
+        point3D.xyz, point3D.track, point3D.color);
   }
   return cropped_reconstruction;
 }
@@ -422,12 +475,21 @@ const class Image* Reconstruction::FindImageWithName(
 
 std::vector<std::pair<image_t, image_t>> Reconstruction::FindCommonRegImageIds(
     const Reconstruction& other) const {
+  // Index the registered images of the other reconstruction by name once
+  // instead of searching all its images for every registered image.
+  std::unordered_map<std::string, image_t> other_reg_image_ids;
+  other_reg_image_ids.reserve(other.NumRegImages());
+  for (const auto other_image_id : other.RegImageIds()) {
+    other_reg_image_ids.emplace(other.Image(other_image_id).Name(),
+                                other_image_id);
+  }
+
   std::vector<std::pair<image_t, image_t>> common_reg_image_ids;
   for (const auto image_id : reg_image_ids_) {
-    const auto& image = Image(image_id);
-    const auto* other_image = other.FindImageWithName(image.Name());
-    if (other_image != nullptr && other_image->IsRegistered()) {
-      common_reg_image_ids.emplace_back(image_id, other_image->ImageId());
+    const auto other_image_id =
+        other_reg_image_ids.find(Image(image_id).Name());
+    if (other_image_id != other_reg_image_ids.end()) {
+      common_reg_image_ids.emplace_back(image_id, other_image_id->second);
     }
   }
   return common_reg_image_ids;
@@ -474,6 +536,23 @@ size_t Reconstruction::ComputeNumObservations() const {
   return num_obs;
 }
 
+size_t Reconstruction::NumBytes() const {
+  size_t num_bytes = 0;
+  for (const auto& camera : cameras_) {
+    num_bytes += sizeof(struct Camera) +
+                 camera.second.params.capacity() * sizeof(double);
+  }
+  for (const auto& image : images_) {
+    num_bytes += sizeof(class Image) +
+                 image.second.NumPoints2D() * sizeof(struct Point2D);
+  }
+  for (const auto& point3D : points3D_) {
+    num_bytes += sizeof(struct Point3D) +
+                 point3D.second.track.Length() * sizeof(TrackElement);
+  }
+  return num_bytes;
+}
+
 double Reconstruction::ComputeMeanTrackLength() const {
   if (points3D_.empty()) {
     return 0.0;
@@ -510,27 +589,75 @@ double Reconstruction::ComputeMeanReprojectionError() const {
 
 void Reconstruction::UpdatePoint3DErrors() {
   for (auto& point3D : points3D_) {
-    if (point3D.second.track.Length() == 0) {
-      point3D.second.error = 0;
+    point3D.second.error = 0;
+  }
+
+  // Accumulate the reprojection errors image by image, so that all
+  // observations of an image are projected in a single batch.
+  std::vector<point2D_t> point2D_idxs;
+  std::vector<Eigen::Vector3d> points3D_in_cam;
+  std::vector<Eigen::Vector2d> proj_points2D;
+  for (const auto& image : images_) {
+    if (image.second.NumPoints3D() == 0) {
       continue;
     }
-    point3D.second.error = 0;
-    for (const auto& track_el : point3D.second.track.Elements()) {
-      const auto& image = Image(track_el.image_id);
-      const auto& point2D = image.Point2D(track_el.point2D_idx);
-      const auto& camera = Camera(image.CameraId());
-      point3D.second.error += std::sqrt(CalculateSquaredReprojectionError(
-          point2D.xy, point3D.second.xyz, image.CamFromWorld(), camera));
+
+    point2D_idxs.clear();
+    points3D_in_cam.clear();
+    const Rigid3d& cam_from_world = image.second.CamFromWorld();
+    for (point2D_t point2D_idx = 0; point2D_idx < image.second.NumPoints2D();
+         ++point2D_idx) {
+      const Point2D& point2D = image.second.Point2D(point2D_idx);
+      if (point2D.HasPoint3D()) {
+        point2D_idxs.push_back(point2D_idx);
+        points3D_in_cam.push_back(cam_from_world *
+                                  Point3D(point2D.point3D_id).xyz);
+      }
+    }
+
+    const auto& camera = Camera(image.second.CameraId());
+    proj_points2D.resize(points3D_in_cam.size());
+    CameraModelImgFromCam(
+        camera.model_id,
+        camera.params,
+        {points3D_in_cam.data(), points3D_in_cam.size()},
+        {proj_points2D.data(), proj_points2D.size()});
+
+    for (size_t i = 0; i < point2D_idxs.size(); ++i) {
+      const Point2D& point2D = image.second.Point2D(point2D_idxs[i]);
+      // Points behind the camera have maximum error, as in
+      // `CalculateSquaredReprojectionError`.
+      const double squared_error =
+          points3D_in_cam[i].z() < std::numeric_limits<double>::epsilon()
+              ? std::numeric_limits<double>::max()
+              : (proj_points2D[i] - point2D.xy).squaredNorm();
+      Point3D(point2D.point3D_id).error += std::sqrt(squared_error);
+    }
+  }
+
+  for (auto& point3D : points3D_) {
+    if (point3D.second.track.Length() > 0) {
+      point3D.second.error /= point3D.second.track.Length();
     }
-    point3D.second.error /= point3D.second.track.Length();
   }
 }
 
 void Reconstruction::Read(const std::string& path) {
-  if (ExistsFile(JoinPaths(path, "cameras.bin")) &&
+  if (IsIncrementalSnapshot(path)) {
+    MaterializeSnapshot(path, this);
+  } else if (ExistsFile(JoinPaths(path, "cameras.bin")) &&
       ExistsFile(JoinPaths(path, "images.bin")) &&
       ExistsFile(JoinPaths(path, "points3D.bin"))) {
     ReadBinary(path);
+  } else if (ExistsFile(JoinPaths(path, "cameras.bin")) &&
+             ExistsFile(JoinPaths(path, "images.bin")) &&
+             ExistsFile(JoinPaths(path, "points3D_tiled.bin"))) {
+    cameras_.clear();
+    images_.clear();
+    points3D_.clear();
+    ReadCamerasBinary(*this, JoinPaths(path, "cameras.bin"));
+    ReadImagesBinary(*this, JoinPaths(path, "images.bin"));
+    ReadPoints3DTiledBinary(*this, JoinPaths(path, "points3D_tiled.bin"));
   } else if (ExistsFile(JoinPaths(path, "cameras.txt")) &&
              ExistsFile(JoinPaths(path, "images.txt")) &&
              ExistsFile(JoinPaths(path, "points3D.txt"))) {
@@ -645,50 +772,93 @@ bool Reconstruction::ExtractColorsForImage(const image_t image_id,
   return true;
 }
 
-void Reconstruction::ExtractColorsForAllImages(const std::string& path) {
-  std::unordered_map<point3D_t, Eigen::Vector3d> color_sums;
-  std::unordered_map<point3D_t, size_t> color_counts;
-
-  for (size_t i = 0; i < reg_image_ids_.size(); ++i) {
-    const class Image& image = Image(reg_image_ids_[i]);
-    const std::string image_path = JoinPaths(path, image.Name());
+void Reconstruction::ExtractColorsForAllImages(const std::string& path,
+                                               const int num_threads,
+                                               const int min_image_size) {
+  // Sum of the colors and number of observations per 3D point.
+  typedef std::unordered_map<point3D_t, Eigen::Vector4d> ColorSums;
+
+  const int effective_num_threads =
+      std::min<int>(GetEffectiveNumThreads(num_threads),
+                    std::max<size_t>(1, reg_image_ids_.size()));
+
+  // Each thread reads the next unprocessed image and accumulates its colors
+  // into separate sums, which are reduced at the end.
+  std::vector<ColorSums> thread_color_sums(effective_num_threads);
+  std::atomic<size_t> next_image_idx(0);
+  const auto accumulate_colors = [&](ColorSums* color_sums) {
+    while (true) {
+      const size_t image_idx = next_image_idx++;
+      if (image_idx >= reg_image_ids_.size()) {
+        break;
+      }
 
-    Bitmap bitmap;
-    if (!bitmap.Read(image_path)) {
-      LOG(WARNING) << StringPrintf("Could not read image %s at path %s.",
-                                   image.Name().c_str(),
-                                   image_path.c_str())
-                   << std::endl;
-      continue;
-    }
+      const class Image& image = Image(reg_image_ids_[image_idx]);
+      const std::string image_path = JoinPaths(path, image.Name());
+
+      int width = 0;
+      int height = 0;
+      Bitmap bitmap;
+      if ((min_image_size > 0 &&
+           !Bitmap::ReadDimensions(image_path, &width, &height)) ||
+          !bitmap.Read(image_path, /*as_rgb=*/true, min_image_size)) {
+        LOG(WARNING) << StringPrintf("Could not read image %s at path %s.",
+                                     image.Name().c_str(),
+                                     image_path.c_str())
+                     << std::endl;
+        continue;
+      }
 
-    for (const Point2D& point2D : image.Points2D()) {
-      if (point2D.HasPoint3D()) {
-        BitmapColor<float> color;
-        // COLMAP assumes that the upper left pixel center is (0.5, 0.5).
-        if (bitmap.InterpolateBilinear(
-                point2D.xy(0) - 0.5, point2D.xy(1) - 0.5, &color)) {
-          if (color_sums.count(point2D.point3D_id)) {
-            Eigen::Vector3d& color_sum = color_sums[point2D.point3D_id];
-            color_sum(0) += color.r;
-            color_sum(1) += color.g;
-            color_sum(2) += color.b;
-            color_counts[point2D.point3D_id] += 1;
-          } else {
-            color_sums.emplace(point2D.point3D_id,
-                               Eigen::Vector3d(color.r, color.g, color.b));
-            color_counts.emplace(point2D.point3D_id, 1);
+      // The image may have been decoded at a reduced resolution.
+      const double scale_x =
+          min_image_size > 0 ? static_cast<double>(bitmap.Width()) / width
+                             : 1.0;
+      const double scale_y =
+          min_image_size > 0 ? static_cast<double>(bitmap.Height()) / height
+                             : 1.0;
+
+      for (const Point2D& point2D : image.Points2D()) {
+        if (point2D.HasPoint3D()) {
+          BitmapColor<float> color;
+          // COLMAP assumes that the upper left pixel center is (0.5, 0.5).
+          if (bitmap.InterpolateBilinear(scale_x * point2D.xy(0) - 0.5,
+                                         scale_y * point2D.xy(1) - 0.5,
+                                         &color)) {
+            (*color_sums)[point2D.point3D_id] +=
+                Eigen::Vector4d(color.r, color.g, color.b, 1);
           }
         }
       }
     }
+  };
+
+  if (effective_num_threads == 1) {
+    accumulate_colors(&thread_color_sums[0]);
+  } else {
+    ThreadPool thread_pool(effective_num_threads);
+    for (ColorSums& color_sums : thread_color_sums) {
+      thread_pool.AddTask(accumulate_colors, &color_sums);
+    }
+    thread_pool.Wait();
+  }
+
+  ColorSums& color_sums = thread_color_sums[0];
+  for (int i = 1; i < effective_num_threads; ++i) {
+    for (const auto& color_sum : thread_color_sums[i]) {
+      auto it = color_sums.find(color_sum.first);
+      if (it == color_sums.end()) {
+        color_sums.emplace(color_sum.first, color_sum.second);
+      } else {
+        it->second += color_sum.second;
+      }
+    }
   }
 
   const Eigen::Vector3ub kBlackColor = Eigen::Vector3ub::Zero();
   for (auto& point3D : points3D_) {
-    if (color_sums.count(point3D.first)) {
-      Eigen::Vector3d color =
-          color_sums[point3D.first] / color_counts[point3D.first];
+    const auto it = color_sums.find(point3D.first);
+    if (it != color_sums.end()) {
+      Eigen::Vector3d color = it->second.head<3>() / it->second(3);
       for (Eigen::Index i = 0; i < color.size(); ++i) {
         color[i] = std::round(color[i]);
       }
@@ -98,6 +98,15 @@ class Reconstruction {
   // save memory.
   void TearDown();
 
+  // Shrink the capacity of all tracks to their length to release the memory
+  // left over after tracks were merged or filtered.
+  void CompressTracks();
+
+  // Reserve space for the given total number of images or 3D points to avoid
+  // rehashing when adding many objects at once, e.g., when reading.
+  void ReserveImages(size_t num_images);
+  void ReservePoints3D(size_t num_points3D);
+
   // Add new camera. There is only one camera per image, while multiple images
   // might be taken by the same camera.
   void AddCamera(struct Camera camera);
@@ -170,9 +179,10 @@ class Reconstruction {
   // Creates a cropped reconstruction using the input bounds as corner points
   // of the bounding box containing the included 3D points of the new
   // reconstruction. Only the cameras and images of the included points are
-  // registered.
-  Reconstruction Crop(
-      const std::pair<Eigen::Vector3d, Eigen::Vector3d>& bbox) const;
+  // registered. The points are tested against the bounding box in parallel
+  // for large reconstructions.
+  Reconstruction Crop(const std::pair<Eigen::Vector3d, Eigen::Vector3d>& bbox,
+                      int num_threads = -1) const;
 
   // Find specific image by name. Note that this uses linear search.
   const class Image* FindImageWithName(const std::string& name) const;
@@ -192,10 +202,15 @@ class Reconstruction {
   double ComputeMeanObservationsPerRegImage() const;
   double ComputeMeanReprojectionError() const;
 
+  // Approximate number of bytes used by the cameras, images, and 3D points.
+  size_t NumBytes() const;
+
   // Updates mean reprojection errors for all 3D points.
   void UpdatePoint3DErrors();
 
-  // Read data from text or binary file. Prefer binary data if it exists.
+  // Read data from text or binary file. Prefer binary data if it exists and
+  // fall back to binary data with tiled 3D points, see reconstruction_io.h.
+  // Incremental snapshots are materialized, see reconstruction_snapshot.h.
   void Read(const std::string& path);
   void Write(const std::string& path) const;
 
@@ -228,10 +243,16 @@ class Reconstruction {
 
   // Extract colors for all 3D points by computing the mean color of all images.
   //
-  // @param path          Absolute or relative path to root folder of image.
-  //                      The image path is determined by concatenating the
-  //                      root path and the name of the image.
-  void ExtractColorsForAllImages(const std::string& path);
+  // @param path            Absolute or relative path to root folder of image.
+  //                        The image path is determined by concatenating the
+  //                        root path and the name of the image.
+  // @param num_threads     Number of threads reading the images in parallel.
+  // @param min_image_size  If positive, JPEG images are decoded at a reduced
+  //                        resolution, whose larger dimension is at least the
+  //                        given size, see `Bitmap::Read`.
+  void ExtractColorsForAllImages(const std::string& path,
+                                 int num_threads = -1,
+                                 int min_image_size = 0);
 
   // Create all image sub-directories in the given path.
   void CreateImageDirs(const std::string& path) const;
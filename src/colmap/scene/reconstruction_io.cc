@@ -36,164 +36,503 @@
 #include "colmap/scene/point3d.h"
 #include "colmap/scene/reconstruction.h"
 #include "colmap/scene/track.h"
+#include "colmap/util/endian.h"
+#include "colmap/util/mapped_file.h"
 #include "colmap/util/misc.h"
 #include "colmap/util/ply.h"
+#include "colmap/util/threading.h"
 #include "colmap/util/types.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <limits>
+#include <map>
+#include <random>
 
 namespace colmap {
+namespace {
+
+// Sequential reader of little-endian values from a memory buffer, e.g., a
+// mapped file. All reads are checked against the end of the buffer.
+class BinaryBufferReader {
+ public:
+  BinaryBufferReader(const uint8_t* begin,
+                     const uint8_t* end,
+                     const std::string& path)
+      : pos_(begin), end_(end), path_(path) {}
+
+  template <typename T>
+  T Read() {
+    CheckRemaining(sizeof(T));
+    T value;
+    memcpy(&value, pos_, sizeof(T));
+    pos_ += sizeof(T);
+    return LittleEndianToNative(value);
+  }
 
-void ReadCamerasText(Reconstruction& reconstruction, const std::string& path) {
-  std::ifstream file(path);
-  THROW_CHECK_FILE_OPEN(file, path);
-
-  std::string line;
-  std::string item;
+  std::string ReadString() {
+    const uint8_t* string_end =
+        static_cast<const uint8_t*>(memchr(pos_, '\0', end_ - pos_));
+    THROW_CHECK(string_end != nullptr) << "Unexpected end of file: " << path_;
+    std::string value(reinterpret_cast<const char*>(pos_), string_end);
+    pos_ = string_end + 1;
+    return value;
+  }
 
-  while (std::getline(file, line)) {
-    StringTrim(&line);
+  void Skip(const size_t num_bytes) {
+    CheckRemaining(num_bytes);
+    pos_ += num_bytes;
+  }
 
-    if (line.empty() || line[0] == '#') {
-      continue;
-    }
+  void SkipString() {
+    const uint8_t* string_end =
+        static_cast<const uint8_t*>(memchr(pos_, '\0', end_ - pos_));
+    THROW_CHECK(string_end != nullptr) << "Unexpected end of file: " << path_;
+    pos_ = string_end + 1;
+  }
 
-    std::stringstream line_stream(line);
+  const uint8_t* Position() const { return pos_; }
 
-    struct Camera camera;
-
-    // ID
-    std::getline(line_stream, item, ' ');
-    camera.camera_id = std::stoul(item);
+  // Reader of the same buffer starting at the given position.
+  BinaryBufferReader At(const uint8_t* pos) const {
+    return BinaryBufferReader(pos, end_, path_);
+  }
 
-    // MODEL
-    std::getline(line_stream, item, ' ');
-    camera.model_id = CameraModelNameToId(item);
+ private:
+  void CheckRemaining(const size_t num_bytes) const {
+    THROW_CHECK_LE(num_bytes, static_cast<size_t>(end_ - pos_))
+        << "Unexpected end of file: " << path_;
+  }
 
-    // WIDTH
-    std::getline(line_stream, item, ' ');
-    camera.width = std::stoll(item);
+  const uint8_t* pos_;
+  const uint8_t* end_;
+  const std::string& path_;
+};
+
+// Read or write a single camera in the binary format.
+void ReadCameraBinary(BinaryBufferReader* reader, struct Camera* camera) {
+  camera->camera_id = reader->Read<camera_t>();
+  camera->model_id = static_cast<CameraModelId>(reader->Read<int>());
+  camera->width = reader->Read<uint64_t>();
+  camera->height = reader->Read<uint64_t>();
+  camera->params.resize(CameraModelNumParams(camera->model_id), 0.);
+  for (double& param : camera->params) {
+    param = reader->Read<double>();
+  }
+  THROW_CHECK(camera->VerifyParams());
+}
 
-    // HEIGHT
-    std::getline(line_stream, item, ' ');
-    camera.height = std::stoll(item);
+void WriteCameraBinary(const struct Camera& camera, std::ostream* stream) {
+  WriteBinaryLittleEndian<camera_t>(stream, camera.camera_id);
+  WriteBinaryLittleEndian<int>(stream, static_cast<int>(camera.model_id));
+  WriteBinaryLittleEndian<uint64_t>(stream, camera.width);
+  WriteBinaryLittleEndian<uint64_t>(stream, camera.height);
+  for (const double param : camera.params) {
+    WriteBinaryLittleEndian<double>(stream, param);
+  }
+}
 
-    // PARAMS
-    camera.params.reserve(CameraModelNumParams(camera.model_id));
-    while (!line_stream.eof()) {
-      std::getline(line_stream, item, ' ');
-      camera.params.push_back(std::stold(item));
-    }
+// Skip, read, or write a single registered image in the binary format.
+void SkipImageBinary(BinaryBufferReader* reader) {
+  const size_t kNumPoseBytes =
+      sizeof(image_t) + 7 * sizeof(double) + sizeof(camera_t);
+  const size_t kNumPoint2DBytes = 2 * sizeof(double) + sizeof(point3D_t);
+  reader->Skip(kNumPoseBytes);
+  reader->SkipString();
+  reader->Skip(reader->Read<uint64_t>() * kNumPoint2DBytes);
+}
 
-    THROW_CHECK(camera.VerifyParams());
-    reconstruction.AddCamera(std::move(camera));
+void ReadImageBinary(BinaryBufferReader* reader, class Image* image) {
+  image->SetImageId(reader->Read<image_t>());
+
+  Rigid3d& cam_from_world = image->CamFromWorld();
+  cam_from_world.rotation.w() = reader->Read<double>();
+  cam_from_world.rotation.x() = reader->Read<double>();
+  cam_from_world.rotation.y() = reader->Read<double>();
+  cam_from_world.rotation.z() = reader->Read<double>();
+  cam_from_world.rotation.normalize();
+  cam_from_world.translation.x() = reader->Read<double>();
+  cam_from_world.translation.y() = reader->Read<double>();
+  cam_from_world.translation.z() = reader->Read<double>();
+
+  image->SetCameraId(reader->Read<camera_t>());
+
+  image->Name() = reader->ReadString();
+
+  const size_t num_points2D = reader->Read<uint64_t>();
+  std::vector<struct Point2D> points2D(num_points2D);
+  for (struct Point2D& point2D : points2D) {
+    point2D.xy(0) = reader->Read<double>();
+    point2D.xy(1) = reader->Read<double>();
+    point2D.point3D_id = reader->Read<point3D_t>();
   }
+  image->SetPoints2D(points2D);
+
+  image->SetRegistered(true);
 }
 
-void ReadImagesText(Reconstruction& reconstruction, const std::string& path) {
-  std::ifstream file(path);
-  THROW_CHECK_FILE_OPEN(file, path);
+void WriteImageBinary(const class Image& image, std::ostream* stream) {
+  WriteBinaryLittleEndian<image_t>(stream, image.ImageId());
 
-  std::string line;
-  std::string item;
+  const Rigid3d& cam_from_world = image.CamFromWorld();
+  WriteBinaryLittleEndian<double>(stream, cam_from_world.rotation.w());
+  WriteBinaryLittleEndian<double>(stream, cam_from_world.rotation.x());
+  WriteBinaryLittleEndian<double>(stream, cam_from_world.rotation.y());
+  WriteBinaryLittleEndian<double>(stream, cam_from_world.rotation.z());
+  WriteBinaryLittleEndian<double>(stream, cam_from_world.translation.x());
+  WriteBinaryLittleEndian<double>(stream, cam_from_world.translation.y());
+  WriteBinaryLittleEndian<double>(stream, cam_from_world.translation.z());
 
-  while (std::getline(file, line)) {
-    StringTrim(&line);
-
-    if (line.empty() || line[0] == '#') {
-      continue;
-    }
+  WriteBinaryLittleEndian<camera_t>(stream, image.CameraId());
 
-    std::stringstream line_stream1(line);
+  const std::string name = image.Name() + '\0';
+  stream->write(name.c_str(), name.size());
 
-    // ID
-    std::getline(line_stream1, item, ' ');
-    const image_t image_id = std::stoul(item);
+  WriteBinaryLittleEndian<uint64_t>(stream, image.NumPoints2D());
+  for (const Point2D& point2D : image.Points2D()) {
+    WriteBinaryLittleEndian<double>(stream, point2D.xy(0));
+    WriteBinaryLittleEndian<double>(stream, point2D.xy(1));
+    WriteBinaryLittleEndian<point3D_t>(stream, point2D.point3D_id);
+  }
+}
 
-    class Image image;
-    image.SetImageId(image_id);
+// Skip, read, or write a single 3D point in the binary format.
+void SkipPoint3DBinary(BinaryBufferReader* reader) {
+  const size_t kNumPointBytes = sizeof(point3D_t) + 3 * sizeof(double) +
+                                3 * sizeof(uint8_t) + sizeof(double);
+  const size_t kNumTrackElementBytes = sizeof(image_t) + sizeof(point2D_t);
+  reader->Skip(kNumPointBytes);
+  reader->Skip(reader->Read<uint64_t>() * kNumTrackElementBytes);
+}
 
-    image.SetRegistered(true);
+void ReadPoint3DBinary(BinaryBufferReader* reader,
+                       point3D_t* point3D_id,
+                       struct Point3D* point3D) {
+  *point3D_id = reader->Read<point3D_t>();
+
+  point3D->xyz(0) = reader->Read<double>();
+  point3D->xyz(1) = reader->Read<double>();
+  point3D->xyz(2) = reader->Read<double>();
+  point3D->color(0) = reader->Read<uint8_t>();
+  point3D->color(1) = reader->Read<uint8_t>();
+  point3D->color(2) = reader->Read<uint8_t>();
+  point3D->error = reader->Read<double>();
+
+  const size_t track_length = reader->Read<uint64_t>();
+  point3D->track.Reserve(track_length);
+  for (size_t j = 0; j < track_length; ++j) {
+    const image_t image_id = reader->Read<image_t>();
+    const point2D_t point2D_idx = reader->Read<point2D_t>();
+    point3D->track.AddElement(image_id, point2D_idx);
+  }
+}
 
-    Rigid3d& cam_from_world = image.CamFromWorld();
+void WritePoint3DBinary(const point3D_t point3D_id,
+                        const struct Point3D& point3D,
+                        std::ostream* stream) {
+  WriteBinaryLittleEndian<point3D_t>(stream, point3D_id);
+  WriteBinaryLittleEndian<double>(stream, point3D.xyz(0));
+  WriteBinaryLittleEndian<double>(stream, point3D.xyz(1));
+  WriteBinaryLittleEndian<double>(stream, point3D.xyz(2));
+  WriteBinaryLittleEndian<uint8_t>(stream, point3D.color(0));
+  WriteBinaryLittleEndian<uint8_t>(stream, point3D.color(1));
+  WriteBinaryLittleEndian<uint8_t>(stream, point3D.color(2));
+  WriteBinaryLittleEndian<double>(stream, point3D.error);
+
+  WriteBinaryLittleEndian<uint64_t>(stream, point3D.track.Length());
+  for (const auto& track_el : point3D.track.Elements()) {
+    WriteBinaryLittleEndian<image_t>(stream, track_el.image_id);
+    WriteBinaryLittleEndian<point2D_t>(stream, track_el.point2D_idx);
+  }
+}
 
-    std::getline(line_stream1, item, ' ');
-    cam_from_world.rotation.w() = std::stold(item);
+// Run func(begin, end) over chunks of [0, num_items) in parallel, where small
+// inputs are processed on the calling thread to avoid the threading overhead.
+template <typename Func>
+void ParallelForChunks(const size_t num_items,
+                       const int num_threads,
+                       const size_t min_num_items_per_thread,
+                       const Func& func) {
+  const int effective_num_threads = std::min<size_t>(
+      GetEffectiveNumThreads(num_threads),
+      std::max<size_t>(1, num_items / min_num_items_per_thread));
+  if (effective_num_threads == 1) {
+    func(0, num_items);
+    return;
+  }
 
-    std::getline(line_stream1, item, ' ');
-    cam_from_world.rotation.x() = std::stold(item);
+  ThreadPool thread_pool(effective_num_threads);
+  const size_t chunk_size =
+      (num_items + effective_num_threads - 1) / effective_num_threads;
+  for (size_t begin = 0; begin < num_items; begin += chunk_size) {
+    thread_pool.AddTask(func, begin, std::min(num_items, begin + chunk_size));
+  }
+  thread_pool.Wait();
+}
 
-    std::getline(line_stream1, item, ' ');
-    cam_from_world.rotation.y() = std::stold(item);
+// Read the entire file into a null-terminated buffer with a single read.
+std::string ReadFileToString(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+  file.seekg(0, std::ios::end);
+  const std::streamoff num_bytes = file.tellg();
+  file.seekg(0, std::ios::beg);
+  std::string data(static_cast<size_t>(num_bytes), '\0');
+  file.read(&data[0], num_bytes);
+  return data;
+}
 
-    std::getline(line_stream1, item, ' ');
-    cam_from_world.rotation.z() = std::stold(item);
+inline bool IsTextSpace(const char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' ||
+         c == '\f';
+}
 
-    cam_from_world.rotation.normalize();
+struct TextLine {
+  const char* begin;
+  const char* end;
+
+  bool IsEmpty() const { return begin == end; }
+  bool IsComment() const { return begin != end && *begin == '#'; }
+};
+
+// Split the text into lines without leading and trailing whitespace.
+std::vector<TextLine> SplitTextLines(const std::string& text) {
+  std::vector<TextLine> lines;
+  const char* pos = text.data();
+  const char* text_end = text.data() + text.size();
+  while (pos < text_end) {
+    const char* line_end =
+        static_cast<const char*>(memchr(pos, '\n', text_end - pos));
+    if (line_end == nullptr) {
+      line_end = text_end;
+    }
+    TextLine line{pos, line_end};
+    while (line.begin < line.end && IsTextSpace(*line.begin)) {
+      ++line.begin;
+    }
+    while (line.end > line.begin && IsTextSpace(*(line.end - 1))) {
+      --line.end;
+    }
+    lines.push_back(line);
+    pos = line_end + 1;
+  }
+  return lines;
+}
 
-    std::getline(line_stream1, item, ' ');
-    cam_from_world.translation.x() = std::stold(item);
+// Parser of space-separated values in a line of a null-terminated text.
+class TextLineParser {
+ public:
+  explicit TextLineParser(const TextLine& line)
+      : pos_(line.begin), end_(line.end) {}
 
-    std::getline(line_stream1, item, ' ');
-    cam_from_world.translation.y() = std::stold(item);
+  bool AtEnd() {
+    SkipSpaces();
+    return pos_ >= end_;
+  }
 
-    std::getline(line_stream1, item, ' ');
-    cam_from_world.translation.z() = std::stold(item);
+  double ReadDouble() {
+    SkipSpaces();
+    char* next = nullptr;
+    const double value = std::strtod(pos_, &next);
+    CheckParsed(next);
+    return value;
+  }
 
-    // CAMERA_ID
-    std::getline(line_stream1, item, ' ');
-    image.SetCameraId(std::stoul(item));
+  int64_t ReadInt() {
+    SkipSpaces();
+    char* next = nullptr;
+    const int64_t value = std::strtoll(pos_, &next, 10);
+    CheckParsed(next);
+    return value;
+  }
 
-    // NAME
-    std::getline(line_stream1, item, ' ');
-    image.SetName(item);
+  std::string ReadToken() {
+    SkipSpaces();
+    const char* token_begin = pos_;
+    while (pos_ < end_ && !IsTextSpace(*pos_)) {
+      ++pos_;
+    }
+    return std::string(token_begin, pos_);
+  }
 
-    // POINTS2D
-    if (!std::getline(file, line)) {
-      break;
+ private:
+  void SkipSpaces() {
+    while (pos_ < end_ && IsTextSpace(*pos_)) {
+      ++pos_;
     }
+  }
 
-    StringTrim(&line);
-    std::stringstream line_stream2(line);
+  void CheckParsed(const char* next) {
+    THROW_CHECK(next != pos_ && next <= end_)
+        << "Invalid value in line: " << std::string(pos_, end_);
+    pos_ = next;
+  }
 
-    std::vector<Eigen::Vector2d> points2D;
-    std::vector<point3D_t> point3D_ids;
+  const char* pos_;
+  const char* end_;
+};
 
-    if (!line.empty()) {
-      while (!line_stream2.eof()) {
-        Eigen::Vector2d point;
+inline void AppendDouble(const double value, std::string* text) {
+  // Identical to std::ostream with a precision of 17 digits, which ensures
+  // that we don't loose any precision by storing in text.
+  char buffer[32];
+  const int num_chars = snprintf(buffer, sizeof(buffer), "%.17g", value);
+  text->append(buffer, num_chars);
+}
 
-        std::getline(line_stream2, item, ' ');
-        point.x() = std::stold(item);
+template <typename T>
+inline void AppendInteger(const T value, std::string* text) {
+  text->append(std::to_string(value));
+}
 
-        std::getline(line_stream2, item, ' ');
-        point.y() = std::stold(item);
+// Format the items in parallel chunks with format(item, &text) and write the
+// formatted text in the original order of the items. Only a limited number of
+// chunks is formatted at a time to bound the memory usage.
+template <typename T, typename Func>
+void WriteFormattedText(const std::vector<T>& items,
+                        const int num_threads,
+                        const Func& format,
+                        std::ostream* stream) {
+  const size_t kNumItemsPerChunk = 10000;
+  const size_t num_chunks =
+      (items.size() + kNumItemsPerChunk - 1) / kNumItemsPerChunk;
+
+  auto FormatChunk = [&](const size_t chunk_idx, std::string* text) {
+    text->clear();
+    const size_t begin = chunk_idx * kNumItemsPerChunk;
+    const size_t end = std::min(items.size(), begin + kNumItemsPerChunk);
+    for (size_t i = begin; i < end; ++i) {
+      format(items[i], text);
+    }
+  };
+
+  const int effective_num_threads = std::min<size_t>(
+      GetEffectiveNumThreads(num_threads), std::max<size_t>(1, num_chunks));
+  if (effective_num_threads == 1) {
+    std::string text;
+    for (size_t chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+      FormatChunk(chunk_idx, &text);
+      stream->write(text.data(), text.size());
+    }
+    return;
+  }
 
-        points2D.push_back(point);
+  ThreadPool thread_pool(effective_num_threads);
+  std::vector<std::string> texts(effective_num_threads);
+  for (size_t block_begin = 0; block_begin < num_chunks;
+       block_begin += effective_num_threads) {
+    const size_t block_end =
+        std::min(num_chunks, block_begin + effective_num_threads);
+    for (size_t chunk_idx = block_begin; chunk_idx < block_end; ++chunk_idx) {
+      thread_pool.AddTask(
+          FormatChunk, chunk_idx, &texts[chunk_idx - block_begin]);
+    }
+    thread_pool.Wait();
+    for (size_t chunk_idx = block_begin; chunk_idx < block_end; ++chunk_idx) {
+      const std::string& text = texts[chunk_idx - block_begin];
+      stream->write(text.data(), text.size());
+    }
+  }
+}
 
-        std::getline(line_stream2, item, ' ');
-        if (item == "-1") {
-          point3D_ids.push_back(kInvalidPoint3DId);
-        } else {
-          point3D_ids.push_back(std::stoll(item));
-        }
-      }
+// Index entry of a tile in the tiled binary 3D point format.
+struct Points3DTile {
+  Eigen::Vector3d min_xyz;
+  Eigen::Vector3d max_xyz;
+  size_t num_points3D = 0;
+  size_t offset = 0;
+};
+
+// Header of the tiled format, consisting of the number of tiles, the tile
+// size, and the index entries of all tiles.
+const size_t kNumTiledHeaderBytes = sizeof(uint64_t) + sizeof(double);
+const size_t kNumTileIndexBytes = 6 * sizeof(double) + 2 * sizeof(uint64_t);
+
+void ReadPoints3DTiles(
+    Reconstruction& reconstruction,
+    const std::string& path,
+    const std::pair<Eigen::Vector3d, Eigen::Vector3d>* bbox,
+    const double level_of_detail) {
+  THROW_CHECK_GT(level_of_detail, 0);
+  THROW_CHECK_LE(level_of_detail, 1);
+
+  const MappedFile file(path);
+  BinaryBufferReader reader(file.Data(), file.Data() + file.Size(), path);
+
+  const size_t num_tiles = reader.Read<uint64_t>();
+  reader.Read<double>();  // Tile size, only informational.
+
+  std::vector<Points3DTile> tiles(num_tiles);
+  for (Points3DTile& tile : tiles) {
+    for (int d = 0; d < 3; ++d) {
+      tile.min_xyz(d) = reader.Read<double>();
+    }
+    for (int d = 0; d < 3; ++d) {
+      tile.max_xyz(d) = reader.Read<double>();
     }
+    tile.num_points3D = reader.Read<uint64_t>();
+    tile.offset = reader.Read<uint64_t>();
+    THROW_CHECK_LE(tile.offset, file.Size());
+  }
 
-    image.SetPoints2D(points2D);
+  const bool is_partial = bbox != nullptr || level_of_detail < 1;
 
-    for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
-         ++point2D_idx) {
-      if (point3D_ids[point2D_idx] != kInvalidPoint3DId) {
-        image.SetPoint3DForPoint2D(point2D_idx, point3D_ids[point2D_idx]);
+  for (const Points3DTile& tile : tiles) {
+    // Only the pages of the overlapping tiles are accessed in the mapping.
+    bool is_tile_inside_bbox = true;
+    if (bbox != nullptr) {
+      if ((tile.max_xyz.array() < bbox->first.array()).any() ||
+          (tile.min_xyz.array() > bbox->second.array()).any()) {
+        continue;
       }
+      is_tile_inside_bbox =
+          (tile.min_xyz.array() >= bbox->first.array()).all() &&
+          (tile.max_xyz.array() <= bbox->second.array()).all();
     }
 
-    reconstruction.AddImage(std::move(image));
+    // The points of a tile are shuffled, so any prefix is a subsample.
+    const size_t num_points3D = std::min<size_t>(
+        tile.num_points3D,
+        static_cast<size_t>(std::ceil(level_of_detail * tile.num_points3D)));
+
+    BinaryBufferReader tile_reader = reader.At(file.Data() + tile.offset);
+    for (size_t i = 0; i < num_points3D; ++i) {
+      point3D_t point3D_id;
+      struct Point3D point3D;
+      ReadPoint3DBinary(&tile_reader, &point3D_id, &point3D);
+      if (!is_tile_inside_bbox &&
+          ((point3D.xyz.array() < bbox->first.array()).any() ||
+           (point3D.xyz.array() > bbox->second.array()).any())) {
+        continue;
+      }
+      reconstruction.AddPoint3D(point3D_id, std::move(point3D));
+    }
+  }
+
+  // Remove the observations of the 3D points that were not read.
+  if (is_partial) {
+    for (const image_t image_id : reconstruction.RegImageIds()) {
+      class Image& image = reconstruction.Image(image_id);
+      for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+           ++point2D_idx) {
+        const struct Point2D& point2D = image.Point2D(point2D_idx);
+        if (point2D.HasPoint3D() &&
+            !reconstruction.ExistsPoint3D(point2D.point3D_id)) {
+          image.ResetPoint3DForPoint2D(point2D_idx);
+        }
+      }
+    }
   }
 }
 
-void ReadPoints3DText(Reconstruction& reconstruction, const std::string& path) {
+}  // namespace
+
+void ReadCamerasText(Reconstruction& reconstruction, const std::string& path) {
   std::ifstream file(path);
   THROW_CHECK_FILE_OPEN(file, path);
 
@@ -209,56 +548,168 @@ void ReadPoints3DText(Reconstruction& reconstruction, const std::string& path) {
 
     std::stringstream line_stream(line);
 
+    struct Camera camera;
+
     // ID
     std::getline(line_stream, item, ' ');
-    const point3D_t point3D_id = std::stoll(item);
-
-    struct Point3D point3D;
+    camera.camera_id = std::stoul(item);
 
-    // XYZ
+    // MODEL
     std::getline(line_stream, item, ' ');
-    point3D.xyz(0) = std::stold(item);
+    camera.model_id = CameraModelNameToId(item);
 
+    // WIDTH
     std::getline(line_stream, item, ' ');
-    point3D.xyz(1) = std::stold(item);
+    camera.width = std::stoll(item);
 
+    // HEIGHT
     std::getline(line_stream, item, ' ');
-    point3D.xyz(2) = std::stold(item);
+    camera.height = std::stoll(item);
 
-    // Color
-    std::getline(line_stream, item, ' ');
-    point3D.color(0) = static_cast<uint8_t>(std::stoi(item));
+    // PARAMS
+    camera.params.reserve(CameraModelNumParams(camera.model_id));
+    while (!line_stream.eof()) {
+      std::getline(line_stream, item, ' ');
+      camera.params.push_back(std::stold(item));
+    }
 
-    std::getline(line_stream, item, ' ');
-    point3D.color(1) = static_cast<uint8_t>(std::stoi(item));
+    THROW_CHECK(camera.VerifyParams());
+    reconstruction.AddCamera(std::move(camera));
+  }
+}
 
-    std::getline(line_stream, item, ' ');
-    point3D.color(2) = static_cast<uint8_t>(std::stoi(item));
+void ReadImagesText(Reconstruction& reconstruction,
+                    const std::string& path,
+                    const int num_threads) {
+  const std::string text = ReadFileToString(path);
+  const std::vector<TextLine> lines = SplitTextLines(text);
+
+  // Each image consists of a line with its pose and name, which is followed
+  // by a (possibly empty) line with its 2D points.
+  std::vector<std::pair<TextLine, TextLine>> image_lines;
+  for (size_t i = 0; i < lines.size(); ++i) {
+    if (lines[i].IsEmpty() || lines[i].IsComment()) {
+      continue;
+    }
+    if (i + 1 == lines.size()) {
+      break;
+    }
+    image_lines.emplace_back(lines[i], lines[i + 1]);
+    ++i;
+  }
 
-    // ERROR
-    std::getline(line_stream, item, ' ');
-    point3D.error = std::stold(item);
+  std::vector<class Image> images(image_lines.size());
+
+  auto ParseImages = [&](const size_t begin, const size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      class Image& image = images[i];
+
+      TextLineParser parser1(image_lines[i].first);
+
+      // ID
+      image.SetImageId(static_cast<image_t>(parser1.ReadInt()));
+
+      image.SetRegistered(true);
+
+      Rigid3d& cam_from_world = image.CamFromWorld();
+      cam_from_world.rotation.w() = parser1.ReadDouble();
+      cam_from_world.rotation.x() = parser1.ReadDouble();
+      cam_from_world.rotation.y() = parser1.ReadDouble();
+      cam_from_world.rotation.z() = parser1.ReadDouble();
+      cam_from_world.rotation.normalize();
+      cam_from_world.translation.x() = parser1.ReadDouble();
+      cam_from_world.translation.y() = parser1.ReadDouble();
+      cam_from_world.translation.z() = parser1.ReadDouble();
+
+      // CAMERA_ID
+      image.SetCameraId(static_cast<camera_t>(parser1.ReadInt()));
+
+      // NAME
+      image.SetName(parser1.ReadToken());
+
+      // POINTS2D
+      TextLineParser parser2(image_lines[i].second);
+      std::vector<struct Point2D> points2D;
+      while (!parser2.AtEnd()) {
+        struct Point2D point2D;
+        point2D.xy(0) = parser2.ReadDouble();
+        point2D.xy(1) = parser2.ReadDouble();
+        const int64_t point3D_id = parser2.ReadInt();
+        if (point3D_id != -1) {
+          point2D.point3D_id = static_cast<point3D_t>(point3D_id);
+        }
+        points2D.push_back(point2D);
+      }
+      image.SetPoints2D(points2D);
+    }
+  };
 
-    // TRACK
-    while (!line_stream.eof()) {
-      TrackElement track_el;
+  const size_t kMinNumImagesPerThread = 100;
+  ParallelForChunks(
+      images.size(), num_threads, kMinNumImagesPerThread, ParseImages);
 
-      std::getline(line_stream, item, ' ');
-      StringTrim(&item);
-      if (item.empty()) {
-        break;
-      }
-      track_el.image_id = std::stoul(item);
+  reconstruction.ReserveImages(reconstruction.NumImages() + images.size());
+  for (class Image& image : images) {
+    reconstruction.AddImage(std::move(image));
+  }
+}
 
-      std::getline(line_stream, item, ' ');
-      track_el.point2D_idx = std::stoul(item);
+void ReadPoints3DText(Reconstruction& reconstruction,
+                      const std::string& path,
+                      const int num_threads) {
+  const std::string text = ReadFileToString(path);
+  std::vector<TextLine> lines = SplitTextLines(text);
+  lines.erase(std::remove_if(lines.begin(),
+                             lines.end(),
+                             [](const TextLine& line) {
+                               return line.IsEmpty() || line.IsComment();
+                             }),
+              lines.end());
+
+  std::vector<point3D_t> point3D_ids(lines.size());
+  std::vector<struct Point3D> points3D(lines.size());
+
+  auto ParsePoints3D = [&](const size_t begin, const size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      TextLineParser parser(lines[i]);
+      struct Point3D& point3D = points3D[i];
+
+      // ID
+      point3D_ids[i] = static_cast<point3D_t>(parser.ReadInt());
+
+      // XYZ
+      point3D.xyz(0) = parser.ReadDouble();
+      point3D.xyz(1) = parser.ReadDouble();
+      point3D.xyz(2) = parser.ReadDouble();
+
+      // Color
+      point3D.color(0) = static_cast<uint8_t>(parser.ReadInt());
+      point3D.color(1) = static_cast<uint8_t>(parser.ReadInt());
+      point3D.color(2) = static_cast<uint8_t>(parser.ReadInt());
+
+      // ERROR
+      point3D.error = parser.ReadDouble();
+
+      // TRACK
+      while (!parser.AtEnd()) {
+        const image_t image_id = static_cast<image_t>(parser.ReadInt());
+        const point2D_t point2D_idx =
+            static_cast<point2D_t>(parser.ReadInt());
+        point3D.track.AddElement(image_id, point2D_idx);
+      }
 
-      point3D.track.AddElement(track_el);
+      point3D.track.Compress();
     }
+  };
 
-    point3D.track.Compress();
+  const size_t kMinNumPoints3DPerThread = 10000;
+  ParallelForChunks(
+      points3D.size(), num_threads, kMinNumPoints3DPerThread, ParsePoints3D);
 
-    reconstruction.AddPoint3D(point3D_id, std::move(point3D));
+  reconstruction.ReservePoints3D(reconstruction.NumPoints3D() +
+                                 points3D.size());
+  for (size_t i = 0; i < points3D.size(); ++i) {
+    reconstruction.AddPoint3D(point3D_ids[i], std::move(points3D[i]));
   }
 }
 
@@ -282,91 +733,74 @@ void ReadCamerasBinary(Reconstruction& reconstruction,
   }
 }
 
-void ReadImagesBinary(Reconstruction& reconstruction, const std::string& path) {
-  std::ifstream file(path, std::ios::binary);
-  THROW_CHECK_FILE_OPEN(file, path);
+void ReadImagesBinary(Reconstruction& reconstruction,
+                      const std::string& path,
+                      const int num_threads) {
+  const MappedFile file(path);
+  BinaryBufferReader reader(file.Data(), file.Data() + file.Size(), path);
+
+  const size_t num_reg_images = reader.Read<uint64_t>();
 
-  const size_t num_reg_images = ReadBinaryLittleEndian<uint64_t>(&file);
+  // The records have variable size, so first find their offsets in a cheap
+  // sequential pass, such that they can then be parsed independently.
+  std::vector<const uint8_t*> record_begins(num_reg_images);
   for (size_t i = 0; i < num_reg_images; ++i) {
-    class Image image;
-
-    image.SetImageId(ReadBinaryLittleEndian<image_t>(&file));
-
-    Rigid3d& cam_from_world = image.CamFromWorld();
-    cam_from_world.rotation.w() = ReadBinaryLittleEndian<double>(&file);
-    cam_from_world.rotation.x() = ReadBinaryLittleEndian<double>(&file);
-    cam_from_world.rotation.y() = ReadBinaryLittleEndian<double>(&file);
-    cam_from_world.rotation.z() = ReadBinaryLittleEndian<double>(&file);
-    cam_from_world.rotation.normalize();
-    cam_from_world.translation.x() = ReadBinaryLittleEndian<double>(&file);
-    cam_from_world.translation.y() = ReadBinaryLittleEndian<double>(&file);
-    cam_from_world.translation.z() = ReadBinaryLittleEndian<double>(&file);
-
-    image.SetCameraId(ReadBinaryLittleEndian<camera_t>(&file));
-
-    char name_char;
-    do {
-      file.read(&name_char, 1);
-      if (name_char != '\0') {
-        image.Name() += name_char;
-      }
-    } while (name_char != '\0');
-
-    const size_t num_points2D = ReadBinaryLittleEndian<uint64_t>(&file);
-
-    std::vector<Eigen::Vector2d> points2D;
-    points2D.reserve(num_points2D);
-    std::vector<point3D_t> point3D_ids;
-    point3D_ids.reserve(num_points2D);
-    for (size_t j = 0; j < num_points2D; ++j) {
-      const double x = ReadBinaryLittleEndian<double>(&file);
-      const double y = ReadBinaryLittleEndian<double>(&file);
-      points2D.emplace_back(x, y);
-      point3D_ids.push_back(ReadBinaryLittleEndian<point3D_t>(&file));
-    }
+    record_begins[i] = reader.Position();
+    SkipImageBinary(&reader);
+  }
 
-    image.SetPoints2D(points2D);
+  std::vector<class Image> images(num_reg_images);
 
-    for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
-         ++point2D_idx) {
-      if (point3D_ids[point2D_idx] != kInvalidPoint3DId) {
-        image.SetPoint3DForPoint2D(point2D_idx, point3D_ids[point2D_idx]);
-      }
+  auto ParseImages = [&](const size_t begin, const size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      BinaryBufferReader record_reader = reader.At(record_begins[i]);
+      ReadImageBinary(&record_reader, &images[i]);
     }
+  };
 
-    image.SetRegistered(true);
+  const size_t kMinNumImagesPerThread = 100;
+  ParallelForChunks(
+      num_reg_images, num_threads, kMinNumImagesPerThread, ParseImages);
+
+  reconstruction.ReserveImages(reconstruction.NumImages() + num_reg_images);
+  for (class Image& image : images) {
     reconstruction.AddImage(std::move(image));
   }
 }
 
 void ReadPoints3DBinary(Reconstruction& reconstruction,
-                        const std::string& path) {
-  std::ifstream file(path, std::ios::binary);
-  THROW_CHECK_FILE_OPEN(file, path);
+                        const std::string& path,
+                        const int num_threads) {
+  const MappedFile file(path);
+  BinaryBufferReader reader(file.Data(), file.Data() + file.Size(), path);
 
-  const size_t num_points3D = ReadBinaryLittleEndian<uint64_t>(&file);
+  const size_t num_points3D = reader.Read<uint64_t>();
+
+  // The records have variable size, so first find their offsets in a cheap
+  // sequential pass, such that they can then be parsed independently.
+  std::vector<const uint8_t*> record_begins(num_points3D);
   for (size_t i = 0; i < num_points3D; ++i) {
-    struct Point3D point3D;
-
-    const point3D_t point3D_id = ReadBinaryLittleEndian<point3D_t>(&file);
-
-    point3D.xyz(0) = ReadBinaryLittleEndian<double>(&file);
-    point3D.xyz(1) = ReadBinaryLittleEndian<double>(&file);
-    point3D.xyz(2) = ReadBinaryLittleEndian<double>(&file);
-    point3D.color(0) = ReadBinaryLittleEndian<uint8_t>(&file);
-    point3D.color(1) = ReadBinaryLittleEndian<uint8_t>(&file);
-    point3D.color(2) = ReadBinaryLittleEndian<uint8_t>(&file);
-    point3D.error = ReadBinaryLittleEndian<double>(&file);
-
-    const size_t track_length = ReadBinaryLittleEndian<uint64_t>(&file);
-    for (size_t j = 0; j < track_length; ++j) {
-      const image_t image_id = ReadBinaryLittleEndian<image_t>(&file);
-      const point2D_t point2D_idx = ReadBinaryLittleEndian<point2D_t>(&file);
-      point3D.track.AddElement(image_id, point2D_idx);
+    record_begins[i] = reader.Position();
+    SkipPoint3DBinary(&reader);
+  }
+
+  std::vector<point3D_t> point3D_ids(num_points3D);
+  std::vector<struct Point3D> points3D(num_points3D);
+
+  auto ParsePoints3D = [&](const size_t begin, const size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      BinaryBufferReader record_reader = reader.At(record_begins[i]);
+      ReadPoint3DBinary(&record_reader, &point3D_ids[i], &points3D[i]);
     }
-    point3D.track.Compress();
+  };
 
-    reconstruction.AddPoint3D(point3D_id, std::move(point3D));
+  const size_t kMinNumPoints3DPerThread = 100000;
+  ParallelForChunks(
+      num_points3D, num_threads, kMinNumPoints3DPerThread, ParsePoints3D);
+
+  reconstruction.ReservePoints3D(reconstruction.NumPoints3D() + num_points3D);
+  for (size_t i = 0; i < num_points3D; ++i) {
+    reconstruction.AddPoint3D(point3D_ids[i], std::move(points3D[i]));
   }
 }
 
@@ -403,7 +837,8 @@ void WriteCamerasText(const Reconstruction& reconstruction,
 }
 
 void WriteImagesText(const Reconstruction& reconstruction,
-                     const std::string& path) {
+                     const std::string& path,
+                     const int num_threads) {
   std::ofstream file(path, std::ios::trunc);
   THROW_CHECK_FILE_OPEN(file, path);
 
@@ -419,53 +854,66 @@ void WriteImagesText(const Reconstruction& reconstruction,
        << ", mean observations per image: "
        << reconstruction.ComputeMeanObservationsPerRegImage() << std::endl;
 
+  std::vector<const std::pair<const image_t, class Image>*> images;
+  images.reserve(reconstruction.NumRegImages());
   for (const auto& image : reconstruction.Images()) {
-    if (!image.second.IsRegistered()) {
-      continue;
+    if (image.second.IsRegistered()) {
+      images.push_back(&image);
     }
+  }
 
-    std::ostringstream line;
-    line.precision(17);
-
-    std::string line_string;
-
-    line << image.first << " ";
-
-    const Rigid3d& cam_from_world = image.second.CamFromWorld();
-    line << cam_from_world.rotation.w() << " ";
-    line << cam_from_world.rotation.x() << " ";
-    line << cam_from_world.rotation.y() << " ";
-    line << cam_from_world.rotation.z() << " ";
-    line << cam_from_world.translation.x() << " ";
-    line << cam_from_world.translation.y() << " ";
-    line << cam_from_world.translation.z() << " ";
-
-    line << image.second.CameraId() << " ";
-
-    line << image.second.Name();
-
-    file << line.str() << std::endl;
-
-    line.str("");
-    line.clear();
-
-    for (const Point2D& point2D : image.second.Points2D()) {
-      line << point2D.xy(0) << " ";
-      line << point2D.xy(1) << " ";
+  auto FormatImage = [](const std::pair<const image_t, class Image>* image,
+                        std::string* text) {
+    AppendInteger(image->first, text);
+    *text += ' ';
+
+    const Rigid3d& cam_from_world = image->second.CamFromWorld();
+    AppendDouble(cam_from_world.rotation.w(), text);
+    *text += ' ';
+    AppendDouble(cam_from_world.rotation.x(), text);
+    *text += ' ';
+    AppendDouble(cam_from_world.rotation.y(), text);
+    *text += ' ';
+    AppendDouble(cam_from_world.rotation.z(), text);
+    *text += ' ';
+    AppendDouble(cam_from_world.translation.x(), text);
+    *text += ' ';
+    AppendDouble(cam_from_world.translation.y(), text);
+    *text += ' ';
+    AppendDouble(cam_from_world.translation.z(), text);
+    *text += ' ';
+
+    AppendInteger(image->second.CameraId(), text);
+    *text += ' ';
+
+    *text += image->second.Name();
+    *text += '\n';
+
+    bool is_first = true;
+    for (const Point2D& point2D : image->second.Points2D()) {
+      if (!is_first) {
+        *text += ' ';
+      }
+      is_first = false;
+      AppendDouble(point2D.xy(0), text);
+      *text += ' ';
+      AppendDouble(point2D.xy(1), text);
+      *text += ' ';
       if (point2D.HasPoint3D()) {
-        line << point2D.point3D_id << " ";
+        AppendInteger(point2D.point3D_id, text);
       } else {
-        line << -1 << " ";
+        *text += "-1";
       }
     }
-    line_string = line.str();
-    line_string = line_string.substr(0, line_string.size() - 1);
-    file << line_string << std::endl;
-  }
+    *text += '\n';
+  };
+
+  WriteFormattedText(images, num_threads, FormatImage, &file);
 }
 
 void WritePoints3DText(const Reconstruction& reconstruction,
-                       const std::string& path) {
+                       const std::string& path,
+                       const int num_threads) {
   std::ofstream file(path, std::ios::trunc);
   THROW_CHECK_FILE_OPEN(file, path);
 
@@ -480,29 +928,46 @@ void WritePoints3DText(const Reconstruction& reconstruction,
        << ", mean track length: " << reconstruction.ComputeMeanTrackLength()
        << std::endl;
 
+  std::vector<const std::pair<const point3D_t, struct Point3D>*> points3D;
+  points3D.reserve(reconstruction.NumPoints3D());
   for (const auto& point3D : reconstruction.Points3D()) {
-    file << point3D.first << " ";
-    file << point3D.second.xyz(0) << " ";
-    file << point3D.second.xyz(1) << " ";
-    file << point3D.second.xyz(2) << " ";
-    file << static_cast<int>(point3D.second.color(0)) << " ";
-    file << static_cast<int>(point3D.second.color(1)) << " ";
-    file << static_cast<int>(point3D.second.color(2)) << " ";
-    file << point3D.second.error << " ";
-
-    std::ostringstream line;
-    line.precision(17);
-
-    for (const auto& track_el : point3D.second.track.Elements()) {
-      line << track_el.image_id << " ";
-      line << track_el.point2D_idx << " ";
-    }
+    points3D.push_back(&point3D);
+  }
 
-    std::string line_string = line.str();
-    line_string = line_string.substr(0, line_string.size() - 1);
+  auto FormatPoint3D =
+      [](const std::pair<const point3D_t, struct Point3D>* point3D,
+         std::string* text) {
+        AppendInteger(point3D->first, text);
+        *text += ' ';
+        AppendDouble(point3D->second.xyz(0), text);
+        *text += ' ';
+        AppendDouble(point3D->second.xyz(1), text);
+        *text += ' ';
+        AppendDouble(point3D->second.xyz(2), text);
+        *text += ' ';
+        AppendInteger(static_cast<int>(point3D->second.color(0)), text);
+        *text += ' ';
+        AppendInteger(static_cast<int>(point3D->second.color(1)), text);
+        *text += ' ';
+        AppendInteger(static_cast<int>(point3D->second.color(2)), text);
+        *text += ' ';
+        AppendDouble(point3D->second.error, text);
+        *text += ' ';
+
+        bool is_first = true;
+        for (const auto& track_el : point3D->second.track.Elements()) {
+          if (!is_first) {
+            *text += ' ';
+          }
+          is_first = false;
+          AppendInteger(track_el.image_id, text);
+          *text += ' ';
+          AppendInteger(track_el.point2D_idx, text);
+        }
+        *text += '\n';
+      };
 
-    file << line_string << std::endl;
-  }
+  WriteFormattedText(points3D, num_threads, FormatPoint3D, &file);
 }
 
 void WriteCamerasBinary(const Reconstruction& reconstruction,
@@ -513,14 +978,7 @@ void WriteCamerasBinary(const Reconstruction& reconstruction,
   WriteBinaryLittleEndian<uint64_t>(&file, reconstruction.NumCameras());
 
   for (const auto& camera : reconstruction.Cameras()) {
-    WriteBinaryLittleEndian<camera_t>(&file, camera.first);
-    WriteBinaryLittleEndian<int>(&file,
-                                 static_cast<int>(camera.second.model_id));
-    WriteBinaryLittleEndian<uint64_t>(&file, camera.second.width);
-    WriteBinaryLittleEndian<uint64_t>(&file, camera.second.height);
-    for (const double param : camera.second.params) {
-      WriteBinaryLittleEndian<double>(&file, param);
-    }
+    WriteCameraBinary(camera.second, &file);
   }
 }
 
@@ -536,28 +994,7 @@ void WriteImagesBinary(const Reconstruction& reconstruction,
       continue;
     }
 
-    WriteBinaryLittleEndian<image_t>(&file, image.first);
-
-    const Rigid3d& cam_from_world = image.second.CamFromWorld();
-    WriteBinaryLittleEndian<double>(&file, cam_from_world.rotation.w());
-    WriteBinaryLittleEndian<double>(&file, cam_from_world.rotation.x());
-    WriteBinaryLittleEndian<double>(&file, cam_from_world.rotation.y());
-    WriteBinaryLittleEndian<double>(&file, cam_from_world.rotation.z());
-    WriteBinaryLittleEndian<double>(&file, cam_from_world.translation.x());
-    WriteBinaryLittleEndian<double>(&file, cam_from_world.translation.y());
-    WriteBinaryLittleEndian<double>(&file, cam_from_world.translation.z());
-
-    WriteBinaryLittleEndian<camera_t>(&file, image.second.CameraId());
-
-    const std::string name = image.second.Name() + '\0';
-    file.write(name.c_str(), name.size());
-
-    WriteBinaryLittleEndian<uint64_t>(&file, image.second.NumPoints2D());
-    for (const Point2D& point2D : image.second.Points2D()) {
-      WriteBinaryLittleEndian<double>(&file, point2D.xy(0));
-      WriteBinaryLittleEndian<double>(&file, point2D.xy(1));
-      WriteBinaryLittleEndian<point3D_t>(&file, point2D.point3D_id);
-    }
+    WriteImageBinary(image.second, &file);
   }
 }
 
@@ -569,20 +1006,179 @@ void WritePoints3DBinary(const Reconstruction& reconstruction,
   WriteBinaryLittleEndian<uint64_t>(&file, reconstruction.NumPoints3D());
 
   for (const auto& point3D : reconstruction.Points3D()) {
-    WriteBinaryLittleEndian<point3D_t>(&file, point3D.first);
-    WriteBinaryLittleEndian<double>(&file, point3D.second.xyz(0));
-    WriteBinaryLittleEndian<double>(&file, point3D.second.xyz(1));
-    WriteBinaryLittleEndian<double>(&file, point3D.second.xyz(2));
-    WriteBinaryLittleEndian<uint8_t>(&file, point3D.second.color(0));
-    WriteBinaryLittleEndian<uint8_t>(&file, point3D.second.color(1));
-    WriteBinaryLittleEndian<uint8_t>(&file, point3D.second.color(2));
-    WriteBinaryLittleEndian<double>(&file, point3D.second.error);
-
-    WriteBinaryLittleEndian<uint64_t>(&file, point3D.second.track.Length());
-    for (const auto& track_el : point3D.second.track.Elements()) {
-      WriteBinaryLittleEndian<image_t>(&file, track_el.image_id);
-      WriteBinaryLittleEndian<point2D_t>(&file, track_el.point2D_idx);
+    WritePoint3DBinary(point3D.first, point3D.second, &file);
+  }
+}
+
+void ReadPoints3DTiledBinary(Reconstruction& reconstruction,
+                             const std::string& path) {
+  ReadPoints3DTiles(reconstruction,
+                    path,
+                    /*bbox=*/nullptr,
+                    /*level_of_detail=*/1);
+}
+
+void ReadPoints3DTiledBinary(
+    Reconstruction& reconstruction,
+    const std::string& path,
+    const std::pair<Eigen::Vector3d, Eigen::Vector3d>& bbox,
+    const double level_of_detail) {
+  ReadPoints3DTiles(reconstruction, path, &bbox, level_of_detail);
+}
+
+void WritePoints3DTiledBinary(const Reconstruction& reconstruction,
+                              const std::string& path,
+                              double tile_size) {
+  using Point3DPtr = const std::pair<const point3D_t, struct Point3D>*;
+
+  if (tile_size <= 0) {
+    Eigen::Vector3d min_xyz =
+        Eigen::Vector3d::Constant(std::numeric_limits<double>::max());
+    Eigen::Vector3d max_xyz =
+        Eigen::Vector3d::Constant(std::numeric_limits<double>::lowest());
+    for (const auto& point3D : reconstruction.Points3D()) {
+      min_xyz = min_xyz.cwiseMin(point3D.second.xyz);
+      max_xyz = max_xyz.cwiseMax(point3D.second.xyz);
+    }
+    const int kNumTilesPerDim = 16;
+    const double extent = (max_xyz - min_xyz).maxCoeff();
+    tile_size = extent > 0 ? extent / kNumTilesPerDim : 1;
+  }
+
+  // Group the points by tile, where the ordered map makes the file
+  // independent of the order of the points in the reconstruction.
+  std::map<std::array<int64_t, 3>, std::vector<Point3DPtr>> tile_points3D;
+  for (const auto& point3D : reconstruction.Points3D()) {
+    const Eigen::Vector3d cell =
+        (point3D.second.xyz / tile_size).array().floor().matrix();
+    THROW_CHECK(cell.allFinite());
+    tile_points3D[{{static_cast<int64_t>(cell(0)),
+                    static_cast<int64_t>(cell(1)),
+                    static_cast<int64_t>(cell(2))}}]
+        .push_back(&point3D);
+  }
+
+  std::vector<Points3DTile> tiles;
+  tiles.reserve(tile_points3D.size());
+  size_t offset =
+      kNumTiledHeaderBytes + tile_points3D.size() * kNumTileIndexBytes;
+  std::mt19937 prng(0);
+  for (auto& points3D : tile_points3D) {
+    // Shuffle the points, such that any prefix is a uniform subsample.
+    std::sort(points3D.second.begin(),
+              points3D.second.end(),
+              [](const Point3DPtr point3D1, const Point3DPtr point3D2) {
+                return point3D1->first < point3D2->first;
+              });
+    std::shuffle(points3D.second.begin(), points3D.second.end(), prng);
+
+    tiles.emplace_back();
+    Points3DTile& tile = tiles.back();
+    tile.min_xyz =
+        Eigen::Vector3d::Constant(std::numeric_limits<double>::max());
+    tile.max_xyz =
+        Eigen::Vector3d::Constant(std::numeric_limits<double>::lowest());
+    tile.num_points3D = points3D.second.size();
+    tile.offset = offset;
+    for (const Point3DPtr point3D : points3D.second) {
+      tile.min_xyz = tile.min_xyz.cwiseMin(point3D->second.xyz);
+      tile.max_xyz = tile.max_xyz.cwiseMax(point3D->second.xyz);
+      offset += sizeof(point3D_t) + 3 * sizeof(double) + 3 * sizeof(uint8_t) +
+                sizeof(double) + sizeof(uint64_t) +
+                point3D->second.track.Length() *
+                    (sizeof(image_t) + sizeof(point2D_t));
+    }
+  }
+
+  std::ofstream file(path, std::ios::trunc | std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  WriteBinaryLittleEndian<uint64_t>(&file, tiles.size());
+  WriteBinaryLittleEndian<double>(&file, tile_size);
+  for (const Points3DTile& tile : tiles) {
+    for (int d = 0; d < 3; ++d) {
+      WriteBinaryLittleEndian<double>(&file, tile.min_xyz(d));
+    }
+    for (int d = 0; d < 3; ++d) {
+      WriteBinaryLittleEndian<double>(&file, tile.max_xyz(d));
     }
+    WriteBinaryLittleEndian<uint64_t>(&file, tile.num_points3D);
+    WriteBinaryLittleEndian<uint64_t>(&file, tile.offset);
+  }
+
+  for (const auto& points3D : tile_points3D) {
+    for (const Point3DPtr point3D : points3D.second) {
+      WritePoint3DBinary(point3D->first, point3D->second, &file);
+    }
+  }
+}
+
+void ReadReconstructionDeltaBinary(const std::string& path,
+                                   ReconstructionDelta* delta) {
+  THROW_CHECK(delta != nullptr);
+
+  const MappedFile file(path);
+  BinaryBufferReader reader(file.Data(), file.Data() + file.Size(), path);
+
+  delta->parent_name = reader.ReadString();
+
+  delta->cameras.resize(reader.Read<uint64_t>());
+  for (struct Camera& camera : delta->cameras) {
+    ReadCameraBinary(&reader, &camera);
+  }
+
+  delta->images.resize(reader.Read<uint64_t>());
+  for (class Image& image : delta->images) {
+    ReadImageBinary(&reader, &image);
+  }
+
+  delta->points3D.resize(reader.Read<uint64_t>());
+  for (auto& point3D : delta->points3D) {
+    ReadPoint3DBinary(&reader, &point3D.first, &point3D.second);
+  }
+
+  delta->deleted_image_ids.resize(reader.Read<uint64_t>());
+  for (image_t& image_id : delta->deleted_image_ids) {
+    image_id = reader.Read<image_t>();
+  }
+
+  delta->deleted_point3D_ids.resize(reader.Read<uint64_t>());
+  for (point3D_t& point3D_id : delta->deleted_point3D_ids) {
+    point3D_id = reader.Read<point3D_t>();
+  }
+}
+
+void WriteReconstructionDeltaBinary(const ReconstructionDelta& delta,
+                                    const std::string& path) {
+  std::ofstream file(path, std::ios::trunc | std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  const std::string parent_name = delta.parent_name + '\0';
+  file.write(parent_name.c_str(), parent_name.size());
+
+  WriteBinaryLittleEndian<uint64_t>(&file, delta.cameras.size());
+  for (const struct Camera& camera : delta.cameras) {
+    WriteCameraBinary(camera, &file);
+  }
+
+  WriteBinaryLittleEndian<uint64_t>(&file, delta.images.size());
+  for (const class Image& image : delta.images) {
+    WriteImageBinary(image, &file);
+  }
+
+  WriteBinaryLittleEndian<uint64_t>(&file, delta.points3D.size());
+  for (const auto& point3D : delta.points3D) {
+    WritePoint3DBinary(point3D.first, point3D.second, &file);
+  }
+
+  WriteBinaryLittleEndian<uint64_t>(&file, delta.deleted_image_ids.size());
+  for (const image_t image_id : delta.deleted_image_ids) {
+    WriteBinaryLittleEndian<image_t>(&file, image_id);
+  }
+
+  WriteBinaryLittleEndian<uint64_t>(&file, delta.deleted_point3D_ids.size());
+  for (const point3D_t point3D_id : delta.deleted_point3D_ids) {
+    WriteBinaryLittleEndian<point3D_t>(&file, point3D_id);
   }
 }
 
@@ -31,31 +31,95 @@
 
 #include "colmap/scene/reconstruction.h"
 
+#include <string>
+#include <utility>
+#include <vector>
+
 #include <Eigen/Core>
 
 namespace colmap {
 
 void ReadCamerasText(Reconstruction& reconstruction, const std::string& path);
 
-void ReadImagesText(Reconstruction& reconstruction, const std::string& path);
+// The text images and points are read with a single read and their lines
+// are parsed in parallel, if num_threads is not 1 and the file is
+// sufficiently large. The result is independent of the number of threads.
+void ReadImagesText(Reconstruction& reconstruction,
+                    const std::string& path,
+                    int num_threads = -1);
 
-void ReadPoints3DText(Reconstruction& reconstruction, const std::string& path);
+void ReadPoints3DText(Reconstruction& reconstruction,
+                      const std::string& path,
+                      int num_threads = -1);
 
 void ReadCamerasBinary(Reconstruction& reconstruction, const std::string& path);
 
-void ReadImagesBinary(Reconstruction& reconstruction, const std::string& path);
+// The binary images and points are read from a memory mapped file and the
+// records are parsed in parallel, if num_threads is not 1 and the file is
+// sufficiently large. The result is independent of the number of threads.
+void ReadImagesBinary(Reconstruction& reconstruction,
+                      const std::string& path,
+                      int num_threads = -1);
 
 void ReadPoints3DBinary(Reconstruction& reconstruction,
-                        const std::string& path);
+                        const std::string& path,
+                        int num_threads = -1);
+
+// Tiled binary format of the 3D points for partial loading of large
+// reconstructions. The points are grouped into cubic tiles of the given size
+// and a header indexes the bounding box, number of points, and file offset of
+// each tile. The points of each tile are randomly shuffled, such that the
+// first fraction of them is a uniform subsample, i.e., a level of detail. A
+// non-positive tile size splits the largest dimension of the bounding box of
+// all points into 16 tiles.
+void WritePoints3DTiledBinary(const Reconstruction& reconstruction,
+                              const std::string& path,
+                              double tile_size = -1);
+
+// Read all 3D points in the tiled format.
+void ReadPoints3DTiledBinary(Reconstruction& reconstruction,
+                             const std::string& path);
+
+// Read only the 3D points inside the bounding box and only the given fraction
+// (0, 1] of the points of each tile, where only the overlapping tiles of the
+// file are accessed. The images must be read before, since their observations
+// of the 3D points that are not read are removed.
+void ReadPoints3DTiledBinary(
+    Reconstruction& reconstruction,
+    const std::string& path,
+    const std::pair<Eigen::Vector3d, Eigen::Vector3d>& bbox,
+    double level_of_detail = 1.0);
+
+// Changes of a reconstruction relative to a parent state, i.e., the added or
+// modified cameras, registered images, and 3D points and the IDs of the
+// deregistered images and deleted 3D points.
+struct ReconstructionDelta {
+  // Name of the snapshot that the changes are relative to.
+  std::string parent_name;
+  std::vector<struct Camera> cameras;
+  std::vector<class Image> images;
+  std::vector<std::pair<point3D_t, struct Point3D>> points3D;
+  std::vector<image_t> deleted_image_ids;
+  std::vector<point3D_t> deleted_point3D_ids;
+};
+
+void ReadReconstructionDeltaBinary(const std::string& path,
+                                   ReconstructionDelta* delta);
+void WriteReconstructionDeltaBinary(const ReconstructionDelta& delta,
+                                    const std::string& path);
 
 void WriteCamerasText(const Reconstruction& reconstruction,
                       const std::string& path);
 
+// The lines of the text images and points are formatted in parallel chunks,
+// if num_threads is not 1, and written in the same order as serially.
 void WriteImagesText(const Reconstruction& reconstruction,
-                     const std::string& path);
+                     const std::string& path,
+                     int num_threads = -1);
 
 void WritePoints3DText(const Reconstruction& reconstruction,
-                       const std::string& path);
+                       const std::string& path,
+                       int num_threads = -1);
 
 void WriteCamerasBinary(const Reconstruction& reconstruction,
                         const std::string& path);
@@ -0,0 +1,257 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/scene/reconstruction_io.h"
+
+#include "colmap/scene/synthetic.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/testing.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+void ExpectEqualReconstructions(const Reconstruction& expected,
+                                const Reconstruction& actual) {
+  ASSERT_EQ(expected.NumImages(), actual.NumImages());
+  ASSERT_EQ(expected.NumRegImages(), actual.NumRegImages());
+  ASSERT_EQ(expected.NumPoints3D(), actual.NumPoints3D());
+  for (const auto& image : expected.Images()) {
+    const class Image& actual_image = actual.Image(image.first);
+    EXPECT_EQ(image.second.Name(), actual_image.Name());
+    EXPECT_EQ(image.second.CameraId(), actual_image.CameraId());
+    EXPECT_EQ(image.second.IsRegistered(), actual_image.IsRegistered());
+    EXPECT_EQ(image.second.NumPoints3D(), actual_image.NumPoints3D());
+    EXPECT_TRUE(image.second.CamFromWorld().rotation.isApprox(
+        actual_image.CamFromWorld().rotation));
+    EXPECT_EQ(image.second.CamFromWorld().translation,
+              actual_image.CamFromWorld().translation);
+    ASSERT_EQ(image.second.NumPoints2D(), actual_image.NumPoints2D());
+    for (point2D_t point2D_idx = 0; point2D_idx < image.second.NumPoints2D();
+         ++point2D_idx) {
+      EXPECT_EQ(image.second.Point2D(point2D_idx).xy,
+                actual_image.Point2D(point2D_idx).xy);
+      EXPECT_EQ(image.second.Point2D(point2D_idx).point3D_id,
+                actual_image.Point2D(point2D_idx).point3D_id);
+    }
+  }
+  for (const auto& point3D : expected.Points3D()) {
+    const struct Point3D& actual_point3D = actual.Point3D(point3D.first);
+    EXPECT_EQ(point3D.second.xyz, actual_point3D.xyz);
+    EXPECT_EQ(point3D.second.color, actual_point3D.color);
+    EXPECT_EQ(point3D.second.error, actual_point3D.error);
+    ASSERT_EQ(point3D.second.track.Length(), actual_point3D.track.Length());
+    for (size_t i = 0; i < point3D.second.track.Length(); ++i) {
+      EXPECT_EQ(point3D.second.track.Element(i).image_id,
+                actual_point3D.track.Element(i).image_id);
+      EXPECT_EQ(point3D.second.track.Element(i).point2D_idx,
+                actual_point3D.track.Element(i).point2D_idx);
+    }
+  }
+}
+
+TEST(ReconstructionIO, ReadWriteBinary) {
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions options;
+  options.num_cameras = 2;
+  options.num_images = 20;
+  options.num_points3D = 500;
+  SynthesizeDataset(options, &reconstruction);
+
+  const std::string test_dir = CreateTestDir();
+  WriteImagesBinary(reconstruction, JoinPaths(test_dir, "images.bin"));
+  WritePoints3DBinary(reconstruction, JoinPaths(test_dir, "points3D.bin"));
+
+  for (const int num_threads : {1, 4}) {
+    Reconstruction read_reconstruction;
+    for (const auto& camera : reconstruction.Cameras()) {
+      read_reconstruction.AddCamera(camera.second);
+    }
+    ReadImagesBinary(
+        read_reconstruction, JoinPaths(test_dir, "images.bin"), num_threads);
+    ReadPoints3DBinary(
+        read_reconstruction, JoinPaths(test_dir, "points3D.bin"), num_threads);
+    ExpectEqualReconstructions(reconstruction, read_reconstruction);
+  }
+}
+
+TEST(ReconstructionIO, ReadWriteText) {
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions options;
+  options.num_cameras = 2;
+  options.num_images = 20;
+  options.num_points3D = 500;
+  SynthesizeDataset(options, &reconstruction);
+
+  const std::string test_dir = CreateTestDir();
+  WriteImagesText(reconstruction, JoinPaths(test_dir, "images1.txt"), 1);
+  WritePoints3DText(reconstruction, JoinPaths(test_dir, "points3D1.txt"), 1);
+  WriteImagesText(reconstruction, JoinPaths(test_dir, "images4.txt"), 4);
+  WritePoints3DText(reconstruction, JoinPaths(test_dir, "points3D4.txt"), 4);
+
+  // The output must not depend on the number of threads.
+  std::vector<uint8_t> data1;
+  std::vector<uint8_t> data4;
+  ReadBinaryBlob<uint8_t>(JoinPaths(test_dir, "images1.txt"), &data1);
+  ReadBinaryBlob<uint8_t>(JoinPaths(test_dir, "images4.txt"), &data4);
+  EXPECT_EQ(data1, data4);
+  ReadBinaryBlob<uint8_t>(JoinPaths(test_dir, "points3D1.txt"), &data1);
+  ReadBinaryBlob<uint8_t>(JoinPaths(test_dir, "points3D4.txt"), &data4);
+  EXPECT_EQ(data1, data4);
+
+  for (const int num_threads : {1, 4}) {
+    Reconstruction read_reconstruction;
+    for (const auto& camera : reconstruction.Cameras()) {
+      read_reconstruction.AddCamera(camera.second);
+    }
+    ReadImagesText(
+        read_reconstruction, JoinPaths(test_dir, "images1.txt"), num_threads);
+    ReadPoints3DText(
+        read_reconstruction, JoinPaths(test_dir, "points3D1.txt"), num_threads);
+    ExpectEqualReconstructions(reconstruction, read_reconstruction);
+  }
+}
+
+TEST(ReconstructionIO, ReadWriteTiledBinary) {
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions options;
+  options.num_cameras = 2;
+  options.num_images = 20;
+  options.num_points3D = 500;
+  SynthesizeDataset(options, &reconstruction);
+
+  const std::string test_dir = CreateTestDir();
+  const std::string images_path = JoinPaths(test_dir, "images.bin");
+  const std::string points3D_path = JoinPaths(test_dir, "points3D_tiled.bin");
+  WriteImagesBinary(reconstruction, images_path);
+
+  for (const double tile_size : {-1.0, 0.5, 100.0}) {
+    WritePoints3DTiledBinary(reconstruction, points3D_path, tile_size);
+    Reconstruction read_reconstruction;
+    for (const auto& camera : reconstruction.Cameras()) {
+      read_reconstruction.AddCamera(camera.second);
+    }
+    ReadImagesBinary(read_reconstruction, images_path);
+    ReadPoints3DTiledBinary(read_reconstruction, points3D_path);
+    ExpectEqualReconstructions(reconstruction, read_reconstruction);
+  }
+}
+
+TEST(ReconstructionIO, ReadTiledBinaryBoundingBox) {
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions options;
+  options.num_cameras = 2;
+  options.num_images = 20;
+  options.num_points3D = 500;
+  SynthesizeDataset(options, &reconstruction);
+
+  const std::string test_dir = CreateTestDir();
+  const std::string images_path = JoinPaths(test_dir, "images.bin");
+  const std::string points3D_path = JoinPaths(test_dir, "points3D_tiled.bin");
+  WriteImagesBinary(reconstruction, images_path);
+  WritePoints3DTiledBinary(reconstruction, points3D_path, 0.5);
+
+  const std::pair<Eigen::Vector3d, Eigen::Vector3d> bbox(
+      Eigen::Vector3d(-0.7, -0.7, -0.7), Eigen::Vector3d(0.3, 0.3, 0.3));
+
+  Reconstruction read_reconstruction;
+  ReadImagesBinary(read_reconstruction, images_path);
+  ReadPoints3DTiledBinary(read_reconstruction, points3D_path, bbox);
+
+  size_t num_points3D_in_bbox = 0;
+  for (const auto& point3D : reconstruction.Points3D()) {
+    const bool is_inside =
+        (point3D.second.xyz.array() >= bbox.first.array()).all() &&
+        (point3D.second.xyz.array() <= bbox.second.array()).all();
+    EXPECT_EQ(read_reconstruction.ExistsPoint3D(point3D.first), is_inside);
+    num_points3D_in_bbox += is_inside;
+  }
+  EXPECT_EQ(read_reconstruction.NumPoints3D(), num_points3D_in_bbox);
+
+  // The observations of the 3D points outside the box are removed.
+  for (const auto& image : read_reconstruction.Images()) {
+    for (const auto& point2D : image.second.Points2D()) {
+      if (point2D.HasPoint3D()) {
+        EXPECT_TRUE(read_reconstruction.ExistsPoint3D(point2D.point3D_id));
+      }
+    }
+  }
+}
+
+TEST(ReconstructionIO, ReadTiledBinaryLevelOfDetail) {
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions options;
+  options.num_points3D = 1000;
+  SynthesizeDataset(options, &reconstruction);
+
+  const std::string test_dir = CreateTestDir();
+  const std::string images_path = JoinPaths(test_dir, "images.bin");
+  const std::string points3D_path = JoinPaths(test_dir, "points3D_tiled.bin");
+  WriteImagesBinary(reconstruction, images_path);
+  WritePoints3DTiledBinary(reconstruction, points3D_path, 100.0);
+
+  const std::pair<Eigen::Vector3d, Eigen::Vector3d> bbox(
+      Eigen::Vector3d::Constant(-1e6), Eigen::Vector3d::Constant(1e6));
+
+  Reconstruction read_reconstruction;
+  ReadImagesBinary(read_reconstruction, images_path);
+  ReadPoints3DTiledBinary(
+      read_reconstruction, points3D_path, bbox, /*level_of_detail=*/0.25);
+  // The points on the unit sphere fall into at most 8 tiles, each of which is
+  // rounded up to the next point.
+  EXPECT_GE(read_reconstruction.NumPoints3D(), 250);
+  EXPECT_LE(read_reconstruction.NumPoints3D(), 258);
+  for (const auto& point3D : read_reconstruction.Points3D()) {
+    EXPECT_TRUE(reconstruction.ExistsPoint3D(point3D.first));
+  }
+}
+
+TEST(ReconstructionIO, ReadTruncatedBinary) {
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions options;
+  SynthesizeDataset(options, &reconstruction);
+
+  const std::string test_dir = CreateTestDir();
+  const std::string points3D_path = JoinPaths(test_dir, "points3D.bin");
+  WritePoints3DBinary(reconstruction, points3D_path);
+
+  std::vector<uint8_t> data;
+  ReadBinaryBlob<uint8_t>(points3D_path, &data);
+  data.resize(data.size() - 1);
+  WriteBinaryBlob<uint8_t>(points3D_path, data);
+
+  Reconstruction read_reconstruction;
+  EXPECT_THROW(ReadPoints3DBinary(read_reconstruction, points3D_path),
+               std::invalid_argument);
+}
+
+}  // namespace
+}  // namespace colmap
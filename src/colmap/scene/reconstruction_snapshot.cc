@@ -0,0 +1,280 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/scene/reconstruction_snapshot.h"
+
+#include "colmap/scene/reconstruction_io.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/misc.h"
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace colmap {
+namespace {
+
+// Name of the file with the changes of an incremental snapshot.
+const char* const kDeltaFileName = "delta.bin";
+
+// Hash of a sequence of 64-bit words. Collisions are practically impossible
+// for the number of records in a reconstruction.
+class Fingerprint {
+ public:
+  void Add(const uint64_t value) {
+    hash_ = (hash_ ^ value) * 0x100000001b3ull;
+    hash_ ^= hash_ >> 29;
+  }
+
+  void Add(const double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    Add(bits);
+  }
+
+  void Add(const std::string& value) {
+    Add(static_cast<uint64_t>(value.size()));
+    for (const char c : value) {
+      Add(static_cast<uint64_t>(c));
+    }
+  }
+
+  uint64_t Hash() const { return hash_; }
+
+ private:
+  uint64_t hash_ = 0xcbf29ce484222325ull;
+};
+
+uint64_t CameraFingerprint(const struct Camera& camera) {
+  Fingerprint fingerprint;
+  fingerprint.Add(static_cast<uint64_t>(camera.model_id));
+  fingerprint.Add(static_cast<uint64_t>(camera.width));
+  fingerprint.Add(static_cast<uint64_t>(camera.height));
+  for (const double param : camera.params) {
+    fingerprint.Add(param);
+  }
+  return fingerprint.Hash();
+}
+
+uint64_t ImageFingerprint(const class Image& image) {
+  Fingerprint fingerprint;
+  const Rigid3d& cam_from_world = image.CamFromWorld();
+  for (int i = 0; i < 4; ++i) {
+    fingerprint.Add(cam_from_world.rotation.coeffs()(i));
+  }
+  for (int i = 0; i < 3; ++i) {
+    fingerprint.Add(cam_from_world.translation(i));
+  }
+  fingerprint.Add(static_cast<uint64_t>(image.CameraId()));
+  fingerprint.Add(image.Name());
+  for (const struct Point2D& point2D : image.Points2D()) {
+    fingerprint.Add(point2D.xy(0));
+    fingerprint.Add(point2D.xy(1));
+    fingerprint.Add(static_cast<uint64_t>(point2D.point3D_id));
+  }
+  return fingerprint.Hash();
+}
+
+uint64_t Point3DFingerprint(const struct Point3D& point3D) {
+  Fingerprint fingerprint;
+  for (int i = 0; i < 3; ++i) {
+    fingerprint.Add(point3D.xyz(i));
+    fingerprint.Add(static_cast<uint64_t>(point3D.color(i)));
+  }
+  fingerprint.Add(point3D.error);
+  for (const auto& track_el : point3D.track.Elements()) {
+    fingerprint.Add(static_cast<uint64_t>(track_el.image_id));
+    fingerprint.Add(static_cast<uint64_t>(track_el.point2D_idx));
+  }
+  return fingerprint.Hash();
+}
+
+// Collect the IDs of the records that are no longer in the new fingerprints.
+template <typename T>
+std::vector<T> FindDeletedIds(
+    const std::unordered_map<T, uint64_t>& prev_fingerprints,
+    const std::unordered_map<T, uint64_t>& fingerprints) {
+  std::vector<T> deleted_ids;
+  for (const auto& fingerprint : prev_fingerprints) {
+    if (fingerprints.count(fingerprint.first) == 0) {
+      deleted_ids.push_back(fingerprint.first);
+    }
+  }
+  return deleted_ids;
+}
+
+// Returns whether the record is new or its fingerprint changed.
+template <typename T>
+bool IsModified(const std::unordered_map<T, uint64_t>& prev_fingerprints,
+                const T id,
+                const uint64_t fingerprint) {
+  const auto it = prev_fingerprints.find(id);
+  return it == prev_fingerprints.end() || it->second != fingerprint;
+}
+
+std::string RemoveTrailingSlashes(std::string path) {
+  while (path.size() > 1 && (path.back() == '/' || path.back() == '\\')) {
+    path.pop_back();
+  }
+  return path;
+}
+
+}  // namespace
+
+void IncrementalSnapshotWriter::Write(const Reconstruction& reconstruction,
+                                      const std::string& path) {
+  CreateDirIfNotExists(path);
+
+  std::unordered_map<camera_t, uint64_t> camera_fingerprints;
+  camera_fingerprints.reserve(reconstruction.NumCameras());
+  std::unordered_map<image_t, uint64_t> image_fingerprints;
+  image_fingerprints.reserve(reconstruction.NumRegImages());
+  std::unordered_map<point3D_t, uint64_t> point3D_fingerprints;
+  point3D_fingerprints.reserve(reconstruction.NumPoints3D());
+
+  const bool is_full = prev_snapshot_name_.empty();
+
+  ReconstructionDelta delta;
+  delta.parent_name = prev_snapshot_name_;
+
+  for (const auto& camera : reconstruction.Cameras()) {
+    const uint64_t fingerprint = CameraFingerprint(camera.second);
+    camera_fingerprints.emplace(camera.first, fingerprint);
+    if (!is_full &&
+        IsModified(camera_fingerprints_, camera.first, fingerprint)) {
+      delta.cameras.push_back(camera.second);
+    }
+  }
+
+  for (const image_t image_id : reconstruction.RegImageIds()) {
+    const class Image& image = reconstruction.Image(image_id);
+    const uint64_t fingerprint = ImageFingerprint(image);
+    image_fingerprints.emplace(image_id, fingerprint);
+    if (!is_full && IsModified(image_fingerprints_, image_id, fingerprint)) {
+      delta.images.push_back(image);
+    }
+  }
+
+  for (const auto& point3D : reconstruction.Points3D()) {
+    const uint64_t fingerprint = Point3DFingerprint(point3D.second);
+    point3D_fingerprints.emplace(point3D.first, fingerprint);
+    if (!is_full &&
+        IsModified(point3D_fingerprints_, point3D.first, fingerprint)) {
+      delta.points3D.emplace_back(point3D.first, point3D.second);
+    }
+  }
+
+  if (is_full) {
+    reconstruction.WriteBinary(path);
+  } else {
+    delta.deleted_image_ids =
+        FindDeletedIds(image_fingerprints_, image_fingerprints);
+    delta.deleted_point3D_ids =
+        FindDeletedIds(point3D_fingerprints_, point3D_fingerprints);
+    VLOG(1) << "=> Changed " << delta.cameras.size() << " cameras, "
+            << delta.images.size() << " images, " << delta.points3D.size()
+            << " points3D, deleted " << delta.deleted_image_ids.size()
+            << " images, " << delta.deleted_point3D_ids.size() << " points3D";
+    WriteReconstructionDeltaBinary(delta, JoinPaths(path, kDeltaFileName));
+  }
+
+  prev_snapshot_name_ = GetPathBaseName(RemoveTrailingSlashes(path));
+  camera_fingerprints_ = std::move(camera_fingerprints);
+  image_fingerprints_ = std::move(image_fingerprints);
+  point3D_fingerprints_ = std::move(point3D_fingerprints);
+}
+
+bool IsIncrementalSnapshot(const std::string& path) {
+  return ExistsFile(JoinPaths(path, kDeltaFileName));
+}
+
+void MaterializeSnapshot(const std::string& path,
+                         Reconstruction* reconstruction) {
+  THROW_CHECK(reconstruction != nullptr);
+
+  // Follow the chain of parents until the last full snapshot.
+  std::vector<ReconstructionDelta> deltas;
+  std::string snapshot_path = RemoveTrailingSlashes(path);
+  while (IsIncrementalSnapshot(snapshot_path)) {
+    deltas.emplace_back();
+    ReadReconstructionDeltaBinary(JoinPaths(snapshot_path, kDeltaFileName),
+                                  &deltas.back());
+    THROW_CHECK(!deltas.back().parent_name.empty())
+        << "Invalid snapshot " << snapshot_path;
+    snapshot_path =
+        JoinPaths(GetParentDir(snapshot_path), deltas.back().parent_name);
+  }
+
+  Reconstruction base_reconstruction;
+  base_reconstruction.Read(snapshot_path);
+
+  std::unordered_map<camera_t, struct Camera> cameras =
+      base_reconstruction.Cameras();
+  std::unordered_map<image_t, class Image> images =
+      base_reconstruction.Images();
+  std::unordered_map<point3D_t, struct Point3D> points3D =
+      base_reconstruction.Points3D();
+  base_reconstruction = Reconstruction();
+
+  // Apply the changes from the oldest to the newest snapshot.
+  for (auto delta = deltas.rbegin(); delta != deltas.rend(); ++delta) {
+    for (const image_t image_id : delta->deleted_image_ids) {
+      images.erase(image_id);
+    }
+    for (const point3D_t point3D_id : delta->deleted_point3D_ids) {
+      points3D.erase(point3D_id);
+    }
+    for (struct Camera& camera : delta->cameras) {
+      const camera_t camera_id = camera.camera_id;
+      cameras[camera_id] = std::move(camera);
+    }
+    for (class Image& image : delta->images) {
+      const image_t image_id = image.ImageId();
+      images[image_id] = std::move(image);
+    }
+    for (auto& point3D : delta->points3D) {
+      points3D[point3D.first] = std::move(point3D.second);
+    }
+  }
+
+  *reconstruction = Reconstruction();
+  for (auto& camera : cameras) {
+    reconstruction->AddCamera(std::move(camera.second));
+  }
+  reconstruction->ReserveImages(images.size());
+  for (auto& image : images) {
+    reconstruction->AddImage(std::move(image.second));
+  }
+  reconstruction->ReservePoints3D(points3D.size());
+  for (auto& point3D : points3D) {
+    reconstruction->AddPoint3D(point3D.first, std::move(point3D.second));
+  }
+}
+
+}  // namespace colmap
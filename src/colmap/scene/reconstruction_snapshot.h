@@ -0,0 +1,68 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "colmap/scene/reconstruction.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace colmap {
+
+// Writes a sequence of snapshots of a changing reconstruction, e.g., during
+// incremental mapping. Only the first snapshot is a full model and every
+// following snapshot only stores the cameras, registered images, and 3D points
+// that changed since the previous snapshot, such that the cost of writing is
+// proportional to the changes and not to the size of the model. Changes are
+// detected by comparing fingerprints of the records with the ones of the
+// previous snapshot. All snapshots of a writer must be in the same folder.
+class IncrementalSnapshotWriter {
+ public:
+  // Write a snapshot of the reconstruction to the given folder.
+  void Write(const Reconstruction& reconstruction, const std::string& path);
+
+ private:
+  std::string prev_snapshot_name_;
+  std::unordered_map<camera_t, uint64_t> camera_fingerprints_;
+  std::unordered_map<image_t, uint64_t> image_fingerprints_;
+  std::unordered_map<point3D_t, uint64_t> point3D_fingerprints_;
+};
+
+// Whether the folder contains an incremental snapshot that only stores the
+// changes relative to a previous snapshot.
+bool IsIncrementalSnapshot(const std::string& path);
+
+// Read the full reconstruction at an incremental snapshot by applying the
+// changes of all snapshots since the last full snapshot.
+void MaterializeSnapshot(const std::string& path,
+                         Reconstruction* reconstruction);
+
+}  // namespace colmap
@@ -0,0 +1,141 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "colmap/scene/reconstruction_snapshot.h"
+
+#include "colmap/scene/reconstruction_io.h"
+#include "colmap/scene/synthetic.h"
+#include "colmap/util/misc.h"
+#include "colmap/util/testing.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+void ExpectEqualReconstructions(const Reconstruction& expected,
+                                const Reconstruction& actual) {
+  ASSERT_EQ(expected.NumCameras(), actual.NumCameras());
+  ASSERT_EQ(expected.NumRegImages(), actual.NumRegImages());
+  ASSERT_EQ(expected.NumPoints3D(), actual.NumPoints3D());
+  for (const auto& camera : expected.Cameras()) {
+    EXPECT_EQ(camera.second.params, actual.Camera(camera.first).params);
+  }
+  for (const image_t image_id : expected.RegImageIds()) {
+    const class Image& image = expected.Image(image_id);
+    const class Image& actual_image = actual.Image(image_id);
+    EXPECT_TRUE(actual_image.IsRegistered());
+    EXPECT_EQ(image.CamFromWorld().translation,
+              actual_image.CamFromWorld().translation);
+    ASSERT_EQ(image.NumPoints2D(), actual_image.NumPoints2D());
+    for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+         ++point2D_idx) {
+      EXPECT_EQ(image.Point2D(point2D_idx).point3D_id,
+                actual_image.Point2D(point2D_idx).point3D_id);
+    }
+  }
+  for (const auto& point3D : expected.Points3D()) {
+    const struct Point3D& actual_point3D = actual.Point3D(point3D.first);
+    EXPECT_EQ(point3D.second.xyz, actual_point3D.xyz);
+    EXPECT_EQ(point3D.second.track.Length(), actual_point3D.track.Length());
+  }
+}
+
+TEST(IncrementalSnapshotWriter, WriteAndMaterialize) {
+  Reconstruction reconstruction;
+  SyntheticDatasetOptions options;
+  options.num_cameras = 2;
+  options.num_images = 20;
+  options.num_points3D = 500;
+  SynthesizeDataset(options, &reconstruction);
+
+  const std::string test_dir = CreateTestDir();
+  IncrementalSnapshotWriter writer;
+
+  const std::string snapshot_path0 = JoinPaths(test_dir, "0");
+  writer.Write(reconstruction, snapshot_path0);
+  EXPECT_FALSE(IsIncrementalSnapshot(snapshot_path0));
+
+  // Modify a camera and a 3D point, delete a 3D point, and deregister an
+  // image, which also changes the 3D points observed by the image.
+  reconstruction.Camera(1).params[0] += 1;
+  const point3D_t modified_point3D_id =
+      reconstruction.Points3D().begin()->first;
+  reconstruction.Point3D(modified_point3D_id).xyz += Eigen::Vector3d::Ones();
+  const point3D_t deleted_point3D_id =
+      std::next(reconstruction.Points3D().begin())->first;
+  reconstruction.DeletePoint3D(deleted_point3D_id);
+  const image_t deregistered_image_id = reconstruction.RegImageIds().back();
+  reconstruction.DeRegisterImage(deregistered_image_id);
+
+  const std::string snapshot_path1 = JoinPaths(test_dir, "1");
+  writer.Write(reconstruction, snapshot_path1);
+  EXPECT_TRUE(IsIncrementalSnapshot(snapshot_path1));
+
+  ReconstructionDelta delta;
+  ReadReconstructionDeltaBinary(JoinPaths(snapshot_path1, "delta.bin"),
+                                &delta);
+  EXPECT_EQ(delta.parent_name, "0");
+  ASSERT_EQ(delta.cameras.size(), 1);
+  EXPECT_EQ(delta.cameras[0].camera_id, 1);
+  EXPECT_LT(delta.images.size(), reconstruction.NumRegImages());
+  EXPECT_LT(delta.points3D.size(), reconstruction.NumPoints3D());
+  ASSERT_EQ(delta.deleted_image_ids.size(), 1);
+  EXPECT_EQ(delta.deleted_image_ids[0], deregistered_image_id);
+  EXPECT_NE(std::find(delta.deleted_point3D_ids.begin(),
+                      delta.deleted_point3D_ids.end(),
+                      deleted_point3D_id),
+            delta.deleted_point3D_ids.end());
+
+  // An unchanged reconstruction results in an empty delta.
+  const std::string snapshot_path2 = JoinPaths(test_dir, "2");
+  writer.Write(reconstruction, snapshot_path2);
+  ReadReconstructionDeltaBinary(JoinPaths(snapshot_path2, "delta.bin"),
+                                &delta);
+  EXPECT_EQ(delta.parent_name, "1");
+  EXPECT_TRUE(delta.cameras.empty());
+  EXPECT_TRUE(delta.images.empty());
+  EXPECT_TRUE(delta.points3D.empty());
+  EXPECT_TRUE(delta.deleted_image_ids.empty());
+  EXPECT_TRUE(delta.deleted_point3D_ids.empty());
+
+  Reconstruction materialized_reconstruction;
+  MaterializeSnapshot(snapshot_path2, &materialized_reconstruction);
+  ExpectEqualReconstructions(reconstruction, materialized_reconstruction);
+
+  Reconstruction read_reconstruction;
+  read_reconstruction.Read(snapshot_path1);
+  ExpectEqualReconstructions(reconstruction, read_reconstruction);
+}
+
+}  // namespace
+}  // namespace colmap
@@ -191,6 +191,23 @@ TEST(Reconstruction, DeleteObservation) {
   EXPECT_FALSE(reconstruction.Image(point3D_id).Point2D(2).HasPoint3D());
 }
 
+TEST(Reconstruction, CompressTracks) {
+  Reconstruction reconstruction;
+  GenerateReconstruction(1, &reconstruction);
+  const point3D_t point3D_id =
+      reconstruction.AddPoint3D(Eigen::Vector3d::Random(), Track());
+  for (point2D_t point2D_idx = 0; point2D_idx < 5; ++point2D_idx) {
+    reconstruction.AddObservation(point3D_id, TrackElement(1, point2D_idx));
+  }
+  reconstruction.DeleteObservation(1, 0);
+  reconstruction.DeleteObservation(1, 1);
+  const Track& track = reconstruction.Point3D(point3D_id).track;
+  EXPECT_GT(track.Elements().capacity(), 3);
+  reconstruction.CompressTracks();
+  EXPECT_EQ(track.Length(), 3);
+  EXPECT_EQ(track.Elements().capacity(), 3);
+}
+
 TEST(Reconstruction, RegisterImage) {
   Reconstruction reconstruction;
   GenerateReconstruction(1, &reconstruction);
@@ -349,6 +366,27 @@ TEST(Reconstruction, Crop) {
   EXPECT_FALSE(recon2.IsImageRegistered(3));
 }
 
+TEST(Reconstruction, CropParallel) {
+  Reconstruction reconstruction;
+  const int kNumPoints3D = 200000;
+  for (int i = 0; i < kNumPoints3D; ++i) {
+    reconstruction.AddPoint3D(
+        Eigen::Vector3d(i % 100, (i / 100) % 100, i / 10000), Track());
+  }
+
+  const std::pair<Eigen::Vector3d, Eigen::Vector3d> bbox(
+      Eigen::Vector3d(10, 20, 5), Eigen::Vector3d(29.5, 49.5, 14.5));
+  const Reconstruction cropped_serial =
+      reconstruction.Crop(bbox, /*num_threads=*/1);
+  const Reconstruction cropped_parallel =
+      reconstruction.Crop(bbox, /*num_threads=*/4);
+  EXPECT_EQ(cropped_serial.NumPoints3D(), 20 * 30 * 10);
+  EXPECT_EQ(cropped_parallel.NumPoints3D(), cropped_serial.NumPoints3D());
+  for (const auto& point3D : cropped_parallel.Points3D()) {
+    EXPECT_EQ(point3D.second.xyz, cropped_serial.Point3D(point3D.first).xyz);
+  }
+}
+
 TEST(Reconstruction, Transform) {
   Reconstruction reconstruction;
   GenerateReconstruction(3, &reconstruction);
@@ -405,6 +443,20 @@ TEST(Reconstruction, ComputeNumObservations) {
   EXPECT_EQ(reconstruction.ComputeNumObservations(), 3);
 }
 
+TEST(Reconstruction, NumBytes) {
+  Reconstruction reconstruction;
+  EXPECT_EQ(reconstruction.NumBytes(), 0);
+  GenerateReconstruction(2, &reconstruction);
+  const size_t num_bytes_without_points3D = reconstruction.NumBytes();
+  EXPECT_GT(num_bytes_without_points3D, 0);
+  const point3D_t point3D_id =
+      reconstruction.AddPoint3D(Eigen::Vector3d::Random(), Track());
+  reconstruction.AddObservation(point3D_id, TrackElement(1, 0));
+  EXPECT_EQ(reconstruction.NumBytes(),
+            num_bytes_without_points3D + sizeof(Point3D) +
+                sizeof(TrackElement));
+}
+
 TEST(Reconstruction, ComputeMeanTrackLength) {
   Reconstruction reconstruction;
   GenerateReconstruction(2, &reconstruction);
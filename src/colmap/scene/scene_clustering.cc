@@ -31,7 +31,9 @@
 
 #include "colmap/math/graph_cut.h"
 #include "colmap/math/random.h"
+#include "colmap/util/misc.h"
 
+#include <fstream>
 #include <set>
 
 namespace colmap {
@@ -323,4 +325,119 @@ SceneClustering SceneClustering::Create(const Options& options,
   return scene_clustering;
 }
 
+void SceneClustering::Write(const std::string& path) const {
+  THROW_CHECK_NOTNULL(root_cluster_);
+
+  const std::vector<const Cluster*> leaf_clusters = GetLeafClusters();
+  std::unordered_map<const Cluster*, int> leaf_indices;
+  leaf_indices.reserve(leaf_clusters.size());
+  for (size_t i = 0; i < leaf_clusters.size(); ++i) {
+    leaf_indices.emplace(leaf_clusters[i], static_cast<int>(i));
+  }
+
+  std::ofstream file(path, std::ios::trunc);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  file << "# Scene clustering with one line per cluster in depth-first order:"
+       << '\n';
+  file << "#   CLUSTER_ID, PARENT_CLUSTER_ID, LEAF_INDEX, IMAGE_IDS[]" << '\n';
+  file << "# Number of leaf clusters: " << leaf_clusters.size() << '\n';
+
+  int num_clusters = 0;
+  std::function<void(const Cluster&, int)> WriteCluster =
+      [&](const Cluster& cluster, int parent_cluster_id) {
+        const int cluster_id = num_clusters++;
+        const auto leaf_index = leaf_indices.find(&cluster);
+        file << cluster_id << " " << parent_cluster_id << " "
+             << (leaf_index == leaf_indices.end() ? -1 : leaf_index->second);
+        for (const image_t image_id : cluster.image_ids) {
+          file << " " << image_id;
+        }
+        file << '\n';
+        for (const auto& child_cluster : cluster.child_clusters) {
+          WriteCluster(child_cluster, cluster_id);
+        }
+      };
+
+  WriteCluster(*root_cluster_, -1);
+}
+
+SceneClustering SceneClustering::Read(const std::string& path) {
+  std::ifstream file(path);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  std::vector<int> leaf_indices;
+  std::vector<std::vector<image_t>> image_ids;
+  std::vector<std::vector<int>> child_cluster_ids;
+
+  std::string line;
+  while (std::getline(file, line)) {
+    StringTrim(&line);
+
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    std::stringstream line_stream(line);
+
+    int cluster_id = -1;
+    int parent_cluster_id = -1;
+    int leaf_index = -1;
+    line_stream >> cluster_id >> parent_cluster_id >> leaf_index;
+    THROW_CHECK(!line_stream.fail()) << "Invalid cluster line: " << line;
+
+    // Clusters are written in depth-first order, so parents always precede
+    // their children.
+    THROW_CHECK_EQ(cluster_id, static_cast<int>(leaf_indices.size()));
+    if (cluster_id == 0) {
+      THROW_CHECK_EQ(parent_cluster_id, -1);
+    } else {
+      THROW_CHECK_GE(parent_cluster_id, 0);
+      THROW_CHECK_LT(parent_cluster_id, cluster_id);
+      child_cluster_ids[parent_cluster_id].push_back(cluster_id);
+    }
+
+    leaf_indices.push_back(leaf_index);
+    image_ids.emplace_back();
+    child_cluster_ids.emplace_back();
+
+    image_t image_id;
+    while (line_stream >> image_id) {
+      image_ids.back().push_back(image_id);
+    }
+    THROW_CHECK(line_stream.eof()) << "Invalid cluster line: " << line;
+  }
+
+  THROW_CHECK(!leaf_indices.empty()) << "No clusters in " << path;
+
+  std::vector<const Cluster*> clusters(leaf_indices.size());
+  std::function<void(int, Cluster*)> ReadCluster = [&](int cluster_id,
+                                                       Cluster* cluster) {
+    clusters[cluster_id] = cluster;
+    cluster->image_ids = std::move(image_ids[cluster_id]);
+    cluster->child_clusters.resize(child_cluster_ids[cluster_id].size());
+    for (size_t i = 0; i < child_cluster_ids[cluster_id].size(); ++i) {
+      ReadCluster(child_cluster_ids[cluster_id][i],
+                  &cluster->child_clusters[i]);
+    }
+  };
+
+  SceneClustering scene_clustering((Options()));
+  scene_clustering.root_cluster_ = std::make_unique<Cluster>();
+  ReadCluster(0, scene_clustering.root_cluster_.get());
+
+  // Verify that the leaf clusters are enumerated in the written order.
+  const std::vector<const Cluster*> leaf_clusters =
+      scene_clustering.GetLeafClusters();
+  for (size_t i = 0; i < clusters.size(); ++i) {
+    if (leaf_indices[i] >= 0) {
+      THROW_CHECK_LT(leaf_indices[i], static_cast<int>(leaf_clusters.size()));
+      THROW_CHECK_EQ(leaf_clusters[leaf_indices[i]], clusters[i])
+          << "Inconsistent leaf index of cluster " << i;
+    }
+  }
+
+  return scene_clustering;
+}
+
 }  // namespace colmap
@@ -33,6 +33,7 @@
 #include "colmap/util/types.h"
 
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace colmap {
@@ -80,6 +81,13 @@ class SceneClustering {
   static SceneClustering Create(const Options& options,
                                 const Database& database);
 
+  // Write/read the cluster hierarchy as a text manifest with one line per
+  // cluster in depth-first order. The leaf clusters of a read manifest are
+  // returned by GetLeafClusters in the same order as in the written one, such
+  // that leaf clusters can be referred to by their index across processes.
+  void Write(const std::string& path) const;
+  static SceneClustering Read(const std::string& path);
+
  private:
   void PartitionHierarchicalCluster(
       const std::vector<std::pair<int, int>>& edges,
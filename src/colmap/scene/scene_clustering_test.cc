@@ -30,6 +30,7 @@
 #include "colmap/scene/scene_clustering.h"
 
 #include "colmap/scene/database.h"
+#include "colmap/util/testing.h"
 
 #include <set>
 
@@ -158,5 +159,63 @@ TEST(SceneClustering, ThreeFlatClustersTwoOverlap) {
   EXPECT_TRUE(image_ids2.count(5));
 }
 
+TEST(SceneClustering, WriteRead) {
+  const std::vector<std::pair<image_t, image_t>> image_pairs = {
+      {0, 1}, {2, 3}, {4, 5}, {6, 7}, {1, 2}, {5, 6}, {3, 4}};
+  const std::vector<int> num_inliers = {100, 100, 100, 100, 50, 50, 1};
+  SceneClustering::Options options;
+  options.branching = 2;
+  options.image_overlap = 1;
+  options.leaf_max_num_images = 2;
+  SceneClustering scene_clustering(options);
+  scene_clustering.Partition(image_pairs, num_inliers);
+  const auto leaf_clusters = scene_clustering.GetLeafClusters();
+  EXPECT_GT(leaf_clusters.size(), 2);
+
+  const std::string path = CreateTestDir() + "/clusters.txt";
+  scene_clustering.Write(path);
+  const SceneClustering read_scene_clustering = SceneClustering::Read(path);
+
+  std::function<void(const SceneClustering::Cluster&,
+                     const SceneClustering::Cluster&)>
+      ExpectEqualClusters = [&](const SceneClustering::Cluster& cluster1,
+                                const SceneClustering::Cluster& cluster2) {
+        EXPECT_EQ(cluster1.image_ids, cluster2.image_ids);
+        ASSERT_EQ(cluster1.child_clusters.size(),
+                  cluster2.child_clusters.size());
+        for (size_t i = 0; i < cluster1.child_clusters.size(); ++i) {
+          ExpectEqualClusters(cluster1.child_clusters[i],
+                              cluster2.child_clusters[i]);
+        }
+      };
+  ExpectEqualClusters(*scene_clustering.GetRootCluster(),
+                      *read_scene_clustering.GetRootCluster());
+
+  const auto read_leaf_clusters = read_scene_clustering.GetLeafClusters();
+  ASSERT_EQ(read_leaf_clusters.size(), leaf_clusters.size());
+  for (size_t i = 0; i < leaf_clusters.size(); ++i) {
+    EXPECT_EQ(read_leaf_clusters[i]->image_ids, leaf_clusters[i]->image_ids);
+  }
+}
+
+TEST(SceneClustering, WriteReadSingleCluster) {
+  const std::vector<std::pair<image_t, image_t>> image_pairs = {{0, 1}};
+  const std::vector<int> num_inliers = {10};
+  SceneClustering::Options options;
+  options.leaf_max_num_images = 2;
+  SceneClustering scene_clustering(options);
+  scene_clustering.Partition(image_pairs, num_inliers);
+
+  const std::string path = CreateTestDir() + "/clusters.txt";
+  scene_clustering.Write(path);
+  const SceneClustering read_scene_clustering = SceneClustering::Read(path);
+  EXPECT_EQ(read_scene_clustering.GetRootCluster()->image_ids,
+            std::vector<image_t>({0, 1}));
+  EXPECT_TRUE(read_scene_clustering.GetRootCluster()->child_clusters.empty());
+  ASSERT_EQ(read_scene_clustering.GetLeafClusters().size(), 1);
+  EXPECT_EQ(read_scene_clustering.GetLeafClusters()[0],
+            read_scene_clustering.GetRootCluster());
+}
+
 }  // namespace
 }  // namespace colmap
@@ -34,74 +34,106 @@
 
 namespace colmap {
 
+namespace {
+
+// Spread the bits of the value to the even bits of the result.
+uint64_t SpreadBits(const uint32_t value) {
+  uint64_t bits = value;
+  bits = (bits | (bits << 16)) & 0x0000FFFF0000FFFFull;
+  bits = (bits | (bits << 8)) & 0x00FF00FF00FF00FFull;
+  bits = (bits | (bits << 4)) & 0x0F0F0F0F0F0F0F0Full;
+  bits = (bits | (bits << 2)) & 0x3333333333333333ull;
+  bits = (bits | (bits << 1)) & 0x5555555555555555ull;
+  return bits;
+}
+
+}  // namespace
+
 VisibilityPyramid::VisibilityPyramid() : VisibilityPyramid(0, 0, 0) {}
 
 VisibilityPyramid::VisibilityPyramid(const size_t num_levels,
                                      const size_t width,
                                      const size_t height)
-    : width_(width), height_(height), score_(0), max_score_(0) {
-  pyramid_.resize(num_levels);
+    : num_levels_(num_levels),
+      width_(width),
+      height_(height),
+      score_(0),
+      max_score_(0) {
+  // The cell coordinates of the finest level are interleaved into 64 bits.
+  THROW_CHECK_LE(num_levels, 16);
+  if (num_levels == 0) {
+    return;
+  }
   for (size_t level = 0; level < num_levels; ++level) {
-    const size_t level_plus_one = level + 1;
-    const int dim = 1 << level_plus_one;
-    pyramid_[level].setZero(dim, dim);
-    max_score_ += dim * dim * dim * dim;
+    max_score_ += LevelScore(level) * LevelScore(level);
+  }
+  counts_.resize(LevelScore(num_levels - 1), 0);
+  populated_.resize(num_levels - 1);
+  for (size_t level = 0; level + 1 < num_levels; ++level) {
+    populated_[level].resize((LevelScore(level) + 63) / 64, 0);
   }
 }
 
 void VisibilityPyramid::SetPoint(const double x, const double y) {
-  THROW_CHECK_GT(pyramid_.size(), 0);
+  THROW_CHECK_GT(num_levels_, 0);
 
-  size_t cx = 0;
-  size_t cy = 0;
-  CellForPoint(x, y, &cx, &cy);
-
-  for (int i = static_cast<int>(pyramid_.size() - 1); i >= 0; --i) {
-    auto& level = pyramid_[i];
-
-    level(cy, cx) += 1;
-    if (level(cy, cx) == 1) {
-      score_ += level.size();
+  size_t cell_idx = CellIndexForPoint(x, y);
+  if (counts_[cell_idx]++ > 0) {
+    return;
+  }
+  score_ += LevelScore(num_levels_ - 1);
+
+  // Populate the coarser cells until reaching an already populated cell.
+  for (size_t level = num_levels_ - 1; level-- > 0;) {
+    cell_idx >>= 2;
+    uint64_t& bits = populated_[level][cell_idx / 64];
+    const uint64_t mask = uint64_t(1) << (cell_idx % 64);
+    if (bits & mask) {
+      break;
     }
-
-    cx = cx >> 1;
-    cy = cy >> 1;
+    bits |= mask;
+    score_ += LevelScore(level);
   }
 
   THROW_CHECK_LE(score_, max_score_);
 }
 
 void VisibilityPyramid::ResetPoint(const double x, const double y) {
-  THROW_CHECK_GT(pyramid_.size(), 0);
+  THROW_CHECK_GT(num_levels_, 0);
 
-  size_t cx = 0;
-  size_t cy = 0;
-  CellForPoint(x, y, &cx, &cy);
-
-  for (int i = static_cast<int>(pyramid_.size() - 1); i >= 0; --i) {
-    auto& level = pyramid_[i];
-
-    level(cy, cx) -= 1;
-    if (level(cy, cx) == 0) {
-      score_ -= level.size();
-    }
-
-    cx = cx >> 1;
-    cy = cy >> 1;
+  size_t cell_idx = CellIndexForPoint(x, y);
+  THROW_CHECK_GT(counts_[cell_idx], 0);
+  if (--counts_[cell_idx] > 0) {
+    return;
+  }
+  score_ -= LevelScore(num_levels_ - 1);
+
+  // Empty the coarser cells until reaching a cell with populated children.
+  // The four children of a cell are consecutive and aligned to four cells,
+  // so their populated bits never straddle two words.
+  const size_t first_child_idx = cell_idx & ~size_t(3);
+  bool has_populated_child = false;
+  for (size_t i = 0; i < 4; ++i) {
+    has_populated_child |= counts_[first_child_idx + i] > 0;
+  }
+  for (size_t level = num_levels_ - 1; level-- > 0 && !has_populated_child;) {
+    cell_idx >>= 2;
+    uint64_t& bits = populated_[level][cell_idx / 64];
+    bits &= ~(uint64_t(1) << (cell_idx % 64));
+    score_ -= LevelScore(level);
+    has_populated_child = (bits >> ((cell_idx % 64) & ~size_t(3))) & 0xF;
   }
-
-  THROW_CHECK_LE(score_, max_score_);
 }
 
-void VisibilityPyramid::CellForPoint(const double x,
-                                     const double y,
-                                     size_t* cx,
-                                     size_t* cy) const {
+size_t VisibilityPyramid::CellIndexForPoint(const double x,
+                                            const double y) const {
   THROW_CHECK_GT(width_, 0);
   THROW_CHECK_GT(height_, 0);
-  const int max_dim = 1 << pyramid_.size();
-  *cx = Clamp<size_t>(max_dim * x / width_, 0, max_dim - 1);
-  *cy = Clamp<size_t>(max_dim * y / height_, 0, max_dim - 1);
+  const int max_dim = 1 << num_levels_;
+  const size_t cx = Clamp<size_t>(max_dim * x / width_, 0, max_dim - 1);
+  const size_t cy = Clamp<size_t>(max_dim * y / height_, 0, max_dim - 1);
+  return SpreadBits(static_cast<uint32_t>(cx)) |
+         (SpreadBits(static_cast<uint32_t>(cy)) << 1);
 }
 
 }  // namespace colmap
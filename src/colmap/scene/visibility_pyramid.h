@@ -29,12 +29,10 @@
 
 #pragma once
 
-#include "colmap/util/eigen_alignment.h"
-
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
-#include <Eigen/Core>
-
 namespace colmap {
 
 // A class that captures the distribution of points in a 2D grid.
@@ -64,7 +62,15 @@ class VisibilityPyramid {
   inline size_t MaxScore() const;
 
  private:
-  void CellForPoint(double x, double y, size_t* cx, size_t* cy) const;
+  // Index of the cell in the finest level in Morton (Z) order, such that the
+  // four children of a cell are consecutive and the index of the parent cell
+  // follows by dropping the last two bits.
+  size_t CellIndexForPoint(double x, double y) const;
+
+  // The score of a populated cell in the given level.
+  inline size_t LevelScore(size_t level) const;
+
+  size_t num_levels_;
 
   // Range of the input points.
   size_t width_;
@@ -76,15 +82,21 @@ class VisibilityPyramid {
   // The maximum score when all cells are populated.
   size_t max_score_;
 
-  // The visibilty pyramid with multiple levels.
-  std::vector<Eigen::MatrixXi> pyramid_;
+  // The number of points in each cell of the finest level.
+  std::vector<uint32_t> counts_;
+
+  // Whether the cells of the coarser levels are populated, packed into one
+  // bit per cell and starting with the coarsest level. A coarser cell is only
+  // updated when the first child is populated or the last child is emptied,
+  // so most updates only touch the finest level.
+  std::vector<std::vector<uint64_t>> populated_;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
 
-size_t VisibilityPyramid::NumLevels() const { return pyramid_.size(); }
+size_t VisibilityPyramid::NumLevels() const { return num_levels_; }
 
 size_t VisibilityPyramid::Width() const { return width_; }
 
@@ -94,4 +106,9 @@ size_t VisibilityPyramid::Score() const { return score_; }
 
 size_t VisibilityPyramid::MaxScore() const { return max_score_; }
 
+size_t VisibilityPyramid::LevelScore(const size_t level) const {
+  // The number of cells in the level.
+  return size_t(1) << (2 * (level + 1));
+}
+
 }  // namespace colmap
@@ -29,6 +29,9 @@
 
 #include "colmap/scene/visibility_pyramid.h"
 
+#include <random>
+
+#include <Eigen/Core>
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -87,5 +90,56 @@ TEST(VisibilityPyramid, Score) {
   }
 }
 
+TEST(VisibilityPyramid, ScoreMatchesPopulatedCells) {
+  const int kNumLevels = 4;
+  const double kWidth = 100;
+  const double kHeight = 50;
+  VisibilityPyramid pyramid(kNumLevels, kWidth, kHeight);
+
+  // Reference pyramid with the number of points in every cell of all levels.
+  std::vector<Eigen::MatrixXi> levels(kNumLevels);
+  for (int level = 0; level < kNumLevels; ++level) {
+    levels[level].setZero(2 << level, 2 << level);
+  }
+  auto ComputeScore = [&levels]() {
+    size_t score = 0;
+    for (const auto& level : levels) {
+      score += (level.array() > 0).count() * level.size();
+    }
+    return score;
+  };
+  auto UpdateLevels = [&](double x, double y, int delta) {
+    for (int level = 0; level < kNumLevels; ++level) {
+      const int dim = 2 << level;
+      const int cx = std::min(static_cast<int>(dim * x / kWidth), dim - 1);
+      const int cy = std::min(static_cast<int>(dim * y / kHeight), dim - 1);
+      levels[level](cy, cx) += delta;
+    }
+  };
+
+  std::mt19937 prng(0);
+  std::uniform_real_distribution<double> x_distribution(0, kWidth);
+  std::uniform_real_distribution<double> y_distribution(0, kHeight);
+  std::vector<std::pair<double, double>> points;
+  for (int i = 0; i < 1000; ++i) {
+    if (points.empty() || prng() % 3 != 0) {
+      points.emplace_back(x_distribution(prng), y_distribution(prng));
+      pyramid.SetPoint(points.back().first, points.back().second);
+      UpdateLevels(points.back().first, points.back().second, 1);
+    } else {
+      const size_t idx = prng() % points.size();
+      pyramid.ResetPoint(points[idx].first, points[idx].second);
+      UpdateLevels(points[idx].first, points[idx].second, -1);
+      points.erase(points.begin() + idx);
+    }
+    ASSERT_EQ(pyramid.Score(), ComputeScore());
+  }
+
+  for (const auto& point : points) {
+    pyramid.ResetPoint(point.first, point.second);
+  }
+  EXPECT_EQ(pyramid.Score(), 0);
+}
+
 }  // namespace
 }  // namespace colmap
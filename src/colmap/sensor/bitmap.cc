@@ -284,6 +284,25 @@ const uint8_t* Bitmap::GetScanline(const int y) const {
   return FreeImage_GetScanLine(handle_.ptr, height_ - 1 - y);
 }
 
+uint8_t* Bitmap::GetScanline(const int y) {
+  THROW_CHECK_GE(y, 0);
+  THROW_CHECK_LT(y, height_);
+  return FreeImage_GetScanLine(handle_.ptr, height_ - 1 - y);
+}
+
+BitmapView Bitmap::View() const {
+  BitmapView view;
+  if (handle_.ptr == nullptr) {
+    return view;
+  }
+  view.data = FreeImage_GetScanLine(handle_.ptr, height_ - 1);
+  view.width = width_;
+  view.height = height_;
+  view.channels = channels_;
+  view.stride = -static_cast<std::ptrdiff_t>(Pitch());
+  return view;
+}
+
 void Bitmap::Fill(const BitmapColor<uint8_t>& color) {
   for (int y = 0; y < height_; ++y) {
     uint8_t* line = FreeImage_GetScanLine(handle_.ptr, height_ - 1 - y);
@@ -558,7 +577,9 @@ bool Bitmap::ExifAltitude(double* altitude) const {
   return false;
 }
 
-bool Bitmap::Read(const std::string& path, const bool as_rgb) {
+bool Bitmap::Read(const std::string& path,
+                  const bool as_rgb,
+                  const int min_size) {
   if (!ExistsFile(path)) {
     return false;
   }
@@ -569,7 +590,15 @@ bool Bitmap::Read(const std::string& path, const bool as_rgb) {
     return false;
   }
 
-  handle_ = FreeImageHandle(FreeImage_Load(format, path.c_str()));
+  int flags = 0;
+  if (format == FIF_JPEG && min_size > 0) {
+    // The upper 16 bits of the flags specify the requested size, from which
+    // the decoder selects the largest DCT scaling that retains this size.
+    const int kMaxRequestedSize = 0x7FFF;
+    flags = JPEG_DEFAULT | (std::min(min_size, kMaxRequestedSize) << 16);
+  }
+
+  handle_ = FreeImageHandle(FreeImage_Load(format, path.c_str(), flags));
   if (handle_.ptr == nullptr) {
     return false;
   }
@@ -594,6 +623,59 @@ bool Bitmap::Read(const std::string& path, const bool as_rgb) {
   return true;
 }
 
+bool Bitmap::ReadDimensions(const std::string& path,
+                            int* width,
+                            int* height) {
+  THROW_CHECK_NOTNULL(width);
+  THROW_CHECK_NOTNULL(height);
+
+  if (!ExistsFile(path)) {
+    return false;
+  }
+
+  const FREE_IMAGE_FORMAT format = FreeImage_GetFileType(path.c_str(), 0);
+  if (format == FIF_UNKNOWN || !FreeImage_FIFSupportsNoPixels(format)) {
+    return false;
+  }
+
+  const FreeImageHandle handle(
+      FreeImage_Load(format, path.c_str(), FIF_LOAD_NOPIXELS));
+  if (handle.ptr == nullptr) {
+    return false;
+  }
+
+  *width = static_cast<int>(FreeImage_GetWidth(handle.ptr));
+  *height = static_cast<int>(FreeImage_GetHeight(handle.ptr));
+
+  return true;
+}
+
+bool Bitmap::ReadHeader(const std::string& path) {
+  Deallocate();
+
+  if (!ExistsFile(path)) {
+    return false;
+  }
+
+  const FREE_IMAGE_FORMAT format = FreeImage_GetFileType(path.c_str(), 0);
+  if (format == FIF_UNKNOWN || !FreeImage_FIFSupportsNoPixels(format)) {
+    return false;
+  }
+
+  handle_ =
+      FreeImageHandle(FreeImage_Load(format, path.c_str(), FIF_LOAD_NOPIXELS));
+  if (handle_.ptr == nullptr) {
+    return false;
+  }
+
+  width_ = FreeImage_GetWidth(handle_.ptr);
+  height_ = FreeImage_GetHeight(handle_.ptr);
+  // There are no pixels in any of the channels.
+  channels_ = 0;
+
+  return true;
+}
+
 bool Bitmap::Write(const std::string& path, const int flags) const {
   FREE_IMAGE_FORMAT save_format = FreeImage_GetFIFFromFilename(path.c_str());
   if (save_format == FIF_UNKNOWN) {
@@ -669,6 +751,19 @@ void Bitmap::Rescale(const int new_width,
   SetPtr(FreeImage_Rescale(handle_.ptr, new_width, new_height, fi_filter));
 }
 
+Bitmap Bitmap::Crop(const int x,
+                    const int y,
+                    const int width,
+                    const int height) const {
+  THROW_CHECK_GE(x, 0);
+  THROW_CHECK_GE(y, 0);
+  THROW_CHECK_GT(width, 0);
+  THROW_CHECK_GT(height, 0);
+  THROW_CHECK_LE(x + width, width_);
+  THROW_CHECK_LE(y + height, height_);
+  return Bitmap(FreeImage_Copy(handle_.ptr, x, y, x + width, y + height));
+}
+
 Bitmap Bitmap::Clone() const {
   FIBITMAP* cloned = FreeImage_Clone(handle_.ptr);
   return Bitmap(cloned);
@@ -33,6 +33,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <ios>
 #include <limits>
@@ -65,6 +66,23 @@ struct BitmapColor {
   T b;
 };
 
+// Non-owning view of the pixel data of an image. The rows are ordered from
+// top to bottom, where consecutive rows are stride bytes apart. Note that the
+// stride may be negative, e.g., for the bottom-up scanlines of FreeImage. The
+// channels of a pixel are interleaved in the memory order of FreeImage, i.e.,
+// BGR on little-endian machines. The view is only valid as long as the
+// underlying image is neither modified nor destroyed.
+struct BitmapView {
+  const uint8_t* data = nullptr;
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  std::ptrdiff_t stride = 0;
+
+  // Get pointer to y-th row, where the 0-th row is at the top.
+  inline const uint8_t* Row(int y) const;
+};
+
 // Wrapper class around FreeImage bitmaps.
 class Bitmap {
  public:
@@ -129,6 +147,10 @@ class Bitmap {
 
   // Get pointer to y-th scanline, where the 0-th scanline is at the top.
   const uint8_t* GetScanline(int y) const;
+  uint8_t* GetScanline(int y);
+
+  // Get view of the pixel data without copying it.
+  BitmapView View() const;
 
   // Fill entire bitmap with uniform color. For grayscale images, the first
   // element of the vector is used.
@@ -148,8 +170,22 @@ class Bitmap {
   bool ExifLongitude(double* longitude) const;
   bool ExifAltitude(double* altitude) const;
 
-  // Read bitmap at given path and convert to grey- or colorscale.
-  bool Read(const std::string& path, bool as_rgb = true);
+  // Read bitmap at given path and convert to grey- or colorscale. If min_size
+  // is positive, JPEG images are decoded at 1/2, 1/4, or 1/8 of their original
+  // resolution using the DCT scaling of the decoder, such that the larger
+  // dimension is still at least min_size. Other formats are always read at
+  // their original resolution.
+  bool Read(const std::string& path, bool as_rgb = true, int min_size = 0);
+
+  // Read the original dimensions of the image at given path without decoding
+  // its pixel data. Returns false if the format does not support this.
+  static bool ReadDimensions(const std::string& path, int* width, int* height);
+
+  // Read the dimensions and metadata of the image at given path without
+  // decoding its pixel data, such that the EXIF functions can be used but the
+  // pixels cannot be accessed. Returns false if the format does not support
+  // this, in which case the image must be read with `Read`.
+  bool ReadHeader(const std::string& path);
 
   // Write image to file. Flags can be used to set e.g. the JPEG quality.
   // Consult the FreeImage documentation for all available flags.
@@ -167,6 +203,10 @@ class Bitmap {
                int new_height,
                RescaleFilter filter = RescaleFilter::kBilinear);
 
+  // Crop the given region of the image to a new bitmap object, where (x, y)
+  // is the top-left corner of the region.
+  Bitmap Crop(int x, int y, int width, int height) const;
+
   // Clone the image to a new bitmap object.
   Bitmap Clone() const;
   Bitmap CloneAsGrey() const;
@@ -262,6 +302,10 @@ std::ostream& operator<<(std::ostream& output, const BitmapColor<T>& color) {
   return output;
 }
 
+const uint8_t* BitmapView::Row(const int y) const {
+  return data + y * stride;
+}
+
 FIBITMAP* Bitmap::Data() { return handle_.ptr; }
 const FIBITMAP* Bitmap::Data() const { return handle_.ptr; }
 
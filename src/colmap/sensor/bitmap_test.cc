@@ -336,6 +336,50 @@ TEST(Bitmap, GetScanlineGrey) {
   }
 }
 
+TEST(Bitmap, ViewRGB) {
+  Bitmap bitmap;
+  bitmap.Allocate(3, 2, true);
+  bitmap.SetPixel(0, 0, BitmapColor<uint8_t>(1, 2, 3));
+  bitmap.SetPixel(2, 1, BitmapColor<uint8_t>(4, 5, 6));
+  const BitmapView view = bitmap.View();
+  EXPECT_EQ(view.width, 3);
+  EXPECT_EQ(view.height, 2);
+  EXPECT_EQ(view.channels, 3);
+  for (int y = 0; y < view.height; ++y) {
+    EXPECT_EQ(view.Row(y), bitmap.GetScanline(y));
+  }
+  EXPECT_EQ(view.Row(0)[FI_RGBA_RED], 1);
+  EXPECT_EQ(view.Row(0)[FI_RGBA_GREEN], 2);
+  EXPECT_EQ(view.Row(0)[FI_RGBA_BLUE], 3);
+  EXPECT_EQ(view.Row(1)[2 * 3 + FI_RGBA_RED], 4);
+  EXPECT_EQ(view.Row(1)[2 * 3 + FI_RGBA_GREEN], 5);
+  EXPECT_EQ(view.Row(1)[2 * 3 + FI_RGBA_BLUE], 6);
+}
+
+TEST(Bitmap, ViewGrey) {
+  Bitmap bitmap;
+  bitmap.Allocate(2, 2, false);
+  bitmap.SetPixel(0, 0, BitmapColor<uint8_t>(0));
+  bitmap.SetPixel(1, 0, BitmapColor<uint8_t>(1));
+  bitmap.SetPixel(0, 1, BitmapColor<uint8_t>(2));
+  bitmap.SetPixel(1, 1, BitmapColor<uint8_t>(3));
+  const BitmapView view = bitmap.View();
+  EXPECT_EQ(view.channels, 1);
+  EXPECT_EQ(std::abs(view.stride),
+            static_cast<std::ptrdiff_t>(bitmap.Pitch()));
+  EXPECT_EQ(view.Row(0)[0], 0);
+  EXPECT_EQ(view.Row(0)[1], 1);
+  EXPECT_EQ(view.Row(1)[0], 2);
+  EXPECT_EQ(view.Row(1)[1], 3);
+}
+
+TEST(Bitmap, ViewEmpty) {
+  const BitmapView view = Bitmap().View();
+  EXPECT_EQ(view.data, nullptr);
+  EXPECT_EQ(view.width, 0);
+  EXPECT_EQ(view.height, 0);
+}
+
 TEST(Bitmap, Fill) {
   Bitmap bitmap;
   bitmap.Allocate(100, 100, true);
@@ -447,6 +491,28 @@ TEST(Bitmap, RescaleGrey) {
   EXPECT_EQ(bitmap2.Channels(), 1);
 }
 
+TEST(Bitmap, Crop) {
+  Bitmap bitmap;
+  bitmap.Allocate(4, 3, false);
+  for (int y = 0; y < bitmap.Height(); ++y) {
+    for (int x = 0; x < bitmap.Width(); ++x) {
+      bitmap.SetPixel(x, y, BitmapColor<uint8_t>(x + 10 * y));
+    }
+  }
+
+  const Bitmap cropped_bitmap = bitmap.Crop(1, 1, 2, 2);
+  EXPECT_EQ(cropped_bitmap.Width(), 2);
+  EXPECT_EQ(cropped_bitmap.Height(), 2);
+  EXPECT_TRUE(cropped_bitmap.IsGrey());
+  BitmapColor<uint8_t> color;
+  for (int y = 0; y < cropped_bitmap.Height(); ++y) {
+    for (int x = 0; x < cropped_bitmap.Width(); ++x) {
+      EXPECT_TRUE(cropped_bitmap.GetPixel(x, y, &color));
+      EXPECT_EQ(color.r, x + 1 + 10 * (y + 1));
+    }
+  }
+}
+
 TEST(Bitmap, Clone) {
   Bitmap bitmap;
   bitmap.Allocate(100, 100, true);
@@ -551,5 +617,74 @@ TEST(Bitmap, ReadWriteAsGrey) {
             bitmap.ConvertToRowMajorArray());
 }
 
+TEST(Bitmap, ReadDownscaled) {
+  Bitmap bitmap;
+  bitmap.Allocate(64, 32, false);
+  bitmap.Fill(BitmapColor<uint8_t>(128));
+
+  const std::string test_dir = CreateTestDir();
+  const std::string jpeg_filename = test_dir + "/bitmap.jpg";
+  const std::string png_filename = test_dir + "/bitmap.png";
+
+  EXPECT_TRUE(bitmap.Write(jpeg_filename));
+  EXPECT_TRUE(bitmap.Write(png_filename));
+
+  Bitmap read_bitmap;
+  EXPECT_TRUE(read_bitmap.Read(jpeg_filename, /*as_rgb=*/false));
+  EXPECT_EQ(read_bitmap.Width(), 64);
+  EXPECT_EQ(read_bitmap.Height(), 32);
+
+  EXPECT_TRUE(
+      read_bitmap.Read(jpeg_filename, /*as_rgb=*/false, /*min_size=*/16));
+  EXPECT_EQ(read_bitmap.Width(), 16);
+  EXPECT_EQ(read_bitmap.Height(), 8);
+
+  EXPECT_TRUE(
+      read_bitmap.Read(jpeg_filename, /*as_rgb=*/false, /*min_size=*/20));
+  EXPECT_EQ(read_bitmap.Width(), 32);
+  EXPECT_EQ(read_bitmap.Height(), 16);
+
+  EXPECT_TRUE(
+      read_bitmap.Read(jpeg_filename, /*as_rgb=*/false, /*min_size=*/64));
+  EXPECT_EQ(read_bitmap.Width(), 64);
+  EXPECT_EQ(read_bitmap.Height(), 32);
+
+  EXPECT_TRUE(
+      read_bitmap.Read(png_filename, /*as_rgb=*/false, /*min_size=*/16));
+  EXPECT_EQ(read_bitmap.Width(), 64);
+  EXPECT_EQ(read_bitmap.Height(), 32);
+
+  int width = 0;
+  int height = 0;
+  EXPECT_TRUE(Bitmap::ReadDimensions(jpeg_filename, &width, &height));
+  EXPECT_EQ(width, 64);
+  EXPECT_EQ(height, 32);
+  EXPECT_FALSE(
+      Bitmap::ReadDimensions(test_dir + "/missing.jpg", &width, &height));
+}
+
+TEST(Bitmap, ReadHeader) {
+  Bitmap bitmap;
+  bitmap.Allocate(64, 32, false);
+  bitmap.Fill(BitmapColor<uint8_t>(128));
+
+  const std::string test_dir = CreateTestDir();
+  const std::string filename = test_dir + "/bitmap.jpg";
+  EXPECT_TRUE(bitmap.Write(filename));
+
+  Bitmap read_bitmap;
+  read_bitmap.Allocate(16, 16, true);
+  EXPECT_TRUE(read_bitmap.ReadHeader(filename));
+  EXPECT_EQ(read_bitmap.Width(), 64);
+  EXPECT_EQ(read_bitmap.Height(), 32);
+  EXPECT_EQ(read_bitmap.Channels(), 0);
+  double focal_length = 0;
+  EXPECT_FALSE(read_bitmap.ExifFocalLength(&focal_length));
+
+  EXPECT_FALSE(read_bitmap.ReadHeader(test_dir + "/missing.jpg"));
+  EXPECT_EQ(read_bitmap.Width(), 0);
+  EXPECT_EQ(read_bitmap.Height(), 0);
+}
+
 }  // namespace
 }  // namespace colmap
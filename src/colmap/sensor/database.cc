@@ -29,41 +29,40 @@
 
 #include "colmap/sensor/database.h"
 
+#include "colmap/util/cache.h"
 #include "colmap/util/string.h"
 
 namespace colmap {
+namespace {
 
-const camera_specs_t CameraDatabase::specs_ = InitializeCameraSpecs();
-
-bool CameraDatabase::QuerySensorWidth(const std::string& make,
-                                      const std::string& model,
-                                      double* sensor_width) {
-  // Clean the strings from all separators.
-  std::string cleaned_make = make;
-  std::string cleaned_model = model;
-  cleaned_make = StringReplace(cleaned_make, " ", "");
-  cleaned_model = StringReplace(cleaned_model, " ", "");
-  cleaned_make = StringReplace(cleaned_make, "-", "");
-  cleaned_model = StringReplace(cleaned_model, "-", "");
-  StringToLower(&cleaned_make);
-  StringToLower(&cleaned_model);
-
-  // Make sure that make name is not duplicated.
-  cleaned_model = StringReplace(cleaned_model, cleaned_make, "");
+struct QueryResult {
+  // Whether the sensor width was uniquely determined.
+  bool is_unique = false;
+  // Whether any entry matched, in which case the sensor width of the last
+  // matching entry is returned also for ambiguous matches.
+  bool has_match = false;
+  double sensor_width = 0;
+};
 
+QueryResult ScanSpecs(const camera_specs_t& specs,
+                      const std::string& cleaned_make,
+                      const std::string& cleaned_model) {
   // Check if cleaned_make exists in database: Test whether EXIF string is
   // substring of database entry and vice versa.
+  QueryResult result;
   size_t spec_matches = 0;
-  for (const auto& make_elem : specs_) {
+  for (const auto& make_elem : specs) {
     if (StringContains(cleaned_make, make_elem.first) ||
         StringContains(make_elem.first, cleaned_make)) {
       for (const auto& model_elem : make_elem.second) {
         if (StringContains(cleaned_model, model_elem.first) ||
             StringContains(model_elem.first, cleaned_model)) {
-          *sensor_width = model_elem.second;
+          result.has_match = true;
+          result.sensor_width = model_elem.second;
           if (cleaned_model == model_elem.first) {
             // Model exactly matches, return immediately.
-            return true;
+            result.is_unique = true;
+            return result;
           }
           spec_matches += 1;
           if (spec_matches > 1) {
@@ -75,7 +74,46 @@ bool CameraDatabase::QuerySensorWidth(const std::string& make,
   }
 
   // Only return unique results, if model does not exactly match.
-  return spec_matches == 1;
+  result.is_unique = spec_matches == 1;
+  return result;
+}
+
+}  // namespace
+
+const camera_specs_t CameraDatabase::specs_ = InitializeCameraSpecs();
+
+bool CameraDatabase::QuerySensorWidth(const std::string& make,
+                                      const std::string& model,
+                                      double* sensor_width) {
+  // Clean the strings from all separators.
+  std::string cleaned_make = make;
+  std::string cleaned_model = model;
+  cleaned_make = StringReplace(cleaned_make, " ", "");
+  cleaned_model = StringReplace(cleaned_model, " ", "");
+  cleaned_make = StringReplace(cleaned_make, "-", "");
+  cleaned_model = StringReplace(cleaned_model, "-", "");
+  StringToLower(&cleaned_make);
+  StringToLower(&cleaned_model);
+
+  // Make sure that make name is not duplicated.
+  cleaned_model = StringReplace(cleaned_model, cleaned_make, "");
+
+  const std::string make_and_model = cleaned_make + "\n" + cleaned_model;
+
+  // The scan results only depend on the cleaned strings, which are few
+  // distinct ones in typical image collections.
+  static ThreadSafeLRUCache<std::string, QueryResult> query_cache(
+      /*max_num_elems=*/1024, [](const std::string& make_and_model) {
+        const size_t separator_pos = make_and_model.find('\n');
+        return ScanSpecs(specs_,
+                         make_and_model.substr(0, separator_pos),
+                         make_and_model.substr(separator_pos + 1));
+      });
+  const QueryResult result = query_cache.Get(make_and_model);
+  if (result.has_match) {
+    *sensor_width = result.sensor_width;
+  }
+  return result.is_unique;
 }
 
 }  // namespace colmap
@@ -37,6 +37,9 @@ namespace colmap {
 
 // Database that contains sensor widths for many cameras, which is useful
 // to automatically extract the focal length if EXIF information is incomplete.
+// The results of the database scans are cached by the normalized make and
+// model, such that repeated queries of the few distinct cameras in large image
+// collections take constant time.
 struct CameraDatabase {
  public:
   CameraDatabase() = default;
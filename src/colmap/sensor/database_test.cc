@@ -56,5 +56,35 @@ TEST(CameraDatabase, AmbiguousMatch) {
   EXPECT_EQ(sensor_width, 6.1600f);
 }
 
+TEST(CameraDatabase, NormalizedExactMatch) {
+  CameraDatabase database;
+  double sensor_width;
+  EXPECT_TRUE(database.QuerySensorWidth(
+      "Canon", "Canon Digital-IXUS 100 IS", &sensor_width));
+  EXPECT_EQ(sensor_width, 6.1600f);
+}
+
+TEST(CameraDatabase, NoMatch) {
+  CameraDatabase database;
+  double sensor_width = -1;
+  EXPECT_FALSE(
+      database.QuerySensorWidth("unknownmake", "unknownmodel", &sensor_width));
+  EXPECT_EQ(sensor_width, -1);
+}
+
+TEST(CameraDatabase, RepeatedQuery) {
+  CameraDatabase database;
+  for (int i = 0; i < 2; ++i) {
+    double sensor_width = -1;
+    EXPECT_TRUE(
+        !database.QuerySensorWidth("canon", "digitalixus", &sensor_width));
+    EXPECT_EQ(sensor_width, 6.1600f);
+    sensor_width = -1;
+    EXPECT_TRUE(database.QuerySensorWidth(
+        "Canon", "Canon DIGITAL IXUS 100 IS", &sensor_width));
+    EXPECT_EQ(sensor_width, 6.1600f);
+  }
+}
+
 }  // namespace
 }  // namespace colmap
@@ -30,6 +30,7 @@
 #pragma once
 
 #include "colmap/util/eigen_alignment.h"
+#include "colmap/util/logging.h"
 #include "colmap/util/types.h"
 
 #include <array>
@@ -191,6 +192,10 @@ struct BaseCameraModel {
 
   template <typename T>
   static inline void IterativeUndistortion(const T* params, T* u, T* v);
+
+  template <typename T>
+  static inline void IterativeCamFromImg(
+      const T* params, T x, T y, T* u, T* v, T* w);
 };
 
 // Simple Pinhole camera model.
@@ -472,6 +477,38 @@ inline Eigen::Vector3d CameraModelCamFromImg(CameraModelId model_id,
                                              const std::vector<double>& params,
                                              const Eigen::Vector2d& xy);
 
+// Batched versions of `CameraModelImgFromCam` and `CameraModelCamFromImg`,
+// which dispatch the camera model only once for all points, such that the
+// inner loop is specialized for the camera model and can be vectorized.
+//
+// @param model_id      Unique identifier of camera model.
+// @param params        Array of camera parameters.
+// @param uvw, xy       Input/output points of the same size.
+inline void CameraModelImgFromCam(CameraModelId model_id,
+                                  const std::vector<double>& params,
+                                  span<const Eigen::Vector3d> uvw,
+                                  span<Eigen::Vector2d> xy);
+inline void CameraModelCamFromImg(CameraModelId model_id,
+                                  const std::vector<double>& params,
+                                  span<const Eigen::Vector2d> xy,
+                                  span<Eigen::Vector3d> uvw);
+
+// Transform image to camera coordinates, given an initial estimate of the
+// camera coordinates, e.g., interpolated from a precomputed grid. The estimate
+// is refined by Newton iterations on the projection, which converge after very
+// few iterations for a good initial estimate.
+//
+// @param model_id      Unique identifier of camera model.
+// @param params        Array of camera parameters.
+// @param xy            Image coordinates in pixels.
+// @param uv            Initial estimate of the coordinates as (u, v, w=1).
+//
+// @return              Output Coordinates in camera system as (u, v, w=1).
+inline Eigen::Vector3d CameraModelCamFromImg(CameraModelId model_id,
+                                             const std::vector<double>& params,
+                                             const Eigen::Vector2d& xy,
+                                             const Eigen::Vector2d& uv);
+
 // Convert pixel threshold in image plane to camera space by dividing
 // the threshold through the mean focal length.
 //
@@ -609,6 +646,52 @@ void BaseCameraModel<CameraModel>::IterativeUndistortion(const T* params,
   *v = x(1);
 }
 
+template <typename CameraModel>
+template <typename T>
+void BaseCameraModel<CameraModel>::IterativeCamFromImg(
+    const T* params, const T x, const T y, T* u, T* v, T* w) {
+  // The iterations terminate once the reprojection is accurate, so that a good
+  // initial estimate typically only requires a single Newton step.
+  const size_t kNumIterations = 100;
+  const double kMaxSquaredResidual = 1e-12;
+  const double kRelStepSize = 1e-6;
+
+  Eigen::Matrix2d J;
+  const Eigen::Vector2d xy0(x, y);
+  Eigen::Vector2d uv(*u, *v);
+  Eigen::Vector2d xy;
+  Eigen::Vector2d xy_0b;
+  Eigen::Vector2d xy_0f;
+  Eigen::Vector2d xy_1b;
+  Eigen::Vector2d xy_1f;
+
+  for (size_t i = 0; i < kNumIterations; ++i) {
+    CameraModel::ImgFromCam(params, uv(0), uv(1), 1.0, &xy(0), &xy(1));
+    if ((xy - xy0).squaredNorm() < kMaxSquaredResidual) {
+      break;
+    }
+    const double step0 = std::max(std::numeric_limits<double>::epsilon(),
+                                  std::abs(kRelStepSize * uv(0)));
+    const double step1 = std::max(std::numeric_limits<double>::epsilon(),
+                                  std::abs(kRelStepSize * uv(1)));
+    CameraModel::ImgFromCam(
+        params, uv(0) - step0, uv(1), 1.0, &xy_0b(0), &xy_0b(1));
+    CameraModel::ImgFromCam(
+        params, uv(0) + step0, uv(1), 1.0, &xy_0f(0), &xy_0f(1));
+    CameraModel::ImgFromCam(
+        params, uv(0), uv(1) - step1, 1.0, &xy_1b(0), &xy_1b(1));
+    CameraModel::ImgFromCam(
+        params, uv(0), uv(1) + step1, 1.0, &xy_1f(0), &xy_1f(1));
+    J.col(0) = (xy_0f - xy_0b) / (2 * step0);
+    J.col(1) = (xy_1f - xy_1b) / (2 * step1);
+    uv -= J.partialPivLu().solve(xy - xy0);
+  }
+
+  *u = uv(0);
+  *v = uv(1);
+  *w = 1;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // SimplePinholeCameraModel
 
@@ -1575,6 +1658,77 @@ Eigen::Vector3d CameraModelCamFromImg(const CameraModelId model_id,
   return uvw;
 }
 
+void CameraModelImgFromCam(const CameraModelId model_id,
+                           const std::vector<double>& params,
+                           span<const Eigen::Vector3d> uvw,
+                           span<Eigen::Vector2d> xy) {
+  THROW_CHECK_EQ(uvw.size(), xy.size());
+  const double* params_data = params.data();
+  const size_t num_points = uvw.size();
+  switch (model_id) {
+#define CAMERA_MODEL_CASE(CameraModel)                          \
+  case CameraModel::model_id:                                   \
+    for (size_t i = 0; i < num_points; ++i) {                   \
+      CameraModel::ImgFromCam(params_data,                      \
+                              uvw[i].x(),                       \
+                              uvw[i].y(),                       \
+                              uvw[i].z(),                       \
+                              &xy[i].x(),                       \
+                              &xy[i].y());                      \
+    }                                                           \
+    break;
+
+    CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+  }
+}
+
+void CameraModelCamFromImg(const CameraModelId model_id,
+                           const std::vector<double>& params,
+                           span<const Eigen::Vector2d> xy,
+                           span<Eigen::Vector3d> uvw) {
+  THROW_CHECK_EQ(xy.size(), uvw.size());
+  const double* params_data = params.data();
+  const size_t num_points = xy.size();
+  switch (model_id) {
+#define CAMERA_MODEL_CASE(CameraModel)                          \
+  case CameraModel::model_id:                                   \
+    for (size_t i = 0; i < num_points; ++i) {                   \
+      CameraModel::CamFromImg(params_data,                      \
+                              xy[i].x(),                        \
+                              xy[i].y(),                        \
+                              &uvw[i].x(),                      \
+                              &uvw[i].y(),                      \
+                              &uvw[i].z());                     \
+    }                                                           \
+    break;
+
+    CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+  }
+}
+
+Eigen::Vector3d CameraModelCamFromImg(const CameraModelId model_id,
+                                      const std::vector<double>& params,
+                                      const Eigen::Vector2d& xy,
+                                      const Eigen::Vector2d& uv) {
+  Eigen::Vector3d uvw(uv.x(), uv.y(), 1);
+  switch (model_id) {
+#define CAMERA_MODEL_CASE(CameraModel)                                \
+  case CameraModel::model_id:                                         \
+    CameraModel::IterativeCamFromImg(                                 \
+        params.data(), xy.x(), xy.y(), &uvw.x(), &uvw.y(), &uvw.z()); \
+    break;
+
+    CAMERA_MODEL_SWITCH_CASES
+
+#undef CAMERA_MODEL_CASE
+  }
+  return uvw;
+}
+
 double CameraModelCamFromImgThreshold(const CameraModelId model_id,
                                       const std::vector<double>& params,
                                       const double threshold) {
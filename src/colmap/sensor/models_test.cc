@@ -66,6 +66,35 @@ void TestCamFromImgToImg(const std::vector<double>& params,
   EXPECT_NEAR(y, y0, 1e-6);
 }
 
+template <typename CameraModel>
+void TestBatchedCamFromImgToImg(const std::vector<double>& params) {
+  std::vector<Eigen::Vector3d> uvw;
+  // NOLINTNEXTLINE(clang-analyzer-security.FloatLoopCounter)
+  for (double u = -0.5; u <= 0.5; u += 0.25) {
+    // NOLINTNEXTLINE(clang-analyzer-security.FloatLoopCounter)
+    for (double v = -0.5; v <= 0.5; v += 0.25) {
+      uvw.emplace_back(u, v, 2);
+    }
+  }
+
+  std::vector<Eigen::Vector2d> xy(uvw.size());
+  CameraModelImgFromCam(CameraModel::model_id,
+                        params,
+                        {uvw.data(), uvw.size()},
+                        {xy.data(), xy.size()});
+  std::vector<Eigen::Vector3d> uvw_lifted(xy.size());
+  CameraModelCamFromImg(CameraModel::model_id,
+                        params,
+                        {xy.data(), xy.size()},
+                        {uvw_lifted.data(), uvw_lifted.size()});
+  for (size_t i = 0; i < uvw.size(); ++i) {
+    EXPECT_EQ(xy[i],
+              CameraModelImgFromCam(CameraModel::model_id, params, uvw[i]));
+    EXPECT_EQ(uvw_lifted[i],
+              CameraModelCamFromImg(CameraModel::model_id, params, xy[i]));
+  }
+}
+
 template <typename CameraModel>
 void TestModel(const std::vector<double>& params) {
   EXPECT_TRUE(CameraModelVerifyParams(CameraModel::model_id, params));
@@ -143,6 +172,8 @@ void TestModel(const std::vector<double>& params) {
   const auto pp_idxs = CameraModel::principal_point_idxs;
   TestCamFromImgToImg<CameraModel>(
       params, params[pp_idxs.at(0)], params[pp_idxs.at(1)]);
+
+  TestBatchedCamFromImgToImg<CameraModel>(params);
 }
 
 TEST(SimplePinhole, Nominal) {
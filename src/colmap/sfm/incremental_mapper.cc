@@ -30,14 +30,20 @@
 #include "colmap/sfm/incremental_mapper.h"
 
 #include "colmap/estimators/pose.h"
+#include "colmap/estimators/structure_refinement.h"
 #include "colmap/estimators/two_view_geometry.h"
 #include "colmap/geometry/triangulation.h"
+#include "colmap/math/random.h"
 #include "colmap/scene/projection.h"
 #include "colmap/sensor/bitmap.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/threading.h"
+#include "colmap/util/timer.h"
 
 #include <array>
 #include <fstream>
+#include <numeric>
+#include <sstream>
 
 namespace colmap {
 namespace {
@@ -75,6 +81,47 @@ float RankNextImageMinUncertainty(const image_t image_id,
   return static_cast<float>(obs_manager.Point3DVisibilityScore(image_id));
 }
 
+void IncrementMetric(Metrics* metrics,
+                     const std::string& name,
+                     const double value = 1) {
+  if (metrics != nullptr) {
+    metrics->IncrementCounter(name, value);
+  }
+}
+
+void IncrementBundleAdjustmentMetrics(Metrics* metrics,
+                                      const std::string& prefix,
+                                      const ceres::Solver::Summary& summary) {
+  IncrementMetric(
+      metrics, "num_" + prefix + "_iterations", summary.iterations.size());
+  // The residuals are -1, if the problem was empty and not solved.
+  IncrementMetric(metrics,
+                  "num_" + prefix + "_residuals",
+                  std::max(summary.num_residuals, 0));
+}
+
+// Adds the wall time of its scope to the "<phase>_seconds" counter.
+class ScopedPhaseTimer {
+ public:
+  ScopedPhaseTimer(Metrics* metrics, const std::string& phase)
+      : metrics_(metrics), phase_(phase) {
+    if (metrics_ != nullptr) {
+      timer_.Start();
+    }
+  }
+
+  ~ScopedPhaseTimer() {
+    if (metrics_ != nullptr) {
+      metrics_->IncrementCounter(phase_ + "_seconds", timer_.ElapsedSeconds());
+    }
+  }
+
+ private:
+  Metrics* metrics_;
+  const std::string phase_;
+  Timer timer_;
+};
+
 }  // namespace
 
 bool IncrementalMapper::Options::Check() const {
@@ -96,6 +143,10 @@ bool IncrementalMapper::Options::Check() const {
   CHECK_OPTION_GE(filter_max_reproj_error, 0.0);
   CHECK_OPTION_GE(filter_min_tri_angle, 0.0);
   CHECK_OPTION_GE(max_reg_trials, 1);
+  CHECK_OPTION_GE(num_parallel_reg_candidates, 1);
+  CHECK_OPTION_GE(num_parallel_init_pair_candidates, 1);
+  CHECK_OPTION_GE(ba_global_max_num_images_per_partition, 0);
+  CHECK_OPTION_GT(sequential_loop_min_frame_gap, 0);
   return true;
 }
 
@@ -106,7 +157,8 @@ IncrementalMapper::IncrementalMapper(
       obs_manager_(nullptr),
       triangulator_(nullptr),
       num_total_reg_images_(0),
-      num_shared_reg_images_(0) {}
+      num_shared_reg_images_(0),
+      metrics_(nullptr) {}
 
 void IncrementalMapper::BeginReconstruction(
     const std::shared_ptr<class Reconstruction>& reconstruction) {
@@ -131,6 +183,20 @@ void IncrementalMapper::BeginReconstruction(
 
   filtered_images_.clear();
   num_reg_trials_.clear();
+  next_image_poses_.clear();
+
+  if (frame_idxs_.empty()) {
+    std::vector<std::pair<std::string, image_t>> image_names;
+    image_names.reserve(database_cache_->NumImages());
+    for (const auto& image : database_cache_->Images()) {
+      image_names.emplace_back(image.second.Name(), image.first);
+    }
+    std::sort(image_names.begin(), image_names.end());
+    frame_idxs_.reserve(image_names.size());
+    for (size_t i = 0; i < image_names.size(); ++i) {
+      frame_idxs_.emplace(image_names[i].second, i);
+    }
+  }
 }
 
 void IncrementalMapper::EndReconstruction(const bool discard) {
@@ -146,8 +212,125 @@ void IncrementalMapper::EndReconstruction(const bool discard) {
   reconstruction_ = nullptr;
   obs_manager_.reset();
   triangulator_.reset();
+  next_image_poses_.clear();
 }
 
+void IncrementalMapper::State::Write(const std::string& path) const {
+  std::ofstream file(path, std::ios::trunc);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  // Each line holds one map or set with the entries as consecutive values.
+  auto WriteMap = [&file](const std::string& name,
+                          const std::unordered_map<image_t, size_t>& map) {
+    file << name;
+    for (const auto& entry : map) {
+      file << " " << entry.first << " " << entry.second;
+    }
+    file << "\n";
+  };
+  auto WriteSet = [&file](const std::string& name, const auto& set) {
+    file << name;
+    for (const auto& entry : set) {
+      file << " " << entry;
+    }
+    file << "\n";
+  };
+
+  WriteMap("init_num_reg_trials", init_num_reg_trials);
+  WriteSet("init_image_pairs", init_image_pairs);
+  WriteMap("num_registrations", num_registrations);
+  WriteSet("filtered_images", filtered_images);
+  WriteMap("num_reg_trials", num_reg_trials);
+  WriteSet("existing_image_ids", existing_image_ids);
+
+  THROW_CHECK(file.good()) << "Failed to write " << path;
+}
+
+IncrementalMapper::State IncrementalMapper::State::Read(
+    const std::string& path) {
+  std::ifstream file(path);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  State state;
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream line_stream(line);
+    std::string name;
+    line_stream >> name;
+    if (name == "init_num_reg_trials" || name == "num_registrations" ||
+        name == "num_reg_trials") {
+      std::unordered_map<image_t, size_t>& map =
+          name == "init_num_reg_trials"
+              ? state.init_num_reg_trials
+              : (name == "num_registrations" ? state.num_registrations
+                                             : state.num_reg_trials);
+      image_t image_id;
+      size_t value;
+      while (line_stream >> image_id >> value) {
+        map.emplace(image_id, value);
+      }
+    } else if (name == "init_image_pairs") {
+      image_pair_t pair_id;
+      while (line_stream >> pair_id) {
+        state.init_image_pairs.insert(pair_id);
+      }
+    } else if (name == "filtered_images" || name == "existing_image_ids") {
+      std::unordered_set<image_t>& set = name == "filtered_images"
+                                             ? state.filtered_images
+                                             : state.existing_image_ids;
+      image_t image_id;
+      while (line_stream >> image_id) {
+        set.insert(image_id);
+      }
+    } else {
+      LOG(FATAL_THROW) << "Invalid mapper state entry: " << name;
+    }
+  }
+
+  return state;
+}
+
+IncrementalMapper::State IncrementalMapper::GetState() const {
+  State state;
+  state.init_num_reg_trials = init_num_reg_trials_;
+  state.init_image_pairs = init_image_pairs_;
+  state.num_registrations = num_registrations_;
+  state.filtered_images = filtered_images_;
+  state.num_reg_trials = num_reg_trials_;
+  state.existing_image_ids = existing_image_ids_;
+  return state;
+}
+
+void IncrementalMapper::SetState(const State& state) {
+  THROW_CHECK_NOTNULL(reconstruction_);
+  init_num_reg_trials_ = state.init_num_reg_trials;
+  init_image_pairs_ = state.init_image_pairs;
+  filtered_images_ = state.filtered_images;
+  num_reg_trials_ = state.num_reg_trials;
+  existing_image_ids_ = state.existing_image_ids;
+
+  // The registrations of the current reconstruction were already counted by
+  // `BeginReconstruction` and are included in the state.
+  num_registrations_ = state.num_registrations;
+  num_total_reg_images_ = 0;
+  for (const auto& num_registrations : num_registrations_) {
+    if (num_registrations.second > 0) {
+      num_total_reg_images_ += 1;
+    }
+  }
+  num_shared_reg_images_ = 0;
+  for (const image_t image_id : reconstruction_->RegImageIds()) {
+    const auto it = num_registrations_.find(image_id);
+    THROW_CHECK(it != num_registrations_.end() && it->second > 0)
+        << "Image " << image_id << " is not registered in the mapper state";
+    if (it->second > 1) {
+      num_shared_reg_images_ += 1;
+    }
+  }
+}
+
+void IncrementalMapper::SetMetrics(Metrics* metrics) { metrics_ = metrics; }
+
 bool IncrementalMapper::FindInitialImagePair(const Options& options,
                                              TwoViewGeometry& two_view_geometry,
                                              image_t& image_id1,
@@ -172,33 +355,94 @@ bool IncrementalMapper::FindInitialImagePair(const Options& options,
     image_ids1 = FindFirstInitialImage(options);
   }
 
-  // Try to find good initial pair.
-  for (size_t i1 = 0; i1 < image_ids1.size(); ++i1) {
-    image_id1 = image_ids1[i1];
+  const size_t num_parallel_candidates =
+      static_cast<size_t>(options.num_parallel_init_pair_candidates);
+  std::unique_ptr<ThreadPool> thread_pool;
+  if (num_parallel_candidates > 1) {
+    thread_pool = std::make_unique<ThreadPool>(
+        std::min(GetEffectiveNumThreads(options.num_threads),
+                 static_cast<int>(num_parallel_candidates)));
+  }
+
+  // Estimate the two-view geometries of a batch of candidate pairs
+  // concurrently and select the best suitable pair. Only the selected and the
+  // unsuitable pairs are marked as tried, such that the other suitable pairs
+  // remain candidates if the initialization with the selected pair fails.
+  std::vector<std::pair<image_t, image_t>> candidates;
+  candidates.reserve(num_parallel_candidates);
+  const auto select_best_candidate = [&]() {
+    std::vector<TwoViewGeometry> two_view_geometries(candidates.size());
+    std::vector<char> success(candidates.size(), false);
+    if (thread_pool == nullptr) {
+      success[0] = EstimateInitialTwoViewGeometry(options,
+                                                  two_view_geometries[0],
+                                                  candidates[0].first,
+                                                  candidates[0].second);
+    } else {
+      thread_pool->ParallelFor(
+          0, candidates.size(), /*grain_size=*/1, [&](const int64_t i) {
+            // Reseed the random number generator of the worker thread, such
+            // that the estimate of a pair does not depend on the scheduling.
+            SetPRNGSeed(kDefaultPRNGSeed);
+            success[i] = EstimateInitialTwoViewGeometry(options,
+                                                        two_view_geometries[i],
+                                                        candidates[i].first,
+                                                        candidates[i].second);
+          });
+    }
 
-    const std::vector<image_t> image_ids2 =
-        FindSecondInitialImage(options, image_id1);
+    // Select the pair with the most inliers and prefer earlier candidates,
+    // which are ranked higher, in case of ties.
+    int best_idx = -1;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      if (!success[i]) {
+        init_image_pairs_.insert(Database::ImagePairToPairId(
+            candidates[i].first, candidates[i].second));
+      } else if (best_idx == -1 ||
+                 two_view_geometries[i].inlier_matches.size() >
+                     two_view_geometries[best_idx].inlier_matches.size() ||
+                 (two_view_geometries[i].inlier_matches.size() ==
+                      two_view_geometries[best_idx].inlier_matches.size() &&
+                  two_view_geometries[i].tri_angle >
+                      two_view_geometries[best_idx].tri_angle)) {
+        best_idx = static_cast<int>(i);
+      }
+    }
 
-    for (size_t i2 = 0; i2 < image_ids2.size(); ++i2) {
-      image_id2 = image_ids2[i2];
+    if (best_idx >= 0) {
+      image_id1 = candidates[best_idx].first;
+      image_id2 = candidates[best_idx].second;
+      init_image_pairs_.insert(
+          Database::ImagePairToPairId(image_id1, image_id2));
+      two_view_geometry = std::move(two_view_geometries[best_idx]);
+    }
 
-      const image_pair_t pair_id =
-          Database::ImagePairToPairId(image_id1, image_id2);
+    candidates.clear();
+    return best_idx >= 0;
+  };
 
+  // Try to find good initial pair.
+  for (const image_t candidate_image_id1 : image_ids1) {
+    for (const image_t candidate_image_id2 :
+         FindSecondInitialImage(options, candidate_image_id1)) {
       // Try every pair only once.
-      if (init_image_pairs_.count(pair_id) > 0) {
+      if (init_image_pairs_.count(Database::ImagePairToPairId(
+              candidate_image_id1, candidate_image_id2)) > 0) {
         continue;
       }
 
-      init_image_pairs_.insert(pair_id);
-
-      if (EstimateInitialTwoViewGeometry(
-              options, two_view_geometry, image_id1, image_id2)) {
+      candidates.emplace_back(candidate_image_id1, candidate_image_id2);
+      if (candidates.size() == num_parallel_candidates &&
+          select_best_candidate()) {
         return true;
       }
     }
   }
 
+  if (!candidates.empty() && select_best_candidate()) {
+    return true;
+  }
+
   // No suitable pair found in entire dataset.
   image_id1 = kInvalidImageId;
   image_id2 = kInvalidImageId;
@@ -224,35 +468,45 @@ std::vector<image_t> IncrementalMapper::FindNextImages(const Options& options) {
       break;
   }
 
+  // Frames of a video are registered in temporal order, starting from the
+  // frames closest to the last registered frame.
+  if (options.sequential && reconstruction_->NumRegImages() > 0) {
+    const float last_frame_idx =
+        frame_idxs_.at(reconstruction_->RegImageIds().back());
+    rank_image_func = [this, last_frame_idx](
+                          const image_t image_id,
+                          const class ObservationManager&) {
+      return -std::abs(frame_idxs_.at(image_id) - last_frame_idx);
+    };
+  }
+
   std::vector<std::pair<image_t, float>> image_ranks;
   std::vector<std::pair<image_t, float>> other_image_ranks;
 
-  // Append images that have not failed to register before.
-  for (const auto& image : reconstruction_->Images()) {
-    // Skip images that are already registered.
-    if (image.second.IsRegistered()) {
-      continue;
-    }
-
+  // Append images that have not failed to register before. Only unregistered
+  // images that see triangulated points are candidates, which are maintained
+  // by the observation manager to avoid scanning all images.
+  for (const image_t image_id :
+       obs_manager_->UnregisteredImagesWithVisiblePoints3D()) {
     // Only consider images with a sufficient number of visible points.
-    if (obs_manager_->NumVisiblePoints3D(image.first) <
+    if (obs_manager_->NumVisiblePoints3D(image_id) <
         static_cast<size_t>(options.abs_pose_min_num_inliers)) {
       continue;
     }
 
     // Only try registration for a certain maximum number of times.
-    const size_t num_reg_trials = num_reg_trials_[image.first];
+    const size_t num_reg_trials = num_reg_trials_[image_id];
     if (num_reg_trials >= static_cast<size_t>(options.max_reg_trials)) {
       continue;
     }
 
     // If image has been filtered or failed to register, place it in the
     // second bucket and prefer images that have not been tried before.
-    const float rank = rank_image_func(image.first, *obs_manager_);
-    if (filtered_images_.count(image.first) == 0 && num_reg_trials == 0) {
-      image_ranks.emplace_back(image.first, rank);
+    const float rank = rank_image_func(image_id, *obs_manager_);
+    if (filtered_images_.count(image_id) == 0 && num_reg_trials == 0) {
+      image_ranks.emplace_back(image_id, rank);
     } else {
-      other_image_ranks.emplace_back(image.first, rank);
+      other_image_ranks.emplace_back(image_id, rank);
     }
   }
 
@@ -274,6 +528,9 @@ void IncrementalMapper::RegisterInitialImagePair(
 
   THROW_CHECK(options.Check());
 
+  ScopedPhaseTimer phase_timer(metrics_, "registration");
+  IncrementMetric(metrics_, "num_initial_pair_registrations");
+
   init_num_reg_trials_[image_id1] += 1;
   init_num_reg_trials_[image_id2] += 1;
   num_reg_trials_[image_id1] += 1;
@@ -342,6 +599,39 @@ void IncrementalMapper::RegisterInitialImagePair(
   }
 }
 
+void IncrementalMapper::EstimateNextImagePoses(
+    const Options& options, const std::vector<image_t>& image_ids) {
+  THROW_CHECK_NOTNULL(reconstruction_);
+  THROW_CHECK_NOTNULL(obs_manager_);
+  THROW_CHECK_GE(reconstruction_->NumRegImages(), 2);
+
+  THROW_CHECK(options.Check());
+
+  ScopedPhaseTimer phase_timer(metrics_, "registration");
+
+  next_image_poses_.clear();
+  for (const image_t image_id : image_ids) {
+    THROW_CHECK(!reconstruction_->Image(image_id).IsRegistered())
+        << "Image cannot be registered multiple times";
+    next_image_poses_.emplace(image_id, NextImagePose());
+  }
+
+  // The estimation only reads from the reconstruction, so the images can be
+  // processed independently of each other.
+  ThreadPool thread_pool(std::min(GetEffectiveNumThreads(options.num_threads),
+                                  static_cast<int>(image_ids.size())));
+  std::vector<std::pair<image_t, NextImagePose*>> poses;
+  poses.reserve(next_image_poses_.size());
+  for (auto& next_image_pose : next_image_poses_) {
+    poses.emplace_back(next_image_pose.first, &next_image_pose.second);
+  }
+  thread_pool.ParallelFor(
+      0, poses.size(), /*grain_size=*/1, [&](const int64_t i) {
+        NextImagePose* pose = poses[i].second;
+        pose->success = EstimateNextImagePose(options, poses[i].first, pose);
+      });
+}
+
 bool IncrementalMapper::RegisterNextImage(const Options& options,
                                           const image_t image_id) {
   THROW_CHECK_NOTNULL(reconstruction_);
@@ -356,8 +646,66 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
   THROW_CHECK(!image.IsRegistered())
       << "Image cannot be registered multiple times";
 
+  ScopedPhaseTimer phase_timer(metrics_, "registration");
+  IncrementMetric(metrics_, "num_registration_trials");
+
   num_reg_trials_[image_id] += 1;
 
+  NextImagePose next_image_pose;
+  const auto next_image_pose_it = next_image_poses_.find(image_id);
+  if (next_image_pose_it == next_image_poses_.end()) {
+    next_image_pose.success =
+        EstimateNextImagePose(options, image_id, &next_image_pose);
+  } else {
+    next_image_pose = std::move(next_image_pose_it->second);
+    next_image_poses_.erase(next_image_pose_it);
+  }
+
+  if (!next_image_pose.success) {
+    IncrementMetric(metrics_, "num_failed_registrations");
+    return false;
+  }
+
+  image.CamFromWorld() = next_image_pose.cam_from_world;
+  camera = next_image_pose.camera;
+
+  // All other pre-computed poses are outdated after the registration.
+  next_image_poses_.clear();
+
+  //////////////////////////////////////////////////////////////////////////////
+  // Continue tracks
+  //////////////////////////////////////////////////////////////////////////////
+
+  reconstruction_->RegisterImage(image_id);
+  RegisterImageEvent(image_id);
+
+  const std::vector<std::pair<point2D_t, point3D_t>>& tri_corrs =
+      next_image_pose.tri_corrs;
+  const std::vector<char>& inlier_mask = next_image_pose.inlier_mask;
+  for (size_t i = 0; i < inlier_mask.size(); ++i) {
+    if (inlier_mask[i]) {
+      const point2D_t point2D_idx = tri_corrs[i].first;
+      const Point2D& point2D = image.Point2D(point2D_idx);
+      if (!point2D.HasPoint3D()) {
+        const point3D_t point3D_id = tri_corrs[i].second;
+        const TrackElement track_el(image_id, point2D_idx);
+        obs_manager_->AddObservation(point3D_id, track_el);
+        triangulator_->AddModifiedPoint3D(point3D_id);
+      }
+    }
+  }
+
+  return true;
+}
+
+bool IncrementalMapper::EstimateNextImagePose(
+    const Options& options,
+    const image_t image_id,
+    NextImagePose* next_image_pose) const {
+  const Image& image = reconstruction_->Image(image_id);
+  next_image_pose->camera = reconstruction_->Camera(image.CameraId());
+  Camera& camera = next_image_pose->camera;
+
   // Check if enough 2D-3D correspondences.
   if (obs_manager_->NumVisiblePoints3D(image_id) <
       static_cast<size_t>(options.abs_pose_min_num_inliers)) {
@@ -368,7 +716,8 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
   // Search for 2D-3D correspondences
   //////////////////////////////////////////////////////////////////////////////
 
-  std::vector<std::pair<point2D_t, point3D_t>> tri_corrs;
+  std::vector<std::pair<point2D_t, point3D_t>>& tri_corrs =
+      next_image_pose->tri_corrs;
   std::vector<Eigen::Vector2d> tri_points2D;
   std::vector<Eigen::Vector3d> tri_points3D;
 
@@ -427,6 +776,35 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
     return false;
   }
 
+  // Points observed in more images are more reliable, so they are sampled
+  // first in progressive sampling.
+  if (options.abs_pose_use_prosac) {
+    std::vector<size_t> track_lengths(tri_corrs.size());
+    for (size_t i = 0; i < tri_corrs.size(); ++i) {
+      track_lengths[i] =
+          reconstruction_->Point3D(tri_corrs[i].second).track.Length();
+    }
+    std::vector<size_t> order(tri_corrs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t i, size_t j) {
+      return track_lengths[i] > track_lengths[j];
+    });
+    std::vector<std::pair<point2D_t, point3D_t>> sorted_tri_corrs;
+    std::vector<Eigen::Vector2d> sorted_tri_points2D;
+    std::vector<Eigen::Vector3d> sorted_tri_points3D;
+    sorted_tri_corrs.reserve(order.size());
+    sorted_tri_points2D.reserve(order.size());
+    sorted_tri_points3D.reserve(order.size());
+    for (const size_t i : order) {
+      sorted_tri_corrs.push_back(tri_corrs[i]);
+      sorted_tri_points2D.push_back(tri_points2D[i]);
+      sorted_tri_points3D.push_back(tri_points3D[i]);
+    }
+    tri_corrs = std::move(sorted_tri_corrs);
+    tri_points2D = std::move(sorted_tri_points2D);
+    tri_points3D = std::move(sorted_tri_points3D);
+  }
+
   //////////////////////////////////////////////////////////////////////////////
   // 2D-3D estimation
   //////////////////////////////////////////////////////////////////////////////
@@ -444,6 +822,8 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
   abs_pose_options.ransac_options.max_error = options.abs_pose_max_error;
   abs_pose_options.ransac_options.min_inlier_ratio =
       options.abs_pose_min_inlier_ratio;
+  abs_pose_options.ransac_options.use_sprt = options.abs_pose_use_sprt;
+  abs_pose_options.use_prosac = options.abs_pose_use_prosac;
   // Use high confidence to avoid preemptive termination of P3P RANSAC
   // - too early termination may lead to bad registration.
   abs_pose_options.ransac_options.min_num_trials = 100;
@@ -451,7 +831,10 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
   abs_pose_options.ransac_options.confidence = 0.99999;
 
   AbsolutePoseRefinementOptions abs_pose_refinement_options;
-  if (num_reg_images_per_camera_[image.CameraId()] > 0) {
+  const auto num_reg_images_it =
+      num_reg_images_per_camera_.find(image.CameraId());
+  if (num_reg_images_it != num_reg_images_per_camera_.end() &&
+      num_reg_images_it->second > 0) {
     // Camera already refined from another image with the same camera.
     if (camera.HasBogusParams(options.min_focal_length_ratio,
                               options.max_focal_length_ratio,
@@ -487,12 +870,12 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
   }
 
   size_t num_inliers;
-  std::vector<char> inlier_mask;
+  std::vector<char>& inlier_mask = next_image_pose->inlier_mask;
 
   if (!EstimateAbsolutePose(abs_pose_options,
                             tri_points2D,
                             tri_points3D,
-                            &image.CamFromWorld(),
+                            &next_image_pose->cam_from_world,
                             &camera,
                             &num_inliers,
                             &inlier_mask)) {
@@ -511,62 +894,89 @@ bool IncrementalMapper::RegisterNextImage(const Options& options,
                           inlier_mask,
                           tri_points2D,
                           tri_points3D,
-                          &image.CamFromWorld(),
+                          &next_image_pose->cam_from_world,
                           &camera)) {
     return false;
   }
 
-  //////////////////////////////////////////////////////////////////////////////
-  // Continue tracks
-  //////////////////////////////////////////////////////////////////////////////
+  return true;
+}
 
-  reconstruction_->RegisterImage(image_id);
-  RegisterImageEvent(image_id);
+bool IncrementalMapper::IsLoopClosure(const Options& options,
+                                      const image_t image_id) const {
+  THROW_CHECK_NOTNULL(reconstruction_);
+  THROW_CHECK(options.Check());
 
-  for (size_t i = 0; i < inlier_mask.size(); ++i) {
-    if (inlier_mask[i]) {
-      const point2D_t point2D_idx = tri_corrs[i].first;
-      const Point2D& point2D = image.Point2D(point2D_idx);
-      if (!point2D.HasPoint3D()) {
-        const point3D_t point3D_id = tri_corrs[i].second;
-        const TrackElement track_el(image_id, point2D_idx);
-        obs_manager_->AddObservation(point3D_id, track_el);
-        triangulator_->AddModifiedPoint3D(point3D_id);
+  const Image& image = reconstruction_->Image(image_id);
+  THROW_CHECK(image.IsRegistered());
+
+  const size_t frame_idx = frame_idxs_.at(image_id);
+  const auto& correspondence_graph = *database_cache_->CorrespondenceGraph();
+
+  int num_loop_corrs = 0;
+  for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+       ++point2D_idx) {
+    const auto range =
+        correspondence_graph.FindCorrespondences(image_id, point2D_idx);
+    for (const auto* corr = range.beg; corr < range.end; ++corr) {
+      const size_t other_frame_idx = frame_idxs_.at(corr->image_id);
+      const size_t frame_gap = frame_idx > other_frame_idx
+                                   ? frame_idx - other_frame_idx
+                                   : other_frame_idx - frame_idx;
+      if (frame_gap >=
+              static_cast<size_t>(options.sequential_loop_min_frame_gap) &&
+          reconstruction_->IsImageRegistered(corr->image_id)) {
+        ++num_loop_corrs;
+        break;
       }
     }
+    if (num_loop_corrs >= options.abs_pose_min_num_inliers) {
+      return true;
+    }
   }
 
-  return true;
+  return false;
 }
 
 size_t IncrementalMapper::TriangulateImage(
     const IncrementalTriangulator::Options& tri_options,
     const image_t image_id) {
   THROW_CHECK_NOTNULL(reconstruction_);
+  ScopedPhaseTimer phase_timer(metrics_, "triangulation");
   VLOG(1) << "=> Continued observations: "
           << reconstruction_->Image(image_id).NumPoints3D();
   const size_t num_tris =
       triangulator_->TriangulateImage(tri_options, image_id);
   VLOG(1) << "=> Added observations: " << num_tris;
+  IncrementMetric(metrics_, "num_triangulated_observations", num_tris);
   return num_tris;
 }
 
 size_t IncrementalMapper::Retriangulate(
     const IncrementalTriangulator::Options& tri_options) {
   THROW_CHECK_NOTNULL(reconstruction_);
-  return triangulator_->Retriangulate(tri_options);
+  ScopedPhaseTimer phase_timer(metrics_, "retriangulation");
+  const size_t num_tris = triangulator_->Retriangulate(tri_options);
+  IncrementMetric(metrics_, "num_retriangulated_observations", num_tris);
+  return num_tris;
 }
 
 size_t IncrementalMapper::CompleteTracks(
     const IncrementalTriangulator::Options& tri_options) {
   THROW_CHECK_NOTNULL(reconstruction_);
-  return triangulator_->CompleteAllTracks(tri_options);
+  ScopedPhaseTimer phase_timer(metrics_, "track_completion");
+  const size_t num_completed = triangulator_->CompleteAllTracks(tri_options);
+  IncrementMetric(metrics_, "num_completed_observations", num_completed);
+  return num_completed;
 }
 
 size_t IncrementalMapper::MergeTracks(
     const IncrementalTriangulator::Options& tri_options) {
   THROW_CHECK_NOTNULL(reconstruction_);
-  return triangulator_->MergeAllTracks(tri_options);
+  ScopedPhaseTimer phase_timer(metrics_, "track_merging");
+  const size_t num_merged = triangulator_->MergeAllTracks(tri_options);
+  IncrementMetric(metrics_, "num_merged_observations", num_merged);
+  return num_merged;
 }
 
 size_t IncrementalMapper::CompleteAndMergeTracks(
@@ -589,6 +999,8 @@ IncrementalMapper::AdjustLocalBundle(
   THROW_CHECK_NOTNULL(obs_manager_);
   THROW_CHECK(options.Check());
 
+  ScopedPhaseTimer phase_timer(metrics_, "local_ba");
+
   LocalBundleAdjustmentReport report;
 
   // Find images that have most 3D points with given image in common.
@@ -660,8 +1072,9 @@ IncrementalMapper::AdjustLocalBundle(
     BundleAdjuster bundle_adjuster(ba_options, ba_config);
     bundle_adjuster.Solve(reconstruction_.get());
 
-    report.num_adjusted_observations =
-        bundle_adjuster.Summary().num_residuals / 2;
+    const ceres::Solver::Summary& summary = bundle_adjuster.Summary();
+    report.num_adjusted_observations = summary.num_residuals / 2;
+    IncrementBundleAdjustmentMetrics(metrics_, "local_ba", summary);
 
     // Merge refined tracks with other existing points.
     report.num_merged_observations =
@@ -692,6 +1105,14 @@ IncrementalMapper::AdjustLocalBundle(
                                    options.filter_min_tri_angle,
                                    point3D_ids);
 
+  IncrementMetric(
+      metrics_, "num_merged_observations", report.num_merged_observations);
+  IncrementMetric(metrics_,
+                  "num_completed_observations",
+                  report.num_completed_observations);
+  IncrementMetric(
+      metrics_, "num_filtered_observations", report.num_filtered_observations);
+
   return report;
 }
 
@@ -700,6 +1121,48 @@ bool IncrementalMapper::AdjustGlobalBundle(
   THROW_CHECK_NOTNULL(reconstruction_);
   THROW_CHECK_NOTNULL(obs_manager_);
 
+  ScopedPhaseTimer phase_timer(metrics_, "global_ba");
+
+  // Avoid degeneracies in bundle adjustment.
+  obs_manager_->FilterObservationsWithNegativeDepth();
+
+  if (IsStructureOnlyGlobalBundle(options, ba_options)) {
+    std::vector<point3D_t> point3D_ids;
+    point3D_ids.reserve(reconstruction_->NumPoints3D());
+    for (const auto& point3D : reconstruction_->Points3D()) {
+      point3D_ids.push_back(point3D.first);
+    }
+    StructureRefinementOptions structure_refinement_options;
+    structure_refinement_options.num_threads = options.num_threads;
+    std::unique_ptr<ceres::LossFunction> loss_function(
+        ba_options.CreateLossFunction());
+    RefinePoints3D(structure_refinement_options,
+                   point3D_ids,
+                   reconstruction_.get(),
+                   loss_function.get());
+    return true;
+  }
+
+  std::unique_ptr<BundleAdjuster> bundle_adjuster =
+      CreateGlobalBundleAdjuster(options, ba_options);
+  if (options.ba_global_max_num_images_per_partition > 0) {
+    PartitionedBundleAdjuster::Options partition_options;
+    partition_options.max_num_images_per_partition =
+        options.ba_global_max_num_images_per_partition;
+    PartitionedBundleAdjuster partitioned_bundle_adjuster(
+        bundle_adjuster->Options(),
+        partition_options,
+        bundle_adjuster->Config());
+    return partitioned_bundle_adjuster.Solve(reconstruction_.get());
+  }
+  const bool success = bundle_adjuster->Solve(reconstruction_.get());
+  IncrementBundleAdjustmentMetrics(
+      metrics_, "global_ba", bundle_adjuster->Summary());
+  return success;
+}
+
+std::unique_ptr<BundleAdjuster> IncrementalMapper::CreateGlobalBundleAdjuster(
+    const Options& options, const BundleAdjustmentOptions& ba_options) const {
   const std::vector<image_t>& reg_image_ids = reconstruction_->RegImageIds();
 
   THROW_CHECK_GE(reg_image_ids.size(), 2) << "At least two images must be "
@@ -717,9 +1180,6 @@ bool IncrementalMapper::AdjustGlobalBundle(
     ba_options_tmp.solver_options.max_linear_solver_iterations = 200;
   }
 
-  // Avoid degeneracies in bundle adjustment.
-  obs_manager_->FilterObservationsWithNegativeDepth();
-
   // Configure bundle adjustment.
   BundleAdjustmentConfig ba_config;
   for (const image_t image_id : reg_image_ids) {
@@ -742,9 +1202,27 @@ bool IncrementalMapper::AdjustGlobalBundle(
     ba_config.SetConstantCamPositions(reg_image_ids[1], {0});
   }
 
-  // Run bundle adjustment.
-  BundleAdjuster bundle_adjuster(ba_options_tmp, ba_config);
-  return bundle_adjuster.Solve(reconstruction_.get());
+  return std::make_unique<BundleAdjuster>(ba_options_tmp, ba_config);
+}
+
+bool IncrementalMapper::IsStructureOnlyGlobalBundle(
+    const Options& options, const BundleAdjustmentOptions& ba_options) const {
+  if (ba_options.refine_focal_length || ba_options.refine_principal_point ||
+      ba_options.refine_extra_params) {
+    return false;
+  }
+  if (!ba_options.refine_extrinsics) {
+    return true;
+  }
+  if (!options.fix_existing_images) {
+    return false;
+  }
+  for (const image_t image_id : reconstruction_->RegImageIds()) {
+    if (existing_image_ids_.count(image_id) == 0) {
+      return false;
+    }
+  }
+  return true;
 }
 
 void IncrementalMapper::IterativeLocalRefinement(
@@ -789,9 +1267,28 @@ void IncrementalMapper::IterativeGlobalRefinement(
     const bool normalize_reconstruction) {
   CompleteAndMergeTracks(tri_options);
   VLOG(1) << "=> Retriangulated observations: " << Retriangulate(tri_options);
+  // The problem of the first iteration is kept alive and only updated for the
+  // observations changed by merging, completing, and filtering tracks.
+  std::unique_ptr<BundleAdjuster> bundle_adjuster;
   for (int i = 0; i < max_num_refinements; ++i) {
     const size_t num_observations = reconstruction_->ComputeNumObservations();
-    AdjustGlobalBundle(options, ba_options);
+    if (options.ba_global_reuse_problem &&
+        options.ba_global_max_num_images_per_partition == 0 &&
+        ba_options.points3D_subsampling_num_levels == 0 &&
+        !IsStructureOnlyGlobalBundle(options, ba_options)) {
+      THROW_CHECK_NOTNULL(obs_manager_);
+      obs_manager_->FilterObservationsWithNegativeDepth();
+      if (bundle_adjuster) {
+        bundle_adjuster->Resolve(reconstruction_.get());
+      } else {
+        BundleAdjustmentOptions ba_options_tmp = ba_options;
+        ba_options_tmp.enable_problem_updates = max_num_refinements > 1;
+        bundle_adjuster = CreateGlobalBundleAdjuster(options, ba_options_tmp);
+        bundle_adjuster->Solve(reconstruction_.get());
+      }
+    } else {
+      AdjustGlobalBundle(options, ba_options);
+    }
     if (normalize_reconstruction) {
       // Normalize scene for numerical stability and
       // to avoid large scale changes in the viewer.
@@ -808,6 +1305,8 @@ void IncrementalMapper::IterativeGlobalRefinement(
       break;
     }
   }
+  // Release the spare track capacity left over by merging and filtering.
+  reconstruction_->CompressTracks();
 }
 
 size_t IncrementalMapper::FilterImages(const Options& options) {
@@ -815,6 +1314,8 @@ size_t IncrementalMapper::FilterImages(const Options& options) {
   THROW_CHECK_NOTNULL(obs_manager_);
   THROW_CHECK(options.Check());
 
+  ScopedPhaseTimer phase_timer(metrics_, "filtering");
+
   // Do not filter images in the early stage of the reconstruction, since the
   // calibration is often still refining a lot. Hence, the camera parameters
   // are not stable in the beginning.
@@ -835,15 +1336,19 @@ size_t IncrementalMapper::FilterImages(const Options& options) {
 
   const size_t num_filtered_images = image_ids.size();
   VLOG(1) << "=> Filtered images: " << num_filtered_images;
+  IncrementMetric(metrics_, "num_filtered_images", num_filtered_images);
   return num_filtered_images;
 }
 
 size_t IncrementalMapper::FilterPoints(const Options& options) {
   THROW_CHECK_NOTNULL(obs_manager_);
   THROW_CHECK(options.Check());
+  ScopedPhaseTimer phase_timer(metrics_, "filtering");
   const size_t num_filtered_observations = obs_manager_->FilterAllPoints3D(
       options.filter_max_reproj_error, options.filter_min_tri_angle);
   VLOG(1) << "=> Filtered observations: " << num_filtered_observations;
+  IncrementMetric(
+      metrics_, "num_filtered_observations", num_filtered_observations);
   return num_filtered_observations;
 }
 
@@ -1042,6 +1547,26 @@ std::vector<image_t> IncrementalMapper::FindLocalBundle(
   const Image& image = reconstruction_->Image(image_id);
   THROW_CHECK(image.IsRegistered());
 
+  // In sequential mode, the local bundle is the sliding window of the last
+  // registered frames, ordered from the most to the least recent frame, such
+  // that the oldest frames of the window are kept constant.
+  if (options.sequential) {
+    const size_t num_images =
+        static_cast<size_t>(options.local_ba_num_images - 1);
+    const std::vector<image_t>& reg_image_ids = reconstruction_->RegImageIds();
+    std::vector<image_t> local_bundle_image_ids;
+    local_bundle_image_ids.reserve(num_images);
+    for (auto it = reg_image_ids.rbegin();
+         it != reg_image_ids.rend() &&
+         local_bundle_image_ids.size() < num_images;
+         ++it) {
+      if (*it != image_id) {
+        local_bundle_image_ids.push_back(*it);
+      }
+    }
+    return local_bundle_image_ids;
+  }
+
   // Extract all images that have at least one 3D point with the query image
   // in common, and simultaneously count the number of common 3D points.
 
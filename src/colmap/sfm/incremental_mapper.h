@@ -35,6 +35,7 @@
 #include "colmap/scene/reconstruction.h"
 #include "colmap/sfm/incremental_triangulator.h"
 #include "colmap/sfm/observation_manager.h"
+#include "colmap/util/metrics.h"
 
 namespace colmap {
 
@@ -88,6 +89,13 @@ class IncrementalMapper {
     // Minimum inlier ratio in absolute pose estimation.
     double abs_pose_min_inlier_ratio = 0.25;
 
+    // Whether to reject bad models early in absolute pose estimation.
+    bool abs_pose_use_sprt = false;
+
+    // Whether to sample the 2D-3D correspondences in absolute pose estimation
+    // progressively (PROSAC) in decreasing order of their track lengths.
+    bool abs_pose_use_prosac = false;
+
     // Whether to estimate the focal length in absolute pose estimation.
     bool abs_pose_refine_focal_length = true;
 
@@ -118,9 +126,28 @@ class IncrementalMapper {
     // If reconstruction is provided as input, fix the existing image poses.
     bool fix_existing_images = false;
 
+    // Whether to keep the global bundle adjustment problem alive across the
+    // iterations of the global refinement and to only update the residuals of
+    // changed observations instead of setting up the problem from scratch.
+    bool ba_global_reuse_problem = true;
+
+    // If positive, global bundle adjustment of more registered images is
+    // partitioned into co-visible clusters of at most this number of images,
+    // see `PartitionedBundleAdjuster`.
+    int ba_global_max_num_images_per_partition = 0;
+
     // Number of threads.
     int num_threads = -1;
 
+    // Number of next image candidates, whose poses are estimated concurrently
+    // before they are registered in order of priority.
+    int num_parallel_reg_candidates = 1;
+
+    // Number of initial image pair candidates, whose two-view geometries are
+    // estimated concurrently. The best of the suitable pairs in terms of the
+    // number of inliers and the triangulation angle is used for initialization.
+    int num_parallel_init_pair_candidates = 1;
+
     // Method to find and select next best image to register.
     enum class ImageSelectionMethod {
       MAX_VISIBLE_POINTS_NUM,
@@ -130,6 +157,16 @@ class IncrementalMapper {
     ImageSelectionMethod image_selection_method =
         ImageSelectionMethod::MIN_UNCERTAINTY;
 
+    // Whether the images are the frames of a video in the order of their
+    // names. The next images are then selected by their temporal distance to
+    // the last registered frame and the local bundle is a sliding window of
+    // the last `local_ba_num_images` registered frames.
+    bool sequential = false;
+
+    // Minimum distance in frames of the correspondences between the
+    // registered frames that close a loop in sequential mode.
+    int sequential_loop_min_frame_gap = 30;
+
     bool Check() const;
   };
 
@@ -140,6 +177,21 @@ class IncrementalMapper {
     size_t num_adjusted_observations = 0;
   };
 
+  // The state of the mapper that is not stored in the reconstructions, e.g.,
+  // to resume the reconstruction from a checkpoint. The registrations are
+  // counted over all reconstructions including the current one.
+  struct State {
+    std::unordered_map<image_t, size_t> init_num_reg_trials;
+    std::unordered_set<image_pair_t> init_image_pairs;
+    std::unordered_map<image_t, size_t> num_registrations;
+    std::unordered_set<image_t> filtered_images;
+    std::unordered_map<image_t, size_t> num_reg_trials;
+    std::unordered_set<image_t> existing_image_ids;
+
+    void Write(const std::string& path) const;
+    static State Read(const std::string& path);
+  };
+
   // Create incremental mapper. The database cache must live for the entire
   // life-time of the incremental mapper.
   explicit IncrementalMapper(
@@ -156,6 +208,19 @@ class IncrementalMapper {
   // be updated accordingly.
   void EndReconstruction(bool discard);
 
+  // Get the state of the current reconstruction or restore it after
+  // beginning the reconstruction with the same registered images.
+  State GetState() const;
+  void SetState(const State& state);
+
+  // Accumulate the wall time of the registration, triangulation, bundle
+  // adjustment, track merging/completion, filtering and retriangulation phases
+  // as "<phase>_seconds" counters and the number of registration trials,
+  // bundle adjustment iterations/residuals, and created/merged/filtered
+  // observations in the given metrics. The metrics may be shared between
+  // multiple mappers and must outlive the mapper. Null disables collection.
+  void SetMetrics(Metrics* metrics);
+
   // Find initial image pair to seed the incremental reconstruction. The image
   // pairs should be passed to `RegisterInitialImagePair`. This function
   // automatically ignores image pairs that failed to register previously.
@@ -175,10 +240,24 @@ class IncrementalMapper {
                                 image_t image_id1,
                                 image_t image_id2);
 
+  // Estimate the poses of the given next images concurrently, such that
+  // subsequent calls to `RegisterNextImage` for these images reuse the
+  // estimated poses. The estimates are discarded once any image is
+  // registered, so this function must be called after any other modification
+  // of the reconstruction and right before `RegisterNextImage`.
+  void EstimateNextImagePoses(const Options& options,
+                              const std::vector<image_t>& image_ids);
+
   // Attempt to register image to the existing model. This requires that
   // a previous call to `RegisterInitialImagePair` was successful.
   bool RegisterNextImage(const Options& options, image_t image_id);
 
+  // Whether the registered image closes a loop in sequential mode, i.e., it
+  // has at least `abs_pose_min_num_inliers` correspondences to registered
+  // frames that are at least `sequential_loop_min_frame_gap` frames apart.
+  // Such correspondences are only established by loop detection in matching.
+  bool IsLoopClosure(const Options& options, image_t image_id) const;
+
   // Triangulate observations of image.
   size_t TriangulateImage(const IncrementalTriangulator::Options& tri_options,
                           image_t image_id);
@@ -272,11 +351,36 @@ class IncrementalMapper {
 
   // Find local bundle for given image in the reconstruction. The local bundle
   // is defined as the images that are most connected, i.e. maximum number of
-  // shared 3D points, to the given image.
+  // shared 3D points, to the given image. In sequential mode, the local bundle
+  // is the sliding window of the last registered frames.
   std::vector<image_t> FindLocalBundle(const Options& options,
                                        image_t image_id) const;
 
+  // Create the bundle adjuster for all registered images, with the gauge
+  // fixed by the first two registered images.
+  std::unique_ptr<BundleAdjuster> CreateGlobalBundleAdjuster(
+      const Options& options, const BundleAdjustmentOptions& ba_options) const;
+
+  // Whether global bundle adjustment only refines the 3D points, because all
+  // camera poses and intrinsics are constant. The points are then refined
+  // independently in parallel instead of in a joint problem.
+  bool IsStructureOnlyGlobalBundle(
+      const Options& options, const BundleAdjustmentOptions& ba_options) const;
+
  private:
+  struct NextImagePose {
+    bool success = false;
+    Rigid3d cam_from_world;
+    Camera camera;
+    std::vector<std::pair<point2D_t, point3D_t>> tri_corrs;
+    std::vector<char> inlier_mask;
+  };
+
+  // Estimate the pose of a next image without modifying the reconstruction.
+  bool EstimateNextImagePose(const Options& options,
+                             image_t image_id,
+                             NextImagePose* next_image_pose) const;
+
   // Find seed images for incremental reconstruction. Suitable seed images have
   // a large number of correspondences and have camera calibration priors. The
   // returned list is ordered such that most suitable images are in the front.
@@ -334,10 +438,20 @@ class IncrementalMapper {
   // an upper bound to the number of trials to register an image.
   std::unordered_map<image_t, size_t> num_reg_trials_;
 
+  // Poses of next images estimated in `EstimateNextImagePoses`.
+  std::unordered_map<image_t, NextImagePose> next_image_poses_;
+
   // Images that were registered before beginning the reconstruction.
   // This image list will be non-empty, if the reconstruction is continued from
   // an existing reconstruction.
   std::unordered_set<image_t> existing_image_ids_;
+
+  // The index of each image in the name order of all images, which is the
+  // temporal order of the frames in sequential mode.
+  std::unordered_map<image_t, size_t> frame_idxs_;
+
+  // Optional cumulative timings and counters of the mapper phases.
+  Metrics* metrics_;
 };
 
 }  // namespace colmap
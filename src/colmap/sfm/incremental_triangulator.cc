@@ -32,6 +32,7 @@
 #include "colmap/estimators/triangulation.h"
 #include "colmap/scene/projection.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/profiler.h"
 
 namespace colmap {
 namespace {
@@ -65,6 +66,67 @@ bool TriangulateTrack(
       options_, points, cams_from_world, cameras, &inlier_mask, &xyz);
 }
 
+// Find the (transitive) correspondences of an observation in registered images
+// without bogus camera parameters and return the number of correspondences
+// that are already triangulated.
+template <typename IsBogusCameraFunc>
+size_t FindCorrespondences(
+    const CorrespondenceGraph& correspondence_graph,
+    const Reconstruction& reconstruction,
+    const image_t image_id,
+    const point2D_t point2D_idx,
+    const size_t transitivity,
+    const IsBogusCameraFunc& is_bogus_camera,
+    std::vector<CorrespondenceGraph::Correspondence>* found_corrs,
+    std::vector<IncrementalTriangulator::CorrData>* corrs_data) {
+  // Direct correspondences are read in-place from the finalized graph, only
+  // transitive correspondences need to be collected first.
+  CorrespondenceGraph::CorrespondenceRange corr_range;
+  if (transitivity == 1) {
+    corr_range =
+        correspondence_graph.FindCorrespondences(image_id, point2D_idx);
+  } else {
+    correspondence_graph.ExtractTransitiveCorrespondences(
+        image_id, point2D_idx, transitivity, found_corrs);
+    corr_range.beg = found_corrs->data();
+    corr_range.end = found_corrs->data() + found_corrs->size();
+  }
+
+  corrs_data->clear();
+  corrs_data->reserve(corr_range.end - corr_range.beg);
+
+  size_t num_triangulated = 0;
+
+  for (const auto* corr_it = corr_range.beg; corr_it < corr_range.end;
+       ++corr_it) {
+    const auto& corr = *corr_it;
+    const Image& corr_image = reconstruction.Image(corr.image_id);
+    if (!corr_image.IsRegistered()) {
+      continue;
+    }
+
+    const Camera& corr_camera = reconstruction.Camera(corr_image.CameraId());
+    if (is_bogus_camera(corr_camera)) {
+      continue;
+    }
+
+    IncrementalTriangulator::CorrData corr_data;
+    corr_data.image_id = corr.image_id;
+    corr_data.point2D_idx = corr.point2D_idx;
+    corr_data.image = &corr_image;
+    corr_data.camera = &corr_camera;
+    corr_data.point2D = &corr_image.Point2D(corr.point2D_idx);
+
+    corrs_data->push_back(corr_data);
+
+    if (corr_data.point2D->HasPoint3D()) {
+      num_triangulated += 1;
+    }
+  }
+
+  return num_triangulated;
+}
+
 }  // namespace
 
 bool IncrementalTriangulator::Options::Check() const {
@@ -97,6 +159,7 @@ IncrementalTriangulator::IncrementalTriangulator(
 
 size_t IncrementalTriangulator::TriangulateImage(const Options& options,
                                                  const image_t image_id) {
+  COLMAP_PROFILE_ZONE("IncrementalTriangulator::TriangulateImage");
   THROW_CHECK(options.Check());
 
   size_t num_tris = 0;
@@ -124,6 +187,16 @@ size_t IncrementalTriangulator::TriangulateImage(const Options& options,
   // Container for correspondences from reference observation to other images.
   std::vector<CorrData> corrs_data;
 
+  // New 3D points estimated in parallel for the observations, whose
+  // correspondences are not yet triangulated. An estimate is only used if no
+  // correspondence was triangulated in the meantime, i.e., if the serial
+  // triangulation would estimate the point from the same correspondences.
+  std::vector<std::vector<NewPoint3D>> new_points3D;
+  std::vector<char> has_new_points3D;
+  if (GetEffectiveNumThreads(options.num_threads) > 1) {
+    EstimateImage(options, ref_corr_data, &new_points3D, &has_new_points3D);
+  }
+
   // Try to triangulate all image observations.
   for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
        ++point2D_idx) {
@@ -142,6 +215,11 @@ size_t IncrementalTriangulator::TriangulateImage(const Options& options,
     ref_corr_data.point2D = &point2D;
 
     if (num_triangulated == 0) {
+      if (!has_new_points3D.empty() && has_new_points3D[point2D_idx] &&
+          !point2D.HasPoint3D()) {
+        num_tris += AddPoints3D(&new_points3D[point2D_idx]);
+        continue;
+      }
       corrs_data.push_back(ref_corr_data);
       num_tris += Create(options, corrs_data);
     } else {
@@ -158,6 +236,7 @@ size_t IncrementalTriangulator::TriangulateImage(const Options& options,
 
 size_t IncrementalTriangulator::CompleteImage(const Options& options,
                                               const image_t image_id) {
+  COLMAP_PROFILE_ZONE("IncrementalTriangulator::CompleteImage");
   THROW_CHECK(options.Check());
 
   size_t num_tris = 0;
@@ -241,7 +320,8 @@ size_t IncrementalTriangulator::CompleteImage(const Options& options,
       }
     }
 
-    const point3D_t point3D_id = obs_manager_->AddPoint3D(xyz, track);
+    const point3D_t point3D_id =
+        obs_manager_->AddPoint3D(xyz, std::move(track));
     modified_point3D_ids_.insert(point3D_id);
   }
 
@@ -264,6 +344,7 @@ size_t IncrementalTriangulator::CompleteTracks(
 }
 
 size_t IncrementalTriangulator::CompleteAllTracks(const Options& options) {
+  COLMAP_PROFILE_ZONE("IncrementalTriangulator::CompleteAllTracks");
   THROW_CHECK(options.Check());
 
   size_t num_completed = 0;
@@ -293,6 +374,7 @@ size_t IncrementalTriangulator::MergeTracks(
 }
 
 size_t IncrementalTriangulator::MergeAllTracks(const Options& options) {
+  COLMAP_PROFILE_ZONE("IncrementalTriangulator::MergeAllTracks");
   THROW_CHECK(options.Check());
 
   size_t num_merged = 0;
@@ -307,6 +389,7 @@ size_t IncrementalTriangulator::MergeAllTracks(const Options& options) {
 }
 
 size_t IncrementalTriangulator::Retriangulate(const Options& options) {
+  COLMAP_PROFILE_ZONE("IncrementalTriangulator::Retriangulate");
   THROW_CHECK(options.Check());
 
   size_t num_tris = 0;
@@ -433,7 +516,6 @@ void IncrementalTriangulator::ClearModifiedPoints3D() {
 }
 
 void IncrementalTriangulator::ClearCaches() {
-  camera_has_bogus_params_.clear();
   merge_trials_.clear();
   found_corrs_.clear();
 }
@@ -443,40 +525,17 @@ size_t IncrementalTriangulator::Find(const Options& options,
                                      const point2D_t point2D_idx,
                                      const size_t transitivity,
                                      std::vector<CorrData>* corrs_data) {
-  correspondence_graph_->ExtractTransitiveCorrespondences(
-      image_id, point2D_idx, transitivity, &found_corrs_);
-
-  corrs_data->clear();
-  corrs_data->reserve(found_corrs_.size());
-
-  size_t num_triangulated = 0;
-
-  for (const auto& corr : found_corrs_) {
-    const Image& corr_image = reconstruction_.Image(corr.image_id);
-    if (!corr_image.IsRegistered()) {
-      continue;
-    }
-
-    const Camera& corr_camera = reconstruction_.Camera(corr_image.CameraId());
-    if (HasCameraBogusParams(options, corr_camera)) {
-      continue;
-    }
-
-    CorrData corr_data;
-    corr_data.image_id = corr.image_id;
-    corr_data.point2D_idx = corr.point2D_idx;
-    corr_data.image = &corr_image;
-    corr_data.camera = &corr_camera;
-    corr_data.point2D = &corr_image.Point2D(corr.point2D_idx);
-
-    corrs_data->push_back(corr_data);
-
-    if (corr_data.point2D->HasPoint3D()) {
-      num_triangulated += 1;
-    }
-  }
-
-  return num_triangulated;
+  return FindCorrespondences(
+      *correspondence_graph_,
+      reconstruction_,
+      image_id,
+      point2D_idx,
+      transitivity,
+      [&](const Camera& camera) {
+        return HasCameraBogusParams(options, camera);
+      },
+      &found_corrs_,
+      corrs_data);
 }
 
 size_t IncrementalTriangulator::Create(
@@ -490,17 +549,15 @@ size_t IncrementalTriangulator::Create(
     }
   }
 
-  if (create_corrs_data.size() < 2) {
-    // Need at least two observations for triangulation.
-    return 0;
-  } else if (options.ignore_two_view_tracks && create_corrs_data.size() == 2) {
-    const CorrData& corr_data1 = create_corrs_data[0];
-    if (correspondence_graph_->IsTwoViewObservation(corr_data1.image_id,
-                                                    corr_data1.point2D_idx)) {
-      return 0;
-    }
-  }
+  std::vector<NewPoint3D> new_points3D;
+  Estimate(options, std::move(create_corrs_data), &new_points3D);
+  return AddPoints3D(&new_points3D);
+}
 
+void IncrementalTriangulator::Estimate(
+    const Options& options,
+    std::vector<CorrData> create_corrs_data,
+    std::vector<NewPoint3D>* new_points3D) const {
   // Setup estimation options.
   EstimateTriangulationOptions tri_options;
   tri_options.min_tri_angle = DegToRad(options.min_angle);
@@ -512,34 +569,126 @@ size_t IncrementalTriangulator::Create(
   tri_options.ransac_options.min_inlier_ratio = 0.02;
   tri_options.ransac_options.max_num_trials = 10000;
 
-  // Estimate triangulation.
+  const size_t kMinRecursiveTrackLength = 3;
+
   Eigen::Vector3d xyz;
   std::vector<char> inlier_mask;
-  if (!TriangulateTrack(tri_options, create_corrs_data, inlier_mask, xyz)) {
-    return 0;
-  }
+  std::vector<CorrData> outlier_corrs_data;
+  while (true) {
+    if (create_corrs_data.size() < 2) {
+      // Need at least two observations for triangulation.
+      return;
+    } else if (options.ignore_two_view_tracks &&
+               create_corrs_data.size() == 2) {
+      const CorrData& corr_data1 = create_corrs_data[0];
+      if (correspondence_graph_->IsTwoViewObservation(
+              corr_data1.image_id, corr_data1.point2D_idx)) {
+        return;
+      }
+    }
+
+    // Estimate triangulation.
+    if (!TriangulateTrack(tri_options, create_corrs_data, inlier_mask, xyz)) {
+      return;
+    }
 
-  // Add inliers to estimated track.
-  Track track;
-  track.Reserve(create_corrs_data.size());
-  for (size_t i = 0; i < inlier_mask.size(); ++i) {
-    if (inlier_mask[i]) {
+    // Add inliers to estimated track and recursively triangulate the
+    // remaining outliers.
+    NewPoint3D new_point3D;
+    new_point3D.xyz = xyz;
+    new_point3D.track.Reserve(create_corrs_data.size());
+    outlier_corrs_data.clear();
+    for (size_t i = 0; i < inlier_mask.size(); ++i) {
       const CorrData& corr_data = create_corrs_data[i];
-      track.AddElement(corr_data.image_id, corr_data.point2D_idx);
+      if (inlier_mask[i]) {
+        new_point3D.track.AddElement(corr_data.image_id,
+                                     corr_data.point2D_idx);
+      } else {
+        outlier_corrs_data.push_back(corr_data);
+      }
     }
+    new_points3D->push_back(std::move(new_point3D));
+
+    if (outlier_corrs_data.size() < kMinRecursiveTrackLength) {
+      return;
+    }
+
+    std::swap(create_corrs_data, outlier_corrs_data);
   }
+}
 
-  // Add estimated point to reconstruction.
-  const size_t track_length = track.Length();
-  const point3D_t point3D_id = obs_manager_->AddPoint3D(xyz, track);
-  modified_point3D_ids_.insert(point3D_id);
+size_t IncrementalTriangulator::AddPoints3D(
+    std::vector<NewPoint3D>* new_points3D) {
+  size_t num_tris = 0;
+  for (NewPoint3D& new_point3D : *new_points3D) {
+    num_tris += new_point3D.track.Length();
+    const point3D_t point3D_id = obs_manager_->AddPoint3D(
+        new_point3D.xyz, std::move(new_point3D.track));
+    modified_point3D_ids_.insert(point3D_id);
+  }
+  new_points3D->clear();
+  return num_tris;
+}
 
-  const size_t kMinRecursiveTrackLength = 3;
-  if (create_corrs_data.size() - track_length >= kMinRecursiveTrackLength) {
-    return track_length + Create(options, create_corrs_data);
+void IncrementalTriangulator::EstimateImage(
+    const Options& options,
+    const CorrData& ref_corr_data,
+    std::vector<std::vector<NewPoint3D>>* new_points3D,
+    std::vector<char>* has_new_points3D) {
+  const int num_threads = GetEffectiveNumThreads(options.num_threads);
+  if (thread_pool_ == nullptr ||
+      thread_pool_->NumThreads() != static_cast<size_t>(num_threads)) {
+    thread_pool_ = std::make_unique<ThreadPool>(num_threads);
+  }
+
+  // Update the cache of bogus camera parameters up-front, so that the cache
+  // is only read concurrently.
+  for (const auto& camera : reconstruction_.Cameras()) {
+    HasCameraBogusParams(options, camera.second);
   }
+  const auto is_bogus_camera = [this](const Camera& camera) {
+    return camera_has_bogus_params_.at(camera.camera_id).has_bogus_params;
+  };
+
+  const Image& image = *ref_corr_data.image;
+  const size_t transitivity = static_cast<size_t>(options.max_transitivity);
+
+  new_points3D->clear();
+  new_points3D->resize(image.NumPoints2D());
+  has_new_points3D->clear();
+  has_new_points3D->resize(image.NumPoints2D(), false);
+
+  thread_pool_->ParallelFor(
+      0, image.NumPoints2D(), /*grain_size=*/64, [&](const int64_t idx) {
+        const point2D_t point2D_idx = static_cast<point2D_t>(idx);
+        const Point2D& point2D = image.Point2D(point2D_idx);
+        if (point2D.HasPoint3D()) {
+          return;
+        }
+
+        std::vector<CorrespondenceGraph::Correspondence> found_corrs;
+        std::vector<CorrData> corrs_data;
+        const size_t num_triangulated =
+            FindCorrespondences(*correspondence_graph_,
+                                reconstruction_,
+                                ref_corr_data.image_id,
+                                point2D_idx,
+                                transitivity,
+                                is_bogus_camera,
+                                &found_corrs,
+                                &corrs_data);
+        if (num_triangulated > 0 || corrs_data.empty()) {
+          return;
+        }
+
+        CorrData point_ref_corr_data = ref_corr_data;
+        point_ref_corr_data.point2D_idx = point2D_idx;
+        point_ref_corr_data.point2D = &point2D;
+        corrs_data.push_back(point_ref_corr_data);
 
-  return track_length;
+        Estimate(options, std::move(corrs_data), &(*new_points3D)[idx]);
+        (*has_new_points3D)[idx] = true;
+      });
 }
 
 size_t IncrementalTriangulator::Continue(
@@ -748,17 +897,21 @@ size_t IncrementalTriangulator::Complete(const Options& options,
 
 bool IncrementalTriangulator::HasCameraBogusParams(const Options& options,
                                                    const Camera& camera) {
-  const auto it = camera_has_bogus_params_.find(camera.camera_id);
-  if (it == camera_has_bogus_params_.end()) {
-    const bool has_bogus_params =
+  CameraBogusParams& cached = camera_has_bogus_params_[camera.camera_id];
+  if (cached.params != camera.params ||
+      cached.min_focal_length_ratio != options.min_focal_length_ratio ||
+      cached.max_focal_length_ratio != options.max_focal_length_ratio ||
+      cached.max_extra_param != options.max_extra_param) {
+    cached.params = camera.params;
+    cached.min_focal_length_ratio = options.min_focal_length_ratio;
+    cached.max_focal_length_ratio = options.max_focal_length_ratio;
+    cached.max_extra_param = options.max_extra_param;
+    cached.has_bogus_params =
         camera.HasBogusParams(options.min_focal_length_ratio,
                               options.max_focal_length_ratio,
                               options.max_extra_param);
-    camera_has_bogus_params_.emplace(camera.camera_id, has_bogus_params);
-    return has_bogus_params;
-  } else {
-    return it->second;
   }
+  return cached.has_bogus_params;
 }
 
 }  // namespace colmap
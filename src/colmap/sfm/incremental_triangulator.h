@@ -32,6 +32,7 @@
 #include "colmap/scene/database_cache.h"
 #include "colmap/scene/reconstruction.h"
 #include "colmap/sfm/observation_manager.h"
+#include "colmap/util/threading.h"
 
 #include <memory>
 
@@ -83,6 +84,12 @@ class IncrementalTriangulator {
     double max_focal_length_ratio = 10.0;
     double max_extra_param = 1.0;
 
+    // Number of threads to estimate the new 3D points of an image in
+    // `TriangulateImage`. The points are estimated concurrently for all
+    // observations without triangulated correspondences and then added in
+    // the same order as in the serial triangulation.
+    int num_threads = 1;
+
     bool Check() const;
   };
 
@@ -157,7 +164,8 @@ class IncrementalTriangulator {
   };
 
  private:
-  // Clear cache of bogus camera parameters and merge trials.
+  // Clear cache of merge trials. The cache of bogus camera parameters is kept,
+  // as its entries are invalidated when the camera parameters change.
   void ClearCaches();
 
   // Find (transitive) correspondences to other images.
@@ -171,6 +179,29 @@ class IncrementalTriangulator {
   size_t Create(const Options& options,
                 const std::vector<CorrData>& corrs_data);
 
+  // Estimated 3D point that is not yet added to the reconstruction.
+  struct NewPoint3D {
+    Eigen::Vector3d xyz;
+    Track track;
+  };
+
+  // Estimate the new 3D points for the given untriangulated correspondences
+  // without modifying the reconstruction. The outliers of a triangulation are
+  // recursively triangulated, if enough of them are left.
+  void Estimate(const Options& options,
+                std::vector<CorrData> create_corrs_data,
+                std::vector<NewPoint3D>* new_points3D) const;
+
+  // Add the estimated 3D points to the reconstruction.
+  size_t AddPoints3D(std::vector<NewPoint3D>* new_points3D);
+
+  // Estimate the new 3D points of all observations of the image, whose
+  // correspondences are not yet triangulated, in parallel.
+  void EstimateImage(const Options& options,
+                     const CorrData& ref_corr_data,
+                     std::vector<std::vector<NewPoint3D>>* new_points3D,
+                     std::vector<char>* has_new_points3D);
+
   // Try to continue the 3D point with the given correspondences.
   size_t Continue(const Options& options,
                   const CorrData& ref_corr_data,
@@ -182,7 +213,8 @@ class IncrementalTriangulator {
   // Try to transitively complete the track of a 3D point.
   size_t Complete(const Options& options, point3D_t point3D_id);
 
-  // Check if camera has bogus parameters and cache the result.
+  // Check if camera has bogus parameters and cache the result for the current
+  // parameters of the camera.
   bool HasCameraBogusParams(const Options& options, const Camera& camera);
 
   // Database cache for the reconstruction. Used to retrieve correspondence
@@ -195,8 +227,17 @@ class IncrementalTriangulator {
   // Class that is responsible for keeping track of 3D point statistics.
   std::shared_ptr<ObservationManager> obs_manager_;
 
-  // Cache for cameras with bogus parameters.
-  std::unordered_map<camera_t, bool> camera_has_bogus_params_;
+  // Cache for cameras with bogus parameters. Each result is only valid for
+  // the camera parameters and thresholds it was computed with, because the
+  // parameters are refined by bundle adjustment between triangulations.
+  struct CameraBogusParams {
+    std::vector<double> params;
+    double min_focal_length_ratio = 0;
+    double max_focal_length_ratio = 0;
+    double max_extra_param = 0;
+    bool has_bogus_params = false;
+  };
+  std::unordered_map<camera_t, CameraBogusParams> camera_has_bogus_params_;
 
   // Cache for tried track merges to avoid duplicate merge trials.
   std::unordered_map<point3D_t, std::unordered_set<point3D_t>> merge_trials_;
@@ -210,6 +251,9 @@ class IncrementalTriangulator {
   // Changed 3D points, i.e. if a 3D point is modified (created, continued,
   // deleted, merged, etc.). Cleared once `ModifiedPoints3D` is called.
   std::unordered_set<point3D_t> modified_point3D_ids_;
+
+  // Thread pool for the parallel triangulation of images.
+  std::unique_ptr<ThreadPool> thread_pool_;
 };
 
 }  // namespace colmap
@@ -35,6 +35,7 @@
 #include "colmap/scene/projection.h"
 #include "colmap/util/logging.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/threading.h"
 
 namespace colmap {
 
@@ -50,6 +51,31 @@ bool MergeAndFilterReconstructions(const double max_reproj_error,
   return true;
 }
 
+namespace {
+
+// Minimum number of points, for which the filtering is parallelized.
+constexpr size_t kMinNumPoints3DForParallelFiltering = 10000;
+
+// Split the range [0, num_items) into contiguous chunks and call
+// func(beg, end) for each chunk on a separate thread.
+template <typename Func>
+void ParallelForEachChunk(const size_t num_items, const Func& func) {
+  if (num_items == 0) {
+    return;
+  }
+  const int num_threads = GetEffectiveNumThreads(-1);
+  const size_t chunk_size = (num_items + num_threads - 1) / num_threads;
+  const size_t num_chunks = (num_items + chunk_size - 1) / chunk_size;
+  ThreadPool thread_pool(num_threads);
+  thread_pool.ParallelFor(
+      0, num_chunks, /*grain_size=*/1, [&](const int64_t chunk_idx) {
+        const size_t beg = chunk_idx * chunk_size;
+        func(beg, std::min(beg + chunk_size, num_items));
+      });
+}
+
+}  // namespace
+
 const int ObservationManager::kNumPoint3DVisibilityPyramidLevels = 6;
 
 ObservationManager::ObservationManager(
@@ -111,6 +137,9 @@ void ObservationManager::IncrementCorrespondenceHasPoint3D(
   stats.num_correspondences_have_point3D[point2D_idx] += 1;
   if (stats.num_correspondences_have_point3D[point2D_idx] == 1) {
     stats.num_visible_points3D += 1;
+    if (stats.num_visible_points3D == 1) {
+      images_with_visible_points3D_.insert(image_id);
+    }
   }
 
   stats.point3D_visibility_pyramid.SetPoint(point2D.xy(0), point2D.xy(1));
@@ -127,6 +156,9 @@ void ObservationManager::DecrementCorrespondenceHasPoint3D(
   stats.num_correspondences_have_point3D[point2D_idx] -= 1;
   if (stats.num_correspondences_have_point3D[point2D_idx] == 0) {
     stats.num_visible_points3D -= 1;
+    if (stats.num_visible_points3D == 0) {
+      images_with_visible_points3D_.erase(image_id);
+    }
   }
 
   stats.point3D_visibility_pyramid.ResetPoint(point2D.xy(0), point2D.xy(1));
@@ -199,12 +231,14 @@ void ObservationManager::ResetTriObservations(const image_t image_id,
 }
 
 point3D_t ObservationManager::AddPoint3D(const Eigen::Vector3d& xyz,
-                                         const Track& track,
+                                         Track track,
                                          const Eigen::Vector3ub& color) {
-  const point3D_t point3D_id = reconstruction_.AddPoint3D(xyz, track, color);
+  const point3D_t point3D_id =
+      reconstruction_.AddPoint3D(xyz, std::move(track), color);
 
   const bool kIsContinuedPoint3D = false;
-  for (const auto& track_el : track.Elements()) {
+  for (const auto& track_el :
+       reconstruction_.Point3D(point3D_id).track.Elements()) {
     SetObservationAsTriangulated(
         track_el.image_id, track_el.point2D_idx, kIsContinuedPoint3D);
   }
@@ -310,8 +344,13 @@ size_t ObservationManager::FilterAllPoints3D(const double max_reproj_error,
   // Important: First filter observations and points with large reprojection
   // error, so that observations with large reprojection error do not make
   // a point stable through a large triangulation angle.
-  const std::unordered_set<point3D_t>& point3D_ids =
-      reconstruction_.Point3DIds();
+  // Collect the identifiers by a linear scan over the points, which avoids
+  // building a hash set of all points in large reconstructions.
+  std::vector<point3D_t> point3D_ids;
+  point3D_ids.reserve(reconstruction_.NumPoints3D());
+  for (const auto& point3D : reconstruction_.Points3D()) {
+    point3D_ids.push_back(point3D.first);
+  }
   size_t num_filtered = 0;
   num_filtered +=
       FilterPoints3DWithLargeReprojectionError(max_reproj_error, point3D_ids);
@@ -321,20 +360,46 @@ size_t ObservationManager::FilterAllPoints3D(const double max_reproj_error,
 }
 
 size_t ObservationManager::FilterObservationsWithNegativeDepth() {
+  const std::vector<image_t>& reg_image_ids = reconstruction_.RegImageIds();
+
+  // Find the observations with negative depth for each image.
+  std::vector<std::vector<point2D_t>> negative_depth_point2D_idxs(
+      reg_image_ids.size());
+  const auto FindNegativeDepthPoints2D = [&](const size_t beg,
+                                             const size_t end) {
+    for (size_t i = beg; i < end; ++i) {
+      const Image& image = reconstruction_.Image(reg_image_ids[i]);
+      const Eigen::Matrix3x4d cam_from_world = image.CamFromWorld().ToMatrix();
+      for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
+           ++point2D_idx) {
+        const Point2D& point2D = image.Point2D(point2D_idx);
+        if (point2D.HasPoint3D()) {
+          const struct Point3D& point3D =
+              reconstruction_.Point3D(point2D.point3D_id);
+          if (!HasPointPositiveDepth(cam_from_world, point3D.xyz)) {
+            negative_depth_point2D_idxs[i].push_back(point2D_idx);
+          }
+        }
+      }
+    }
+  };
+
+  if (reconstruction_.NumPoints3D() >= kMinNumPoints3DForParallelFiltering) {
+    ParallelForEachChunk(reg_image_ids.size(), FindNegativeDepthPoints2D);
+  } else {
+    FindNegativeDepthPoints2D(0, reg_image_ids.size());
+  }
+
+  // Deleting an observation can delete the entire 3D point and thereby
+  // other observations, so they must be checked again.
   size_t num_filtered = 0;
-  for (const auto image_id : reconstruction_.RegImageIds()) {
+  for (size_t i = 0; i < reg_image_ids.size(); ++i) {
+    const image_t image_id = reg_image_ids[i];
     const Image& image = reconstruction_.Image(image_id);
-    const Eigen::Matrix3x4d cam_from_world = image.CamFromWorld().ToMatrix();
-    for (point2D_t point2D_idx = 0; point2D_idx < image.NumPoints2D();
-         ++point2D_idx) {
-      const Point2D& point2D = image.Point2D(point2D_idx);
-      if (point2D.HasPoint3D()) {
-        const struct Point3D& point3D =
-            reconstruction_.Point3D(point2D.point3D_id);
-        if (!HasPointPositiveDepth(cam_from_world, point3D.xyz)) {
-          DeleteObservation(image_id, point2D_idx);
-          num_filtered += 1;
-        }
+    for (const point2D_t point2D_idx : negative_depth_point2D_idxs[i]) {
+      if (image.Point2D(point2D_idx).HasPoint3D()) {
+        DeleteObservation(image_id, point2D_idx);
+        num_filtered += 1;
       }
     }
   }
@@ -344,60 +409,87 @@ size_t ObservationManager::FilterObservationsWithNegativeDepth() {
 size_t ObservationManager::FilterPoints3DWithSmallTriangulationAngle(
     const double min_tri_angle,
     const std::unordered_set<point3D_t>& point3D_ids) {
+  return FilterPoints3DWithSmallTriangulationAngle(
+      min_tri_angle,
+      std::vector<point3D_t>(point3D_ids.begin(), point3D_ids.end()));
+}
+
+size_t ObservationManager::FilterPoints3DWithSmallTriangulationAngle(
+    const double min_tri_angle, const std::vector<point3D_t>& point3D_ids) {
   // Number of filtered points.
   size_t num_filtered = 0;
 
   // Minimum triangulation angle in radians.
   const double min_tri_angle_rad = DegToRad(min_tri_angle);
 
+  // Calculate triangulation angle for all pairwise combinations of image
+  // poses in the track. Only delete point if none of the combinations
+  // has a sufficient triangulation angle.
+  const auto HasSufficientTriangulationAngle =
+      [this, min_tri_angle_rad](
+          const struct Point3D& point3D,
+          std::unordered_map<image_t, Eigen::Vector3d>* proj_centers) {
+        for (size_t i1 = 0; i1 < point3D.track.Length(); ++i1) {
+          const image_t image_id1 = point3D.track.Element(i1).image_id;
+
+          auto proj_center1_it = proj_centers->find(image_id1);
+          if (proj_center1_it == proj_centers->end()) {
+            const Image& image1 = reconstruction_.Image(image_id1);
+            proj_center1_it =
+                proj_centers->emplace(image_id1, image1.ProjectionCenter())
+                    .first;
+          }
+          const Eigen::Vector3d proj_center1 = proj_center1_it->second;
+
+          for (size_t i2 = 0; i2 < i1; ++i2) {
+            const image_t image_id2 = point3D.track.Element(i2).image_id;
+            const Eigen::Vector3d proj_center2 = proj_centers->at(image_id2);
+
+            const double tri_angle = CalculateTriangulationAngle(
+                proj_center1, proj_center2, point3D.xyz);
+
+            if (tri_angle >= min_tri_angle_rad) {
+              return true;
+            }
+          }
+        }
+        return false;
+      };
+
+  // The decision for each point only depends on its own track, so it can be
+  // made for many points in parallel before deleting points serially.
+  std::vector<char> keep_points;
+  if (point3D_ids.size() >= kMinNumPoints3DForParallelFiltering) {
+    keep_points.resize(point3D_ids.size());
+    ParallelForEachChunk(
+        point3D_ids.size(), [&](const size_t beg, const size_t end) {
+          std::unordered_map<image_t, Eigen::Vector3d> proj_centers;
+          for (size_t i = beg; i < end; ++i) {
+            keep_points[i] =
+                !reconstruction_.ExistsPoint3D(point3D_ids[i]) ||
+                HasSufficientTriangulationAngle(
+                    reconstruction_.Point3D(point3D_ids[i]), &proj_centers);
+          }
+        });
+  }
+
   // Cache for image projection centers.
   std::unordered_map<image_t, Eigen::Vector3d> proj_centers;
 
-  for (const auto point3D_id : point3D_ids) {
-    if (!reconstruction_.ExistsPoint3D(point3D_id)) {
-      continue;
-    }
-
-    const struct Point3D& point3D = reconstruction_.Point3D(point3D_id);
-
-    // Calculate triangulation angle for all pairwise combinations of image
-    // poses in the track. Only delete point if none of the combinations
-    // has a sufficient triangulation angle.
-    bool keep_point = false;
-    for (size_t i1 = 0; i1 < point3D.track.Length(); ++i1) {
-      const image_t image_id1 = point3D.track.Element(i1).image_id;
-
-      Eigen::Vector3d proj_center1;
-      if (proj_centers.count(image_id1) == 0) {
-        const Image& image1 = reconstruction_.Image(image_id1);
-        proj_center1 = image1.ProjectionCenter();
-        proj_centers.emplace(image_id1, proj_center1);
-      } else {
-        proj_center1 = proj_centers.at(image_id1);
-      }
-
-      for (size_t i2 = 0; i2 < i1; ++i2) {
-        const image_t image_id2 = point3D.track.Element(i2).image_id;
-        const Eigen::Vector3d proj_center2 = proj_centers.at(image_id2);
-
-        const double tri_angle = CalculateTriangulationAngle(
-            proj_center1, proj_center2, point3D.xyz);
-
-        if (tri_angle >= min_tri_angle_rad) {
-          keep_point = true;
-          break;
-        }
-      }
-
-      if (keep_point) {
-        break;
+  for (size_t i = 0; i < point3D_ids.size(); ++i) {
+    const point3D_t point3D_id = point3D_ids[i];
+    if (keep_points.empty()) {
+      if (!reconstruction_.ExistsPoint3D(point3D_id) ||
+          HasSufficientTriangulationAngle(reconstruction_.Point3D(point3D_id),
+                                          &proj_centers)) {
+        continue;
       }
+    } else if (keep_points[i]) {
+      continue;
     }
 
-    if (!keep_point) {
-      num_filtered += 1;
-      DeletePoint3D(point3D_id);
-    }
+    num_filtered += 1;
+    DeletePoint3D(point3D_id);
   }
 
   return num_filtered;
@@ -406,12 +498,66 @@ size_t ObservationManager::FilterPoints3DWithSmallTriangulationAngle(
 size_t ObservationManager::FilterPoints3DWithLargeReprojectionError(
     const double max_reproj_error,
     const std::unordered_set<point3D_t>& point3D_ids) {
+  return FilterPoints3DWithLargeReprojectionError(
+      max_reproj_error,
+      std::vector<point3D_t>(point3D_ids.begin(), point3D_ids.end()));
+}
+
+size_t ObservationManager::FilterPoints3DWithLargeReprojectionError(
+    const double max_reproj_error, const std::vector<point3D_t>& point3D_ids) {
   const double max_squared_reproj_error = max_reproj_error * max_reproj_error;
 
   // Number of filtered points.
   size_t num_filtered = 0;
 
-  for (const auto point3D_id : point3D_ids) {
+  // Most points have no observation with large reprojection error, so their
+  // mean error is computed in parallel beforehand and only the remaining
+  // points are filtered serially. A negative error marks remaining points.
+  std::vector<double> mean_reproj_errors;
+  if (point3D_ids.size() >= kMinNumPoints3DForParallelFiltering) {
+    mean_reproj_errors.resize(point3D_ids.size(), -1);
+    ParallelForEachChunk(
+        point3D_ids.size(), [&](const size_t beg, const size_t end) {
+          for (size_t i = beg; i < end; ++i) {
+            if (!reconstruction_.ExistsPoint3D(point3D_ids[i])) {
+              continue;
+            }
+            const struct Point3D& point3D =
+                reconstruction_.Point3D(point3D_ids[i]);
+            if (point3D.track.Length() < 2) {
+              continue;
+            }
+            double reproj_error_sum = 0.0;
+            bool has_large_reproj_error = false;
+            for (const auto& track_el : point3D.track.Elements()) {
+              const Image& image = reconstruction_.Image(track_el.image_id);
+              const struct Camera& camera =
+                  reconstruction_.Camera(image.CameraId());
+              const Point2D& point2D = image.Point2D(track_el.point2D_idx);
+              const double squared_reproj_error =
+                  CalculateSquaredReprojectionError(
+                      point2D.xy, point3D.xyz, image.CamFromWorld(), camera);
+              if (squared_reproj_error > max_squared_reproj_error) {
+                has_large_reproj_error = true;
+                break;
+              }
+              reproj_error_sum += std::sqrt(squared_reproj_error);
+            }
+            if (!has_large_reproj_error) {
+              mean_reproj_errors[i] =
+                  reproj_error_sum / point3D.track.Length();
+            }
+          }
+        });
+  }
+
+  for (size_t i = 0; i < point3D_ids.size(); ++i) {
+    const point3D_t point3D_id = point3D_ids[i];
+    if (!mean_reproj_errors.empty() && mean_reproj_errors[i] >= 0) {
+      reconstruction_.Point3D(point3D_id).error = mean_reproj_errors[i];
+      continue;
+    }
+
     if (!reconstruction_.ExistsPoint3D(point3D_id)) {
       continue;
     }
@@ -465,6 +611,24 @@ void ObservationManager::DeRegisterImage(const image_t image_id) {
     }
   }
   reconstruction_.DeRegisterImage(image_id);
+
+  // The image might have been removed as a registered image before.
+  if (image_stats_.at(image_id).num_visible_points3D > 0) {
+    images_with_visible_points3D_.insert(image_id);
+  }
+}
+
+const std::unordered_set<image_t>&
+ObservationManager::UnregisteredImagesWithVisiblePoints3D() {
+  for (auto it = images_with_visible_points3D_.begin();
+       it != images_with_visible_points3D_.end();) {
+    if (reconstruction_.Image(*it).IsRegistered()) {
+      it = images_with_visible_points3D_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return images_with_visible_points3D_;
 }
 
 std::vector<image_t> ObservationManager::FilterImages(
@@ -60,7 +60,7 @@ class ObservationManager {
   // Add new 3D object, and return its unique ID.
   point3D_t AddPoint3D(
       const Eigen::Vector3d& xyz,
-      const Track& track,
+      Track track,
       const Eigen::Vector3ub& color = Eigen::Vector3ub::Zero());
 
   // Add observation to existing 3D point.
@@ -132,6 +132,13 @@ class ObservationManager {
   // uniform distribution of observations results in more robust registration.
   inline size_t Point3DVisibilityScore(image_t image_id) const;
 
+  // Get the unregistered images that see at least one triangulated point, i.e.
+  // the candidates for the next image to register. The set is maintained
+  // incrementally as points are triangulated or deleted, and registered images
+  // are lazily removed, so the cost is independent of the number of images.
+  // This assumes that images are de-registered through `DeRegisterImage`.
+  const std::unordered_set<image_t>& UnregisteredImagesWithVisiblePoints3D();
+
   // The number of levels in the 3D point multi-resolution visibility pyramid.
   static const int kNumPoint3DVisibilityPyramidLevels;
 
@@ -148,6 +155,11 @@ class ObservationManager {
                                          point2D_t point2D_idx);
 
  private:
+  size_t FilterPoints3DWithSmallTriangulationAngle(
+      double min_tri_angle, const std::vector<point3D_t>& point3D_ids);
+  size_t FilterPoints3DWithLargeReprojectionError(
+      double max_reproj_error, const std::vector<point3D_t>& point3D_ids);
+
   void SetObservationAsTriangulated(image_t image_id,
                                     point2D_t point2D_idx,
                                     bool is_continued_point3D);
@@ -180,6 +192,10 @@ class ObservationManager {
   const std::shared_ptr<const CorrespondenceGraph> correspondence_graph_;
   std::unordered_map<image_pair_t, ImagePairStat> image_pair_stats_;
   std::unordered_map<image_t, ImageStat> image_stats_;
+
+  // Images with `num_visible_points3D > 0`, which may contain registered
+  // images, see `UnregisteredImagesWithVisiblePoints3D`.
+  std::unordered_set<image_t> images_with_visible_points3D_;
 };
 
 const std::unordered_map<image_pair_t, ObservationManager::ImagePairStat>&
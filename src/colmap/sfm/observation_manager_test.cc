@@ -251,6 +251,52 @@ TEST(ObservationManager, NumVisiblePoints3D) {
   EXPECT_EQ(obs_manager.NumVisiblePoints3D(kImageId1), 0);
 }
 
+TEST(ObservationManager, UnregisteredImagesWithVisiblePoints3D) {
+  Reconstruction reconstruction;
+  const image_t kImageId1 = 1;
+  const image_t kImageId2 = 2;
+  const camera_t kCameraId = 1;
+  const Camera camera = Camera::CreateFromModelId(kCameraId,
+                                                  CameraModelId::kPinhole,
+                                                  /*focal_length=*/10,
+                                                  /*width=*/10,
+                                                  /*height=*/10);
+  reconstruction.AddCamera(camera);
+  Image image;
+  image.SetImageId(kImageId1);
+  image.SetCameraId(kCameraId);
+  image.SetPoints2D(std::vector<Eigen::Vector2d>(10));
+  reconstruction.AddImage(image);
+  image.SetImageId(kImageId2);
+  reconstruction.AddImage(image);
+  auto correspondence_graph = std::make_shared<CorrespondenceGraph>();
+  correspondence_graph->AddImage(kImageId1, 10);
+  correspondence_graph->AddImage(kImageId2, 10);
+  FeatureMatches matches;
+  for (size_t i = 0; i < 10; ++i) {
+    matches.emplace_back(i, i);
+  }
+  correspondence_graph->AddCorrespondences(kImageId1, kImageId2, matches);
+  correspondence_graph->Finalize();
+  ObservationManager obs_manager(reconstruction, correspondence_graph);
+
+  using ImageIdSet = std::unordered_set<image_t>;
+  EXPECT_EQ(obs_manager.UnregisteredImagesWithVisiblePoints3D(), ImageIdSet());
+  obs_manager.IncrementCorrespondenceHasPoint3D(kImageId1, 0);
+  obs_manager.IncrementCorrespondenceHasPoint3D(kImageId2, 0);
+  EXPECT_EQ(obs_manager.UnregisteredImagesWithVisiblePoints3D(),
+            ImageIdSet({kImageId1, kImageId2}));
+  reconstruction.RegisterImage(kImageId1);
+  EXPECT_EQ(obs_manager.UnregisteredImagesWithVisiblePoints3D(),
+            ImageIdSet({kImageId2}));
+  obs_manager.DeRegisterImage(kImageId1);
+  EXPECT_EQ(obs_manager.UnregisteredImagesWithVisiblePoints3D(),
+            ImageIdSet({kImageId1, kImageId2}));
+  obs_manager.DecrementCorrespondenceHasPoint3D(kImageId2, 0);
+  EXPECT_EQ(obs_manager.UnregisteredImagesWithVisiblePoints3D(),
+            ImageIdSet({kImageId1}));
+}
+
 TEST(ObservationManager, Point3DVisibilityScore) {
   Reconstruction reconstruction;
   const image_t kImageId1 = 1;
@@ -99,8 +99,10 @@ void TwoViewInfoTab::ShowMatches() {
   matches_viewer_widget_->setWindowTitle(QString::fromStdString(
       "Matches for image pair " + std::to_string(image_->ImageId()) + " - " +
       std::to_string(selection.first->ImageId())));
+  const auto matches =
+      ReadMatches(image_->ImageId(), selection.first->ImageId());
   matches_viewer_widget_->ReadAndShowWithMatches(
-      path1, path2, keypoints1, keypoints2, selection.second);
+      path1, path2, keypoints1, keypoints2, matches);
 }
 
 void TwoViewInfoTab::FillTable() {
@@ -111,8 +113,7 @@ void TwoViewInfoTab::FillTable() {
   std::sort(sorted_matches_idxs_.begin(),
             sorted_matches_idxs_.end(),
             [&](const size_t idx1, const size_t idx2) {
-              return matches_[idx1].second.size() >
-                     matches_[idx2].second.size();
+              return matches_[idx1].second > matches_[idx2].second;
             });
 
   QString info;
@@ -130,7 +131,7 @@ void TwoViewInfoTab::FillTable() {
     table_widget_->setItem(i, 0, image_id_item);
 
     QTableWidgetItem* num_matches_item =
-        new QTableWidgetItem(QString::number(matches_[idx].second.size()));
+        new QTableWidgetItem(QString::number(matches_[idx].second));
     table_widget_->setItem(i, 1, num_matches_item);
 
     // config for inlier matches tab
@@ -144,40 +145,68 @@ void TwoViewInfoTab::FillTable() {
   table_widget_->resizeColumnsToContents();
 }
 
-MatchesTab::MatchesTab(QWidget* parent,
-                       OptionManager* options,
-                       Database* database)
-    : TwoViewInfoTab(parent, options, database) {
-  QStringList table_header;
-  table_header << "image_id"
-               << "num_matches";
-  InitializeTable(table_header);
-}
-
-void MatchesTab::Reload(const std::vector<Image>& images,
-                        const image_t image_id) {
+void TwoViewInfoTab::CollectMatchedImages(
+    const std::vector<Image>& images,
+    const image_t image_id,
+    const std::vector<std::pair<image_t, image_t>>& image_pairs,
+    const std::vector<int>& num_matches,
+    const std::vector<int>& configs) {
   matches_.clear();
+  configs_.clear();
 
-  // Find all matched images
-
+  std::unordered_map<image_t, const Image*> images_by_id;
   for (const auto& image : images) {
     if (image.ImageId() == image_id) {
       image_ = &image;
-      continue;
+    } else {
+      images_by_id.emplace(image.ImageId(), &image);
     }
+  }
 
-    if (database_->ExistsMatches(image_id, image.ImageId())) {
-      const auto matches = database_->ReadMatches(image_id, image.ImageId());
+  for (size_t i = 0; i < image_pairs.size(); ++i) {
+    image_t other_image_id;
+    if (image_pairs[i].first == image_id) {
+      other_image_id = image_pairs[i].second;
+    } else if (image_pairs[i].second == image_id) {
+      other_image_id = image_pairs[i].first;
+    } else {
+      continue;
+    }
 
-      if (matches.size() > 0) {
-        matches_.emplace_back(&image, matches);
+    const auto other_image = images_by_id.find(other_image_id);
+    if (num_matches[i] > 0 && other_image != images_by_id.end()) {
+      matches_.emplace_back(other_image->second, num_matches[i]);
+      if (!configs.empty()) {
+        configs_.push_back(configs[i]);
       }
     }
   }
+}
+
+MatchesTab::MatchesTab(QWidget* parent,
+                       OptionManager* options,
+                       Database* database)
+    : TwoViewInfoTab(parent, options, database) {
+  QStringList table_header;
+  table_header << "image_id"
+               << "num_matches";
+  InitializeTable(table_header);
+}
 
+void MatchesTab::Reload(const std::vector<Image>& images,
+                        const image_t image_id) {
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<int> num_matches;
+  database_->ReadNumMatches(&image_pairs, &num_matches);
+  CollectMatchedImages(images, image_id, image_pairs, num_matches, {});
   FillTable();
 }
 
+FeatureMatches MatchesTab::ReadMatches(const image_t image_id1,
+                                       const image_t image_id2) const {
+  return database_->ReadMatches(image_id1, image_id2);
+}
+
 TwoViewGeometriesTab::TwoViewGeometriesTab(QWidget* parent,
                                            OptionManager* options,
                                            Database* database)
@@ -191,31 +220,20 @@ TwoViewGeometriesTab::TwoViewGeometriesTab(QWidget* parent,
 
 void TwoViewGeometriesTab::Reload(const std::vector<Image>& images,
                                   const image_t image_id) {
-  matches_.clear();
-  configs_.clear();
-
-  // Find all matched images.
-
-  for (const auto& image : images) {
-    if (image.ImageId() == image_id) {
-      image_ = &image;
-      continue;
-    }
-
-    if (database_->ExistsInlierMatches(image_id, image.ImageId())) {
-      const auto two_view_geometry =
-          database_->ReadTwoViewGeometry(image_id, image.ImageId());
-
-      if (two_view_geometry.inlier_matches.size() > 0) {
-        matches_.emplace_back(&image, two_view_geometry.inlier_matches);
-        configs_.push_back(two_view_geometry.config);
-      }
-    }
-  }
-
+  std::vector<std::pair<image_t, image_t>> image_pairs;
+  std::vector<int> num_inliers;
+  std::vector<int> configs;
+  database_->ReadTwoViewGeometryNumInliers(
+      &image_pairs, &num_inliers, &configs);
+  CollectMatchedImages(images, image_id, image_pairs, num_inliers, configs);
   FillTable();
 }
 
+FeatureMatches TwoViewGeometriesTab::ReadMatches(
+    const image_t image_id1, const image_t image_id2) const {
+  return database_->ReadTwoViewGeometry(image_id1, image_id2).inlier_matches;
+}
+
 OverlappingImagesWidget::OverlappingImagesWidget(QWidget* parent,
                                                  OptionManager* options,
                                                  Database* database)
@@ -56,11 +56,24 @@ class TwoViewInfoTab : public QWidget {
   void ShowMatches();
   void FillTable();
 
+  // Collect the images matched to the given image from the number of matches
+  // of all image pairs, so that the matches are only read when shown.
+  void CollectMatchedImages(
+      const std::vector<Image>& images,
+      image_t image_id,
+      const std::vector<std::pair<image_t, image_t>>& image_pairs,
+      const std::vector<int>& num_matches,
+      const std::vector<int>& configs);
+
+  // Read the matches of an image pair for display.
+  virtual FeatureMatches ReadMatches(image_t image_id1,
+                                     image_t image_id2) const = 0;
+
   OptionManager* options_;
   Database* database_;
 
   const Image* image_;
-  std::vector<std::pair<const Image*, FeatureMatches>> matches_;
+  std::vector<std::pair<const Image*, int>> matches_;
   std::vector<int> configs_;
   std::vector<size_t> sorted_matches_idxs_;
 
@@ -74,6 +87,10 @@ class MatchesTab : public TwoViewInfoTab {
   MatchesTab(QWidget* parent, OptionManager* options, Database* database);
 
   void Reload(const std::vector<Image>& images, image_t image_id);
+
+ protected:
+  FeatureMatches ReadMatches(image_t image_id1,
+                             image_t image_id2) const override;
 };
 
 class TwoViewGeometriesTab : public TwoViewInfoTab {
@@ -83,6 +100,10 @@ class TwoViewGeometriesTab : public TwoViewInfoTab {
                        Database* database);
 
   void Reload(const std::vector<Image>& images, image_t image_id);
+
+ protected:
+  FeatureMatches ReadMatches(image_t image_id1,
+                             image_t image_id2) const override;
 };
 
 class OverlappingImagesWidget : public QWidget {
@@ -54,7 +54,10 @@ class StereoOptionsTab : public OptionsWidget {
 
     AddOptionInt(
         &options->patch_match_stereo->max_image_size, "max_image_size", -1);
+    AddOptionBool(&options->patch_match_stereo->use_gpu, "use_gpu");
     AddOptionText(&options->patch_match_stereo->gpu_index, "gpu_index");
+    AddOptionInt(
+        &options->patch_match_stereo->num_threads, "num_threads", -1);
     AddOptionDouble(&options->patch_match_stereo->depth_min, "depth_min", -1);
     AddOptionDouble(&options->patch_match_stereo->depth_max, "depth_max", -1);
     AddOptionInt(&options->patch_match_stereo->window_radius, "window_radius");
@@ -70,12 +73,26 @@ class StereoOptionsTab : public OptionsWidget {
                     "incident_angle_sigma");
     AddOptionInt(&options->patch_match_stereo->num_iterations,
                  "num_iterations");
+    AddOptionInt(&options->patch_match_stereo->num_pyramid_levels,
+                 "num_pyramid_levels");
+    AddOptionInt(&options->patch_match_stereo->pyramid_num_iterations,
+                 "pyramid_num_iterations");
+    AddOptionBool(&options->patch_match_stereo->init_from_sparse_points,
+                  "init_from_sparse_points");
     AddOptionBool(&options->patch_match_stereo->geom_consistency,
                   "geom_consistency");
     AddOptionDouble(&options->patch_match_stereo->geom_consistency_regularizer,
                     "geom_consistency_regularizer");
     AddOptionDouble(&options->patch_match_stereo->geom_consistency_max_cost,
                     "geom_consistency_max_cost");
+    AddOptionBool(&options->patch_match_stereo->half_precision_depth_maps,
+                  "half_precision_depth_maps");
+    AddOptionDouble(&options->patch_match_stereo->gpu_depth_map_cache_size,
+                    "gpu_depth_map_cache_size [gigabytes]",
+                    0,
+                    std::numeric_limits<double>::max(),
+                    0.1,
+                    1);
     AddOptionBool(&options->patch_match_stereo->filter, "filter");
     AddOptionDouble(&options->patch_match_stereo->filter_min_ncc,
                     "filter_min_ncc");
@@ -95,6 +112,16 @@ class StereoOptionsTab : public OptionsWidget {
                     1);
     AddOptionBool(&options->patch_match_stereo->write_consistency_graph,
                   "write_consistency_graph");
+    AddOptionBool(&options->patch_match_stereo->write_compressed_maps,
+                  "write_compressed_maps");
+    AddOptionBool(&options->patch_match_stereo->scored_src_image_selection,
+                  "scored_src_image_selection");
+    AddOptionDouble(&options->patch_match_stereo->src_image_min_score_ratio,
+                    "src_image_min_score_ratio",
+                    0,
+                    1);
+    AddOptionInt(&options->patch_match_stereo->tile_size, "tile_size", -1);
+    AddOptionInt(&options->patch_match_stereo->tile_overlap, "tile_overlap");
   }
 };
 
@@ -126,6 +153,13 @@ class FusionOptionsTab : public OptionsWidget {
                     0.1,
                     1);
     AddOptionBool(&options->stereo_fusion->use_cache, "use_cache");
+    AddOptionBool(&options->stereo_fusion->use_gpu, "use_gpu");
+    AddOptionInt(&options->stereo_fusion->gpu_index, "gpu_index", -1);
+    AddOptionBool(&options->stereo_fusion->use_consistency_graph,
+                  "use_consistency_graph");
+    AddOptionInt(&options->stereo_fusion->max_num_concurrent_images,
+                 "max_num_concurrent_images",
+                 1);
   }
 };
 
@@ -139,6 +173,12 @@ class MeshingOptionsTab : public OptionsWidget {
     AddOptionDouble(&options->poisson_meshing->color, "color", 0);
     AddOptionDouble(&options->poisson_meshing->trim, "trim", 0);
     AddOptionInt(&options->poisson_meshing->num_threads, "num_threads", -1);
+    AddOptionDouble(&options->poisson_meshing->downsample_voxel_size,
+                    "downsample_voxel_size",
+                    0);
+    AddOptionDouble(&options->poisson_meshing->tile_size, "tile_size", 0);
+    AddOptionDouble(
+        &options->poisson_meshing->tile_overlap, "tile_overlap", 0, 1);
 
     AddSection("Delaunay Meshing");
     AddOptionDouble(
@@ -158,6 +198,12 @@ class MeshingOptionsTab : public OptionsWidget {
                     "max_side_length_percentile",
                     0);
     AddOptionInt(&options->delaunay_meshing->num_threads, "num_threads", -1);
+    AddOptionDouble(&options->delaunay_meshing->downsample_voxel_size,
+                    "downsample_voxel_size",
+                    0);
+    AddOptionDouble(&options->delaunay_meshing->tile_size, "tile_size", 0);
+    AddOptionDouble(
+        &options->delaunay_meshing->tile_overlap, "tile_overlap", 0, 1);
   }
 };
 
@@ -379,7 +425,6 @@ void DenseReconstructionWidget::Stereo() {
     return;
   }
 
-#if defined(COLMAP_CUDA_ENABLED)
   auto processor =
       std::make_unique<ControllerThread<mvs::PatchMatchController>>(
           std::make_shared<mvs::PatchMatchController>(
@@ -387,12 +432,6 @@ void DenseReconstructionWidget::Stereo() {
   processor->AddCallback(Thread::FINISHED_CALLBACK,
                          [this]() { refresh_workspace_action_->trigger(); });
   thread_control_widget_->StartThread("Stereo...", true, std::move(processor));
-#else
-  QMessageBox::critical(this,
-                        "",
-                        tr("Dense stereo reconstruction requires CUDA, which "
-                           "is not available on your system."));
-#endif
 }
 
 void DenseReconstructionWidget::Fusion() {
@@ -147,7 +147,8 @@ void ImportFeaturesWidget::Run() {
   reader_options.database_path = *options_->database_path;
   reader_options.image_path = *options_->image_path;
 
-  auto importer = CreateFeatureImporterController(reader_options, import_path_);
+  auto importer = CreateFeatureImporterController(
+      reader_options, import_path_, options_->sift_extraction->num_threads);
   thread_control_widget_->StartThread(
       "Importing...", true, std::move(importer));
 }
@@ -108,6 +108,8 @@ void FeatureMatchingTab::CreateGeneralOptions() {
   options_widget_->AddOptionBool(&options_->sift_matching->use_gpu, "use_gpu");
   options_widget_->AddOptionText(&options_->sift_matching->gpu_index,
                                  "gpu_index");
+  options_widget_->AddOptionInt(
+      &options_->sift_matching->num_matchers_per_gpu, "num_matchers_per_gpu");
   options_widget_->AddOptionDouble(&options_->sift_matching->max_ratio,
                                    "max_ratio");
   options_widget_->AddOptionDouble(&options_->sift_matching->max_distance,
@@ -179,6 +181,8 @@ SequentialMatchingTab::SequentialMatchingTab(QWidget* parent,
                                 "overlap");
   options_widget_->AddOptionBool(
       &options_->sequential_matching->quadratic_overlap, "quadratic_overlap");
+  options_widget_->AddOptionBool(&options_->sequential_matching->online,
+                                 "online");
   options_widget_->AddOptionBool(&options_->sequential_matching->loop_detection,
                                  "loop_detection");
   options_widget_->AddOptionInt(
@@ -205,6 +209,11 @@ SequentialMatchingTab::SequentialMatchingTab(QWidget* parent,
       -1);
   options_widget_->AddOptionFilePath(
       &options_->sequential_matching->vocab_tree_path, "vocab_tree_path");
+  options_widget_->AddOptionFilePath(
+      &options_->sequential_matching->rig_config_path, "rig_config_path");
+  options_widget_->AddOptionDouble(
+      &options_->sequential_matching->rig_max_view_angle,
+      "rig_max_view_angle");
 
   CreateGeneralOptions();
 }
@@ -270,6 +279,10 @@ SpatialMatchingTab::SpatialMatchingTab(QWidget* parent, OptionManager* options)
                                 "max_num_neighbors");
   options_widget_->AddOptionDouble(&options_->spatial_matching->max_distance,
                                    "max_distance");
+  options_widget_->AddOptionFilePath(
+      &options_->spatial_matching->rig_config_path, "rig_config_path");
+  options_widget_->AddOptionDouble(
+      &options_->spatial_matching->rig_max_view_angle, "rig_max_view_angle");
 
   CreateGeneralOptions();
 }
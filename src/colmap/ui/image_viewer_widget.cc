@@ -109,8 +109,7 @@ void ImageViewerWidget::ShowBitmap(const Bitmap& bitmap) {
 }
 
 void ImageViewerWidget::ShowPixmap(const QPixmap& pixmap) {
-  graphics_scene_.ImagePixmapItem()->setPixmap(pixmap);
-  graphics_scene_.setSceneRect(pixmap.rect());
+  SetPixmap(pixmap);
 
   show();
   graphics_view_->fitInView(graphics_scene_.sceneRect(), Qt::KeepAspectRatio);
@@ -118,6 +117,11 @@ void ImageViewerWidget::ShowPixmap(const QPixmap& pixmap) {
   raise();
 }
 
+void ImageViewerWidget::SetPixmap(const QPixmap& pixmap) {
+  graphics_scene_.ImagePixmapItem()->setPixmap(pixmap);
+  graphics_scene_.setSceneRect(pixmap.rect());
+}
+
 void ImageViewerWidget::ReadAndShow(const std::string& path) {
   Bitmap bitmap;
   if (!bitmap.Read(path, true)) {
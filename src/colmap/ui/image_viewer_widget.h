@@ -69,6 +69,8 @@ class ImageViewerWidget : public QWidget {
  protected:
   void resizeEvent(QResizeEvent* event);
   void closeEvent(QCloseEvent* event);
+  // Replace the shown pixmap without changing the zoom of the view.
+  void SetPixmap(const QPixmap& pixmap);
   void ZoomIn();
   void ZoomOut();
   void Save();
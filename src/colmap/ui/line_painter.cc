@@ -31,9 +31,12 @@
 
 #include "colmap/util/opengl_utils.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace colmap {
 
-LinePainter::LinePainter() : num_geoms_(0) {}
+LinePainter::LinePainter() : num_geoms_(0), capacity_(0) {}
 
 LinePainter::~LinePainter() {
   vao_.destroy();
@@ -59,6 +62,8 @@ void LinePainter::Setup() {
 
   vao_.create();
   vbo_.create();
+  data_.clear();
+  capacity_ = 0;
 
 #if DEBUG
   glDebugLog();
@@ -74,20 +79,52 @@ void LinePainter::Upload(const std::vector<LinePainter::Data>& data) {
   vao_.bind();
   vbo_.bind();
 
-  // Upload data array to GPU
-  vbo_.setUsagePattern(QOpenGLBuffer::DynamicDraw);
-  vbo_.allocate(data.data(),
-                static_cast<int>(data.size() * sizeof(LinePainter::Data)));
-
-  // in_position
-  shader_program_.enableAttributeArray("a_pos");
-  shader_program_.setAttributeBuffer(
-      "a_pos", GL_FLOAT, 0, 3, sizeof(PointPainter::Data));
+  if (num_geoms_ > capacity_) {
+    // Upload data array to GPU with spare capacity, so that growing data,
+    // e.g., during a live reconstruction, can later be updated in place.
+    capacity_ = 2 * num_geoms_;
+    vbo_.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+    vbo_.allocate(static_cast<int>(capacity_ * sizeof(LinePainter::Data)));
+    vbo_.write(0,
+               data.data(),
+               static_cast<int>(num_geoms_ * sizeof(LinePainter::Data)));
+
+    // in_position
+    shader_program_.enableAttributeArray("a_pos");
+    shader_program_.setAttributeBuffer(
+        "a_pos", GL_FLOAT, 0, 3, sizeof(PointPainter::Data));
+
+    // in_color
+    shader_program_.enableAttributeArray("a_color");
+    shader_program_.setAttributeBuffer("a_color",
+                                       GL_FLOAT,
+                                       3 * sizeof(GLfloat),
+                                       4,
+                                       sizeof(PointPainter::Data));
+  } else {
+    // Only update the range of the buffer that changed since the last upload.
+    const auto IsEqual = [&](const size_t i) {
+      return std::memcmp(&data[i], &data_[i], sizeof(LinePainter::Data)) ==
+             0;
+    };
+    const size_t num_prev_geoms = std::min(data_.size(), num_geoms_);
+    size_t begin = 0;
+    while (begin < num_prev_geoms && IsEqual(begin)) {
+      begin += 1;
+    }
+    size_t end = num_geoms_;
+    while (end > begin && end <= num_prev_geoms && IsEqual(end - 1)) {
+      end -= 1;
+    }
+    if (begin < end) {
+      const size_t data_size = sizeof(LinePainter::Data);
+      vbo_.write(static_cast<int>(begin * data_size),
+                 data.data() + begin,
+                 static_cast<int>((end - begin) * data_size));
+    }
+  }
 
-  // in_color
-  shader_program_.enableAttributeArray("a_color");
-  shader_program_.setAttributeBuffer(
-      "a_color", GL_FLOAT, 3 * sizeof(GLfloat), 4, sizeof(PointPainter::Data));
+  data_ = data;
 
   // Make sure they are not changed from the outside
   vbo_.release();
@@ -0,0 +1,567 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/ui/lod_point_painter.h"
+
+#include "colmap/ui/qt_utils.h"
+#include "colmap/util/logging.h"
+#include "colmap/util/opengl_utils.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <queue>
+
+#include <Eigen/Geometry>
+
+namespace colmap {
+namespace {
+
+Eigen::Vector3f PointPosition(const PointPainter::Data& point) {
+  return Eigen::Vector3f(point.x, point.y, point.z);
+}
+
+// Index of the child octant that contains the given cell of a node's grid.
+int ChildOfCell(const int cell) {
+  const int kGridSize = LODPointPainter::kGridSize;
+  const int x = cell % kGridSize;
+  const int y = (cell / kGridSize) % kGridSize;
+  const int z = cell / (kGridSize * kGridSize);
+  return (x >= kGridSize / 2 ? 1 : 0) | (y >= kGridSize / 2 ? 2 : 0) |
+         (z >= kGridSize / 2 ? 4 : 0);
+}
+
+}  // namespace
+
+LODPointPainter::LODPointPainter() : upload_(0), frame_(0) {}
+
+LODPointPainter::~LODPointPainter() {
+  vao_.destroy();
+  vbo_.destroy();
+}
+
+void LODPointPainter::Setup() {
+  vao_.destroy();
+  vbo_.destroy();
+  if (shader_program_.isLinked()) {
+    shader_program_.release();
+    shader_program_.removeAllShaders();
+  }
+
+  shader_program_.addShaderFromSourceFile(QOpenGLShader::Vertex,
+                                          ":/shaders/points.v.glsl");
+  shader_program_.addShaderFromSourceFile(QOpenGLShader::Fragment,
+                                          ":/shaders/points.f.glsl");
+  shader_program_.link();
+  shader_program_.bind();
+
+  vao_.create();
+  vbo_.create();
+
+  vao_.bind();
+  vbo_.bind();
+
+  // Allocate the slots of all resident nodes once. The nodes are then
+  // streamed into the slots with partial updates of the buffer.
+  vbo_.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+  vbo_.allocate(
+      static_cast<int>(kMaxNumResidentPoints * sizeof(PointPainter::Data)));
+
+  // in_position
+  shader_program_.enableAttributeArray("a_position");
+  shader_program_.setAttributeBuffer(
+      "a_position", GL_FLOAT, 0, 3, sizeof(PointPainter::Data));
+
+  // in_color
+  shader_program_.enableAttributeArray("a_color");
+  shader_program_.setAttributeBuffer(
+      "a_color", GL_FLOAT, 3 * sizeof(GLfloat), 4, sizeof(PointPainter::Data));
+
+  // Make sure they are not changed from the outside
+  vbo_.release();
+  vao_.release();
+
+  slots_.resize(kMaxNumResidentPoints / kMaxNumNodePoints);
+  ResetSlots();
+
+#if DEBUG
+  glDebugLog();
+#endif
+}
+
+void LODPointPainter::Upload(const std::vector<uint64_t>& ids,
+                             const std::vector<PointPainter::Data>& data) {
+  THROW_CHECK_EQ(ids.size(), data.size());
+
+  upload_ += 1;
+
+  for (const auto& point : data) {
+    if (nodes_.empty() || !IsInBounds(point)) {
+      Rebuild(ids, data);
+      return;
+    }
+  }
+
+  if (!ids.empty()) {
+    const uint64_t max_id = *std::max_element(ids.begin(), ids.end());
+    if (max_id >= locations_.size()) {
+      locations_.resize(max_id + 1);
+    }
+  }
+
+  for (size_t i = 0; i < ids.size(); ++i) {
+    Location& location = locations_[ids[i]];
+    if (location.node_idx == -1) {
+      InsertPoint(/*node_idx=*/0, ids[i], data[i]);
+      continue;
+    }
+
+    Node& node = nodes_[location.node_idx];
+    PointPainter::Data& point = node.points[location.point_idx];
+    if (point.x == data[i].x && point.y == data[i].y && point.z == data[i].z) {
+      if (point.r != data[i].r || point.g != data[i].g ||
+          point.b != data[i].b || point.a != data[i].a) {
+        point = data[i];
+        node.dirty = true;
+      }
+      location.upload = upload_;
+    } else {
+      RemovePoint(ids[i]);
+      InsertPoint(/*node_idx=*/0, ids[i], data[i]);
+    }
+  }
+
+  // Remove all points that were not part of this upload.
+  for (size_t id = 0; id < locations_.size(); ++id) {
+    if (locations_[id].node_idx != -1 && locations_[id].upload != upload_) {
+      RemovePoint(id);
+    }
+  }
+
+  // Update the changed nodes resident in GPU memory. The other nodes are
+  // uploaded once they are rendered.
+  vbo_.bind();
+  for (size_t node_idx = 0; node_idx < nodes_.size(); ++node_idx) {
+    if (nodes_[node_idx].dirty && nodes_[node_idx].slot != -1) {
+      UploadNode(static_cast<int>(node_idx));
+    }
+  }
+  vbo_.release();
+
+#if DEBUG
+  glDebugLog();
+#endif
+}
+
+bool LODPointPainter::Render(const QMatrix4x4& pmv_matrix,
+                             const int width,
+                             const int height,
+                             const float point_size) {
+  frame_ += 1;
+
+  if (nodes_.empty()) {
+    return true;
+  }
+
+  const Eigen::Matrix4f pmv = QMatrixToEigen(pmv_matrix);
+
+  // Clipping planes of the view frustum in model coordinates.
+  Eigen::Matrix<float, 6, 4> planes;
+  planes.row(0) = pmv.row(3) + pmv.row(0);
+  planes.row(1) = pmv.row(3) - pmv.row(0);
+  planes.row(2) = pmv.row(3) + pmv.row(1);
+  planes.row(3) = pmv.row(3) - pmv.row(1);
+  planes.row(4) = pmv.row(3) + pmv.row(2);
+  planes.row(5) = pmv.row(3) - pmv.row(2);
+
+  const auto IsVisible = [&planes](const Node& node) {
+    for (int i = 0; i < planes.rows(); ++i) {
+      const Eigen::Vector3f normal = planes.block<1, 3>(i, 0).transpose();
+      Eigen::Vector3f corner = node.min_bound;
+      for (int d = 0; d < 3; ++d) {
+        if (normal(d) > 0) {
+          corner(d) += node.size;
+        }
+      }
+      if (normal.dot(corner) + planes(i, 3) < 0) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  // Number of pixels per unit length at unit depth, which is the same for
+  // perspective and orthographic projections.
+  const float pixel_scale =
+      std::max(0.5f * width * pmv.block<1, 3>(0, 0).norm(),
+               0.5f * height * pmv.block<1, 3>(1, 0).norm());
+  const Eigen::Vector3f depth_axis = pmv.block<1, 3>(3, 0).transpose();
+  const float depth_scale = depth_axis.norm();
+
+  // Projected point spacing of a node at the closest point of its bounding
+  // sphere, which is infinite if the camera is inside the sphere.
+  const auto ScreenSpaceError = [&](const Node& node) {
+    const Eigen::Vector3f center =
+        node.min_bound + Eigen::Vector3f::Constant(0.5f * node.size);
+    const float radius = 0.5f * std::sqrt(3.0f) * node.size;
+    const float depth =
+        depth_axis.dot(center) + pmv(3, 3) - depth_scale * radius;
+    if (depth <= 0) {
+      return std::numeric_limits<float>::max();
+    }
+    return pixel_scale * node.size / kGridSize / depth;
+  };
+
+  // Traverse the octree from coarse to fine with the largest error first, so
+  // that the budgets are spent on the most visible nodes. Children are only
+  // traversed once their parent is resident.
+  render_node_idxs_.clear();
+  std::priority_queue<std::pair<float, int>> queue;
+  if (IsVisible(nodes_[0])) {
+    queue.emplace(ScreenSpaceError(nodes_[0]), 0);
+  }
+
+  bool complete = true;
+  size_t num_upload_points = 0;
+
+  vbo_.bind();
+  while (!queue.empty() && render_node_idxs_.size() < slots_.size()) {
+    const float error = queue.top().first;
+    const int node_idx = queue.top().second;
+    queue.pop();
+
+    Node& node = nodes_[node_idx];
+    if (node.slot == -1) {
+      if (num_upload_points + node.points.size() >
+          kMaxNumUploadPointsPerFrame) {
+        complete = false;
+        continue;
+      }
+      const int slot = AcquireSlot();
+      if (slot == -1) {
+        complete = false;
+        continue;
+      }
+      slots_[slot].node_idx = node_idx;
+      node.slot = slot;
+      UploadNode(node_idx);
+      num_upload_points += node.points.size();
+    }
+
+    slots_[node.slot].last_frame = frame_;
+    render_node_idxs_.push_back(node_idx);
+
+    if (error > kMaxScreenSpaceError) {
+      for (const int child_idx : node.children) {
+        if (child_idx != -1 && IsVisible(nodes_[child_idx])) {
+          queue.emplace(ScreenSpaceError(nodes_[child_idx]), child_idx);
+        }
+      }
+    }
+  }
+  vbo_.release();
+
+  shader_program_.bind();
+  vao_.bind();
+
+  shader_program_.setUniformValue("u_pmv_matrix", pmv_matrix);
+  shader_program_.setUniformValue("u_point_size", point_size);
+
+  QOpenGLFunctions* gl_funcs = QOpenGLContext::currentContext()->functions();
+  for (const int node_idx : render_node_idxs_) {
+    const Node& node = nodes_[node_idx];
+    gl_funcs->glDrawArrays(GL_POINTS,
+                           static_cast<GLint>(node.slot * kMaxNumNodePoints),
+                           static_cast<GLsizei>(node.points.size()));
+  }
+
+  // Make sure the VAO is not changed from the outside
+  vao_.release();
+
+#if DEBUG
+  glDebugLog();
+#endif
+
+  return complete;
+}
+
+bool LODPointPainter::Pick(const QMatrix4x4& pmv_matrix,
+                           const int width,
+                           const int height,
+                           const Eigen::Vector2f& position,
+                           const float radius,
+                           uint64_t* id,
+                           float* depth) const {
+  const Eigen::Matrix4f pmv = QMatrixToEigen(pmv_matrix);
+
+  // Project to window coordinates with the depth in normalized device
+  // coordinates. Returns false for positions behind the viewer.
+  const auto Project = [&](const Eigen::Vector3f& xyz,
+                           Eigen::Vector3f* window) {
+    const Eigen::Vector4f clip = pmv * xyz.homogeneous();
+    if (clip(3) <= 0) {
+      return false;
+    }
+    (*window)(0) = 0.5f * (clip(0) / clip(3) + 1) * width;
+    (*window)(1) = 0.5f * (1 - clip(1) / clip(3)) * height;
+    (*window)(2) = clip(2) / clip(3);
+    return true;
+  };
+
+  bool picked = false;
+  *depth = std::numeric_limits<float>::max();
+
+  Eigen::Vector3f window;
+  for (const int node_idx : render_node_idxs_) {
+    const Node& node = nodes_[node_idx];
+
+    // Skip nodes whose projected bounds are not close to the position.
+    bool is_behind = false;
+    Eigen::Vector2f min_bound =
+        Eigen::Vector2f::Constant(std::numeric_limits<float>::max());
+    Eigen::Vector2f max_bound = -min_bound;
+    for (int corner = 0; corner < 8 && !is_behind; ++corner) {
+      const Eigen::Vector3f xyz =
+          node.min_bound + node.size * Eigen::Vector3f((corner >> 0) & 1,
+                                                       (corner >> 1) & 1,
+                                                       (corner >> 2) & 1);
+      if (Project(xyz, &window)) {
+        min_bound = min_bound.cwiseMin(window.head<2>());
+        max_bound = max_bound.cwiseMax(window.head<2>());
+      } else {
+        is_behind = true;
+      }
+    }
+    if (!is_behind &&
+        ((position - min_bound).minCoeff() < -radius ||
+         (max_bound - position).minCoeff() < -radius)) {
+      continue;
+    }
+
+    for (size_t i = 0; i < node.points.size(); ++i) {
+      if (Project(PointPosition(node.points[i]), &window) &&
+          window(2) >= -1 && window(2) <= 1 && window(2) < *depth &&
+          (window.head<2>() - position).squaredNorm() <= radius * radius) {
+        picked = true;
+        *id = node.point_ids[i];
+        *depth = window(2);
+      }
+    }
+  }
+
+  return picked;
+}
+
+bool LODPointPainter::IsInBounds(const PointPainter::Data& point) const {
+  const Eigen::Vector3f rel_position =
+      PointPosition(point) - nodes_[0].min_bound;
+  return rel_position.minCoeff() >= 0 &&
+         rel_position.maxCoeff() <= nodes_[0].size;
+}
+
+void LODPointPainter::Rebuild(const std::vector<uint64_t>& ids,
+                              const std::vector<PointPainter::Data>& data) {
+  nodes_.clear();
+  locations_.clear();
+  render_node_idxs_.clear();
+  ResetSlots();
+
+  if (data.empty()) {
+    return;
+  }
+
+  Eigen::Vector3f min_bound = PointPosition(data[0]);
+  Eigen::Vector3f max_bound = min_bound;
+  for (const auto& point : data) {
+    min_bound = min_bound.cwiseMin(PointPosition(point));
+    max_bound = max_bound.cwiseMax(PointPosition(point));
+  }
+
+  // Enlarge the bounds, so that the octree is not rebuilt every time the
+  // model grows during a live reconstruction.
+  const float size = 2 * std::max((max_bound - min_bound).maxCoeff(),
+                                  std::numeric_limits<float>::epsilon());
+  nodes_.emplace_back();
+  nodes_[0].min_bound = 0.5f * (min_bound + max_bound) -
+                        Eigen::Vector3f::Constant(0.5f * size);
+  nodes_[0].size = size;
+
+  locations_.resize(*std::max_element(ids.begin(), ids.end()) + 1);
+  for (size_t i = 0; i < ids.size(); ++i) {
+    InsertPoint(/*node_idx=*/0, ids[i], data[i]);
+  }
+}
+
+void LODPointPainter::InsertPoint(int node_idx,
+                                  const uint64_t id,
+                                  const PointPainter::Data& point) {
+  while (true) {
+    if (nodes_[node_idx].occupied.empty()) {
+      if (nodes_[node_idx].points.size() < kMaxNumNodePoints) {
+        AppendPoint(node_idx, id, point);
+        return;
+      } else if (nodes_[node_idx].depth == kMaxDepth) {
+        return;
+      }
+      SplitNode(node_idx);
+    }
+
+    // Keep the first point in every cell of the sampling grid and pass the
+    // remaining points on to the children.
+    const int cell = NodeCell(nodes_[node_idx], point);
+    if (!nodes_[node_idx].occupied[cell]) {
+      nodes_[node_idx].occupied[cell] = true;
+      AppendPoint(node_idx, id, point);
+      return;
+    }
+
+    const int child = ChildOfCell(cell);
+    if (nodes_[node_idx].children[child] == -1) {
+      Node child_node;
+      child_node.size = 0.5f * nodes_[node_idx].size;
+      child_node.min_bound =
+          nodes_[node_idx].min_bound +
+          child_node.size * Eigen::Vector3f((child >> 0) & 1,
+                                            (child >> 1) & 1,
+                                            (child >> 2) & 1);
+      child_node.depth = nodes_[node_idx].depth + 1;
+      nodes_[node_idx].children[child] = static_cast<int>(nodes_.size());
+      nodes_.push_back(std::move(child_node));
+    }
+
+    node_idx = nodes_[node_idx].children[child];
+  }
+}
+
+void LODPointPainter::AppendPoint(const int node_idx,
+                                  const uint64_t id,
+                                  const PointPainter::Data& point) {
+  Node& node = nodes_[node_idx];
+  Location& location = locations_[id];
+  location.node_idx = node_idx;
+  location.point_idx = static_cast<int>(node.points.size());
+  location.upload = upload_;
+  node.points.push_back(point);
+  node.point_ids.push_back(id);
+  node.dirty = true;
+}
+
+void LODPointPainter::RemovePoint(const uint64_t id) {
+  Location& location = locations_[id];
+  Node& node = nodes_[location.node_idx];
+  if (!node.occupied.empty()) {
+    node.occupied[NodeCell(node, node.points[location.point_idx])] = false;
+  }
+
+  const int last_point_idx = static_cast<int>(node.points.size()) - 1;
+  if (location.point_idx != last_point_idx) {
+    node.points[location.point_idx] = node.points[last_point_idx];
+    node.point_ids[location.point_idx] = node.point_ids[last_point_idx];
+    locations_[node.point_ids[location.point_idx]].point_idx =
+        location.point_idx;
+  }
+  node.points.pop_back();
+  node.point_ids.pop_back();
+  node.dirty = true;
+
+  location = Location();
+}
+
+void LODPointPainter::SplitNode(const int node_idx) {
+  std::vector<PointPainter::Data> points;
+  std::vector<uint64_t> point_ids;
+  points.swap(nodes_[node_idx].points);
+  point_ids.swap(nodes_[node_idx].point_ids);
+  nodes_[node_idx].occupied.resize(kMaxNumNodePoints, false);
+  nodes_[node_idx].dirty = true;
+  for (size_t i = 0; i < points.size(); ++i) {
+    InsertPoint(node_idx, point_ids[i], points[i]);
+  }
+}
+
+int LODPointPainter::NodeCell(const Node& node,
+                              const PointPainter::Data& point) const {
+  const Eigen::Vector3f rel_position =
+      (PointPosition(point) - node.min_bound) * (kGridSize / node.size);
+  int cell[3];
+  for (int d = 0; d < 3; ++d) {
+    cell[d] = std::min(std::max(static_cast<int>(rel_position(d)), 0),
+                       kGridSize - 1);
+  }
+  return (cell[2] * kGridSize + cell[1]) * kGridSize + cell[0];
+}
+
+void LODPointPainter::ResetSlots() {
+  for (auto& node : nodes_) {
+    node.slot = -1;
+  }
+  free_slots_.resize(slots_.size());
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    slots_[i] = Slot();
+    free_slots_[i] = static_cast<int>(slots_.size() - i - 1);
+  }
+}
+
+int LODPointPainter::AcquireSlot() {
+  if (!free_slots_.empty()) {
+    const int slot = free_slots_.back();
+    free_slots_.pop_back();
+    return slot;
+  }
+
+  // Evict the least recently rendered node that is not used in this frame.
+  int lru_slot = -1;
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    if (slots_[i].last_frame < frame_ &&
+        (lru_slot == -1 ||
+         slots_[i].last_frame < slots_[lru_slot].last_frame)) {
+      lru_slot = static_cast<int>(i);
+    }
+  }
+
+  if (lru_slot != -1) {
+    nodes_[slots_[lru_slot].node_idx].slot = -1;
+  }
+
+  return lru_slot;
+}
+
+void LODPointPainter::UploadNode(const int node_idx) {
+  Node& node = nodes_[node_idx];
+  vbo_.write(
+      static_cast<int>(node.slot * kMaxNumNodePoints *
+                       sizeof(PointPainter::Data)),
+      node.points.data(),
+      static_cast<int>(node.points.size() * sizeof(PointPainter::Data)));
+  node.dirty = false;
+}
+
+}  // namespace colmap
@@ -0,0 +1,161 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "colmap/ui/point_painter.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+#include <QtCore>
+#include <QtOpenGL>
+
+namespace colmap {
+
+// Level-of-detail point renderer for large models. The points are organized
+// in an octree, in which every node stores a spatially uniform subsample of
+// the points in its cube and the children store the remaining points. Only
+// the visible nodes, whose projected point spacing exceeds the maximum screen
+// space error, are rendered. The nodes are streamed on demand into fixed-size
+// slots of a GPU buffer, so that the GPU memory and the uploads per frame are
+// bounded independently of the size of the model.
+class LODPointPainter {
+ public:
+  // Resolution of the sampling grid of a node. An inner node stores at most
+  // one point per grid cell, while a leaf node stores all of its points.
+  static const int kGridSize = 32;
+  static const size_t kMaxNumNodePoints = kGridSize * kGridSize * kGridSize;
+  // Maximum depth of the octree, beyond which points are discarded. This only
+  // affects models with many (nearly) duplicate points.
+  static const int kMaxDepth = 20;
+  // Maximum number of points resident in GPU memory.
+  static const size_t kMaxNumResidentPoints = 8 * 1024 * 1024;
+  // Maximum number of points uploaded to the GPU per rendered frame.
+  static const size_t kMaxNumUploadPointsPerFrame = 1024 * 1024;
+  // Maximum projected point spacing in pixels, above which nodes are refined.
+  static constexpr float kMaxScreenSpaceError = 1.5f;
+
+  LODPointPainter();
+  ~LODPointPainter();
+
+  void Setup();
+
+  // Upload the points with the given identifiers. The identifiers index a
+  // lookup table and should thus be small, such as the 3D point identifiers
+  // of a reconstruction. Points are incrementally inserted, removed, or
+  // updated with respect to the previous upload, and only the changed nodes
+  // resident in GPU memory are re-uploaded. The octree is only rebuilt, if
+  // points fall outside of its bounds.
+  void Upload(const std::vector<uint64_t>& ids,
+              const std::vector<PointPainter::Data>& data);
+
+  // Render the visible nodes at the required level of detail. Returns false,
+  // if not all required nodes could be uploaded in this frame, in which case
+  // the caller should schedule another frame.
+  bool Render(const QMatrix4x4& pmv_matrix,
+              int width,
+              int height,
+              float point_size);
+
+  // Pick the point closest to the viewer among the points rendered in the
+  // last frame, whose projection is within the given radius of the given
+  // window position. The window position and size are in pixels with the
+  // origin at the top-left. Returns false, if no point is within the radius.
+  // The depth is returned in normalized device coordinates.
+  bool Pick(const QMatrix4x4& pmv_matrix,
+            int width,
+            int height,
+            const Eigen::Vector2f& position,
+            float radius,
+            uint64_t* id,
+            float* depth) const;
+
+ private:
+  struct Node {
+    Eigen::Vector3f min_bound = Eigen::Vector3f::Zero();
+    float size = 0;
+    int depth = 0;
+    int children[8] = {-1, -1, -1, -1, -1, -1, -1, -1};
+    // Points and their identifiers stored in this node.
+    std::vector<PointPainter::Data> points;
+    std::vector<uint64_t> point_ids;
+    // Occupied cells of the sampling grid, which is empty for leaf nodes.
+    std::vector<bool> occupied;
+    // Index of the GPU buffer slot or -1, if the node is not resident.
+    int slot = -1;
+    // Whether the points changed since the node was uploaded.
+    bool dirty = false;
+  };
+
+  struct Location {
+    int node_idx = -1;
+    int point_idx = -1;
+    size_t upload = 0;
+  };
+
+  struct Slot {
+    int node_idx = -1;
+    size_t last_frame = 0;
+  };
+
+  bool IsInBounds(const PointPainter::Data& point) const;
+  void Rebuild(const std::vector<uint64_t>& ids,
+               const std::vector<PointPainter::Data>& data);
+  void InsertPoint(int node_idx, uint64_t id, const PointPainter::Data& point);
+  void AppendPoint(int node_idx, uint64_t id, const PointPainter::Data& point);
+  void RemovePoint(uint64_t id);
+  void SplitNode(int node_idx);
+  int NodeCell(const Node& node, const PointPainter::Data& point) const;
+  void ResetSlots();
+  int AcquireSlot();
+  void UploadNode(int node_idx);
+
+  QOpenGLShaderProgram shader_program_;
+  QOpenGLVertexArrayObject vao_;
+  QOpenGLBuffer vbo_;
+
+  // Octree nodes with the root node at the front.
+  std::vector<Node> nodes_;
+  // Location of the points in the octree indexed by their identifier.
+  std::vector<Location> locations_;
+  // Counter of uploads to detect removed points.
+  size_t upload_;
+
+  // Nodes rendered in the last frame.
+  std::vector<int> render_node_idxs_;
+
+  std::vector<Slot> slots_;
+  std::vector<int> free_slots_;
+  size_t frame_;
+};
+
+}  // namespace colmap
@@ -29,20 +29,71 @@
 
 #include "colmap/ui/match_matrix_widget.h"
 
+#include <tuple>
+
 namespace colmap {
+namespace {
+
+// Number of image pairs read between updates of the shared matrix.
+const size_t kUpdateBatchSize = 100000;
+// Interval in milliseconds between refreshes of the shown matrix.
+const int kRefreshInterval = 250;
+
+}  // namespace
 
 MatchMatrixWidget::MatchMatrixWidget(QWidget* parent, OptionManager* options)
-    : ImageViewerWidget(parent), options_(options) {
+    : ImageViewerWidget(parent),
+      options_(options),
+      stop_(false),
+      done_(true),
+      matrix_size_(0),
+      matrix_changed_(false),
+      matrix_shown_(false) {
   setWindowTitle("Match matrix");
+
+  refresh_timer_ = new QTimer(this);
+  connect(refresh_timer_, &QTimer::timeout, this, &MatchMatrixWidget::Refresh);
 }
 
+MatchMatrixWidget::~MatchMatrixWidget() { Stop(); }
+
 void MatchMatrixWidget::Show() {
-  Database database(*options_->database_path);
+  Stop();
+
+  // The matrix is downsampled to the screen resolution, since more cells
+  // cannot be displayed at once.
+  const QSize screen_size =
+      devicePixelRatio() * QGuiApplication::primaryScreen()->size();
+  const int max_matrix_size =
+      std::max(screen_size.width(), screen_size.height());
 
-  if (database.NumImages() == 0) {
-    return;
+  {
+    std::lock_guard<std::mutex> lock(matrix_mutex_);
+    matrix_size_ = 0;
+    matrix_.clear();
+    matrix_changed_ = false;
+    matrix_shown_ = false;
   }
 
+  stop_ = false;
+  done_ = false;
+  setWindowTitle("Match matrix (loading...)");
+  thread_ = std::thread(&MatchMatrixWidget::Compute,
+                        this,
+                        *options_->database_path,
+                        max_matrix_size);
+  refresh_timer_->start(kRefreshInterval);
+}
+
+void MatchMatrixWidget::closeEvent(QCloseEvent* event) {
+  Stop();
+  ImageViewerWidget::closeEvent(event);
+}
+
+void MatchMatrixWidget::Compute(const std::string& database_path,
+                                const int max_matrix_size) {
+  Database database(database_path);
+
   // Sort the images according to their name.
   std::vector<Image> images = database.ReadAllImages();
   std::sort(images.begin(),
@@ -51,38 +102,119 @@ void MatchMatrixWidget::Show() {
               return image1.Name() < image2.Name();
             });
 
-  // Allocate the match matrix image.
+  // Map image identifiers to the cells of the downsampled matrix.
+  const int matrix_size =
+      std::min(static_cast<int>(images.size()), max_matrix_size);
+  std::unordered_map<image_t, int> image_id_to_cell;
+  for (size_t idx = 0; idx < images.size(); ++idx) {
+    image_id_to_cell.emplace(
+        images[idx].ImageId(),
+        static_cast<int>(idx * matrix_size / images.size()));
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(matrix_mutex_);
+    matrix_size_ = matrix_size;
+    matrix_.assign(matrix_size * matrix_size, 0);
+    matrix_changed_ = true;
+  }
+
+  std::vector<std::tuple<int, int, int>> batch;
+  batch.reserve(kUpdateBatchSize);
+  const auto UpdateMatrix = [&]() {
+    std::lock_guard<std::mutex> lock(matrix_mutex_);
+    for (const auto& update : batch) {
+      int& value1 = matrix_[std::get<0>(update) * matrix_size_ +
+                            std::get<1>(update)];
+      int& value2 = matrix_[std::get<1>(update) * matrix_size_ +
+                            std::get<0>(update)];
+      value1 = std::max(value1, std::get<2>(update));
+      value2 = std::max(value2, std::get<2>(update));
+    }
+    matrix_changed_ = matrix_changed_ || !batch.empty();
+    batch.clear();
+  };
+
+  // Only the number of inliers is read, which avoids decoding the matches.
+  database.ReadTwoViewGeometryNumInliers(
+      [&](const image_pair_t pair_id, const int num_inliers, int /*config*/) {
+        if (stop_) {
+          return;
+        }
+        const auto image_pair = Database::PairIdToImagePair(pair_id);
+        const auto cell1 = image_id_to_cell.find(image_pair.first);
+        const auto cell2 = image_id_to_cell.find(image_pair.second);
+        if (cell1 == image_id_to_cell.end() ||
+            cell2 == image_id_to_cell.end()) {
+          return;
+        }
+        batch.emplace_back(cell1->second, cell2->second, num_inliers);
+        if (batch.size() >= kUpdateBatchSize) {
+          UpdateMatrix();
+        }
+      });
+
+  UpdateMatrix();
+
+  done_ = true;
+}
+
+void MatchMatrixWidget::Refresh() {
+  // Check for completion before reading the matrix, so that the last update
+  // of the background thread is always shown.
+  const bool done = done_;
+
   Bitmap match_matrix;
-  match_matrix.Allocate(images.size(), images.size(), true);
-  match_matrix.Fill(BitmapColor<uint8_t>(255));
+  {
+    std::lock_guard<std::mutex> lock(matrix_mutex_);
+    if (matrix_changed_ && matrix_size_ > 0) {
+      matrix_changed_ = false;
 
-  // Map image identifiers to match matrix locations.
-  std::unordered_map<image_t, size_t> image_id_to_idx;
-  for (size_t idx = 0; idx < images.size(); ++idx) {
-    image_id_to_idx.emplace(images[idx].ImageId(), idx);
+      match_matrix.Allocate(matrix_size_, matrix_size_, true);
+      match_matrix.Fill(BitmapColor<uint8_t>(255));
+
+      const int max_num_inliers =
+          *std::max_element(matrix_.begin(), matrix_.end());
+      if (max_num_inliers > 0) {
+        const double max_value = std::log1p(max_num_inliers);
+        for (int y = 0; y < matrix_size_; ++y) {
+          for (int x = 0; x < matrix_size_; ++x) {
+            const int num_inliers = matrix_[y * matrix_size_ + x];
+            if (num_inliers == 0) {
+              continue;
+            }
+            const double value = std::log1p(num_inliers) / max_value;
+            const BitmapColor<float> color(255 * JetColormap::Red(value),
+                                           255 * JetColormap::Green(value),
+                                           255 * JetColormap::Blue(value));
+            match_matrix.SetPixel(x, y, color.Cast<uint8_t>());
+          }
+        }
+      }
+    }
   }
 
-  std::vector<std::pair<image_t, image_t>> image_pairs;
-  std::vector<int> num_inliers;
-  database.ReadTwoViewGeometryNumInliers(&image_pairs, &num_inliers);
-
-  // Fill the match matrix.
-  if (!num_inliers.empty()) {
-    const double max_value =
-        std::log1p(*std::max_element(num_inliers.begin(), num_inliers.end()));
-    for (size_t i = 0; i < image_pairs.size(); ++i) {
-      const double value = std::log1p(num_inliers[i]) / max_value;
-      const size_t idx1 = image_id_to_idx.at(image_pairs[i].first);
-      const size_t idx2 = image_id_to_idx.at(image_pairs[i].second);
-      const BitmapColor<float> color(255 * JetColormap::Red(value),
-                                     255 * JetColormap::Green(value),
-                                     255 * JetColormap::Blue(value));
-      match_matrix.SetPixel(idx1, idx2, color.Cast<uint8_t>());
-      match_matrix.SetPixel(idx2, idx1, color.Cast<uint8_t>());
+  if (match_matrix.Width() > 0) {
+    if (matrix_shown_) {
+      SetPixmap(QPixmap::fromImage(BitmapToQImageRGB(match_matrix)));
+    } else {
+      ShowBitmap(match_matrix);
+      matrix_shown_ = true;
     }
   }
 
-  ShowBitmap(match_matrix);
+  if (done) {
+    refresh_timer_->stop();
+    setWindowTitle("Match matrix");
+  }
+}
+
+void MatchMatrixWidget::Stop() {
+  refresh_timer_->stop();
+  stop_ = true;
+  if (thread_.joinable()) {
+    thread_.join();
+  }
 }
 
 }  // namespace colmap
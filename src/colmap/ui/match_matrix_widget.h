@@ -32,17 +32,44 @@
 #include "colmap/controllers/option_manager.h"
 #include "colmap/ui/image_viewer_widget.h"
 
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 namespace colmap {
 
-// Widget to visualize match matrix.
+// Widget to visualize match matrix. The number of inlier matches is read in a
+// background thread and accumulated in a matrix downsampled to the screen
+// resolution, which is shown progressively while it is computed.
 class MatchMatrixWidget : public ImageViewerWidget {
  public:
   MatchMatrixWidget(QWidget* parent, OptionManager* options);
+  ~MatchMatrixWidget();
 
   void Show();
 
  private:
+  void closeEvent(QCloseEvent* event) override;
+
+  void Compute(const std::string& database_path, int max_matrix_size);
+  void Refresh();
+  void Stop();
+
   OptionManager* options_;
+  QTimer* refresh_timer_;
+
+  std::thread thread_;
+  std::atomic<bool> stop_;
+  std::atomic<bool> done_;
+
+  // Maximum number of inlier matches between the images of every cell of the
+  // downsampled matrix, which is shared with the background thread.
+  std::mutex matrix_mutex_;
+  int matrix_size_;
+  std::vector<int> matrix_;
+  bool matrix_changed_;
+  bool matrix_shown_;
 };
 
 }  // namespace colmap
@@ -31,8 +31,7 @@
 
 #include "colmap/ui/main_window.h"
 
-#define SELECTION_BUFFER_IMAGE_IDX 0
-#define SELECTION_BUFFER_POINT_IDX 1
+#include <limits>
 
 const Eigen::Vector4f kSelectedPointColor(0.0f, 1.0f, 0.0f, 1.0f);
 
@@ -50,22 +49,6 @@ const Eigen::Vector4f kZAxisColor(0.0f, 0.0f, 0.9f, 0.5f);
 namespace colmap {
 namespace {
 
-// Generate unique index from RGB color in the range [0, 256^3].
-inline size_t RGBToIndex(const uint8_t r, const uint8_t g, const uint8_t b) {
-  return static_cast<size_t>(r) + static_cast<size_t>(g) * 256 +
-         static_cast<size_t>(b) * 65536;
-}
-
-// Derive color from unique index, generated by `RGBToIndex`.
-inline Eigen::Vector4f IndexToRGB(const size_t index) {
-  Eigen::Vector4f color;
-  color(0) = ((index & 0x000000FF) >> 0) / 255.0f;
-  color(1) = ((index & 0x0000FF00) >> 8) / 255.0f;
-  color(2) = ((index & 0x00FF0000) >> 16) / 255.0f;
-  color(3) = 1.0f;
-  return color;
-}
-
 void BuildImageModel(const Image& image,
                      const Camera& camera,
                      const float image_size,
@@ -346,8 +329,10 @@ void ModelViewerWidget::paintGL() {
     coordinate_grid_painter_.Render(pmvc_matrix, width(), height(), 1);
   }
 
-  // Points
-  point_painter_.Render(pmv_matrix, point_size_);
+  // Points, which are streamed to the GPU over multiple frames for large
+  // models, so another frame is scheduled until all visible nodes are loaded.
+  const bool points_complete =
+      point_painter_.Render(pmv_matrix, width(), height(), point_size_);
   point_connection_painter_.Render(pmv_matrix, width(), height(), 1);
 
   // Images
@@ -359,6 +344,10 @@ void ModelViewerWidget::paintGL() {
   movie_grabber_path_painter_.Render(pmv_matrix, width(), height(), 1.5);
   movie_grabber_line_painter_.Render(pmv_matrix, width(), height(), 1);
   movie_grabber_triangle_painter_.Render(pmv_matrix);
+
+  if (!points_complete) {
+    update();
+  }
 }
 
 void ModelViewerWidget::resizeGL(int width, int height) {
@@ -558,76 +547,41 @@ void ModelViewerWidget::SetModelViewMatrix(const QMatrix4x4& matrix) {
 }
 
 void ModelViewerWidget::SelectObject(const int x, const int y) {
-  makeCurrent();
-
-  // Ensure that anti-aliasing does not change the colors of objects.
-  glDisable(GL_MULTISAMPLE);
-
-  glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-  // Upload data in selection mode (one color per object).
-  UploadImageData(true);
-  UploadPointData(true);
-
-  // Render in selection mode, with larger points to improve selection accuracy.
+  // Pick the closest object on the CPU in device pixels. Points are picked
+  // with twice their rendered size to improve the selection accuracy.
   const QMatrix4x4 pmv_matrix = projection_matrix_ * model_view_matrix_;
-  image_triangle_painter_.Render(pmv_matrix);
-  point_painter_.Render(pmv_matrix, 2 * point_size_);
-
-  const int scaled_x = devicePixelRatio() * x;
-  const int scaled_y = devicePixelRatio() * (height() - y - 1);
-
-  QOpenGLFramebufferObjectFormat fbo_format;
-  fbo_format.setSamples(0);
-  QOpenGLFramebufferObject fbo(1, 1, fbo_format);
-
-  glBindFramebuffer(GL_READ_FRAMEBUFFER, defaultFramebufferObject());
-  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo.handle());
-  glBlitFramebuffer(scaled_x,
-                    scaled_y,
-                    scaled_x + 1,
-                    scaled_y + 1,
-                    0,
-                    0,
-                    1,
-                    1,
-                    GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT,
-                    GL_NEAREST);
-
-  fbo.bind();
-  std::array<uint8_t, 3> color;
-  glReadPixels(0, 0, 1, 1, GL_RGB, GL_UNSIGNED_BYTE, color.data());
-  fbo.release();
-
-  const size_t index = RGBToIndex(color[0], color[1], color[2]);
-
-  if (index < selection_buffer_.size()) {
-    const char buffer_type = selection_buffer_[index].second;
-    if (buffer_type == SELECTION_BUFFER_IMAGE_IDX) {
-      selected_image_id_ = static_cast<image_t>(selection_buffer_[index].first);
-      selected_point3D_id_ = kInvalidPoint3DId;
-      ShowImageInfo(selected_image_id_);
-    } else if (buffer_type == SELECTION_BUFFER_POINT_IDX) {
-      selected_image_id_ = kInvalidImageId;
-      selected_point3D_id_ = selection_buffer_[index].first;
-      ShowPointInfo(selection_buffer_[index].first);
-    } else {
-      selected_image_id_ = kInvalidImageId;
-      selected_point3D_id_ = kInvalidPoint3DId;
-      image_viewer_widget_->hide();
-    }
+  const float pixel_ratio = devicePixelRatio();
+  const Eigen::Vector2f position(pixel_ratio * x + 0.5f,
+                                 pixel_ratio * y + 0.5f);
+
+  point3D_t point3D_id = kInvalidPoint3DId;
+  float point_depth = std::numeric_limits<float>::max();
+  point_painter_.Pick(pmv_matrix,
+                      static_cast<int>(pixel_ratio * width()),
+                      static_cast<int>(pixel_ratio * height()),
+                      position,
+                      point_size_,
+                      &point3D_id,
+                      &point_depth);
+
+  image_t image_id = kInvalidImageId;
+  float image_depth = std::numeric_limits<float>::max();
+  PickImage(pmv_matrix, position, &image_id, &image_depth);
+
+  if (image_id != kInvalidImageId && image_depth <= point_depth) {
+    selected_image_id_ = image_id;
+    selected_point3D_id_ = kInvalidPoint3DId;
+    ShowImageInfo(selected_image_id_);
+  } else if (point3D_id != kInvalidPoint3DId) {
+    selected_image_id_ = kInvalidImageId;
+    selected_point3D_id_ = point3D_id;
+    ShowPointInfo(selected_point3D_id_);
   } else {
     selected_image_id_ = kInvalidImageId;
     selected_point3D_id_ = kInvalidPoint3DId;
     image_viewer_widget_->hide();
   }
 
-  // Re-enable, since temporarily disabled above.
-  glEnable(GL_MULTISAMPLE);
-
-  selection_buffer_.clear();
-
   UploadPointData();
   UploadImageData();
   UploadPointConnectionData();
@@ -636,6 +590,77 @@ void ModelViewerWidget::SelectObject(const int x, const int y) {
   update();
 }
 
+void ModelViewerWidget::PickImage(const QMatrix4x4& pmv_matrix,
+                                  const Eigen::Vector2f& position,
+                                  image_t* image_id,
+                                  float* depth) const {
+  const Eigen::Matrix4f pmv = QMatrixToEigen(pmv_matrix);
+  const float window_width = devicePixelRatio() * width();
+  const float window_height = devicePixelRatio() * height();
+
+  std::vector<TrianglePainter::Data> triangle_data;
+  for (const image_t reg_image_id : reg_image_ids) {
+    const Image& image = images.at(reg_image_id);
+    triangle_data.clear();
+    BuildImageModel(image,
+                    cameras.at(image.CameraId()),
+                    image_size_,
+                    Eigen::Vector4f::Zero(),
+                    Eigen::Vector4f::Zero(),
+                    &triangle_data,
+                    /*line_data=*/nullptr);
+
+    for (const auto& triangle : triangle_data) {
+      // Project the corners to window coordinates with the depth in
+      // normalized device coordinates.
+      Eigen::Matrix3f window;
+      bool is_behind = false;
+      const PointPainter::Data* corners[3] = {
+          &triangle.point1, &triangle.point2, &triangle.point3};
+      for (int i = 0; i < 3; ++i) {
+        const Eigen::Vector4f clip =
+            pmv *
+            Eigen::Vector4f(corners[i]->x, corners[i]->y, corners[i]->z, 1);
+        if (clip(3) <= 0) {
+          is_behind = true;
+          break;
+        }
+        window(0, i) = 0.5f * (clip(0) / clip(3) + 1) * window_width;
+        window(1, i) = 0.5f * (1 - clip(1) / clip(3)) * window_height;
+        window(2, i) = clip(2) / clip(3);
+      }
+      if (is_behind) {
+        continue;
+      }
+
+      // Barycentric coordinates of the position in the projected triangle,
+      // in which the normalized depth is interpolated linearly.
+      const Eigen::Vector2f origin = window.block<2, 1>(0, 0);
+      const Eigen::Vector2f edge1 = window.block<2, 1>(0, 1) - origin;
+      const Eigen::Vector2f edge2 = window.block<2, 1>(0, 2) - origin;
+      const Eigen::Vector2f rel_position = position - origin;
+      const float det = edge1(0) * edge2(1) - edge1(1) * edge2(0);
+      if (det == 0) {
+        continue;
+      }
+      const float u =
+          (rel_position(0) * edge2(1) - rel_position(1) * edge2(0)) / det;
+      const float v =
+          (edge1(0) * rel_position(1) - edge1(1) * rel_position(0)) / det;
+      if (u < 0 || v < 0 || u + v > 1) {
+        continue;
+      }
+      const float triangle_depth =
+          (1 - u - v) * window(2, 0) + u * window(2, 1) + v * window(2, 2);
+      if (triangle_depth >= -1 && triangle_depth <= 1 &&
+          triangle_depth < *depth) {
+        *image_id = reg_image_id;
+        *depth = triangle_depth;
+      }
+    }
+  }
+}
+
 void ModelViewerWidget::SelectMoviewGrabberView(const size_t view_idx) {
   selected_movie_grabber_view_ = view_idx;
   UploadMovieGrabberData();
@@ -721,7 +746,6 @@ void ModelViewerWidget::mousePressEvent(QMouseEvent* event) {
   if (mouse_press_timer_.isActive()) {  // Select objects (2. click)
     mouse_is_pressed_ = false;
     mouse_press_timer_.stop();
-    selection_buffer_.clear();
     SelectObject(event->pos().x(), event->pos().y());
   } else {  // Set timer to remember 1. click
     mouse_press_timer_.setSingleShot(true);
@@ -906,12 +930,14 @@ void ModelViewerWidget::UploadCoordinateGridData() {
   coordinate_axes_painter_.Upload(axes_data);
 }
 
-void ModelViewerWidget::UploadPointData(const bool selection_mode) {
+void ModelViewerWidget::UploadPointData() {
   makeCurrent();
 
+  std::vector<uint64_t> ids;
   std::vector<PointPainter::Data> data;
 
   // Assume we want to display the majority of points
+  ids.reserve(points3D.size());
   data.reserve(points3D.size());
 
   const size_t min_track_len =
@@ -929,13 +955,7 @@ void ModelViewerWidget::UploadPointData(const bool selection_mode) {
         painter_point.z = static_cast<float>(point3D.second.xyz(2));
 
         Eigen::Vector4f color;
-        if (selection_mode) {
-          const size_t index = selection_buffer_.size();
-          selection_buffer_.push_back(
-              std::make_pair(point3D.first, SELECTION_BUFFER_POINT_IDX));
-          color = IndexToRGB(index);
-
-        } else if (point3D.first == selected_point3D_id_) {
+        if (point3D.first == selected_point3D_id_) {
           color = kSelectedPointColor;
         } else {
           color = point_colormap_->ComputeColor(point3D.first, point3D.second);
@@ -946,6 +966,7 @@ void ModelViewerWidget::UploadPointData(const bool selection_mode) {
         painter_point.b = color(2);
         painter_point.a = color(3);
 
+        ids.push_back(point3D.first);
         data.push_back(painter_point);
       }
     }
@@ -961,12 +982,7 @@ void ModelViewerWidget::UploadPointData(const bool selection_mode) {
         painter_point.z = static_cast<float>(point3D.second.xyz(2));
 
         Eigen::Vector4f color;
-        if (selection_mode) {
-          const size_t index = selection_buffer_.size();
-          selection_buffer_.push_back(
-              std::make_pair(point3D.first, SELECTION_BUFFER_POINT_IDX));
-          color = IndexToRGB(index);
-        } else if (selected_image.HasPoint3D(point3D.first)) {
+        if (selected_image.HasPoint3D(point3D.first)) {
           color = kSelectedImagePlaneColor;
         } else if (point3D.first == selected_point3D_id_) {
           color = kSelectedPointColor;
@@ -979,12 +995,13 @@ void ModelViewerWidget::UploadPointData(const bool selection_mode) {
         painter_point.b = color(2);
         painter_point.a = color(3);
 
+        ids.push_back(point3D.first);
         data.push_back(painter_point);
       }
     }
   }
 
-  point_painter_.Upload(data);
+  point_painter_.Upload(ids, data);
 }
 
 void ModelViewerWidget::UploadPointConnectionData() {
@@ -1028,7 +1045,7 @@ void ModelViewerWidget::UploadPointConnectionData() {
   point_connection_painter_.Upload(line_data);
 }
 
-void ModelViewerWidget::UploadImageData(const bool selection_mode) {
+void ModelViewerWidget::UploadImageData() {
   makeCurrent();
 
   std::vector<LinePainter::Data> line_data;
@@ -1043,29 +1060,20 @@ void ModelViewerWidget::UploadImageData(const bool selection_mode) {
 
     Eigen::Vector4f plane_color;
     Eigen::Vector4f frame_color;
-    if (selection_mode) {
-      const size_t index = selection_buffer_.size();
-      selection_buffer_.push_back(
-          std::make_pair(image_id, SELECTION_BUFFER_IMAGE_IDX));
-      plane_color = frame_color = IndexToRGB(index);
+    if (image_id == selected_image_id_) {
+      plane_color = kSelectedImagePlaneColor;
+      frame_color = kSelectedImageFrameColor;
     } else {
-      if (image_id == selected_image_id_) {
-        plane_color = kSelectedImagePlaneColor;
-        frame_color = kSelectedImageFrameColor;
-      } else {
-        image_colormap_->ComputeColor(image, &plane_color, &frame_color);
-      }
+      image_colormap_->ComputeColor(image, &plane_color, &frame_color);
     }
 
-    // Lines are not colored with the indexed color in selection mode, so do not
-    // show them, so they do not block the selection process
     BuildImageModel(image,
                     camera,
                     image_size_,
                     plane_color,
                     frame_color,
                     &triangle_data,
-                    selection_mode ? nullptr : &line_data);
+                    &line_data);
   }
 
   image_line_painter_.Upload(line_data);
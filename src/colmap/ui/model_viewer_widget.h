@@ -35,6 +35,7 @@
 #include "colmap/ui/colormaps.h"
 #include "colmap/ui/image_viewer_widget.h"
 #include "colmap/ui/line_painter.h"
+#include "colmap/ui/lod_point_painter.h"
 #include "colmap/ui/movie_grabber_widget.h"
 #include "colmap/ui/point_painter.h"
 #include "colmap/ui/point_viewer_widget.h"
@@ -140,14 +141,22 @@ class ModelViewerWidget : public QOpenGLWidget,
 
   void Upload();
   void UploadCoordinateGridData();
-  void UploadPointData(bool selection_mode = false);
+  void UploadPointData();
   void UploadPointConnectionData();
-  void UploadImageData(bool selection_mode = false);
+  void UploadImageData();
   void UploadImageConnectionData();
   void UploadMovieGrabberData();
 
   void ComposeProjectionMatrix();
 
+  // Pick the image plane closest to the viewer at the given window position
+  // in device pixels. The image and its depth in normalized device
+  // coordinates are only set if the image is closer than the given depth.
+  void PickImage(const QMatrix4x4& pmv_matrix,
+                 const Eigen::Vector2f& position,
+                 image_t* image_id,
+                 float* depth) const;
+
   float ZoomScale() const;
   float AspectRatio() const;
   float OrthographicWindowExtent() const;
@@ -162,7 +171,7 @@ class ModelViewerWidget : public QOpenGLWidget,
   LinePainter coordinate_axes_painter_;
   LinePainter coordinate_grid_painter_;
 
-  PointPainter point_painter_;
+  LODPointPainter point_painter_;
   LinePainter point_connection_painter_;
 
   LinePainter image_line_painter_;
@@ -186,7 +195,6 @@ class ModelViewerWidget : public QOpenGLWidget,
 
   float focus_distance_;
 
-  std::vector<std::pair<size_t, char>> selection_buffer_;
   image_t selected_image_id_;
   point3D_t selected_point3D_id_;
   size_t selected_movie_grabber_view_;
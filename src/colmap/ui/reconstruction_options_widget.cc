@@ -47,6 +47,8 @@ MapperGeneralOptionsWidget::MapperGeneralOptionsWidget(QWidget* parent,
   AddOptionDirPath(&options->mapper->snapshot_path, "snapshot_path");
   AddOptionInt(
       &options->mapper->snapshot_images_freq, "snapshot_images_freq", 0);
+  AddOptionBool(&options->mapper->snapshot_incremental,
+                "snapshot_incremental");
 }
 
 MapperTriangulationOptionsWidget::MapperTriangulationOptionsWidget(
@@ -63,6 +63,10 @@ class TrianglePainter {
   QOpenGLBuffer vbo_;
 
   size_t num_geoms_;
+  // Number of allocated geometries and the last uploaded data, which is used
+  // to only update the changed range of the buffer.
+  size_t capacity_;
+  std::vector<TrianglePainter::Data> data_;
 };
 
 }  // namespace colmap
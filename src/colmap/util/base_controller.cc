@@ -64,4 +64,8 @@ bool BaseController::CheckIfStopped() {
     return false;
 }
 
+Metrics& BaseController::GetMetrics() { return metrics_; }
+
+const Metrics& BaseController::GetMetrics() const { return metrics_; }
+
 }  // namespace colmap
@@ -29,6 +29,8 @@
 
 #pragma once
 
+#include "colmap/util/metrics.h"
+
 #include <functional>
 #include <list>
 #include <unordered_map>
@@ -60,6 +62,11 @@ class BaseController {
   void SetCheckIfStoppedFunc(const std::function<bool()>& func);
   bool CheckIfStopped();
 
+  // Progress metrics of the controller, which are updated from within the main
+  // run function and can be read or written to file from other threads.
+  Metrics& GetMetrics();
+  const Metrics& GetMetrics() const;
+
  protected:
   // Register a new callback. Note that only registered callbacks can be
   // set/reset and called from within the thread. Hence, this method should be
@@ -71,6 +78,8 @@ class BaseController {
   std::unordered_map<int, std::list<std::function<void()>>> callbacks_;
   // check_if_stop function
   std::function<bool()> check_if_stopped_fn_;
+  // progress metrics
+  Metrics metrics_;
 };
 
 }  // namespace colmap
@@ -31,11 +31,17 @@
 
 #include "colmap/util/logging.h"
 
+#include <algorithm>
+#include <condition_variable>
 #include <functional>
 #include <iostream>
 #include <limits>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace colmap {
 
@@ -100,6 +106,10 @@ class MemoryConstrainedLRUCache : public LRUCache<key_t, value_t> {
   size_t MaxNumBytes() const;
   void UpdateNumBytes(const key_t& key);
 
+  // Change the memory limit and evict least recently used elements until the
+  // new limit is satisfied. The most recently used element is never evicted.
+  void SetMaxNumBytes(size_t max_num_bytes);
+
   void Set(const key_t& key, value_t value) override;
   void Pop() override;
   void Clear() override;
@@ -112,11 +122,89 @@ class MemoryConstrainedLRUCache : public LRUCache<key_t, value_t> {
   using LRUCache<key_t, value_t>::elems_map_;
   using LRUCache<key_t, value_t>::getter_func_;
 
-  const size_t max_num_bytes_;
+  size_t max_num_bytes_;
   size_t num_bytes_;
   std::unordered_map<key_t, size_t> elems_num_bytes_;
 };
 
+// Thread-safe Least Recently Used cache implementation. The keys are
+// distributed over multiple shards by their hash and each shard is a separate
+// LRU cache with its own lock, so that concurrent readers of different keys
+// rarely contend. Values are returned by copy, since references would be
+// invalidated by concurrent evictions, so the values should be cheap to copy
+// (e.g., shared pointers). Missing values are computed outside of the lock and
+// only once: concurrent requests of a key that is being computed wait for the
+// result instead of calling the getter function again.
+template <typename key_t, typename value_t>
+class ThreadSafeLRUCache {
+ public:
+  struct Stats {
+    // Number of requests served from the cache.
+    size_t num_hits = 0;
+    // Number of requests that computed a new value.
+    size_t num_misses = 0;
+    // Number of elements evicted due to the size limit.
+    size_t num_evictions = 0;
+  };
+
+  // The maximum number of elements is divided evenly among the shards.
+  ThreadSafeLRUCache(size_t max_num_elems,
+                     const std::function<value_t(const key_t&)>& getter_func,
+                     size_t num_shards = 16);
+
+  // The number of elements in the cache.
+  size_t NumElems() const;
+  size_t MaxNumElems() const;
+  size_t NumShards() const;
+
+  // Check whether the element with the given key exists.
+  bool Exists(const key_t& key) const;
+
+  // Mark the element as recently used without counting it as a request.
+  // Returns whether the element exists.
+  bool Touch(const key_t& key);
+
+  // Get the value of an element either from the cache or compute the new value.
+  // If the getter function throws, the exception is propagated to the caller
+  // that computed the value and waiting callers retry the computation.
+  value_t Get(const key_t& key);
+
+  // Manually set the value of an element.
+  void Set(const key_t& key, value_t value);
+
+  // Clear all elements from cache.
+  void Clear();
+
+  // Accumulated statistics over all shards.
+  Stats GetStats() const;
+
+ private:
+  typedef typename std::pair<key_t, value_t> key_value_pair_t;
+  typedef typename std::list<key_value_pair_t>::iterator list_iterator_t;
+
+  struct Shard {
+    mutable std::mutex mutex;
+    std::condition_variable pending_condition;
+    std::list<key_value_pair_t> elems_list;
+    std::unordered_map<key_t, list_iterator_t> elems_map;
+    // Keys whose values are currently being computed by some thread.
+    std::unordered_set<key_t> pending_keys;
+    Stats stats;
+  };
+
+  Shard& GetShard(const key_t& key) const;
+
+  // Insert the value into the shard and evict elements beyond its capacity.
+  // The shard's mutex must be held by the caller.
+  void SetLocked(Shard* shard, const key_t& key, value_t value);
+
+  const size_t max_num_elems_;
+  size_t max_num_elems_per_shard_;
+  std::unique_ptr<Shard[]> shards_;
+  size_t num_shards_;
+  const std::function<value_t(const key_t&)> getter_func_;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -259,6 +347,16 @@ void MemoryConstrainedLRUCache<key_t, value_t>::UpdateNumBytes(
   }
 }
 
+template <typename key_t, typename value_t>
+void MemoryConstrainedLRUCache<key_t, value_t>::SetMaxNumBytes(
+    const size_t max_num_bytes) {
+  THROW_CHECK_GT(max_num_bytes, 0);
+  max_num_bytes_ = max_num_bytes;
+  while (num_bytes_ > max_num_bytes_ && elems_map_.size() > 1) {
+    Pop();
+  }
+}
+
 template <typename key_t, typename value_t>
 void MemoryConstrainedLRUCache<key_t, value_t>::Clear() {
   LRUCache<key_t, value_t>::Clear();
@@ -266,4 +364,153 @@ void MemoryConstrainedLRUCache<key_t, value_t>::Clear() {
   elems_num_bytes_.clear();
 }
 
+template <typename key_t, typename value_t>
+ThreadSafeLRUCache<key_t, value_t>::ThreadSafeLRUCache(
+    const size_t max_num_elems,
+    const std::function<value_t(const key_t&)>& getter_func,
+    const size_t num_shards)
+    : max_num_elems_(max_num_elems), getter_func_(getter_func) {
+  THROW_CHECK(getter_func);
+  THROW_CHECK_GT(max_num_elems, 0);
+  THROW_CHECK_GT(num_shards, 0);
+  // Never use more shards than elements, so that each shard holds at least one
+  // element and the total capacity does not exceed the maximum.
+  num_shards_ = std::min(num_shards, max_num_elems);
+  max_num_elems_per_shard_ = max_num_elems / num_shards_;
+  shards_.reset(new Shard[num_shards_]);
+}
+
+template <typename key_t, typename value_t>
+size_t ThreadSafeLRUCache<key_t, value_t>::NumElems() const {
+  size_t num_elems = 0;
+  for (size_t i = 0; i < num_shards_; ++i) {
+    std::lock_guard<std::mutex> lock(shards_[i].mutex);
+    num_elems += shards_[i].elems_map.size();
+  }
+  return num_elems;
+}
+
+template <typename key_t, typename value_t>
+size_t ThreadSafeLRUCache<key_t, value_t>::MaxNumElems() const {
+  return max_num_elems_;
+}
+
+template <typename key_t, typename value_t>
+size_t ThreadSafeLRUCache<key_t, value_t>::NumShards() const {
+  return num_shards_;
+}
+
+template <typename key_t, typename value_t>
+typename ThreadSafeLRUCache<key_t, value_t>::Shard&
+ThreadSafeLRUCache<key_t, value_t>::GetShard(const key_t& key) const {
+  return shards_[std::hash<key_t>()(key) % num_shards_];
+}
+
+template <typename key_t, typename value_t>
+bool ThreadSafeLRUCache<key_t, value_t>::Exists(const key_t& key) const {
+  const Shard& shard = GetShard(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  return shard.elems_map.find(key) != shard.elems_map.end();
+}
+
+template <typename key_t, typename value_t>
+bool ThreadSafeLRUCache<key_t, value_t>::Touch(const key_t& key) {
+  Shard& shard = GetShard(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  const auto it = shard.elems_map.find(key);
+  if (it == shard.elems_map.end()) {
+    return false;
+  }
+  shard.elems_list.splice(shard.elems_list.begin(), shard.elems_list, it->second);
+  return true;
+}
+
+template <typename key_t, typename value_t>
+value_t ThreadSafeLRUCache<key_t, value_t>::Get(const key_t& key) {
+  Shard& shard = GetShard(key);
+  std::unique_lock<std::mutex> lock(shard.mutex);
+  while (true) {
+    const auto it = shard.elems_map.find(key);
+    if (it != shard.elems_map.end()) {
+      shard.stats.num_hits += 1;
+      shard.elems_list.splice(
+          shard.elems_list.begin(), shard.elems_list, it->second);
+      return it->second->second;
+    }
+    if (shard.pending_keys.count(key) == 0) {
+      break;
+    }
+    shard.pending_condition.wait(lock);
+  }
+
+  shard.stats.num_misses += 1;
+  shard.pending_keys.insert(key);
+  lock.unlock();
+
+  try {
+    value_t value = getter_func_(key);
+    lock.lock();
+    shard.pending_keys.erase(key);
+    SetLocked(&shard, key, value);
+    lock.unlock();
+    shard.pending_condition.notify_all();
+    return value;
+  } catch (...) {
+    if (!lock.owns_lock()) {
+      lock.lock();
+    }
+    shard.pending_keys.erase(key);
+    lock.unlock();
+    shard.pending_condition.notify_all();
+    throw;
+  }
+}
+
+template <typename key_t, typename value_t>
+void ThreadSafeLRUCache<key_t, value_t>::Set(const key_t& key, value_t value) {
+  Shard& shard = GetShard(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  SetLocked(&shard, key, std::move(value));
+}
+
+template <typename key_t, typename value_t>
+void ThreadSafeLRUCache<key_t, value_t>::SetLocked(Shard* shard,
+                                                   const key_t& key,
+                                                   value_t value) {
+  auto it = shard->elems_map.find(key);
+  shard->elems_list.emplace_front(key, std::move(value));
+  if (it != shard->elems_map.end()) {
+    shard->elems_list.erase(it->second);
+    shard->elems_map.erase(it);
+  }
+  shard->elems_map[key] = shard->elems_list.begin();
+  while (shard->elems_map.size() > max_num_elems_per_shard_) {
+    shard->elems_map.erase(shard->elems_list.back().first);
+    shard->elems_list.pop_back();
+    shard->stats.num_evictions += 1;
+  }
+}
+
+template <typename key_t, typename value_t>
+void ThreadSafeLRUCache<key_t, value_t>::Clear() {
+  for (size_t i = 0; i < num_shards_; ++i) {
+    std::lock_guard<std::mutex> lock(shards_[i].mutex);
+    shards_[i].elems_list.clear();
+    shards_[i].elems_map.clear();
+  }
+}
+
+template <typename key_t, typename value_t>
+typename ThreadSafeLRUCache<key_t, value_t>::Stats
+ThreadSafeLRUCache<key_t, value_t>::GetStats() const {
+  Stats stats;
+  for (size_t i = 0; i < num_shards_; ++i) {
+    std::lock_guard<std::mutex> lock(shards_[i].mutex);
+    stats.num_hits += shards_[i].stats.num_hits;
+    stats.num_misses += shards_[i].stats.num_misses;
+    stats.num_evictions += shards_[i].stats.num_evictions;
+  }
+  return stats;
+}
+
 }  // namespace colmap
@@ -29,6 +29,12 @@
 
 #include "colmap/util/cache.h"
 
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -270,5 +276,143 @@ TEST(MemoryConstrainedLRUCache, UpdateNumBytes) {
   EXPECT_EQ(cache.NumBytes(), 2);
 }
 
+TEST(MemoryConstrainedLRUCache, SetMaxNumBytes) {
+  MemoryConstrainedLRUCache<int, SizedElem> cache(
+      50, [](const int key) { return SizedElem(key); });
+  for (int i = 1; i <= 5; ++i) {
+    cache.Get(i);
+  }
+  EXPECT_EQ(cache.NumBytes(), 15);
+
+  cache.SetMaxNumBytes(10);
+  EXPECT_EQ(cache.MaxNumBytes(), 10);
+  EXPECT_EQ(cache.NumBytes(), 9);
+  EXPECT_FALSE(cache.Exists(3));
+  EXPECT_TRUE(cache.Exists(4));
+  EXPECT_TRUE(cache.Exists(5));
+
+  cache.SetMaxNumBytes(1);
+  EXPECT_EQ(cache.NumElems(), 1);
+  EXPECT_TRUE(cache.Exists(5));
+}
+
+TEST(ThreadSafeLRUCache, Empty) {
+  ThreadSafeLRUCache<int, int> cache(
+      8, [](const int key) { return key; }, 4);
+  EXPECT_EQ(cache.NumElems(), 0);
+  EXPECT_EQ(cache.MaxNumElems(), 8);
+  EXPECT_EQ(cache.NumShards(), 4);
+}
+
+TEST(ThreadSafeLRUCache, NumShardsBoundedByNumElems) {
+  ThreadSafeLRUCache<int, int> cache(
+      2, [](const int key) { return key; }, 16);
+  EXPECT_EQ(cache.NumShards(), 2);
+}
+
+TEST(ThreadSafeLRUCache, Get) {
+  ThreadSafeLRUCache<int, int> cache(
+      5, [](const int key) { return key; }, 1);
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(cache.Get(i), i);
+    EXPECT_EQ(cache.NumElems(), i + 1);
+    EXPECT_TRUE(cache.Exists(i));
+  }
+
+  EXPECT_EQ(cache.Get(5), 5);
+  EXPECT_EQ(cache.NumElems(), 5);
+  EXPECT_FALSE(cache.Exists(0));
+  EXPECT_TRUE(cache.Exists(5));
+
+  EXPECT_TRUE(cache.Touch(1));
+  EXPECT_FALSE(cache.Touch(0));
+  EXPECT_EQ(cache.Get(6), 6);
+  EXPECT_TRUE(cache.Exists(1));
+  EXPECT_FALSE(cache.Exists(2));
+
+  const auto stats = cache.GetStats();
+  EXPECT_EQ(stats.num_hits, 0);
+  EXPECT_EQ(stats.num_misses, 7);
+  EXPECT_EQ(stats.num_evictions, 2);
+}
+
+TEST(ThreadSafeLRUCache, SetAndClear) {
+  ThreadSafeLRUCache<int, int> cache(
+      4, [](const int key) { return key; }, 2);
+  cache.Set(0, 10);
+  EXPECT_EQ(cache.Get(0), 10);
+  cache.Set(0, 20);
+  EXPECT_EQ(cache.Get(0), 20);
+  EXPECT_EQ(cache.NumElems(), 1);
+  EXPECT_EQ(cache.GetStats().num_hits, 2);
+  cache.Clear();
+  EXPECT_EQ(cache.NumElems(), 0);
+  EXPECT_EQ(cache.Get(0), 0);
+}
+
+TEST(ThreadSafeLRUCache, GetterException) {
+  bool do_throw = true;
+  ThreadSafeLRUCache<int, int> cache(4, [&do_throw](const int key) {
+    if (do_throw) {
+      throw std::runtime_error("getter failed");
+    }
+    return key;
+  });
+  EXPECT_THROW(cache.Get(1), std::runtime_error);
+  EXPECT_FALSE(cache.Exists(1));
+  do_throw = false;
+  EXPECT_EQ(cache.Get(1), 1);
+}
+
+TEST(ThreadSafeLRUCache, ConcurrentGetSingleFlight) {
+  std::atomic<int> num_getter_calls(0);
+  ThreadSafeLRUCache<int, int> cache(100, [&num_getter_calls](const int key) {
+    num_getter_calls += 1;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return 2 * key;
+  });
+
+  constexpr int kNumThreads = 8;
+  constexpr int kNumKeys = 10;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kNumThreads; ++t) {
+    threads.emplace_back([&cache]() {
+      for (int i = 0; i < kNumKeys; ++i) {
+        EXPECT_EQ(cache.Get(i), 2 * i);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(num_getter_calls, kNumKeys);
+  const auto stats = cache.GetStats();
+  EXPECT_EQ(stats.num_misses, kNumKeys);
+  EXPECT_EQ(stats.num_hits, (kNumThreads - 1) * kNumKeys);
+  EXPECT_EQ(stats.num_evictions, 0);
+}
+
+TEST(ThreadSafeLRUCache, ConcurrentEviction) {
+  ThreadSafeLRUCache<int, int> cache(
+      8, [](const int key) { return key; }, 4);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&cache, t]() {
+      for (int i = 0; i < 1000; ++i) {
+        const int key = (i * 7 + t) % 64;
+        EXPECT_EQ(cache.Get(key), key);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_LE(cache.NumElems(), 8);
+  const auto stats = cache.GetStats();
+  EXPECT_EQ(stats.num_hits + stats.num_misses, 4000);
+  EXPECT_EQ(stats.num_misses - stats.num_evictions, cache.NumElems());
+}
+
 }  // namespace
 }  // namespace colmap
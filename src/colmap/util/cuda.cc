@@ -31,8 +31,11 @@
 
 #include "colmap/util/cudacc.h"
 #include "colmap/util/logging.h"
+#include "colmap/util/string.h"
+#include "colmap/util/threading.h"
 
 #include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <vector>
 
@@ -81,6 +84,43 @@ void SetBestCudaDevice(const int gpu_index) {
   cudaDeviceProp device;
   cudaGetDeviceProperties(&device, selected_gpu_index);
   CUDA_SAFE_CALL(cudaSetDevice(selected_gpu_index));
+  SetCudaDeviceThreadAffinity(selected_gpu_index);
+}
+
+bool SetCudaDeviceThreadAffinity(const int gpu_index) {
+  if (GetThreadAffinity() == ThreadAffinity::NONE || gpu_index < 0) {
+    return false;
+  }
+
+  char pci_bus_id[32];
+  if (cudaDeviceGetPCIBusId(pci_bus_id, sizeof(pci_bus_id), gpu_index) !=
+      cudaSuccess) {
+    return false;
+  }
+
+  // The sysfs uses lower-case PCI addresses.
+  std::string pci_address(pci_bus_id);
+  StringToLower(&pci_address);
+  std::ifstream file(StringPrintf("/sys/bus/pci/devices/%s/local_cpulist",
+                                  pci_address.c_str()));
+  std::string cpu_list;
+  if (!file.is_open() || !std::getline(file, cpu_list)) {
+    return false;
+  }
+
+  // Only bind to the CPUs on which the process may run.
+  std::vector<int> cpus;
+  const std::vector<int> device_cpus = ParseCPUList(cpu_list);
+  for (const auto& node_cpus : GetNumaNodeCPUs()) {
+    for (const int cpu : node_cpus) {
+      if (std::find(device_cpus.begin(), device_cpus.end(), cpu) !=
+          device_cpus.end()) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+
+  return SetCurrentThreadCPUs(cpus);
 }
 
 }  // namespace colmap
@@ -35,4 +35,9 @@ int GetNumCudaDevices();
 
 void SetBestCudaDevice(int gpu_index);
 
+// Bind the current thread to the CPUs of the socket to which the given CUDA
+// device is attached, if thread affinities are enabled, see ThreadAffinity in
+// util/threading.h. Returns whether the thread was bound.
+bool SetCudaDeviceThreadAffinity(int gpu_index);
+
 }  // namespace colmap
@@ -0,0 +1,149 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/util/mapped_file.h"
+
+#include "colmap/util/logging.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace colmap {
+
+MappedFile::MappedFile(const std::string& path) { Open(path); }
+
+MappedFile::~MappedFile() { Close(); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+  *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    Close();
+    path_ = std::move(other.path_);
+    is_open_ = std::exchange(other.is_open_, false);
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+#ifdef _WIN32
+    file_handle_ = std::exchange(other.file_handle_, nullptr);
+    mapping_handle_ = std::exchange(other.mapping_handle_, nullptr);
+#endif
+  }
+  return *this;
+}
+
+void MappedFile::Open(const std::string& path) {
+  Close();
+
+#ifdef _WIN32
+  HANDLE file_handle = CreateFileA(path.c_str(),
+                                   GENERIC_READ,
+                                   FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                   nullptr,
+                                   OPEN_EXISTING,
+                                   FILE_ATTRIBUTE_NORMAL,
+                                   nullptr);
+  THROW_CHECK(file_handle != INVALID_HANDLE_VALUE)
+      << "Failed to open file " << path;
+  LARGE_INTEGER file_size;
+  THROW_CHECK(GetFileSizeEx(file_handle, &file_size));
+  file_handle_ = file_handle;
+  size_ = static_cast<size_t>(file_size.QuadPart);
+  if (size_ > 0) {
+    HANDLE mapping_handle =
+        CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    THROW_CHECK_NOTNULL(mapping_handle);
+    mapping_handle_ = mapping_handle;
+    data_ = static_cast<const uint8_t*>(
+        MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    THROW_CHECK_NOTNULL(data_);
+  }
+#else
+  const int fd = open(path.c_str(), O_RDONLY);
+  THROW_CHECK_GE(fd, 0) << "Failed to open file " << path;
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    close(fd);
+    LOG(FATAL_THROW) << "Failed to stat file " << path;
+  }
+  size_ = static_cast<size_t>(file_stat.st_size);
+  if (size_ > 0) {
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    THROW_CHECK(data != MAP_FAILED) << "Failed to map file " << path;
+    data_ = static_cast<const uint8_t*>(data);
+  } else {
+    close(fd);
+  }
+#endif
+
+  path_ = path;
+  is_open_ = true;
+}
+
+void MappedFile::Close() {
+  if (!is_open_) {
+    return;
+  }
+
+#ifdef _WIN32
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_handle_ != nullptr) {
+    CloseHandle(mapping_handle_);
+  }
+  if (file_handle_ != nullptr) {
+    CloseHandle(file_handle_);
+  }
+  file_handle_ = nullptr;
+  mapping_handle_ = nullptr;
+#else
+  if (data_ != nullptr) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+  }
+#endif
+
+  path_.clear();
+  is_open_ = false;
+  data_ = nullptr;
+  size_ = 0;
+}
+
+}  // namespace colmap
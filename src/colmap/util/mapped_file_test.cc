@@ -0,0 +1,87 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/util/mapped_file.h"
+
+#include "colmap/util/testing.h"
+
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+TEST(MappedFile, Empty) {
+  MappedFile file;
+  EXPECT_FALSE(file.IsOpen());
+  EXPECT_EQ(file.Data(), nullptr);
+  EXPECT_EQ(file.Size(), 0);
+}
+
+TEST(MappedFile, EmptyFile) {
+  const std::string path = CreateTestDir() + "/file.bin";
+  { std::ofstream file(path, std::ios::binary); }
+  MappedFile file(path);
+  EXPECT_TRUE(file.IsOpen());
+  EXPECT_EQ(file.Data(), nullptr);
+  EXPECT_EQ(file.Size(), 0);
+  EXPECT_EQ(file.Path(), path);
+}
+
+TEST(MappedFile, OpenClose) {
+  const std::string path = CreateTestDir() + "/file.bin";
+  const std::string data = "0123456789";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << data;
+  }
+  MappedFile file(path);
+  EXPECT_TRUE(file.IsOpen());
+  EXPECT_EQ(file.Size(), data.size());
+  EXPECT_EQ(std::string(reinterpret_cast<const char*>(file.Data()),
+                        file.Size()),
+            data);
+  MappedFile moved_file(std::move(file));
+  EXPECT_FALSE(file.IsOpen());
+  EXPECT_TRUE(moved_file.IsOpen());
+  EXPECT_EQ(moved_file.Size(), data.size());
+  moved_file.Close();
+  EXPECT_FALSE(moved_file.IsOpen());
+  EXPECT_EQ(moved_file.Data(), nullptr);
+}
+
+TEST(MappedFile, NonExistent) {
+  MappedFile file;
+  EXPECT_ANY_THROW(file.Open(CreateTestDir() + "/non_existent.bin"));
+}
+
+}  // namespace
+}  // namespace colmap
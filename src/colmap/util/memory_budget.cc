@@ -0,0 +1,165 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/util/memory_budget.h"
+
+#include "colmap/util/logging.h"
+#include "colmap/util/metrics.h"
+#include "colmap/util/misc.h"
+
+#include <algorithm>
+
+namespace colmap {
+namespace {
+
+double BytesToGB(const size_t num_bytes) {
+  return num_bytes / (1024.0 * 1024.0 * 1024.0);
+}
+
+}  // namespace
+
+MemoryBudget& MemoryBudget::Global() {
+  static MemoryBudget budget;
+  return budget;
+}
+
+void MemoryBudget::SetMaxNumBytes(const size_t max_num_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_num_bytes_ = max_num_bytes;
+}
+
+size_t MemoryBudget::MaxNumBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return max_num_bytes_;
+}
+
+bool MemoryBudget::IsLimited() const { return MaxNumBytes() > 0; }
+
+size_t MemoryBudget::NumBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_bytes_;
+}
+
+size_t MemoryBudget::PeakNumBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return peak_num_bytes_;
+}
+
+std::map<std::string, size_t> MemoryBudget::NumBytesPerName() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::map<std::string, size_t> num_bytes;
+  for (const auto& usage : usages_) {
+    num_bytes.emplace(usage.first, usage.second.num_bytes);
+  }
+  return num_bytes;
+}
+
+std::map<std::string, size_t> MemoryBudget::PeakNumBytesPerName() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::map<std::string, size_t> peak_num_bytes;
+  for (const auto& usage : usages_) {
+    peak_num_bytes.emplace(usage.first, usage.second.peak_num_bytes);
+  }
+  return peak_num_bytes;
+}
+
+void MemoryBudget::PrintReport() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  LOG(INFO) << StringPrintf("Peak resident memory: %.3f GB",
+                            BytesToGB(GetPeakResidentMemoryBytes()));
+  if (usages_.empty()) {
+    return;
+  }
+  if (max_num_bytes_ > 0) {
+    LOG(INFO) << StringPrintf("Peak accounted memory: %.3f / %.3f GB",
+                              BytesToGB(peak_num_bytes_),
+                              BytesToGB(max_num_bytes_));
+  } else {
+    LOG(INFO) << StringPrintf("Peak accounted memory: %.3f GB",
+                              BytesToGB(peak_num_bytes_));
+  }
+  for (const auto& usage : usages_) {
+    LOG(INFO) << StringPrintf("  %s: %.3f GB",
+                              usage.first.c_str(),
+                              BytesToGB(usage.second.peak_num_bytes));
+  }
+}
+
+void MemoryBudget::Update(const std::string& name,
+                          const size_t prev_num_bytes,
+                          const size_t num_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Usage& usage = usages_[name];
+  usage.num_bytes = usage.num_bytes - prev_num_bytes + num_bytes;
+  usage.peak_num_bytes = std::max(usage.peak_num_bytes, usage.num_bytes);
+  num_bytes_ = num_bytes_ - prev_num_bytes + num_bytes;
+  peak_num_bytes_ = std::max(peak_num_bytes_, num_bytes_);
+}
+
+size_t MemoryBudget::AvailableNumBytes(const size_t own_num_bytes) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (max_num_bytes_ == 0) {
+    return std::numeric_limits<size_t>::max();
+  }
+  const size_t other_num_bytes = num_bytes_ - own_num_bytes;
+  if (other_num_bytes >= max_num_bytes_) {
+    return 0;
+  }
+  return max_num_bytes_ - other_num_bytes;
+}
+
+MemoryAccount::MemoryAccount(std::string name, MemoryBudget* budget)
+    : name_(std::move(name)),
+      budget_(THROW_CHECK_NOTNULL(budget)),
+      num_bytes_(0) {
+  budget_->Update(name_, 0, 0);
+}
+
+MemoryAccount::~MemoryAccount() { budget_->Update(name_, num_bytes_, 0); }
+
+const std::string& MemoryAccount::Name() const { return name_; }
+
+void MemoryAccount::SetNumBytes(const size_t num_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  budget_->Update(name_, num_bytes_, num_bytes);
+  num_bytes_ = num_bytes;
+}
+
+size_t MemoryAccount::NumBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_bytes_;
+}
+
+size_t MemoryAccount::AvailableNumBytes(const size_t max_num_bytes) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::min(max_num_bytes, budget_->AvailableNumBytes(num_bytes_));
+}
+
+}  // namespace colmap
@@ -0,0 +1,116 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace colmap {
+
+// Process-wide accounting of the memory used by different subsystems, such as
+// caches and reconstructions, under an optional global budget. Subsystems
+// report their current usage through a MemoryAccount and caches can query how
+// many bytes they may use given the usage of all other accounts, so that they
+// shrink when other subsystems grow.
+class MemoryBudget {
+ public:
+  static MemoryBudget& Global();
+
+  // Maximum number of bytes for all accounts together. The budget is
+  // unlimited by default or when set to zero.
+  void SetMaxNumBytes(size_t max_num_bytes);
+  size_t MaxNumBytes() const;
+  bool IsLimited() const;
+
+  // Current and peak number of bytes of all accounts together.
+  size_t NumBytes() const;
+  size_t PeakNumBytes() const;
+
+  // Current and peak number of bytes per account name. Accounts with the same
+  // name are summed up. Names of destroyed accounts are kept to report their
+  // peak usage.
+  std::map<std::string, size_t> NumBytesPerName() const;
+  std::map<std::string, size_t> PeakNumBytesPerName() const;
+
+  // Log the peak usage of all accounts and the peak resident memory of the
+  // process.
+  void PrintReport() const;
+
+ private:
+  friend class MemoryAccount;
+
+  struct Usage {
+    size_t num_bytes = 0;
+    size_t peak_num_bytes = 0;
+  };
+
+  void Update(const std::string& name, size_t prev_num_bytes, size_t num_bytes);
+  size_t AvailableNumBytes(size_t own_num_bytes) const;
+
+  mutable std::mutex mutex_;
+  size_t max_num_bytes_ = 0;
+  size_t num_bytes_ = 0;
+  size_t peak_num_bytes_ = 0;
+  std::map<std::string, Usage> usages_;
+};
+
+// Reports the memory usage of one subsystem instance to a memory budget. The
+// account is thread-safe.
+class MemoryAccount {
+ public:
+  explicit MemoryAccount(std::string name,
+                         MemoryBudget* budget = &MemoryBudget::Global());
+  ~MemoryAccount();
+
+  MemoryAccount(const MemoryAccount&) = delete;
+  MemoryAccount& operator=(const MemoryAccount&) = delete;
+
+  const std::string& Name() const;
+
+  // Set the current number of bytes used by the subsystem.
+  void SetNumBytes(size_t num_bytes);
+  size_t NumBytes() const;
+
+  // The number of bytes the subsystem may use without exceeding the budget,
+  // given the current usage of all other accounts, capped at max_num_bytes.
+  size_t AvailableNumBytes(
+      size_t max_num_bytes = std::numeric_limits<size_t>::max()) const;
+
+ private:
+  const std::string name_;
+  MemoryBudget* budget_;
+  mutable std::mutex mutex_;
+  size_t num_bytes_;
+};
+
+}  // namespace colmap
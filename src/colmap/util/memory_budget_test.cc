@@ -0,0 +1,90 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/util/memory_budget.h"
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+TEST(MemoryBudget, Unlimited) {
+  MemoryBudget budget;
+  EXPECT_FALSE(budget.IsLimited());
+  MemoryAccount account("account", &budget);
+  account.SetNumBytes(100);
+  EXPECT_EQ(account.NumBytes(), 100);
+  EXPECT_EQ(budget.NumBytes(), 100);
+  EXPECT_EQ(account.AvailableNumBytes(), std::numeric_limits<size_t>::max());
+  EXPECT_EQ(account.AvailableNumBytes(50), 50);
+}
+
+TEST(MemoryBudget, Limited) {
+  MemoryBudget budget;
+  budget.SetMaxNumBytes(100);
+  EXPECT_TRUE(budget.IsLimited());
+  EXPECT_EQ(budget.MaxNumBytes(), 100);
+  MemoryAccount account1("account1", &budget);
+  MemoryAccount account2("account2", &budget);
+  account1.SetNumBytes(30);
+  EXPECT_EQ(account1.AvailableNumBytes(), 100);
+  EXPECT_EQ(account2.AvailableNumBytes(), 70);
+  account2.SetNumBytes(60);
+  EXPECT_EQ(account1.AvailableNumBytes(), 40);
+  EXPECT_EQ(account1.AvailableNumBytes(20), 20);
+  account2.SetNumBytes(120);
+  EXPECT_EQ(account1.AvailableNumBytes(), 0);
+  EXPECT_EQ(budget.NumBytes(), 150);
+}
+
+TEST(MemoryBudget, PeakPerName) {
+  MemoryBudget budget;
+  {
+    MemoryAccount account1("cache", &budget);
+    MemoryAccount account2("cache", &budget);
+    MemoryAccount account3("other", &budget);
+    account1.SetNumBytes(10);
+    account2.SetNumBytes(20);
+    account3.SetNumBytes(5);
+    account1.SetNumBytes(0);
+    EXPECT_EQ(budget.NumBytesPerName().at("cache"), 20);
+    EXPECT_EQ(budget.NumBytes(), 25);
+  }
+  EXPECT_EQ(budget.NumBytes(), 0);
+  EXPECT_EQ(budget.PeakNumBytes(), 35);
+  const auto num_bytes = budget.NumBytesPerName();
+  const auto peak_num_bytes = budget.PeakNumBytesPerName();
+  EXPECT_EQ(num_bytes.at("cache"), 0);
+  EXPECT_EQ(peak_num_bytes.at("cache"), 30);
+  EXPECT_EQ(peak_num_bytes.at("other"), 5);
+}
+
+}  // namespace
+}  // namespace colmap
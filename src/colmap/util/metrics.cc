@@ -0,0 +1,215 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/util/metrics.h"
+
+#include "colmap/util/logging.h"
+#include "colmap/util/misc.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <sys/resource.h>
+#endif
+
+namespace colmap {
+namespace {
+
+double GetValue(const std::map<std::string, double>& values,
+                const std::string& name) {
+  const auto it = values.find(name);
+  if (it == values.end()) {
+    return 0;
+  }
+  return it->second;
+}
+
+void WriteJSONObject(const std::map<std::string, double>& values,
+                     std::ostream& stream) {
+  stream << "{";
+  bool first = true;
+  for (const auto& value : values) {
+    if (!first) {
+      stream << ",";
+    }
+    first = false;
+    stream << "\n    \"" << value.first << "\": " << value.second;
+  }
+  stream << (values.empty() ? "}" : "\n  }");
+}
+
+}  // namespace
+
+void Metrics::IncrementCounter(const std::string& name, const double value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  counters_[name] += value;
+}
+
+void Metrics::SetGauge(const std::string& name, const double value) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  gauges_[name] = value;
+}
+
+double Metrics::Counter(const std::string& name) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return GetValue(counters_, name);
+}
+
+double Metrics::Gauge(const std::string& name) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return GetValue(gauges_, name);
+}
+
+std::map<std::string, double> Metrics::Counters() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return counters_;
+}
+
+std::map<std::string, double> Metrics::Gauges() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return gauges_;
+}
+
+void Metrics::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  counters_.clear();
+  gauges_.clear();
+}
+
+void Metrics::WriteJSON(std::ostream& stream) const {
+  const auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
+  std::lock_guard<std::mutex> lock(mutex_);
+  stream << std::setprecision(std::numeric_limits<double>::max_digits10);
+  stream << "{\n  \"timestamp_ms\": " << timestamp << ",\n  \"counters\": ";
+  WriteJSONObject(counters_, stream);
+  stream << ",\n  \"gauges\": ";
+  WriteJSONObject(gauges_, stream);
+  stream << "\n}\n";
+}
+
+void Metrics::WriteJSON(const std::string& path) const {
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ios::trunc);
+    THROW_CHECK_FILE_OPEN(file, tmp_path);
+    WriteJSON(file);
+  }
+  THROW_CHECK_EQ(std::rename(tmp_path.c_str(), path.c_str()), 0)
+      << "Could not rename " << tmp_path << " to " << path;
+}
+
+size_t GetResidentMemoryBytes() {
+#if defined(__linux__)
+  std::ifstream file("/proc/self/statm");
+  size_t num_total_pages = 0;
+  size_t num_resident_pages = 0;
+  if (file >> num_total_pages >> num_resident_pages) {
+    return num_resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  }
+  return 0;
+#elif defined(__APPLE__)
+  mach_task_basic_info info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(),
+                MACH_TASK_BASIC_INFO,
+                reinterpret_cast<task_info_t>(&info),
+                &count) == KERN_SUCCESS) {
+    return info.resident_size;
+  }
+  return 0;
+#else
+  return 0;
+#endif
+}
+
+size_t GetPeakResidentMemoryBytes() {
+#if defined(__linux__) || defined(__APPLE__)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#if defined(__APPLE__)
+  return static_cast<size_t>(usage.ru_maxrss);
+#else
+  // Linux reports the maximum resident set size in kilobytes.
+  return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+  return 0;
+#endif
+}
+
+MetricsFileWriter::MetricsFileWriter(Metrics* metrics,
+                                     const std::string& path,
+                                     const double interval_seconds)
+    : metrics_(THROW_CHECK_NOTNULL(metrics)), path_(path), stopped_(false) {
+  THROW_CHECK_GT(interval_seconds, 0);
+  const auto interval = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::duration<double>(interval_seconds));
+  thread_ = std::thread([this, interval]() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_condition_.wait_for(
+        lock, interval, [this]() { return stopped_; })) {
+      Write();
+    }
+  });
+}
+
+MetricsFileWriter::~MetricsFileWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  stop_condition_.notify_all();
+  thread_.join();
+  Write();
+}
+
+void MetricsFileWriter::Write() {
+  metrics_->SetGauge("resident_memory_bytes",
+                     static_cast<double>(GetResidentMemoryBytes()));
+  try {
+    metrics_->WriteJSON(path_);
+  } catch (const std::exception& error) {
+    LOG(WARNING) << "Failed to write metrics: " << error.what();
+  }
+}
+
+}  // namespace colmap
@@ -0,0 +1,103 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <condition_variable>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace colmap {
+
+// Thread-safe collection of named numeric metrics of a long-running process,
+// e.g., to monitor its progress externally. Counters accumulate increments,
+// while gauges hold the most recently set value.
+class Metrics {
+ public:
+  void IncrementCounter(const std::string& name, double value = 1);
+  void SetGauge(const std::string& name, double value);
+
+  // Get the value of a counter or gauge or zero if it was never set.
+  double Counter(const std::string& name) const;
+  double Gauge(const std::string& name) const;
+
+  std::map<std::string, double> Counters() const;
+  std::map<std::string, double> Gauges() const;
+
+  void Clear();
+
+  // Write the metrics as a JSON object with separate counters and gauges
+  // objects. The file is written to a temporary path first and then renamed,
+  // so that readers never see a partially written file.
+  void WriteJSON(std::ostream& stream) const;
+  void WriteJSON(const std::string& path) const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::map<std::string, double> counters_;
+  std::map<std::string, double> gauges_;
+};
+
+// Resident set size of the current process in bytes or zero, if it cannot be
+// determined on the current platform.
+size_t GetResidentMemoryBytes();
+
+// Peak resident set size of the current process in bytes or zero, if it cannot
+// be determined on the current platform.
+size_t GetPeakResidentMemoryBytes();
+
+// Periodically writes the metrics to a JSON file from a background thread,
+// together with the "resident_memory_bytes" gauge of the process. The
+// metrics are written a final time when the writer is destroyed.
+class MetricsFileWriter {
+ public:
+  MetricsFileWriter(Metrics* metrics,
+                    const std::string& path,
+                    double interval_seconds);
+  ~MetricsFileWriter();
+
+  MetricsFileWriter(const MetricsFileWriter&) = delete;
+  MetricsFileWriter& operator=(const MetricsFileWriter&) = delete;
+
+ private:
+  void Write();
+
+  Metrics* metrics_;
+  const std::string path_;
+  std::mutex mutex_;
+  std::condition_variable stop_condition_;
+  bool stopped_;
+  std::thread thread_;
+};
+
+}  // namespace colmap
@@ -0,0 +1,112 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/util/metrics.h"
+
+#include "colmap/util/misc.h"
+#include "colmap/util/testing.h"
+
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+TEST(Metrics, Empty) {
+  Metrics metrics;
+  EXPECT_TRUE(metrics.Counters().empty());
+  EXPECT_TRUE(metrics.Gauges().empty());
+  EXPECT_EQ(metrics.Counter("missing"), 0);
+  EXPECT_EQ(metrics.Gauge("missing"), 0);
+}
+
+TEST(Metrics, CountersAndGauges) {
+  Metrics metrics;
+  metrics.IncrementCounter("counter");
+  metrics.IncrementCounter("counter", 2);
+  metrics.SetGauge("gauge", 5);
+  metrics.SetGauge("gauge", 3);
+  EXPECT_EQ(metrics.Counter("counter"), 3);
+  EXPECT_EQ(metrics.Gauge("gauge"), 3);
+  EXPECT_EQ(metrics.Counters().size(), 1);
+  EXPECT_EQ(metrics.Gauges().size(), 1);
+  metrics.Clear();
+  EXPECT_TRUE(metrics.Counters().empty());
+  EXPECT_TRUE(metrics.Gauges().empty());
+}
+
+TEST(Metrics, ConcurrentIncrement) {
+  Metrics metrics;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&metrics]() {
+      for (int j = 0; j < 1000; ++j) {
+        metrics.IncrementCounter("counter");
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(metrics.Counter("counter"), 4000);
+}
+
+TEST(Metrics, WriteJSON) {
+  Metrics metrics;
+  metrics.IncrementCounter("num_images", 2);
+  metrics.SetGauge("num_points", 10);
+  std::ostringstream stream;
+  metrics.WriteJSON(stream);
+  const std::string json = stream.str();
+  EXPECT_NE(json.find("\"timestamp_ms\""), std::string::npos);
+  EXPECT_NE(json.find("\"num_images\": 2"), std::string::npos);
+  EXPECT_NE(json.find("\"num_points\": 10"), std::string::npos);
+}
+
+TEST(MetricsFileWriter, Nominal) {
+  const std::string test_dir = CreateTestDir();
+  const std::string path = JoinPaths(test_dir, "metrics.json");
+  Metrics metrics;
+  metrics.SetGauge("gauge", 1);
+  { MetricsFileWriter writer(&metrics, path, 0.001); }
+  EXPECT_TRUE(ExistsFile(path));
+  EXPECT_FALSE(ExistsFile(path + ".tmp"));
+  const std::vector<std::string> lines = ReadTextFileLines(path);
+  EXPECT_FALSE(lines.empty());
+#if defined(__linux__) || defined(__APPLE__)
+  EXPECT_GT(metrics.Gauge("resident_memory_bytes"), 0);
+#endif
+}
+
+}  // namespace
+}  // namespace colmap
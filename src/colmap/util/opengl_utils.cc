@@ -31,9 +31,115 @@
 
 #include "colmap/util/logging.h"
 
+#if defined(COLMAP_EGL_ENABLED)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
 namespace colmap {
 
-#if defined(COLMAP_GUI_ENABLED)
+#if defined(COLMAP_EGL_ENABLED)
+namespace {
+
+// Get the display of the first GPU without a display server, if the EGL
+// device extensions are available, and the default display otherwise.
+EGLDisplay GetHeadlessEGLDisplay() {
+  const auto query_devices = reinterpret_cast<PFNEGLQUERYDEVICESEXTPROC>(
+      eglGetProcAddress("eglQueryDevicesEXT"));
+  const auto get_platform_display =
+      reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+          eglGetProcAddress("eglGetPlatformDisplayEXT"));
+  if (query_devices != nullptr && get_platform_display != nullptr) {
+    EGLDeviceEXT device;
+    EGLint num_devices = 0;
+    if (query_devices(1, &device, &num_devices) && num_devices > 0) {
+      const EGLDisplay display =
+          get_platform_display(EGL_PLATFORM_DEVICE_EXT, device, nullptr);
+      if (display != EGL_NO_DISPLAY) {
+        return display;
+      }
+    }
+  }
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+}  // namespace
+
+OpenGLContextManager::OpenGLContextManager(int opengl_major_version,
+                                           int opengl_minor_version)
+    : display_(EGL_NO_DISPLAY),
+      surface_(EGL_NO_SURFACE),
+      context_(EGL_NO_CONTEXT) {
+  // Initializing an already initialized display has no effect, such that all
+  // contexts share the display, which is never terminated.
+  display_ = GetHeadlessEGLDisplay();
+  THROW_CHECK(display_ != EGL_NO_DISPLAY) << "Could not get EGL display";
+  THROW_CHECK(eglInitialize(display_, nullptr, nullptr))
+      << "Could not initialize EGL display";
+
+  const EGLint config_attribs[] = {EGL_SURFACE_TYPE,
+                                   EGL_PBUFFER_BIT,
+                                   EGL_RENDERABLE_TYPE,
+                                   EGL_OPENGL_BIT,
+                                   EGL_RED_SIZE,
+                                   8,
+                                   EGL_GREEN_SIZE,
+                                   8,
+                                   EGL_BLUE_SIZE,
+                                   8,
+                                   EGL_DEPTH_SIZE,
+                                   24,
+                                   EGL_NONE};
+  EGLConfig config;
+  EGLint num_configs = 0;
+  THROW_CHECK(
+      eglChooseConfig(display_, config_attribs, &config, 1, &num_configs) &&
+      num_configs > 0)
+      << "Could not find EGL config for OpenGL";
+
+  // The context is never displayed, so a minimal surface suffices.
+  const EGLint surface_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+  surface_ = eglCreatePbufferSurface(display_, config, surface_attribs);
+  THROW_CHECK(surface_ != EGL_NO_SURFACE) << "Could not create EGL surface";
+
+  THROW_CHECK(eglBindAPI(EGL_OPENGL_API));
+  const EGLint context_attribs[] = {
+      EGL_CONTEXT_MAJOR_VERSION_KHR,
+      opengl_major_version,
+      EGL_CONTEXT_MINOR_VERSION_KHR,
+      opengl_minor_version,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR,
+      EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT_KHR,
+      EGL_NONE};
+  context_ =
+      eglCreateContext(display_, config, EGL_NO_CONTEXT, context_attribs);
+  THROW_CHECK(context_ != EGL_NO_CONTEXT)
+      << "Could not create valid OpenGL context";
+}
+
+OpenGLContextManager::~OpenGLContextManager() {
+  // Contexts and surfaces that are still current in a thread are only
+  // destroyed once they are released.
+  if (context_ != EGL_NO_CONTEXT) {
+    eglDestroyContext(display_, context_);
+  }
+  if (surface_ != EGL_NO_SURFACE) {
+    eglDestroySurface(display_, surface_);
+  }
+}
+
+bool OpenGLContextManager::MakeCurrent() {
+  // The bound client API is a per-thread state.
+  return eglBindAPI(EGL_OPENGL_API) &&
+         eglMakeCurrent(display_, surface_, surface_, context_);
+}
+
+void RunThreadWithOpenGLContext(Thread* thread) {
+  thread->Start();
+  thread->Wait();
+}
+
+#elif defined(COLMAP_GUI_ENABLED)
 OpenGLContextManager::OpenGLContextManager(int opengl_major_version,
                                            int opengl_minor_version)
     : parent_thread_(QThread::currentThread()),
@@ -88,6 +194,9 @@ void RunThreadWithOpenGLContext(Thread* thread) {
   QCoreApplication::processEvents();
 }
 
+#endif
+
+#if defined(COLMAP_GUI_ENABLED)
 void GLError(const char* file, const int line) {
   GLenum error_code(glGetError());
   while (error_code != GL_NO_ERROR) {
@@ -117,7 +226,6 @@ void GLError(const char* file, const int line) {
     error_code = glGetError();
   }
 }
-
 #endif
 
 }  // namespace colmap
@@ -48,7 +48,41 @@ namespace colmap {
 #define glDebugLog()
 #endif
 
-#if defined(COLMAP_GUI_ENABLED)
+#if defined(COLMAP_EGL_ENABLED)
+
+// This class manages a headless OpenGL context created with EGL, which neither
+// requires a display server nor a Qt application. Every instance owns an
+// independent context, which can be created in any thread and then be made
+// current in any other thread, such that multiple threads can use OpenGL
+// concurrently, e.g., on a headless server.
+class OpenGLContextManager {
+ public:
+  explicit OpenGLContextManager(int opengl_major_version = 2,
+                                int opengl_minor_version = 1);
+  ~OpenGLContextManager();
+
+  // Make the OpenGL context current in the calling thread.
+  bool MakeCurrent();
+
+ private:
+  OpenGLContextManager(const OpenGLContextManager&) = delete;
+  OpenGLContextManager& operator=(const OpenGLContextManager&) = delete;
+
+  // The EGLDisplay, EGLSurface, and EGLContext handles, which are opaque
+  // pointers, such that the EGL headers are not exposed.
+  void* display_;
+  void* surface_;
+  void* context_;
+};
+
+// Run and wait for the thread, that uses the OpenGLContextManager. With EGL,
+// this does not require a Qt application.
+void RunThreadWithOpenGLContext(Thread* thread);
+
+// Get the OpenGL errors and print them to stderr.
+void GLError(const char* file, int line);
+
+#elif defined(COLMAP_GUI_ENABLED)
 
 // This class manages a thread-safe OpenGL context. Note that this class must be
 // instantiated in the main Qt thread, since an OpenGL context must be created
@@ -31,6 +31,7 @@
 
 #include <QApplication>
 #include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -71,5 +72,21 @@ TEST(RunThreadWithOpenGLContext, Nominal) {
   RunThreadWithOpenGLContext(&thread);
 }
 
+#if defined(COLMAP_EGL_ENABLED)
+TEST(OpenGLContextManager, HeadlessConcurrent) {
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([]() {
+      OpenGLContextManager manager;
+      EXPECT_TRUE(manager.MakeCurrent());
+      EXPECT_TRUE(manager.MakeCurrent());
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+#endif
+
 }  // namespace
 }  // namespace colmap
@@ -31,15 +31,22 @@
 
 #include "colmap/util/eigen_alignment.h"
 #include "colmap/util/logging.h"
+#include "colmap/util/mapped_file.h"
 #include "colmap/util/misc.h"
+#include "colmap/util/threading.h"
 
+#include <cmath>
+#include <cstring>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
 
 #include <Eigen/Core>
 
 namespace colmap {
 
-std::vector<PlyPoint> ReadPly(const std::string& path) {
+std::vector<PlyPoint> ReadPly(const std::string& path, const int num_threads) {
   std::ifstream file(path, std::ios::binary);
   THROW_CHECK_FILE_OPEN(file, path);
 
@@ -209,77 +216,72 @@ std::vector<PlyPoint> ReadPly(const std::string& path) {
   points.reserve(num_vertices);
 
   if (is_binary) {
-    std::vector<char> buffer(num_bytes_per_line);
-    for (size_t i = 0; i < num_vertices; ++i) {
-      file.read(buffer.data(), num_bytes_per_line);
+    // Map the binary body into memory and parse it in parallel chunks.
+    const size_t body_offset = static_cast<size_t>(file.tellg());
+    file.close();
+
+    MappedFile mapped_file(path);
+    THROW_CHECK_GE(mapped_file.Size(),
+                   body_offset + num_vertices * num_bytes_per_line)
+        << "Invalid PLY file format: truncated vertex data";
+    const uint8_t* body = mapped_file.Data() + body_offset;
+
+    auto ReadValue = [is_little_endian](const uint8_t* data,
+                                        const bool is_double) -> float {
+      if (is_double) {
+        double value;
+        memcpy(&value, data, sizeof(double));
+        return is_little_endian ? LittleEndianToNative(value)
+                                : BigEndianToNative(value);
+      } else {
+        float value;
+        memcpy(&value, data, sizeof(float));
+        return is_little_endian ? LittleEndianToNative(value)
+                                : BigEndianToNative(value);
+      }
+    };
 
-      PlyPoint point;
+    points.resize(num_vertices);
 
-      if (is_little_endian) {
-        point.x = LittleEndianToNative(
-            X_double ? *reinterpret_cast<double*>(&buffer[X_byte_pos])
-                     : *reinterpret_cast<float*>(&buffer[X_byte_pos]));
-        point.y = LittleEndianToNative(
-            Y_double ? *reinterpret_cast<double*>(&buffer[Y_byte_pos])
-                     : *reinterpret_cast<float*>(&buffer[Y_byte_pos]));
-        point.z = LittleEndianToNative(
-            Z_double ? *reinterpret_cast<double*>(&buffer[Z_byte_pos])
-                     : *reinterpret_cast<float*>(&buffer[Z_byte_pos]));
+    auto ParsePoints = [&](const size_t begin, const size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        const uint8_t* data = body + i * num_bytes_per_line;
+        PlyPoint& point = points[i];
 
-        if (!is_normal_missing) {
-          point.nx = LittleEndianToNative(
-              NX_double ? *reinterpret_cast<double*>(&buffer[NX_byte_pos])
-                        : *reinterpret_cast<float*>(&buffer[NX_byte_pos]));
-          point.ny = LittleEndianToNative(
-              NY_double ? *reinterpret_cast<double*>(&buffer[NY_byte_pos])
-                        : *reinterpret_cast<float*>(&buffer[NY_byte_pos]));
-          point.nz = LittleEndianToNative(
-              NZ_double ? *reinterpret_cast<double*>(&buffer[NZ_byte_pos])
-                        : *reinterpret_cast<float*>(&buffer[NZ_byte_pos]));
-        }
-
-        if (!is_rgb_missing) {
-          point.r = LittleEndianToNative(
-              *reinterpret_cast<uint8_t*>(&buffer[R_byte_pos]));
-          point.g = LittleEndianToNative(
-              *reinterpret_cast<uint8_t*>(&buffer[G_byte_pos]));
-          point.b = LittleEndianToNative(
-              *reinterpret_cast<uint8_t*>(&buffer[B_byte_pos]));
-        }
-      } else {
-        point.x = BigEndianToNative(
-            X_double ? *reinterpret_cast<double*>(&buffer[X_byte_pos])
-                     : *reinterpret_cast<float*>(&buffer[X_byte_pos]));
-        point.y = BigEndianToNative(
-            Y_double ? *reinterpret_cast<double*>(&buffer[Y_byte_pos])
-                     : *reinterpret_cast<float*>(&buffer[Y_byte_pos]));
-        point.z = BigEndianToNative(
-            Z_double ? *reinterpret_cast<double*>(&buffer[Z_byte_pos])
-                     : *reinterpret_cast<float*>(&buffer[Z_byte_pos]));
+        point.x = ReadValue(data + X_byte_pos, X_double);
+        point.y = ReadValue(data + Y_byte_pos, Y_double);
+        point.z = ReadValue(data + Z_byte_pos, Z_double);
 
         if (!is_normal_missing) {
-          point.nx = BigEndianToNative(
-              NX_double ? *reinterpret_cast<double*>(&buffer[NX_byte_pos])
-                        : *reinterpret_cast<float*>(&buffer[NX_byte_pos]));
-          point.ny = BigEndianToNative(
-              NY_double ? *reinterpret_cast<double*>(&buffer[NY_byte_pos])
-                        : *reinterpret_cast<float*>(&buffer[NY_byte_pos]));
-          point.nz = BigEndianToNative(
-              NZ_double ? *reinterpret_cast<double*>(&buffer[NZ_byte_pos])
-                        : *reinterpret_cast<float*>(&buffer[NZ_byte_pos]));
+          point.nx = ReadValue(data + NX_byte_pos, NX_double);
+          point.ny = ReadValue(data + NY_byte_pos, NY_double);
+          point.nz = ReadValue(data + NZ_byte_pos, NZ_double);
         }
 
         if (!is_rgb_missing) {
-          point.r = BigEndianToNative(
-              *reinterpret_cast<uint8_t*>(&buffer[R_byte_pos]));
-          point.g = BigEndianToNative(
-              *reinterpret_cast<uint8_t*>(&buffer[G_byte_pos]));
-          point.b = BigEndianToNative(
-              *reinterpret_cast<uint8_t*>(&buffer[B_byte_pos]));
+          point.r = data[R_byte_pos];
+          point.g = data[G_byte_pos];
+          point.b = data[B_byte_pos];
         }
       }
-
-      points.push_back(point);
+    };
+
+    // Avoid the threading overhead for small point clouds.
+    const size_t kMinNumPointsPerThread = 100000;
+    const int effective_num_threads = std::min<size_t>(
+        GetEffectiveNumThreads(num_threads),
+        std::max<size_t>(1, num_vertices / kMinNumPointsPerThread));
+    if (effective_num_threads == 1) {
+      ParsePoints(0, num_vertices);
+    } else {
+      ThreadPool thread_pool(effective_num_threads);
+      const size_t chunk_size =
+          (num_vertices + effective_num_threads - 1) / effective_num_threads;
+      for (size_t begin = 0; begin < num_vertices; begin += chunk_size) {
+        thread_pool.AddTask(
+            ParsePoints, begin, std::min(num_vertices, begin + chunk_size));
+      }
+      thread_pool.Wait();
     }
   } else {
     while (std::getline(file, line)) {
@@ -370,55 +372,369 @@ void WriteBinaryPlyPoints(const std::string& path,
                           const std::vector<PlyPoint>& points,
                           const bool write_normal,
                           const bool write_rgb) {
-  std::fstream text_file(path, std::ios::out);
-  THROW_CHECK_FILE_OPEN(text_file, path);
+  std::fstream file(path, std::ios::out | std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
 
-  text_file << "ply" << std::endl;
-  text_file << "format binary_little_endian 1.0" << std::endl;
-  text_file << "element vertex " << points.size() << std::endl;
+  WriteBinaryPlyPointsHeader(&file, points.size(), write_normal, write_rgb);
+  for (const auto& point : points) {
+    WriteBinaryPlyPoint(&file, point, write_normal, write_rgb);
+  }
 
-  text_file << "property float x" << std::endl;
-  text_file << "property float y" << std::endl;
-  text_file << "property float z" << std::endl;
+  file.close();
+}
+
+void WriteBinaryPlyPointsHeader(std::ostream* stream,
+                                const size_t num_points,
+                                const bool write_normal,
+                                const bool write_rgb) {
+  *stream << "ply" << std::endl;
+  *stream << "format binary_little_endian 1.0" << std::endl;
+  *stream << "element vertex " << num_points << std::endl;
+
+  *stream << "property float x" << std::endl;
+  *stream << "property float y" << std::endl;
+  *stream << "property float z" << std::endl;
 
   if (write_normal) {
-    text_file << "property float nx" << std::endl;
-    text_file << "property float ny" << std::endl;
-    text_file << "property float nz" << std::endl;
+    *stream << "property float nx" << std::endl;
+    *stream << "property float ny" << std::endl;
+    *stream << "property float nz" << std::endl;
   }
 
   if (write_rgb) {
-    text_file << "property uchar red" << std::endl;
-    text_file << "property uchar green" << std::endl;
-    text_file << "property uchar blue" << std::endl;
+    *stream << "property uchar red" << std::endl;
+    *stream << "property uchar green" << std::endl;
+    *stream << "property uchar blue" << std::endl;
   }
 
-  text_file << "end_header" << std::endl;
-  text_file.close();
+  *stream << "end_header" << std::endl;
+}
 
-  std::fstream binary_file(path,
-                           std::ios::out | std::ios::binary | std::ios::app);
-  THROW_CHECK_FILE_OPEN(binary_file, path);
+void WriteBinaryPlyPoint(std::ostream* stream,
+                         const PlyPoint& point,
+                         const bool write_normal,
+                         const bool write_rgb) {
+  WriteBinaryLittleEndian<float>(stream, point.x);
+  WriteBinaryLittleEndian<float>(stream, point.y);
+  WriteBinaryLittleEndian<float>(stream, point.z);
+
+  if (write_normal) {
+    WriteBinaryLittleEndian<float>(stream, point.nx);
+    WriteBinaryLittleEndian<float>(stream, point.ny);
+    WriteBinaryLittleEndian<float>(stream, point.nz);
+  }
+
+  if (write_rgb) {
+    WriteBinaryLittleEndian<uint8_t>(stream, point.r);
+    WriteBinaryLittleEndian<uint8_t>(stream, point.g);
+    WriteBinaryLittleEndian<uint8_t>(stream, point.b);
+  }
+}
+
+std::vector<PlyPoint> DownsamplePlyPoints(const std::vector<PlyPoint>& points,
+                                          const double voxel_size,
+                                          std::vector<size_t>* point_idxs) {
+  THROW_CHECK_GT(voxel_size, 0);
+
+  struct VoxelHash {
+    size_t operator()(const Eigen::Vector3i& voxel) const {
+      return static_cast<size_t>(voxel.x()) * 73856093 ^
+             static_cast<size_t>(voxel.y()) * 19349663 ^
+             static_cast<size_t>(voxel.z()) * 83492791;
+    }
+  };
+
+  struct VoxelSum {
+    Eigen::Vector3d xyz = Eigen::Vector3d::Zero();
+    Eigen::Vector3d normal = Eigen::Vector3d::Zero();
+    Eigen::Vector3d rgb = Eigen::Vector3d::Zero();
+    size_t num_points = 0;
+  };
+
+  // The voxels are stored in the order of their first point, such that the
+  // output is deterministic.
+  std::unordered_map<Eigen::Vector3i, size_t, VoxelHash> voxel_idxs;
+  std::vector<VoxelSum> voxel_sums;
+  if (point_idxs != nullptr) {
+    point_idxs->resize(points.size());
+  }
+
+  const double inv_voxel_size = 1.0 / voxel_size;
+  for (size_t i = 0; i < points.size(); ++i) {
+    const auto& point = points[i];
+    const Eigen::Vector3i voxel(
+        static_cast<int>(std::floor(point.x * inv_voxel_size)),
+        static_cast<int>(std::floor(point.y * inv_voxel_size)),
+        static_cast<int>(std::floor(point.z * inv_voxel_size)));
+    const auto voxel_idx = voxel_idxs.emplace(voxel, voxel_sums.size());
+    if (voxel_idx.second) {
+      voxel_sums.emplace_back();
+    }
+    VoxelSum& voxel_sum = voxel_sums[voxel_idx.first->second];
+    voxel_sum.xyz += Eigen::Vector3d(point.x, point.y, point.z);
+    voxel_sum.normal += Eigen::Vector3d(point.nx, point.ny, point.nz);
+    voxel_sum.rgb += Eigen::Vector3d(point.r, point.g, point.b);
+    voxel_sum.num_points += 1;
+    if (point_idxs != nullptr) {
+      (*point_idxs)[i] = voxel_idx.first->second;
+    }
+  }
+
+  std::vector<PlyPoint> downsampled_points(voxel_sums.size());
+  for (size_t i = 0; i < voxel_sums.size(); ++i) {
+    const VoxelSum& voxel_sum = voxel_sums[i];
+    const Eigen::Vector3d xyz = voxel_sum.xyz / voxel_sum.num_points;
+    const Eigen::Vector3d rgb = voxel_sum.rgb / voxel_sum.num_points;
+    Eigen::Vector3d normal = voxel_sum.normal;
+    if (normal.squaredNorm() > 0) {
+      normal.normalize();
+    }
+    PlyPoint& point = downsampled_points[i];
+    point.x = xyz.x();
+    point.y = xyz.y();
+    point.z = xyz.z();
+    point.nx = normal.x();
+    point.ny = normal.y();
+    point.nz = normal.z();
+    point.r = static_cast<uint8_t>(std::round(rgb.x()));
+    point.g = static_cast<uint8_t>(std::round(rgb.y()));
+    point.b = static_cast<uint8_t>(std::round(rgb.z()));
+  }
+
+  return downsampled_points;
+}
+
+namespace {
+
+// Number of digits of the largest 64-bit vertex count.
+const int kNumPointsWidth = 20;
+
+std::string FormatNumPlyPoints(const size_t num_points) {
+  std::ostringstream stream;
+  stream << std::setw(kNumPointsWidth) << std::setfill('0') << num_points;
+  return stream.str();
+}
+
+}  // namespace
+
+BinaryPlyPointsWriter::BinaryPlyPointsWriter(const std::string& path,
+                                             const bool write_normal,
+                                             const bool write_rgb)
+    : path_(path),
+      write_normal_(write_normal),
+      write_rgb_(write_rgb),
+      file_(path, std::ios::out | std::ios::binary) {
+  THROW_CHECK_FILE_OPEN(file_, path_);
+
+  // Write the header with a placeholder vertex count of fixed width, which is
+  // overwritten in place on close.
+  std::ostringstream header;
+  WriteBinaryPlyPointsHeader(&header, 0, write_normal_, write_rgb_);
+  const std::string kVertexElement = "element vertex ";
+  std::string header_str = header.str();
+  const size_t num_points_offset =
+      header_str.find(kVertexElement) + kVertexElement.size();
+  header_str.replace(num_points_offset, 1, FormatNumPlyPoints(0));
+  file_ << header_str;
+  num_points_pos_ = static_cast<std::streamoff>(num_points_offset);
+}
+
+BinaryPlyPointsWriter::~BinaryPlyPointsWriter() {
+  if (file_.is_open()) {
+    WriteNumPoints();
+    file_.close();
+  }
+}
+
+void BinaryPlyPointsWriter::Write(const PlyPoint& point) {
+  THROW_CHECK(file_.is_open()) << path_;
+  WriteBinaryPlyPoint(&file_, point, write_normal_, write_rgb_);
+  num_points_ += 1;
+}
 
+void BinaryPlyPointsWriter::Write(const std::vector<PlyPoint>& points) {
   for (const auto& point : points) {
-    WriteBinaryLittleEndian<float>(&binary_file, point.x);
-    WriteBinaryLittleEndian<float>(&binary_file, point.y);
-    WriteBinaryLittleEndian<float>(&binary_file, point.z);
+    Write(point);
+  }
+}
 
-    if (write_normal) {
-      WriteBinaryLittleEndian<float>(&binary_file, point.nx);
-      WriteBinaryLittleEndian<float>(&binary_file, point.ny);
-      WriteBinaryLittleEndian<float>(&binary_file, point.nz);
+size_t BinaryPlyPointsWriter::NumPoints() const { return num_points_; }
+
+void BinaryPlyPointsWriter::Close() {
+  THROW_CHECK(file_.is_open()) << path_;
+  WriteNumPoints();
+  file_.close();
+  THROW_CHECK(!file_.fail()) << "Failed to write " << path_;
+}
+
+void BinaryPlyPointsWriter::WriteNumPoints() {
+  file_.seekp(num_points_pos_);
+  file_ << FormatNumPlyPoints(num_points_);
+}
+
+namespace {
+
+struct PlyMeshProperty {
+  std::string name;
+  // The data type of a scalar or the data type of the elements of a list.
+  std::string type;
+  // The data type of the number of list elements or empty for scalars.
+  std::string list_size_type;
+};
+
+template <typename T>
+T ReadBinaryPlyScalar(std::istream* stream, const bool is_little_endian) {
+  T value;
+  stream->read(reinterpret_cast<char*>(&value), sizeof(T));
+  return is_little_endian ? LittleEndianToNative(value)
+                          : BigEndianToNative(value);
+}
+
+double ReadPlyValue(std::istream* stream,
+                    const std::string& type,
+                    const bool is_binary,
+                    const bool is_little_endian) {
+  if (!is_binary) {
+    double value;
+    *stream >> value;
+    return value;
+  }
+
+  if (type == "char" || type == "int8") {
+    return ReadBinaryPlyScalar<int8_t>(stream, is_little_endian);
+  } else if (type == "uchar" || type == "uint8") {
+    return ReadBinaryPlyScalar<uint8_t>(stream, is_little_endian);
+  } else if (type == "short" || type == "int16") {
+    return ReadBinaryPlyScalar<int16_t>(stream, is_little_endian);
+  } else if (type == "ushort" || type == "uint16") {
+    return ReadBinaryPlyScalar<uint16_t>(stream, is_little_endian);
+  } else if (type == "int" || type == "int32") {
+    return ReadBinaryPlyScalar<int32_t>(stream, is_little_endian);
+  } else if (type == "uint" || type == "uint32") {
+    return ReadBinaryPlyScalar<uint32_t>(stream, is_little_endian);
+  } else if (type == "float" || type == "float32") {
+    return ReadBinaryPlyScalar<float>(stream, is_little_endian);
+  } else if (type == "double" || type == "float64") {
+    return ReadBinaryPlyScalar<double>(stream, is_little_endian);
+  } else {
+    LOG(FATAL_THROW) << "Invalid data type: " << type;
+    return 0;
+  }
+}
+
+}  // namespace
+
+PlyMesh ReadPlyMesh(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  THROW_CHECK_FILE_OPEN(file, path);
+
+  bool is_binary = false;
+  bool is_little_endian = false;
+  size_t num_vertices = 0;
+  size_t num_faces = 0;
+  std::vector<PlyMeshProperty> vertex_properties;
+  std::vector<PlyMeshProperty> face_properties;
+  std::vector<PlyMeshProperty>* properties = nullptr;
+
+  std::string line;
+  while (std::getline(file, line)) {
+    StringTrim(&line);
+
+    if (line.empty()) {
+      continue;
     }
 
-    if (write_rgb) {
-      WriteBinaryLittleEndian<uint8_t>(&binary_file, point.r);
-      WriteBinaryLittleEndian<uint8_t>(&binary_file, point.g);
-      WriteBinaryLittleEndian<uint8_t>(&binary_file, point.b);
+    if (line == "end_header") {
+      break;
+    }
+
+    const std::vector<std::string> line_elems = StringSplit(line, " ");
+
+    if (line_elems[0] == "format") {
+      THROW_CHECK_GE(line_elems.size(), 2);
+      is_binary = line_elems[1] != "ascii";
+      is_little_endian = line_elems[1] == "binary_little_endian";
+    } else if (line_elems[0] == "element") {
+      THROW_CHECK_GE(line_elems.size(), 3);
+      const size_t num_elements = std::stoll(line_elems[2]);
+      if (line_elems[1] == "vertex") {
+        num_vertices = num_elements;
+        properties = &vertex_properties;
+      } else if (line_elems[1] == "face") {
+        num_faces = num_elements;
+        properties = &face_properties;
+      } else {
+        THROW_CHECK_EQ(num_elements, 0)
+            << "Only vertex and face elements supported";
+        properties = nullptr;
+      }
+    } else if (line_elems[0] == "property" && properties != nullptr) {
+      PlyMeshProperty property;
+      if (line_elems.size() >= 5 && line_elems[1] == "list") {
+        property.list_size_type = line_elems[2];
+        property.type = line_elems[3];
+        property.name = line_elems[4];
+      } else {
+        THROW_CHECK_GE(line_elems.size(), 3);
+        property.type = line_elems[1];
+        property.name = line_elems[2];
+      }
+      properties->push_back(property);
     }
   }
 
-  binary_file.close();
+  PlyMesh mesh;
+
+  mesh.vertices.reserve(num_vertices);
+  for (size_t i = 0; i < num_vertices; ++i) {
+    PlyMeshVertex vertex;
+    for (const auto& property : vertex_properties) {
+      THROW_CHECK(property.list_size_type.empty())
+          << "List vertex properties not supported";
+      const float value =
+          ReadPlyValue(&file, property.type, is_binary, is_little_endian);
+      if (property.name == "x") {
+        vertex.x = value;
+      } else if (property.name == "y") {
+        vertex.y = value;
+      } else if (property.name == "z") {
+        vertex.z = value;
+      }
+    }
+    mesh.vertices.push_back(vertex);
+  }
+
+  mesh.faces.reserve(num_faces);
+  std::vector<size_t> vertex_idxs;
+  for (size_t i = 0; i < num_faces; ++i) {
+    for (const auto& property : face_properties) {
+      if (property.list_size_type.empty()) {
+        ReadPlyValue(&file, property.type, is_binary, is_little_endian);
+        continue;
+      }
+      const size_t num_values = ReadPlyValue(
+          &file, property.list_size_type, is_binary, is_little_endian);
+      const bool is_vertex_idxs =
+          property.name == "vertex_index" || property.name == "vertex_indices";
+      vertex_idxs.clear();
+      for (size_t j = 0; j < num_values; ++j) {
+        const size_t vertex_idx =
+            ReadPlyValue(&file, property.type, is_binary, is_little_endian);
+        if (is_vertex_idxs) {
+          THROW_CHECK_LT(vertex_idx, num_vertices);
+          vertex_idxs.push_back(vertex_idx);
+        }
+      }
+      for (size_t j = 2; j < vertex_idxs.size(); ++j) {
+        mesh.faces.emplace_back(
+            vertex_idxs[0], vertex_idxs[j - 1], vertex_idxs[j]);
+      }
+    }
+  }
+
+  THROW_CHECK(file) << "Invalid PLY file format: truncated data";
+
+  return mesh;
 }
 
 void WriteTextPlyMesh(const std::string& path, const PlyMesh& mesh) {
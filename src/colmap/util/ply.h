@@ -31,6 +31,8 @@
 
 #include "colmap/util/types.h"
 
+#include <fstream>
+#include <ostream>
 #include <string>
 #include <vector>
 
@@ -77,8 +79,9 @@ struct PlyMesh {
   std::vector<PlyMeshFace> faces;
 };
 
-// Read PLY point cloud from text or binary file.
-std::vector<PlyPoint> ReadPly(const std::string& path);
+// Read PLY point cloud from text or binary file. The body of binary files is
+// memory mapped and parsed with the given number of threads.
+std::vector<PlyPoint> ReadPly(const std::string& path, int num_threads = -1);
 
 // Write PLY point cloud to text or binary file.
 void WriteTextPlyPoints(const std::string& path,
@@ -90,6 +93,61 @@ void WriteBinaryPlyPoints(const std::string& path,
                           bool write_normal = true,
                           bool write_rgb = true);
 
+// Write the header of a binary PLY file or a single point to a stream, such
+// that the points can be written incrementally, if their number is known
+// upfront.
+void WriteBinaryPlyPointsHeader(std::ostream* stream,
+                                size_t num_points,
+                                bool write_normal = true,
+                                bool write_rgb = true);
+void WriteBinaryPlyPoint(std::ostream* stream,
+                         const PlyPoint& point,
+                         bool write_normal = true,
+                         bool write_rgb = true);
+
+// Downsample the points on a regular voxel grid of the given size by averaging
+// the positions, normals, and colors of all points within each voxel. The
+// averaged normals are normalized. If given, the index of the output point is
+// returned for every input point.
+std::vector<PlyPoint> DownsamplePlyPoints(
+    const std::vector<PlyPoint>& points,
+    double voxel_size,
+    std::vector<size_t>* point_idxs = nullptr);
+
+// Incrementally write a binary PLY point cloud without knowing the number of
+// points upfront. The vertex count in the header is written with a fixed width
+// and patched, when the writer is closed. The file is only valid after closing.
+class BinaryPlyPointsWriter {
+ public:
+  BinaryPlyPointsWriter(const std::string& path,
+                        bool write_normal = true,
+                        bool write_rgb = true);
+  ~BinaryPlyPointsWriter();
+
+  void Write(const PlyPoint& point);
+  void Write(const std::vector<PlyPoint>& points);
+
+  size_t NumPoints() const;
+
+  // Patch the vertex count and close the file.
+  void Close();
+
+ private:
+  void WriteNumPoints();
+
+  const std::string path_;
+  const bool write_normal_;
+  const bool write_rgb_;
+  std::fstream file_;
+  std::streampos num_points_pos_;
+  size_t num_points_ = 0;
+};
+
+// Read PLY mesh from text or binary file. Only the vertex positions and the
+// faces are read and polygonal faces are triangulated as a fan, while all
+// other properties, e.g., vertex colors, are ignored.
+PlyMesh ReadPlyMesh(const std::string& path);
+
 // Write PLY mesh to text or binary file.
 void WriteTextPlyMesh(const std::string& path, const PlyMesh& mesh);
 void WriteBinaryPlyMesh(const std::string& path, const PlyMesh& mesh);
@@ -0,0 +1,213 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/util/ply.h"
+
+#include "colmap/util/testing.h"
+
+#include <cmath>
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+std::vector<PlyPoint> CreatePoints(const size_t num_points) {
+  std::vector<PlyPoint> points(num_points);
+  for (size_t i = 0; i < num_points; ++i) {
+    points[i].x = i;
+    points[i].y = 2 * i;
+    points[i].z = 3 * i;
+    points[i].nx = 1;
+    points[i].r = i % 256;
+  }
+  return points;
+}
+
+void ExpectEqualPoints(const std::vector<PlyPoint>& points1,
+                       const std::vector<PlyPoint>& points2) {
+  ASSERT_EQ(points1.size(), points2.size());
+  for (size_t i = 0; i < points1.size(); ++i) {
+    EXPECT_EQ(points1[i].x, points2[i].x);
+    EXPECT_EQ(points1[i].y, points2[i].y);
+    EXPECT_EQ(points1[i].z, points2[i].z);
+    EXPECT_EQ(points1[i].nx, points2[i].nx);
+    EXPECT_EQ(points1[i].r, points2[i].r);
+  }
+}
+
+TEST(WriteBinaryPlyPoints, Nominal) {
+  const std::string path = CreateTestDir() + "/points.ply";
+  const std::vector<PlyPoint> points = CreatePoints(10);
+  WriteBinaryPlyPoints(path, points);
+  ExpectEqualPoints(ReadPly(path), points);
+}
+
+TEST(ReadPly, ParallelBinary) {
+  const std::string path = CreateTestDir() + "/points.ply";
+  const std::vector<PlyPoint> points = CreatePoints(1000003);
+  WriteBinaryPlyPoints(path, points);
+  ExpectEqualPoints(ReadPly(path, /*num_threads=*/1), points);
+  ExpectEqualPoints(ReadPly(path, /*num_threads=*/4), points);
+}
+
+TEST(ReadPly, Text) {
+  const std::string path = CreateTestDir() + "/points.ply";
+  const std::vector<PlyPoint> points = CreatePoints(10);
+  WriteTextPlyPoints(path, points);
+  ExpectEqualPoints(ReadPly(path), points);
+}
+
+TEST(DownsamplePlyPoints, Nominal) {
+  std::vector<PlyPoint> points(4);
+  points[0].x = 0.1;
+  points[0].nx = 1;
+  points[0].r = 10;
+  points[1].x = 0.3;
+  points[1].ny = 1;
+  points[1].r = 20;
+  points[2].x = 1.5;
+  points[2].nz = 1;
+  points[3].x = -0.5;
+  std::vector<size_t> point_idxs;
+  const std::vector<PlyPoint> downsampled_points =
+      DownsamplePlyPoints(points, 1.0, &point_idxs);
+  ASSERT_EQ(downsampled_points.size(), 3);
+  EXPECT_EQ(point_idxs, std::vector<size_t>({0, 0, 1, 2}));
+  EXPECT_NEAR(downsampled_points[0].x, 0.2, 1e-6);
+  EXPECT_NEAR(downsampled_points[0].nx, std::sqrt(0.5), 1e-6);
+  EXPECT_NEAR(downsampled_points[0].ny, std::sqrt(0.5), 1e-6);
+  EXPECT_EQ(downsampled_points[0].r, 15);
+  EXPECT_EQ(downsampled_points[1].x, 1.5);
+  EXPECT_EQ(downsampled_points[1].nz, 1);
+  EXPECT_EQ(downsampled_points[2].x, -0.5);
+  EXPECT_EQ(downsampled_points[2].nx, 0);
+}
+
+TEST(DownsamplePlyPoints, Empty) {
+  EXPECT_TRUE(DownsamplePlyPoints({}, 1.0).empty());
+}
+
+TEST(BinaryPlyPointsWriter, Nominal) {
+  const std::string path = CreateTestDir() + "/points.ply";
+  const std::vector<PlyPoint> points = CreatePoints(10);
+  BinaryPlyPointsWriter writer(path);
+  EXPECT_EQ(writer.NumPoints(), 0);
+  writer.Write(points[0]);
+  writer.Write(std::vector<PlyPoint>(points.begin() + 1, points.end()));
+  EXPECT_EQ(writer.NumPoints(), points.size());
+  writer.Close();
+  ExpectEqualPoints(ReadPly(path), points);
+}
+
+TEST(BinaryPlyPointsWriter, Empty) {
+  const std::string path = CreateTestDir() + "/points.ply";
+  BinaryPlyPointsWriter(path).Close();
+  EXPECT_TRUE(ReadPly(path).empty());
+}
+
+TEST(BinaryPlyPointsWriter, CloseOnDestruction) {
+  const std::string path = CreateTestDir() + "/points.ply";
+  const std::vector<PlyPoint> points = CreatePoints(3);
+  {
+    BinaryPlyPointsWriter writer(path);
+    writer.Write(points);
+  }
+  ExpectEqualPoints(ReadPly(path), points);
+}
+
+PlyMesh CreateMesh() {
+  PlyMesh mesh;
+  mesh.vertices.emplace_back(0, 0, 0);
+  mesh.vertices.emplace_back(1, 0, 0);
+  mesh.vertices.emplace_back(1, 1, 0);
+  mesh.vertices.emplace_back(0, 1, 2);
+  mesh.faces.emplace_back(0, 1, 2);
+  mesh.faces.emplace_back(0, 2, 3);
+  return mesh;
+}
+
+void ExpectEqualMeshes(const PlyMesh& mesh1, const PlyMesh& mesh2) {
+  ASSERT_EQ(mesh1.vertices.size(), mesh2.vertices.size());
+  for (size_t i = 0; i < mesh1.vertices.size(); ++i) {
+    EXPECT_EQ(mesh1.vertices[i].x, mesh2.vertices[i].x);
+    EXPECT_EQ(mesh1.vertices[i].y, mesh2.vertices[i].y);
+    EXPECT_EQ(mesh1.vertices[i].z, mesh2.vertices[i].z);
+  }
+  ASSERT_EQ(mesh1.faces.size(), mesh2.faces.size());
+  for (size_t i = 0; i < mesh1.faces.size(); ++i) {
+    EXPECT_EQ(mesh1.faces[i].vertex_idx1, mesh2.faces[i].vertex_idx1);
+    EXPECT_EQ(mesh1.faces[i].vertex_idx2, mesh2.faces[i].vertex_idx2);
+    EXPECT_EQ(mesh1.faces[i].vertex_idx3, mesh2.faces[i].vertex_idx3);
+  }
+}
+
+TEST(ReadPlyMesh, Binary) {
+  const std::string path = CreateTestDir() + "/mesh.ply";
+  const PlyMesh mesh = CreateMesh();
+  WriteBinaryPlyMesh(path, mesh);
+  ExpectEqualMeshes(ReadPlyMesh(path), mesh);
+}
+
+TEST(ReadPlyMesh, Text) {
+  const std::string path = CreateTestDir() + "/mesh.ply";
+  const PlyMesh mesh = CreateMesh();
+  WriteTextPlyMesh(path, mesh);
+  ExpectEqualMeshes(ReadPlyMesh(path), mesh);
+}
+
+TEST(ReadPlyMesh, PolygonsAndExtraProperties) {
+  const std::string path = CreateTestDir() + "/mesh.ply";
+  {
+    std::ofstream file(path);
+    file << "ply\n"
+         << "format ascii 1.0\n"
+         << "comment extra properties\n"
+         << "element vertex 4\n"
+         << "property float x\n"
+         << "property float y\n"
+         << "property float z\n"
+         << "property uchar red\n"
+         << "element face 1\n"
+         << "property uchar flags\n"
+         << "property list uchar int vertex_indices\n"
+         << "end_header\n"
+         << "0 0 0 10\n"
+         << "1 0 0 20\n"
+         << "1 1 0 30\n"
+         << "0 1 2 40\n"
+         << "7 4 0 1 2 3\n";
+  }
+  ExpectEqualMeshes(ReadPlyMesh(path), CreateMesh());
+}
+
+}  // namespace
+}  // namespace colmap
@@ -0,0 +1,171 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/util/profiler.h"
+
+#include "colmap/util/misc.h"
+
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace colmap {
+namespace {
+
+struct ThreadBuffer {
+  // Only contended while exporting or clearing the events.
+  std::mutex mutex;
+  std::vector<Profiler::Event> events;
+  int thread_id = 0;
+};
+
+// Buffers of all threads that ever recorded an event. Buffers are kept alive
+// after their threads exit, so that their events can still be exported.
+struct BufferRegistry {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+};
+
+BufferRegistry& GetBufferRegistry() {
+  static BufferRegistry registry;
+  return registry;
+}
+
+const std::chrono::steady_clock::time_point& GetEpoch() {
+  static const std::chrono::steady_clock::time_point epoch =
+      std::chrono::steady_clock::now();
+  return epoch;
+}
+
+ThreadBuffer& GetThreadBuffer() {
+  thread_local std::shared_ptr<ThreadBuffer> buffer;
+  if (!buffer) {
+    buffer = std::make_shared<ThreadBuffer>();
+    BufferRegistry& registry = GetBufferRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    buffer->thread_id = static_cast<int>(registry.buffers.size()) + 1;
+    registry.buffers.push_back(buffer);
+  }
+  return *buffer;
+}
+
+double MicroSecondsSinceEpoch(const std::chrono::steady_clock::time_point& t) {
+  return std::chrono::duration<double, std::micro>(t - GetEpoch()).count();
+}
+
+void WriteJSONString(const char* str, std::ostream& stream) {
+  stream << '"';
+  for (const char* c = str; *c != '\0'; ++c) {
+    if (*c == '"' || *c == '\\') {
+      stream << '\\' << *c;
+    } else if (static_cast<unsigned char>(*c) < 0x20) {
+      stream << ' ';
+    } else {
+      stream << *c;
+    }
+  }
+  stream << '"';
+}
+
+}  // namespace
+
+std::atomic<bool> Profiler::enabled_(false);
+
+void Profiler::Enable() {
+  // Initialize the epoch before the first zone is entered.
+  GetEpoch();
+  enabled_ = true;
+}
+
+void Profiler::Disable() { enabled_ = false; }
+
+void Profiler::Clear() {
+  BufferRegistry& registry = GetBufferRegistry();
+  std::lock_guard<std::mutex> registry_lock(registry.mutex);
+  for (auto& buffer : registry.buffers) {
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    buffer->events.clear();
+  }
+}
+
+size_t Profiler::NumEvents() {
+  BufferRegistry& registry = GetBufferRegistry();
+  std::lock_guard<std::mutex> registry_lock(registry.mutex);
+  size_t num_events = 0;
+  for (auto& buffer : registry.buffers) {
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    num_events += buffer->events.size();
+  }
+  return num_events;
+}
+
+void Profiler::Record(const char* name,
+                      const std::chrono::steady_clock::time_point start,
+                      const std::chrono::steady_clock::time_point end) {
+  Event event;
+  event.name = name;
+  event.start_us = MicroSecondsSinceEpoch(start);
+  event.duration_us =
+      std::chrono::duration<double, std::micro>(end - start).count();
+  ThreadBuffer& buffer = GetThreadBuffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  buffer.events.push_back(event);
+}
+
+void Profiler::WriteChromeTrace(const std::string& path) {
+  std::ofstream file(path, std::ios::trunc);
+  THROW_CHECK_FILE_OPEN(file, path);
+  WriteChromeTrace(file);
+}
+
+void Profiler::WriteChromeTrace(std::ostream& stream) {
+  stream << "{\"traceEvents\":[";
+  bool first = true;
+  BufferRegistry& registry = GetBufferRegistry();
+  std::lock_guard<std::mutex> registry_lock(registry.mutex);
+  for (auto& buffer : registry.buffers) {
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    for (const Event& event : buffer->events) {
+      if (!first) {
+        stream << ",";
+      }
+      first = false;
+      stream << "\n{\"name\":";
+      WriteJSONString(event.name, stream);
+      stream << ",\"cat\":\"colmap\",\"ph\":\"X\",\"pid\":1"
+             << ",\"tid\":" << buffer->thread_id << ",\"ts\":" << std::fixed
+             << event.start_us << ",\"dur\":" << event.duration_us << "}";
+    }
+  }
+  stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+}  // namespace colmap
@@ -0,0 +1,126 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+namespace colmap {
+
+// Lightweight profiler for named, nested scopes ("zones"). Zones are recorded
+// into per-thread buffers and can be exported as a Chrome trace event file,
+// which can be inspected in chrome://tracing or https://ui.perfetto.dev.
+// Profiling is disabled by default, in which case entering a zone costs a
+// single relaxed atomic load. Use the COLMAP_PROFILE_ZONE macro to profile
+// the enclosing scope, e.g.:
+//
+//    void Foo() {
+//      COLMAP_PROFILE_ZONE("Foo");
+//      ...
+//    }
+//
+class Profiler {
+ public:
+  struct Event {
+    // Name of the zone. Must have static storage duration.
+    const char* name = nullptr;
+    // Start time and duration of the zone in microseconds, where the start
+    // time is relative to the process-wide profiler epoch.
+    double start_us = 0;
+    double duration_us = 0;
+  };
+
+  static void Enable();
+  static void Disable();
+  inline static bool IsEnabled();
+
+  // Remove all recorded events from the buffers of all threads.
+  static void Clear();
+
+  // Total number of recorded events over all threads.
+  static size_t NumEvents();
+
+  // Write the recorded events of all threads in the Chrome trace event format.
+  static void WriteChromeTrace(const std::string& path);
+  static void WriteChromeTrace(std::ostream& stream);
+
+  // Record a completed zone in the buffer of the calling thread.
+  static void Record(const char* name,
+                     std::chrono::steady_clock::time_point start,
+                     std::chrono::steady_clock::time_point end);
+
+ private:
+  static std::atomic<bool> enabled_;
+};
+
+// Records the lifetime of the object as a profiler zone, if the profiler is
+// enabled when the zone is entered.
+class ProfileZone {
+ public:
+  inline explicit ProfileZone(const char* name);
+  inline ~ProfileZone();
+
+  ProfileZone(const ProfileZone&) = delete;
+  ProfileZone& operator=(const ProfileZone&) = delete;
+
+ private:
+  const char* name_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+#define COLMAP_PROFILE_CONCAT_IMPL(a, b) a##b
+#define COLMAP_PROFILE_CONCAT(a, b) COLMAP_PROFILE_CONCAT_IMPL(a, b)
+#define COLMAP_PROFILE_ZONE(name) \
+  ::colmap::ProfileZone COLMAP_PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+
+////////////////////////////////////////////////////////////////////////////////
+// Implementation
+////////////////////////////////////////////////////////////////////////////////
+
+bool Profiler::IsEnabled() { return enabled_.load(std::memory_order_relaxed); }
+
+ProfileZone::ProfileZone(const char* name) : name_(nullptr) {
+  if (Profiler::IsEnabled()) {
+    name_ = name;
+    start_ = std::chrono::steady_clock::now();
+  }
+}
+
+ProfileZone::~ProfileZone() {
+  if (name_ != nullptr) {
+    Profiler::Record(name_, start_, std::chrono::steady_clock::now());
+  }
+}
+
+}  // namespace colmap
@@ -0,0 +1,102 @@
+// Copyright (c) 2023, ETH Zurich and UNC Chapel Hill.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//
+//     * Neither the name of ETH Zurich and UNC Chapel Hill nor the names of
+//       its contributors may be used to endorse or promote products derived
+//       from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "colmap/util/profiler.h"
+
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace colmap {
+namespace {
+
+TEST(Profiler, Disabled) {
+  Profiler::Disable();
+  Profiler::Clear();
+  { COLMAP_PROFILE_ZONE("Disabled"); }
+  EXPECT_EQ(Profiler::NumEvents(), 0);
+}
+
+TEST(Profiler, NestedZones) {
+  Profiler::Clear();
+  Profiler::Enable();
+  {
+    COLMAP_PROFILE_ZONE("Outer");
+    { COLMAP_PROFILE_ZONE("Inner"); }
+  }
+  Profiler::Disable();
+  EXPECT_EQ(Profiler::NumEvents(), 2);
+
+  std::ostringstream stream;
+  Profiler::WriteChromeTrace(stream);
+  const std::string trace = stream.str();
+  EXPECT_NE(trace.find("\"traceEvents\""), std::string::npos);
+  EXPECT_NE(trace.find("\"name\":\"Outer\""), std::string::npos);
+  EXPECT_NE(trace.find("\"name\":\"Inner\""), std::string::npos);
+  EXPECT_NE(trace.find("\"ph\":\"X\""), std::string::npos);
+
+  Profiler::Clear();
+  EXPECT_EQ(Profiler::NumEvents(), 0);
+}
+
+TEST(Profiler, MultipleThreads) {
+  Profiler::Clear();
+  Profiler::Enable();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([]() {
+      for (int j = 0; j < 100; ++j) {
+        COLMAP_PROFILE_ZONE("Worker");
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  Profiler::Disable();
+  EXPECT_EQ(Profiler::NumEvents(), 400);
+  Profiler::Clear();
+}
+
+TEST(Profiler, EscapeName) {
+  Profiler::Clear();
+  Profiler::Enable();
+  { COLMAP_PROFILE_ZONE("Quote\"Name"); }
+  Profiler::Disable();
+  std::ostringstream stream;
+  Profiler::WriteChromeTrace(stream);
+  EXPECT_NE(stream.str().find("\"Quote\\\"Name\""), std::string::npos);
+  Profiler::Clear();
+}
+
+}  // namespace
+}  // namespace colmap
@@ -30,8 +30,32 @@
 #include "colmap/util/threading.h"
 
 #include "colmap/util/logging.h"
+#include "colmap/util/string.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
 
 namespace colmap {
+namespace {
+
+std::atomic<ThreadAffinity> thread_affinity(ThreadAffinity::NONE);
+
+#ifdef __linux__
+std::vector<int> ReadCPUListFile(const std::string& path) {
+  std::ifstream file(path);
+  std::string cpu_list;
+  if (!file.is_open() || !std::getline(file, cpu_list)) {
+    return {};
+  }
+  return ParseCPUList(cpu_list);
+}
+#endif
+
+}  // namespace
 
 Thread::Thread()
     : started_(false),
@@ -181,9 +205,52 @@ void Thread::RunFunc() {
   Callback(FINISHED_CALLBACK);
 }
 
+namespace {
+
+// The pool and index of the worker running on the current thread.
+struct ThreadPoolWorker {
+  const ThreadPool* pool = nullptr;
+  int index = -1;
+};
+
+thread_local ThreadPoolWorker current_worker;
+
+}  // namespace
+
 ThreadPool::ThreadPool(const int num_threads)
-    : stopped_(false), num_active_workers_(0) {
+    : next_queue_idx_(0),
+      num_queued_tasks_(0),
+      num_unfinished_tasks_(0),
+      stopped_(false) {
   const int num_effective_threads = GetEffectiveNumThreads(num_threads);
+  queues_.reserve(num_effective_threads);
+  for (int index = 0; index < num_effective_threads; ++index) {
+    queues_.push_back(std::make_unique<WorkerQueue>());
+  }
+
+  const ThreadAffinity affinity = GetThreadAffinity();
+  if (affinity != ThreadAffinity::NONE) {
+    // Compact placement in the order of the nodes and their CPUs.
+    std::vector<std::pair<size_t, int>> node_cpus;
+    const std::vector<std::vector<int>> nodes = GetNumaNodeCPUs();
+    for (size_t node_idx = 0; node_idx < nodes.size(); ++node_idx) {
+      for (const int cpu : nodes[node_idx]) {
+        node_cpus.emplace_back(node_idx, cpu);
+      }
+    }
+    if (!node_cpus.empty()) {
+      worker_cpus_.resize(num_effective_threads);
+      for (int index = 0; index < num_effective_threads; ++index) {
+        const auto& node_cpu = node_cpus[index % node_cpus.size()];
+        if (affinity == ThreadAffinity::CORE) {
+          worker_cpus_[index] = {node_cpu.second};
+        } else {
+          worker_cpus_[index] = nodes[node_cpu.first];
+        }
+      }
+    }
+  }
+
   for (int index = 0; index < num_effective_threads; ++index) {
     std::function<void(void)> worker =
         std::bind(&ThreadPool::WorkerFunc, this, index);
@@ -202,9 +269,17 @@ void ThreadPool::Stop() {
     }
 
     stopped_ = true;
+  }
 
-    std::queue<std::function<void()>> empty_tasks;
-    std::swap(tasks_, empty_tasks);
+  // Discard the pending tasks, whose futures then report a broken promise.
+  for (auto& queue : queues_) {
+    std::deque<Task> tasks;
+    {
+      std::lock_guard<std::mutex> lock(queue->mutex);
+      std::swap(tasks, queue->tasks);
+    }
+    num_queued_tasks_ -= tasks.size();
+    num_unfinished_tasks_ -= tasks.size();
   }
 
   task_condition_.notify_all();
@@ -218,50 +293,128 @@ void ThreadPool::Stop() {
 
 void ThreadPool::Wait() {
   std::unique_lock<std::mutex> lock(mutex_);
-  if (!tasks_.empty() || num_active_workers_ > 0) {
-    finished_condition_.wait(
-        lock, [this]() { return tasks_.empty() && num_active_workers_ == 0; });
+  finished_condition_.wait(
+      lock, [this]() { return stopped_ || num_unfinished_tasks_ <= 0; });
+}
+
+void ThreadPool::PushTask(Task task) {
+  const int current_index = CurrentThreadIndex();
+  const size_t queue_idx = current_index >= 0
+                               ? static_cast<size_t>(current_index)
+                               : next_queue_idx_++ % queues_.size();
+
+  {
+    // Check under the queue lock, such that the task is either rejected or
+    // discarded by a concurrent Stop, which then takes the same lock.
+    std::lock_guard<std::mutex> lock(queues_[queue_idx]->mutex);
+    if (stopped_) {
+      throw std::runtime_error("Cannot add task to stopped thread pool.");
+    }
+    num_unfinished_tasks_ += 1;
+    queues_[queue_idx]->tasks.push_back(std::move(task));
   }
+  num_queued_tasks_ += 1;
+
+  // Synchronize with workers that are about to sleep, so that the new task
+  // cannot be missed between their check of the queues and their wait.
+  { std::lock_guard<std::mutex> lock(mutex_); }
+  task_condition_.notify_one();
 }
 
-void ThreadPool::WorkerFunc(const int index) {
+bool ThreadPool::PopTask(const int index, Task* task) {
+  if (num_queued_tasks_ <= 0) {
+    return false;
+  }
+
+  // The own queue is processed in last-in-first-out order for locality.
   {
-    std::lock_guard<std::mutex> lock(mutex_);
-    thread_id_to_index_.emplace(GetThreadId(), index);
+    WorkerQueue& queue = *queues_[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      *task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+      num_queued_tasks_ -= 1;
+      return true;
+    }
   }
 
-  while (true) {
-    std::function<void()> task;
-    {
-      std::unique_lock<std::mutex> lock(mutex_);
-      task_condition_.wait(lock,
-                           [this] { return stopped_ || !tasks_.empty(); });
-      if (stopped_ && tasks_.empty()) {
-        return;
-      }
-      task = std::move(tasks_.front());
-      tasks_.pop();
-      num_active_workers_ += 1;
+  // Other queues are stolen from in first-in-first-out order, i.e., the
+  // oldest and typically largest tasks.
+  for (size_t i = 1; i < queues_.size(); ++i) {
+    WorkerQueue& queue = *queues_[(index + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      *task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      num_queued_tasks_ -= 1;
+      return true;
     }
+  }
 
-    task();
+  return false;
+}
 
-    {
-      std::unique_lock<std::mutex> lock(mutex_);
-      num_active_workers_ -= 1;
-    }
+void ThreadPool::RunTask(Task task) {
+  task->Run();
+  task.reset();
 
+  if (--num_unfinished_tasks_ == 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
     finished_condition_.notify_all();
   }
 }
 
+bool ThreadPool::RunPendingTask() {
+  const int index = CurrentThreadIndex();
+  if (index < 0) {
+    return false;
+  }
+  Task task;
+  if (!PopTask(index, &task)) {
+    return false;
+  }
+  RunTask(std::move(task));
+  return true;
+}
+
+int ThreadPool::CurrentThreadIndex() const {
+  return current_worker.pool == this ? current_worker.index : -1;
+}
+
+void ThreadPool::WorkerFunc(const int index) {
+  current_worker.pool = this;
+  current_worker.index = index;
+
+  if (!worker_cpus_.empty() && !SetCurrentThreadCPUs(worker_cpus_[index])) {
+    VLOG(2) << "Failed to bind thread pool worker " << index << " to CPUs";
+  }
+
+  while (true) {
+    Task task;
+    if (PopTask(index, &task)) {
+      RunTask(std::move(task));
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_condition_.wait(
+        lock, [this] { return stopped_ || num_queued_tasks_ > 0; });
+    if (stopped_ && num_queued_tasks_ <= 0) {
+      return;
+    }
+  }
+}
+
 std::thread::id ThreadPool::GetThreadId() const {
   return std::this_thread::get_id();
 }
 
 int ThreadPool::GetThreadIndex() {
-  std::unique_lock<std::mutex> lock(mutex_);
-  return thread_id_to_index_.at(GetThreadId());
+  const int index = CurrentThreadIndex();
+  if (index < 0) {
+    throw std::out_of_range("Current thread is not a worker of the pool.");
+  }
+  return index;
 }
 
 int GetEffectiveNumThreads(const int num_threads) {
@@ -277,4 +430,86 @@ int GetEffectiveNumThreads(const int num_threads) {
   return num_effective_threads;
 }
 
+void SetThreadAffinity(const ThreadAffinity affinity) {
+  thread_affinity = affinity;
+}
+
+ThreadAffinity GetThreadAffinity() { return thread_affinity; }
+
+std::vector<int> ParseCPUList(const std::string& cpu_list) {
+  std::vector<int> cpus;
+  for (std::string range : StringSplit(cpu_list, ",")) {
+    StringTrim(&range);
+    if (range.empty()) {
+      continue;
+    }
+    const std::vector<std::string> bounds = StringSplit(range, "-");
+    THROW_CHECK_LE(bounds.size(), 2) << "Invalid CPU list: " << cpu_list;
+    const int first = std::stoi(bounds[0]);
+    const int last = bounds.size() == 2 ? std::stoi(bounds[1]) : first;
+    THROW_CHECK_LE(first, last) << "Invalid CPU list: " << cpu_list;
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+std::vector<std::vector<int>> GetNumaNodeCPUs() {
+#ifdef __linux__
+  cpu_set_t process_cpus;
+  CPU_ZERO(&process_cpus);
+  if (sched_getaffinity(0, sizeof(process_cpus), &process_cpus) != 0) {
+    return {};
+  }
+
+  std::vector<std::vector<int>> nodes;
+  for (const int node : ReadCPUListFile("/sys/devices/system/node/online")) {
+    std::vector<int> cpus;
+    for (const int cpu : ReadCPUListFile(StringPrintf(
+             "/sys/devices/system/node/node%d/cpulist", node))) {
+      if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &process_cpus)) {
+        cpus.push_back(cpu);
+      }
+    }
+    if (!cpus.empty()) {
+      nodes.push_back(std::move(cpus));
+    }
+  }
+
+  if (nodes.empty()) {
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &process_cpus)) {
+        cpus.push_back(cpu);
+      }
+    }
+    nodes.push_back(std::move(cpus));
+  }
+
+  return nodes;
+#else
+  return {};
+#endif
+}
+
+bool SetCurrentThreadCPUs(const std::vector<int>& cpus) {
+#ifdef __linux__
+  if (cpus.empty()) {
+    return false;
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (const int cpu : cpus) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+      return false;
+    }
+    CPU_SET(cpu, &cpu_set);
+  }
+  return sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0;
+#else
+  return false;
+#endif
+}
+
 }  // namespace colmap
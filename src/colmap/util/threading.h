@@ -31,15 +31,24 @@
 
 #include "colmap/util/timer.h"
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <climits>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <future>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <queue>
+#include <stdexcept>
+#include <string>
 #include <thread>
 #include <type_traits>
 #include <unordered_map>
+#include <vector>
 
 namespace colmap {
 
@@ -189,7 +198,13 @@ class Thread {
 //      thread_pool.AddTask([](const int i) { /* Do some work */ });
 //    }
 //    thread_pool.Wait();
+//    thread_pool.ParallelFor(0, 1000, 10, [](const int64_t i) { /* ... */ });
 //
+// Every worker has its own task queue, such that fine-grained tasks do not
+// contend for a single lock. Tasks added from outside of the pool are
+// distributed over the workers, tasks added from inside a task are pushed to
+// the queue of the current worker, and idle workers steal tasks from the
+// queues of the other workers.
 class ThreadPool {
  public:
   static const int kMaxNumThreads = -1;
@@ -211,10 +226,22 @@ class ThreadPool {
   auto AddTask(func_t&& f, args_t&&... args)
       -> std::future<result_of_t<func_t, args_t...>>;
 
+  // Call func(i) for all i in [begin, end) on the workers of the pool and
+  // block until all calls finished. The range is processed in chunks of
+  // grain_size indices. If called from a task of the same pool, the calling
+  // worker processes chunks and other pending tasks while waiting, so that
+  // nested parallel loops cannot deadlock. The first exception thrown by func
+  // is rethrown after all chunks finished.
+  template <typename func_t>
+  void ParallelFor(int64_t begin,
+                   int64_t end,
+                   int64_t grain_size,
+                   const func_t& func);
+
   // Stop the execution of all workers.
   void Stop();
 
-  // Wait until tasks are finished.
+  // Wait until tasks are finished. Must not be called from inside a task.
   void Wait();
 
   // Get the unique identifier of the current thread.
@@ -226,19 +253,67 @@ class ThreadPool {
   int GetThreadIndex();
 
  private:
+  // Type-erased, move-only task, which avoids the copyable std::function and
+  // its shared ownership of the packaged task.
+  struct TaskBase {
+    virtual ~TaskBase() = default;
+    virtual void Run() = 0;
+  };
+
+  template <typename func_t>
+  struct TaskImpl : public TaskBase {
+    explicit TaskImpl(func_t&& func) : func(std::move(func)) {}
+    void Run() override { func(); }
+    func_t func;
+  };
+
+  using Task = std::unique_ptr<TaskBase>;
+
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  template <typename func_t>
+  static Task MakeTask(func_t&& func) {
+    return Task(new TaskImpl<typename std::decay<func_t>::type>(
+        std::forward<func_t>(func)));
+  }
+
+  // Push the task to the queue of the current worker or, if called from
+  // outside of the pool, to the queue of the next worker in turn.
+  void PushTask(Task task);
+
+  // Pop a task from the queue of the given worker or steal one from another
+  // worker. Returns false if all queues are empty.
+  bool PopTask(int index, Task* task);
+
+  // Run a single task and signal waiting threads when all tasks finished.
+  void RunTask(Task task);
+
+  // Run a pending task, if the current thread is a worker of the pool.
+  bool RunPendingTask();
+
+  // Index of the current thread in the pool or -1 for other threads.
+  int CurrentThreadIndex() const;
+
   void WorkerFunc(int index);
 
   std::vector<std::thread> workers_;
-  std::queue<std::function<void()>> tasks_;
+  // The CPUs to which each worker is bound, empty if not bound.
+  std::vector<std::vector<int>> worker_cpus_;
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  std::atomic<size_t> next_queue_idx_;
+
+  // Number of queued tasks and of queued or running tasks.
+  std::atomic<int64_t> num_queued_tasks_;
+  std::atomic<int64_t> num_unfinished_tasks_;
 
   std::mutex mutex_;
   std::condition_variable task_condition_;
   std::condition_variable finished_condition_;
 
-  bool stopped_;
-  int num_active_workers_;
-
-  std::unordered_map<std::thread::id, int> thread_id_to_index_;
+  std::atomic<bool> stopped_;
 };
 
 // A job queue class for the producer-consumer paradigm.
@@ -262,6 +337,11 @@ class ThreadPool {
 //    producer_thread.join();
 //    consumer_thread.join();
 //
+// Bounded queues can use a lock-free ring buffer instead of a mutex, which
+// reduces the latency for high rates of small jobs. Waiting calls of the
+// lock-free queue first spin and only block if the wait takes longer.
+enum class JobQueueType { LOCKING, LOCK_FREE };
+
 template <typename T>
 class JobQueue {
  public:
@@ -282,8 +362,24 @@ class JobQueue {
     bool valid_;
   };
 
+  // Statistics of the queue since its construction, e.g., to find the
+  // bottleneck in a pipeline of threads connected by queues.
+  struct Stats {
+    // Number of successfully pushed and popped jobs.
+    size_t num_pushed = 0;
+    size_t num_popped = 0;
+    // Maximum and time-averaged number of jobs in the queue.
+    size_t max_num_jobs = 0;
+    double mean_num_jobs = 0;
+    // Time in seconds that Push waited for free space and Pop waited for a
+    // new job, accumulated over all producer and consumer threads.
+    double push_wait_seconds = 0;
+    double pop_wait_seconds = 0;
+  };
+
   JobQueue();
-  explicit JobQueue(size_t max_num_jobs);
+  explicit JobQueue(size_t max_num_jobs,
+                    JobQueueType type = JobQueueType::LOCKING);
   ~JobQueue();
 
   // The number of pushed and not popped jobs in the queue.
@@ -304,7 +400,67 @@ class JobQueue {
   // Clear all pushed and not popped jobs from the queue.
   void Clear();
 
+  // The mean number of jobs is not tracked by lock-free queues.
+  Stats GetStats();
+
  private:
+  using Clock = std::chrono::steady_clock;
+
+  // Bounded multi-producer multi-consumer ring buffer. Every slot has a
+  // sequence number, which tells whether the slot is free for the push or
+  // filled for the pop at a given position, so that producers and consumers
+  // only synchronize by atomic operations on the positions and slots.
+  class RingBuffer {
+   public:
+    explicit RingBuffer(size_t capacity);
+
+    // Move the data into the queue or return false if the queue is full.
+    bool TryPush(T* data);
+
+    // Move the next job into data or return false if the queue is empty.
+    bool TryPop(T* data);
+
+    size_t Size() const;
+    size_t NumPushed() const { return push_pos_; }
+    size_t NumPopped() const { return pop_pos_; }
+
+   private:
+    struct Slot {
+      std::atomic<size_t> sequence;
+      T data;
+    };
+
+    const size_t capacity_;
+    // At least two slots are needed to distinguish free and filled slots.
+    const size_t num_slots_;
+    std::unique_ptr<Slot[]> slots_;
+    // Producers and consumers modify different cache lines.
+    char padding1_[64];
+    std::atomic<size_t> push_pos_;
+    char padding2_[64];
+    std::atomic<size_t> pop_pos_;
+    char padding3_[64];
+  };
+
+  // Spin for the condition to become true and then block until it is
+  // notified through the given condition variable.
+  template <typename Predicate>
+  void SpinThenWait(const Predicate& predicate,
+                    std::atomic<int>* num_waiting,
+                    std::condition_variable* condition);
+
+  // Notify a waiting thread of the lock-free queue, if there is any.
+  void NotifyWaiting(std::atomic<int>* num_waiting,
+                     std::condition_variable* condition,
+                     bool notify_all);
+
+  bool PushLockFree(T data);
+  Job PopLockFree();
+
+  // Integrate the number of jobs over time until now. Must be called with
+  // locked mutex before every change of the number of jobs.
+  void UpdateNumJobsIntegral(Clock::time_point now);
+
   size_t max_num_jobs_;
   std::atomic<bool> stop_;
   std::queue<T> jobs_;
@@ -312,12 +468,58 @@ class JobQueue {
   std::condition_variable push_condition_;
   std::condition_variable pop_condition_;
   std::condition_variable empty_condition_;
+  Stats stats_;
+  const Clock::time_point start_time_;
+  Clock::time_point last_change_time_;
+  double num_jobs_integral_ = 0;
+
+  // State of the lock-free queue, whose statistics are updated atomically.
+  std::unique_ptr<RingBuffer> ring_buffer_;
+  std::atomic<int> num_waiting_pushes_{0};
+  std::atomic<int> num_waiting_pops_{0};
+  std::atomic<int> num_waiting_empty_{0};
+  std::atomic<size_t> max_num_jobs_seen_{0};
+  std::atomic<int64_t> push_wait_nanoseconds_{0};
+  std::atomic<int64_t> pop_wait_nanoseconds_{0};
 };
 
 // Return the number of logical CPU cores if num_threads <= 0,
 // otherwise return the input value of num_threads.
 int GetEffectiveNumThreads(int num_threads);
 
+// Placement of the workers of thread pools on the CPUs. By default, the
+// operating system schedules the workers freely, which on multi-socket systems
+// moves them between the sockets and away from their memory. The workers can
+// instead be bound to the CPUs of a NUMA node or to a single core each. They
+// are placed compactly, i.e., the cores of the first node are used before the
+// cores of the next node. Memory that a bound worker allocates and first
+// writes, e.g., its scratch buffers, is then placed on its node by the
+// first-touch policy of the operating system. Threads started from a bound
+// thread, e.g., the threads of Ceres, inherit its CPUs. Only supported on
+// Linux and ignored on other platforms.
+enum class ThreadAffinity {
+  NONE,
+  NUMA_NODE,
+  CORE,
+};
+
+// Set/get the process-wide placement of the workers of thread pools that are
+// created afterwards, and of the threads that select a CUDA device.
+void SetThreadAffinity(ThreadAffinity affinity);
+ThreadAffinity GetThreadAffinity();
+
+// Parse a list of CPUs in the format of the Linux sysfs, e.g., "0-3,8,10-11".
+std::vector<int> ParseCPUList(const std::string& cpu_list);
+
+// The CPUs of each NUMA node that the process may run on. Without NUMA
+// information, all CPUs of the process form a single node. Empty if thread
+// affinities are not supported.
+std::vector<std::vector<int>> GetNumaNodeCPUs();
+
+// Bind the current thread to the given CPUs. Returns false, if the affinity
+// could not be set or is not supported.
+bool SetCurrentThreadCPUs(const std::vector<int>& cpus);
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -329,30 +531,146 @@ auto ThreadPool::AddTask(func_t&& f, args_t&&... args)
     -> std::future<result_of_t<func_t, args_t...>> {
   typedef result_of_t<func_t, args_t...> return_t;
 
-  auto task = std::make_shared<std::packaged_task<return_t()>>(
+  std::packaged_task<return_t()> task(
       std::bind(std::forward<func_t>(f), std::forward<args_t>(args)...));
 
-  std::future<return_t> result = task->get_future();
+  std::future<return_t> result = task.get_future();
 
-  {
-    std::unique_lock<std::mutex> lock(mutex_);
-    if (stopped_) {
-      throw std::runtime_error("Cannot add task to stopped thread pool.");
+  PushTask(MakeTask(std::move(task)));
+
+  return result;
+}
+
+template <typename func_t>
+void ThreadPool::ParallelFor(const int64_t begin,
+                             const int64_t end,
+                             const int64_t grain_size,
+                             const func_t& func) {
+  if (begin >= end) {
+    return;
+  }
+
+  const int64_t chunk_size = std::max<int64_t>(1, grain_size);
+  const int64_t num_chunks = (end - begin + chunk_size - 1) / chunk_size;
+
+  // The state is shared by the caller and the helper tasks, which all claim
+  // chunks until none are left. The caller waits for all helper tasks to be
+  // destroyed, so the state can live on its stack.
+  struct State {
+    std::atomic<int64_t> next_chunk_idx{0};
+    std::atomic<int64_t> num_active_helpers{0};
+    std::mutex mutex;
+    std::condition_variable finished_condition;
+    std::exception_ptr exception;
+  } state;
+
+  auto ProcessChunks = [&]() {
+    while (true) {
+      const int64_t chunk_idx = state.next_chunk_idx++;
+      if (chunk_idx >= num_chunks) {
+        break;
+      }
+      const int64_t chunk_begin = begin + chunk_idx * chunk_size;
+      const int64_t chunk_end = std::min(end, chunk_begin + chunk_size);
+      try {
+        for (int64_t i = chunk_begin; i < chunk_end; ++i) {
+          func(i);
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (!state.exception) {
+          state.exception = std::current_exception();
+        }
+        // Skip the remaining chunks.
+        state.next_chunk_idx = num_chunks;
+      }
     }
-    tasks_.emplace([task]() { (*task)(); });
+  };
+
+  // The calling thread only processes chunks if it is a worker of the pool,
+  // such that func always runs on a worker with a valid thread index.
+  const bool is_worker = CurrentThreadIndex() >= 0;
+  const int64_t num_helpers = std::min<int64_t>(
+      num_chunks - (is_worker ? 1 : 0), static_cast<int64_t>(NumThreads()));
+
+  // Counts the helper tasks alive and signals the caller when the last one is
+  // destroyed, whether it ran or was discarded by a stopped pool.
+  struct HelperGuard {
+    explicit HelperGuard(State* state) : state(state) {
+      ++state->num_active_helpers;
+    }
+    HelperGuard(HelperGuard&& other) : state(other.state) {
+      other.state = nullptr;
+    }
+    ~HelperGuard() {
+      if (state != nullptr) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (--state->num_active_helpers == 0) {
+          state->finished_condition.notify_all();
+        }
+      }
+    }
+    State* state;
+  };
+
+  try {
+    for (int64_t i = 0; i < num_helpers; ++i) {
+      PushTask(MakeTask([guard = HelperGuard(&state), &ProcessChunks]() {
+        ProcessChunks();
+      }));
+    }
+  } catch (...) {
+    // Wait for the already pushed helpers below before rethrowing.
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.exception) {
+      state.exception = std::current_exception();
+    }
+    state.next_chunk_idx = num_chunks;
   }
 
-  task_condition_.notify_one();
+  if (is_worker) {
+    ProcessChunks();
+    // Help with the pending tasks, including the own helpers that were not
+    // yet started, instead of blocking the worker.
+    while (state.num_active_helpers > 0 && RunPendingTask()) {
+    }
+  }
 
-  return result;
+  {
+    std::unique_lock<std::mutex> lock(state.mutex);
+    state.finished_condition.wait(
+        lock, [&]() { return state.num_active_helpers == 0; });
+  }
+
+  if (state.exception) {
+    std::rethrow_exception(state.exception);
+  }
+
+  // Helpers that were discarded by a stopped pool left chunks unprocessed.
+  if (state.next_chunk_idx < num_chunks) {
+    throw std::runtime_error("Thread pool stopped during ParallelFor.");
+  }
 }
 
 template <typename T>
 JobQueue<T>::JobQueue() : JobQueue(std::numeric_limits<size_t>::max()) {}
 
 template <typename T>
-JobQueue<T>::JobQueue(const size_t max_num_jobs)
-    : max_num_jobs_(max_num_jobs), stop_(false) {}
+JobQueue<T>::JobQueue(const size_t max_num_jobs, const JobQueueType type)
+    : max_num_jobs_(max_num_jobs),
+      stop_(false),
+      start_time_(Clock::now()),
+      last_change_time_(start_time_) {
+  if (type == JobQueueType::LOCK_FREE) {
+    // The ring buffer allocates all slots upfront.
+    const size_t kMaxNumLockFreeJobs = 1 << 20;
+    if (max_num_jobs == 0 || max_num_jobs > kMaxNumLockFreeJobs) {
+      throw std::invalid_argument(
+          "Lock-free job queue requires a bounded number of jobs.");
+    }
+    ring_buffer_ = std::make_unique<RingBuffer>(max_num_jobs);
+  }
+}
 
 template <typename T>
 JobQueue<T>::~JobQueue() {
@@ -361,20 +679,36 @@ JobQueue<T>::~JobQueue() {
 
 template <typename T>
 size_t JobQueue<T>::Size() {
+  if (ring_buffer_) {
+    return ring_buffer_->Size();
+  }
   std::unique_lock<std::mutex> lock(mutex_);
   return jobs_.size();
 }
 
 template <typename T>
 bool JobQueue<T>::Push(T data) {
+  if (ring_buffer_) {
+    return PushLockFree(std::move(data));
+  }
   std::unique_lock<std::mutex> lock(mutex_);
-  while (jobs_.size() >= max_num_jobs_ && !stop_) {
-    pop_condition_.wait(lock);
+  Clock::time_point now = Clock::now();
+  if (jobs_.size() >= max_num_jobs_ && !stop_) {
+    const Clock::time_point wait_start_time = now;
+    while (jobs_.size() >= max_num_jobs_ && !stop_) {
+      pop_condition_.wait(lock);
+    }
+    now = Clock::now();
+    stats_.push_wait_seconds +=
+        std::chrono::duration<double>(now - wait_start_time).count();
   }
   if (stop_) {
     return false;
   } else {
+    UpdateNumJobsIntegral(now);
     jobs_.push(std::move(data));
+    stats_.num_pushed += 1;
+    stats_.max_num_jobs = std::max(stats_.max_num_jobs, jobs_.size());
     push_condition_.notify_one();
     return true;
   }
@@ -382,15 +716,27 @@ bool JobQueue<T>::Push(T data) {
 
 template <typename T>
 typename JobQueue<T>::Job JobQueue<T>::Pop() {
+  if (ring_buffer_) {
+    return PopLockFree();
+  }
   std::unique_lock<std::mutex> lock(mutex_);
-  while (jobs_.empty() && !stop_) {
-    push_condition_.wait(lock);
+  Clock::time_point now = Clock::now();
+  if (jobs_.empty() && !stop_) {
+    const Clock::time_point wait_start_time = now;
+    while (jobs_.empty() && !stop_) {
+      push_condition_.wait(lock);
+    }
+    now = Clock::now();
+    stats_.pop_wait_seconds +=
+        std::chrono::duration<double>(now - wait_start_time).count();
   }
   if (stop_) {
     return Job();
   } else {
+    UpdateNumJobsIntegral(now);
     Job job(std::move(jobs_.front()));
     jobs_.pop();
+    stats_.num_popped += 1;
     pop_condition_.notify_one();
     if (jobs_.empty()) {
       empty_condition_.notify_all();
@@ -401,6 +747,12 @@ typename JobQueue<T>::Job JobQueue<T>::Pop() {
 
 template <typename T>
 void JobQueue<T>::Wait() {
+  if (ring_buffer_) {
+    SpinThenWait([this]() { return ring_buffer_->Size() == 0; },
+                 &num_waiting_empty_,
+                 &empty_condition_);
+    return;
+  }
   std::unique_lock<std::mutex> lock(mutex_);
   while (!jobs_.empty()) {
     empty_condition_.wait(lock);
@@ -410,15 +762,231 @@ void JobQueue<T>::Wait() {
 template <typename T>
 void JobQueue<T>::Stop() {
   stop_ = true;
+  // Synchronize with the lock-free waits, which check the stop flag with
+  // locked mutex before blocking.
+  { std::lock_guard<std::mutex> lock(mutex_); }
   push_condition_.notify_all();
   pop_condition_.notify_all();
 }
 
 template <typename T>
 void JobQueue<T>::Clear() {
+  if (ring_buffer_) {
+    T data;
+    while (ring_buffer_->TryPop(&data)) {
+    }
+    NotifyWaiting(&num_waiting_pushes_, &pop_condition_, /*notify_all=*/true);
+    NotifyWaiting(&num_waiting_empty_, &empty_condition_, /*notify_all=*/true);
+    return;
+  }
   std::unique_lock<std::mutex> lock(mutex_);
+  UpdateNumJobsIntegral(Clock::now());
   std::queue<T> empty_jobs;
   std::swap(jobs_, empty_jobs);
 }
 
+template <typename T>
+typename JobQueue<T>::Stats JobQueue<T>::GetStats() {
+  if (ring_buffer_) {
+    Stats stats;
+    stats.num_popped = ring_buffer_->NumPopped();
+    stats.num_pushed = ring_buffer_->NumPushed();
+    stats.max_num_jobs = max_num_jobs_seen_;
+    stats.push_wait_seconds = 1e-9 * push_wait_nanoseconds_;
+    stats.pop_wait_seconds = 1e-9 * pop_wait_nanoseconds_;
+    return stats;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  const Clock::time_point now = Clock::now();
+  UpdateNumJobsIntegral(now);
+  Stats stats = stats_;
+  const double elapsed_seconds =
+      std::chrono::duration<double>(now - start_time_).count();
+  if (elapsed_seconds > 0) {
+    stats.mean_num_jobs = num_jobs_integral_ / elapsed_seconds;
+  }
+  return stats;
+}
+
+template <typename T>
+void JobQueue<T>::UpdateNumJobsIntegral(const Clock::time_point now) {
+  num_jobs_integral_ +=
+      jobs_.size() *
+      std::chrono::duration<double>(now - last_change_time_).count();
+  last_change_time_ = now;
+}
+
+template <typename T>
+JobQueue<T>::RingBuffer::RingBuffer(const size_t capacity)
+    : capacity_(capacity),
+      num_slots_(std::max<size_t>(2, capacity)),
+      slots_(new Slot[num_slots_]),
+      push_pos_(0),
+      pop_pos_(0) {
+  for (size_t i = 0; i < num_slots_; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+template <typename T>
+bool JobQueue<T>::RingBuffer::TryPush(T* data) {
+  size_t pos = push_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    if (pos - pop_pos_.load(std::memory_order_relaxed) >= capacity_) {
+      return false;
+    }
+    Slot& slot = slots_[pos % num_slots_];
+    const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence == pos) {
+      // The slot is free, try to claim the position.
+      if (push_pos_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+        slot.data = std::move(*data);
+        slot.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (sequence < pos) {
+      // The slot was not yet popped in the previous round.
+      return false;
+    } else {
+      pos = push_pos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+template <typename T>
+bool JobQueue<T>::RingBuffer::TryPop(T* data) {
+  size_t pos = pop_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    Slot& slot = slots_[pos % num_slots_];
+    const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence == pos + 1) {
+      // The slot is filled, try to claim the position.
+      if (pop_pos_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+        *data = std::move(slot.data);
+        slot.sequence.store(pos + num_slots_, std::memory_order_release);
+        return true;
+      }
+    } else if (sequence < pos + 1) {
+      // The slot was not yet pushed in this round.
+      return false;
+    } else {
+      pos = pop_pos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+template <typename T>
+size_t JobQueue<T>::RingBuffer::Size() const {
+  const size_t pop_pos = pop_pos_;
+  const size_t push_pos = push_pos_;
+  return push_pos > pop_pos ? std::min(push_pos - pop_pos, capacity_) : 0;
+}
+
+template <typename T>
+template <typename Predicate>
+void JobQueue<T>::SpinThenWait(const Predicate& predicate,
+                               std::atomic<int>* num_waiting,
+                               std::condition_variable* condition) {
+  const int kNumSpins = 64;
+  for (int i = 0; i < kNumSpins; ++i) {
+    if (predicate()) {
+      return;
+    }
+    std::this_thread::yield();
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  *num_waiting += 1;
+  // Pairs with the fence in NotifyWaiting, such that either the waiting
+  // thread observes the change or the notifying thread observes the waiter.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  condition->wait(lock, predicate);
+  *num_waiting -= 1;
+}
+
+template <typename T>
+void JobQueue<T>::NotifyWaiting(std::atomic<int>* num_waiting,
+                                std::condition_variable* condition,
+                                const bool notify_all) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (*num_waiting > 0) {
+    { std::lock_guard<std::mutex> lock(mutex_); }
+    if (notify_all) {
+      condition->notify_all();
+    } else {
+      condition->notify_one();
+    }
+  }
+}
+
+template <typename T>
+bool JobQueue<T>::PushLockFree(T data) {
+  if (stop_) {
+    return false;
+  }
+
+  if (!ring_buffer_->TryPush(&data)) {
+    const Clock::time_point wait_start_time = Clock::now();
+    bool pushed = false;
+    while (!pushed && !stop_) {
+      SpinThenWait(
+          [this]() { return stop_ || ring_buffer_->Size() < max_num_jobs_; },
+          &num_waiting_pushes_,
+          &pop_condition_);
+      pushed = !stop_ && ring_buffer_->TryPush(&data);
+    }
+    push_wait_nanoseconds_ +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - wait_start_time)
+            .count();
+    if (!pushed) {
+      return false;
+    }
+  }
+
+  const size_t num_jobs = ring_buffer_->Size();
+  size_t max_num_jobs_seen = max_num_jobs_seen_;
+  while (num_jobs > max_num_jobs_seen &&
+         !max_num_jobs_seen_.compare_exchange_weak(max_num_jobs_seen,
+                                                   num_jobs)) {
+  }
+
+  NotifyWaiting(&num_waiting_pops_, &push_condition_, /*notify_all=*/false);
+  return true;
+}
+
+template <typename T>
+typename JobQueue<T>::Job JobQueue<T>::PopLockFree() {
+  if (stop_) {
+    return Job();
+  }
+
+  T data;
+  if (!ring_buffer_->TryPop(&data)) {
+    const Clock::time_point wait_start_time = Clock::now();
+    bool popped = false;
+    while (!popped && !stop_) {
+      SpinThenWait([this]() { return stop_ || ring_buffer_->Size() > 0; },
+                   &num_waiting_pops_,
+                   &push_condition_);
+      popped = !stop_ && ring_buffer_->TryPop(&data);
+    }
+    pop_wait_nanoseconds_ +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - wait_start_time)
+            .count();
+    if (!popped) {
+      return Job();
+    }
+  }
+
+  NotifyWaiting(&num_waiting_pushes_, &pop_condition_, /*notify_all=*/false);
+  if (ring_buffer_->Size() == 0) {
+    NotifyWaiting(&num_waiting_empty_, &empty_condition_, /*notify_all=*/true);
+  }
+  return Job(std::move(data));
+}
+
 }  // namespace colmap
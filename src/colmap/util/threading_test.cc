@@ -31,6 +31,10 @@
 
 #include "colmap/util/logging.h"
 
+#ifdef __linux__
+#include <sched.h>
+#endif
+
 #include <gtest/gtest.h>
 
 namespace colmap {
@@ -640,6 +644,119 @@ TEST(ThreadPool, GetThreadIndex) {
   }
 }
 
+TEST(ThreadPool, AddTaskFromTask) {
+  ThreadPool pool(4);
+
+  std::atomic<int> num_calls(0);
+  for (int i = 0; i < 10; ++i) {
+    pool.AddTask([&]() {
+      for (int j = 0; j < 10; ++j) {
+        pool.AddTask([&]() { num_calls += 1; });
+      }
+    });
+  }
+
+  pool.Wait();
+
+  EXPECT_EQ(num_calls, 100);
+}
+
+TEST(ThreadPool, ParallelFor) {
+  ThreadPool pool(4);
+
+  for (const int grain_size : {0, 1, 7, 1000}) {
+    std::vector<int> results(100, 0);
+    pool.ParallelFor(10, 100, grain_size, [&](const int64_t i) {
+      results[i] += 1;
+      EXPECT_GE(pool.GetThreadIndex(), 0);
+      EXPECT_LE(pool.GetThreadIndex(), 3);
+    });
+    for (size_t i = 0; i < results.size(); ++i) {
+      EXPECT_EQ(results[i], i < 10 ? 0 : 1);
+    }
+  }
+
+  pool.ParallelFor(0, 0, 1, [](const int64_t) { FAIL(); });
+}
+
+TEST(ThreadPool, ParallelForNested) {
+  // More outer iterations than workers, such that all workers wait in nested
+  // loops at the same time.
+  ThreadPool pool(2);
+
+  std::vector<std::vector<int>> results(8, std::vector<int>(50, 0));
+  pool.ParallelFor(0, results.size(), 1, [&](const int64_t i) {
+    pool.ParallelFor(0, results[i].size(), 1, [&](const int64_t j) {
+      results[i][j] += 1;
+    });
+  });
+
+  for (const auto& inner_results : results) {
+    for (const int result : inner_results) {
+      EXPECT_EQ(result, 1);
+    }
+  }
+}
+
+TEST(ThreadPool, ParallelForException) {
+  ThreadPool pool(4);
+
+  std::atomic<int> num_calls(0);
+  EXPECT_THROW(pool.ParallelFor(0,
+                                1000,
+                                1,
+                                [&](const int64_t i) {
+                                  num_calls += 1;
+                                  if (i == 10) {
+                                    throw std::runtime_error("Failure");
+                                  }
+                                }),
+               std::runtime_error);
+
+  // The pool remains usable after an exception.
+  num_calls = 0;
+  pool.ParallelFor(0, 100, 1, [&](const int64_t) { num_calls += 1; });
+  EXPECT_EQ(num_calls, 100);
+}
+
+TEST(ThreadPool, ParallelForConcurrentStop) {
+  for (int trial = 0; trial < 10; ++trial) {
+    ThreadPool pool(1);
+
+    // Block the only worker, such that the helper tasks of the ParallelFor are
+    // still queued or not yet pushed when the pool is stopped.
+    std::atomic<bool> release(false);
+    pool.AddTask([&]() {
+      while (!release) {
+        std::this_thread::yield();
+      }
+    });
+
+    std::atomic<int> num_calls(0);
+    std::atomic<bool> stopped(false);
+    std::thread parallel_for_thread([&]() {
+      try {
+        pool.ParallelFor(0, 100, 1, [&](const int64_t) { num_calls += 1; });
+      } catch (const std::runtime_error&) {
+        stopped = true;
+      }
+    });
+
+    std::thread stop_thread([&]() { pool.Stop(); });
+    release = true;
+
+    // Must not block forever, no matter whether Stop discarded the helpers
+    // or the ParallelFor finished first.
+    parallel_for_thread.join();
+    stop_thread.join();
+    if (stopped) {
+      EXPECT_LT(num_calls, 100);
+    } else {
+      EXPECT_EQ(num_calls, 100);
+    }
+  }
+}
+
 TEST(JobQueue, SingleProducerSingleConsumer) {
   JobQueue<int> job_queue;
 
@@ -887,6 +1004,146 @@ TEST(JobQueue, Clear) {
   EXPECT_EQ(job_queue.Size(), 0);
 }
 
+TEST(JobQueue, LockFreeMultipleProducerMultipleConsumer) {
+  JobQueue<int> job_queue(3, JobQueueType::LOCK_FREE);
+
+  // IMPORTANT: EXPECT_TRUE_* macros are not thread-safe,
+  //            so we use glog's CHECK macros inside threads.
+
+  const int kNumJobsPerThread = 10000;
+  std::vector<std::thread> threads;
+  std::atomic<int64_t> sum(0);
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&job_queue]() {
+      for (int i = 0; i < kNumJobsPerThread; ++i) {
+        CHECK(job_queue.Push(i));
+      }
+    });
+    threads.emplace_back([&job_queue, &sum]() {
+      for (int i = 0; i < kNumJobsPerThread; ++i) {
+        const auto job = job_queue.Pop();
+        CHECK(job.IsValid());
+        CHECK_LE(job_queue.Size(), 3);
+        sum += job.Data();
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(sum, 4 * kNumJobsPerThread * (kNumJobsPerThread - 1) / 2);
+  EXPECT_EQ(job_queue.Size(), 0);
+
+  const auto stats = job_queue.GetStats();
+  EXPECT_EQ(stats.num_pushed, 4 * kNumJobsPerThread);
+  EXPECT_EQ(stats.num_popped, 4 * kNumJobsPerThread);
+  EXPECT_GE(stats.max_num_jobs, 1);
+  EXPECT_LE(stats.max_num_jobs, 3);
+}
+
+TEST(JobQueue, LockFreeWait) {
+  JobQueue<int> job_queue(10, JobQueueType::LOCK_FREE);
+
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_TRUE(job_queue.Push(i));
+  }
+
+  std::thread consumer_thread([&job_queue]() {
+    for (int i = 0; i < 10; ++i) {
+      const auto job = job_queue.Pop();
+      CHECK(job.IsValid());
+      CHECK_EQ(job.Data(), i);
+    }
+  });
+
+  job_queue.Wait();
+
+  EXPECT_EQ(job_queue.Size(), 0);
+  consumer_thread.join();
+}
+
+TEST(JobQueue, LockFreeStop) {
+  JobQueue<int> job_queue(1, JobQueueType::LOCK_FREE);
+
+  EXPECT_TRUE(job_queue.Push(0));
+
+  // Blocks until the queue is stopped, since the queue is full.
+  std::thread producer_thread(
+      [&job_queue]() { CHECK(!job_queue.Push(1)); });
+
+  JobQueue<int> empty_job_queue(1, JobQueueType::LOCK_FREE);
+  std::thread consumer_thread(
+      [&empty_job_queue]() { CHECK(!empty_job_queue.Pop().IsValid()); });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  job_queue.Stop();
+  empty_job_queue.Stop();
+  producer_thread.join();
+  consumer_thread.join();
+
+  EXPECT_FALSE(job_queue.Push(0));
+  EXPECT_FALSE(job_queue.Pop().IsValid());
+}
+
+TEST(JobQueue, LockFreeClear) {
+  JobQueue<int> job_queue(2, JobQueueType::LOCK_FREE);
+
+  EXPECT_TRUE(job_queue.Push(0));
+  EXPECT_TRUE(job_queue.Push(1));
+  EXPECT_EQ(job_queue.Size(), 2);
+
+  job_queue.Clear();
+  EXPECT_EQ(job_queue.Size(), 0);
+
+  EXPECT_TRUE(job_queue.Push(2));
+  EXPECT_EQ(job_queue.Pop().Data(), 2);
+}
+
+TEST(JobQueue, LockFreeUnbounded) {
+  EXPECT_THROW(JobQueue<int>(std::numeric_limits<size_t>::max(),
+                             JobQueueType::LOCK_FREE),
+               std::invalid_argument);
+}
+
+TEST(JobQueue, Stats) {
+  JobQueue<int> job_queue(1);
+
+  auto stats = job_queue.GetStats();
+  EXPECT_EQ(stats.num_pushed, 0);
+  EXPECT_EQ(stats.num_popped, 0);
+  EXPECT_EQ(stats.max_num_jobs, 0);
+  EXPECT_EQ(stats.mean_num_jobs, 0);
+  EXPECT_EQ(stats.push_wait_seconds, 0);
+  EXPECT_EQ(stats.pop_wait_seconds, 0);
+
+  // IMPORTANT: EXPECT_TRUE_* macros are not thread-safe,
+  //            so we use glog's CHECK macros inside threads.
+
+  EXPECT_TRUE(job_queue.Push(0));
+
+  std::thread consumer_thread([&job_queue]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    for (int i = 0; i < 2; ++i) {
+      CHECK(job_queue.Pop().IsValid());
+    }
+  });
+
+  // Waits for the consumer to pop the first job.
+  EXPECT_TRUE(job_queue.Push(1));
+  consumer_thread.join();
+
+  stats = job_queue.GetStats();
+  EXPECT_EQ(stats.num_pushed, 2);
+  EXPECT_EQ(stats.num_popped, 2);
+  EXPECT_EQ(stats.max_num_jobs, 1);
+  EXPECT_GT(stats.mean_num_jobs, 0);
+  EXPECT_LE(stats.mean_num_jobs, 1);
+  EXPECT_GT(stats.push_wait_seconds, 0.01);
+  EXPECT_GE(stats.pop_wait_seconds, 0);
+}
+
 TEST(GetEffectiveNumThreads, Nominal) {
   EXPECT_GT(GetEffectiveNumThreads(-2), 0);
   EXPECT_GT(GetEffectiveNumThreads(-1), 0);
@@ -896,5 +1153,38 @@ TEST(GetEffectiveNumThreads, Nominal) {
   EXPECT_EQ(GetEffectiveNumThreads(3), 3);
 }
 
+TEST(ParseCPUList, Nominal) {
+  EXPECT_TRUE(ParseCPUList("").empty());
+  EXPECT_EQ(ParseCPUList("3"), std::vector<int>({3}));
+  EXPECT_EQ(ParseCPUList("0-3,8,10-11\n"),
+            std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_ANY_THROW(ParseCPUList("3-1"));
+}
+
+#ifdef __linux__
+TEST(ThreadPool, ThreadAffinity) {
+  const std::vector<std::vector<int>> nodes = GetNumaNodeCPUs();
+  ASSERT_FALSE(nodes.empty());
+  EXPECT_EQ(GetThreadAffinity(), ThreadAffinity::NONE);
+
+  // Every worker is bound to a different core of the first node.
+  SetThreadAffinity(ThreadAffinity::CORE);
+  ThreadPool pool(nodes[0].size());
+  SetThreadAffinity(ThreadAffinity::NONE);
+  std::vector<int> worker_cpus(pool.NumThreads(), -1);
+  for (size_t i = 0; i < pool.NumThreads(); ++i) {
+    pool.AddTask([&pool, &worker_cpus]() {
+      worker_cpus[pool.GetThreadIndex()] = sched_getcpu();
+    });
+  }
+  pool.Wait();
+  for (size_t i = 0; i < worker_cpus.size(); ++i) {
+    if (worker_cpus[i] != -1) {
+      EXPECT_EQ(worker_cpus[i], nodes[0][i]);
+    }
+  }
+}
+#endif
+
 }  // namespace
 }  // namespace colmap
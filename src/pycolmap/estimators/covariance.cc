@@ -55,6 +55,29 @@ void BindCovarianceEstimator(py::module& m) {
       py::arg("reconstruction"),
       py::arg("lambda") = 1e-8);
 
+  m.def(
+      "estimate_pose_marginal_covariance_from_ba",
+      [](ceres::Problem* problem,
+         Reconstruction* reconstruction,
+         double lambda,
+         int num_threads,
+         double max_memory_mb) -> py::object {
+        std::map<image_t, Eigen::MatrixXd> image_id_to_covar;
+        if (!EstimatePoseMarginalCovariance(problem,
+                                            reconstruction,
+                                            image_id_to_covar,
+                                            lambda,
+                                            num_threads,
+                                            max_memory_mb))
+          return py::none();
+        return py::cast(image_id_to_covar);
+      },
+      py::arg("problem"),
+      py::arg("reconstruction"),
+      py::arg("lambda") = 1e-8,
+      py::arg("num_threads") = -1,
+      py::arg("max_memory_mb") = 1024);
+
   using EstimatorBase = BundleAdjustmentCovarianceEstimatorBase;
   py::class_<EstimatorBase>(m, "BundleAdjustmentCovarianceEstimatorBase")
       .def(
@@ -198,5 +221,11 @@ void BindCovarianceEstimator(py::module& m) {
       .def("has_valid_full_factorization",
            &BundleAdjustmentCovarianceEstimator::HasValidFullFactorization)
       .def("has_valid_pose_factorization",
-           &BundleAdjustmentCovarianceEstimator::HasValidPoseFactorization);
+           &BundleAdjustmentCovarianceEstimator::HasValidPoseFactorization)
+      .def("compute_marginals",
+           &BundleAdjustmentCovarianceEstimator::ComputeMarginals,
+           py::arg("num_threads") = -1,
+           py::arg("max_memory_mb") = 1024)
+      .def("has_valid_pose_marginals",
+           &BundleAdjustmentCovarianceEstimator::HasValidPoseMarginals);
 }
@@ -40,6 +40,9 @@ void BindTwoViewGeometryEstimator(py::module& m) {
                      &TwoViewGeometryOptions::compute_relative_pose)
       .def_readwrite("multiple_models",
                      &TwoViewGeometryOptions::multiple_models)
+      .def_readwrite("min_num_matches_parallel",
+                     &TwoViewGeometryOptions::min_num_matches_parallel)
+      .def_readwrite("use_prosac", &TwoViewGeometryOptions::use_prosac)
       .def_readwrite("ransac", &TwoViewGeometryOptions::ransac_options);
   MakeDataclass(PyTwoViewGeometryOptions);
   auto tvg_options = PyTwoViewGeometryOptions().cast<TwoViewGeometryOptions>();
@@ -74,19 +74,43 @@ void BindExtractFeatures(py::module& m) {
                          &SEOpts::num_threads,
                          "Number of threads for feature matching and "
                          "geometric verification.")
+          .def_readwrite("num_threads_per_image",
+                         &SEOpts::num_threads_per_image,
+                         "Number of threads used by the CPU extractor to "
+                         "compute the orientations and descriptors within a "
+                         "single image.")
           .def_readwrite("gpu_index",
                          &SEOpts::gpu_index,
                          "Index of the GPU used for feature matching. For "
                          "multi-GPU matching, you should separate multiple "
                          "GPU indices by comma, e.g., '0,1,2,3'.")
+          .def_readwrite("gpu_batch_size",
+                         &SEOpts::gpu_batch_size,
+                         "Number of images with the same dimensions that are "
+                         "extracted together on the GPU.")
           .def_readwrite(
               "max_image_size",
               &SEOpts::max_image_size,
               "Maximum image size, otherwise image will be down-scaled.")
+          .def_readwrite("tiled_extraction",
+                         &SEOpts::tiled_extraction,
+                         "Whether to extract the features of images larger "
+                         "than max_image_size at their original resolution in "
+                         "overlapping tiles of max_image_size instead of "
+                         "down-scaling them.")
+          .def_readwrite("tile_overlap",
+                         &SEOpts::tile_overlap,
+                         "Overlap in pixels between neighboring tiles in "
+                         "tiled extraction.")
           .def_readwrite("max_num_features",
                          &SEOpts::max_num_features,
                          "Maximum number of features to detect, keeping "
                          "larger-scale features.")
+          .def_readwrite("max_num_uniform_features",
+                         &SEOpts::max_num_uniform_features,
+                         "If positive, the detected features are reduced to "
+                         "this number by selecting them uniformly over the "
+                         "image.")
           .def_readwrite("first_octave",
                          &SEOpts::first_octave,
                          "First octave in the pyramid, i.e. -1 upsamples the "
@@ -127,7 +151,12 @@ void BindExtractFeatures(py::module& m) {
           .def_readwrite("dsp_num_scales", &SEOpts::dsp_num_scales)
           .def_readwrite("normalization",
                          &SEOpts::normalization,
-                         "L1_ROOT or L2 descriptor normalization");
+                         "L1_ROOT or L2 descriptor normalization")
+          .def_readwrite("compact_descriptors",
+                         &SEOpts::compact_descriptors,
+                         "Whether to extract compact 64-dimensional instead "
+                         "of 128-dimensional descriptors by summing "
+                         "neighboring orientation bins.");
   MakeDataclass(PySiftExtractionOptions);
   auto sift_extraction_options = PySiftExtractionOptions().cast<SEOpts>();
 
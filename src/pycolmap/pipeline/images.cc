@@ -41,25 +41,15 @@ void ImportImages(const std::string& database_path,
 
   PyInterrupt py_interrupt(2.0);
 
+  // The image headers are read in parallel in batches, between which the
+  // interrupt is checked.
+  const size_t kBatchSize = 1000;
+  ThreadPool thread_pool;
   while (image_reader.NextIndex() < image_reader.NumImages()) {
     if (py_interrupt.Raised()) {
       throw py::error_already_set();
     }
-    Camera camera;
-    Image image;
-    PosePrior pose_prior;
-    Bitmap bitmap;
-    if (image_reader.Next(&camera, &image, &pose_prior, &bitmap, nullptr) !=
-        ImageReader::Status::SUCCESS) {
-      continue;
-    }
-    DatabaseTransaction database_transaction(&database);
-    if (image.ImageId() == kInvalidImageId) {
-      image.SetImageId(database.WriteImage(image));
-      if (pose_prior.IsValid()) {
-        database.WritePosePrior(image.ImageId(), pose_prior);
-      }
-    }
+    image_reader.ImportNext(kBatchSize, &thread_pool);
   }
 }
 
@@ -187,7 +177,20 @@ void BindImages(py::module& m) {
               &IROpts::camera_mask_path,
               "Optional path to an image file specifying a mask for all "
               "images. No features will be extracted in regions where the "
-              "mask is black (pixel intensity value 0 in grayscale)");
+              "mask is black (pixel intensity value 0 in grayscale)")
+          .def_readwrite(
+              "min_decode_size",
+              &IROpts::min_decode_size,
+              "If positive, JPEG images are decoded at a reduced resolution "
+              "of 1/2, 1/4, or 1/8, such that the larger image dimension is "
+              "still at least this size. Cameras are nevertheless created "
+              "with the original image dimensions.")
+          .def_readwrite(
+              "use_content_hash",
+              &IROpts::use_content_hash,
+              "Whether to store a hash of the file content of each image. "
+              "Unchanged images are skipped, while the features and matches "
+              "of modified images are deleted and extracted again.");
   MakeDataclass(PyImageReaderOptions);
   auto reader_options = PyImageReaderOptions().cast<IROpts>();
 
@@ -220,7 +223,15 @@ void BindImages(py::module& m) {
           .def_readwrite("roi_min_x", &UDOpts::roi_min_x)
           .def_readwrite("roi_min_y", &UDOpts::roi_min_y)
           .def_readwrite("roi_max_x", &UDOpts::roi_max_x)
-          .def_readwrite("roi_max_y", &UDOpts::roi_max_y);
+          .def_readwrite("roi_max_y", &UDOpts::roi_max_y)
+          .def_readwrite("use_gpu",
+                         &UDOpts::use_gpu,
+                         "Whether to warp the images on the GPU. Requires "
+                         "CUDA.")
+          .def_readwrite("gpu_index",
+                         &UDOpts::gpu_index,
+                         "The index of the GPU used for warping, where -1 "
+                         "selects the best GPU.");
   MakeDataclass(PyUndistortCameraOptions);
   auto undistort_options = PyUndistortCameraOptions().cast<UDOpts>();
 
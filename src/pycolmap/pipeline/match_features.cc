@@ -80,6 +80,10 @@ void BindMatchFeatures(py::module& m) {
                          "multi-GPU matching, "
                          "you should separate multiple GPU indices by comma, "
                          "e.g., \"0,1,2,3\".")
+          .def_readwrite("num_matchers_per_gpu",
+                         &SMOpts::num_matchers_per_gpu,
+                         "Number of concurrent matchers on each GPU. Only "
+                         "supported by the CUDA version of SiftGPU.")
           .def_readwrite(
               "max_ratio",
               &SMOpts::max_ratio,
@@ -96,7 +100,37 @@ void BindMatchFeatures(py::module& m) {
           .def_readwrite("guided_matching",
                          &SMOpts::guided_matching,
                          "Whether to perform guided matching, if geometric "
-                         "verification succeeds.");
+                         "verification succeeds.")
+          .def_readwrite("max_num_pairs_per_commit",
+                         &SMOpts::max_num_pairs_per_commit,
+                         "Maximum number of image pairs per database commit.")
+          .def_readwrite("max_num_bytes_per_commit",
+                         &SMOpts::max_num_bytes_per_commit,
+                         "Maximum number of bytes of matches per database "
+                         "commit.")
+          .def_readwrite("num_shards",
+                         &SMOpts::num_shards,
+                         "Number of shards into which the image pairs are "
+                         "partitioned.")
+          .def_readwrite("shard_index",
+                         &SMOpts::shard_index,
+                         "Index of the shard of image pairs to match.")
+          .def_readwrite("pre_filter_num_features",
+                         &SMOpts::pre_filter_num_features,
+                         "If positive, reject image pairs by first matching "
+                         "only this number of largest-scale features.")
+          .def_readwrite("pre_filter_min_num_matches",
+                         &SMOpts::pre_filter_min_num_matches,
+                         "Minimum number of coarse matches to not reject an "
+                         "image pair in the pre-filter.")
+          .def_readwrite("sort_matches",
+                         &SMOpts::sort_matches,
+                         "Whether to sort the matches by decreasing "
+                         "descriptor similarity for progressive sampling.")
+          .def_readwrite("reverify_matches",
+                         &SMOpts::reverify_matches,
+                         "Whether to reuse the stored matches of verified "
+                         "image pairs and only verify them again.");
   MakeDataclass(PySiftMatchingOptions);
   auto sift_matching_options = PySiftMatchingOptions().cast<SMOpts>();
 
@@ -104,7 +138,11 @@ void BindMatchFeatures(py::module& m) {
   auto PyExhaustiveMatchingOptions =
       py::class_<ExhaustiveMatchingOptions>(m, "ExhaustiveMatchingOptions")
           .def(py::init<>())
-          .def_readwrite("block_size", &EMOpts::block_size);
+          .def_readwrite("block_size", &EMOpts::block_size)
+          .def_readwrite("cache_size",
+                         &EMOpts::cache_size,
+                         "Maximum number of images with features cached in "
+                         "memory. If not positive, five blocks are cached.");
   MakeDataclass(PyExhaustiveMatchingOptions);
   auto exhaustive_options = PyExhaustiveMatchingOptions().cast<EMOpts>();
 
@@ -149,6 +187,24 @@ void BindMatchFeatures(py::module& m) {
           .def_readwrite("vocab_tree_path",
                          &SeqMOpts::vocab_tree_path,
                          "Path to the vocabulary tree.")
+          .def_readwrite("loop_detection_index_path",
+                         &SeqMOpts::loop_detection_index_path,
+                         "Optional path to a file with the visual index of "
+                         "loop detection, which is updated with the new "
+                         "images instead of indexing all images again.")
+          .def_readwrite("online",
+                         &SeqMOpts::online,
+                         "Whether to only match the images appended to the "
+                         "sequence since the previous matching.")
+          .def_readwrite("rig_config_path",
+                         &SeqMOpts::rig_config_path,
+                         "Optional path to a camera rig configuration. Images "
+                         "of different cameras in the same rig are only "
+                         "matched, if their viewing directions overlap.")
+          .def_readwrite("rig_max_view_angle",
+                         &SeqMOpts::rig_max_view_angle,
+                         "The maximum angle between the viewing directions of "
+                         "two cameras in the same rig [degrees].")
           .def("vocab_tree_options", &SeqMOpts::VocabTreeOptions);
   MakeDataclass(PySequentialMatchingOptions);
   auto sequential_options = PySequentialMatchingOptions().cast<SeqMOpts>();
@@ -168,7 +224,16 @@ void BindMatchFeatures(py::module& m) {
                          &SpMOpts::max_distance,
                          "The maximum distance between the query and nearest "
                          "neighbor [meters].")
-          .def_readwrite("num_threads", &SpMOpts::num_threads);
+          .def_readwrite("num_threads", &SpMOpts::num_threads)
+          .def_readwrite("rig_config_path",
+                         &SpMOpts::rig_config_path,
+                         "Optional path to a camera rig configuration. Images "
+                         "of different cameras in the same rig are only "
+                         "matched, if their viewing directions overlap.")
+          .def_readwrite("rig_max_view_angle",
+                         &SpMOpts::rig_max_view_angle,
+                         "The maximum angle between the viewing directions of "
+                         "two cameras in the same rig [degrees].");
   MakeDataclass(PySpatialMatchingOptions);
   auto spatial_options = PySpatialMatchingOptions().cast<SpMOpts>();
 
@@ -196,6 +261,10 @@ void BindMatchFeatures(py::module& m) {
               "max_num_features",
               &VTMOpts::max_num_features,
               "The maximum number of features to use for indexing an image.")
+          .def_readwrite("max_document_frequency",
+                         &VTMOpts::max_document_frequency,
+                         "Visual words that occur in more than this fraction "
+                         "of the database images are pruned as stop words.")
           .def_readwrite("vocab_tree_path",
                          &VTMOpts::vocab_tree_path,
                          "Path to the vocabulary tree.")
@@ -203,7 +272,37 @@ void BindMatchFeatures(py::module& m) {
               "match_list_path",
               &VTMOpts::match_list_path,
               "Optional path to file with specific image names to match.")
+          .def_readwrite("index_path",
+                         &VTMOpts::index_path,
+                         "Optional path to the persisted visual index of the "
+                         "database images. Only new images are indexed.")
+          .def_readwrite("use_gpu",
+                         &VTMOpts::use_gpu,
+                         "Whether to assign features to visual words on the "
+                         "GPU. Requires CUDA.")
+          .def_readwrite("gpu_index",
+                         &VTMOpts::gpu_index,
+                         "Index of the GPU used for the visual word "
+                         "assignment, where -1 selects the best GPU.")
+          .def_readwrite("use_global_descriptors",
+                         &VTMOpts::use_global_descriptors,
+                         "Whether to retrieve images by approximate search "
+                         "of compact global descriptors instead of the "
+                         "visual words of all features.")
+          .def_readwrite("global_descriptor_num_clusters",
+                         &VTMOpts::global_descriptor_num_clusters,
+                         "Number of codebook clusters of the global "
+                         "descriptors.")
+          .def_readwrite("global_descriptor_num_probes",
+                         &VTMOpts::global_descriptor_num_probes,
+                         "Number of inverted lists of global descriptors "
+                         "scanned per query.")
           .def_readwrite("num_threads", &VTMOpts::num_threads)
+          .def_readwrite("cache_size",
+                         &VTMOpts::cache_size,
+                         "Maximum number of images with features cached in "
+                         "memory. If not positive, five times the number of "
+                         "retrieved images are cached.")
           .def("check", [](VTMOpts& self) {
             THROW_CHECK(!self.vocab_tree_path.empty())
                 << "vocab_tree_path required.";
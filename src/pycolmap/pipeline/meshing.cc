@@ -55,7 +55,20 @@ void BindMeshing(py::module& m) {
           .def_readwrite(
               "num_threads",
               &PoissonMOpts::num_threads,
-              "The number of threads used for the Poisson reconstruction.");
+              "The number of threads used for the Poisson reconstruction.")
+          .def_readwrite("downsample_voxel_size",
+                         &PoissonMOpts::downsample_voxel_size,
+                         "If positive, the input points are downsampled on a "
+                         "voxel grid of this size before the reconstruction.")
+          .def_readwrite("tile_size",
+                         &PoissonMOpts::tile_size,
+                         "If positive, the scene is partitioned into cubic "
+                         "tiles of this size, which are meshed independently "
+                         "and clipped at their boundaries.")
+          .def_readwrite("tile_overlap",
+                         &PoissonMOpts::tile_overlap,
+                         "The overlap of neighboring tiles relative to the "
+                         "tile size.");
   MakeDataclass(PyPoissonMeshingOptions);
   auto poisson_options = PyPoissonMeshingOptions().cast<PoissonMOpts>();
 
@@ -113,7 +126,25 @@ void BindMeshing(py::module& m) {
           .def_readwrite("num_threads",
                          &DMOpts::num_threads,
                          "The number of threads to use for reconstruction. "
-                         "Default is all threads.");
+                         "Default is all threads.")
+          .def_readwrite("parallel_graph_cut",
+                         &DMOpts::parallel_graph_cut,
+                         "Whether to compute the graph-cut with the parallel "
+                         "push-relabel instead of the Boykov-Kolmogorov "
+                         "max-flow algorithm.")
+          .def_readwrite("downsample_voxel_size",
+                         &DMOpts::downsample_voxel_size,
+                         "If positive, the fused points of dense input are "
+                         "downsampled on a voxel grid of this size.")
+          .def_readwrite("tile_size",
+                         &DMOpts::tile_size,
+                         "If positive, the scene is partitioned into cubic "
+                         "tiles of this size, which are meshed independently "
+                         "and clipped at their boundaries.")
+          .def_readwrite("tile_overlap",
+                         &DMOpts::tile_overlap,
+                         "The overlap of neighboring tiles relative to the "
+                         "tile size.");
   MakeDataclass(PyDelaunayMeshingOptions);
   auto delaunay_options = PyDelaunayMeshingOptions().cast<DMOpts>();
 
@@ -1,11 +1,8 @@
 #include "colmap/mvs/fusion.h"
+#include "colmap/mvs/patch_match.h"
 #include "colmap/scene/reconstruction.h"
 #include "colmap/util/misc.h"
 
-#ifdef COLMAP_CUDA_ENABLED
-#include "colmap/mvs/patch_match.h"
-#endif  // COLMAP_CUDA_ENABLED
-
 #include "colmap/util/logging.h"
 
 #include "pycolmap/helpers.h"
@@ -18,7 +15,6 @@ using namespace colmap;
 using namespace pybind11::literals;
 namespace py = pybind11;
 
-#ifdef COLMAP_CUDA_ENABLED
 void PatchMatchStereo(const std::string& workspace_path,
                       std::string workspace_format,
                       const std::string& pmvs_option_name,
@@ -35,7 +31,6 @@ void PatchMatchStereo(const std::string& workspace_path,
       options, workspace_path, workspace_format, pmvs_option_name, config_path);
   controller.Run();
 }
-#endif  // COLMAP_CUDA_ENABLED
 
 Reconstruction StereoFusion(const std::string& output_path,
                             const std::string& workspace_path,
@@ -60,6 +55,13 @@ Reconstruction StereoFusion(const std::string& output_path,
   fuser.Run();
 
   Reconstruction reconstruction;
+  if (!options.out_of_core_path.empty()) {
+    THROW_CHECK(!ExistsDir(output_path))
+        << "Out-of-core fusion only supports PLY output.";
+    fuser.WriteFusedPoints(output_path);
+    return reconstruction;
+  }
+
   // read data from sparse reconstruction
   if (workspace_format == "colmap") {
     reconstruction.Read(JoinPaths(workspace_path, "sparse"));
@@ -71,16 +73,13 @@ Reconstruction StereoFusion(const std::string& output_path,
   if (ExistsDir(output_path)) {
     reconstruction.WriteBinary(output_path);
   } else {
-    WriteBinaryPlyPoints(output_path, fuser.GetFusedPoints());
-    mvs::WritePointsVisibility(output_path + ".vis",
-                               fuser.GetFusedPointsVisibility());
+    fuser.WriteFusedPoints(output_path);
   }
 
   return reconstruction;
 }
 
 void BindMVS(py::module& m) {
-#ifdef COLMAP_CUDA_ENABLED
   using PMOpts = mvs::PatchMatchOptions;
   auto PyPatchMatchOptions =
       py::class_<PMOpts>(m, "PatchMatchOptions")
@@ -88,12 +87,20 @@ void BindMVS(py::module& m) {
           .def_readwrite("max_image_size",
                          &PMOpts::max_image_size,
                          "Maximum image size in either dimension.")
+          .def_readwrite("use_gpu",
+                         &PMOpts::use_gpu,
+                         "Whether to use the CUDA implementation instead of "
+                         "the multi-threaded CPU implementation.")
           .def_readwrite(
               "gpu_index",
               &PMOpts::gpu_index,
               "Index of the GPU used for patch match. For multi-GPU usage, "
               "you should separate multiple GPU indices by comma, e.g., "
               "\"0,1,2,3\".")
+          .def_readwrite("num_threads",
+                         &PMOpts::num_threads,
+                         "Number of threads of the CPU implementation for "
+                         "each problem.")
           .def_readwrite("depth_min", &PMOpts::depth_min)
           .def_readwrite("depth_max", &PMOpts::depth_max)
           .def_readwrite(
@@ -125,6 +132,20 @@ void BindMVS(py::module& m) {
           .def_readwrite("num_iterations",
                          &PMOpts::num_iterations,
                          "Number of coordinate descent iterations.")
+          .def_readwrite("num_pyramid_levels",
+                         &PMOpts::num_pyramid_levels,
+                         "Number of coarse-to-fine pyramid levels in the "
+                         "photometric pass, where each level halves the "
+                         "image resolution.")
+          .def_readwrite("pyramid_num_iterations",
+                         &PMOpts::pyramid_num_iterations,
+                         "Number of coordinate descent iterations at all but "
+                         "the coarsest pyramid level.")
+          .def_readwrite("init_from_sparse_points",
+                         &PMOpts::init_from_sparse_points,
+                         "Whether to initialize the photometric depth "
+                         "hypotheses from the interpolated sparse points "
+                         "instead of randomly.")
           .def_readwrite("geom_consistency",
                          &PMOpts::geom_consistency,
                          "Whether to add a regularized geometric consistency "
@@ -138,6 +159,15 @@ void BindMVS(py::module& m) {
                          &PMOpts::geom_consistency_max_cost,
                          "Maximum geometric consistency cost in terms of the "
                          "forward-backward reprojection error in pixels.")
+          .def_readwrite("half_precision_depth_maps",
+                         &PMOpts::half_precision_depth_maps,
+                         "Whether to store the source depth maps of the "
+                         "geometric consistency term in half precision on "
+                         "the GPU.")
+          .def_readwrite("gpu_depth_map_cache_size",
+                         &PMOpts::gpu_depth_map_cache_size,
+                         "Size in gigabytes of the GPU cache of source depth "
+                         "maps in the geometric pass.")
           .def_readwrite(
               "filter", &PMOpts::filter, "Whether to enable filtering.")
           .def_readwrite(
@@ -166,7 +196,36 @@ void BindMVS(py::module& m) {
               "Whether to tolerate missing images/maps in the problem setup")
           .def_readwrite("write_consistency_graph",
                          &PMOpts::write_consistency_graph,
-                         "Whether to write the consistency graph.");
+                         "Whether to write the consistency graph.")
+          .def_readwrite("write_compressed_maps",
+                         &PMOpts::write_compressed_maps,
+                         "Whether to write the depth and normal maps in the "
+                         "compressed 16-bit format.")
+          .def_readwrite("scored_src_image_selection",
+                         &PMOpts::scored_src_image_selection,
+                         "Whether to select the source images of __auto__ "
+                         "problems with a view selection score instead of "
+                         "the number of shared sparse points.")
+          .def_readwrite("src_image_min_score_ratio",
+                         &PMOpts::src_image_min_score_ratio,
+                         "Stop adding source images once the score gain drops "
+                         "below this ratio of the best source image's score.")
+          .def_readwrite("tile_size",
+                         &PMOpts::tile_size,
+                         "Maximum width and height of the tiles, in which the "
+                         "reference image is processed, or -1 to process the "
+                         "image in one piece.")
+          .def_readwrite("tile_overlap",
+                         &PMOpts::tile_overlap,
+                         "Number of pixels, by which neighboring tiles "
+                         "overlap.")
+          .def_readwrite("num_shards",
+                         &PMOpts::num_shards,
+                         "Number of shards, in which the problems are "
+                         "partitioned for distributed processing.")
+          .def_readwrite("shard_index",
+                         &PMOpts::shard_index,
+                         "Index of the shard processed by this run.");
   MakeDataclass(PyPatchMatchOptions);
   auto patch_match_options = PyPatchMatchOptions().cast<PMOpts>();
 
@@ -177,8 +236,7 @@ void BindMVS(py::module& m) {
         "pmvs_option_name"_a = "option-all",
         "options"_a = patch_match_options,
         "config_path"_a = "",
-        "Runs Patch-Match-Stereo (requires CUDA)");
-#endif  // COLMAP_CUDA_ENABLED
+        "Runs Patch-Match-Stereo");
 
   using SFOpts = mvs::StereoFusionOptions;
   auto PyStereoFusionOptions =
@@ -227,6 +285,28 @@ void BindMVS(py::module& m) {
           .def_readwrite("cache_size",
                          &SFOpts::cache_size,
                          "Cache size in gigabytes for fusion.")
+          .def_readwrite("out_of_core_path",
+                         &SFOpts::out_of_core_path,
+                         "Directory for spilling fused points and masks to "
+                         "disk. If empty, all data is kept in memory.")
+          .def_readwrite("use_gpu",
+                         &SFOpts::use_gpu,
+                         "Whether to check the consistency of the pixels "
+                         "with their overlapping images on the GPU, which "
+                         "restricts the traversal depth to one.")
+          .def_readwrite("gpu_index",
+                         &SFOpts::gpu_index,
+                         "Index of the GPU used for fusion. If -1, the best "
+                         "available GPU is used.")
+          .def_readwrite("use_consistency_graph",
+                         &SFOpts::use_consistency_graph,
+                         "Whether to restrict the traversal of each pixel to "
+                         "the images in the consistency graph of patch "
+                         "match stereo.")
+          .def_readwrite("max_num_concurrent_images",
+                         &SFOpts::max_num_concurrent_images,
+                         "Maximum number of images with disjoint "
+                         "neighborhoods that are fused concurrently.")
           .def_readwrite("bounding_box",
                          &SFOpts::bounding_box,
                          "Bounding box Tuple[min, max]");
@@ -146,6 +146,10 @@ void BindSfM(py::module& m) {
       .def_readwrite("num_threads",
                      &MapperOpts::num_threads,
                      "The number of threads to use during reconstruction.")
+      .def_readwrite("num_component_workers",
+                     &MapperOpts::num_component_workers,
+                     "The number of workers that reconstruct the connected "
+                     "components of the correspondence graph concurrently.")
       .def_readwrite("min_focal_length_ratio",
                      &MapperOpts::min_focal_length_ratio,
                      "The threshold used to filter and ignore images with "
@@ -170,6 +174,10 @@ void BindSfM(py::module& m) {
           "ba_refine_extra_params",
           &MapperOpts::ba_refine_extra_params,
           "Which intrinsic parameters to optimize during the reconstruction.")
+      .def_readwrite("ba_use_analytic_jacobians",
+                     &MapperOpts::ba_use_analytic_jacobians,
+                     "Whether to use analytic Jacobians in bundle adjustment "
+                     "for the camera models that support them.")
       .def_readwrite(
           "ba_min_num_residuals_for_multi_threading",
           &MapperOpts::ba_min_num_residuals_for_multi_threading,
@@ -203,6 +211,15 @@ void BindSfM(py::module& m) {
           "ba_global_points_freq",
           &MapperOpts::ba_global_points_freq,
           "The growth rates after which to perform global bundle adjustment.")
+      .def_readwrite("ba_global_adaptive",
+                     &MapperOpts::ba_global_adaptive,
+                     "Whether to postpone global bundle adjustments triggered "
+                     "by the growth ratios until the mean reprojection error "
+                     "drifted since the last global bundle adjustment.")
+      .def_readwrite("ba_global_max_reproj_error_drift",
+                     &MapperOpts::ba_global_max_reproj_error_drift,
+                     "The relative reprojection error drift after which to "
+                     "perform global bundle adjustment in adaptive mode.")
       .def_readwrite(
           "ba_global_function_tolerance",
           &MapperOpts::ba_global_function_tolerance,
@@ -211,6 +228,29 @@ void BindSfM(py::module& m) {
           "ba_global_max_num_iterations",
           &MapperOpts::ba_global_max_num_iterations,
           "The maximum number of global bundle adjustment iterations.")
+      .def_readwrite("ba_global_use_gpu",
+                     &MapperOpts::ba_global_use_gpu,
+                     "Whether to use the CUDA solvers of Ceres for global "
+                     "bundle adjustment, if available.")
+      .def_readwrite("ba_global_gpu_index",
+                     &MapperOpts::ba_global_gpu_index,
+                     "Index of the GPU used for global bundle adjustment. "
+                     "-1 selects the best GPU.")
+      .def_readwrite("ba_global_reuse_problem",
+                     &MapperOpts::ba_global_reuse_problem,
+                     "Whether to keep the global bundle adjustment problem "
+                     "alive across the refinement iterations and to only "
+                     "update changed observations.")
+      .def_readwrite("ba_global_max_num_images_per_partition",
+                     &MapperOpts::ba_global_max_num_images_per_partition,
+                     "If positive, global bundle adjustment of more registered "
+                     "images is partitioned into co-visible clusters of at "
+                     "most this number of images.")
+      .def_readwrite("ba_global_points3D_subsampling_num_levels",
+                     &MapperOpts::ba_global_points3D_subsampling_num_levels,
+                     "If positive, global bundle adjustment optimizes the "
+                     "cameras with a subset of the 3D points and refines the "
+                     "other 3D points afterwards with constant cameras.")
       .def_readwrite(
           "ba_local_max_refinements",
           &MapperOpts::ba_local_max_refinements,
@@ -227,6 +267,14 @@ void BindSfM(py::module& m) {
           "ba_global_max_refinement_change",
           &MapperOpts::ba_global_max_refinement_change,
           "The thresholds for iterative bundle adjustment refinements.")
+      .def_readwrite("reg_batch_size",
+                     &MapperOpts::reg_batch_size,
+                     "The maximum number of images to register in a batch "
+                     "before jointly triangulating and locally refining them.")
+      .def_readwrite("reg_batch_min_num_visible_points3D",
+                     &MapperOpts::reg_batch_min_num_visible_points3D,
+                     "The minimum number of visible 3D points for an image to "
+                     "be added to a registration batch after the first one.")
       .def_readwrite("snapshot_path",
                      &MapperOpts::snapshot_path,
                      "Path to a folder in which reconstruction snapshots will "
@@ -235,6 +283,37 @@ void BindSfM(py::module& m) {
                      &MapperOpts::snapshot_images_freq,
                      "Frequency of registered images according to which "
                      "reconstruction snapshots will be saved.")
+      .def_readwrite("snapshot_incremental",
+                     &MapperOpts::snapshot_incremental,
+                     "Whether snapshots after the first one of a "
+                     "reconstruction only store the changes since the "
+                     "previous snapshot.")
+      .def_readwrite("checkpoint_path",
+                     &MapperOpts::checkpoint_path,
+                     "Path to a folder in which checkpoints are written to "
+                     "resume an interrupted reconstruction.")
+      .def_readwrite("checkpoint_images_freq",
+                     &MapperOpts::checkpoint_images_freq,
+                     "Frequency of registered images according to which "
+                     "checkpoints are written. Disabled if zero.")
+      .def_readwrite("resume",
+                     &MapperOpts::resume,
+                     "Whether to resume from the latest checkpoint in "
+                     "checkpoint_path.")
+      .def_readwrite("correspondence_graph_cache_path",
+                     &MapperOpts::correspondence_graph_cache_path,
+                     "Path to a folder in which snapshots of the "
+                     "correspondence graph are cached to skip rebuilding it, "
+                     "if the database did not change.")
+      .def_readwrite("lazy_points2D",
+                     &MapperOpts::lazy_points2D,
+                     "Whether to load the 2D points of images from the "
+                     "database only when they are first needed.")
+      .def_readwrite("max_num_neighbors",
+                     &MapperOpts::max_num_neighbors,
+                     "The maximum number of neighbors with the most inliers, "
+                     "to which the correspondences of each image are kept. "
+                     "All image pairs are kept if zero.")
       .def_readwrite("image_names",
                      &MapperOpts::image_names,
                      "Which images to reconstruct. If no images are specified, "
@@ -288,6 +367,39 @@ void BindSfM(py::module& m) {
           .def_readwrite("refine_extrinsics",
                          &BAOpts::refine_extrinsics,
                          "Whether to refine the extrinsic parameter group.")
+          .def_readwrite(
+              "use_analytic_jacobians",
+              &BAOpts::use_analytic_jacobians,
+              "Whether to use cost functions with analytic Jacobians for the "
+              "PINHOLE, SIMPLE_RADIAL, RADIAL, and OPENCV camera models.")
+          .def_readwrite(
+              "use_float_jacobians",
+              &BAOpts::use_float_jacobians,
+              "Whether to evaluate automatically differentiated Jacobians in "
+              "single precision (experimental).")
+          .def_readwrite(
+              "use_batched_evaluation",
+              &BAOpts::use_batched_evaluation,
+              "Whether to evaluate the reprojection errors in batches grouped "
+              "by camera model instead of per residual block.")
+          .def_readwrite("use_gpu",
+                         &BAOpts::use_gpu,
+                         "Whether to use the CUDA solvers of Ceres, if "
+                         "available.")
+          .def_readwrite("gpu_index",
+                         &BAOpts::gpu_index,
+                         "Index of the GPU used for bundle adjustment. -1 "
+                         "selects the best GPU.")
+          .def_readwrite("min_num_images_gpu_solver",
+                         &BAOpts::min_num_images_gpu_solver,
+                         "Minimum number of images to use the GPU solvers.")
+          .def_readwrite(
+              "points3D_subsampling_num_levels",
+              &BAOpts::points3D_subsampling_num_levels,
+              "If positive, the cameras are adjusted with a subset of the 3D "
+              "points covering every image uniformly in a visibility pyramid "
+              "with this number of levels. The other 3D points are then "
+              "refined with constant cameras.")
           .def_readwrite("print_summary",
                          &BAOpts::print_summary,
                          "Whether to print a final summary.")
@@ -117,6 +117,11 @@ void BindCamera(py::module& m) {
       .def("has_bogus_params",
            &Camera::HasBogusParams,
            "Check whether camera has bogus parameters.")
+      .def("compute_undistortion_grid",
+           &Camera::ComputeUndistortionGrid,
+           "spacing"_a,
+           "Precompute the undistortion grid with the given spacing in "
+           "pixels\nto speed up cam_from_img for the current parameters.")
       .def("cam_from_img",
            &Camera::CamFromImg,
            "Project point in image plane to world / infinity.")
@@ -125,6 +125,12 @@ void BindDatabase(py::module& m) {
            &Database::DeleteInlierMatches,
            "image_id1"_a,
            "image_id2"_a)
+      .def("delete_image_features",
+           &Database::DeleteImageFeatures,
+           "image_id"_a)
+      .def("delete_images", &Database::DeleteImages, "image_ids"_a)
+      .def("delete_image_pairs", &Database::DeleteImagePairs, "pair_ids"_a)
+      .def("vacuum_into", &Database::VacuumInto, "path"_a)
       .def("clear_all_tables", &Database::ClearAllTables)
       .def("clear_cameras", &Database::ClearCameras)
       .def("clear_images", &Database::ClearImages)
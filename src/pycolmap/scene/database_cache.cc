@@ -18,7 +18,17 @@ void BindDatabaseCache(py::module& m) {
                   "database"_a,
                   "min_num_matches"_a,
                   "ignore_watermarks"_a,
+                  "image_names"_a,
+                  "correspondence_graph_cache_path"_a = "",
+                  "lazy_points2D"_a = false,
+                  "max_num_neighbors"_a = 0)
+      .def_static("create_from_cache",
+                  &DatabaseCache::CreateFromCache,
+                  "database_cache"_a,
                   "image_names"_a)
+      .def_static("read", &DatabaseCache::Read, "path"_a)
+      .def("write", &DatabaseCache::Write, "path"_a)
+      .def("update", &DatabaseCache::Update, "database"_a)
       .def("num_cameras", &DatabaseCache::NumCameras)
       .def("num_images", &DatabaseCache::NumImages)
       .def("exists_camera", &DatabaseCache::ExistsCamera, "camera_id"_a)
@@ -27,5 +37,7 @@ void BindDatabaseCache(py::module& m) {
       .def_property_readonly("images", &DatabaseCache::Images)
       .def_property_readonly("correspondence_graph",
                              &DatabaseCache::CorrespondenceGraph)
-      .def("find_image_with_name", &DatabaseCache::FindImageWithName);
+      .def("find_image_with_name", &DatabaseCache::FindImageWithName)
+      .def_property_readonly("lazy_points2D", &DatabaseCache::LazyPoints2D)
+      .def("evict_points2D", &DatabaseCache::EvictPoints2D, "image_id"_a);
 }
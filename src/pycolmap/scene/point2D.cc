@@ -12,6 +12,7 @@
 #include <sstream>
 
 #include <pybind11/eigen.h>
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/stl_bind.h>
@@ -39,7 +40,44 @@ void BindPoint2D(py::module& m) {
       .def("__repr__", &PrintPoint2D);
   MakeDataclass(PyPoint2D);
 
+  // The views below share the memory of the list, such that the coordinates
+  // of all points are accessible without converting each point separately.
+  // The views are invalidated when the list is resized.
   py::bind_vector<Point2DVector>(m, "ListPoint2D")
+      .def_property_readonly(
+          "xy",
+          [](py::object self) {
+            Point2DVector& points2D = self.cast<Point2DVector&>();
+            if (points2D.empty()) {
+              return py::array_t<double>(std::vector<py::ssize_t>{0, 2});
+            }
+            return py::array_t<double>(
+                {static_cast<py::ssize_t>(points2D.size()), py::ssize_t(2)},
+                {static_cast<py::ssize_t>(sizeof(Point2D)),
+                 static_cast<py::ssize_t>(sizeof(double))},
+                points2D[0].xy.data(),
+                self);
+          },
+          "Writable view of the image coordinates as an Nx2 array.")
+      .def_property_readonly(
+          "point3D_ids",
+          [](py::object self) {
+            const Point2DVector& points2D = self.cast<const Point2DVector&>();
+            if (points2D.empty()) {
+              return py::array_t<point3D_t>(0);
+            }
+            py::array_t<point3D_t> point3D_ids(
+                {static_cast<py::ssize_t>(points2D.size())},
+                {static_cast<py::ssize_t>(sizeof(Point2D))},
+                &points2D[0].point3D_id,
+                self);
+            // Tracks are only consistent if modified through the
+            // reconstruction, so the identifiers are read-only.
+            point3D_ids.attr("setflags")("write"_a = false);
+            return point3D_ids;
+          },
+          "Read-only view of the 3D point identifiers as an array of length "
+          "N.")
       .def("__repr__", [](const Point2DVector& self) {
         std::string repr = "[";
         bool is_first = true;
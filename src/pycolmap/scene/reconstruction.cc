@@ -15,6 +15,7 @@
 #include <sstream>
 
 #include <pybind11/eigen.h>
+#include <pybind11/numpy.h>
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/stl_bind.h>
@@ -78,6 +79,45 @@ void BindReconstruction(py::module& m) {
                              py::return_value_policy::reference_internal)
       .def("point3D", py::overload_cast<point3D_t>(&Reconstruction::Point3D))
       .def("point3D_ids", &Reconstruction::Point3DIds)
+      .def(
+          "points3D_arrays",
+          [](const Reconstruction& self) {
+            const py::ssize_t num_points3D = self.NumPoints3D();
+            py::array_t<point3D_t> point3D_ids(num_points3D);
+            py::array_t<double> xyz({num_points3D, py::ssize_t(3)});
+            py::array_t<uint8_t> color({num_points3D, py::ssize_t(3)});
+            py::array_t<double> error(num_points3D);
+            py::array_t<size_t> track_length(num_points3D);
+            point3D_t* point3D_ids_data = point3D_ids.mutable_data();
+            double* xyz_data = xyz.mutable_data();
+            uint8_t* color_data = color.mutable_data();
+            double* error_data = error.mutable_data();
+            size_t* track_length_data = track_length.mutable_data();
+            {
+              py::gil_scoped_release release;
+              size_t i = 0;
+              for (const auto& point3D : self.Points3D()) {
+                point3D_ids_data[i] = point3D.first;
+                Eigen::Map<Eigen::Vector3d>(xyz_data + 3 * i) =
+                    point3D.second.xyz;
+                Eigen::Map<Eigen::Vector3ub>(color_data + 3 * i) =
+                    point3D.second.color;
+                error_data[i] = point3D.second.error;
+                track_length_data[i] = point3D.second.track.Length();
+                ++i;
+              }
+            }
+            py::dict arrays;
+            arrays["point3D_ids"] = point3D_ids;
+            arrays["xyz"] = xyz;
+            arrays["color"] = color;
+            arrays["error"] = error;
+            arrays["track_length"] = track_length;
+            return arrays;
+          },
+          "Export the 3D points as a dict of arrays with the keys point3D_ids, "
+          "xyz, color, error, and track_length, which are filled without "
+          "creating a Python object per point.")
       .def("reg_image_ids", &Reconstruction::RegImageIds)
       .def("exists_camera", &Reconstruction::ExistsCamera)
       .def("exists_image", &Reconstruction::ExistsImage)
@@ -153,7 +193,7 @@ void BindReconstruction(py::module& m) {
            &Reconstruction::ComputeBoundingBox,
            "p0"_a = 0.0,
            "p1"_a = 1.0)
-      .def("crop", &Reconstruction::Crop)
+      .def("crop", &Reconstruction::Crop, "bbox"_a, "num_threads"_a = -1)
       .def("find_image_with_name",
            &Reconstruction::FindImageWithName,
            py::return_value_policy::reference_internal,
@@ -192,13 +232,23 @@ void BindReconstruction(py::module& m) {
            "@return              True if image could be read at given path.")
       .def("extract_colors_for_all_images",
            &Reconstruction::ExtractColorsForAllImages,
+           "path"_a,
+           "num_threads"_a = -1,
+           "min_image_size"_a = 0,
            "Extract colors for all 3D points by computing the mean color of "
            "all images.\n\n"
-           "@param path          Absolute or relative path to root folder of "
-           "image.\n"
-           "                     The image path is determined by concatenating "
-           "the\n"
-           "                     root path and the name of the image.")
+           "@param path            Absolute or relative path to root folder "
+           "of image.\n"
+           "                       The image path is determined by "
+           "concatenating the\n"
+           "                       root path and the name of the image.\n"
+           "@param num_threads     Number of threads reading the images in "
+           "parallel.\n"
+           "@param min_image_size  If positive, JPEG images are decoded at a "
+           "reduced\n"
+           "                       resolution, whose larger dimension is at "
+           "least the\n"
+           "                       given size.")
       .def("create_image_dirs",
            &Reconstruction::CreateImageDirs,
            "Create all image sub-directories in the given path.")
@@ -47,6 +47,16 @@ void BindIncrementalMapperController(py::module& m) {
            "image_path"_a,
            "database_path"_a,
            "reconstruction_manager"_a)
+      .def(py::init<std::shared_ptr<const IncrementalMapperOptions>,
+                    const std::string&,
+                    const std::string&,
+                    std::shared_ptr<const DatabaseCache>,
+                    std::shared_ptr<ReconstructionManager>>(),
+           "options"_a,
+           "image_path"_a,
+           "database_path"_a,
+           "shared_database_cache"_a,
+           "reconstruction_manager"_a)
       .def_property_readonly("options", &IncrementalMapperController::Options)
       .def_property_readonly("image_path",
                              &IncrementalMapperController::ImagePath)
@@ -67,7 +77,8 @@ void BindIncrementalMapperController(py::module& m) {
            &IncrementalMapperController::CheckRunGlobalRefinement,
            "reconstruction"_a,
            "ba_prev_num_reg_images"_a,
-           "ba_prev_num_points"_a)
+           "ba_prev_num_points"_a,
+           "ba_prev_mean_reproj_error"_a = -1.0)
       .def("reconstruct",
            &IncrementalMapperController::Reconstruct,
            "mapper_options"_a)
@@ -115,6 +126,14 @@ void BindIncrementalMapperOptions(py::module& m) {
       .def_readwrite("abs_pose_min_inlier_ratio",
                      &Opts::abs_pose_min_inlier_ratio,
                      "Minimum inlier ratio in absolute pose estimation.")
+      .def_readwrite(
+          "abs_pose_use_sprt",
+          &Opts::abs_pose_use_sprt,
+          "Whether to reject bad models early in absolute pose estimation.")
+      .def_readwrite("abs_pose_use_prosac",
+                     &Opts::abs_pose_use_prosac,
+                     "Whether to sample the 2D-3D correspondences "
+                     "progressively by decreasing track length.")
       .def_readwrite(
           "abs_pose_refine_focal_length",
           &Opts::abs_pose_refine_focal_length,
@@ -156,10 +175,40 @@ void BindIncrementalMapperOptions(py::module& m) {
                      &Opts::fix_existing_images,
                      "If reconstruction is provided as input, fix the existing "
                      "image poses.")
+      .def_readwrite("ba_global_reuse_problem",
+                     &Opts::ba_global_reuse_problem,
+                     "Whether to keep the global bundle adjustment problem "
+                     "alive across the refinement iterations and to only "
+                     "update changed observations.")
+      .def_readwrite("ba_global_max_num_images_per_partition",
+                     &Opts::ba_global_max_num_images_per_partition,
+                     "If positive, global bundle adjustment of more registered "
+                     "images is partitioned into co-visible clusters of at "
+                     "most this number of images.")
       .def_readwrite("num_threads", &Opts::num_threads, "Number of threads.")
+      .def_readwrite("num_parallel_reg_candidates",
+                     &Opts::num_parallel_reg_candidates,
+                     "Number of next image candidates, whose poses are "
+                     "estimated concurrently before they are registered in "
+                     "order of priority.")
+      .def_readwrite("num_parallel_init_pair_candidates",
+                     &Opts::num_parallel_init_pair_candidates,
+                     "Number of initial image pair candidates, whose two-view "
+                     "geometries are estimated concurrently before the best "
+                     "suitable pair is selected.")
       .def_readwrite("image_selection_method",
                      &Opts::image_selection_method,
-                     "Method to find and select next best image to register.");
+                     "Method to find and select next best image to register.")
+      .def_readwrite("sequential",
+                     &Opts::sequential,
+                     "Whether the images are the frames of a video in the "
+                     "order of their names, which are registered in temporal "
+                     "order and refined in a sliding window.")
+      .def_readwrite("sequential_loop_min_frame_gap",
+                     &Opts::sequential_loop_min_frame_gap,
+                     "Minimum distance in frames of the correspondences "
+                     "between the registered frames that close a loop in "
+                     "sequential mode.");
   MakeDataclass(PyOpts);
 }
 
@@ -251,10 +300,18 @@ void BindIncrementalMapperImpl(py::module& m) {
            "image_id1"_a,
            "image_id2"_a)
       .def("find_next_images", &IncrementalMapper::FindNextImages, "options"_a)
+      .def("estimate_next_image_poses",
+           &IncrementalMapper::EstimateNextImagePoses,
+           "options"_a,
+           "image_ids"_a)
       .def("register_next_image",
            &IncrementalMapper::RegisterNextImage,
            "options"_a,
            "image_id"_a)
+      .def("is_loop_closure",
+           &IncrementalMapper::IsLoopClosure,
+           "options"_a,
+           "image_id"_a)
       .def("triangulate_image",
            &IncrementalMapper::TriangulateImage,
            "tri_options"_a,
@@ -69,7 +69,11 @@ void BindIncrementalTriangulator(py::module& m) {
       .def_readwrite("max_extra_param",
                      &Opts::max_extra_param,
                      "The threshold used to filter and ignore images with "
-                     "degenerate intrinsics.");
+                     "degenerate intrinsics.")
+      .def_readwrite("num_threads",
+                     &Opts::num_threads,
+                     "Number of threads to estimate the new 3D points of an "
+                     "image in parallel.");
   MakeDataclass(PyOpts);
 
   // TODO: Add bindings for GetModifiedPoints3D.
@@ -317,6 +317,10 @@ public:
 	SIFTGPU_EXPORT virtual void SetDescriptors(int index, int num, const float* descriptors, int id  = -1);
 	//Option 2 unsigned char descriptors. They must be already normalized to 512
 	SIFTGPU_EXPORT virtual void SetDescriptors(int index, int num, const unsigned char * descriptors, int id = -1);
+	//Keep up to num_sets descriptor sets with an id != -1 resident in GPU memory, such that
+	//setting the descriptors of a resident id skips the upload. num_sets < 0 sizes the cache
+	//by the available device memory. Returns the cache size, which is 0 if unsupported.
+	SIFTGPU_EXPORT virtual int SetDescriptorCacheSize(int num_sets);
 
 	//match two sets of features, the function RETURNS the number of matches.
 	//Given two normalized descriptor d1,d2, the distance here is acos(d1 *d2);
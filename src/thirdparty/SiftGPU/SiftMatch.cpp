@@ -668,6 +668,11 @@ void SiftMatchGPU::SetDescriptors(int index, int num, const float* descriptors,
 	__matcher->SetDescriptors(index, num, descriptors, id);
 }
 
+int SiftMatchGPU::SetDescriptorCacheSize(int num_sets)
+{
+	return __matcher ? __matcher->SetDescriptorCacheSize(num_sets) : 0;
+}
+
 void SiftMatchGPU::SetFeautreLocation(int index, const float* locations, int gap)
 {
 	__matcher->SetFeautreLocation(index, locations, gap);
@@ -46,12 +46,20 @@ using namespace std;
 
 SiftMatchCU::SiftMatchCU(int max_sift) : SiftMatchGPU() {
   _num_sift[0] = _num_sift[1] = 0;
-  _id_sift[0] = _id_sift[1] = 0;
+  _id_sift[0] = _id_sift[1] = -1;
   _have_loc[0] = _have_loc[1] = 0;
+  _texDesPtr[0] = &_texDes[0];
+  _texDesPtr[1] = &_texDes[1];
+  _texLocPtr[0] = &_texLoc[0];
+  _texLocPtr[1] = &_texLoc[1];
+  _cached_sift[0] = _cached_sift[1] = NULL;
+  _descriptor_cache_clock = 0;
   __max_sift = max_sift <= 0 ? 4096 : ((max_sift + 31) / 32 * 32);
   _initialized = 0;
 }
 
+SiftMatchCU::~SiftMatchCU() {}
+
 bool SiftMatchCU::Allocate(int max_sift, int mbm) {
   SetMaxSift(max_sift);
 
@@ -101,16 +109,103 @@ void SiftMatchCU::SetDescriptors(int index, int num,
   if (_initialized == 0) return;
   if (index > 1) index = 1;
   if (index < 0) index = 0;
-  _have_loc[index] = 0;
   // the same feature is already set
-  if (id != -1 && id == _id_sift[index]) return;
+  if (id != -1 && id == _id_sift[index]) {
+    _have_loc[index] = _cached_sift[index] != NULL && _cached_sift[index]->have_loc;
+    return;
+  }
+  _have_loc[index] = 0;
   _id_sift[index] = id;
   if (num > __max_sift) num = __max_sift;
   _num_sift[index] = num;
+  if (id != -1 && !_descriptor_cache.empty()) {
+    CachedDescriptors* entry = GetCachedDescriptors(index, num, descriptors, id);
+    if (entry != NULL) {
+      // the locations of resident descriptors are resident as well
+      _cached_sift[index] = entry;
+      _texDesPtr[index] = entry->tex.get();
+      _texLocPtr[index] = entry->loc.get();
+      _have_loc[index] = entry->have_loc;
+      return;
+    }
+  }
+  _cached_sift[index] = NULL;
+  _texDesPtr[index] = &_texDes[index];
+  _texLocPtr[index] = &_texLoc[index];
   _texDes[index].InitTexture(8 * num, 1, 4);
   _texDes[index].CopyFromHost((void*)descriptors);
 }
 
+SiftMatchCU::CachedDescriptors* SiftMatchCU::GetCachedDescriptors(
+    int index, int num, const unsigned char* descriptors, int id) {
+  ++_descriptor_cache_clock;
+
+  // Reuse the resident descriptors or otherwise evict the least recently
+  // used descriptors, which are not in use by the other feature set.
+  CachedDescriptors* entry = NULL;
+  for (size_t i = 0; i < _descriptor_cache.size(); ++i) {
+    CachedDescriptors& candidate = _descriptor_cache[i];
+    if (candidate.id == id && candidate.num == num) {
+      candidate.last_used = _descriptor_cache_clock;
+      return &candidate;
+    }
+    if (&candidate == _cached_sift[1 - index]) continue;
+    if (entry == NULL || candidate.last_used < entry->last_used) {
+      entry = &candidate;
+    }
+  }
+
+  if (entry == NULL) return NULL;
+
+  entry->id = -1;
+  entry->have_loc = 0;
+  if (!entry->tex) entry->tex.reset(new CuTexImage());
+  if (!entry->loc) entry->loc.reset(new CuTexImage());
+  if (!entry->tex->InitTexture(8 * num, 1, 4) ||
+      !entry->loc->InitTexture(num, 1, 2)) {
+    // Release the memory and fall back to uploading without caching.
+    entry->tex.reset();
+    entry->loc.reset();
+    cudaGetLastError();
+    return NULL;
+  }
+  entry->tex->CopyFromHost((void*)descriptors);
+  entry->id = id;
+  entry->num = num;
+  entry->last_used = _descriptor_cache_clock;
+  return entry;
+}
+
+int SiftMatchCU::SetDescriptorCacheSize(int num_sets) {
+  for (int index = 0; index < 2; ++index) {
+    _id_sift[index] = -1;
+    _have_loc[index] = 0;
+    _cached_sift[index] = NULL;
+    _texDesPtr[index] = &_texDes[index];
+    _texLocPtr[index] = &_texLoc[index];
+  }
+  _descriptor_cache.clear();
+
+  if (num_sets < 0) {
+    // Use at most half of the free device memory.
+    size_t free_bytes = 0;
+    size_t total_bytes = 0;
+    if (cudaMemGetInfo(&free_bytes, &total_bytes) != cudaSuccess) {
+      cudaGetLastError();
+      return 0;
+    }
+    const size_t num_bytes_per_set = 136 * static_cast<size_t>(__max_sift);
+    num_sets = static_cast<int>(
+        min(free_bytes / 2 / num_bytes_per_set, static_cast<size_t>(1024)));
+  }
+
+  // The two feature sets may not evict each other.
+  if (num_sets < 2) return 0;
+
+  _descriptor_cache.resize(num_sets);
+  return num_sets;
+}
+
 void SiftMatchCU::SetDescriptors(int index, int num, const float* descriptors,
                                  int id) {
   if (_initialized == 0) return;
@@ -129,9 +224,12 @@ void SiftMatchCU::SetDescriptors(int index, int num, const float* descriptors,
 void SiftMatchCU::SetFeautreLocation(int index, const float* locations,
                                      int gap) {
   if (_num_sift[index] <= 0) return;
-  _texLoc[index].InitTexture(_num_sift[index], 1, 2);
+  // the locations of resident descriptors are only uploaded once
+  if (_have_loc[index] && _cached_sift[index] != NULL) return;
+  CuTexImage* texLoc = _texLocPtr[index];
+  texLoc->InitTexture(_num_sift[index], 1, 2);
   if (gap == 0) {
-    _texLoc[index].CopyFromHost(locations);
+    texLoc->CopyFromHost(locations);
   } else {
     sift_buffer.resize(_num_sift[index] * 2);
     float* pbuf = (float*)(&sift_buffer[0]);
@@ -140,9 +238,10 @@ void SiftMatchCU::SetFeautreLocation(int index, const float* locations,
       pbuf[i * 2 + 1] = *locations++;
       locations += gap;
     }
-    _texLoc[index].CopyFromHost(pbuf);
+    texLoc->CopyFromHost(pbuf);
   }
   _have_loc[index] = 1;
+  if (_cached_sift[index] != NULL) _cached_sift[index]->have_loc = 1;
 }
 
 int SiftMatchCU::GetGuidedSiftMatch(int max_match, uint32_t match_buffer[][2],
@@ -152,7 +251,7 @@ int SiftMatchCU::GetGuidedSiftMatch(int max_match, uint32_t match_buffer[][2],
   if (_initialized == 0) return 0;
   if (_num_sift[0] <= 0 || _num_sift[1] <= 0) return 0;
   if (_have_loc[0] == 0 || _have_loc[1] == 0) return 0;
-  ProgramCU::MultiplyDescriptorG(_texDes, _texDes + 1, _texLoc, _texLoc + 1,
+  ProgramCU::MultiplyDescriptorG(_texDesPtr[0], _texDesPtr[1], _texLocPtr[0], _texLocPtr[1],
                                  &_texDot, (mbm ? &_texCRT : NULL), H, hdistmax,
                                  F, fdistmax);
   return GetBestMatch(max_match, match_buffer, distmax, ratiomax, mbm);
@@ -162,7 +261,7 @@ int SiftMatchCU::GetSiftMatch(int max_match, uint32_t match_buffer[][2],
                               float distmax, float ratiomax, int mbm) {
   if (_initialized == 0) return 0;
   if (_num_sift[0] <= 0 || _num_sift[1] <= 0) return 0;
-  ProgramCU::MultiplyDescriptor(_texDes, _texDes + 1, &_texDot,
+  ProgramCU::MultiplyDescriptor(_texDesPtr[0], _texDesPtr[1], &_texDot,
                                 (mbm ? &_texCRT : NULL));
   return GetBestMatch(max_match, match_buffer, distmax, ratiomax, mbm);
 }
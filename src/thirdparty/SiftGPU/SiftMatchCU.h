@@ -25,6 +25,9 @@
 #define CU_SIFT_MATCH_H
 #if defined(CUDA_SIFTGPU_ENABLED)
 
+#include <memory>
+#include <vector>
+
 class CuTexImage;
 class SiftMatchCU:public SiftMatchGPU
 {
@@ -41,20 +44,40 @@ private:
 	int _num_sift[2];
 	int _id_sift[2];
 	int _have_loc[2];
+	//descriptor sets resident in GPU memory with their feature locations,
+	//evicted in least recently used order
+	struct CachedDescriptors
+	{
+		int id = -1;
+		int num = 0;
+		int have_loc = 0;
+		long long last_used = 0;
+		std::unique_ptr<CuTexImage> tex;
+		std::unique_ptr<CuTexImage> loc;
+	};
+	vector<CachedDescriptors> _descriptor_cache;
+	long long _descriptor_cache_clock;
+
+	//features currently used for matching, either in _texDes/_texLoc or resident in the cache
+	CachedDescriptors* _cached_sift[2];
+	CuTexImage* _texDesPtr[2];
+	CuTexImage* _texLocPtr[2];
 
 	//gpu parameter
 	int _initialized;
 	vector<int> sift_buffer;
 private:
+	CachedDescriptors* GetCachedDescriptors(int index, int num, const unsigned char * descriptors, int id);
 	int  GetBestMatch(int max_match, uint32_t match_buffer[][2], float distmax, float ratiomax, int mbm);
 public:
 	SiftMatchCU(int max_sift);
-	virtual ~SiftMatchCU(){};
+	virtual ~SiftMatchCU();
 	void InitSiftMatch();
   bool Allocate(int max_sift, int mbm) override;
 	void SetMaxSift(int max_sift) override;
 	void SetDescriptors(int index, int num, const unsigned char * descriptor, int id = -1);
 	void SetDescriptors(int index, int num, const float * descriptor, int id = -1);
+	int  SetDescriptorCacheSize(int num_sets) override;
 	void SetFeautreLocation(int index, const float* locatoins, int gap);
 	int  GetSiftMatch(int max_match, uint32_t match_buffer[][2], float distmax, float ratiomax, int mbm);
 	int  GetGuidedSiftMatch(int max_match, uint32_t match_buffer[][2], float* H, float* F,